@@ -32,6 +32,8 @@
 #include "ql/api/operation.h"
 #include "ql/api/unitary.h"
 #include "ql/api/kernel.h"
+#include "ql/api/compile_job.h"
+#include "ql/api/schedule.h"
 #include "ql/api/program.h"
 #include "ql/api/cqasm_reader.h"
 
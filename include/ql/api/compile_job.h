@@ -0,0 +1,59 @@
+/** \file
+ * API header for compilations running in the background.
+ */
+
+#pragma once
+
+#include <future>
+#include "ql/pmgr/manager.h"
+#include "ql/api/declarations.h"
+
+//============================================================================//
+//                               W A R N I N G                                //
+//----------------------------------------------------------------------------//
+//         Docstrings in this file must manually be kept in sync with         //
+//    compile_job.i! This should be automated at some point, but isn't yet.   //
+//============================================================================//
+
+namespace ql {
+namespace api {
+
+/**
+ * Handle for a compilation running in a background thread, as returned by
+ * Program::compile_async(). The global options are frozen until the
+ * compilation completes. When the last handle for a compilation is
+ * destroyed, the destructor waits for the compilation to complete.
+ */
+class CompileJob {
+private:
+    friend class Program;
+
+    /**
+     * Future for the compilation result.
+     */
+    std::shared_future<void> future;
+
+    /**
+     * Starts compiling the given program using the given pass manager in a
+     * background thread.
+     */
+    CompileJob(const ql::pmgr::Ref &pass_manager, const ql::ir::Ref &ir);
+
+public:
+
+    /**
+     * Returns whether the compilation has completed, either successfully or
+     * with an error. Does not block.
+     */
+    bool done() const;
+
+    /**
+     * Waits for the compilation to complete. If compilation failed, the
+     * exception is rethrown.
+     */
+    void wait() const;
+
+};
+
+} // namespace api
+} // namespace ql
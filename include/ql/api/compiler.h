@@ -356,6 +356,16 @@ public:
      */
     void compile(const Program &program);
 
+    /**
+     * Ensures that all passes have been constructed, and then runs the passes
+     * on each of the given programs, compiling up to num_threads programs
+     * concurrently. 0 means use all hardware threads. The programs should all
+     * target the same platform. Global options cannot be changed while this
+     * runs. If compilation of one or more programs fails, the exception for
+     * the first failing program is rethrown once all programs are done.
+     */
+    void compile_batch(const std::vector<Program> &programs, size_t num_threads = 0);
+
     /**
      * Ensures that all passes have been constructed, and then runs the passes
      * without specification of an input program. The first pass should then act
@@ -15,6 +15,8 @@ class CReg;
 class Operation;
 class Unitary;
 class Program;
+class CompileJob;
+class Schedule;
 class Kernel;
 class cQasmReader;
 
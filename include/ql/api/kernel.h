@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include "ql/ir/compat/compat.h"
 #include "ql/api/declarations.h"
 #include "ql/api/platform.h"
@@ -207,6 +208,33 @@ public:
         const std::vector<size_t> &condregs
     );
 
+    /**
+     * Appends many simple quantum gates at once, described by flat arrays
+     * rather than by one gate() call per gate. This is intended for Python
+     * users that generate large circuits with NumPy, in which case the arrays
+     * are read directly from the NumPy buffers.
+     *
+     * names is the table of gate names that the gate types index into. types
+     * contains one type index per gate, and thus determines the number of
+     * gates. qubits contains the qubit operands of all gates in row-major
+     * order; each gate gets the same number of entries (num_qubits divided by
+     * num_types), and gates with fewer operands than that must pad the end of
+     * their row with negative values. angles is either empty (num_angles = 0)
+     * or contains one angle per gate.
+     *
+     * The gates are added as if by gate(name, qubits, 0, angle), so the
+     * current preset condition, if any, applies to all of them.
+     */
+    void gates(
+        const std::vector<std::string> &names,
+        const std::int64_t *types,
+        size_t num_types,
+        const std::int64_t *qubits,
+        size_t num_qubits,
+        const double *angles,
+        size_t num_angles
+    );
+
     /**
      * Appends a classical assignment gate to the circuit. The classical integer
      * register is assigned to the result of the given operation.
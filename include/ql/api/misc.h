@@ -126,5 +126,28 @@ void compile(
     std::map<std::string, std::string> read_options = {}
 );
 
+/**
+ * Like compile(), but reads the given cQASM code instead of a file, and
+ * returns the output files instead of writing them to disk (see
+ * Program.compile_in_memory()). If platform_json is empty, the platform must
+ * be encoded using a `pragma @ql.platform(...)` annotation as for compile().
+ * Otherwise, the platform is built from the given platform configuration JSON
+ * *data*, including the compiler configuration it specifies, if any.
+ */
+std::map<std::string, std::string> compile_in_memory(
+    const std::string &cqasm,
+    const std::string &platform_json = "",
+    std::map<std::string, std::string> read_options = {}
+);
+
+/**
+ * Returns the progress of the long-running algorithms that are currently
+ * reporting it, such as the router of the mapper, as a fraction between 0 and
+ * 1 keyed by the name of the algorithm. The progress of concurrent instances
+ * of the same algorithm is averaged. This may be called from another thread
+ * while a program is being compiled.
+ */
+std::map<std::string, double> get_progress();
+
 } // namespace api
 } // namespace ql
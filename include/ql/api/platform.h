@@ -91,7 +91,8 @@ public:
      * Constructs a platform. name is any name the user wants to give to the
      * platform; it is only used for report messages. platform_config must be
      * a recognized architecture (variant) name, or must point to a JSON file
-     * that represents the platform directly. Optionally, compiler_config can be
+     * that represents the platform directly or to a platform snapshot written
+     * by write_snapshot(). Optionally, compiler_config can be
      * specified to override the compiler configuration specified by the
      * platform (if any).
      */
@@ -147,6 +148,15 @@ public:
      */
     std::string get_info() const;
 
+    /**
+     * Writes a binary snapshot of the loaded platform to the given file. The
+     * file can be used in place of the platform configuration file when
+     * constructing a platform later on, which avoids preprocessing the
+     * configuration and recomputing the topology. Snapshots can only be
+     * loaded by the OpenQL version that wrote them.
+     */
+    void write_snapshot(const std::string &fname) const;
+
     /**
      * Returns whether a custom compiler configuration has been attached to this
      * platform. When this is the case, programs constructed from this platform
@@ -8,6 +8,8 @@
 #include "ql/pmgr/manager.h"
 #include "ql/api/declarations.h"
 #include "ql/api/platform.h"
+#include "ql/api/compile_job.h"
+#include "ql/api/schedule.h"
 #include "ql/api/program.h"
 
 //============================================================================//
@@ -87,6 +89,29 @@ public:
      */
     void add_kernel(const Kernel &k);
 
+    /**
+     * Adds the given unconditionally-executed kernels to the end of the
+     * program. This is equivalent to calling add_kernel() for each kernel,
+     * except that none of the kernels are added if any of them cannot be.
+     */
+    void add_kernels(const std::vector<Kernel> &ks);
+
+    /**
+     * Adds unconditionally-executed clones of the given kernel to the end of
+     * the program, in which only the angles of some of the gates differ. The
+     * gates to substitute the angle of are specified by their index in the
+     * kernel, and must be rx, ry, rz, or custom gates. The angles vector
+     * specifies the angles for each clone in turn, so its size must be a
+     * multiple of the number of gate indices. Clone i is named
+     * <kernel name>_<i>. The gates are copied rather than resolved against
+     * the platform again for every clone.
+     */
+    void add_kernel_clones(
+        const Kernel &k,
+        const std::vector<size_t> &gate_indices,
+        const std::vector<double> &angles
+    );
+
     /**
      * Adds an unconditionally-executed subprogram to the end of the program.
      */
@@ -190,16 +215,42 @@ public:
     void compile();
 
     /**
-     * Prints the interaction matrix for each kernel in the program.
+     * Compiles the program without writing any output files to disk. The
+     * files are returned instead, mapping the path they would have been
+     * written to (usually starting with the output_dir option) to their
+     * contents.
+     */
+    std::map<std::string, std::string> compile_in_memory();
+
+    /**
+     * Compiles the program like compile(), and returns the instructions of
+     * the compiled program in columnar form.
+     */
+    Schedule compile_to_schedule();
+
+    /**
+     * Starts compiling the program in a background thread, returning a handle
+     * that can be used to poll or wait for completion. The program is
+     * converted to the compiler's internal representation before this
+     * returns, so it may be modified afterwards without affecting the
+     * compilation. The global options are frozen until compilation completes.
+     */
+    CompileJob compile_async();
+
+    /**
+     * Prints the interaction matrix for each kernel in the program. If sparse
+     * is set, only the nonzero entries are printed, one "<qubit> <qubit>
+     * <count>" line each.
      */
-    void print_interaction_matrix() const;
+    void print_interaction_matrix(bool sparse = false) const;
 
     /**
      * Writes the interaction matrix for each kernel in the program to a file.
      * This is one of the few functions that still uses the global output_dir
-     * option.
+     * option. If sparse is set, only the nonzero entries are written, one
+     * "<qubit> <qubit> <count>" line each.
      */
-    void write_interaction_matrix() const;
+    void write_interaction_matrix(bool sparse = false) const;
 
 };
 
@@ -0,0 +1,114 @@
+/** \file
+ * API header for accessing the schedule of a compiled program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "ql/ir/ir.h"
+#include "ql/api/declarations.h"
+
+//============================================================================//
+//                               W A R N I N G                                //
+//----------------------------------------------------------------------------//
+//         Docstrings in this file must manually be kept in sync with         //
+//     schedule.i! This should be automated at some point, but isn't yet.     //
+//============================================================================//
+
+namespace ql {
+namespace api {
+
+/**
+ * The instructions of a compiled program in columnar form, as returned by
+ * Program::compile_to_schedule(). Each column is a flat array of 64-bit
+ * integers, so the schedule of large programs can be analyzed without
+ * creating an object per instruction.
+ *
+ * The instructions of all blocks are concatenated in program order. The
+ * following columns exist:
+ *
+ *  - "type": index into get_instruction_types() for each instruction;
+ *  - "cycle": the cycle each instruction is scheduled in, relative to the
+ *    start of its block;
+ *  - "duration": the duration of each instruction in cycles;
+ *  - "operand_offset": one entry per instruction plus one, such that the
+ *    qubit operands of instruction i are at operand_offset[i] up to
+ *    operand_offset[i + 1] in the "operand" column;
+ *  - "operand": the indices of the qubits in the main qubit register that
+ *    each instruction operates on;
+ *  - "block_offset": one entry per block plus one, such that the
+ *    instructions of block i are at block_offset[i] up to block_offset[i + 1]
+ *    in the other columns.
+ *
+ * Structured control-flow statements and their bodies are not included.
+ */
+class Schedule {
+private:
+    friend class Program;
+
+    /**
+     * The names of the instruction types that the type column indexes into.
+     */
+    std::vector<std::string> instruction_types;
+
+    /**
+     * The names of the blocks that the block_offset column delimits.
+     */
+    std::vector<std::string> block_names;
+
+    /**
+     * The columns, as described in the class documentation.
+     */
+    std::vector<std::int64_t> types;
+    std::vector<std::int64_t> cycles;
+    std::vector<std::int64_t> durations;
+    std::vector<std::int64_t> operand_offsets;
+    std::vector<std::int64_t> operands;
+    std::vector<std::int64_t> block_offsets;
+
+    /**
+     * Builds the columns from the given program, usually after compiling it.
+     */
+    explicit Schedule(const ql::ir::Ref &ir);
+
+public:
+
+    /**
+     * Returns the number of instructions in the schedule.
+     */
+    size_t get_num_instructions() const;
+
+    /**
+     * Returns the number of blocks in the schedule.
+     */
+    size_t get_num_blocks() const;
+
+    /**
+     * Returns the names of the instruction types that the "type" column
+     * indexes into.
+     */
+    const std::vector<std::string> &get_instruction_types() const;
+
+    /**
+     * Returns the names of the blocks that the "block_offset" column
+     * delimits.
+     */
+    const std::vector<std::string> &get_block_names() const;
+
+    /**
+     * Returns the names of the available columns.
+     */
+    std::vector<std::string> get_column_names() const;
+
+    /**
+     * Returns the column with the given name. The reference remains valid for
+     * as long as this object exists.
+     */
+    const std::vector<std::int64_t> &get_column(const std::string &name) const;
+
+};
+
+} // namespace api
+} // namespace ql
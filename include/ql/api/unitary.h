@@ -48,6 +48,14 @@ public:
      */
     void decompose();
 
+    /**
+     * Returns an upper bound on the operator norm of the error of the most
+     * recent decomposition of this gate, up to global phase. This is only
+     * nonzero when the unitary_tolerance option allowed rotations to be
+     * dropped.
+     */
+    double get_error_bound() const;
+
     /**
      * Returns whether OpenQL was built with unitary decomposition support
      * enabled.
@@ -17,7 +17,7 @@ namespace vq1asm {
 /**
  * QuTech Central Controller Q1 processor assembly generator pass.
  */
-class GenerateVQ1AsmPass : public pmgr::pass_types::ProgramTransformation {
+class GenerateVQ1AsmPass : public pmgr::pass_types::Transformation {
 protected:
 
     /**
@@ -48,7 +48,7 @@ public:
      * Runs the code generator.
      */
     utils::Int run(
-        const ir::compat::ProgramRef &program,
+        const ir::Ref &ir,
         const pmgr::pass_types::Context &context
     ) const override;
 
@@ -34,6 +34,23 @@ private:
      */
     utils::Map<utils::Str, InfoRef> eqasm_compiler_names = {};
 
+    /**
+     * Tag type for constructing an empty factory.
+     */
+    struct Empty {};
+
+    /**
+     * Constructs an empty architecture factory.
+     */
+    explicit Factory(Empty) {}
+
+    /**
+     * Returns the default architecture factory. The architecture info objects
+     * are stateless, so they are only constructed when this is first called,
+     * and are then shared by all default factories.
+     */
+    static const Factory &get_default();
+
 public:
 
     /**
@@ -7,6 +7,7 @@
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
 #include "ql/ir/compat/compat.h"
 
 namespace ql {
@@ -19,56 +20,140 @@ namespace ana {
 /**
  * Utility for counting the number of two-qubit gates, grouped by their qubit
  * operands.
+ *
+ * The matrix is stored in compressed sparse row (CSR) form, such that its size
+ * is proportional to the number of distinct interacting qubit pairs rather
+ * than to the square of the number of qubits. A dense view can be obtained
+ * using get_dense_matrix() when needed.
  */
 class InteractionMatrix {
-private:
+public:
 
     /**
-     * Shorthand for the matrix type.
+     * Shorthand for the dense matrix type.
      */
     using Matrix = utils::Vec<utils::Vec<utils::UInt>>;
 
+    /**
+     * A nonzero entry of a row of the matrix.
+     */
+    struct Entry {
+
+        /**
+         * The column of the entry, i.e. the qubit interacted with.
+         */
+        utils::UInt qubit;
+
+        /**
+         * The number of interactions.
+         */
+        utils::UInt count;
+
+    };
+
+private:
+
     /**
      * Size of the matrix, i.e. the number of qubits.
      */
-    const utils::UInt size;
+    utils::UInt size;
+
+    /**
+     * For each row, the index of its first entry in entries, followed by the
+     * total number of entries.
+     */
+    utils::Vec<utils::UInt> row_offsets;
 
     /**
-     * Square matrix of unsigned integers, representing the number of two-qubit
-     * gates spanning the indexed qubits. Operand order is not respected; the
-     * matrix is symmetric.
+     * The nonzero entries of all rows, sorted by row and then by column.
      */
-    Matrix matrix;
+    utils::Vec<Entry> entries;
+
+    /**
+     * Returns the qubit operand pairs of the two-qubit gates of the given
+     * kernel that are counted, in both directions.
+     */
+    static utils::Vec<utils::Pair<utils::UInt, utils::UInt>> get_interactions(
+        const ir::compat::KernelRef &kernel
+    );
 
 public:
 
+    /**
+     * Constructs an interaction matrix of the given size, counting each of the
+     * given (row, column) pairs once. The pairs are counted as given, so the
+     * caller is responsible for adding both directions if a symmetric matrix
+     * is desired.
+     */
+    InteractionMatrix(
+        utils::UInt size,
+        const utils::Vec<utils::Pair<utils::UInt, utils::UInt>> &interactions
+    );
+
     /**
      * Computes the interaction matrix for the given kernel.
      */
     InteractionMatrix(const ir::compat::KernelRef &kernel);
 
     /**
-     * Returns the embedded matrix.
+     * Returns the size of the matrix, i.e. the number of qubits.
+     */
+    utils::UInt get_size() const;
+
+    /**
+     * Returns the number of interactions between the given qubits.
      */
-    const Matrix &get_matrix() const;
+    utils::UInt get(utils::UInt qubit1, utils::UInt qubit2) const;
+
+    /**
+     * Returns the nonzero entries of the row for the given qubit, sorted by
+     * column.
+     */
+    utils::Vec<Entry> get_row(utils::UInt qubit) const;
+
+    /**
+     * Returns the number of nonzero entries in the matrix.
+     */
+    utils::UInt get_num_entries() const;
+
+    /**
+     * Returns the matrix in dense form. This uses memory quadratic in the
+     * number of qubits.
+     */
+    Matrix get_dense_matrix() const;
 
     /**
      * Returns the matrix as a string.
      */
     utils::Str get_string() const;
 
+    /**
+     * Returns the matrix as a string with one "<qubit> <qubit> <count>" line
+     * for each nonzero entry.
+     */
+    utils::Str get_sparse_string() const;
+
     /**
      * Constructs interaction matrices for each kernel in the program, and
-     * reports the results to the given output stream.
+     * reports the results to the given output stream. If sparse is set, the
+     * sparse format of get_sparse_string() is used.
      */
-    static void dump_for_program(const ir::compat::ProgramRef &program, std::ostream &os=std::cout);
+    static void dump_for_program(
+        const ir::compat::ProgramRef &program,
+        std::ostream &os=std::cout,
+        utils::Bool sparse=false
+    );
 
     /**
      * Same as dump_for_program(), but writes the result to files in the
      * current globally-configured output directory, using the names
      * "<prefix><kernel>InteractionMatrix.dat".
      */
-    static void write_for_program(const utils::Str &output_prefix, const ir::compat::ProgramRef &program);
+    static void write_for_program(
+        const utils::Str &output_prefix,
+        const ir::compat::ProgramRef &program,
+        utils::Bool sparse=false
+    );
 
 };
 
@@ -3,14 +3,19 @@
  * kernels.
  *
  * Usage is for instance com::metrics::compute<ClassicalOperationCount>(kernel).
+ * When multiple metrics are needed, MetricSet and the compute_*_fused()
+ * functions compute them all using a single traversal of the IR.
  */
 
 #pragma once
 
 #include "ql/utils/num.h"
 #include "ql/utils/map.h"
+#include "ql/utils/vec.h"
 #include "ql/utils/exception.h"
+#include "ql/utils/parallel.h"
 #include "ql/ir/ir.h"
+#include "ql/ir/walker.h"
 
 namespace ql {
 namespace com {
@@ -28,6 +33,15 @@ public:
      */
     using ReturnType = T;
 
+    /**
+     * Whether this metric is computed entirely from process_instruction().
+     * MetricSet relies on this: metrics for which this is true receive every
+     * instruction of the traversal, while the others only get a
+     * process_block() call for the block that the traversal starts from.
+     * Metrics that override process_block() must set this to false.
+     */
+    static constexpr utils::Bool PER_INSTRUCTION = true;
+
     /**
      * Updates the metric using the given instruction. Default implementation
      * throws an unimplemented exception.
@@ -102,6 +116,17 @@ public:
         }
     }
 
+    /**
+     * Updates the metric using the result of the same metric computed
+     * separately for a subsequent top-level block of the program, such that
+     * computing the metric per block and accumulating the results in program
+     * order is equivalent to process_program(). Default implementation throws
+     * an unimplemented exception.
+     */
+    virtual void accumulate(const T &block_result) {
+        throw utils::Exception("metric cannot be accumulated over blocks");
+    }
+
     /**
      * Virtual destructor.
      */
@@ -152,6 +177,187 @@ typename M::ReturnType compute_program(const ir::Ref &ir) {
     return metric.get_result();
 }
 
+/**
+ * Storage for a single metric within a MetricSet.
+ */
+template <class M>
+struct MetricSlot {
+
+    /**
+     * The metric.
+     */
+    M metric{};
+
+};
+
+/**
+ * A set of metrics that is computed using a single traversal of the IR. Every
+ * instruction encountered is dispatched to all metrics for which
+ * PER_INSTRUCTION is set, while the remaining metrics get a single
+ * process_block() call per top-level block. Use get_result<M>() to retrieve
+ * the result for metric M.
+ */
+template <class... Ms>
+class MetricSet : private MetricSlot<Ms>... {
+private:
+
+    /**
+     * Helper for expanding a statement for each metric.
+     */
+    using Expand = int[];
+
+    /**
+     * Dispatches the given instruction to all instruction-based metrics. The
+     * metrics are stored by value, so their dynamic type is known, and their
+     * process_instruction() is called without virtual dispatch.
+     */
+    void visit_instruction(
+        const ir::Ref &ir,
+        const ir::InstructionRef &instruction
+    ) {
+        (void)Expand{0, (
+            Ms::PER_INSTRUCTION
+                ? static_cast<MetricSlot<Ms>&>(*this).metric.Ms::process_instruction(ir, instruction)
+                : void(),
+            0
+        )...};
+    }
+
+    /**
+     * Statically dispatched walker over all instructions in a statement or
+     * block and their sub-blocks. This mirrors Metric::process_statement().
+     */
+    class Walker : public ir::StatementWalker<Walker> {
+    public:
+
+        /**
+         * The set that instructions are dispatched to.
+         */
+        MetricSet &set;
+
+        /**
+         * The IR that the instructions belong to.
+         */
+        const ir::Ref &ir;
+
+        /**
+         * Constructs a walker for the given set.
+         */
+        Walker(MetricSet &set, const ir::Ref &ir) : set(set), ir(ir) {
+        }
+
+        /**
+         * Dispatches an instruction to the metrics.
+         */
+        void on_instruction(const ir::InstructionRef &instruction) {
+            set.visit_instruction(ir, instruction);
+        }
+
+    };
+
+public:
+
+    /**
+     * Updates all metrics using the given statement.
+     */
+    void process_statement(
+        const ir::Ref &ir,
+        const ir::StatementRef &statement
+    ) {
+        Walker(*this, ir).walk_statement(statement);
+    }
+
+    /**
+     * Updates all metrics using the given block.
+     */
+    void process_block(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block
+    ) {
+        (void)Expand{0, (
+            Ms::PER_INSTRUCTION
+                ? void()
+                : static_cast<MetricSlot<Ms>&>(*this).metric.process_block(ir, block),
+            0
+        )...};
+        Walker(*this, ir).walk_block(block);
+    }
+
+    /**
+     * Updates all metrics using the results for a subsequent block.
+     */
+    void accumulate(MetricSet &block_result) {
+        (void)Expand{0, (
+            static_cast<MetricSlot<Ms>&>(*this).metric.accumulate(
+                static_cast<MetricSlot<Ms>&>(block_result).metric.get_result()
+            ),
+            0
+        )...};
+    }
+
+    /**
+     * Updates all metrics using the given program. The top-level blocks are
+     * processed independently using up to num_threads threads (0 means use
+     * all hardware threads), after which the results are accumulated in
+     * program order.
+     */
+    void process_program(
+        const ir::Ref &ir,
+        const ir::ProgramRef &program,
+        utils::UInt num_threads = 1
+    ) {
+        utils::Vec<MetricSet> block_results(program->blocks.size());
+        utils::parallel_for(
+            program->blocks.size(),
+            num_threads,
+            [&](utils::UInt i) {
+                block_results[i].process_block(ir, program->blocks[i]);
+            }
+        );
+        for (auto &block_result : block_results) {
+            accumulate(block_result);
+        }
+    }
+
+    /**
+     * Returns the results gathered thus far for metric M.
+     */
+    template <class M>
+    typename M::ReturnType get_result() {
+        return static_cast<MetricSlot<M>&>(*this).metric.get_result();
+    }
+
+};
+
+/**
+ * Computes the given metrics for the given block using a single traversal.
+ */
+template <class... Ms>
+MetricSet<Ms...> compute_block_fused(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block
+) {
+    MetricSet<Ms...> metrics;
+    metrics.process_block(ir, block);
+    return metrics;
+}
+
+/**
+ * Computes the given metrics for the given program using a single traversal,
+ * processing the top-level blocks using up to num_threads threads.
+ */
+template <class... Ms>
+MetricSet<Ms...> compute_program_fused(
+    const ir::Ref &ir,
+    utils::UInt num_threads = 1
+) {
+    MetricSet<Ms...> metrics;
+    if (!ir->program.empty()) {
+        metrics.process_program(ir, ir->program, num_threads);
+    }
+    return metrics;
+}
+
 /**
  * A metric that just returns a simple C++ primitive value with the given
  * initial value.
@@ -209,6 +415,7 @@ public:
         const ir::Ref &ir,
         const ir::InstructionRef &instruction
     ) override;
+    void accumulate(const utils::UInt &block_result) override;
 };
 
 /**
@@ -220,6 +427,7 @@ public:
         const ir::Ref &ir,
         const ir::InstructionRef &instruction
     ) override;
+    void accumulate(const utils::UInt &block_result) override;
 };
 
 /**
@@ -231,6 +439,7 @@ public:
         const ir::Ref &ir,
         const ir::InstructionRef &instruction
     ) override;
+    void accumulate(const utils::UInt &block_result) override;
 };
 
 /**
@@ -242,6 +451,9 @@ public:
         const ir::Ref &ir,
         const ir::InstructionRef &instruction
     ) override;
+    void accumulate(
+        const utils::SparseMap<utils::UInt, utils::UInt, 0> &block_result
+    ) override;
 };
 
 /**
@@ -253,6 +465,9 @@ public:
         const ir::Ref &ir,
         const ir::InstructionRef &instruction
     ) override;
+    void accumulate(
+        const utils::SparseMap<utils::UInt, utils::UInt, 0> &block_result
+    ) override;
 };
 
 /**
@@ -260,6 +475,8 @@ public:
  */
 class Latency : public SimpleValueMetric<utils::UInt, 0> {
 public:
+    static constexpr utils::Bool PER_INSTRUCTION = false;
+    void accumulate(const utils::UInt &block_result) override;
     void process_block(
         const ir::Ref &ir,
         const ir::BlockBaseRef &block
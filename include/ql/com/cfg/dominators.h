@@ -0,0 +1,43 @@
+/** \file
+ * Defines functions for querying the dominator tree of a control-flow graph.
+ */
+
+#pragma once
+
+#include "ql/com/cfg/types.h"
+
+namespace ql {
+namespace com {
+namespace cfg {
+
+/**
+ * Returns the dominator tree of the control-flow graph of the given program,
+ * which must already exist. The tree is computed on first use and cached on
+ * the graph, until the graph is rebuilt or modified through the functions in
+ * incremental.h.
+ */
+const DominatorTree &get_dominator_tree(const ir::ProgramRef &program);
+
+/**
+ * Returns the immediate dominator of the given block. An empty reference is
+ * returned for the source block and for blocks that are unreachable.
+ */
+ir::BlockRef get_immediate_dominator(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &block
+);
+
+/**
+ * Returns whether block a dominates block b, i.e. whether all paths from the
+ * source to b pass through a. Every reachable block dominates itself.
+ * Unreachable blocks neither dominate nor are dominated by anything.
+ */
+utils::Bool dominates(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &a,
+    const ir::BlockRef &b
+);
+
+} // namespace cfg
+} // namespace com
+} // namespace ql
@@ -0,0 +1,72 @@
+/** \file
+ * Defines functions for updating an existing control-flow graph after local
+ * edits to the program, without rebuilding it.
+ */
+
+#pragma once
+
+#include "ql/com/cfg/types.h"
+
+namespace ql {
+namespace com {
+namespace cfg {
+
+/**
+ * Adds an edge between the two given blocks to the control-flow graph of the
+ * given program, which must already exist. An empty to reference refers to the
+ * sink. Nothing happens if the edge already exists. This only modifies the
+ * graph; the caller is responsible for the goto instruction or next link that
+ * the edge represents.
+ */
+void add_edge(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &from,
+    const ir::BlockRef &to
+);
+
+/**
+ * Removes the edge between the two given blocks from the control-flow graph
+ * of the given program, which must already exist. An empty to reference
+ * refers to the sink. Nothing happens if there is no such edge. This only
+ * modifies the graph; the caller is responsible for removing the goto
+ * instruction or next link that the edge represented.
+ */
+void remove_edge(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &from,
+    const ir::BlockRef &to
+);
+
+/**
+ * Recomputes the outgoing edges of the given block from its goto instructions
+ * and next link, after these have been modified. Only the nodes of the block
+ * and its old and new successors are touched. The block must be in basic
+ * block form. If the block does not have a node yet, one is created.
+ */
+void update_successors(const ir::ProgramRef &program, const ir::BlockRef &block);
+
+/**
+ * Inserts the given block into the given program at the given index (the
+ * number of blocks to append), and adds a node with the outgoing edges of the
+ * block to the control-flow graph, which must already exist. Incoming edges
+ * are added by calling update_successors() for the blocks that were modified
+ * to jump to the new block.
+ */
+void insert_block(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &block,
+    utils::UInt index
+);
+
+/**
+ * Removes the given block from the given program, along with its node and all
+ * edges from and to it. This requires a linear search for the block in the
+ * program, but does not touch the nodes of unrelated blocks. The caller is
+ * responsible for making sure that no goto instruction or next link still
+ * refers to the block, and that it is not the entry point.
+ */
+void remove_block(const ir::ProgramRef &program, const ir::BlockRef &block);
+
+} // namespace cfg
+} // namespace com
+} // namespace ql
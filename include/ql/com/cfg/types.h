@@ -5,7 +5,10 @@
 #pragma once
 
 #include "ql/utils/map.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/opt.h"
 #include "ql/ir/ir.h"
+#include "ql/ir/slots.h"
 
 namespace ql {
 namespace com {
@@ -70,6 +73,38 @@ using NodeRef = utils::Ptr<Node>;
  */
 using NodeCRef = utils::Ptr<const Node>;
 
+/**
+ * The dominator tree of a CFG, rooted at the source block. Only the blocks
+ * reachable from the source are part of the tree.
+ */
+struct DominatorTree {
+
+    /**
+     * The reachable blocks in reverse postorder, starting with the source.
+     */
+    utils::Vec<ir::BlockRef> blocks;
+
+    /**
+     * The index of each reachable block in blocks.
+     */
+    utils::Map<ir::BlockRef, utils::UInt> index;
+
+    /**
+     * For each entry of blocks, the index of its immediate dominator. The
+     * source is its own immediate dominator.
+     */
+    utils::Vec<utils::UInt> idom;
+
+    /**
+     * For each entry of blocks, the preorder and postorder numbers of the
+     * block in a depth-first traversal of the dominator tree, used to check
+     * for dominance in constant time.
+     */
+    utils::Vec<utils::UInt> preorder;
+    utils::Vec<utils::UInt> postorder;
+
+};
+
 /**
  * Annotation structure placed on a program when the CFG is constructed,
  * containing things that need to be tracked for the CFG as a whole.
@@ -87,8 +122,27 @@ struct Graph {
      */
     ir::BlockRef sink;
 
+    /**
+     * The dominator tree of the graph, computed on demand by
+     * get_dominator_tree() and dropped whenever the graph is modified.
+     */
+    utils::Opt<DominatorTree> dominators;
+
 };
 
 } // namespace cfg
 } // namespace com
+
+namespace ir {
+
+/**
+ * CFG nodes are stored in a fixed slot of their block.
+ */
+template <>
+struct AnnotationSlot<com::cfg::NodeRef> {
+    using Owner = BlockBase;
+    static constexpr utils::UInt INDEX = slot::CFG_NODE;
+};
+
+} // namespace ir
 } // namespace ql
@@ -114,12 +114,19 @@ public:
  * such that the absolute value of the weight indicates the minimum number of
  * cycles that must be between the start cycle of the source and destination
  * node in the final schedule, and such that the sign indicates the direction
+ *
+ * If transitive_reduction is set, edges that are implied by a path of two
+ * other edges with at least the same weight are pruned while the graph is
+ * built. This does not change the set of valid schedules, but the causes of
+ * the pruned edges are not recorded. Returns the number of edges in the
+ * resulting graph.
  */
-void build(
+utils::UInt build(
     const ir::Ref &ir,
     const ir::BlockBaseRef &block,
     utils::Bool commute_multi_qubit = true,
-    utils::Bool commute_single_qubit = true
+    utils::Bool commute_single_qubit = true,
+    utils::Bool transitive_reduction = false
 );
 
 } // namespace ddg
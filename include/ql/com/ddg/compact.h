@@ -0,0 +1,213 @@
+/** \file
+ * Defines a compact, contiguous representation of an existing data dependency
+ * graph.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/ptr.h"
+#include "ql/com/ddg/types.h"
+
+namespace ql {
+namespace com {
+namespace ddg {
+
+/**
+ * Compact representation of the data dependency graph of a block, built from
+ * the Node and Edge annotations placed by build(). Rather than a graph of
+ * shared pointers attached to the statements, nodes are identified by a dense
+ * index, and the edges of each node are stored in compressed sparse row (CSR)
+ * form, i.e. as a range of a single array of edge indices delimited by an
+ * offset array. Edge weights and causes are packed into arrays indexed by edge
+ * index.
+ *
+ * The index of a node is the absolute value of its order, so the source of the
+ * forward DDG has index 0, the statements of the block have indices 1 through
+ * the number of statements, and the sink of the forward DDG comes last. The
+ * graph represents the DDG in the direction it was in when the CompactGraph was
+ * constructed, or in the requested direction; i.e., for a reversed DDG,
+ * successors, predecessors, the source and sink, order, and edge weights are
+ * all reversed as well. Because the CSR form stores the edges in both
+ * directions anyway, a graph in the other direction can be made without
+ * reversing the DDG annotations themselves, so the annotations can stay in
+ * forward direction while the block is scheduled ALAP, or even scheduled in
+ * both directions at the same time. The CompactGraph does not track
+ * subsequent changes to the DDG annotations.
+ */
+class CompactGraph {
+public:
+
+    /**
+     * A range of edge indices, as returned by get_successors() and
+     * get_predecessors().
+     */
+    struct EdgeRange {
+
+        /**
+         * Pointer to the first edge index in the range.
+         */
+        const utils::UInt *first;
+
+        /**
+         * Pointer to one past the last edge index in the range.
+         */
+        const utils::UInt *last;
+
+        /**
+         * Iteration support.
+         */
+        const utils::UInt *begin() const { return first; }
+        const utils::UInt *end() const { return last; }
+
+        /**
+         * Returns the number of edges in the range.
+         */
+        utils::UInt size() const { return last - first; }
+
+    };
+
+    /**
+     * The statement for each node, including the source and sink sentinels.
+     */
+    utils::Vec<ir::StatementRef> statements;
+
+    /**
+     * The order of each node, as used for tie-breaking in scheduling
+     * heuristics (see Node::order).
+     */
+    utils::Vec<utils::Int> order;
+
+    /**
+     * Index of the source node in the current direction.
+     */
+    utils::UInt source;
+
+    /**
+     * Index of the sink node in the current direction.
+     */
+    utils::UInt sink;
+
+    /**
+     * The direction of the DDG, 1 for forward or -1 for reversed.
+     */
+    utils::Int direction;
+
+    /**
+     * CSR offsets for the outgoing edges of each node. The outgoing edges of
+     * node i are at successor_edges[successor_offsets[i]] up to but excluding
+     * successor_edges[successor_offsets[i + 1]]. Contains one more entry than
+     * there are nodes.
+     */
+    utils::Vec<utils::UInt> successor_offsets;
+
+    /**
+     * Edge indices of the outgoing edges of all nodes. If the graph is in the
+     * direction of the DDG annotations, the edges of each node appear in the
+     * same order as they do in Node::successors; otherwise they are ordered by
+     * edge index.
+     */
+    utils::Vec<utils::UInt> successor_edges;
+
+    /**
+     * CSR offsets for the incoming edges of each node, analogous to
+     * successor_offsets.
+     */
+    utils::Vec<utils::UInt> predecessor_offsets;
+
+    /**
+     * Edge indices of the incoming edges of all nodes. If the graph is in the
+     * direction of the DDG annotations, the edges of each node appear ordered
+     * by edge index; otherwise in the order of Node::predecessors.
+     */
+    utils::Vec<utils::UInt> predecessor_edges;
+
+    /**
+     * The node index that each edge originates from.
+     */
+    utils::Vec<utils::UInt> edge_predecessor;
+
+    /**
+     * The node index that each edge targets.
+     */
+    utils::Vec<utils::UInt> edge_successor;
+
+    /**
+     * The weight of each edge (see Edge::weight).
+     */
+    utils::Vec<utils::Int> edge_weight;
+
+    /**
+     * CSR offsets into causes for each edge. Contains one more entry than
+     * there are edges.
+     */
+    utils::Vec<utils::UInt> cause_offsets;
+
+    /**
+     * The causes of all edges, packed together.
+     */
+    utils::Vec<Cause> causes;
+
+    /**
+     * Builds the compact representation of the DDG currently attached to the
+     * given block. Throws an exception if no DDG is present.
+     */
+    explicit CompactGraph(const ir::BlockBaseRef &block);
+
+    /**
+     * Builds the compact representation of the DDG currently attached to the
+     * given block in the given direction (1 for forward, -1 for reversed),
+     * regardless of the direction of the DDG annotations, which are left
+     * untouched. Throws an exception if no DDG is present.
+     */
+    CompactGraph(const ir::BlockBaseRef &block, utils::Int direction);
+
+    /**
+     * Returns a copy of this graph in the opposite direction. This is the
+     * same as what com::ddg::reverse() followed by construction of a
+     * CompactGraph would return, except for the order of the edges within the
+     * lists of each node, but without modifying the DDG annotations.
+     */
+    CompactGraph reversed() const;
+
+    /**
+     * Reverses the direction of this graph in place.
+     */
+    void reverse();
+
+    /**
+     * Returns the number of nodes in the graph, including the source and sink.
+     */
+    utils::UInt get_num_nodes() const;
+
+    /**
+     * Returns the number of edges in the graph.
+     */
+    utils::UInt get_num_edges() const;
+
+    /**
+     * Returns the node index of the given statement.
+     */
+    static utils::UInt get_index(const ir::StatementRef &statement);
+
+    /**
+     * Returns the indices of the outgoing edges of the given node.
+     */
+    EdgeRange get_successors(utils::UInt node) const;
+
+    /**
+     * Returns the indices of the incoming edges of the given node.
+     */
+    EdgeRange get_predecessors(utils::UInt node) const;
+
+};
+
+/**
+ * Shared reference to a compact DDG.
+ */
+using CompactGraphCRef = utils::Ptr<const CompactGraph>;
+
+} // namespace ddg
+} // namespace com
+} // namespace ql
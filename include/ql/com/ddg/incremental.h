@@ -0,0 +1,70 @@
+/** \file
+ * Defines functions for patching an existing data dependency graph after
+ * local edits to its block, without rebuilding it.
+ */
+
+#pragma once
+
+#include "ql/com/ddg/types.h"
+
+namespace ql {
+namespace com {
+namespace ddg {
+
+/**
+ * Inserts the given statement into the given block at the given index (0 to
+ * insert in front of all statements, the number of statements to append), and
+ * adds a node and the necessary edges for it to the data dependency graph of
+ * the block, which must already exist. The graph may be in either direction.
+ * commute_multi_qubit and commute_single_qubit must be set the same way as
+ * they were for build().
+ *
+ * The dependencies of the new statement are found by scanning the block
+ * backward and forward from the insertion point, until each object accessed
+ * by the statement is written by an earlier/later statement (at the latest
+ * the source/sink). Thus, only the statements near the insertion point that
+ * touch the same objects are visited in the common case. The order of the
+ * nodes following the insertion point is updated accordingly. Edges between
+ * existing statements are not modified; an edge that would not be needed
+ * anymore now that the new statement orders its endpoints transitively is
+ * redundant, but harmless.
+ */
+void insert_statement(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::UInt index,
+    const ir::StatementRef &statement,
+    utils::Bool commute_multi_qubit = true,
+    utils::Bool commute_single_qubit = true
+);
+
+/**
+ * Removes the given statement from the given block, along with its node in the
+ * data dependency graph, which must already exist. The graph may be in either
+ * direction. To preserve the ordering of the remaining statements, an edge is
+ * added from every predecessor to every successor of the removed node, using
+ * the weight and causes of the incoming edge. This is conservative: the
+ * resulting graph may be more constrained than the graph build() would
+ * construct for the modified block, so use build() instead if that matters.
+ */
+void remove_statement(
+    const ir::BlockBaseRef &block,
+    const ir::StatementRef &statement
+);
+
+/**
+ * Ensures that the given statement is scheduled at least the given number of
+ * cycles after the start of the block by adding (or strengthening) a
+ * dependency on the source of the forward data dependency graph, which must
+ * already exist. The graph may be in either direction. This is used to
+ * express dependencies on statements outside of the block.
+ */
+void constrain_start(
+    const ir::BlockBaseRef &block,
+    const ir::StatementRef &statement,
+    utils::UInt min_cycle
+);
+
+} // namespace ddg
+} // namespace com
+} // namespace ql
@@ -5,7 +5,9 @@
 #pragma once
 
 #include "ql/utils/map.h"
+#include "ql/utils/ptr.h"
 #include "ql/ir/ir.h"
+#include "ql/ir/slots.h"
 
 namespace ql {
 namespace com {
@@ -357,9 +359,10 @@ using EdgeCRef = utils::Ptr<const Edge>;
 using Endpoints = utils::Map<ir::StatementRef, EdgeRef>;
 
 /**
- * A node in the DDG.
+ * A node in the DDG. These are referenced intrusively, as node references are
+ * copied around a lot while the DDG is being built.
  */
-struct Node {
+struct Node : utils::RefCounted {
 
     /**
      * The endpoints of the incoming edges for this node.
@@ -387,12 +390,12 @@ struct Node {
 /**
  * A reference to a DDG node. This is attached to statements via an annotation.
  */
-using NodeRef = utils::Ptr<Node>;
+using NodeRef = utils::IntrusivePtr<Node>;
 
 /**
  * A const reference to a DDG node.
  */
-using NodeCRef = utils::Ptr<const Node>;
+using NodeCRef = utils::IntrusivePtr<const Node>;
 
 /**
  * Annotation structure placed on a block when the DDG is constructed,
@@ -425,4 +428,26 @@ struct Graph {
 
 } // namespace ddg
 } // namespace com
+
+namespace ir {
+
+/**
+ * DDG nodes are stored in a fixed slot of their statement.
+ */
+template <>
+struct AnnotationSlot<com::ddg::NodeRef> {
+    using Owner = Statement;
+    static constexpr utils::UInt INDEX = slot::DDG_NODE;
+};
+
+/**
+ * DDG graph data is stored in a fixed slot of its block.
+ */
+template <>
+struct AnnotationSlot<com::ddg::Graph> {
+    using Owner = BlockBase;
+    static constexpr utils::UInt INDEX = slot::DDG_GRAPH;
+};
+
+} // namespace ir
 } // namespace ql
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <deque>
+#include <unordered_map>
 #include "ql/ir/ir.h"
 
 namespace ql {
@@ -15,6 +17,82 @@ namespace dec {
  */
 using RulePredicate = std::function<utils::Bool(const ir::DecompositionRef&)>;
 
+/**
+ * A decomposition rule preprocessed for expansion. The parameters and
+ * temporary objects of the rule are indexed, such that references to them in
+ * the expansion can be substituted with a single hash lookup.
+ */
+struct CompiledDecompositionRule {
+
+    /**
+     * The decomposition rule.
+     */
+    const ir::InstructionDecomposition *rule;
+
+    /**
+     * Index of each of the parameters of the decomposition rule, i.e. the
+     * operand of the instruction that references to it must be replaced with.
+     */
+    std::unordered_map<const ir::Object*, utils::UInt> parameter_index;
+
+    /**
+     * Index of each of the temporary objects declared by the decomposition
+     * rule.
+     */
+    std::unordered_map<const ir::Object*, utils::UInt> object_index;
+
+    /**
+     * Preprocesses the given decomposition rule.
+     */
+    explicit CompiledDecompositionRule(const ir::InstructionDecomposition &rule);
+
+};
+
+/**
+ * Table of the decomposition rules that should be applied to instructions of
+ * each instruction type, i.e. the first rule that matches the predicate, if
+ * any. Entries are computed the first time an instruction type is looked up,
+ * such that the predicate only needs to be evaluated once for each rule, and
+ * instructions without a matching rule only cost a hash lookup. The table is
+ * only valid as long as the platform is not modified.
+ */
+class DecompositionRuleTable {
+private:
+
+    /**
+     * The predicate that rules must match.
+     */
+    RulePredicate predicate;
+
+    /**
+     * Storage for the compiled rules. This is a deque so pointers to the
+     * elements remain valid as rules are added.
+     */
+    std::deque<CompiledDecompositionRule> compiled;
+
+    /**
+     * The rule to apply for each instruction type seen so far, or nullptr if
+     * no rule applies.
+     */
+    std::unordered_map<const ir::InstructionType*, const CompiledDecompositionRule*> rules;
+
+public:
+
+    /**
+     * Constructs a table for the rules that match the given predicate.
+     */
+    explicit DecompositionRuleTable(
+        const RulePredicate &predicate = [](const ir::DecompositionRef&){ return true; }
+    );
+
+    /**
+     * Returns the rule that should be applied to instructions of the given
+     * type, or nullptr if there is none.
+     */
+    const CompiledDecompositionRule *find(const ir::InstructionType &instruction_type);
+
+};
+
 /**
  * Recursively applies all available decomposition rules (that match the
  * predicate, if given) to the given block. Sub-blocks are not considered; in
@@ -33,6 +111,17 @@ utils::UInt apply_decomposition_rules(
     const RulePredicate &predicate = [](const ir::DecompositionRef&){ return true; }
 );
 
+/**
+ * Same as above, but takes the rules to apply from the given table, such that
+ * it can be reused for multiple blocks.
+ */
+utils::UInt apply_decomposition_rules(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::Bool ignore_schedule,
+    DecompositionRuleTable &table
+);
+
 } // namespace dec
 } // namespace com
 } // namespace ql
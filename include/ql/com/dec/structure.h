@@ -26,10 +26,17 @@ namespace dec {
  *
  * If check is set, a consistency and basic-block form check is done before
  * returning the created program. This is also done if debugging is enabled via
- * the loglevel.
+ * the loglevel. The thoroughness of the consistency check is controlled by the
+ * `ir_consistency_check` global option.
  */
 ir::ProgramRef decompose_structure(const ir::Ref &ir, utils::Bool check = false);
 
+/**
+ * Returns whether the given block is in basic block form, as defined by
+ * decompose_structure(). Assumes that the block is otherwise consistent.
+ */
+utils::Bool is_in_basic_block_form(const ir::BlockRef &block);
+
 /**
  * Returns whether the given program is in basic block form, as defined by
  * decompose_structure(). Assumes that the program is otherwise consistent.
@@ -37,6 +37,11 @@ private:
      */
     utils::Vec<utils::Real> instruction_list;
 
+    /**
+     * Error bound of the most recently returned decomposition.
+     */
+    utils::Real error_bound;
+
 public:
 
     /**
@@ -59,6 +64,14 @@ public:
      */
     utils::UInt size() const;
 
+    /**
+     * Returns an upper bound on the operator norm of the difference between
+     * the most recently returned decomposition and the exact one, up to
+     * global phase. This is nonzero only when rotations were dropped due to
+     * the unitary_tolerance option.
+     */
+    utils::Real get_error_bound() const;
+
     /**
      * Explicitly runs the matrix decomposition algorithm. Used to be required,
      * nowadays is called implicitly by get_decomposition() if not done explicitly.
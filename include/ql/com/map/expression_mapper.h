@@ -5,66 +5,220 @@
 #pragma once
 
 #include "ql/ir/ir.h"
+#include "ql/ir/dispatch.h"
 
 namespace ql {
 namespace com {
 namespace map {
 
 /**
- * Class for implementing map operations on expressions or references. While not
- * an abstract class, this must be subclassed to be useful; either or both of
- * on_expression() and on_reference() must be overridden with the desired map
- * operation.
+ * CRTP base class for implementing map operations on expressions or
+ * references, with the handlers dispatched statically. Derived may define
+ *
+ *     utils::Bool on_expression(utils::Maybe<ir::Expression> &expr);
+ *     utils::Bool on_reference(utils::Maybe<ir::Reference> &ref);
+ *
+ * with the semantics described for ExpressionMapper; these must be accessible
+ * to this class. Use this rather than ExpressionMapper for mappers that are
+ * applied to large parts of a program.
  */
-class ExpressionMapper {
-protected:
+template <class Derived>
+class StaticExpressionMapper {
+private:
 
     /**
-     * Called when an expression of any kind is encountered in the tree. The
-     * subtree formed by the expression will already have been processed (i.e.
-     * traversal is depth-first.) The method may assign the Maybe edge to
-     * change the complete expression (including its node type), or may change
-     * the contents of the expression. If the method returns true, the subtree
-     * formed by the new expression will be processed as well. The default
-     * implementation calls on_reference() if the expression is a reference.
+     * Returns a reference to the derived class.
      */
-    virtual utils::Bool on_expression(utils::Maybe<ir::Expression> &expr);
+    Derived &derived() {
+        return static_cast<Derived&>(*this);
+    }
 
     /**
-     * Like on_expression(), but called for edges that must always be a
-     * reference of some kind. The default implementation is no-op and just
-     * returns false.
+     * Handles visiting an expression subtree before or after on_expression()
+     * is called by the callee.
      */
-    virtual utils::Bool on_reference(utils::Maybe<ir::Reference> &ref);
+    void recurse_into_expression(const ir::ExpressionRef &expression) {
+        ir::dispatch_expression(*expression, VisitExpression{*this});
+    }
 
-private:
+    /**
+     * Handler for dispatch_expression(); only function calls have
+     * subexpressions.
+     */
+    struct VisitExpression {
+        StaticExpressionMapper &mapper;
+
+        void operator()(ir::FunctionCall &func) {
+            for (auto &operand : func.operands) {
+                mapper.process_expression(operand);
+            }
+        }
+
+        void operator()(ir::Expression &) {
+            // nothing to do
+        }
+    };
 
     /**
-     * Handles visiting an expression subtree before or after on_expression()
-     * is called by the callee.
+     * Handler for dispatch_statement().
      */
-    void recurse_into_expression(const ir::ExpressionRef &expression);
+    struct VisitStatement {
+        StaticExpressionMapper &mapper;
+
+        void operator()(ir::CustomInstruction &custom_insn) {
+            mapper.process_expression(custom_insn.condition);
+            for (auto &operand : custom_insn.operands) {
+                mapper.process_expression(operand);
+            }
+        }
+
+        void operator()(ir::SetInstruction &set_insn) {
+            mapper.process_expression(set_insn.condition);
+            mapper.derived().on_reference(set_insn.lhs);
+            mapper.process_expression(set_insn.rhs);
+        }
+
+        void operator()(ir::GotoInstruction &goto_insn) {
+            mapper.process_expression(goto_insn.condition);
+        }
+
+        void operator()(ir::WaitInstruction &wait_insn) {
+            for (auto &reference : wait_insn.objects) {
+                mapper.derived().on_reference(reference);
+            }
+        }
+
+        void operator()(ir::IfElse &if_else) {
+            for (const auto &branch : if_else.branches) {
+                mapper.process_expression(branch->condition);
+                mapper.process_block(branch->body);
+            }
+            if (!if_else.otherwise.empty()) {
+                mapper.process_block(if_else.otherwise);
+            }
+        }
+
+        void operator()(ir::StaticLoop &static_loop) {
+            mapper.process_block(static_loop.body);
+            mapper.derived().on_reference(static_loop.lhs);
+        }
+
+        void operator()(ir::ForLoop &for_loop) {
+            mapper.process_block(for_loop.body);
+            mapper.process_expression(for_loop.condition);
+            if (!for_loop.initialize.empty()) {
+                mapper.process_statement(for_loop.initialize);
+            }
+            if (!for_loop.update.empty()) {
+                mapper.process_statement(for_loop.update);
+            }
+        }
+
+        void operator()(ir::RepeatUntilLoop &repeat_until) {
+            mapper.process_block(repeat_until.body);
+            mapper.process_expression(repeat_until.condition);
+        }
+
+        void operator()(ir::LoopControlStatement &) {
+            // no expressions here
+        }
+
+        void operator()(ir::SentinelStatement &) {
+            QL_ASSERT(false);
+        }
+    };
 
 public:
 
+    /**
+     * Default expression handler, which calls on_reference() if the
+     * expression is a reference.
+     */
+    utils::Bool on_expression(utils::Maybe<ir::Expression> &expr) {
+        auto ref = expr.as<ir::Reference>();
+        if (!ref.empty() && derived().on_reference(ref)) {
+            expr = ref;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * Default reference handler, which is no-op and just returns false.
+     */
+    utils::Bool on_reference(utils::Maybe<ir::Reference> &ref) {
+        (void)ref;
+        return false;
+    }
+
     /**
      * Visits an expression. This processes the subtree formed by the expression
      * depth-first, then calls on_expression(), and if that returns true
      * processes the new subtree depth-first.
      */
-    void process_expression(utils::Maybe<ir::Expression> &expression);
+    void process_expression(utils::Maybe<ir::Expression> &expression) {
+        recurse_into_expression(expression);
+        if (derived().on_expression(expression)) {
+            recurse_into_expression(expression);
+        }
+    }
 
     /**
      * Visits a statement. on_expression()/on_reference() will be called for
      * all expression/reference edges found in the statement, depth-first.
      */
-    void process_statement(const ir::StatementRef &statement);
+    void process_statement(const ir::StatementRef &statement) {
+        ir::dispatch_statement(*statement, VisitStatement{*this});
+    }
 
     /**
      * Visits a block. on_expression()/on_reference() will be called for
      * all expression/reference edges found in the block, depth-first.
      */
-    void process_block(const ir::BlockBaseRef &block);
+    void process_block(const ir::BlockBaseRef &block) {
+        for (const auto &stmt : block->statements) {
+            process_statement(stmt);
+        }
+    }
+
+};
+
+/**
+ * Class for implementing map operations on expressions or references. While not
+ * an abstract class, this must be subclassed to be useful; either or both of
+ * on_expression() and on_reference() must be overridden with the desired map
+ * operation. This costs a virtual call per edge; StaticExpressionMapper
+ * provides the same traversal with statically dispatched handlers.
+ */
+class ExpressionMapper : public StaticExpressionMapper<ExpressionMapper> {
+protected:
+
+    friend class StaticExpressionMapper<ExpressionMapper>;
+
+    /**
+     * Called when an expression of any kind is encountered in the tree. The
+     * subtree formed by the expression will already have been processed (i.e.
+     * traversal is depth-first.) The method may assign the Maybe edge to
+     * change the complete expression (including its node type), or may change
+     * the contents of the expression. If the method returns true, the subtree
+     * formed by the new expression will be processed as well. The default
+     * implementation calls on_reference() if the expression is a reference.
+     */
+    virtual utils::Bool on_expression(utils::Maybe<ir::Expression> &expr);
+
+    /**
+     * Like on_expression(), but called for edges that must always be a
+     * reference of some kind. The default implementation is no-op and just
+     * returns false.
+     */
+    virtual utils::Bool on_reference(utils::Maybe<ir::Reference> &ref);
+
+public:
+
+    /**
+     * Virtual destructor.
+     */
+    virtual ~ExpressionMapper() = default;
 
 };
 
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
@@ -49,6 +50,10 @@ std::ostream &operator<<(std::ostream &os, QubitState qs);
 /**
  * Virtual to real qubit mapping. Maintains the mapping (in both directions), as
  * well as information about whether the state of a real qubit is in use or not.
+ * The backward map and the set of free real qubits are updated incrementally,
+ * so looking up the virtual qubit for a real qubit takes constant time, and
+ * allocating a real qubit takes time proportional to the number of qubits
+ * divided by 64.
  */
 class QubitMapping {
 private:
@@ -63,6 +68,28 @@ private:
      */
     utils::Vec<utils::UInt> virt_to_real;
 
+    /**
+     * Maps real qubit indices to virtual qubit indices or UNDEFINED_QUBIT,
+     * i.e. the inverse of virt_to_real.
+     */
+    utils::Vec<utils::UInt> real_to_virt;
+
+    /**
+     * Bitset of the real qubits that have no virtual qubit mapped to them.
+     * Bit i of word j represents real qubit 64*j + i.
+     */
+    utils::Vec<std::uint64_t> free_reals;
+
+    /**
+     * Updates real_to_virt and free_reals for the given real qubit.
+     */
+    void set_virtual(utils::UInt real, utils::UInt virt);
+
+    /**
+     * Rebuilds real_to_virt and free_reals from virt_to_real.
+     */
+    void rebuild_backward_map();
+
     /**
      * Maps real qubit indices to their state.
      */
@@ -99,12 +126,21 @@ public:
     /**
      * Map virtual qubit index to real qubit index.
      */
-    utils::UInt &operator[](utils::UInt v);
+    const utils::UInt &operator[](utils::UInt v) const;
 
     /**
-     * Map virtual qubit index to real qubit index.
+     * Maps the given virtual qubit to the given real qubit, or unmaps it if
+     * real is UNDEFINED_QUBIT. The real qubit must not be mapped to another
+     * virtual qubit.
      */
-    const utils::UInt &operator[](utils::UInt v) const;
+    void set_real(utils::UInt virt, utils::UInt real);
+
+    /**
+     * Replaces the complete virtual to real qubit map. The vector must have
+     * one entry per qubit, and no two virtual qubits may map to the same real
+     * qubit. The real qubit states are not affected.
+     */
+    void set_virt_to_real(const utils::Vec<utils::UInt> &v2r);
 
     /**
      * Returns the underlying virtual to real qubit vector.
@@ -113,8 +149,7 @@ public:
 
     /**
      * Map real qubit to the virtual qubit index that is mapped to it (i.e.
-     * backward map). When none, return UNDEFINED_QUBIT. This currently loops
-     * over all qubits, so it isn't particularly fast.
+     * backward map). When none, return UNDEFINED_QUBIT.
      */
     utils::UInt get_virtual(utils::UInt real) const;
 
@@ -134,7 +169,8 @@ public:
     const utils::Vec<QubitState> &get_state() const;
 
     /**
-     * Allocate a real qubit for the given unmapped virtual qubit.
+     * Allocate a real qubit for the given unmapped virtual qubit. This is
+     * always the lowest-indexed real qubit that isn't mapped yet.
      */
     utils::UInt allocate(utils::UInt virt);
 
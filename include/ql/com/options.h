@@ -21,6 +21,55 @@ utils::Options make_ql_options();
  */
 QL_GLOBAL extern utils::Options global;
 
+/**
+ * The ways in which Kernel.toffoli() can handle controlled CNOT gates, as
+ * selected by the decompose_toffoli option.
+ */
+enum class ToffoliDecomposition {
+
+    /**
+     * Insert the Toffoli gate as-is.
+     */
+    NONE,
+
+    /**
+     * Decompose using the NC substitution.
+     */
+    NC,
+
+    /**
+     * Decompose using the AM substitution.
+     */
+    AM
+
+};
+
+/**
+ * Typed values of the global options that are consulted on hot paths, such
+ * as for every gate added to a kernel. These are updated by option callbacks
+ * whenever the options change, so reading them does not involve a
+ * string-keyed lookup. Like the options themselves, they must not be changed
+ * while the options are frozen.
+ */
+struct CachedOptions {
+
+    /**
+     * Value of the use_default_gates option.
+     */
+    utils::Bool use_default_gates;
+
+    /**
+     * Value of the decompose_toffoli option.
+     */
+    ToffoliDecomposition decompose_toffoli;
+
+};
+
+/**
+ * Returns the typed values of the hot global options.
+ */
+const CachedOptions &get_cached();
+
 /**
  * Convenience function for getting an option value as a string from the global
  * options record.
@@ -29,10 +78,45 @@ const utils::Str &get(const utils::Str &key);
 
 /**
  * Convenience function for setting an option value for the global options
- * record.
+ * record. Throws an exception if the global options are currently frozen.
  */
 void set(const utils::Str &key, const utils::Str &value);
 
+/**
+ * Returns whether the global options are currently frozen, i.e. whether at
+ * least one Freeze object exists.
+ */
+utils::Bool is_frozen();
+
+/**
+ * Throws an exception if the global options are currently frozen.
+ */
+void check_not_frozen();
+
+/**
+ * RAII object that freezes the global options for as long as it exists, such
+ * that set() throws rather than modifying them. Passes read the global options
+ * (and the log level derived from them) without any synchronization, so this
+ * is used while multiple programs are being compiled concurrently.
+ */
+class Freeze {
+public:
+
+    /**
+     * Freezes the global options.
+     */
+    Freeze();
+
+    /**
+     * Unfreezes the global options, unless other Freeze objects still exist.
+     */
+    ~Freeze();
+
+    Freeze(const Freeze &) = delete;
+    Freeze &operator=(const Freeze &) = delete;
+
+};
+
 } // namespace options
 } // namespace com
 } // namespace ql
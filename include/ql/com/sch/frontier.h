@@ -0,0 +1,46 @@
+/** \file
+ * Defines a linear-time ASAP/ALAP scheduler without resource constraints that
+ * does not need a data dependency graph.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace com {
+namespace sch {
+
+/**
+ * Schedules the statements of the given block as soon as possible (direction
+ * 1) or as late as possible (direction -1) without resource constraints, and
+ * sorts them by cycle, with cycle numbers starting at zero. The result is
+ * identical to building the data dependency graph for the block using the same
+ * commutation rules and running the Scheduler on it with no resources,
+ * followed by Scheduler::convert_cycles().
+ *
+ * Instead of building the graph, the block is scanned once (in reverse order
+ * for ALAP), while a frontier is maintained for each object: the bound imposed
+ * by the statements before the current group of mutually commuting accesses,
+ * and the bound imposed by that group itself. An incoming access that commutes
+ * with the group joins it and is only bound by the former; any other access
+ * is bound by both and starts a new group.
+ *
+ * Only references to qubits, their implicit bits, scalar objects, and fully
+ * indexed elements of other objects can be tracked this way. If the block
+ * contains any other reference, for example an array element accessed with a
+ * dynamic index, false is returned and the block is left unchanged, such that
+ * the caller can fall back to the graph-based scheduler.
+ */
+utils::Bool schedule_without_resources(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::Int direction,
+    utils::Bool commute_multi_qubit = true,
+    utils::Bool commute_single_qubit = true
+);
+
+} // namespace sch
+} // namespace com
+} // namespace ql
@@ -1,18 +1,24 @@
 /** \file
  * Defines basic criticality heuristics for the list scheduler.
  *
- * Heuristic classes must consist of two operator() overloads:
+ * Heuristic classes must consist of two operator() overloads and a key
+ * function:
  *
- *  - `Bool operator()(const StatementRef &lhs, const StatementRef &rhs) const`
- *    and
- *  - `Str operator()(const StatementRef &val) const`
+ *  - `Bool operator()(const StatementRef &lhs, const StatementRef &rhs) const`,
+ *  - `Str operator()(const StatementRef &val) const`, and
+ *  - `UInt get_key(const StatementRef &val) const`.
  *
- * The former implements a standard less-than comparator for the criticality of
- * the two given statements. This is what's used to actually order the list of
- * available instructions.
+ * The first implements a standard less-than comparator for the criticality of
+ * the two given statements.
  *
- * The latter is just used for debugging. It should return a string
+ * The second is just used for debugging. It should return a string
  * representation of the criticality of the given statement.
+ *
+ * The key function returns an integer that orders statements the same way as
+ * the comparator, with higher keys being more critical. This is what's used to
+ * actually order the list of available instructions: the scheduler computes
+ * the key of a statement once when the statement becomes available, so the
+ * key must not change while the statement is available.
  */
 
 #pragma once
@@ -20,6 +26,8 @@
 #include "ql/utils/num.h"
 #include "ql/utils/set.h"
 #include "ql/ir/ir.h"
+#include "ql/ir/slots.h"
+#include "ql/com/ddg/compact.h"
 
 namespace ql {
 namespace com {
@@ -31,6 +39,7 @@ namespace sch {
 struct TrivialHeuristic {
     utils::Bool operator()(const ir::StatementRef &lhs, const ir::StatementRef &rhs) const;
     utils::Str operator()(const ir::StatementRef &val) const;
+    utils::UInt get_key(const ir::StatementRef &val) const;
 };
 
 /**
@@ -48,6 +57,7 @@ struct TrivialHeuristic {
 struct CriticalPathHeuristic {
     utils::Bool operator()(const ir::StatementRef &lhs, const ir::StatementRef &rhs) const;
     utils::Str operator()(const ir::StatementRef &val) const;
+    utils::UInt get_key(const ir::StatementRef &val) const;
 };
 
 /**
@@ -80,6 +90,15 @@ public:
      */
     ir::StatementRef most_critical_dependent;
 
+    /**
+     * Dense rank of this node w.r.t. deep criticality, computed by compute().
+     * Comparing the ranks of two nodes gives the same result as recursively
+     * comparing critical_path_length down the chains of most critical
+     * dependents, but in constant time. Nodes with equal deep criticality
+     * have equal rank. Rank 0 is reserved for nodes without annotation.
+     */
+    utils::UInt rank = 0;
+
     /**
      * Returns the Criticality annotation for the given statement, or returns
      * zero criticality if no statement exist.
@@ -87,7 +106,8 @@ public:
     static const DeepCriticality &get(const ir::StatementRef &statement);
 
     /**
-     * Compares the criticality of two Criticality annotations.
+     * Compares the criticality of two Criticality annotations by means of their
+     * rank.
      */
     utils::Bool operator<(const DeepCriticality &other) const;
 
@@ -96,21 +116,6 @@ public:
      */
     friend std::ostream &operator<<(std::ostream &os, const DeepCriticality &dc);
 
-private:
-
-    /**
-     * Ensures that a valid criticality annotation exists for the given
-     * statement. This will recursively ensure that dependent statements are
-     * annotated, because this is needed to compute which of the dependent
-     * statements is the most critical for deep criticality. The set tracks
-     * which statements have valid annotations (there may be stray annotations
-     * from previous scheduling operations that we must be sure to override).
-     */
-    static void ensure_annotation(
-        const ir::StatementRef &statement,
-        utils::Set<ir::StatementRef> &annotated
-    );
-
 public:
 
     /**
@@ -123,6 +128,12 @@ public:
      */
     static void compute(const ir::SubBlockRef &block);
 
+    /**
+     * Same as compute(block), but uses the given, previously constructed
+     * compact form of the data dependency graph of the block.
+     */
+    static void compute(const ir::SubBlockRef &block, const com::ddg::CompactGraph &graph);
+
     /**
      * Compares the criticality of two statements by means of their Criticality
      * annotation.
@@ -130,6 +141,7 @@ public:
     struct Heuristic {
         utils::Bool operator()(const ir::StatementRef &lhs, const ir::StatementRef &rhs) const;
         utils::Str operator()(const ir::StatementRef &val) const;
+        utils::UInt get_key(const ir::StatementRef &val) const;
     };
 
     /**
@@ -139,6 +151,37 @@ public:
 
 };
 
+/**
+ * Adds the given feedback latency in cycles to the weights of the edges of the
+ * given compact data dependency graph that carry a classical feedback
+ * dependency, i.e. where the (forward) dependent statement is a conditional
+ * instruction whose condition reads the object that caused the dependency,
+ * usually the bit written by a measurement. Scheduling the statements
+ * according to the resulting graph doesn't respect the actual timing
+ * constraints of the statements, but pre-scheduling with it yields
+ * critical path lengths that include the feedback latency, such that
+ * criticality-based heuristics hoist the measurements and fill the feedback
+ * gap with independent work. The graph may be in either direction.
+ */
+void add_feedback_latency(
+    const ir::Ref &ir,
+    com::ddg::CompactGraph &graph,
+    utils::UInt latency
+);
+
 } // namespace sch
 } // namespace com
+
+namespace ir {
+
+/**
+ * Deep criticality is stored in a fixed slot of its statement.
+ */
+template <>
+struct AnnotationSlot<com::sch::DeepCriticality> {
+    using Owner = Statement;
+    static constexpr utils::UInt INDEX = slot::DEEP_CRITICALITY;
+};
+
+} // namespace ir
 } // namespace ql
@@ -5,13 +5,19 @@
 
 #pragma once
 
+#include <algorithm>
 #include "ql/utils/num.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/list.h"
 #include "ql/utils/opt.h"
+#include "ql/utils/trace.h"
 #include "ql/ir/ir.h"
 #include "ql/ir/describe.h"
 #include "ql/com/ddg/ops.h"
+#include "ql/com/ddg/compact.h"
 #include "ql/com/sch/heuristics.h"
 #include "ql/rmgr/manager.h"
+#include "ql/rmgr/static_state.h"
 
 namespace ql {
 namespace com {
@@ -38,30 +44,70 @@ namespace sch {
  * try_schedule(), advance(), and is_done() to override the criticality metric.
  * The Scheduler object can also be cloned, to implement backtracking
  * algorithms.
+ *
+ * Internally, the scheduler operates on the compact form of the data dependency
+ * graph (com::ddg::CompactGraph), and readiness is tracked using per-node
+ * counters of unscheduled predecessors, so scheduling a statement only costs
+ * time proportional to its number of successors. Available statements are kept
+ * in a binary heap, and statements that become available in a later cycle are
+ * kept in a calendar queue indexed by cycle number.
+ *
+ * The resource state is of type ResourceState, which is rmgr::State by
+ * default. When the types of the resources in use are known, an
+ * rmgr::StaticState for those types can be used instead, which avoids virtual
+ * calls into the resources for every probe. The resource state returned by
+ * the resource manager is then converted when the scheduler is constructed.
  */
-template <typename HeuristicComparator = TrivialHeuristic>
+template <
+    typename HeuristicComparator = TrivialHeuristic,
+    typename ResourceState = rmgr::State
+>
 class Scheduler {
 
     /**
-     * Criticality comparator for the availability list/set. The most critical
-     * statement will end up in the front, so set iteration starts with the most
-     * critical instruction. This uses the heuristic provided as template
-     * argument to the surrounding function, and falls back on the original
-     * statement order as recorded when the DDG was constructed for stability.
+     * Criticality comparator for the availability list, operating on compact
+     * graph node indices. The most critical statement will end up in the
+     * front. This uses the keys computed by the heuristic provided as template
+     * argument to the surrounding class when the statements became available,
+     * and falls back on the original statement order as recorded when the DDG
+     * was constructed for stability.
      */
     struct AvailableListComparator {
-        utils::Bool operator()(const ir::StatementRef &lhs, const ir::StatementRef &rhs) const {
+        const utils::Vec<utils::UInt> &keys;
+        const utils::Vec<utils::Int> &order;
+
+        AvailableListComparator(
+            const utils::Vec<utils::UInt> &keys,
+            const com::ddg::CompactGraph &graph
+        ) : keys(keys), order(graph.order) {}
 
-            // The heuristic implements "criticality less than," which would
-            // result in reverse order, so we swap the value here.
-            HeuristicComparator heuristic;
-            if (heuristic(rhs, lhs)) return true;
-            if (heuristic(lhs, rhs)) return false;
+        utils::Bool operator()(utils::UInt lhs, utils::UInt rhs) const {
+
+            // Higher keys are more critical, and should come first.
+            if (keys[lhs] != keys[rhs]) return keys[lhs] > keys[rhs];
 
             // If the heuristic says both RHS and LHS are equal, fall back to
             // the original statement order.
-            return com::ddg::get_node(lhs)->order < com::ddg::get_node(rhs)->order;
+            return order[lhs] < order[rhs];
+
+        }
+    };
+
+    /**
+     * Heap comparator for the availability heap, based on
+     * AvailableListComparator such that the most critical statement is at the
+     * front of the heap.
+     */
+    struct HeapComparator {
+        AvailableListComparator comparator;
+
+        HeapComparator(
+            const utils::Vec<utils::UInt> &keys,
+            const com::ddg::CompactGraph &graph
+        ) : comparator(keys, graph) {}
 
+        utils::Bool operator()(utils::UInt lhs, utils::UInt rhs) const {
+            return comparator(rhs, lhs);
         }
     };
 
@@ -80,18 +126,6 @@ class Scheduler {
         return abs_lt(a, b) ? b : a;
     }
 
-    /**
-     * Comparator based on the abs_lt() function.
-     */
-    struct AbsoluteComparator {
-        utils::Bool operator()(
-            const utils::Int &lhs,
-            const utils::Int &rhs
-        ) const {
-            return abs_lt(lhs, rhs);
-        }
-    };
-
     /**
      * The block that we're scheduling for.
      */
@@ -110,46 +144,201 @@ class Scheduler {
      */
     utils::Int direction;
 
+    /**
+     * Compact form of the data dependency graph of the block. This is shared
+     * between clones of the scheduler.
+     */
+    com::ddg::CompactGraphCRef graph;
+
     /**
      * State of the resources for resource-constrained scheduling.
      */
-    utils::Opt<rmgr::State> resource_state;
+    utils::Opt<ResourceState> resource_state;
 
     /**
-     * Set of statements that have been scheduled.
+     * The scheduling state of a DDG node.
      */
-    utils::Set<ir::StatementRef> scheduled;
+    enum class NodeState : utils::Byte {
+
+        /**
+         * Not all predecessors have been scheduled yet.
+         */
+        WAITING,
+
+        /**
+         * All predecessors have been scheduled, but the statement only becomes
+         * available in a later cycle, because of edge weights/preceding
+         * statement duration. The statement is in available_in.
+         */
+        PENDING,
+
+        /**
+         * The statement is available for scheduling as far as the data
+         * dependency graph is concerned. The statement is in available.
+         */
+        AVAILABLE,
+
+        /**
+         * The statement has been scheduled.
+         */
+        SCHEDULED
+
+    };
 
     /**
-     * List of available statements, i.e. statements we can immediately schedule
-     * as far as the data dependency graph is concerned (but not necessarily as
-     * far as the resource constraints are concerned). Per the comparator,
-     * forward iteration over the set yields statements starting from the most
-     * critical one per the HeuristicComparator template argument.
+     * The scheduling state of each DDG node, indexed by compact graph node
+     * index.
      */
-    utils::Set<ir::StatementRef, AvailableListComparator> available;
+    utils::Vec<NodeState> node_state;
 
     /**
-     * The statements for which all predecessors have been scheduled, but which
-     * aren't available yet because of edge weights/preceding statement
-     * duration. The key is the cycle in which the accompanied list of
-     * statements becomes valid. The comparator ensures that the first cycle
-     * we'll encounter when scheduling will appear at the front, because we
-     * always schedule away from cycle 0 regardless of the scheduling direction.
+     * The number of incoming edges of each DDG node for which the predecessor
+     * hasn't been scheduled yet.
      */
-    utils::Map<utils::Int, utils::List<ir::StatementRef>, AbsoluteComparator> available_in;
+    utils::Vec<utils::UInt> pending_predecessors;
 
     /**
-     * Set of statements that are still blocked, because their data
+     * For each DDG node, the earliest cycle in which it can be scheduled w.r.t.
+     * the predecessors that have been scheduled so far (in terms of absolute
+     * value).
+     */
+    utils::Vec<utils::Int> available_from;
+
+    /**
+     * For each DDG node that is or has been available, the criticality key
+     * returned by the heuristic when it became available.
+     */
+    utils::Vec<utils::UInt> keys;
+
+    /**
+     * Binary heap of the node indices of available statements, i.e. statements
+     * we can immediately schedule as far as the data dependency graph is
+     * concerned (but not necessarily as far as the resource constraints are
+     * concerned). The most critical statement per the HeuristicComparator
+     * template argument is at the front. Statements that are scheduled while
+     * not at the front are not removed immediately; such stale entries are
+     * recognized by their node state, and are dropped when they reach the
+     * front, or when they make up more than half of the heap.
+     */
+    utils::Vec<utils::UInt> available;
+
+    /**
+     * The number of non-stale entries in available.
+     */
+    utils::UInt num_available;
+
+    /**
+     * Calendar queue of the node indices of the statements for which all
+     * predecessors have been scheduled, but which aren't available yet because
+     * of edge weights/preceding statement duration. The statements that become
+     * available in cycle c are in bucket abs(c) modulo the number of buckets.
+     * Statements never become available more than the maximum absolute edge
+     * weight cycles after the current cycle, and the number of buckets is
+     * larger than that, so a bucket never contains statements for different
+     * cycles.
+     */
+    utils::Vec<utils::Vec<utils::UInt>> available_in;
+
+    /**
+     * The number of statements in available_in.
+     */
+    utils::UInt num_available_in;
+
+    /**
+     * The number of statements that are still blocked, because their data
      * dependencies have not yet been scheduled.
      */
-    utils::Set<ir::StatementRef> waiting;
+    utils::UInt num_waiting;
+
+    /**
+     * The number of statements that have been scheduled.
+     */
+    utils::UInt num_scheduled;
+
+    /**
+     * Returns the bucket of available_in for the given cycle.
+     */
+    utils::Vec<utils::UInt> &get_bucket(utils::Int c) {
+        return available_in[utils::abs(c) & (available_in.size() - 1)];
+    }
 
     /**
-     * Schedules the given statement in the current cycle, updating all state
+     * Returns the bucket of available_in for the given cycle.
+     */
+    const utils::Vec<utils::UInt> &get_bucket(utils::Int c) const {
+        return available_in[utils::abs(c) & (available_in.size() - 1)];
+    }
+
+    /**
+     * Adds the given node to the available heap.
+     */
+    void make_available(utils::UInt node) {
+        node_state[node] = NodeState::AVAILABLE;
+        keys[node] = HeuristicComparator().get_key(graph->statements[node]);
+        available.push_back(node);
+        std::push_heap(available.begin(), available.end(), HeapComparator(keys, *graph));
+        num_available++;
+    }
+
+    /**
+     * Moves all statements in the bucket for the current cycle to the
+     * available heap.
+     */
+    void release_bucket() {
+        auto &bucket = get_bucket(cycle);
+        for (auto node : bucket) {
+            QL_ASSERT(node_state[node] == NodeState::PENDING);
+            make_available(node);
+        }
+        num_available_in -= bucket.size();
+        bucket.clear();
+    }
+
+    /**
+     * Drops stale entries from the front of the available heap, and rebuilds
+     * the heap when it consists mostly of stale entries.
+     */
+    void drop_stale() {
+        if (available.size() > 2 * num_available + 16) {
+            available.erase(
+                std::remove_if(
+                    available.begin(), available.end(),
+                    [this](utils::UInt node) {
+                        return node_state[node] != NodeState::AVAILABLE;
+                    }
+                ),
+                available.end()
+            );
+            std::make_heap(available.begin(), available.end(), HeapComparator(keys, *graph));
+        }
+        while (!available.empty() && node_state[available.front()] != NodeState::AVAILABLE) {
+            std::pop_heap(available.begin(), available.end(), HeapComparator(keys, *graph));
+            available.pop_back();
+        }
+    }
+
+    /**
+     * Returns the node indices of the statements that are available w.r.t.
+     * data dependencies, ordered by decreasing criticality.
+     */
+    utils::Vec<utils::UInt> get_sorted_available() const {
+        utils::Vec<utils::UInt> result;
+        result.reserve(num_available);
+        for (auto node : available) {
+            if (node_state[node] == NodeState::AVAILABLE) {
+                result.push_back(node);
+            }
+        }
+        std::sort(result.begin(), result.end(), AvailableListComparator(keys, *graph));
+        return result;
+    }
+
+    /**
+     * Schedules the given node in the current cycle, updating all state
      * accordingly.
      */
-    void schedule(ir::StatementRef statement) {
+    void schedule(utils::UInt node) {
+        const auto &statement = graph->statements[node];
 
         // Update the resource state.
         resource_state->reserve(cycle, statement);
@@ -157,60 +346,48 @@ class Scheduler {
         // Set the cycle number of the statement to the current cycle.
         statement->cycle = cycle;
 
-        // Move the statement from available to scheduled.
-        QL_ASSERT(available.erase(statement));
-        QL_ASSERT(scheduled.insert(statement).second);
-
-        // The DDG successors of the statement should all still be in the
-        // waiting list, but some may be unblocked now. Check for that, and
-        // move the unblocked statements to available_in or available
-        // accordingly.
-        for (const auto &successor_ep : com::ddg::get_node(statement)->successors) {
-            const auto &successor_stmt = successor_ep.first;
-            auto successor_node = com::ddg::get_node(successor_stmt);
-
-            // Check if this successor of the statement we just scheduled is
-            // now available.
-            utils::Bool is_now_available = true;
-            utils::Int available_from_cycle = 0;
-            for (const auto &predecessor_ep : successor_node->predecessors) {
-                const auto &predecessor_stmt = predecessor_ep.first;
-                const auto &edge = predecessor_ep.second;
-
-                // Ensure that all predecessors have been scheduled.
-                if (!scheduled.count(predecessor_stmt)) {
-                    is_now_available = false;
-                    break;
-                }
-
-                // Compute the minimum cycle for which this statement will
-                // become available.
-                available_from_cycle = abs_max(
-                    available_from_cycle,
-                    predecessor_stmt->cycle + edge->weight
-                );
+        // Mark the statement as scheduled. If it's not at the front of the
+        // available heap, its entry becomes stale and is removed lazily.
+        QL_ASSERT(node_state[node] == NodeState::AVAILABLE);
+        node_state[node] = NodeState::SCHEDULED;
+        num_available--;
+        num_scheduled++;
+        drop_stale();
+
+        // The DDG successors of the statement should all still be waiting, but
+        // some may be unblocked now. Update their predecessor counters and
+        // available-from cycles, and move the unblocked statements to
+        // available_in or available accordingly.
+        for (auto edge : graph->get_successors(node)) {
+            auto successor = graph->edge_successor[edge];
+            QL_ASSERT(node_state[successor] == NodeState::WAITING);
+
+            // Compute the minimum cycle for which this statement will become
+            // available.
+            available_from[successor] = abs_max(
+                available_from[successor],
+                cycle + graph->edge_weight[edge]
+            );
 
+            // If this was the last predecessor, actually make the statement
+            // available by moving it to the appropriate list.
+            QL_ASSERT(pending_predecessors[successor] > 0);
+            if (--pending_predecessors[successor]) {
+                continue;
             }
+            num_waiting--;
+            if (available_from[successor] == cycle) {
 
-            // If the statement is now available, actually make it available by
-            // moving it to the appropriate list.
-            if (is_now_available) {
-                if (available_from_cycle == cycle) {
-
-                    // The statement is immediately available.
-                    QL_ASSERT(available.insert(successor_stmt).second);
-
-                } else {
-
-                    // The statement is not immediately available, so we have
-                    // to move it to available_in.
-                    auto it = available_in.insert({available_from_cycle, {}});
-                    it.first->second.push_back(successor_stmt);
+                // The statement is immediately available.
+                make_available(successor);
 
-                }
+            } else {
 
-                // Remove the statement from the waiting list.
-                QL_ASSERT(waiting.erase(successor_stmt));
+                // The statement is not immediately available, so we have
+                // to move it to available_in.
+                node_state[successor] = NodeState::PENDING;
+                get_bucket(available_from[successor]).push_back(successor);
+                num_available_in++;
 
             }
 
@@ -218,34 +395,44 @@ class Scheduler {
 
         // If no more instructions are available in this cycle, advance to the
         // next cycle in which instructions will become available.
-        if (available.empty()) {
-            auto it = available_in.begin();
-            if (it != available_in.end()) {
-                cycle = it->first;
-                for (const auto &available_statement : it->second) {
-                    QL_ASSERT(available.insert(available_statement).second);
-                }
-                available_in.erase(it);
-            }
+        if (!num_available && num_available_in) {
+            do {
+                cycle += direction;
+            } while (get_bucket(cycle).empty());
+            release_bucket();
         }
 
     }
 
-public:
-
     /**
-     * Creates a scheduler for the given block and initializes it.
+     * Tries to schedule the given node in the current cycle. Returns whether
+     * scheduling was successful.
      */
-    Scheduler(
-        const ir::BlockBaseRef &block,
-        const rmgr::CRef &resources = {}
-    ) : block(block) {
+    utils::Bool try_schedule_node(utils::UInt node) {
+        const auto &statement = graph->statements[node];
+        QL_DOUT("trying n" << node << " = " << ir::describe(statement));
+        QL_DOUT(" |-> with criticality " << HeuristicComparator()(statement));
+        if (node_state[node] != NodeState::AVAILABLE) {
+            QL_DOUT(" '-> not available due to data dependencies");
+            return false;
+        }
+        if (!resource_state->available(cycle, statement)) {
+            QL_DOUT(" '-> not available due to resources");
+            return false;
+        }
+        QL_DOUT(" '-> ok, scheduling in cycle " << cycle);
+        schedule(node);
+        return true;
+    }
 
-        // Always start scheduling at cycle 0.
-        cycle = 0;
+    /**
+     * Initializes the scheduling direction and the resource state. Shared
+     * between the constructors.
+     */
+    void initialize_resources(const rmgr::CRef &resources) {
 
         // Cache the scheduling direction.
-        direction = com::ddg::get_direction(block);
+        direction = graph->direction;
         if (direction == 1) {
             QL_DOUT("scheduling in forward direction (ASAP)");
         } else if (direction == -1) {
@@ -258,24 +445,125 @@ public:
         // constraints, the state will simply be empty and always say a
         // statement is available for scheduling.
         if (!resources.has_value()) {
-            resource_state = rmgr::Manager({}).build(rmgr::Direction::UNDEFINED);
+            resource_state.emplace(rmgr::Manager({}).build(rmgr::Direction::UNDEFINED));
         } else if (direction > 0) {
-            resource_state = resources->build(rmgr::Direction::FORWARD);
+            resource_state.emplace(resources->build(rmgr::Direction::FORWARD));
         } else {
-            resource_state = resources->build(rmgr::Direction::BACKWARD);
+            resource_state.emplace(resources->build(rmgr::Direction::BACKWARD));
         }
 
+    }
+
+    /**
+     * Initializes the scheduling state, with the source node scheduled in the
+     * given cycle. Shared between the constructors.
+     */
+    void initialize(utils::Int start_cycle) {
+        cycle = start_cycle;
+
+        // Initialize the per-node state, counting the predecessors of each
+        // node.
+        auto num_nodes = graph->get_num_nodes();
+        node_state.assign(num_nodes, NodeState::WAITING);
+        pending_predecessors.resize(num_nodes);
+        for (utils::UInt node = 0; node < num_nodes; node++) {
+            pending_predecessors[node] = graph->get_predecessors(node).size();
+        }
+        available_from.assign(num_nodes, 0);
+        keys.assign(num_nodes, 0);
+
+        // Initialize the calendar queue with a power-of-two number of buckets
+        // that is larger than the maximum edge weight.
+        utils::UInt max_weight = 0;
+        for (auto weight : graph->edge_weight) {
+            max_weight = utils::max<utils::UInt>(max_weight, utils::abs(weight));
+        }
+        utils::UInt num_buckets = 1;
+        while (num_buckets <= max_weight) {
+            num_buckets <<= 1;
+        }
+        available_in.resize(num_buckets);
+        num_available_in = 0;
+
         // Initialize by putting the source statement in the available list and
         // all other statements in the waiting list.
-        QL_ASSERT(available.insert(com::ddg::get_source(block)).second);
-        for (const auto &statement : block->statements) {
-            QL_ASSERT(waiting.insert(statement).second);
-        }
-        QL_ASSERT(waiting.insert(com::ddg::get_sink(block)).second);
+        num_available = 0;
+        num_scheduled = 0;
+        num_waiting = num_nodes - 1;
+        make_available(graph->source);
 
         // Start by scheduling the source node.
-        schedule(com::ddg::get_source(block));
+        schedule(graph->source);
+
+    }
+
+public:
+
+    /**
+     * Creates a scheduler for the given block and initializes it. This builds
+     * the compact form of the data dependency graph of the block.
+     */
+    Scheduler(
+        const ir::BlockBaseRef &block,
+        const rmgr::CRef &resources = {}
+    ) : block(block) {
+        if (!com::ddg::get_direction(block)) {
+            QL_ICE("no data dependency graph is present");
+        }
+        utils::Ptr<com::ddg::CompactGraph> compact_graph;
+        compact_graph.emplace(block);
+        graph = compact_graph.as_const();
+        initialize_resources(resources);
+        initialize(0);
+    }
 
+    /**
+     * Creates a scheduler for the given block and initializes it, using the
+     * given, previously constructed compact form of the data dependency graph
+     * of the block. The graph must be in the desired scheduling direction.
+     */
+    Scheduler(
+        const ir::BlockBaseRef &block,
+        const com::ddg::CompactGraphCRef &graph,
+        const rmgr::CRef &resources = {}
+    ) : block(block), graph(graph) {
+        initialize_resources(resources);
+        initialize(0);
+    }
+
+    /**
+     * Creates a scheduler for the given block using the given compact form of
+     * its data dependency graph, continuing from the given resource state
+     * (previously obtained from get_resource_state()) rather than starting
+     * from a fresh one, and scheduling the source node in start_cycle rather
+     * than in cycle 0. This is used to schedule a long block in consecutive
+     * windows. The resource state must have been built for the scheduling
+     * direction of the graph.
+     */
+    Scheduler(
+        const ir::BlockBaseRef &block,
+        const com::ddg::CompactGraphCRef &graph,
+        const ResourceState &resource_state,
+        utils::Int start_cycle
+    ) : block(block), graph(graph), resource_state(resource_state) {
+        direction = graph->direction;
+        QL_ASSERT(direction == 1 || direction == -1);
+        initialize(start_cycle);
+    }
+
+    /**
+     * Returns the current state of the resources.
+     */
+    const ResourceState &get_resource_state() const {
+        return *resource_state;
+    }
+
+    /**
+     * Enables the performance counters of the resources, which can then be
+     * retrieved through get_resource_state().
+     */
+    void enable_resource_statistics() {
+        resource_state->enable_statistics();
     }
 
     /**
@@ -299,18 +587,15 @@ public:
      */
     void advance(utils::UInt by = 1) {
 
-        // Advance to the next cycle.
-        cycle += direction * (utils::Int)by;
-
         // Advancing the cycle number may mean more statements will become
         // available due to data dependencies. If this is the case, move them
-        // from available_in to available.
-        auto it = available_in.begin();
-        if (it != available_in.end() && it->first == cycle) {
-            for (const auto &available_statement : it->second) {
-                QL_ASSERT(available.insert(available_statement).second);
+        // from available_in to available. When advancing by more than one
+        // cycle, this includes the statements for the skipped cycles.
+        for (utils::UInt i = 0; i < by; i++) {
+            cycle += direction;
+            if (num_available_in) {
+                release_bucket();
             }
-            available_in.erase(it);
         }
 
     }
@@ -321,7 +606,8 @@ public:
      */
     utils::List<ir::StatementRef> get_available() const {
         utils::List<ir::StatementRef> result;
-        for (const auto &statement : available) {
+        for (auto node : get_sorted_available()) {
+            const auto &statement = graph->statements[node];
             if (resource_state->available(cycle, statement)) {
                 result.push_back(statement);
             }
@@ -342,12 +628,22 @@ public:
     utils::Bool try_schedule(const ir::StatementRef &statement = {}) {
         if (statement.empty()) {
 
-            // Try to schedule statements that are available w.r.t. data
-            // dependencies. Note that the iteration order here is implicitly by
-            // decreasing criticality, because available is a set that uses the
-            // criticality heuristic for its comparator.
-            for (const auto &statement : available) {
-                if (try_schedule(statement)) {
+            // Try to schedule the most critical statement that is available
+            // w.r.t. data dependencies first, which is at the front of the
+            // heap.
+            if (!num_available) {
+                return false;
+            }
+            if (try_schedule_node(available.front())) {
+                return true;
+            }
+
+            // If that doesn't work due to resource constraints, try the
+            // others by decreasing criticality. The first one in the sorted
+            // list is the one we just tried.
+            auto sorted = get_sorted_available();
+            for (utils::UInt i = 1; i < sorted.size(); i++) {
+                if (try_schedule_node(sorted[i])) {
                     return true;
                 }
             }
@@ -356,21 +652,53 @@ public:
         } else {
 
             // Schedule the given statement, if it's available.
-            QL_DOUT("trying n" << utils::abs(ddg::get_node(statement)->order) << " = " << ir::describe(statement));
-            QL_DOUT(" |-> with criticality " << HeuristicComparator()(statement));
-            if (available.find(statement) == available.end()) {
-                QL_DOUT(" '-> not available due to data dependencies");
-                return false;
-            }
-            if (!resource_state->available(cycle, statement)) {
-                QL_DOUT(" '-> not available due to resources");
-                return false;
+            return try_schedule_node(com::ddg::CompactGraph::get_index(statement));
+
+        }
+    }
+
+    /**
+     * Returns the number of cycles to advance by when none of the statements
+     * that are available w.r.t. data dependencies can be scheduled in the
+     * current cycle due to resource constraints. This is the distance to the
+     * nearest cycle in which either one of those statements fits w.r.t. the
+     * resources, or in which more statements become available w.r.t. data
+     * dependencies, but no more than max_skip and at least one cycle. The
+     * resource state is queried for all available statements at once rather
+     * than probed one statement and one cycle at a time.
+     */
+    utils::UInt get_resource_skip(utils::UInt max_skip) const {
+        max_skip = utils::max<utils::UInt>(max_skip, 1);
+
+        // Find the nearest cycle in which statements become available w.r.t.
+        // data dependencies.
+        if (num_available_in) {
+            for (utils::UInt delay = 1; delay < max_skip; delay++) {
+                if (!get_bucket(cycle + direction * (utils::Int)delay).empty()) {
+                    max_skip = delay;
+                    break;
+                }
             }
-            QL_DOUT(" '-> ok, scheduling in cycle " << cycle);
-            schedule(statement);
-            return true;
+        }
+        if (max_skip == 1) {
+            return 1;
+        }
 
+        // Query the resources for the nearest cycle in which any of the
+        // available statements fits.
+        utils::Vec<ir::StatementRef> statements;
+        statements.reserve(num_available);
+        for (auto node : available) {
+            if (node_state[node] == NodeState::AVAILABLE) {
+                statements.push_back(graph->statements[node]);
+            }
+        }
+        utils::UInt skip = max_skip;
+        for (auto delay : resource_state->get_earliest(cycle, statements, max_skip)) {
+            skip = utils::min(skip, delay);
         }
+        return utils::max<utils::UInt>(skip, 1);
+
     }
 
     /**
@@ -378,10 +706,10 @@ public:
      * scheduled.
      */
     utils::Bool is_done() const {
-        if (!available.empty()) return false;
-        if (!available_in.empty()) return false;
-        if (!waiting.empty()) return false;
-        QL_ASSERT(scheduled.size() == block->statements.size() + 2);
+        if (num_available) return false;
+        if (num_available_in) return false;
+        if (num_waiting) return false;
+        QL_ASSERT(num_scheduled == graph->get_num_nodes());
         return true;
     }
 
@@ -403,30 +731,36 @@ public:
      * IR-mandated invariants on cycle numbers to be valid.
      */
     void run(utils::UInt max_resource_block_cycles = 0) {
+        QL_TRACE_SCOPE("sch.run");
         QL_DOUT("starting scheduler...");
 
         // Now schedule statements until all statements have been scheduled.
         while (!is_done()) {
             QL_DOUT(
                 "cycle " << cycle << ", " <<
-                scheduled.size() << " scheduled, " <<
-                available.size() << " available w.r.t. data dependencies, " <<
-                available_in.size() << " batches available later, " <<
-                waiting.size() << " waiting"
+                num_scheduled << " scheduled, " <<
+                num_available << " available w.r.t. data dependencies, " <<
+                num_available_in << " available later, " <<
+                num_waiting << " waiting"
             );
-            QL_ASSERT(!available.empty());
+            QL_ASSERT(num_available);
             utils::UInt advanced = 0;
             while (!try_schedule()) {
-                advance();
-                advanced++;
+                auto by = get_resource_skip(
+                    max_resource_block_cycles
+                    ? max_resource_block_cycles + 1 - advanced
+                    : available_in.size()
+                );
+                advance(by);
+                advanced += by;
                 QL_DOUT("nothing is available, advancing to cycle " << cycle);
                 if (max_resource_block_cycles && advanced > max_resource_block_cycles) {
                     utils::StrStrm ss;
                     ss << "scheduling resources seem to be deadlocked! ";
                     ss << "The current cycle is " << cycle << ", ";
                     ss << "and the available statements are:\n";
-                    for (const auto &available_statement : available) {
-                        ss << "  " << ir::describe(available_statement) << "\n";
+                    for (auto node : get_sorted_available()) {
+                        ss << "  " << ir::describe(graph->statements[node]) << "\n";
                     }
                     ss << "The state of the resources is:\n";
                     resource_state->dump(ss, "  ");
@@ -437,7 +771,7 @@ public:
 
         QL_DOUT(
             "scheduler done; schedule takes " <<
-            utils::abs(com::ddg::get_sink(block)->cycle) << " cycles"
+            utils::abs(graph->statements[graph->sink]->cycle) << " cycles"
         );
     }
 
@@ -5,13 +5,19 @@
 
 #pragma once
 
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/pair.h"
 #include "ql/utils/list.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/map.h"
+#include "ql/utils/index_map.h"
+#include "ql/utils/ptr.h"
 #include "ql/utils/json.h"
+#include "ql/utils/binary_io.h"
 
 namespace ql {
 namespace com {
@@ -106,13 +112,151 @@ public:
      */
     using Neighbors = utils::List<Qubit>;
 
+    /**
+     * Read-only view of the neighbors of a qubit, as returned by
+     * get_neighbor_span(). For specified connectivity and for full
+     * connectivity with coordinates, this refers to the precomputed
+     * adjacency arrays of the topology. For full connectivity without
+     * coordinates, the neighbors are enumerated by the iterator. Either way,
+     * no memory is allocated. The view is only valid for as long as the
+     * topology exists.
+     */
+    class NeighborSpan {
+    private:
+        friend class Topology;
+
+        /**
+         * The topology for implicit full connectivity, or nullptr when the
+         * span refers to the adjacency arrays.
+         */
+        const Topology *topology = nullptr;
+
+        /**
+         * The qubit whose neighbors are enumerated, for implicit full
+         * connectivity.
+         */
+        Qubit qubit = 0;
+
+        /**
+         * The range in the adjacency array, for explicit adjacency.
+         */
+        const Qubit *first = nullptr;
+        const Qubit *last = nullptr;
+
+    public:
+
+        /**
+         * Forward iterator over the neighbors.
+         */
+        class Iterator {
+        private:
+            friend class NeighborSpan;
+
+            /**
+             * Same as in NeighborSpan.
+             */
+            const Topology *topology;
+            Qubit qubit;
+
+            /**
+             * Position in the adjacency array, for explicit adjacency.
+             */
+            const Qubit *ptr;
+
+            /**
+             * The current neighbor, for implicit full connectivity.
+             */
+            Qubit current;
+
+            Iterator(const Topology *topology, Qubit qubit, const Qubit *ptr, Qubit current);
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Qubit;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Qubit*;
+            using reference = Qubit;
+
+            Qubit operator*() const;
+            Iterator &operator++();
+            utils::Bool operator==(const Iterator &rhs) const;
+            utils::Bool operator!=(const Iterator &rhs) const;
+        };
+
+        Iterator begin() const;
+        Iterator end() const;
+
+        /**
+         * Returns the number of neighbors. This is linear in the number of
+         * qubits for implicit full connectivity.
+         */
+        utils::UInt size() const;
+
+        /**
+         * Returns whether there are no neighbors.
+         */
+        utils::Bool empty() const;
+
+    };
+
+    /**
+     * Compact representation of all paths from a source qubit to a target
+     * qubit within a given hop budget, as returned by get_path_dag(). Rather
+     * than listing the paths themselves (of which there may be exponentially
+     * many), this stores for each reachable (qubit, remaining budget) state
+     * the neighbors that continue a path within budget. The paths can then be
+     * enumerated by walking the DAG from (source, budget) until the target is
+     * reached.
+     */
+    class PathDag {
+    private:
+        friend class Topology;
+
+        /**
+         * The next hops for each (qubit, remaining budget) state that is
+         * reachable from the source state and isn't the target. The next hops
+         * are listed in the same order as the neighbor list of the qubit.
+         */
+        utils::Map<utils::Pair<Qubit, utils::UInt>, Neighbors> next_hops;
+
+    public:
+
+        /**
+         * Returns the neighbors of qubit that continue a path to the target
+         * qubit in at most budget hops, i.e. the neighbors that are at most
+         * budget - 1 hops away from the target. The state must be reachable
+         * from the source state the DAG was constructed for.
+         */
+        const Neighbors &get_next_hops(Qubit qubit, utils::UInt budget) const;
+
+    };
+
+    /**
+     * Shared pointer reference to an immutable path DAG.
+     */
+    using CPathDagRef = utils::Ptr<const PathDag>;
+
+    /**
+     * The maximum number of path DAGs kept in the cache used by
+     * get_path_dag().
+     */
+    static constexpr utils::UInt PATH_DAG_CACHE_SIZE = 4096;
+
 private:
 
     /**
-     * Shorthand for a map from a qubit number to something else.
+     * Least-recently-used cache for the path DAGs returned by get_path_dag().
+     * Defined in the source file, as it also contains the mutex needed to
+     * protect it.
+     */
+    struct PathDagCache;
+
+    /**
+     * Shorthand for a map from a qubit number to something else. Qubit numbers
+     * are dense, so this is a vector indexed by qubit rather than a tree.
      */
     template <class T>
-    using QubitMap = utils::Map<Qubit, T>;
+    using QubitMap = utils::IndexMap<Qubit, T>;
 
     /**
      * The total number of qubits in the platform.
@@ -160,9 +304,15 @@ private:
     GridConnectivity connectivity;
 
     /**
-     * The list of neighboring qubits for each qubit.
+     * Adjacency in compressed sparse row form: the neighbors of qubit q are
+     * neighbor_qubits[neighbor_offsets[q]] up to (excluding)
+     * neighbor_qubits[neighbor_offsets[q + 1]], sorted clockwise starting
+     * from 12:00 when the qubits have coordinates. Empty for full
+     * connectivity without coordinates, in which case the neighbors are
+     * enumerated on-the-fly by NeighborSpan.
      */
-    QubitMap<Neighbors> neighbors;
+    utils::Vec<utils::UInt> neighbor_offsets;
+    utils::Vec<Qubit> neighbor_qubits;
 
     /**
      * Edge to qubit pair map. Only used for specified connectivity.
@@ -182,16 +332,99 @@ private:
     Edge max_edge;
 
     /**
-     * The distance (number of edges) between a pair of qubits. Only used and
-     * initialized for specified connectivity; distance is computed by
-     * get_distance() on-the-fly for full connectivity.
+     * Value used in the distance matrix for qubits that are not connected.
+     */
+    static constexpr std::uint16_t NO_PATH = 0xFFFF;
+
+    /**
+     * The maximum number of qubits for which the full distance matrix is
+     * computed when the topology is constructed. For larger topologies with
+     * specified connectivity, rows are computed on-demand instead.
+     */
+    static constexpr utils::UInt MAX_QUBITS_FOR_DISTANCE_MATRIX = 4096;
+
+    /**
+     * The distance (number of edges) between a pair of qubits, stored as a
+     * flat num_qubits * num_qubits matrix indexed by source * num_qubits +
+     * target, with NO_PATH for unconnected pairs. Only used and initialized
+     * for specified connectivity with at most MAX_QUBITS_FOR_DISTANCE_MATRIX
+     * qubits; distance is computed by get_distance() on-the-fly for full
+     * connectivity, and via distance_rows for larger topologies.
+     */
+    utils::Vec<std::uint16_t> distance;
+
+    /**
+     * The default for the maximum number of rows kept by the distance row
+     * cache, used when the topology.distance_cache_rows key is not specified.
+     */
+    static constexpr utils::UInt DEFAULT_DISTANCE_CACHE_ROWS = 1024;
+
+    /**
+     * The maximum number of rows kept by the distance row cache.
+     */
+    utils::UInt distance_cache_rows = DEFAULT_DISTANCE_CACHE_ROWS;
+
+    /**
+     * Bounded cache of distance matrix rows, computed on-demand for
+     * topologies that are too large for a complete distance matrix. Defined
+     * in the source file, as it also contains the atomics and mutex needed to
+     * share it between threads.
+     */
+    struct DistanceRowCache;
+
+    /**
+     * Distance row cache for large topologies with specified connectivity,
+     * empty otherwise. Like path_dag_cache, this is shared between copies.
+     */
+    utils::Ptr<DistanceRowCache> distance_rows;
+
+    /**
+     * Computes the distances from the given source qubit to all qubits using a
+     * breadth-first search over the specified edges, writing them to the given
+     * row of num_qubits entries.
+     */
+    void compute_distance_row(Qubit source, std::uint16_t *row) const;
+
+    /**
+     * Cache for get_path_dag(). This is shared between copies of the topology
+     * (which is fine, as the topology is immutable after construction).
+     */
+    utils::Ptr<PathDagCache> path_dag_cache;
+
+    /**
+     * Returns the first qubit greater than or equal to qd that is a neighbor
+     * of qs for full connectivity, or num_qubits if there is none.
+     */
+    Qubit find_implicit_neighbor(Qubit qs, Qubit qd) const;
+
+    /**
+     * Fills the adjacency arrays from the given neighbor lists, sorting them
+     * clockwise first when the qubits have coordinates.
+     */
+    void build_adjacency(QubitMap<Neighbors> &&neighbors);
+
+    /**
+     * Generates the neighbors of the given qubit that a path to the given
+     * target may continue with, for multi-core topologies. See
+     * build_path_dag().
+     */
+    void generate_path_neighbors_list(Qubit qs, Qubit target, Neighbors &qubits) const;
+
+    /**
+     * Sorts the given neighbor list of the given qubit clockwise starting from
+     * 12:00. Qubits must have coordinates.
      */
-    utils::Vec<utils::Vec<utils::UInt>> distance;
+    void sort_neighbors_clockwise(Qubit qubit, Neighbors &nbl) const;
 
     /**
-     * Generates the neighbor list for the given qubit for full connectivity.
+     * Constructs the path DAG for the given source, target, and budget.
      */
-    void generate_neighbors_list(utils::UInt qs, Neighbors &qubits) const;
+    CPathDagRef build_path_dag(Qubit source, Qubit target, utils::UInt budget) const;
+
+    /**
+     * Constructs an empty topology, to be filled by read_binary().
+     */
+    Topology() = default;
 
 public:
 
@@ -201,6 +434,19 @@ public:
      */
     Topology(utils::UInt num_qubits, const utils::Json &topology);
 
+    /**
+     * Writes a binary representation of this topology, including the
+     * adjacency arrays, edge maps, and distance matrix derived from the JSON
+     * description, such that read_binary() doesn't need to recompute them.
+     * This is used for platform snapshots.
+     */
+    void write_binary(utils::BinaryWriter &writer) const;
+
+    /**
+     * Reconstructs a topology from the data written by write_binary().
+     */
+    static Topology read_binary(utils::BinaryReader &reader);
+
     /**
      * Returns the number of qubits for this topology.
      */
@@ -245,10 +491,18 @@ public:
     Edge get_max_edge() const;
 
     /**
-     * Returns the indices of the neighboring qubits for the given qubit.
+     * Returns the indices of the neighboring qubits for the given qubit. This
+     * copies them into a list; prefer get_neighbor_span() when the neighbors
+     * are only iterated over.
      */
     Neighbors get_neighbors(Qubit qubit) const;
 
+    /**
+     * Returns a view of the neighboring qubits for the given qubit, in the
+     * same order as get_neighbors(), without allocating memory.
+     */
+    NeighborSpan get_neighbor_span(Qubit qubit) const;
+
     /**
      * Returns the number of cores.
      */
@@ -298,11 +552,50 @@ public:
      */
     utils::UInt get_min_hops(Qubit source, Qubit target) const;
 
+    /**
+     * Returns the DAG of all paths from source to target that take at most
+     * budget hops. This is always precisely the set of shortest paths when
+     * budget equals get_distance(source, target), but a larger budget can be
+     * used for multi-core routing (see get_min_hops()). The most recently
+     * used DAGs are cached, so repeated requests for the same qubit pair
+     * (which are very common while mapping a kernel) don't recompute them.
+     * This function is thread-safe.
+     */
+    CPathDagRef get_path_dag(Qubit source, Qubit target, utils::UInt budget) const;
+
     /**
      * Returns whether qubits have coordinates associated with them.
      */
     utils::Bool has_coordinates() const;
 
+    /**
+     * Returns whether all pairs of qubits are nearest neighbors, i.e. the
+     * connectivity is full and there is only a single core. Two-qubit gates
+     * then never need routing.
+     */
+    utils::Bool is_fully_connected() const;
+
+    /**
+     * Disables the given couplers and all couplers of the given qubits, for
+     * example because they have been taken offline. A coupler is disabled in
+     * both directions, so the edges from its first to its second qubit and
+     * vice versa are removed, along with their edge indices. Disabling a
+     * coupler that doesn't exist in either direction is an error. The JSON
+     * returned by get_json() is updated accordingly. This is only supported
+     * for specified connectivity.
+     *
+     * The distances are repaired incrementally: removing edges can only make
+     * distances larger, so only the distance rows of source qubits for which
+     * a removed edge lies on a shortest path are recomputed. Rows that are
+     * computed on-demand for large topologies are simply dropped when
+     * affected. The path DAG and distance row caches are normally shared
+     * between copies, so this topology gets new ones. This means that
+     * copies made before this call are unaffected, and thus that a degraded
+     * variant of a topology can be derived cheaply by disabling parts of a
+     * copy of it.
+     */
+    void disable(const utils::Vec<QubitPair> &couplers, const utils::Vec<Qubit> &qubits = {});
+
     /**
      * Rotate neighbors list such that largest angle difference between adjacent
      * elements is behind back. This is needed when a given subset of variations
@@ -0,0 +1,75 @@
+/** \file
+ * Binary serialization of the IR, as a compact and fast alternative to
+ * the cQASM round trip for checkpointing and transferring IR trees.
+ */
+
+#pragma once
+
+#include <iostream>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace ir {
+namespace binary {
+
+/**
+ * Version of the binary format. This is incremented whenever the IR tree
+ * structure or the serialization of any of its primitives changes.
+ */
+extern const utils::UInt FORMAT_VERSION;
+
+/**
+ * Writes a binary representation of the given IR to the given stream.
+ *
+ * The record consists of a four-byte magic number (`QLIR`), a 32-bit format
+ * version, a 64-bit payload length, and the payload itself, all integers being
+ * little-endian. The payload is tree-gen's CBOR serialization of the tree,
+ * which stores links as the sequence number of the node they refer to. Since
+ * records are length-prefixed, multiple records can be written to the same
+ * stream back to back.
+ *
+ * The resource manager and the compatibility platform are not stored; they
+ * are rebuilt from the platform JSON data when the record is read. All other
+ * annotations are lost.
+ */
+void write(const Ref &ir, std::ostream &os);
+
+/**
+ * Shorthand for getting the binary representation of the given IR as a
+ * string.
+ */
+utils::Str to_string(const Ref &ir);
+
+/**
+ * Same as write(), but writes to the given file.
+ */
+void write_file(const Ref &ir, const utils::Str &fname);
+
+/**
+ * Reads a binary IR record from the given buffer, which must contain exactly
+ * one record. The buffer is only read from and not retained, so it may for
+ * instance be a memory-mapped file.
+ */
+Ref read(const char *data, utils::UInt size);
+
+/**
+ * Same as read(const char*, utils::UInt), but reads from a string.
+ */
+Ref read(const utils::Str &data);
+
+/**
+ * Reads the next binary IR record from the given stream. The stream is left
+ * positioned at the end of the record.
+ */
+Ref read(std::istream &is);
+
+/**
+ * Same as read(), but reads the record from the given file.
+ */
+Ref read_file(const utils::Str &fname);
+
+} // namespace binary
+} // namespace ir
+} // namespace ql
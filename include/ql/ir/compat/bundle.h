@@ -6,7 +6,7 @@
 
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
-#include "ql/utils/list.h"
+#include "ql/utils/vec.h"
 #include "ql/ir/compat/gate.h"
 #include "ql/ir/compat/kernel.h"
 
@@ -21,31 +21,169 @@ namespace compat {
 static const utils::UInt FIRST_CYCLE = 1;
 
 /**
- * A bundle of gates that start in the same cycle.
+ * The gates of a bundle, as a range over the gates of the kernel that the
+ * bundle was created from.
+ */
+class BundleGates {
+private:
+
+    /**
+     * The gates of the kernel.
+     */
+    const GateRefs *gates;
+
+    /**
+     * Range of indices into gates for the gates in this bundle.
+     */
+    const utils::UInt *first;
+    const utils::UInt *last;
+
+public:
+
+    /**
+     * Forward iterator over the gates in a bundle.
+     */
+    class ConstIter {
+    private:
+        const GateRefs *gates;
+        const utils::UInt *pos;
+    public:
+        ConstIter(const GateRefs *gates, const utils::UInt *pos) : gates(gates), pos(pos) {}
+        const GateRef &operator*() const { return (*gates)[*pos]; }
+        const GateRef *operator->() const { return &(*gates)[*pos]; }
+        ConstIter &operator++() { pos++; return *this; }
+        utils::Bool operator==(const ConstIter &other) const { return pos == other.pos; }
+        utils::Bool operator!=(const ConstIter &other) const { return pos != other.pos; }
+    };
+
+    /**
+     * Constructs a range over the gates at the given indices.
+     */
+    BundleGates(
+        const GateRefs &gates,
+        const utils::UInt *first,
+        const utils::UInt *last
+    ) : gates(&gates), first(first), last(last) {}
+
+    ConstIter begin() const { return {gates, first}; }
+    ConstIter end() const { return {gates, last}; }
+    utils::UInt size() const { return last - first; }
+    utils::Bool empty() const { return first == last; }
+
+};
+
+/**
+ * A bundle of gates that start in the same cycle. This is a lightweight view
+ * into a Bundles object, and is only valid for as long as that object and the
+ * gates of its kernel remain unchanged.
  */
 struct Bundle {
 
     /**
      * The start cycle for all gates in this bundle.
      */
-    utils::UInt start_cycle = FIRST_CYCLE;
+    utils::UInt start_cycle;
 
     /**
      * The maximum gate duration of the gates in this bundle.
      */
-    utils::UInt duration_in_cycles = 0;
+    utils::UInt duration_in_cycles;
 
     /**
      * The list of parallel gates in this bundle.
      */
-    utils::List<GateRef> gates = {};
+    BundleGates gates;
 
 };
 
 /**
-* A list of bundles. Note that subsequent bundles can overlap in time.
+ * The bundles of a kernel, ordered by (strictly increasing) start cycle.
+ * Note that subsequent bundles can overlap in time.
+ *
+ * Rather than as lists of gate references, the bundles are stored in columnar
+ * form: the indices of the bundled gates in the kernel's circuit in a single
+ * array, grouped by bundle, and for each bundle its start cycle, its duration,
+ * and the offset of its first gate in that array. Iterating over the bundles
+ * yields Bundle views one at a time, without materializing anything. The
+ * gates of the kernel must not be modified while the bundles are in use.
  */
-using Bundles = utils::List<Bundle>;
+class Bundles {
+private:
+
+    /**
+     * The kernel that the bundles were created from.
+     */
+    KernelRef kernel;
+
+    /**
+     * The indices of the bundled gates in kernel->gates, grouped by bundle.
+     */
+    utils::Vec<utils::UInt> gate_indices;
+
+    /**
+     * For each bundle the offset of its first gate in gate_indices, followed
+     * by gate_indices.size().
+     */
+    utils::Vec<utils::UInt> offsets = {0};
+
+    /**
+     * The start cycle of each bundle.
+     */
+    utils::Vec<utils::UInt> start_cycles;
+
+    /**
+     * The duration in cycles of each bundle.
+     */
+    utils::Vec<utils::UInt> durations;
+
+    friend Bundles bundler(const KernelRef &kernel);
+
+public:
+
+    /**
+     * Forward iterator over the bundles.
+     */
+    class ConstIter {
+    private:
+        const Bundles *bundles;
+        utils::UInt idx;
+    public:
+        ConstIter(const Bundles *bundles, utils::UInt idx) : bundles(bundles), idx(idx) {}
+        Bundle operator*() const { return bundles->at(idx); }
+        ConstIter &operator++() { idx++; return *this; }
+        utils::Bool operator==(const ConstIter &other) const { return idx == other.idx; }
+        utils::Bool operator!=(const ConstIter &other) const { return idx != other.idx; }
+    };
+
+    ConstIter begin() const { return {this, 0}; }
+    ConstIter end() const { return {this, size()}; }
+
+    /**
+     * Returns the number of bundles.
+     */
+    utils::UInt size() const;
+
+    /**
+     * Returns whether there are no bundles.
+     */
+    utils::Bool empty() const;
+
+    /**
+     * Returns a view of the bundle with the given index.
+     */
+    Bundle at(utils::UInt idx) const;
+
+    /**
+     * Returns a view of the first bundle, which must exist.
+     */
+    Bundle front() const;
+
+    /**
+     * Returns a view of the last bundle, which must exist.
+     */
+    Bundle back() const;
+
+};
 
 /**
  * Create a circuit with valid cycle values from the bundled internal
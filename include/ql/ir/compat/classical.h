@@ -81,7 +81,7 @@ class Classical : public Gate {
 public:
     Classical(const ClassicalRegister &dest, const ClassicalOperation &oper);
     Classical(const utils::Str &operation);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
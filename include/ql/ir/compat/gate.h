@@ -5,7 +5,9 @@
 #pragma once
 
 #include "ql/utils/str.h"
+#include "ql/utils/intern.h"
 #include "ql/utils/vec.h"
+#include "ql/utils/small_vec.h"
 #include "ql/utils/json.h"
 #include "ql/utils/misc.h"
 #include "ql/utils/tree.h"
@@ -87,16 +89,22 @@ struct SwapParamaters {
     {}
 };
 
+/**
+ * list of qubit or bit operand indices of a gate; almost all gates have at most
+ * three, so these are stored inline
+ */
+using GateOperands = utils::SmallVec<utils::UInt, 3>;
+
 /**
  * gate interface
  */
 class Gate : public utils::Node {
 public:
     utils::Str name;
-    utils::Vec<utils::UInt> operands;             // qubit operands
-    utils::Vec<utils::UInt> creg_operands;
-    utils::Vec<utils::UInt> breg_operands;        // bit operands e.g. assigned to by measure; cond_operands are separate
-    utils::Vec<utils::UInt> cond_operands;        // 0, 1 or 2 bit operands of condition
+    GateOperands operands;                        // qubit operands
+    GateOperands creg_operands;
+    GateOperands breg_operands;                   // bit operands e.g. assigned to by measure; cond_operands are separate
+    GateOperands cond_operands;                   // 0, 1 or 2 bit operands of condition
     ConditionType condition = ConditionType::ALWAYS; // defines condition and by that number of bit operands of condition
     SwapParamaters swap_params;                  // if the gate is part of a swap/move, this will contain the real and virtual qubits involved
     utils::Int int_operand = 0;                   // FIXME: move to class 'classical'
@@ -104,11 +112,24 @@ public:
     utils::Real angle = 0.0;                      // for arbitrary rotations
     utils::UInt cycle = MAX_CYCLE;                // cycle after scheduling; MAX_CYCLE indicates undefined
     virtual ~Gate() = default;
-    virtual Instruction qasm() const = 0;
+    virtual void append_qasm(utils::Str &buf) const = 0; // appends the gate in qasm layout to buf
+    Instruction qasm() const;                     // returns the gate in qasm layout
     virtual GateType      type() const = 0;
     utils::Bool is_conditional() const;           // whether gate has condition that is NOT cond_always
+    void append_cond_qasm(utils::Str &buf) const; // appends the condition expression in qasm layout to buf
     Instruction cond_qasm() const;              // returns the condition expression in qasm layout
     static utils::Bool is_valid_cond(ConditionType condition, const utils::Vec<utils::UInt> &cond_operands);
+
+    // interned name, for O(1) comparison against other interned names; cached, so after the first call this
+    // only costs a (short) string compare to check that name didn't change
+    const utils::InternedStr &get_interned_name() const;
+    // same, but only up to the first space, i.e. without the operands that legacy custom gate names may include
+    const utils::InternedStr &get_base_name() const;
+
+private:
+    mutable utils::InternedStr name_cache;        // interned copy of name as of the last update_name_cache()
+    mutable utils::InternedStr base_name_cache;   // interned base name belonging to name_cache
+    void update_name_cache() const;
 };
 
 using GateRef = utils::One<Gate>;
@@ -123,126 +144,126 @@ namespace gate_types {
 class Identity : public Gate {
 public:
     explicit Identity(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Hadamard : public Gate {
 public:
     explicit Hadamard(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Phase : public Gate {
 public:
     explicit Phase(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class PhaseDag : public Gate {
 public:
     explicit PhaseDag(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RX : public Gate {
 public:
     RX(utils::UInt q, utils::Real theta);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RY : public Gate {
 public:
     RY(utils::UInt q, utils::Real theta);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RZ : public Gate {
 public:
     RZ(utils::UInt q, utils::Real theta);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class T : public Gate {
 public:
     explicit T(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class TDag : public Gate {
 public:
     explicit TDag(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class PauliX : public Gate {
 public:
     explicit PauliX(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class PauliY : public Gate {
 public:
     explicit PauliY(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class PauliZ : public Gate {
 public:
     explicit PauliZ(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RX90 : public Gate {
 public:
     explicit RX90(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class MRX90 : public Gate {
 public:
     explicit MRX90(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RX180 : public Gate {
 public:
     explicit RX180(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RY90 : public Gate {
 public:
     explicit RY90(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class MRY90 : public Gate {
 public:
     explicit MRY90(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class RY180 : public Gate {
 public:
     explicit RY180(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
@@ -250,49 +271,49 @@ class Measure : public Gate {
 public:
     explicit Measure(utils::UInt q);
     Measure(utils::UInt q, utils::UInt c);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class PrepZ : public Gate {
 public:
     explicit PrepZ(utils::UInt q);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class CNot : public Gate {
 public:
     CNot(utils::UInt q1, utils::UInt q2);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class CPhase : public Gate {
 public:
     CPhase(utils::UInt q1, utils::UInt q2);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Toffoli : public Gate {
 public:
     Toffoli(utils::UInt q1, utils::UInt q2, utils::UInt q3);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Nop : public Gate {
 public:
     Nop();
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Swap : public Gate {
 public:
     Swap(utils::UInt q1, utils::UInt q2);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
@@ -305,28 +326,28 @@ public:
     utils::UInt duration_in_cycles;
 
     Wait(utils::Vec<utils::UInt> qubits, utils::UInt d, utils::UInt dc);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Source : public Gate {
 public:
     Source();
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Sink : public Gate {
 public:
     Sink();
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Display : public Gate {
 public:
     Display();
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
@@ -335,16 +356,30 @@ public:
     explicit Custom(const utils::Str &name);
     void load(const utils::Json &instr, utils::UInt num_qubits, utils::UInt cycle_time);
     void print_info() const;
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
 class Composite : public Custom {
 public:
     GateRefs gs;
+
+    // decomposition template of a sub-gate, parsed once from its name when the composite is constructed: the name
+    // of the gate to add, and the numbers following the first character of each operand, i.e. the qubit indices of
+    // a specialized sub-gate ("x q0") or the parameter indices of a parameterized one ("x %0")
+    struct SubGate {
+        utils::Str name;
+        utils::Vec<utils::UInt> operands;
+    };
+    utils::Vec<SubGate> sub_gates;
+
+    // if the name of a sub-gate could not be parsed into a template, this describes the problem; the error is only
+    // reported when the composite gate is used
+    utils::Str template_error;
+
     explicit Composite(const utils::Str &name);
     Composite(const utils::Str &name, const GateRefs &seq);
-    Instruction qasm() const override;
+    void append_qasm(utils::Str &buf) const override;
     GateType type() const override;
 };
 
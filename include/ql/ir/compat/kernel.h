@@ -8,6 +8,8 @@
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/opt.h"
+#include "ql/utils/tree.h"
+#include "ql/utils/arena.h"
 #include "ql/ir/compat/platform.h"
 #include "ql/ir/compat/gate.h"
 #include "ql/ir/compat/classical.h"
@@ -102,6 +104,15 @@ public: // FIXME: should be private
      */
     GateRefs gates;
 
+    /**
+     * Arena that the gates created by this kernel are allocated from, or empty
+     * to allocate them from the heap. Set at construction time based on the
+     * ir_arena option. The gates keep the arena alive, so its memory is
+     * released in bulk when the last of them is freed, normally when the old
+     * IR is discarded after conversion.
+     */
+    utils::ArenaRef gate_arena;
+
     /**
      * The classical control-flow behavior of this kernel.
      */
@@ -156,6 +167,19 @@ public:
     void set_condition(const ClassicalOperation &oper);
     void set_kernel_type(KernelType typ);
 
+    // returns a copy of this kernel with the given name and copies of its gates, in which the gates at the given
+    // indices have the corresponding angle substituted; only rx, ry, rz, and custom gates can be substituted
+    utils::One<Kernel> clone_with_angles(
+        const utils::Str &name,
+        const utils::Vec<utils::UInt> &gate_indices,
+        const utils::Vec<utils::Real> &angles
+    ) const;
+
+    // returns a copy of the given gate, allocated from gate_arena if there is one; passes modify gates in place,
+    // for example to set their cycle numbers, so kernels that are processed independently must not share gates;
+    // the sub-gates of a composite gate are not copied, as they are only used as decomposition templates
+    GateRef copy_gate(const Gate &gate) const;
+
     utils::Str get_gates_definition() const;
     utils::Str get_name() const;
 
@@ -192,6 +216,22 @@ public:
     void clifford(utils::Int id, utils::UInt qubit);
 
 private:
+    // construct a gate of the given type, allocated from gate_arena if there is one
+    template <class T, typename... Args>
+    utils::One<T> make_gate(Args&&... args) const {
+        if (gate_arena.has_value()) {
+            utils::UseArena use_arena{gate_arena};
+            return utils::make<T>(std::forward<Args>(args)...);
+        }
+        return utils::make<T>(std::forward<Args>(args)...);
+    }
+
+    // construct a gate of the given type and append it to the circuit
+    template <class T, typename... Args>
+    void add_gate(Args&&... args) {
+        gates.add(make_gate<T>(std::forward<Args>(args)...));
+    }
+
     // a default gate is the last resort of user gate resolution and is of a build-in form, as below in the code;
     // the "using_default_gates" option can be used to enable ("yes") or disable ("no") default gates;
     // the use of default gates is deprecated; use the .json configuration file instead to define custom gates;
@@ -223,13 +263,30 @@ private:
         const utils::Vec<utils::UInt> &gcondregs = {}
     );
 
-    // FIXME: move to class composite_gate?
-    // return the subinstructions of a composite gate
-    // while doing, test whether the subinstructions have a definition (so they cannot be specialized or default ones!)
-    void get_decomposed_ins(
+    // add a copy of the given custom gate to the circuit with the given operands
+    void add_custom_gate(
+        const gate_types::Custom &custom,
+        const utils::Vec<utils::UInt> &qubits,
+        const utils::Vec<utils::UInt> &cregs,
+        utils::UInt duration,
+        utils::Real angle,
+        const utils::Vec<utils::UInt> &bregs,
+        ConditionType gcond,
+        const utils::Vec<utils::UInt> &gcondregs
+    );
+
+    // add the sub-gates of the given composite gate to the circuit, using its pre-parsed decomposition template;
+    // if parameterized is set, the operand numbers of the template index into all_qubits, otherwise they are the
+    // qubits themselves
+    void add_decomposed_gate(
         const gate_types::Composite &gate,
-        utils::Vec<utils::Str> &sub_instructons
-    ) const;
+        utils::Bool parameterized,
+        const utils::Vec<utils::UInt> &all_qubits,
+        const utils::Vec<utils::UInt> &cregs,
+        const utils::Vec<utils::UInt> &bregs,
+        ConditionType gcond,
+        const utils::Vec<utils::UInt> &gcondregs
+    );
 
     // if specialized composed gate: "e.g. cz q0,q3" available, with composition of subinstructions, return true
     //      also check each subinstruction for presence as a custom_gate (or a default gate)
@@ -327,12 +384,45 @@ public:
         const utils::Vec<utils::UInt> &gcondregs = {}
     );
 
+    /**
+     * Returns the custom gate that gate() would add as-is for the given
+     * lowercase gate name and qubit operands, or nullptr if gate() would
+     * instead decompose it via a composite gate or fall back to a default
+     * gate. The result only depends on the platform, so callers that add many
+     * gates of the same shape (like the new-to-old IR conversion) can resolve
+     * it once and use custom_gate() from then on.
+     */
+    const gate_types::Custom *find_direct_custom_gate(
+        const utils::Str &gname,
+        const utils::Vec<utils::UInt> &qubits
+    ) const;
+
+    /**
+     * Equivalent to gate() for a custom gate that was resolved using
+     * find_direct_custom_gate(), skipping all name-based lookups.
+     */
+    void custom_gate(
+        const utils::Str &gname,
+        const gate_types::Custom &custom,
+        const utils::Vec<utils::UInt> &qubits,
+        const utils::Vec<utils::UInt> &cregs = {},
+        utils::UInt duration = 0,
+        utils::Real angle = 0.0,
+        const utils::Vec<utils::UInt> &bregs = {}
+    );
+
     /**
      * support function for Python conditional execution interfaces to pass condition
      */
     ConditionType condstr2condvalue(const std::string &condstring);
 
 private:
+    void gate_check_operands(
+        const utils::Str &gname,
+        const utils::Vec<utils::UInt> &qubits,
+        const utils::Vec<utils::UInt> &cregs,
+        const utils::Vec<utils::UInt> &bregs
+    ) const;
     void gate_add_implicits(
         const utils::Str &gname,
         utils::Vec<utils::UInt> &qubits,
@@ -352,6 +442,7 @@ public:
     // FIXME: create a separate QASM backend?
     utils::Str get_prologue() const;
     utils::Str get_epilogue() const;
+    void qasm(std::ostream &os) const;  // streaming variant, for large kernels
     utils::Str qasm() const;
 
     void classical(const ClassicalRegister &destination, const ClassicalOperation &oper);
@@ -403,6 +494,15 @@ using KernelRef = utils::One<Kernel>;
  */
 using KernelRefs = utils::Any<Kernel>;
 
+/**
+ * Makes the given kernel reference the only owner of its kernel, by replacing
+ * it with a copy if the kernel is also referenced from elsewhere, for example
+ * by a program that it was added to. Kernels are thus shared until they are
+ * modified. The copy also gets copies of the gates (see Kernel::copy_gate()),
+ * because passes modify gates in place. Returns the reference.
+ */
+KernelRef &make_mutable(KernelRef &kernel);
+
 } // namespace compat
 } // namespace ir
 } // namespace ql
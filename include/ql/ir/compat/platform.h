@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <memory>
+#include <unordered_map>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/opt.h"
@@ -21,6 +23,47 @@ using CustomGateRef = utils::One<gate_types::Custom>;
 
 using InstructionMap = utils::Map<utils::Str, CustomGateRef>;
 
+/**
+ * Hash function for qubit operand lists, used to index specialized
+ * instructions.
+ */
+struct QubitListHash {
+    std::size_t operator()(const utils::Vec<utils::UInt> &qubits) const {
+        std::size_t hash = qubits.size();
+        for (auto qubit : qubits) {
+            hash = hash * 31 + qubit;
+        }
+        return hash;
+    }
+};
+
+/**
+ * Entry in the hashed instruction index for a single instruction name.
+ */
+struct InstructionIndexEntry {
+
+    /**
+     * The generic instruction with this name, i.e. the instruction_map entry
+     * whose key is exactly the name, or an empty reference if there is none.
+     */
+    utils::Maybe<gate_types::Custom> generic;
+
+    /**
+     * The specialized instructions with this name, such as `"cz q0,q3"`,
+     * keyed by their qubit operands.
+     */
+    std::unordered_map<utils::Vec<utils::UInt>, CustomGateRef, QubitListHash> specialized;
+
+};
+
+/**
+ * Hashed index into an InstructionMap, keyed by instruction name. Every name
+ * that instruction_map defines anything for, be it a generic, specialized, or
+ * parameterized (composite) instruction, has an entry, even if it has neither
+ * a generic nor a specialized custom instruction.
+ */
+using InstructionIndex = std::unordered_map<utils::Str, InstructionIndexEntry>;
+
 class Platform;
 
 /**
@@ -39,11 +82,27 @@ using PlatformRef = utils::One<Platform>;
 class Platform : public utils::Node {
 private:
 
+    /**
+     * The *complete* platform configuration JSON, after preprocessing by the
+     * architecture. This is immutable after loading, so copies of the platform
+     * (as made by build() when the platform cache is enabled) share it rather
+     * than deep-copying the JSON tree.
+     */
+    std::shared_ptr<const utils::Json> platform_config;
+
     /**
      * Raw instruction setting data for use by the eQASM backend, corresponding
-     * to the `"instructions"` key in the root JSON object.
+     * to the `"instructions"` key in the root JSON object. Points into
+     * platform_config.
+     */
+    const utils::Json *instruction_settings;
+
+    /**
+     * Additional hardware settings (to use by the eqasm backend), corresponding
+     * to the `"hardware_settings"` key in the root JSON object. Points into
+     * platform_config.
      */
-    utils::Json instruction_settings;
+    const utils::Json *hardware_settings;
 
 public:
 
@@ -97,6 +156,12 @@ public:
      */
     InstructionMap instruction_map;
 
+    /**
+     * Hashed index into instruction_map, built by load(). Must be rebuilt with
+     * build_instruction_index() if instruction_map is modified afterwards.
+     */
+    InstructionIndex instruction_index;
+
     /**
      * Architecture information object.
      */
@@ -117,12 +182,6 @@ public:
      */
     utils::Json compiler_settings;
 
-    /**
-     * Additional hardware settings (to use by the eqasm backend), corresponding
-     * to the `"hardware_settings"` key in the root JSON object.
-     */
-    utils::Json hardware_settings;
-
     /**
      * Scheduling resource description (representing e.g. instrument/control
      * constraints), corresponding to the `"resources"` key in the root JSON
@@ -143,11 +202,6 @@ public:
      */
     utils::Opt<com::Topology> topology;
 
-    /**
-     * The *complete* platform configuration JSON.
-     */
-    utils::Json platform_config;
-
 public:
 
     /**
@@ -159,7 +213,8 @@ private:
 
     /**
      * Loads the platform members from the given JSON data and optional
-     * auxiliary compiler configuration file.
+     * auxiliary compiler configuration file. The JSON data is moved into the
+     * platform, leaving platform_cfg in a valid but unspecified state.
      */
     void load(
         utils::Json &platform_cfg,
@@ -167,6 +222,18 @@ private:
         const utils::Str &compiler_config = ""
     );
 
+    /**
+     * Loads the platform members that follow from the preprocessed platform
+     * configuration in platform_config: the hardware settings, the resources,
+     * the topology (unless it has already been set), and the instructions.
+     */
+    void load_preprocessed();
+
+    /**
+     * Constructs an empty platform, to be filled by read_snapshot().
+     */
+    explicit Platform(const utils::Str &name);
+
     /**
      * Constructs a platform from the given configuration filename.
      */
@@ -188,7 +255,10 @@ private:
 public:
 
     /**
-     * Constructs a platform from the given configuration filename.
+     * Constructs a platform from the given configuration filename. Unless the
+     * platform_cache global option is disabled, loaded platforms are cached
+     * for the lifetime of the process, so building a platform for the same
+     * configuration again only costs a copy.
      */
     static PlatformRef build(
         const utils::Str &name,
@@ -197,7 +267,8 @@ public:
     );
 
     /**
-     * Constructs a platform from the given configuration *data*.
+     * Constructs a platform from the given configuration *data*. This uses the
+     * same cache as the above.
      */
     static PlatformRef build(
         const utils::Str &name,
@@ -205,6 +276,62 @@ public:
         const utils::Str &compiler_config = ""
     );
 
+    /**
+     * Clears the cache used by build().
+     */
+    static void clear_build_cache();
+
+    /**
+     * Writes a snapshot of this platform to the given stream, in a versioned
+     * binary format. The snapshot contains the platform configuration as
+     * preprocessed and post-processed by the architecture, the compiler
+     * configuration, and the topology including the data derived from it
+     * (adjacency, edge maps, and distance matrix). Loading it thus avoids
+     * reading and preprocessing the configuration files and building the
+     * topology. The instructions are loaded from the stored configuration
+     * as usual. Snapshots are only readable by the OpenQL version that wrote
+     * them.
+     */
+    void write_snapshot(std::ostream &os) const;
+
+    /**
+     * Same as write_snapshot(), but writes to the given file. The file can
+     * be passed to build() in place of a platform configuration file.
+     */
+    void write_snapshot_file(const utils::Str &fname) const;
+
+    /**
+     * Returns whether the given buffer starts like a platform snapshot.
+     */
+    static utils::Bool is_snapshot(const char *data, utils::UInt size);
+
+    /**
+     * Returns a copy of this platform with the given couplers and all
+     * couplers of the given qubits disabled in its topology (see
+     * com::Topology::disable()), for compiling against a degraded device.
+     * Everything but the topology is shared with this platform, and the
+     * topology only repairs the distances that are affected, so this is much
+     * cheaper than building a platform from an edited configuration. This
+     * platform is not modified. Snapshots written for the returned platform
+     * contain the degraded topology.
+     */
+    PlatformRef derive_degraded(
+        const utils::Vec<com::Topology::QubitPair> &couplers,
+        const utils::Vec<com::Topology::Qubit> &qubits = {}
+    ) const;
+
+    /**
+     * Constructs a platform with the given name from the given snapshot
+     * buffer, which must contain exactly one snapshot. The buffer is only
+     * read from and not retained, so it may for instance be a memory-mapped
+     * file. This does not use the cache of build().
+     */
+    static PlatformRef read_snapshot(
+        const utils::Str &name,
+        const char *data,
+        utils::UInt size
+    );
+
     /**
      * Dumps some basic info about the platform to the given stream.
      */
@@ -227,11 +354,49 @@ public:
      */
     const utils::Json &get_instructions() const;
 
+    /**
+     * Returns the additional hardware settings (to use by the eqasm backend),
+     * corresponding to the `"hardware_settings"` key in the root JSON object.
+     */
+    const utils::Json &get_hardware_settings() const;
+
+    /**
+     * Returns the *complete* platform configuration JSON, after preprocessing
+     * by the architecture.
+     */
+    const utils::Json &get_platform_config() const;
+
     /**
      * Converts the given time in nanoseconds to cycles.
      */
     utils::UInt time_to_cycles(utils::Real time_ns) const;
 
+    /**
+     * (Re)builds instruction_index from instruction_map.
+     */
+    void build_instruction_index();
+
+    /**
+     * Returns the custom instruction to use for a gate with the given name and
+     * qubit operands: the specialized instruction for exactly these operands
+     * (e.g. `"cz q0,q3"`) if there is one, otherwise the generic instruction
+     * with the given name, otherwise null. This is equivalent to looking up
+     * the canonical specialized and generic names in instruction_map, but does
+     * not need to build any strings.
+     */
+    const gate_types::Custom *find_custom_gate(
+        const utils::Str &name,
+        const utils::Vec<utils::UInt> &qubits
+    ) const;
+
+    /**
+     * Returns whether instruction_map defines an instruction or decomposition
+     * by the given name (case-insensitive) for any operands. If not, no gate
+     * by this name can be made, except possibly a default gate. Used to avoid
+     * probing for optional variants like `<name>_prim` gate by gate.
+     */
+    utils::Bool has_instruction(const utils::Str &name) const;
+
 };
 
 } // namespace compat
@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <unordered_set>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
@@ -104,6 +105,12 @@ public:
      */
     void add(const KernelRef &k);
 
+    /**
+     * Adds the given kernels to the end of the program, after checking that
+     * they are all safe to add. If any of them is not, none of them are added.
+     */
+    void add_kernels(const KernelRefs &ks);
+
     /**
      * Adds the kernels in the given (sub)program to the end of this program,
      * checking for each kernel whether it's safe to add.
@@ -154,6 +161,32 @@ public:
      */
     void add_for(const ProgramRef &p, utils::UInt iterations);
 
+private:
+
+    /**
+     * Names of the first num_indexed_kernels kernels, used to check the
+     * uniqueness of kernel names without scanning all kernels. Kernels are
+     * only ever appended, but not all code does so through add(), so the
+     * index is brought up to date lazily by index_kernel_names().
+     */
+    std::unordered_set<utils::Str> kernel_names;
+
+    /**
+     * The number of kernels that have been added to kernel_names.
+     */
+    utils::UInt num_indexed_kernels = 0;
+
+    /**
+     * Brings kernel_names up to date with the kernels list.
+     */
+    void index_kernel_names();
+
+    /**
+     * Throws an exception if the given kernel cannot be added to this
+     * program. The name is not checked by this function.
+     */
+    void check_kernel(const KernelRef &k) const;
+
 };
 
 } // namespace compat
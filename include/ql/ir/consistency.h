@@ -9,6 +9,68 @@
 namespace ql {
 namespace ir {
 
+/**
+ * The amount of checking performed by check_consistency().
+ */
+enum class ConsistencyCheckLevel {
+
+    /**
+     * No checks are performed at all.
+     */
+    OFF,
+
+    /**
+     * The platform and the structure of the program are checked, but only a
+     * deterministic sample of the statements of each block is checked, and
+     * the well-formedness (link validity) of the tree is not checked.
+     */
+    SAMPLED,
+
+    /**
+     * Only the parts of the tree that have changed are checked. A changed
+     * platform is checked completely, including its well-formedness; a
+     * changed program is checked completely except for the well-formedness
+     * of the tree, as that can only be checked for the tree as a whole.
+     */
+    CHANGED,
+
+    /**
+     * The complete tree is checked.
+     */
+    FULL
+
+};
+
+/**
+ * The parts of the IR that are (potentially) changed since the previous
+ * consistency check, used by the CHANGED check level.
+ */
+enum class ChangedParts {
+
+    /**
+     * Only the platform has changed.
+     */
+    PLATFORM,
+
+    /**
+     * Only the program has changed.
+     */
+    PROGRAM,
+
+    /**
+     * The platform and the program have changed.
+     */
+    ALL
+
+};
+
+/**
+ * Returns the consistency check level configured via the
+ * `ir_consistency_check` global option. When debug logging is enabled, FULL is
+ * always returned.
+ */
+ConsistencyCheckLevel get_consistency_check_level();
+
 /**
  * Performs a consistency check of the IR. An exception is thrown if a problem
  * is found. The constraints checked by this must be met on any interface that
@@ -17,5 +79,16 @@ namespace ir {
  */
 void check_consistency(const Ref &ir);
 
+/**
+ * Same as check_consistency(ir), but only performs the amount of checking
+ * indicated by level. changed specifies which parts of the tree may have
+ * changed since they were last checked.
+ */
+void check_consistency(
+    const Ref &ir,
+    ConsistencyCheckLevel level,
+    ChangedParts changed = ChangedParts::ALL
+);
+
 } // namespace ir
 } // namespace ql
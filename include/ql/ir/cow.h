@@ -0,0 +1,51 @@
+/** \file
+ * Copy-on-write operations on the IR, for cheaply forking (parts of) a
+ * program and modifying the fork without affecting the original.
+ */
+
+#pragma once
+
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * Makes the node that the given edge (a One, Maybe, or element of an Any)
+ * refers to exclusively owned by it, by replacing it with a shallow copy if
+ * the node is also referenced from elsewhere. Nodes are copied at most once
+ * per fork: after this, the edge is the only owner, so subsequent calls are
+ * no-ops. The child edges of the copy still share their subtrees with the
+ * original, so to modify a node deep within a shared subtree, every node on
+ * the path to it must be made mutable top-down. Returns the edge.
+ *
+ * Links that referred to the original node are not updated, so this should
+ * not be used for nodes that links may refer to (objects, types, blocks),
+ * unless those links are relinked manually, like fork_program() does for
+ * blocks.
+ */
+template <class E>
+E &make_mutable(E &edge) {
+    if (!edge.empty() && edge.get_ptr().use_count() > 1) {
+        edge = edge.copy();
+    }
+    return edge;
+}
+
+/**
+ * Returns a fork of the given program that shares all statements with it.
+ * Only the program node and its blocks are copied, along with the goto
+ * instructions (and the structured statements containing them) that need to
+ * be relinked to the copied blocks, so this is linear in the number of
+ * blocks rather than in the size of the program. The statements of the fork
+ * must be made mutable with make_mutable() before being modified; adding,
+ * removing and reordering statements of a forked block is always safe.
+ *
+ * This makes speculative transformations affordable: fork the program, try
+ * the transformation on the fork, and then either assign the fork to the
+ * root node or just drop it.
+ */
+ProgramRef fork_program(const ProgramRef &program);
+
+} // namespace ir
+} // namespace ql
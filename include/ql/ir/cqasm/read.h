@@ -92,6 +92,8 @@ void read(
 
 /**
  * Same as read(), but given a file to load, rather than loading from a string.
+ * The file is parsed by libqasm directly, so no copy of the file contents is
+ * kept in memory.
  */
 void read_file(
     const Ref &ir,
@@ -99,6 +101,22 @@ void read_file(
     const ReadOptions &options = {}
 );
 
+/**
+ * Reads multiple cQASM 1.2 files concurrently, each into a new IR root that
+ * shares the platform of ir, using at most num_threads threads (0 means all
+ * hardware threads, subject to the num_threads global option). The analyzer
+ * is set up once per thread rather than once per file, and the platform is not
+ * modified. The load_platform option is not supported, as all files must use
+ * the same platform. If reading a file fails, an exception is rethrown once
+ * all threads are done.
+ */
+utils::Vec<Ref> read_files(
+    const Ref &ir,
+    const utils::Vec<utils::Str> &fnames,
+    const ReadOptions &options = {},
+    utils::UInt num_threads = 0
+);
+
 /**
  * Constructs a platform from the `@ql.platform` annotation in the given cQASM
  * file.
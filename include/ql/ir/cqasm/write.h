@@ -101,6 +101,14 @@ struct WriteOptions {
      */
     utils::Bool include_timing = true;
 
+    /**
+     * The number of threads used to print the blocks of the program. Each
+     * block is then printed into its own buffer, and the results are
+     * concatenated in order, so the output does not depend on this. 0 means
+     * use all hardware threads.
+     */
+    utils::UInt num_threads = 1;
+
 };
 
 /**
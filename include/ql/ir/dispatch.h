@@ -0,0 +1,94 @@
+/** \file
+ * Statically dispatched visitation of statement and expression nodes, using
+ * the node type enumeration generated by tree-gen.
+ */
+
+#pragma once
+
+#include <utility>
+#include "ql/utils/exception.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * Calls the overload of handler() for the concrete node type of the given
+ * statement, std::visit-style. Rather than going through a chain of virtual
+ * as_*() casts or the double dispatch of the generated Visitor classes, this
+ * makes a single virtual type() call and switches on the result, so the
+ * compiler can inline the handlers. The handler must be callable with a
+ * reference to each concrete statement type (a template operator() can be
+ * used as catch-all), and all overloads must have the same return type.
+ */
+template <class Handler>
+auto dispatch_statement(
+    Statement &statement,
+    Handler &&handler
+) -> decltype(handler(std::declval<CustomInstruction&>())) {
+    switch (statement.type()) {
+        case NodeType::CustomInstruction:
+            return handler(static_cast<CustomInstruction&>(statement));
+        case NodeType::SetInstruction:
+            return handler(static_cast<SetInstruction&>(statement));
+        case NodeType::GotoInstruction:
+            return handler(static_cast<GotoInstruction&>(statement));
+        case NodeType::WaitInstruction:
+            return handler(static_cast<WaitInstruction&>(statement));
+        case NodeType::IfElse:
+            return handler(static_cast<IfElse&>(statement));
+        case NodeType::StaticLoop:
+            return handler(static_cast<StaticLoop&>(statement));
+        case NodeType::ForLoop:
+            return handler(static_cast<ForLoop&>(statement));
+        case NodeType::RepeatUntilLoop:
+            return handler(static_cast<RepeatUntilLoop&>(statement));
+        case NodeType::BreakStatement:
+            return handler(static_cast<BreakStatement&>(statement));
+        case NodeType::ContinueStatement:
+            return handler(static_cast<ContinueStatement&>(statement));
+        case NodeType::SentinelStatement:
+            return handler(static_cast<SentinelStatement&>(statement));
+        default:
+            break;
+    }
+    QL_ICE("unknown statement node type");
+}
+
+/**
+ * Same as dispatch_statement(), but for expressions.
+ */
+template <class Handler>
+auto dispatch_expression(
+    Expression &expression,
+    Handler &&handler
+) -> decltype(handler(std::declval<Reference&>())) {
+    switch (expression.type()) {
+        case NodeType::Reference:
+            return handler(static_cast<Reference&>(expression));
+        case NodeType::FunctionCall:
+            return handler(static_cast<FunctionCall&>(expression));
+        case NodeType::BitLiteral:
+            return handler(static_cast<BitLiteral&>(expression));
+        case NodeType::IntLiteral:
+            return handler(static_cast<IntLiteral&>(expression));
+        case NodeType::RealLiteral:
+            return handler(static_cast<RealLiteral&>(expression));
+        case NodeType::ComplexLiteral:
+            return handler(static_cast<ComplexLiteral&>(expression));
+        case NodeType::RealMatrixLiteral:
+            return handler(static_cast<RealMatrixLiteral&>(expression));
+        case NodeType::ComplexMatrixLiteral:
+            return handler(static_cast<ComplexMatrixLiteral&>(expression));
+        case NodeType::StringLiteral:
+            return handler(static_cast<StringLiteral&>(expression));
+        case NodeType::JsonLiteral:
+            return handler(static_cast<JsonLiteral&>(expression));
+        default:
+            break;
+    }
+    QL_ICE("unknown expression node type");
+}
+
+} // namespace ir
+} // namespace ql
@@ -0,0 +1,65 @@
+/** \file
+ * Defines a mark-and-sweep garbage collector that removes unused temporary
+ * objects and generated instruction types from the IR.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * The amount of garbage removed by collect_garbage().
+ */
+struct GarbageStats {
+
+    /**
+     * The number of temporary objects removed from the program.
+     */
+    utils::UInt temporaries = 0;
+
+    /**
+     * The number of generated instruction types removed from the platform,
+     * including their specializations.
+     */
+    utils::UInt instruction_types = 0;
+
+};
+
+/**
+ * Returns the number of entries in the IR that the garbage collector could
+ * remove if they are unused: the temporary objects of the program and the
+ * generated instruction types of the platform (see GeneratedInstructionType).
+ * This does not traverse the program, so it is cheap enough to call after
+ * every pass.
+ */
+utils::UInt count_garbage_candidates(const Ref &ir);
+
+/**
+ * Removes all temporary objects of the program that are not referenced, and
+ * all generated instruction types of the platform that are not used by any
+ * instruction and none of whose specializations are used, from the IR. Uses
+ * are found by traversing the entire IR, including the decomposition rules of
+ * the platform; links held by annotations are not considered, so annotations
+ * that refer to objects or instruction types must not outlive the pass that
+ * made them. Objects and instruction types defined by the platform or the
+ * user are never removed. The instruction type indices are rebuilt if
+ * anything was removed.
+ */
+GarbageStats collect_garbage(const Ref &ir);
+
+/**
+ * Runs collect_garbage() only when the number of garbage candidates exceeds
+ * the number that survived the previous collection by at least threshold,
+ * such that the cost of traversing the IR is amortized over the garbage it
+ * can remove. The number of survivors is recorded in an annotation on the
+ * platform node, and is zero before the first collection. A threshold of zero disables the
+ * collector. Returns whether a collection was performed.
+ */
+utils::Bool collect_garbage_if_needed(const Ref &ir, utils::UInt threshold);
+
+} // namespace ir
+} // namespace ql
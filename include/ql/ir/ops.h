@@ -99,13 +99,55 @@ InstructionTypeLink add_instruction_type(
     const utils::Any<Expression> &template_operands = {}
 );
 
+/**
+ * Starts adding instruction types to the platform in bulk. Until
+ * end_bulk_instruction_types() is called, new generalized instruction types are
+ * appended to the instruction list of the platform rather than inserted in
+ * sort order, so building a platform with many instruction types doesn't take
+ * quadratic time. Lookups via find_instruction_type() and friends are not
+ * affected, but the instruction list itself must not be assumed to be sorted
+ * until bulk mode ends.
+ */
+void begin_bulk_instruction_types(const Ref &ir);
+
+/**
+ * Ends adding instruction types to the platform in bulk, sorting the
+ * instruction types that were added since begin_bulk_instruction_types() into
+ * place and indexing them. No-op if bulk mode is not active.
+ */
+void end_bulk_instruction_types(const Ref &ir);
+
+/**
+ * Brings all lookup indices for the instruction types of the platform up to
+ * date, such that subsequent lookups that don't add anything also don't modify
+ * the IR. This must be called before looking up instruction types or
+ * specializing instructions from multiple threads concurrently.
+ */
+void index_instruction_types(const Ref &ir);
+
+/**
+ * Discards and rebuilds all lookup indices for the instruction types of the
+ * platform. The indices only pick up instruction types that are added, so this
+ * must be called after removing instruction types or specializations.
+ */
+void reindex_instruction_types(const Ref &ir);
+
+/**
+ * Annotation placed on instruction types that find_instruction_type()
+ * generated as overloads, as opposed to the instruction types defined by the
+ * platform. Only these may be removed by the garbage collector when they are
+ * no longer used.
+ */
+struct GeneratedInstructionType {};
+
 /**
  * Finds an instruction type based on its name, operand types, and writability
  * of each operand. If generate_overload_if_needed is set, and no instruction
  * with the given name and operand type set exists, then an overload is
  * generated for the first instruction type for which only the name matches, and
- * that overload is returned. If no matching instruction type is found or was
- * created, an empty link is returned.
+ * that overload is returned. Generated overloads carry the
+ * GeneratedInstructionType annotation. If no matching instruction type is
+ * found or was created, an empty link is returned.
  */
 InstructionTypeLink find_instruction_type(
     const Ref &ir,
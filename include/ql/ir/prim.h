@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <array>
+#include <memory>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
@@ -538,6 +540,78 @@ template <>
 ResourceManager deserialize(const utils::tree::cbor::MapReader &map);
 std::ostream &operator<<(std::ostream &os, const ResourceManager &top);
 
+
+/**
+ * Inline storage for a fixed number of well-known annotations, used to avoid
+ * the type-keyed map lookup of tree-gen's generic annotation mechanism for
+ * annotations that are queried in hot loops. Which annotation type lives in
+ * which slot is registered through ir::AnnotationSlot (see ql/ir/slots.h);
+ * use the accessor functions defined there rather than this class directly.
+ *
+ * Like generic annotations, slots are not part of the tree proper: they are
+ * ignored for equality, they are not serialized, and copying a node copies
+ * the (shared) pointers to the annotation objects.
+ */
+class AnnotationSlots {
+public:
+
+    /**
+     * The number of slots per node.
+     */
+    static constexpr utils::UInt SIZE = 2;
+
+private:
+
+    /**
+     * The type-erased annotation objects, or null for empty slots.
+     */
+    std::array<std::shared_ptr<void>, SIZE> slots;
+
+public:
+
+    /**
+     * Returns the annotation object in the given slot, or nullptr if there is
+     * none.
+     */
+    void *get(utils::UInt index) const {
+        return slots[index].get();
+    }
+
+    /**
+     * Sets the annotation object in the given slot.
+     */
+    void set(utils::UInt index, std::shared_ptr<void> &&object) {
+        slots[index] = std::move(object);
+    }
+
+    /**
+     * Clears the given slot.
+     */
+    void erase(utils::UInt index) {
+        slots[index].reset();
+    }
+
+    /**
+     * Annotations do not contribute to equality.
+     */
+    utils::Bool operator==(const AnnotationSlots &rhs) const {
+        return true;
+    }
+
+    /**
+     * Annotations do not contribute to equality.
+     */
+    utils::Bool operator!=(const AnnotationSlots &rhs) const {
+        return false;
+    }
+
+};
+template <>
+void serialize(const AnnotationSlots &obj, utils::tree::cbor::MapWriter &map);
+template <>
+AnnotationSlots deserialize(const utils::tree::cbor::MapReader &map);
+std::ostream &operator<<(std::ostream &os, const AnnotationSlots &slots);
+
 } // namespace prim
 } // namespace ir
 } // namespace ql
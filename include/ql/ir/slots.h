@@ -0,0 +1,141 @@
+/** \file
+ * Defines the registry of fixed annotation slots on IR nodes, and accessors
+ * that use them when available, falling back to tree-gen's generic
+ * annotation mechanism otherwise.
+ */
+
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include "ql/utils/num.h"
+#include "ql/utils/exception.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * The slot indices in use. Statement and BlockBase nodes each have their own
+ * prim::AnnotationSlots, so the indices only need to be unique per node kind.
+ * Increase prim::AnnotationSlots::SIZE when adding more.
+ */
+namespace slot {
+
+/**
+ * Statement slot for com::ddg::NodeRef.
+ */
+constexpr utils::UInt DDG_NODE = 0;
+
+/**
+ * Statement slot for com::sch::DeepCriticality.
+ */
+constexpr utils::UInt DEEP_CRITICALITY = 1;
+
+/**
+ * BlockBase slot for com::ddg::Graph.
+ */
+constexpr utils::UInt DDG_GRAPH = 0;
+
+/**
+ * BlockBase slot for com::cfg::NodeRef.
+ */
+constexpr utils::UInt CFG_NODE = 1;
+
+} // namespace slot
+
+/**
+ * Registry of annotation types stored in a fixed slot. The default
+ * specialization indicates that annotations of type T are stored using the
+ * generic annotation mechanism. To register a type, specialize this template
+ * in the header that defines it, with Owner set to the node class that holds
+ * the slots (Statement or BlockBase), and INDEX set to the slot index from the
+ * slot namespace.
+ */
+template <class T>
+struct AnnotationSlot {
+    using Owner = void;
+    static constexpr utils::UInt INDEX = 0;
+};
+
+/**
+ * Whether annotations of type T on nodes of type N are stored in a slot.
+ */
+template <class T, class N>
+struct UsesAnnotationSlot : std::is_base_of<
+    typename AnnotationSlot<T>::Owner,
+    typename std::remove_const<N>::type
+> {};
+
+/**
+ * Returns a pointer to the annotation of type T on the given node, or nullptr
+ * if there is none. Drop-in replacement for node.get_annotation_ptr<T>().
+ */
+template <class T, class N>
+typename std::enable_if<UsesAnnotationSlot<T, N>::value, T*>::type
+get_annotation_ptr(N &node) {
+    return static_cast<T*>(node.slots.get(AnnotationSlot<T>::INDEX));
+}
+
+template <class T, class N>
+typename std::enable_if<!UsesAnnotationSlot<T, N>::value, T*>::type
+get_annotation_ptr(N &node) {
+    return const_cast<T*>(node.template get_annotation_ptr<T>());
+}
+
+/**
+ * Returns whether the given node has an annotation of type T. Drop-in
+ * replacement for node.has_annotation<T>().
+ */
+template <class T, class N>
+utils::Bool has_annotation(N &node) {
+    return get_annotation_ptr<T>(node) != nullptr;
+}
+
+/**
+ * Returns a reference to the annotation of type T on the given node, throwing
+ * an exception if there is none. Drop-in replacement for
+ * node.get_annotation<T>().
+ */
+template <class T, class N>
+T &get_annotation(N &node) {
+    if (auto ptr = get_annotation_ptr<T>(node)) {
+        return *ptr;
+    }
+    throw utils::Exception("object does not have an annotation of this type");
+}
+
+/**
+ * Sets the annotation of type T on the given node, replacing any previous
+ * one. Drop-in replacement for node.set_annotation<T>(value).
+ */
+template <class T, class N>
+typename std::enable_if<UsesAnnotationSlot<T, N>::value>::type
+set_annotation(N &node, T value) {
+    node.slots.set(AnnotationSlot<T>::INDEX, std::make_shared<T>(std::move(value)));
+}
+
+template <class T, class N>
+typename std::enable_if<!UsesAnnotationSlot<T, N>::value>::type
+set_annotation(N &node, T value) {
+    node.template set_annotation<T>(std::move(value));
+}
+
+/**
+ * Removes the annotation of type T from the given node, if any. Drop-in
+ * replacement for node.erase_annotation<T>().
+ */
+template <class T, class N>
+typename std::enable_if<UsesAnnotationSlot<T, N>::value>::type
+erase_annotation(N &node) {
+    node.slots.erase(AnnotationSlot<T>::INDEX);
+}
+
+template <class T, class N>
+typename std::enable_if<!UsesAnnotationSlot<T, N>::value>::type
+erase_annotation(N &node) {
+    node.template erase_annotation<T>();
+}
+
+} // namespace ir
+} // namespace ql
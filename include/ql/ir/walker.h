@@ -0,0 +1,140 @@
+/** \file
+ * Defines StatementWalker, a statically dispatched traversal of the
+ * instructions in a block and its sub-blocks.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/exception.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/dispatch.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * CRTP base class for hot traversals over all instructions in a block,
+ * including those in structured control-flow sub-blocks and the initialize
+ * and update statements of for loops. Derived must define
+ *
+ *     void on_instruction(const InstructionRef &instruction);
+ *
+ * and may define
+ *
+ *     void on_block(const BlockBaseRef &block);
+ *
+ * to intercept the traversal of sub-blocks; the default calls walk_block().
+ * Both are called without virtual dispatch, so they must be accessible to
+ * this class, and the only dynamic dispatch left per statement is the type()
+ * call of dispatch_statement(). The statements of a block are iterated in
+ * storage order, prefetching the node of the next statement while the
+ * current one is handled.
+ */
+template <class Derived>
+class StatementWalker {
+private:
+
+    /**
+     * Returns a reference to the derived class.
+     */
+    Derived &derived() {
+        return static_cast<Derived&>(*this);
+    }
+
+    /**
+     * Hints to the processor that the given node will be accessed soon.
+     */
+    static void prefetch(const void *ptr) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(ptr);
+#else
+        (void)ptr;
+#endif
+    }
+
+    /**
+     * Handler for dispatch_statement().
+     */
+    struct Visit {
+        Derived &self;
+        const StatementRef &statement;
+
+        void operator()(Instruction &) {
+            self.on_instruction(
+                InstructionRef(std::static_pointer_cast<Instruction>(statement.get_ptr()))
+            );
+        }
+
+        void operator()(IfElse &if_else) {
+            for (const auto &branch : if_else.branches) {
+                self.on_block(branch->body);
+            }
+            if (!if_else.otherwise.empty()) {
+                self.on_block(if_else.otherwise);
+            }
+        }
+
+        void operator()(StaticLoop &static_loop) {
+            self.on_block(static_loop.body);
+        }
+
+        void operator()(ForLoop &for_loop) {
+            if (!for_loop.initialize.empty()) {
+                self.on_instruction(for_loop.initialize);
+            }
+            if (!for_loop.update.empty()) {
+                self.on_instruction(for_loop.update);
+            }
+            self.on_block(for_loop.body);
+        }
+
+        void operator()(RepeatUntilLoop &repeat_until) {
+            self.on_block(repeat_until.body);
+        }
+
+        void operator()(LoopControlStatement &) {
+            // no-op.
+        }
+
+        void operator()(SentinelStatement &) {
+            QL_ASSERT(false);
+        }
+    };
+
+public:
+
+    /**
+     * Default handler for sub-blocks, which just walks them.
+     */
+    void on_block(const BlockBaseRef &block) {
+        walk_block(block);
+    }
+
+    /**
+     * Walks the given statement. The instruction is passed to
+     * on_instruction() using a static cast of the existing edge, rather than
+     * a dynamic one.
+     */
+    void walk_statement(const StatementRef &statement) {
+        dispatch_statement(*statement, Visit{derived(), statement});
+    }
+
+    /**
+     * Walks all statements in the given block.
+     */
+    void walk_block(const BlockBaseRef &block) {
+        const auto &statements = block->statements;
+        utils::UInt size = statements.size();
+        for (utils::UInt i = 0; i < size; i++) {
+            if (i + 1 < size) {
+                prefetch(statements[i + 1].get_ptr().get());
+            }
+            walk_statement(statements[i]);
+        }
+    }
+
+};
+
+} // namespace ir
+} // namespace ql
@@ -4,8 +4,11 @@
 
 #pragma once
 
+#include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/list.h"
+#include "ql/utils/intern.h"
+#include "ql/utils/json.h"
 #include "ql/ir/ir.h"
 #include "ql/ir/compat/compat.h"
 
@@ -19,13 +22,134 @@ namespace statistics {
  * statistics to the program and/or kernel nodes. These will then be printed
  * and removed by the next statistics reporting pass, or discarded by a
  * statistics cleaning pass.
+ *
+ * Besides free-form lines, passes can record typed numeric statistics:
+ * counters, gauges, and timers, keyed by interned name. These are only
+ * converted to text (or JSON) when the statistics are reported, so they are
+ * cheap enough to update from within hot loops; the reference returned by
+ * counter(), gauge(), or timer() remains valid until the statistics are
+ * popped.
  */
 struct AdditionalStats {
 
     /**
-     * Additional lines for the statistics report.
+     * The kind of a statistic.
      */
-    utils::List<utils::Str> stats;
+    enum class Kind {
+
+        /**
+         * A free-form line of text.
+         */
+        LINE,
+
+        /**
+         * An integer that is incremented as events occur.
+         */
+        COUNTER,
+
+        /**
+         * A real number that reflects the last recorded value.
+         */
+        GAUGE,
+
+        /**
+         * An accumulated amount of time, in seconds.
+         */
+        TIMER
+
+    };
+
+    /**
+     * A single statistic.
+     */
+    struct Entry {
+
+        /**
+         * The kind of statistic.
+         */
+        Kind kind;
+
+        /**
+         * The name of a typed statistic.
+         */
+        utils::InternedStr name;
+
+        /**
+         * The text of a free-form line. Lines are not interned, as they
+         * usually differ from each other.
+         */
+        utils::Str line;
+
+        /**
+         * The value of a counter.
+         */
+        utils::Int count;
+
+        /**
+         * The value of a gauge or timer.
+         */
+        utils::Real value;
+
+        /**
+         * Renders the statistic as a line for the report.
+         */
+        utils::Str to_string() const;
+
+    };
+
+    /**
+     * The statistics, in the order in which they were first recorded.
+     */
+    utils::List<Entry> entries;
+
+    /**
+     * Returns a reference to the value of the counter with the given name,
+     * creating it with value zero if it doesn't exist yet.
+     */
+    utils::Int &counter(const utils::InternedStr &name);
+
+    /**
+     * Returns a reference to the value of the gauge with the given name,
+     * creating it with value zero if it doesn't exist yet.
+     */
+    utils::Real &gauge(const utils::InternedStr &name);
+
+    /**
+     * Returns a reference to the number of seconds accumulated by the timer
+     * with the given name, creating it with value zero if it doesn't exist
+     * yet.
+     */
+    utils::Real &timer(const utils::InternedStr &name);
+
+    /**
+     * Converts the typed statistics to a JSON object mapping their names to
+     * their values. Free-form lines are listed in the "lines" array.
+     */
+    utils::Json to_json() const;
+
+    /**
+     * Returns the statistics attached to the given block node, attaching an
+     * empty set of statistics first if there are none yet.
+     */
+    static AdditionalStats &get(const ir::BlockRef &block);
+
+    /**
+     * Returns the statistics attached to the given program node, attaching
+     * an empty set of statistics first if there are none yet.
+     */
+    static AdditionalStats &get(const ir::ProgramRef &program);
+
+    /**
+     * Returns the statistics attached to the given kernel node, attaching an
+     * empty set of statistics first if there are none yet.
+     */
+    static AdditionalStats &get(const ir::compat::KernelRef &kernel);
+
+    /**
+     * Returns the statistics attached to the given program node, attaching
+     * an empty set of statistics first if there are none yet.
+     */
+    static AdditionalStats &get(const ir::compat::ProgramRef &program);
 
     /**
      * Attaches a statistic to the given block node.
@@ -48,15 +172,29 @@ struct AdditionalStats {
     static void push(const ir::compat::ProgramRef &program, const utils::Str &line);
 
     /**
-     * Pops all statistics annotations from the given kernel.
+     * Pops all statistics annotations from the given kernel, rendering the
+     * typed statistics to lines of text.
      */
     static utils::List<utils::Str> pop(const ir::BlockRef &block);
 
     /**
-     * Pops all statistics annotations from the given program.
+     * Pops all statistics annotations from the given program, rendering the
+     * typed statistics to lines of text.
      */
     static utils::List<utils::Str> pop(const ir::ProgramRef &program);
 
+    /**
+     * Returns the statistics attached to the given kernel as JSON, without
+     * removing them.
+     */
+    static utils::Json peek_json(const ir::BlockRef &block);
+
+    /**
+     * Returns the statistics attached to the given program as JSON, without
+     * removing them.
+     */
+    static utils::Json peek_json(const ir::ProgramRef &program);
+
 };
 
 } // namespace statistics
@@ -37,12 +37,14 @@ void dump(
 
 /**
  * Dumps statistics for the given program and its top-level blocks to the given
- * output stream.
+ * output stream. The statistics of the blocks are computed using up to
+ * num_threads threads (0 means use all hardware threads).
  */
 void dump_all(
     const ir::Ref &ir,
     std::ostream &os = std::cout,
-    const utils::Str &line_prefix = ""
+    const utils::Str &line_prefix = "",
+    utils::UInt num_threads = 1
 );
 
 /**
@@ -66,6 +68,12 @@ public:
      */
     utils::Str get_friendly_type() const override;
 
+    /**
+     * Returns the products of the statistics reporter: the report files, and
+     * the statistics reported in them.
+     */
+    pmgr::Products get_products() const override;
+
     /**
      * Constructs a statistics reporter.
      */
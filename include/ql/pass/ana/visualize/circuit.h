@@ -33,6 +33,12 @@ public:
      */
     utils::Str get_friendly_type() const override;
 
+    /**
+     * Returns the products of the circuit visualizer: a window in interactive
+     * mode, or an image file otherwise.
+     */
+    pmgr::Products get_products() const override;
+
     /**
      * Constructs a circuit visualizer pass.
      */
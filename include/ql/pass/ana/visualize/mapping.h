@@ -33,6 +33,12 @@ public:
      */
     utils::Str get_friendly_type() const override;
 
+    /**
+     * Returns the products of the mapping graph visualizer: a window in interactive
+     * mode, or an image file otherwise.
+     */
+    pmgr::Products get_products() const override;
+
     /**
      * Constructs a mapping graph visualizer pass.
      */
@@ -51,7 +51,7 @@ private:
         const ir::Ref &ir,
         const ir::BlockBaseRef &block,
         utils::Bool ignore_schedule,
-        const com::dec::RulePredicate &predicate
+        com::dec::DecompositionRuleTable &rules
     );
 
 public:
@@ -35,6 +35,12 @@ public:
      */
     utils::Str get_friendly_type() const override;
 
+    /**
+     * Returns the products of the cQASM writer: the output file, and the
+     * statistics reported in it if enabled.
+     */
+    pmgr::Products get_products() const override;
+
     /**
      * Constructs a cQASM writer.
      */
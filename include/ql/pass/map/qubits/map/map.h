@@ -39,6 +39,14 @@ protected:
         const utils::Str &line_prefix
     ) const override;
 
+    /**
+     * Returns whether the result of the mapper may be restored from the pass
+     * cache. This is the case when all tie-breaking and path selection is
+     * deterministic, the MIP placer (which has a time limit) is disabled, and
+     * no output files are to be written.
+     */
+    utils::Bool is_cacheable() const override;
+
 public:
 
     /**
@@ -25,7 +25,7 @@ void clifford_optimize(
 /**
  * Clifford optimizer pass.
  */
-class CliffordOptimizePass : public pmgr::pass_types::KernelTransformation {
+class CliffordOptimizePass : public pmgr::pass_types::Transformation {
 protected:
 
     /**
@@ -56,8 +56,7 @@ public:
      * Runs the Clifford optimizer.
      */
     utils::Int run(
-        const ir::compat::ProgramRef &program,
-        const ir::compat::KernelRef &kernel,
+        const ir::Ref &ir,
         const pmgr::pass_types::Context &context
     ) const override;
 
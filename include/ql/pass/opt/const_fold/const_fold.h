@@ -0,0 +1,62 @@
+/** \file
+ * Defines the classical constant folding pass.
+ */
+
+#pragma once
+
+#include "ql/pmgr/pass_types/specializations.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace const_fold {
+
+/**
+ * Classical constant folding, propagation, and strength reduction pass.
+ */
+class ConstFoldPass : public pmgr::pass_types::Transformation {
+protected:
+
+    /**
+     * Dumps docs for the constant folding pass.
+     */
+    void dump_docs(
+        std::ostream &os,
+        const utils::Str &line_prefix
+    ) const override;
+
+public:
+
+    /**
+     * Returns a user-friendly type name for this pass.
+     */
+    utils::Str get_friendly_type() const override;
+
+    /**
+     * Constructs a constant folding pass.
+     */
+    ConstFoldPass(
+        const utils::Ptr<const pmgr::Factory> &pass_factory,
+        const utils::Str &instance_name,
+        const utils::Str &type_name
+    );
+
+    /**
+     * Runs the constant folding pass.
+     */
+    utils::Int run(
+        const ir::Ref &ir,
+        const pmgr::pass_types::Context &context
+    ) const override;
+
+};
+
+/**
+ * Shorthand for referring to the pass using namespace notation.
+ */
+using Pass = ConstFoldPass;
+
+} // namespace const_fold
+} // namespace opt
+} // namespace pass
+} // namespace ql
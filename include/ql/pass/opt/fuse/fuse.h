@@ -0,0 +1,77 @@
+/** \file
+ * Defines the single-qubit gate fusion pass.
+ */
+
+#pragma once
+
+#include "ql/pmgr/pass_types/specializations.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace fuse {
+
+/**
+ * Single-qubit gate fusion and resynthesis pass.
+ */
+class FusePass : public pmgr::pass_types::Transformation {
+protected:
+
+    /**
+     * Dumps docs for the gate fusion pass.
+     */
+    void dump_docs(
+        std::ostream &os,
+        const utils::Str &line_prefix
+    ) const override;
+
+public:
+
+    /**
+     * Returns a user-friendly type name for this pass.
+     */
+    utils::Str get_friendly_type() const override;
+
+    /**
+     * Constructs a gate fusion pass.
+     */
+    FusePass(
+        const utils::Ptr<const pmgr::Factory> &pass_factory,
+        const utils::Str &instance_name,
+        const utils::Str &type_name
+    );
+
+private:
+
+    /**
+     * Fuses single-qubit gates in the given block and (recursively) its
+     * structured control-flow sub-blocks. Returns by how many statements the
+     * blocks shrunk.
+     */
+    static utils::UInt run_on_block(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block,
+        const pmgr::pass_types::Context &context
+    );
+
+public:
+
+    /**
+     * Runs the gate fusion pass.
+     */
+    utils::Int run(
+        const ir::Ref &ir,
+        const pmgr::pass_types::Context &context
+    ) const override;
+
+};
+
+/**
+ * Shorthand for referring to the pass using namespace notation.
+ */
+using Pass = FusePass;
+
+} // namespace fuse
+} // namespace opt
+} // namespace pass
+} // namespace ql
@@ -25,6 +25,13 @@ protected:
         const utils::Str &line_prefix
     ) const override;
 
+    /**
+     * Returns whether the result of the scheduler may be restored from the
+     * pass cache, which is the case unless it is configured to write output
+     * files.
+     */
+    utils::Bool is_cacheable() const override;
+
 public:
 
     /**
@@ -44,13 +51,90 @@ public:
 private:
 
     /**
-     * Runs the scheduler on the given block.
+     * A block to be scheduled, along with its uniquified name.
      */
-    static void run_on_block(
-        const ir::Ref &ir,
+    struct BlockTask {
+        ir::BlockBaseRef block;
+        utils::Str name;
+    };
+
+    /**
+     * Appends the given block and (recursively) its structured control-flow
+     * sub-blocks to the given task list, after giving them a unique name. The
+     * sub-blocks are appended after their parent block.
+     */
+    static void gather_blocks(
         const ir::BlockBaseRef &block,
         const utils::Str &name_path,
         utils::Set<utils::Str> &used_names,
+        utils::List<BlockTask> &tasks
+    );
+
+    /**
+     * Runs the scheduler on the given block in consecutive windows of the given
+     * number of statements, for ASAP scheduling of very long blocks. This does
+     * not recurse into sub-blocks. Resource statistics are only written if
+     * write_outputs is set.
+     */
+    static void run_windowed_on_block(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block,
+        const utils::Str &name,
+        utils::UInt window_size,
+        const pmgr::pass_types::Context &context,
+        utils::Bool write_outputs
+    );
+
+    /**
+     * Runs the scheduler on the given block for ASAP scheduling on a
+     * multi-core platform, scheduling the statements local to each core
+     * concurrently. This does not recurse into sub-blocks. Resource statistics
+     * are only written if write_outputs is set.
+     */
+    static void run_core_partitioned_on_block(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block,
+        const utils::Str &name,
+        const pmgr::pass_types::Context &context,
+        utils::Bool write_outputs
+    );
+
+    /**
+     * Runs the scheduler on the given block. This does not recurse into
+     * sub-blocks. The requested dot graphs and resource statistics are only
+     * written if write_outputs is set.
+     */
+    static void run_on_block(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block,
+        const utils::Str &name,
+        const pmgr::pass_types::Context &context,
+        utils::Bool write_outputs = true
+    );
+
+    /**
+     * Tries to overlap the tail of the given block with the head of its
+     * successor, both of which must already have been scheduled, by
+     * scheduling their statements together and moving the statements of the
+     * successor that end up starting before the block is done into the block.
+     * The blocks are left unchanged if this does not reduce their combined
+     * duration.
+     */
+    static void overlap_blocks(
+        const ir::Ref &ir,
+        const ir::BlockRef &block,
+        const ir::BlockRef &successor,
+        const pmgr::pass_types::Context &context
+    );
+
+    /**
+     * Overlaps every program block with its successor for cross-block
+     * scheduling, where the control flow permits this: the block must
+     * unconditionally continue with the successor, and the successor must
+     * not be reachable in any other way.
+     */
+    static void run_cross_block(
+        const ir::Ref &ir,
         const pmgr::pass_types::Context &context
     );
 
@@ -0,0 +1,74 @@
+/** \file
+ * Pass group that runs alternative strategies and keeps the best result.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/ptr.h"
+#include "ql/pmgr/declarations.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * A group of alternative strategies for the same part of the compilation
+ * process. Each alternative is run on its own copy of the IR, after which the
+ * copy that scores best according to the configured metric is kept.
+ */
+class Alternatives : public pass_types::Base {
+protected:
+
+    /**
+     * Writes the documentation for this pass group to the given stream.
+     */
+    void dump_docs(
+        std::ostream &os,
+        const utils::Str &line_prefix
+    ) const override;
+
+    /**
+     * Builds the alternatives from the pass_type and alternatives options.
+     */
+    pass_types::NodeType on_construct(
+        const utils::Ptr<const Factory> &factory,
+        utils::List<PassRef> &passes,
+        condition::Ref &condition
+    ) override;
+
+    /**
+     * Scores a copy of the IR after one of the alternatives has been run on
+     * it. Lower is better.
+     */
+    utils::Int run_internal(
+        const ir::Ref &ir,
+        const pass_types::Context &context
+    ) const override;
+
+    /**
+     * Returns the value of the alternative_threads option.
+     */
+    utils::UInt get_num_alternative_threads() const override;
+
+public:
+
+    /**
+     * Returns a user-friendly type name for this pass.
+     */
+    utils::Str get_friendly_type() const override;
+
+    /**
+     * Constructs the pass group.
+     */
+    Alternatives(
+        const utils::Ptr<const Factory> &pass_factory,
+        const utils::Str &instance_name,
+        const utils::Str &type_name
+    );
+
+};
+
+} // namespace pmgr
+} // namespace ql
@@ -0,0 +1,65 @@
+/** \file
+ * Defines the analyses that the pass manager tracks as annotations on the IR,
+ * and how to free them.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Bit mask of analyses that store their results as annotations on the IR.
+ * Passes declare which of these remain valid after they run (see
+ * pass_types::Base::get_preserved_analyses()), and the pass manager frees the
+ * others, so dead analysis data doesn't accumulate in the IR from pass to
+ * pass.
+ *
+ * AdditionalStats are deliberately not an analysis in this sense: they are
+ * the means by which passes pass statistics on to the statistics reporting
+ * passes, which free them when they're reported or cleaned.
+ */
+using Analyses = utils::UInt;
+
+namespace analysis {
+
+/**
+ * No analyses.
+ */
+constexpr Analyses NONE = 0;
+
+/**
+ * Data dependency graphs (see ql/com/ddg), annotated on blocks and their
+ * statements.
+ */
+constexpr Analyses DDG = 1;
+
+/**
+ * Deep criticality (see com::sch::DeepCriticality), annotated on statements,
+ * including the source and sink sentinels of data dependency graphs.
+ */
+constexpr Analyses DEEP_CRITICALITY = 2;
+
+/**
+ * Control-flow graphs (see ql/com/cfg), annotated on the program and its
+ * blocks.
+ */
+constexpr Analyses CFG = 4;
+
+/**
+ * All analyses.
+ */
+constexpr Analyses ALL = DDG | DEEP_CRITICALITY | CFG;
+
+} // namespace analysis
+
+/**
+ * Frees the annotations for the given analyses everywhere in the given IR.
+ */
+void free_analyses(const ir::Ref &ir, Analyses analyses);
+
+} // namespace pmgr
+} // namespace ql
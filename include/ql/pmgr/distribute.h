@@ -0,0 +1,160 @@
+/** \file
+ * Pass group that compiles each kernel of the program separately, possibly on
+ * other machines, and merges the results.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/ptr.h"
+#include "ql/pmgr/declarations.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Interface for sending the shard requests of a Distribute pass group to
+ * workers. A worker is any process that passes the requests it receives to
+ * Distribute::serve() and returns the response; the transport is only
+ * responsible for moving the data back and forth.
+ */
+class Transport {
+public:
+
+    /**
+     * Default virtual destructor.
+     */
+    virtual ~Transport() = default;
+
+    /**
+     * Sends the given request to the given worker, and returns the response
+     * of its Distribute::serve() call. The worker is one of the addresses
+     * listed in the workers option of the pass group, or empty if none were
+     * specified. This is called concurrently from up to num_threads threads,
+     * so it must be thread-safe.
+     */
+    virtual utils::Str submit(
+        const utils::Str &worker,
+        const utils::Str &request
+    ) const = 0;
+
+};
+
+/**
+ * Shared pointer reference to a transport.
+ */
+using TransportRef = utils::Ptr<Transport>;
+
+/**
+ * Immutable shared pointer reference to a transport.
+ */
+using CTransportRef = utils::Ptr<const Transport>;
+
+/**
+ * A group of passes that is run separately for each kernel of the program.
+ * Each kernel is serialized into a shard request along with the platform and
+ * the configuration of the sub-passes, which is sent to a worker through a
+ * pluggable transport. The worker compiles the shard with its own pass
+ * manager and returns the resulting IR and output files, after which the
+ * kernels are merged back into the program in their original order.
+ */
+class Distribute : public pass_types::Base {
+public:
+
+    /**
+     * Version of the shard request and response format. This is incremented
+     * whenever the format changes, and workers reject requests of any other
+     * version. The embedded IR records have their own version as well.
+     */
+    static const utils::UInt FORMAT_VERSION;
+
+    /**
+     * Registers a transport with the given name, to be selected using the
+     * transport option. Replaces any previously registered transport with the
+     * same name. The built-in `local` transport can not be replaced.
+     */
+    static void register_transport(
+        const utils::Str &name,
+        const CTransportRef &transport
+    );
+
+    /**
+     * Handles a shard request as produced by a Distribute pass group, and
+     * returns the response to send back. Errors are reported through the
+     * response rather than thrown, such that the pass group can rethrow them
+     * on the machine that started the compilation.
+     */
+    static utils::Str serve(const utils::Str &request);
+
+private:
+
+    /**
+     * Returns the transport selected by the transport option.
+     */
+    CTransportRef get_transport() const;
+
+    /**
+     * Returns the parsed workers option.
+     */
+    utils::Vec<utils::Str> get_workers() const;
+
+protected:
+
+    /**
+     * Writes the documentation for this pass group to the given stream.
+     */
+    void dump_docs(
+        std::ostream &os,
+        const utils::Str &line_prefix
+    ) const override;
+
+    /**
+     * Builds the sub-passes from the pass_types option.
+     */
+    pass_types::NodeType on_construct(
+        const utils::Ptr<const Factory> &factory,
+        utils::List<PassRef> &passes,
+        condition::Ref &condition
+    ) override;
+
+    /**
+     * Dummy implementation for compilation. Should never be called, as this
+     * pass group runs its sub-passes through run_shards().
+     */
+    utils::Int run_internal(
+        const ir::Ref &ir,
+        const pass_types::Context &context
+    ) const override;
+
+    /**
+     * Sends each kernel of the program to a worker, and merges the compiled
+     * kernels back into the program.
+     */
+    void run_shards(
+        const ir::Ref &ir,
+        const pass_types::Context &context
+    ) const override;
+
+public:
+
+    /**
+     * Returns a user-friendly type name for this pass.
+     */
+    utils::Str get_friendly_type() const override;
+
+    /**
+     * Constructs the pass group.
+     */
+    Distribute(
+        const utils::Ptr<const Factory> &pass_factory,
+        const utils::Str &instance_name,
+        const utils::Str &type_name
+    );
+
+};
+
+} // namespace pmgr
+} // namespace ql
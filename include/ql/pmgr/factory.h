@@ -4,7 +4,6 @@
 
 #pragma once
 
-#include <functional>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/ptr.h"
@@ -36,23 +35,64 @@ class Factory {
 private:
 
     /**
-     * Function pointer object type that is used to construct pass class
-     * instances.
+     * Function pointer type that is used to construct pass class instances.
      */
-    using ConstructorFn = utils::Ptr<
-        std::function<
-            PassRef(
-                const CFactoryRef &pass_factory,
-                const utils::Str &instance_name
-            )
-        >
-    >;
+    using ConstructorFn = PassRef (*)(
+        const CFactoryRef &pass_factory,
+        const utils::Str &type_name,
+        const utils::Str &instance_name
+    );
+
+    /**
+     * A registered pass type, consisting of the type name it was registered
+     * with (which differs from its key for the aliases made by configure())
+     * and the function that constructs it. Registration thus does not
+     * allocate anything beyond the map entry, and nothing pass-specific is
+     * done until a pass is actually built.
+     */
+    struct Registration {
+        utils::Str type_name;
+        ConstructorFn constructor;
+    };
 
     /**
-     * Map from (desugared) pass type name to a constructor function for that
+     * Map of registered pass types.
+     */
+    using Registrations = utils::Map<utils::Str, Registration>;
+
+    /**
+     * Map from (desugared) pass type name to the registration for that
      * particular pass type.
      */
-    utils::Map<utils::Str, ConstructorFn> pass_types;
+    Registrations pass_types;
+
+    /**
+     * Constructor function for the given pass class.
+     */
+    template <class PassType>
+    static PassRef construct_pass(
+        const CFactoryRef &pass_factory,
+        const utils::Str &type_name,
+        const utils::Str &instance_name
+    ) {
+        PassRef pass;
+        pass.emplace<PassType>(pass_factory, type_name, instance_name);
+        return pass;
+    }
+
+    /**
+     * Adds a pass class with the given type name to the given map.
+     */
+    template <class PassType>
+    static void add_pass_type(Registrations &registrations, const utils::Str &type_name) {
+        registrations.set(type_name) = {type_name, &construct_pass<PassType>};
+    }
+
+    /**
+     * Returns the registrations for the default OpenQL passes. These are built
+     * on first use only, and then shared by all default factories.
+     */
+    static const Registrations &get_default_pass_types();
 
 public:
 
@@ -66,16 +106,7 @@ public:
      */
     template <class PassType>
     void register_pass(const utils::Str &type_name) {
-        ConstructorFn fn;
-        fn.emplace([type_name](
-            const CFactoryRef &pass_factory,
-            const utils::Str &instance_name
-        ) {
-            PassRef pass;
-            pass.emplace<PassType>(pass_factory, type_name, instance_name);
-            return pass;
-        });
-        pass_types.set(type_name) = fn;
+        add_pass_type<PassType>(pass_types, type_name);
     }
 
     /**
@@ -10,6 +10,7 @@
 #include "ql/utils/str.h"
 #include "ql/utils/ptr.h"
 #include "ql/utils/list.h"
+#include "ql/utils/map.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/set.h"
 #include "ql/utils/pair.h"
@@ -73,6 +74,12 @@ private:
      */
     PassRef root;
 
+    /**
+     * Runs the passes on the given program, assuming that they have already
+     * been constructed.
+     */
+    void run_passes(const ir::Ref &ir) const;
+
 public:
 
     /**
@@ -307,10 +314,33 @@ public:
 
     /**
      * Ensures that all passes have been constructed, and then runs the passes
-     * on the given program.
+     * on the given program. The global options are frozen while this runs.
+     * Multiple threads may compile different programs using the same pass
+     * manager concurrently, as long as the pass tree is not modified.
      */
     void compile(const ir::Ref &ir);
 
+    /**
+     * Like compile(), but collects the files that the passes would write in
+     * memory instead of writing them to disk, and returns them, keyed by the
+     * path they would have been written to (usually starting with the
+     * output_dir option). Files that passes read back during compilation are
+     * read from memory as well, while cache entries are still written to
+     * disk. Bitmap images written by the visualizer are not captured.
+     */
+    utils::Map<utils::Str, utils::Str> compile_in_memory(const ir::Ref &ir);
+
+    /**
+     * Ensures that all passes have been constructed, and then runs the passes
+     * on each of the given programs, compiling up to num_threads programs
+     * concurrently. 0 means use all hardware threads. The pass tree is shared
+     * between the programs and must not be modified while this runs, and the
+     * global options are frozen until all programs have been compiled. If
+     * compilation of one or more programs fails, the exception for the first
+     * failing program is rethrown once all threads are done.
+     */
+    void compile_batch(const utils::Vec<ir::Ref> &irs, utils::UInt num_threads = 0);
+
 };
 
 /**
@@ -0,0 +1,93 @@
+/** \file
+ * Defines the on-disk pass result cache, used by the pass manager to skip
+ * passes that were already run on identical input before.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/ptr.h"
+#include "ql/utils/options.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * On-disk cache for the results of passes that declare themselves cacheable
+ * (see pass_types::Base::is_cacheable()). Entries are keyed by a hash of the
+ * OpenQL version, the pass type, the values of all pass options, and the
+ * input IR including the platform. Each entry holds the return value of the
+ * pass and the IR it produced.
+ *
+ * The IR is stored in cQASM form, with timing and metadata included, so
+ * restoring an entry yields a program that is equivalent according to the
+ * cQASM writer. Annotations that the cQASM writer doesn't represent (such as
+ * the statistics collected by the passes) are not restored.
+ *
+ * Entries are written to a temporary file first and then renamed into place,
+ * so multiple processes can share a cache directory.
+ */
+class PassCache {
+private:
+
+    /**
+     * The directory in which the cache entries are stored.
+     */
+    utils::Str directory;
+
+    /**
+     * Returns the filename for the entry with the given key.
+     */
+    utils::Str get_entry_path(const utils::Str &key) const;
+
+public:
+
+    /**
+     * Constructs a cache that stores its entries in the given directory. The
+     * directory is created when the first entry is written, if it does not
+     * already exist.
+     */
+    explicit PassCache(const utils::Str &directory);
+
+    /**
+     * Computes the cache key for running a pass of the given type and with
+     * the given options on the given IR.
+     */
+    static utils::Str make_key(
+        const ir::Ref &ir,
+        const utils::Str &type_name,
+        const utils::Options &options
+    );
+
+    /**
+     * Looks up the entry for the given key. If it exists, ir->program is
+     * replaced with the cached result, retval is set to the cached return
+     * value, and true is returned. Otherwise, the IR is not modified and
+     * false is returned.
+     */
+    utils::Bool restore(
+        const utils::Str &key,
+        const ir::Ref &ir,
+        utils::Int &retval
+    ) const;
+
+    /**
+     * Stores the given IR and return value as the entry for the given key.
+     */
+    void store(
+        const utils::Str &key,
+        const ir::Ref &ir,
+        utils::Int retval
+    ) const;
+
+};
+
+/**
+ * Shared reference to a pass cache.
+ */
+using PassCacheRef = utils::Ptr<const PassCache>;
+
+} // namespace pmgr
+} // namespace ql
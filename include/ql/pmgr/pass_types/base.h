@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/ptr.h"
@@ -13,7 +14,11 @@
 #include "ql/utils/options.h"
 #include "ql/ir/ir.h"
 #include "ql/pmgr/declarations.h"
+#include "ql/pmgr/analyses.h"
+#include "ql/pmgr/products.h"
 #include "ql/pmgr/condition.h"
+#include "ql/pmgr/profiler.h"
+#include "ql/pmgr/pass_cache.h"
 
 namespace ql {
 namespace pmgr {
@@ -43,6 +48,70 @@ struct Context {
 
 };
 
+/**
+ * Scope within which passes whose only products are output files are
+ * deferred. Rather than running such a pass inline, the pass manager
+ * serializes the IR and submits the pass to the thread pool, to be run on a
+ * copy of the IR concurrently with the rest of the pipeline. The pass manager
+ * opens a scope around the compilation when the defer_reports global option
+ * is set, and waits for the deferred passes at the end of it. Only passes
+ * compiled by the thread that opened the scope are deferred, so passes run
+ * by concurrent alternatives or instances are run inline.
+ */
+class DeferredPasses {
+private:
+
+    /**
+     * The number of pending passes and the first error, shared with the
+     * tasks. Defined in the source file.
+     */
+    struct State;
+
+    /**
+     * The shared state.
+     */
+    utils::Ptr<State> state;
+
+    /**
+     * The scope that was active on this thread before this one was opened.
+     */
+    DeferredPasses *previous;
+
+public:
+
+    /**
+     * Opens a scope on the calling thread.
+     */
+    DeferredPasses();
+
+    /**
+     * Closes the scope, waiting for any passes that are still pending. Errors
+     * that were not yet reported by wait() are logged.
+     */
+    ~DeferredPasses();
+
+    DeferredPasses(const DeferredPasses &) = delete;
+    DeferredPasses &operator=(const DeferredPasses &) = delete;
+
+    /**
+     * Returns the innermost scope that is open on the calling thread, or
+     * nullptr if there is none.
+     */
+    static DeferredPasses *get_active();
+
+    /**
+     * Submits a deferred pass to the thread pool.
+     */
+    void submit(std::function<void()> &&task);
+
+    /**
+     * Waits for all deferred passes to complete, running pending tasks in the
+     * meantime. If any of them threw an exception, the first one is rethrown.
+     */
+    void wait();
+
+};
+
 // Forward declaration for the base type.
 class Base;
 
@@ -101,7 +170,32 @@ enum class NodeType {
      * Like GROUP_WHILE, but the condition is evaluated at the end of the loop
      * rather than at the beginning, so the group is evaluated at list once.
      */
-    GROUP_REPEAT_UNTIL_NOT
+    GROUP_REPEAT_UNTIL_NOT,
+
+    /**
+     * A group of alternative strategies. compile() runs each sub-pass on its
+     * own copy of the IR, possibly concurrently, and then calls
+     * run_internal()/run() on each copy to score it. The copy with the lowest
+     * score replaces the IR; the others are discarded.
+     */
+    GROUP_SELECT,
+
+    /**
+     * A group that is instantiated multiple times. compile() first calls
+     * run_internal()/run() once on the IR, and then runs the group of passes
+     * on a copy of the IR for each instance, as prepared by instantiate().
+     * The copies are discarded afterwards, so the IR itself is only modified
+     * by run_internal()/run().
+     */
+    GROUP_INSTANCES,
+
+    /**
+     * A group that is run separately for each kernel (toplevel block) of the
+     * program. compile() calls run_shards(), which is responsible for running
+     * the group of passes on each kernel and merging the results back into
+     * the IR; run_internal()/run() is not called.
+     */
+    GROUP_SHARDS
 
 };
 
@@ -258,6 +352,62 @@ protected:
      */
     virtual utils::Bool is_legacy() const;
 
+    /**
+     * Returns whether the pass manager may restore the result of this pass
+     * from the pass cache rather than running it. This requires that, with
+     * the configured options, the pass is deterministic, its result depends
+     * only on the input IR (including the platform) and its options, and it
+     * has no effects other than modifying the IR and returning its return
+     * value. Returns false unless overridden.
+     */
+    virtual utils::Bool is_cacheable() const;
+
+    /**
+     * Returns the analyses (see ql/pmgr/analyses.h) whose annotations remain
+     * valid after this pass runs, such that later passes may use them. The
+     * pass manager frees the annotations of all other analyses after running
+     * the pass. Only used for passes that operate on the new IR. Returns
+     * analysis::NONE unless overridden.
+     */
+    virtual Analyses get_preserved_analyses() const;
+
+    /**
+     * Returns the products (see ql/pmgr/products.h) of this pass with its
+     * current options. A pass whose only products are output files (and the
+     * statistics reported in them) is skipped when its output_prefix option
+     * is empty, and may be deferred when the defer_reports global option is
+     * set. Returns product::ALL unless overridden.
+     */
+    virtual Products get_products() const;
+
+    /**
+     * Returns the maximum number of threads that GROUP_SELECT and
+     * GROUP_INSTANCES nodes may use to run their alternatives or instances
+     * concurrently, with 0 meaning all hardware threads. Returns 1 unless
+     * overridden.
+     */
+    virtual utils::UInt get_num_alternative_threads() const;
+
+    /**
+     * Returns the number of instances of a GROUP_INSTANCES node. Returns 0
+     * unless overridden.
+     */
+    virtual utils::UInt get_num_instances() const;
+
+    /**
+     * Prepares the given copy of the IR for the given instance of a
+     * GROUP_INSTANCES node, before the sub-passes are run on it. Does nothing
+     * unless overridden.
+     */
+    virtual void instantiate(const ir::Ref &ir, utils::UInt index) const;
+
+    /**
+     * Runs the sub-passes of a GROUP_SHARDS node on each kernel of the given
+     * program, and merges the results back into the IR. Must be overridden by
+     * passes that construct into a GROUP_SHARDS node.
+     */
+    virtual void run_shards(const ir::Ref &ir, const Context &context) const;
+
     /**
      * Returns `pass "<name>"` for normal passes and `root` for the root pass.
      * Used for error messages.
@@ -584,13 +734,34 @@ private:
         utils::Bool after_pass
     );
 
+    /**
+     * Returns whether this pass is dead, i.e. whether the only products of the
+     * pass are output files (and the statistics reported in them), while its
+     * output_prefix option routes them nowhere by being empty.
+     */
+    utils::Bool is_dead() const;
+
+    /**
+     * Called instead of the main pass implementation when the pass is dead.
+     * Discards the statistics that the pass would have reported, if any.
+     */
+    void skip_dead_pass(const ir::Ref &ir, const Context &context) const;
+
+    /**
+     * Defers the main pass implementation to the active DeferredPasses scope
+     * if there is one and the only products of the pass are output files.
+     * Returns whether the pass was deferred.
+     */
+    utils::Bool defer_main_pass(const ir::Ref &ir, const Context &context) const;
+
     /**
      * Wrapper around running the main pass implementation for this pass, taking
      * care of logging, profiling, etc.
      */
     utils::Int run_main_pass(
         const ir::Ref &ir,
-        const Context &context
+        const Context &context,
+        const PassCacheRef &cache
     ) const;
 
     /**
@@ -599,17 +770,47 @@ private:
      */
     void run_sub_passes(
         const ir::Ref &ir,
-        const Context &context
+        const Context &context,
+        const ProfilerRef &profiler,
+        const PassCacheRef &cache
+    ) const;
+
+    /**
+     * Runs each sub-pass on its own copy of the IR, scores the copies using
+     * the main pass, and replaces the IR with the best copy. Used for
+     * GROUP_SELECT nodes.
+     */
+    void run_alternatives(
+        const ir::Ref &ir,
+        const Context &context,
+        const ProfilerRef &profiler,
+        const PassCacheRef &cache
+    ) const;
+
+    /**
+     * Runs the main pass, and then runs the sub-passes on a copy of the IR for
+     * each instance. Used for GROUP_INSTANCES nodes.
+     */
+    void run_instances(
+        const ir::Ref &ir,
+        const Context &context,
+        const ProfilerRef &profiler,
+        const PassCacheRef &cache
     ) const;
 
 public:
 
     /**
-     * Executes this pass or pass group on the given program.
+     * Executes this pass or pass group on the given program. If a profiler is
+     * specified, the execution of this pass and all its sub-passes is recorded
+     * with it. If a pass cache is specified, the results of cacheable passes
+     * are restored from it when possible, and stored in it otherwise.
      */
     void compile(
         const ir::Ref &ir,
-        const utils::Str &pass_name_prefix = ""
+        const utils::Str &pass_name_prefix = "",
+        const ProfilerRef &profiler = {},
+        const PassCacheRef &cache = {}
     );
 
 };
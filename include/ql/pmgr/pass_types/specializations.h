@@ -176,6 +176,13 @@ protected:
  * using the old IR.
  */
 class KernelTransformation : public Normal {
+private:
+
+    /**
+     * Whether this pass type can process kernels concurrently.
+     */
+    const utils::Bool kernel_parallel;
+
 protected:
 
     /**
@@ -185,7 +192,8 @@ protected:
     KernelTransformation(
         const utils::Ptr<const Factory> &pass_factory,
         const utils::Str &instance_name,
-        const utils::Str &type_name
+        const utils::Str &type_name,
+        utils::Bool kernel_parallel = false
     );
 
     /**
@@ -220,6 +228,13 @@ protected:
      */
     utils::Bool is_legacy() const override;
 
+public:
+
+    /**
+     * Returns whether this pass type can process kernels concurrently.
+     */
+    utils::Bool is_kernel_parallel() const;
+
 };
 
 /**
@@ -246,6 +261,11 @@ protected:
         const Context &context
     ) const final;
 
+    /**
+     * Analysis passes don't modify the IR, so they preserve all analyses.
+     */
+    Analyses get_preserved_analyses() const override;
+
     /**
      * The virtual implementation for this pass.
      */
@@ -301,6 +321,13 @@ protected:
  * A pass type for passes that analyze individual kernels using the old IR.
  */
 class KernelAnalysis : public Normal {
+private:
+
+    /**
+     * Whether this pass type can process kernels concurrently.
+     */
+    const utils::Bool kernel_parallel;
+
 protected:
 
     /**
@@ -310,7 +337,8 @@ protected:
     KernelAnalysis(
         const utils::Ptr<const Factory> &pass_factory,
         const utils::Str &instance_name,
-        const utils::Str &type_name
+        const utils::Str &type_name,
+        utils::Bool kernel_parallel = false
     );
 
     /**
@@ -346,8 +374,46 @@ protected:
      */
     utils::Bool is_legacy() const override;
 
+public:
+
+    /**
+     * Returns whether this pass type can process kernels concurrently.
+     */
+    utils::Bool is_kernel_parallel() const;
+
 };
 
+/**
+ * Returns the old-IR equivalent of the given new IR for use by a legacy pass.
+ * Consecutive legacy passes share the same old-IR program: it is only
+ * converted from the new IR when no valid cached conversion exists.
+ */
+ir::compat::ProgramRef get_legacy_program(const ir::Ref &ir);
+
+/**
+ * Records that a legacy transformation pass modified the program returned by
+ * get_legacy_program(), such that the new IR must be regenerated from it
+ * before anything reads the new IR again. The conversion back is deferred
+ * until sync_legacy_program() is called.
+ */
+void mark_legacy_program_modified(const ir::Ref &ir);
+
+/**
+ * Regenerates the new IR from the cached old-IR program if a legacy
+ * transformation modified it since the last conversion. The cache stays
+ * valid, so this is suitable for passes and debug dumps that only read the
+ * new IR.
+ */
+void sync_legacy_program(const ir::Ref &ir);
+
+/**
+ * Syncs the new IR with the cached old-IR program (if needed) and then
+ * discards the cache. This must be called before anything modifies the new
+ * IR, i.e. before running any pass that isn't a legacy pass, and once all
+ * passes have been run.
+ */
+void flush_legacy_program(const ir::Ref &ir);
+
 } // namespace pass_types
 } // namespace pmgr
 } // namespace ql
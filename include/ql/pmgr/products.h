@@ -0,0 +1,65 @@
+/** \file
+ * Defines the kinds of products that passes declare, which the pass manager
+ * uses to skip passes whose products go nowhere and to defer passes that only
+ * write output files.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Bit mask of the kinds of products of a pass. Passes declare what they
+ * produce with their current options (see pass_types::Base::get_products()).
+ * When the only products of a pass are output files and the output_prefix
+ * option of the pass routes them nowhere (i.e. it is empty), the pass is
+ * dead and is not run at all. Passes that only write output files to which
+ * nothing else refers can also be run on a snapshot of the IR, concurrently
+ * with the rest of the pipeline (see the defer_reports global option).
+ */
+using Products = utils::UInt;
+
+namespace product {
+
+/**
+ * No products at all.
+ */
+constexpr Products NONE = 0;
+
+/**
+ * The pass modifies the IR, other than discarding statistics (see
+ * STATISTICS). This includes passes whose return value is used.
+ */
+constexpr Products PROGRAM = 1;
+
+/**
+ * The pass writes output files, whose names are derived from the
+ * output_prefix option.
+ */
+constexpr Products FILES = 2;
+
+/**
+ * The pass interacts with the user, for example by opening a window.
+ */
+constexpr Products INTERACTIVE = 4;
+
+/**
+ * The pass reports the statistics that earlier passes attached to the IR (see
+ * pass::ana::statistics::AdditionalStats) in its output files, and thereby
+ * discards them. When such a pass is dead, the pass manager discards the
+ * statistics in its place.
+ */
+constexpr Products STATISTICS = 8;
+
+/**
+ * All products; used for passes that don't declare anything more specific.
+ */
+constexpr Products ALL = PROGRAM | FILES | INTERACTIVE | STATISTICS;
+
+} // namespace product
+
+} // namespace pmgr
+} // namespace ql
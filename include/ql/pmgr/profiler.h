@@ -0,0 +1,227 @@
+/** \file
+ * Defines the pass profiler, used by the pass manager to record how much time
+ * and memory each pass in the pass tree takes.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <ctime>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/ptr.h"
+#include "ql/utils/json.h"
+#include "ql/utils/accounting.h"
+#include "ql/ir/ir.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Records wall time, CPU time, IR size, and memory usage metrics for every
+ * invocation of every pass in the pass tree, including groups. Passes
+ * announce themselves using begin() before they run and end() after they
+ * complete; nesting is tracked using a stack, such that the records of the
+ * sub-passes of a group appear after the record of the group itself.
+ *
+ * The memory metrics are process-wide and thus include any allocations done
+ * by other threads. Heap usage is the net change in the number of bytes in
+ * use by the allocator (so memory that was allocated and subsequently freed
+ * by the pass is not included); it is only available when compiling against
+ * glibc. The peak resident set size delta is only available on POSIX
+ * systems. Unavailable metrics are reported as zero.
+ *
+ * If allocation accounting (see utils::AccountAllocations) is enabled when
+ * the profiler is constructed, the memory allocated for IR nodes and gates is
+ * additionally attributed to the passes: the bytes allocated while the pass
+ * ran, the counted bytes still live when it completed, and the peak number
+ * of live bytes while it ran. Allocations of sub-passes are included in the
+ * numbers of their parents.
+ */
+class Profiler {
+public:
+
+    /**
+     * Profiling information for a single invocation of a pass.
+     */
+    struct Record {
+
+        /**
+         * The fully-qualified pass name, or an empty string for the root of
+         * the pass tree.
+         */
+        utils::Str pass_name;
+
+        /**
+         * The pass type name, or an empty string for generic groups.
+         */
+        utils::Str type_name;
+
+        /**
+         * The nesting depth of the pass, where 0 is used for the root.
+         */
+        utils::UInt depth;
+
+        /**
+         * Start time of the pass in microseconds, relative to the construction
+         * of the profiler.
+         */
+        utils::UInt start_us;
+
+        /**
+         * Wall-clock time taken by the pass in microseconds.
+         */
+        utils::UInt wall_us;
+
+        /**
+         * Process CPU time taken by the pass in microseconds.
+         */
+        utils::UInt cpu_us;
+
+        /**
+         * Number of nodes in the IR tree before the pass.
+         */
+        utils::UInt nodes_before;
+
+        /**
+         * Number of nodes in the IR tree after the pass.
+         */
+        utils::UInt nodes_after;
+
+        /**
+         * Net change in heap usage in bytes.
+         */
+        utils::Int heap_delta;
+
+        /**
+         * Change in peak resident set size in bytes.
+         */
+        utils::Int peak_rss_delta;
+
+        /**
+         * Number of bytes allocated for nodes while the pass ran, when
+         * allocations are counted.
+         */
+        utils::UInt allocated_bytes;
+
+        /**
+         * Number of counted bytes that were live when the pass completed,
+         * when allocations are counted.
+         */
+        utils::UInt live_bytes;
+
+        /**
+         * Peak number of counted bytes that were live while the pass ran,
+         * when allocations are counted.
+         */
+        utils::UInt peak_live_bytes;
+
+    };
+
+private:
+
+    /**
+     * The clock source to use for measuring wall-clock time.
+     */
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Snapshot of the resource metrics at the start of a pass.
+     */
+    struct Snapshot {
+        Clock::time_point wall;
+        std::clock_t cpu;
+        utils::Int heap;
+        utils::Int peak_rss;
+        utils::AllocationCounters allocations;
+    };
+
+    /**
+     * Whether allocations are counted.
+     */
+    utils::Bool count_allocations;
+
+    /**
+     * For each pass that is currently running, the peak number of live bytes
+     * of its parent when it started, such that the peak of the parent can be
+     * restored when it completes.
+     */
+    utils::Vec<utils::UInt> parent_peaks;
+
+    /**
+     * Time at which the profiler was constructed.
+     */
+    Clock::time_point epoch;
+
+    /**
+     * The records for all passes that were started thus far, in the order in
+     * which they were started.
+     */
+    utils::Vec<Record> records;
+
+    /**
+     * Stack of record indices and start snapshots for the passes that are
+     * currently running.
+     */
+    utils::Vec<utils::Pair<utils::UInt, Snapshot>> stack;
+
+    /**
+     * Takes a snapshot of the current resource metrics.
+     */
+    static Snapshot take_snapshot();
+
+    /**
+     * Counts the number of nodes in the given IR tree.
+     */
+    static utils::UInt count_nodes(const ir::Ref &ir);
+
+public:
+
+    /**
+     * Constructs a new profiler, starting its clock. Allocations are counted
+     * if allocation accounting is enabled at this time.
+     */
+    Profiler();
+
+    /**
+     * Records the start of a pass.
+     */
+    void begin(
+        const utils::Str &pass_name,
+        const utils::Str &type_name,
+        const ir::Ref &ir
+    );
+
+    /**
+     * Records the completion of the pass most recently started with begin().
+     */
+    void end(const ir::Ref &ir);
+
+    /**
+     * Returns the records for all passes that were run thus far.
+     */
+    const utils::Vec<Record> &get_records() const;
+
+    /**
+     * Returns the profiling report as a JSON array with one object per pass
+     * invocation.
+     */
+    utils::Json to_json() const;
+
+    /**
+     * Returns the profiling report in the Chrome trace event format, as
+     * understood by chrome://tracing and Perfetto.
+     */
+    utils::Json to_trace_json() const;
+
+};
+
+/**
+ * Shared reference to a pass profiler.
+ */
+using ProfilerRef = utils::Ptr<Profiler>;
+
+} // namespace pmgr
+} // namespace ql
@@ -0,0 +1,94 @@
+/** \file
+ * Pass group that instantiates the remainder of the compilation process for
+ * each point of a parameter sweep.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/ptr.h"
+#include "ql/pmgr/declarations.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * A group of passes that is run once for each point of a parameter sweep, on
+ * a copy of the IR in which a placeholder angle is replaced by the value for
+ * that point. The passes before the group are thus only run once for the
+ * whole sweep.
+ */
+class Sweep : public pass_types::Base {
+private:
+
+    /**
+     * Returns the parsed values option.
+     */
+    utils::Vec<utils::Real> get_values() const;
+
+protected:
+
+    /**
+     * Writes the documentation for this pass group to the given stream.
+     */
+    void dump_docs(
+        std::ostream &os,
+        const utils::Str &line_prefix
+    ) const override;
+
+    /**
+     * Builds the sub-passes from the pass_types option.
+     */
+    pass_types::NodeType on_construct(
+        const utils::Ptr<const Factory> &factory,
+        utils::List<PassRef> &passes,
+        condition::Ref &condition
+    ) override;
+
+    /**
+     * Writes the sweep points file, if enabled.
+     */
+    utils::Int run_internal(
+        const ir::Ref &ir,
+        const pass_types::Context &context
+    ) const override;
+
+    /**
+     * Returns the value of the point_threads option.
+     */
+    utils::UInt get_num_alternative_threads() const override;
+
+    /**
+     * Returns the number of sweep points.
+     */
+    utils::UInt get_num_instances() const override;
+
+    /**
+     * Substitutes the value of the given sweep point for the placeholder, and
+     * suffixes the program name with the index of the point.
+     */
+    void instantiate(const ir::Ref &ir, utils::UInt index) const override;
+
+public:
+
+    /**
+     * Returns a user-friendly type name for this pass.
+     */
+    utils::Str get_friendly_type() const override;
+
+    /**
+     * Constructs the pass group.
+     */
+    Sweep(
+        const utils::Ptr<const Factory> &pass_factory,
+        const utils::Str &instance_name,
+        const utils::Str &type_name
+    );
+
+};
+
+} // namespace pmgr
+} // namespace ql
@@ -16,7 +16,7 @@ namespace instrument {
 /**
  * State per instrument.
  */
-using State = utils::RangeMap<utils::Int, utils::UInt>;
+using State = utils::FlatRangeMap<utils::Int, utils::UInt>;
 
 /**
  * Forward-declaration for the configuration structure, defined in the CC file.
@@ -26,14 +26,20 @@ struct Config;
 /**
  * Instrument resource.
  */
-class InstrumentResource : public rmgr::resource_types::Base {
+class InstrumentResource final : public rmgr::resource_types::Base {
 private:
+    friend class rmgr::resource_types::Base;
 
     /**
      * The reservations made for each instrument.
      */
     utils::Vec<State> state;
 
+    /**
+     * Undo log for the elements of state, used to support checkpoints.
+     */
+    rmgr::resource_types::UndoLog<State> undo_log;
+
     /**
      * Shared pointer to the configuration structure.
      */
@@ -55,6 +61,37 @@ protected:
         utils::Bool commit
     ) override;
 
+    /**
+     * Computes the earliest cycles at which the given gates would be accepted,
+     * skipping directly past conflicting reservations.
+     */
+    void on_get_earliest(
+        utils::Int cycle,
+        const utils::Vec<rmgr::resource_types::GateData> &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    ) override;
+
+    /**
+     * Returns whether this resource supports checkpoints, which it does.
+     */
+    utils::Bool on_supports_checkpoints() const override;
+
+    /**
+     * Pushes a checkpoint onto the undo log.
+     */
+    void on_checkpoint() override;
+
+    /**
+     * Undoes all reservations made since the innermost checkpoint.
+     */
+    void on_rollback() override;
+
+    /**
+     * Pops the innermost checkpoint from the undo log.
+     */
+    void on_release() override;
+
     /**
      * Dumps documentation for this resource.
      */
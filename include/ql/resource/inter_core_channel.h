@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "ql/utils/vec.h"
 #include "ql/utils/rangemap.h"
 #include "ql/rmgr/resource_types/base.h"
 
@@ -15,7 +16,7 @@ namespace inter_core_channel {
 /**
  * State per qubit.
  */
-using State = utils::RangeSet<utils::Int>;
+using State = utils::FlatRangeSet<utils::Int>;
 
 /**
  * Forward-declaration for the configuration structure, defined in the CC file.
@@ -26,19 +27,36 @@ struct Config;
  * Communication channel resource. This limits the amount of parallel
  * communication between cores in a multi-core system.
  */
-class InterCoreChannelResource : public rmgr::resource_types::Base {
+class InterCoreChannelResource final : public rmgr::resource_types::Base {
 private:
+    friend class rmgr::resource_types::Base;
 
     /**
-     * The reservations for each [core][channel].
+     * The reservations for each channel, indexed by core index (see
+     * com::Topology::get_core_index()) times the number of channels per core
+     * plus the channel index.
      */
-    utils::Vec<utils::Vec<State>> state;
+    utils::Vec<State> state;
+
+    /**
+     * Undo log for the elements of state, used to support checkpoints.
+     */
+    rmgr::resource_types::UndoLog<State> undo_log;
 
     /**
      * Shared pointer to the configuration structure.
      */
     utils::Ptr<Config> config;
 
+    /**
+     * Determines the cores whose channels the given gate needs. Returns false
+     * if the gate is not constrained by this resource at all.
+     */
+    utils::Bool get_affected_cores(
+        const rmgr::resource_types::GateData &gate,
+        utils::Vec<utils::UInt> &affected
+    ) const;
+
 protected:
 
     /**
@@ -55,6 +73,37 @@ protected:
         utils::Bool commit
     ) override;
 
+    /**
+     * Computes the earliest cycles at which the given gates would be accepted,
+     * skipping directly past conflicting reservations.
+     */
+    void on_get_earliest(
+        utils::Int cycle,
+        const utils::Vec<rmgr::resource_types::GateData> &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    ) override;
+
+    /**
+     * Returns whether this resource supports checkpoints, which it does.
+     */
+    utils::Bool on_supports_checkpoints() const override;
+
+    /**
+     * Pushes a checkpoint onto the undo log.
+     */
+    void on_checkpoint() override;
+
+    /**
+     * Undoes all reservations made since the innermost checkpoint.
+     */
+    void on_rollback() override;
+
+    /**
+     * Pops the innermost checkpoint from the undo log.
+     */
+    void on_release() override;
+
     /**
      * Dumps documentation for this resource.
      */
@@ -13,25 +13,84 @@ namespace resource {
 namespace qubit {
 
 /**
- * State per qubit.
+ * State per qubit when there is no defined scheduling direction.
  */
-using State = utils::RangeSet<utils::Int>;
+using State = utils::FlatRangeSet<utils::Int>;
+
+/**
+ * State per qubit when there is a defined scheduling direction. Gates are then
+ * committed in order, so only the most recent reservation of a qubit can
+ * conflict with later gates, and it suffices to store its cycle range. A
+ * default-constructed horizon represents a qubit that has not been reserved
+ * yet.
+ */
+struct Horizon {
+
+    /**
+     * The first cycle of the most recent reservation.
+     */
+    utils::Int first;
+
+    /**
+     * The cycle after the last cycle of the most recent reservation.
+     */
+    utils::Int second;
+
+    /**
+     * Constructs a horizon for a qubit without reservations, which does not
+     * overlap with any range.
+     */
+    Horizon() : first(utils::MAX), second(utils::MIN) {}
+
+    /**
+     * Constructs a horizon for the given reservation.
+     */
+    explicit Horizon(const State::Range &range) : first(range.first), second(range.second) {}
+
+    /**
+     * Returns whether the reservation overlaps with the given range, using the
+     * same semantics as RangeSet::find().
+     */
+    utils::Bool overlaps(const State::Range &range) const {
+        return first < range.second && range.first < second;
+    }
+
+};
 
 /**
  * Qubit resource. This resource prevents a qubit from being used more than once
  * in each cycle.
  */
-class QubitResource : public rmgr::resource_types::Base {
+class QubitResource final : public rmgr::resource_types::Base {
 private:
+    friend class rmgr::resource_types::Base;
 
     /**
-     * The reservations for each qubit.
+     * The reservations for each qubit, used when there is no defined
+     * scheduling direction.
      */
     utils::Vec<State> state;
 
+    /**
+     * The most recent reservation for each qubit, used instead of state when
+     * there is a defined scheduling direction.
+     */
+    utils::Vec<Horizon> horizon;
+
+    /**
+     * Undo log for the elements of state, used to support checkpoints.
+     */
+    rmgr::resource_types::UndoLog<State> undo_log;
+
+    /**
+     * Undo log for the elements of horizon, used to support checkpoints.
+     */
+    rmgr::resource_types::UndoLog<Horizon> horizon_undo_log;
+
     /**
      * When set, there is a defined scheduling direction, which means it's
-     * sufficient to only track the latest reservation for each qubit.
+     * sufficient to only track the latest reservation for each qubit, so
+     * horizon is used instead of state.
      */
     utils::Bool optimize;
 
@@ -51,6 +110,37 @@ protected:
         utils::Bool commit
     ) override;
 
+    /**
+     * Computes the earliest cycles at which the given gates would be accepted,
+     * skipping directly past conflicting reservations.
+     */
+    void on_get_earliest(
+        utils::Int cycle,
+        const utils::Vec<rmgr::resource_types::GateData> &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    ) override;
+
+    /**
+     * Returns whether this resource supports checkpoints, which it does.
+     */
+    utils::Bool on_supports_checkpoints() const override;
+
+    /**
+     * Pushes a checkpoint onto the undo log.
+     */
+    void on_checkpoint() override;
+
+    /**
+     * Undoes all reservations made since the innermost checkpoint.
+     */
+    void on_rollback() override;
+
+    /**
+     * Pops the innermost checkpoint from the undo log.
+     */
+    void on_release() override;
+
     /**
      * Dumps documentation for this resource.
      */
@@ -90,6 +180,57 @@ public:
 
 };
 
+/**
+ * Checks availability of and/or reserves a gate. This is defined inline, such
+ * that rmgr::StaticState can inline it into the scheduler.
+ */
+inline utils::Bool QubitResource::on_gate(
+    utils::Int cycle,
+    const rmgr::resource_types::GateData &gate,
+    utils::Bool commit
+) {
+
+    // Compute cycle range for this gate.
+    State::Range range = {
+        cycle,
+        cycle + gate.duration_cycles
+    };
+
+    // Fast path for directional scheduling: check and update only the most
+    // recent reservation of each operand.
+    if (optimize) {
+        for (auto qubit : gate.qubits) {
+            if (horizon[qubit].overlaps(range)) {
+                return false;
+            }
+        }
+        if (commit) {
+            for (auto qubit : gate.qubits) {
+                horizon_undo_log.record(horizon, qubit);
+                horizon[qubit] = Horizon(range);
+            }
+        }
+        return true;
+    }
+
+    // Check qubit availability for all operands.
+    for (auto qubit : gate.qubits) {
+        if (state[qubit].find_any_overlap(range)) {
+            return false;
+        }
+    }
+
+    // If we're committing, reserve for all operands.
+    if (commit) {
+        for (auto qubit : gate.qubits) {
+            undo_log.record(state, qubit);
+            state[qubit].set(range);
+        }
+    }
+
+    return true;
+}
+
 /**
  * Shorthand for namespace-based notation.
  */
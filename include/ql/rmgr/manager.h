@@ -4,7 +4,9 @@
 
 #pragma once
 
+#include <mutex>
 #include "ql/utils/num.h"
+#include "ql/utils/ptr.h"
 #include "ql/utils/str.h"
 #include "ql/utils/list.h"
 #include "ql/utils/map.h"
@@ -53,6 +55,34 @@ private:
      */
     utils::Map<utils::Str, ResourceRef> resources;
 
+    /**
+     * Pristine resource states for each scheduling direction, built on the
+     * first call to build() for that direction and cloned by subsequent
+     * calls. This avoids calling the initialization functions of the
+     * resources, which may have to parse their JSON configuration, for every
+     * block or kernel that is scheduled. The cache is shared between copies
+     * of the manager until resources are added or removed, and is protected
+     * by a mutex so build() may be called from multiple threads.
+     */
+    struct Templates {
+
+        /**
+         * Mutex protecting states.
+         */
+        std::mutex mutex;
+
+        /**
+         * The pristine states built so far, indexed by direction.
+         */
+        utils::Map<Direction, State> states;
+
+    };
+
+    /**
+     * The cache of pristine resource states.
+     */
+    utils::Ptr<Templates> templates;
+
     /**
      * Returns whether the given user-specified name is a valid resource name.
      */
@@ -141,7 +171,10 @@ public:
     );
 
     /**
-     * Builds a state tracker from the configured list of resources.
+     * Builds a state tracker from the configured list of resources. The
+     * resources are only initialized the first time this is called for a
+     * particular direction; after that, the result is a clone of the state
+     * built then.
      */
     State build(Direction direction = Direction::UNDEFINED) const;
 
@@ -4,8 +4,14 @@
 
 #pragma once
 
+#include <atomic>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/small_vec.h"
+#include "ql/utils/ptr.h"
+#include "ql/utils/json.h"
 #include "ql/ir/compat/compat.h"
 #include "ql/ir/ir.h"
 #include "ql/rmgr/types.h"
@@ -21,6 +27,12 @@ namespace resource_types {
  * acts as the least common denominator between them. When the old IR is phased
  * out, this structure can be removed, and gate()/on_gate() can be updated to
  * accept an ir::StatementRef directly.
+ *
+ * A GateData is constructed for every probe, so it avoids allocating memory:
+ * the name and JSON data refer to the gate or instruction type rather than
+ * being copies, and the qubit operands are stored inline for gates with up to
+ * three operands. A GateData is thus only valid for as long as the gate (and
+ * the IR it belongs to) is.
  */
 struct GateData {
 
@@ -39,7 +51,7 @@ struct GateData {
     /**
      * Reference to the name of the gate, valid for either IR type.
      */
-    utils::Str name;
+    utils::RawPtr<const utils::Str> name;
 
     /**
      * Reference to the duration of the gate in cycles, valid for either IR
@@ -52,7 +64,7 @@ struct GateData {
      * on the main qubit register, this is populated with the qubit indices.
      * Otherwise, it will be empty.
      */
-    utils::Vec<utils::UInt> qubits;
+    utils::SmallVec<utils::UInt, 3> qubits;
 
     /**
      * JSON data from the instruction definition in the platform configuration
@@ -62,6 +74,51 @@ struct GateData {
 
 };
 
+/**
+ * Performance counters for a resource, used to figure out which resource
+ * makes scheduling slow, and which resource actually constrains the schedule.
+ * The counters are shared between a resource and its clones, and are
+ * therefore atomic, as clones may be used from multiple threads.
+ */
+struct Statistics {
+
+    /**
+     * Number of times gate() was called with commit cleared.
+     */
+    std::atomic<utils::UInt> num_probes{0};
+
+    /**
+     * Number of gates committed by gate().
+     */
+    std::atomic<utils::UInt> num_commits{0};
+
+    /**
+     * Number of times gate() reported that a gate could not be scheduled.
+     */
+    std::atomic<utils::UInt> num_rejections{0};
+
+    /**
+     * Total number of gates passed to get_earliest().
+     */
+    std::atomic<utils::UInt> num_earliest_queries{0};
+
+    /**
+     * Time spent in gate() and get_earliest(), in nanoseconds.
+     */
+    std::atomic<utils::UInt> time{0};
+
+    /**
+     * Returns the counters as a JSON object. The time is in seconds.
+     */
+    utils::Json to_json() const;
+
+    /**
+     * Dumps the counters in human-readable form.
+     */
+    void dump(std::ostream &os, const utils::Str &line_prefix) const;
+
+};
+
 /**
  * Base class for scheduling resources. Scheduling resources are used to
  * represent constraints on when gates can be executed in a schedule, within
@@ -94,6 +151,30 @@ private:
      */
     utils::Int prev_cycle;
 
+    /**
+     * The value of prev_cycle at the time of each active checkpoint, innermost
+     * checkpoint last.
+     */
+    utils::Vec<utils::Int> checkpoints;
+
+    /**
+     * Performance counters for this resource, shared with its clones, or
+     * empty if statistics are disabled (the default).
+     */
+    utils::Ptr<Statistics> statistics;
+
+    /**
+     * Returns whether a gate at the given cycle would violate the scheduling
+     * direction, given the cycle of the previously committed gate.
+     */
+    utils::Bool is_out_of_order(utils::Int cycle) const {
+        switch (direction) {
+            case Direction::FORWARD: return cycle < prev_cycle;
+            case Direction::BACKWARD: return cycle > prev_cycle;
+            default: return false;
+        }
+    }
+
 protected:
 
     /**
@@ -102,6 +183,12 @@ protected:
      */
     explicit Base(const Context &context);
 
+    /**
+     * Returns the scheduling direction that the resource was initialized
+     * with.
+     */
+    Direction get_direction() const;
+
     /**
      * Abstract implementation for initialize(). This is where the JSON
      * structure should be parsed and the resource state should be initialized.
@@ -119,6 +206,50 @@ protected:
         utils::Bool commit
     ) = 0;
 
+    /**
+     * Abstract implementation for get_earliest(). Each entry of delays is a
+     * lower bound for the number of cycles after cycle (in the scheduling
+     * direction, or forward if there is none) at which the respective gate can
+     * be scheduled; the implementation must increase it to the smallest delay
+     * at which this resource alone accepts the gate, or to max_delay + 1 if
+     * that delay would exceed max_delay. The default implementation probes
+     * on_gate() for each successive cycle; resources that can compute the
+     * earliest cycle directly from their state should override it.
+     */
+    virtual void on_get_earliest(
+        utils::Int cycle,
+        const utils::Vec<GateData> &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    );
+
+    /**
+     * Abstract implementation for supports_checkpoints(). The default
+     * implementation returns false. Resources that override this to return
+     * true must also override on_checkpoint(), on_rollback(), and on_release(),
+     * and must record how to undo any state change they commit in on_gate()
+     * while a checkpoint is active.
+     */
+    virtual utils::Bool on_supports_checkpoints() const;
+
+    /**
+     * Abstract implementation for checkpoint(). The default implementation
+     * throws an exception.
+     */
+    virtual void on_checkpoint();
+
+    /**
+     * Abstract implementation for rollback(). The default implementation
+     * throws an exception.
+     */
+    virtual void on_rollback();
+
+    /**
+     * Abstract implementation for release(). The default implementation
+     * throws an exception.
+     */
+    virtual void on_release();
+
     /**
      * Abstract implementation for dump_docs().
      */
@@ -205,6 +336,50 @@ public:
         utils::Bool commit
     );
 
+    /**
+     * Same as gate() for GateData wrappers, but calls Derived::on_gate()
+     * directly rather than through the vtable, such that it can be inlined
+     * when the concrete type of the resource is known at compile time (see
+     * rmgr::StaticState). Derived must be the dynamic type of this resource
+     * and must be a friend of Base. Falls back to gate() when statistics are
+     * enabled.
+     */
+    template <class Derived>
+    utils::Bool gate_as(
+        utils::Int cycle,
+        const GateData &data,
+        utils::Bool commit
+    ) {
+        if (statistics.has_value()) {
+            return gate(cycle, data, commit);
+        }
+        if (!initialized) {
+            throw utils::Exception("resource gate() called before initialization");
+        }
+        if (is_out_of_order(cycle)) {
+            return false;
+        }
+        utils::Bool retval = static_cast<Derived&>(*this).Derived::on_gate(cycle, data, commit);
+        if (retval && commit) {
+            prev_cycle = cycle;
+        }
+        return retval;
+    }
+
+    /**
+     * Converts an old-IR gate to the GateData wrapper passed to on_gate().
+     * Resources sharing the same platform produce the same wrapper, so a
+     * collection of resources only needs to do this once per gate.
+     */
+    GateData make_gate_data(const ir::compat::GateRef &gate) const;
+
+    /**
+     * Converts a new-IR statement to the GateData wrapper passed to on_gate().
+     * Resources sharing the same platform produce the same wrapper, so a
+     * collection of resources only needs to do this once per gate.
+     */
+    GateData make_gate_data(const ir::StatementRef &statement) const;
+
     /**
      * Checks and optionally updates the resource manager state for the given
      * old-IR gate and (start) cycle number. The state is only updated if the
@@ -228,6 +403,85 @@ public:
         utils::Bool commit
     );
 
+    /**
+     * Computes, for each of the given gates, the smallest number of cycles
+     * after cycle (in the scheduling direction, or forward if there is none)
+     * at which this resource would accept the gate, assuming no further gates
+     * are committed in the meantime. The entries of delays should be
+     * initialized by the caller, and are treated as lower bounds; they are
+     * only ever increased. Delays that would exceed max_delay are set to
+     * max_delay + 1. Returns whether any delay was increased. Unlike probing
+     * gate() cycle by cycle, this does all gates in a single call, and lets
+     * resources skip directly past their reservations.
+     */
+    utils::Bool get_earliest(
+        utils::Int cycle,
+        const utils::Vec<GateData> &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    );
+
+    /**
+     * Same as get_earliest() for GateData wrappers, but for old-IR gates.
+     */
+    utils::Bool get_earliest(
+        utils::UInt cycle,
+        const ir::compat::GateRefs &gates,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    );
+
+    /**
+     * Same as get_earliest() for GateData wrappers, but for new-IR
+     * statements.
+     */
+    utils::Bool get_earliest(
+        utils::Int cycle,
+        const utils::Vec<ir::StatementRef> &statements,
+        utils::Vec<utils::UInt> &delays,
+        utils::UInt max_delay
+    );
+
+    /**
+     * Returns whether this resource supports checkpoint(), rollback(), and
+     * release(). If not, the only way to undo reservations is to restore a
+     * clone of the resource.
+     */
+    utils::Bool supports_checkpoints() const;
+
+    /**
+     * Pushes a checkpoint. Any gates committed after this can be undone
+     * using rollback(), until the checkpoint is released using release().
+     * Checkpoints can be nested; rollback() and release() always operate on
+     * the innermost active checkpoint.
+     */
+    void checkpoint();
+
+    /**
+     * Undoes all gates committed since the innermost active checkpoint, and
+     * removes that checkpoint.
+     */
+    void rollback();
+
+    /**
+     * Removes the innermost active checkpoint without undoing anything. The
+     * gates committed since then can still be undone by rolling back an outer
+     * checkpoint, if any.
+     */
+    void release();
+
+    /**
+     * Enables the performance counters for this resource. The counters are
+     * shared with all clones of the resource made after this call.
+     */
+    void enable_statistics();
+
+    /**
+     * Returns the performance counters for this resource, or an empty
+     * reference if statistics are disabled.
+     */
+    utils::Ptr<const Statistics> get_statistics() const;
+
     /**
      * Dumps a debug representation of the current resource state.
      */
@@ -238,6 +492,75 @@ public:
 
 };
 
+/**
+ * Undo log for resources that store their state as a vector of per-element
+ * states, such as one state per qubit. Resource implementations supporting
+ * checkpoints call record() from on_gate() right before modifying an element
+ * of their state vector, and forward on_checkpoint(), on_rollback(), and
+ * on_release() to the functions of the same name. Nothing is recorded while no
+ * checkpoint is active, so resources that are never checkpointed pay nothing
+ * more than a branch.
+ */
+template <typename T>
+class UndoLog {
+private:
+
+    /**
+     * The previous states of modified elements, in the order in which they
+     * were recorded.
+     */
+    utils::Vec<utils::Pair<utils::UInt, T>> entries;
+
+    /**
+     * The size of entries at the time of each active checkpoint.
+     */
+    utils::Vec<utils::UInt> marks;
+
+public:
+
+    /**
+     * Records the current state of the given element, such that it can be
+     * restored on rollback.
+     */
+    void record(const utils::Vec<T> &state, utils::UInt index) {
+        if (!marks.empty()) {
+            entries.emplace_back(index, state[index]);
+        }
+    }
+
+    /**
+     * Pushes a checkpoint.
+     */
+    void on_checkpoint() {
+        marks.push_back(entries.size());
+    }
+
+    /**
+     * Restores all elements recorded since the innermost checkpoint in reverse
+     * order, and pops the checkpoint.
+     */
+    void on_rollback(utils::Vec<T> &state) {
+        auto mark = marks.back();
+        marks.pop_back();
+        while (entries.size() > mark) {
+            state[entries.back().first] = std::move(entries.back().second);
+            entries.pop_back();
+        }
+    }
+
+    /**
+     * Pops the innermost checkpoint. The log is cleared when no checkpoints
+     * remain.
+     */
+    void on_release() {
+        marks.pop_back();
+        if (marks.empty()) {
+            entries.clear();
+        }
+    }
+
+};
+
 /**
  * A mutable reference to a resource.
  */
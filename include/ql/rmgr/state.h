@@ -15,8 +15,11 @@
 namespace ql {
 namespace rmgr {
 
-// Forward declaration for the manager, so we can declare it as a friend.
+// Forward declarations for the manager and StaticState, so we can declare
+// them as friends.
 class Manager;
+template <class... Resources>
+class StaticState;
 
 /**
  * Maintains the state of a collection of scheduling resources.
@@ -24,6 +27,8 @@ class Manager;
 class State {
 private:
     friend class Manager;
+    template <class... Resources>
+    friend class StaticState;
 
     /**
      * The list of resources and their state.
@@ -37,6 +42,38 @@ private:
      */
     utils::Bool is_broken;
 
+    /**
+     * Information saved for an active checkpoint.
+     */
+    struct Checkpoint {
+
+        /**
+         * Clones of the resources that don't support checkpoints themselves,
+         * taken when the checkpoint was made. Indexed in the same way as
+         * resources; entries for resources that do support checkpoints are
+         * empty.
+         */
+        utils::Vec<ResourceRef> clones;
+
+        /**
+         * The value of is_broken when the checkpoint was made.
+         */
+        utils::Bool is_broken;
+
+    };
+
+    /**
+     * The stack of active checkpoints, innermost checkpoint last. The token
+     * returned by checkpoint() is the index into this vector.
+     */
+    utils::Vec<Checkpoint> checkpoints;
+
+    /**
+     * Copies the checkpoint stack of src into this, cloning the resource clones
+     * contained in it.
+     */
+    void copy_checkpoints(const State &src);
+
     /**
      * Constructor for the initial state, called from Manager::build().
      */
@@ -103,6 +140,76 @@ public:
         const ir::StatementRef &statement
     );
 
+    /**
+     * Computes, for each of the given old-IR gates, the earliest (start) cycle
+     * at or after the given cycle at which it could be scheduled, assuming
+     * nothing else is reserved in the meantime. This is done in a single pass
+     * per resource rather than by probing available() cycle by cycle. The
+     * result is returned as the number of cycles after the given cycle; when
+     * this number would exceed max_delay, max_delay + 1 is returned instead.
+     */
+    utils::Vec<utils::UInt> get_earliest(
+        utils::UInt cycle,
+        const ir::compat::GateRefs &gates,
+        utils::UInt max_delay
+    ) const;
+
+    /**
+     * Computes, for each of the given new-IR statements, the earliest (start)
+     * cycle at or after the given cycle in the scheduling direction at which
+     * it could be scheduled, assuming nothing else is reserved in the
+     * meantime. This is done in a single pass per resource rather than by
+     * probing available() cycle by cycle. The result is returned as the
+     * number of cycles after (or before, when scheduling backward) the given
+     * cycle; when this number would exceed max_delay, max_delay + 1 is
+     * returned instead.
+     */
+    utils::Vec<utils::UInt> get_earliest(
+        utils::Int cycle,
+        const utils::Vec<ir::StatementRef> &statements,
+        utils::UInt max_delay
+    ) const;
+
+    /**
+     * Makes a checkpoint of the current state, such that all reservations
+     * made after this can be undone using rollback(). This is much cheaper
+     * than copying the state for resources that support checkpoints, because
+     * they only keep an undo log of the reservations made after the
+     * checkpoint; other resources are cloned. Checkpoints can be nested. The
+     * returned token identifies the checkpoint for rollback() and release().
+     */
+    utils::UInt checkpoint();
+
+    /**
+     * Restores the state to what it was when the checkpoint identified by the
+     * given token was made. The checkpoint and all checkpoints made after it
+     * are no longer active after this.
+     */
+    void rollback(utils::UInt token);
+
+    /**
+     * Deactivates the checkpoint identified by the given token and all
+     * checkpoints made after it, without undoing any reservations. This
+     * should be done as soon as a checkpoint is no longer needed, because
+     * resources keep their undo log for as long as any checkpoint is active.
+     */
+    void release(utils::UInt token);
+
+    /**
+     * Enables the performance counters of all resources (see
+     * resource_types::Statistics). The counters are shared with all copies of
+     * this state made after this call. They are included in dump() from then
+     * on.
+     */
+    void enable_statistics();
+
+    /**
+     * Returns the performance counters of all resources as a JSON array of
+     * objects, each also containing the name and type of the resource.
+     * Resources for which statistics are disabled are omitted.
+     */
+    utils::Json get_statistics() const;
+
     /**
      * Dumps a debug representation of the current resource state.
      */
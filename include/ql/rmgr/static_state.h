@@ -0,0 +1,349 @@
+/** \file
+ * Defines a resource state for a collection of resources of which the types
+ * are known at compile time.
+ */
+
+#pragma once
+
+#include <tuple>
+#include <typeinfo>
+#include <type_traits>
+#include "ql/utils/num.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/json.h"
+#include "ql/utils/exception.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/describe.h"
+#include "ql/rmgr/resource_types/base.h"
+#include "ql/rmgr/state.h"
+
+namespace ql {
+namespace rmgr {
+
+/**
+ * Drop-in replacement for State for the new-IR functions used by the
+ * scheduler, for when the set of resource types in use is known at compile
+ * time. The resources are stored by value, grouped per type, and available()
+ * and reserve() call their on_gate() implementations directly rather than
+ * through the vtable (see resource_types::Base::gate_as()). This allows the
+ * compiler to inline resource implementations that are defined in their
+ * header, and in any case avoids cloning resources through pointers when the
+ * scheduler state is copied.
+ *
+ * All types in Resources must be final resource classes that are friends of
+ * resource_types::Base, and each type can only be listed once; a type list
+ * may be used for any State with at least one resource, of which each
+ * resource has one of the listed types, as checked by matches(). The relative
+ * order of the resources of State is retained for everything that reports
+ * resources by name. Checkpoints are not supported; use State for that.
+ */
+template <class... Resources>
+class StaticState {
+private:
+
+    /**
+     * The number of resource types.
+     */
+    static constexpr utils::UInt NUM_TYPES = sizeof...(Resources);
+
+    /**
+     * Tuple of vectors, with one vector of resource instances per type.
+     */
+    using Tuple = std::tuple<utils::Vec<Resources>...>;
+
+    /**
+     * Shorthand for the resource type at the given index in the type list.
+     */
+    template <utils::UInt I>
+    using ResourceAt = typename std::tuple_element<I, Tuple>::type::value_type;
+
+    /**
+     * The resource instances and their state. This is mutable because probing
+     * a resource (gate() with commit cleared) does not modify its state,
+     * though the resource interface does not make that distinction.
+     */
+    mutable Tuple resources;
+
+    /**
+     * The resources in the order of the State this was constructed from, as
+     * pairs of type index and index within the vector for that type.
+     */
+    utils::Vec<utils::Pair<utils::UInt, utils::UInt>> order;
+
+    /**
+     * Set when reserve() returned an error, implying that the resources are in
+     * an inconsistent state. When set, further calls to available() and
+     * reserve() will immediately throw an exception.
+     */
+    utils::Bool is_broken;
+
+    /**
+     * Returns the index of the dynamic type of the given resource in the type
+     * list, or NUM_TYPES if it is not listed.
+     */
+    template <utils::UInt I = 0>
+    static typename std::enable_if<I == NUM_TYPES, utils::UInt>::type
+    find_type(const resource_types::Base &) {
+        return NUM_TYPES;
+    }
+
+    /**
+     * Returns the index of the dynamic type of the given resource in the type
+     * list, or NUM_TYPES if it is not listed.
+     */
+    template <utils::UInt I = 0>
+    static typename std::enable_if<I < NUM_TYPES, utils::UInt>::type
+    find_type(const resource_types::Base &resource) {
+        if (typeid(resource) == typeid(ResourceAt<I>)) {
+            return I;
+        }
+        return find_type<I + 1>(resource);
+    }
+
+    /**
+     * Appends a copy of the given resource to the vector for its type, which
+     * must have the given index in the type list.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I == NUM_TYPES>::type
+    add(utils::UInt, const resource_types::Base &) {
+        QL_ICE("resource type is not part of the static resource type list");
+    }
+
+    /**
+     * Appends a copy of the given resource to the vector for its type, which
+     * must have the given index in the type list.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I < NUM_TYPES>::type
+    add(utils::UInt type, const resource_types::Base &resource) {
+        if (type != I) {
+            add<I + 1>(type, resource);
+            return;
+        }
+        auto &instances = std::get<I>(resources);
+        order.emplace_back(I, instances.size());
+        instances.push_back(static_cast<const ResourceAt<I>&>(resource));
+    }
+
+    /**
+     * Returns the resource identified by the given entry of order.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I == NUM_TYPES, resource_types::Base&>::type
+    get(const utils::Pair<utils::UInt, utils::UInt> &) const {
+        QL_ICE("resource type index out of range");
+    }
+
+    /**
+     * Returns the resource identified by the given entry of order.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I < NUM_TYPES, resource_types::Base&>::type
+    get(const utils::Pair<utils::UInt, utils::UInt> &entry) const {
+        if (entry.first != I) {
+            return get<I + 1>(entry);
+        }
+        return std::get<I>(resources)[entry.second];
+    }
+
+    /**
+     * Passes the given gate to all resources, stopping at the first resource
+     * that rejects it, which is then returned via failed.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I == NUM_TYPES, utils::Bool>::type
+    gate_all(
+        utils::Int,
+        const resource_types::GateData &,
+        utils::Bool,
+        const resource_types::Base *&
+    ) const {
+        return true;
+    }
+
+    /**
+     * Passes the given gate to all resources, stopping at the first resource
+     * that rejects it, which is then returned via failed.
+     */
+    template <utils::UInt I = 0>
+    typename std::enable_if<I < NUM_TYPES, utils::Bool>::type
+    gate_all(
+        utils::Int cycle,
+        const resource_types::GateData &data,
+        utils::Bool commit,
+        const resource_types::Base *&failed
+    ) const {
+        for (auto &resource : std::get<I>(resources)) {
+            if (!resource.template gate_as<ResourceAt<I>>(cycle, data, commit)) {
+                failed = &resource;
+                return false;
+            }
+        }
+        return gate_all<I + 1>(cycle, data, commit, failed);
+    }
+
+    /**
+     * Throws an exception if a previous reserve() failed.
+     */
+    void check_broken() const {
+        if (is_broken) {
+            throw utils::Exception("usage of resource state that was left in an undefined state");
+        }
+    }
+
+    /**
+     * Converts a statement to the wrapper passed to the resources.
+     */
+    resource_types::GateData make_gate_data(const ir::StatementRef &statement) const {
+        return get(order.front()).make_gate_data(statement);
+    }
+
+public:
+
+    /**
+     * Returns whether the given state can be converted to this type, i.e.
+     * whether it has at least one resource, all its resources have one of the
+     * listed types, and no checkpoints are active.
+     */
+    static utils::Bool matches(const State &state) {
+        if (state.resources.empty() || !state.checkpoints.empty()) {
+            return false;
+        }
+        for (const auto &resource : state.resources) {
+            if (find_type(*resource) == NUM_TYPES) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Constructs from the given dynamic state, which must match as per
+     * matches(). The resources are copied.
+     */
+    explicit StaticState(const State &state) : is_broken(state.is_broken) {
+        if (!matches(state)) {
+            QL_ICE("resource state does not match static resource type list");
+        }
+        for (const auto &resource : state.resources) {
+            add(find_type(*resource), *resource);
+        }
+    }
+
+    /**
+     * Checks whether the given new-IR statement can be scheduled at the given
+     * (start) cycle. Note that the cycle number may be negative.
+     */
+    utils::Bool available(
+        utils::Int cycle,
+        const ir::StatementRef &statement
+    ) const {
+        check_broken();
+        const resource_types::Base *failed = nullptr;
+        return gate_all(cycle, make_gate_data(statement), false, failed);
+    }
+
+    /**
+     * Schedules the given new-IR statement at the given (start) cycle. Throws
+     * an exception if this is not possible. When an exception is thrown, the
+     * resulting state of the resources is undefined. Note that the cycle number
+     * may be negative.
+     */
+    void reserve(
+        utils::Int cycle,
+        const ir::StatementRef &statement
+    ) {
+        check_broken();
+        const resource_types::Base *failed = nullptr;
+        if (!gate_all(cycle, make_gate_data(statement), true, failed)) {
+            is_broken = true;
+            utils::StrStrm ss;
+            ss << "failed to reserve " << ir::describe(statement);
+            ss << " for cycle " << cycle;
+            ss << " with resource " << failed->get_name();
+            ss << " of type " << failed->get_type();
+            throw utils::Exception(ss.str());
+        }
+    }
+
+    /**
+     * Same as State::get_earliest() for new-IR statements. The statements
+     * are converted to resource_types::GateData only once for all resources.
+     */
+    utils::Vec<utils::UInt> get_earliest(
+        utils::Int cycle,
+        const utils::Vec<ir::StatementRef> &statements,
+        utils::UInt max_delay
+    ) const {
+        check_broken();
+        utils::Vec<resource_types::GateData> gates;
+        gates.reserve(statements.size());
+        for (const auto &statement : statements) {
+            gates.push_back(make_gate_data(statement));
+        }
+        utils::Vec<utils::UInt> delays(gates.size(), 0);
+        utils::UInt num_agreeing = 0;
+        utils::UInt index = 0;
+        while (num_agreeing < order.size()) {
+            if (get(order[index]).get_earliest(cycle, gates, delays, max_delay)) {
+                num_agreeing = 1;
+            } else {
+                num_agreeing++;
+            }
+            index = (index + 1) % order.size();
+        }
+        return delays;
+    }
+
+    /**
+     * Same as State::enable_statistics(). Note that resources with statistics
+     * enabled are called through the vtable again.
+     */
+    void enable_statistics() {
+        for (const auto &entry : order) {
+            get(entry).enable_statistics();
+        }
+    }
+
+    /**
+     * Same as State::get_statistics().
+     */
+    utils::Json get_statistics() const {
+        auto json = utils::Json::array();
+        for (const auto &entry : order) {
+            const auto &resource = get(entry);
+            auto statistics = resource.get_statistics();
+            if (!statistics.has_value()) {
+                continue;
+            }
+            auto stats = statistics->to_json();
+            stats["name"] = resource.get_name();
+            stats["type"] = resource.get_type();
+            json.push_back(stats);
+        }
+        return json;
+    }
+
+    /**
+     * Dumps a debug representation of the current resource state.
+     */
+    void dump(
+        std::ostream &os = std::cout,
+        const utils::Str &line_prefix = ""
+    ) const {
+        for (const auto &entry : order) {
+            const auto &resource = get(entry);
+            os << line_prefix << "Resource " << resource.get_name();
+            os << " of type " << resource.get_type() << ":\n";
+            resource.dump_state(os, line_prefix + "    ");
+            os << "\n";
+        }
+        os.flush();
+    }
+
+};
+
+} // namespace rmgr
+} // namespace ql
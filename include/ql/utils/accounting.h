@@ -0,0 +1,191 @@
+/** \file
+ * Optional accounting of the memory allocated for objects constructed with
+ * utils::make(), used by the pass profiler to attribute memory usage to
+ * passes.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include "ql/utils/num.h"
+#include "ql/utils/arena.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Snapshot of the allocation counters.
+ */
+struct AllocationCounters {
+
+    /**
+     * Total number of bytes allocated while accounting was enabled.
+     */
+    UInt allocated;
+
+    /**
+     * Total number of bytes freed of the allocations counted in allocated.
+     */
+    UInt freed;
+
+    /**
+     * The largest number of live bytes since the last call to
+     * AllocationAccounting::exchange_peak().
+     */
+    UInt peak;
+
+    /**
+     * Returns the number of bytes of the counted allocations that are still
+     * live.
+     */
+    UInt get_live() const {
+        return allocated - freed;
+    }
+
+};
+
+/**
+ * Process-wide accounting of the memory allocated by utils::make(), which is
+ * used to construct all IR tree nodes and old-IR gates. While accounting is
+ * enabled (see AccountAllocations), objects are allocated through
+ * CountingAllocator, which records the size of every allocation and of the
+ * corresponding deallocation, even if the latter happens after accounting is
+ * disabled again. Heap allocations are counted using the size reported by
+ * malloc_usable_size() when compiling against glibc, so allocator overhead
+ * is included; otherwise, and for allocations from an arena, the requested
+ * size is counted. Note that memory freed back to an arena is counted as
+ * freed, even though the arena only releases it when it is destroyed.
+ *
+ * The counters are shared by all threads, so when multiple programs are
+ * compiled concurrently, their allocations are mixed.
+ */
+class AllocationAccounting {
+public:
+
+    /**
+     * Returns whether allocations made by utils::make() are currently being
+     * counted.
+     */
+    static Bool is_enabled();
+
+    /**
+     * Records an allocation of the given number of bytes at the given
+     * address.
+     */
+    static void record_allocation(void *ptr, UInt size, Bool from_heap);
+
+    /**
+     * Records a deallocation of an allocation previously recorded with
+     * record_allocation() using the same arguments.
+     */
+    static void record_deallocation(void *ptr, UInt size, Bool from_heap) noexcept;
+
+    /**
+     * Returns the current values of the counters.
+     */
+    static AllocationCounters get_counters();
+
+    /**
+     * Sets the peak counter to the given value or the current number of live
+     * bytes, whichever is larger, and returns its previous value. This allows
+     * the peak to be measured for a region of code, after which the peak of
+     * the enclosing region can be restored.
+     */
+    static UInt exchange_peak(UInt peak);
+
+};
+
+/**
+ * RAII object that enables allocation accounting for as long as it exists.
+ * Multiple instances may exist at once; accounting is enabled while any of
+ * them exist.
+ */
+class AccountAllocations {
+public:
+
+    /**
+     * Enables allocation accounting.
+     */
+    AccountAllocations();
+
+    /**
+     * Disables allocation accounting, unless other instances still exist.
+     */
+    ~AccountAllocations();
+
+    AccountAllocations(const AccountAllocations &) = delete;
+    AccountAllocations &operator=(const AccountAllocations &) = delete;
+
+};
+
+/**
+ * Standard allocator that records its allocations with AllocationAccounting,
+ * for use with std::allocate_shared(). Memory is taken from the given arena,
+ * or from the heap if the arena reference is empty.
+ */
+template <class T>
+class CountingAllocator {
+public:
+
+    using value_type = T;
+
+    /**
+     * The arena that memory is taken from, if any.
+     */
+    ArenaRef arena;
+
+    /**
+     * Constructs an allocator for the given arena, or for the heap if the
+     * reference is empty.
+     */
+    explicit CountingAllocator(const ArenaRef &arena) : arena(arena) {
+    }
+
+    /**
+     * Converts an allocator for a different type.
+     */
+    template <class U>
+    CountingAllocator(const CountingAllocator<U> &other) : arena(other.arena) {
+    }
+
+    /**
+     * Allocates memory for n objects of type T.
+     */
+    T *allocate(std::size_t n) {
+        auto size = n * sizeof(T);
+        void *ptr;
+        if (arena.has_value()) {
+            ptr = arena->allocate(size, alignof(T));
+        } else {
+            ptr = ::operator new(size);
+        }
+        AllocationAccounting::record_allocation(ptr, size, !arena.has_value());
+        return static_cast<T*>(ptr);
+    }
+
+    /**
+     * Frees the memory for n objects of type T. If the memory was taken from
+     * an arena, it is only released when the arena is destroyed.
+     */
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        AllocationAccounting::record_deallocation(ptr, n * sizeof(T), !arena.has_value());
+        if (!arena.has_value()) {
+            ::operator delete(ptr);
+        }
+    }
+
+    template <class U>
+    Bool operator==(const CountingAllocator<U> &other) const {
+        return arena.unwrap() == other.arena.unwrap();
+    }
+
+    template <class U>
+    Bool operator!=(const CountingAllocator<U> &other) const {
+        return arena.unwrap() != other.arena.unwrap();
+    }
+
+};
+
+} // namespace utils
+} // namespace ql
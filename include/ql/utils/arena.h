@@ -0,0 +1,207 @@
+/** \file
+ * Defines a bump allocator for tree nodes, used to avoid the cost of
+ * allocating and freeing many small nodes individually.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ql/utils/num.h"
+#include "ql/utils/ptr.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Bump allocator for objects that are constructed with utils::make(). Memory
+ * is taken from large chunks that are only released when the arena itself is
+ * destroyed; freeing an object runs its destructor but does not make its
+ * memory available again. Objects allocated from an arena keep it alive, so
+ * the arena is destroyed (and all its memory released in bulk) when the last
+ * object allocated from it is freed.
+ *
+ * This makes construction and destruction of large trees considerably cheaper
+ * than allocating every node on the heap separately, at the cost of never
+ * reusing the memory of nodes that are freed while the arena is still alive.
+ * Use UseArena to make utils::make() allocate from an arena in the current
+ * thread.
+ */
+class Arena {
+private:
+
+    /**
+     * The minimum size of the chunks that memory is taken from.
+     */
+    const UInt chunk_size;
+
+    /**
+     * Mutex protecting the fields below, in case the arena is used by multiple
+     * threads at once.
+     */
+    std::mutex mutex;
+
+    /**
+     * All chunks allocated so far.
+     */
+    std::vector<std::unique_ptr<char[]>> chunks;
+
+    /**
+     * Pointer to the unused part of the current chunk.
+     */
+    char *next;
+
+    /**
+     * Number of unused bytes in the current chunk.
+     */
+    UInt remaining;
+
+    /**
+     * Total number of bytes handed out so far.
+     */
+    UInt allocated;
+
+    /**
+     * Total size of all chunks allocated so far.
+     */
+    UInt reserved;
+
+public:
+
+    /**
+     * Constructs an arena that allocates memory in chunks of at least the
+     * given size.
+     */
+    explicit Arena(UInt chunk_size = 1024 * 1024);
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    /**
+     * Allocates size bytes of memory with the given alignment, which must be
+     * a power of two no larger than alignof(std::max_align_t).
+     */
+    void *allocate(UInt size, UInt alignment);
+
+    /**
+     * Releases everything allocated from the arena at once, such that the
+     * reserved memory can be reused. This must only be called when none of
+     * the objects allocated from the arena are alive anymore. If the arena
+     * spans multiple chunks, they are merged into a single chunk, such that
+     * the next round of allocations of the same size fits in one chunk.
+     */
+    void reset();
+
+    /**
+     * Returns the total number of bytes handed out by allocate() since
+     * construction or the last reset().
+     */
+    UInt get_allocated();
+
+    /**
+     * Returns the total number of bytes reserved by the arena so far.
+     */
+    UInt get_reserved();
+
+    /**
+     * Returns the arena that utils::make() allocates from in the current
+     * thread, or an empty pointer if the heap is used.
+     */
+    static const Ptr<Arena> &get_active();
+
+};
+
+/**
+ * Shared reference to an arena.
+ */
+using ArenaRef = Ptr<Arena>;
+
+/**
+ * RAII object that makes utils::make() allocate from the given arena in the
+ * current thread for as long as it exists. Scopes may be nested. Passing an
+ * empty reference makes utils::make() use the heap again.
+ */
+class UseArena {
+private:
+
+    /**
+     * The arena that was active in the current thread before us.
+     */
+    ArenaRef previous;
+
+public:
+
+    /**
+     * Makes utils::make() allocate from the given arena in the current thread.
+     */
+    explicit UseArena(const ArenaRef &arena);
+
+    /**
+     * Restores the previously active arena of the current thread.
+     */
+    ~UseArena();
+
+    UseArena(const UseArena &) = delete;
+    UseArena &operator=(const UseArena &) = delete;
+
+};
+
+/**
+ * Standard allocator that takes its memory from an arena, for use with
+ * std::allocate_shared(). The allocator holds a reference to the arena, so
+ * the control block of a shared pointer allocated with it keeps the arena
+ * alive until the object is freed.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+
+    using value_type = T;
+
+    /**
+     * The arena that memory is taken from.
+     */
+    ArenaRef arena;
+
+    /**
+     * Constructs an allocator for the given arena.
+     */
+    explicit ArenaAllocator(const ArenaRef &arena) : arena(arena) {
+    }
+
+    /**
+     * Converts an allocator for a different type.
+     */
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {
+    }
+
+    /**
+     * Allocates memory for n objects of type T.
+     */
+    T *allocate(std::size_t n) {
+        return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    /**
+     * Does nothing; the memory is released when the arena is destroyed.
+     */
+    void deallocate(T*, std::size_t) noexcept {
+    }
+
+    template <class U>
+    Bool operator==(const ArenaAllocator<U> &other) const {
+        return arena.unwrap() == other.arena.unwrap();
+    }
+
+    template <class U>
+    Bool operator!=(const ArenaAllocator<U> &other) const {
+        return arena.unwrap() != other.arena.unwrap();
+    }
+
+};
+
+} // namespace utils
+} // namespace ql
@@ -0,0 +1,179 @@
+/** \file
+ * Asynchronous writing of side outputs (reports, DOT graphs, cQASM dumps,
+ * etc.), to keep disk I/O off the critical path of compilation.
+ */
+
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/opt.h"
+#include "ql/utils/filesystem.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * RAII object that, for as long as it exists, causes the files written by the
+ * constructing thread through AsyncOutFile to be handed off to a background
+ * I/O thread rather than being written synchronously. The contents of files
+ * that have not yet been written are queued in memory; when the queue exceeds
+ * the given number of bytes, AsyncOutFile blocks until the I/O thread catches
+ * up. When multiple instances are constructed by the same thread, the most
+ * recent one is used until it is destroyed.
+ *
+ * Errors encountered by the I/O thread are thrown by flush(). The destructor
+ * waits for all queued files to be written as well, but can only log errors,
+ * so flush() should be called first when nothing else is going wrong.
+ *
+ * When OpenQL is built with QL_SINGLE_THREADED, files are written
+ * synchronously when they are closed.
+ */
+class AsyncOutput {
+public:
+
+    /**
+     * The default maximum number of queued bytes.
+     */
+    static constexpr UInt DEFAULT_QUEUE_LIMIT = 64ull * 1024 * 1024;
+
+private:
+
+    /**
+     * The queue and background thread, defined in the source file.
+     */
+    class Writer;
+
+    /**
+     * The queue and background thread for this instance.
+     */
+    std::unique_ptr<Writer> writer;
+
+    /**
+     * The instance that was active for this thread before this one was
+     * constructed.
+     */
+    AsyncOutput *previous;
+
+public:
+
+    /**
+     * Starts asynchronous writing of output files for the calling thread,
+     * queueing at most the given number of bytes.
+     */
+    explicit AsyncOutput(UInt max_queued_bytes = DEFAULT_QUEUE_LIMIT);
+
+    /**
+     * Waits until all queued files have been written, logging any errors,
+     * and reverts to the previously active instance, if any.
+     */
+    ~AsyncOutput();
+
+    AsyncOutput(const AsyncOutput &) = delete;
+    AsyncOutput &operator=(const AsyncOutput &) = delete;
+
+    /**
+     * Waits until all files queued thus far have been written. Throws an
+     * Exception if any of them could not be written.
+     */
+    void flush();
+
+    /**
+     * Returns the instance that is active for the calling thread, or nullptr
+     * if files are to be written synchronously.
+     */
+    static AsyncOutput *get_current();
+
+    /**
+     * Queues the given contents to be written to the given file. The path
+     * must already have been made relative to the OpenQL working directory of
+     * the calling thread. Blocks while the queue is full.
+     */
+    void submit(const Str &path, Bool binary, Str &&contents);
+
+};
+
+/**
+ * Drop-in replacement for OutFile for side outputs that nothing reads back
+ * during compilation. When an AsyncOutput object is active for the calling
+ * thread, the contents are buffered and handed off to its I/O thread when the
+ * file is closed or destroyed, so errors are only reported by
+ * AsyncOutput::flush(). Otherwise, or when an OutputCapture is active, this
+ * behaves exactly like OutFile.
+ */
+class AsyncOutFile {
+private:
+
+    /**
+     * The synchronously written file, when asynchronous output is disabled.
+     */
+    Opt<OutFile> file;
+
+    /**
+     * The buffer for the contents, when asynchronous output is enabled.
+     */
+    std::ostringstream buffer;
+
+    /**
+     * The path to write to, relative to the OpenQL working directory at the
+     * time of construction.
+     */
+    Str path;
+
+    /**
+     * Whether the file is to be written in binary mode.
+     */
+    Bool binary;
+
+    /**
+     * The output that the buffer is submitted to, or nullptr if the file is
+     * written synchronously or has already been submitted.
+     */
+    AsyncOutput *output;
+
+public:
+
+    /**
+     * Opens the given file, or prepares to write it asynchronously.
+     */
+    explicit AsyncOutFile(const Str &path, Bool binary = false);
+
+    /**
+     * Closes the file if this has not been done yet.
+     */
+    ~AsyncOutFile() noexcept(false);
+
+    AsyncOutFile(const AsyncOutFile &) = delete;
+    AsyncOutFile &operator=(const AsyncOutFile &) = delete;
+
+    /**
+     * Writes to the file.
+     */
+    void write(const Str &content);
+
+    /**
+     * Closes the file, or submits its contents to the I/O thread.
+     */
+    void close();
+
+    /**
+     * Provides access to the underlying stream.
+     */
+    std::ostream &unwrap();
+
+    template <typename T>
+    AsyncOutFile &operator<<(T &&rhs) {
+        if (file.has_value()) {
+            *file << std::forward<T>(rhs);
+        } else {
+            buffer << std::forward<T>(rhs);
+        }
+        return *this;
+    }
+
+};
+
+} // namespace utils
+} // namespace ql
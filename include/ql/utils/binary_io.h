@@ -0,0 +1,157 @@
+/** \file
+ * Helpers for reading and writing the little-endian records of OpenQL's
+ * binary file formats.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/json.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Appends little-endian binary data to a string buffer.
+ */
+class BinaryWriter {
+private:
+
+    /**
+     * The buffer being written to.
+     */
+    Str &buf;
+
+public:
+
+    /**
+     * Constructs a writer that appends to the given buffer.
+     */
+    explicit BinaryWriter(Str &buf);
+
+    /**
+     * Writes an unsigned integer using the given number of bytes.
+     */
+    void write_uint(UInt value, UInt num_bytes = 8);
+
+    /**
+     * Writes a signed integer as a 64-bit two's complement number.
+     */
+    void write_int(Int value);
+
+    /**
+     * Writes raw bytes.
+     */
+    void write_bytes(const char *data, UInt size);
+
+    /**
+     * Writes a length-prefixed string.
+     */
+    void write_str(const Str &value);
+
+    /**
+     * Writes a JSON value as a length-prefixed CBOR record.
+     */
+    void write_json(const Json &value);
+
+    /**
+     * Writes a length-prefixed vector of unsigned integers, each using the
+     * given number of bytes.
+     */
+    template <class T>
+    void write_uints(const Vec<T> &values, UInt num_bytes = 8) {
+        write_uint(values.size());
+        for (const auto &value : values) {
+            write_uint((UInt)value, num_bytes);
+        }
+    }
+
+};
+
+/**
+ * Reads little-endian binary data written by BinaryWriter from a buffer. The
+ * buffer is not copied, so it may for instance be a memory-mapped file, but
+ * it must outlive the reader. All reads are bounds-checked; reading past the
+ * end of the buffer throws a user error mentioning what was being read.
+ */
+class BinaryReader {
+private:
+
+    /**
+     * The next byte to read.
+     */
+    const char *data;
+
+    /**
+     * The end of the buffer.
+     */
+    const char *end;
+
+    /**
+     * Description of what is being read, for error messages.
+     */
+    Str what;
+
+public:
+
+    /**
+     * Constructs a reader for the given buffer. what describes the contents
+     * of the buffer for error messages, for example "platform snapshot".
+     */
+    BinaryReader(const char *data, UInt size, const Str &what);
+
+    /**
+     * Returns the number of bytes that remain to be read.
+     */
+    UInt remaining() const;
+
+    /**
+     * Returns a pointer to the next size bytes, and skips past them.
+     */
+    const char *read_bytes(UInt size);
+
+    /**
+     * Reads an unsigned integer stored using the given number of bytes.
+     */
+    UInt read_uint(UInt num_bytes = 8);
+
+    /**
+     * Reads a signed integer stored as a 64-bit two's complement number.
+     */
+    Int read_int();
+
+    /**
+     * Reads the length prefix of an array of elements of the given size, and
+     * checks that the array fits in the remaining data.
+     */
+    UInt read_length(UInt element_size);
+
+    /**
+     * Reads a length-prefixed string.
+     */
+    Str read_str();
+
+    /**
+     * Reads a JSON value stored as a length-prefixed CBOR record.
+     */
+    Json read_json();
+
+    /**
+     * Reads a length-prefixed vector of unsigned integers, each stored using
+     * the given number of bytes.
+     */
+    template <class T>
+    Vec<T> read_uints(UInt num_bytes = 8) {
+        Vec<T> values(read_length(num_bytes));
+        for (auto &value : values) {
+            value = (T)read_uint(num_bytes);
+        }
+        return values;
+    }
+
+};
+
+} // namespace utils
+} // namespace ql
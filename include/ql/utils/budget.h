@@ -0,0 +1,158 @@
+/** \file
+ * Compile-time budgets, allowing expensive algorithms to degrade gracefully
+ * when compilation takes longer than allowed.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/json.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * RAII object that, for as long as it exists, imposes a time limit on the
+ * work done by the constructing thread and the thread pool tasks it submits.
+ * Nothing is ever interrupted; instead, algorithms that can trade result
+ * quality for time (the mapper heuristics, MIP placement, unitary
+ * decomposition) poll is_exceeded() at convenient points and switch to a
+ * cheaper strategy once the budget is exhausted, reporting this via
+ * report_degradation().
+ *
+ * Budgets nest: when multiple instances are constructed by the same thread,
+ * the most recent one is used until it is destroyed, and its deadline is the
+ * earliest of its own and that of the enclosing budget. Degradations are
+ * recorded with the outermost budget, such that they can be reported once
+ * for the whole compilation.
+ */
+class TimeBudget {
+public:
+
+    /**
+     * The clock source to use.
+     */
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * A record of an algorithm that degraded due to budget pressure.
+     */
+    struct Degradation {
+
+        /**
+         * The algorithm or pass that degraded.
+         */
+        Str source;
+
+        /**
+         * What it did instead of what it would normally do.
+         */
+        Str message;
+
+        /**
+         * When this happened, in seconds since the outermost budget was
+         * started.
+         */
+        Real time;
+
+    };
+
+private:
+
+    /**
+     * The degradations reported thus far, shared by nested budgets and
+     * protected by a mutex. Defined in the source file.
+     */
+    class Record;
+
+    /**
+     * The record shared by this budget and the budgets nested inside it.
+     */
+    std::shared_ptr<Record> record;
+
+    /**
+     * The time at which this budget is exhausted, or Clock::time_point::max()
+     * if there is no limit.
+     */
+    Clock::time_point deadline;
+
+    /**
+     * The budget that was active for this thread before this one was
+     * constructed.
+     */
+    TimeBudget *previous;
+
+public:
+
+    /**
+     * Starts a budget of the given number of seconds for the calling thread,
+     * nested in the currently active budget, if any. Zero or less means that
+     * this budget imposes no limit of its own.
+     */
+    explicit TimeBudget(Real seconds = 0.0);
+
+    /**
+     * Reverts to the previously active budget, if any.
+     */
+    ~TimeBudget();
+
+    TimeBudget(const TimeBudget &) = delete;
+    TimeBudget &operator=(const TimeBudget &) = delete;
+
+    /**
+     * Returns the budget that is active for the calling thread, or nullptr if
+     * there is none.
+     */
+    static TimeBudget *get_current();
+
+    /**
+     * Makes the given budget the active one for the calling thread, returning
+     * the previously active budget. Used to propagate budgets to thread pool
+     * tasks; the given budget must outlive its use.
+     */
+    static TimeBudget *exchange_current(TimeBudget *budget);
+
+    /**
+     * Returns whether the budget of the calling thread is exhausted. Always
+     * false when no budget with a limit is active.
+     */
+    static Bool is_exceeded();
+
+    /**
+     * Returns the number of seconds left in the budget of the calling thread,
+     * zero if it is exhausted, or infinity if there is no limit.
+     */
+    static Real get_remaining();
+
+    /**
+     * Logs a warning stating that the given algorithm or pass degrades as
+     * described by the message due to the compile-time budget, and records it
+     * with the budget of the calling thread, if any. Thread-safe.
+     */
+    static void report_degradation(const Str &source, const Str &message);
+
+    /**
+     * Returns the degradations reported thus far by the code running within
+     * this budget, including nested budgets, in the order they were reported.
+     */
+    Vec<Degradation> get_degradations() const;
+
+    /**
+     * Returns the number of seconds since the outermost budget was started.
+     */
+    Real get_elapsed() const;
+
+    /**
+     * Returns a JSON report of the limit, the time elapsed thus far, and the
+     * degradations reported thus far.
+     */
+    Json to_json() const;
+
+};
+
+} // namespace utils
+} // namespace ql
@@ -155,6 +155,8 @@ template <
     typename Compare = std::less<Key>
 >
 class SparseMap;
+template <typename U>
+class CheckedMapWrapper;
 
 /**
  * Wrapper for standard iterators to detect undefined behavior and throw an
@@ -186,6 +188,8 @@ private:
     friend class CheckedList;
     template <typename Key, typename T, typename Compare, typename Allocator>
     friend class CheckedMap;
+    template <typename U>
+    friend class CheckedMapWrapper;
 
     /**
      * The wrapped iterator.
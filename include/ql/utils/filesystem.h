@@ -5,7 +5,10 @@
 #pragma once
 
 #include <fstream>
+#include <memory>
+#include <sstream>
 #include "ql/utils/str.h"
+#include "ql/utils/map.h"
 #include "ql/utils/exception.h"
 #include "ql/utils/compat.h"
 #include "ql/utils/list.h"
@@ -13,16 +16,6 @@
 namespace ql {
 namespace utils {
 
-namespace {
-
-/**
- * Stack of working directories. Private; use push_working_directory(),
- * pop_working_directory(), and get_working_directory() to access.
- */
-QL_GLOBAL extern List<Str> working_directory_stack;
-
-} // anonymous namespace
-
 /**
  * Sets OpenQL's working directory to the given directory. If the directory
  * looks like a relative path, it is appended to the previous working directory.
@@ -35,6 +28,14 @@ void push_working_directory(const Str &dir);
  */
 void pop_working_directory();
 
+/**
+ * Replaces the working directory stack of the calling thread with the given
+ * one, and returns the previous stack. This is used to run work on behalf of
+ * another thread (see ThreadPool): a stack with only the result of
+ * get_working_directory() on that thread reproduces its working directory.
+ */
+List<Str> exchange_working_directory_stack(List<Str> &&stack);
+
 /**
  * Context management class that pushes the given working directory on
  * construction and pops it on destruction.
@@ -92,31 +93,139 @@ Str dir_name(const Str &path);
  */
 void make_dirs(const Str &path);
 
+/**
+ * RAII object that, for as long as it exists, causes the files written by the
+ * constructing thread (and the thread pool tasks it submits) through OutFile
+ * and AsyncOutFile to be collected in memory instead of being written to
+ * disk. Files read through InFile are looked up in the collected files first,
+ * such that passes that read back earlier outputs still work. Nothing is
+ * written to disk at all while a capture is active, not even the directories
+ * of the files.
+ *
+ * The files are keyed by the path they would have been written to. That is
+ * the path as passed to OutFile when the OpenQL working directory has not
+ * been changed, relative to the OpenQL working directory otherwise. When the
+ * same file is written more than once, the last write wins. When multiple
+ * instances are constructed by the same thread, the most recent one is used
+ * until it is destroyed.
+ */
+class OutputCapture {
+private:
+
+    /**
+     * The collected files, protected by a mutex. Defined in the source file.
+     */
+    class Files;
+
+    /**
+     * The collected files.
+     */
+    std::unique_ptr<Files> files;
+
+    /**
+     * The capture that was active for this thread before this one was
+     * constructed.
+     */
+    OutputCapture *previous;
+
+public:
+
+    /**
+     * Starts capturing the output files of the calling thread.
+     */
+    OutputCapture();
+
+    /**
+     * Reverts to the previously active capture, if any.
+     */
+    ~OutputCapture();
+
+    OutputCapture(const OutputCapture &) = delete;
+    OutputCapture &operator=(const OutputCapture &) = delete;
+
+    /**
+     * Returns the capture that is active for the calling thread, or nullptr
+     * if files are written to disk.
+     */
+    static OutputCapture *get_current();
+
+    /**
+     * Makes the given capture the active one for the calling thread,
+     * returning the previously active capture. Used to propagate captures to
+     * thread pool tasks; the given capture must outlive its use.
+     */
+    static OutputCapture *exchange_current(OutputCapture *capture);
+
+    /**
+     * Returns the key for the given path, as used by store() and load().
+     */
+    static Str get_key(const Str &path);
+
+    /**
+     * Stores the given contents for the file with the given key, replacing
+     * any previous contents. Thread-safe.
+     */
+    void store(const Str &key, Str &&contents);
+
+    /**
+     * Copies the contents of the file with the given key into contents and
+     * returns true if it has been stored, or returns false if not.
+     * Thread-safe.
+     */
+    Bool load(const Str &key, Str &contents) const;
+
+    /**
+     * Returns a copy of all files collected thus far, mapping their keys to
+     * their contents.
+     */
+    Map<Str, Str> get_files() const;
+
+};
+
+/**
+ * Context management class that suspends the active OutputCapture, if any,
+ * while it exists. Used for files that must end up on disk regardless, such
+ * as cache entries.
+ */
+struct WithoutOutputCapture {
+    OutputCapture *previous;
+    WithoutOutputCapture() : previous(OutputCapture::exchange_current(nullptr)) {}
+    ~WithoutOutputCapture() { OutputCapture::exchange_current(previous); }
+};
+
 /**
  * Wrapper for std::ofstream that:
  *  - takes care of the insane error handling magic of C++ streams;
  *  - opens the file upon construction instead of afterwards with open();
  *  - tries to ensure that the directory of the to-be-written file exists before
  *    attempting to open the file.
+ * The file is opened in text mode unless binary is set.
  * Note that close() does not need to be called; if it isn't, the destructor
  * will do it. But this automatic closing may throw an exception; if this
  * happens while another exception is being handled, abort() will be called.
  * Relative paths are treated as relative to the current OpenQL working
- * directory.
+ * directory. When an OutputCapture is active, the contents are buffered and
+ * stored with it when the file is closed or destroyed instead.
  */
 class OutFile {
 private:
     std::ofstream ofs;
+    std::ostringstream buffer;
+    OutputCapture *capture;
     Str path;
+    std::ostream &stream();
 public:
-    explicit OutFile(const Str &path);
+    explicit OutFile(const Str &path, Bool binary = false);
+    ~OutFile();
+    OutFile(const OutFile &) = delete;
+    OutFile &operator=(const OutFile &) = delete;
     void write(const Str &content);
     void close();
     void check();
-    std::ofstream &unwrap();
+    std::ostream &unwrap();
     template <typename T>
     OutFile &operator<<(T &&rhs) {
-        ofs << std::forward<T>(rhs);
+        stream() << std::forward<T>(rhs);
         check();
         return *this;
     }
@@ -126,24 +235,29 @@ public:
  * Wrapper for std::ifstream that:
  *  - takes care of the insane error handling magic of C++ streams;
  *  - opens the file upon construction instead of afterwards with open().
+ * The file is opened in text mode unless binary is set.
  * Note that close() does not need to be called; if it isn't, the destructor
  * will do it. But this automatic closing may throw an exception; if this
  * happens while another exception is being handled, abort() will be called.
  * Relative paths are treated as relative to the current OpenQL working
- * directory.
+ * directory. When an OutputCapture is active that holds the file, it is read
+ * from there instead.
  */
 class InFile {
 private:
     std::ifstream ifs;
+    std::istringstream captured;
+    Bool is_captured;
     Str path;
+    std::istream &stream();
 public:
-    InFile(const Str &path);
+    InFile(const Str &path, Bool binary = false);
     Str read();
     void close();
     void check();
     template <typename T>
     InFile &operator>>(T &&rhs) {
-        ifs >> std::forward<T>(rhs);
+        stream() >> std::forward<T>(rhs);
         check();
         return *this;
     }
@@ -0,0 +1,458 @@
+/** \file
+ * Provides a map implemented as a sorted vector of key-value pairs, with the
+ * same safe accessors as utils::Map.
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "ql/config.h"
+#include "ql/utils/str.h"
+#include "ql/utils/map_wrapper.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Map implemented as a vector of key-value pairs sorted by key, without
+ * additional error checking.
+ *
+ * This replaces the node-based tree of `std::map` with a single contiguous
+ * allocation, which is considerably faster to iterate over, look up in, and
+ * copy for small maps, at the cost of O(n) insertion and removal. Use it for
+ * maps that are built once and then mostly read, or that stay small.
+ *
+ * The element accessors follow utils::Map; that is, there is no operator[],
+ * but there are `set(key)`, `at(key)`, `get(key)`, `get(key, default)`, and
+ * `dbg(key)`. Note that unlike `std::map`, insertion and removal invalidate
+ * all iterators and references, and that the key of an element must not be
+ * modified through an iterator.
+ */
+template <class Key, class T, class Compare = std::less<Key>>
+class UncheckedFlatMap {
+public:
+
+    /**
+     * Typedef for the vector that stores the elements.
+     */
+    using Stl = std::vector<std::pair<Key, T>>;
+
+    // Member types expected by the standard library.
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = typename Stl::value_type;
+    using key_compare = Compare;
+    using allocator_type = typename Stl::allocator_type;
+    using size_type = typename Stl::size_type;
+    using difference_type = typename Stl::difference_type;
+    using reference = typename Stl::reference;
+    using const_reference = typename Stl::const_reference;
+    using iterator = typename Stl::iterator;
+    using const_iterator = typename Stl::const_iterator;
+    using reverse_iterator = typename Stl::reverse_iterator;
+    using const_reverse_iterator = typename Stl::const_reverse_iterator;
+
+    /**
+     * Forward iterator with mutable access to the values.
+     */
+    using Iter = iterator;
+
+    /**
+     * Forward iterator with const access to the values.
+     */
+    using ConstIter = const_iterator;
+
+    /**
+     * Backward iterator with mutable access to the values.
+     */
+    using ReverseIter = reverse_iterator;
+
+    /**
+     * Backward iterator with const access to the values.
+     */
+    using ConstReverseIter = const_reverse_iterator;
+
+private:
+
+    /**
+     * The elements, sorted by key.
+     */
+    Stl elements;
+
+    /**
+     * The key comparator.
+     */
+    Compare comp;
+
+    /**
+     * Returns an iterator to the first element with a key not less than key.
+     */
+    iterator lower(const Key &key) {
+        return std::lower_bound(
+            elements.begin(), elements.end(), key,
+            [this](const value_type &a, const Key &b) { return comp(a.first, b); }
+        );
+    }
+
+    /**
+     * Returns an iterator to the first element with a key not less than key.
+     */
+    const_iterator lower(const Key &key) const {
+        return std::lower_bound(
+            elements.cbegin(), elements.cend(), key,
+            [this](const value_type &a, const Key &b) { return comp(a.first, b); }
+        );
+    }
+
+    /**
+     * Returns whether the element at the given lower bound iterator has the
+     * given key.
+     */
+    template <class It>
+    Bool matches(const It &it, const Key &key) const {
+        return it != elements.cend() && !comp(key, it->first);
+    }
+
+public:
+
+    /**
+     * Constructs an empty map.
+     */
+    UncheckedFlatMap() = default;
+
+    /**
+     * Constructs an empty map with the given comparator.
+     */
+    explicit UncheckedFlatMap(const Compare &comp) : comp(comp) {}
+
+    /**
+     * Constructs the map from the given key-value pairs. If a key occurs more
+     * than once, the first occurrence wins.
+     */
+    UncheckedFlatMap(
+        std::initializer_list<value_type> init,
+        const Compare &comp = Compare()
+    ) : comp(comp) {
+        insert(init.begin(), init.end());
+    }
+
+    /**
+     * Constructs the map from the key-value pairs in [first, last). If a key
+     * occurs more than once, the first occurrence wins.
+     */
+    template <
+        typename InputIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<InputIt>::iterator_category,
+            std::input_iterator_tag
+        >::value>::type
+    >
+    UncheckedFlatMap(
+        InputIt first,
+        InputIt last,
+        const Compare &comp = Compare()
+    ) : comp(comp) {
+        insert(first, last);
+    }
+
+    /**
+     * Returns mutable access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    T &at(const Key &key) {
+        auto it = find(key);
+        if (it != end()) {
+            return it->second;
+        } else {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+    }
+
+    /**
+     * Returns const access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    const T &at(const Key &key) const {
+        auto it = find(key);
+        if (it != end()) {
+            return it->second;
+        } else {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+    }
+
+    /**
+     * Use this to set values in the map, rather than operator[]. Just calling
+     * set(key) without an assignment statement inserts a default-constructed
+     * value for the given key.
+     */
+    T &set(const Key &key) {
+        auto it = lower(key);
+        if (!matches(it, key)) {
+            it = elements.emplace(it, key, T());
+        }
+        return it->second;
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to a dummy
+     * default-constructed value if the key does not exist.
+     */
+    const T &get(const Key &key) const {
+        auto it = find(key);
+        if (it != end()) {
+            return it->second;
+        } else {
+            static const T DEFAULT{};
+            return DEFAULT;
+        }
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to the given
+     * default value if the key does not exist.
+     */
+    const T &get(const Key &key, const T &dflt) const {
+        auto it = find(key);
+        if (it != end()) {
+            return it->second;
+        } else {
+            return dflt;
+        }
+    }
+
+    /**
+     * Returns a string representation of the value at the given key, or
+     * `"<EMPTY>"` if there is no value for the given key. A stream << overload
+     * must exist for the value type.
+     */
+    Str dbg(const Key &key) const {
+        auto it = find(key);
+        if (it != end()) {
+            return utils::to_string(it->second);
+        } else {
+            return "<EMPTY>";
+        }
+    }
+
+    /**
+     * Returns a string representation of the entire contents of the map. Stream
+     * << overloads must exist for both the key and value type.
+     */
+    Str to_string(
+        const Str &prefix = "{",
+        const Str &key_value_separator = ": ",
+        const Str &element_separator = ", ",
+        const Str &suffix = "}"
+    ) const {
+        return map_to_string(*this, prefix, key_value_separator, element_separator, suffix);
+    }
+
+    /**
+     * Returns an iterator to the first element of the map.
+     */
+    iterator begin() { return elements.begin(); }
+    const_iterator begin() const { return elements.cbegin(); }
+    const_iterator cbegin() const { return elements.cbegin(); }
+
+    /**
+     * Returns an iterator to the element following the last element of the map.
+     */
+    iterator end() { return elements.end(); }
+    const_iterator end() const { return elements.cend(); }
+    const_iterator cend() const { return elements.cend(); }
+
+    /**
+     * Returns a reverse iterator to the last element of the map.
+     */
+    reverse_iterator rbegin() { return elements.rbegin(); }
+    const_reverse_iterator rbegin() const { return elements.crbegin(); }
+    const_reverse_iterator crbegin() const { return elements.crbegin(); }
+
+    /**
+     * Returns a reverse iterator to the element preceding the first element of
+     * the map.
+     */
+    reverse_iterator rend() { return elements.rend(); }
+    const_reverse_iterator rend() const { return elements.crend(); }
+    const_reverse_iterator crend() const { return elements.crend(); }
+
+    /**
+     * Returns whether the map is empty.
+     */
+    Bool empty() const { return elements.empty(); }
+
+    /**
+     * Returns the number of elements in the map.
+     */
+    size_type size() const { return elements.size(); }
+
+    /**
+     * Reserves storage for at least the given number of elements.
+     */
+    void reserve(size_type capacity) { elements.reserve(capacity); }
+
+    /**
+     * Removes all elements from the map.
+     */
+    void clear() { elements.clear(); }
+
+    /**
+     * Inserts the given key-value pair if the key does not exist yet. Returns
+     * an iterator to the element with the key, and whether insertion took
+     * place.
+     */
+    std::pair<iterator, Bool> insert(const value_type &value) {
+        auto it = lower(value.first);
+        if (matches(it, value.first)) {
+            return {it, false};
+        }
+        return {elements.insert(it, value), true};
+    }
+
+    /**
+     * Inserts the key-value pairs in [first, last) for which the key does not
+     * exist yet.
+     */
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            insert(value_type(*first));
+        }
+    }
+
+    /**
+     * Constructs a key-value pair from the given arguments and inserts it if
+     * the key does not exist yet.
+     */
+    template <class... Args>
+    std::pair<iterator, Bool> emplace(Args&&... args) {
+        value_type value(std::forward<Args>(args)...);
+        auto it = lower(value.first);
+        if (matches(it, value.first)) {
+            return {it, false};
+        }
+        return {elements.insert(it, std::move(value)), true};
+    }
+
+    /**
+     * Removes the element at the given position, returning an iterator to the
+     * element following it.
+     */
+    iterator erase(const_iterator pos) {
+        return elements.erase(pos);
+    }
+
+    /**
+     * Removes the elements in the range [first, last).
+     */
+    iterator erase(const_iterator first, const_iterator last) {
+        return elements.erase(first, last);
+    }
+
+    /**
+     * Removes the element with the given key, if any. Returns the number of
+     * elements removed.
+     */
+    size_type erase(const Key &key) {
+        auto it = lower(key);
+        if (!matches(it, key)) {
+            return 0;
+        }
+        elements.erase(it);
+        return 1;
+    }
+
+    /**
+     * Returns the number of elements with the given key, which is either 0 or
+     * 1.
+     */
+    size_type count(const Key &key) const {
+        return matches(lower(key), key) ? 1 : 0;
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    iterator find(const Key &key) {
+        auto it = lower(key);
+        return matches(it, key) ? it : elements.end();
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    const_iterator find(const Key &key) const {
+        auto it = lower(key);
+        return matches(it, key) ? it : elements.cend();
+    }
+
+    /**
+     * Returns an iterator to the first element with a key not less than the
+     * given key.
+     */
+    iterator lower_bound(const Key &key) { return lower(key); }
+    const_iterator lower_bound(const Key &key) const { return lower(key); }
+
+    /**
+     * Returns an iterator to the first element with a key greater than the
+     * given key.
+     */
+    iterator upper_bound(const Key &key) {
+        auto it = lower(key);
+        return matches(it, key) ? it + 1 : it;
+    }
+    const_iterator upper_bound(const Key &key) const {
+        auto it = lower(key);
+        return matches(it, key) ? it + 1 : it;
+    }
+
+    /**
+     * Swaps the contents of two maps.
+     */
+    void swap(UncheckedFlatMap &other) {
+        std::swap(elements, other.elements);
+        std::swap(comp, other.comp);
+    }
+
+    /**
+     * Compares the contents of two maps.
+     */
+    friend Bool operator==(const UncheckedFlatMap &lhs, const UncheckedFlatMap &rhs) {
+        return lhs.elements == rhs.elements;
+    }
+
+    /**
+     * Compares the contents of two maps.
+     */
+    friend Bool operator!=(const UncheckedFlatMap &lhs, const UncheckedFlatMap &rhs) {
+        return lhs.elements != rhs.elements;
+    }
+
+};
+
+/**
+ * Stream << overload for UncheckedFlatMap<>.
+ */
+template <class Key, class T, class Compare>
+std::ostream &operator<<(std::ostream &os, const UncheckedFlatMap<Key, T, Compare> &map) {
+    os << map.to_string();
+    return os;
+}
+
+/**
+ * Sorted vector map with the same checked accessors and iterators as
+ * utils::Map. When QL_CHECKED_MAP is defined, the iterators are checked for
+ * validity, which, unlike for utils::Map, means that they are invalidated by
+ * any insertion or removal.
+ */
+template <class Key, class T, class Compare = std::less<Key>>
+#ifdef QL_CHECKED_MAP
+using FlatMap = CheckedMapWrapper<UncheckedFlatMap<Key, T, Compare>>;
+#else
+using FlatMap = UncheckedFlatMap<Key, T, Compare>;
+#endif
+
+} // namespace utils
+} // namespace ql
@@ -0,0 +1,215 @@
+/** \file
+ * Provides a wrapper for std::unordered_map with the same safe accessors as
+ * utils::Map.
+ */
+
+#pragma once
+
+#include <unordered_map>
+#include "ql/config.h"
+#include "ql/utils/str.h"
+#include "ql/utils/map_wrapper.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Wrapper for `std::unordered_map` which replaces operator[] with safer
+ * variants, but does no additional error checking.
+ *
+ * The element accessors follow utils::Map; that is, there is no operator[],
+ * but there are `set(key)`, `at(key)`, `get(key)`, `get(key, default)`, and
+ * `dbg(key)`. Note that the iteration order, and thus the output of
+ * to_string(), is unspecified, so do not iterate over a HashMap where the
+ * order could affect the compiler output.
+ */
+template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+class UncheckedHashMap : public std::unordered_map<Key, T, Hash, KeyEqual> {
+public:
+
+    /**
+     * Typedef for the wrapped STL container.
+     */
+    using Stl = std::unordered_map<Key, T, Hash, KeyEqual>;
+
+    /**
+     * Forward iterator with mutable access to the values.
+     */
+    using Iter = typename Stl::iterator;
+
+    /**
+     * Forward iterator with const access to the values.
+     */
+    using ConstIter = typename Stl::const_iterator;
+
+    /**
+     * Default constructor. Constructs an empty container.
+     */
+    UncheckedHashMap() : Stl() {}
+
+    /**
+     * Constructor arguments are forwarded to the STL container constructor, so
+     * all constructors of the STL container can be used.
+     */
+    template <class... Args>
+    explicit UncheckedHashMap(Args&&... args) : Stl(std::forward<Args>(args)...) {
+    }
+
+    /**
+     * Copy constructor from Stl variant.
+     */
+    UncheckedHashMap(const Stl &stl) : Stl(stl) {}
+
+    /**
+     * Move constructor from Stl variant.
+     */
+    UncheckedHashMap(Stl &&stl) : Stl(std::move(stl)) {}
+
+    /**
+     * Implicit conversion for initializer lists.
+     */
+    UncheckedHashMap(std::initializer_list<typename Stl::value_type> init) : Stl(init) {
+    }
+
+    /**
+     * Default copy constructor.
+     */
+    UncheckedHashMap(const UncheckedHashMap &map) = default;
+
+    /**
+     * Default move constructor.
+     */
+    UncheckedHashMap(UncheckedHashMap &&map) noexcept = default;
+
+    /**
+     * Default copy assignment.
+     */
+    UncheckedHashMap &operator=(const UncheckedHashMap &other) = default;
+
+    /**
+     * Default move assignment.
+     */
+    UncheckedHashMap &operator=(UncheckedHashMap &&other) noexcept = default;
+
+    /**
+     * Returns mutable access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    T &at(const Key &key) {
+        auto it = this->find(key);
+        if (it != this->end()) {
+            return it->second;
+        } else {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+    }
+
+    /**
+     * Returns const access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    const T &at(const Key &key) const {
+        auto it = this->find(key);
+        if (it != this->end()) {
+            return it->second;
+        } else {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+    }
+
+    /**
+     * Use this to set values in the map, rather than operator[]. Just calling
+     * set(key) without an assignment statement inserts a default-constructed
+     * value for the given key.
+     */
+    T &set(const Key &key) {
+        return Stl::operator[](key);
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to a dummy
+     * default-constructed value if the key does not exist.
+     */
+    const T &get(const Key &key) const {
+        auto it = this->find(key);
+        if (it != this->end()) {
+            return it->second;
+        } else {
+            static const T DEFAULT{};
+            return DEFAULT;
+        }
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to the given
+     * default value if the key does not exist.
+     */
+    const T &get(const Key &key, const T &dflt) const {
+        auto it = this->find(key);
+        if (it != this->end()) {
+            return it->second;
+        } else {
+            return dflt;
+        }
+    }
+
+    /**
+     * Returns a string representation of the value at the given key, or
+     * `"<EMPTY>"` if there is no value for the given key. A stream << overload
+     * must exist for the value type.
+     */
+    Str dbg(const Key &key) const {
+        auto it = this->find(key);
+        if (it != this->end()) {
+            return utils::to_string(it->second);
+        } else {
+            return "<EMPTY>";
+        }
+    }
+
+    /**
+     * Returns a string representation of the entire contents of the map, in
+     * unspecified order. Stream << overloads must exist for both the key and
+     * value type.
+     */
+    Str to_string(
+        const Str &prefix = "{",
+        const Str &key_value_separator = ": ",
+        const Str &element_separator = ", ",
+        const Str &suffix = "}"
+    ) const {
+        return map_to_string(*this, prefix, key_value_separator, element_separator, suffix);
+    }
+
+    /**
+     * operator[] is unsafe in maps: it can insert keys when you don't expect it
+     * to. Therefore it is disabled.
+     */
+    T &operator[](const Key &key) = delete;
+
+};
+
+/**
+ * Stream << overload for UncheckedHashMap<>.
+ */
+template <class Key, class T, class Hash, class KeyEqual>
+std::ostream &operator<<(std::ostream &os, const UncheckedHashMap<Key, T, Hash, KeyEqual> &map) {
+    os << map.to_string();
+    return os;
+}
+
+/**
+ * Hash map with the same checked accessors and iterators as utils::Map. When
+ * QL_CHECKED_MAP is defined, the iterators are checked for validity, which,
+ * unlike for utils::Map, means that they are invalidated by any insertion or
+ * removal.
+ */
+template <class Key, class T, class Hash = std::hash<Key>, class KeyEqual = std::equal_to<Key>>
+#ifdef QL_CHECKED_MAP
+using HashMap = CheckedMapWrapper<UncheckedHashMap<Key, T, Hash, KeyEqual>>;
+#else
+using HashMap = UncheckedHashMap<Key, T, Hash, KeyEqual>;
+#endif
+
+} // namespace utils
+} // namespace ql
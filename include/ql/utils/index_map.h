@@ -0,0 +1,522 @@
+/** \file
+ * Provides a map keyed by dense integer indices, such as qubit indices, with
+ * the same safe accessors as utils::Map.
+ */
+
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include "ql/config.h"
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/map_wrapper.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Map keyed by small non-negative integers, implemented as a vector indexed by
+ * the key, without additional error checking.
+ *
+ * Lookup, insertion, and removal are O(1) without hashing or comparisons, but
+ * the storage is proportional to the largest key ever inserted, so this is
+ * meant for keys that are dense by construction, like qubit indices or other
+ * sequential IDs. Iteration is in ascending key order, like for utils::Map.
+ *
+ * The element accessors follow utils::Map; that is, there is no operator[],
+ * but there are `set(key)`, `at(key)`, `get(key)`, `get(key, default)`, and
+ * `dbg(key)`. Inserting a key larger than any key before it may invalidate all
+ * iterators and references. The key of an element must not be modified
+ * through an iterator.
+ */
+template <class Key, class T>
+class UncheckedIndexMap {
+    static_assert(std::is_integral<Key>::value, "IndexMap keys must be integral");
+public:
+
+    // Member types expected by the standard library.
+    using key_type = Key;
+    using mapped_type = T;
+    using value_type = std::pair<Key, T>;
+    using allocator_type = std::allocator<value_type>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type&;
+    using const_reference = const value_type&;
+
+private:
+
+    /**
+     * The slots, indexed by key. The first element of the pair always equals
+     * the index of the slot, so iterators can return a reference to it.
+     */
+    std::vector<value_type> slots;
+
+    /**
+     * Whether the slot with the same index holds an element.
+     */
+    std::vector<Bool> used;
+
+    /**
+     * The number of used slots.
+     */
+    size_type count_used = 0;
+
+    /**
+     * Returns the index of the first used slot at or after the given index, or
+     * the number of slots if there is none.
+     */
+    size_type next_used(size_type index) const {
+        while (index < used.size() && !used[index]) {
+            index++;
+        }
+        return index;
+    }
+
+    /**
+     * Returns whether the given key is negative, without warnings about
+     * comparisons that are always false for unsigned keys.
+     */
+    static Bool is_negative(const Key &key) {
+        return is_negative(key, std::is_signed<Key>());
+    }
+    static Bool is_negative(const Key &key, std::true_type) {
+        return key < 0;
+    }
+    static Bool is_negative(const Key &, std::false_type) {
+        return false;
+    }
+
+    /**
+     * Returns whether the given key is in the map.
+     */
+    Bool contains(const Key &key) const {
+        return !is_negative(key) && static_cast<size_type>(key) < used.size() && used[key];
+    }
+
+    /**
+     * Forward iterator over the used slots.
+     */
+    template <class Map, class Value>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::remove_const<Value>::type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = Value*;
+        using reference = Value&;
+
+    private:
+        friend class UncheckedIndexMap;
+        template <class Map2, class Value2>
+        friend class Iterator;
+
+        Map *map;
+        size_type index;
+
+        Iterator(Map *map, size_type index) : map(map), index(index) {}
+
+    public:
+        Iterator() : map(nullptr), index(0) {}
+
+        /**
+         * Conversion from mutable to const iterator.
+         */
+        template <
+            class Map2, class Value2,
+            typename = typename std::enable_if<std::is_convertible<Value2*, Value*>::value>::type
+        >
+        Iterator(const Iterator<Map2, Value2> &other) : map(other.map), index(other.index) {}
+
+        reference operator*() const {
+            return map->slots[index];
+        }
+
+        pointer operator->() const {
+            return &map->slots[index];
+        }
+
+        Iterator &operator++() {
+            index = map->next_used(index + 1);
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        friend bool operator==(const Iterator &lhs, const Iterator &rhs) {
+            return lhs.map == rhs.map && lhs.index == rhs.index;
+        }
+
+        friend bool operator!=(const Iterator &lhs, const Iterator &rhs) {
+            return !(lhs == rhs);
+        }
+
+    };
+
+public:
+
+    /**
+     * Forward iterator with mutable access to the values.
+     */
+    using iterator = Iterator<UncheckedIndexMap, value_type>;
+
+    /**
+     * Forward iterator with const access to the values.
+     */
+    using const_iterator = Iterator<const UncheckedIndexMap, const value_type>;
+
+    /**
+     * Forward iterator with mutable access to the values.
+     */
+    using Iter = iterator;
+
+    /**
+     * Forward iterator with const access to the values.
+     */
+    using ConstIter = const_iterator;
+
+    /**
+     * Constructs an empty map.
+     */
+    UncheckedIndexMap() = default;
+
+    /**
+     * Constructs an empty map with room for keys up to (but not including) the
+     * given key without reallocation.
+     */
+    explicit UncheckedIndexMap(size_type capacity) {
+        reserve(capacity);
+    }
+
+    /**
+     * Constructs the map from the given key-value pairs. If a key occurs more
+     * than once, the first occurrence wins.
+     */
+    UncheckedIndexMap(std::initializer_list<value_type> init) {
+        insert(init.begin(), init.end());
+    }
+
+    /**
+     * Constructs the map from the key-value pairs in [first, last). If a key
+     * occurs more than once, the first occurrence wins.
+     */
+    template <
+        typename InputIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<InputIt>::iterator_category,
+            std::input_iterator_tag
+        >::value>::type
+    >
+    UncheckedIndexMap(InputIt first, InputIt last) {
+        insert(first, last);
+    }
+
+    /**
+     * Returns mutable access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    T &at(const Key &key) {
+        if (!contains(key)) {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+        return slots[key].second;
+    }
+
+    /**
+     * Returns const access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    const T &at(const Key &key) const {
+        if (!contains(key)) {
+            throw Exception("key " + try_to_string(key) + " does not exist in map");
+        }
+        return slots[key].second;
+    }
+
+    /**
+     * Use this to set values in the map, rather than operator[]. Just calling
+     * set(key) without an assignment statement inserts a default-constructed
+     * value for the given key. Negative keys result in an Exception.
+     */
+    T &set(const Key &key) {
+        if (is_negative(key)) {
+            throw Exception("negative key " + try_to_string(key) + " cannot be used in index map");
+        }
+        auto index = static_cast<size_type>(key);
+        if (index >= slots.size()) {
+            size_type old_size = slots.size();
+            slots.resize(index + 1);
+            used.resize(index + 1, false);
+            for (size_type i = old_size; i <= index; i++) {
+                slots[i].first = static_cast<Key>(i);
+            }
+        }
+        if (!used[index]) {
+            used[index] = true;
+            slots[index].second = T();
+            count_used++;
+        }
+        return slots[index].second;
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to a dummy
+     * default-constructed value if the key does not exist.
+     */
+    const T &get(const Key &key) const {
+        if (contains(key)) {
+            return slots[key].second;
+        } else {
+            static const T DEFAULT{};
+            return DEFAULT;
+        }
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to the given
+     * default value if the key does not exist.
+     */
+    const T &get(const Key &key, const T &dflt) const {
+        if (contains(key)) {
+            return slots[key].second;
+        } else {
+            return dflt;
+        }
+    }
+
+    /**
+     * Returns a string representation of the value at the given key, or
+     * `"<EMPTY>"` if there is no value for the given key. A stream << overload
+     * must exist for the value type.
+     */
+    Str dbg(const Key &key) const {
+        if (contains(key)) {
+            return utils::to_string(slots[key].second);
+        } else {
+            return "<EMPTY>";
+        }
+    }
+
+    /**
+     * Returns a string representation of the entire contents of the map. Stream
+     * << overloads must exist for both the key and value type.
+     */
+    Str to_string(
+        const Str &prefix = "{",
+        const Str &key_value_separator = ": ",
+        const Str &element_separator = ", ",
+        const Str &suffix = "}"
+    ) const {
+        return map_to_string(*this, prefix, key_value_separator, element_separator, suffix);
+    }
+
+    /**
+     * Returns an iterator to the first element of the map.
+     */
+    iterator begin() { return iterator(this, next_used(0)); }
+    const_iterator begin() const { return const_iterator(this, next_used(0)); }
+    const_iterator cbegin() const { return const_iterator(this, next_used(0)); }
+
+    /**
+     * Returns an iterator to the element following the last element of the map.
+     */
+    iterator end() { return iterator(this, slots.size()); }
+    const_iterator end() const { return const_iterator(this, slots.size()); }
+    const_iterator cend() const { return const_iterator(this, slots.size()); }
+
+    /**
+     * Returns whether the map is empty.
+     */
+    Bool empty() const { return count_used == 0; }
+
+    /**
+     * Returns the number of elements in the map.
+     */
+    size_type size() const { return count_used; }
+
+    /**
+     * Reserves storage for keys up to (but not including) the given key.
+     */
+    void reserve(size_type capacity) {
+        slots.reserve(capacity);
+        used.reserve(capacity);
+    }
+
+    /**
+     * Removes all elements from the map.
+     */
+    void clear() {
+        slots.clear();
+        used.clear();
+        count_used = 0;
+    }
+
+    /**
+     * Inserts the given key-value pair if the key does not exist yet. Returns
+     * an iterator to the element with the key, and whether insertion took
+     * place.
+     */
+    std::pair<iterator, Bool> insert(const value_type &value) {
+        if (contains(value.first)) {
+            return {find(value.first), false};
+        }
+        set(value.first) = value.second;
+        return {find(value.first), true};
+    }
+
+    /**
+     * Inserts the key-value pairs in [first, last) for which the key does not
+     * exist yet.
+     */
+    template <class InputIt>
+    void insert(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            insert(value_type(*first));
+        }
+    }
+
+    /**
+     * Constructs a key-value pair from the given arguments and inserts it if
+     * the key does not exist yet.
+     */
+    template <class... Args>
+    std::pair<iterator, Bool> emplace(Args&&... args) {
+        value_type value(std::forward<Args>(args)...);
+        if (contains(value.first)) {
+            return {find(value.first), false};
+        }
+        set(value.first) = std::move(value.second);
+        return {find(value.first), true};
+    }
+
+    /**
+     * Removes the element at the given position, returning an iterator to the
+     * element following it.
+     */
+    iterator erase(const_iterator pos) {
+        erase(pos->first);
+        return iterator(this, next_used(pos.index + 1));
+    }
+
+    /**
+     * Removes the element with the given key, if any. Returns the number of
+     * elements removed.
+     */
+    size_type erase(const Key &key) {
+        if (!contains(key)) {
+            return 0;
+        }
+        used[key] = false;
+        slots[key].second = T();
+        count_used--;
+        return 1;
+    }
+
+    /**
+     * Returns the number of elements with the given key, which is either 0 or
+     * 1.
+     */
+    size_type count(const Key &key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    iterator find(const Key &key) {
+        return contains(key) ? iterator(this, key) : end();
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    const_iterator find(const Key &key) const {
+        return contains(key) ? const_iterator(this, key) : end();
+    }
+
+    /**
+     * Returns an iterator to the first element with a key not less than the
+     * given key.
+     */
+    iterator lower_bound(const Key &key) {
+        return iterator(this, next_used(is_negative(key) ? 0 : key));
+    }
+    const_iterator lower_bound(const Key &key) const {
+        return const_iterator(this, next_used(is_negative(key) ? 0 : key));
+    }
+
+    /**
+     * Returns an iterator to the first element with a key greater than the
+     * given key.
+     */
+    iterator upper_bound(const Key &key) {
+        return iterator(this, next_used(is_negative(key) ? 0 : key + 1));
+    }
+    const_iterator upper_bound(const Key &key) const {
+        return const_iterator(this, next_used(is_negative(key) ? 0 : key + 1));
+    }
+
+    /**
+     * Swaps the contents of two maps. Iterators keep pointing to the map they
+     * were created for.
+     */
+    void swap(UncheckedIndexMap &other) {
+        std::swap(slots, other.slots);
+        std::swap(used, other.used);
+        std::swap(count_used, other.count_used);
+    }
+
+    /**
+     * Compares the contents of two maps.
+     */
+    friend Bool operator==(const UncheckedIndexMap &lhs, const UncheckedIndexMap &rhs) {
+        if (lhs.count_used != rhs.count_used) {
+            return false;
+        }
+        for (const auto &kv : lhs) {
+            if (!rhs.contains(kv.first) || !(rhs.slots[kv.first].second == kv.second)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Compares the contents of two maps.
+     */
+    friend Bool operator!=(const UncheckedIndexMap &lhs, const UncheckedIndexMap &rhs) {
+        return !(lhs == rhs);
+    }
+
+};
+
+/**
+ * Stream << overload for UncheckedIndexMap<>.
+ */
+template <class Key, class T>
+std::ostream &operator<<(std::ostream &os, const UncheckedIndexMap<Key, T> &map) {
+    os << map.to_string();
+    return os;
+}
+
+/**
+ * Dense integer-keyed map with the same checked accessors and iterators as
+ * utils::Map. When QL_CHECKED_MAP is defined, the iterators are checked for
+ * validity, which, unlike for utils::Map, means that they are invalidated by
+ * any insertion or removal.
+ */
+template <class Key, class T>
+#ifdef QL_CHECKED_MAP
+using IndexMap = CheckedMapWrapper<UncheckedIndexMap<Key, T>>;
+#else
+using IndexMap = UncheckedIndexMap<Key, T>;
+#endif
+
+} // namespace utils
+} // namespace ql
@@ -0,0 +1,91 @@
+/** \file
+ * Provides interned strings, i.e. strings that are stored only once for the
+ * whole process such that they can be compared in constant time.
+ */
+
+#pragma once
+
+#include <functional>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Handle to a string in the process-wide intern table. Interning a string
+ * hashes it once; after that, comparison, hashing, and copying are constant
+ * time and allocation-free, as they only involve a pointer. Interned strings
+ * are never freed, so this is only meant for strings that come from a small
+ * set, such as gate and instruction names. The table is thread-safe.
+ *
+ * The ordering operators order by address, not lexicographically; use str()
+ * when the order must be deterministic.
+ */
+class InternedStr {
+private:
+
+    /**
+     * Pointer to the canonical copy of the string in the intern table. Never
+     * null.
+     */
+    const Str *ptr;
+
+public:
+
+    /**
+     * Constructs the interned empty string.
+     */
+    InternedStr();
+
+    /**
+     * Interns the given string.
+     */
+    explicit InternedStr(const Str &str);
+
+    /**
+     * Returns the interned string.
+     */
+    const Str &str() const {
+        return *ptr;
+    }
+
+    /**
+     * Returns the unique address of the interned string, usable as a small
+     * integer identifier.
+     */
+    const void *id() const {
+        return ptr;
+    }
+
+    Bool operator==(const InternedStr &rhs) const { return ptr == rhs.ptr; }
+    Bool operator!=(const InternedStr &rhs) const { return ptr != rhs.ptr; }
+    Bool operator<(const InternedStr &rhs) const { return ptr < rhs.ptr; }
+    Bool operator>(const InternedStr &rhs) const { return ptr > rhs.ptr; }
+    Bool operator<=(const InternedStr &rhs) const { return ptr <= rhs.ptr; }
+    Bool operator>=(const InternedStr &rhs) const { return ptr >= rhs.ptr; }
+
+};
+
+/**
+ * Stream << overload for interned strings.
+ */
+std::ostream &operator<<(std::ostream &os, const InternedStr &str);
+
+} // namespace utils
+} // namespace ql
+
+namespace std {
+
+/**
+ * Hash function for interned strings, allowing them to be used as keys in
+ * unordered containers.
+ */
+template <>
+struct hash<ql::utils::InternedStr> {
+    std::size_t operator()(const ql::utils::InternedStr &str) const {
+        return std::hash<const void*>()(str.id());
+    }
+};
+
+} // namespace std
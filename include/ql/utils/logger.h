@@ -5,50 +5,83 @@
 #pragma once
 
 #include <iostream>
+#include <mutex>
 #include "ql/utils/exception.h"
 #include "ql/utils/compat.h"
 #include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
 
 // helper macro: stringstream to string
 // based on https://stackoverflow.com/questions/21924156/how-to-initialize-a-stdstringstream
 #define QL_SS2S(values) ::ql::utils::Str(dynamic_cast<::ql::utils::StrStrm&&>(::ql::utils::StrStrm() << values).str())
 
+// The most verbose log level that is compiled in, normally set via config.h.
+#ifndef QL_MAX_LOG_LEVEL
+#define QL_MAX_LOG_LEVEL LOG_DEBUG
+#endif
+
+// helper macro: whether messages of the given log level are to be written.
+// The first term is a compile-time constant, such that log statements more
+// verbose than QL_MAX_LOG_LEVEL are removed entirely by the compiler.
+#define QL_LOG_ENABLED(level) \
+    (::ql::utils::logger::LogLevel::level <= ::ql::utils::logger::LogLevel::QL_MAX_LOG_LEVEL   \
+    && ::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::level)
+
 #define QL_PRINTLN(x) \
     do {                                                                                                    \
-        std::cout << "[OPENQL] " << x << std::endl;                                                         \
+        ::ql::utils::logger::write_message(                                                                 \
+            false,                                                                                          \
+            QL_SS2S("[OPENQL] " << x)                                                                       \
+        );                                                                                                  \
     } while (false)
 
 #define QL_EOUT(content) \
     do {                                                                                                    \
-        if (::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::LOG_ERROR) {                   \
-            ::std::cerr << "[OPENQL] " __FILE__ ":" << __LINE__ << " Error: " << content << ::std::endl;    \
+        if (QL_LOG_ENABLED(LOG_ERROR)) {                                                                    \
+            ::ql::utils::logger::write_message(                                                             \
+                true,                                                                                       \
+                QL_SS2S("[OPENQL] " __FILE__ ":" << __LINE__ << " Error: " << content)                      \
+            );                                                                                              \
         }                                                                                                   \
     } while (false)
 
 #define QL_WOUT(content) \
     do {                                                                                                    \
-        if (::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::LOG_WARNING) {                 \
-            ::std::cerr << "[OPENQL] " __FILE__ ":" << __LINE__ << " Warning: " << content << ::std::endl;  \
+        if (QL_LOG_ENABLED(LOG_WARNING)) {                                                                  \
+            ::ql::utils::logger::write_message(                                                             \
+                true,                                                                                       \
+                QL_SS2S("[OPENQL] " __FILE__ ":" << __LINE__ << " Warning: " << content)                    \
+            );                                                                                              \
         }                                                                                                   \
     } while (false)
 
 #define QL_IOUT(content) \
     do {                                                                                                    \
-        if (::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::LOG_INFO) {                    \
-            ::std::cout << "[OPENQL] " __FILE__ ":" << __LINE__ << " Info: "<< content << ::std::endl;      \
+        if (QL_LOG_ENABLED(LOG_INFO)) {                                                                     \
+            ::ql::utils::logger::write_message(                                                             \
+                false,                                                                                      \
+                QL_SS2S("[OPENQL] " __FILE__ ":" << __LINE__ << " Info: " << content)                       \
+            );                                                                                              \
         }                                                                                                   \
     } while (false)
 
 #define QL_DOUT(content) \
     do {                                                                                                    \
-        if (::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::LOG_DEBUG) {                   \
-            ::std::cout << "[OPENQL] " __FILE__ ":" << __LINE__ << " " << content << ::std::endl;           \
+        if (QL_LOG_ENABLED(LOG_DEBUG)) {                                                                    \
+            ::ql::utils::logger::write_message(                                                             \
+                false,                                                                                      \
+                QL_SS2S("[OPENQL] " __FILE__ ":" << __LINE__ << " " << content)                             \
+            );                                                                                              \
         }                                                                                                   \
     } while (false)
 
 #define QL_COUT(content) \
     do {                                                                                                    \
-        ::std::cout << "[OPENQL] " __FILE__ ":" << __LINE__ << " " << content << ::std::endl;               \
+        ::ql::utils::logger::write_message(                                                                 \
+            false,                                                                                          \
+            QL_SS2S("[OPENQL] " __FILE__ ":" << __LINE__ << " " << content)                                 \
+        );                                                                                                  \
     } while (false)
 
 #define QL_FATAL(content) \
@@ -61,7 +94,7 @@
     } while (false)
 
 #define QL_IS_LOG_DEBUG \
-    (::ql::utils::logger::log_level >= ::ql::utils::logger::LogLevel::LOG_DEBUG)
+    QL_LOG_ENABLED(LOG_DEBUG)
 
 #define QL_IF_LOG_DEBUG \
     if QL_IS_LOG_DEBUG
@@ -84,6 +117,101 @@ QL_GLOBAL extern LogLevel log_level;
 LogLevel log_level_from_string(const Str &level);
 void set_log_level(const Str &level);
 
+/**
+ * Writes a single formatted log message followed by a newline to stderr (if
+ * to_stderr is set) or stdout, or to the Capture that the calling thread is
+ * currently redirected to, if any. Messages from different threads do not
+ * interleave within a line.
+ *
+ * Messages for stdout are queued in a lock-free ring buffer for the calling
+ * thread, which a background thread drains to stdout without flushing after
+ * every line. Messages for stderr first flush() all queued messages, and are
+ * then written and flushed immediately, so errors and warnings still appear
+ * in order with respect to the preceding messages of the same thread.
+ */
+void write_message(Bool to_stderr, const Str &message);
+
+/**
+ * Waits until all messages queued by write_message() so far have been
+ * written, and then flushes stdout.
+ */
+void flush();
+
+/**
+ * Buffer for log messages, that can be written out at a later time using
+ * replay(). Use Redirect to make a thread write its log messages to it. This
+ * is used to keep log output deterministic when work is distributed over
+ * multiple threads, by capturing the messages per work item and replaying
+ * them in order once all threads are done.
+ */
+class Capture {
+private:
+
+    /**
+     * The captured messages, and whether they were written to stderr.
+     */
+    Vec<Pair<Bool, Str>> messages;
+
+    /**
+     * Protects messages. Tasks that run on a thread pool on behalf of a
+     * redirected thread write to the same capture (see ThreadPool), possibly
+     * concurrently.
+     */
+    std::mutex mutex;
+
+    friend void write_message(Bool to_stderr, const Str &message);
+
+public:
+
+    /**
+     * Writes all captured messages out using write_message(), in the order in
+     * which they were captured, and clears the capture.
+     */
+    void replay();
+
+};
+
+/**
+ * Returns the capture that the current thread is redirected to, or nullptr
+ * if it is not redirected.
+ */
+Capture *get_active_capture();
+
+/**
+ * RAII object that redirects all log messages written by the current thread
+ * to the given Capture for as long as it exists. Redirects may be nested.
+ */
+class Redirect {
+private:
+
+    /**
+     * The capture that the current thread was redirected to before us.
+     */
+    Capture *previous;
+
+public:
+
+    /**
+     * Redirects the log messages of the current thread to the given capture.
+     */
+    explicit Redirect(Capture &capture);
+
+    /**
+     * Same as above, but nullptr can be passed to undo any redirection for
+     * as long as this object exists.
+     */
+    explicit Redirect(Capture *capture);
+
+    /**
+     * Restores the previous redirection of the current thread.
+     */
+    ~Redirect();
+
+    Redirect(const Redirect &) = delete;
+    Redirect &operator=(const Redirect &) = delete;
+
+};
+
 } // namespace logger
 } // namespace utils
 } // namespace ql
@@ -0,0 +1,535 @@
+/** \file
+ * Provides a checked wrapper for the map-like containers that are not based on
+ * std::map, i.e. FlatMap, HashMap, and IndexMap.
+ */
+
+#pragma once
+
+#include <memory>
+#include "ql/utils/str.h"
+#include "ql/utils/container_base.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Returns a string representation of the contents of a map-like container.
+ * Stream << overloads must exist for both the key and value type.
+ */
+template <class M>
+Str map_to_string(
+    const M &map,
+    const Str &prefix,
+    const Str &key_value_separator,
+    const Str &element_separator,
+    const Str &suffix
+) {
+    StrStrm ss{};
+    ss << prefix;
+    bool first = true;
+    for (const auto &kv : map) {
+        if (first) {
+            first = false;
+        } else {
+            ss << element_separator;
+        }
+        ss << kv.first << key_value_separator << kv.second;
+    }
+    ss << suffix;
+    return ss.str();
+}
+
+/**
+ * Wrapper for one of the unchecked map-like containers (UncheckedFlatMap,
+ * UncheckedHashMap, or UncheckedIndexMap) that guards against undefined
+ * behavior in the same way that CheckedMap does for std::map: iterators keep
+ * the data block alive, and using an iterator that belongs to a different
+ * container, that was invalidated by a structural change, or that points
+ * past-the-end results in an Exception.
+ *
+ * Unlike for std::map, any insertion or removal is considered to be a
+ * structural change, because none of the wrapped containers guarantee
+ * iterator stability for those.
+ *
+ * Member functions that only exist for some of the wrapped containers (such as
+ * lower_bound() for FlatMap) are provided here for all of them, but can of
+ * course only be used when the wrapped container supports them.
+ */
+template <class U>
+class CheckedMapWrapper {
+public:
+
+    /**
+     * Shorthand for the unchecked container being wrapped.
+     */
+    using Stl = U;
+
+    /**
+     * Shorthand for the data block type.
+     */
+    using Data = ContainerData<Stl>;
+
+    /**
+     * Forward iterator with mutable access to the values.
+     */
+    using Iter = WrappedIterator<Data, typename Stl::iterator, RegularEndpointAdapter>;
+
+    /**
+     * Forward iterator with const access to the values.
+     */
+    using ConstIter = WrappedIterator<const Data, typename Stl::const_iterator, ConstEndpointAdapter>;
+
+    /**
+     * Backward iterator with mutable access to the values. Only usable for
+     * ordered containers.
+     */
+    using ReverseIter = std::reverse_iterator<Iter>;
+
+    /**
+     * Backward iterator with const access to the values. Only usable for
+     * ordered containers.
+     */
+    using ConstReverseIter = std::reverse_iterator<ConstIter>;
+
+    // Member types expected by the standard library.
+    using key_type = typename Stl::key_type;
+    using mapped_type = typename Stl::mapped_type;
+    using value_type = typename Stl::value_type;
+    using size_type = typename Stl::size_type;
+    using difference_type = typename Stl::difference_type;
+    using reference = typename Stl::reference;
+    using const_reference = typename Stl::const_reference;
+    using iterator = Iter;
+    using const_iterator = ConstIter;
+
+private:
+
+    /**
+     * Shorthand for the key type.
+     */
+    using Key = key_type;
+
+    /**
+     * Shorthand for the value type.
+     */
+    using T = mapped_type;
+
+    /**
+     * Data block for the map.
+     */
+    std::shared_ptr<Data> data_ptr;
+
+    /**
+     * Safely returns mutable access to the data block.
+     */
+    Data &get_data() {
+        if (!data_ptr) {
+            QL_CONTAINER_ERROR(
+                "container is used after move or otherwise has invalid data block"
+            );
+        }
+        return *data_ptr;
+    }
+
+    /**
+     * Safely returns const access to the data block.
+     */
+    const Data &get_data() const {
+        if (!data_ptr) {
+            QL_CONTAINER_ERROR(
+                "container is used after move or otherwise has invalid data block"
+            );
+        }
+        return *data_ptr;
+    }
+
+public:
+
+    /**
+     * Default constructor. Constructs an empty container.
+     */
+    CheckedMapWrapper() : data_ptr(std::make_shared<Data>()) {}
+
+    /**
+     * Constructs the container with the contents of the initializer list init.
+     */
+    CheckedMapWrapper(
+        std::initializer_list<value_type> init
+    ) : data_ptr(std::make_shared<Data>(Stl(init))) {}
+
+    /**
+     * Constructs the container with the contents of the range [first, last).
+     */
+    template <
+        typename InputIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<InputIt>::iterator_category,
+            std::input_iterator_tag
+        >::value>::type
+    >
+    CheckedMapWrapper(
+        InputIt first,
+        InputIt last
+    ) : data_ptr(std::make_shared<Data>(first, last)) {}
+
+    /**
+     * Copy constructor.
+     */
+    CheckedMapWrapper(const CheckedMapWrapper &other) : data_ptr(std::make_shared<Data>(other.get_data().get_const())) {}
+
+    /**
+     * Copy constructor from the unchecked variant.
+     */
+    CheckedMapWrapper(const Stl &other) : data_ptr(std::make_shared<Data>(other)) {}
+
+    /**
+     * Move constructor. The data block pointer is moved, so iterators remain
+     * valid.
+     */
+    CheckedMapWrapper(CheckedMapWrapper &&other) noexcept = default;
+
+    /**
+     * Copy assignment.
+     */
+    CheckedMapWrapper &operator=(const CheckedMapWrapper &rhs) {
+        get_data().get_mut().operator=(rhs.get_data().get_const());
+        return *this;
+    }
+
+    /**
+     * Move assignment. The data block pointer is moved, so iterators remain
+     * valid.
+     */
+    CheckedMapWrapper &operator=(CheckedMapWrapper &&rhs) noexcept = default;
+
+    /**
+     * Returns mutable access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    T &at(const Key &key) {
+        return get_data().get_mut_element_only().at(key);
+    }
+
+    /**
+     * Returns const access to the value stored for the given key. If the key
+     * does not exist, an Exception is thrown.
+     */
+    const T &at(const Key &key) const {
+        return get_data().get_const().at(key);
+    }
+
+    /**
+     * Use this to set values in the map, rather than operator[]. Just calling
+     * set(key) without an assignment statement inserts a default-constructed
+     * value for the given key. Iterators are invalidated only if the key did
+     * not exist yet.
+     */
+    T &set(const Key &key) {
+        auto &data = get_data();
+        if (data.get_const().count(key)) {
+            return data.get_mut_element_only().at(key);
+        }
+        return data.get_mut().set(key);
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to a dummy
+     * default-constructed value if the key does not exist.
+     */
+    const T &get(const Key &key) const {
+        return get_data().get_const().get(key);
+    }
+
+    /**
+     * Returns a const reference to the value at the given key, or to the given
+     * default value if the key does not exist.
+     */
+    const T &get(const Key &key, const T &dflt) const {
+        return get_data().get_const().get(key, dflt);
+    }
+
+    /**
+     * Returns a string representation of the value at the given key, or
+     * `"<EMPTY>"` if there is no value for the given key.
+     */
+    Str dbg(const Key &key) const {
+        return get_data().get_const().dbg(key);
+    }
+
+    /**
+     * Returns a string representation of the entire contents of the map.
+     */
+    Str to_string(
+        const Str &prefix = "{",
+        const Str &key_value_separator = ": ",
+        const Str &element_separator = ", ",
+        const Str &suffix = "}"
+    ) const {
+        return get_data().get_const().to_string(prefix, key_value_separator, element_separator, suffix);
+    }
+
+    /**
+     * Returns an iterator to the first element of the map.
+     */
+    Iter begin() {
+        return Iter(get_data().get_mut_element_only().begin(), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element of the map.
+     */
+    ConstIter begin() const {
+        return ConstIter(get_data().get_const().cbegin(), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element of the map.
+     */
+    ConstIter cbegin() const {
+        return ConstIter(get_data().get_const().cbegin(), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the element following the last element of the
+     * map.
+     */
+    Iter end() {
+        return Iter(get_data().get_mut_element_only().end(), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the element following the last element of the
+     * map.
+     */
+    ConstIter end() const {
+        return ConstIter(get_data().get_const().cend(), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the element following the last element of the
+     * map.
+     */
+    ConstIter cend() const {
+        return ConstIter(get_data().get_const().cend(), data_ptr);
+    }
+
+    /**
+     * Returns a reverse iterator to the last element of the map. Only
+     * available for ordered containers.
+     */
+    ReverseIter rbegin() {
+        return ReverseIter(end());
+    }
+
+    /**
+     * Returns a reverse iterator to the last element of the map. Only
+     * available for ordered containers.
+     */
+    ConstReverseIter rbegin() const {
+        return ConstReverseIter(end());
+    }
+
+    /**
+     * Returns a reverse iterator to the last element of the map. Only
+     * available for ordered containers.
+     */
+    ConstReverseIter crbegin() const {
+        return ConstReverseIter(end());
+    }
+
+    /**
+     * Returns a reverse iterator to the element preceding the first element of
+     * the map. Only available for ordered containers.
+     */
+    ReverseIter rend() {
+        return ReverseIter(begin());
+    }
+
+    /**
+     * Returns a reverse iterator to the element preceding the first element of
+     * the map. Only available for ordered containers.
+     */
+    ConstReverseIter rend() const {
+        return ConstReverseIter(begin());
+    }
+
+    /**
+     * Returns a reverse iterator to the element preceding the first element of
+     * the map. Only available for ordered containers.
+     */
+    ConstReverseIter crend() const {
+        return ConstReverseIter(begin());
+    }
+
+    /**
+     * Checks if the container has no elements.
+     */
+    Bool empty() const {
+        return get_data().get_const().empty();
+    }
+
+    /**
+     * Returns the number of elements in the container.
+     */
+    size_type size() const {
+        return get_data().get_const().size();
+    }
+
+    /**
+     * Reserves storage for at least the given number of elements. All
+     * iterators are invalidated.
+     */
+    void reserve(size_type capacity) {
+        get_data().get_mut().reserve(capacity);
+    }
+
+    /**
+     * Erases all elements from the container. All iterators are invalidated.
+     */
+    void clear() {
+        get_data().get_mut().clear();
+    }
+
+    /**
+     * Inserts the given key-value pair if the key does not exist yet. All
+     * iterators are invalidated if insertion takes place.
+     */
+    std::pair<Iter, Bool> insert(const value_type &value) {
+        auto &data = get_data();
+        if (data.get_const().count(value.first)) {
+            return std::make_pair(Iter(data.get_mut_element_only().find(value.first), data_ptr), false);
+        }
+        auto p = data.get_mut().insert(value);
+        return std::make_pair(Iter(std::move(p.first), data_ptr), true);
+    }
+
+    /**
+     * Constructs a key-value pair from the given arguments and inserts it if
+     * the key does not exist yet. All iterators are invalidated if insertion
+     * takes place.
+     */
+    template <class... Args>
+    std::pair<Iter, Bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Removes the element at pos, which must be valid and dereferenceable. All
+     * iterators are invalidated.
+     */
+    Iter erase(const ConstIter &pos) {
+        pos.check(data_ptr);
+        *pos;
+        return Iter(get_data().get_mut().erase(pos.iter), data_ptr);
+    }
+
+    /**
+     * Removes the elements in the range [first, last). The iterator first
+     * does not need to be dereferenceable if first == last. All iterators are
+     * invalidated. Only available for ordered containers.
+     */
+    Iter erase(const ConstIter &first, const ConstIter &last) {
+        first.check(last);
+        first.check(data_ptr);
+        if (first != last) {
+            *first;
+        }
+        return Iter(get_data().get_mut().erase(first.iter, last.iter), data_ptr);
+    }
+
+    /**
+     * Removes the element with the given key, if any. All iterators are
+     * invalidated. Returns the number of elements removed.
+     */
+    size_type erase(const Key &key) {
+        return get_data().get_mut().erase(key);
+    }
+
+    /**
+     * Swaps the data block of two containers.
+     */
+    void swap(CheckedMapWrapper &other) {
+        std::swap(data_ptr, other.data_ptr);
+    }
+
+    /**
+     * Returns the number of elements with the given key, which is either 0 or
+     * 1.
+     */
+    size_type count(const Key &key) const {
+        return get_data().get_const().count(key);
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    Iter find(const Key &key) {
+        return Iter(get_data().get_mut_element_only().find(key), data_ptr);
+    }
+
+    /**
+     * Finds the element with the given key, returning end() if there is none.
+     */
+    ConstIter find(const Key &key) const {
+        return ConstIter(get_data().get_const().find(key), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element with a key not less than the
+     * given key. Only available for ordered containers.
+     */
+    Iter lower_bound(const Key &key) {
+        return Iter(get_data().get_mut_element_only().lower_bound(key), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element with a key not less than the
+     * given key. Only available for ordered containers.
+     */
+    ConstIter lower_bound(const Key &key) const {
+        return ConstIter(get_data().get_const().lower_bound(key), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element with a key greater than the
+     * given key. Only available for ordered containers.
+     */
+    Iter upper_bound(const Key &key) {
+        return Iter(get_data().get_mut_element_only().upper_bound(key), data_ptr);
+    }
+
+    /**
+     * Returns an iterator to the first element with a key greater than the
+     * given key. Only available for ordered containers.
+     */
+    ConstIter upper_bound(const Key &key) const {
+        return ConstIter(get_data().get_const().upper_bound(key), data_ptr);
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are equal.
+     */
+    friend bool operator==(const CheckedMapWrapper &lhs, const CheckedMapWrapper &rhs) {
+        return lhs.get_data().get_const() == rhs.get_data().get_const();
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are not equal.
+     */
+    friend bool operator!=(const CheckedMapWrapper &lhs, const CheckedMapWrapper &rhs) {
+        return lhs.get_data().get_const() != rhs.get_data().get_const();
+    }
+
+};
+
+/**
+ * Stream << overload for CheckedMapWrapper<>.
+ */
+template <class U>
+std::ostream &operator<<(std::ostream &os, const CheckedMapWrapper<U> &map) {
+    os << map.to_string();
+    return os;
+}
+
+} // namespace utils
+} // namespace ql
@@ -465,6 +465,11 @@ public:
      */
     void update_from(const Options &src);
 
+    /**
+     * Returns the names and values of all options that were explicitly set.
+     */
+    utils::Map<utils::Str, utils::Str> get_set_options() const;
+
     /**
      * Resets all options to their default values.
      */
@@ -0,0 +1,173 @@
+/** \file
+ * Provides simple utilities for running independent pieces of work on multiple
+ * threads.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ql/utils/num.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Returns the number of hardware threads available to us, or 1 if the
+ * standard library can't tell us.
+ */
+UInt get_hardware_concurrency();
+
+/**
+ * Resolves a user-specified thread count to the actual number of threads to
+ * use. 0 is interpreted as "use all hardware threads."
+ */
+UInt resolve_num_threads(UInt num_threads);
+
+/**
+ * Process-wide pool of worker threads that all parallel work of OpenQL is
+ * distributed over, such that nested or concurrent parallel regions (say,
+ * per-kernel passes inside a batch compilation) don't oversubscribe the
+ * machine. Each worker has its own deque of tasks: tasks submitted by a
+ * worker are pushed to the back of its own deque and popped from there
+ * (LIFO, for locality), while idle workers steal from the front of the
+ * deques of others. Tasks submitted by other threads go to a separate
+ * injection deque.
+ *
+ * Threads waiting for the completion of tasks (see wait_until()) help by
+ * running pending tasks themselves, so waiting on a worker thread cannot
+ * deadlock the pool, even when all workers are waiting.
+ *
+ * Tasks run with the logger redirection (see logger::Redirect), OpenQL
+ * working directory, and compile-time budget (see TimeBudget) of the thread
+ * that submitted them, so log messages and output files end up where they
+ * would have if the task had been run by the submitting thread itself. Tasks
+ * must not throw exceptions; exceptions that escape anyway are logged and
+ * discarded.
+ *
+ * When OpenQL is built with QL_SINGLE_THREADED, the pool has no workers and
+ * tasks are run immediately by submit().
+ */
+class ThreadPool {
+private:
+
+    /**
+     * The deques, workers, and synchronization primitives, defined in the
+     * source file.
+     */
+    class State;
+
+    /**
+     * The current state of the pool, created when the first task is
+     * submitted, and replaced when the pool is resized. Loaded without
+     * locking; states are never destroyed while the pool exists, so threads
+     * that still hold the previous one can safely keep using it.
+     */
+    std::atomic<State*> state{nullptr};
+
+    /**
+     * Protects creating and replacing the state, and the states list.
+     */
+    std::mutex state_mutex;
+
+    /**
+     * All states created thus far, owning them.
+     */
+    std::vector<std::unique_ptr<State>> states;
+
+    /**
+     * The maximum total number of threads working on tasks, including the
+     * thread that waits for them.
+     */
+    std::atomic<UInt> num_threads;
+
+    /**
+     * Returns the state to submit a task to, creating it if there is none,
+     * and replacing it if the number of threads changed and no tasks are
+     * pending. The task is counted as pending for the returned state, such
+     * that it can't be replaced before the task is pushed.
+     */
+    State *acquire_state();
+
+    ThreadPool();
+
+public:
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * Returns the process-wide pool.
+     */
+    static ThreadPool &get();
+
+    /**
+     * Sets the maximum total number of threads working on tasks, including
+     * the thread waiting for them, after resolving it with
+     * resolve_num_threads(); the pool thus uses one worker thread less than
+     * this. This is controlled by the num_threads global option. The workers
+     * are (re)started lazily, when the next task is submitted; if tasks are
+     * still pending at that time, the resize is deferred to the first
+     * submission after they are done. This may be called from any thread.
+     */
+    void set_num_threads(UInt num_threads);
+
+    /**
+     * Returns the maximum total number of threads working on tasks, as set
+     * by set_num_threads().
+     */
+    UInt get_num_threads() const;
+
+    /**
+     * Queues the given task.
+     */
+    void submit(std::function<void()> &&task);
+
+    /**
+     * Runs a single pending task on the calling thread, if there is one.
+     * Returns whether a task was run.
+     */
+    Bool run_pending_task();
+
+    /**
+     * Blocks until done() returns true, running pending tasks in the
+     * meantime. The tasks signalling completion must call notify() after
+     * updating whatever state done() checks.
+     */
+    void wait_until(const std::function<Bool()> &done);
+
+    /**
+     * Wakes up the threads blocked in wait_until(), such that they
+     * re-evaluate their condition.
+     */
+    void notify();
+
+};
+
+/**
+ * Calls fn(i) for all i in [0, count), using at most num_threads threads
+ * (after resolving it with resolve_num_threads()), and no more than the
+ * num_threads global option allows; the additional threads are taken from
+ * ThreadPool. The calling thread participates in the work, so nothing is
+ * submitted to the pool at all when the effective thread count or count is
+ * one (or less). Calls to parallel_for() may be nested. The order in which the
+ * indices are processed is undefined, so fn must only touch state that
+ * belongs to index i, or otherwise synchronize itself.
+ *
+ * If one or more calls to fn throw an exception, the remaining indices that
+ * haven't been started yet are skipped, and once all threads are done, the
+ * exception thrown for the lowest index is rethrown in the calling thread.
+ */
+void parallel_for(
+    UInt count,
+    UInt num_threads,
+    const std::function<void(UInt)> &fn
+);
+
+} // namespace utils
+} // namespace ql
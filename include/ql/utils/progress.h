@@ -1,75 +1,114 @@
 /** \file
- * Provides utilities for working with strings that the STL fails to
- * satisfactorily provide.
+ * Thread-safe progress monitoring for long-running algorithms.
  */
 
 #pragma once
 
-#include <chrono>
+#include <functional>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
+#include "ql/utils/map.h"
+#include "ql/utils/ptr.h"
 
 namespace ql {
 namespace utils {
 
 /**
- * Progress monitor. Prints progress every N milliseconds (as long as progress
- * is called often enough), including time taken thus far and ETA, using
- * INFO loglevel.
+ * Progress monitor. Progress is recorded using relaxed atomic operations only,
+ * so recording it is cheap enough to do for every gate, and monitors may be
+ * updated from any thread. A single background reporter thread samples all
+ * active monitors at a fixed rate, prints the progress of each monitor every
+ * interval milliseconds (including time taken thus far and ETA) using INFO
+ * loglevel, and passes the progress of all monitors to the progress callback,
+ * if any.
+ *
+ * Copies of a monitor refer to the same progress; the monitor stops being
+ * reported when complete() is called or when the last copy is destroyed.
  */
 class Progress {
-private:
+public:
 
     /**
-     * The clock source to use.
+     * Callback for progress updates, called from the reporter thread with
+     * the progress of all active monitors, keyed by prefix. The progress of
+     * monitors with the same prefix is averaged. The callback must not block
+     * for long, as it delays further reporting.
      */
-    using Clock = std::chrono::high_resolution_clock;
+    using Callback = std::function<void(const Map<Str, Real> &progress)>;
 
     /**
-     * Time points for the clock source.
+     * The rate in milliseconds at which the reporter thread samples the
+     * active monitors.
      */
-    using TimePoint = Clock::time_point;
+    static const UInt REPORT_INTERVAL;
 
     /**
-     * Prefix for printing.
+     * Sets the progress callback, or clears it when an empty function is
+     * passed.
      */
-    Str prefix;
+    static void set_callback(const Callback &callback);
 
     /**
-     * Minimum printing interval.
+     * Returns the current progress of all active monitors, keyed by prefix,
+     * as it would be passed to the progress callback.
      */
-    UInt interval;
+    static Map<Str, Real> get_snapshot();
+
+private:
 
     /**
-     * Start time (when we were constructed).
+     * The progress state shared with the reporter thread.
      */
-    TimePoint start;
+    struct State;
+
+    friend class Reporter;
 
     /**
-     * The previous time we printed our progress.
+     * The shared state, or empty for monitors that don't report anything.
      */
-    TimePoint prev;
+    Ptr<State> state;
 
 public:
 
     /**
-     * Constructor that doesn't print anything.
+     * Constructor that doesn't report anything.
      */
     Progress();
 
     /**
-     * Progress monitor constructor. Also starts the timer.
+     * Progress monitor constructor. Also starts the timer. The progress is
+     * printed every interval milliseconds; if the total amount of work is
+     * not known yet, it can be set later using set_total().
+     */
+    explicit Progress(const Str &prefix, UInt interval=0, UInt total=0);
+
+    /**
+     * Sets the total amount of work.
+     */
+    void set_total(UInt total);
+
+    /**
+     * Records that the given amount of work was done. This is a single
+     * relaxed atomic increment.
+     */
+    void advance(UInt amount=1);
+
+    /**
+     * Records the total amount of work done thus far. This is a single relaxed
+     * atomic store.
      */
-    explicit Progress(const Str &prefix, UInt interval=0);
+    void set_done(UInt done);
 
     /**
-     * Prints the current progress and ETA, if enough time has passed since
-     * the previous print.
+     * Records the progress as a fraction between 0 and 1, for algorithms that
+     * can't express their progress as an amount of work. This overrides the
+     * total amount of work set previously.
      */
     void feed(Real progress);
 
     /**
-     * Prints a completion message that includes total time taken.
+     * Stops reporting the progress, and prints a completion message that
+     * includes total time taken.
      */
     void complete();
 
@@ -7,8 +7,11 @@
 #pragma once
 
 #include <memory>
+#include <atomic>
 #include <type_traits>
 #include <functional>
+#include "ql/config.h"
+#include "ql/utils/num.h"
 #include "ql/utils/logger.h"
 #include "ql/utils/exception.h"
 
@@ -845,5 +848,361 @@ public:
 
 };
 
+/**
+ * Base class for objects that keep their own reference count, such that they
+ * can be referenced through IntrusivePtr. This avoids the separately-allocated
+ * control block of std::shared_ptr, and halves the size of the handle.
+ *
+ * The count is atomic, unless OpenQL is compiled with QL_SINGLE_THREADED, in
+ * which case it is a plain integer. Copying an object does not copy its
+ * count; the copy starts out unreferenced.
+ */
+class RefCounted {
+private:
+    template <class T>
+    friend class IntrusivePtr;
+
+    /**
+     * The number of IntrusivePtrs referring to this object.
+     */
+#ifdef QL_SINGLE_THREADED
+    mutable UInt ref_count{0};
+#else
+    mutable std::atomic<UInt> ref_count{0};
+#endif
+
+    /**
+     * Adds a reference.
+     */
+    void add_ref() const noexcept {
+#ifdef QL_SINGLE_THREADED
+        ref_count++;
+#else
+        ref_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+    }
+
+    /**
+     * Drops a reference, deleting the object if it was the last one.
+     */
+    void release() const noexcept {
+#ifdef QL_SINGLE_THREADED
+        if (--ref_count == 0) {
+            delete this;
+        }
+#else
+        if (ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+#endif
+    }
+
+protected:
+
+    RefCounted() = default;
+    RefCounted(const RefCounted &) noexcept {}
+    RefCounted &operator=(const RefCounted &) noexcept { return *this; }
+
+public:
+
+    /**
+     * Objects are deleted through this base class, so the destructor must be
+     * virtual.
+     */
+    virtual ~RefCounted() = default;
+
+};
+
+/**
+ * Like Ptr, but for types deriving from RefCounted, keeping the reference
+ * count in the object itself. The interface is the same as Ptr's, except that
+ * there is no unwrap(), so switching a type between Ptr and IntrusivePtr is
+ * just a matter of changing a typedef and adding or removing the RefCounted
+ * base class.
+ */
+template <class T>
+class IntrusivePtr {
+public:
+    using Data = T;
+
+private:
+    template <class S>
+    friend class IntrusivePtr;
+
+    /**
+     * The referenced object, which holds a reference for us.
+     */
+    T *v = nullptr;
+
+    /**
+     * Returns a new reference to the given object, which may be null.
+     */
+    static IntrusivePtr retain(T *ptr) noexcept {
+        IntrusivePtr result;
+        result.v = ptr;
+        if (ptr) ptr->add_ref();
+        return result;
+    }
+
+public:
+
+    /**
+     * Initialization method, used to fill an empty container after
+     * construction. Will override any previous value.
+     */
+    template<typename S = T, class... Args>
+    void emplace(Args&&... args) {
+        *this = retain(new S(std::forward<Args>(args)...));
+    }
+
+    /**
+     * Drops the contained object, if any.
+     */
+    void reset() {
+        if (v) v->release();
+        v = nullptr;
+    }
+
+    /**
+     * Constructor for an empty container.
+     */
+    IntrusivePtr() = default;
+
+    /**
+     * Constructor for a filled container.
+     *
+     * This only works when there is at least one argument for the constructor
+     * of the contained object, and the object is not polymorphic. You'll have
+     * to use emplace() otherwise.
+     */
+    template<
+        class Arg1, class... Args,
+        typename = typename std::enable_if<!std::is_same<
+            typename std::remove_reference<Arg1>::type,
+            IntrusivePtr<T>
+        >::value>::type>
+    IntrusivePtr(Arg1 &&arg1, Args&&... args) {
+        emplace(std::forward<Arg1>(arg1), std::forward<Args>(args)...);
+    }
+
+    /**
+     * Builder for IntrusivePtr objects.
+     */
+    template<class... Args>
+    static IntrusivePtr make(Args&&... args) {
+        IntrusivePtr ret;
+        ret.emplace(std::forward<Args>(args)...);
+        return ret;
+    }
+
+    /**
+     * Copy constructor. Only the pointer is copied, so the two IntrusivePtrs
+     * will refer to the same object.
+     */
+    IntrusivePtr(const IntrusivePtr &o) noexcept : v(o.v) {
+        if (v) v->add_ref();
+    }
+
+    /**
+     * Move constructor. Just moves the pointer to the contained object.
+     */
+    IntrusivePtr(IntrusivePtr &&o) noexcept : v(o.v) {
+        o.v = nullptr;
+    }
+
+    /**
+     * Destructor. Drops our reference.
+     */
+    ~IntrusivePtr() {
+        reset();
+    }
+
+    /**
+     * Copy assignment. Copies the pointer, so both IntrusivePtrs will point to
+     * the same object.
+     */
+    template<typename S = T, typename = typename std::enable_if<std::is_base_of<T, S>::value>::type>
+    IntrusivePtr &operator=(const IntrusivePtr<S> &rhs) {
+        return *this = retain(rhs.v);
+    }
+
+    /**
+     * Copy assignment. Copies the pointer, so both IntrusivePtrs will point to
+     * the same object.
+     */
+    IntrusivePtr &operator=(const IntrusivePtr &rhs) {
+        return *this = IntrusivePtr(rhs);
+    }
+
+    /**
+     * Move assignment.
+     */
+    IntrusivePtr &operator=(IntrusivePtr &&rhs) noexcept {
+        std::swap(v, rhs.v);
+        return *this;
+    }
+
+    /**
+     * Returns whether this container is filled.
+     */
+    bool has_value() const noexcept {
+        return v != nullptr;
+    }
+
+    /**
+     * Returns whether this container is filled.
+     */
+    explicit operator bool() const noexcept {
+        return v != nullptr;
+    }
+
+    /**
+     * Returns the raw pointer, without taking a reference.
+     */
+    T *get() const noexcept {
+        return v;
+    }
+
+    /**
+     * Returns whether this IntrusivePtr points to a value of the given type.
+     */
+    template<typename S>
+    bool is() const noexcept {
+        return dynamic_cast<S*>(v) != nullptr;
+    }
+
+    /**
+     * Casts to an IntrusivePtr of the given type. The resulting IntrusivePtr
+     * will be empty if the cast failed.
+     */
+    template<typename S>
+    IntrusivePtr<S> try_as() const noexcept {
+        return IntrusivePtr<S>::retain(dynamic_cast<S*>(v));
+    }
+
+    /**
+     * Casts to an IntrusivePtr of the given type. Throws an exception if the
+     * cast failed or this IntrusivePtr is empty.
+     */
+    template<typename S>
+    IntrusivePtr<S> as() const {
+        if (!v) {
+            throw Exception("attempt to cast empty Ptr");
+        }
+        auto result = try_as<S>();
+        if (!result) {
+            throw Exception("attempt to cast Ptr to unsupported type");
+        }
+        return result;
+    }
+
+    /**
+     * Casts to a const IntrusivePtr.
+     */
+    IntrusivePtr<const T> as_const() const noexcept {
+        return IntrusivePtr<const T>::retain(v);
+    }
+
+    /**
+     * Dereference operator.
+     */
+    T &operator*() const {
+        if (!v) {
+            QL_ICE("attempt to dereference empty Ptr of type " << typeid(T).name());
+        }
+        return *v;
+    }
+
+    /**
+     * Dereference operator.
+     */
+    T *operator->() const {
+        if (!v) {
+            QL_ICE("attempt to dereference empty Ptr of type " << typeid(T).name());
+        }
+        return v;
+    }
+
+    /**
+     * Stream overload for pointers.
+     */
+    friend std::ostream &operator<<(std::ostream &os, const IntrusivePtr &ptr) {
+        if (ptr.v) {
+            os << *ptr.v;
+        } else {
+            os << "<NULL>";
+        }
+        return os;
+    }
+
+    /**
+     * Pointer-based equality operator.
+     */
+    utils::Bool operator==(const IntrusivePtr &rhs) const {
+        return v == rhs.v;
+    }
+
+    /**
+     * Pointer-based inequality operator.
+     */
+    utils::Bool operator!=(const IntrusivePtr &rhs) const {
+        return v != rhs.v;
+    }
+
+    /**
+     * Pointer-based comparison operator.
+     */
+    utils::Bool operator<(const IntrusivePtr &rhs) const {
+        return std::less<T*>()(v, rhs.v);
+    }
+
+    /**
+     * Pointer-based comparison operator.
+     */
+    utils::Bool operator<=(const IntrusivePtr &rhs) const {
+        return !(rhs < *this);
+    }
+
+    /**
+     * Pointer-based comparison operator.
+     */
+    utils::Bool operator>(const IntrusivePtr &rhs) const {
+        return rhs < *this;
+    }
+
+    /**
+     * Pointer-based comparison operator.
+     */
+    utils::Bool operator>=(const IntrusivePtr &rhs) const {
+        return !(*this < rhs);
+    }
+
+};
+
 } // namespace utils
 } // namespace ql
+
+namespace std {
+
+/**
+ * Pointer-based hash for Ptr<>, consistent with its equality operator, so it
+ * can be used as the key of a utils::HashMap.
+ */
+template <class T>
+struct hash<::ql::utils::Ptr<T>> {
+    std::size_t operator()(const ::ql::utils::Ptr<T> &ptr) const noexcept {
+        return std::hash<T*>()(ptr.unwrap().get());
+    }
+};
+
+/**
+ * Pointer-based hash for IntrusivePtr<>.
+ */
+template <class T>
+struct hash<::ql::utils::IntrusivePtr<T>> {
+    std::size_t operator()(const ::ql::utils::IntrusivePtr<T> &ptr) const noexcept {
+        return std::hash<T*>()(ptr.get());
+    }
+};
+
+} // namespace std
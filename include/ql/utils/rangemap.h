@@ -7,6 +7,7 @@
 #include <functional>
 #include "ql/utils/pair.h"
 #include "ql/utils/map.h"
+#include "ql/utils/flat_map.h"
 #include "ql/utils/exception.h"
 #include "ql/utils/ptr.h"
 
@@ -71,6 +72,25 @@ enum class RangeMatchType {
  */
 std::ostream &operator<<(std::ostream &os, RangeMatchType rmt);
 
+/**
+ * Comparator for ranges of keys, used to order the ranges of a RangeMap.
+ * operator() returns whether the left-hand side sorts before the right-hand
+ * side.
+ */
+template <typename K, typename C = std::less<K>>
+struct RangeCompare {
+    C key_compare;
+    utils::Bool operator()(const utils::Pair<K, K> &lhs, const utils::Pair<K, K> &rhs) const {
+        if (key_compare(lhs.first, rhs.first)) {
+            return true;
+        } else if (key_compare(rhs.first, lhs.first)) {
+            return false;
+        } else {
+            return key_compare(rhs.second, lhs.second);
+        }
+    }
+};
+
 /**
  * A map (and set) mapping from non-overlapping *ranges* of keys to values.
  *
@@ -79,8 +99,17 @@ std::ostream &operator<<(std::ostream &os, RangeMatchType rmt);
  * indicates that the values for the consecutive ranges are equal. By default
  * ranges are kept as-is; alternative comparators can be presented to the
  * constructor or to set().
+ *
+ * M is the ordered map from range to value that the range map is built upon.
+ * By default this is a utils::Map, but FlatRangeMap uses a utils::FlatMap
+ * instead.
  */
-template <typename K, typename V, typename C = std::less<K>>
+template <
+    typename K,
+    typename V,
+    typename C = std::less<K>,
+    typename M = utils::Map<utils::Pair<K, K>, V, RangeCompare<K, C>>
+>
 class RangeMap {
 public:
 
@@ -104,18 +133,7 @@ public:
      * Comparator for ranges. operator() returns whether the left-hand side
      * sorts before the right-hand side.
      */
-    struct RangeCompare {
-        KeyCompare key_compare;
-        utils::Bool operator()(const Range& lhs, const Range& rhs) const {
-            if (key_compare(lhs.first, rhs.first)) {
-                return true;
-            } else if (key_compare(rhs.first, lhs.first)) {
-                return false;
-            } else {
-                return key_compare(rhs.second, lhs.second);
-            }
-        }
-    };
+    using RangeCompare = utils::RangeCompare<K, C>;
 
     /**
      * The value type.
@@ -130,7 +148,7 @@ public:
     /**
      * The map type this is built upon.
      */
-    using Map = utils::Map<Range, Value, RangeCompare>;
+    using Map = M;
 
     /**
      * Mutable iterator.
@@ -463,6 +481,28 @@ public:
         };
     }
 
+    /**
+     * Returns whether any range in the map overlaps with the given range. This
+     * is equivalent to checking whether find() returns RangeMatchType::NONE,
+     * but only looks at the ranges adjacent to the insertion position of the
+     * given range rather than collecting all overlapping ranges.
+     */
+    utils::Bool find_any_overlap(const Range &range) const {
+        if (!range_valid(range)) {
+            throw utils::Exception(
+                "Invalid range presented to find_any_overlap(): " + utils::try_to_string(range)
+            );
+        }
+        auto it = map.lower_bound(range);
+        if (it != map.end() && !range_entirely_before(range, it->first)) {
+            return true;
+        }
+        if (it != map.begin() && !range_entirely_before(std::prev(it)->first, range)) {
+            return true;
+        }
+        return false;
+    }
+
     /**
      * Returns an iterator to the range that contains the given key, or end() if
      * no such range exists.
@@ -856,5 +896,24 @@ public:
 template <typename K, typename C = std::less<K>>
 using RangeSet = RangeMap<K, Nothing, C>;
 
+/**
+ * RangeMap built upon a sorted vector (utils::FlatMap) rather than a
+ * node-based map. Lookups are binary searches over contiguous memory and
+ * copying the map takes a single allocation, which makes this the better
+ * choice for the small maps that scheduling resources keep per instrument or
+ * qubit, which are copied whenever the resource state is cloned or a
+ * checkpoint is recorded. Insertion and removal are linear in the number of
+ * ranges, and invalidate all iterators.
+ */
+template <typename K, typename V, typename C = std::less<K>>
+using FlatRangeMap = RangeMap<K, V, C, utils::FlatMap<utils::Pair<K, K>, V, RangeCompare<K, C>>>;
+
+/**
+ * Convenience typedef for FlatRangeMaps that don't map to anything significant
+ * and thus behave like a set instead.
+ */
+template <typename K, typename C = std::less<K>>
+using FlatRangeSet = FlatRangeMap<K, Nothing, C>;
+
 } // namespace utils
 } // namespace ql
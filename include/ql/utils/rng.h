@@ -0,0 +1,114 @@
+/** \file
+ * Counter-based random number generation, for reproducible random streams
+ * that don't depend on the order in which threads consume them.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "ql/utils/num.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Philox4x32-10 counter-based random number generator, as described by
+ * Salmon et al., "Parallel random numbers: as easy as 1, 2, 3" (SC'11).
+ *
+ * Unlike a sequential generator such as std::mt19937, the numbers are
+ * computed from a key (the seed) and a counter by means of a bijection, so
+ * any position of any stream can be produced directly. The upper half of the
+ * 128-bit counter selects the stream and the lower half the position within
+ * it. Callers that need reproducible results regardless of how work is
+ * distributed over threads can thus derive a stream identifier from the
+ * logical position of the work item (for example a kernel and gate index)
+ * instead of sharing a generator.
+ *
+ * This satisfies the UniformRandomBitGenerator requirements, so it can be
+ * used with the standard distributions and std::shuffle().
+ */
+class Philox {
+public:
+
+    /**
+     * The type of the generated numbers.
+     */
+    using result_type = std::uint32_t;
+
+    /**
+     * Smallest number that can be generated.
+     */
+    static constexpr result_type min() { return 0; }
+
+    /**
+     * Largest number that can be generated.
+     */
+    static constexpr result_type max() { return 0xFFFFFFFFu; }
+
+private:
+
+    /**
+     * The key, derived from the seed.
+     */
+    std::array<result_type, 2> key;
+
+    /**
+     * The counter of the next block. Words 0 and 1 hold the position within
+     * the stream, words 2 and 3 the stream identifier.
+     */
+    std::array<result_type, 4> counter;
+
+    /**
+     * The current block of random numbers.
+     */
+    std::array<result_type, 4> block;
+
+    /**
+     * Index of the next number in block to return. 4 means that the next
+     * block must be generated first.
+     */
+    UInt index;
+
+public:
+
+    /**
+     * Constructs a generator for the given seed and stream.
+     */
+    explicit Philox(UInt seed = 0, UInt stream = 0);
+
+    /**
+     * Resets the generator to the start of the given stream for the given
+     * seed.
+     */
+    void seed(UInt seed, UInt stream = 0);
+
+    /**
+     * Returns the next random number of the stream.
+     */
+    result_type operator()();
+
+    /**
+     * Skips the next n numbers of the stream in constant time.
+     */
+    void discard(UInt n);
+
+    /**
+     * Applies the Philox4x32-10 bijection to the given counter using the
+     * given key, returning the resulting block of four random numbers.
+     */
+    static std::array<result_type, 4> generate(
+        const std::array<result_type, 4> &counter,
+        const std::array<result_type, 2> &key
+    );
+
+    /**
+     * Derives a new seed from the given seed and index, for example to give
+     * each of a number of independent runs its own set of streams.
+     */
+    static UInt derive_seed(UInt seed, UInt index);
+
+};
+
+} // namespace utils
+} // namespace ql
@@ -0,0 +1,676 @@
+/** \file
+ * Provides a vector with inline storage for a small number of elements.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <sstream>
+#include <type_traits>
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/container_base.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Vector that stores up to N elements inline, and only allocates on the heap
+ * when it grows beyond that. This is intended for the many small lists of
+ * integers in the IR, such as gate operand lists, which almost always have
+ * only one to three entries.
+ *
+ * Like Vec, operator[] is range-checked; it basically functions like at(), as
+ * do front() and back(). The iterators are plain pointers though, so they are
+ * not checked for invalidation, even when QL_CHECKED_VEC is defined. T must be
+ * a trivial type, such that elements can be copied and moved around with
+ * memcpy()/memmove().
+ *
+ * SmallVec converts implicitly from and to Vec<T>, so it can be passed to
+ * functions that take a const Vec<T>& and assigned from a Vec<T>, at the cost
+ * of a copy.
+ */
+template <typename T, std::size_t N>
+class SmallVec {
+    static_assert(std::is_trivial<T>::value, "SmallVec only supports trivial types");
+    static_assert(N > 0, "SmallVec needs room for at least one inline element");
+public:
+
+    // Member types expected by the standard library.
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+private:
+
+    /**
+     * The number of elements in the vector.
+     */
+    std::uint32_t count = 0;
+
+    /**
+     * The number of elements that fit in the current storage. The elements
+     * are stored inline if and only if this equals N.
+     */
+    std::uint32_t cap = N;
+
+    /**
+     * Inline storage, or the heap storage if cap > N.
+     */
+    union {
+        T inline_data[N];
+        T *heap_data;
+    };
+
+    /**
+     * Returns whether the elements are stored on the heap.
+     */
+    bool on_heap() const {
+        return cap > N;
+    }
+
+    /**
+     * Throws a ContainerException if the vector is empty.
+     */
+    void check_not_empty() const {
+        if (!count) {
+            QL_CONTAINER_ERROR("access to first or last element of empty vector");
+        }
+    }
+
+    /**
+     * Returns the index of the given iterator, checking that it belongs to
+     * this vector. end() is allowed if allow_end is set.
+     */
+    size_type index_of(const_iterator pos, bool allow_end) const {
+        if (pos < cbegin() || pos > cend() || (!allow_end && pos == cend())) {
+            QL_CONTAINER_ERROR("iterator does not point into this vector");
+        }
+        return pos - cbegin();
+    }
+
+public:
+
+    /**
+     * Default constructor. Constructs an empty container.
+     */
+    SmallVec() {}
+
+    /**
+     * Constructs the container with count copies of elements with value value.
+     */
+    SmallVec(size_type count, const T &value) {
+        assign(count, value);
+    }
+
+    /**
+     * Constructs the container with count value-initialized instances of T.
+     */
+    explicit SmallVec(size_type count) {
+        resize(count);
+    }
+
+    /**
+     * Constructs the container with the contents of the range [first, last).
+     *
+     * This overload only participates in overload resolution if InputIt
+     * satisfies LegacyInputIterator, to avoid ambiguity with other overloads.
+     */
+    template <
+        typename InputIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<InputIt>::iterator_category,
+            std::input_iterator_tag
+        >::value>::type
+    >
+    SmallVec(InputIt first, InputIt last) {
+        assign(first, last);
+    }
+
+    /**
+     * Constructs the container with the contents of the initializer list.
+     */
+    SmallVec(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+    }
+
+    /**
+     * Constructs the container with a copy of the contents of the given Vec.
+     */
+    SmallVec(const Vec<T> &other) {
+        assign(other.begin(), other.end());
+    }
+
+    /**
+     * Copy constructor.
+     */
+    SmallVec(const SmallVec &other) {
+        assign(other.cbegin(), other.cend());
+    }
+
+    /**
+     * Move constructor. After the move, other is empty().
+     */
+    SmallVec(SmallVec &&other) noexcept {
+        steal(other);
+    }
+
+    /**
+     * Destructor.
+     */
+    ~SmallVec() {
+        if (on_heap()) {
+            delete[] heap_data;
+        }
+    }
+
+    /**
+     * Copy assignment operator.
+     */
+    SmallVec &operator=(const SmallVec &other) {
+        if (this != &other) {
+            assign(other.cbegin(), other.cend());
+        }
+        return *this;
+    }
+
+    /**
+     * Move assignment operator. After the move, other is empty().
+     */
+    SmallVec &operator=(SmallVec &&other) noexcept {
+        if (this != &other) {
+            if (on_heap()) {
+                delete[] heap_data;
+            }
+            steal(other);
+        }
+        return *this;
+    }
+
+    /**
+     * Replaces the contents with a copy of the contents of the given Vec.
+     */
+    SmallVec &operator=(const Vec<T> &other) {
+        assign(other.begin(), other.end());
+        return *this;
+    }
+
+    /**
+     * Replaces the contents with those of the initializer list.
+     */
+    SmallVec &operator=(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+        return *this;
+    }
+
+    /**
+     * Returns a Vec with a copy of the contents.
+     */
+    operator Vec<T>() const {
+        return Vec<T>(cbegin(), cend());
+    }
+
+    /**
+     * Replaces the contents with count copies of value.
+     */
+    void assign(size_type count, const T &value) {
+        clear();
+        resize(count, value);
+    }
+
+    /**
+     * Replaces the contents with the range [first, last).
+     */
+    template <
+        typename InputIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<InputIt>::iterator_category,
+            std::input_iterator_tag
+        >::value>::type
+    >
+    void assign(InputIt first, InputIt last) {
+        clear();
+        for (; first != last; ++first) {
+            push_back(*first);
+        }
+    }
+
+    /**
+     * Returns a reference to the element at specified location pos, with bounds
+     * checking. If pos is not within the range of the container, an exception
+     * of type ContainerException is thrown.
+     */
+    reference at(size_type pos) {
+        if (pos >= count) {
+            QL_CONTAINER_ERROR(
+                "index " + std::to_string(pos) + " is out of range, "
+                "size is " + std::to_string(count)
+            );
+        }
+        return data()[pos];
+    }
+
+    /**
+     * Returns a const reference to the element at specified location pos, with
+     * bounds checking. If pos is not within the range of the container, an
+     * exception of type ContainerException is thrown.
+     */
+    const_reference at(size_type pos) const {
+        if (pos >= count) {
+            QL_CONTAINER_ERROR(
+                "index " + std::to_string(pos) + " is out of range, "
+                "size is " + std::to_string(count)
+            );
+        }
+        return data()[pos];
+    }
+
+    /**
+     * Returns a reference to the element at specified location pos, with bounds
+     * checking. If pos is not within the range of the container, an exception
+     * of type ContainerException is thrown.
+     */
+    reference operator[](size_type pos) {
+        return at(pos);
+    }
+
+    /**
+     * Returns a const reference to the element at specified location pos, with
+     * bounds checking. If pos is not within the range of the container, an
+     * exception of type ContainerException is thrown.
+     */
+    const_reference operator[](size_type pos) const {
+        return at(pos);
+    }
+
+    /**
+     * Returns UNCHECKED mutable access to the value stored at the given index.
+     */
+    reference unchecked_at(size_type index) {
+        return data()[index];
+    }
+
+    /**
+     * Returns UNCHECKED const access to the value stored at the given index.
+     */
+    const_reference unchecked_at(size_type index) const {
+        return data()[index];
+    }
+
+    /**
+     * Returns a const reference to the value at the given index, or to a dummy
+     * default-constructed value if the index is out of range.
+     */
+    const_reference get(size_type index) const {
+        if (index >= count) {
+            static const T DEFAULT{};
+            return DEFAULT;
+        }
+        return data()[index];
+    }
+
+    /**
+     * Returns a reference to the first element. Throws a ContainerException
+     * if the container is empty.
+     */
+    reference front() {
+        check_not_empty();
+        return data()[0];
+    }
+
+    /**
+     * Returns a const reference to the first element. Throws a
+     * ContainerException if the container is empty.
+     */
+    const_reference front() const {
+        check_not_empty();
+        return data()[0];
+    }
+
+    /**
+     * Returns a reference to the last element. Throws a ContainerException
+     * if the container is empty.
+     */
+    reference back() {
+        check_not_empty();
+        return data()[count - 1];
+    }
+
+    /**
+     * Returns a const reference to the last element. Throws a
+     * ContainerException if the container is empty.
+     */
+    const_reference back() const {
+        check_not_empty();
+        return data()[count - 1];
+    }
+
+    /**
+     * Returns a pointer to the underlying storage.
+     */
+    T *data() {
+        return on_heap() ? heap_data : inline_data;
+    }
+
+    /**
+     * Returns a const pointer to the underlying storage.
+     */
+    const T *data() const {
+        return on_heap() ? heap_data : inline_data;
+    }
+
+    // Iterators.
+    iterator begin() { return data(); }
+    const_iterator begin() const { return data(); }
+    const_iterator cbegin() const { return data(); }
+    iterator end() { return data() + count; }
+    const_iterator end() const { return data() + count; }
+    const_iterator cend() const { return data() + count; }
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator crbegin() const { return const_reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    const_reverse_iterator crend() const { return const_reverse_iterator(begin()); }
+
+    /**
+     * Returns whether the container is empty.
+     */
+    bool empty() const {
+        return !count;
+    }
+
+    /**
+     * Returns the number of elements.
+     */
+    size_type size() const {
+        return count;
+    }
+
+    /**
+     * Returns the number of elements that can be held without reallocating.
+     */
+    size_type capacity() const {
+        return cap;
+    }
+
+    /**
+     * Makes room for at least new_cap elements. Moves the elements to the
+     * heap if new_cap exceeds N.
+     */
+    void reserve(size_type new_cap) {
+        if (new_cap <= cap) {
+            return;
+        }
+        if (new_cap > UINT32_MAX) {
+            QL_CONTAINER_ERROR("SmallVec cannot hold " + std::to_string(new_cap) + " elements");
+        }
+        new_cap = std::max<size_type>(new_cap, 2 * (size_type)cap);
+        if (new_cap > UINT32_MAX) {
+            new_cap = UINT32_MAX;
+        }
+        T *new_data = new T[new_cap];
+        std::memcpy(new_data, data(), count * sizeof(T));
+        if (on_heap()) {
+            delete[] heap_data;
+        }
+        heap_data = new_data;
+        cap = new_cap;
+    }
+
+    /**
+     * Erases all elements. The capacity is left unchanged.
+     */
+    void clear() {
+        count = 0;
+    }
+
+    /**
+     * Inserts value before pos, and returns an iterator to it.
+     */
+    iterator insert(const_iterator pos, const T &value) {
+        return insert(pos, &value, &value + 1);
+    }
+
+    /**
+     * Inserts the range [first, last) before pos, and returns an iterator to
+     * the first inserted element. The range must not point into this vector.
+     */
+    template <
+        typename ForwardIt,
+        typename = typename std::enable_if<std::is_convertible<
+            typename std::iterator_traits<ForwardIt>::iterator_category,
+            std::forward_iterator_tag
+        >::value>::type
+    >
+    iterator insert(const_iterator pos, ForwardIt first, ForwardIt last) {
+        size_type index = index_of(pos, true);
+        size_type num = std::distance(first, last);
+        reserve(count + num);
+        T *d = data();
+        std::memmove(d + index + num, d + index, (count - index) * sizeof(T));
+        std::copy(first, last, d + index);
+        count += num;
+        return d + index;
+    }
+
+    /**
+     * Removes the element at pos, and returns an iterator following it.
+     */
+    iterator erase(const_iterator pos) {
+        index_of(pos, false);
+        return erase(pos, pos + 1);
+    }
+
+    /**
+     * Removes the elements in the range [first, last), and returns an
+     * iterator following the last removed element.
+     */
+    iterator erase(const_iterator first, const_iterator last) {
+        size_type from = index_of(first, true);
+        size_type to = index_of(last, true);
+        if (to < from) {
+            QL_CONTAINER_ERROR("invalid iterator range for erase");
+        }
+        T *d = data();
+        std::memmove(d + from, d + to, (count - to) * sizeof(T));
+        count -= to - from;
+        return d + from;
+    }
+
+    /**
+     * Appends the given element.
+     */
+    void push_back(const T &value) {
+        if (count == cap) {
+            T copy = value;     // value may point into this vector
+            reserve(count + 1);
+            data()[count++] = copy;
+        } else {
+            data()[count++] = value;
+        }
+    }
+
+    /**
+     * Appends an element constructed from the given arguments.
+     */
+    template <class... Args>
+    reference emplace_back(Args&&... args) {
+        push_back(T(std::forward<Args>(args)...));
+        return back();
+    }
+
+    /**
+     * Removes the last element. Throws a ContainerException if the container
+     * is empty.
+     */
+    void pop_back() {
+        check_not_empty();
+        count--;
+    }
+
+    /**
+     * Resizes the container to contain count elements, value-initializing new
+     * elements.
+     */
+    void resize(size_type new_count) {
+        resize(new_count, T{});
+    }
+
+    /**
+     * Resizes the container to contain count elements, initializing new
+     * elements with value.
+     */
+    void resize(size_type new_count, const T &value) {
+        if (new_count > count) {
+            T copy = value;     // value may point into this vector
+            reserve(new_count);
+            std::fill(data() + count, data() + new_count, copy);
+        }
+        count = new_count;
+    }
+
+    /**
+     * Exchanges the contents of the container with those of other.
+     */
+    void swap(SmallVec &other) noexcept {
+        SmallVec tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+    /**
+     * Returns a string representation of the value at the given index, or
+     * `"<OUT-OF-RANGE>"` if the index is out of range. A stream << overload
+     * must exist for the value type.
+     */
+    std::string dbg(size_t index) const {
+        if (index >= count) {
+            return "<OUT-OF-RANGE>";
+        }
+        return utils::to_string(data()[index]);
+    }
+
+    /**
+     * Returns a string representation of the entire contents of the vector,
+     * in the same format as Vec::to_string().
+     */
+    std::string to_string(
+        const std::string &prefix = "[",
+        const std::string &separator = ", ",
+        const std::string &suffix = "]",
+        const std::string &last_separator = "",
+        const std::string &only_separator = ""
+    ) const {
+        std::ostringstream ss{};
+        ss << prefix;
+        for (size_type i = 0; i < count; i++) {
+            if (i > 0) {
+                if (i == count - 1) {
+                    if (i == 1) {
+                        ss << (only_separator.empty() ? separator : only_separator);
+                    } else {
+                        ss << (last_separator.empty() ? separator : last_separator);
+                    }
+                } else {
+                    ss << separator;
+                }
+            }
+            ss << data()[i];
+        }
+        ss << suffix;
+        return ss.str();
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are equal.
+     */
+    friend bool operator==(const SmallVec &lhs, const SmallVec &rhs) {
+        return lhs.count == rhs.count && std::equal(lhs.cbegin(), lhs.cend(), rhs.cbegin());
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are not equal.
+     */
+    friend bool operator!=(const SmallVec &lhs, const SmallVec &rhs) {
+        return !(lhs == rhs);
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are equal.
+     */
+    friend bool operator==(const SmallVec &lhs, const Vec<T> &rhs) {
+        return lhs.size() == rhs.size() && std::equal(lhs.cbegin(), lhs.cend(), rhs.begin());
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are equal.
+     */
+    friend bool operator==(const Vec<T> &lhs, const SmallVec &rhs) {
+        return rhs == lhs;
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are not equal.
+     */
+    friend bool operator!=(const SmallVec &lhs, const Vec<T> &rhs) {
+        return !(lhs == rhs);
+    }
+
+    /**
+     * Checks if the contents of lhs and rhs are not equal.
+     */
+    friend bool operator!=(const Vec<T> &lhs, const SmallVec &rhs) {
+        return !(rhs == lhs);
+    }
+
+    /**
+     * Compares the contents of lhs and rhs lexicographically.
+     */
+    friend bool operator<(const SmallVec &lhs, const SmallVec &rhs) {
+        return std::lexicographical_compare(lhs.cbegin(), lhs.cend(), rhs.cbegin(), rhs.cend());
+    }
+
+private:
+
+    /**
+     * Takes over the contents of other, leaving other empty. Any storage of
+     * this vector must already have been released.
+     */
+    void steal(SmallVec &other) {
+        count = other.count;
+        cap = other.cap;
+        if (other.on_heap()) {
+            heap_data = other.heap_data;
+        } else {
+            std::memcpy(inline_data, other.inline_data, count * sizeof(T));
+        }
+        other.count = 0;
+        other.cap = N;
+    }
+
+};
+
+/**
+ * Stream << overload for SmallVec<>.
+ */
+template <typename T, std::size_t N>
+std::ostream &operator<<(std::ostream &os, const ::ql::utils::SmallVec<T, N> &vec) {
+    os << vec.to_string();
+    return os;
+}
+
+} // namespace utils
+} // namespace ql
@@ -63,6 +63,26 @@ Str to_string(T arg) {
     return ss.str();
 }
 
+/**
+ * Appends the decimal representation of the given unsigned integer to buf.
+ * This is equivalent to buf += to_string(value), but doesn't go through a
+ * stream or allocate a temporary string.
+ */
+void append_uint(Str &buf, UInt value);
+
+/**
+ * Appends the decimal representation of the given signed integer to buf.
+ * This is equivalent to buf += to_string(value), but doesn't go through a
+ * stream or allocate a temporary string.
+ */
+void append_int(Str &buf, Int value);
+
+/**
+ * Appends the given real number to buf, formatted the same way as
+ * to_string(value), i.e. with six significant digits.
+ */
+void append_real(Str &buf, Real value);
+
 /**
  * Parses the given string as an unsigned integer. Throws an exception if the
  * conversion fails.
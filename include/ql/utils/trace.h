@@ -0,0 +1,149 @@
+/** \file
+ * Lightweight tracing of compiler phases for external profilers.
+ *
+ * Code is instrumented using QL_TRACE_SCOPE("name"), which records a span
+ * from the statement to the end of the enclosing scope. Unless OpenQL is
+ * built with the OPENQL_TRACE CMake option (which defines QL_TRACE in
+ * ql/config.h), the macro expands to nothing. Otherwise, spans are only
+ * recorded once tracing is enabled at runtime, either via enable() or by
+ * setting the OPENQL_TRACE environment variable to one of the following:
+ *
+ *  - a filename: spans are collected in memory and written as Chrome trace
+ *    event JSON when tracing is disabled or the process exits. The file can
+ *    be loaded in chrome://tracing and in the Perfetto UI;
+ *  - "marker": spans are written to the ftrace marker file as they begin and
+ *    end, in the format understood by Perfetto and systrace, so they appear
+ *    alongside samples taken with perf record -e ftrace:print;
+ *  - "itt": spans are reported as tasks via the Intel ITT API for VTune.
+ *    Only available when OpenQL is additionally built with OPENQL_TRACE_ITT.
+ */
+
+#pragma once
+
+#include "ql/config.h"
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+
+namespace ql {
+namespace utils {
+namespace trace {
+
+/**
+ * The available tracing backends.
+ */
+enum class Backend {
+
+    /**
+     * Tracing is disabled.
+     */
+    NONE,
+
+    /**
+     * Spans are collected and written as Chrome trace event JSON.
+     */
+    CHROME,
+
+    /**
+     * Spans are written to the ftrace marker file.
+     */
+    MARKER,
+
+    /**
+     * Spans are reported via the Intel ITT API.
+     */
+    ITT
+
+};
+
+/**
+ * Enables tracing using the given backend specification, as described in the
+ * file documentation. Any active trace is disabled first. An empty string
+ * disables tracing. Throws an exception if the backend is not available in
+ * this build.
+ */
+void enable(const Str &spec);
+
+/**
+ * Disables tracing, writing out the collected spans if the backend requires
+ * this.
+ */
+void disable();
+
+/**
+ * Returns whether spans are currently being recorded.
+ */
+Bool is_enabled();
+
+#ifdef QL_TRACE
+
+/**
+ * RAII object recording a span for its lifetime. Use QL_TRACE_SCOPE() rather
+ * than constructing this directly.
+ */
+class Scope {
+private:
+
+    /**
+     * The name of the span, if it was constructed from a literal.
+     */
+    const char *literal;
+
+    /**
+     * The name of the span, if it was constructed from a string.
+     */
+    Str name;
+
+    /**
+     * The backend that was active when the span was started, which is the
+     * one it will be reported to.
+     */
+    Backend backend;
+
+    /**
+     * Start time of the span in microseconds.
+     */
+    Real start_us;
+
+    /**
+     * Starts the span.
+     */
+    void begin();
+
+public:
+
+    /**
+     * Starts a span with the given name, which must outlive the span (i.e.,
+     * should be a string literal).
+     */
+    explicit Scope(const char *literal);
+
+    /**
+     * Starts a span with the given name. The name is only copied if tracing
+     * is enabled.
+     */
+    explicit Scope(const Str &name);
+
+    /**
+     * Ends the span.
+     */
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+};
+
+#endif
+
+} // namespace trace
+} // namespace utils
+} // namespace ql
+
+#ifdef QL_TRACE
+#define QL_TRACE_CONCAT_INNER(a, b) a##b
+#define QL_TRACE_CONCAT(a, b) QL_TRACE_CONCAT_INNER(a, b)
+#define QL_TRACE_SCOPE(name) \
+    ::ql::utils::trace::Scope QL_TRACE_CONCAT(ql_trace_scope_, __LINE__){name}
+#else
+#define QL_TRACE_SCOPE(name) do {} while (0)
+#endif
@@ -8,6 +8,8 @@
 // Include the snippets from tree-gen.
 #include "ql/utils/tree-config.inc"
 #include "tree-all.hpp.inc"
+#include "ql/utils/arena.h"
+#include "ql/utils/accounting.h"
 
 namespace ql {
 namespace utils {
@@ -90,10 +92,24 @@ template <class T>
 using Link = tree::base::Link<T>;
 
 /**
- * Constructs a One or Maybe object, analogous to std::make_shared.
+ * Constructs a One or Maybe object, analogous to std::make_shared. If an arena
+ * is active in the current thread (see UseArena), the object is allocated from
+ * it, otherwise it is allocated on the heap. While allocation accounting is
+ * enabled (see AccountAllocations), the allocation is counted.
  */
 template <class T, typename... Args>
 One<T> make(Args&&... args) {
+    const auto &arena = Arena::get_active();
+    if (AllocationAccounting::is_enabled()) {
+        return One<T>(std::allocate_shared<T>(
+            CountingAllocator<T>(arena), std::forward<Args>(args)...
+        ));
+    }
+    if (arena.has_value()) {
+        return One<T>(std::allocate_shared<T>(
+            ArenaAllocator<T>(arena), std::forward<Args>(args)...
+        ));
+    }
     return One<T>(std::make_shared<T>(std::forward<Args>(args)...));
 }
 
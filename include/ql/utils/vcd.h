@@ -8,40 +8,59 @@
 
 #pragma once
 
+#include <ostream>
+#include <unordered_map>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
+#include "ql/utils/vec.h"
 #include "ql/utils/map.h"
 
 namespace ql {
 namespace utils {
 
+/**
+ * Streaming VCD writer. The header is written to the stream as it is
+ * defined. Value changes may arrive out of timestamp order, so they are
+ * buffered and sorted until flush() promises that no changes before a given
+ * timestamp will follow; only the window between the flushed timestamp and the
+ * latest change is kept in memory. Change values are interned, such that
+ * repeated values (gate names, codewords) are only stored once.
+ */
 class Vcd {
 public:
     enum class VarType { INT, STRING };
     enum class Scope { MODULE };
 
 public:
-    void start();
+    void start(std::ostream &os);
     void scope(Scope type, const Str &name);
     int registerVar(const Str &name, VarType type, Scope scope=Scope::MODULE);
     void upscope();
     void change(Int var, Int timestamp, const Str &value);
     void change(Int var, Int timestamp, Int value);
+    void flush(Int timestamp);                  // write all changes before timestamp
     void finish();
-    Str getVcd();
+
+public:
+    typedef UInt ValueId;                       // interned value, index into values
+    ValueId intern(const Str &value);
+    void changeInterned(Int var, Int timestamp, ValueId value);
 
 private:
-    struct Value {
-        Int intVal;
-        Str strVal;
-    };
-    typedef Map<Int, Value> VarChangeMap;        // map variable 'id' to 'tValue'
+    typedef Map<Int, ValueId> VarChangeMap;     // map variable 'id' to value
     typedef Map<Int, VarChangeMap> TimestampMap; // map 'timestamp' to variables
 
 private:
-    Int lastId;
-    TimestampMap timestampMap;
-    StrStrm vcd;
+    void endDefinitions();
+
+private:
+    std::ostream *vcd = nullptr;
+    Int lastId = 0;
+    Bool definitionsEnded = false;
+    Int flushedUntil = MIN;                     // no changes before this timestamp are accepted anymore
+    TimestampMap timestampMap;                  // pending changes, all at or after flushedUntil
+    Vec<Str> values;
+    std::unordered_map<Str, ValueId> valueIds;
 };
 
 } // namespace utils
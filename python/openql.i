@@ -7,7 +7,12 @@
 "`OpenQL` is a C++/Python framework for high-level quantum programming. The framework provides a compiler for compiling and optimizing quantum code. The compiler produces the intermediate quantum assembly language in cQASM (Common QASM) and the compiled eQASM (executable QASM) for various target platforms. While the eQASM is platform-specific, the quantum assembly code (QASM) is hardware-agnostic and can be simulated on the QX simulator."
 %enddef
 
-%module(docstring=DOCSTRING) openql
+%module(docstring=DOCSTRING, threads="1") openql
+
+// Only release the GIL for the functions that are marked with %thread, i.e.
+// the ones that may take a long time and don't touch Python objects.
+%nothread;
+
 %feature("autodoc", "1");
 
 %include "std_vector.i"
@@ -22,7 +27,9 @@ namespace std {
    %template(vectorf) vector<float>;
    %template(vectord) vector<double>;
    %template(vectorc) vector<std::complex<double>>;
+   %template(vectors) vector<std::string>;
    %template(mapss) map<std::string, std::string>;
+   %template(mapsd) map<std::string, double>;
 };
 
 %{
@@ -55,9 +62,13 @@ namespace std {
 %include "ql/api/operation.i"
 %include "ql/api/unitary.i"
 %include "ql/api/kernel.i"
+%include "ql/api/compile_job.i"
+%include "ql/api/schedule.i"
 %include "ql/api/program.i"
 %include "ql/api/cqasm_reader.i"
 
 namespace std {
     %template(vectorp) vector<ql::api::Pass>;
+    %template(vectorprog) vector<ql::api::Program>;
+    %template(vectork) vector<ql::api::Kernel>;
 };
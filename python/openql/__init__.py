@@ -35,6 +35,7 @@ __all__ = [
     'initialize',
     'ensure_initialized',
     'compile',
+    'compile_in_memory',
     'get_version',
     'set_option',
     'get_option',
@@ -52,6 +53,8 @@ __all__ = [
     'dump_compiler_docs',
     'Platform',
     'Program',
+    'CompileJob',
+    'Schedule',
     'Kernel',
     'CReg',
     'Operation',
@@ -77,6 +80,7 @@ def _fixup_swig_autodoc_type(typ):
         'mapss': 'Dict[str, str]',
         'vectorp': 'List[Pass]',
         'vectorui': 'List[int]',
+        'vectors': 'List[str]',
         'vectord': 'List[float]'
     }.get(typ, typ)
     return typ
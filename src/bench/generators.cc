@@ -0,0 +1,407 @@
+/** \file
+ * Generators for the synthetic platforms and programs used by ql_bench.
+ */
+
+#include "generators.h"
+
+#include <cmath>
+#include <random>
+#include "ql/utils/pair.h"
+#include "ql/utils/json.h"
+#include "ql/utils/exception.h"
+#include "ql/arch/factory.h"
+#include "ql/arch/architecture.h"
+
+namespace bench {
+
+using namespace ql;
+
+/**
+ * The single-qubit gates used for the generated circuits, besides the X90 and
+ * Y90 gates of the target. All of these exist in each default platform.
+ */
+static const utils::Vec<utils::Str> SINGLE_QUBIT_GATES = {
+    "x", "y", "z", "h", "s", "t"
+};
+
+/**
+ * Returns the default platform configuration for the given family.
+ */
+static utils::Json default_config(const utils::Str &family) {
+    return utils::parse_json(
+        arch::Factory().build_from_namespace(family)->get_default_platform()
+    );
+}
+
+/**
+ * Returns the width of the smallest square-ish grid with at least num_qubits
+ * qubits.
+ */
+static utils::UInt grid_width(utils::UInt num_qubits) {
+    auto width = (utils::UInt)std::ceil(std::sqrt((utils::Real)num_qubits));
+    return utils::max<utils::UInt>(1, width);
+}
+
+/**
+ * Builds a variant of the default cc_light platform with a width x height
+ * grid of nearest-neighbor-connected qubits and no resources, for the mapper
+ * benchmarks.
+ */
+ir::compat::PlatformRef grid_platform(utils::UInt width, utils::UInt height) {
+    auto config = default_config("cc_light");
+    auto num_qubits = width * height;
+    config["hardware_settings"]["qubit_number"] = num_qubits;
+
+    utils::Json qubits = utils::Json::array();
+    utils::Json edges = utils::Json::array();
+    auto add_edge = [&edges](utils::UInt src, utils::UInt dst) {
+        edges.push_back({{"id", edges.size()}, {"src", src}, {"dst", dst}});
+        edges.push_back({{"id", edges.size()}, {"src", dst}, {"dst", src}});
+    };
+    for (utils::UInt y = 0; y < height; y++) {
+        for (utils::UInt x = 0; x < width; x++) {
+            auto q = y * width + x;
+            qubits.push_back({{"id", q}, {"x", x}, {"y", y}});
+            if (x + 1 < width) add_edge(q, q + 1);
+            if (y + 1 < height) add_edge(q, q + width);
+        }
+    }
+    config["topology"] = {
+        {"form", "xy"},
+        {"x_size", width},
+        {"y_size", height},
+        {"qubits", qubits},
+        {"connectivity", "specified"},
+        {"edges", edges}
+    };
+    config["resources"] = utils::Json::object();
+    config["gate_decomposition"]["swap %0,%1"] = {"cnot %0,%1", "cnot %1,%0", "cnot %0,%1"};
+
+    return ir::compat::Platform::build(
+        "grid" + utils::to_string(width) + "x" + utils::to_string(height),
+        config
+    );
+}
+
+/**
+ * Builds a target for the given platform family and number of qubits.
+ */
+Target build_target(
+    const utils::Str &family,
+    utils::UInt num_qubits,
+    utils::UInt num_cores
+) {
+    Target target;
+    if (family == "cc_light") {
+        if (!num_qubits || num_qubits == 7) {
+            target.platform = ir::compat::Platform::build("cc_light", family);
+        } else {
+            auto width = grid_width(num_qubits);
+            target.platform = grid_platform(width, (num_qubits + width - 1) / width);
+        }
+        target.prep = "prepz";
+        target.x90 = "rx90";
+        target.y90 = "ry90";
+    } else if (family == "cc") {
+        target.platform = ir::compat::Platform::build("cc", family);
+        if (num_qubits > target.platform->qubit_count) {
+            throw utils::Exception(
+                "the cc platform only has " +
+                utils::to_string(target.platform->qubit_count) + " qubits"
+            );
+        }
+        target.prep = "prepz";
+        target.x90 = "rx90";
+        target.y90 = "ry90";
+    } else if (family == "none") {
+        auto config = default_config("none");
+        if (!num_qubits) {
+            num_qubits = config["hardware_settings"]["qubit_number"].get<utils::UInt>();
+        }
+        num_cores = utils::max<utils::UInt>(1, num_cores);
+        num_qubits = (num_qubits + num_cores - 1) / num_cores * num_cores;
+        config["hardware_settings"]["qubit_number"] = num_qubits;
+        config["topology"] = {
+            {"number_of_cores", num_cores},
+            {"connectivity", "full"}
+        };
+        target.platform = ir::compat::Platform::build(
+            "none" + utils::to_string(num_cores) + "x" + utils::to_string(num_qubits / num_cores),
+            config
+        );
+        target.prep = "prep_z";
+        target.x90 = "x90";
+        target.y90 = "y90";
+    } else {
+        throw utils::Exception("unknown platform family " + family);
+    }
+    return target;
+}
+
+/**
+ * Constructs a program spanning all qubits of the target.
+ */
+static ir::compat::ProgramRef make_program(const Target &target, const utils::Str &name) {
+    auto num_qubits = target.platform->qubit_count;
+    return utils::make<ir::compat::Program>(name, target.platform, num_qubits, num_qubits, 0);
+}
+
+/**
+ * Constructs a kernel spanning all qubits of the target.
+ */
+static ir::compat::KernelRef make_kernel(const Target &target, const utils::Str &name) {
+    auto num_qubits = target.platform->qubit_count;
+    return utils::make<ir::compat::Kernel>(name, target.platform, num_qubits, num_qubits, 0);
+}
+
+/**
+ * Builds a program with a single kernel of num_gates random gates, of which
+ * roughly one in three is a CNOT between two random distinct qubits.
+ */
+ir::compat::ProgramRef random_program(
+    const Target &target,
+    utils::UInt num_gates,
+    utils::UInt seed
+) {
+    auto num_qubits = target.platform->qubit_count;
+    auto program = make_program(target, "bench");
+    auto kernel = make_kernel(target, "bench");
+    utils::Vec<utils::Str> gates = SINGLE_QUBIT_GATES;
+    gates.push_back(target.x90);
+    gates.push_back(target.y90);
+    std::mt19937_64 rng{seed};
+    std::uniform_int_distribution<utils::UInt> qubit_dist{0, num_qubits - 1};
+    std::uniform_int_distribution<utils::UInt> gate_dist{0, gates.size() + 3};
+    for (utils::UInt i = 0; i < num_gates; i++) {
+        auto gate = gate_dist(rng);
+        auto q0 = qubit_dist(rng);
+        if (gate < gates.size()) {
+            kernel->gate(gates[gate], q0);
+        } else if (num_qubits > 1) {
+            auto q1 = qubit_dist(rng);
+            while (q1 == q0) {
+                q1 = qubit_dist(rng);
+            }
+            kernel->gate("cnot", q0, q1);
+        }
+    }
+    program->add(kernel);
+    return program;
+}
+
+/**
+ * Appends a controlled phase gate to the kernel. The rotation angle is not
+ * modelled; the CNOT-T-CNOT sequence has the structure of the usual CNOT-Rz
+ * decomposition.
+ */
+static void controlled_phase(const ir::compat::KernelRef &kernel, utils::UInt control, utils::UInt target) {
+    kernel->gate("t", control);
+    kernel->gate("cnot", control, target);
+    kernel->gate("tdag", target);
+    kernel->gate("cnot", control, target);
+    kernel->gate("t", target);
+}
+
+/**
+ * Generates the quantum Fourier transform over all qubits, applied
+ * repetitions times, including the final qubit reversal.
+ */
+static ir::compat::ProgramRef qft_program(const Target &target, utils::UInt repetitions) {
+    auto num_qubits = target.platform->qubit_count;
+    auto program = make_program(target, "qft");
+    auto kernel = make_kernel(target, "qft");
+    for (utils::UInt r = 0; r < repetitions; r++) {
+        for (utils::UInt i = 0; i < num_qubits; i++) {
+            kernel->gate("h", i);
+            for (utils::UInt j = i + 1; j < num_qubits; j++) {
+                controlled_phase(kernel, j, i);
+            }
+        }
+        for (utils::UInt i = 0; i < num_qubits / 2; i++) {
+            auto j = num_qubits - 1 - i;
+            kernel->gate("cnot", i, j);
+            kernel->gate("cnot", j, i);
+            kernel->gate("cnot", i, j);
+        }
+    }
+    for (utils::UInt i = 0; i < num_qubits; i++) {
+        kernel->measure(i);
+    }
+    program->add(kernel);
+    return program;
+}
+
+/**
+ * Generates a QAOA (MaxCut) circuit with the given number of layers for the
+ * nearest-neighbor graph of a square-ish grid over all qubits.
+ */
+static ir::compat::ProgramRef qaoa_program(const Target &target, utils::UInt layers) {
+    auto num_qubits = target.platform->qubit_count;
+    auto width = grid_width(num_qubits);
+    utils::Vec<utils::Pair<utils::UInt, utils::UInt>> edges;
+    for (utils::UInt q = 0; q < num_qubits; q++) {
+        if ((q + 1) % width && q + 1 < num_qubits) edges.push_back({q, q + 1});
+        if (q + width < num_qubits) edges.push_back({q, q + width});
+    }
+
+    auto program = make_program(target, "qaoa");
+    auto kernel = make_kernel(target, "qaoa");
+    for (utils::UInt q = 0; q < num_qubits; q++) {
+        kernel->gate("h", q);
+    }
+    for (utils::UInt l = 0; l < layers; l++) {
+        for (const auto &edge : edges) {
+            kernel->gate("cnot", edge.first, edge.second);
+            kernel->gate("t", edge.second);
+            kernel->gate("cnot", edge.first, edge.second);
+        }
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            kernel->gate(target.x90, q);
+        }
+    }
+    for (utils::UInt q = 0; q < num_qubits; q++) {
+        kernel->measure(q);
+    }
+    program->add(kernel);
+    return program;
+}
+
+/**
+ * Generates the given number of stabilizer measurement rounds for the
+ * largest odd-distance rotated surface code that fits in the target. Data
+ * qubit (row, col) is mapped to row * d + col, the d * d - 1 ancillas follow
+ * the data qubits.
+ */
+static ir::compat::ProgramRef surface_program(const Target &target, utils::UInt rounds) {
+    auto num_qubits = target.platform->qubit_count;
+    utils::UInt d = 0;
+    for (utils::UInt c = 3; 2 * c * c - 1 <= num_qubits; c += 2) {
+        d = c;
+    }
+    if (!d) {
+        throw utils::Exception(
+            "the surface workload needs at least 17 qubits, the platform has " +
+            utils::to_string(num_qubits)
+        );
+    }
+
+    // Build the stabilizers as (is_x, data qubits) pairs. Face (r, c) touches
+    // the data qubits at the corners (r - 1, c - 1) to (r, c) that exist. The
+    // interior faces alternate between X and Z, the top and bottom boundary
+    // faces are X, and the left and right boundary faces are Z. The data
+    // qubits are listed in the order in which the CNOTs are applied.
+    utils::Vec<utils::Pair<utils::Bool, utils::Vec<utils::UInt>>> faces;
+    for (utils::UInt r = 0; r <= d; r++) {
+        for (utils::UInt c = 0; c <= d; c++) {
+            utils::Bool is_x = (r + c) % 2 == 0;
+            utils::Bool interior = r > 0 && r < d && c > 0 && c < d;
+            utils::Bool x_boundary = (r == 0 || r == d) && c > 0 && c < d;
+            utils::Bool z_boundary = (c == 0 || c == d) && r > 0 && r < d;
+            if (!interior && !(x_boundary && is_x) && !(z_boundary && !is_x)) {
+                continue;
+            }
+            utils::Vec<utils::UInt> data;
+            auto add = [&](utils::UInt dr, utils::UInt dc) {
+                if (r + dr >= 1 && r + dr <= d && c + dc >= 1 && c + dc <= d) {
+                    data.push_back((r + dr - 1) * d + (c + dc - 1));
+                }
+            };
+            if (is_x) {
+                add(0, 0); add(0, 1); add(1, 0); add(1, 1);
+            } else {
+                add(0, 0); add(1, 0); add(0, 1); add(1, 1);
+            }
+            faces.push_back({is_x, data});
+        }
+    }
+    QL_ASSERT(faces.size() == d * d - 1);
+
+    auto program = make_program(target, "surface");
+    auto kernel = make_kernel(target, "surface");
+    for (utils::UInt q = 0; q < d * d; q++) {
+        kernel->gate(target.prep, q);
+    }
+    for (utils::UInt round = 0; round < rounds; round++) {
+        for (utils::UInt f = 0; f < faces.size(); f++) {
+            auto ancilla = d * d + f;
+            kernel->gate(target.prep, ancilla);
+            if (faces[f].first) {
+                kernel->gate("h", ancilla);
+                for (auto q : faces[f].second) {
+                    kernel->gate("cnot", ancilla, q);
+                }
+                kernel->gate("h", ancilla);
+            } else {
+                for (auto q : faces[f].second) {
+                    kernel->gate("cnot", q, ancilla);
+                }
+            }
+            kernel->measure(ancilla);
+        }
+    }
+    program->add(kernel);
+    return program;
+}
+
+/**
+ * Generates an AllXY-like calibration sequence with the given number of
+ * kernels. Each kernel prepares all qubits, applies a pair of rotations to
+ * them, and measures them.
+ */
+static ir::compat::ProgramRef calibration_program(const Target &target, utils::UInt repetitions) {
+    auto num_qubits = target.platform->qubit_count;
+    utils::Vec<utils::Str> rotations = {"x", "y", target.x90, target.y90};
+    auto program = make_program(target, "calibration");
+    for (utils::UInt r = 0; r < repetitions; r++) {
+        auto pair = r % (rotations.size() * rotations.size());
+        auto kernel = make_kernel(target, "calibration_" + utils::to_string(r));
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            kernel->gate(target.prep, q);
+        }
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            kernel->gate(rotations[pair / rotations.size()], q);
+            kernel->gate(rotations[pair % rotations.size()], q);
+        }
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            kernel->measure(q);
+        }
+        program->add(kernel);
+    }
+    return program;
+}
+
+/**
+ * Returns the names of the workloads supported by generate_program().
+ */
+const utils::Vec<utils::Str> &get_workloads() {
+    static const utils::Vec<utils::Str> WORKLOADS = {
+        "random", "qft", "qaoa", "surface", "calibration"
+    };
+    return WORKLOADS;
+}
+
+/**
+ * Generates a program for the given workload, using all qubits of the
+ * target.
+ */
+ir::compat::ProgramRef generate_program(
+    const Target &target,
+    const utils::Str &workload,
+    utils::UInt size,
+    utils::UInt seed
+) {
+    if (workload == "random") {
+        return random_program(target, size, seed);
+    } else if (workload == "qft") {
+        return qft_program(target, size);
+    } else if (workload == "qaoa") {
+        return qaoa_program(target, size);
+    } else if (workload == "surface") {
+        return surface_program(target, size);
+    } else if (workload == "calibration") {
+        return calibration_program(target, size);
+    }
+    throw utils::Exception("unknown workload " + workload);
+}
+
+} // namespace bench
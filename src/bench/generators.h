@@ -0,0 +1,105 @@
+/** \file
+ * Generators for the synthetic platforms and programs used by ql_bench.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/ir/compat/compat.h"
+
+namespace bench {
+
+/**
+ * A platform to generate programs for, along with the names of the gates
+ * that differ between the default platforms.
+ */
+struct Target {
+
+    /**
+     * The platform.
+     */
+    ql::ir::compat::PlatformRef platform;
+
+    /**
+     * Name of the gate that prepares a qubit in the Z basis.
+     */
+    ql::utils::Str prep;
+
+    /**
+     * Name of the 90-degree X rotation gate.
+     */
+    ql::utils::Str x90;
+
+    /**
+     * Name of the 90-degree Y rotation gate.
+     */
+    ql::utils::Str y90;
+
+};
+
+/**
+ * Builds a variant of the default cc_light platform with a width x height
+ * grid of nearest-neighbor-connected qubits and no resources, for the mapper
+ * benchmarks.
+ */
+ql::ir::compat::PlatformRef grid_platform(ql::utils::UInt width, ql::utils::UInt height);
+
+/**
+ * Builds a target for the given platform family and number of qubits:
+ *
+ *  - "cc_light": the default cc_light platform if num_qubits is 0 or 7,
+ *    otherwise the smallest square-ish grid platform with at least
+ *    num_qubits qubits (see grid_platform());
+ *  - "cc": the default cc platform, which has 5 qubits; num_qubits must not
+ *    exceed that;
+ *  - "none": the default none platform with num_qubits qubits (rounded up to
+ *    a multiple of num_cores), split into num_cores fully-connected cores.
+ */
+Target build_target(
+    const ql::utils::Str &family,
+    ql::utils::UInt num_qubits,
+    ql::utils::UInt num_cores = 1
+);
+
+/**
+ * Builds a program with a single kernel of num_gates random gates, of which
+ * roughly one in three is a CNOT between two random distinct qubits.
+ */
+ql::ir::compat::ProgramRef random_program(
+    const Target &target,
+    ql::utils::UInt num_gates,
+    ql::utils::UInt seed
+);
+
+/**
+ * Returns the names of the workloads supported by generate_program().
+ */
+const ql::utils::Vec<ql::utils::Str> &get_workloads();
+
+/**
+ * Generates a program for the given workload, using all qubits of the
+ * target. The meaning of size depends on the workload:
+ *
+ *  - "random": the number of gates (see random_program());
+ *  - "qft": the number of times the QFT is applied;
+ *  - "qaoa": the number of QAOA layers on the nearest-neighbor graph of a
+ *    square-ish grid;
+ *  - "surface": the number of stabilizer measurement rounds of the largest
+ *    odd-distance rotated surface code that fits;
+ *  - "calibration": the number of kernels of an AllXY-like calibration
+ *    sequence.
+ *
+ * Rotation angles are not modelled; the QFT and QAOA phases are replaced by
+ * T gates, so the generated programs only have the structure and gate count
+ * of the real algorithms.
+ */
+ql::ir::compat::ProgramRef generate_program(
+    const Target &target,
+    const ql::utils::Str &workload,
+    ql::utils::UInt size,
+    ql::utils::UInt seed
+);
+
+} // namespace bench
@@ -0,0 +1,849 @@
+/** \file
+ * Microbenchmarks for the core compiler kernels and a scaling benchmark for
+ * the full compiler, built as ql_bench when the OPENQL_BUILD_BENCHMARKS CMake
+ * option is enabled.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/json.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/exception.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/map.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/new_to_old.h"
+#include "ql/ir/cqasm/read.h"
+#include "ql/ir/cqasm/write.h"
+#include "ql/com/ddg/build.h"
+#include "ql/com/ddg/ops.h"
+#include "ql/com/ddg/compact.h"
+#include "ql/com/sch/scheduler.h"
+#include "ql/com/sch/heuristics.h"
+#include "ql/rmgr/manager.h"
+#include "ql/com/options.h"
+#include "ql/com/ana/metrics.h"
+#include "ql/pmgr/manager.h"
+#include "ql/pass/map/qubits/map/detail/mapper.h"
+#include "generators.h"
+
+using namespace ql;
+
+/**
+ * Command-line options for the benchmark runner.
+ */
+struct BenchOptions {
+
+    /**
+     * Only benchmarks whose name contains this substring are run.
+     */
+    utils::Str filter;
+
+    /**
+     * The number of timed iterations per benchmark.
+     */
+    utils::UInt repeat = 5;
+
+    /**
+     * Seed for the random circuit generator. Every benchmark reseeds the
+     * generator with this, so the circuits do not depend on which benchmarks
+     * are selected.
+     */
+    utils::UInt seed = 1;
+
+    /**
+     * Factor applied to the number of gates of the generated circuits.
+     */
+    utils::Real scale = 1.0;
+
+    /**
+     * When set, the names of the benchmarks are listed instead of running
+     * them.
+     */
+    utils::Bool list = false;
+
+    /**
+     * When set, the scaling benchmark is run instead of the microbenchmarks.
+     */
+    utils::Bool scaling = false;
+
+    /**
+     * The workload to generate for the scaling benchmark, see
+     * bench::generate_program().
+     */
+    utils::Str workload = "random";
+
+    /**
+     * The platform family to compile for in the scaling benchmark, see
+     * bench::build_target().
+     */
+    utils::Str family = "cc_light";
+
+    /**
+     * The qubit counts to run the scaling benchmark for. 0 means the qubit
+     * count of the default platform.
+     */
+    utils::Vec<utils::UInt> qubits = {0};
+
+    /**
+     * The workload sizes to run the scaling benchmark for.
+     */
+    utils::Vec<utils::UInt> sizes = {100};
+
+    /**
+     * The number of cores for the none platform family.
+     */
+    utils::UInt cores = 4;
+
+    /**
+     * Global options to set before compiling in the scaling benchmark, in
+     * addition to the defaults set by run_scaling().
+     */
+    utils::Vec<utils::Pair<utils::Str, utils::Str>> settings;
+
+    /**
+     * Optional compiler configuration JSON file used instead of the default
+     * strategy in the scaling benchmark.
+     */
+    utils::Str strategy;
+
+    /**
+     * Output directory for the compiler in the scaling benchmark.
+     */
+    utils::Str output_dir = "bench_output";
+
+    /**
+     * Optional baseline file to compare the results with.
+     */
+    utils::Str baseline;
+
+    /**
+     * Optional file to write the results to, for use as a baseline later.
+     */
+    utils::Str save_baseline;
+
+    /**
+     * Relative increase of a metric over its baseline value beyond which it
+     * is considered a regression.
+     */
+    utils::Real threshold = 0.2;
+
+};
+
+/**
+ * Returns the peak resident set size of the process in bytes, or 0 if this
+ * is not supported.
+ */
+static utils::Int get_peak_rss() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+#ifdef __APPLE__
+        return (utils::Int)usage.ru_maxrss;
+#else
+        return (utils::Int)usage.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Returns the number of bytes currently allocated on the heap, or 0 if this
+ * is not supported.
+ */
+static utils::Int get_heap_usage() {
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+    auto mi = mallinfo2();
+#else
+    auto mi = mallinfo();
+#endif
+    return (utils::Int)mi.uordblks + (utils::Int)mi.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * Returns the median of the given values, sorting them in the process.
+ */
+template <typename T>
+static T median(utils::Vec<T> &values) {
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+/**
+ * Runs benchmarks and writes one JSON object per benchmark to the output
+ * stream. The results are also kept, to compare them with a baseline
+ * afterwards.
+ */
+class Runner {
+private:
+
+    /**
+     * The options we're running with.
+     */
+    const BenchOptions &options;
+
+    /**
+     * The stream to write the results to.
+     */
+    std::ostream &os;
+
+    /**
+     * The results reported thus far.
+     */
+    utils::Vec<utils::Json> results;
+
+public:
+
+    Runner(const BenchOptions &options, std::ostream &os) : options(options), os(os) {}
+
+    /**
+     * Writes the given result object and keeps it.
+     */
+    void report(const utils::Json &result) {
+        os << result.dump() << std::endl;
+        results.push_back(result);
+    }
+
+    /**
+     * Returns the results reported thus far.
+     */
+    const utils::Vec<utils::Json> &get_results() const {
+        return results;
+    }
+
+    /**
+     * Runs the given benchmark, unless it is filtered out. setup is called
+     * before every iteration and is not timed; body is timed, and the net
+     * amount of heap memory it allocates is recorded as well. One untimed
+     * warm-up iteration precedes the timed iterations.
+     */
+    void run(
+        const utils::Str &name,
+        const utils::Json &params,
+        const std::function<void()> &setup,
+        const std::function<void()> &body
+    ) {
+        if (name.find(options.filter) == utils::Str::npos) {
+            return;
+        }
+        if (options.list) {
+            os << name << " " << params.dump() << std::endl;
+            return;
+        }
+
+        utils::Vec<utils::Real> times;
+        utils::Vec<utils::Int> heap;
+        for (utils::UInt i = 0; i <= options.repeat; i++) {
+            setup();
+            auto heap_before = get_heap_usage();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (i) {
+                times.push_back(elapsed.count());
+                heap.push_back(get_heap_usage() - heap_before);
+            }
+        }
+        utils::Real total = 0.0;
+        for (auto time : times) {
+            total += time;
+        }
+
+        utils::Json result = utils::Json::object();
+        result["benchmark"] = name;
+        result["params"] = params;
+        result["repeat"] = times.size();
+        if (!times.empty()) {
+            result["median"] = median(times);
+            result["min"] = times.front();
+            result["mean"] = total / times.size();
+            result["max"] = times.back();
+            result["heap"] = median(heap);
+        }
+        report(result);
+    }
+
+};
+
+/**
+ * Returns the number of gates to generate for the given base count.
+ */
+static utils::UInt scaled(const BenchOptions &options, utils::UInt num_gates) {
+    return utils::max<utils::UInt>(1, (utils::UInt)(num_gates * options.scale));
+}
+
+/**
+ * Benchmarks data dependency graph construction.
+ */
+static void bench_ddg(Runner &runner, const BenchOptions &options, const bench::Target &target) {
+    for (utils::UInt num_gates : {1000, 10000}) {
+        num_gates = scaled(options, num_gates);
+        auto ir = ir::convert_old_to_new(bench::random_program(target, num_gates, options.seed));
+        ir::BlockBaseRef block = ir->program->blocks[0];
+        runner.run(
+            "ddg.build", {{"gates", num_gates}},
+            [&]() { com::ddg::clear(block); },
+            [&]() { com::ddg::build(ir, block); }
+        );
+    }
+}
+
+/**
+ * Runs the scheduler for the given heuristic in the same way the list
+ * scheduling pass does it, without resource constraints.
+ */
+template <class Heuristic>
+static void run_scheduler(const ir::BlockBaseRef &block) {
+    utils::Ptr<com::ddg::CompactGraph> graph;
+    graph.emplace(block);
+    com::sch::Scheduler<Heuristic> scheduler(block, graph.as_const());
+    scheduler.run();
+}
+
+/**
+ * Benchmarks the list scheduler for each heuristic.
+ */
+static void bench_scheduler(Runner &runner, const BenchOptions &options, const bench::Target &target) {
+    for (utils::UInt num_gates : {1000, 10000}) {
+        num_gates = scaled(options, num_gates);
+        auto ir = ir::convert_old_to_new(bench::random_program(target, num_gates, options.seed));
+        ir::BlockBaseRef block = ir->program->blocks[0];
+        auto setup = [&]() {
+            com::ddg::clear(block);
+            com::ddg::build(ir, block);
+        };
+        auto preschedule = [&]() {
+            com::ddg::reverse(block);
+            com::sch::Scheduler<>(block).run();
+            com::ddg::reverse(block);
+        };
+        runner.run(
+            "sch.run", {{"gates", num_gates}, {"heuristic", "none"}},
+            setup,
+            [&]() { run_scheduler<com::sch::TrivialHeuristic>(block); }
+        );
+        runner.run(
+            "sch.run", {{"gates", num_gates}, {"heuristic", "critical_path"}},
+            setup,
+            [&]() {
+                preschedule();
+                run_scheduler<com::sch::CriticalPathHeuristic>(block);
+            }
+        );
+        runner.run(
+            "sch.run", {{"gates", num_gates}, {"heuristic", "deep_criticality"}},
+            setup,
+            [&]() {
+                preschedule();
+                utils::Ptr<com::ddg::CompactGraph> graph;
+                graph.emplace(block);
+                com::sch::DeepCriticality::compute(block, *graph);
+                com::sch::Scheduler<com::sch::DeepCriticality::Heuristic> scheduler(block, graph.as_const());
+                scheduler.run();
+                com::sch::DeepCriticality::clear(block);
+            }
+        );
+    }
+}
+
+/**
+ * Benchmarks the qubit mapper on random circuits for grids of various sizes.
+ */
+static void bench_mapper(Runner &runner, const BenchOptions &options) {
+    for (utils::UInt size : {3, 5, 8}) {
+        auto target = bench::build_target("cc_light", size * size);
+        const auto &platform = target.platform;
+        auto num_gates = scaled(options, 20 * platform->qubit_count);
+
+        utils::Ptr<pass::map::qubits::map::detail::Options> mapper_options;
+        mapper_options.emplace();
+        mapper_options->heuristic = pass::map::qubits::map::detail::Heuristic::MIN_EXTEND;
+        mapper_options->tie_break_method = pass::map::qubits::map::detail::TieBreakMethod::FIRST;
+        mapper_options->use_move_gates = false;
+
+        ir::compat::ProgramRef program;
+        runner.run(
+            "map.map_kernel", {{"qubits", platform->qubit_count}, {"gates", num_gates}, {"heuristic", "minextend"}},
+            [&]() { program = bench::random_program(target, num_gates, options.seed); },
+            [&]() { pass::map::qubits::map::detail::Mapper().map(program, mapper_options.as_const()); }
+        );
+    }
+}
+
+/**
+ * Benchmarks reading and writing cQASM.
+ */
+static void bench_cqasm(Runner &runner, const BenchOptions &options, const bench::Target &target) {
+    for (utils::UInt num_gates : {1000, 10000}) {
+        num_gates = scaled(options, num_gates);
+        auto ir = ir::convert_old_to_new(bench::random_program(target, num_gates, options.seed));
+        utils::Str cqasm;
+        runner.run(
+            "cqasm.write", {{"gates", num_gates}},
+            []() {},
+            [&]() {
+                std::ostringstream ss;
+                ir::cqasm::write(ir, {}, ss);
+                cqasm = ss.str();
+            }
+        );
+        if (cqasm.empty()) {
+            std::ostringstream ss;
+            ir::cqasm::write(ir, {}, ss);
+            cqasm = ss.str();
+        }
+        ir::Ref empty;
+        runner.run(
+            "cqasm.read", {{"gates", num_gates}},
+            [&]() { empty = ir::convert_old_to_new(target.platform); },
+            [&]() { ir::cqasm::read(empty, cqasm, "<bench>"); }
+        );
+    }
+}
+
+/**
+ * Benchmarks the conversions between the old and new IR.
+ */
+static void bench_convert(Runner &runner, const BenchOptions &options, const bench::Target &target) {
+    for (utils::UInt num_gates : {1000, 10000}) {
+        num_gates = scaled(options, num_gates);
+        auto program = bench::random_program(target, num_gates, options.seed);
+        ir::Ref ir;
+        runner.run(
+            "ir.convert_old_to_new", {{"gates", num_gates}},
+            []() {},
+            [&]() { ir = ir::convert_old_to_new(program); }
+        );
+        if (ir.empty()) {
+            ir = ir::convert_old_to_new(program);
+        }
+        runner.run(
+            "ir.convert_new_to_old", {{"gates", num_gates}},
+            []() {},
+            [&]() { ir::convert_new_to_old(ir); }
+        );
+    }
+}
+
+/**
+ * Benchmarks the instrument resources of the default cc_light platform, by
+ * greedily reserving random gates in program order at the earliest cycle
+ * that they are available.
+ */
+static void bench_instrument(Runner &runner, const BenchOptions &options, const bench::Target &target) {
+    auto manager = rmgr::Manager::from_defaults(target.platform);
+    for (utils::UInt num_gates : {1000, 10000}) {
+        num_gates = scaled(options, num_gates);
+        auto program = bench::random_program(target, num_gates, options.seed);
+        const auto &gates = program->kernels[0]->gates;
+        rmgr::State state;
+        runner.run(
+            "rmgr.instrument.on_gate", {{"gates", num_gates}},
+            [&]() { state = manager.build(rmgr::Direction::FORWARD); },
+            [&]() {
+                utils::UInt cycle = 0;
+                for (const auto &gate : gates) {
+                    while (!state.available(cycle, gate)) {
+                        cycle++;
+                    }
+                    state.reserve(cycle, gate);
+                }
+            }
+        );
+    }
+}
+
+/**
+ * Returns the gate counts and latency of the given program as a JSON object.
+ */
+static utils::Json get_program_stats(const ir::Ref &ir) {
+    auto metrics = com::ana::compute_program_fused<
+        com::ana::QuantumGateCount,
+        com::ana::MultiQubitGateCount,
+        com::ana::Latency
+    >(ir);
+    return {
+        {"gates", metrics.get_result<com::ana::QuantumGateCount>()},
+        {"multi_qubit_gates", metrics.get_result<com::ana::MultiQubitGateCount>()},
+        {"cycles", metrics.get_result<com::ana::Latency>()}
+    };
+}
+
+/**
+ * Compiles generated programs of increasing size with the default strategy
+ * (or the configured one) and reports one JSON object per program to the
+ * runner, with the median compile time over the iterations, the growth of the peak resident set
+ * size, the per-pass profile, and the statistics of the input and output
+ * programs.
+ */
+static void run_scaling(const BenchOptions &options, Runner &runner) {
+
+    // Run the mapper by default for cc_light, as the output quality is
+    // otherwise not very interesting. The options can still be overridden
+    // using --set.
+    if (options.family == "cc_light") {
+        com::options::set("mapper", "minextend");
+        com::options::set("mapusemoves", "no");
+    }
+    for (const auto &setting : options.settings) {
+        com::options::set(setting.first, setting.second);
+    }
+    com::options::set("output_dir", options.output_dir);
+    com::options::set("profile_passes", "yes");
+
+    for (auto num_qubits : options.qubits) {
+        auto target = bench::build_target(options.family, num_qubits, options.cores);
+        for (auto size : options.sizes) {
+            auto manager = options.strategy.empty()
+                ? pmgr::Manager::from_defaults(target.platform)
+                : pmgr::Manager::from_json(utils::load_json(options.strategy));
+
+            // Compile the program repeat times, regenerating it each time.
+            // Only the first compilation is representative for the peak
+            // memory usage, as the peak never decreases.
+            ir::Ref ir;
+            utils::Json input_stats;
+            utils::Vec<utils::Real> times;
+            utils::Int rss_before = 0;
+            utils::Int rss_after = 0;
+            for (utils::UInt i = 0; i < utils::max<utils::UInt>(1, options.repeat); i++) {
+                auto program = bench::generate_program(target, options.workload, size, options.seed);
+                ir = ir::convert_old_to_new(program);
+                input_stats = get_program_stats(ir);
+                auto rss = get_peak_rss();
+                auto start = std::chrono::steady_clock::now();
+                manager.compile(ir);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                times.push_back(elapsed.count());
+                if (!i) {
+                    rss_before = rss;
+                    rss_after = get_peak_rss();
+                }
+            }
+
+            utils::Str profile = options.output_dir + "/";
+            if (!ir->program.empty()) {
+                profile += ir->program->unique_name + "_";
+            }
+            profile += "pass_profile.json";
+
+            utils::Json result = utils::Json::object();
+            result["benchmark"] = "scaling";
+            result["params"] = {
+                {"workload", options.workload},
+                {"platform", target.platform->name},
+                {"qubits", target.platform->qubit_count},
+                {"size", size}
+            };
+            result["repeat"] = times.size();
+            result["compile_time"] = median(times);
+            result["compile_time_min"] = times.front();
+            result["peak_rss"] = rss_after;
+            result["peak_rss_delta"] = rss_after - rss_before;
+            result["input"] = input_stats;
+            result["output"] = get_program_stats(ir);
+            result["passes"] = utils::load_json(profile);
+            runner.report(result);
+        }
+    }
+}
+
+/**
+ * The metrics that are compared with the baseline. Larger is worse for all of
+ * them.
+ */
+static const utils::Vec<utils::Str> COMPARED_METRICS = {
+    "median", "heap", "compile_time", "peak_rss_delta"
+};
+
+/**
+ * Returns the key used to match results with their baseline.
+ */
+static utils::Str get_result_key(const utils::Json &result) {
+    return result["benchmark"].get<utils::Str>() + " " + result["params"].dump();
+}
+
+/**
+ * Compares the given results with the baseline results. A summary table is
+ * written to the given stream, and the number of regressions is returned. A
+ * metric regresses when its value exceeds the baseline value by more than the
+ * threshold; as the values are medians over the timed iterations, this is
+ * tolerant to occasional outliers. Results without a baseline are listed,
+ * but are never regressions.
+ */
+static utils::UInt compare_with_baseline(
+    const BenchOptions &options,
+    const utils::Vec<utils::Json> &results,
+    std::ostream &os
+) {
+    auto baseline_json = utils::load_json(options.baseline);
+    if (!baseline_json.is_array()) {
+        throw utils::Exception("baseline file " + options.baseline + " must contain a JSON array");
+    }
+    utils::Map<utils::Str, utils::Json> baseline;
+    for (const auto &result : baseline_json) {
+        baseline.set(get_result_key(result)) = result;
+    }
+
+    os << std::left << std::setw(60) << "benchmark" << " "
+       << std::setw(14) << "metric" << " "
+       << std::right << std::setw(12) << "baseline" << " "
+       << std::setw(12) << "current" << " "
+       << std::setw(8) << "change" << "  status" << std::endl;
+    utils::UInt regressions = 0;
+    for (const auto &result : results) {
+        auto key = get_result_key(result);
+        auto it = baseline.find(key);
+        for (const auto &metric : COMPARED_METRICS) {
+            if (!result.count(metric)) {
+                continue;
+            }
+            auto current = result[metric].get<utils::Real>();
+            os << std::left << std::setw(60) << key << " "
+               << std::setw(14) << metric << " " << std::right;
+            if (it == baseline.end() || !it->second.count(metric)) {
+                os << std::setw(12) << "-" << " "
+                   << std::setw(12) << current << " "
+                   << std::setw(8) << "-" << "  new" << std::endl;
+                continue;
+            }
+            auto previous = it->second[metric].get<utils::Real>();
+            os << std::setw(12) << previous << " " << std::setw(12) << current << " ";
+            if (previous <= 0.0) {
+                os << std::setw(8) << "-" << "  ok" << std::endl;
+                continue;
+            }
+            auto change = current / previous - 1.0;
+            std::ostringstream ss;
+            ss << std::fixed << std::setprecision(1) << std::showpos << change * 100.0 << "%";
+            os << std::setw(8) << ss.str();
+            if (change > options.threshold) {
+                os << "  REGRESSION" << std::endl;
+                regressions++;
+            } else if (change < -options.threshold) {
+                os << "  improved" << std::endl;
+            } else {
+                os << "  ok" << std::endl;
+            }
+        }
+    }
+    os << regressions << " regression(s) beyond " << options.threshold * 100.0 << "%" << std::endl;
+    return regressions;
+}
+
+/**
+ * Parses a comma-separated list of unsigned integers.
+ */
+static utils::Vec<utils::UInt> parse_uint_list(const utils::Str &value) {
+    utils::Vec<utils::UInt> list;
+    utils::UInt start = 0;
+    while (true) {
+        auto end = value.find(',', start);
+        list.push_back(utils::parse_uint(value.substr(start, end - start)));
+        if (end == utils::Str::npos) {
+            return list;
+        }
+        start = end + 1;
+    }
+}
+
+/**
+ * Prints usage information.
+ */
+static void usage(const char *argv0) {
+    std::cerr << "Usage: " << argv0 << " [options]\n";
+    std::cerr << "\n";
+    std::cerr << "Runs the OpenQL microbenchmarks, writing one JSON object per benchmark to\n";
+    std::cerr << "stdout. Times are in seconds.\n";
+    std::cerr << "\n";
+    std::cerr << "Options:\n";
+    std::cerr << "  --filter <str>   only run benchmarks whose name contains <str>\n";
+    std::cerr << "  --repeat <n>     number of timed iterations per benchmark (default 5)\n";
+    std::cerr << "  --seed <n>       seed for the random circuit generator (default 1)\n";
+    std::cerr << "  --scale <x>      factor for the number of gates per circuit (default 1)\n";
+    std::cerr << "  --list           list the benchmarks instead of running them\n";
+    std::cerr << "\n";
+    std::cerr << "Regression checking:\n";
+    std::cerr << "  --save-baseline <f> write the results to <f> as a JSON array\n";
+    std::cerr << "  --baseline <f>   compare the results with the baseline in <f>, print a\n";
+    std::cerr << "                   summary to stderr, and exit with code 2 if any metric\n";
+    std::cerr << "                   regressed\n";
+    std::cerr << "  --threshold <x>  relative increase considered a regression (default 0.2)\n";
+    std::cerr << "\n";
+    std::cerr << "Scaling benchmark:\n";
+    std::cerr << "  --scaling        compile generated programs with the default strategy\n";
+    std::cerr << "                   instead of running the microbenchmarks\n";
+    std::cerr << "  --workload <w>   random, qft, qaoa, surface or calibration (default random)\n";
+    std::cerr << "  --platform <p>   cc_light, cc or none (default cc_light)\n";
+    std::cerr << "  --qubits <n,..>  qubit counts to compile for (default: platform default)\n";
+    std::cerr << "  --size <n,..>    workload sizes (gates, repetitions, layers, rounds or\n";
+    std::cerr << "                   kernels, depending on the workload; default 100)\n";
+    std::cerr << "  --cores <n>      number of cores for the none platform (default 4)\n";
+    std::cerr << "  --set <k>=<v>    set global compiler option <k> to <v>\n";
+    std::cerr << "  --strategy <f>   use compiler configuration file <f> instead of the\n";
+    std::cerr << "                   default strategy\n";
+    std::cerr << "  --output-dir <d> compiler output directory (default bench_output)\n";
+}
+
+/**
+ * Entry point.
+ *
+ * Every benchmark result is written to stdout as a single-line JSON object
+ * with the following keys:
+ *
+ *  - "benchmark": the name of the benchmark;
+ *  - "params": object describing the benchmark instance, such as the number
+ *    of gates;
+ *  - "repeat": the number of timed iterations;
+ *  - "min", "median", "mean", "max": statistics of the iteration times in
+ *    seconds;
+ *  - "heap": the median net number of bytes allocated on the heap by an
+ *    iteration (glibc only, 0 otherwise).
+ *
+ * With --scaling, generated programs are instead compiled in full for each
+ * combination of qubit count and workload size, and the result objects also
+ * contain the median and minimum compile time over the iterations, the peak
+ * resident set size and its growth during the first compilation in bytes,
+ * the per-pass profile records of the last compilation (see the
+ * profile_passes option), and the number of gates, multi-qubit gates and cycles of the input
+ * and output programs. The growth in multi-qubit gates is a measure for the
+ * routing overhead, as each swap inserted by the mapper typically decomposes
+ * into three CNOTs.
+ *
+ * The circuits are generated from a fixed seed, so results for the same seed
+ * and scale are comparable between builds. To guard against performance
+ * regressions, the results of a reference build can be stored with
+ * --save-baseline and compared against with --baseline; the median time
+ * ("median" or "compile_time") and the memory usage ("heap" or
+ * "peak_rss_delta") of each benchmark must then not exceed their baseline
+ * value by more than the threshold. Log output is redirected to stderr
+ * and limited to warnings.
+ */
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    try {
+        for (int i = 1; i < argc; i++) {
+            utils::Str arg = argv[i];
+            if (arg == "--list") {
+                options.list = true;
+                continue;
+            }
+            if (arg == "--scaling") {
+                options.scaling = true;
+                continue;
+            }
+            if (arg == "--help" || arg == "-h") {
+                usage(argv[0]);
+                return 0;
+            }
+            if (i + 1 >= argc) {
+                throw utils::Exception("missing value for " + arg);
+            }
+            utils::Str value = argv[++i];
+            if (arg == "--filter") {
+                options.filter = value;
+            } else if (arg == "--repeat") {
+                options.repeat = utils::parse_uint(value);
+            } else if (arg == "--seed") {
+                options.seed = utils::parse_uint(value);
+            } else if (arg == "--scale") {
+                options.scale = utils::parse_real(value);
+            } else if (arg == "--workload") {
+                options.workload = value;
+            } else if (arg == "--platform") {
+                options.family = value;
+            } else if (arg == "--qubits") {
+                options.qubits = parse_uint_list(value);
+            } else if (arg == "--size") {
+                options.sizes = parse_uint_list(value);
+            } else if (arg == "--cores") {
+                options.cores = utils::parse_uint(value);
+            } else if (arg == "--set") {
+                auto eq = value.find('=');
+                if (eq == utils::Str::npos) {
+                    throw utils::Exception("expected <key>=<value> for --set");
+                }
+                options.settings.push_back({value.substr(0, eq), value.substr(eq + 1)});
+            } else if (arg == "--strategy") {
+                options.strategy = value;
+            } else if (arg == "--output-dir") {
+                options.output_dir = value;
+            } else if (arg == "--baseline") {
+                options.baseline = value;
+            } else if (arg == "--save-baseline") {
+                options.save_baseline = value;
+            } else if (arg == "--threshold") {
+                options.threshold = utils::parse_real(value);
+            } else {
+                throw utils::Exception("unknown option " + arg);
+            }
+        }
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Keep the real stdout for the results, and send log output to stderr.
+    std::ostream results{std::cout.rdbuf()};
+    std::cout.rdbuf(std::cerr.rdbuf());
+    utils::logger::set_log_level("LOG_WARNING");
+
+    try {
+        Runner runner{options, results};
+        if (options.scaling) {
+            run_scaling(options, runner);
+        } else {
+            auto target = bench::build_target("cc_light", 0);
+            bench_ddg(runner, options, target);
+            bench_scheduler(runner, options, target);
+            bench_mapper(runner, options);
+            bench_cqasm(runner, options, target);
+            bench_convert(runner, options, target);
+            bench_instrument(runner, options, target);
+        }
+        if (options.list) {
+            return 0;
+        }
+
+        // Save and/or check against the baseline.
+        if (!options.save_baseline.empty()) {
+            utils::Json baseline = utils::Json::array();
+            for (const auto &result : runner.get_results()) {
+                baseline.push_back(result);
+            }
+            utils::OutFile(options.save_baseline) << baseline.dump(4) << "\n";
+        }
+        if (!options.baseline.empty()) {
+            if (compare_with_baseline(options, runner.get_results(), std::cerr)) {
+                return 2;
+            }
+        }
+
+    } catch (std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/** \file
+ * API header for compilations running in the background.
+ */
+
+#include "ql/api/compile_job.h"
+
+#include <chrono>
+#include <memory>
+#include "ql/com/options.h"
+
+//============================================================================//
+//                               W A R N I N G                                //
+//----------------------------------------------------------------------------//
+//         Docstrings in this file must manually be kept in sync with         //
+//    compile_job.i! This should be automated at some point, but isn't yet.   //
+//============================================================================//
+
+namespace ql {
+namespace api {
+
+/**
+ * Starts compiling the given program using the given pass manager in a
+ * background thread.
+ */
+CompileJob::CompileJob(const ql::pmgr::Ref &pass_manager, const ql::ir::Ref &ir) {
+
+    // Freeze the options before returning, such that the user can't change
+    // them before the background thread gets a chance to start.
+    auto freeze = std::make_shared<ql::com::options::Freeze>();
+    future = std::async(std::launch::async, [pass_manager, ir, freeze]() mutable {
+
+        // The lambda itself lives as long as the future does, so move the
+        // freeze into the body to release it as soon as compilation
+        // completes, successfully or otherwise.
+        auto scoped_freeze = std::move(freeze);
+        pass_manager->compile(ir);
+
+    }).share();
+
+}
+
+/**
+ * Returns whether the compilation has completed, either successfully or
+ * with an error. Does not block.
+ */
+bool CompileJob::done() const {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/**
+ * Waits for the compilation to complete. If compilation failed, the
+ * exception is rethrown.
+ */
+void CompileJob::wait() const {
+    future.get();
+}
+
+} // namespace api
+} // namespace ql
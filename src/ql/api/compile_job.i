@@ -0,0 +1,56 @@
+%feature("docstring") ql::api::CompileJob
+"""
+Handle for a compilation running in a background thread, as returned by
+Program.compile_async(). The global options are frozen until the compilation
+completes. When the last handle for a compilation is destroyed, the
+destructor waits for the compilation to complete.
+
+A CompileJob can be awaited from asyncio code, in which case the waiting is
+done in the default executor of the running event loop.
+"""
+
+
+%feature("docstring") ql::api::CompileJob::done
+"""
+Returns whether the compilation has completed, either successfully or with
+an error. Does not block.
+
+Parameters
+----------
+None
+
+Returns
+-------
+bool
+    Whether the compilation has completed.
+"""
+
+
+%feature("docstring") ql::api::CompileJob::wait
+"""
+Waits for the compilation to complete. If compilation failed, the exception
+is rethrown. The Python GIL is released while waiting.
+
+Parameters
+----------
+None
+
+Returns
+-------
+None
+"""
+
+
+// Release the GIL while waiting, such that other Python threads can run.
+%thread ql::api::CompileJob::wait;
+
+%include "ql/api/compile_job.h"
+
+%extend ql::api::CompileJob {
+    %pythoncode %{
+        def __await__(self):
+            import asyncio
+            loop = asyncio.get_event_loop()
+            return loop.run_in_executor(None, self.wait).__await__()
+    %}
+}
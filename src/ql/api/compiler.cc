@@ -405,6 +405,23 @@ void Compiler::compile(const Program &program) {
     pass_manager->compile(ir::convert_old_to_new(program.program));
 }
 
+/**
+ * Ensures that all passes have been constructed, and then runs the passes
+ * on each of the given programs, compiling up to num_threads programs
+ * concurrently. 0 means use all hardware threads. The programs should all
+ * target the same platform. Global options cannot be changed while this
+ * runs. If compilation of one or more programs fails, the exception for
+ * the first failing program is rethrown once all programs are done.
+ */
+void Compiler::compile_batch(const std::vector<Program> &programs, size_t num_threads) {
+    ql::utils::Vec<ql::ir::Ref> irs;
+    irs.reserve(programs.size());
+    for (const auto &program : programs) {
+        irs.push_back(ir::convert_old_to_new(program.program));
+    }
+    pass_manager->compile_batch(irs, num_threads);
+}
+
 /**
  * Ensures that all passes have been constructed, and then runs the passes
  * without specification of an input program. The first pass should then act
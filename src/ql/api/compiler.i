@@ -674,6 +674,29 @@ None
 """
 
 
+%feature("docstring") ql::api::Compiler::compile_batch
+"""
+Ensures that all passes have been constructed, and then runs the passes
+on each of the given programs, compiling up to num_threads programs
+concurrently. 0 means use all hardware threads. The programs should all
+target the same platform. Global options cannot be changed while this
+runs. If compilation of one or more programs fails, the exception for
+the first failing program is rethrown once all programs are done.
+
+Parameters
+----------
+programs : List[Program]
+    The programs to compile.
+num_threads : int
+    The maximum number of programs to compile concurrently, or 0 to use all
+    hardware threads.
+
+Returns
+-------
+None
+"""
+
+
 %feature("docstring") ql::api::Compiler::compile_with_frontend
 """
 Ensures that all passes have been constructed, and then runs the passes without
@@ -695,4 +718,9 @@ None
 """
 
 
+// Release the GIL while compiling, such that other Python threads can run.
+%thread ql::api::Compiler::compile;
+%thread ql::api::Compiler::compile_batch;
+%thread ql::api::Compiler::compile_with_frontend;
+
 %include "ql/api/compiler.h"
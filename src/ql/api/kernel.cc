@@ -68,14 +68,14 @@ std::string Kernel::dump_custom_instructions() const {
  * Shorthand for appending the given gate name with a single qubit.
  */
 void Kernel::gate(const std::string &name, size_t q0) {
-    kernel->gate(name, q0);
+    ir::compat::make_mutable(kernel)->gate(name, q0);
 }
 
 /**
  * Shorthand for appending the given gate name with two qubits.
  */
 void Kernel::gate(const std::string &name, size_t q0, size_t q1) {
-    kernel->gate(name, q0, q1);
+    ir::compat::make_mutable(kernel)->gate(name, q0, q1);
 }
 
 /**
@@ -109,7 +109,7 @@ void Kernel::gate(
     );
     auto condvalue = kernel->condstr2condvalue(condstring);
 
-    kernel->gate(
+    ir::compat::make_mutable(kernel)->gate(
         name,
         {qubits.begin(), qubits.end()},
         {},
@@ -139,7 +139,7 @@ void Kernel::gate(
         << (destination.creg)->id
         << ") # (name,qubits,creg-destination)"
     );
-    kernel->gate(name, {qubits.begin(), qubits.end()}, {(destination.creg)->id} );
+    ir::compat::make_mutable(kernel)->gate(name, {qubits.begin(), qubits.end()}, {(destination.creg)->id} );
 }
 
 /**
@@ -147,7 +147,7 @@ void Kernel::gate(
  * of course align with the number of qubits presented.
  */
 void Kernel::gate(const Unitary &u, const std::vector<size_t> &qubits) {
-    kernel->gate(*(u.unitary), {qubits.begin(), qubits.end()});
+    ir::compat::make_mutable(kernel)->gate(*(u.unitary), {qubits.begin(), qubits.end()});
 }
 
 /**
@@ -171,7 +171,7 @@ void Kernel::condgate(
         << ql::utils::Vec<size_t>(condregs.begin(), condregs.end())
         << ")"
     );
-    kernel->condgate(
+    ir::compat::make_mutable(kernel)->condgate(
         name,
         {qubits.begin(), qubits.end()},
         kernel->condstr2condvalue(condstring),
@@ -179,12 +179,107 @@ void Kernel::condgate(
     );
 }
 
+/**
+ * Appends many simple quantum gates at once, described by flat arrays
+ * rather than by one gate() call per gate. This is intended for Python
+ * users that generate large circuits with NumPy, in which case the arrays
+ * are read directly from the NumPy buffers.
+ *
+ * names is the table of gate names that the gate types index into. types
+ * contains one type index per gate, and thus determines the number of
+ * gates. qubits contains the qubit operands of all gates in row-major
+ * order; each gate gets the same number of entries (num_qubits divided by
+ * num_types), and gates with fewer operands than that must pad the end of
+ * their row with negative values. angles is either empty (num_angles = 0)
+ * or contains one angle per gate.
+ *
+ * The gates are added as if by gate(name, qubits, 0, angle), so the
+ * current preset condition, if any, applies to all of them.
+ */
+void Kernel::gates(
+    const std::vector<std::string> &names,
+    const std::int64_t *types,
+    size_t num_types,
+    const std::int64_t *qubits,
+    size_t num_qubits,
+    const double *angles,
+    size_t num_angles
+) {
+    QL_DOUT(
+        "Python k.gates("
+        << ql::utils::Vec<std::string>(names.begin(), names.end())
+        << ", <" << num_types << " types>"
+        << ", <" << num_qubits << " qubits>"
+        << ", <" << num_angles << " angles>"
+        << ")"
+    );
+    if (num_types == 0) {
+        if (num_qubits || num_angles) {
+            QL_USER_ERROR("qubits and angles must be empty when there are no gates");
+        }
+        return;
+    }
+    if (num_qubits % num_types) {
+        QL_USER_ERROR(
+            "number of qubit operands (" << num_qubits << ") is not a multiple "
+            "of the number of gates (" << num_types << ")"
+        );
+    }
+    if (num_angles && num_angles != num_types) {
+        QL_USER_ERROR(
+            "number of angles (" << num_angles << ") does not match the "
+            "number of gates (" << num_types << ")"
+        );
+    }
+    size_t width = num_qubits / num_types;
+
+    // Resolve the gate names only once, rather than once per gate.
+    ql::utils::Vec<ql::utils::Str> lowered;
+    lowered.reserve(names.size());
+    for (const auto &name : names) {
+        lowered.push_back(ql::utils::to_lower(name));
+    }
+
+    // Reuse the operand buffer for all gates.
+    ql::utils::Vec<ql::utils::UInt> operands;
+    operands.reserve(width);
+    for (size_t gate = 0; gate < num_types; gate++) {
+        auto type = types[gate];
+        if (type < 0 || (size_t)type >= lowered.size()) {
+            QL_USER_ERROR(
+                "gate type " << type << " of gate " << gate
+                << " is out of range for " << lowered.size() << " gate names"
+            );
+        }
+        operands.clear();
+        const std::int64_t *row = qubits + gate * width;
+        for (size_t i = 0; i < width; i++) {
+            if (row[i] >= 0) {
+                if (operands.size() != i) {
+                    QL_USER_ERROR(
+                        "qubit operand " << i << " of gate " << gate
+                        << " follows a padding entry"
+                    );
+                }
+                operands.push_back(row[i]);
+            }
+        }
+        ir::compat::make_mutable(kernel)->gate(
+            lowered[type],
+            operands,
+            {},
+            0,
+            num_angles ? angles[gate] : 0.0
+        );
+    }
+}
+
 /**
  * Appends a classical assignment gate to the circuit. The classical integer
  * register is assigned to the result of the given operation.
  */
 void Kernel::classical(const CReg &destination, const Operation &operation) {
-    kernel->classical(*(destination.creg), *(operation.operation));
+    ir::compat::make_mutable(kernel)->classical(*(destination.creg), *(operation.operation));
 }
 
 /**
@@ -192,7 +287,7 @@ void Kernel::classical(const CReg &destination, const Operation &operation) {
  * or less) supported.
  */
 void Kernel::classical(const std::string &operation) {
-    kernel->classical(operation);
+    ir::compat::make_mutable(kernel)->classical(operation);
 }
 
 /**
@@ -204,7 +299,7 @@ void Kernel::gate_preset_condition(
     const std::vector<size_t> &condregs
 ) {
     QL_DOUT("Python k.gate_preset_condition("<<condstring<<", condregs)");
-    kernel->gate_preset_condition(
+    ir::compat::make_mutable(kernel)->gate_preset_condition(
         kernel->condstr2condvalue(condstring),
         {condregs.begin(), condregs.end()}
     );
@@ -215,112 +310,112 @@ void Kernel::gate_preset_condition(
  */
 void Kernel::gate_clear_condition() {
     QL_DOUT("Python k.gate_clear_condition()");
-    kernel->gate_clear_condition();
+    ir::compat::make_mutable(kernel)->gate_clear_condition();
 }
 
 /**
  * Shorthand for appending an "identity" gate with a single qubit.
  */
 void Kernel::identity(size_t q0) {
-    kernel->identity(q0);
+    ir::compat::make_mutable(kernel)->identity(q0);
 }
 
 /**
  * Shorthand for appending a "hadamard" gate with a single qubit.
  */
 void Kernel::hadamard(size_t q0) {
-    kernel->hadamard(q0);
+    ir::compat::make_mutable(kernel)->hadamard(q0);
 }
 
 /**
  * Shorthand for appending an "s" gate with a single qubit.
  */
 void Kernel::s(size_t q0) {
-    kernel->s(q0);
+    ir::compat::make_mutable(kernel)->s(q0);
 }
 
 /**
  * Shorthand for appending an "sdag" gate with a single qubit.
  */
 void Kernel::sdag(size_t q0) {
-    kernel->sdag(q0);
+    ir::compat::make_mutable(kernel)->sdag(q0);
 }
 
 /**
  * Shorthand for appending a "t" gate with a single qubit.
  */
 void Kernel::t(size_t q0) {
-    kernel->t(q0);
+    ir::compat::make_mutable(kernel)->t(q0);
 }
 
 /**
  * Shorthand for appending a "tdag" gate with a single qubit.
  */
 void Kernel::tdag(size_t q0) {
-    kernel->tdag(q0);
+    ir::compat::make_mutable(kernel)->tdag(q0);
 }
 
 /**
  * Shorthand for appending an "x" gate with a single qubit.
  */
 void Kernel::x(size_t q0) {
-    kernel->x(q0);
+    ir::compat::make_mutable(kernel)->x(q0);
 }
 
 /**
  * Shorthand for appending a "y" gate with a single qubit.
  */
 void Kernel::y(size_t q0) {
-    kernel->y(q0);
+    ir::compat::make_mutable(kernel)->y(q0);
 }
 
 /**
  * Shorthand for appending a "z" gate with a single qubit.
  */
 void Kernel::z(size_t q0) {
-    kernel->z(q0);
+    ir::compat::make_mutable(kernel)->z(q0);
 }
 
 /**
  * Shorthand for appending an "rx90" gate with a single qubit.
  */
 void Kernel::rx90(size_t q0) {
-    kernel->rx90(q0);
+    ir::compat::make_mutable(kernel)->rx90(q0);
 }
 
 /**
  * Shorthand for appending an "mrx90" gate with a single qubit.
  */
 void Kernel::mrx90(size_t q0) {
-    kernel->mrx90(q0);
+    ir::compat::make_mutable(kernel)->mrx90(q0);
 }
 
 /**
  * Shorthand for appending an "rx180" gate with a single qubit.
  */
 void Kernel::rx180(size_t q0) {
-    kernel->rx180(q0);
+    ir::compat::make_mutable(kernel)->rx180(q0);
 }
 
 /**
  * Shorthand for appending an "ry90" gate with a single qubit.
  */
 void Kernel::ry90(size_t q0) {
-    kernel->ry90(q0);
+    ir::compat::make_mutable(kernel)->ry90(q0);
 }
 
 /**
  * Shorthand for appending an "mry90" gate with a single qubit.
  */
 void Kernel::mry90(size_t q0) {
-    kernel->mry90(q0);
+    ir::compat::make_mutable(kernel)->mry90(q0);
 }
 
 /**
  * Shorthand for appending an "ry180" gate with a single qubit.
  */
 void Kernel::ry180(size_t q0) {
-    kernel->ry180(q0);
+    ir::compat::make_mutable(kernel)->ry180(q0);
 }
 
 /**
@@ -328,7 +423,7 @@ void Kernel::ry180(size_t q0) {
  * rotation in radians.
  */
 void Kernel::rx(size_t q0, double angle) {
-    kernel->rx(q0, angle);
+    ir::compat::make_mutable(kernel)->rx(q0, angle);
 }
 
 /**
@@ -336,7 +431,7 @@ void Kernel::rx(size_t q0, double angle) {
  * rotation in radians.
  */
 void Kernel::ry(size_t q0, double angle) {
-    kernel->ry(q0, angle);
+    ir::compat::make_mutable(kernel)->ry(q0, angle);
 }
 
 /**
@@ -344,7 +439,7 @@ void Kernel::ry(size_t q0, double angle) {
  * rotation in radians.
  */
 void Kernel::rz(size_t q0, double angle) {
-    kernel->rz(q0, angle);
+    ir::compat::make_mutable(kernel)->rz(q0, angle);
 }
 
 /**
@@ -353,7 +448,7 @@ void Kernel::rz(size_t q0, double angle) {
  */
 void Kernel::measure(size_t q0) {
     QL_DOUT("Python k.measure([" << q0 << "])");
-    kernel->measure(q0);
+    ir::compat::make_mutable(kernel)->measure(q0);
 }
 
 /**
@@ -362,42 +457,42 @@ void Kernel::measure(size_t q0) {
  */
 void Kernel::measure(size_t q0, size_t b0) {
     QL_DOUT("Python k.measure([" << q0 << "], [" << b0 << "])");
-    kernel->measure(q0, b0);
+    ir::compat::make_mutable(kernel)->measure(q0, b0);
 }
 
 /**
  * Shorthand for appending a "prepz" gate with a single qubit.
  */
 void Kernel::prepz(size_t q0) {
-    kernel->prepz(q0);
+    ir::compat::make_mutable(kernel)->prepz(q0);
 }
 
 /**
  * Shorthand for appending a "cnot" gate with two qubits.
  */
 void Kernel::cnot(size_t q0, size_t q1) {
-    kernel->cnot(q0,q1);
+    ir::compat::make_mutable(kernel)->cnot(q0,q1);
 }
 
 /**
  * Shorthand for appending a "cphase" gate with two qubits.
  */
 void Kernel::cphase(size_t q0, size_t q1) {
-    kernel->cphase(q0,q1);
+    ir::compat::make_mutable(kernel)->cphase(q0,q1);
 }
 
 /**
  * Shorthand for appending a "cz" gate with two qubits.
  */
 void Kernel::cz(size_t q0, size_t q1) {
-    kernel->cz(q0,q1);
+    ir::compat::make_mutable(kernel)->cz(q0,q1);
 }
 
 /**
  * Shorthand for appending a "toffoli" gate with three qubits.
  */
 void Kernel::toffoli(size_t q0, size_t q1, size_t q2) {
-    kernel->toffoli(q0,q1,q2);
+    ir::compat::make_mutable(kernel)->toffoli(q0,q1,q2);
 }
 
 /**
@@ -405,7 +500,7 @@ void Kernel::toffoli(size_t q0, size_t q1, size_t q2) {
  * the minimal number of rx90, rx180, mrx90, ry90, ry180, and mry90 gates.
  */
 void Kernel::clifford(int id, size_t q0) {
-    kernel->clifford(id, q0);
+    ir::compat::make_mutable(kernel)->clifford(id, q0);
 }
 
 /**
@@ -416,7 +511,7 @@ void Kernel::clifford(int id, size_t q0) {
  * platform's cycle time.
  */
 void Kernel::wait(const std::vector<size_t> &qubits, size_t duration) {
-    kernel->wait({qubits.begin(), qubits.end()}, duration);
+    ir::compat::make_mutable(kernel)->wait({qubits.begin(), qubits.end()}, duration);
 }
 
 /**
@@ -425,7 +520,7 @@ void Kernel::wait(const std::vector<size_t> &qubits, size_t duration) {
  * instead (a wait with no qubits is meaningless).
  */
 void Kernel::barrier(const std::vector<size_t> &qubits) {
-    kernel->wait({qubits.begin(), qubits.end()}, 0);
+    ir::compat::make_mutable(kernel)->wait({qubits.begin(), qubits.end()}, 0);
 }
 
 /**
@@ -439,7 +534,7 @@ void Kernel::display() {
  * Appends the diamond excite_mw instruction.
  */
 void Kernel::diamond_excite_mw(size_t envelope, size_t duration, size_t frequency, size_t phase, size_t amplitude, size_t qubit) {
-    kernel->gate("excite_mw", qubit);
+    ir::compat::make_mutable(kernel)->gate("excite_mw", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::ExciteMicrowaveParameters>({envelope, duration, frequency, phase, amplitude});
 }
 
@@ -448,7 +543,7 @@ void Kernel::diamond_excite_mw(size_t envelope, size_t duration, size_t frequenc
  * to a nuclear spin qubit within the color center.
  */
 void Kernel::diamond_memswap(size_t qubit, size_t nuclear_qubit) {
-    kernel->gate("memswap", qubit);
+    ir::compat::make_mutable(kernel)->gate("memswap", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::MemSwapParameters>({nuclear_qubit});
 }
 
@@ -457,7 +552,7 @@ void Kernel::diamond_memswap(size_t qubit, size_t nuclear_qubit) {
  * nuclear spin qubit within the color center.
  */
 void Kernel::diamond_qentangle(size_t qubit, size_t nuclear_qubit){
-    kernel->gate("qentangle", qubit);
+    ir::compat::make_mutable(kernel)->gate("qentangle", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::QEntangleParameters>({nuclear_qubit});
 }
 
@@ -467,7 +562,7 @@ void Kernel::diamond_qentangle(size_t qubit, size_t nuclear_qubit){
  */
 void Kernel::diamond_sweep_bias(size_t qubit, size_t value, size_t dacreg, size_t start, size_t step, size_t max, size_t memaddress)
 {
-    kernel->gate("sweep_bias", qubit);
+    ir::compat::make_mutable(kernel)->gate("sweep_bias", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::SweepBiasParameters>({value, dacreg, start, step, max, memaddress});
 }
 
@@ -476,7 +571,7 @@ void Kernel::diamond_sweep_bias(size_t qubit, size_t value, size_t dacreg, size_
  * still in the correct charge state.
  */
 void Kernel::diamond_crc(size_t qubit, size_t threshold, size_t value) {
-    kernel->gate("crc", qubit);
+    ir::compat::make_mutable(kernel)->gate("crc", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::CRCParameters>({threshold, value});
 }
 
@@ -486,7 +581,7 @@ void Kernel::diamond_crc(size_t qubit, size_t threshold, size_t value) {
  * be excited for to have it flip.
  */
 void Kernel::diamond_rabi_check(size_t qubit, size_t measurements, size_t duration, size_t t_max){
-    kernel->gate("rabi_check", qubit);
+    ir::compat::make_mutable(kernel)->gate("rabi_check", qubit);
     kernel->gates.back()->set_annotation<ql::arch::diamond::annotations::RabiParameters>({measurements, duration, t_max});
 }
 
@@ -502,7 +597,7 @@ void Kernel::controlled(
     const std::vector<size_t> &control_qubits,
     const std::vector<size_t> &ancilla_qubits
 ) {
-    kernel->controlled(*k.kernel, {control_qubits.begin(), control_qubits.end()}, {ancilla_qubits.begin(), ancilla_qubits.end()});
+    ir::compat::make_mutable(kernel)->controlled(*k.kernel, {control_qubits.begin(), control_qubits.end()}, {ancilla_qubits.begin(), ancilla_qubits.end()});
 }
 
 /**
@@ -512,7 +607,7 @@ void Kernel::controlled(
  * on default gates, which are on the list for removal.
  */
 void Kernel::conjugate(const Kernel &k) {
-    kernel->conjugate(*k.kernel);
+    ir::compat::make_mutable(kernel)->conjugate(*k.kernel);
 }
 
 } // namespace api
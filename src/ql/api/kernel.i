@@ -241,6 +241,187 @@ None
 """
 
 
+// Typemaps for the flat arrays taken by gates(). Contiguous buffers with the
+// right element type (notably NumPy int64 and float64 arrays) are used
+// directly without copying; anything else is converted element by element
+// through the sequence protocol. None is accepted as an empty array.
+%{
+#include <vector>
+#include <cstdint>
+
+namespace ql {
+namespace api {
+
+// Returns whether the given buffer format character matches a signed
+// integer of the same width as T, or a double if T is double.
+template <typename T>
+static bool swig_buffer_format_matches(const char *format);
+
+template <>
+bool swig_buffer_format_matches<std::int64_t>(const char *format) {
+    if (!format) return false;
+    if (*format == '@' || *format == '=' || *format == '<') format++;
+    return (*format == 'q' && sizeof(long long) == sizeof(std::int64_t))
+        || (*format == 'l' && sizeof(long) == sizeof(std::int64_t));
+}
+
+template <>
+bool swig_buffer_format_matches<double>(const char *format) {
+    if (!format) return false;
+    if (*format == '@' || *format == '=' || *format == '<') format++;
+    return *format == 'd';
+}
+
+static bool swig_convert_element(PyObject *obj, std::int64_t &value) {
+    PyObject *index = PyNumber_Index(obj);
+    if (!index) return false;
+    value = PyLong_AsLongLong(index);
+    Py_DECREF(index);
+    return !PyErr_Occurred();
+}
+
+static bool swig_convert_element(PyObject *obj, double &value) {
+    value = PyFloat_AsDouble(obj);
+    return !PyErr_Occurred();
+}
+
+// Views a Python object as a flat array of T. If the object exposes a
+// contiguous buffer of the right type, the buffer is locked and used
+// directly, and must be released with PyBuffer_Release() when view_valid is
+// set. Otherwise, the elements are copied into temp. Returns false with a
+// Python exception set on failure.
+template <typename T>
+static bool swig_view_array(
+    PyObject *obj,
+    Py_buffer &view,
+    bool &view_valid,
+    std::vector<T> &temp,
+    const T *&data,
+    size_t &size
+) {
+    view_valid = false;
+    data = nullptr;
+    size = 0;
+    if (obj == Py_None) {
+        return true;
+    }
+    if (PyObject_CheckBuffer(obj)) {
+        if (PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+            if (
+                view.itemsize == sizeof(T)
+                && swig_buffer_format_matches<T>(view.format)
+            ) {
+                view_valid = true;
+                data = static_cast<const T*>(view.buf);
+                size = view.len / sizeof(T);
+                return true;
+            }
+            PyBuffer_Release(&view);
+        } else {
+            PyErr_Clear();
+        }
+    }
+    PyObject *seq = PySequence_Fast(obj, "expected a sequence or buffer");
+    if (!seq) return false;
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(seq);
+    temp.resize(len);
+    for (Py_ssize_t i = 0; i < len; i++) {
+        if (!swig_convert_element(PySequence_Fast_GET_ITEM(seq, i), temp[i])) {
+            Py_DECREF(seq);
+            return false;
+        }
+    }
+    Py_DECREF(seq);
+    data = temp.data();
+    size = temp.size();
+    return true;
+}
+
+} // namespace api
+} // namespace ql
+%}
+
+%typemap(in) (const std::int64_t *INT64_ARRAY, size_t INT64_ARRAY_SIZE)
+    (Py_buffer view, bool view_valid = false, std::vector<std::int64_t> temp) {
+    const std::int64_t *data;
+    size_t size;
+    if (!ql::api::swig_view_array($input, view, view_valid, temp, data, size)) {
+        SWIG_fail;
+    }
+    $1 = ($1_ltype)data;
+    $2 = size;
+}
+
+%typemap(freearg) (const std::int64_t *INT64_ARRAY, size_t INT64_ARRAY_SIZE) {
+    if (view_valid$argnum) {
+        PyBuffer_Release(&view$argnum);
+    }
+}
+
+%typemap(in) (const double *DOUBLE_ARRAY, size_t DOUBLE_ARRAY_SIZE)
+    (Py_buffer view, bool view_valid = false, std::vector<double> temp) {
+    const double *data;
+    size_t size;
+    if (!ql::api::swig_view_array($input, view, view_valid, temp, data, size)) {
+        SWIG_fail;
+    }
+    $1 = ($1_ltype)data;
+    $2 = size;
+}
+
+%typemap(freearg) (const double *DOUBLE_ARRAY, size_t DOUBLE_ARRAY_SIZE) {
+    if (view_valid$argnum) {
+        PyBuffer_Release(&view$argnum);
+    }
+}
+
+%apply (const std::int64_t *INT64_ARRAY, size_t INT64_ARRAY_SIZE) {
+    (const std::int64_t *types, size_t num_types),
+    (const std::int64_t *qubits, size_t num_qubits)
+};
+
+%apply (const double *DOUBLE_ARRAY, size_t DOUBLE_ARRAY_SIZE) {
+    (const double *angles, size_t num_angles)
+};
+
+
+%feature("docstring") ql::api::Kernel::gates
+"""
+Appends many simple quantum gates at once, described by flat arrays rather
+than by one gate() call per gate. This is much faster than calling gate()
+in a Python loop when generating large circuits. Contiguous NumPy arrays of
+type int64 (for types and qubits) and float64 (for angles) are read directly
+without being copied; other sequences are converted element by element.
+
+The gates are added as if by gate(name, qubits, 0, angle), so the current
+preset condition, if any, applies to all of them.
+
+Parameters
+----------
+names : List[str]
+    The table of gate names that the entries of types index into.
+
+types : numpy.ndarray or List[int]
+    One index into names per gate. The length of this array determines the
+    number of gates.
+
+qubits : numpy.ndarray or List[int]
+    The qubit operands of all gates, in row-major order. Each gate gets the
+    same number of entries, i.e. the size of this array divided by the number
+    of gates, so a 2D array of shape (number of gates, maximum operand count)
+    can be passed directly. Gates with fewer operands must pad the end of
+    their row with negative values.
+
+angles : numpy.ndarray or List[float] or None
+    Either None or an empty array to use angle 0 for all gates, or one angle
+    in radians per gate.
+
+Returns
+-------
+None
+"""
+
+
 %feature("docstring") ql::api::Kernel::condgate
 """
 Alternative function for appending normal conditional quantum gates. Avoids
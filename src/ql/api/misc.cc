@@ -6,6 +6,8 @@
 
 #include "ql/version.h"
 #include "ql/utils/logger.h"
+#include "ql/utils/json.h"
+#include "ql/utils/progress.h"
 #include "ql/ir/cqasm/read.h"
 #include "ql/ir/old_to_new.h"
 #include "ql/com/options.h"
@@ -47,6 +49,7 @@ void initialize() {
     } else {
         QL_IOUT("initializing OpenQL library");
     }
+    ql::com::options::check_not_frozen();
     initialized = true;
     ql::com::options::global.reset();
 }
@@ -74,7 +77,7 @@ std::string get_version() {
  */
 void set_option(const std::string &option, const std::string &value) {
     ensure_initialized();
-    ql::com::options::global[option] = value;
+    ql::com::options::set(option, value);
 }
 
 /**
@@ -201,5 +204,51 @@ void compile(
     pass_manager.compile(ir::convert_old_to_new(platform));
 }
 
+/**
+ * Like compile(), but reads the given cQASM code instead of a file, and
+ * returns the output files instead of writing them to disk (see
+ * Program.compile_in_memory()). If platform_json is empty, the platform must
+ * be encoded using a `pragma @ql.platform(...)` annotation as for compile().
+ * Otherwise, the platform is built from the given platform configuration JSON
+ * *data*, including the compiler configuration it specifies, if any.
+ */
+std::map<std::string, std::string> compile_in_memory(
+    const std::string &cqasm,
+    const std::string &platform_json,
+    std::map<std::string, std::string> read_options
+) {
+    ensure_initialized();
+    ql::ir::compat::PlatformRef platform;
+    if (platform_json.empty()) {
+        platform = ir::cqasm::read_platform(cqasm, "<string>");
+    } else {
+        platform = ql::ir::compat::Platform::build("platform", utils::parse_json(platform_json));
+    }
+    auto pass_manager = ql::pmgr::Manager::from_defaults(platform);
+    read_options.insert({"cqasm_string", cqasm}).first->second = cqasm;
+    pass_manager.prefix_pass("io.cqasm.Read", "", read_options);
+    auto files = pass_manager.compile_in_memory(ir::convert_old_to_new(platform));
+    std::map<std::string, std::string> result;
+    for (const auto &file : files) {
+        result.emplace(file.first, file.second);
+    }
+    return result;
+}
+
+/**
+ * Returns the progress of the long-running algorithms that are currently
+ * reporting it, such as the router of the mapper, as a fraction between 0 and
+ * 1 keyed by the name of the algorithm. The progress of concurrent instances
+ * of the same algorithm is averaged. This may be called from another thread
+ * while a program is being compiled.
+ */
+std::map<std::string, double> get_progress() {
+    std::map<std::string, double> result;
+    for (const auto &it : utils::Progress::get_snapshot()) {
+        result.emplace(it.first, it.second);
+    }
+    return result;
+}
+
 } // namespace api
 } // namespace ql
@@ -284,4 +284,61 @@ None
 """
 
 
+%feature("docstring") compile_in_memory
+"""
+Like compile(), but reads the given cQASM code instead of a file, and returns
+the output files instead of writing them to disk (see
+Program.compile_in_memory()). The Python GIL is released while compiling.
+
+If platform_json is empty, the platform must be encoded using a
+`pragma @ql.platform(...)` annotation at the front of the code, as for
+compile(). Otherwise, the platform is built from the given platform
+configuration JSON data, including the compiler configuration it specifies,
+if any.
+
+Parameters
+----------
+cqasm : str
+    The cQASM code to compile.
+platform_json : str
+    The platform configuration JSON data, or an empty string to load the
+    platform from the cQASM code.
+read_options : dict[str, str]
+    A list of options to set for the cQASM reader pass.
+
+Returns
+-------
+mapss
+    A dict-like object mapping the path that each output file would have
+    been written to (usually starting with the output_dir option) to its
+    contents. Use dict() to turn it into a regular dictionary.
+"""
+
+
+%feature("docstring") get_progress
+"""
+Returns the progress of the long-running algorithms that are currently
+reporting it, such as the router of the mapper. The progress is recorded using
+cheap atomic counters and sampled by a background thread, so this may be
+polled from another Python thread while a program is being compiled (the GIL
+is released while compiling) to report compilation progress.
+
+Parameters
+----------
+None
+
+Returns
+-------
+mapsd
+    A dict-like object mapping the name of each algorithm to its progress as
+    a fraction between 0 and 1. The progress of concurrent instances of the
+    same algorithm, such as the router when kernels are mapped concurrently,
+    is averaged. Use dict() to turn it into a regular dictionary.
+"""
+
+
+// Release the GIL while compiling, such that other Python threads can run.
+%thread compile_in_memory;
+
+
 %include "ql/api/misc.h"
@@ -39,8 +39,8 @@ Eight constructors are provided:
  - Platform(name, platform_config): builds a platform with the given name (only
    used for log messages) and platform configuration, the latter of which can
    be either a recognized platform name with or without variant suffix (for
-   example \"cc\" or \"cc_light.s7\"), or a path to a JSON configuration
-   filename.
+   example \"cc\" or \"cc_light.s7\"), a path to a JSON configuration
+   filename, or a path to a platform snapshot written by write_snapshot().
  - Platform(name, platform_config, compiler_config): as above, but specifies a
    custom compiler configuration file in addition.
  - Platform.from_json(name, platform_config_json): instead of loading the
@@ -171,6 +171,26 @@ str
 """
 
 
+%feature("docstring") ql::api::Platform::write_snapshot
+"""
+Writes a binary snapshot of the loaded platform to the given file. The snapshot
+contains the preprocessed platform configuration and the topology including
+its distance matrix, so constructing a platform from the snapshot file (in
+place of the configuration file) is much faster than loading the original
+configuration. Snapshots can only be loaded by the OpenQL version that wrote
+them.
+
+Parameters
+----------
+fname : str
+    The file to write the snapshot to.
+
+Returns
+-------
+None
+"""
+
+
 %feature("docstring") ql::api::Platform::has_compiler
 """
 Returns whether a custom compiler configuration has been attached to this
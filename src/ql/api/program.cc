@@ -53,6 +53,52 @@ void Program::add_kernel(const Kernel &k) {
     program->add(k.kernel);
 }
 
+/**
+ * Adds the given unconditionally-executed kernels to the end of the program.
+ * This is equivalent to calling add_kernel() for each kernel, except that none
+ * of the kernels are added if any of them cannot be.
+ */
+void Program::add_kernels(const std::vector<Kernel> &ks) {
+    ir::compat::KernelRefs kernels;
+    for (const auto &k : ks) {
+        kernels.add(k.kernel);
+    }
+    program->add_kernels(kernels);
+}
+
+/**
+ * Adds unconditionally-executed clones of the given kernel to the end of the
+ * program, in which only the angles of some of the gates differ. The gates to
+ * substitute the angle of are specified by their index in the kernel, and must
+ * be rx, ry, rz, or custom gates. The angles vector specifies the angles for
+ * each clone in turn, so its size must be a multiple of the number of gate
+ * indices. Clone i is named <kernel name>_<i>. The gates are copied rather
+ * than resolved against the platform again for every clone.
+ */
+void Program::add_kernel_clones(
+    const Kernel &k,
+    const std::vector<size_t> &gate_indices,
+    const std::vector<double> &angles
+) {
+    if (gate_indices.empty() || angles.size() % gate_indices.size()) {
+        QL_USER_ERROR(
+            "number of angles (" << angles.size() << ") is not a multiple "
+            "of the number of gate indices (" << gate_indices.size() << ")"
+        );
+    }
+    utils::Vec<utils::UInt> indices{gate_indices.begin(), gate_indices.end()};
+    ir::compat::KernelRefs kernels;
+    for (size_t i = 0; i * indices.size() < angles.size(); i++) {
+        auto first = angles.begin() + i * indices.size();
+        kernels.add(k.kernel->clone_with_angles(
+            k.name + "_" + utils::to_string(i),
+            indices,
+            {first, first + indices.size()}
+        ));
+    }
+    program->add_kernels(kernels);
+}
+
 /**
  * Adds an unconditionally-executed subprogram to the end of the program.
  */
@@ -214,23 +260,80 @@ void Program::compile() {
 }
 
 /**
- * Prints the interaction matrix for each kernel in the program.
+ * Compiles the program without writing any output files to disk. The files
+ * are returned instead, mapping the path they would have been written to
+ * (usually starting with the output_dir option) to their contents.
+ */
+std::map<std::string, std::string> Program::compile_in_memory() {
+    QL_IOUT("compiling " << name << " in memory ...");
+    auto ir = ir::convert_old_to_new(program);
+    ql::utils::Map<ql::utils::Str, ql::utils::Str> files;
+    if (pass_manager.has_value()) {
+        files = pass_manager->compile_in_memory(ir);
+    } else {
+        files = ql::pmgr::Manager::from_defaults(program->platform).compile_in_memory(ir);
+    }
+    std::map<std::string, std::string> result;
+    for (const auto &file : files) {
+        result.emplace(file.first, file.second);
+    }
+    return result;
+}
+
+/**
+ * Compiles the program like compile(), and returns the instructions of the
+ * compiled program in columnar form.
+ */
+Schedule Program::compile_to_schedule() {
+    QL_IOUT("compiling " << name << " ...");
+    auto ir = ir::convert_old_to_new(program);
+    if (pass_manager.has_value()) {
+        pass_manager->compile(ir);
+    } else {
+        ql::pmgr::Manager::from_defaults(program->platform).compile(ir);
+    }
+    return Schedule(ir);
+}
+
+/**
+ * Starts compiling the program in a background thread, returning a handle
+ * that can be used to poll or wait for completion. The program is
+ * converted to the compiler's internal representation before this
+ * returns, so it may be modified afterwards without affecting the
+ * compilation. The global options are frozen until compilation completes.
+ */
+CompileJob Program::compile_async() {
+    QL_IOUT("compiling " << name << " in the background ...");
+    auto ir = ir::convert_old_to_new(program);
+    ql::pmgr::Ref manager = pass_manager;
+    if (!manager.has_value()) {
+        manager.emplace(ql::pmgr::Manager::from_defaults(program->platform));
+    }
+    return CompileJob(manager, ir);
+}
+
+/**
+ * Prints the interaction matrix for each kernel in the program. If sparse is
+ * set, only the nonzero entries are printed, one "<qubit> <qubit> <count>"
+ * line each.
  */
-void Program::print_interaction_matrix() const {
+void Program::print_interaction_matrix(bool sparse) const {
     QL_IOUT("printing interaction matrix...");
 
-    ql::com::ana::InteractionMatrix::dump_for_program(program);
+    ql::com::ana::InteractionMatrix::dump_for_program(program, std::cout, sparse);
 }
 
 /**
  * Writes the interaction matrix for each kernel in the program to a file.
  * This is one of the few functions that still uses the global output_dir
- * option.
+ * option. If sparse is set, only the nonzero entries are written, one
+ * "<qubit> <qubit> <count>" line each.
  */
-void Program::write_interaction_matrix() const {
+void Program::write_interaction_matrix(bool sparse) const {
     ql::com::ana::InteractionMatrix::write_for_program(
         get_option("output_dir") + "/",
-        program
+        program,
+        sparse
     );
 }
 
@@ -56,6 +56,48 @@ None
 """
 
 
+%feature("docstring") ql::api::Program::add_kernels
+"""
+Adds the given unconditionally-executed kernels to the end of the program.
+This is equivalent to calling add_kernel() for each kernel, except that none
+of the kernels are added if any of them cannot be.
+
+Parameters
+----------
+ks : List[Kernel]
+    The kernels to add.
+
+Returns
+-------
+None
+"""
+
+
+%feature("docstring") ql::api::Program::add_kernel_clones
+"""
+Adds unconditionally-executed clones of the given kernel to the end of the
+program, in which only the angles of some of the gates differ. The gates are
+copied rather than resolved against the platform again for every clone, so
+this is much cheaper than constructing each kernel separately when generating
+parameter sweeps.
+
+Parameters
+----------
+k : Kernel
+    The template kernel. It is not added to the program itself.
+gate_indices : List[int]
+    The indices of the gates within the kernel to substitute the angle of.
+    These must be rx, ry, rz, or custom gates.
+angles : List[float]
+    The angles for each clone in turn, so the size must be a multiple of the
+    number of gate indices. Clone i is named <kernel name>_<i>.
+
+Returns
+-------
+None
+"""
+
+
 %feature("docstring") ql::api::Program::add_program
 """
 Adds an unconditionally-executed subprogram to the end of the program.
@@ -280,7 +322,46 @@ None
 
 %feature("docstring") ql::api::Program::compile
 """
-Compiles the program.
+Compiles the program. The Python GIL is released while compiling, so other
+Python threads can keep running.
+
+Parameters
+----------
+None
+
+Returns
+-------
+None
+"""
+
+
+%feature("docstring") ql::api::Program::compile_in_memory
+"""
+Compiles the program without writing any output files to disk. The Python
+GIL is released while compiling, like for compile().
+
+Files that passes read back during compilation are read from memory as
+well. Cache entries (pass_cache_dir, unitary_cache_dir) are still written
+to disk, and bitmap images written by the visualizer are not captured.
+
+Parameters
+----------
+None
+
+Returns
+-------
+mapss
+    A dict-like object mapping the path that each output file would have
+    been written to (usually starting with the output_dir option) to its
+    contents. Use dict() to turn it into a regular dictionary.
+"""
+
+
+%feature("docstring") ql::api::Program::compile_to_schedule
+"""
+Compiles the program like compile(), and returns the instructions of the
+compiled program in columnar form. The Python GIL is released while
+compiling.
 
 Parameters
 ----------
@@ -288,7 +369,29 @@ None
 
 Returns
 -------
+Schedule
+    The instruction types, cycles, durations, and qubit operands of the
+    compiled program, accessible as NumPy arrays.
+"""
+
+
+%feature("docstring") ql::api::Program::compile_async
+"""
+Starts compiling the program in a background thread, returning a handle
+that can be used to poll or wait for completion. The program is converted
+to the compiler's internal representation before this returns, so it may be
+modified afterwards without affecting the compilation. The global options
+are frozen until compilation completes.
+
+Parameters
+----------
 None
+
+Returns
+-------
+CompileJob
+    A handle for the running compilation. It can also be awaited from
+    asyncio code.
 """
 
 
@@ -298,7 +401,9 @@ Prints the interaction matrix for each kernel in the program.
 
 Parameters
 ----------
-None
+sparse : bool
+    If set, only the nonzero entries are printed, one "<qubit> <qubit>
+    <count>" line each.
 
 Returns
 -------
@@ -314,7 +419,9 @@ option.
 
 Parameters
 ----------
-None
+sparse : bool
+    If set, only the nonzero entries are written, one "<qubit> <qubit>
+    <count>" line each.
 
 Returns
 -------
@@ -322,4 +429,10 @@ None
 """
 
 
+// Release the GIL while compiling, such that other Python threads can run.
+%thread ql::api::Program::compile;
+%thread ql::api::Program::compile_in_memory;
+%thread ql::api::Program::compile_to_schedule;
+%thread ql::api::Program::compile_async;
+
 %include "ql/api/program.h"
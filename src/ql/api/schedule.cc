@@ -0,0 +1,138 @@
+/** \file
+ * API header for accessing the schedule of a compiled program.
+ */
+
+#include "ql/api/schedule.h"
+
+#include <unordered_map>
+#include "ql/ir/ops.h"
+
+//============================================================================//
+//                               W A R N I N G                                //
+//----------------------------------------------------------------------------//
+//         Docstrings in this file must manually be kept in sync with         //
+//     schedule.i! This should be automated at some point, but isn't yet.     //
+//============================================================================//
+
+namespace ql {
+namespace api {
+
+/**
+ * Builds the columns from the given program, usually after compiling it.
+ */
+Schedule::Schedule(const ql::ir::Ref &ir) {
+    std::unordered_map<std::string, std::int64_t> type_ids;
+    operand_offsets.push_back(0);
+    block_offsets.push_back(0);
+    if (ir->program.empty()) {
+        return;
+    }
+    for (const auto &block : ir->program->blocks) {
+        block_names.push_back(block->name);
+        for (const auto &statement : block->statements) {
+            auto insn = statement.as<ql::ir::Instruction>();
+            if (insn.empty()) {
+                continue;
+            }
+
+            // Look up or assign the type index, using the same names as the
+            // resources see.
+            std::string name;
+            if (auto custom = insn->as_custom_instruction()) {
+                name = custom->instruction_type->name;
+            } else if (insn->as_set_instruction()) {
+                name = "set";
+            } else if (insn->as_goto_instruction()) {
+                name = "goto";
+            } else if (insn->as_wait_instruction()) {
+                name = "wait";
+            }
+            auto it = type_ids.find(name);
+            if (it == type_ids.end()) {
+                it = type_ids.emplace(name, instruction_types.size()).first;
+                instruction_types.push_back(name);
+            }
+            types.push_back(it->second);
+            cycles.push_back(statement->cycle);
+            durations.push_back(ql::ir::get_duration_of_statement(statement));
+
+            // Only literal references to the main qubit register are
+            // recorded as operands.
+            for (const auto &oper : ql::ir::get_operands(insn)) {
+                if (auto ref = oper->as_reference()) {
+                    if (
+                        ref->target == ir->platform->qubits &&
+                        ref->data_type == ir->platform->qubits->data_type &&
+                        ref->indices.size() == 1 &&
+                        ref->indices[0]->as_int_literal()
+                    ) {
+                        operands.push_back(ref->indices[0]->as_int_literal()->value);
+                    }
+                }
+            }
+            operand_offsets.push_back(operands.size());
+
+        }
+        block_offsets.push_back(types.size());
+    }
+}
+
+/**
+ * Returns the number of instructions in the schedule.
+ */
+size_t Schedule::get_num_instructions() const {
+    return types.size();
+}
+
+/**
+ * Returns the number of blocks in the schedule.
+ */
+size_t Schedule::get_num_blocks() const {
+    return block_names.size();
+}
+
+/**
+ * Returns the names of the instruction types that the "type" column indexes
+ * into.
+ */
+const std::vector<std::string> &Schedule::get_instruction_types() const {
+    return instruction_types;
+}
+
+/**
+ * Returns the names of the blocks that the "block_offset" column delimits.
+ */
+const std::vector<std::string> &Schedule::get_block_names() const {
+    return block_names;
+}
+
+/**
+ * Returns the names of the available columns.
+ */
+std::vector<std::string> Schedule::get_column_names() const {
+    return {"type", "cycle", "duration", "operand_offset", "operand", "block_offset"};
+}
+
+/**
+ * Returns the column with the given name. The reference remains valid for as
+ * long as this object exists.
+ */
+const std::vector<std::int64_t> &Schedule::get_column(const std::string &name) const {
+    if (name == "type") {
+        return types;
+    } else if (name == "cycle") {
+        return cycles;
+    } else if (name == "duration") {
+        return durations;
+    } else if (name == "operand_offset") {
+        return operand_offsets;
+    } else if (name == "operand") {
+        return operands;
+    } else if (name == "block_offset") {
+        return block_offsets;
+    }
+    QL_USER_ERROR("unknown schedule column \"" << name << "\"");
+}
+
+} // namespace api
+} // namespace ql
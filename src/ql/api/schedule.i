@@ -0,0 +1,173 @@
+%feature("docstring") ql::api::Schedule
+"""
+The instructions of a compiled program in columnar form, as returned by
+Program.compile_to_schedule(). Each column is a flat array of 64-bit
+integers, so the schedule of large programs can be analyzed without
+creating an object per instruction. get_column() returns the columns as
+read-only NumPy arrays that refer directly to the data owned by this object,
+without copying it.
+
+The instructions of all blocks are concatenated in program order. The
+following columns exist:
+
+ - "type": index into get_instruction_types() for each instruction;
+ - "cycle": the cycle each instruction is scheduled in, relative to the
+   start of its block;
+ - "duration": the duration of each instruction in cycles;
+ - "operand_offset": one entry per instruction plus one, such that the qubit
+   operands of instruction i are at operand_offset[i] up to
+   operand_offset[i + 1] in the "operand" column;
+ - "operand": the indices of the qubits in the main qubit register that each
+   instruction operates on;
+ - "block_offset": one entry per block plus one, such that the instructions
+   of block i are at block_offset[i] up to block_offset[i + 1] in the other
+   columns.
+
+Structured control-flow statements and their bodies are not included.
+"""
+
+
+%feature("docstring") ql::api::Schedule::get_num_instructions
+"""
+Returns the number of instructions in the schedule.
+
+Parameters
+----------
+None
+
+Returns
+-------
+int
+    The number of instructions.
+"""
+
+
+%feature("docstring") ql::api::Schedule::get_num_blocks
+"""
+Returns the number of blocks in the schedule.
+
+Parameters
+----------
+None
+
+Returns
+-------
+int
+    The number of blocks.
+"""
+
+
+%feature("docstring") ql::api::Schedule::get_instruction_types
+"""
+Returns the names of the instruction types that the "type" column indexes
+into.
+
+Parameters
+----------
+None
+
+Returns
+-------
+List[str]
+    The instruction type names.
+"""
+
+
+%feature("docstring") ql::api::Schedule::get_block_names
+"""
+Returns the names of the blocks that the "block_offset" column delimits.
+
+Parameters
+----------
+None
+
+Returns
+-------
+List[str]
+    The block names.
+"""
+
+
+%feature("docstring") ql::api::Schedule::get_column_names
+"""
+Returns the names of the available columns.
+
+Parameters
+----------
+None
+
+Returns
+-------
+List[str]
+    The column names.
+"""
+
+
+// get_column() is reimplemented in Python on top of the raw buffer access
+// below, such that NumPy can use the data directly.
+%ignore ql::api::Schedule::get_column;
+
+%include "ql/api/schedule.h"
+
+%extend ql::api::Schedule {
+
+    size_t _get_column_address(const std::string &name) const {
+        return reinterpret_cast<size_t>($self->get_column(name).data());
+    }
+
+    size_t _get_column_size(const std::string &name) const {
+        return $self->get_column(name).size();
+    }
+
+    %pythoncode %{
+        def get_column(self, name):
+            """
+            Returns the column with the given name as a read-only NumPy array
+            of int64. The array refers directly to the data owned by this
+            object, which is kept alive for as long as the array exists.
+
+            Parameters
+            ----------
+            name : str
+                The name of the column, see get_column_names().
+
+            Returns
+            -------
+            numpy.ndarray
+                The column data.
+            """
+            import sys
+            import numpy
+            size = self._get_column_size(name)
+            if size == 0:
+                return numpy.zeros(0, dtype=numpy.int64)
+
+            class _Column(object):
+                def __init__(self, owner, address, size):
+                    self._owner = owner
+                    self.__array_interface__ = {
+                        'version': 3,
+                        'shape': (size,),
+                        'typestr': ('<' if sys.byteorder == 'little' else '>') + 'i8',
+                        'data': (address, True),
+                    }
+
+            return numpy.asarray(_Column(self, self._get_column_address(name), size))
+
+        def get_columns(self):
+            """
+            Returns all columns as a dict from column name to read-only NumPy
+            array, see get_column().
+
+            Parameters
+            ----------
+            None
+
+            Returns
+            -------
+            Dict[str, numpy.ndarray]
+                The column data.
+            """
+            return {name: self.get_column(name) for name in self.get_column_names()}
+    %}
+}
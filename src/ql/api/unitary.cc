@@ -35,6 +35,15 @@ void Unitary::decompose() {
     unitary->decompose();
 }
 
+/**
+ * Returns an upper bound on the operator norm of the error of the most recent
+ * decomposition of this gate, up to global phase. This is only nonzero when
+ * the unitary_tolerance option allowed rotations to be dropped.
+ */
+double Unitary::get_error_bound() const {
+    return unitary->get_error_bound();
+}
+
 /**
  * Returns whether OpenQL was built with unitary decomposition support
  * enabled.
@@ -29,6 +29,23 @@ None
 """
 
 
+%feature("docstring") ql::api::Unitary::get_error_bound
+"""
+Returns an upper bound on the operator norm of the error of the most recent
+decomposition of this gate, up to global phase. This is only nonzero when the
+unitary_tolerance option allowed rotations to be dropped.
+
+Parameters
+----------
+None
+
+Returns
+-------
+float
+    The error bound.
+"""
+
+
 %feature("docstring") ql::api::Unitary::is_decompose_support_enabled
 """
 Returns whether OpenQL was built with unitary decomposition support enabled.
@@ -23,37 +23,17 @@
 #include "backend.h"
 
 #include "ql/utils/str.h"
+#include "ql/utils/map.h"
+#include "ql/utils/pair.h"
 #include "ql/utils/filesystem.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/trace.h"
 #include "ql/ir/compat/platform.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/ir/old_to_new.h"
 #include "ql/com/options.h"
 
-#include <regex>
-
-
-// define classical QASM instructions as generated by classical.h
-// FIXME: should be moved to a more sensible location
-#define QASM_CLASSICAL_INSTRUCTION_LIST   \
-    X(QASM_ADD, "add") \
-    X(QASM_SUB, "sub") \
-    X(QASM_AND, "and") \
-    X(QASM_OR, "or")   \
-    X(QASM_XOR, "xor") \
-    X(QASM_NOT, "not") \
-    X(QASM_NOP, "nop") \
-    X(QASM_LDI, "ldi") \
-    X(QASM_MOV, "mov") \
-    X(QASM_EQ, "eq")   \
-    X(QASM_NE, "ne")   \
-    X(QASM_LT, "lt")   \
-    X(QASM_GT, "gt")   \
-    X(QASM_LE, "le")   \
-    X(QASM_GE, "ge")
-
-// generate constants for instructions
-#define X(_enum, _string) static const char *_enum = _string;
-QASM_CLASSICAL_INSTRUCTION_LIST
-#undef X
-
 
 namespace ql {
 namespace arch {
@@ -65,43 +45,183 @@ namespace detail {
 
 using namespace utils;
 
+// fingerprint of the scheduled contents of a kernel: kernels with the same fingerprint generate identical code
+Str Backend::kernelFingerprint(const Vec<Bundle> &bundles) {
+    StrStrm fp;
+    fp << std::hexfloat;                                                    // represent angles exactly
+    for (const auto &bundle : bundles) {
+        fp << "@" << bundle.startCycle << "+" << bundle.durationInCycles << ":";
+        for (const auto &gate : bundle.gates) {
+            fp << gate.name << "/" << gate.builtin
+               << "/" << gate.operands << gate.creg_operands << gate.breg_operands
+               << "/" << (Int)gate.condition << gate.cond_operands
+               << "/" << gate.angle << "/" << gate.durationInCycles << ";";
+        }
+    }
+    return fp.str();
+}
+
+
 // compile for Central Controller
-// NB: a new eqasm_backend_cc is instantiated per call to compile, so we don't need to cleanup
-void Backend::compile(const ir::compat::ProgramRef &program, const OptionsRef &options) {
-    QL_DOUT("Compiling " << program->kernels.size() << " kernels to generate Central Controller program ... ");
+// NB: a new Backend is instantiated per call to compile, so we don't need to cleanup
+void Backend::compile(const ir::Ref &root, const OptionsRef &options) {
+    QL_TRACE_SCOPE("cc.vq1asm.compile");
+    this->root = root;
+
+    // get the platform the code generator works on. If the IR was converted from the old IR, as is the case for
+    // programs built using the API, the original platform is attached to it
+    if (root->platform->has_annotation<ir::compat::PlatformRef>()) {
+        platform = root->platform->get_annotation<ir::compat::PlatformRef>();
+    } else {
+        platform = ir::compat::Platform::build(root->platform->name, root->platform->data.data);
+    }
+
+    // determine the objects that qubits, bregs and cregs map to, like the new-to-old IR conversion does
+    numQubits = ir::get_num_qubits(root);
+    bregObject = ir::find_physical_object(root, "breg");
+    cregObject = ir::find_physical_object(root, "creg");
+    numBregs = numQubits;
+    if (!bregObject.empty() && bregObject->shape.size() == 1) {
+        numBregs += bregObject->shape[0];
+    }
+    if (!root->program.empty() && root->program->has_annotation<ir::ObjectUsage>()) {
+        const auto &usage = root->program->get_annotation<ir::ObjectUsage>();
+        numQubits = usage.num_qubits;
+        numBregs = usage.num_bregs;
+    }
+    lookupKernel = ir::compat::KernelRef::make("lookup", platform, numQubits, 0, numBregs);
+
+    // collect the kernels and control-flow of the program. The blocks must be ordered linearly, since the only
+    // control-flow we support is structured
+    Str programName = "empty";
+    if (!root->program.empty()) {
+        programName = root->program->unique_name;
+        const auto &blocks = root->program->blocks;
+        for (UInt blockIdx = 0; blockIdx < blocks.size(); blockIdx++) {
+            if (
+                (blockIdx == 0 && !root->program->entry_point.links_to(blocks[0])) ||
+                (blockIdx + 1 < blocks.size() && !blocks[blockIdx]->next.links_to(blocks[blockIdx + 1])) ||
+                (blockIdx + 1 == blocks.size() && !blocks[blockIdx]->next.empty())
+            ) {
+                QL_FATAL("program has unsupported goto-based control-flow at block '" << blocks[blockIdx]->name << "'");
+            }
+            collectSections(blocks[blockIdx]);
+        }
+    }
+    UInt nrKernels = 0;
+    for (const auto &section : sections) {
+        if (section.type == Section::Type::KERNEL) nrKernels++;
+    }
+    QL_DOUT("Compiling " << nrKernels << " kernels to generate Central Controller program ... ");
 
     // init
-    loadHwSettings(program->platform);
-    codegen.init(program->platform, options);
+    loadHwSettings(platform);
+    codegen.init(platform, options);
     bundleIdx = 0;
 
     // generate program header
-    codegen.programStart(program->unique_name);
-
-    // generate code for all kernels
-    for (auto &kernel : program->kernels) {
-        QL_IOUT("Compiling kernel: " << kernel->name);
-        codegenKernelPrologue(kernel);
-
-        if (!kernel->gates.empty()) {
-            ir::compat::Bundles bundles = ir::compat::bundler(kernel);
-            codegen.kernelStart();
-            codegenBundles(bundles, program->platform);
-            codegen.kernelFinish(kernel->name, bundles.back().start_cycle+bundles.back().duration_in_cycles);
-        } else {
-            QL_DOUT("Empty kernel: " << kernel->name);                      // NB: normal situation for kernels with classical control
+    codegen.programStart(programName);
+
+    // bundle the kernels (and fingerprint them, for folding) concurrently, because that only depends on the kernel
+    // itself. The code is then generated in program order, since it shares state with the other kernels: datapath
+    // allocations, labels, and timing of the VCD output
+    Vec<UInt> kernelSections;
+    for (UInt sectionIdx = 0; sectionIdx < sections.size(); sectionIdx++) {
+        if (sections[sectionIdx].type == Section::Type::KERNEL) kernelSections.push_back(sectionIdx);
+    }
+    parallel_for(kernelSections.size(), options->num_threads, [&](UInt idx) {
+        Section &section = sections[kernelSections[idx]];
+        makeBundles(section);
+        if (options->fold_repeated_kernels) {
+            section.fingerprint = kernelFingerprint(section.bundles);
         }
+    });
+
+    // generate code for all sections
+    for (UInt sectionIdx = 0; sectionIdx < sections.size(); sectionIdx++) {
+        const Section &section = sections[sectionIdx];
+        switch (section.type) {
+            case Section::Type::KERNEL: {
+                QL_IOUT("Compiling kernel: " << section.name);
+                codegen.comment(QL_SS2S("### Kernel: '" << section.name << "'"));
+                if (section.bundles.empty()) {
+                    QL_DOUT("Empty kernel: " << section.name);
+                    break;
+                }
+                const Vec<Bundle> &bundles = section.bundles;
+                UInt durationInCycles = bundles.back().startCycle + bundles.back().durationInCycles;
+
+                // emit identical consecutive kernels once, inside a loop
+                UInt repeatCount = 1;
+                if (options->fold_repeated_kernels) {
+                    repeatCount = countRepeatedKernels(sectionIdx);
+                }
+                Str repeatLabel = QL_SS2S(section.name << "_repeat" << sectionIdx);    // NB: sectionIdx is the kernel index of the old IR
+                if (repeatCount > 1) {
+                    QL_IOUT("Kernel '" << section.name << "' is repeated " << repeatCount << " times, emitting it once");
+                    codegen.repeatStart(repeatLabel, repeatCount);
+                }
+
+                codegen.kernelStart(section.name);
+                codegenBundles(bundles);
+                codegen.kernelFinish(section.name, durationInCycles);
+
+                if (repeatCount > 1) {
+                    codegen.repeatFinish(repeatLabel, section.name, durationInCycles, repeatCount);
+                    sectionIdx += repeatCount - 1;                          // skip the kernels we folded
+                }
+                break;
+            }
+
+            case Section::Type::IF_START:
+                codegen.ifStart(section.op0, section.opName, section.op1);
+                break;
+
+            case Section::Type::ELSE_START:
+                codegen.elseStart(section.op0, section.opName, section.op1);
+                break;
+
+            case Section::Type::IF_END:
+            case Section::Type::ELSE_END:
+                // do nothing
+                break;
+
+            case Section::Type::FOR_START:
+                codegen.forStart(section.name, section.iterations);
+                break;
 
-        codegenKernelEpilogue(kernel);
+            case Section::Type::FOR_END:
+                codegen.forEnd(section.name);
+                break;
+
+            case Section::Type::DO_WHILE_START:
+                codegen.doWhileStart(section.name);
+                break;
+
+            case Section::Type::DO_WHILE_END:
+                codegen.doWhileEnd(section.name, section.op0, section.opName, section.op1);
+                break;
+        }
     }
 
-    codegen.programFinish(program->unique_name);
+    codegen.programFinish(programName);
 
     // write program to file
     Str file_name(options->output_prefix + ".vq1asm");
     QL_IOUT("Writing Central Controller program to " << file_name);
     OutFile(file_name).write(codegen.getProgram());
 
+    // write object code and symbols to file
+    if (options->object_output) {
+        Str file_name_obj(options->output_prefix + ".vq1obj");
+        QL_IOUT("Writing Central Controller object code to " << file_name_obj);
+        OutFile(file_name_obj, true).write(codegen.getObject());
+
+        Str file_name_sym(options->output_prefix + ".vq1sym");
+        QL_IOUT("Writing Central Controller symbols to " << file_name_sym);
+        OutFile(file_name_sym).write(codegen.getSymbols());
+    }
+
     // write instrument map to file (unless we were using input file)
     Str map_input_file = options->map_input_file;
     if (!map_input_file.empty()) {
@@ -114,247 +234,448 @@ void Backend::compile(const ir::compat::ProgramRef &program, const OptionsRef &o
 }
 
 
-// based on cc_light_eqasm_compiler.h::classical_instruction2qisa/decompose_instructions
-// NB: input instructions defined in classical.h::classical
-void Backend::codegenClassicalInstruction(const ir::compat::GateRef &classical_ins) {
-    auto &iname =  classical_ins->name;
-    auto &iopers = classical_ins->creg_operands;
-    UInt iopers_count = iopers.size();
-
-    if (
-        iname == QASM_ADD || iname == QASM_SUB ||
-        iname == QASM_AND || iname == QASM_OR  || iname == QASM_NOT || iname == QASM_XOR ||
-        iname == QASM_LDI || iname == QASM_MOV ||
-        iname == QASM_NOP
-    ) {
-        QL_FATAL("Classical instruction not implemented: " << iname);
-    } else if(
-        iname == QASM_EQ || iname == QASM_NE || iname == QASM_LT ||
-        iname == QASM_GT || iname == QASM_LE || iname == QASM_GE
-    ) {
-        QL_FATAL("Classical instruction not implemented: " << iname);
-    } else {
-        QL_FATAL("Unknown classical operation'" << iname << "' with'" << iopers_count << "' operands!");
-    }
-}
-
-
-/* get loop label from kernel name
- *
- * Program::add_for() and Program::add_do_while() generate kernels that wrap a program or kernel inside
- * a 'start' and 'end' kernel that only contain the looping information. The names of these added kernels are derived
- * from the name of the wrapped object by adding a suffix. Examples:
- * -    "program" results e.g. in "program_for3389_start" or "program_for3389_end"
- * -    "kernel" results e.g. in "kernel_do_while1_start" or "kernel_do_while1" (without "_end")
- *
- * This function obtains the stem name without the added suffix (e.g. '_for0_start') to use as a label to share between
- * the 'start' and 'end' code.
+/*
+ * Make a unique kernel name for (part of) a block: the name of the kernel it was converted from, or else the name of
+ * the block.
  *
  * Notes:
- * -    Other than the original in Kernel::get_epilogue, we extract the full stem, not only the part up to the first
- *      "_" to prevent duplicate labels if users choose to use names that are identical before the first "_"
- * -    numbering is performed using "static unsigned long phi_node_count = 0;" and thus persists over compiler invocations
+ * -    makeKernelName() is called in the same order as by the new-to-old IR conversion, such that kernels and loop
+ *      labels get the same names as they did when this backend consumed the old IR. Loop labels use the name of the
+ *      block containing the loop, like the stem of the name of the kernels added by Program::add_for() and
+ *      Program::add_do_while() did
  */
+Str Backend::makeKernelName(const ir::BlockBaseRef &block) {
+    Str name;
+    if (auto kn = block->get_annotation_ptr<ir::KernelName>()) {
+        name = kn->name;
+    } else if (auto b = block->as_block()) {
+        name = b->name;
+    }
+    if (!name.empty() && kernelNames.insert(name).second) {
+        return name;
+    }
+    for (UInt i = 1; true; i++) {
+        Str uniqueName = name + "_" + to_string(i);
+        if (kernelNames.insert(uniqueName).second) {
+            return uniqueName;
+        }
+    }
+}
 
-// FIXME: originally extracted from Kernel::get_epilogue, should be in a common place
 
-Str Backend::loopLabel(const ir::compat::KernelRef &k) {
-    Str label;
-    Str expr;
+// append the sections for a (sub)block to 'sections', recursing into structured control-flow
+void Backend::collectSections(const ir::BlockBaseRef &block) {
+    // make sure that the incoming code is scheduled, as expected
+    if (auto kcv = block->get_annotation_ptr<ir::KernelCyclesValid>()) {
+        if (!kcv->valid) {
+            throw Exception("The code going into the CC backend must be scheduled, but isn't!");
+        }
+    }
 
-    switch (k->type) {
-        case ir::compat::KernelType::FOR_START:
-            expr = "(.*)_for[0-9]+_start$";
-            break;
+    // cycles in a block start at zero, and kernels in the old IR started at ir::compat::FIRST_CYCLE. After structured
+    // control-flow, the first cycle encountered maps to ir::compat::FIRST_CYCLE, which is marked by MAX
+    Int cycleOffset = ir::compat::FIRST_CYCLE;
+    Bool inKernel = false;
+    for (UInt stmtIdx = 0; stmtIdx < block->statements.size(); stmtIdx++) {
+        const ir::StatementRef &stmt = block->statements[stmtIdx];
+        if (stmt->as_instruction()) {
+            if (!inKernel) {
+                Section section;
+                section.type = Section::Type::KERNEL;
+                section.name = makeKernelName(block);
+                section.block = block;
+                section.firstStatement = stmtIdx;
+                if (cycleOffset == MAX) {
+                    cycleOffset = ir::compat::FIRST_CYCLE - stmt->cycle;
+                }
+                section.cycleOffset = cycleOffset;
+                sections.push_back(section);
+                inKernel = true;
+            }
+            sections.back().lastStatement = stmtIdx + 1;
+
+        } else if (stmt->as_structured()) {
+            inKernel = false;
+            cycleOffset = MAX;
+
+            Section start;
+            Section end;
+            if (auto ifElse = stmt->as_if_else()) {
+                if (ifElse->branches.size() != 1) {
+                    QL_FATAL("if-else chains with multiple conditions are not supported");
+                }
+                start.type = Section::Type::IF_START;
+                start.name = makeKernelName(block);
+                convertClassicalCondition(ifElse->branches[0]->condition, false, start);
+                sections.push_back(start);
+                collectSections(ifElse->branches[0]->body);
+                end = start;
+                end.type = Section::Type::IF_END;
+                sections.push_back(end);
+                if (!ifElse->otherwise.empty()) {
+                    Section elseStart = start;
+                    elseStart.type = Section::Type::ELSE_START;
+                    elseStart.name = makeKernelName(block);
+                    sections.push_back(elseStart);
+                    collectSections(ifElse->otherwise);
+                    end = elseStart;
+                    end.type = Section::Type::ELSE_END;
+                    sections.push_back(end);
+                }
+
+            } else if (auto staticLoop = stmt->as_static_loop()) {
+                start.type = Section::Type::FOR_START;
+                start.name = makeKernelName(block);
+                start.iterations = abs<Int>(staticLoop->to->value - staticLoop->frm->value) + 1;
+                sections.push_back(start);
+
+                // NB: Program::add_for() adds an empty kernel named after the loop body before it
+                Section empty;
+                empty.type = Section::Type::KERNEL;
+                empty.name = start.name;
+                empty.block = staticLoop->body;
+                empty.firstStatement = 0;
+                empty.lastStatement = 0;
+                empty.cycleOffset = ir::compat::FIRST_CYCLE;
+                sections.push_back(empty);
+
+                collectSections(staticLoop->body);
+                end.type = Section::Type::FOR_END;
+                end.name = start.name;
+                sections.push_back(end);
+
+            } else if (auto repeatUntilLoop = stmt->as_repeat_until_loop()) {
+                start.type = Section::Type::DO_WHILE_START;
+                start.name = makeKernelName(block);
+                sections.push_back(start);
+                collectSections(repeatUntilLoop->body);
+                end.type = Section::Type::DO_WHILE_END;
+                end.name = start.name;
+                convertClassicalCondition(repeatUntilLoop->condition, true, end);   // NB: do-while condition is the inverse
+                sections.push_back(end);
 
-        case ir::compat::KernelType::FOR_END:
-            expr = "(.*)_for[0-9]+_end$";
-            break;
+            } else {
+                QL_FATAL("unsupported structured control-flow statement: " << ir::describe(stmt));
+            }
 
-        case ir::compat::KernelType::DO_WHILE_START:
-            expr = "(.*)_do_while[0-9]+_start$";
-            break;
+        } else {
+            QL_FATAL("unsupported statement: " << ir::describe(stmt));
+        }
+    }
+}
 
-        case ir::compat::KernelType::DO_WHILE_END:
-            expr = "(.*)_do_while[0-9]+$";  // NB: there is no "_end" here, see quantum_program::add_do_while()
-            break;
 
-        default:
-            QL_FATAL("internal inconsistency: requesting kernel label for kernel type " << (int)k->type);
+// add an operand of a custom instruction to the gate, like the new-to-old IR conversion does
+void Backend::convertOperand(const ir::ExpressionRef &expr, Gate &gate) const {
+    if (auto realLit = expr->as_real_literal()) {
+        gate.angle = realLit->value;
+    } else if (expr->as_int_literal()) {
+        // NB: integer operands are not used by the CC backend
+    } else if (auto ref = expr->as_reference()) {
+        if (ref->indices.size() != 1 || !ref->indices[0]->as_int_literal()) {
+            QL_FATAL("unsupported reference to '" << ref->target->name << "' in operands of '" << gate.name << "'");
+        }
+        UInt index = ref->indices[0]->as_int_literal()->value;
+        if (ref->target == root->platform->qubits && ref->data_type == root->platform->qubits->data_type) {
+            gate.operands.push_back(index);
+        } else if (ref->target == root->platform->qubits && ref->data_type == root->platform->default_bit_type) {
+            gate.breg_operands.push_back(index);
+        } else if (ref->target == bregObject && ref->data_type == bregObject->data_type) {
+            gate.breg_operands.push_back(index + numQubits);
+        } else if (ref->target == cregObject && ref->data_type == cregObject->data_type) {
+            gate.creg_operands.push_back(index);
+        } else {
+            QL_FATAL("unsupported reference to '" << ref->target->name << "' in operands of '" << gate.name << "'");
+        }
+    } else {
+        QL_FATAL("unsupported operand " << ir::describe(expr) << " for '" << gate.name << "'");
     }
+}
 
-    std::regex re(expr, std::regex_constants::egrep);   // FIXME: we are reverse engineering the naming scheme of quantum_program::add_*
-    const int numMatch = 1+1;		// NB: +1 because index 0 contains full input match
-    std::smatch match;
-    if(std::regex_search(k->name, match, re) && match.size() == numMatch) {
-        label = match.str(1);
-    } else {
-        QL_FATAL("internal inconsistency: kernel name '" << k->name << "' does not contain loop suffix");
+
+// convert a bit reference to its breg index
+UInt Backend::convertBregReference(const ir::ExpressionRef &expr) const {
+    Gate gate;
+    convertOperand(expr, gate);
+    if (gate.breg_operands.size() != 1 || !gate.operands.empty() || !gate.creg_operands.empty()) {
+        QL_FATAL("expected bit reference, but got " << ir::describe(expr));
     }
+    return gate.breg_operands[0];
+}
+
 
-    QL_IOUT("kernel '" << k->name << "' gets label '" << label << "'");
-    return label;
+// convert a creg reference to its creg index
+UInt Backend::convertCregReference(const ir::ExpressionRef &expr) const {
+    Gate gate;
+    convertOperand(expr, gate);
+    if (gate.creg_operands.size() != 1 || !gate.operands.empty() || !gate.breg_operands.empty()) {
+        QL_FATAL("expected creg reference, but got " << ir::describe(expr));
+    }
+    return gate.creg_operands[0];
 }
 
 
-// handle kernel conditionality at beginning of kernel
-// based on cc_light_eqasm_compiler.h::get_prologue
-void Backend::codegenKernelPrologue(const ir::compat::KernelRef &k) {
-    codegen.comment(QL_SS2S("### Kernel: '" << k->name << "'"));
+// convert the condition of a conditional instruction to a condition type and operands, like the new-to-old IR
+// conversion does
+void Backend::convertGateCondition(const ir::ExpressionRef &expr, Gate &gate) const {
+    using ir::compat::ConditionType;
 
-    switch (k->type) {
-        case ir::compat::KernelType::IF_START: {
-            auto op0 = k->br_condition->operands[0]->as_register().id;
-            auto op1 = k->br_condition->operands[1]->as_register().id;
-            auto opName = k->br_condition->operation_name;
-            codegen.ifStart(op0, opName, op1);
-            break;
-        }
+    gate.cond_operands.clear();
+    if (auto bitLit = expr->as_bit_literal()) {
+        gate.condition = bitLit->value ? ConditionType::ALWAYS : ConditionType::NEVER;
+        return;
+    } else if (expr->as_reference()) {
+        gate.cond_operands.push_back(convertBregReference(expr));
+        gate.condition = ConditionType::UNARY;
+        return;
+    }
 
-        case ir::compat::KernelType::ELSE_START: {
-            auto op0 = k->br_condition->operands[0]->as_register().id;
-            auto op1 = k->br_condition->operands[1]->as_register().id;
-            auto opName = k->br_condition->operation_name;
-            codegen.elseStart(op0, opName, op1);
-            break;
+    auto fn = expr->as_function_call();
+    if (!fn) {
+        QL_FATAL("unsupported gate condition: " << ir::describe(expr));
+    }
+    const Str &fnName = fn->function_type->name;
+    if ((fnName == "operator!" || fnName == "operator~") && fn->operands.size() == 1) {
+        if (fn->operands[0]->as_reference()) {
+            gate.cond_operands.push_back(convertBregReference(fn->operands[0]));
+            gate.condition = ConditionType::NOT;
+            return;
         }
-
-        case ir::compat::KernelType::FOR_START: {
-            codegen.forStart(loopLabel(k), k->iteration_count);
-            break;
+        auto fn2 = fn->operands[0]->as_function_call();
+        if (fn2 && fn2->operands.size() == 2) {
+            const Str &fn2Name = fn2->function_type->name;
+            gate.cond_operands.push_back(convertBregReference(fn2->operands[0]));
+            gate.cond_operands.push_back(convertBregReference(fn2->operands[1]));
+            if (fn2Name == "operator&" || fn2Name == "operator&&") {
+                gate.condition = ConditionType::NAND;
+                return;
+            } else if (fn2Name == "operator|" || fn2Name == "operator||") {
+                gate.condition = ConditionType::NOR;
+                return;
+            } else if (fn2Name == "operator^" || fn2Name == "operator^^" || fn2Name == "operator!=") {
+                gate.condition = ConditionType::NXOR;
+                return;
+            } else if (fn2Name == "operator==") {
+                gate.condition = ConditionType::XOR;
+                return;
+            }
         }
-
-        case ir::compat::KernelType::DO_WHILE_START: {
-            codegen.doWhileStart(loopLabel(k));
-            break;
+    } else if (fn->operands.size() == 2) {
+        gate.cond_operands.push_back(convertBregReference(fn->operands[0]));
+        gate.cond_operands.push_back(convertBregReference(fn->operands[1]));
+        if (fnName == "operator&" || fnName == "operator&&") {
+            gate.condition = ConditionType::AND;
+            return;
+        } else if (fnName == "operator|" || fnName == "operator||") {
+            gate.condition = ConditionType::OR;
+            return;
+        } else if (fnName == "operator^" || fnName == "operator^^" || fnName == "operator!=") {
+            gate.condition = ConditionType::XOR;
+            return;
+        } else if (fnName == "operator==") {
+            gate.condition = ConditionType::NXOR;
+            return;
         }
+    }
+    QL_FATAL("unsupported gate condition: " << ir::describe(expr));
+}
 
-        case ir::compat::KernelType::STATIC:
-        case ir::compat::KernelType::FOR_END:
-        case ir::compat::KernelType::DO_WHILE_END:
-        case ir::compat::KernelType::IF_END:
-        case ir::compat::KernelType::ELSE_END:
-            // do nothing
-            break;
 
-        default:
-            QL_FATAL("inconsistency detected: unhandled kernel type");
-            break;
+// convert the condition of structured control-flow to the register comparison used by the Codegen functions for
+// classical operations on kernels
+void Backend::convertClassicalCondition(const ir::ExpressionRef &expr, Bool invert, Section &section) const {
+    auto fn = expr->as_function_call();
+    if (!fn || fn->operands.size() != 2) {
+        QL_FATAL("expected classical relational operator, but got " << ir::describe(expr));
     }
+    const Str &fnName = fn->function_type->name;
+    if (fnName == "operator==") {
+        section.opName = invert ? "!=" : "==";
+    } else if (fnName == "operator!=") {
+        section.opName = invert ? "==" : "!=";
+    } else if (fnName == "operator<") {
+        section.opName = invert ? ">=" : "<";
+    } else if (fnName == "operator<=") {
+        section.opName = invert ? ">" : "<=";
+    } else if (fnName == "operator>") {
+        section.opName = invert ? "<=" : ">";
+    } else if (fnName == "operator>=") {
+        section.opName = invert ? "<" : ">=";
+    } else {
+        QL_FATAL("expected classical relational operator, but got " << ir::describe(expr));
+    }
+    section.op0 = convertCregReference(fn->operands[0]);
+    section.op1 = convertCregReference(fn->operands[1]);
 }
 
 
-// handle kernel conditionality at end of kernel
-// based on cc_light_eqasm_compiler.h::get_epilogue
-void Backend::codegenKernelEpilogue(const ir::compat::KernelRef &k) {
-    switch (k->type) {
-        case ir::compat::KernelType::FOR_END: {
-            codegen.forEnd(loopLabel(k));
-            break;
-        }
+// convert the statements of a kernel section to bundles, like ir::compat::bundler() did for the old IR
+// NB: called concurrently for different sections, so must not modify shared state
+void Backend::makeBundles(Section &section) const {
+    // the custom gates resolved thus far, per instruction type and qubit operands
+    Map<Pair<const ir::InstructionType*, Vec<UInt>>, const ir::compat::gate_types::Custom*> customGates;
 
-        case ir::compat::KernelType::DO_WHILE_END: {
-            auto op0 = k->br_condition->operands[0]->as_register().id;
-            auto op1 = k->br_condition->operands[1]->as_register().id;
-            auto opName = k->br_condition->operation_name;
-            codegen.doWhileEnd(loopLabel(k), op0, opName, op1);
-            break;
+    for (UInt stmtIdx = section.firstStatement; stmtIdx < section.lastStatement; stmtIdx++) {
+        const ir::StatementRef &stmt = section.block->statements[stmtIdx];
+
+        // NB: the "wait" instruction never makes it into the bundle. It is accounted for in scheduling though,
+        // and if a non-zero duration is specified that duration is reflected in the cycle of the subsequent instruction
+        if (stmt->as_wait_instruction()) {
+            continue;
+        }
+        auto custom = stmt->as_custom_instruction();
+        if (!custom) {
+            if (stmt->as_set_instruction()) {
+                QL_FATAL("Classical instruction not implemented: " << ir::describe(stmt));
+            }
+            QL_FATAL("Unsupported instruction: " << ir::describe(stmt));
         }
 
-        case ir::compat::KernelType::IF_END:
-        case ir::compat::KernelType::ELSE_END:
-            // do nothing
-            break;
+        // convert the instruction
+        Gate gate;
+        gate.name = custom->instruction_type->name;
+        gate.angle = 0.0;
+        gate.durationInCycles = ir::get_duration_of_statement(stmt);
+        for (const auto &op : custom->instruction_type->template_operands) {
+            convertOperand(op, gate);
+        }
+        for (const auto &op : custom->operands) {
+            convertOperand(op, gate);
+        }
+        convertGateCondition(custom->condition, gate);
+
+        // like Kernel::gate_add_implicits(), measurements without bit operand implicitly write the bit of their qubit
+        if (
+            (gate.name == "measure" || gate.name == "measx" || gate.name == "measz") &&
+            gate.breg_operands.empty() && !gate.operands.empty() && gate.operands[0] < numBregs
+        ) {
+            gate.breg_operands.push_back(gate.operands[0]);
+        }
 
-        case ir::compat::KernelType::STATIC:
-        case ir::compat::KernelType::IF_START:
-        case ir::compat::KernelType::ELSE_START:
-        case ir::compat::KernelType::FOR_START:
-        case ir::compat::KernelType::DO_WHILE_START:
-            // do nothing
-            break;
+        // look up the custom gate of the platform, which may be specialized for the qubit operands (e.g.
+        // "sf_cz_ne q2"), in which case its name includes the operands. Gates that the platform decomposes are
+        // not handled here, and gates that it doesn't define at all are builtin gates
+        Pair<const ir::InstructionType*, Vec<UInt>> key{custom->instruction_type.get_ptr().get(), gate.operands};
+        auto it = customGates.find(key);
+        if (it == customGates.end()) {
+            it = customGates.insert({key, lookupKernel->find_direct_custom_gate(to_lower(gate.name), gate.operands)}).first;
+        }
+        if (it->second) {
+            gate.name = it->second->name;
+            gate.builtin = false;
+        } else if (platform->has_instruction(gate.name)) {
+            QL_FATAL(
+                "no CC definition for instruction " << ir::describe(stmt) << ": gates that the platform "
+                "decomposes must be decomposed before code generation, using dec.Instructions"
+            );
+        } else {
+            gate.builtin = true;
+        }
 
-        default:
-            QL_FATAL("inconsistency detected: unhandled kernel type");
-            break;
+        // add it to the current bundle, or start a new one
+        UInt startCycle = stmt->cycle + section.cycleOffset;
+        if (section.bundles.empty() || startCycle > section.bundles.back().startCycle) {
+            section.bundles.push_back({startCycle, 0, {}});
+        } else if (startCycle < section.bundles.back().startCycle) {
+            QL_FATAL("Error: circuit not ordered by cycle value");
+        }
+        Bundle &bundle = section.bundles.back();
+        bundle.durationInCycles = max(bundle.durationInCycles, gate.durationInCycles);
+        bundle.gates.push_back(std::move(gate));
     }
 }
 
 
 // based on cc_light_eqasm_compiler.h::bundles2qisa()
-void Backend::codegenBundles(ir::compat::Bundles &bundles, const ir::compat::PlatformRef &platform) {
+void Backend::codegenBundles(const Vec<Bundle> &bundles) {
     QL_IOUT("Generating .vq1asm for bundles");
 
     for (const auto &bundle : bundles) {
         // generate bundle header
-        QL_DOUT(QL_SS2S("Bundle " << bundleIdx << ": start_cycle=" << bundle.start_cycle << ", duration_in_cycles=" << bundle.duration_in_cycles));
+        QL_DOUT(QL_SS2S("Bundle " << bundleIdx << ": start_cycle=" << bundle.startCycle << ", duration_in_cycles=" << bundle.durationInCycles));
         codegen.bundleStart(QL_SS2S(
             "## Bundle " << bundleIdx++
-            << ": start_cycle=" << bundle.start_cycle
-            << ", duration_in_cycles=" << bundle.duration_in_cycles << ":"
+            << ": start_cycle=" << bundle.startCycle
+            << ", duration_in_cycles=" << bundle.durationInCycles << ":"
         ));
-        // NB: the "wait" instruction never makes it into the bundle. It is accounted for in scheduling though,
-        // and if a non-zero duration is specified that duration is reflected in 'start_cycle' of the subsequent instruction
 
         // generate code for this bundle
-        for (const auto &instr : bundle.gates) {
-            // check whether section defines classical gate
-            if (instr->type() == ir::compat::GateType::CLASSICAL) {
-                QL_DOUT(QL_SS2S("Classical bundle: instr='" << instr->name << "'"));
-                codegenClassicalInstruction(instr);
+        for (const auto &gate : bundle.gates) {
+            QL_DOUT(QL_SS2S("Bundle section: instr='" << gate.name << "'"));
+            if (gate.builtin) {
+                if (gate.name == "nop") {               // a quantum "nop", see gate.h
+                    codegen.nopGate();
+                } else {
+                    QL_FATAL("Unsupported builtin gate: '" << gate.name << "'");
+                }
             } else {
-                ir::compat::GateType itype = instr->type();
-                Str iname = instr->name;
-                QL_DOUT(QL_SS2S("Bundle section: instr='" << iname << "'"));
-
-                switch (itype) {
-                    case ir::compat::GateType::NOP:       // a quantum "nop", see gate.h
-                        codegen.nopGate();
-                        break;
-
-                    case ir::compat::GateType::CLASSICAL:
-                        QL_FATAL("Inconsistency detected in bundle contents: classical gate found after first section (which itself was non-classical)");
-                        break;
-
-                    case ir::compat::GateType::CUSTOM:
-                        QL_DOUT(QL_SS2S("Custom gate: instr='" << iname << "'" << ", duration=" << instr->duration) << " ns");
-                        codegen.customGate(
-                            iname,
-                            instr->operands,            // qubit operands (FKA qops)
-                            instr->creg_operands,        // classic operands (FKA cops)
-                            instr->breg_operands,         // bit operands e.g. assigned to by measure
-                            instr->condition,
-                            instr->cond_operands,        // 0, 1 or 2 bit operands of condition
-                               instr->angle,
-                               bundle.start_cycle, platform->time_to_cycles(instr->duration)
-                        );
-                        break;
-
-                    case ir::compat::GateType::DISPLAY:
-                        QL_FATAL("Gate type __display__ not supported");           // QX specific, according to openql.pdf
-                        break;
-
-                    case ir::compat::GateType::MEASURE:
-                        QL_FATAL("Gate type __measure_gate__ not supported");      // no use, because there is no way to define CC-specifics
-                        break;
-
-                    default:
-                        QL_FATAL(
-                            "Unsupported builtin gate, type: " << itype
-                            << ", instruction: '" << instr->qasm() << "'");
-                }   // switch(itype)
+                QL_DOUT(QL_SS2S("Custom gate: instr='" << gate.name << "'" << ", duration=" << gate.durationInCycles) << " cycles");
+                codegen.customGate(
+                    gate.name,
+                    gate.operands,                      // qubit operands (FKA qops)
+                    gate.creg_operands,                 // classic operands (FKA cops)
+                    gate.breg_operands,                 // bit operands e.g. assigned to by measure
+                    gate.condition,
+                    gate.cond_operands,                 // 0, 1 or 2 bit operands of condition
+                    gate.angle,
+                    bundle.startCycle, gate.durationInCycles
+                );
             }
         }
 
-        // generate bundle trailer, and code for classical gates
-        Bool isLastBundle = &bundle == &bundles.back();
-        codegen.bundleFinish(bundle.start_cycle, bundle.duration_in_cycles, isLastBundle);
+        // generate bundle trailer
+        Bool isLastBundle = bundle.startCycle == bundles.back().startCycle;   // NB: start cycles are strictly increasing
+        codegen.bundleFinish(bundle.startCycle, bundle.durationInCycles, isLastBundle);
     }   // for(bundles)
 
     QL_IOUT("Generating .vq1asm for bundles [Done]");
 }
 
 
+// determine whether the code generated for a kernel only depends on the kernel itself
+Bool Backend::isRepeatable(const Vec<Bundle> &bundles) {
+    for (const auto &bundle : bundles) {
+        for (const auto &gate : bundle.gates) {
+            if (gate.builtin || gate.condition != ir::compat::ConditionType::ALWAYS) {
+                return false;
+            }
+            if (!codegen.isRepeatable(gate.name)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * Count the number of consecutive kernels, starting at section sectionIdx, that generate identical code to that of
+ * the kernel at sectionIdx, such that they can be emitted once inside a loop. The fingerprints of the kernels must
+ * have been computed beforehand. Only kernels whose code does not depend on state outside the kernel (see
+ * isRepeatable()) are considered. Calibration programs typically consist of many of these.
+ *
+ * Returns 1 if the kernel is not followed by identical kernels, or cannot be folded.
+ */
+UInt Backend::countRepeatedKernels(UInt sectionIdx) {
+    if (!isRepeatable(sections[sectionIdx].bundles)) {
+        return 1;
+    }
+    const Str &fp = sections[sectionIdx].fingerprint;
+    UInt count = 1;
+    while (sectionIdx + count < sections.size()) {
+        const Section &next = sections[sectionIdx + count];
+        if (next.type != Section::Type::KERNEL || next.bundles.empty()) {
+            break;
+        }
+        if (next.fingerprint != fp) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+
 // based on: cc_light_eqasm_compiler.h::loadHwSettings
 void Backend::loadHwSettings(const ir::compat::PlatformRef &platform) {
 #if 0   // FIXME: currently unused, may be of future use
@@ -379,7 +700,7 @@ void Backend::loadHwSettings(const ir::compat::PlatformRef &platform) {
     UInt i = 0;
     try {
         for (i = 0; i < ELEM_CNT(hw_settings); i++) {
-            UInt val = platform.hardware_settings[hw_settings[i].name].get<UInt>();
+            UInt val = platform.get_hardware_settings()[hw_settings[i].name].get<UInt>();
             *hw_settings[i].var = val;
         }
     } catch (Json::exception &e) {
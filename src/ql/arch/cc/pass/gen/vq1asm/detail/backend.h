@@ -10,6 +10,8 @@
 
 #include "types.h"
 
+#include "ql/utils/set.h"
+#include "ql/ir/ir.h"
 #include "ql/ir/compat/compat.h"
 #include "options.h"
 #include "codegen.h"
@@ -26,19 +28,83 @@ class Backend {
 public:
     Backend() = default;
 
-    void compile(const ir::compat::ProgramRef &program, const OptionsRef &options);
+    void compile(const ir::Ref &root, const OptionsRef &options);
+
+private: // types
+    // a custom instruction, with its operands decoded from the new IR into the form used by Codegen::customGate()
+    struct Gate {
+        Str name;
+        Bool builtin;                               // not defined by the platform, i.e. generated by OpenQL itself
+        Vec<UInt> operands;                         // qubit operands
+        Vec<UInt> creg_operands;                    // classic operands
+        Vec<UInt> breg_operands;                    // bit operands, NB: the first numQubits bits are the implicit qubit bits
+        ir::compat::ConditionType condition;
+        Vec<UInt> cond_operands;                    // 0, 1 or 2 bit operands of condition
+        Real angle;
+        UInt durationInCycles;
+    };
+
+    // the gates starting in the same cycle
+    struct Bundle {
+        UInt startCycle;                            // NB: starts at ir::compat::FIRST_CYCLE, like in the old IR
+        UInt durationInCycles;
+        Vec<Gate> gates;
+    };
+
+    // the program in code generation order: kernels, i.e. runs of instructions within a block that are not interrupted
+    // by structured control-flow, and the start and end of the structured control-flow around them. NB: the sections
+    // correspond one-to-one to the kernels that the new-to-old IR conversion generated, such that section indices can
+    // be used where kernel indices were used before
+    struct Section {
+        enum class Type { KERNEL, IF_START, IF_END, ELSE_START, ELSE_END, FOR_START, FOR_END, DO_WHILE_START, DO_WHILE_END };
+
+        Type type;
+        Str name;                                   // kernel name, or label for loops
+
+        // KERNEL
+        ir::BlockBaseRef block;
+        UInt firstStatement;                        // range of statements of block that make up the kernel
+        UInt lastStatement;
+        Int cycleOffset;                            // offset from cycles in block to Bundle::startCycle
+        Vec<Bundle> bundles;                        // filled by makeBundles()
+        Str fingerprint;                            // idem, if options->fold_repeated_kernels
+
+        // FOR_START
+        UInt iterations;
+
+        // IF_START, ELSE_START, DO_WHILE_END
+        UInt op0;
+        Str opName;
+        UInt op1;
+    };
 
 private:
-    static Str loopLabel(const ir::compat::KernelRef &k);
-    void codegenClassicalInstruction(const ir::compat::GateRef &classical_ins);
-    void codegenKernelPrologue(const ir::compat::KernelRef &k);
-    void codegenKernelEpilogue(const ir::compat::KernelRef &k);
-    void codegenBundles(ir::compat::Bundles &bundles, const ir::compat::PlatformRef &platform);
+    static Str kernelFingerprint(const Vec<Bundle> &bundles);
+    Str makeKernelName(const ir::BlockBaseRef &block);
+    void collectSections(const ir::BlockBaseRef &block);
+    void convertOperand(const ir::ExpressionRef &expr, Gate &gate) const;
+    UInt convertBregReference(const ir::ExpressionRef &expr) const;
+    UInt convertCregReference(const ir::ExpressionRef &expr) const;
+    void convertGateCondition(const ir::ExpressionRef &expr, Gate &gate) const;
+    void convertClassicalCondition(const ir::ExpressionRef &expr, Bool invert, Section &section) const;
+    void makeBundles(Section &section) const;
+    void codegenBundles(const Vec<Bundle> &bundles);
+    Bool isRepeatable(const Vec<Bundle> &bundles);
+    UInt countRepeatedKernels(UInt sectionIdx);
     void loadHwSettings(const ir::compat::PlatformRef &platform);
 
 private: // vars
     Codegen codegen;
     Int bundleIdx;
+    ir::Ref root;
+    ir::compat::PlatformRef platform;
+    ir::compat::KernelRef lookupKernel;             // used to look up custom gates like the new-to-old IR conversion does
+    UInt numQubits;
+    UInt numBregs;                                  // including the implicit qubit bits
+    ir::ObjectLink bregObject;                      // the object used for bregs from numQubits onwards, if any
+    ir::ObjectLink cregObject;                      // the object used for cregs, if any
+    Vec<Section> sections;
+    utils::Set<Str> kernelNames;                    // names used thus far by makeKernelName()
 }; // class
 
 } // namespace detail
@@ -34,6 +34,7 @@ void Codegen::init(const ir::compat::PlatformRef &platform, const OptionsRef &op
     this->platform = platform;
     this->options = options;
     settings.loadBackendSettings(platform);
+    settings.buildLookupTables();
 
     // optionally preload codewordTable
     Str map_input_file = options->map_input_file;
@@ -47,7 +48,7 @@ void Codegen::init(const ir::compat::PlatformRef &platform, const OptionsRef &op
 #if OPT_FEEDBACK
     // iterate over instruments
     for (UInt instrIdx = 0; instrIdx < settings.getInstrumentsSize(); instrIdx++) {
-        const Settings::InstrumentControl ic = settings.getInstrumentControl(instrIdx);
+        const Settings::InstrumentControl &ic = settings.getInstrumentControl(instrIdx);
         if (QL_JSON_EXISTS(ic.controlMode, "result_bits")) {  // this instrument mode produces results (i.e. it is a measurement device)
             QL_IOUT("instrument '" << ic.ii.instrumentName << "' (index " << instrIdx << ") is used for feedback");
         }
@@ -57,12 +58,24 @@ void Codegen::init(const ir::compat::PlatformRef &platform, const OptionsRef &op
 
 Str Codegen::getProgram() {
 #if OPT_FEEDBACK
-    return codeSection.str() + dp.getDatapathSection();
+    return codeSection + dp.getDatapathSection();
 #else
-    return codeSection.str();
+    return codeSection;
 #endif
 }
 
+Str Codegen::getObject() {
+#if OPT_FEEDBACK
+    return objectCode.getObject(dp.getDatapathSection());
+#else
+    return objectCode.getObject("");
+#endif
+}
+
+Str Codegen::getSymbols() {
+    return objectCode.getSymbols();
+}
+
 Str Codegen::getMap() {
     Json map;
 
@@ -81,7 +94,7 @@ void Codegen::programStart(const Str &progName) {
 
     dp.programStart();
 
-    vcd.programStart(platform->qubit_count, platform->cycle_time, MAX_GROUPS, settings);
+    vcd.programStart(platform->qubit_count, platform->cycle_time, MAX_GROUPS, settings, options->output_prefix + ".vcd");
 }
 
 
@@ -90,19 +103,61 @@ void Codegen::programFinish(const Str &progName) {
 
     dp.programFinish();
 
-    vcd.programFinish(options->output_prefix + ".vcd");
+    vcd.programFinish();
 }
 
 /************************************************************************\
 | 'Kernel' level functions
 \************************************************************************/
 
-void Codegen::kernelStart() {
+void Codegen::kernelStart(const Str &kernelName) {
     for (UInt i=0; i<ELEM_CNT(lastEndCycle); i++) lastEndCycle[i] = ir::compat::FIRST_CYCLE;
+    vcd.kernelStart(kernelName);
 }
 
 void Codegen::kernelFinish(const Str &kernelName, UInt durationInCycles) {
-    vcd.kernelFinish(kernelName, durationInCycles);
+    vcd.kernelFinish(durationInCycles);
+}
+
+/*
+    Identical consecutive kernels can be emitted once inside a loop, instead of
+    generating the same code for every instance. This is possible because timing
+    starts anew for every kernel (see kernelStart()), and the last bundle pads
+    all outputs to the end of the kernel. It is not possible if the code depends on
+    state outside the kernel, i.e. the datapath (feedback, conditional gates) or
+    loop labels (pragmas), see isRepeatable() and Backend::isRepeatable()
+
+    - repeatStart():
+    emit loop header, before kernelStart()
+
+    - repeatFinish():
+    emit loop trailer, after kernelFinish(), and repeat the VCD output of the kernel
+*/
+
+// determine whether the code generated for an unconditional custom gate only depends on the kernel itself
+Bool Codegen::isRepeatable(const Str &iname) {
+    if (settings.isPragma(iname)) {
+        return false;
+    }
+    if (settings.isReadout(iname) && settings.getReadoutMode(iname) == "feedback") {
+        return false;
+    }
+    return true;
+}
+
+void Codegen::repeatStart(const Str &label, UInt count) {
+    comment(QL_SS2S("# REPEAT_START(" << count << ")"));
+    // FIXME: reserve register
+    emit("", "move", QL_SS2S(count << ",R61"), "# R61 is the 'kernel repeat counter'");
+    emit((label+":"), "", "", "# ");
+}
+
+void Codegen::repeatFinish(const Str &label, const Str &kernelName, UInt durationInCycles, UInt count) {
+    comment("# REPEAT_END");
+    emit("", "loop", QL_SS2S("R61,@" << label), "# R61 is the 'kernel repeat counter'");
+
+    // the first instance was already handled by kernelFinish()
+    vcd.kernelRepeat(kernelName, durationInCycles, count - 1);
 }
 
 /************************************************************************\
@@ -131,7 +186,7 @@ void Codegen::bundleStart(const Str &cmnt) {
     bundleInfo.clear();
     BundleInfo empty;
     for (UInt instrIdx = 0; instrIdx < settings.getInstrumentsSize(); instrIdx++) {
-        const Settings::InstrumentControl ic = settings.getInstrumentControl(instrIdx);
+        const Settings::InstrumentControl &ic = settings.getInstrumentControl(instrIdx);
         bundleInfo.emplace_back(
             ic.controlModeGroupCnt,     // one BundleInfo per group in the control mode selected for instrument
             empty                       // empty BundleInfo
@@ -157,7 +212,8 @@ static CalcGroupDigOut calcGroupDigOut(
     UInt group,
     UInt nrGroups,
     const Settings::InstrumentControl &ic,
-    Codeword staticCodewordOverride
+    Codeword staticCodewordOverride,
+    Bool withComment
 ) {
     CalcGroupDigOut ret{0, ""};
 
@@ -182,20 +238,14 @@ static CalcGroupDigOut calcGroupDigOut(
         );
     }
 
-    // get number of control bits for group
-    const Json &groupControlBits = ic.controlMode["control_bits"][controlModeGroup];    // NB: tests above guarantee existence
-    QL_DOUT(
-        "instrumentName=" << ic.ii.instrumentName
-        << ", slot=" << ic.ii.slot
-        << ", control mode group=" << controlModeGroup
-        << ", group control bits: " << groupControlBits
-    );
-    UInt nrGroupControlBits = groupControlBits.size();
+    // get bit layout for group, as precomputed by Settings
+    const Settings::ControlGroupBits &cgb = ic.controlGroupBits[controlModeGroup];    // NB: tests above guarantee existence
+    UInt nrGroupControlBits = cgb.codewordBits.size();
 
 
     // calculate digital output for group
     if (nrGroupControlBits == 1) {       // single bit, implying this is a mask (not code word)
-        ret.groupDigOut |= 1ul << groupControlBits[0].get<Int>();     // NB: we assume the mask is active high, which is correct for VSM and UHF-QC
+        ret.groupDigOut |= 1ul << cgb.codewordBits[0];     // NB: we assume the mask is active high, which is correct for VSM and UHF-QC
         // FIXME: check controlModeGroup vs group
     } else if (nrGroupControlBits > 1) {                 // > 1 bit, implying code word
 #if OPT_VECTOR_MODE
@@ -216,21 +266,27 @@ static CalcGroupDigOut calcGroupDigOut(
 #endif
 
         // convert codeword to digOut
-        for (size_t idx=0; idx<nrGroupControlBits; idx++) {
-            Int codeWordBit = nrGroupControlBits - 1 - idx;    // NB: groupControlBits defines MSB..LSB
-            if (codeword & (1ul << codeWordBit)) {
-                ret.groupDigOut |= 1ul << groupControlBits[idx].get<Int>();
+        if (cgb.codewordShift >= 0) {                   // contiguous bits: shift the code word in place
+            Digital mask = nrGroupControlBits >= 32 ? ~Digital(0) : (Digital(1) << nrGroupControlBits) - 1;
+            ret.groupDigOut |= (codeword & mask) << cgb.codewordShift;
+        } else {
+            for (UInt bit = 0; bit < nrGroupControlBits; bit++) {
+                if (codeword & (1ul << bit)) {
+                    ret.groupDigOut |= 1ul << cgb.codewordBits[bit];
+                }
             }
         }
 
-        ret.comment = QL_SS2S(
-            "  # slot=" << ic.ii.slot
-            << ", instrument='" << ic.ii.instrumentName << "'"
-            << ", group=" << group
-            << ": codeword=" << codeword
-            << std::string(codewordOverriden ? " (static override)" : "")
-            << ": groupDigOut=0x" << std::hex << std::setfill('0') << std::setw(8) << ret.groupDigOut
-        );
+        if (withComment) {
+            ret.comment = QL_SS2S(
+                "  # slot=" << ic.ii.slot
+                << ", instrument='" << ic.ii.instrumentName << "'"
+                << ", group=" << group
+                << ": codeword=" << codeword
+                << std::string(codewordOverriden ? " (static override)" : "")
+                << ": groupDigOut=0x" << std::hex << std::setfill('0') << std::setw(8) << ret.groupDigOut
+            );
+        }
     } else {    // nrGroupControlBits < 1
         QL_JSON_FATAL(
             "key 'control_bits' empty for group " << controlModeGroup
@@ -239,29 +295,16 @@ static CalcGroupDigOut calcGroupDigOut(
     }
 
     // add trigger to digOut
-    UInt nrTriggerBits = ic.controlMode["trigger_bits"].size();
-    if (nrTriggerBits == 0) {                                   // no trigger
-        // do nothing
-    } else if (nrTriggerBits == 1) {                            // single trigger for all groups (NB: will possibly assigned multiple times)
-        ret.groupDigOut |= 1ul << ic.controlMode["trigger_bits"][0].get<Int>();
-#if 1    // FIXME: hotfix for QWG, implement properly
-    } else if(nrTriggerBits == 2) {
-        ret.groupDigOut |= 1ul << ic.controlMode["trigger_bits"][0].get<Int>();
-        ret.groupDigOut |= 1ul << ic.controlMode["trigger_bits"][1].get<Int>();
-#endif
-#if 1   // FIXME: trigger per group
-    } else if(nrTriggerBits == nrGroups) {                      // trigger per group
-        ret.groupDigOut |= 1ul << ic.controlMode["trigger_bits"][group].get<Int>();
-#endif
-    } else {
+    if (!ic.triggerBitsValid) {
         QL_JSON_FATAL(
             "instrument '" << ic.ii.instrumentName
             << "' uses " << nrGroups
             << " groups, but control mode '" << ic.refControlMode
-            << "' defines " << nrTriggerBits
+            << "' defines " << ic.controlMode["trigger_bits"].size()
             << " trigger bits in 'trigger_bits' (must be 1 or #groups)"
         );
     }
+    ret.groupDigOut |= cgb.triggerMask;
 
     return ret;
 }
@@ -276,7 +319,7 @@ Codegen::CodeGenMap Codegen::collectCodeGenInfo(
     // iterate over instruments
     for (UInt instrIdx = 0; instrIdx < settings.getInstrumentsSize(); instrIdx++) {
         // get control info from instrument settings
-        const Settings::InstrumentControl ic = settings.getInstrumentControl(instrIdx);
+        const Settings::InstrumentControl &ic = settings.getInstrumentControl(instrIdx);
         if (ic.ii.slot >= MAX_SLOTS) {
             QL_JSON_FATAL(
                 "illegal slot " << ic.ii.slot
@@ -308,7 +351,7 @@ Codegen::CodeGenMap Codegen::collectCodeGenInfo(
                     codeGenInfo.instrMaxDurationInCycles = bi.durationInCycles;
                 }
 
-                CalcGroupDigOut gdo = calcGroupDigOut(instrIdx, group, nrGroups, ic, bi.staticCodewordOverride);
+                CalcGroupDigOut gdo = calcGroupDigOut(instrIdx, group, nrGroups, ic, bi.staticCodewordOverride, options->verbose);
                 codeGenInfo.digOut |= gdo.groupDigOut;
                 comment(gdo.comment);
 #if OPT_FEEDBACK
@@ -520,25 +563,27 @@ void Codegen::customGate(
 
     Bool isReadout = settings.isReadout(iname);        //  determine whether this is a readout instruction
 
-    // generate comment
-    if (isReadout) {
-        comment(Str(" # READOUT: '") + qasm(iname, operands, breg_operands) + "'");
-    } else { // handle all other instruction types than "readout"
-        // generate comment. NB: we don't have a particular limit for the number of operands
-        comment(Str(" # gate '") + qasm(iname, operands, breg_operands) + "'");
+    // generate comment. NB: only build the string if it will actually be emitted
+    if (options->verbose) {
+        if (isReadout) {
+            comment(Str(" # READOUT: '") + qasm(iname, operands, breg_operands) + "'");
+        } else { // handle all other instruction types than "readout"
+            // NB: we don't have a particular limit for the number of operands
+            comment(Str(" # gate '") + qasm(iname, operands, breg_operands) + "'");
+        }
     }
 
     // find instruction (gate definition)
     const Json &instruction = platform->find_instruction(iname);
     // find signal vector definition for instruction
-    Settings::SignalDef sd = settings.findSignalDefinition(instruction, iname);
+    const Settings::SignalDef &sd = settings.findSignalDefinition(instruction, iname);
 
     // scatter signals defined for instruction (e.g. several operands and/or types) to instruments & groups
     for (UInt s = 0; s < sd.signal.size(); s++) {
         CalcSignalValue csv = calcSignalValue(sd, s, operands, iname);
 
         // store signal value, checking for conflicts
-        BundleInfo &bi = bundleInfo[csv.si.instrIdx][csv.si.group];         // shorthand
+        BundleInfo &bi = bundleInfo[csv.si->instrIdx][csv.si->group];         // shorthand
         if (!csv.signalValueString.empty()) {                               // empty implies no signal
             if (bi.signalValue.empty()) {                                   // signal not yet used
                 bi.signalValue = csv.signalValueString;
@@ -551,8 +596,8 @@ void Codegen::customGate(
             } else {
                 showCodeSoFar();
                 QL_FATAL(
-                    "Signal conflict on instrument='" << csv.si.ic.ii.instrumentName
-                    << "', group=" << csv.si.group
+                    "Signal conflict on instrument='" << csv.si->ic.ii.instrumentName
+                    << "', group=" << csv.si->group
                     << ", between '" << bi.signalValue
                     << "' and '" << csv.signalValueString << "'"
                 );  // FIXME: add offending instruction
@@ -610,8 +655,8 @@ void Codegen::customGate(
 
         QL_DOUT("customGate(): iname='" << iname <<
              "', duration=" << durationInCycles <<
-             " [cycles], instrIdx=" << csv.si.instrIdx <<
-             ", group=" << csv.si.group);
+             " [cycles], instrIdx=" << csv.si->instrIdx <<
+             ", group=" << csv.si->group);
 
         // NB: code is generated in bundleFinish()
     }   // for(signal)
@@ -709,15 +754,38 @@ void Codegen::comment(const Str &c) {
 // FIXME: assure space between fields!
 // FIXME: make comment output depend on verboseCode
 
+// append field to code, left aligned and padded with spaces to width (like std::left << std::setw(width))
+static void appendField(Str &code, const Str &field, UInt width) {
+    code += field;
+    if (field.length() < width) {
+        code.append(width - field.length(), ' ');
+    }
+}
+
 void Codegen::emit(const Str &labelOrComment, const Str &instr) {
     if (labelOrComment.empty()) {                       // no label
-        codeSection << "        " << instr << std::endl;
+        codeSection += "        ";
+        codeSection += instr;
     } else if (labelOrComment.length() < 8) {           // label fits before instr
-        codeSection << std::setw(8) << labelOrComment << instr << std::endl;
+        appendField(codeSection, labelOrComment, 8);
+        codeSection += instr;
     } else if (instr.empty()) {                         // no instr
-        codeSection << labelOrComment << std::endl;
+        codeSection += labelOrComment;
     } else {
-        codeSection << labelOrComment << std::endl << "        " << instr << std::endl;
+        codeSection += labelOrComment;
+        codeSection += "\n        ";
+        codeSection += instr;
+    }
+    codeSection += '\n';
+
+    if (options->object_output) {
+        // NB: directives (e.g. ".CODE") and comments do not end up in the object code
+        if (!labelOrComment.empty() && labelOrComment.back() == ':') {
+            objectCode.label(labelOrComment.substr(0, labelOrComment.size() - 1));
+        }
+        if (!instr.empty()) {
+            objectCode.instruction(ObjectCode::NO_SELECTOR, instr, "");
+        }
     }
 }
 
@@ -725,11 +793,27 @@ void Codegen::emit(const Str &labelOrComment, const Str &instr) {
 // @param   labelOrSel      label must include trailing ":"
 // @param   comment         must include leading "#"
 void Codegen::emit(const Str &labelOrSel, const Str &instr, const Str &ops, const Str &comment) {
-    codeSection << std::setw(16) << labelOrSel << std::setw(16) << instr << std::setw(24) << ops << comment << std::endl;
+    appendField(codeSection, labelOrSel, 16);
+    appendField(codeSection, instr, 16);
+    appendField(codeSection, ops, 24);
+    codeSection += comment;
+    codeSection += '\n';
+
+    if (options->object_output) {
+        uint32_t selector = ObjectCode::NO_SELECTOR;
+        if (!labelOrSel.empty() && labelOrSel.back() == ':') {
+            objectCode.label(labelOrSel.substr(0, labelOrSel.size() - 1));
+        } else if (labelOrSel.size() > 2 && labelOrSel.front() == '[') {
+            selector = parse_uint(labelOrSel.substr(1, labelOrSel.size() - 2));
+        }
+        if (!instr.empty()) {
+            objectCode.instruction(selector, instr, ops);
+        }
+    }
 }
 
 void Codegen::emit(Int slot, const Str &instr, const Str &ops, const Str &comment) {
-    emit(QL_SS2S("[" << slot << "]"), instr, ops, comment);
+    emit("[" + to_string(slot) + "]", instr, ops, comment);
 }
 
 /************************************************************************\
@@ -738,17 +822,18 @@ void Codegen::emit(Int slot, const Str &instr, const Str &ops, const Str &commen
 
 void Codegen::showCodeSoFar() {
     // provide context to help finding reason. FIXME: limit # lines
-    QL_EOUT("Code so far:\n" << codeSection.str());
+    QL_EOUT("Code so far:\n" << codeSection);
 }
 
 void Codegen::emitProgramStart(const Str &progName) {
     // emit program header
-    codeSection << std::left;    // assumed by emit()
-    codeSection << "# Program: '" << progName << "'" << std::endl;   // NB: put on top so it shows up in internal CC logging
-    codeSection << "# CC_BACKEND_VERSION " << CC_BACKEND_VERSION_STRING << std::endl;
-    codeSection << "# OPENQL_VERSION " << OPENQL_VERSION_STRING << std::endl;
-    codeSection << "# Note:    generated by OpenQL Central Controller backend" << std::endl;
-    codeSection << "#" << std::endl;
+    // NB: the code is appended to a single preallocated string, which is much faster than streaming for long experiments
+    codeSection.reserve(CODE_SECTION_RESERVE);
+    codeSection += "# Program: '" + progName + "'\n";   // NB: put on top so it shows up in internal CC logging
+    codeSection += "# CC_BACKEND_VERSION " CC_BACKEND_VERSION_STRING "\n";
+    codeSection += "# OPENQL_VERSION " OPENQL_VERSION_STRING "\n";
+    codeSection += "# Note:    generated by OpenQL Central Controller backend\n";
+    codeSection += "#\n";
 
 #if OPT_FEEDBACK
     emit(".CODE");   // start .CODE section
@@ -799,8 +884,7 @@ void Codegen::emitFeedback(
 
     // code generation for participating and non-participating instruments (NB: must take equal number of sequencer cycles)
     if (!feedbackMap.empty()) {    // this instrument performs readout for feedback now
-        UInt mux = dp.getOrAssignMux(instrIdx, feedbackMap);
-        dp.emitMux(mux, feedbackMap, instrIdx, slot);
+        UInt mux = dp.getOrAssignMux(instrIdx, feedbackMap, slot);
 
         // emit code for slot input
         UInt sizeTag = Datapath::getSizeTag(feedbackMap.size());        // compute DSM transfer size tag (for 'seq_in_sm' instruction)
@@ -857,8 +941,8 @@ void Codegen::emitOutput(
         );
     } else {    // at least one group conditional
         // configure datapath PL
-        UInt pl = dp.getOrAssignPl(instrIdx, condGateMap);
-        UInt smAddr = dp.emitPl(pl, condGateMap, instrIdx, slot);
+        UInt pl = dp.getOrAssignPl(instrIdx, condGateMap, slot);
+        UInt smAddr = dp.getPlSmAddr(condGateMap, instrIdx);
 
         // emit code for conditional gate
         emit(
@@ -984,17 +1068,17 @@ Codegen::CalcSignalValue Codegen::calcSignalValue(
     \************************************************************************/
 
     // find signalInfo, i.e. perform the mapping
-    ret.si = settings.findSignalInfoForQubit(instructionSignalType, qubit);
+    ret.si = &settings.findSignalInfoForQubit(instructionSignalType, qubit);
 
     if (instructionSignalValue.empty()) {    // allow empty signal
         ret.signalValueString = "";
     } else {
         // verify signal dimensions
-        UInt channelsPergroup = ret.si.ic.controlModeGroupSize;
+        UInt channelsPergroup = ret.si->ic.controlModeGroupSize;
         if (instructionSignalValue.size() != channelsPergroup) {
             QL_JSON_FATAL(
                 "signal dimension mismatch on instruction '" << iname
-                << "' : control mode '" << ret.si.ic.refControlMode
+                << "' : control mode '" << ret.si->ic.refControlMode
                 << "' requires " <<  channelsPergroup
                 << " signals, but signal '" << signalSPath+"/value"
                 << "' provides " << instructionSignalValue.size()
@@ -1004,8 +1088,8 @@ Codegen::CalcSignalValue Codegen::calcSignalValue(
         // expand macros
         sv = replace_all(sv, "\"", "");   // get rid of quotes
         sv = replace_all(sv, "{gateName}", iname);
-        sv = replace_all(sv, "{instrumentName}", ret.si.ic.ii.instrumentName);
-        sv = replace_all(sv, "{instrumentGroup}", to_string(ret.si.group));
+        sv = replace_all(sv, "{instrumentName}", ret.si->ic.ii.instrumentName);
+        sv = replace_all(sv, "{instrumentGroup}", to_string(ret.si->group));
         // FIXME: allow using all qubits involved (in same signalType?, or refer to signal: qubitOfSignal[n]), e.g. qubit[0], qubit[1], qubit[2]
         sv = replace_all(sv, "{qubit}", to_string(qubit));
         ret.signalValueString = sv;
@@ -1014,9 +1098,9 @@ Codegen::CalcSignalValue Codegen::calcSignalValue(
     }
 
     comment(QL_SS2S(
-        "  # slot=" << ret.si.ic.ii.slot
-        << ", instrument='" << ret.si.ic.ii.instrumentName << "'"
-        << ", group=" << ret.si.group
+        "  # slot=" << ret.si->ic.ii.slot
+        << ", instrument='" << ret.si->ic.ii.instrumentName << "'"
+        << ", group=" << ret.si->group
         << "': signalValue='" << ret.signalValueString << "'"
     ));
 
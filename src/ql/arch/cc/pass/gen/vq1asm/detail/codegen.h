@@ -10,12 +10,14 @@
 #pragma once
 
 #include "ql/ir/compat/platform.h"
+#include "ql/ir/compat/bundle.h"
 #include "types.h"
 #include "options.h"
 #include "bundle_info.h"
 #include "datapath.h"
 #include "settings.h"
 #include "vcd.h"
+#include "object.h"
 
 namespace ql {
 namespace arch {
@@ -34,15 +36,22 @@ public: //  functions
     void init(const ir::compat::PlatformRef &platform, const OptionsRef &options);
     Str getProgram();                           // return the CC source code that was created
     Str getMap();                               // return a map of codeword assignments, useful for configuring AWGs
+    Str getObject();                            // return the program as object code, if options->object_output
+    Str getSymbols();                           // return the symbol table of the object code, useful for debugging
 
     // Compile support
     void programStart(const Str &progName);
     void programFinish(const Str &progName);
-    void kernelStart();
+    void kernelStart(const Str &kernelName);
     void kernelFinish(const Str &kernelName, UInt durationInCycles);
     void bundleStart(const Str &cmnt);
     void bundleFinish(UInt startCycle, UInt durationInCycles, Bool isLastBundle);
 
+    // Folding of identical consecutive kernels into a loop
+    Bool isRepeatable(const Str &iname);
+    void repeatStart(const Str &label, UInt count);
+    void repeatFinish(const Str &label, const Str &kernelName, UInt durationInCycles, UInt count);
+
     // Quantum instructions
     void customGate(
         // FIXME consider passing a gate&, custom_gate& or (new type) GateOperands&
@@ -90,13 +99,14 @@ private:    // types
     struct CalcSignalValue {
         Str signalValueString;
         UInt operandIdx;
-        Settings::SignalInfo si;
+        RawPtr<const Settings::SignalInfo> si;     // NB: points into the lookup tables of Settings
     }; // return type for calcSignalValue()
 
 
 private:    // vars
     static const Int MAX_SLOTS = 12;                            // physical maximum of CC
     static const Int MAX_GROUPS = 32;                           // based on VSM, which currently has the largest number of groups
+    static const UInt CODE_SECTION_RESERVE = 1 << 20;           // initial capacity of codeSection
 
     OptionsRef options;
     ir::compat::PlatformRef platform;                           // remind platform
@@ -108,7 +118,8 @@ private:    // vars
 
     // codegen state, program scope
     Json codewordTable;                                         // codewords versus signals per instrument group
-    StrStrm codeSection;                                        // the code generated
+    Str codeSection;                                            // the code generated
+    ObjectCode objectCode;                                      // the code generated, as object code (if enabled)
 
     // codegen state, kernel scope FIXME: create class
     UInt lastEndCycle[MAX_INSTRS];                              // vector[instrIdx], maintain where we got per slot
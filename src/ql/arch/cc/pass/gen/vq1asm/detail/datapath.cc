@@ -20,8 +20,9 @@ namespace detail {
 
 using namespace utils;
 
+const Int Datapath::NO_OWNER;    // NB: ODR-used by smXferOwner initializer
+
 // math helpers
-static unsigned int roundUp(unsigned int val, unsigned int mult) { return (val+mult-1)/mult*mult; }
 static unsigned int alignSm(unsigned int bitAddr, unsigned int bits) { return bitAddr/bits*(bits/8); }
 
 void Datapath::programStart() {
@@ -43,30 +44,49 @@ UInt Datapath::allocateSmBit(UInt breg_operand, UInt instrIdx) {
     // - DSM size is 1024 bits (128 bytes)
     // Other notes:
     // - we don't attempt to be smart about DSM transfer size allocation
-    // - new allocations to the same breg_operand overwrite the old mapping
-    // - we don't reuse SM bits (thus wasting space)
-
-    UInt smBit = 0;
-    if (!mapBregToSmBit.empty()) {    // not first alloc
-        // perform allocation
-        if (instrIdx != smBitLastInstrIdx) {
-            smBit = roundUp(lastSmBit + 1, MAX_DSM_XFER_SIZE);
-        } else {
-            smBit = lastSmBit + 1;
-        }
-        if (smBit >= SM_BIT_CNT) {
-            QL_FATAL("Exceeded available Shared memory space of " << SM_BIT_CNT << " bits");
+    // - new allocations to the same breg_operand overwrite the old mapping, and release the
+    //   old SM bit
+    // - allocation proceeds linearly through SM, and only wraps around to reuse released
+    //   DSM transfer blocks once the end of SM is reached
+
+    auto it = mapBregToSmBit.find(breg_operand);
+    if (it != mapBregToSmBit.end()) {
+        QL_IOUT("Overwriting mapping of breg_operand " << it->second);
+        releaseSmBit(it->second);
+    }
+
+    // continue in the DSM transfer block of the previous allocation if possible
+    UInt smBit = SM_BIT_CNT;    // invalid
+    if (smBitAllocated && instrIdx == smBitLastInstrIdx) {
+        UInt candidate = lastSmBit + 1;
+        if (candidate % MAX_DSM_XFER_SIZE != 0 && !smBitUsed[candidate]) {
+            smXferOwner[candidate/MAX_DSM_XFER_SIZE] = instrIdx;    // NB: block may have been released meanwhile
+            smBit = candidate;
         }
+    }
 
-        auto it = mapBregToSmBit.find(breg_operand);
-        if (it != mapBregToSmBit.end()) {
-            QL_IOUT("Overwriting mapping of breg_operand " << it->second);
+    // otherwise, start a free DSM transfer block
+    if (smBit == SM_BIT_CNT) {
+        UInt firstXfer = smBitAllocated ? lastSmBit/MAX_DSM_XFER_SIZE + 1 : 0;
+        for (UInt i = 0; i < SM_XFER_CNT; i++) {
+            UInt xfer = (firstXfer + i) % SM_XFER_CNT;
+            if (smXferOwner[xfer] == NO_OWNER) {
+                smXferOwner[xfer] = instrIdx;
+                smBit = xfer*MAX_DSM_XFER_SIZE;
+                break;
+            }
+        }
+        if (smBit == SM_BIT_CNT) {
+            QL_FATAL("Exceeded available Shared memory space of " << SM_BIT_CNT << " bits");
         }
     }
 
     QL_IOUT("Mapping breg_operand " << breg_operand << " to smBit " << smBit);
     mapBregToSmBit.set(breg_operand) = smBit;    // created on demand
+    smBitUsed.set(smBit);
+    smXferUseCnt[smBit/MAX_DSM_XFER_SIZE]++;
 
+    smBitAllocated = true;
     smBitLastInstrIdx = instrIdx;
     lastSmBit = smBit;
 
@@ -87,23 +107,39 @@ UInt Datapath::getSmBit(UInt bit_operand, UInt instrIdx) {
     return smBit;
 }
 
-UInt Datapath::getOrAssignMux(UInt instrIdx, const FeedbackMap &feedbackMap) {
-    // We need a different MUX for every new combination of simultaneous readouts (per instrument)
-    UInt mux = lastMux[instrIdx]++;    // FIXME: no reuse of identical combinations yet
+UInt Datapath::getOrAssignMux(UInt instrIdx, const FeedbackMap &feedbackMap, Int slot) {
+    // We need a different MUX for every new combination of simultaneous readouts (per instrument).
+    // Identical combinations reuse the MUX, which has then already been emitted
+    auto &known = muxBySignature[instrIdx];
+    auto it = known.emplace(muxSignature(feedbackMap), lastMux[instrIdx]);
+    if (!it.second) {
+        return it.first->second;
+    }
+
+    UInt mux = lastMux[instrIdx]++;
     if (mux == MUX_CNT) {
         QL_FATAL("Maximum number of available CC datapath MUXes exceeded");
     }
+    emitMux(mux, feedbackMap, instrIdx, slot);
 
     return mux;
 }
 
 
-UInt Datapath::getOrAssignPl(UInt instrIdx, const CondGateMap &condGateMap) {
-    // We need a different PL for every new combination of simultaneous gate conditions (per instrument)
-    UInt pl = lastPl[instrIdx]++;    // FIXME: no reuse of identical combinations yet
+UInt Datapath::getOrAssignPl(UInt instrIdx, const CondGateMap &condGateMap, Int slot) {
+    // We need a different PL for every new combination of simultaneous gate conditions (per instrument).
+    // Identical combinations reuse the PL, which has then already been emitted
+    auto &known = plBySignature[instrIdx];
+    auto it = known.emplace(plSignature(condGateMap, instrIdx), lastPl[instrIdx]);
+    if (!it.second) {
+        return it.first->second;
+    }
+
+    UInt pl = lastPl[instrIdx]++;
     if (pl == PL_CNT) {
         QL_FATAL("Maximum number of available CC datapath PLs exceeded");
     }
+    emitPl(pl, condGateMap, instrIdx, slot);
 
     return pl;
 }
@@ -127,6 +163,21 @@ UInt Datapath::getSizeTag(UInt numReadouts) {
 }
 
 
+// number of cond_operands used by condition
+static UInt condOperandCount(ir::compat::ConditionType condition) {
+    switch (condition) {
+        case ir::compat::ConditionType::ALWAYS:
+        case ir::compat::ConditionType::NEVER:
+            return 0;
+        case ir::compat::ConditionType::NOT:
+        case ir::compat::ConditionType::UNARY:
+            return 1;
+        default:
+            return 2;
+    }
+}
+
+
 static Str cond_qasm(ir::compat::ConditionType condition, const Vec<UInt> &cond_operands) {
     // FIXME: hack
     ir::compat::gate_types::Custom g("foo");
@@ -180,12 +231,7 @@ UInt Datapath::getMuxSmAddr(const FeedbackMap &feedbackMap) {
 }
 
 
-// FIXME: split like emitMux/getMuxSmAddr
-UInt Datapath::emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, Int slot) {
-    Bool minMaxValid = false;    // we might not access SM
-    UInt minSmBit = MAX;
-    UInt maxSmBit = 0;
-
+void Datapath::emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, Int slot) {
     if (condGateMap.empty()) {
         QL_FATAL("condGateMap must not be empty");
     }
@@ -204,13 +250,9 @@ UInt Datapath::emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, In
         );
 
         // shorthand
-        auto winBit = [this, cgi, instrIdx, &minMaxValid, &minSmBit, &maxSmBit](int i)
+        auto winBit = [this, &cgi, instrIdx](int i)
         {
-            UInt smBit = getSmBit(cgi.cond_operands[i], instrIdx);
-            minMaxValid = true;
-            minSmBit = min(minSmBit, smBit);
-            maxSmBit = max(maxSmBit, smBit);
-            return smBit % PL_SM_WIN_SIZE;
+            return getSmBit(cgi.cond_operands[i], instrIdx) % PL_SM_WIN_SIZE;
         };
 
         // compute RHS of PL expression
@@ -267,6 +309,28 @@ UInt Datapath::emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, In
         }
     }
 
+}
+
+
+UInt Datapath::getPlSmAddr(const CondGateMap &condGateMap, UInt instrIdx) {
+    Bool minMaxValid = false;    // we might not access SM
+    UInt minSmBit = MAX;
+    UInt maxSmBit = 0;
+
+    if (condGateMap.empty()) {
+        QL_FATAL("condGateMap must not be empty");
+    }
+
+    for (auto &cg : condGateMap) {
+        const CondGateInfo &cgi = cg.second;
+        for (UInt i = 0; i < condOperandCount(cgi.condition); i++) {
+            UInt smBit = getSmBit(cgi.cond_operands[i], instrIdx);
+            minMaxValid = true;
+            minSmBit = min(minSmBit, smBit);
+            maxSmBit = max(maxSmBit, smBit);
+        }
+    }
+
     // perform checks
     if (minMaxValid) {
         if (alignSm(minSmBit, PL_SM_WIN_SIZE) != alignSm(maxSmBit, PL_SM_WIN_SIZE)) {
@@ -276,6 +340,51 @@ UInt Datapath::emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, In
     return alignSm(minSmBit, PL_SM_WIN_SIZE);    // NB: irrelevant if !minMaxValid since SM is not accessed in that case
 }
 
+
+/************************************************************************\
+| Private functions
+\************************************************************************/
+
+void Datapath::releaseSmBit(UInt smBit) {
+    if (!smBitUsed[smBit]) {
+        QL_ICE("releasing unused smBit " << smBit);
+    }
+    smBitUsed.reset(smBit);
+    UInt xfer = smBit/MAX_DSM_XFER_SIZE;
+    if (--smXferUseCnt[xfer] == 0) {
+        smXferOwner[xfer] = NO_OWNER;
+    }
+}
+
+// append an integer to a binary signature key
+static void appendKey(Str &key, UInt val) {
+    key.append(reinterpret_cast<const char *>(&val), sizeof(val));
+}
+
+// signature of the MUX configuration generated by emitMux(), i.e. the mapping of inputs to SM window bits
+Str Datapath::muxSignature(const FeedbackMap &feedbackMap) {
+    Str key;
+    for (const auto &feedback : feedbackMap) {
+        appendKey(key, feedback.second.smBit % MUX_SM_WIN_SIZE);
+        appendKey(key, feedback.second.bit);
+    }
+    return key;
+}
+
+// signature of the PL configuration generated by emitPl(), i.e. the outputs, conditions and SM window bits they depend on
+Str Datapath::plSignature(const CondGateMap &condGateMap, UInt instrIdx) {
+    Str key;
+    for (const auto &cg : condGateMap) {
+        appendKey(key, cg.first);
+        appendKey(key, cg.second.groupDigOut);
+        appendKey(key, static_cast<UInt>(cg.second.condition));
+        for (UInt i = 0; i < condOperandCount(cg.second.condition); i++) {
+            appendKey(key, getSmBit(cg.second.cond_operands[i], instrIdx) % PL_SM_WIN_SIZE);
+        }
+    }
+    return key;
+}
+
 } // namespace detail
 } // namespace vq1asm
 } // namespace gen
@@ -9,6 +9,8 @@
 #pragma once
 
 #include <iomanip>
+#include <bitset>
+#include <unordered_map>
 #include "ql/utils/logger.h"
 #include "ql/ir/compat/compat.h"
 #include "types.h"
@@ -53,12 +55,13 @@ public: // functions
 
     UInt allocateSmBit(UInt breg_operand, UInt instrIdx);
     UInt getSmBit(UInt bit_operand, UInt instrIdx);
-    UInt getOrAssignMux(UInt instrIdx, const FeedbackMap &feedbackMap);
-    UInt getOrAssignPl(UInt instrIdx, const CondGateMap &condGateMap);
+    UInt getOrAssignMux(UInt instrIdx, const FeedbackMap &feedbackMap, Int slot);    // emits MUX configuration if new
+    UInt getOrAssignPl(UInt instrIdx, const CondGateMap &condGateMap, Int slot);     // emits PL configuration if new
     static UInt getSizeTag(UInt numReadouts);
     void emitMux(Int mux, const FeedbackMap &feedbackMap, UInt instrIdx, Int slot);
     static UInt getMuxSmAddr(const FeedbackMap &feedbackMap);
-    UInt emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, Int slot);
+    void emitPl(UInt pl, const CondGateMap &condGateMap, UInt instrIdx, Int slot);
+    UInt getPlSmAddr(const CondGateMap &condGateMap, UInt instrIdx);
 
     Str getDatapathSection() { return datapathSection.str(); }
 
@@ -67,6 +70,10 @@ public: // functions
     }
 
 private:    // functions
+    void releaseSmBit(UInt smBit);
+    Str muxSignature(const FeedbackMap &feedbackMap);
+    Str plSignature(const CondGateMap &condGateMap, UInt instrIdx);
+
     Str selString(Int sel) { return QL_SS2S("[" << sel << "]"); }
 
     void emit(const Str &sel, const Str &statement, const Str &comment="") {
@@ -83,17 +90,25 @@ private:    // vars
     static const UInt PL_SM_WIN_SIZE = 128;                     // number of SM bits in single view
     static const UInt SM_BIT_CNT = 1024;                        // number of SM bits
     static const UInt MAX_DSM_XFER_SIZE = 16;                   // current max (using a ZI UHFQA)
+    static const UInt SM_XFER_CNT = SM_BIT_CNT/MAX_DSM_XFER_SIZE;  // number of DSM transfer blocks
+    static const Int NO_OWNER = -1;
 
     StrStrm datapathSection;                                    // the data path configuration generated
 
     // state for allocateSmBit/getSmBit
+    Bool smBitAllocated = false;
     UInt lastSmBit = 0;
     UInt smBitLastInstrIdx = 0;
     Map<UInt, UInt> mapBregToSmBit;
+    std::bitset<SM_BIT_CNT> smBitUsed;                          // SM bits currently mapped to a breg_operand
+    Vec<Int> smXferOwner = Vec<Int>(SM_XFER_CNT, NO_OWNER);    // vector[DSM transfer block], instrIdx owning the block
+    Vec<UInt> smXferUseCnt = Vec<UInt>(SM_XFER_CNT, 0);        // vector[DSM transfer block], number of used bits
 
-    // other state
+    // state for getOrAssignMux/getOrAssignPl
     Vec<UInt> lastMux = Vec<UInt>(MAX_INSTRS, 0);
     Vec<UInt> lastPl = Vec<UInt>(MAX_INSTRS, 0);
+    Vec<std::unordered_map<Str, UInt>> muxBySignature = Vec<std::unordered_map<Str, UInt>>(MAX_INSTRS);    // vector[instrIdx], key is muxSignature()
+    Vec<std::unordered_map<Str, UInt>> plBySignature = Vec<std::unordered_map<Str, UInt>>(MAX_INSTRS);     // vector[instrIdx], key is plSignature()
 }; // class
 
 } // namespace detail
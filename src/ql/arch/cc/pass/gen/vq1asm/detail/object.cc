@@ -0,0 +1,213 @@
+/**
+ * @file    arch/cc/pass/gen/vq1asm/detail/object.cc
+ * @date    20261014
+ * @brief   pre-tokenized object output for the CC backend, as an alternative to assembling the .vq1asm text
+ * @note    see object.h for the layout
+ */
+
+#include "object.h"
+
+#include <cctype>
+#include <iomanip>
+#include "ql/utils/exception.h"
+#include "options.h"
+
+namespace ql {
+namespace arch {
+namespace cc {
+namespace pass {
+namespace gen {
+namespace vq1asm {
+namespace detail {
+
+using namespace utils;
+
+const uint32_t ObjectCode::VERSION;
+const uint32_t ObjectCode::NO_SELECTOR;
+const uint32_t ObjectCode::UNDEFINED;
+
+/************************************************************************\
+| Static helpers for little endian output
+\************************************************************************/
+
+static void putU8(Str &buf, uint8_t v) {
+    buf += static_cast<char>(v);
+}
+
+static void putU32(Str &buf, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        putU8(buf, static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+static void putU64(Str &buf, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        putU8(buf, static_cast<uint8_t>(v >> (8 * i)));
+    }
+}
+
+static Bool isDecimal(const Str &s) {
+    if (s.empty()) return false;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+    }
+    return true;
+}
+
+static Bool isHexadecimal(const Str &s) {
+    if (s.size() <= 2 || s[0] != '0' || (s[1] != 'x' && s[1] != 'X')) return false;
+    for (UInt i = 2; i < s.size(); i++) {
+        if (!std::isxdigit(static_cast<unsigned char>(s[i]))) return false;
+    }
+    return true;
+}
+
+/************************************************************************\
+| Public functions
+\************************************************************************/
+
+// define label at the position of the next instruction
+void ObjectCode::label(const Str &name) {
+    uint32_t idx = getLabel(name);
+    if (labelInstrIdx[idx] != UNDEFINED) {
+        QL_FATAL("label '" << name << "' defined more than once");
+    }
+    labelInstrIdx[idx] = instructions.size();
+}
+
+// add instruction, where ops is the comma separated operand list as used in the .vq1asm text
+void ObjectCode::instruction(uint32_t selector, const Str &mnemonic, const Str &ops) {
+    Instruction instr;
+    instr.selector = selector;
+    instr.mnemonic = getString(mnemonic);
+    if (!ops.empty()) {
+        UInt start = 0;
+        while (true) {
+            UInt end = ops.find(',', start);
+            Str op = ops.substr(start, end == Str::npos ? Str::npos : end - start);
+            instr.operands.push_back(parseOperand(op, instr.operands.size()));
+            if (end == Str::npos) break;
+            start = end + 1;
+        }
+    }
+    instructions.push_back(std::move(instr));
+}
+
+Str ObjectCode::getObject(const Str &datapathSection) {
+    uint32_t datapath = getString(datapathSection);
+
+    for (UInt idx = 0; idx < labelNames.size(); idx++) {
+        if (labelInstrIdx[idx] == UNDEFINED) {
+            QL_FATAL("label '" << labelNames[idx] << "' is referenced but not defined");
+        }
+    }
+
+    Str buf;
+    buf += "VQ1O";
+    putU32(buf, VERSION);
+
+    putU32(buf, strings.size());
+    for (const auto &s : strings) {
+        putU32(buf, s.size());
+        buf += s;
+    }
+
+    putU32(buf, instructions.size());
+    for (const auto &instr : instructions) {
+        putU32(buf, instr.selector);
+        putU32(buf, instr.mnemonic);
+        putU32(buf, instr.operands.size());
+        for (const auto &op : instr.operands) {
+            putU8(buf, static_cast<uint8_t>(op.kind));
+            putU64(buf, op.value);
+        }
+    }
+
+    putU32(buf, labelNames.size());
+    for (UInt idx = 0; idx < labelNames.size(); idx++) {
+        putU32(buf, stringIdx.at(labelNames[idx]));
+        putU32(buf, labelInstrIdx[idx]);
+    }
+
+    putU32(buf, relocations.size());
+    for (const auto &reloc : relocations) {
+        putU32(buf, reloc.instrIdx);
+        putU32(buf, reloc.operandIdx);
+        putU32(buf, reloc.labelIdx);
+    }
+
+    putU32(buf, datapath);
+    return buf;
+}
+
+Str ObjectCode::getSymbols() const {
+    Json symbols;
+
+    symbols["note"] = "generated by OpenQL CC backend version " CC_BACKEND_VERSION_STRING;
+    symbols["instruction_count"] = instructions.size();
+    for (UInt idx = 0; idx < labelNames.size(); idx++) {
+        symbols["labels"][labelNames[idx]] = labelInstrIdx[idx];
+    }
+    for (const auto &reloc : relocations) {
+        symbols["relocations"].push_back({
+            {"instruction", reloc.instrIdx},
+            {"operand", reloc.operandIdx},
+            {"label", labelNames[reloc.labelIdx]}
+        });
+    }
+    return QL_SS2S(std::setw(4) << symbols << std::endl);
+}
+
+/************************************************************************\
+| Private functions
+\************************************************************************/
+
+uint32_t ObjectCode::getString(const Str &s) {
+    auto it = stringIdx.find(s);
+    if (it != stringIdx.end()) {
+        return it->second;
+    }
+    uint32_t idx = strings.size();
+    strings.push_back(s);
+    stringIdx.emplace(s, idx);
+    return idx;
+}
+
+uint32_t ObjectCode::getLabel(const Str &name) {
+    auto it = labelIdx.find(name);
+    if (it != labelIdx.end()) {
+        return it->second;
+    }
+    uint32_t idx = labelNames.size();
+    getString(name);
+    labelNames.push_back(name);
+    labelInstrIdx.push_back(UNDEFINED);
+    labelIdx.emplace(name, idx);
+    return idx;
+}
+
+ObjectCode::Operand ObjectCode::parseOperand(const Str &op, uint32_t operandIdx) {
+    if (op.size() > 1 && op[0] == '@') {
+        uint32_t idx = getLabel(op.substr(1));
+        relocations.push_back({static_cast<uint32_t>(instructions.size()), operandIdx, idx});
+        return {OperandKind::LABEL, idx};
+    } else if (op.size() > 1 && op[0] == 'R' && isDecimal(op.substr(1))) {
+        return {OperandKind::REGISTER, std::stoull(op.substr(1))};
+    } else if (op.size() > 1 && op[0] == 'S' && isDecimal(op.substr(1))) {
+        return {OperandKind::SM_ADDRESS, std::stoull(op.substr(1))};
+    } else if (isDecimal(op)) {
+        return {OperandKind::NUMBER, std::stoull(op)};
+    } else if (isHexadecimal(op)) {
+        return {OperandKind::NUMBER, std::stoull(op.substr(2), nullptr, 16)};
+    } else {
+        return {OperandKind::STRING, getString(op)};
+    }
+}
+
+} // namespace detail
+} // namespace vq1asm
+} // namespace gen
+} // namespace pass
+} // namespace cc
+} // namespace arch
+} // namespace ql
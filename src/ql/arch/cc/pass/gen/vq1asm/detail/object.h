@@ -0,0 +1,95 @@
+/**
+ * @file    arch/cc/pass/gen/vq1asm/detail/object.h
+ * @date    20261014
+ * @brief   pre-tokenized object output for the CC backend, as an alternative to assembling the .vq1asm text
+ * @note    the binary layout is described below, all integers are little endian
+ *
+ *  header:         "VQ1O", u32 version
+ *  string table:   u32 count, count * (u32 length, length bytes)
+ *  instructions:   u32 count, count * (u32 selector, u32 mnemonic, u32 operand count, operand count * operand)
+ *  operand:        u8 kind (see OperandKind), u64 value (number, register, string index or label index)
+ *  labels:         u32 count, count * (u32 name, u32 instruction index)
+ *  relocations:    u32 count, count * (u32 instruction index, u32 operand index, u32 label index)
+ *  datapath:       u32 string index of the datapath section (verbatim text)
+ *
+ *  Strings (mnemonics, names) are given as index into the string table. The selector is the CCIO slot of the
+ *  instruction, or NO_SELECTOR. Labels are defined at the index of the instruction that follows them.
+ */
+
+#pragma once
+
+#include "types.h"
+
+namespace ql {
+namespace arch {
+namespace cc {
+namespace pass {
+namespace gen {
+namespace vq1asm {
+namespace detail {
+
+class ObjectCode {
+public: // types
+    enum class OperandKind : uint8_t {
+        NUMBER = 0,                                             // decimal or hexadecimal immediate
+        REGISTER = 1,                                           // 'R<n>'
+        SM_ADDRESS = 2,                                         // 'S<n>', Distributed Shared Memory address
+        LABEL = 3,                                              // '@<label>', also listed in the relocations
+        STRING = 4                                              // anything else, verbatim
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t NO_SELECTOR = 0xFFFFFFFF;
+
+public: // functions
+    ObjectCode() = default;
+    ~ObjectCode() = default;
+
+    void label(const Str &name);
+    void instruction(uint32_t selector, const Str &mnemonic, const Str &ops);
+
+    Str getObject(const Str &datapathSection);                  // return the binary object
+    Str getSymbols() const;                                     // return the symbol table, useful for debugging
+
+private:    // types
+    struct Operand {
+        OperandKind kind;
+        uint64_t value;
+    };
+
+    struct Instruction {
+        uint32_t selector;
+        uint32_t mnemonic;
+        Vec<Operand> operands;
+    };
+
+    struct Relocation {
+        uint32_t instrIdx;
+        uint32_t operandIdx;
+        uint32_t labelIdx;
+    };
+
+    static const uint32_t UNDEFINED = 0xFFFFFFFF;
+
+private:    // funcs
+    uint32_t getString(const Str &s);
+    uint32_t getLabel(const Str &name);
+    Operand parseOperand(const Str &op, uint32_t operandIdx);
+
+private:    // vars
+    Vec<Str> strings;
+    Map<Str, uint32_t> stringIdx;
+    Vec<Instruction> instructions;
+    Vec<Str> labelNames;
+    Vec<uint32_t> labelInstrIdx;                                // vector[labelIdx], UNDEFINED until defined
+    Map<Str, uint32_t> labelIdx;
+    Vec<Relocation> relocations;
+}; // class
+
+} // namespace detail
+} // namespace vq1asm
+} // namespace gen
+} // namespace pass
+} // namespace cc
+} // namespace arch
+} // namespace ql
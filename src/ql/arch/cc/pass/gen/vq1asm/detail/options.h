@@ -63,6 +63,24 @@ struct Options {
      */
     Bool run_once;
 
+    /**
+     * When set, consecutive kernels that generate identical code are emitted
+     * once, inside a loop.
+     */
+    Bool fold_repeated_kernels;
+
+    /**
+     * When set, also write the program as pre-tokenized object code, plus a
+     * symbol file.
+     */
+    Bool object_output;
+
+    /**
+     * Number of threads to prepare the kernels with, or 0 to use all hardware
+     * threads.
+     */
+    UInt num_threads;
+
 };
 
 /**
@@ -20,10 +20,15 @@ using namespace utils;
 
 void Settings::loadBackendSettings(const ir::compat::PlatformRef &platform) {
     this->platform = platform;
+    readoutCache.clear();
+    instrumentControls.clear();
+    signalInfoTable.clear();
+    signalTypes.clear();
+    signalDefCache.clear();
 
     // remind some main JSON areas
-    QL_JSON_ASSERT(platform->hardware_settings, "eqasm_backend_cc", "hardware_settings");  // NB: json_get<const json &> unavailable
-    const Json &jsonBackendSettings = platform->hardware_settings["eqasm_backend_cc"];
+    QL_JSON_ASSERT(platform->get_hardware_settings(), "eqasm_backend_cc", "hardware_settings");  // NB: json_get<const json &> unavailable
+    const Json &jsonBackendSettings = platform->get_hardware_settings()["eqasm_backend_cc"];
 
     QL_JSON_ASSERT(jsonBackendSettings, "instrument_definitions", "eqasm_backend_cc");
     jsonInstrumentDefinitions = &jsonBackendSettings["instrument_definitions"];
@@ -66,6 +71,53 @@ void Settings::loadBackendSettings(const ir::compat::PlatformRef &platform) {
 #endif
 }
 
+// precompute the instrument control information and the mapping of signal types and qubits onto instruments & groups.
+// This is done once here, because code generation needs it for every gate in every bundle.
+// NB: requires prior loadBackendSettings()
+void Settings::buildLookupTables() {
+    for (UInt instrIdx = 0; instrIdx < jsonInstruments->size(); instrIdx++) {
+        instrumentControls.push_back(calcInstrumentControl(instrIdx));
+    }
+
+    // iterate over instruments, the first instrument (and group) found for a signal type and qubit wins
+    for (UInt instrIdx = 0; instrIdx < instrumentControls.size(); instrIdx++) {
+        const InstrumentControl &ic = instrumentControls[instrIdx];
+        Str instrumentSignalType = json_get<Str>(*ic.ii.instrument, "signal_type", ic.ii.instrumentName);
+        signalTypes.insert(instrumentSignalType);
+        const Json qubits = json_get<const Json>(*ic.ii.instrument, "qubits", ic.ii.instrumentName);   // NB: json_get<const json&> unavailable
+
+        // verify group size: qubits vs. control mode
+        UInt qubitGroupCnt = qubits.size();                                  // NB: JSON key qubits is a 'matrix' of [groups*qubits]
+        if (qubitGroupCnt != ic.controlModeGroupCnt) {
+            QL_JSON_FATAL(
+                "instrument " << ic.ii.instrumentName
+                << ": number of qubit groups " << qubitGroupCnt
+                << " does not match number of control_bits groups " << ic.controlModeGroupCnt
+                << " of selected control mode '" << ic.refControlMode << "'"
+            );
+        }
+
+        // remind who is connected to which qubit
+        for (UInt group = 0; group < qubitGroupCnt; group++) {
+            for (UInt idx = 0; idx < qubits[group].size(); idx++) {
+                UInt qubit = qubits[group][idx].get<UInt>();
+                SignalInfo si;
+                si.ic = ic;
+                si.instrIdx = instrIdx;
+                si.group = group;
+                if (signalInfoTable.emplace(std::make_pair(instrumentSignalType, qubit), si).second) {
+                    QL_DOUT(
+                        "qubit " << qubit
+                        << " signal type '" << instrumentSignalType
+                        << "' driven by instrument '" << ic.ii.instrumentName
+                        << "' group " << group
+                    );
+                }
+            }
+        }
+    }
+}
+
 // NB: assumes prior test for isReadout()==true
 Str Settings::getReadoutMode(const Str &iname) {
     const Json &instruction = platform->find_instruction(iname);
@@ -84,8 +136,15 @@ Bool Settings::isReadout(const Json &instruction, const Str &iname) {
 // determine whether this is a 'readout instruction'
 Bool Settings::isReadout(const Str &iname) {
 #if 1    // new semantics
+    // this is called for every gate, so remember the result per instruction name to avoid the JSON lookups
+    auto it = readoutCache.find(iname);
+    if (it != readoutCache.end()) {
+        return it->second;
+    }
     const Json &instruction = platform->find_instruction(iname);
-    return isReadout(instruction, iname);
+    Bool result = isReadout(instruction, iname);
+    readoutCache.emplace(iname, result);
+    return result;
 #else
     /*
         NB: we only use the instruction_type "readout" and don't care about the rest
@@ -173,37 +232,34 @@ Settings::SignalDef Settings::findSignalDefinition(const Json &instruction, RawP
 
 
 // find JSON signal definition for instruction, either inline or via 'ref_signal'
-Settings::SignalDef Settings::findSignalDefinition(const Json &instruction, const Str &iname) const {
-#if 1
-    return findSignalDefinition(instruction, jsonSignals, iname);
-#else
-    SignalDef ret;
-
-    Str instructionPath = "instructions/" + iname;
-    QL_JSON_ASSERT(instruction, "cc", instructionPath);
-    if (QL_JSON_EXISTS(instruction["cc"], "ref_signal")) {                      // optional syntax: "ref_signal"
-        Str refSignal = instruction["cc"]["ref_signal"].get<Str>();
-        ret.signal = (*jsonSignals)[refSignal];                                 // poor man's JSON pointer
-        if(ret.signal.empty()) {
-            QL_JSON_FATAL(
-                "instruction '" << iname
-                << "': ref_signal '" << refSignal
-                << "' does not resolve"
-            );
-        }
-        ret.path = "signals/" + refSignal;
-    } else {                                                                    // alternative syntax: "signal"
-        ret.signal = json_get<Json>(instruction["cc"], "signal", instructionPath + "/cc");
-        QL_DOUT("signal for '" << instruction << "': " << ret.signal);
-        ret.path = instructionPath + "/cc/signal";
+const Settings::SignalDef &Settings::findSignalDefinition(const Json &instruction, const Str &iname) const {
+    // this is called for every gate, so remember the result per instruction name
+    auto it = signalDefCache.find(iname);
+    if (it == signalDefCache.end()) {
+        it = signalDefCache.emplace(iname, findSignalDefinition(instruction, jsonSignals, iname)).first;
     }
-    return ret;
-#endif
+    return it->second;
 }
 
 
 // collect some configuration info for an instrument
-Settings::InstrumentInfo Settings::getInstrumentInfo(UInt instrIdx) const {
+const Settings::InstrumentInfo &Settings::getInstrumentInfo(UInt instrIdx) const {
+    return getInstrumentControl(instrIdx).ii;
+}
+
+
+const Settings::InstrumentControl &Settings::getInstrumentControl(UInt instrIdx) const {
+    if (instrIdx >= jsonInstruments->size()) {
+        QL_JSON_FATAL("node not defined: instruments[" << instrIdx << "]");    // probably an internal backend error
+    }
+    if (instrIdx >= instrumentControls.size()) {
+        QL_ICE("instrument control information requested before buildLookupTables()");
+    }
+    return instrumentControls[instrIdx];
+}
+
+
+Settings::InstrumentInfo Settings::calcInstrumentInfo(UInt instrIdx) const {
     InstrumentInfo ret = {nullptr};
 
     Str instrumentPath = QL_SS2S("instruments[" << instrIdx << "]");    // for JSON error reporting
@@ -230,10 +286,10 @@ Settings::InstrumentInfo Settings::getInstrumentInfo(UInt instrIdx) const {
 }
 
 
-Settings::InstrumentControl Settings::getInstrumentControl(UInt instrIdx) const {
+Settings::InstrumentControl Settings::calcInstrumentControl(UInt instrIdx) const {
     InstrumentControl ret;
 
-    ret.ii = getInstrumentInfo(instrIdx);
+    ret.ii = calcInstrumentInfo(instrIdx);
 
     // get control mode reference for for instrument
     ret.refControlMode = json_get<Str>(*ret.ii.instrument, "ref_control_mode", ret.ii.instrumentName);
@@ -244,6 +300,46 @@ Settings::InstrumentControl Settings::getInstrumentControl(UInt instrIdx) const
     // how many groups of control bits does the control mode specify (NB: 0 on missing key)
     ret.controlModeGroupCnt = ret.controlMode["control_bits"].size();
 
+    // precompute the bit layout of every group, such that code generation does not have to walk the JSON per bundle
+    const Json &triggerBits = ret.controlMode["trigger_bits"];
+    UInt nrTriggerBits = triggerBits.size();
+    ret.triggerBitsValid = true;
+    for (UInt group = 0; group < ret.controlModeGroupCnt; group++) {
+        const Json &groupControlBits = ret.controlMode["control_bits"][group];
+        ControlGroupBits cgb;
+        UInt nrGroupControlBits = groupControlBits.size();
+        for (UInt idx = 0; idx < nrGroupControlBits; idx++) {
+            cgb.codewordBits.push_back(groupControlBits[nrGroupControlBits - 1 - idx].get<Digital>());   // NB: groupControlBits defines MSB..LSB
+        }
+        cgb.codewordShift = cgb.codewordBits.empty() ? -1 : cgb.codewordBits[0];
+        for (UInt bit = 1; bit < cgb.codewordBits.size(); bit++) {
+            if (cgb.codewordBits[bit] != cgb.codewordBits[0] + bit) {
+                cgb.codewordShift = -1;
+                break;
+            }
+        }
+
+        // NB: the order of these checks determines what happens when there are 2 groups with 2 trigger bits
+        cgb.triggerMask = 0;
+        if (nrTriggerBits == 0) {                                   // no trigger
+            // do nothing
+        } else if (nrTriggerBits == 1) {                            // single trigger for all groups
+            cgb.triggerMask |= 1ul << triggerBits[0].get<Int>();
+#if 1    // FIXME: hotfix for QWG, implement properly
+        } else if (nrTriggerBits == 2) {
+            cgb.triggerMask |= 1ul << triggerBits[0].get<Int>();
+            cgb.triggerMask |= 1ul << triggerBits[1].get<Int>();
+#endif
+#if 1   // FIXME: trigger per group
+        } else if (nrTriggerBits == ret.controlModeGroupCnt) {      // trigger per group
+            cgb.triggerMask |= 1ul << triggerBits[group].get<Int>();
+#endif
+        } else {
+            ret.triggerBitsValid = false;                           // reported when the instrument is actually used
+        }
+        ret.controlGroupBits.push_back(cgb);
+    }
+
 
 
     // get instrument definition reference for for instrument
@@ -288,59 +384,15 @@ Int Settings::getResultBit(const InstrumentControl &ic, Int group) {
 // NB: this implies that we map signal *vectors* to groups, i.e. it is not possible to map individual channels
 // Conceptually, this is were we map an abstract signal definition, eg: {"flux", q3} (which may also be
 // interpreted as port "q3.flux") onto an instrument & group
-Settings::SignalInfo Settings::findSignalInfoForQubit(const Str &instructionSignalType, UInt qubit) const {
-    SignalInfo ret;
-    Bool signalTypeFound = false;
-    Bool qubitFound = false;
-
-    // iterate over instruments
-    for (UInt instrIdx = 0; instrIdx < jsonInstruments->size() && !qubitFound; instrIdx++) {
-        InstrumentControl ic = getInstrumentControl(instrIdx);
-        Str instrumentSignalType = json_get<Str>(*ic.ii.instrument, "signal_type", ic.ii.instrumentName);
-        if (instrumentSignalType == instructionSignalType) {
-            signalTypeFound = true;
-            const Json qubits = json_get<const Json>(*ic.ii.instrument, "qubits", ic.ii.instrumentName);   // NB: json_get<const json&> unavailable
-
-            // verify group size: qubits vs. control mode
-            UInt qubitGroupCnt = qubits.size();                                  // NB: JSON key qubits is a 'matrix' of [groups*qubits]
-            if (qubitGroupCnt != ic.controlModeGroupCnt) {
-                QL_JSON_FATAL(
-                    "instrument " << ic.ii.instrumentName
-                    << ": number of qubit groups " << qubitGroupCnt
-                    << " does not match number of control_bits groups " << ic.controlModeGroupCnt
-                    << " of selected control mode '" << ic.refControlMode << "'"
-                );
-            }
-
-            // anyone connected to qubit?
-            for (UInt group = 0; group < qubitGroupCnt && !qubitFound; group++) {
-                for (UInt idx = 0; idx < qubits[group].size() && !qubitFound; idx++) {
-                    if (qubits[group][idx].get<UInt>() == qubit) {
-                        qubitFound = true;                                      // also: stop searching
-
-                        QL_DOUT(
-                            "qubit " << qubit
-                            << " signal type '" << instructionSignalType
-                            << "' driven by instrument '" << ic.ii.instrumentName
-                            << "' group " << group
-                        );
-
-                        ret.ic = ic;
-                        ret.instrIdx = instrIdx;
-                        ret.group = group;
-                    }
-                }
-            }
+const Settings::SignalInfo &Settings::findSignalInfoForQubit(const Str &instructionSignalType, UInt qubit) const {
+    auto it = signalInfoTable.find(std::make_pair(instructionSignalType, qubit));
+    if (it == signalInfoTable.end()) {
+        if (signalTypes.find(instructionSignalType) == signalTypes.end()) {
+            QL_JSON_FATAL("No instruments found providing signal type '" << instructionSignalType << "'");
         }
-    }
-    if (!signalTypeFound) {
-        QL_JSON_FATAL("No instruments found providing signal type '" << instructionSignalType << "'");
-    }
-    if (!qubitFound) {
         QL_JSON_FATAL("No instruments found driving qubit " << qubit << " for signal type '" << instructionSignalType << "'");
     }
-
-    return ret;
+    return it->second;
 }
 
 /************************************************************************\
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include "ql/ir/compat/platform.h"
 #include "types.h"
 #include "options.h"
@@ -36,12 +39,20 @@ public: // types
 #endif
     };
 
+    struct ControlGroupBits {       // bit layout of a group in key 'control_bits', precomputed from the control mode
+        Vec<Digital> codewordBits;  // digital output bit for every code word bit, LSB first
+        Int codewordShift;          // shift that maps the code word onto the digital outputs if these are contiguous, -1 otherwise
+        Digital triggerMask;        // trigger bits to add to the digital outputs of the group
+    };
+
     struct InstrumentControl {      // information from key 'instruments/ref_control_mode'
         InstrumentInfo ii;
         Str refControlMode;
         Json controlMode;           // FIXME: pointer
         UInt controlModeGroupCnt;   // number of groups in key 'control_bits' of effective control mode
         UInt controlModeGroupSize;  // the size (#channels) of the effective control mode group
+        Vec<ControlGroupBits> controlGroupBits;     // vector[controlModeGroup]
+        Bool triggerBitsValid;      // whether the number of bits in key 'trigger_bits' is supported
     };
 
     struct SignalInfo {
@@ -57,6 +68,7 @@ public: // functions
     ~Settings() = default;
 
     void loadBackendSettings(const ir::compat::PlatformRef &platform);
+    void buildLookupTables();
     Str getReadoutMode(const Str &iname);
     static Bool isReadout(const Json &instruction, const Str &iname);
     Bool isReadout(const Str &iname);
@@ -65,13 +77,13 @@ public: // functions
     Bool isPragma(const Str &iname);
     RawPtr<const Json> getPragma(const Str &iname);
     static SignalDef findSignalDefinition(const Json &instruction, RawPtr<const Json> signals, const Str &iname);
-    SignalDef findSignalDefinition(const Json &instruction, const Str &iname) const;
-    InstrumentInfo getInstrumentInfo(UInt instrIdx) const;
-    InstrumentControl getInstrumentControl(UInt instrIdx) const;
+    const SignalDef &findSignalDefinition(const Json &instruction, const Str &iname) const;
+    const InstrumentInfo &getInstrumentInfo(UInt instrIdx) const;
+    const InstrumentControl &getInstrumentControl(UInt instrIdx) const;
     static Int getResultBit(const InstrumentControl &ic, Int group) ;
 
     // find instrument/group providing instructionSignalType for qubit
-    SignalInfo findSignalInfoForQubit(const Str &instructionSignalType, UInt qubit) const;
+    const SignalInfo &findSignalInfoForQubit(const Str &instructionSignalType, UInt qubit) const;
 
     static Int findStaticCodewordOverride(const Json &instruction, UInt operandIdx, const Str &iname);
 
@@ -79,12 +91,23 @@ public: // functions
     const Json &getInstrumentAtIdx(UInt instrIdx) const { return (*jsonInstruments)[instrIdx]; }
     UInt getInstrumentsSize() const { return jsonInstruments->size(); }
 
+private:    // funcs
+    InstrumentInfo calcInstrumentInfo(UInt instrIdx) const;
+    InstrumentControl calcInstrumentControl(UInt instrIdx) const;
+
 private:    // vars
     ir::compat::PlatformRef platform;
     RawPtr<const Json> jsonInstrumentDefinitions;
     RawPtr<const Json> jsonControlModes;
     RawPtr<const Json> jsonInstruments;
     RawPtr<const Json> jsonSignals;
+    std::unordered_map<Str, Bool> readoutCache;     // isReadout() result per instruction name
+
+    // lookup tables filled by buildLookupTables(), such that code generation does not have to walk the JSON per gate
+    Vec<InstrumentControl> instrumentControls;                      // vector[instrIdx]
+    std::map<std::pair<Str, UInt>, SignalInfo> signalInfoTable;    // instrument & group per (instructionSignalType, qubit)
+    std::unordered_set<Str> signalTypes;                            // all instrument signal types
+    mutable std::unordered_map<Str, SignalDef> signalDefCache;      // findSignalDefinition() result per instruction name
 }; // class
 
 } // namespace detail
@@ -23,12 +23,17 @@ namespace detail {
 using namespace utils;
 
 // NB: parameters qubitNumber and cycleTime originate from OpenQL variable 'platform'
-void Vcd::programStart(UInt qubitNumber, Int cycleTime, Int maxGroups, const Settings &settings) {
+void Vcd::programStart(UInt qubitNumber, Int cycleTime, Int maxGroups, const Settings &settings, const Str &filename) {
     this->cycleTime = cycleTime;
     kernelStartTime = 0;
 
+    // the VCD is streamed to the file while generating code
+    QL_IOUT("Writing Value Change Dump to " << filename);
+    file.emplace(filename);
+
     // define header
-    start();
+    start(file->unwrap());
+    vcdValueEmpty = intern("");
 
     // define kernel variable
     scope(Vcd::Scope::MODULE, "kernel");
@@ -73,25 +78,52 @@ void Vcd::programStart(UInt qubitNumber, Int cycleTime, Int maxGroups, const Set
 }
 
 
-void Vcd::programFinish(const Str &filename) {
-    // generate VCD
+void Vcd::programFinish() {
+    // write remaining changes
     finish();
+    file->close();
+    file.reset();
+}
 
-    // write VCD to file
-    QL_IOUT("Writing Value Change Dump to " << filename);
-    OutFile(filename).write(getVcd());
+
+// NB: changes before the start of the kernel are written out here, so only the changes of a single kernel are pending
+void Vcd::kernelStart(const Str &kernelName) {
+    kernelChanges.clear();
+    flush(kernelStartTime);
+    vcdValueKernel = intern(kernelName);
+    changeInterned(vcdVarKernel, kernelStartTime, vcdValueKernel);     // start of kernel
 }
 
 
-void Vcd::kernelFinish(const Str &kernelName, UInt durationInCycles) {
+void Vcd::kernelFinish(UInt durationInCycles) {
     // NB: timing starts anew for every kernel
     UInt durationInNs = durationInCycles * cycleTime;
-    change(vcdVarKernel, kernelStartTime, kernelName);          // start of kernel
-    change(vcdVarKernel, kernelStartTime + durationInNs, "");   // end of kernel
+    changeInterned(vcdVarKernel, kernelStartTime + durationInNs, vcdValueEmpty);   // end of kernel
     kernelStartTime += durationInNs;
 }
 
 
+// repeat the changes of the last kernel count times, for kernels that the code generator folded into a loop
+void Vcd::kernelRepeat(const Str &kernelName, UInt durationInCycles, UInt count) {
+    for (UInt i = 0; i < count; i++) {
+        flush(kernelStartTime);
+        changeInterned(vcdVarKernel, kernelStartTime, vcdValueKernel);     // start of kernel
+        for (const auto &kc : kernelChanges) {
+            changeInterned(kc.var, kernelStartTime + kc.time, kc.value);
+        }
+        kernelFinish(durationInCycles);
+    }
+}
+
+
+// change of a signal within the current kernel, which is also remembered for kernelRepeat()
+void Vcd::kernelChange(Int var, UInt time, const Str &value) {
+    ValueId id = intern(value);
+    changeInterned(var, kernelStartTime + time, id);
+    kernelChanges.push_back({var, time, id});
+}
+
+
 void Vcd::bundleFinishGroup(
     UInt startCycle,
     UInt durationInCycles,
@@ -101,35 +133,38 @@ void Vcd::bundleFinishGroup(
     Int group
 ) {
     // generate signal output for group
-    UInt startTime = kernelStartTime + startCycle * cycleTime;
+    UInt startTime = startCycle * cycleTime;
     UInt durationInNs = durationInCycles * cycleTime;
     Int var = vcdVarSignal[instrIdx][group];
     Str val = QL_SS2S(groupDigOut) + "=" + signalValue;
-    change(var, startTime, val);                                // start of signal
-    change(var, startTime + durationInNs, "");                  // end of signal
+    kernelChange(var, startTime, val);                          // start of signal
+    kernelChange(var, startTime + durationInNs, "");            // end of signal
 }
 
 
 void Vcd::bundleFinish(UInt startCycle, Digital digOut, UInt maxDurationInCycles, UInt instrIdx) {
     // generate codeword output for instrument
-    UInt startTime = kernelStartTime + startCycle * cycleTime;
+    UInt startTime = startCycle * cycleTime;
     UInt durationInNs = maxDurationInCycles * cycleTime;
     Int var = vcdVarCodeword[instrIdx];
     Str val = QL_SS2S("0x" << std::hex << std::setfill('0') << std::setw(8) << digOut);
-    change(var, startTime, val);                                // start of signal
-    change(var, startTime+durationInNs, "");                    // end of signal
+    kernelChange(var, startTime, val);                          // start of signal
+    kernelChange(var, startTime+durationInNs, "");              // end of signal
 }
 
 
 void Vcd::customGate(const Str &iname, const Vec<UInt> &qops, UInt startCycle, UInt durationInCycles) {
     // generate qubit VCD output
-    UInt startTime = kernelStartTime + startCycle*cycleTime;
+    UInt startTime = startCycle*cycleTime;
+
+    // NB: bundles arrive in order of start cycle, and no change of this or later bundles precedes the start of the bundle
+    flush(kernelStartTime + startTime);
     UInt durationInNs = durationInCycles*cycleTime;
     for (UInt i = 0; i < qops.size(); i++) {
         Int var = vcdVarQubit[qops[i]];
         Str name = iname;                                       // FIXME: improve name for 2q gates
-        change(var, startTime, name);                           // start of instruction
-        change(var, startTime + durationInNs, "");              // end of instruction
+        kernelChange(var, startTime, name);                     // start of instruction
+        kernelChange(var, startTime + durationInNs, "");        // end of instruction
     }
 }
 
@@ -9,6 +9,8 @@
 #pragma once
 
 #include "ql/utils/vcd.h"
+#include "ql/utils/ptr.h"
+#include "ql/utils/filesystem.h"
 
 #include "types.h"
 #include "settings.h"
@@ -26,20 +28,36 @@ public:     // funcs
     Vcd() = default;
     ~Vcd() = default;
 
-    void programStart(UInt qubitNumber, Int cycleTime, Int maxGroups, const Settings &settings);
-    void programFinish(const Str &filename);
-    void kernelFinish(const Str &kernelName, UInt durationInCycles);
+    void programStart(UInt qubitNumber, Int cycleTime, Int maxGroups, const Settings &settings, const Str &filename);
+    void programFinish();
+    void kernelStart(const Str &kernelName);
+    void kernelFinish(UInt durationInCycles);
+    void kernelRepeat(const Str &kernelName, UInt durationInCycles, UInt count);
     void bundleFinishGroup(UInt startCycle, UInt durationInCycles, Digital groupDigOut, const Str &signalValue, UInt instrIdx, Int group);
     void bundleFinish(UInt startCycle, Digital digOut, UInt maxDurationInCycles, UInt instrIdx);
     void customGate(const Str &iname, const Vec<UInt> &qops, UInt startCycle, UInt durationInCycles);
 
+private:    // types
+    struct KernelChange {
+        Int var;
+        UInt time;                                              // relative to start of kernel
+        ValueId value;
+    };
+
+private:    // funcs
+    void kernelChange(Int var, UInt time, const Str &value);
+
 private:    // vars
+    Ptr<utils::OutFile> file;                                   // VCD output, written while generating code
     UInt cycleTime = 1;
     UInt kernelStartTime = 0;
     Int vcdVarKernel = 0;
     Vec<Int> vcdVarQubit;
     Vec<Vec<Int>> vcdVarSignal;
     Vec<Int> vcdVarCodeword;
+    ValueId vcdValueEmpty = 0;                                  // interned ""
+    ValueId vcdValueKernel = 0;                                 // interned name of current kernel
+    Vec<KernelChange> kernelChanges;                            // changes of current kernel, for kernelRepeat()
 };
 
 } // namespace detail
@@ -31,6 +31,9 @@ void GenerateVQ1AsmPass::dump_docs(
      - `<prefix>.vcd`: a VCD (value change dump) file for viewing the waveforms
        that the program outputs.
 
+    When `object_output` is set, the program is additionally written as object
+    code (`<prefix>.vq1obj`) with a symbol file (`<prefix>.vq1sym`).
+
     The pass is compile-time configured with the following options:
      - `OPT_CC_SCHEDULE_RC` = )"           + utils::to_string(OPT_CC_SCHEDULE_RC)           + R"(
      - `OPT_SUPPORT_STATIC_CODEWORDS` = )" + utils::to_string(OPT_SUPPORT_STATIC_CODEWORDS) + R"(
@@ -55,7 +58,7 @@ GenerateVQ1AsmPass::GenerateVQ1AsmPass(
     const utils::Ptr<const pmgr::Factory> &pass_factory,
     const utils::Str &instance_name,
     const utils::Str &type_name
-) : pmgr::pass_types::ProgramTransformation(pass_factory, instance_name, type_name) {
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
 
     options.add_str(
         "map_input_file",
@@ -75,34 +78,59 @@ GenerateVQ1AsmPass::GenerateVQ1AsmPass(
         "indefinitely."
     );
 
+    options.add_bool(
+        "fold_repeated_kernels",
+        "When set, consecutive identical kernels (for instance a calibration "
+        "kernel that is added to the program many times) are emitted once, "
+        "inside a loop that repeats it. This does not change the timing of "
+        "the program, but reduces code generation time and program size. "
+        "Kernels that use feedback, conditional gates, or pragmas are never "
+        "folded.",
+        true
+    );
+
+    options.add_bool(
+        "object_output",
+        "When set, the program is also written as pre-tokenized object code "
+        "to <prefix>.vq1obj, such that it does not need to be assembled from "
+        "text. The instructions are stored as mnemonic and typed operands, "
+        "with a label and relocation table; <prefix>.vq1sym lists the labels "
+        "and relocations in JSON form for debugging. See "
+        "arch/cc/pass/gen/vq1asm/detail/object.h for the layout.",
+        false
+    );
+
+    options.add_int(
+        "kernel_threads",
+        "The number of threads to use for bundling the kernels before code "
+        "generation. The code itself is generated in kernel order. 0 means use all "
+        "hardware threads.",
+        "1",
+        0
+    );
+
 }
 
 /**
  * Runs the code generator.
  */
 utils::Int GenerateVQ1AsmPass::run(
-    const ir::compat::ProgramRef &program,
+    const ir::Ref &ir,
     const pmgr::pass_types::Context &context
 ) const {
 
-    // Make sure that the incoming code is scheduled, as expected.
-    for (const auto &kernel : program->kernels) {
-        if (!kernel->cycles_valid) {
-            throw utils::Exception(
-                "The code going into the CC backend must be scheduled, but isn't!"
-            );
-        }
-    }
-
     // Parse the options.
     auto parsed_options = utils::Ptr<detail::Options>::make();
     parsed_options->output_prefix = context.output_prefix;
     parsed_options->map_input_file = options["map_input_file"].as_str();
     parsed_options->run_once = options["run_once"].as_bool();
     parsed_options->verbose = options["verbose"].as_bool();
+    parsed_options->fold_repeated_kernels = options["fold_repeated_kernels"].as_bool();
+    parsed_options->object_output = options["object_output"].as_bool();
+    parsed_options->num_threads = options["kernel_threads"].as_uint();
 
     // Run the backend.
-    detail::Backend().compile(program, parsed_options.as_const());
+    detail::Backend().compile(ir, parsed_options.as_const());
 
     return 0;
 }
@@ -1,6 +1,6 @@
 #include "ql/utils/str.h"
 #include "ql/utils/filesystem.h"
-#include "ql/ir/compat/platform.h"
+#include "ql/ir/ir.h"
 #include "ql/com/options.h"
 #include "functions.h"
 
@@ -34,15 +34,15 @@ Str switchOff(UInt arg) {
 /**
  * Function for load immediate (LDi)
  */
-Str loadimm(Str value, Str reg_name, Str reg_value) {
-    Str body = "LDi " + value + ", " + reg_name + to_string(reg_value);
+Str loadimm(const Str &value, const Str &reg_name, const Str &reg_value) {
+    Str body = "LDi " + value + ", " + reg_name + reg_value;
     return body;
 }
 
 /**
  * Function for move (mov)
  */
-Str mov(Str reg1_name, Str reg1_value, Str reg2_name, Str reg2_value) {
+Str mov(const Str &reg1_name, const Str &reg1_value, const Str &reg2_name, const Str &reg2_value) {
     Str body = "mov " + reg1_name + reg1_value + ", " + reg2_name + reg2_value;
     return body;
 }
@@ -50,10 +50,10 @@ Str mov(Str reg1_name, Str reg1_value, Str reg2_name, Str reg2_value) {
 /**
  * Function for exciting the qubit with a custom laser (excite_mw)
  */
-Str excite_mw(Str envelope, Str duration, Str frequency, Str phase, Str amp, UInt qubit){
-    Str body_1 = "excite_MW " + to_string(envelope) + ", " +  to_string(duration) + ", ";
-    Str body_2 = to_string(frequency) + ", " + to_string(phase) + ", " +
-        to_string(amp)+ ", q" + to_string(qubit);
+Str excite_mw(const Str &envelope, const Str &duration, const Str &frequency, const Str &phase, const Str &amp, UInt qubit){
+    Str body_1 = "excite_MW " + envelope + ", " +  duration + ", ";
+    Str body_2 = frequency + ", " + phase + ", " +
+        amp + ", q" + to_string(qubit);
     Str body = body_1 + body_2;
     return body;
 }
@@ -61,16 +61,16 @@ Str excite_mw(Str envelope, Str duration, Str frequency, Str phase, Str amp, UIn
 /**
  * Function for branch instructions (br)
  */
-Str branch(Str name_1, Str value_1, Str comparison, Str name_2, Str value_2, Str target_name, Str target_value) {
-    Str compare = name_1 + to_string(value_1) + comparison + name_2 + to_string(value_2);
-    Str body = "BR " + compare +", " + target_name + to_string(target_value);
+Str branch(const Str &name_1, const Str &value_1, const Str &comparison, const Str &name_2, const Str &value_2, const Str &target_name, const Str &target_value) {
+    Str compare = name_1 + value_1 + comparison + name_2 + value_2;
+    Str body = "BR " + compare +", " + target_name + target_value;
     return body;
 }
 
 /**
  * Function for creating a label (label)
  */
-Str label(Str labelcount){
+Str label(const Str &labelcount){
    Str body = "LABEL LAB" + labelcount;
    return body;
 }
@@ -78,7 +78,7 @@ Str label(Str labelcount){
 /**
  * Function for single qubit gate (qgate)
  */
-Str qgate(Str gatename, UInt operand) {
+Str qgate(const Str &gatename, UInt operand) {
     Str body_1 = "qgate " + to_upper(gatename) + ", ";
     Str body_2 = "q" + to_string(operand);
     Str body = body_1 + body_2;
@@ -88,7 +88,7 @@ Str qgate(Str gatename, UInt operand) {
 /**
  * Function for two-qubit gate (qgate2)
  */
-Str qgate2(Str gatename, Str operand_1, Str operand_2) {
+Str qgate2(const Str &gatename, const Str &operand_1, const Str &operand_2) {
     Str body_1 = "qgate2 " + to_upper(gatename) + ", ";
     Str body_2 = operand_1 + ", " + operand_2;
     Str body = body_1 + body_2;
@@ -98,7 +98,7 @@ Str qgate2(Str gatename, Str operand_1, Str operand_2) {
 /**
  * Function for storing information in memory (ST)
  */
-Str store(Str reg_name1, Str reg_value1, Str reg_name2, Str reg_value2, Str memaddr){
+Str store(const Str &reg_name1, const Str &reg_value1, const Str &reg_name2, const Str &reg_value2, const Str &memaddr){
     Str body_1 = "ST " + reg_name1 + reg_value1 + ", " + reg_name2 + reg_value2 + "($" + memaddr + ")";
 
 //    Str body_2;
@@ -113,7 +113,7 @@ Str store(Str reg_name1, Str reg_value1, Str reg_name2, Str reg_value2, Str mema
 /**
  * Function for addition (ADD)
  */
-Str add(Str name_1, Str value_1, Str name_2, Str value_2, Str name_3, Str value_3) {
+Str add(const Str &name_1, const Str &value_1, const Str &name_2, const Str &value_2, const Str &name_3, const Str &value_3) {
     Str body = "ADD " + name_1 + value_1 + ", " + name_2 + value_2 + ", " + name_3 + value_3;
     return body;
 }
@@ -121,7 +121,7 @@ Str add(Str name_1, Str value_1, Str name_2, Str value_2, Str name_3, Str value_
 /**
  * Function for immediate addition (ADDi)
  */
-Str addimm(Str value, Str regname, Str regvalue) {
+Str addimm(const Str &value, const Str &regname, const Str &regvalue) {
     Str body = "ADDi " + regname + regvalue + ", " + value;
     return body;
 }
@@ -129,11 +129,113 @@ Str addimm(Str value, Str regname, Str regvalue) {
 /**
  * Function for unconditional jump (jump)
  */
-Str jump(Str labelcount) {
+Str jump(const Str &labelcount) {
     Str body = "JUMP LAB" + labelcount;
     return body;
 }
 
+/**
+ * Returns the microcode sequence for a gate with the given diamond_type and
+ * name.
+ */
+Microcode find_microcode(const Str &type, const Str &name) {
+    if (type == "qgate") {
+        return Microcode::QGATE;
+    } else if (type == "qgate2") {
+        return Microcode::QGATE2;
+    } else if (type == "rotation") {
+        if (name == "rx") return Microcode::RX;
+        if (name == "ry") return Microcode::RY;
+        if (name == "rz") return Microcode::RZ;
+        if (name == "cr") return Microcode::CR;
+        if (name == "crk") return Microcode::CRK;
+
+        // Alternate representation of x90, mx90, y90 and my90. Now works with using qgate.
+        // Can be changed to excite_MW by setting diamond_type in hw config file to
+        // "rotation" instead of "qgate".
+        if (name == "x90") return Microcode::X90;
+        if (name == "mx90") return Microcode::MX90;
+        if (name == "y90") return Microcode::Y90;
+        if (name == "my90") return Microcode::MY90;
+        return Microcode::NONE;
+    } else if (type == "prepare") {
+        // prep_z needs nothing, already in z-basis
+        if (name == "prep_x") return Microcode::PREP_X;
+        if (name == "prep_y") return Microcode::PREP_Y;
+        if (name == "mprep_x") return Microcode::MPREP_X;
+        if (name == "mprep_y") return Microcode::MPREP_Y;
+        return Microcode::NONE;
+    } else if (type == "classical") {
+        if (name == "calculate_current") return Microcode::CALCULATE_CURRENT;
+        if (name == "calculate_voltage") return Microcode::CALCULATE_VOLTAGE;
+        return Microcode::NONE;
+    } else if (type == "initial_checks") {
+        // mag_bias needs nothing, because it is decomposed into sweep_bias and
+        // calculate_current by the generator
+        if (name == "rabi_check") return Microcode::RABI_CHECK;
+        if (name == "crc") return Microcode::CRC;
+        return Microcode::NONE;
+    } else if (type == "calibration") {
+        if (name == "decouple") return Microcode::DECOUPLE;
+        if (name == "cal_measure") return Microcode::CAL_MEASURE;
+        if (name == "cal_pi") return Microcode::CAL_PI;
+        if (name == "cal_halfpi") return Microcode::CAL_HALFPI;
+        return Microcode::NONE;
+    }
+
+    if (name == "measure") return Microcode::MEASURE;
+    if (name == "initialize") return Microcode::INITIALIZE;
+    if (name == "wait") return Microcode::WAIT;
+    if (name == "barrier") return Microcode::NONE;
+    if (name == "qnop") return Microcode::QNOP;
+    if (name == "sweep_bias") return Microcode::SWEEP_BIAS;
+    if (name == "excite_mw") return Microcode::EXCITE_MW;
+    if (name == "memswap") return Microcode::MEMSWAP;
+    if (name == "qentangle") return Microcode::QENTANGLE;
+    if (name == "nventangle") return Microcode::NVENTANGLE;
+    return Microcode::UNSUPPORTED;
+}
+
+/**
+ * Adds the given instruction type and its specializations to the microcode
+ * table. Specializations normally share the name and diamond_type of their
+ * generalization, but if only a specialization defines the diamond_type, that
+ * one is used.
+ */
+static void add_to_microcode_table(
+    MicrocodeTable &table,
+    const ir::InstructionType &insn
+) {
+    Str type = "unknown";
+    const auto &data = insn.data.data;
+    if (data.is_object()) {
+        auto iterator = data.find("diamond_type");
+        if (iterator != data.end() && iterator->is_string()) {
+            type = iterator->get<Str>();
+        }
+    }
+    if (type != "unknown" || table.find(insn.name) == table.end()) {
+        table[insn.name] = find_microcode(type, insn.name);
+    }
+    for (const auto &specialization : insn.specializations) {
+        add_to_microcode_table(table, *specialization);
+    }
+}
+
+/**
+ * Builds the microcode table for all instructions of the platform, such that
+ * the generator doesn't need to look up the instruction JSON and compare names
+ * for every gate. Waits are not custom instructions in the new IR, so the
+ * generator handles those itself.
+ */
+MicrocodeTable build_microcode_table(const ir::Ref &ir) {
+    MicrocodeTable table;
+    for (const auto &insn : ir->platform->instructions) {
+        add_to_microcode_table(table, *insn);
+    }
+    return table;
+}
+
 
 } // namespace detail
 } // namespace microcode
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <unordered_map>
+#include "ql/utils/str.h"
+#include "ql/ir/ir.h"
+
 namespace ql {
 namespace arch {
 namespace diamond {
@@ -23,57 +27,106 @@ Str switchOff(UInt qubit_path );
 /**
  * Function for load immediate (LDi)
  */
-Str loadimm(Str value, Str reg_name, Str reg_value);
+Str loadimm(const Str &value, const Str &reg_name, const Str &reg_value);
 
 /**
  * Function for move (mov)
  */
-Str mov(Str reg1_name, Str reg1_value, Str reg2_name, Str reg2_value);
+Str mov(const Str &reg1_name, const Str &reg1_value, const Str &reg2_name, const Str &reg2_value);
 
 /**
  * Function for exciting the qubit with a custom laser (excite_mw)
  */
-Str excite_mw(Str envelope, Str duration, Str frequency, Str phase, Str amp, UInt qubit);
+Str excite_mw(const Str &envelope, const Str &duration, const Str &frequency, const Str &phase, const Str &amp, UInt qubit);
 
 /**
  * Function for branch instructions (br)
  */
-Str branch(Str name_1, Str value_1, Str comparison, Str name_2, Str value_2, Str target_name, Str target_value);
+Str branch(const Str &name_1, const Str &value_1, const Str &comparison, const Str &name_2, const Str &value_2, const Str &target_name, const Str &target_value);
 
 /**
  * Function for creating a label (label)
  */
-Str label(Str labelcount);
+Str label(const Str &labelcount);
 
 /**
  * Function for single qubit gate (qgate)
  */
-Str qgate(Str gatename, UInt operand);
+Str qgate(const Str &gatename, UInt operand);
 
 /**
  * Function for two-qubit gate (qgate2)
  */
-Str qgate2(Str gatename, Str operand_1, Str operand_2);
+Str qgate2(const Str &gatename, const Str &operand_1, const Str &operand_2);
 
 /**
  * Function for storing information in memory (ST)
  */
-Str store(Str reg_name1, Str reg_value1, Str reg_name2, Str reg_value2, Str memaddr);
+Str store(const Str &reg_name1, const Str &reg_value1, const Str &reg_name2, const Str &reg_value2, const Str &memaddr);
 
 /**
  * Function for addition (ADD)
  */
-Str add(Str name_1, Str value_1, Str name_2, Str value_2, Str name_3, Str value_3);
+Str add(const Str &name_1, const Str &value_1, const Str &name_2, const Str &value_2, const Str &name_3, const Str &value_3);
 
 /**
  * Function for immediate addition (ADDi)
  */
-Str addimm(Str value, Str regname, Str regvalue);
+Str addimm(const Str &value, const Str &regname, const Str &regvalue);
 
 /**
  * Function for unconditional jump (jump)
  */
-Str jump(Str labelcount);
+Str jump(const Str &labelcount);
+
+/**
+ * The microcode sequences that the generator knows how to emit.
+ */
+enum class Microcode {
+    NONE,
+    QGATE,
+    QGATE2,
+    RX,
+    RY,
+    RZ,
+    CR,
+    CRK,
+    X90,
+    MX90,
+    Y90,
+    MY90,
+    PREP_X,
+    PREP_Y,
+    MPREP_X,
+    MPREP_Y,
+    CALCULATE_CURRENT,
+    CALCULATE_VOLTAGE,
+    RABI_CHECK,
+    CRC,
+    DECOUPLE,
+    CAL_MEASURE,
+    CAL_PI,
+    CAL_HALFPI,
+    MEASURE,
+    INITIALIZE,
+    WAIT,
+    QNOP,
+    SWEEP_BIAS,
+    EXCITE_MW,
+    MEMSWAP,
+    QENTANGLE,
+    NVENTANGLE,
+    UNSUPPORTED
+};
+
+/**
+ * Map from instruction name to microcode sequence.
+ */
+using MicrocodeTable = std::unordered_map<Str, Microcode>;
+
+Microcode find_microcode(const Str &type, const Str &name);
+
+MicrocodeTable build_microcode_table(const ir::Ref &ir);
 } // namespace detail
 } // namespace microcode
 } // namespace gen
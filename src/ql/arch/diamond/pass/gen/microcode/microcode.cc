@@ -10,8 +10,13 @@
 #include "ql/pmgr/pass_types/base.h"
 
 #include "ql/utils/str.h"
+#include "ql/utils/set.h"
+#include "ql/utils/map.h"
+#include "ql/utils/exception.h"
 #include "ql/utils/filesystem.h"
-#include "ql/ir/compat/platform.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/ir/old_to_new.h"
 #include "ql/com/options.h"
 
 namespace ql {
@@ -33,728 +38,1235 @@ void GenerateMicrocodePass::dump_docs(
     utils::dump_str(os, line_prefix, R"(
     Generates the microcode from the algorithm (cQASM/C++/Python) description
     for quantum computing in diamond.
+
+    The program must not contain structured control-flow; run dec.Structure
+    first if it does. Gotos and block successors that are not the next block
+    in the program are emitted as jumps.
+
+    Before the gates of each block, the generator emits a magnetic bias
+    sweep, bias current calculation, Rabi check, CRC, and initialization for
+    every qubit, and it emits a CRC for every qubit after every 10 gates.
+    These calibration gates are also inserted into the program, so passes
+    that run after this one see them, and the schedule of the program is no
+    longer valid.
     )");
 }
 
-utils::Str GenerateMicrocodePass::get_friendly_type() const {
-    return "Diamond microcode generator";
+/**
+ * Returns the excite_MW duration for a custom rotation over the given angle.
+ */
+static Str rotation_duration(Real angle) {
+    UInt a = 1000 / 3.14159265359;
+    return to_string(a * angle);
 }
 
-GenerateMicrocodePass::GenerateMicrocodePass(
-    const utils::Ptr<const pmgr::Factory> &pass_factory,
-    const utils::Str &instance_name,
-    const utils::Str &type_name
-) : pmgr::pass_types::ProgramTransformation(pass_factory, instance_name, type_name) {
-
+/**
+ * Returns the number of trailing integer literal operands that carry the
+ * Diamond-specific parameters (see annotations.h) for the given microcode.
+ */
+static UInt get_num_parameters(detail::Microcode microcode) {
+    switch (microcode) {
+        case detail::Microcode::EXCITE_MW: return 5;
+        case detail::Microcode::MEMSWAP: return 1;
+        case detail::Microcode::QENTANGLE: return 1;
+        case detail::Microcode::SWEEP_BIAS: return 6;
+        case detail::Microcode::CRC: return 2;
+        case detail::Microcode::RABI_CHECK: return 3;
+        default: return 0;
+    }
 }
 
-utils::Int GenerateMicrocodePass::run(
-    const ir::compat::ProgramRef &program,
-    const pmgr::pass_types::Context &context
-) const {
-    // General Idea: Make a big case statement with all the different options that
-    // cQASM provides. Then, decide for each option what to write to the output file.
+/**
+ * A gate as seen by the generator. Statements are reduced to this form before
+ * their microcode is emitted.
+ */
+struct Gate {
+
+    /**
+     * The name of the instruction.
+     */
+    Str name;
+
+    /**
+     * The microcode sequence for the instruction.
+     */
+    detail::Microcode microcode = detail::Microcode::NONE;
+
+    /**
+     * The qubit operands.
+     */
+    Vec<UInt> qubits;
+
+    /**
+     * The creg and breg operands. These are only used for the comment line.
+     */
+    Vec<UInt> cregs;
+    Vec<UInt> bregs;
+
+    /**
+     * The angle operand, or 0 if there is none.
+     */
+    Real angle = 0.0;
+
+    /**
+     * The Diamond-specific integer parameters.
+     */
+    Vec<UInt> parameters;
+
+    /**
+     * The duration in nanoseconds. Only used for waits, in which case
+     * duration_in_cycles is the duration as it appears in the comment line.
+     */
+    UInt duration = 0;
+    UInt duration_in_cycles = 0;
+
+    /**
+     * The breg that the gate is conditional on, or -1 if it is unconditional.
+     */
+    Int condition = -1;
+
+    /**
+     * The target block for gotos, in which case the microcode is NONE.
+     */
+    const ir::Block *target = nullptr;
+
+};
 
-    // Specify output file name
-    Str file_name(context.output_prefix + ".dqasm");
+/**
+ * Microcode generator for a program in the new IR. The program blocks are
+ * emitted in order. Before that, the magnetic bias, Rabi, and charge resonance
+ * checks and initialization of all qubits are inserted at the start of each
+ * block, and a charge resonance check of all qubits between every 10
+ * statements. The microcode of each block is written to the output file when
+ * the block is done.
+ */
+class MicrocodeGenerator {
+private:
+
+    /**
+     * The IR that we're generating code for.
+     */
+    const ir::Ref &ir;
+
+    /**
+     * The microcode for each instruction name of the platform.
+     */
+    detail::MicrocodeTable table;
+
+    /**
+     * The number of qubits used by the program.
+     */
+    UInt num_qubits;
+
+    /**
+     * The cycle time of the platform in nanoseconds.
+     */
+    UInt cycle_time;
+
+    /**
+     * The breg and creg objects, if any.
+     */
+    ir::ObjectLink breg_ob;
+    ir::ObjectLink creg_ob;
+
+    /**
+     * The blocks that are jumped to, and the labels allocated for them thus
+     * far. The label for the end of the program is stored for nullptr.
+     */
+    Set<const ir::Block*> targets;
+    Map<const ir::Block*, Str> block_labels;
+
+    /**
+     * Counter for the label numbers.
+     */
+    Int labelcount = 0;
+
+    /**
+     * The microcode for the current block.
+     */
+    StrStrm out;
+
+    /**
+     * Returns the label for the given block, or for the end of the program if
+     * nullptr.
+     */
+    const Str &get_block_label(const ir::Block *block) {
+        auto it = block_labels.find(block);
+        if (it != block_labels.end()) {
+            return it->second;
+        }
+        auto &label = block_labels.set(block);
+        label = to_string(labelcount++);
+        return label;
+    }
 
-    // Specify the outfile name
-    OutFile outfile{file_name};
+    /**
+     * Returns the microcode for the given instruction name.
+     */
+    detail::Microcode find_microcode(const Str &name) const {
+        auto entry = table.find(name);
+        if (entry == table.end()) {
+            QL_FATAL("JSON file: instruction not found: '" << name << "'");
+        }
+        return entry->second;
+    }
 
-    // Copy the kernel into a new kernel, add the necessary gates before and in between the existing gates.
-    for (const auto &kernel : program->kernels) {
-        ir::compat::Kernel temp_kernel(
-            "dummy",
-            program->platform,
-            kernel->qubit_count,
-            kernel->creg_count,
-            kernel->breg_count
+    /**
+     * Converts a reference to a single bit to its breg index, using the same
+     * numbering as the old IR: the implicit bits of the qubits first, then the
+     * breg register. Returns -1 if the reference is not a bit reference.
+     */
+    Int convert_breg_reference(const ir::Reference &ref) const {
+        if (ref.indices.size() != 1 || !ref.indices[0]->as_int_literal()) {
+            return -1;
+        }
+        auto index = ref.indices[0]->as_int_literal()->value;
+        if (ref.target == ir->platform->qubits && ref.data_type == ir->platform->default_bit_type) {
+            return index;
+        } else if (ref.target == breg_ob && ref.data_type == breg_ob->data_type) {
+            return index + num_qubits;
+        }
+        return -1;
+    }
+
+    /**
+     * Appends an operand of a statement to the given gate.
+     */
+    void convert_operand(const ir::ExpressionRef &expr, Gate &gate) const {
+        if (auto real_lit = expr->as_real_literal()) {
+            gate.angle = real_lit->value;
+        } else if (expr->as_int_literal()) {
+            // Integer operands other than the Diamond parameters don't affect
+            // the microcode.
+        } else if (auto ref = expr->as_reference()) {
+            if (ref->indices.size() != 1 || !ref->indices[0]->as_int_literal()) {
+                throw Exception(
+                    "encountered unsupported reference to " + ref->target->name
+                );
+            }
+            auto index = (UInt)ref->indices[0]->as_int_literal()->value;
+            auto breg = convert_breg_reference(*ref);
+            if (
+                ref->target == ir->platform->qubits &&
+                ref->data_type == ir->platform->qubits->data_type
+            ) {
+                gate.qubits.push_back(index);
+            } else if (breg >= 0) {
+                gate.bregs.push_back(breg);
+            } else if (ref->target == creg_ob && ref->data_type == creg_ob->data_type) {
+                gate.cregs.push_back(index);
+            } else {
+                throw Exception(
+                    "encountered unsupported reference to " + ref->target->name
+                );
+            }
+        } else {
+            throw Exception("encountered unsupported gate operand " + ir::describe(expr));
+        }
+    }
+
+    /**
+     * Converts the condition of an instruction.
+     */
+    void convert_condition(const ir::ExpressionRef &condition, Gate &gate) const {
+        if (auto blit = condition->as_bit_literal()) {
+            if (blit->value) {
+                return;
+            }
+        } else if (auto ref = condition->as_reference()) {
+            gate.condition = convert_breg_reference(*ref);
+            if (gate.condition >= 0) {
+                return;
+            }
+        }
+        throw Exception(
+            "gate with condition " + ir::describe(condition) + " is not supported"
         );
+    }
+
+    /**
+     * Reduces a statement to a gate.
+     */
+    Gate convert_statement(const ir::StatementRef &statement) const {
+        Gate gate;
+        if (auto wait = statement->as_wait_instruction()) {
+            gate.name = "wait";
+            gate.microcode = detail::Microcode::WAIT;
+            gate.duration = wait->duration * cycle_time;
+            gate.duration_in_cycles = wait->duration;
+        } else if (auto custom = statement->as_custom_instruction()) {
+            gate.name = custom->instruction_type->name;
+            gate.microcode = find_microcode(gate.name);
+            convert_condition(custom->condition, gate);
+            for (const auto &operand : custom->instruction_type->template_operands) {
+                convert_operand(operand, gate);
+            }
+            auto num_parameters = get_num_parameters(gate.microcode);
+            if (custom->operands.size() < num_parameters) {
+                throw Exception(
+                    "Diamond arch gate " + gate.name + " must have at least " +
+                    to_string(num_parameters) + " arguments"
+                );
+            }
+            auto num_operands = custom->operands.size() - num_parameters;
+            for (UInt i = 0; i < num_operands; i++) {
+                convert_operand(custom->operands[i], gate);
+            }
+            for (UInt i = num_operands; i < custom->operands.size(); i++) {
+                auto ilit = custom->operands[i]->as_int_literal();
+                if (!ilit || ilit->value < 0) {
+                    throw Exception(
+                        "operand " + to_string(i) + " of Diamond arch gate " +
+                        gate.name + " must be an unsigned integer literal"
+                    );
+                }
+                gate.parameters.push_back((UInt)ilit->value);
+            }
+        } else if (auto goto_insn = statement->as_goto_instruction()) {
+            gate.name = "goto";
+            convert_condition(goto_insn->condition, gate);
+            gate.target = goto_insn->target.get_ptr().get();
+        } else {
+            throw Exception(
+                "statement " + ir::describe(statement) + " is not supported by "
+                "the Diamond architecture; structured control-flow must be "
+                "decomposed using dec.Structure first"
+            );
+        }
+        return gate;
+    }
+
+    /**
+     * Returns the cQASM-like description of a gate used for the comment line,
+     * formatted like the old IR did.
+     */
+    static Str describe_gate(const Gate &gate) {
+        Str buf;
+        if (gate.microcode == detail::Microcode::WAIT) {
+            buf += "wait ";
+            append_uint(buf, gate.duration_in_cycles);
+            return buf;
+        }
+        if (gate.condition >= 0) {
+            buf += "cond(b[";
+            append_uint(buf, gate.condition);
+            buf += "]) ";
+        }
+        buf += gate.name;
+        if (gate.target) {
+            buf += " ";
+            buf += gate.target->name;
+            return buf;
+        }
+        for (UInt i = 0; i < gate.qubits.size(); i++) {
+            buf += i ? ",q[" : " q[";
+            append_uint(buf, gate.qubits[i]);
+            buf += ']';
+        }
+        if (gate.name == "rx" || gate.name == "ry" || gate.name == "rz") {
+            buf += ", ";
+            append_real(buf, gate.angle);
+        }
+        for (auto r : gate.cregs) {
+            buf += ", r[";
+            append_uint(buf, r);
+            buf += ']';
+        }
+        for (auto b : gate.bregs) {
+            buf += ", b[";
+            append_uint(buf, b);
+            buf += ']';
+        }
+        return buf;
+    }
+
+    /**
+     * Appends one of the calibration gates inserted by the generator to the
+     * given statement list, scheduled in the given cycle, and advances the
+     * cycle by its duration. The Diamond parameters are passed as trailing
+     * integer literal operands, in the same way old_to_new converts their
+     * annotations. The caller must attach the annotation itself, as the
+     * conversion back to the old IR needs it to recognize the parameters.
+     */
+    ir::InstructionRef add_calibration(
+        utils::Any<ir::Statement> &statements,
+        Int &cycle,
+        const Str &name,
+        UInt qubit,
+        const Vec<UInt> &parameters = {}
+    ) const {
+        utils::Any<ir::Expression> operands;
+        operands.add(ir::make_qubit_ref(ir, qubit));
+        for (auto parameter : parameters) {
+            operands.add(ir::make_int_lit(ir, (Int)parameter));
+        }
+        auto insn = ir::make_instruction(ir, name, operands, {}, false, true);
+        insn->cycle = cycle;
+        cycle += (Int)utils::max<UInt>(1, ir::get_duration_of_instruction(insn));
+        statements.add(insn.as<ir::Statement>());
+        return insn;
+    }
+
+    /**
+     * Appends a CRC of the given qubit to the given statement list.
+     */
+    void add_crc(utils::Any<ir::Statement> &statements, Int &cycle, UInt qubit) const {
+        const annotations::CRCParameters params{5, qubit};
+        add_calibration(
+            statements, cycle, "crc", qubit, {params.threshold, params.value}
+        )->set_annotation<annotations::CRCParameters>(params);
+    }
 
-        // Only for the first kernel
+    /**
+     * Inserts the calibration gates into the given block: magnetic bias
+     * checks, Rabi checks, CRCs, and initialization of every qubit before the
+     * statements of the block, and a CRC of every qubit between every 10
+     * statements. The inserted gates are given cycles of their own, delaying
+     * the statements after them, but this doesn't account for statements that
+     * are still busy, so the block is marked as not having a valid schedule
+     * for the conversion back to the old IR.
+     */
+    void insert_calibration_gates(const ir::BlockRef &block) const {
+        utils::Any<ir::Statement> statements;
+        Int cycle = 0;
+        if (!block->statements.empty()) {
+            cycle = block->statements[0]->cycle;
+        }
+        Int first_cycle = cycle;
 
         // For every qubit, insert a magnetic bias check
-        for (UInt q = 0; q < kernel->qubit_count; q++) {
-            temp_kernel.gate("sweep_bias", q);
-            temp_kernel.gates.back()->set_annotation<ql::arch::diamond::annotations::SweepBiasParameters>(
-                {10, q, 0, 10, 100, 0});
-            temp_kernel.gate("calculate_current", q);
+        for (UInt q = 0; q < num_qubits; q++) {
+            const annotations::SweepBiasParameters params{10, q, 0, 10, 100, 0};
+            add_calibration(
+                statements, cycle, "sweep_bias", q,
+                {params.value, params.dacreg, params.start, params.step, params.max, params.memaddress}
+            )->set_annotation<annotations::SweepBiasParameters>(params);
+            add_calibration(statements, cycle, "calculate_current", q);
         }
 
         // For every qubit, inset a rabi check
-        for (UInt q = 0; q < kernel->qubit_count; q++) {
-            // rabi check
-            temp_kernel.gate("rabi_check", q);
-            temp_kernel.gates.back()->set_annotation<ql::arch::diamond::annotations::RabiParameters>({100, 2, 3});
+        for (UInt q = 0; q < num_qubits; q++) {
+            const annotations::RabiParameters params{100, 2, 3};
+            add_calibration(
+                statements, cycle, "rabi_check", q,
+                {params.measurements, params.duration, params.t_max}
+            )->set_annotation<annotations::RabiParameters>(params);
         }
 
         // For every qubit, insert a CRC
-        for (UInt q = 0; q < kernel->qubit_count; q++) {
-
-            temp_kernel.gate("crc", q);
-            temp_kernel.gates.back()->set_annotation<ql::arch::diamond::annotations::CRCParameters>({5, q});
+        for (UInt q = 0; q < num_qubits; q++) {
+            add_crc(statements, cycle, q);
         }
 
         // For every qubit, initialize to |0>
-        for (UInt q = 0; q < kernel->qubit_count; q++) {
-
-            temp_kernel.gate("initialize", q);
+        for (UInt q = 0; q < num_qubits; q++) {
+            add_calibration(statements, cycle, "initialize", q);
         }
 
-        // Add the gates from the original kernel. Every 10 gates, add a CRC check
-        // for all qubits.
+        // Add the statements from the original block. Every 10 statements,
+        // add a CRC check for all qubits.
+        Int shift = cycle - first_cycle;
         UInt number_gates = 0;
-        for (const auto &gate : kernel->gates) {
+        for (const auto &statement : block->statements) {
             if (number_gates > 9) {
-                for (UInt q = 0; q < kernel->qubit_count; q++) {
-
-                    temp_kernel.gate("crc", q);
-                    temp_kernel.gates.back()->set_annotation<ql::arch::diamond::annotations::CRCParameters>({5, q});
+                cycle = statement->cycle + shift;
+                for (UInt q = 0; q < num_qubits; q++) {
+                    add_crc(statements, cycle, q);
                 }
+                shift = cycle - statement->cycle;
                 number_gates = 0;
             }
-
-            temp_kernel.gates.add(gate);
+            statement->cycle += shift;
+            statements.add(statement);
             number_gates++;
         }
 
-        // Copy the gates to the original kernel and set the cycles_valid flag to false
-        // because the cycle count is not accurate anymore.
-        kernel->gates = std::move(temp_kernel.gates);
-        kernel->cycles_valid = false;
+        block->statements = std::move(statements);
+        block->set_annotation<ir::KernelCyclesValid>({false});
     }
 
-    // Make global variable for keeping track label numbers.
-    int labelcount = 0;
+    /**
+     * Emits the microcode for a gate.
+     */
+    void emit(const Gate &gate) {
+        out << "# " << describe_gate(gate) << "\n";
+
+        // Check for condition
+        Str end_label;
+        if (gate.condition >= 0) {
+            end_label = to_string(labelcount++);
+            out << detail::branch("ResultReg", to_string(gate.condition), "<", "", "1", "LAB", end_label) << "\n";
+        }
 
-    for (const ir::compat::KernelRef &kernel : program->kernels) {
-        for (const ir::compat::GateRef &gate : kernel->gates) {
-            utils::Json data;
-            if (gate->name != "wait" && gate->name != "barrier") {
-                data = program->platform->find_instruction(gate->name);
+        if (gate.target) {
+            out << detail::jump(get_block_label(gate.target)) << "\n";
+        }
+
+        // Emit the microcode for the gate. Names that are not known for
+        // their diamond_type emit nothing, gates without a known type and
+        // name are reported as not supported. The latter likely will not
+        // occur as OpenQL will throw an error when running the algorithm.
+        switch (gate.microcode) {
+            case detail::Microcode::NONE: {
+                break;
+            }
+            case detail::Microcode::QGATE: {
+                // Single qubit gate
+                out << detail::qgate(gate.name, gate.qubits[0]) << "\n";
+                break;
+            }
+            case detail::Microcode::QGATE2: {
+                // Two qubit gate. Not that in the diamond structure, 2 qubit gates are only possible between
+                // a qubit and a nuclear spin qubit.
+                Str op_1 = "q" + to_string(gate.qubits[0]);
+                Str op_2 = "nuq" + to_string(gate.qubits[1]);
+                out << detail::qgate2(gate.name, op_1, op_2) << "\n";
+                break;
             }
+            case detail::Microcode::RX: {
+                Str duration = rotation_duration(gate.angle);
+                Str phase = to_string(1.57);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::RY: {
+                Str duration = rotation_duration(gate.angle);
+                Str phase = to_string(3.14);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::RZ: {
+                Str duration = rotation_duration(gate.angle);
+                Str phase = to_string(0);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::CR: {
+                Str duration = rotation_duration(gate.angle);
+                out << detail::qgate2(gate.name, "q" + to_string(
+                    gate.qubits[0]), "nuq" + to_string(gate.qubits[1]));
+                out << ", " << duration << "\n";
+                break;
+            }
+            case detail::Microcode::CRK: {
+                Str duration = rotation_duration(gate.angle);
+                UInt angle = 1000 / (3.14 / pow(2, gate.angle));
+                out << detail::qgate2(gate.name, "q" + to_string(
+                    gate.qubits[0]), "nuq" + to_string(gate.qubits[1]));
+                out << ", " << to_string(angle) << "\n";
+                break;
+            }
+            case detail::Microcode::X90: {
+                Str phase = to_string(1.57);
+                Str duration = to_string((1000 / 3.14) * 1.57);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::MX90: {
+                Str phase = to_string(1.57);
+                Str duration = to_string((1000 / 3.14) * 4.71);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::Y90: {
+                Str phase = to_string(3.14);
+                Str duration = to_string((1000 / 3.14) * 1.57);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::MY90: {
+                Str phase = to_string(3.14);
+                Str duration = to_string((1000 / 3.14) * 4.71);
+                out << detail::excite_mw("0", duration, "200", phase, "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::PREP_X: {
+                // Rotate 1/2-pi around y-axis
+                out
+                    << detail::excite_mw("0", to_string(500), "200", "3.14", "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::PREP_Y: {
+                // Rotate 1/2-pi around x-axis
+                out
+                    << detail::excite_mw("0", to_string(500), "200", "1.57", "60",
+                                         gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::MPREP_X: {
+                // Rotate -1/2-pi around y-axis
+                out << detail::excite_mw("0", to_string(1500), "200", "3.14", "60", gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::MPREP_Y: {
+                // Rotate -1/2-pi around x-axis
+                out << detail::excite_mw("0", to_string(1500), "200", "1.57", "60", gate.qubits[0]);
+                break;
+            }
+            case detail::Microcode::CALCULATE_CURRENT: {
+                out << "calculate_current()" << "\n";
+                break;
+            }
+            case detail::Microcode::CALCULATE_VOLTAGE: {
+                out << "calculate_voltage()" << "\n";
+                break;
+            }
+            case detail::Microcode::RABI_CHECK: {
+                // Implements the rabi check.
+                Str qubit_number = to_string(gate.qubits[0]);
+
+                const annotations::RabiParameters params{
+                    gate.parameters[0], gate.parameters[1], gate.parameters[2]
+                };
+                const Str threshold = "0";
+                const Str threshold_measure = "33";
+                Str count = to_string(labelcount);
+                Str count_1 = to_string(labelcount + 1);
+                Str count_2 = to_string(labelcount + 2);
+
+                out
+                    << detail::loadimm(to_string(params.measurements), "R",
+                                       "1") << "\n";
+                out
+                    << detail::loadimm(to_string(params.duration), "R", "2")
+                    << "\n";
+                out
+                    << detail::loadimm(to_string(params.t_max), "R", "3")
+                    << "\n";
+
+                out << detail::loadimm("0", "R", "32")
+                    << "\n"; // number measurements
+                out << detail::label(count) << "\n";
+                out << detail::label(count_1) << "\n";
+                //Init qubit
+                out << detail::label(count_2) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count_2) << "\n";
+
+                //Excite with Time Duration T
+                out << detail::excite_mw("1", "R2", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+
+                //Readout
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::branch("R", qubit_number, "<", "R",
+                                      threshold_measure, "ResultReg",
+                                      qubit_number) << "\n";
+
+                // Store result and adjust memory address for next value
+                out << detail::store("ResultReg", qubit_number,
+                                     "memAddress", qubit_number, "0")
+                    << "\n";
+                out << detail::addimm("4", "memAddr", qubit_number)
+                    << "\n";
+                out << detail::addimm("1", "R", "32") << "\n";
+
+                // if #measurements < threshold, measure again
+                out << detail::branch("R", "32", "<", "R", "1", "LAB",
+                                      count_1) << "\n";
+                out
+                    << detail::store("R", "2", "memAddr", qubit_number, "0")
+                    << "\n";
+                out << detail::addimm("4", "memAddr", qubit_number)
+                    << "\n";
+                out << detail::addimm("10", "R", "2") << "\n";
+                out
+                    << detail::branch("R", "2", "<", "R", "3", "LAB", count)
+                    << "\n";
+
+                // Add 3 to labelcount because label was used thrice.
+                labelcount++;
+                labelcount++;
+                labelcount++;
+                break;
+            }
+            case detail::Microcode::CRC: {
+                // Implements the Charge Resonance Check.
+                const annotations::CRCParameters params{
+                    gate.parameters[0], gate.parameters[1]
+                };
+
+                Str qubit_number = to_string(gate.qubits[0]);
+                Str count = to_string(labelcount);
+                Str count2 = to_string(labelcount + 1);
+
+                out << detail::loadimm(to_string(params.threshold),
+                                       "treshReg", qubit_number)
+                    << "\n";
+                out
+                    << detail::loadimm(to_string(params.value), "dacReg",
+                                       qubit_number) << "\n";
+
+                out << detail::label(count) << "\n";
+                out << detail::loadimm("0", "photon Reg", qubit_number)
+                    << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "treshReg",
+                                      qubit_number, "LAB",
+                                      count2) << "\n";
+                out << "calculateVoltage()" << "\n";
+                out << detail::jump(count) << "\n";
+                out << detail::label(count2) << "\n";
+
+                // Add 2 to labelcount because label was used twice.
+                labelcount++;
+                labelcount++;
+                break;
+            }
+            case detail::Microcode::DECOUPLE: {
+                // Code for XY-8 dynamical decoupling
+                Str t = to_string(50);
+                Str t2 = to_string(100);
+                out << detail::excite_mw("0", "500", "200", "1.57", "60", gate.qubits[0])<< "\n"; // pi/2 x
+                out << "wait "<< t << "\n";
+                out << detail::excite_mw("0", "1000", "200", "1.57", "60", gate.qubits[0]) << "\n"; // pi x
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "3.14", "60", gate.qubits[0]) << "\n"; // pi y
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "1.57", "60", gate.qubits[0]) << "\n"; // pi x
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "3.14", "60", gate.qubits[0]) << "\n"; // pi y
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "3.14", "60", gate.qubits[0]) << "\n"; // pi y
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "1.57", "60", gate.qubits[0]) << "\n"; // pi x
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "3.14", "60", gate.qubits[0]) << "\n"; // pi y
+                out << "wait "<< t2 << "\n";
+                out << detail::excite_mw("0", "1000", "200", "1.57", "60", gate.qubits[0]) << "\n"; // pi x
+                out << "wait "<< t << "\n";
+                out << detail::excite_mw("0", "500", "200", "1.57", "60", gate.qubits[0]) << "\n"; // pi/2 x
+                break;
+            }
+            case detail::Microcode::CAL_MEASURE: {
+                // code for measurement calibration
+                Str lab_1 = to_string(labelcount+1);
+                Str lab_2 = to_string(labelcount+3);
+
+                Str qubit_number = to_string(gate.qubits[0]);
+                const Str threshold = "0";
+                Str count = to_string(labelcount);
+                Str count_2 = to_string(labelcount+2);
+
+                // initialize qubit to 0
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count) << "\n";
+
+                out << detail::loadimm(to_string(0), "photonReg", to_string(gate.qubits[0])) << "\n";
+                out << detail::loadimm(to_string(1), "R", "30") << "\n";
+                out << detail::label(lab_1) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "1", "200", "0", "60", gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::store("photonReg", to_string(gate.qubits[0]), "R", "1", "0") << "\n";
+                out << detail::store("R", "30", "R", "1", "0") << "\n";
+                out << detail::addimm("1", "R", "30") << "\n";
+                out << detail::branch("R", "30", "<", "", "40", "LAB", lab_1) << "\n";
+
+                // initialize qubit to 0
+                out << detail::label(count_2) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count_2) << "\n";
+                out << detail::qgate("x", gate.qubits[0]) << "\n";
+
+                out << detail::loadimm(to_string(0), "photonReg", to_string(gate.qubits[0])) << "\n";
+                out << detail::loadimm(to_string(1), "R", "30") << "\n";
+                out << detail::label(lab_2) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "1", "200", "0", "60", gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::store("photonReg", to_string(gate.qubits[0]), "R", "2", "0") << "\n";
+                out << detail::store("R", "30", "R", "3", "0") << "\n";
+                out << detail::addimm("1", "R", "30") << "\n";
+                out << detail::branch("R", "30", "<", "", "40", "LAB",
+                                      lab_2) << "\n";
+
+                out << "calculate_readouttime(R0, R1, R2, R3)" << "\n"; //function still needs to be implemented/designed
+
+                labelcount = labelcount+4;
+                break;
+            }
+            case detail::Microcode::CAL_PI: {
+                // code for pi-rotation calibration
+                Str qubit_number = to_string(gate.qubits[0]);
+                const Str threshold = "0";
+                Str count = to_string(labelcount);
+                Str lab1 = to_string(labelcount+1);
+                Str lab2 = to_string(labelcount+2);
+
+                // init qubit to 0
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count) << "\n";
+
+
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0])) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+2)) << "\n";
+                out << detail::label(lab1) << "\n";
+                out << detail::label(lab2) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "1000", "200", "0", "R"+to_string(gate.qubits[0]), gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::addimm("1", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::branch("R", to_string(gate.qubits[0]+1), "<", "", "12", "LAB", lab1) << "\n";
+                out << "measure_fidelity(R0) \n";
+                out << detail::addimm("0.1", "R", to_string(gate.qubits[0])) << "\n";
+                out << detail::addimm("1", "R", to_string(gate.qubits[0]+2)) << "\n";
+                out << detail::branch("R", to_string(gate.qubits[0]+2), ">", "", "10", "LAB", lab2) << "\n";
+                out << "calculate_minimum_fidelity() \n";
+
+                labelcount = labelcount+2;
+                break;
+            }
+            case detail::Microcode::CAL_HALFPI: {
+                // code for pi/2-rotation calibration
+                Str qubit_number = to_string(gate.qubits[0]);
+                const Str threshold = "0";
+                Str count = to_string(labelcount);
+                Str lab1 = to_string(labelcount+1);
+                Str lab2 = to_string(labelcount+2);
+
+                // init qubit to 0
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count) << "\n";
+
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0])) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+2)) << "\n";
+                out << detail::label(lab1) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "500", "200", "0", "R"+to_string(gate.qubits[0]), gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+
+                out << detail::addimm("1", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::branch("R", to_string(gate.qubits[0]+1), "<", "", "7", "LAB", lab1) << "\n";
+                out << "measure_fidelity(R0) \n";
+
+                // init qubit to 0
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count) << "\n";
+
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0])) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::loadimm("0", "R", to_string(gate.qubits[0]+2)) << "\n";
+                out << detail::label(lab2) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "500", "200", "0", "R"+to_string(gate.qubits[0]), gate.qubits[0]) << "\n";
+                out << detail::excite_mw("0", "1000", "200", "0", "60", gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+
+                out << detail::addimm("1", "R", to_string(gate.qubits[0]+1)) << "\n";
+                out << detail::branch("R", to_string(gate.qubits[0]+1), "<", "", "7", "LAB", lab2) << "\n";
+                out << "measure_fidelity(R0) \n";
+
+                labelcount = labelcount + 3;
+                break;
+            }
+            case detail::Microcode::MEASURE: {
+                // Measures a qubit and stores the result in ResultRegQ,
+                // where Q is the qubit number. Also stores the result in
+                // breg[Q], as per OpenQL standard.
+                Str qubit_number = to_string(gate.qubits[0]);
+                const Str threshold = "33";
+
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out
+                    << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number)
+                    << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::branch("R", qubit_number, "<", "R",
+                                      threshold, "ResultReg",
+                                      qubit_number) << "\n";
+                break;
+            }
+            case detail::Microcode::INITIALIZE: {
+                // Initializes a qubit to |0>.
+                Str qubit_number = to_string(gate.qubits[0]);
+                const Str threshold = "0";
+                Str count = to_string(labelcount);
+
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::loadimm("0", "photonReg", qubit_number)
+                    << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number) << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::branch("R", qubit_number, ">", "", threshold,
+                                      "LAB", count) << "\n";
+
+                labelcount++;
+                break;
+            }
+            case detail::Microcode::WAIT: {
+                // Implements the wait x-cycles instruction.
+                out << "wait "
+                    << to_string(gate.duration) << "\n";
+                break;
+            }
+            case detail::Microcode::QNOP: {
+                // Quantum nop instruction
+                out << "wait 1" << "\n";
+                break;
+            }
+            case detail::Microcode::SWEEP_BIAS: {
+                // Implements the instruction sweep_bias, that sweeps the frequency
+                // of the laser of a qubit to help determine the magnetic biasing value
+                // for correct biasing.
+                const annotations::SweepBiasParameters params{
+                    gate.parameters[0], gate.parameters[1], gate.parameters[2],
+                    gate.parameters[3], gate.parameters[4], gate.parameters[5]
+                };
+
+                Str qubit_number = to_string(gate.qubits[0]);
+                Str count = to_string(labelcount);
+
+                out
+                    << detail::loadimm(to_string(params.value), "dacReg",
+                                       to_string(params.dacreg)) << "\n";
+                out
+                    << detail::loadimm(to_string(params.start),
+                                       "sweepStartReg",
+                                       qubit_number) << "\n";
+                out
+                    << detail::loadimm(to_string(params.step),
+                                       "sweepStepReg",
+                                       qubit_number) << "\n";
+                out
+                    << detail::loadimm(to_string(params.max),
+                                       "sweepStopReg",
+                                       qubit_number) << "\n";
+                out
+                    << detail::loadimm(to_string(params.memaddress),
+                                       "memAddr",
+                                       qubit_number) << "\n";
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::excite_mw("1", "100",
+                                         "sweepStartReg" + qubit_number,
+                                         "0", "60", gate.qubits[0])
+                    << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out
+                    << detail::mov("photonReg", qubit_number, "R",
+                                   qubit_number)
+                    << "\n";
+                out
+                    << detail::store("R", qubit_number, "memAddr",
+                                     qubit_number,
+                                     "0") << "\n";
+                out
+                    << detail::store("sweepStartReg", qubit_number,
+                                     "memAddr",
+                                     qubit_number, "0") << "\n";
+                out << detail::add("sweepStartReg", qubit_number,
+                                   "sweepStartReg", qubit_number,
+                                   "sweepStepReg", qubit_number)
+                    << "\n";
+                out << detail::addimm("4", "memAddr", qubit_number)
+                    << "\n";
+                out
+                    << detail::branch("sweepStartReg", qubit_number, "<",
+                                      "sweepStopReg", qubit_number, "LAB",
+                                      count) << "\n";
+                labelcount++;
+                break;
+            }
+            case detail::Microcode::EXCITE_MW: {
+                // Implements the custom instruction on how the user wants
+                // to use the laser.
+                const annotations::ExciteMicrowaveParameters params{
+                    gate.parameters[0], gate.parameters[1], gate.parameters[2],
+                    gate.parameters[3], gate.parameters[4]
+                };
+
+                out << detail::excite_mw(to_string(params.envelope),
+                                         to_string(params.duration),
+                                         to_string(params.frequency),
+                                         to_string(params.phase),
+                                         to_string(params.amplitude),
+                                         gate.qubits[0]) << "\n";
+                break;
+            }
+            case detail::Microcode::MEMSWAP: {
+                // Implements the swap from electron qubit to nuclear spin qubit.
+                const annotations::MemSwapParameters params{
+                    gate.parameters[0]
+                };
+
+                Str nuq = "nuq" + to_string(params.nuclear);
+                Str qubit = "q" + to_string(gate.qubits[0]);
+                out << detail::qgate2("pmy90", qubit, nuq) << "\n";
+                out << detail::qgate("x90", gate.qubits[0]) << "\n";
+                out << detail::qgate2("pmx90", qubit, nuq) << "\n";
+                out << detail::qgate("my90", gate.qubits[0]) << "\n";
+                break;
+            }
+            case detail::Microcode::QENTANGLE: {
+                // Implements electron-nuclear spin entanglement.
+                const annotations::QEntangleParameters params{
+                    gate.parameters[0]
+                };
+
+                Str nuq = "nuq" + to_string(params.nuclear);
+                Str qubit = "q" + to_string(gate.qubits[0]);
+                out << detail::qgate("mx90", gate.qubits[0]) << "\n";
+                out << detail::qgate2("pmx90", qubit, nuq) << "\n";
+                out << detail::qgate("x90", gate.qubits[0]) << "\n";
+                break;
+            }
+            case detail::Microcode::NVENTANGLE: {
+                // Implements electron-electron entanglement following the
+                // Barrett and Kok scheme.
+                Str count = to_string(labelcount);
+                Str count_1 = to_string(labelcount + 1);
+
+                out << detail::loadimm("0", "R", "2") << "\n";
+                out << detail::label(count) << "\n";
+                out << detail::switchOn(gate.qubits[0]) << "\n";
+                out << detail::switchOn(gate.qubits[1]) << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[0]) << "\n";
+                out << detail::excite_mw("1", "100", "200", "0", "60",
+                                         gate.qubits[1]) << "\n";
+                out << "wait 100" << "\n";
+                out << detail::mov("R", "0", "photonReg", "01") << "\n";
+                out << detail::switchOff(gate.qubits[0]) << "\n";
+                out << detail::switchOff(gate.qubits[1]) << "\n";
+                out << detail::addimm("1", "R", "2") << "\n";
+                out << "wait 50" << "\n";
+                out
+                    << detail::branch("R", "1", ">", "", "1", "LAB",
+                                      count_1)
+                    << "\n";
+                out << detail::qgate("x", gate.qubits[0]) << "\n";
+                out << detail::qgate("x", gate.qubits[1]) << "\n";
+                out << detail::mov("R", "0", "R", "1") << "\n";
+                out << detail::jump(count) << "\n";
+                out << detail::label(count_1) << "\n";
+
+                labelcount++;
+                labelcount++;
+                break;
+            }
+            case detail::Microcode::UNSUPPORTED: {
+                out << "ERROR: Gate " + gate.name +
+                       " is not supported by the Diamond Architecture."
+                    << "\n";
+                break;
+            }
+        }
+        if (!end_label.empty()) {
+            out << detail::label(end_label) << "\n";
+        }
 
-            outfile << "# " << gate->qasm() << "\n";
+        out << "\n";
+    }
 
-            // Determine gate type.
-            utils::Str type = "unknown";
-            auto iterator = data.find("diamond_type");
-            if (iterator != data.end() && iterator->is_string()) {
-                type = iterator->get<utils::Str>();
-            }
+    /**
+     * Generates the microcode for the given program block.
+     */
+    void generate_block(const ir::BlockRef &block) {
+        if (targets.find(block.get_ptr().get()) != targets.end()) {
+            out << detail::label(get_block_label(block.get_ptr().get())) << "\n\n";
+        }
+        insert_calibration_gates(block);
+        for (const auto &statement : block->statements) {
+            emit(convert_statement(statement));
+        }
+    }
 
-            // Check for condition
-            Str end_label;
-            if (gate->condition == ir::compat::ConditionType::UNARY) {
-                end_label = to_string(labelcount++);
-                outfile << detail::branch("ResultReg", to_string(gate->cond_operands[0]), "<", "", "1", "LAB", end_label) << "\n";
-            } else if (gate->condition != ir::compat::ConditionType::ALWAYS) {
-                throw utils::Exception("gate with " + to_string(gate->condition) + " is not supported");
+public:
+
+    /**
+     * Creates a generator for the given IR.
+     */
+    explicit MicrocodeGenerator(const ir::Ref &ir) :
+        ir(ir),
+        table(detail::build_microcode_table(ir)),
+        num_qubits(ir::get_num_qubits(ir)),
+        cycle_time(1),
+        breg_ob(ir::find_physical_object(ir, "breg")),
+        creg_ob(ir::find_physical_object(ir, "creg"))
+    {
+        if (ir->program->has_annotation<ir::ObjectUsage>()) {
+            num_qubits = ir->program->get_annotation<ir::ObjectUsage>().num_qubits;
+        }
+        const auto &data = ir->platform->data.data;
+        auto settings = data.find("hardware_settings");
+        if (settings != data.end()) {
+            auto it = settings->find("cycle_time");
+            if (it != settings->end() && it->is_number_unsigned()) {
+                cycle_time = it->get<UInt>();
             }
+        }
+    }
 
-            // Determine the microcode output for the given gate-type
-            // If the gate-type is known, check the gate name.
-            // If the gate-type is not known, check the gate name
-            // If the gate-name is not known, print that the gate `name` is not known.
-            // Last option likely will not occur as OpenQL will throw an error
-            // when running the algorithm.
-            if (type == "qgate") {
-                // Single qubit gate
-                outfile << detail::qgate(gate->name, gate->operands[0]) << "\n";
-            } else if (type == "qgate2") {
-                // Two qubit gate. Not that in the diamond structure, 2 qubit gates are only possible between
-                // a qubit and a nuclear spin qubit.
-                Str op_1 = "q" + to_string(gate->operands[0]);
-                Str op_2 = "nuq" + to_string(gate->operands[1]);
-                outfile << detail::qgate2(gate->name, op_1, op_2) << "\n";
-            } else if (type == "rotation") {
-                // custom rotations around an axis
-                UInt a = 1000 / 3.14159265359;
-                Str duration = to_string(a * gate->angle);
-                if (gate->name == "rx") {
-                    Str phase = to_string(1.57);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "ry") {
-                    Str phase = to_string(3.14);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "rz") {
-                    Str phase = to_string(0);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "cr") {
-                    Str phase = to_string(0);
-                    outfile << detail::qgate2(gate->name, "q" + to_string(
-                        gate->operands[0]), "nuq" + to_string(gate->operands[1]));
-                    outfile << ", " << duration << "\n";
-                } else if (gate->name == "crk") {
-                    Str phase = to_string(0);
-                    UInt angle = 1000 / (3.14 / pow(2, gate->angle));
-                    outfile << detail::qgate2(gate->name, "q" + to_string(
-                        gate->operands[0]), "nuq" + to_string(gate->operands[1]));
-                    outfile << ", " << to_string(angle) << "\n";
-                }
+    /**
+     * Generates the microcode for the program, writing it to the given file
+     * block by block.
+     */
+    void run(OutFile &file) {
+        if (ir->program.empty()) {
+            return;
+        }
+        const auto &blocks = ir->program->blocks;
 
-                // Alternate representation of x90, mx90, y90 and my90. Now works with using qgate.
-                // Can be changed to excite_MW by setting diamond_type in hw config file to
-                // "rotation" instead of "qgate".
-                else if (gate->name == "x90") {
-                    Str phase = to_string(1.57);
-                    duration = to_string((1000 / 3.14) * 1.57);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "mx90") {
-                    Str phase = to_string(1.57);
-                    duration = to_string((1000 / 3.14) * 4.71);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "y90") {
-                    Str phase = to_string(3.14);
-                    duration = to_string((1000 / 3.14) * 1.57);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                } else if (gate->name == "my90") {
-                    Str phase = to_string(3.14);
-                    duration = to_string((1000 / 3.14) * 4.71);
-                    outfile << detail::excite_mw("0", duration, "200", phase, "60",
-                                                 gate->operands[0]);
-                }
-            } else if (type == "prepare") {
-                if (gate->name == "prep_z") {
-                    // nothing, already in z-basis
-                } else if (gate->name == "prep_x") {
-                    // Rotate 1/2-pi around y-axis
-                    outfile
-                        << detail::excite_mw("0", to_string(500), "200", "3.14", "60",
-                                             gate->operands[0]);
-                } else if (gate->name == "prep_y") {
-                    // Rotate 1/2-pi around x-axis
-                    outfile
-                        << detail::excite_mw("0", to_string(500), "200", "1.57", "60",
-                                             gate->operands[0]);
-                } else if (gate->name == "mprep_x") {
-                    // Rotate -1/2-pi around y-axis
-                    outfile << detail::excite_mw("0", to_string(1500), "200", "3.14", "60", gate->operands[0]);
-                } else if (gate->name == "mprep_y") {
-                    // Rotate -1/2-pi around x-axis
-                    outfile << detail::excite_mw("0", to_string(1500), "200", "1.57", "60", gate->operands[0]);
-                }
-            } else if (type == "classical") {
-                // These instructions calculate a new value for either current or
-                // voltage using purely classical instructions. They have to be
-                // elaborated using the classical instructions from the micro ISA.
-                if (gate->name == "calculate_current") {
-                    outfile << "calculate_current()" << "\n";
-                } else if (gate->name == "calculate_voltage") {
-                    outfile << "calculate_voltage()" << "\n";
-                }
-            } else if (type == "initial_checks") {
-                if (gate->name == "mag_bias") {
-                    // Code for magnetic biasing
-                    // Not added because it is decomposed into sweep_bias and calculate_current()
-                    // at lines 76-79 of microcode.cc
-                } else if (gate->name == "rabi_check") {
-                    // Implements the rabi check.
-                    Str qubit_number = to_string(gate->operands[0]);
-
-                    const auto &params =
-                        gate->get_annotation<annotations::RabiParameters>();
-                    const Str threshold = "0";
-                    const Str threshold_measure = "33";
-                    Str count = to_string(labelcount);
-                    Str count_1 = to_string(labelcount + 1);
-                    Str count_2 = to_string(labelcount + 2);
-
-                    outfile
-                        << detail::loadimm(to_string(params.measurements), "R",
-                                           "1") << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.duration), "R", "2")
-                        << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.t_max), "R", "3")
-                        << "\n";
-
-                    outfile << detail::loadimm("0", "R", "32")
-                            << "\n"; // number measurements
-                    outfile << detail::label(count) << "\n";
-                    outfile << detail::label(count_1) << "\n";
-                    //Init qubit
-                    outfile << detail::label(count_2) << "\n";
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::loadimm("0", "photonReg", qubit_number)
-                            << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile << detail::mov("photonReg", qubit_number, "R",
-                                           qubit_number) << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile
-                        << detail::branch("R", qubit_number, ">", "", threshold,
-                                          "LAB", count_2) << "\n";
-
-                    //Excite with Time Duration T
-                    outfile << detail::excite_mw("1", "R2", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-
-                    //Readout
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::loadimm("0", "photonReg", qubit_number)
-                            << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile << detail::mov("photonReg", qubit_number, "R",
-                                           qubit_number) << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile << detail::branch("R", qubit_number, "<", "R",
-                                              threshold_measure, "ResultReg",
-                                              qubit_number) << "\n";
-
-                    // Store result and adjust memory address for next value
-                    outfile << detail::store("ResultReg", qubit_number,
-                                             "memAddress", qubit_number, "0")
-                            << "\n";
-                    outfile << detail::addimm("4", "memAddr", qubit_number)
-                            << "\n";
-                    outfile << detail::addimm("1", "R", "32") << "\n";
-
-                    // if #measurements < threshold, measure again
-                    outfile << detail::branch("R", "32", "<", "R", "1", "LAB",
-                                              count_1) << "\n";
-                    outfile
-                        << detail::store("R", "2", "memAddr", qubit_number, "0")
-                        << "\n";
-                    outfile << detail::addimm("4", "memAddr", qubit_number)
-                            << "\n";
-                    outfile << detail::addimm("10", "R", "2") << "\n";
-                    outfile
-                        << detail::branch("R", "2", "<", "R", "3", "LAB", count)
-                        << "\n";
-
-                    // Add 3 to labelcount because label was used thrice.
-                    labelcount++;
-                    labelcount++;
-                    labelcount++;
-                } else if (gate->name == "crc") {
-                    // Implements the Charge Resonance Check.
-                    const auto &params =
-                        gate->get_annotation<annotations::CRCParameters>();
-
-                    Str qubit_number = to_string(gate->operands[0]);
-                    Str count = to_string(labelcount);
-                    Str count2 = to_string(labelcount + 1);
-
-                    outfile << detail::loadimm(to_string(params.threshold),
-                                               "treshReg", qubit_number)
-                            << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.value), "dacReg",
-                                           qubit_number) << "\n";
-
-                    outfile << detail::label(count) << "\n";
-                    outfile << detail::loadimm("0", "photon Reg", qubit_number)
-                            << "\n";
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile << detail::mov("photonReg", qubit_number, "R",
-                                           qubit_number) << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile
-                        << detail::branch("R", qubit_number, ">", "treshReg",
-                                          qubit_number, "LAB",
-                                          count2) << "\n";
-                    outfile << "calculateVoltage()" << "\n";
-                    outfile << detail::jump(count) << "\n";
-                    outfile << detail::label(count2) << "\n";
-
-                    // Add 2 to labelcount because label was used twice.
-                    labelcount++;
-                    labelcount++;
-                }
-            } else if (type == "calibration") {
-               if (gate->name == "decouple") {
-                   // Code for XY-8 dynamical decoupling
-                   Str t = to_string(50);
-                   Str t2 = to_string(100);
-                   outfile << detail::excite_mw("0", "500", "200", "1.57", "60", gate->operands[0])<< "\n"; // pi/2 x
-                   outfile << "wait "<< t << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "1.57", "60", gate->operands[0]) << "\n"; // pi x
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "3.14", "60", gate->operands[0]) << "\n"; // pi y
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "1.57", "60", gate->operands[0]) << "\n"; // pi x
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "3.14", "60", gate->operands[0]) << "\n"; // pi y
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "3.14", "60", gate->operands[0]) << "\n"; // pi y
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "1.57", "60", gate->operands[0]) << "\n"; // pi x
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "3.14", "60", gate->operands[0]) << "\n"; // pi y
-                   outfile << "wait "<< t2 << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "1.57", "60", gate->operands[0]) << "\n"; // pi x
-                   outfile << "wait "<< t << "\n";
-                   outfile << detail::excite_mw("0", "500", "200", "1.57", "60", gate->operands[0]) << "\n"; // pi/2 x
-
-               } else if (gate->name == "cal_measure") {
-                   // code for measurement calibration
-                   Str lab_1 = to_string(labelcount+1);
-                   Str lab_2 = to_string(labelcount+3);
-
-                   Str qubit_number = to_string(gate->operands[0]);
-                   const Str threshold = "0";
-                   Str count = to_string(labelcount);
-                   Str count_2 = to_string(labelcount+2);
-
-                   // initialize qubit to 0
-                   outfile << detail::label(count) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::loadimm("0", "photonReg", qubit_number)
-                           << "\n";
-                   outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                gate->operands[0]) << "\n";
-                   outfile << detail::mov("photonReg", qubit_number, "R",
-                                          qubit_number) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile
-                       << detail::branch("R", qubit_number, ">", "", threshold,
-                                         "LAB", count) << "\n";
-
-                   outfile << detail::loadimm(to_string(0), "photonReg", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::loadimm(to_string(1), "R", "30") << "\n";
-                   outfile << detail::label(lab_1) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "1", "200", "0", "60", gate->operands[0]) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile << detail::store("photonReg", to_string(gate->operands[0]), "R", "1", "0") << "\n";
-                   outfile << detail::store("R", "30", "R", "1", "0") << "\n";
-                   outfile << detail::addimm("1", "R", "30") << "\n";
-                   outfile << detail::branch("R", "30", "<", "", "40", "LAB", lab_1) << "\n";
-
-                   // initialize qubit to 0
-                   outfile << detail::label(count_2) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::loadimm("0", "photonReg", qubit_number)
-                           << "\n";
-                   outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                gate->operands[0]) << "\n";
-                   outfile << detail::mov("photonReg", qubit_number, "R",
-                                          qubit_number) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile
-                       << detail::branch("R", qubit_number, ">", "", threshold,
-                                         "LAB", count_2) << "\n";
-                   outfile << detail::qgate("x", gate->operands[0]) << "\n";
-
-                   outfile << detail::loadimm(to_string(0), "photonReg", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::loadimm(to_string(1), "R", "30") << "\n";
-                   outfile << detail::label(lab_2) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "1", "200", "0", "60", gate->operands[0]) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile << detail::store("photonReg", to_string(gate->operands[0]), "R", "2", "0") << "\n";
-                   outfile << detail::store("R", "30", "R", "3", "0") << "\n";
-                   outfile << detail::addimm("1", "R", "30") << "\n";
-                   outfile << detail::branch("R", "30", "<", "", "40", "LAB",
-                                             lab_2) << "\n";
-
-                   outfile << "calculate_readouttime(R0, R1, R2, R3)" << "\n"; //function still needs to be implemented/designed
-
-                   labelcount = labelcount+4;
-
-               } else if (gate->name == "cal_pi") {
-                   // code for pi-rotation calibration
-                   Str qubit_number = to_string(gate->operands[0]);
-                   const Str threshold = "0";
-                   Str count = to_string(labelcount);
-                   Str lab1 = to_string(labelcount+1);
-                   Str lab2 = to_string(labelcount+2);
-
-                   // init qubit to 0
-                   outfile << detail::label(count) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::loadimm("0", "photonReg", qubit_number)
-                           << "\n";
-                   outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                gate->operands[0]) << "\n";
-                   outfile << detail::mov("photonReg", qubit_number, "R",
-                                          qubit_number) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile
-                       << detail::branch("R", qubit_number, ">", "", threshold,
-                                         "LAB", count) << "\n";
-
-
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+2)) << "\n";
-                   outfile << detail::label(lab1) << "\n";
-                   outfile << detail::label(lab2) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "0", "R"+to_string(gate->operands[0]), gate->operands[0]) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile << detail::addimm("1", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::branch("R", to_string(gate->operands[0]+1), "<", "", "12", "LAB", lab1) << "\n";
-                   outfile << "measure_fidelity(R0) \n";
-                   outfile << detail::addimm("0.1", "R", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::addimm("1", "R", to_string(gate->operands[0]+2)) << "\n";
-                   outfile << detail::branch("R", to_string(gate->operands[0]+2), ">", "", "10", "LAB", lab2) << "\n";
-                   outfile << "calculate_minimum_fidelity() \n";
-
-                   labelcount = labelcount+2;
-               } else if (gate->name == "cal_halfpi") {
-                   // code for pi/2-rotation calibration
-                   Str qubit_number = to_string(gate->operands[0]);
-                   const Str threshold = "0";
-                   Str count = to_string(labelcount);
-                   Str lab1 = to_string(labelcount+1);
-                   Str lab2 = to_string(labelcount+2);
-
-                   // init qubit to 0
-                   outfile << detail::label(count) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::loadimm("0", "photonReg", qubit_number)
-                           << "\n";
-                   outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                gate->operands[0]) << "\n";
-                   outfile << detail::mov("photonReg", qubit_number, "R",
-                                          qubit_number) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile
-                       << detail::branch("R", qubit_number, ">", "", threshold,
-                                         "LAB", count) << "\n";
-
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+2)) << "\n";
-                   outfile << detail::label(lab1) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "500", "200", "0", "R"+to_string(gate->operands[0]), gate->operands[0]) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-
-                   outfile << detail::addimm("1", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::branch("R", to_string(gate->operands[0]+1), "<", "", "7", "LAB", lab1) << "\n";
-                   outfile << "measure_fidelity(R0) \n";
-
-                   // init qubit to 0
-                   outfile << detail::label(count) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::loadimm("0", "photonReg", qubit_number)
-                           << "\n";
-                   outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                gate->operands[0]) << "\n";
-                   outfile << detail::mov("photonReg", qubit_number, "R",
-                                          qubit_number) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-                   outfile
-                       << detail::branch("R", qubit_number, ">", "", threshold,
-                                         "LAB", count) << "\n";
-
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0])) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::loadimm("0", "R", to_string(gate->operands[0]+2)) << "\n";
-                   outfile << detail::label(lab2) << "\n";
-                   outfile << detail::switchOn(gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "500", "200", "0", "R"+to_string(gate->operands[0]), gate->operands[0]) << "\n";
-                   outfile << detail::excite_mw("0", "1000", "200", "0", "60", gate->operands[0]) << "\n";
-                   outfile << detail::switchOff(gate->operands[0]) << "\n";
-
-                   outfile << detail::addimm("1", "R", to_string(gate->operands[0]+1)) << "\n";
-                   outfile << detail::branch("R", to_string(gate->operands[0]+1), "<", "", "7", "LAB", lab2) << "\n";
-                   outfile << "measure_fidelity(R0) \n";
-
-                   labelcount = labelcount + 3;
-               }
-            } else {
-                if (gate->name == "measure") {
-                    // Measures a qubit and stores the result in ResultRegQ,
-                    // where Q is the qubit number. Also stores the result in
-                    // breg[Q], as per OpenQL standard.
-                    Str qubit_number = to_string(gate->operands[0]);
-                    const Str threshold = "33";
-
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::loadimm("0", "photonReg", qubit_number)
-                            << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile
-                        << detail::mov("photonReg", qubit_number, "R",
-                                       qubit_number)
-                        << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile << detail::branch("R", qubit_number, "<", "R",
-                                              threshold, "ResultReg",
-                                              qubit_number) << "\n";
-                } else if (gate->name == "initialize") {
-                    // Initializes a qubit to |0>.
-                    Str qubit_number = to_string(gate->operands[0]);
-                    const Str threshold = "0";
-                    Str count = to_string(labelcount);
-
-                    outfile << detail::label(count) << "\n";
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::loadimm("0", "photonReg", qubit_number)
-                            << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile << detail::mov("photonReg", qubit_number, "R",
-                                           qubit_number) << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile
-                        << detail::branch("R", qubit_number, ">", "", threshold,
-                                          "LAB", count) << "\n";
-
-                    labelcount++;
-                } else if (gate->name == "wait") {
-                    // Implements the wait x-cycles instruction.
-                    outfile << "wait "
-                            << to_string(gate->duration) << "\n";
-                } else if (gate->name == "barrier") {
-                    // Ignore barriers
-                } else if (gate->name == "qnop") {
-                    // Quantum nop instruction
-                    outfile << "wait 1" << "\n";
-                } else if (gate->name == "sweep_bias") {
-                    // Implements the instruction sweep_bias, that sweeps the frequency
-                    // of the laser of a qubit to help determine the magnetic biasing value
-                    // for correct biasing.
-                    const auto &params =
-                        gate->get_annotation<annotations::SweepBiasParameters>();
-
-                    Str qubit_number = to_string(gate->operands[0]);
-                    Str count = to_string(labelcount);
-
-                    outfile
-                        << detail::loadimm(to_string(params.value), "dacReg",
-                                           to_string(params.dacreg)) << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.start),
-                                           "sweepStartReg",
-                                           qubit_number) << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.step),
-                                           "sweepStepReg",
-                                           qubit_number) << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.max),
-                                           "sweepStopReg",
-                                           qubit_number) << "\n";
-                    outfile
-                        << detail::loadimm(to_string(params.memaddress),
-                                           "memAddr",
-                                           qubit_number) << "\n";
-                    outfile << detail::label(count) << "\n";
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::excite_mw("1", "100",
-                                                 "sweepStartReg" + qubit_number,
-                                                 "0", "60", gate->operands[0])
-                            << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile
-                        << detail::mov("photonReg", qubit_number, "R",
-                                       qubit_number)
-                        << "\n";
-                    outfile
-                        << detail::store("R", qubit_number, "memAddr",
-                                         qubit_number,
-                                         "0") << "\n";
-                    outfile
-                        << detail::store("sweepStartReg", qubit_number,
-                                         "memAddr",
-                                         qubit_number, "0") << "\n";
-                    outfile << detail::add("sweepStartReg", qubit_number,
-                                           "sweepStartReg", qubit_number,
-                                           "sweepStepReg", qubit_number)
-                            << "\n";
-                    outfile << detail::addimm("4", "memAddr", qubit_number)
-                            << "\n";
-                    outfile
-                        << detail::branch("sweepStartReg", qubit_number, "<",
-                                          "sweepStopReg", qubit_number, "LAB",
-                                          count) << "\n";
-                    labelcount++;
-                } else if (gate->name == "excite_mw") {
-                    // Implements the custom instruction on how the user wants
-                    // to use the laser.
-                    const auto &params =
-                        gate->get_annotation<annotations::ExciteMicrowaveParameters>();
-
-                    outfile << detail::excite_mw(to_string(params.envelope),
-                                                 to_string(params.duration),
-                                                 to_string(params.frequency),
-                                                 to_string(params.phase),
-                                                 to_string(params.amplitude),
-                                                 gate->operands[0]) << "\n";
-                } else if (gate->name == "memswap") {
-                    // Implements the swap from electron qubit to nuclear spin qubit.
-                    const auto &params =
-                        gate->get_annotation<annotations::MemSwapParameters>();
-
-                    Str nuq = "nuq" + to_string(params.nuclear);
-                    Str qubit = "q" + to_string(gate->operands[0]);
-                    outfile << detail::qgate2("pmy90", qubit, nuq) << "\n";
-                    outfile << detail::qgate("x90", gate->operands[0]) << "\n";
-                    outfile << detail::qgate2("pmx90", qubit, nuq) << "\n";
-                    outfile << detail::qgate("my90", gate->operands[0]) << "\n";
-                } else if (gate->name == "qentangle") {
-                    // Implements electron-nuclear spin entanglement.
-                    const auto &params =
-                        gate->get_annotation<annotations::QEntangleParameters>();
-
-                    Str nuq = "nuq" + to_string(params.nuclear);
-                    Str qubit = "q" + to_string(gate->operands[0]);
-                    outfile << detail::qgate("mx90", gate->operands[0]) << "\n";
-                    outfile << detail::qgate2("pmx90", qubit, nuq) << "\n";
-                    outfile << detail::qgate("x90", gate->operands[0]) << "\n";
-                } else if (gate->name == "nventangle") {
-                    // Implements electron-electron entanglement following the
-                    // Barrett and Kok scheme.
-                    Str count = to_string(labelcount);
-                    Str count_1 = to_string(labelcount + 1);
-
-                    outfile << detail::loadimm("0", "R", "2") << "\n";
-                    outfile << detail::label(count) << "\n";
-                    outfile << detail::switchOn(gate->operands[0]) << "\n";
-                    outfile << detail::switchOn(gate->operands[1]) << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[0]) << "\n";
-                    outfile << detail::excite_mw("1", "100", "200", "0", "60",
-                                                 gate->operands[1]) << "\n";
-                    outfile << "wait 100" << "\n";
-                    outfile << detail::mov("R", "0", "photonReg", "01") << "\n";
-                    outfile << detail::switchOff(gate->operands[0]) << "\n";
-                    outfile << detail::switchOff(gate->operands[1]) << "\n";
-                    outfile << detail::addimm("1", "R", "2") << "\n";
-                    outfile << "wait 50" << "\n";
-                    outfile
-                        << detail::branch("R", "1", ">", "", "1", "LAB",
-                                          count_1)
-                        << "\n";
-                    outfile << detail::qgate("x", gate->operands[0]) << "\n";
-                    outfile << detail::qgate("x", gate->operands[1]) << "\n";
-                    outfile << detail::mov("R", "0", "R", "1") << "\n";
-                    outfile << detail::jump(count) << "\n";
-                    outfile << detail::label(count_1) << "\n";
-
-                    labelcount++;
-                    labelcount++;
-                } else {
-                    outfile << "ERROR: Gate " + gate->name +
-                               " is not supported by the Diamond Architecture."
-                            << "\n";
+        // Find the blocks that need a label.
+        const ir::Block *entry_point = ir->program->entry_point.get_ptr().get();
+        if (entry_point != blocks[0].get_ptr().get()) {
+            targets.insert(entry_point);
+            out << detail::jump(get_block_label(entry_point)) << "\n\n";
+        }
+        for (UInt i = 0; i < blocks.size(); i++) {
+            for (const auto &statement : blocks[i]->statements) {
+                if (auto goto_insn = statement->as_goto_instruction()) {
+                    targets.insert(goto_insn->target.get_ptr().get());
                 }
             }
+            const ir::Block *next = nullptr;
+            if (!blocks[i]->next.empty()) {
+                next = blocks[i]->next.get_ptr().get();
+            }
+            if (i + 1 < blocks.size() && next != blocks[i + 1].get_ptr().get()) {
+                targets.insert(next);
+            }
+        }
 
-            if (!end_label.empty()) {
-                outfile << detail::label(end_label) << "\n";
+        for (UInt i = 0; i < blocks.size(); i++) {
+            generate_block(blocks[i]);
+
+            // Jump to the successor of the block if it doesn't directly
+            // follow it.
+            const ir::Block *next = nullptr;
+            if (!blocks[i]->next.empty()) {
+                next = blocks[i]->next.get_ptr().get();
+            }
+            if (i + 1 < blocks.size() && next != blocks[i + 1].get_ptr().get()) {
+                out << detail::jump(get_block_label(next)) << "\n\n";
+            }
+            if (i + 1 == blocks.size() && targets.find(nullptr) != targets.end()) {
+                out << detail::label(get_block_label(nullptr)) << "\n\n";
             }
 
-            outfile << "\n";
+            file.write(out.str());
+            out.str("");
         }
     }
+
+};
+
+utils::Str GenerateMicrocodePass::get_friendly_type() const {
+    return "Diamond microcode generator";
+}
+
+GenerateMicrocodePass::GenerateMicrocodePass(
+    const utils::Ptr<const pmgr::Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
+
+}
+
+utils::Int GenerateMicrocodePass::run(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) const {
+    // General Idea: Make a big case statement with all the different options that
+    // cQASM provides. Then, decide for each option what to write to the output file.
+    // The instruction names are mapped to these options once for the platform, and
+    // the output of each block is buffered and written to the file in one go.
+    // The checks that are inserted between the gates are added to the
+    // program as well, so passes that run after this one see them.
+    OutFile file(context.output_prefix + ".dqasm");
+    MicrocodeGenerator(ir).run(file);
     return 0;
 }
 
@@ -12,14 +12,27 @@
 namespace ql {
 namespace arch {
 
+/**
+ * Returns the default architecture factory. The architecture info objects
+ * are stateless, so they are only constructed when this is first called,
+ * and are then shared by all default factories.
+ */
+const Factory &Factory::get_default() {
+    static const Factory DEFAULT = [] {
+        Factory factory{Empty{}};
+        factory.register_architecture<cc::Info>();
+        factory.register_architecture<cc_light::Info>();
+        factory.register_architecture<none::Info>();
+        factory.register_architecture<diamond::Info>();
+        return factory;
+    }();
+    return DEFAULT;
+}
+
 /**
  * Constructs a default architecture factory for OpenQL.
  */
-Factory::Factory() {
-    register_architecture<cc::Info>();
-    register_architecture<cc_light::Info>();
-    register_architecture<none::Info>();
-    register_architecture<diamond::Info>();
+Factory::Factory() : Factory(get_default()) {
 }
 
 /**
@@ -5,7 +5,10 @@
 #include "ql/com/ana/interaction_matrix.h"
 
 #include <iomanip>
+#include <algorithm>
+#include "ql/utils/exception.h"
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 #include "ql/com/options.h"
 
 namespace ql {
@@ -14,29 +17,128 @@ namespace ana {
 
 using namespace utils;
 
-InteractionMatrix::InteractionMatrix(
+/**
+ * Returns the qubit operand pairs of the two-qubit gates of the given kernel
+ * that are counted, in both directions.
+ */
+Vec<Pair<UInt, UInt>> InteractionMatrix::get_interactions(
     const ir::compat::KernelRef &kernel
-) : size(kernel->qubit_count) {
-    matrix.resize(size, Vec<UInt>(size, 0));
+) {
+    Vec<Pair<UInt, UInt>> interactions;
     for (auto ins : kernel->gates) {
-        Str insName = ins->qasm();
-        if (insName.find("cnot") != Str::npos) {
+        // the qasm string of a gate only contains "cnot" through its name
+        if (ins->name.find("cnot") != Str::npos) {
             // for now the interaction matrix only for cnot
             auto operands = ins->operands;
             if (operands.size() == 2) {
                 UInt operand0 = operands[0];
                 UInt operand1 = operands[1];
-                matrix[operand0][operand1] += 1;
-                matrix[operand1][operand0] += 1;
+                interactions.emplace_back(operand0, operand1);
+                interactions.emplace_back(operand1, operand0);
             }
         }
     }
+    return interactions;
+}
+
+/**
+ * Constructs an interaction matrix of the given size, counting each of the
+ * given (row, column) pairs once. The pairs are sorted and then run-length
+ * encoded into the rows.
+ */
+InteractionMatrix::InteractionMatrix(
+    UInt size,
+    const Vec<Pair<UInt, UInt>> &interactions
+) : size(size), row_offsets(size + 1, 0) {
+    auto sorted = interactions;
+    std::sort(sorted.begin(), sorted.end());
+    for (UInt i = 0; i < sorted.size(); ) {
+        auto row = sorted[i].first;
+        auto column = sorted[i].second;
+        if (row >= size || column >= size) {
+            QL_ICE(
+                "interaction between qubits " << row << " and " << column
+                << " is out of range for " << size << " qubits"
+            );
+        }
+        UInt count = 0;
+        while (i < sorted.size() && sorted[i].first == row && sorted[i].second == column) {
+            count++;
+            i++;
+        }
+        entries.push_back({column, count});
+        row_offsets[row + 1]++;
+    }
+    for (UInt row = 0; row < size; row++) {
+        row_offsets[row + 1] += row_offsets[row];
+    }
+}
+
+/**
+ * Computes the interaction matrix for the given kernel.
+ */
+InteractionMatrix::InteractionMatrix(
+    const ir::compat::KernelRef &kernel
+) : InteractionMatrix(kernel->qubit_count, get_interactions(kernel)) {
+}
+
+/**
+ * Returns the size of the matrix, i.e. the number of qubits.
+ */
+UInt InteractionMatrix::get_size() const {
+    return size;
+}
+
+/**
+ * Returns the number of interactions between the given qubits.
+ */
+UInt InteractionMatrix::get(UInt qubit1, UInt qubit2) const {
+    if (qubit1 >= size) {
+        return 0;
+    }
+    auto begin = entries.begin() + row_offsets[qubit1];
+    auto end = entries.begin() + row_offsets[qubit1 + 1];
+    auto it = std::lower_bound(begin, end, qubit2, [](const Entry &entry, UInt qubit) {
+        return entry.qubit < qubit;
+    });
+    if (it != end && it->qubit == qubit2) {
+        return it->count;
+    }
+    return 0;
+}
+
+/**
+ * Returns the nonzero entries of the row for the given qubit, sorted by
+ * column.
+ */
+Vec<InteractionMatrix::Entry> InteractionMatrix::get_row(UInt qubit) const {
+    if (qubit >= size) {
+        return {};
+    }
+    return Vec<Entry>(
+        entries.begin() + row_offsets[qubit],
+        entries.begin() + row_offsets[qubit + 1]
+    );
+}
+
+/**
+ * Returns the number of nonzero entries in the matrix.
+ */
+UInt InteractionMatrix::get_num_entries() const {
+    return entries.size();
 }
 
 /**
- * Returns the embedded matrix.
+ * Returns the matrix in dense form. This uses memory quadratic in the number
+ * of qubits.
  */
-const InteractionMatrix::Matrix &InteractionMatrix::get_matrix() const {
+InteractionMatrix::Matrix InteractionMatrix::get_dense_matrix() const {
+    Matrix matrix(size, Vec<UInt>(size, 0));
+    for (UInt row = 0; row < size; row++) {
+        for (UInt i = row_offsets[row]; i < row_offsets[row + 1]; i++) {
+            matrix[row][entries[i].qubit] = entries[i].count;
+        }
+    }
     return matrix;
 }
 
@@ -62,8 +164,14 @@ Str InteractionMatrix::get_string() const {
 
     for (UInt p = 0; p < size; p++) {
         ss << ALIGNMENT << "q" + to_string(p);
+        auto i = row_offsets[p];
         for (UInt c = 0; c < size; c++) {
-            ss << ALIGNMENT << matrix[p][c];
+            if (i < row_offsets[p + 1] && entries[i].qubit == c) {
+                ss << ALIGNMENT << entries[i].count;
+                i++;
+            } else {
+                ss << ALIGNMENT << 0;
+            }
         }
         ss << std::endl;
     }
@@ -72,17 +180,33 @@ Str InteractionMatrix::get_string() const {
     return ss.str();
 }
 
+/**
+ * Returns the matrix as a string with one "<qubit> <qubit> <count>" line for
+ * each nonzero entry.
+ */
+Str InteractionMatrix::get_sparse_string() const {
+    StrStrm ss;
+    ss << "# " << size << " qubits, " << entries.size() << " nonzero entries" << std::endl;
+    for (UInt row = 0; row < size; row++) {
+        for (UInt i = row_offsets[row]; i < row_offsets[row + 1]; i++) {
+            ss << row << " " << entries[i].qubit << " " << entries[i].count << std::endl;
+        }
+    }
+    return ss.str();
+}
+
 /**
  * Constructs interaction matrices for each kernel in the program, and
  * reports the results to the given output stream.
  */
 void InteractionMatrix::dump_for_program(
     const ir::compat::ProgramRef &program,
-    std::ostream &os
+    std::ostream &os,
+    Bool sparse
 ) {
     for (const auto &k : program->kernels) {
         InteractionMatrix imat(k);
-        utils::Str mstr = imat.get_string();
+        utils::Str mstr = sparse ? imat.get_sparse_string() : imat.get_string();
         os << mstr << std::endl;
     }
 }
@@ -94,15 +218,16 @@ void InteractionMatrix::dump_for_program(
  */
 void InteractionMatrix::write_for_program(
     const utils::Str &output_prefix,
-    const ir::compat::ProgramRef &program
+    const ir::compat::ProgramRef &program,
+    Bool sparse
 ) {
     for (const auto &k : program->kernels) {
         ql::com::ana::InteractionMatrix imat(k);
-        utils::Str mstr = imat.get_string();
+        utils::Str mstr = sparse ? imat.get_sparse_string() : imat.get_string();
 
         utils::Str fname = output_prefix + "/" + k->get_name() + "InteractionMatrix.dat";
         QL_IOUT("writing interaction matrix to '" << fname << "' ...");
-        utils::OutFile(fname).write(mstr);
+        utils::AsyncOutFile(fname).write(mstr);
     }
 }
 
@@ -23,6 +23,13 @@ void ClassicalOperationCount::process_instruction(
     }
 }
 
+/**
+ * Accumulates the count for a subsequent block.
+ */
+void ClassicalOperationCount::accumulate(const utils::UInt &block_result) {
+    value += block_result;
+}
+
 /**
  * Quantum gate counting metric.
  */
@@ -35,6 +42,13 @@ void QuantumGateCount::process_instruction(
     }
 }
 
+/**
+ * Accumulates the count for a subsequent block.
+ */
+void QuantumGateCount::accumulate(const utils::UInt &block_result) {
+    value += block_result;
+}
+
 /**
  * Multi-qubit gate counting metric.
  */
@@ -47,6 +61,13 @@ void MultiQubitGateCount::process_instruction(
     }
 }
 
+/**
+ * Accumulates the count for a subsequent block.
+ */
+void MultiQubitGateCount::accumulate(const utils::UInt &block_result) {
+    value += block_result;
+}
+
 /**
  * Qubit usage counting metric.
  */
@@ -69,6 +90,17 @@ void QubitUsageCount::process_instruction(
     }
 }
 
+/**
+ * Accumulates the per-qubit counts for a subsequent block.
+ */
+void QubitUsageCount::accumulate(
+    const utils::SparseMap<utils::UInt, utils::UInt, 0> &block_result
+) {
+    for (const auto &it : block_result) {
+        value[it.first] += it.second;
+    }
+}
+
 /**
  * Qubit cycle usage counting metric.
  */
@@ -92,6 +124,17 @@ void QubitUsedCycleCount::process_instruction(
     }
 }
 
+/**
+ * Accumulates the per-qubit cycle counts for a subsequent block.
+ */
+void QubitUsedCycleCount::accumulate(
+    const utils::SparseMap<utils::UInt, utils::UInt, 0> &block_result
+) {
+    for (const auto &it : block_result) {
+        value[it.first] += it.second;
+    }
+}
+
 /**
  * Returns the duration of a scheduled block in cycles.
  */
@@ -99,6 +142,14 @@ void Latency::process_block(const ir::Ref &ir, const ir::BlockBaseRef &block) {
     value = ir::get_duration_of_block(block);
 }
 
+/**
+ * Accumulates the duration of a subsequent block. Like process_program(), this
+ * reports the duration of the last block processed.
+ */
+void Latency::accumulate(const utils::UInt &block_result) {
+    value = block_result;
+}
+
 } // namespace ana
 } // namespace com
 } // namespace ql
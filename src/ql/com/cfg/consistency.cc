@@ -19,12 +19,12 @@ void check_consistency(const ir::ProgramRef &program) {
     try {
 
         // Check the graph annotation.
-        auto graph = program->get_annotation_ptr<Graph>();
+        auto graph = ir::get_annotation_ptr<Graph>(*program);
         if (!graph) QL_ICE("missing Graph annotation on program");
         if (graph->source.empty()) QL_ICE("missing source block");
-        if (!graph->source->has_annotation<NodeRef>()) QL_ICE("missing source node");
+        if (!ir::has_annotation<NodeRef>(*graph->source)) QL_ICE("missing source node");
         if (graph->sink.empty()) QL_ICE("missing source block");
-        if (!graph->sink->has_annotation<NodeRef>()) QL_ICE("missing source node");
+        if (!ir::has_annotation<NodeRef>(*graph->sink)) QL_ICE("missing source node");
 
         // Sanity-check the source node.
         auto source = get_source_node(program);
@@ -0,0 +1,172 @@
+/** \file
+ * Defines functions for querying the dominator tree of a control-flow graph.
+ */
+
+#include "ql/com/cfg/dominators.h"
+
+#include <algorithm>
+#include "ql/utils/set.h"
+#include "ql/com/cfg/ops.h"
+
+namespace ql {
+namespace com {
+namespace cfg {
+
+/**
+ * Marker for blocks whose immediate dominator has not been determined yet.
+ */
+static const utils::UInt UNDEFINED = (utils::UInt)-1;
+
+/**
+ * Computes the dominator tree of a CFG using the iterative algorithm by
+ * Cooper, Harvey, and Kennedy ("A Simple, Fast Dominance Algorithm"), which
+ * converges in a few passes over the blocks in reverse postorder for the
+ * graphs encountered in practice.
+ */
+static DominatorTree compute_dominator_tree(const ir::BlockRef &source) {
+    DominatorTree tree;
+
+    // Number the reachable blocks in postorder using an iterative depth-first
+    // search, and then reverse the order.
+    {
+        utils::Set<ir::BlockRef> visited;
+        utils::Vec<std::pair<ir::BlockRef, Endpoints::const_iterator>> stack;
+        visited.insert(source);
+        stack.emplace_back(source, get_node(source)->successors.begin());
+        while (!stack.empty()) {
+            auto &top = stack.back();
+            if (top.second == get_node(top.first)->successors.end()) {
+                tree.blocks.push_back(top.first);
+                stack.pop_back();
+                continue;
+            }
+            auto successor = (top.second++)->first;
+            if (visited.insert(successor).second) {
+                stack.emplace_back(successor, get_node(successor)->successors.begin());
+            }
+        }
+        std::reverse(tree.blocks.begin(), tree.blocks.end());
+        for (utils::UInt i = 0; i < tree.blocks.size(); i++) {
+            tree.index.set(tree.blocks[i]) = i;
+        }
+    }
+
+    // Iterate until the immediate dominators converge. Because the blocks are
+    // in reverse postorder, dominators always have a lower index than the
+    // blocks they dominate.
+    auto num_blocks = tree.blocks.size();
+    tree.idom.assign(num_blocks, UNDEFINED);
+    tree.idom[0] = 0;
+    utils::Bool changed = true;
+    while (changed) {
+        changed = false;
+        for (utils::UInt i = 1; i < num_blocks; i++) {
+            auto new_idom = UNDEFINED;
+            for (const auto &endpoint : get_node(tree.blocks[i])->predecessors) {
+                auto it = tree.index.find(endpoint.first);
+                if (it == tree.index.end() || tree.idom[it->second] == UNDEFINED) {
+                    continue;
+                }
+                auto pred = it->second;
+                if (new_idom == UNDEFINED) {
+                    new_idom = pred;
+                    continue;
+                }
+                while (pred != new_idom) {
+                    while (pred > new_idom) pred = tree.idom[pred];
+                    while (new_idom > pred) new_idom = tree.idom[new_idom];
+                }
+            }
+            if (tree.idom[i] != new_idom) {
+                tree.idom[i] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    // Number the blocks in preorder and postorder of the dominator tree, such
+    // that a dominates b if and only if the interval of a contains that of b.
+    utils::Vec<utils::Vec<utils::UInt>> children(num_blocks);
+    for (utils::UInt i = 1; i < num_blocks; i++) {
+        children[tree.idom[i]].push_back(i);
+    }
+    tree.preorder.assign(num_blocks, 0);
+    tree.postorder.assign(num_blocks, 0);
+    utils::UInt pre = 0;
+    utils::UInt post = 0;
+    utils::Vec<std::pair<utils::UInt, utils::UInt>> stack;
+    tree.preorder[0] = pre++;
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        auto &top = stack.back();
+        if (top.second == children[top.first].size()) {
+            tree.postorder[top.first] = post++;
+            stack.pop_back();
+            continue;
+        }
+        auto child = children[top.first][top.second++];
+        tree.preorder[child] = pre++;
+        stack.emplace_back(child, 0);
+    }
+
+    return tree;
+}
+
+/**
+ * Returns the dominator tree of the control-flow graph of the given program,
+ * which must already exist. The tree is computed on first use and cached on
+ * the graph, until the graph is rebuilt or modified through the functions in
+ * incremental.h.
+ */
+const DominatorTree &get_dominator_tree(const ir::ProgramRef &program) {
+    auto graph = ir::get_annotation_ptr<Graph>(*program);
+    if (!graph) {
+        QL_ICE("the control-flow graph of the program has not been built");
+    }
+    if (!graph->dominators.has_value()) {
+        graph->dominators.emplace(compute_dominator_tree(graph->source));
+    }
+    return *graph->dominators;
+}
+
+/**
+ * Returns the immediate dominator of the given block. An empty reference is
+ * returned for the source block and for blocks that are unreachable.
+ */
+ir::BlockRef get_immediate_dominator(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &block
+) {
+    const auto &tree = get_dominator_tree(program);
+    auto it = tree.index.find(block);
+    if (it == tree.index.end() || it->second == 0) {
+        return {};
+    }
+    return tree.blocks[tree.idom[it->second]];
+}
+
+/**
+ * Returns whether block a dominates block b, i.e. whether all paths from the
+ * source to b pass through a. Every reachable block dominates itself.
+ * Unreachable blocks neither dominate nor are dominated by anything.
+ */
+utils::Bool dominates(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &a,
+    const ir::BlockRef &b
+) {
+    const auto &tree = get_dominator_tree(program);
+    auto ia = tree.index.find(a);
+    auto ib = tree.index.find(b);
+    if (ia == tree.index.end() || ib == tree.index.end()) {
+        return false;
+    }
+    return (
+        tree.preorder[ia->second] <= tree.preorder[ib->second] &&
+        tree.postorder[ia->second] >= tree.postorder[ib->second]
+    );
+}
+
+} // namespace cfg
+} // namespace com
+} // namespace ql
@@ -0,0 +1,191 @@
+/** \file
+ * Defines functions for updating an existing control-flow graph after local
+ * edits to the program, without rebuilding it.
+ */
+
+#include "ql/com/cfg/incremental.h"
+
+#include "ql/ir/describe.h"
+
+namespace ql {
+namespace com {
+namespace cfg {
+
+/**
+ * Returns the Graph annotation of the given program, throwing an ICE if the
+ * control-flow graph has not been built.
+ */
+static Graph &get_graph(const ir::ProgramRef &program) {
+    auto graph = ir::get_annotation_ptr<Graph>(*program);
+    if (!graph) {
+        QL_ICE("the control-flow graph of the program has not been built");
+    }
+    return *graph;
+}
+
+/**
+ * Ensures that a node exists for the given block, and returns that node.
+ */
+static NodeRef ensure_node(const ir::BlockRef &block) {
+    if (auto node = ir::get_annotation_ptr<NodeRef>(*block)) {
+        return *node;
+    }
+    NodeRef node;
+    node.emplace();
+    ir::set_annotation<NodeRef>(*block, node);
+    return node;
+}
+
+/**
+ * Returns the node for the given block, throwing an ICE if it does not exist.
+ */
+static NodeRef require_node(const ir::BlockRef &block) {
+    if (auto node = ir::get_annotation_ptr<NodeRef>(*block)) {
+        return *node;
+    }
+    QL_ICE(ir::describe(block) << " is not part of the control-flow graph");
+}
+
+/**
+ * Creates a CFG edge between the two given blocks, mapping an empty to
+ * reference to the sink of the given graph.
+ */
+static void add_edge(Graph &graph, const ir::BlockRef &from, const ir::BlockRef &to) {
+    auto target = to.empty() ? graph.sink : to;
+    QL_ASSERT(from != target);
+    auto from_node = ensure_node(from);
+    auto target_node = ensure_node(target);
+    auto result = from_node->successors.insert({target, {}});
+    if (!result.second) {
+        return;
+    }
+    auto &edge_ref = result.first->second;
+    edge_ref.emplace();
+    edge_ref->predecessor = from;
+    edge_ref->successor = target;
+    QL_ASSERT(target_node->predecessors.insert({from, edge_ref}).second);
+}
+
+/**
+ * Adds an edge between the two given blocks to the control-flow graph of the
+ * given program, which must already exist. An empty to reference refers to the
+ * sink. Nothing happens if the edge already exists. This only modifies the
+ * graph; the caller is responsible for the goto instruction or next link that
+ * the edge represents.
+ */
+void add_edge(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &from,
+    const ir::BlockRef &to
+) {
+    auto &graph = get_graph(program);
+    add_edge(graph, from, to);
+    graph.dominators.reset();
+}
+
+/**
+ * Removes the edge between the two given blocks from the control-flow graph
+ * of the given program, which must already exist. An empty to reference
+ * refers to the sink. Nothing happens if there is no such edge. This only
+ * modifies the graph; the caller is responsible for removing the goto
+ * instruction or next link that the edge represented.
+ */
+void remove_edge(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &from,
+    const ir::BlockRef &to
+) {
+    auto &graph = get_graph(program);
+    auto target = to.empty() ? graph.sink : to;
+    if (require_node(from)->successors.erase(target)) {
+        require_node(target)->predecessors.erase(from);
+        graph.dominators.reset();
+    }
+}
+
+/**
+ * Recomputes the outgoing edges of the given block from its goto instructions
+ * and next link, after these have been modified. Only the nodes of the block
+ * and its old and new successors are touched. The block must be in basic
+ * block form. If the block does not have a node yet, one is created.
+ */
+void update_successors(const ir::ProgramRef &program, const ir::BlockRef &block) {
+    auto &graph = get_graph(program);
+    auto node = ensure_node(block);
+
+    // Remove the existing outgoing edges.
+    for (const auto &endpoint : node->successors) {
+        require_node(endpoint.first)->predecessors.erase(block);
+    }
+    node->successors.clear();
+
+    // Add the edges for the goto instructions and the next link.
+    for (const auto &statement : block->statements) {
+        if (!statement->as_instruction()) {
+            QL_ICE(
+                "found non-instruction in program; cannot construct CFG: " <<
+                ir::describe(statement)
+            );
+        }
+        if (auto gi = statement->as_goto_instruction()) {
+            add_edge(graph, block, gi->target.as_mut());
+        }
+    }
+    add_edge(graph, block, block->next.as_mut());
+
+    graph.dominators.reset();
+}
+
+/**
+ * Inserts the given block into the given program at the given index (the
+ * number of blocks to append), and adds a node with the outgoing edges of the
+ * block to the control-flow graph, which must already exist. Incoming edges
+ * are added by calling update_successors() for the blocks that were modified
+ * to jump to the new block.
+ */
+void insert_block(
+    const ir::ProgramRef &program,
+    const ir::BlockRef &block,
+    utils::UInt index
+) {
+    QL_ASSERT(index <= program->blocks.size());
+    program->blocks.add(block, index);
+    update_successors(program, block);
+}
+
+/**
+ * Removes the given block from the given program, along with its node and all
+ * edges from and to it. This requires a linear search for the block in the
+ * program, but does not touch the nodes of unrelated blocks. The caller is
+ * responsible for making sure that no goto instruction or next link still
+ * refers to the block, and that it is not the entry point.
+ */
+void remove_block(const ir::ProgramRef &program, const ir::BlockRef &block) {
+    auto &graph = get_graph(program);
+
+    // Find the block in the program.
+    utils::UInt index = 0;
+    while (index < program->blocks.size() && program->blocks[index] != block) {
+        index++;
+    }
+    if (index == program->blocks.size()) {
+        QL_ICE(ir::describe(block) << " is not part of the program");
+    }
+
+    // Remove the edges from and to the block and its node.
+    auto node = require_node(block);
+    for (const auto &endpoint : node->successors) {
+        require_node(endpoint.first)->predecessors.erase(block);
+    }
+    for (const auto &endpoint : node->predecessors) {
+        require_node(endpoint.first)->successors.erase(block);
+    }
+    ir::erase_annotation<NodeRef>(*block);
+    program->blocks.remove(index);
+
+    graph.dominators.reset();
+}
+
+} // namespace cfg
+} // namespace com
+} // namespace ql
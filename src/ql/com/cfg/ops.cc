@@ -15,7 +15,7 @@ NodeCRef get_node(const ir::BlockRef &block) {
     if (block.empty()) {
         return {};
     }
-    if (auto node = block->get_annotation_ptr<NodeRef>()) {
+    if (auto node = ir::get_annotation_ptr<NodeRef>(*block)) {
         return node->as_const();
     } else {
         return {};
@@ -26,7 +26,7 @@ NodeCRef get_node(const ir::BlockRef &block) {
  * Returns the source block associated with the given program, if any.
  */
 ir::BlockRef get_source(const ir::ProgramRef &program) {
-    if (auto data = program->get_annotation_ptr<Graph>()) {
+    if (auto data = ir::get_annotation_ptr<Graph>(*program)) {
         return data->source;
     } else {
         return {};
@@ -44,7 +44,7 @@ NodeCRef get_source_node(const ir::ProgramRef &program) {
  * Returns the sink block associated with the given program, if any.
  */
 ir::BlockRef get_sink(const ir::ProgramRef &program) {
-    if (auto data = program->get_annotation_ptr<Graph>()) {
+    if (auto data = ir::get_annotation_ptr<Graph>(*program)) {
         return data->sink;
     } else {
         return {};
@@ -77,9 +77,9 @@ EdgeCRef get_edge(const ir::BlockRef &from, const ir::BlockRef &to) {
  * Removes the control-flow graph annotations from the given program.
  */
 void clear(const ir::ProgramRef &program) {
-    program->erase_annotation<Graph>();
+    ir::erase_annotation<Graph>(*program);
     for (const auto &block : program->blocks) {
-        block->erase_annotation<NodeRef>();
+        ir::erase_annotation<NodeRef>(*block);
     }
 }
 
@@ -0,0 +1,79 @@
+#include "ql/ir/ir.h"
+#include "ql/com/cfg/build.h"
+#include "ql/com/cfg/ops.h"
+#include "ql/com/cfg/consistency.h"
+#include "ql/com/cfg/incremental.h"
+#include "ql/com/cfg/dominators.h"
+
+using namespace ql;
+
+int main() {
+
+    // Build a diamond: a branches to c and falls through to b, both of which
+    // continue with d, which ends the program.
+    auto program = utils::make<ir::Program>();
+    auto a = utils::make<ir::Block>("a");
+    auto b = utils::make<ir::Block>("b");
+    auto c = utils::make<ir::Block>("c");
+    auto d = utils::make<ir::Block>("d");
+    auto branch = utils::make<ir::GotoInstruction>();
+    branch->target = c;
+    a->statements.add(branch);
+    a->next = b;
+    b->next = d;
+    c->next = d;
+    program->blocks.add(a);
+    program->blocks.add(b);
+    program->blocks.add(c);
+    program->blocks.add(d);
+    program->entry_point = a;
+
+    com::cfg::build(program);
+    com::cfg::check_consistency(program);
+    auto source = com::cfg::get_source(program);
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, source).empty());
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, a) == source);
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, b) == a);
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, c) == a);
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, d) == a);
+    QL_ASSERT(com::cfg::dominates(program, a, d));
+    QL_ASSERT(com::cfg::dominates(program, d, d));
+    QL_ASSERT(!com::cfg::dominates(program, b, d));
+    QL_ASSERT(!com::cfg::dominates(program, d, a));
+
+    // Insert a block e between b and d. Only the nodes of b, d, and e need to
+    // be updated, and the dominator tree is recomputed.
+    auto e = utils::make<ir::Block>("e");
+    e->next = d;
+    b->next = e;
+    com::cfg::insert_block(program, e, 2);
+    com::cfg::update_successors(program, b);
+    com::cfg::check_consistency(program);
+    QL_ASSERT(program->blocks[2] == e);
+    QL_ASSERT(!com::cfg::get_edge(b, e).empty());
+    QL_ASSERT(com::cfg::get_edge(b, d).empty());
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, e) == b);
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, d) == a);
+    QL_ASSERT(com::cfg::dominates(program, b, e));
+
+    // Let c end the program by patching its edges directly. d can then only
+    // be reached through e.
+    c->next.reset();
+    com::cfg::remove_edge(program, c, d);
+    com::cfg::add_edge(program, c, {});
+    com::cfg::check_consistency(program);
+    QL_ASSERT(!com::cfg::get_edge(c, com::cfg::get_sink(program)).empty());
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, d) == e);
+
+    // Remove e again.
+    b->next = d;
+    com::cfg::update_successors(program, b);
+    com::cfg::remove_block(program, e);
+    com::cfg::check_consistency(program);
+    QL_ASSERT(program->blocks.size() == 4);
+    QL_ASSERT(!com::cfg::get_node(e).has_value());
+    QL_ASSERT(com::cfg::get_immediate_dominator(program, d) == b);
+
+    com::cfg::clear(program);
+    return 0;
+}
@@ -5,6 +5,9 @@
 
 #include "ql/com/ddg/build.h"
 
+#include <algorithm>
+#include "ql/utils/hash_map.h"
+#include "ql/utils/trace.h"
 #include "ql/ir/ops.h"
 #include "ql/ir/describe.h"
 #include "ql/com/ddg/ops.h"
@@ -212,6 +215,18 @@ void EventGatherer::reset() {
 
 /**
  * Data dependency graph builder class. Implements the build() function.
+ *
+ * The builder tracks the object accesses (events) of the statements processed
+ * thus far that may still cause dependencies for future statements, grouped
+ * into lanes. Each lane holds the events for one major element of an object
+ * (for example q[3], or the implicit bit of q[3]), the events that access a
+ * non-scalar object as a whole (or a scalar object), or the events that access
+ * the global state. Events in different lanes of different objects are always
+ * provably distinct, so an incoming event only has to be compared with the
+ * events in its own lane, the whole-object lane of its object, and the global
+ * lane. Lanes are identified by dense indices; the lanes for the qubits and
+ * their implicit bits are allocated up front, such that looking up a lane for
+ * a qubit or implicit bit access needs no map lookup at all.
  */
 class Builder {
 private:
@@ -265,6 +280,15 @@ private:
          */
         ir::StatementRef statement;
 
+        /**
+         * Sequence number, assigned from a counter that is incremented
+         * whenever the pair is pushed into a commuting or non-commuting list.
+         * Taken over all lanes, the lists are thus ordered by sequence number,
+         * which is used to process events from multiple lanes in the order in
+         * which they were added.
+         */
+        utils::UInt sequence;
+
         /**
          * Returns whether this event commutes with the given event. Also
          * returns true when the events are caused by the same node.
@@ -286,35 +310,266 @@ private:
     /**
      * List of events and corresponding DDG nodes.
      */
-    using EventNodePairs = utils::List<EventNodePair>;
+    using EventNodePairs = utils::Vec<EventNodePair>;
+
+    /**
+     * The state tracked for a single lane.
+     */
+    struct Lane {
+
+        /**
+         * List of events/nodes that commute with each other. That is, all
+         * events in this list commute with all other events in this list.
+         * Incoming events will always be pushed into this set, evicting any
+         * entries that don't commute with the incoming event to the
+         * non_commuting list. Whenever an event is evicted from commuting to
+         * non_commuting, any entries previously in non_commuting that operate
+         * on the same object or a subset thereof that don't commute with the
+         * evicted event are pruned, to avoid redundant edges in the DDG as
+         * much as possible.
+         */
+        EventNodePairs commuting;
+
+        /**
+         * List of events and associated DDG nodes in the past, that can't
+         * possibly commute with any future events anymore. When a new event is
+         * pushed into the commuting list, a data dependency must be added
+         * between all events in this list that may (partially) operate on the
+         * same object, regardless of whether the incoming event would commute
+         * with that event (because something in commuting is already
+         * preventing this).
+         */
+        EventNodePairs non_commuting;
+
+    };
+
+    /**
+     * The lanes. Lane 0 is the global lane, used for events that access the
+     * global state.
+     */
+    utils::Vec<Lane> lanes;
+
+    /**
+     * The lanes belonging to a single object, accessed as a particular data
+     * type.
+     */
+    struct ObjectLanes {
+
+        /**
+         * The lane for events that access the object as a whole.
+         */
+        utils::UInt whole;
+
+        /**
+         * The lanes for events that access a single element of the object,
+         * indexed by the major index, or utils::MAX if no lane has been
+         * allocated for the element yet.
+         */
+        utils::Vec<utils::UInt> elements;
+
+        /**
+         * All lanes belonging to the object, including the whole-object lane.
+         */
+        utils::Vec<utils::UInt> all;
+
+    };
+
+    /**
+     * The lanes for the objects encountered thus far. The first one is the
+     * qubit register, the second one the implicit bits of the qubits, if the
+     * platform has those.
+     */
+    utils::Vec<ObjectLanes> objects;
+
+    /**
+     * Key type for object_indices: the target object and the data type it is
+     * accessed as.
+     */
+    using ObjectKey = utils::Pair<const ir::Object*, const ir::DataType*>;
 
     /**
-     * List of events/nodes that commute with each other. That is, all events
-     * in this list commute with all other events in this list. Incoming events
-     * will always be pushed into this set, evicting any entries that don't
-     * commute with the incoming event to the non_commuting list. Whenever an
-     * event is evicted from commuting to non_commuting, any entries previously
-     * in non_commuting that operate on the same object or a subset thereof that
-     * don't commute with the evicted event are pruned, to avoid redundant edges
-     * in the DDG as much as possible.
+     * Hash function for ObjectKey.
      */
-    EventNodePairs commuting;
+    struct ObjectKeyHash {
+        std::size_t operator()(const ObjectKey &key) const {
+            return (
+                std::hash<const void*>()(key.first) * 31 +
+                std::hash<const void*>()(key.second)
+            );
+        }
+    };
+
+    /**
+     * Map from the objects encountered thus far to their index in objects.
+     */
+    utils::HashMap<ObjectKey, utils::UInt, ObjectKeyHash> object_indices;
 
     /**
-     * List of events and associated DDG nodes in the past, that can't possibly
-     * commute with any future events anymore. When a new event is pushed into
-     * the commuting list, a data dependency must be added between all events
-     * in this list that may (partially) operate on the same object, regardless
-     * of whether the incoming event would commute with that event (because
-     * something in commuting is already preventing this).
+     * The qubit register of the platform, used to find its lanes without
+     * going through object_indices.
      */
-    EventNodePairs non_commuting;
+    const ir::Object *qubits;
+
+    /**
+     * The implicit bit type of the platform, or nullptr if there is none.
+     */
+    const ir::DataType *implicit_bit_type;
+
+    /**
+     * Counter for the sequence numbers of the event-node pairs.
+     */
+    utils::UInt sequence_counter;
 
     /**
      * Accumulator for the order field of the DDG nodes.
      */
     utils::Int order_accumulator;
 
+    /**
+     * Whether to prune edges that are implied by a path of two edges, see
+     * reduce_predecessors().
+     */
+    utils::Bool transitive_reduction;
+
+    /**
+     * Number of edges in the graph thus far.
+     */
+    utils::UInt num_edges;
+
+    /**
+     * Number of edges pruned by reduce_predecessors() thus far.
+     */
+    utils::UInt num_pruned;
+
+    /**
+     * Scratch space for process_event(): the lanes that the incoming event may
+     * interact with.
+     */
+    utils::Vec<utils::UInt> interacting_lanes;
+
+    /**
+     * Scratch space for process_event(): the sequence numbers and lanes of the
+     * event-node pairs to evict.
+     */
+    utils::Vec<utils::Pair<utils::UInt, utils::UInt>> evictions;
+
+    /**
+     * Scratch space for process_event(): the non-global event-node pairs that
+     * may need an edge to the incoming event.
+     */
+    utils::Vec<const EventNodePair*> candidates;
+
+    /**
+     * Scratch space for reduce_predecessors(): the predecessors to disconnect.
+     */
+    utils::Vec<ir::StatementRef> redundant;
+
+    /**
+     * Allocates a new, empty lane and returns its index.
+     */
+    utils::UInt add_lane() {
+        lanes.emplace_back();
+        return lanes.size() - 1;
+    }
+
+    /**
+     * Adds an entry for an object with the given number of major elements to
+     * objects, and returns its index.
+     */
+    utils::UInt add_object(utils::UInt num_elements) {
+        objects.emplace_back();
+        auto &object = objects.back();
+        object.whole = add_lane();
+        object.elements.resize(num_elements, utils::MAX);
+        object.all.push_back(object.whole);
+        return objects.size() - 1;
+    }
+
+    /**
+     * Returns the lanes for the object referred to by the given non-global
+     * reference, adding an entry for it if there is none yet.
+     */
+    ObjectLanes &get_object(const Reference &reference) {
+        auto target = reference.target.get_ptr().get();
+        auto data_type = reference.data_type.get_ptr().get();
+        if (target == qubits) {
+            if (data_type == reference.target->data_type.get_ptr().get()) {
+                return objects[0];
+            } else if (data_type == implicit_bit_type) {
+                return objects[1];
+            }
+        }
+        auto it = object_indices.find({target, data_type});
+        if (it != object_indices.end()) {
+            return objects[it->second];
+        }
+        utils::UInt num_elements = 0;
+        if (!reference.target->shape.empty()) {
+            num_elements = reference.target->shape[0];
+        }
+        auto index = add_object(num_elements);
+        object_indices.insert({{target, data_type}, index});
+        return objects[index];
+    }
+
+    /**
+     * Returns the lane for events with the given major index for the given
+     * object, allocating it if there is none yet.
+     */
+    utils::UInt get_element_lane(ObjectLanes &object, utils::UInt index) {
+        if (index >= object.elements.size()) {
+            object.elements.resize(index + 1, utils::MAX);
+        }
+        auto &lane = object.elements[index];
+        if (lane == utils::MAX) {
+            lane = add_lane();
+            object.all.push_back(lane);
+        }
+        return lane;
+    }
+
+    /**
+     * Returns the lane that events with the given reference belong to.
+     */
+    utils::UInt get_home_lane(const Reference &reference) {
+        if (reference.is_global_state()) {
+            return 0;
+        }
+        auto &object = get_object(reference);
+        if (reference.indices.empty()) {
+            return object.whole;
+        }
+        return get_element_lane(object, reference.indices[0]);
+    }
+
+    /**
+     * Returns the lanes containing all events that may refer to (partially)
+     * the same objects as the given reference via interacting_lanes. If
+     * include_global is set, the global lane is included as well; otherwise it
+     * is only included if the reference itself refers to the global state.
+     */
+    void get_interacting_lanes(const Reference &reference, utils::Bool include_global) {
+        interacting_lanes.clear();
+        if (reference.is_global_state()) {
+            for (utils::UInt lane = 0; lane < lanes.size(); lane++) {
+                interacting_lanes.push_back(lane);
+            }
+            return;
+        }
+        if (include_global) {
+            interacting_lanes.push_back(0);
+        }
+        auto &object = get_object(reference);
+        if (reference.indices.empty()) {
+            for (auto lane : object.all) {
+                interacting_lanes.push_back(lane);
+            }
+        } else {
+            interacting_lanes.push_back(object.whole);
+            interacting_lanes.push_back(get_element_lane(object, reference.indices[0]));
+        }
+    }
+
     /**
      * Adds a data dependency edge between the nodes of the given two event-node
      * pairs, using the duration of the "from" statement as weight.
@@ -337,6 +592,7 @@ private:
             edge_ref->successor = to.statement;
             edge_ref->weight = 0;
             QL_ASSERT(to.node->predecessors.insert({from.statement, edge_ref}).second);
+            num_edges++;
 
         }
 
@@ -360,52 +616,97 @@ private:
     }
 
     /**
-     * Evicts an event-node pair from the commuting list into the non_commuting
-     * list, and prunes the non_commuting list accordingly. it must be an
-     * iterator of the commuting list. It is advanced to the next event-node
-     * pair after eviction.
+     * Evicts the event-node pair with the given sequence number from the
+     * commuting list of the given lane into its non_commuting list, and prunes
+     * the non_commuting lists accordingly.
      */
-    void evict_from_commuting(EventNodePairs::Iter &it) {
-        QL_DOUT("    evict: " << it->event << " for " << ir::describe(it->statement));
+    void evict_from_commuting(utils::UInt lane_index, utils::UInt sequence) {
+        auto &commuting = lanes[lane_index].commuting;
+        auto it = commuting.begin();
+        while (it->sequence != sequence) {
+            ++it;
+        }
+        auto enp = *it;
+        commuting.erase(it);
+        QL_DOUT("    evict: " << enp.event << " for " << ir::describe(enp.statement));
 
         // Remove any event-node pairs in non_commuting of which the event is
         // fully shadowed by the incoming event. The shadowing implies that the
         // events don't commute, and thus that there is already a DDG edge
-        // between them. Because anything that would get an edge from *nc_it
-        // would also get an edge to *it in this case, and because dependency
-        // relations are transitive, we can safely forget about nc_it, and thus
-        // optimize the graph and the generation thereof.
-        auto nc_it = non_commuting.begin();
-        while (nc_it != non_commuting.end()) {
-            if (nc_it->event.is_shadowed_by(it->event)) {
-                nc_it = non_commuting.erase(nc_it);
-            } else {
-                ++nc_it;
-            }
+        // between them. Because anything that would get an edge from the
+        // shadowed pair would also get an edge to enp in this case, and
+        // because dependency relations are transitive, we can safely forget
+        // about it, and thus optimize the graph and the generation thereof.
+        // Only events in the lanes that interact with enp can be shadowed by
+        // it, and the global lane is only affected by global events.
+        get_interacting_lanes(enp.event.reference, false);
+        for (auto lane : interacting_lanes) {
+            auto &non_commuting = lanes[lane].non_commuting;
+            non_commuting.erase(
+                std::remove_if(
+                    non_commuting.begin(), non_commuting.end(),
+                    [&enp](const EventNodePair &nc) {
+                        return nc.event.is_shadowed_by(enp.event);
+                    }
+                ),
+                non_commuting.end()
+            );
         }
 
         // Move the event-node pair from commuting to non_commuting.
-        non_commuting.push_back(*it);
-        it = commuting.erase(it);
+        enp.sequence = sequence_counter++;
+        lanes[lane_index].non_commuting.push_back(enp);
 
     }
 
     /**
-     * Processes an incoming event by adding it to the commuting list, first
-     * evicting anything from the list that doesn't commute with it.
+     * Processes an incoming event by adding it to the commuting list of its
+     * lane, first evicting anything from the lists that doesn't commute with
+     * it.
      */
-    void process_event(const EventNodePair &incoming) {
+    void process_event(EventNodePair incoming) {
         QL_DOUT("  process event: " << incoming.event << " for " << ir::describe(incoming.statement));
+        const auto &reference = incoming.event.reference;
+
+        // Find the event-node pairs that don't commute with the incoming pair
+        // in the commuting lists, and evict them in the order in which they
+        // were added.
+        get_interacting_lanes(reference, true);
+        evictions.clear();
+        for (auto lane : interacting_lanes) {
+            for (const auto &enp : lanes[lane].commuting) {
+                if (!enp.commutes_with(incoming)) {
+                    evictions.push_back({enp.sequence, lane});
+                }
+            }
+        }
+        std::sort(evictions.begin(), evictions.end());
+        for (const auto &eviction : evictions) {
+            evict_from_commuting(eviction.second, eviction.first);
+        }
 
-        // Evict any event-node pairs that don't commute with the incoming pair
-        // from the commuting list.
-        auto it = commuting.begin();
-        while (it != commuting.end()) {
-            if (!it->commutes_with(incoming)) {
-                evict_from_commuting(it);
-            } else {
-                ++it;
+        // Gather the non-global event-node pairs in non_commuting that may
+        // need an edge to the incoming pair, in the order in which they were
+        // added.
+        get_interacting_lanes(reference, false);
+        candidates.clear();
+        utils::UInt num_lanes = 0;
+        for (auto lane : interacting_lanes) {
+            if (lane == 0) continue;
+            const auto &non_commuting = lanes[lane].non_commuting;
+            if (non_commuting.empty()) continue;
+            for (const auto &nc : non_commuting) {
+                candidates.push_back(&nc);
             }
+            num_lanes++;
+        }
+        if (num_lanes > 1) {
+            std::sort(
+                candidates.begin(), candidates.end(),
+                [](const EventNodePair *a, const EventNodePair *b) {
+                    return a->sequence < b->sequence;
+                }
+            );
         }
 
         // Add DDG edges from nodes in non_commuting that hit the same object as
@@ -414,42 +715,80 @@ private:
         // need an edge with, because said node necessarily will already have an
         // edge to this global state write.
         utils::Bool any_edge = false;
-        utils::List<std::reference_wrapper<const EventNodePair>> global_write;
-        for (const auto &nc : non_commuting) {
-            if (nc.event.reference.is_global_state()) {
-                global_write.push_back(nc);
-                continue;
-            }
-            if (!nc.event.reference.is_provably_distinct_from(incoming.event.reference)) {
-                add_edge(nc, incoming);
+        for (auto nc : candidates) {
+            if (!nc->event.reference.is_provably_distinct_from(reference)) {
+                add_edge(*nc, incoming);
                 any_edge = true;
             }
         }
         if (!any_edge) {
-            for (const auto &nc : global_write) {
-                QL_ASSERT(!nc.get().commutes_with(incoming));
+            for (const auto &nc : lanes[0].non_commuting) {
+                QL_ASSERT(!nc.commutes_with(incoming));
                 add_edge(nc, incoming);
             }
         }
 
-        // Add the incoming pair to the commuting list.
-        commuting.push_back(incoming);
+        // Add the incoming pair to the commuting list of its lane.
+        incoming.sequence = sequence_counter++;
+        lanes[get_home_lane(reference)].commuting.push_back(incoming);
 
     }
 
+    /**
+     * Removes the incoming edges of the given node that are implied by a path
+     * of two edges via another predecessor of the node, with at least the
+     * same combined weight. Only the edges to the node that was just added
+     * need to be considered, as the edges between earlier nodes never change
+     * anymore, so this is done as soon as a node is complete. Paths longer
+     * than two edges are not considered, but the two-edge case covers the
+     * common pattern of a multi-qubit gate that depends on both a gate on one
+     * of its qubits and on the gate preceding that gate on another qubit.
+     * Note that the causes of the removed edges are lost.
+     */
+    void reduce_predecessors(const NodeRef &node, const ir::StatementRef &statement) {
+        if (node->predecessors.size() < 2) {
+            return;
+        }
+        redundant.clear();
+        for (const auto &pred : node->predecessors) {
+            const auto &pred_node = ir::get_annotation<NodeRef>(*pred.first);
+            for (const auto &via : node->predecessors) {
+                if (via.first == pred.first) {
+                    continue;
+                }
+                auto it = pred_node->successors.find(via.first);
+                if (it == pred_node->successors.end()) {
+                    continue;
+                }
+                if (it->second->weight + via.second->weight >= pred.second->weight) {
+                    redundant.push_back(pred.first);
+                    break;
+                }
+            }
+        }
+        for (const auto &pred : redundant) {
+            QL_DOUT(
+                "    prune edge from " << ir::describe(pred) <<
+                " to " << ir::describe(statement)
+            );
+            ir::get_annotation<NodeRef>(*pred)->successors.erase(statement);
+            node->predecessors.erase(pred);
+        }
+        num_edges -= redundant.size();
+        num_pruned += redundant.size();
+    }
+
     /**
      * Processes an incoming statement.
      */
     void process_statement(const ir::StatementRef &statement) {
         QL_DOUT("process statement: " << ir::describe(statement));
-        QL_DOUT("  currently " << commuting.size() << " commuting entries");
-        QL_DOUT("  currently " << non_commuting.size() << " non-commuting entries");
 
         // Make a node for the statement and add it.
         NodeRef node;
         node.emplace();
         node->order = order_accumulator++;
-        statement->set_annotation<NodeRef>(node);
+        ir::set_annotation<NodeRef>(*statement, node);
 
         // Gather the object access events for this statement.
         gatherer.reset();
@@ -469,7 +808,12 @@ private:
 
         // Process the events.
         for (const auto &event : gatherer.get()) {
-            process_event({event, node, statement});
+            process_event({event, node, statement, 0});
+        }
+
+        // The node now has all its incoming edges.
+        if (transitive_reduction) {
+            reduce_predecessors(node, statement);
         }
 
     }
@@ -483,21 +827,45 @@ public:
         const ir::Ref &ir,
         const ir::BlockBaseRef &block,
         utils::Bool commute_multi_qubit,
-        utils::Bool commute_single_qubit
+        utils::Bool commute_single_qubit,
+        utils::Bool transitive_reduction
     ) :
         ir(ir),
         block(block),
         gatherer(ir),
-        order_accumulator(0)
+        qubits(ir->platform->qubits.get_ptr().get()),
+        implicit_bit_type(nullptr),
+        sequence_counter(0),
+        order_accumulator(0),
+        transitive_reduction(transitive_reduction),
+        num_edges(0),
+        num_pruned(0)
     {
         gatherer.disable_multi_qubit_commutation = !commute_multi_qubit;
         gatherer.disable_single_qubit_commutation = !commute_single_qubit;
+
+        // Allocate the global lane, and the lanes for the qubits and their
+        // implicit bits.
+        add_lane();
+        auto num_qubits = ir::get_num_qubits(ir);
+        add_object(num_qubits);
+        if (!ir->platform->implicit_bit_type.empty()) {
+            implicit_bit_type = ir->platform->implicit_bit_type.get_ptr().get();
+            add_object(num_qubits);
+        }
+        for (auto &object : objects) {
+            for (utils::UInt index = 0; index < num_qubits; index++) {
+                get_element_lane(object, index);
+            }
+        }
+
     }
 
     /**
-     * Actually does the building.
+     * Actually does the building, returning the number of edges in the
+     * resulting graph.
      */
-    void build() {
+    utils::UInt build() {
 
         // Remove any existing DDG annotations.
         clear(block);
@@ -506,7 +874,7 @@ public:
         // Graph annotation.
         source.emplace();
         sink.emplace();
-        block->set_annotation<Graph>({source, sink, 1});
+        ir::set_annotation<Graph>(*block, {source, sink, 1});
 
         // Process the statements.
         process_statement(source);
@@ -515,6 +883,11 @@ public:
         }
         process_statement(sink);
 
+        QL_DOUT(
+            "built DDG with " << num_edges << " edge(s), pruned " <<
+            num_pruned << " redundant edge(s)"
+        );
+        return num_edges;
     }
 
 };
@@ -530,14 +903,24 @@ public:
  * such that the absolute value of the weight indicates the minimum number of
  * cycles that must be between the start cycle of the source and destination
  * node in the final schedule, and such that the sign indicates the direction
+ *
+ * If transitive_reduction is set, edges that are implied by a path of two
+ * other edges with at least the same weight are pruned while the graph is
+ * built. This does not change the set of valid schedules, but the causes of
+ * the pruned edges are not recorded. Returns the number of edges in the
+ * resulting graph.
  */
-void build(
+utils::UInt build(
     const ir::Ref &ir,
     const ir::BlockBaseRef &block,
     utils::Bool commute_multi_qubit,
-    utils::Bool commute_single_qubit
+    utils::Bool commute_single_qubit,
+    utils::Bool transitive_reduction
 ) {
-    Builder(ir, block, commute_multi_qubit, commute_single_qubit).build();
+    QL_TRACE_SCOPE("ddg.build");
+    return Builder(
+        ir, block, commute_multi_qubit, commute_single_qubit, transitive_reduction
+    ).build();
 }
 
 } // namespace ddg
@@ -0,0 +1,173 @@
+/** \file
+ * Defines a compact, contiguous representation of an existing data dependency
+ * graph.
+ */
+
+#include "ql/com/ddg/compact.h"
+
+#include <utility>
+#include "ql/com/ddg/ops.h"
+
+namespace ql {
+namespace com {
+namespace ddg {
+
+/**
+ * Builds the compact representation of the DDG currently attached to the
+ * given block. Throws an exception if no DDG is present.
+ */
+CompactGraph::CompactGraph(const ir::BlockBaseRef &block) {
+    direction = get_direction(block);
+    if (!direction) {
+        QL_ICE("no data dependency graph is present");
+    }
+
+    // Gather the statements in node index order.
+    utils::UInt num_nodes = block->statements.size() + 2;
+    statements.resize(num_nodes);
+    order.resize(num_nodes);
+    auto add_statement = [this, num_nodes](const ir::StatementRef &statement) {
+        auto node = get_node(statement);
+        QL_ASSERT(!node.empty());
+        auto index = get_index(statement);
+        QL_ASSERT(index < num_nodes);
+        QL_ASSERT(statements[index].empty());
+        statements[index] = statement;
+        order[index] = node->order;
+        return index;
+    };
+    source = add_statement(get_source(block));
+    for (const auto &statement : block->statements) {
+        add_statement(statement);
+    }
+    sink = add_statement(get_sink(block));
+
+    // Number the edges by iterating over the successors of each node, which
+    // immediately gives us the successor CSR arrays.
+    successor_offsets.reserve(num_nodes + 1);
+    cause_offsets.push_back(0);
+    for (utils::UInt index = 0; index < num_nodes; index++) {
+        successor_offsets.push_back(successor_edges.size());
+        for (const auto &successor_ep : get_node(statements[index])->successors) {
+            const auto &edge = successor_ep.second;
+            successor_edges.push_back(edge_weight.size());
+            edge_predecessor.push_back(index);
+            edge_successor.push_back(get_index(successor_ep.first));
+            edge_weight.push_back(edge->weight);
+            for (const auto &cause : edge->causes) {
+                causes.push_back(cause);
+            }
+            cause_offsets.push_back(causes.size());
+        }
+    }
+    successor_offsets.push_back(successor_edges.size());
+
+    // Build the predecessor CSR arrays using a counting sort of the edges by
+    // the node they target.
+    utils::UInt num_edges = edge_weight.size();
+    predecessor_offsets.assign(num_nodes + 1, 0);
+    for (auto target : edge_successor) {
+        predecessor_offsets[target + 1]++;
+    }
+    for (utils::UInt index = 0; index < num_nodes; index++) {
+        predecessor_offsets[index + 1] += predecessor_offsets[index];
+    }
+    auto fill = predecessor_offsets;
+    predecessor_edges.resize(num_edges);
+    for (utils::UInt edge = 0; edge < num_edges; edge++) {
+        predecessor_edges[fill[edge_successor[edge]]++] = edge;
+    }
+
+}
+
+/**
+ * Builds the compact representation of the DDG currently attached to the
+ * given block in the given direction (1 for forward, -1 for reversed),
+ * regardless of the direction of the DDG annotations, which are left
+ * untouched. Throws an exception if no DDG is present.
+ */
+CompactGraph::CompactGraph(const ir::BlockBaseRef &block, utils::Int direction) :
+    CompactGraph(block)
+{
+    QL_ASSERT(direction == 1 || direction == -1);
+    if (direction != this->direction) {
+        reverse();
+    }
+}
+
+/**
+ * Returns a copy of this graph in the opposite direction. This is the same as
+ * what com::ddg::reverse() followed by construction of a CompactGraph would
+ * return, except for the order of the edges within the lists of each node, but
+ * without modifying the DDG annotations.
+ */
+CompactGraph CompactGraph::reversed() const {
+    CompactGraph result = *this;
+    result.reverse();
+    return result;
+}
+
+/**
+ * Reverses the direction of this graph in place. The edge indices and thus
+ * the cause arrays remain valid; only the roles of the two CSR arrays and of
+ * the two endpoints of each edge are swapped, and the weights and order are
+ * negated, like com::ddg::reverse() does for the annotations.
+ */
+void CompactGraph::reverse() {
+    std::swap(source, sink);
+    direction = -direction;
+    for (auto &o : order) {
+        o = -o;
+    }
+    std::swap(successor_offsets, predecessor_offsets);
+    std::swap(successor_edges, predecessor_edges);
+    std::swap(edge_predecessor, edge_successor);
+    for (auto &weight : edge_weight) {
+        weight = -weight;
+    }
+}
+
+/**
+ * Returns the number of nodes in the graph, including the source and sink.
+ */
+utils::UInt CompactGraph::get_num_nodes() const {
+    return statements.size();
+}
+
+/**
+ * Returns the number of edges in the graph.
+ */
+utils::UInt CompactGraph::get_num_edges() const {
+    return edge_weight.size();
+}
+
+/**
+ * Returns the node index of the given statement.
+ */
+utils::UInt CompactGraph::get_index(const ir::StatementRef &statement) {
+    return utils::abs(get_node(statement)->order);
+}
+
+/**
+ * Returns the indices of the outgoing edges of the given node.
+ */
+CompactGraph::EdgeRange CompactGraph::get_successors(utils::UInt node) const {
+    return {
+        successor_edges.data() + successor_offsets[node],
+        successor_edges.data() + successor_offsets[node + 1]
+    };
+}
+
+/**
+ * Returns the indices of the incoming edges of the given node.
+ */
+CompactGraph::EdgeRange CompactGraph::get_predecessors(utils::UInt node) const {
+    return {
+        predecessor_edges.data() + predecessor_offsets[node],
+        predecessor_edges.data() + predecessor_offsets[node + 1]
+    };
+}
+
+} // namespace ddg
+} // namespace com
+} // namespace ql
@@ -50,12 +50,12 @@ void check_consistency(const ir::BlockBaseRef &block) {
     try {
 
         // Check the graph annotation.
-        auto graph = block->get_annotation_ptr<Graph>();
+        auto graph = ir::get_annotation_ptr<Graph>(*block);
         if (!graph) QL_ICE("missing Graph annotation on block");
         if (graph->source.empty()) QL_ICE("missing source statement");
-        if (!graph->source->has_annotation<NodeRef>()) QL_ICE("missing source node");
+        if (!ir::has_annotation<NodeRef>(*graph->source)) QL_ICE("missing source node");
         if (graph->sink.empty()) QL_ICE("missing source statement");
-        if (!graph->sink->has_annotation<NodeRef>()) QL_ICE("missing source node");
+        if (!ir::has_annotation<NodeRef>(*graph->sink)) QL_ICE("missing source node");
         if (graph->direction != 1 && graph->direction != -1) QL_ICE("invalid graph direction");
 
         // Sanity-check the source node.
@@ -0,0 +1,290 @@
+/** \file
+ * Defines functions for patching an existing data dependency graph after
+ * local edits to its block, without rebuilding it.
+ */
+
+#include "ql/com/ddg/incremental.h"
+
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/com/ddg/build.h"
+#include "ql/com/ddg/ops.h"
+
+namespace ql {
+namespace com {
+namespace ddg {
+
+/**
+ * Returns the statement at the given logical position of the given block,
+ * where position 0 is the source of the forward DDG, positions 1 through the
+ * number of statements are the statements of the block, and the position
+ * after that is the sink of the forward DDG. This equals the absolute value of
+ * the order of the corresponding node.
+ */
+static ir::StatementRef get_statement_at(
+    const ir::BlockBaseRef &block,
+    const Graph &graph,
+    utils::UInt position
+) {
+    auto num_statements = block->statements.size();
+    if (position == 0) {
+        return graph.direction > 0 ? graph.source : graph.sink;
+    } else if (position <= num_statements) {
+        return block->statements[position - 1];
+    } else {
+        QL_ASSERT(position == num_statements + 1);
+        return graph.direction > 0 ? graph.sink : graph.source;
+    }
+}
+
+/**
+ * Updates the order of the nodes at the given logical position of the given
+ * block and beyond.
+ */
+static void renumber(
+    const ir::BlockBaseRef &block,
+    const Graph &graph,
+    utils::UInt first_position
+) {
+    auto num_positions = block->statements.size() + 2;
+    for (auto position = first_position; position < num_positions; position++) {
+        auto statement = get_statement_at(block, graph, position);
+        ir::get_annotation<NodeRef>(*statement)->order = graph.direction * (utils::Int)position;
+    }
+}
+
+/**
+ * Adds an edge from the given predecessor to the given successor as stored in
+ * the DDG (so, in the reversed direction for a reversed DDG), or updates the
+ * existing edge. weight must have the sign that corresponds to the direction
+ * of the DDG; the absolute value of the weight of an existing edge is only
+ * ever increased.
+ */
+static void add_stored_edge(
+    const ir::StatementRef &predecessor,
+    const ir::StatementRef &successor,
+    utils::Int weight,
+    const utils::List<Cause> &causes
+) {
+    QL_ASSERT(predecessor != successor);
+    auto &predecessor_node = ir::get_annotation<NodeRef>(*predecessor);
+    auto &successor_node = ir::get_annotation<NodeRef>(*successor);
+    auto result = predecessor_node->successors.insert({successor, {}});
+    auto &edge_ref = result.first->second;
+    if (result.second) {
+        QL_DOUT(
+            "    add edge from " << ir::describe(predecessor) <<
+            " to " << ir::describe(successor)
+        );
+        edge_ref.emplace();
+        edge_ref->predecessor = predecessor;
+        edge_ref->successor = successor;
+        edge_ref->weight = weight;
+        QL_ASSERT(successor_node->predecessors.insert({predecessor, edge_ref}).second);
+    } else if (utils::abs(weight) > utils::abs(edge_ref->weight)) {
+        edge_ref->weight = weight;
+    }
+    for (const auto &cause : causes) {
+        edge_ref->causes.push_back(cause);
+    }
+}
+
+/**
+ * Inserts the given statement into the given block at the given index (0 to
+ * insert in front of all statements, the number of statements to append), and
+ * adds a node and the necessary edges for it to the data dependency graph of
+ * the block, which must already exist. The graph may be in either direction.
+ * commute_multi_qubit and commute_single_qubit must be set the same way as
+ * they were for build().
+ *
+ * The dependencies of the new statement are found by scanning the block
+ * backward and forward from the insertion point, until each object accessed
+ * by the statement is written by an earlier/later statement (at the latest
+ * the source/sink). Thus, only the statements near the insertion point that
+ * touch the same objects are visited in the common case. The order of the
+ * nodes following the insertion point is updated accordingly. Edges between
+ * existing statements are not modified; an edge that would not be needed
+ * anymore now that the new statement orders its endpoints transitively is
+ * redundant, but harmless.
+ */
+void insert_statement(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::UInt index,
+    const ir::StatementRef &statement,
+    utils::Bool commute_multi_qubit,
+    utils::Bool commute_single_qubit
+) {
+    auto graph_ptr = ir::get_annotation_ptr<Graph>(*block);
+    if (!graph_ptr) {
+        QL_ICE("no data dependency graph is present");
+    }
+    const auto &graph = *graph_ptr;
+    QL_ASSERT(index <= block->statements.size());
+    QL_DOUT("insert statement " << ir::describe(statement) << " at index " << index);
+
+    // Gather the events for the new statement. Like build(), statements
+    // without events are upgraded to barriers.
+    EventGatherer gatherer(ir);
+    gatherer.disable_multi_qubit_commutation = !commute_multi_qubit;
+    gatherer.disable_single_qubit_commutation = !commute_single_qubit;
+    gatherer.add_statement(statement);
+    if (gatherer.get().empty()) {
+        gatherer.add_reference(ir::prim::OperandMode::BARRIER, {});
+    }
+    utils::Vec<Event> events;
+    for (const auto &event : gatherer.get()) {
+        events.emplace_back(event);
+    }
+
+    // Insert the statement and its node, and update the node order.
+    block->statements.add(statement, index);
+    NodeRef node;
+    node.emplace();
+    ir::set_annotation<NodeRef>(*statement, node);
+    auto position = index + 1;
+    renumber(block, graph, position);
+
+    // Scans in the given logical direction (-1 for earlier statements, 1 for
+    // later statements) for statements that the new statement depends on or
+    // that depend on it, and adds the corresponding edges.
+    auto scan = [&](utils::Int step) {
+        utils::Vec<utils::Bool> open(events.size(), true);
+        utils::UInt num_open = events.size();
+        auto other_position = position;
+        while (num_open) {
+            other_position += step;
+            auto other = get_statement_at(block, graph, other_position);
+
+            // Gather the events for the other statement.
+            gatherer.reset();
+            gatherer.add_statement(other);
+            if (gatherer.get().empty()) {
+                gatherer.add_reference(ir::prim::OperandMode::BARRIER, {});
+            }
+
+            // Find the causes for an edge between the statements, and close
+            // the events of the new statement that are shadowed by a write of
+            // the other statement: anything beyond that conflicting with the
+            // event also conflicts with this write, so the dependency is
+            // implied transitively.
+            utils::List<Cause> causes;
+            for (utils::UInt i = 0; i < events.size(); i++) {
+                if (!open[i]) continue;
+                for (const auto &other_event_pair : gatherer.get()) {
+                    Event other_event{other_event_pair};
+                    if (events[i].commutes_with(other_event)) continue;
+                    const auto &from = step < 0 ? other_event : events[i];
+                    const auto &to = step < 0 ? events[i] : other_event;
+                    causes.push_back({
+                        from.reference.intersect_with(to.reference),
+                        {from.mode, to.mode}
+                    });
+                    if (
+                        other_event.mode == AccessMode::write() &&
+                        events[i].is_shadowed_by(other_event)
+                    ) {
+                        open[i] = false;
+                        num_open--;
+                        break;
+                    }
+                }
+            }
+            if (causes.empty()) continue;
+
+            // Add the edge in the logical direction, and store it in the
+            // direction of the DDG.
+            const auto &from = step < 0 ? other : statement;
+            const auto &to = step < 0 ? statement : other;
+            auto weight = (utils::Int)ir::get_duration_of_statement(from);
+            if (graph.direction > 0) {
+                add_stored_edge(from, to, weight, causes);
+            } else {
+                add_stored_edge(to, from, -weight, causes);
+            }
+
+        }
+    };
+    scan(-1);
+    scan(1);
+
+}
+
+/**
+ * Removes the given statement from the given block, along with its node in the
+ * data dependency graph, which must already exist. The graph may be in either
+ * direction. To preserve the ordering of the remaining statements, an edge is
+ * added from every predecessor to every successor of the removed node, using
+ * the weight and causes of the incoming edge. This is conservative: the
+ * resulting graph may be more constrained than the graph build() would
+ * construct for the modified block, so use build() instead if that matters.
+ */
+void remove_statement(
+    const ir::BlockBaseRef &block,
+    const ir::StatementRef &statement
+) {
+    auto graph_ptr = ir::get_annotation_ptr<Graph>(*block);
+    if (!graph_ptr) {
+        QL_ICE("no data dependency graph is present");
+    }
+    const auto &graph = *graph_ptr;
+    QL_DOUT("remove statement " << ir::describe(statement));
+
+    // Find the statement in the block.
+    auto node = ir::get_annotation<NodeRef>(*statement);
+    auto position = (utils::UInt)utils::abs(node->order);
+    QL_ASSERT(position >= 1 && position <= block->statements.size());
+    QL_ASSERT(block->statements[position - 1] == statement);
+
+    // Bypass the node, and remove its edges from its neighbors.
+    for (const auto &predecessor_ep : node->predecessors) {
+        for (const auto &successor_ep : node->successors) {
+            add_stored_edge(
+                predecessor_ep.first,
+                successor_ep.first,
+                predecessor_ep.second->weight,
+                predecessor_ep.second->causes
+            );
+        }
+    }
+    for (const auto &predecessor_ep : node->predecessors) {
+        ir::get_annotation<NodeRef>(*predecessor_ep.first)->successors.erase(statement);
+    }
+    for (const auto &successor_ep : node->successors) {
+        ir::get_annotation<NodeRef>(*successor_ep.first)->predecessors.erase(statement);
+    }
+
+    // Remove the statement and its node, and update the node order.
+    ir::erase_annotation<NodeRef>(*statement);
+    block->statements.remove(position - 1);
+    renumber(block, graph, position);
+
+}
+
+/**
+ * Ensures that the given statement is scheduled at least the given number of
+ * cycles after the start of the block by adding (or strengthening) a
+ * dependency on the source of the forward data dependency graph, which must
+ * already exist. The graph may be in either direction. This is used to
+ * express dependencies on statements outside of the block.
+ */
+void constrain_start(
+    const ir::BlockBaseRef &block,
+    const ir::StatementRef &statement,
+    utils::UInt min_cycle
+) {
+    auto graph_ptr = ir::get_annotation_ptr<Graph>(*block);
+    if (!graph_ptr) {
+        QL_ICE("no data dependency graph is present");
+    }
+    const auto &graph = *graph_ptr;
+    if (graph.direction > 0) {
+        add_stored_edge(graph.source, statement, min_cycle, {});
+    } else {
+        add_stored_edge(statement, graph.sink, -(utils::Int)min_cycle, {});
+    }
+}
+
+} // namespace ddg
+} // namespace com
+} // namespace ql
@@ -15,7 +15,7 @@ NodeCRef get_node(const ir::StatementRef &statement) {
     if (statement.empty()) {
         return {};
     }
-    if (auto node = statement->get_annotation_ptr<NodeRef>()) {
+    if (auto node = ir::get_annotation_ptr<NodeRef>(*statement)) {
         return node->as_const();
     } else {
         return {};
@@ -26,7 +26,7 @@ NodeCRef get_node(const ir::StatementRef &statement) {
  * Returns the source statement associated with the given block, if any.
  */
 utils::One<ir::SentinelStatement> get_source(const ir::BlockBaseRef &block) {
-    if (auto data = block->get_annotation_ptr<Graph>()) {
+    if (auto data = ir::get_annotation_ptr<Graph>(*block)) {
         return data->source;
     } else {
         return {};
@@ -44,7 +44,7 @@ NodeCRef get_source_node(const ir::BlockBaseRef &block) {
  * Returns the sink statement associated with the given block, if any.
  */
 utils::One<ir::SentinelStatement> get_sink(const ir::BlockBaseRef &block) {
-    if (auto data = block->get_annotation_ptr<Graph>()) {
+    if (auto data = ir::get_annotation_ptr<Graph>(*block)) {
         return data->sink;
     } else {
         return {};
@@ -77,7 +77,7 @@ EdgeCRef get_edge(const ir::StatementRef &from, const ir::StatementRef &to) {
  * Returns the effective scheduling direction when scheduling using this DDG.
  */
 utils::Int get_direction(const ir::BlockBaseRef &block) {
-    if (auto data = block->get_annotation_ptr<Graph>()) {
+    if (auto data = ir::get_annotation_ptr<Graph>(*block)) {
         return data->direction;
     } else {
         return 0;
@@ -88,9 +88,9 @@ utils::Int get_direction(const ir::BlockBaseRef &block) {
  * Removes the data dependency graph annotations from the given block.
  */
 void clear(const ir::BlockBaseRef &block) {
-    block->erase_annotation<Graph>();
+    ir::erase_annotation<Graph>(*block);
     for (const auto &statement : block->statements) {
-        statement->erase_annotation<NodeRef>();
+        ir::erase_annotation<NodeRef>(*statement);
     }
 }
 
@@ -99,7 +99,7 @@ void clear(const ir::BlockBaseRef &block) {
  * the given statement.
  */
 static void reverse_statement(const ir::StatementRef &statement) {
-    auto node = statement->get_annotation<NodeRef>();
+    auto node = ir::get_annotation<NodeRef>(*statement);
     std::swap(node->successors, node->predecessors);
     node->order = -node->order;
     for (const auto &it : node->successors) {
@@ -124,7 +124,7 @@ static void reverse_statement(const ir::StatementRef &statement) {
  * dependencies are reversed.
  */
 void reverse(const ir::BlockBaseRef &block) {
-    auto &graph = block->get_annotation<Graph>();
+    auto &graph = ir::get_annotation<Graph>(*block);
     std::swap(graph.source, graph.sink);
     graph.direction = -graph.direction;
     reverse_statement(graph.source);
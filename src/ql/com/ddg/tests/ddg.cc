@@ -1,9 +1,13 @@
+#include <algorithm>
+
 #include "ql/ir/compat/compat.h"
 #include "ql/ir/old_to_new.h"
 #include "ql/com/ddg/build.h"
 #include "ql/com/ddg/ops.h"
 #include "ql/com/ddg/consistency.h"
 #include "ql/com/ddg/dot.h"
+#include "ql/com/ddg/compact.h"
+#include "ql/com/ddg/incremental.h"
 
 using namespace ql;
 
@@ -35,5 +39,122 @@ int main() {
     com::ddg::check_consistency(ir->program->blocks[0]);
     com::ddg::dump_dot(ir->program->blocks[0]);
 
+    com::ddg::CompactGraph graph(ir->program->blocks[0]);
+    QL_ASSERT(graph.get_num_nodes() == ir->program->blocks[0]->statements.size() + 2);
+    QL_ASSERT(graph.direction == -1);
+    QL_ASSERT(graph.source == graph.get_num_nodes() - 1);
+    QL_ASSERT(graph.sink == 0);
+    QL_ASSERT(graph.get_predecessors(graph.source).size() == 0);
+    QL_ASSERT(graph.get_successors(graph.sink).size() == 0);
+    for (utils::UInt node = 0; node < graph.get_num_nodes(); node++) {
+        const auto &ddg_node = com::ddg::get_node(graph.statements[node]);
+        QL_ASSERT(graph.order[node] == ddg_node->order);
+        QL_ASSERT(graph.get_successors(node).size() == ddg_node->successors.size());
+        QL_ASSERT(graph.get_predecessors(node).size() == ddg_node->predecessors.size());
+        for (auto edge : graph.get_successors(node)) {
+            QL_ASSERT(graph.edge_predecessor[edge] == node);
+            auto ddg_edge = com::ddg::get_edge(
+                graph.statements[node],
+                graph.statements[graph.edge_successor[edge]]
+            );
+            QL_ASSERT(!ddg_edge.empty());
+            QL_ASSERT(graph.edge_weight[edge] == ddg_edge->weight);
+            QL_ASSERT(graph.cause_offsets[edge + 1] - graph.cause_offsets[edge] == ddg_edge->causes.size());
+        }
+    }
+
+    // A compact graph can be built in either direction without reversing the
+    // annotations, and then matches the graph built from reversed annotations
+    // up to the order of the edges of each node.
+    com::ddg::CompactGraph forward(ir->program->blocks[0], 1);
+    QL_ASSERT(com::ddg::get_direction(ir->program->blocks[0]) == -1);
+    QL_ASSERT(forward.direction == 1);
+    QL_ASSERT(forward.source == 0);
+    auto backward = forward.reversed();
+    QL_ASSERT(backward.direction == graph.direction);
+    QL_ASSERT(backward.source == graph.source);
+    QL_ASSERT(backward.sink == graph.sink);
+    QL_ASSERT(backward.order == graph.order);
+    QL_ASSERT(backward.get_num_edges() == graph.get_num_edges());
+    for (utils::UInt node = 0; node < graph.get_num_nodes(); node++) {
+        auto endpoints = [node](const com::ddg::CompactGraph &g) {
+            utils::Vec<utils::Pair<utils::UInt, utils::Int>> result;
+            for (auto edge : g.get_successors(node)) {
+                QL_ASSERT(g.edge_predecessor[edge] == node);
+                result.push_back({g.edge_successor[edge], g.edge_weight[edge]});
+            }
+            std::sort(result.begin(), result.end());
+            return result;
+        };
+        QL_ASSERT(endpoints(backward) == endpoints(graph));
+        QL_ASSERT(backward.get_predecessors(node).size() == graph.get_predecessors(node).size());
+    }
+
+    // Remove a statement and insert it again elsewhere, patching the reversed
+    // DDG without rebuilding it.
+    auto block = ir->program->blocks[0];
+    auto statement = block->statements[3];
+    com::ddg::remove_statement(block, statement);
+    com::ddg::check_consistency(block);
+    QL_ASSERT(com::ddg::CompactGraph(block).get_num_nodes() == block->statements.size() + 2);
+    com::ddg::insert_statement(ir, block, 0, statement);
+    com::ddg::check_consistency(block);
+    QL_ASSERT(block->statements[0] == statement);
+    QL_ASSERT(com::ddg::get_node(statement)->order == -1);
+    QL_ASSERT(!com::ddg::get_edge(statement, com::ddg::get_sink(block)).empty());
+    com::ddg::dump_dot(block);
+
+    // Statements on distinct qubits must not depend on each other, while a
+    // two-qubit gate depends on the preceding gates on both of its qubits.
+    auto wide_program = utils::make<ir::compat::Program>("wide_prog", plat, 7, 32, 10);
+    auto wide_kernel = utils::make<ir::compat::Kernel>("wide_kernel", plat, 7, 32, 10);
+    wide_kernel->x(0);
+    wide_kernel->x(1);
+    wide_kernel->measure(2);
+    wide_kernel->cz(0, 1);
+    wide_program->add(wide_kernel);
+    auto wide_ir = ir::convert_old_to_new(wide_program);
+    auto wide_block = wide_ir->program->blocks[0];
+    com::ddg::build(wide_ir, wide_block);
+    com::ddg::check_consistency(wide_block);
+    const auto &wide = wide_block->statements;
+    QL_ASSERT(com::ddg::get_edge(wide[0], wide[1]).empty());
+    QL_ASSERT(com::ddg::get_edge(wide[0], wide[2]).empty());
+    QL_ASSERT(com::ddg::get_edge(wide[1], wide[2]).empty());
+    QL_ASSERT(!com::ddg::get_edge(wide[0], wide[3]).empty());
+    QL_ASSERT(!com::ddg::get_edge(wide[1], wide[3]).empty());
+    QL_ASSERT(com::ddg::get_edge(wide[2], wide[3]).empty());
+
+    // With transitive reduction, the edge between two two-qubit gates is
+    // pruned when it's implied by a gate on one of the qubits between them.
+    // Commutation is disabled so the two CZs depend on each other directly.
+    auto chain_program = utils::make<ir::compat::Program>("chain_prog", plat, 7, 32, 10);
+    auto chain_kernel = utils::make<ir::compat::Kernel>("chain_kernel", plat, 7, 32, 10);
+    chain_kernel->cz(0, 1);
+    chain_kernel->x(1);
+    chain_kernel->cz(0, 1);
+    chain_program->add(chain_kernel);
+    auto chain_ir = ir::convert_old_to_new(chain_program);
+    auto chain_block = chain_ir->program->blocks[0];
+    const auto &chain = chain_block->statements;
+    auto num_full_edges = com::ddg::build(chain_ir, chain_block, false, false);
+    QL_ASSERT(!com::ddg::get_edge(chain[0], chain[2]).empty());
+    auto num_reduced_edges = com::ddg::build(chain_ir, chain_block, false, false, true);
+    com::ddg::check_consistency(chain_block);
+    QL_ASSERT_EQ(num_reduced_edges, num_full_edges - 1);
+    QL_ASSERT(com::ddg::get_edge(chain[0], chain[2]).empty());
+    QL_ASSERT(!com::ddg::get_edge(chain[0], chain[1]).empty());
+    QL_ASSERT(!com::ddg::get_edge(chain[1], chain[2]).empty());
+
+    // DDG annotations live in the fixed annotation slots of the nodes rather
+    // than in the generic annotation map, and are cleared along with the DDG.
+    QL_ASSERT(ir::has_annotation<com::ddg::NodeRef>(*wide[0]));
+    QL_ASSERT(!wide[0]->has_annotation<com::ddg::NodeRef>());
+    QL_ASSERT(ir::has_annotation<com::ddg::Graph>(*wide_block));
+    QL_ASSERT(!wide_block->has_annotation<com::ddg::Graph>());
+    com::ddg::clear(wide_block);
+    QL_ASSERT(!ir::has_annotation<com::ddg::NodeRef>(*wide[0]));
+    QL_ASSERT(!ir::has_annotation<com::ddg::Graph>(*wide_block));
+
     return 0;
 }
@@ -138,7 +138,7 @@ utils::Bool Reference::is_provably_distinct_from(const Reference &reference) con
     // that object. You can do all sorts of fancy aliasing stuff here, but for
     // now we'll only worry about static indices for as far as they are known.
     // If they differ, the targets are distinct.
-    utils::UInt known_dims = utils::max(indices.size(), reference.indices.size());
+    utils::UInt known_dims = utils::min(indices.size(), reference.indices.size());
     for (utils::UInt dim = 0; dim < known_dims; dim++) {
         if (indices[dim] != reference.indices[dim]) {
             return true;
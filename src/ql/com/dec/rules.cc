@@ -13,26 +13,81 @@ namespace com {
 namespace dec {
 
 /**
- * Class for implementing map operations on expressions or references. While not
- * an abstract class, this must be subclassed to be useful; either or both of
- * on_expression() and on_reference() must be overridden with the desired map
- * operation.
+ * Preprocesses the given decomposition rule.
  */
-class DecompositionRuleExpressionMapper : public map::ExpressionMapper {
+CompiledDecompositionRule::CompiledDecompositionRule(
+    const ir::InstructionDecomposition &rule
+) : rule(&rule) {
+    for (utils::UInt i = 0; i < rule.parameters.size(); i++) {
+        parameter_index.insert({rule.parameters[i].get_ptr().get(), i});
+    }
+    for (utils::UInt i = 0; i < rule.objects.size(); i++) {
+        object_index.insert({rule.objects[i].get_ptr().get(), i});
+    }
+}
+
+/**
+ * Constructs a table for the rules that match the given predicate.
+ */
+DecompositionRuleTable::DecompositionRuleTable(
+    const RulePredicate &predicate
+) : predicate(predicate) {
+}
+
+/**
+ * Returns the rule that should be applied to instructions of the given
+ * type, or nullptr if there is none.
+ */
+const CompiledDecompositionRule *DecompositionRuleTable::find(
+    const ir::InstructionType &instruction_type
+) {
+    auto it = rules.find(&instruction_type);
+    if (it != rules.end()) {
+        return it->second;
+    }
+    const CompiledDecompositionRule *result = nullptr;
+    for (const auto &rule : instruction_type.decompositions) {
+        if (predicate(rule)) {
+            compiled.emplace_back(*rule);
+            result = &compiled.back();
+            break;
+        }
+    }
+    rules.insert({&instruction_type, result});
+    return result;
+}
+
+/**
+ * Expression mapper for expanding a compiled decomposition rule for a
+ * particular instruction: references to the parameters of the rule are
+ * replaced with (clones of) the corresponding operands of the instruction,
+ * and references to the temporary objects of the rule are replaced with
+ * references to newly created temporaries.
+ */
+class DecompositionRuleExpressionMapper final
+    : public map::StaticExpressionMapper<DecompositionRuleExpressionMapper>
+{
 public:
 
     /**
-     * Map of variable references that need to be updated.
+     * The rule being expanded.
      */
-    utils::Map<ir::ObjectLink, ir::ObjectLink> variable_map;
+    const CompiledDecompositionRule &rule;
 
     /**
-     * Map of operand references/parameters that need to be updated.
+     * The operands of the instruction being expanded, by parameter index.
      */
-    utils::Map<ir::ObjectLink, ir::ExpressionRef> operand_map;
+    const utils::Any<ir::Expression> &operands;
+
+    /**
+     * The temporaries that replace the objects of the rule, by object index.
+     */
+    utils::Vec<ir::ObjectLink> temporaries;
 
 protected:
 
+    friend class map::StaticExpressionMapper<DecompositionRuleExpressionMapper>;
+
     /**
      * Called when an expression of any kind is encountered in the tree. The
      * subtree formed by the expression will already have been processed (i.e.
@@ -42,26 +97,28 @@ protected:
      * formed by the new expression will be processed as well. The default
      * implementation calls on_reference() if the expression is a reference.
      */
-    utils::Bool on_expression(utils::Maybe<ir::Expression> &expr) override {
+    utils::Bool on_expression(utils::Maybe<ir::Expression> &expr) {
 
         // We only have to worry about replacing references with things.
         auto ref = expr->as_reference();
         if (!ref) {
             return false;
         }
+        auto target = ref->target.get_ptr().get();
 
         // Handle variables.
-        auto it1 = variable_map.find(ref->target);
-        if (it1 != variable_map.end()) {
-            QL_ASSERT(ref->target->data_type == it1->second->data_type);
-            ref->target = it1->second;
+        auto it1 = rule.object_index.find(target);
+        if (it1 != rule.object_index.end()) {
+            const auto &temporary = temporaries[it1->second];
+            QL_ASSERT(ref->target->data_type == temporary->data_type);
+            ref->target = temporary;
             return true;
         }
 
         // Handle parameters.
-        auto it2 = operand_map.find(ref->target);
-        if (it2 != operand_map.end()) {
-            expr = it2->second.clone();
+        auto it2 = rule.parameter_index.find(target);
+        if (it2 != rule.parameter_index.end()) {
+            expr = operands[it2->second].clone();
             return true;
         }
 
@@ -73,7 +130,7 @@ protected:
      * reference of some kind. The default implementation is no-op and just
      * returns false.
      */
-    utils::Bool on_reference(utils::Maybe<ir::Reference> &ref) override {
+    utils::Bool on_reference(utils::Maybe<ir::Reference> &ref) {
         utils::Maybe<ir::Expression> expr = ref;
         if (on_expression(expr)) {
             auto ref2 = expr.as<ir::Reference>();
@@ -93,9 +150,19 @@ protected:
 public:
 
     /**
-     * Default constructor.
+     * Constructs a mapper for expanding the given rule for an instruction
+     * with the given operands, making temporaries for the objects of the rule.
      */
-    DecompositionRuleExpressionMapper() = default;
+    DecompositionRuleExpressionMapper(
+        const ir::Ref &ir,
+        const CompiledDecompositionRule &rule,
+        const utils::Any<ir::Expression> &operands
+    ) : rule(rule), operands(operands) {
+        QL_ASSERT(rule.rule->parameters.size() == operands.size());
+        for (const auto &var : rule.rule->objects) {
+            temporaries.push_back(make_temporary(ir, var->data_type, var->shape));
+        }
+    }
 
 };
 
@@ -116,73 +183,86 @@ utils::UInt apply_decomposition_rules(
     utils::Bool ignore_schedule,
     const RulePredicate &predicate
 ) {
+    DecompositionRuleTable table{predicate};
+    return apply_decomposition_rules(ir, block, ignore_schedule, table);
+}
+
+/**
+ * Returns the rule that should be applied to the given statement, or nullptr
+ * if there is none.
+ */
+static const CompiledDecompositionRule *find_rule(
+    DecompositionRuleTable &table,
+    const ir::StatementRef &stmt
+) {
+    if (auto insn = stmt->as_custom_instruction()) {
+        return table.find(*insn->instruction_type);
+    }
+    return nullptr;
+}
+
+/**
+ * Same as above, but takes the rules to apply from the given table, such that
+ * it can be reused for multiple blocks.
+ */
+utils::UInt apply_decomposition_rules(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::Bool ignore_schedule,
+    DecompositionRuleTable &table
+) {
+
+    // Most blocks don't need any decomposition at all, in which case we
+    // don't have to touch the block.
+    auto &statements = block->statements.get_vec();
+    utils::UInt first = 0;
+    while (first < statements.size() && !find_rule(table, statements[first])) {
+        first++;
+    }
+    if (first == statements.size()) {
+        return 0;
+    }
 
-    // Make a list of the statements we haven't processed yet, and clear the
-    // block. We'll add the statements back to the block as we process them.
+    // Make a list of the statements we haven't processed yet, and remove them
+    // from the block. We'll add the statements back to the block as we
+    // process them. The statements before the first one that needs to be
+    // expanded can stay where they are.
     utils::List<ir::StatementRef> remaining;
-    for (const auto &statement : block->statements) {
-        remaining.push_back(statement);
+    for (auto i = first; i < statements.size(); i++) {
+        remaining.push_back(statements[i]);
     }
-    block->statements.reset();
+    statements.erase(statements.begin() + first, statements.end());
 
     // Process the statements.
     utils::UInt number_of_applications = 0;
     while (!remaining.empty()) {
         auto stmt = remaining.front();
         remaining.pop_front();
-        utils::Bool rule_applied = false;
-        if (auto insn = stmt->as_custom_instruction()) {
-            for (const auto &rule : insn->instruction_type->decompositions) {
-
-                // Ignore decomposition rules that don't match the predicate.
-                if (!predicate(rule)) {
-                    continue;
-                }
-
-                // Expression mapper for updating variable and parameter
-                // references in the expansion.
-                DecompositionRuleExpressionMapper mapper;
-
-                // Add any variables declared in the decomposition rule as
-                // temporary objects, and remember that we have to remap them.
-                for (const auto &var : rule->objects) {
-                    mapper.variable_map.insert({
-                        var,
-                        make_temporary(ir, var->data_type, var->shape)
-                    });
-                }
-
-                // Figure out how to map the operand placeholders.
-                QL_ASSERT(rule->parameters.size() == insn->operands.size());
-                for (utils::UInt i = 0; i < rule->parameters.size(); i++) {
-                    mapper.operand_map.insert({
-                        rule->parameters[i],
-                        insn->operands[i]
-                    });
-                }
-
-                // Perform the expansion.
-                auto it = remaining.begin();
-                for (const auto &orig_exp_stmt : rule->expansion) {
-                    auto exp_stmt = orig_exp_stmt.clone();
-                    mapper.process_statement(exp_stmt);
-                    if (ignore_schedule) {
-                        exp_stmt->cycle = stmt->cycle;
-                    } else {
-                        exp_stmt->cycle += stmt->cycle;
-                    }
-                    it = remaining.insert(it, exp_stmt);
-                }
-
-                rule_applied = true;
-                break;
-            }
-        }
-        if (rule_applied) {
-            number_of_applications++;
-        } else {
+        auto rule = find_rule(table, stmt);
+        if (!rule) {
             block->statements.add(stmt);
+            continue;
+        }
+
+        // Expression mapper for updating variable and parameter references in
+        // the expansion. This also adds any variables declared in the
+        // decomposition rule as temporary objects.
+        auto insn = stmt->as_custom_instruction();
+        DecompositionRuleExpressionMapper mapper{ir, *rule, insn->operands};
+
+        // Perform the expansion.
+        auto it = remaining.begin();
+        for (const auto &orig_exp_stmt : rule->rule->expansion) {
+            auto exp_stmt = orig_exp_stmt.clone();
+            mapper.process_statement(exp_stmt);
+            if (ignore_schedule) {
+                exp_stmt->cycle = stmt->cycle;
+            } else {
+                exp_stmt->cycle += stmt->cycle;
+            }
+            it = remaining.insert(it, exp_stmt);
         }
+        number_of_applications++;
     }
 
     // Make sure that the statements are ordered by cycle. This is only
@@ -82,6 +82,12 @@ private:
      */
     utils::Int previous_cycle = 0;
 
+    /**
+     * Whether the program has been changed in any way thus far, i.e. whether
+     * any block needed to be restructured, renamed, or relinked.
+     */
+    utils::Bool changed = false;
+
     /**
      * Class that adds a suffix to name_stack while it's in scope using RAII.
      */
@@ -154,6 +160,14 @@ private:
      */
     void process_block(const ir::BlockRef &block);
 
+    /**
+     * Fast path for process_block() for blocks that are already in basic
+     * block form, which moves a shallow copy of the block to the blocks list
+     * instead of processing the statements one by one. Returns false without
+     * doing anything if the block cannot be handled this way.
+     */
+    utils::Bool process_basic_block(const ir::BlockRef &block);
+
     /**
      * For the given block reference, which may be a reference to a block in the
      * original IR or in the new blocks list, convert to the appropriate block
@@ -278,6 +292,7 @@ ir::BlockRef StructureDecomposer::new_block(utils::Bool also_add) {
     // Link the previous block to it by default.
     if (!blocks.empty() && blocks.back()->next.empty()) {
         blocks.back()->next = new_block;
+        changed = true;
     }
 
     // Cycle numbers need to restart from zero, but we might still be taking
@@ -571,6 +586,12 @@ void StructureDecomposer::process_block_base(const ir::BlockBaseRef &block) {
  */
 void StructureDecomposer::process_block(const ir::BlockRef &block) {
 
+    // Blocks without structured control flow can be taken over as they are.
+    if (process_basic_block(block)) {
+        return;
+    }
+    changed = true;
+
     // Handle naming of the blocks.
     QL_ASSERT(name_stack.empty());
     name_stack.push_back(block->name);
@@ -606,6 +627,39 @@ void StructureDecomposer::process_block(const ir::BlockRef &block) {
 
 }
 
+/**
+ * Fast path for process_block() for blocks that are already in basic block
+ * form, which moves a shallow copy of the block to the blocks list instead of
+ * processing the statements one by one. Returns false without doing anything
+ * if the block cannot be handled this way.
+ */
+utils::Bool StructureDecomposer::process_basic_block(const ir::BlockRef &block) {
+
+    // The block must not need any restructuring or renaming.
+    if (!is_in_basic_block_form(block) || used_names.count(block->name)) {
+        return false;
+    }
+    used_names.insert(block->name);
+
+    // Link the previous block to it if it doesn't link to anything yet, just
+    // like new_block() would.
+    auto start = block.copy();
+    if (!blocks.empty() && blocks.back()->next.empty()) {
+        blocks.back()->next = start;
+        changed = true;
+    }
+    blocks.push_back(start);
+    remap.insert({block, start});
+    if (ir->program->entry_point.links_to(block)) {
+        entry_point = start;
+    }
+    if (!block->statements.empty()) {
+        previous_cycle = block->statements.back()->cycle;
+    }
+
+    return true;
+}
+
 /**
  * For the given block reference, which may be a reference to a block in the
  * original IR or in the new blocks list, convert to the appropriate block
@@ -646,6 +700,12 @@ ir::ProgramRef StructureDecomposer::process_program(const ir::Ref &incoming_ir)
         process_block(block);
     }
 
+    // If all blocks were already in basic block form, the program can be
+    // used as it is.
+    if (!changed) {
+        return ir->program;
+    }
+
     // Point all the goto and next block targets to the new blocks list.
     for (const auto &block : blocks) {
         block->next = update_block_reference(block->next.as_mut());
@@ -686,20 +746,28 @@ ir::ProgramRef StructureDecomposer::run(const ir::Ref &ir) {
  * The ir tree is not modified. Instead, a new program node is returned. This
  * node is such that the original program node in ir can be replaced with it.
  * Note that nodes/subtrees may be shared between the structured and basic block
- * representations of the programs.
+ * representations of the programs. Blocks that are already in basic block form
+ * are taken over without processing their statements, and if the program as a
+ * whole is already in basic block form, the original program node is returned.
  *
  * If check is set, a consistency and basic-block form check is done before
- * returning the created program. This is also done if debugging is enabled via
- * the loglevel.
+ * returning the created program, unless the original program was returned.
+ * The check is always done if debugging is enabled via the loglevel. The
+ * thoroughness of the consistency check is controlled by the
+ * `ir_consistency_check` global option.
  */
 ir::ProgramRef decompose_structure(const ir::Ref &ir, utils::Bool check) {
     auto program = StructureDecomposer::run(ir);
 
     // If we're in debug mode, check postconditions.
-    if (QL_IS_LOG_DEBUG || check) {
+    if (QL_IS_LOG_DEBUG || (check && program.get_ptr() != ir->program.get_ptr())) {
         auto new_ir = ir.copy();
         new_ir->program = program;
-        ir::check_consistency(new_ir);
+        ir::check_consistency(
+            new_ir,
+            ir::get_consistency_check_level(),
+            ir::ChangedParts::PROGRAM
+        );
         check_basic_block_form(program);
     };
 
@@ -707,30 +775,49 @@ ir::ProgramRef decompose_structure(const ir::Ref &ir, utils::Bool check) {
 }
 
 /**
- * Checks whether the given program is in basic block form, as defined by
+ * Checks whether the given block is in basic block form, as defined by
  * decompose_structure(). If yes, an empty string is returned. Otherwise a
  * string with an appropriate message is returned.
  */
+static utils::Str check_basic_block_form_str(const ir::BlockRef &block) {
+    for (utils::UInt i = 0; i < block->statements.size(); i++) {
+        const auto &stmt = block->statements[i];
+        if (!stmt->as_instruction()) {
+            return
+                "in block " + block->name + ": "
+                "found non-instruction: " + ir::describe(stmt);
+        }
+        if (stmt->as_goto_instruction() && i < block->statements.size() - 1) {
+            return
+                "in block " + block->name + ": "
+                "found goto statement not at the end of the block: " +
+                ir::describe(stmt);
+        }
+    }
+    return {};
+}
+
+/**
+ * Same as above, but for all blocks of the given program.
+ */
 static utils::Str check_basic_block_form_str(const ir::ProgramRef &program) {
     for (const auto &block : program->blocks) {
-        for (utils::UInt i = 0; i < block->statements.size(); i++) {
-            const auto &stmt = block->statements[i];
-            if (!stmt->as_instruction()) {
-                return
-                    "in block " + block->name + ": "
-                    "found non-instruction: " + ir::describe(stmt);
-            }
-            if (stmt->as_goto_instruction() && i < block->statements.size() - 1) {
-                return
-                    "in block " + block->name + ": "
-                    "found goto statement not at the end of the block: " +
-                    ir::describe(stmt);
-            }
+        auto s = check_basic_block_form_str(block);
+        if (!s.empty()) {
+            return s;
         }
     }
     return {};
 }
 
+/**
+ * Returns whether the given block is in basic block form, as defined by
+ * decompose_structure(). Assumes that the block is otherwise consistent.
+ */
+utils::Bool is_in_basic_block_form(const ir::BlockRef &block) {
+    return check_basic_block_form_str(block).empty();
+}
+
 /**
  * Returns whether the given program is in basic block form, as defined by
  * decompose_structure(). Assumes that the program is otherwise consistent.
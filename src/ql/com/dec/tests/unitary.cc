@@ -0,0 +1,123 @@
+#include <cmath>
+#include <iostream>
+
+#include "ql/utils/str.h"
+#include "ql/com/options.h"
+#include "ql/com/dec/unitary.h"
+
+using namespace ql;
+
+/**
+ * Decomposes the given matrix and returns the resulting gates in string form.
+ */
+static utils::Str decompose(
+    const utils::Vec<utils::Complex> &matrix,
+    const utils::Vec<utils::UInt> &qubits = {0, 1}
+) {
+    com::dec::Unitary u{"u", matrix};
+    utils::StrStrm ss;
+    for (const auto &gate : u.get_decomposition(qubits)) {
+        ss << gate->qasm() << "\n";
+    }
+    return ss.str();
+}
+
+int main() {
+    if (!com::dec::Unitary::is_decompose_support_enabled()) {
+        return 0;
+    }
+
+    // A two-qubit unitary, and the same unitary with a different global
+    // phase.
+    utils::Complex i{0.0, 1.0};
+    utils::Vec<utils::Complex> matrix = {
+        0.5, 0.5, 0.5, 0.5,
+        0.5, 0.5 * i, -0.5, -0.5 * i,
+        0.5, -0.5, 0.5, -0.5,
+        0.5, -0.5 * i, -0.5, 0.5 * i
+    };
+    utils::Vec<utils::Complex> rotated;
+    for (const auto &element : matrix) {
+        rotated.push_back(element * std::polar(1.0, 0.3));
+    }
+
+    // Without the cache, the decomposition is computed each time.
+    com::options::set("unitary_cache", "no");
+    auto uncached = decompose(matrix);
+    QL_ASSERT(!uncached.empty());
+
+    // With the cache, repeated and phase-equivalent unitaries reuse the
+    // first decomposition.
+    com::options::set("unitary_cache", "yes");
+    QL_ASSERT(decompose(matrix) == uncached);
+    QL_ASSERT(decompose(matrix) == uncached);
+    QL_ASSERT(decompose(rotated) == uncached);
+
+    // Decomposing the sub-unitaries of a five-qubit QFT concurrently must
+    // give the same result as decomposing them sequentially.
+    com::options::set("unitary_cache", "no");
+    utils::UInt dim = 32;
+    utils::Vec<utils::Complex> qft;
+    for (utils::UInt row = 0; row < dim; row++) {
+        for (utils::UInt col = 0; col < dim; col++) {
+            qft.push_back(std::polar(1.0 / std::sqrt(dim), 2.0 * utils::PI * row * col / dim));
+        }
+    }
+    utils::Vec<utils::UInt> qubits = {0, 1, 2, 3, 4};
+    com::options::set("unitary_decomposition_threads", "1");
+    auto sequential = decompose(qft, qubits);
+    QL_ASSERT(!sequential.empty());
+    com::options::set("unitary_decomposition_threads", "4");
+    QL_ASSERT(decompose(qft, qubits) == sequential);
+    com::options::set("unitary_decomposition_threads", "1");
+
+    // Diagonal unitaries are decomposed into rz and cnot gates only; for the
+    // controlled phase, that's 3 rotations and 2 cnots.
+    utils::Vec<utils::Complex> cz = {
+        1.0, 0.0, 0.0, 0.0,
+        0.0, 1.0, 0.0, 0.0,
+        0.0, 0.0, 1.0, 0.0,
+        0.0, 0.0, 0.0, -1.0
+    };
+    com::dec::Unitary cz_unitary{"cz", cz};
+    auto cz_gates = cz_unitary.get_decomposition({0, 1});
+    QL_ASSERT(cz_gates.size() == 5);
+    for (const auto &gate : cz_gates) {
+        QL_ASSERT(gate->name == "rz" || gate->name == "cnot");
+    }
+
+    // Permutations are decomposed into X/CNOT/Toffoli networks; a Toffoli
+    // unitary (targeting the least significant qubit) is just that.
+    utils::Vec<utils::Complex> toffoli(64, 0.0);
+    for (utils::UInt row = 0; row < 8; row++) {
+        toffoli[row * 8 + (row >= 6 ? row ^ 1 : row)] = 1.0;
+    }
+    com::dec::Unitary toffoli_unitary{"toffoli", toffoli};
+    auto toffoli_gates = toffoli_unitary.get_decomposition({0, 1, 2});
+    QL_ASSERT(toffoli_gates.size() == 1);
+    QL_ASSERT(toffoli_gates[0]->name == "toffoli");
+    QL_ASSERT(toffoli_gates[0]->operands[2] == 0);
+
+    // With a tolerance, rotations that are (nearly) the identity are dropped
+    // along with the multiplexors consisting only of such rotations, and the
+    // error bound reflects what was dropped.
+    utils::Vec<utils::Complex> near_identity = {
+        1.0, 0.0, 0.0, 0.0,
+        0.0, 1.0, 0.0, 0.0,
+        0.0, 0.0, 1.0, 0.0,
+        0.0, 0.0, 0.0, std::polar(1.0, 1e-4)
+    };
+    com::dec::Unitary exact_unitary{"near_identity", near_identity};
+    QL_ASSERT(exact_unitary.get_decomposition({0, 1}).size() == 5);
+    QL_ASSERT(exact_unitary.get_error_bound() == 0.0);
+    com::options::set("unitary_tolerance", "1e-3");
+    com::dec::Unitary approximate_unitary{"near_identity", near_identity};
+    QL_ASSERT(approximate_unitary.get_decomposition({0, 1}).empty());
+    QL_ASSERT(approximate_unitary.get_error_bound() > 0.0);
+    QL_ASSERT(approximate_unitary.get_error_bound() < 1e-3);
+    QL_ASSERT(cz_unitary.get_decomposition({0, 1}).size() == 5);
+    QL_ASSERT(cz_unitary.get_error_bound() == 0.0);
+    com::options::set("unitary_tolerance", "0");
+
+    return 0;
+}
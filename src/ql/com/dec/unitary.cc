@@ -4,8 +4,23 @@
 
 #include "ql/com/dec/unitary.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
 #include "ql/utils/exception.h"
 #include "ql/utils/logger.h"
+#include "ql/utils/opt.h"
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/budget.h"
+#include "ql/com/options.h"
 
 #ifndef WITHOUT_UNITARY_DECOMPOSITION
 #include <Eigen/MatrixFunctions>
@@ -31,6 +46,7 @@ Unitary::Unitary(
     const Vec<Complex> &array
 ) :
     decomposed(false),
+    error_bound(0.0),
     name(name),
     array(array)
 {
@@ -43,6 +59,16 @@ UInt Unitary::size() const {
     return array.size();
 }
 
+/**
+ * Returns an upper bound on the operator norm of the difference between the
+ * most recently returned decomposition and the exact one, up to global phase.
+ * This is nonzero only when rotations were dropped due to the
+ * unitary_tolerance option.
+ */
+Real Unitary::get_error_bound() const {
+    return error_bound;
+}
+
 #ifdef WITHOUT_UNITARY_DECOMPOSITION
 
 /**
@@ -63,6 +89,12 @@ Bool Unitary::is_decompose_support_enabled() {
 
 #else
 
+/**
+ * Magnitude below which matrix elements are considered to be zero when
+ * detecting structure in a unitary.
+ */
+static const Real STRUCTURE_TOLERANCE = 1e-12;
+
 // JvS: this was originally the class "unitary" itself, but compile times of
 // Eigen are so excessive that I moved it into its own compile unit and
 // provided a wrapper instead. It doesn't actually NEED to be wrapped like
@@ -70,9 +102,97 @@ Bool Unitary::is_decompose_support_enabled() {
 // the scope of a single method (calling other methods), but I'm not touching
 // this code.
 class UnitaryDecomposer {
+public:
+    typedef Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic> complex_matrix;
+
 private:
     Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic> _matrix;
 
+    /**
+     * Preallocated matrices for a single level of the recursion, i.e. for
+     * decomposing a unitary of a particular size. All matrices are square with
+     * half the size of the unitary at that level; the vectors have the same
+     * length. Except for the parallel case, only one unitary of each size is
+     * being decomposed at any time, so one set of these per level suffices.
+     */
+    struct Level {
+        complex_matrix V, W, V2, W2, L0, L1, R0, R1, ss;
+        complex_matrix c, q2, tmp_s, tmp_c, check;
+        Eigen::VectorXcd D, D2;
+        complex_matrix tmp, permuted;
+
+        explicit Level(Int n) :
+            V(n, n), W(n, n), V2(n, n), W2(n, n),
+            L0(n, n), L1(n, n), R0(n, n), R1(n, n), ss(n, n),
+            c(n, n), q2(n, n), tmp_s(n, n), tmp_c(n, n), check(n, n),
+            D(n), D2(n), tmp(2 * n, 2 * n), permuted(2 * n, 2 * n)
+        {}
+    };
+
+    /**
+     * Workspace for decomposing a unitary with a particular number of qubits
+     * and everything below it, indexed by number of qubits.
+     */
+    typedef Vec<std::unique_ptr<Level>> Workspace;
+
+    /**
+     * Builds a workspace for decomposing unitaries of up to the given number
+     * of qubits.
+     */
+    static Workspace make_workspace(Int numberofbits) {
+        Workspace ws;
+        ws.resize(numberofbits + 1);
+        for (Int bits = 2; bits <= numberofbits; bits++) {
+            ws[bits].reset(new Level(1 << (bits - 1)));
+        }
+        return ws;
+    }
+
+    /**
+     * Part of the instruction list of a node in the recursion: either a
+     * sub-unitary that is to be decomposed recursively, or a list of
+     * precomputed multiplexor angles.
+     */
+    struct Part {
+        const complex_matrix *unitary;
+        Vec<Real> angles;
+    };
+
+    /**
+     * Sub-unitaries with fewer qubits than this are always decomposed in the
+     * thread that encountered them; for those, the overhead of starting a
+     * thread would be larger than the work.
+     */
+    static const Int PARALLEL_MIN_BITS = 4;
+
+    /**
+     * Set once the numerical self-checks of the decomposition steps are
+     * skipped due to the compile-time budget having been exhausted.
+     */
+    mutable std::atomic<Bool> unchecked{false};
+
+    /**
+     * Returns whether the (expensive) numerical self-checks of the
+     * decomposition steps are to be performed. This is the case until the
+     * compile-time budget is exhausted; the first time it isn't, this is
+     * reported.
+     */
+    Bool check_results() const {
+        if (unchecked.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        if (!utils::TimeBudget::is_exceeded()) {
+            return true;
+        }
+        if (!unchecked.exchange(true)) {
+            utils::TimeBudget::report_degradation(
+                "unitary decomposition",
+                "skipping numerical self-checks for the remainder of unitary " + name
+            );
+        }
+        return false;
+    }
+
 public:
     Str name;
     Vec<Complex> array;
@@ -84,8 +204,6 @@ public:
     Bool decomposed;
     Vec<Real> instruction_list;
 
-    typedef Eigen::Matrix<Complex, Eigen::Dynamic, Eigen::Dynamic> complex_matrix;
-
     UnitaryDecomposer() : name(""), decomposed(false) {}
 
     UnitaryDecomposer(
@@ -108,7 +226,7 @@ public:
         }
     }
 
-    complex_matrix getMatrix() {
+    const complex_matrix &getMatrix() {
         if (!array.empty()) {
             Int matrix_size = (Int)sqrt(array.size());
 
@@ -118,7 +236,11 @@ public:
         return _matrix;
     }
 
-    void decompose() {
+    /**
+     * Decomposes the unitary, using up to the given number of threads for
+     * decomposing independent sub-unitaries.
+     */
+    void decompose(UInt num_threads = 1) {
         QL_DOUT("decomposing Unitary: " << name);
 
         getMatrix();
@@ -127,19 +249,18 @@ public:
         // compute the number of qubits: length of array is collumns*rows, so log2(sqrt(array.size))
         Int numberofbits = uint64_log2(matrix_size);
 
-        Eigen::MatrixXcd identity = Eigen::MatrixXcd::Identity(matrix_size, matrix_size);
-        Eigen::MatrixXcd matmatadjoint = (_matrix.adjoint()*_matrix);
         // very little accuracy because of tests using printed-from-matlab code that does not have many digits after the comma
-        if (!matmatadjoint.isApprox(identity, 0.001)) {
+        if (!(_matrix.adjoint()*_matrix).isApprox(Eigen::MatrixXcd::Identity(matrix_size, matrix_size), 0.001)) {
             //Throw an error
             QL_EOUT("Unitary " << name <<" is not a unitary matrix!");
 
-            throw utils::Exception("Error: Unitary '"+ name+"' is not a unitary matrix. Cannot be decomposed!" + to_string(matmatadjoint));
+            throw utils::Exception("Error: Unitary '"+ name+"' is not a unitary matrix. Cannot be decomposed!" + to_string(_matrix.adjoint()*_matrix));
         }
         // initialize the general M^k lookuptable
         genMk();
 
-        decomp_function(_matrix, numberofbits); //needed because the matrix is read in columnmajor
+        auto ws = make_workspace(numberofbits);
+        decomp_function(_matrix, numberofbits, instruction_list, ws, num_threads); //needed because the matrix is read in columnmajor
 
         QL_DOUT("Done decomposing");
         decomposed = true;
@@ -149,7 +270,7 @@ public:
         const complex_matrix &m,
         const Str &vector_prefix = "",
         const Str &elem_sep = ", "
-    ) {
+    ) const {
         StrStrm ss;
         ss << m << "\n";
         return ss.str();
@@ -162,64 +283,310 @@ public:
     // std::chrono::duration<Real> multiplexing_time;
     // std::chrono::duration<Real> demultiplexing_time;
 
-    void decomp_function(const Eigen::Ref<const complex_matrix>& matrix, Int numberofbits) {
+    /**
+     * Decomposes the sub-unitaries in the given parts with numberofbits
+     * qubits each, and appends their instruction lists to out, interleaved
+     * with the precomputed angles of the other parts. The sub-unitaries are
+     * independent, so they are decomposed concurrently when multiple threads
+     * are available and they are large enough; each thread then needs its
+     * own workspace.
+     */
+    void decomp_parts(
+        const Vec<Part> &parts,
+        Int numberofbits,
+        Vec<Real> &out,
+        Workspace &ws,
+        UInt num_threads
+    ) const {
+        Vec<UInt> unitaries;
+        for (UInt i = 0; i < parts.size(); i++) {
+            if (parts[i].unitary) {
+                unitaries.push_back(i);
+            }
+        }
+        if (num_threads <= 1 || unitaries.size() <= 1 || numberofbits < PARALLEL_MIN_BITS) {
+            for (const auto &part : parts) {
+                if (part.unitary) {
+                    decomp_function(*part.unitary, numberofbits, out, ws, 1);
+                } else {
+                    out.insert(out.end(), part.angles.begin(), part.angles.end());
+                }
+            }
+            return;
+        }
+
+        // Divide the threads we have over the sub-unitaries, such that
+        // deeper levels can use the remainder.
+        UInt threads_per_part = utils::max<UInt>(1, num_threads / unitaries.size());
+        Vec<Vec<Real>> results(parts.size());
+        utils::parallel_for(unitaries.size(), num_threads, [&](UInt i) {
+            auto part_ws = make_workspace(numberofbits);
+            decomp_function(*parts[unitaries[i]].unitary, numberofbits, results[unitaries[i]], part_ws, threads_per_part);
+        });
+        for (UInt i = 0; i < parts.size(); i++) {
+            const auto &list = parts[i].unitary ? results[i] : parts[i].angles;
+            out.insert(out.end(), list.begin(), list.end());
+        }
+    }
+
+    /**
+     * Returns whether all elements of the given matrix that map between
+     * states with a different value for the given bit of the state index are
+     * zero, i.e. whether the matrix is a multiplexor controlled by that bit.
+     */
+    static Bool is_multiplexed_on(const Eigen::Ref<const complex_matrix> &matrix, Int bit) {
+        Int mask = 1 << bit;
+        for (Int col = 0; col < matrix.cols(); col++) {
+            for (Int row = 0; row < matrix.rows(); row++) {
+                if (((row ^ col) & mask) && std::abs(matrix(row, col)) > STRUCTURE_TOLERANCE) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Appends the instruction list for the diagonal unitary with the given
+     * diagonal to out. For a single qubit this is just the angle of an RZ
+     * gate; for more qubits, the diagonal is split into a diagonal on all but
+     * the most significant qubit and a multiplexed RZ on that qubit, which
+     * commute.
+     */
+    void diagonal_decomp(const Eigen::Ref<const Eigen::VectorXcd> &diagonal, Int numberofbits, Vec<Real> &out) const {
+        if (numberofbits == 1) {
+            out.push_back(std::arg(diagonal(1) / diagonal(0)));
+            return;
+        }
+        Int n = diagonal.rows() / 2;
+        Eigen::VectorXcd D(n);
+        Eigen::VectorXcd P(n);
+        for (Int i = 0; i < n; i++) {
+            D(i) = std::sqrt(diagonal(i) / diagonal(i + n));
+            P(i) = diagonal(i) / D(i);
+        }
+        diagonal_decomp(P, numberofbits - 1, out);
+        multicontrolledZ(D, n, out);
+    }
+
+    /**
+     * If the given matrix is a permutation matrix with arbitrary phases,
+     * appends the instruction list for it to out and returns true. The
+     * permutation is synthesized as a network of X, CNOT, and Toffoli gates
+     * using the transformation-based algorithm of Miller, Maslov, and Dueck,
+     * preceded by a diagonal for the phases if they are not all equal.
+     * Returns false without modifying out if the matrix is not a permutation
+     * or if the network would need gates with more than two controls.
+     */
+    Bool permutation_decomp(const Eigen::Ref<const complex_matrix> &matrix, Int numberofbits, Vec<Real> &out) const {
+        Int size = matrix.rows();
+        Vec<Int> permutation(size, -1);
+        Vec<Bool> used(size, false);
+        Eigen::VectorXcd phases(size);
+        for (Int col = 0; col < size; col++) {
+            for (Int row = 0; row < size; row++) {
+                auto magnitude = std::abs(matrix(row, col));
+                if (magnitude <= STRUCTURE_TOLERANCE) {
+                    continue;
+                }
+                if (permutation[col] >= 0 || used[row] || magnitude < 0.5) {
+                    return false;
+                }
+                permutation[col] = row;
+                used[row] = true;
+                phases(col) = matrix(row, col) / magnitude;
+            }
+            if (permutation[col] < 0) {
+                return false;
+            }
+        }
+
+        // Find gates g_1..g_k such that g_k...g_1 P = I, by fixing the
+        // states in order of increasing index. Each gate is represented by
+        // the mask of its control bits and its target bit. The gates are
+        // self-inverse, so P = g_1...g_k, i.e. the circuit applies them in
+        // reverse order.
+        Vec<std::pair<Int, Int>> gates;
+        auto apply = [&](Int controls, Int target) {
+            for (auto &value : permutation) {
+                if ((value & controls) == controls) {
+                    value ^= 1 << target;
+                }
+            }
+            gates.emplace_back(controls, target);
+        };
+        for (Int i = 0; i < size; i++) {
+            Int value = permutation[i];
+            for (Int bit = 0; bit < numberofbits; bit++) {
+                if ((i >> bit & 1) && !(value >> bit & 1)) {
+                    apply(value, bit);
+                    value |= 1 << bit;
+                }
+            }
+            for (Int bit = 0; bit < numberofbits; bit++) {
+                if (!(i >> bit & 1) && (value >> bit & 1)) {
+                    apply(i, bit);
+                    value &= ~(1 << bit);
+                }
+            }
+        }
+        for (const auto &gate : gates) {
+            if (bitCount(gate.first) > 2) {
+                return false;
+            }
+        }
+
+        out.push_back(500.0);
+        Bool has_phases = false;
+        for (Int i = 1; i < size; i++) {
+            if (std::abs(phases(i) - phases(0)) > STRUCTURE_TOLERANCE) {
+                has_phases = true;
+                break;
+            }
+        }
+        out.push_back(has_phases ? 1.0 : 0.0);
+        if (has_phases) {
+            diagonal_decomp(phases, numberofbits, out);
+        }
+        out.push_back((Real) gates.size());
+        for (auto it = gates.rbegin(); it != gates.rend(); ++it) {
+            out.push_back((Real) bitCount(it->first));
+            for (Int bit = 0; bit < numberofbits; bit++) {
+                if (it->first >> bit & 1) {
+                    out.push_back((Real) bit);
+                }
+            }
+            out.push_back((Real) it->second);
+        }
+        return true;
+    }
+
+    void decomp_function(
+        const Eigen::Ref<const complex_matrix>& matrix,
+        Int numberofbits,
+        Vec<Real> &out,
+        Workspace &ws,
+        UInt num_threads
+    ) const {
         QL_DOUT("decomp_function: \n" << to_string(matrix));
+
+        // Check to see if it the kronecker product of a bigger matrix and the identity matrix.
+        // By checking if the elements mapping between states with different values for the last qubit are
+        // zero, and if the matrices for the two values of the last qubit are equal
+        // Which means the last qubit is not affected by this gate
+        Int n = matrix.rows()/2;
+        Bool last_qubit_unaffected = numberofbits > 1
+            && matrix(Eigen::seqN(0, n, 2), Eigen::seqN(1, n, 2)).isZero()
+            && matrix(Eigen::seqN(1, n, 2), Eigen::seqN(0, n, 2)).isZero()
+            && matrix(Eigen::seqN(0, n, 2), Eigen::seqN(0, n, 2)) == matrix(Eigen::seqN(1, n, 2), Eigen::seqN(1, n, 2));
+
+        // Diagonal and permutation matrices have much cheaper dedicated
+        // decompositions, but skipping a qubit entirely is cheaper still.
+        if (!last_qubit_unaffected) {
+            if (matrix.isDiagonal(STRUCTURE_TOLERANCE)) {
+                QL_DOUT("Optimization: unitary is diagonal, decomposing as multiplexed rotations.");
+                out.push_back(400.0);
+                Eigen::VectorXcd diagonal = matrix.diagonal();
+                diagonal.array() /= diagonal.array().abs();
+                diagonal_decomp(diagonal, numberofbits, out);
+                return;
+            }
+            if (permutation_decomp(matrix, numberofbits, out)) {
+                QL_DOUT("Optimization: unitary is a permutation, decomposing as a CNOT/Toffoli network.");
+                return;
+            }
+        }
+
         if(numberofbits == 1) {
-            zyz_decomp(matrix);
+            zyz_decomp(matrix, out);
         } else {
-            Int n = matrix.rows()/2;
+            Level &lv = *ws[numberofbits];
+
+            // Find the most significant bit other than the last one that the
+            // unitary is multiplexed on, i.e. that controls which of a number
+            // of unitaries is applied to the other qubits (including
+            // controlled unitaries, where one of them is the identity). If
+            // there is one, the qubits are reordered such that it becomes
+            // the most significant, at which point only demultiplexing is
+            // needed instead of a full CSD.
+            Int multiplexed_bit = -1;
+            if (!is_multiplexed_on(matrix, numberofbits - 1)) {
+                for (Int bit = numberofbits - 2; bit >= 0; bit--) {
+                    if (is_multiplexed_on(matrix, bit)) {
+                        multiplexed_bit = bit;
+                        break;
+                    }
+                }
+            }
 
-            complex_matrix V(n,n);
-            complex_matrix W(n,n);
-            Eigen::VectorXcd D(n);
             // if q2 is zero, the whole thing is a demultiplexing problem instead of full CSD
             if (matrix.bottomLeftCorner(n,n).isZero(10e-14) && matrix.topRightCorner(n,n).isZero(10e-14)) {
                 QL_DOUT("Optimization: q2 is zero, only demultiplexing will be performed.");
-                instruction_list.push_back(200.0);
+                out.push_back(200.0);
                 if (matrix.topLeftCorner(n, n).isApprox(matrix.bottomRightCorner(n,n),10e-4)) {
                     QL_DOUT("Optimization: Unitaries are equal, skip one step in the recursion for unitaries of size: " << n << " They are both: " << matrix.topLeftCorner(n, n));
-                    instruction_list.push_back(300.0);
-                    decomp_function(matrix.topLeftCorner(n, n), numberofbits-1);
+                    out.push_back(300.0);
+                    decomp_function(matrix.topLeftCorner(n, n), numberofbits-1, out, ws, num_threads);
                 } else {
-                    demultiplexing(matrix.topLeftCorner(n, n), matrix.bottomRightCorner(n,n), V, D, W, numberofbits-1);
-
-                    decomp_function(W, numberofbits-1);
-                    multicontrolledZ(D, D.rows());
-                    decomp_function(V, numberofbits-1);
+                    demultiplexing(matrix.topLeftCorner(n, n), matrix.bottomRightCorner(n,n), lv.V, lv.D, lv.W, lv, numberofbits-1);
+
+                    Vec<Part> parts(3);
+                    parts[0].unitary = &lv.W;
+                    parts[1].unitary = nullptr;
+                    multicontrolledZ(lv.D, lv.D.rows(), parts[1].angles);
+                    parts[2].unitary = &lv.V;
+                    decomp_parts(parts, numberofbits-1, out, ws, num_threads);
                 }
-            } else if (
-                // Check to see if it the kronecker product of a bigger matrix and the identity matrix.
-                // By checking if the first row is equal to the second row one over, and if thelast two rows are equal
-                // Which means the last qubit is not affected by this gate
-                matrix(Eigen::seqN(0, n, 2), Eigen::seqN(1, n, 2)).isZero()
-                && matrix(Eigen::seqN(1, n, 2), Eigen::seqN(0, n, 2)).isZero()
-                && matrix.block(0,0,1,2*n-1) == matrix.block(1,1,1,2*n-1)
-                && matrix.block(2*n-2,0,1,2*n-1) == matrix.block(2*n-1,1,1,2*n-1)
-            ) {
+            } else if (last_qubit_unaffected) {
                 QL_DOUT("Optimization: last qubit is not affected, skip one step in the recursion.");
                 // Code for last qubit not affected
-                instruction_list.push_back(100.0);
-                decomp_function(matrix(Eigen::seqN(0, n, 2), Eigen::seqN(0, n, 2)), numberofbits-1);
+                out.push_back(100.0);
+                lv.tmp_c = matrix(Eigen::seqN(0, n, 2), Eigen::seqN(0, n, 2));
+                decomp_function(lv.tmp_c, numberofbits-1, out, ws, num_threads);
+            } else if (multiplexed_bit >= 0) {
+                QL_DOUT("Optimization: unitary is multiplexed on qubit " << multiplexed_bit << ", reordering qubits to only demultiplex.");
+                out.push_back(600.0);
+                out.push_back((Real) multiplexed_bit);
+
+                // Move the multiplexed bit to the most significant position.
+                Int low_mask = (1 << multiplexed_bit) - 1;
+                Vec<Int> index(2*n);
+                for (Int i = 0; i < 2*n; i++) {
+                    index[i] = (i & low_mask) | (((i & ~low_mask) << 1) & (2*n - 1)) | ((i >> (numberofbits - 1)) << multiplexed_bit);
+                }
+                for (Int col = 0; col < 2*n; col++) {
+                    for (Int row = 0; row < 2*n; row++) {
+                        lv.permuted(row, col) = matrix(index[row], index[col]);
+                    }
+                }
+                decomp_function(lv.permuted, numberofbits, out, ws, num_threads);
             } else {
-                complex_matrix ss(n,n);
-                complex_matrix L0(n,n);
-                complex_matrix L1(n,n);
-                complex_matrix R0(n,n);
-                complex_matrix R1(n,n);
                 // auto start = std::chrono::steady_clock::now();
-                CSD(matrix, L0, L1, R0, R1, ss);
+                CSD(matrix, lv.L0, lv.L1, lv.R0, lv.R1, lv.ss, lv);
                 // CSD_time += (std::chrono::steady_clock::now() - start);
-                demultiplexing(R0, R1, V, D, W, numberofbits-1);
-                decomp_function(W, numberofbits-1);
-                multicontrolledZ(D, D.rows());
-                decomp_function(V, numberofbits-1);
-
-                multicontrolledY(ss.diagonal(), n);
 
-                demultiplexing(L0, L1, V, D, W, numberofbits-1);
-                decomp_function(W, numberofbits-1);
-                multicontrolledZ(D, D.rows());
-                decomp_function(V, numberofbits-1);
+                // Mark the node, such that the instruction list can't be
+                // mistaken for that of one of the optimized cases when the
+                // first sub-unitary is one.
+                out.push_back(700.0);
+
+                // Both demultiplexing steps only depend on the CSD, so do them
+                // up front. That leaves four independent sub-unitaries.
+                demultiplexing(lv.R0, lv.R1, lv.V, lv.D, lv.W, lv, numberofbits-1);
+                demultiplexing(lv.L0, lv.L1, lv.V2, lv.D2, lv.W2, lv, numberofbits-1);
+
+                Vec<Part> parts(7);
+                parts[0].unitary = &lv.W;
+                parts[1].unitary = nullptr;
+                multicontrolledZ(lv.D, lv.D.rows(), parts[1].angles);
+                parts[2].unitary = &lv.V;
+                parts[3].unitary = nullptr;
+                multicontrolledY(lv.ss.diagonal(), n, parts[3].angles);
+                parts[4].unitary = &lv.W2;
+                parts[5].unitary = nullptr;
+                multicontrolledZ(lv.D2, lv.D2.rows(), parts[5].angles);
+                parts[6].unitary = &lv.V2;
+                decomp_parts(parts, numberofbits-1, out, ws, num_threads);
             }
         }
     }
@@ -230,8 +597,9 @@ public:
         Eigen::Ref<complex_matrix> u2,
         Eigen::Ref<complex_matrix> v1,
         Eigen::Ref<complex_matrix> v2,
-        Eigen::Ref<complex_matrix> s
-    ) {
+        Eigen::Ref<complex_matrix> s,
+        Level &lv
+    ) const {
         // auto start = std::chrono::steady_clock::now();
         //Cosine sine decomposition
         // U = [q1, U01] = [u1    ][c  s][v1  ]
@@ -248,11 +616,13 @@ public:
         //          q2 = u2*s*v1.adjoint()
         Int p = n/2;
         // complex_matrix z = Eigen::MatrixXd::Identity(p, p).colwise().reverse();
-        complex_matrix c(svd.singularValues().reverse().asDiagonal());
+        complex_matrix &c = lv.c;
+        c = svd.singularValues().reverse().asDiagonal();
         u1.noalias() = svd.matrixU().rowwise().reverse();
         v1.noalias() = svd.matrixV().rowwise().reverse(); // Same v as in matlab: u*s*v.adjoint() = q1
 
-        complex_matrix q2 = U.bottomLeftCorner(p,p)*v1;
+        complex_matrix &q2 = lv.q2;
+        q2.noalias() = U.bottomLeftCorner(p,p)*v1;
 
         Int k = 0;
         for (Int j = 1; j < p; j++) {
@@ -306,7 +676,7 @@ public:
         s(s_ind,s_ind) = -s(s_ind,s_ind);
         u2(Eigen::all, s_ind) = -u2(Eigen::all, s_ind);
 
-        if (!U.topLeftCorner(p,p).isApprox(u1*c*v1.adjoint(), 10e-8) || !U.bottomLeftCorner(p,p).isApprox(u2*s*v1.adjoint(), 10e-8)) {
+        if (check_results() && (!U.topLeftCorner(p,p).isApprox(u1*c*v1.adjoint(), 10e-8) || !U.bottomLeftCorner(p,p).isApprox(u2*s*v1.adjoint(), 10e-8))) {
             if (U.topLeftCorner(p,p).isApprox(u1*c*v1.adjoint(), 10e-8)) {
                 QL_DOUT("q1 is correct");
             } else {
@@ -325,18 +695,18 @@ public:
         v1.adjointInPlace(); // Use this instead of = v1.adjoint (to avoid aliasing issues)
         s = -s;
 
-        complex_matrix tmp_s = u1.adjoint()*U.topRightCorner(p,p);
-        complex_matrix tmp_c = u2.adjoint()*U.bottomRightCorner(p,p);
+        lv.tmp_s.noalias() = u1.adjoint()*U.topRightCorner(p,p);
+        lv.tmp_c.noalias() = u2.adjoint()*U.bottomRightCorner(p,p);
 
         // Vec<Int> c_ind_row;
         // Vec<Int> s_ind_row;
         for (Int i = 0; i < p; i++) {
             if (abs(s(i,i)) > abs(c(i,i))) {
                 // Vec<Int> s_ind_row;
-                v2.row(i).noalias() = tmp_s.row(i)/s(i,i);
+                v2.row(i).noalias() = lv.tmp_s.row(i)/s(i,i);
             } else {
                 // c_ind_row.push_back(i);
-                v2.row(i).noalias() = tmp_c.row(i)/c(i,i);
+                v2.row(i).noalias() = lv.tmp_c.row(i)/c(i,i);
             }
         }
 
@@ -346,20 +716,22 @@ public:
         // U = [q1, U01] = [u1    ][c  s][v1  ]
         //     [q2, U11] = [    u2][-s c][   v2]
 
-        complex_matrix tmp(n,n);
-        tmp.topLeftCorner(p,p) = u1*c*v1;
-        tmp.bottomLeftCorner(p,p) = -u2*s*v1;
-        tmp.topRightCorner(p,p) = u1*s*v2;
-        tmp.bottomRightCorner(p,p) = u2*c*v2;
-        // Just to see if it kinda matches
-        if (!tmp.isApprox(U, 10e-2)) {
-            throw utils::Exception("CSD of unitary '"+ name+"' is wrong! Failed at matrix: \n"+to_string(tmp) + "\nwhich should be: \n" + to_string(U));
+        if (check_results()) {
+            complex_matrix &tmp = lv.tmp;
+            tmp.topLeftCorner(p,p) = u1*c*v1;
+            tmp.bottomLeftCorner(p,p) = -u2*s*v1;
+            tmp.topRightCorner(p,p) = u1*s*v2;
+            tmp.bottomRightCorner(p,p) = u2*c*v2;
+            // Just to see if it kinda matches
+            if (!tmp.isApprox(U, 10e-2)) {
+                throw utils::Exception("CSD of unitary '"+ name+"' is wrong! Failed at matrix: \n"+to_string(tmp) + "\nwhich should be: \n" + to_string(U));
+            }
         }
         // CSD_time3 += (std::chrono::steady_clock::now() - start2);
 
     }
 
-    void zyz_decomp(const Eigen::Ref<const complex_matrix> &matrix) {
+    void zyz_decomp(const Eigen::Ref<const complex_matrix> &matrix, Vec<Real> &out) const {
         // auto start = std::chrono::steady_clock::now();
 
         Complex det = matrix.determinant();// matrix(0,0)*matrix(1,1)-matrix(1,0)*matrix(0,1);
@@ -381,12 +753,12 @@ public:
 
         Real t1 = atan2(A.imag(),A.real());
         Real t2 = atan2(B.imag(), B.real());
-        alpha = t1+t2;
-        gamma = t1-t2;
-        beta = 2*atan2(sw*sqrt(pow((Real) wx,2)+pow((Real) wy,2)),sqrt(pow((Real) A.real(),2)+pow((wz*sw),2)));
-        instruction_list.push_back(-gamma);
-        instruction_list.push_back(-beta);
-        instruction_list.push_back(-alpha);
+        Real alpha = t1+t2;
+        Real gamma = t1-t2;
+        Real beta = 2*atan2(sw*sqrt(pow((Real) wx,2)+pow((Real) wy,2)),sqrt(pow((Real) A.real(),2)+pow((wz*sw),2)));
+        out.push_back(-gamma);
+        out.push_back(-beta);
+        out.push_back(-alpha);
         // zyz_time += (std::chrono::steady_clock::now() - start);
     }
 
@@ -396,12 +768,14 @@ public:
         Eigen::Ref<complex_matrix> V,
         Eigen::Ref<Eigen::VectorXcd> D,
         Eigen::Ref<complex_matrix> W,
+        Level &lv,
         Int numberofcontrolbits
-    ) {
+    ) const {
         // [U1 0 ]  = [V 0][D 0 ][W 0]
         // [0  U2]    [0 V][0 D*][0 W]
         // auto start = std::chrono::steady_clock::now();
-        complex_matrix check = U1*U2.adjoint();
+        complex_matrix &check = lv.check;
+        check.noalias() = U1*U2.adjoint();
         // complex_matrix D;
         // complex_matrix V;
         // complex_matrix W;
@@ -434,8 +808,7 @@ public:
             V(Eigen::all,Eigen::seq(Eigen::last-1,Eigen::last)) = svd3.matrixU();
         }
 
-        complex_matrix Dtemp = D.asDiagonal();
-        if (!U1.isApprox(V*Dtemp*W, 10e-2) || !U2.isApprox(V*Dtemp.adjoint()*W, 10e-2)) {
+        if (check_results() && (!U1.isApprox(V*D.asDiagonal()*W, 10e-2) || !U2.isApprox(V*D.conjugate().asDiagonal()*W, 10e-2))) {
             QL_EOUT("Demultiplexing not correct!");
             throw utils::Exception("Demultiplexing of unitary '"+ name+"' not correct! Failed at matrix U1: \n"+to_string(U1)+ "and matrix U2: \n" +to_string(U2) + "\nwhile they are: \n" + to_string(V*D.asDiagonal()*W) + "\nand \n" + to_string(V*D.conjugate().asDiagonal()*W));
         }
@@ -444,6 +817,13 @@ public:
 
     Vec<Eigen::MatrixXd> genMk_lookuptable;
 
+    /**
+     * Decompositions of the matrices in genMk_lookuptable, used by the
+     * multiplexor functions to solve for the rotation angles. Computing these
+     * is the expensive part, so this is done only once for each size.
+     */
+    Vec<Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd>> genMk_decompositions;
+
     // returns M^k = (-1)^(b_(i-1)*g_(i-1)), where * is bitwise inner product, g = binary gray code, b = binary code.
     void genMk() {
         Int numberqubits = uint64_log2(_matrix.rows());
@@ -456,19 +836,28 @@ public:
                 }
             }
             genMk_lookuptable.push_back(Mk);
+            genMk_decompositions.emplace_back(Mk);
         }
 
         // return genMk_lookuptable[numberqubits-1];
     }
 
     // source: https://stackoverflow.com/questions/994593/how-to-do-an-integer-log2-in-c user Todd Lehman
-    Int uint64_log2(uint64_t n) {
+    static Int uint64_log2(uint64_t n) {
 #define S(k) if (n >= (UINT64_C(1) << k)) { i += k; n >>= k; }
         Int i = -(n == 0); S(32); S(16); S(8); S(4); S(2); S(1); return i;
 #undef S
     }
 
-    Int bitParity(Int i) {
+    static Int bitCount(Int i) {
+        Int count = 0;
+        for (; i; i &= i - 1) {
+            count++;
+        }
+        return count;
+    }
+
+    static Int bitParity(Int i) {
         if (i < 2 << 16) {
             i = (i >> 16) ^ i;
             i = (i >> 8) ^ i;
@@ -481,34 +870,34 @@ public:
         }
     }
 
-    void multicontrolledY(const Eigen::Ref<const Eigen::VectorXcd> &ss, Int halfthesizeofthematrix) {
+    void multicontrolledY(const Eigen::Ref<const Eigen::VectorXcd> &ss, Int halfthesizeofthematrix, Vec<Real> &out) const {
         // auto start = std::chrono::steady_clock::now();
         Eigen::VectorXd temp =  2*Eigen::asin(ss.array()).real();
-        Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd> dec(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]);
+        const auto &dec = genMk_decompositions[uint64_log2(halfthesizeofthematrix)-1];
         Eigen::VectorXd tr = dec.solve(temp);
         // Check is very approximate to account for low-precision input matrices
-        if (!temp.isApprox(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]*tr, 10e-2)) {
+        if (check_results() && !temp.isApprox(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]*tr, 10e-2)) {
             QL_EOUT("Multicontrolled Y not correct!");
             throw utils::Exception("Demultiplexing of unitary '"+ name+"' not correct! Failed at demultiplexing of matrix ss: \n"  + to_string(ss));
         }
 
-        instruction_list.insert(instruction_list.end(), &tr[0], &tr[halfthesizeofthematrix]);
+        out.insert(out.end(), &tr[0], &tr[halfthesizeofthematrix]);
         // multiplexing_time += std::chrono::steady_clock::now() - start;
     }
 
-    void multicontrolledZ(const Eigen::Ref<const Eigen::VectorXcd> &D, Int halfthesizeofthematrix) {
+    void multicontrolledZ(const Eigen::Ref<const Eigen::VectorXcd> &D, Int halfthesizeofthematrix, Vec<Real> &out) const {
         // auto start = std::chrono::steady_clock::now();
 
         Eigen::VectorXd temp =  (Complex(0,-2)*Eigen::log(D.array())).real();
-        Eigen::CompleteOrthogonalDecomposition<Eigen::MatrixXd> dec(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]);
+        const auto &dec = genMk_decompositions[uint64_log2(halfthesizeofthematrix)-1];
         Eigen::VectorXd tr = dec.solve(temp);
         // Check is very approximate to account for low-precision input matrices
-        if (!temp.isApprox(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]*tr, 10e-2)) {
+        if (check_results() && !temp.isApprox(genMk_lookuptable[uint64_log2(halfthesizeofthematrix)-1]*tr, 10e-2)) {
             QL_EOUT("Multicontrolled Z not correct!");
             throw utils::Exception("Demultiplexing of unitary '"+ name+"' not correct! Failed at demultiplexing of matrix D: \n"+ to_string(D));
         }
 
-        instruction_list.insert(instruction_list.end(), &tr[0], &tr[halfthesizeofthematrix]);
+        out.insert(out.end(), &tr[0], &tr[halfthesizeofthematrix]);
         // multiplexing_time += std::chrono::steady_clock::now() - start;
 
     }
@@ -519,6 +908,237 @@ public:
     }
 };
 
+/**
+ * Tolerance used for the fingerprints of the decomposition cache. Matrices
+ * of which all elements differ by less than this after global phase
+ * normalization are considered equal.
+ */
+static const Real CACHE_TOLERANCE = 1e-9;
+
+/**
+ * Fingerprint of a unitary matrix for the decomposition cache.
+ */
+struct UnitaryFingerprint {
+
+    /**
+     * The matrix with its global phase normalized away, by rotating it such
+     * that the first element with a magnitude of at least half of what the
+     * largest element of a unitary matrix is guaranteed to have becomes real
+     * and positive.
+     */
+    Vec<Complex> normalized;
+
+    /**
+     * Hash of the normalized matrix after quantizing its elements to
+     * multiples of CACHE_TOLERANCE. Matrices that are equal within tolerance
+     * usually, but not always, end up with the same hash; they may straddle a
+     * quantization boundary, in which case the cache just misses.
+     */
+    UInt hash;
+
+    /**
+     * Computes the fingerprint of the given row-major matrix.
+     */
+    explicit UnitaryFingerprint(const Vec<Complex> &array) : normalized(array), hash(0xCBF29CE484222325ull) {
+        Real threshold = 0.5 / std::sqrt(std::sqrt((Real)array.size()));
+        Complex rotation = 1.0;
+        for (const auto &element : array) {
+            if (std::abs(element) >= threshold) {
+                rotation = std::conj(element) / std::abs(element);
+                break;
+            }
+        }
+        for (auto &element : normalized) {
+            element *= rotation;
+            for (auto part : {element.real(), element.imag()}) {
+                hash ^= (UInt)std::llround(part / CACHE_TOLERANCE);
+                hash *= 0x100000001B3ull;
+            }
+        }
+        hash ^= normalized.size();
+        hash *= 0x100000001B3ull;
+    }
+
+    /**
+     * Returns whether the given normalized matrix is equal to ours within
+     * tolerance.
+     */
+    Bool matches(const Vec<Complex> &other) const {
+        if (other.size() != normalized.size()) {
+            return false;
+        }
+        for (UInt i = 0; i < normalized.size(); i++) {
+            if (std::abs(normalized[i] - other[i]) > 2 * CACHE_TOLERANCE) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+};
+
+/**
+ * A cached unitary decomposition.
+ */
+struct CachedDecomposition {
+
+    /**
+     * The normalized matrix that was decomposed.
+     */
+    Vec<Complex> normalized;
+
+    /**
+     * The resulting instruction list.
+     */
+    Vec<Real> instruction_list;
+
+};
+
+/**
+ * Process-wide in-memory cache of unitary decompositions, keyed by
+ * fingerprint hash. Intentionally leaked, to avoid depending on the
+ * destruction order of static objects.
+ */
+struct DecompositionCache {
+
+    /**
+     * Mutex protecting the entries.
+     */
+    std::mutex mutex;
+
+    /**
+     * The cached decompositions, keyed by fingerprint hash.
+     */
+    std::unordered_multimap<UInt, CachedDecomposition> entries;
+
+    /**
+     * Returns the process-wide cache.
+     */
+    static DecompositionCache &get() {
+        static DecompositionCache *cache = new DecompositionCache();
+        return *cache;
+    }
+
+};
+
+/**
+ * Returns the path of the on-disk cache entry for the given fingerprint, or
+ * an empty string if the on-disk cache is disabled.
+ */
+static Str get_cache_entry_path(const UnitaryFingerprint &fingerprint) {
+    auto dir = com::options::global["unitary_cache_dir"].as_str();
+    if (dir.empty()) {
+        return "";
+    }
+    StrStrm ss;
+    ss << dir << "/" << std::hex << std::setfill('0') << std::setw(16) << fingerprint.hash;
+    ss << std::dec << "_" << fingerprint.normalized.size() << ".json";
+    return ss.str();
+}
+
+/**
+ * Looks up the decomposition for the given fingerprint in the in-memory and
+ * on-disk caches. Returns whether it was found, in which case it is written to
+ * instruction_list.
+ */
+static Bool lookup_cached_decomposition(
+    const UnitaryFingerprint &fingerprint,
+    Vec<Real> &instruction_list
+) {
+    auto &cache = DecompositionCache::get();
+    {
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        auto range = cache.entries.equal_range(fingerprint.hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (fingerprint.matches(it->second.normalized)) {
+                instruction_list = it->second.instruction_list;
+                return true;
+            }
+        }
+    }
+
+    // Try the on-disk cache. Entries that can't be read or don't match are
+    // ignored; they will just be overwritten.
+    auto path = get_cache_entry_path(fingerprint);
+    if (path.empty() || !utils::is_file(path)) {
+        return false;
+    }
+    CachedDecomposition entry;
+    try {
+        auto json = utils::parse_json(utils::InFile(path).read());
+        for (const auto &element : json["matrix"]) {
+            entry.normalized.emplace_back(element[0].get<Real>(), element[1].get<Real>());
+        }
+        for (const auto &value : json["instructions"]) {
+            entry.instruction_list.push_back(value.get<Real>());
+        }
+    } catch (std::exception &e) {
+        QL_WOUT("ignoring unreadable unitary cache entry " << path << ": " << e.what());
+        return false;
+    }
+    if (!fingerprint.matches(entry.normalized)) {
+        return false;
+    }
+    instruction_list = entry.instruction_list;
+    std::lock_guard<std::mutex> lock{cache.mutex};
+    cache.entries.emplace(fingerprint.hash, std::move(entry));
+    return true;
+}
+
+/**
+ * Stores the decomposition for the given fingerprint in the in-memory and
+ * on-disk caches.
+ */
+static void store_cached_decomposition(
+    const UnitaryFingerprint &fingerprint,
+    const Vec<Real> &instruction_list
+) {
+    auto &cache = DecompositionCache::get();
+    {
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        cache.entries.emplace(fingerprint.hash, CachedDecomposition{fingerprint.normalized, instruction_list});
+    }
+
+    auto path = get_cache_entry_path(fingerprint);
+    if (path.empty()) {
+        return;
+    }
+    utils::Json matrix = utils::Json::array();
+    for (const auto &element : fingerprint.normalized) {
+        matrix.push_back({element.real(), element.imag()});
+    }
+    utils::Json instructions = utils::Json::array();
+    for (auto value : instruction_list) {
+        instructions.push_back(value);
+    }
+    utils::Json entry = {
+        {"matrix", matrix},
+        {"instructions", instructions}
+    };
+
+    // Write to a temporary file that is unique to this thread and process
+    // first, and then move it into place, such that readers never see partial
+    // entries.
+    StrStrm tmp_path;
+    tmp_path << path << ".tmp" << std::this_thread::get_id() << "_" << std::random_device()();
+    utils::WithoutOutputCapture without_capture;
+    {
+        utils::OutFile file{tmp_path.str()};
+        file << entry.dump() << "\n";
+        file.close();
+    }
+    auto wd = utils::get_working_directory();
+    auto from = utils::path_relative_to(wd, tmp_path.str());
+    auto to = utils::path_relative_to(wd, path);
+    if (std::rename(from.c_str(), to.c_str())) {
+        std::remove(to.c_str());
+        if (std::rename(from.c_str(), to.c_str())) {
+            std::remove(from.c_str());
+            QL_WOUT("failed to store unitary cache entry " << path);
+        }
+    }
+}
+
 /**
  * Explicitly runs the matrix decomposition algorithm. Used to be required,
  * nowadays is called implicitly by get_circuit() if not done explicitly.
@@ -527,14 +1147,41 @@ void Unitary::decompose() {
     if (decomposed) {
         return;
     }
+
+    // Unless disabled, look for the decomposition of an equivalent unitary
+    // in the cache first. The decomposition is only defined up to global
+    // phase anyway, so we can reuse it for unitaries that only differ in that.
+    auto use_cache = com::options::global["unitary_cache"].as_bool();
+    utils::Opt<UnitaryFingerprint> fingerprint;
+    if (use_cache) {
+        fingerprint.emplace(array);
+        if (lookup_cached_decomposition(*fingerprint, instruction_list)) {
+            QL_DOUT("using cached decomposition for unitary " << name);
+            decomposed = true;
+            return;
+        }
+    }
+
+    // Impose the global compile-time budget when we're not called from
+    // within the pass manager, which already does so.
+    utils::TimeBudget budget{
+        utils::TimeBudget::get_current() ? 0.0 : com::options::global["max_compile_time"].as_real()
+    };
+
     UnitaryDecomposer decomposer(name, array);
-    decomposer.decompose();
+    decomposer.decompose(utils::resolve_num_threads(
+        com::options::global["unitary_decomposition_threads"].as_uint()
+    ));
     //SU = decomposer.SU;
     //alpha = decomposer.alpha;
     //beta = decomposer.beta;
     //gamma = decomposer.gamma;
     decomposed = decomposer.decomposed;
     instruction_list = decomposer.instruction_list;
+
+    if (use_cache) {
+        store_cached_decomposition(*fingerprint, instruction_list);
+    }
 }
 
 /**
@@ -548,70 +1195,280 @@ Bool Unitary::is_decompose_support_enabled() {
 #endif
 
 
+/**
+ * Collects the gates of a decomposition, dropping rotations that are within
+ * the given tolerance of the identity and keeping track of the resulting
+ * error.
+ */
+struct GateEmitter {
+
+    /**
+     * The gates emitted thus far.
+     */
+    ir::compat::GateRefs &gates;
+
+    /**
+     * Rotations with an angle within this tolerance of a multiple of 2 pi are
+     * dropped. Zero means that the decomposition is exact.
+     */
+    Real tolerance;
+
+    /**
+     * Upper bound on the operator norm of the difference between the emitted
+     * circuit and the exact decomposition, accumulated over the dropped
+     * rotations.
+     */
+    Real error_bound = 0.0;
+
+    GateEmitter(ir::compat::GateRefs &gates, Real tolerance) : gates(gates), tolerance(tolerance) {
+    }
+
+    /**
+     * Returns the deviation of the given angle from the nearest multiple of
+     * 2 pi. A rotation by 2 pi is minus the identity, which, for a rotation
+     * on its own or controlled by a CNOT network, only affects global phase.
+     */
+    static Real deviation(Real angle) {
+        return std::remainder(angle, 2 * PI);
+    }
+
+    /**
+     * Returns whether a rotation by the given angle can be dropped.
+     */
+    Bool prunable(Real angle) const {
+        return std::abs(deviation(angle)) < tolerance;
+    }
+
+    /**
+     * Drops a rotation by the given angle, accounting for the error.
+     */
+    void drop(Real angle) {
+        error_bound += 2.0 * std::abs(std::sin(deviation(angle) / 4.0));
+    }
+
+    /**
+     * Drops the multiplexed rotation with the angles at the given inclusive
+     * range of indices if all its rotations can be dropped, returning whether
+     * this was the case. The CNOTs of the multiplexor then also amount to the
+     * identity, because each control is used an even number of times.
+     */
+    Bool drop_multiplexor(const Vec<Real> &angles, UInt start_index, UInt end_index) {
+        if (tolerance <= 0.0) {
+            return false;
+        }
+        for (UInt i = start_index; i <= end_index; i++) {
+            if (!prunable(angles[i])) {
+                return false;
+            }
+        }
+        for (UInt i = start_index; i <= end_index; i++) {
+            drop(angles[i]);
+        }
+        return true;
+    }
+
+    /**
+     * Emits a Z rotation, unless it can be dropped.
+     */
+    void rz(UInt qubit, Real angle) {
+        if (prunable(angle)) {
+            drop(angle);
+        } else {
+            gates.emplace<ir::compat::gate_types::RZ>(qubit, angle);
+        }
+    }
+
+    /**
+     * Emits a Y rotation, unless it can be dropped.
+     */
+    void ry(UInt qubit, Real angle) {
+        if (prunable(angle)) {
+            drop(angle);
+        } else {
+            gates.emplace<ir::compat::gate_types::RY>(qubit, angle);
+        }
+    }
+
+    /**
+     * Emits a CNOT. When rotations are being dropped, a CNOT directly
+     * following an identical one cancels it instead.
+     */
+    void cnot(UInt control, UInt target) {
+        if (
+            tolerance > 0.0 && !gates.empty() && gates.back()->name == "cnot" &&
+            gates.back()->operands == Vec<UInt>{control, target}
+        ) {
+            gates.get_vec().pop_back();
+        } else {
+            gates.emplace<ir::compat::gate_types::CNot>(control, target);
+        }
+    }
+
+};
+
 //controlled qubit is the first in the list.
 static void multicontrolled_rz(
-    ir::compat::GateRefs &c,
+    GateEmitter &c,
     const Vec<Real> &instruction_list,
     UInt start_index,
     UInt end_index,
     const Vec<UInt> &qubits
 ) {
     // DOUT("Adding a multicontrolled rz-gate at start index " << start_index << ", to " << to_string(qubits, "qubits: "));
+    if (c.drop_multiplexor(instruction_list, start_index, end_index)) {
+        return;
+    }
     UInt idx;
     //The first one is always controlled from the last to the first qubit.
-    c.emplace<ir::compat::gate_types::RZ>(qubits.back(), -instruction_list[start_index]);
-    c.emplace<ir::compat::gate_types::CNot>(qubits[0], qubits.back());
+    c.rz(qubits.back(), -instruction_list[start_index]);
+    c.cnot(qubits[0], qubits.back());
     for (UInt i = 1; i < end_index - start_index; i++) {
         idx = log2(((i)^((i)>>1))^((i+1)^((i+1)>>1)));
-        c.emplace<ir::compat::gate_types::RZ>(qubits.back(), -instruction_list[i + start_index]);
-        c.emplace<ir::compat::gate_types::CNot>(qubits[idx], qubits.back());
+        c.rz(qubits.back(), -instruction_list[i + start_index]);
+        c.cnot(qubits[idx], qubits.back());
     }
     // The last one is always controlled from the next qubit to the first qubit
-    c.emplace<ir::compat::gate_types::RZ>(qubits.back(), -instruction_list[end_index]);
-    c.emplace<ir::compat::gate_types::CNot>(qubits.end()[-2], qubits.back());
+    c.rz(qubits.back(), -instruction_list[end_index]);
+    c.cnot(qubits.end()[-2], qubits.back());
 }
 
 //controlled qubit is the first in the list.
 static void multicontrolled_ry(
-    ir::compat::GateRefs &c,
+    GateEmitter &c,
     const Vec<Real> &instruction_list,
     UInt start_index,
     UInt end_index,
     const Vec<UInt> &qubits
 ) {
     // DOUT("Adding a multicontrolled ry-gate at start index "<< start_index << ", to " << to_string(qubits, "qubits: "));
+    if (c.drop_multiplexor(instruction_list, start_index, end_index)) {
+        return;
+    }
     UInt idx;
 
     //The first one is always controlled from the last to the first qubit.
-    c.emplace<ir::compat::gate_types::RY>(qubits.back(), -instruction_list[start_index]);
-    c.emplace<ir::compat::gate_types::CNot>(qubits[0], qubits.back());
+    c.ry(qubits.back(), -instruction_list[start_index]);
+    c.cnot(qubits[0], qubits.back());
 
     for (UInt i = 1; i < end_index - start_index; i++) {
         idx = log2(((i)^((i)>>1))^((i+1)^((i+1)>>1)));
-        c.emplace<ir::compat::gate_types::RY>(qubits.back(), -instruction_list[i + start_index]);
-        c.emplace<ir::compat::gate_types::CNot>(qubits[idx], qubits.back());
+        c.ry(qubits.back(), -instruction_list[i + start_index]);
+        c.cnot(qubits[idx], qubits.back());
     }
     // Last one is controlled from the next qubit to the first one.
-    c.emplace<ir::compat::gate_types::RY>(qubits.back(), -instruction_list[end_index]);
-    c.emplace<ir::compat::gate_types::CNot>(qubits.end()[-2], qubits.back());
+    c.ry(qubits.back(), -instruction_list[end_index]);
+    c.cnot(qubits.end()[-2], qubits.back());
+}
+
+//recursive gate count function for diagonal unitaries
+//n is number of qubits
+//i is the start point for the instructionlist
+static Int recursiveRelationsForDiagonal(
+    GateEmitter &c,
+    const Vec<Real> &insns,
+    const Vec<UInt> &qubits,
+    UInt n,
+    UInt i
+) {
+    if (n == 1) {
+        c.rz(qubits.back(), insns[i]);
+        return 1;
+    }
+
+    // Diagonal on all but the last qubit, followed by a multiplexed rotation
+    // on the last qubit.
+    Vec<UInt> subvector(qubits.begin(), qubits.end() - 1);
+    UInt numberforcontrolledrotation = pow2(n - 1);
+    UInt start_counter = i;
+    start_counter += recursiveRelationsForDiagonal(c, insns, subvector, n - 1, start_counter);
+    multicontrolled_rz(c, insns, start_counter, start_counter + numberforcontrolledrotation - 1, qubits);
+    start_counter += numberforcontrolledrotation;
+    return start_counter - i;
+}
+
+//gate count function for permutation unitaries
+//n is number of qubits
+//i is the start point for the instructionlist, after the 500.0 marker
+static Int relationsForPermutation(
+    GateEmitter &c,
+    const Vec<Real> &insns,
+    const Vec<UInt> &qubits,
+    UInt n,
+    UInt i
+) {
+    UInt start_counter = i;
+
+    // Phases are applied first, if any.
+    if (insns[start_counter++] != 0.0) {
+        start_counter += recursiveRelationsForDiagonal(c, insns, qubits, n, start_counter);
+    }
+
+    // Followed by the X/CNOT/Toffoli network, stored as the number of
+    // controls, the control bits, and the target bit for each gate.
+    UInt num_gates = (UInt)insns[start_counter++];
+    for (UInt gate = 0; gate < num_gates; gate++) {
+        UInt num_controls = (UInt)insns[start_counter++];
+        Vec<UInt> operands;
+        for (UInt operand = 0; operand <= num_controls; operand++) {
+            operands.push_back(qubits[(UInt)insns[start_counter++]]);
+        }
+        switch (num_controls) {
+            case 0:
+                c.gates.emplace<ir::compat::gate_types::PauliX>(operands[0]);
+                break;
+            case 1:
+                c.cnot(operands[0], operands[1]);
+                break;
+            case 2:
+                c.gates.emplace<ir::compat::gate_types::Toffoli>(operands[0], operands[1], operands[2]);
+                break;
+            default:
+                throw Exception("unsupported gate in permutation decomposition");
+        }
+    }
+    return start_counter - i;
 }
 
 //recursive gate count function
 //n is number of qubits
 //i is the start point for the instructionlist
 static Int recursiveRelationsForUnitaryDecomposition(
-    ir::compat::GateRefs &c,
+    GateEmitter &c,
     const Vec<Real> &insns,
     const Vec<UInt> &qubits,
     UInt n,
     UInt i
 ) {
     // DOUT("Adding a new unitary starting at index: "<< i << ", to " << n << to_string(qubits, " qubits: "));
+
+    // Structured unitaries, which can occur at any level of the recursion.
+    if (insns[i] == 400.0) {
+        QL_DOUT("[kernel.h] Optimization: unitary is diagonal. New start_index: " << i + 1);
+        return recursiveRelationsForDiagonal(c, insns, qubits, n, i + 1) + 1; // for the number 400
+    } else if (insns[i] == 500.0) {
+        QL_DOUT("[kernel.h] Optimization: unitary is a permutation. New start_index: " << i + 1);
+        return relationsForPermutation(c, insns, qubits, n, i + 1) + 1; // for the number 500
+    }
+
     if (n > 1) {
         // Need to be checked here because it changes the structure of the decomposition.
         // This checks whether the first qubit is affected, if not, it applies a unitary to the all qubits except the first one.
         UInt numberforcontrolledrotation = pow2(n - 1);                     //number of gates per rotation
 
+        // code for a unitary multiplexed on a qubit other than the last
+        if (insns[i] == 600.0) {
+            UInt bit = (UInt)insns[i + 1];
+            QL_DOUT("[kernel.h] Optimization: unitary is multiplexed on qubit " << bit << ", moving it to the end. New start_index: " << i + 2);
+            Vec<UInt> reordered;
+            for (UInt q = 0; q < n; q++) {
+                if (q != bit) {
+                    reordered.push_back(qubits[q]);
+                }
+            }
+            reordered.push_back(qubits[bit]);
+            return recursiveRelationsForUnitaryDecomposition(c, insns, reordered, n, i + 2) + 2; // for the number 600 and the qubit
+        }
+
         // code for last one not affected
         if (insns[i] == 100.0) {
             QL_DOUT("[kernel.h] Optimization: last qubit is not affected, skip one step in the recursion. New start_index: " << i + 1);
@@ -642,6 +1499,9 @@ static Int recursiveRelationsForUnitaryDecomposition(
             // The new qubit vector that is passed to the recursive function
             Vec<UInt> subvector(qubits.begin(), qubits.end() - 1);
             UInt start_counter = i;
+            if (insns[i] == 700.0) {
+                start_counter++; // for the number 700
+            }
             start_counter += recursiveRelationsForUnitaryDecomposition(c, insns, subvector, n - 1, start_counter);
             multicontrolled_rz(c, insns, start_counter, start_counter + numberforcontrolledrotation - 1, qubits);
             start_counter += numberforcontrolledrotation;
@@ -657,9 +1517,9 @@ static Int recursiveRelationsForUnitaryDecomposition(
     } else { //n=1
         // DOUT("Adding the zyz decomposition gates at index: "<< i);
         // zyz gates happen on the only qubit in the list.
-        c.emplace<ir::compat::gate_types::RZ>(qubits.back(), insns[i]);
-        c.emplace<ir::compat::gate_types::RY>(qubits.back(), insns[i + 1]);
-        c.emplace<ir::compat::gate_types::RZ>(qubits.back(), insns[i + 2]);
+        c.rz(qubits.back(), insns[i]);
+        c.ry(qubits.back(), insns[i + 1]);
+        c.rz(qubits.back(), insns[i + 2]);
         // How many gates this took
         return 3;
     }
@@ -698,8 +1558,16 @@ ir::compat::GateRefs Unitary::get_decomposition(const utils::Vec<utils::UInt> &q
     QL_DOUT("The list is this many items long: " << instruction_list.size());
     //COUT("Instructionlist" << to_string(u.instructionlist));
     ir::compat::GateRefs c;
-    Int end_index = recursiveRelationsForUnitaryDecomposition(c, instruction_list, qubits, u_size, 0);
+    GateEmitter emitter{c, com::options::global["unitary_tolerance"].as_real()};
+    Int end_index = recursiveRelationsForUnitaryDecomposition(emitter, instruction_list, qubits, u_size, 0);
     QL_DOUT("Total number of gates added: " << end_index);
+    error_bound = emitter.error_bound;
+    if (emitter.tolerance > 0.0) {
+        QL_IOUT(
+            "approximate decomposition of unitary '" << name << "' has " <<
+            c.size() << " gates, with an error of at most " << error_bound
+        );
+    }
 
     return c;
 }
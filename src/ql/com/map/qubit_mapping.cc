@@ -24,6 +24,38 @@ std::ostream &operator<<(std::ostream &os, QubitState qs) {
     return os;
 }
 
+/**
+ * Updates real_to_virt and free_reals for the given real qubit.
+ */
+void QubitMapping::set_virtual(UInt real, UInt virt) {
+    QL_ASSERT(real < nq);
+    real_to_virt[real] = virt;
+    std::uint64_t bit = std::uint64_t(1) << (real % 64);
+    if (virt == UNDEFINED_QUBIT) {
+        free_reals[real / 64] |= bit;
+    } else {
+        free_reals[real / 64] &= ~bit;
+    }
+}
+
+/**
+ * Rebuilds real_to_virt and free_reals from virt_to_real.
+ */
+void QubitMapping::rebuild_backward_map() {
+    real_to_virt.assign(nq, UNDEFINED_QUBIT);
+    free_reals.assign((nq + 63) / 64, 0);
+    for (UInt real = 0; real < nq; real++) {
+        free_reals[real / 64] |= std::uint64_t(1) << (real % 64);
+    }
+    for (UInt virt = 0; virt < nq; virt++) {
+        UInt real = virt_to_real[virt];
+        if (real != UNDEFINED_QUBIT && real < nq) {
+            QL_ASSERT(real_to_virt[real] == UNDEFINED_QUBIT);
+            set_virtual(real, virt);
+        }
+    }
+}
+
 /**
  * Creates a virtual to real qubit map with the given number of qubits.
  *
@@ -63,22 +95,47 @@ void QubitMapping::resize(
         real_state[i] = initial_state;
     }
     nq = num_qubits;
+    rebuild_backward_map();
 }
 
 /**
  * Map virtual qubit index to real qubit index.
  */
-UInt &QubitMapping::operator[](UInt v) {
+const UInt &QubitMapping::operator[](UInt v) const {
     QL_ASSERT(v < nq);   // implies v != UNDEFINED_QUBIT
     return virt_to_real[v];
 }
 
 /**
- * Map virtual qubit index to real qubit index.
+ * Maps the given virtual qubit to the given real qubit, or unmaps it if
+ * real is UNDEFINED_QUBIT. The real qubit must not be mapped to another
+ * virtual qubit.
  */
-const UInt &QubitMapping::operator[](UInt v) const {
-    QL_ASSERT(v < nq);   // implies v != UNDEFINED_QUBIT
-    return virt_to_real[v];
+void QubitMapping::set_real(UInt virt, UInt real) {
+    QL_ASSERT(virt < nq);
+    UInt old_real = virt_to_real[virt];
+    if (old_real == real) {
+        return;
+    }
+    if (old_real != UNDEFINED_QUBIT) {
+        set_virtual(old_real, UNDEFINED_QUBIT);
+    }
+    if (real != UNDEFINED_QUBIT) {
+        QL_ASSERT(real_to_virt[real] == UNDEFINED_QUBIT);
+        set_virtual(real, virt);
+    }
+    virt_to_real[virt] = real;
+}
+
+/**
+ * Replaces the complete virtual to real qubit map. The vector must have
+ * one entry per qubit, and no two virtual qubits may map to the same real
+ * qubit. The real qubit states are not affected.
+ */
+void QubitMapping::set_virt_to_real(const utils::Vec<utils::UInt> &v2r) {
+    QL_ASSERT(v2r.size() == nq);
+    virt_to_real = v2r;
+    rebuild_backward_map();
 }
 
 /**
@@ -90,17 +147,14 @@ const utils::Vec<utils::UInt> &QubitMapping::get_virt_to_real() const {
 
 /**
  * Map real qubit to the virtual qubit index that is mapped to it (i.e.
- * backward map). When none, return UNDEFINED_QUBIT. This currently loops
- * over all qubits, so it isn't particularly fast.
+ * backward map). When none, return UNDEFINED_QUBIT.
  */
 UInt QubitMapping::get_virtual(UInt real) const {
     QL_ASSERT(real != UNDEFINED_QUBIT);
-    for (UInt virt = 0; virt < nq; virt++) {
-        if (virt_to_real[virt] == real) {
-            return virt;
-        }
+    if (real >= nq) {
+        return UNDEFINED_QUBIT;
     }
-    return UNDEFINED_QUBIT;
+    return real_to_virt[real];
 }
 
 /**
@@ -125,21 +179,27 @@ const utils::Vec<QubitState> &QubitMapping::get_state() const {
 }
 
 /**
- * Allocate a real qubit for the given unmapped virtual qubit.
+ * Allocate a real qubit for the given unmapped virtual qubit. This is
+ * always the lowest-indexed real qubit that isn't mapped yet.
  */
 UInt QubitMapping::allocate(UInt virt) {
     QL_ASSERT(virt_to_real[virt] == UNDEFINED_QUBIT);
-    // check all real indices for being in v2rMap
-    // first one that isn't, is free and is returned
-    for (UInt real = 0; real < nq; real++) {
-        if (get_virtual(real) == UNDEFINED_QUBIT) {
-            // real qubit r was not found in v2rMap
-            // use it to map v
-            virt_to_real[virt] = real;
-            QL_ASSERT(real_state[real] == QubitState::INITIALIZED || real_state[real] == QubitState::NONE);
-            QL_DOUT("allocate(v=" << virt << ") in r=" << real);
-            return real;
+    // find the first word of the free set with a bit set, and then the
+    // lowest bit set within it
+    for (UInt word = 0; word < free_reals.size(); word++) {
+        std::uint64_t bits = free_reals[word];
+        if (!bits) {
+            continue;
         }
+        UInt real = word * 64;
+        while (!(bits & 1)) {
+            bits >>= 1;
+            real++;
+        }
+        set_real(virt, real);
+        QL_ASSERT(real_state[real] == QubitState::INITIALIZED || real_state[real] == QubitState::NONE);
+        QL_DOUT("allocate(v=" << virt << ") in r=" << real);
+        return real;
     }
     QL_ASSERT(0);    // number of virt qubits <= number of real qubits
     return UNDEFINED_QUBIT;
@@ -172,6 +232,9 @@ void QubitMapping::swap(UInt r0, UInt r1) {
         virt_to_real[v1] = r0;
     }
 
+    set_virtual(r0, v1);
+    set_virtual(r1, v0);
+
     QubitState ts = real_state[r0];
     real_state[r0] = real_state[r1];
     real_state[r1] = ts;
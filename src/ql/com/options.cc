@@ -4,7 +4,9 @@
 
 #include "ql/com/options.h"
 
+#include <atomic>
 #include "ql/utils/logger.h"
+#include "ql/utils/parallel.h"
 
 namespace ql {
 namespace com {
@@ -12,6 +14,12 @@ namespace options {
 
 using namespace utils;
 
+/**
+ * The typed values of the hot global options. Defined before global, so it is
+ * initialized before the callbacks of the global options write to it.
+ */
+static CachedOptions cached{true, ToffoliDecomposition::NONE};
+
 /**
  * Makes a new options record for OpenQL.
  */
@@ -46,7 +54,7 @@ Options make_ql_options() {
         "available as fallback for the gates defined in the platform "
         "configuration structure, including the special wait and barrier gates.",
         true
-    );
+    ).with_callback([](Option &x){cached.use_default_gates = x.as_bool();});
 
     options.add_enum(
         "decompose_toffoli",
@@ -55,7 +63,15 @@ Options make_ql_options() {
         "into the circuit as-is if `no` or unspecified.",
         "no",
         {"no", "NC", "AM"}
-    );
+    ).with_callback([](Option &x){
+        if (x.as_str() == "NC") {
+            cached.decompose_toffoli = ToffoliDecomposition::NC;
+        } else if (x.as_str() == "AM") {
+            cached.decompose_toffoli = ToffoliDecomposition::AM;
+        } else {
+            cached.decompose_toffoli = ToffoliDecomposition::NONE;
+        }
+    });
 
     options.add_bool(
         "issue_skip_319",
@@ -78,6 +94,205 @@ Options make_ql_options() {
         "only used when %N is used in the `output_prefix` common pass option."
     );
 
+    options.add_bool(
+        "profile_passes",
+        "Profile the execution of the pass tree. When set, the pass manager "
+        "records wall-clock time, CPU time, the number of IR nodes before and "
+        "after, the net change in heap usage, and the change in peak resident "
+        "set size for every pass invocation, including groups. The results "
+        "are written to `<output_dir>/<program>_pass_profile.json` and in "
+        "Chrome trace event format to `<output_dir>/<program>_pass_trace.json`, "
+        "where `<program>` is the uniquified program name."
+    );
+
+    options.add_bool(
+        "profile_allocations",
+        "When `profile_passes` is set, additionally count the memory allocated "
+        "for IR nodes and gates while the pass tree runs, and attribute it to "
+        "the running passes. The profile then includes the number of bytes "
+        "allocated by each pass, the number of counted bytes still live when "
+        "it completes, and the peak number of live bytes while it ran. "
+        "Counting adds overhead to every allocation of a node. The counters "
+        "are process-wide, so the numbers are only meaningful when a single "
+        "program is compiled at a time."
+    );
+
+    options.add_bool(
+        "async_output",
+        "Write side outputs produced while the pass tree runs, such as "
+        "statistics reports, cQASM reports, DOT graphs, interaction matrices "
+        "and pass debug output, from a background thread, such that "
+        "compilation does not have to wait for the disk. The files are "
+        "complete when compilation returns; errors writing them are reported "
+        "at that point. The outputs of code generators and files that are "
+        "read back later are still written synchronously."
+    );
+
+    options.add_bool(
+        "defer_reports",
+        "When set, passes whose only products are output files to which "
+        "nothing refers, such as cQASM reports without statistics, are run on "
+        "a copy of the IR concurrently with the rest of the pipeline, rather "
+        "than inline. Compilation waits for them before returning. Only the "
+        "serialization of the IR for the copy remains on the critical path.",
+        false
+    );
+
+    options.add_int(
+        "async_output_queue_limit",
+        "When `async_output` is set, the maximum amount of memory in MiB used "
+        "to hold output files that have not been written yet. Passes block "
+        "when they produce output while the limit is reached.",
+        "64", 1
+    );
+
+    options.add_int(
+        "num_threads",
+        "The maximum total number of threads that OpenQL uses for parallel "
+        "work, such as concurrently running pass alternatives, kernels, or "
+        "programs in a batch. All parallel regions share a single pool of "
+        "this many threads (including the thread that started the region), "
+        "so nested regions don't oversubscribe the machine. 0 means use all "
+        "hardware threads, 1 disables parallelism altogether. The number of "
+        "threads used by an individual region is further limited by the "
+        "thread count option of the pass it belongs to, where applicable; "
+        "these are named after the unit of work they distribute, such as "
+        "`block_threads` or `kernel_threads`.",
+        "0", 0
+    ).with_callback([](Option &x){ThreadPool::get().set_num_threads(x.as_uint());});
+
+    options.add_real(
+        "max_compile_time",
+        "Compile-time budget for a single run of the pass manager, and for "
+        "each unitary decomposition done outside of it, in seconds, or 0 for "
+        "no limit. Compilation is never interrupted; instead, once "
+        "the budget is exhausted, the most expensive algorithms switch to a "
+        "cheaper strategy for the remainder of the compilation: the mapper "
+        "falls back to the `base` heuristic and limits the number of routing "
+        "alternatives, MIP-based placement is skipped, and unitary "
+        "decomposition skips its numerical self-checks. Note that this makes "
+        "the result depend on timing. Each degradation is logged as a warning "
+        "and listed in `<output_dir>/<program>_compile_report.json`. Passes "
+        "that support it can be given a tighter budget of their own using "
+        "their `time_budget` option.",
+        "0", 0.0, utils::INF
+    );
+
+    options.add_bool(
+        "ir_arena",
+        "Allocate the IR nodes created while the pass tree runs, as well as "
+        "the gates created by kernels constructed after this option is set, "
+        "from a bump allocator rather than from the heap. This makes "
+        "constructing and tearing down large programs considerably faster, "
+        "but the memory of nodes that are freed during compilation is only "
+        "released once the entire IR is freed, so peak memory usage may go "
+        "up."
+    );
+
+    options.add_enum(
+        "ir_consistency_check",
+        "Controls how thoroughly the IR is checked for consistency after "
+        "conversion from the old IR, after reading cQASM, and after structure "
+        "decomposition. `full` checks the complete tree, including the "
+        "validity of all links. `changed` only checks the part of the tree "
+        "that was modified (the platform or the program), without checking "
+        "the link validity of the program. `sampled` checks the platform and "
+        "the structure of the program, but only every 64th statement of each "
+        "block, without checking link validity. `off` disables these checks. "
+        "When the log level is LOG_DEBUG, full checks are always performed.",
+        "full",
+        {"off", "sampled", "changed", "full"}
+    );
+
+    options.add_int(
+        "ir_conversion_threads",
+        "Number of threads used to convert the gates of the kernels of a "
+        "program from the old IR (as built via the API) to the new IR. Gates "
+        "that require the platform to be modified, such as the first use of a "
+        "default gate, are always converted serially, in program order. The "
+        "result does not depend on this setting. 0 means one thread per "
+        "hardware thread.",
+        "1", 0
+    );
+
+    options.add_bool(
+        "platform_cache",
+        "Cache fully loaded platforms for the lifetime of the process, keyed by "
+        "the architecture name or the contents of the platform configuration, "
+        "such that constructing a platform for a configuration that was loaded "
+        "before only costs a copy. Note that compiler configuration files "
+        "referred to from within a platform configuration file are not part of "
+        "the key, so changes to those are not picked up while this is enabled.",
+        true
+    );
+
+    options.add_str(
+        "pass_cache_dir",
+        "When set, the results of passes that support it are cached in this "
+        "directory, keyed by a hash of the OpenQL version, the pass type, the "
+        "pass options, and the input program and platform. When the same pass "
+        "is later run on identical input, its result is restored from the "
+        "cache instead of running the pass again. Passes only support caching "
+        "when they are deterministic with the configured options and have no "
+        "effects other than modifying the program; for instance, the mapper "
+        "requires non-random tie-breaking. Programs are stored in cQASM form, "
+        "so annotations that cQASM cannot represent, such as statistics, are "
+        "not restored. Empty (the default) disables the cache."
+    );
+
+    options.add_int(
+        "gc_threshold",
+        "After each pass that operates on the new IR, temporary objects that "
+        "are no longer referenced and generated instruction type overloads "
+        "that are no longer used are removed from the IR when the number of "
+        "such candidates grew by at least this amount since the previous "
+        "collection. This keeps lookups and serialization fast in long "
+        "pipelines. 0 disables the garbage collector.",
+        "1000", 0
+    );
+
+    options.add_bool(
+        "unitary_cache",
+        "Cache the results of unitary decomposition for the lifetime of the "
+        "process, keyed by a fingerprint of the matrix with its global phase "
+        "normalized away, such that decomposing the same unitary (or one that "
+        "differs from it only in global phase, or by less than 1e-9 in every "
+        "element) again only costs a hash lookup.",
+        true
+    );
+
+    options.add_str(
+        "unitary_cache_dir",
+        "When set, unitary decomposition results are also cached in this "
+        "directory, such that they are retained across processes. This uses "
+        "the same key as the in-memory cache enabled by `unitary_cache`, which "
+        "must be enabled for this to have any effect. Empty (the default) "
+        "disables the on-disk cache."
+    );
+
+    options.add_real(
+        "unitary_tolerance",
+        "Tolerance for approximate unitary decomposition. Rotations in the "
+        "decomposition with an angle within this tolerance (in radians) of a "
+        "multiple of 2 pi are dropped, as are multiplexed rotations that "
+        "consist only of such rotations, along with their CNOTs. The error "
+        "bound of the result is logged at info level. Note that the "
+        "decomposition cache (`unitary_cache`) stores the exact "
+        "decomposition, so this can be changed without clearing it. 0 (the "
+        "default) gives the exact decomposition.",
+        "0", 0.0, utils::INF
+    );
+
+    options.add_int(
+        "unitary_decomposition_threads",
+        "Number of threads used to decompose a single unitary. The recursive "
+        "decomposition splits each unitary into four independent unitaries "
+        "with one qubit less, which are decomposed concurrently when they are "
+        "large enough to make that worthwhile. The result does not depend on "
+        "this setting. 0 means one thread per hardware thread.",
+        "1", 0
+    );
+
     //========================================================================//
     // Default pass order                                                     //
     //========================================================================//
@@ -241,7 +456,7 @@ Options make_ql_options() {
         "whether the heuristic mapper will be run, and if so, which heuristic "
         "it should use. When `no`, MIP-based placement is also disabled.",
         "no",
-        {"no", "base", "baserc", "minextend", "minextendrc", "maxfidelity"}
+        {"no", "base", "baserc", "minextend", "minextendrc", "maxfidelity", "sabre"}
     );
 
     options.add_int(
@@ -476,6 +691,13 @@ Options make_ql_options() {
  */
 Options global = make_ql_options();
 
+/**
+ * Returns the typed values of the hot global options.
+ */
+const CachedOptions &get_cached() {
+    return cached;
+}
+
 /**
  * Convenience function for getting an option value as a string from the global
  * options record.
@@ -484,14 +706,53 @@ const Str &get(const Str &key) {
     return global[key].as_str();
 }
 
+/**
+ * The number of Freeze objects that currently exist.
+ */
+static std::atomic<UInt> freeze_count{0};
+
 /**
  * Convenience function for setting an option value for the global options
- * record.
+ * record. Throws an exception if the global options are currently frozen.
  */
 void set(const Str &key, const Str &value) {
+    check_not_frozen();
     global[key] = value;
 }
 
+/**
+ * Returns whether the global options are currently frozen, i.e. whether at
+ * least one Freeze object exists.
+ */
+Bool is_frozen() {
+    return freeze_count.load() > 0;
+}
+
+/**
+ * Throws an exception if the global options are currently frozen.
+ */
+void check_not_frozen() {
+    if (is_frozen()) {
+        QL_USER_ERROR(
+            "global options cannot be changed while programs are being compiled"
+        );
+    }
+}
+
+/**
+ * Freezes the global options.
+ */
+Freeze::Freeze() {
+    freeze_count++;
+}
+
+/**
+ * Unfreezes the global options, unless other Freeze objects still exist.
+ */
+Freeze::~Freeze() {
+    freeze_count--;
+}
+
 } // namespace options
 } // namespace com
 } // namespace ql
@@ -0,0 +1,343 @@
+/** \file
+ * Defines a linear-time ASAP/ALAP scheduler without resource constraints that
+ * does not need a data dependency graph.
+ */
+
+#include "ql/com/sch/frontier.h"
+
+#include <algorithm>
+#include "ql/utils/vec.h"
+#include "ql/utils/map.h"
+#include "ql/utils/trace.h"
+#include "ql/ir/ops.h"
+#include "ql/com/ddg/build.h"
+
+namespace ql {
+namespace com {
+namespace sch {
+
+/**
+ * Frontier scheduler class. Implements schedule_without_resources().
+ *
+ * The dependency rules are those of the data dependency graph builder: an
+ * access depends on all earlier accesses to the same object that it doesn't
+ * commute with, and transitively on everything those depend on. Because all
+ * accesses that commute with each other have the same access mode, the
+ * accesses to an object form a sequence of groups of mutually commuting
+ * accesses, and an access depends on everything in the groups before its own.
+ * Each object is tracked in a lane; lane 0 is the global lane, used for
+ * barrier-like statements, which depend on and are depended on by everything.
+ */
+class FrontierScheduler {
+private:
+
+    /**
+     * The state tracked for a single lane.
+     */
+    struct Lane {
+
+        /**
+         * The bound imposed by the accesses before the current group.
+         */
+        utils::Int before;
+
+        /**
+         * The bound imposed by the accesses in the current group.
+         */
+        utils::Int group;
+
+        /**
+         * The access mode of the current group, if there is one.
+         */
+        ddg::AccessMode mode;
+
+        /**
+         * Whether there is a current group.
+         */
+        utils::Bool open;
+
+    };
+
+    /**
+     * A single object access of a statement, reduced to the lane of the
+     * object and the access mode.
+     */
+    struct Access {
+        utils::UInt lane;
+        ddg::AccessMode mode;
+    };
+
+    /**
+     * IR root node.
+     */
+    const ir::Ref &ir;
+
+    /**
+     * The block that we're scheduling.
+     */
+    const ir::BlockBaseRef &block;
+
+    /**
+     * The event gatherer object that we're using to get the events for the
+     * statements in the block.
+     */
+    ddg::EventGatherer gatherer;
+
+    /**
+     * The number of qubits in the platform. Lanes 1 to num_qubits are used
+     * for the qubits, and the num_qubits lanes after those for their implicit
+     * bits.
+     */
+    utils::UInt num_qubits;
+
+    /**
+     * The qubit register of the platform.
+     */
+    const ir::Object *qubits;
+
+    /**
+     * The implicit bit type of the platform, or nullptr if there is none.
+     */
+    const ir::DataType *implicit_bit_type;
+
+    /**
+     * Lanes for the references to objects other than the qubits and their
+     * implicit bits.
+     */
+    utils::Map<ddg::Reference, utils::UInt> other_lanes;
+
+    /**
+     * The total number of lanes.
+     */
+    utils::UInt num_lanes;
+
+    /**
+     * The accesses of all statements, in statement order.
+     */
+    utils::Vec<Access> accesses;
+
+    /**
+     * The offset of the accesses of each statement in accesses, with an extra
+     * entry at the end.
+     */
+    utils::Vec<utils::UInt> offsets;
+
+    /**
+     * Returns the lane for the given reference, or utils::MAX if the
+     * reference can't be tracked by a single lane.
+     */
+    utils::UInt get_lane(const ddg::Reference &reference) {
+        if (reference.is_global_state()) {
+            return 0;
+        }
+        auto target = reference.target.get_ptr().get();
+        auto data_type = reference.data_type.get_ptr().get();
+        if (target == qubits && reference.indices.size() == 1 && reference.indices[0] < num_qubits) {
+            if (data_type == reference.target->data_type.get_ptr().get()) {
+                return 1 + reference.indices[0];
+            } else if (data_type == implicit_bit_type) {
+                return 1 + num_qubits + reference.indices[0];
+            }
+        }
+        if (reference.indices.size() != reference.target->shape.size()) {
+            return utils::MAX;
+        }
+        auto it = other_lanes.find(reference);
+        if (it != other_lanes.end()) {
+            return it->second;
+        }
+        other_lanes.set(reference) = num_lanes;
+        return num_lanes++;
+    }
+
+    /**
+     * Gathers the accesses of all statements in the block. Returns false if
+     * any access can't be tracked.
+     */
+    utils::Bool gather() {
+        offsets.reserve(block->statements.size() + 1);
+        for (const auto &statement : block->statements) {
+            offsets.push_back(accesses.size());
+            gatherer.reset();
+            gatherer.add_statement(statement);
+
+            // Statements without any events are upgraded to barriers, like
+            // the DDG builder does.
+            if (gatherer.get().empty()) {
+                gatherer.add_reference(ir::prim::OperandMode::BARRIER, {});
+            }
+
+            for (const auto &event : gatherer.get()) {
+                auto lane = get_lane(event.first);
+                if (lane == utils::MAX) {
+                    QL_DOUT(
+                        "cannot schedule without DDG due to untracked "
+                        "reference " << event.first
+                    );
+                    return false;
+                }
+                accesses.push_back({lane, event.second});
+            }
+        }
+        offsets.push_back(accesses.size());
+        return true;
+    }
+
+    /**
+     * Schedules the statements, in forward direction for ASAP and in reverse
+     * for ALAP. For ASAP, the bounds are the minimum start cycles implied by
+     * the completion of the earlier statements; for ALAP, they are the maximum
+     * completion cycles implied by the start of the later statements, with
+     * the end of the block at cycle 0.
+     */
+    void schedule(utils::Int direction) {
+        auto extreme = [direction](utils::Int a, utils::Int b) {
+            return direction > 0 ? utils::max(a, b) : utils::min(a, b);
+        };
+        Lane initial{0, 0, ddg::AccessMode(), false};
+        utils::Vec<Lane> lanes(num_lanes, initial);
+
+        // The bound imposed by all statements processed thus far, which is
+        // what a barrier depends on.
+        utils::Int all = 0;
+
+        utils::UInt num_statements = block->statements.size();
+        for (utils::UInt i = 0; i < num_statements; i++) {
+            auto index = direction > 0 ? i : num_statements - 1 - i;
+            const auto &statement = block->statements[index];
+            auto begin = offsets[index];
+            auto end = offsets[index + 1];
+
+            // Determine the bound on the statement from its accesses.
+            utils::Int bound = lanes[0].before;
+            for (auto a = begin; a < end; a++) {
+                const auto &access = accesses[a];
+                const auto &lane = lanes[access.lane];
+                if (access.lane == 0) {
+                    bound = extreme(bound, all);
+                } else if (lane.open && lane.mode.commutes_with(access.mode)) {
+                    bound = extreme(bound, lane.before);
+                } else {
+                    bound = extreme(bound, extreme(lane.before, lane.group));
+                }
+            }
+
+            // Schedule the statement.
+            auto duration = (utils::Int)ir::get_duration_of_statement(statement);
+            utils::Int frontier;
+            if (direction > 0) {
+                statement->cycle = bound;
+                frontier = bound + duration;
+            } else {
+                statement->cycle = bound - duration;
+                frontier = statement->cycle;
+            }
+            all = extreme(all, frontier);
+
+            // Update the frontiers. Barriers bound everything that follows
+            // them, so there is no need to touch the other lanes for them.
+            for (auto a = begin; a < end; a++) {
+                const auto &access = accesses[a];
+                auto &lane = lanes[access.lane];
+                if (access.lane == 0) {
+                    lane.before = extreme(lane.before, frontier);
+                } else if (lane.open && lane.mode.commutes_with(access.mode)) {
+                    lane.group = extreme(lane.group, frontier);
+                } else {
+                    if (lane.open) {
+                        lane.before = extreme(lane.before, lane.group);
+                    }
+                    lane.group = frontier;
+                    lane.mode = access.mode;
+                    lane.open = true;
+                }
+            }
+
+        }
+
+        // Adjust the cycles such that the block starts at cycle 0.
+        if (direction < 0) {
+            for (const auto &statement : block->statements) {
+                statement->cycle -= all;
+            }
+        }
+
+    }
+
+public:
+
+    /**
+     * Creates a new frontier scheduler.
+     */
+    FrontierScheduler(
+        const ir::Ref &ir,
+        const ir::BlockBaseRef &block,
+        utils::Bool commute_multi_qubit,
+        utils::Bool commute_single_qubit
+    ) :
+        ir(ir),
+        block(block),
+        gatherer(ir),
+        num_qubits(ir::get_num_qubits(ir)),
+        qubits(ir->platform->qubits.get_ptr().get()),
+        implicit_bit_type(nullptr),
+        num_lanes(1 + 2 * num_qubits)
+    {
+        gatherer.disable_multi_qubit_commutation = !commute_multi_qubit;
+        gatherer.disable_single_qubit_commutation = !commute_single_qubit;
+        if (!ir->platform->implicit_bit_type.empty()) {
+            implicit_bit_type = ir->platform->implicit_bit_type.get_ptr().get();
+        }
+    }
+
+    /**
+     * Actually does the scheduling. Returns false and leaves the block
+     * unchanged if the block contains references that can't be tracked.
+     */
+    utils::Bool run(utils::Int direction) {
+        QL_ASSERT(direction == 1 || direction == -1);
+        if (!gather()) {
+            return false;
+        }
+        schedule(direction);
+
+        // Sort the statements by cycle.
+        std::stable_sort(
+            block->statements.begin(),
+            block->statements.end(),
+            [](const ir::StatementRef &lhs, const ir::StatementRef &rhs) {
+                return lhs->cycle < rhs->cycle;
+            }
+        );
+
+        return true;
+    }
+
+};
+
+/**
+ * Schedules the statements of the given block as soon as possible (direction
+ * 1) or as late as possible (direction -1) without resource constraints, and
+ * sorts them by cycle, with cycle numbers starting at zero. The result is
+ * identical to building the data dependency graph for the block using the same
+ * commutation rules and running the Scheduler on it with no resources,
+ * followed by Scheduler::convert_cycles(). Returns false and leaves the block
+ * unchanged if the block contains references that can't be tracked without
+ * the graph.
+ */
+utils::Bool schedule_without_resources(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    utils::Int direction,
+    utils::Bool commute_multi_qubit,
+    utils::Bool commute_single_qubit
+) {
+    QL_TRACE_SCOPE("sch.schedule_without_resources");
+    return FrontierScheduler(
+        ir, block, commute_multi_qubit, commute_single_qubit
+    ).run(direction);
+}
+
+} // namespace sch
+} // namespace com
+} // namespace ql
@@ -4,7 +4,9 @@
 
 #include "ql/com/sch/heuristics.h"
 
+#include <algorithm>
 #include "ql/com/ddg/ops.h"
+#include "ql/com/ddg/build.h"
 
 namespace ql {
 namespace com {
@@ -29,6 +31,15 @@ utils::Str TrivialHeuristic::operator()(
     return "-";
 }
 
+/**
+ * Sort key for TrivialHeuristic.
+ */
+utils::UInt TrivialHeuristic::get_key(
+    const ir::StatementRef &val
+) const {
+    return 0;
+}
+
 /**
  * Comparator implementation for CriticalPathHeuristic.
  */
@@ -48,12 +59,21 @@ utils::Str CriticalPathHeuristic::operator()(
     return utils::to_string(utils::abs(val->cycle));
 }
 
+/**
+ * Sort key for CriticalPathHeuristic.
+ */
+utils::UInt CriticalPathHeuristic::get_key(
+    const ir::StatementRef &val
+) const {
+    return utils::abs(val->cycle);
+}
+
 /**
  * Returns the Criticality annotation for the given statement, or returns
  * zero criticality if no statement exist.
  */
 const DeepCriticality &DeepCriticality::get(const ir::StatementRef &statement) {
-    if (auto ptr = statement->get_annotation_ptr<DeepCriticality>()) {
+    if (auto ptr = ir::get_annotation_ptr<DeepCriticality>(*statement)) {
         return *ptr;
     } else {
         static const DeepCriticality EMPTY{};
@@ -62,23 +82,11 @@ const DeepCriticality &DeepCriticality::get(const ir::StatementRef &statement) {
 }
 
 /**
- * Compares the criticality of two Criticality annotations.
+ * Compares the criticality of two Criticality annotations by means of their
+ * rank.
  */
 utils::Bool DeepCriticality::operator<(const DeepCriticality &other) const {
-
-    // The node with the largest shallow criticality wins.
-    if (critical_path_length > other.critical_path_length) return false;
-    if (critical_path_length < other.critical_path_length) return true;
-
-    // The nodes have equal shallow criticality. The one with dependent
-    // nodes wins.
-    if (other.most_critical_dependent.empty()) return false;
-    if (most_critical_dependent.empty()) return true;
-
-    // Both nodes have dependent nodes. Recursively check their
-    // criticality.
-    return get(most_critical_dependent) < get(other.most_critical_dependent);
-
+    return rank < other.rank;
 }
 
 /**
@@ -92,64 +100,6 @@ std::ostream &operator<<(std::ostream &os, const DeepCriticality &dc) {
     return os;
 }
 
-/**
- * Ensures that a valid criticality annotation exists for the given
- * statement. This will recursively ensure that dependent statements are
- * annotated, because this is needed to compute which of the dependent
- * statements is the most critical for deep criticality. The set tracks
- * which statements have valid annotations (there may be stray annotations
- * from previous scheduling operations that we must be sure to override).
- */
-void DeepCriticality::ensure_annotation(
-    const ir::StatementRef &statement,
-    utils::Set<ir::StatementRef> &annotated
-) {
-
-    // If insertion into the set succeeds, we haven't annotated this
-    // statement yet.
-    if (annotated.insert(statement).second) {
-        DeepCriticality criticality;
-
-        // Determine the critical path length for shallow criticality.
-        // Because the schedule used to determine criticality is constructed
-        // in reverse order from the list scheduler it is intended for,
-        // instructions that could be scheduled quickly have lower
-        // criticality. So, the criticality of an instruction is simply its
-        // distance from the source node of the reversed DDG, which is 0 by
-        // definition before the cycles adjusted, so this is just the
-        // absolute value.
-        criticality.critical_path_length = utils::abs(statement->cycle);
-
-        // Find the most critical dependent statement for the given
-        // scheduling direction.
-        for (const auto &dependent : com::ddg::get_node(statement)->successors) {
-            const auto &dependent_stmt = dependent.first;
-
-            // Make sure the dependent statement has a criticality
-            // annotation already.
-            ensure_annotation(dependent_stmt, annotated);
-
-            // If the dependent statement is more critical than the most
-            // critical dependent found thus far, replace it.
-            if (
-                criticality.most_critical_dependent.empty() ||
-                DeepCriticality::Heuristic()(criticality.most_critical_dependent, dependent_stmt)
-            ) {
-                criticality.most_critical_dependent = dependent_stmt;
-            }
-
-        }
-
-        // Attach the annotation.
-        statement->set_annotation<DeepCriticality>(criticality);
-
-    }
-
-    // There must now be a criticality annotation.
-    QL_ASSERT(statement->has_annotation<DeepCriticality>());
-
-}
-
 /**
  * Annotates the instructions in block with DeepCriticality structures, such
  * that DeepCriticality::Heuristic() can be used as scheduling heuristic.
@@ -159,19 +109,132 @@ void DeepCriticality::ensure_annotation(
  * numbers still referenced such that the source node is at cycle 0.
  */
 void DeepCriticality::compute(const ir::SubBlockRef &block) {
+    compute(block, com::ddg::CompactGraph(block));
+}
 
-    // Tracks which statements have already been annotated by *this call*
-    // (we can't just check whether the annotation already exists, because
-    // it could be an out-of-date annotation added by an earlier call).
-    utils::Set<ir::StatementRef> annotated;
+/**
+ * Same as compute(block), but uses the given, previously constructed
+ * compact form of the data dependency graph of the block.
+ *
+ * Deep criticality is the lexicographical order of the sequence of critical
+ * path lengths along the chain of most critical dependents of a node, with a
+ * longer sequence winning when one is a prefix of the other. Because the
+ * critical path length never increases along a DDG edge (the edge weights are
+ * non-negative in the scheduling direction), this can be ranked without deep
+ * comparisons. The nodes are grouped by critical path length and processed by
+ * increasing length, and in reverse topological order within a group, such
+ * that the dependents of a node have always been processed before the node
+ * itself. Within a group with length L, the chain of a node is then L repeated
+ * k + 1 times for some k, followed by the chain of a node from an earlier
+ * group, which already has its final rank r (or 0 if the chain ends). So,
+ * within the group, nodes are ordered by (k, r), and the group as a whole is
+ * ranked after the earlier groups.
+ */
+void DeepCriticality::compute(const ir::SubBlockRef &block, const com::ddg::CompactGraph &graph) {
+    auto num_nodes = graph.get_num_nodes();
+
+    // Order the nodes by increasing critical path length, and in reverse
+    // topological order for equal length. Edges of a forward DDG always go
+    // from lower to higher node indices, and vice versa for a reversed DDG.
+    // The source node is nobody's dependent, so it doesn't need an annotation.
+    utils::Vec<utils::UInt> critical_path_length(num_nodes);
+    utils::Vec<utils::UInt> nodes;
+    nodes.reserve(num_nodes);
+    for (utils::UInt node = 0; node < num_nodes; node++) {
+        critical_path_length[node] = utils::abs(graph.statements[node]->cycle);
+        if (node != graph.source) {
+            nodes.push_back(node);
+        }
+    }
+    auto direction = graph.direction;
+    std::sort(nodes.begin(), nodes.end(), [&](utils::UInt lhs, utils::UInt rhs) {
+        if (critical_path_length[lhs] != critical_path_length[rhs]) {
+            return critical_path_length[lhs] < critical_path_length[rhs];
+        }
+        return direction > 0 ? lhs > rhs : lhs < rhs;
+    });
+
+    // The (k, r) pair for each node as described above, the final rank of
+    // the nodes in earlier groups, and the most critical dependent for each
+    // node.
+    utils::Vec<utils::UInt> chain_repeat(num_nodes, 0);
+    utils::Vec<utils::UInt> chain_rank(num_nodes, 0);
+    utils::Vec<utils::UInt> rank(num_nodes, 0);
+    utils::Vec<utils::UInt> most_critical(num_nodes, utils::UMAX);
+
+    // Returns whether node lhs is less critical than node rhs, for nodes
+    // that have already been processed.
+    auto less_critical = [&](utils::UInt lhs, utils::UInt rhs) {
+        if (critical_path_length[lhs] != critical_path_length[rhs]) {
+            return critical_path_length[lhs] < critical_path_length[rhs];
+        }
+        if (chain_repeat[lhs] != chain_repeat[rhs]) {
+            return chain_repeat[lhs] < chain_repeat[rhs];
+        }
+        return chain_rank[lhs] < chain_rank[rhs];
+    };
+
+    utils::Vec<utils::Bool> processed(num_nodes, false);
+    utils::UInt next_rank = 1;
+    utils::UInt group_begin = 0;
+    while (group_begin < nodes.size()) {
+        auto length = critical_path_length[nodes[group_begin]];
+        auto group_end = group_begin;
+        while (group_end < nodes.size() && critical_path_length[nodes[group_end]] == length) {
+            auto node = nodes[group_end++];
+
+            // Find the most critical dependent statement for the given
+            // scheduling direction. Ties are broken in favor of the first
+            // dependent.
+            auto &best = most_critical[node];
+            for (auto edge : graph.get_successors(node)) {
+                auto dependent = graph.edge_successor[edge];
+                QL_ASSERT(processed[dependent]);
+                if (best == utils::UMAX || less_critical(best, dependent)) {
+                    best = dependent;
+                }
+            }
+
+            // Determine the (k, r) pair for the node.
+            if (best == utils::UMAX) {
+                chain_repeat[node] = 0;
+                chain_rank[node] = 0;
+            } else if (critical_path_length[best] == length) {
+                chain_repeat[node] = chain_repeat[best] + 1;
+                chain_rank[node] = chain_rank[best];
+            } else {
+                chain_repeat[node] = 0;
+                chain_rank[node] = rank[best];
+            }
+            processed[node] = true;
+
+        }
+
+        // Assign the final ranks for this group.
+        std::sort(
+            nodes.begin() + group_begin, nodes.begin() + group_end,
+            less_critical
+        );
+        for (auto i = group_begin; i < group_end; i++) {
+            if (i > group_begin && less_critical(nodes[i - 1], nodes[i])) {
+                next_rank++;
+            }
+            rank[nodes[i]] = next_rank;
+        }
+        next_rank++;
+        group_begin = group_end;
 
-    // Annotate all the statements in the block. The order doesn't matter:
-    // when a dependent statement doesn't yet have the criticality
-    // annotation needed to determine deep criticality, it will be computed
-    // automatically using recursion, and if criticality has already been
-    // computed the function becomes no-op.
-    for (const auto &statement : block->statements) {
-        ensure_annotation(statement, annotated);
+    }
+
+    // Attach the annotations.
+    for (auto node : nodes) {
+        DeepCriticality criticality;
+        criticality.critical_path_length = critical_path_length[node];
+        if (most_critical[node] != utils::UMAX) {
+            criticality.most_critical_dependent = graph.statements[most_critical[node]];
+        }
+        criticality.rank = rank[node];
+        ir::set_annotation<DeepCriticality>(*graph.statements[node], criticality);
     }
 
 }
@@ -196,19 +259,76 @@ utils::Str DeepCriticality::Heuristic::operator()(
     return utils::to_string(get(val));
 }
 
+/**
+ * Sort key for DeepCriticality::Heuristic.
+ */
+utils::UInt DeepCriticality::Heuristic::get_key(
+    const ir::StatementRef &val
+) const {
+    return get(val).rank;
+}
+
 /**
  * Clears the deep criticality annotations from the given block.
  */
 void DeepCriticality::clear(const ir::SubBlockRef &block) {
     auto source = com::ddg::get_source(block);
-    if (!source.empty()) source->erase_annotation<DeepCriticality>();
-    auto sink = com::ddg::get_source(block);
-    if (!sink.empty()) sink->erase_annotation<DeepCriticality>();
+    if (!source.empty()) ir::erase_annotation<DeepCriticality>(*source);
+    auto sink = com::ddg::get_sink(block);
+    if (!sink.empty()) ir::erase_annotation<DeepCriticality>(*sink);
     for (const auto &statement : block->statements) {
-        statement->erase_annotation<DeepCriticality>();
+        ir::erase_annotation<DeepCriticality>(*statement);
     }
 }
 
+/**
+ * Adds the given feedback latency in cycles to the weights of the edges of the
+ * given compact data dependency graph that carry a classical feedback
+ * dependency. See the header for details.
+ */
+void add_feedback_latency(
+    const ir::Ref &ir,
+    com::ddg::CompactGraph &graph,
+    utils::UInt latency
+) {
+    if (!latency) return;
+
+    // Gather the objects read by the condition of each conditional
+    // instruction. Unconditional instructions have a literal true condition,
+    // so they end up without any events.
+    com::ddg::EventGatherer gatherer(ir);
+    utils::Vec<com::ddg::Events> conditions(graph.get_num_nodes());
+    for (utils::UInt node = 0; node < graph.get_num_nodes(); node++) {
+        auto insn = graph.statements[node]->as_conditional_instruction();
+        if (!insn || insn->condition->as_bit_literal()) continue;
+        gatherer.reset();
+        gatherer.add_expression(ir::prim::OperandMode::READ, insn->condition);
+        conditions[node] = gatherer.get();
+    }
+
+    // Weights of reversed graphs are negated, so the latency is added in the
+    // direction of the graph.
+    auto delta = graph.direction * (utils::Int)latency;
+    for (utils::UInt edge = 0; edge < graph.edge_weight.size(); edge++) {
+        auto dependent = graph.direction > 0 ? graph.edge_successor[edge] : graph.edge_predecessor[edge];
+        const auto &condition = conditions[dependent];
+        if (condition.empty()) continue;
+        utils::Bool feedback = false;
+        for (auto i = graph.cause_offsets[edge]; i < graph.cause_offsets[edge + 1] && !feedback; i++) {
+            for (const auto &event : condition) {
+                if (!graph.causes[i].reference.is_provably_distinct_from(event.first)) {
+                    feedback = true;
+                    break;
+                }
+            }
+        }
+        if (feedback) {
+            graph.edge_weight[edge] += delta;
+        }
+    }
+
+}
+
 } // namespace sch
 } // namespace com
 } // namespace ql
@@ -0,0 +1,89 @@
+#include "ql/ir/compat/compat.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/describe.h"
+#include "ql/com/ddg/build.h"
+#include "ql/com/ddg/ops.h"
+#include "ql/com/ddg/compact.h"
+#include "ql/com/sch/scheduler.h"
+#include "ql/com/sch/frontier.h"
+
+using namespace ql;
+
+/**
+ * Builds a pseudo-random kernel mixing single- and two-qubit gates,
+ * measurements, and waits.
+ */
+static ir::compat::ProgramRef make_program(const ir::compat::PlatformRef &plat) {
+    auto program = utils::make<ir::compat::Program>("prog", plat, 7, 32, 10);
+    auto kernel = utils::make<ir::compat::Kernel>("kernel", plat, 7, 32, 10);
+    utils::UInt state = 12345;
+    for (utils::UInt i = 0; i < 400; i++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        auto r = state >> 33;
+        auto q0 = r % 7;
+        auto q1 = (q0 + 1 + (r >> 3) % 6) % 7;
+        switch ((r >> 8) % 10) {
+            case 0: kernel->x(q0); break;
+            case 1: kernel->y(q0); break;
+            case 2: kernel->z(q0); break;
+            case 3: kernel->hadamard(q0); break;
+            case 4: case 5: kernel->cz(q0, q1); break;
+            case 6: kernel->cnot(q0, q1); break;
+            case 7: kernel->measure(q0); break;
+            case 8: kernel->wait({q0, q1}, 40); break;
+            default:
+                if ((r >> 12) % 8 == 0) {
+                    kernel->wait({}, 0);
+                } else {
+                    kernel->x(q1);
+                }
+                break;
+        }
+    }
+    program->add(kernel);
+    return program;
+}
+
+/**
+ * Returns the schedule of the given block as a list of statement descriptions
+ * and cycles, in block order.
+ */
+static utils::Vec<utils::Pair<utils::Str, utils::Int>> get_schedule(const ir::BlockBaseRef &block) {
+    utils::Vec<utils::Pair<utils::Str, utils::Int>> schedule;
+    for (const auto &statement : block->statements) {
+        schedule.push_back({ir::describe(statement), statement->cycle});
+    }
+    return schedule;
+}
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+    auto program = make_program(plat);
+
+    // The frontier scheduler must yield exactly the same schedule as the
+    // DDG-based scheduler without resources, in both directions and with and
+    // without commutation.
+    for (utils::Int direction : {1, -1}) {
+        for (utils::Bool commute : {false, true}) {
+            auto ddg_ir = ir::convert_old_to_new(program);
+            auto ddg_block = ddg_ir->program->blocks[0];
+            com::ddg::build(ddg_ir, ddg_block, commute, commute);
+            utils::Ptr<com::ddg::CompactGraph> graph;
+            graph.emplace(ddg_block, direction);
+            com::sch::Scheduler<> scheduler(ddg_block, graph.as_const());
+            scheduler.run();
+            scheduler.convert_cycles();
+            com::ddg::clear(ddg_block);
+
+            auto frontier_ir = ir::convert_old_to_new(program);
+            auto frontier_block = frontier_ir->program->blocks[0];
+            QL_ASSERT(com::sch::schedule_without_resources(
+                frontier_ir, frontier_block, direction, commute, commute
+            ));
+
+            QL_ASSERT(get_schedule(frontier_block) == get_schedule(ddg_block));
+        }
+    }
+
+    return 0;
+}
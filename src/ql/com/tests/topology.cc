@@ -0,0 +1,143 @@
+#include "ql/com/topology.h"
+
+using namespace ql;
+
+int main() {
+
+    // Specified connectivity: the neighbors are stored in the adjacency
+    // arrays, sorted clockwise starting from 12:00.
+    com::Topology grid(4, utils::parse_json(R"({
+        "form": "xy",
+        "qubits": [
+            {"id": 0, "x": 1, "y": 1},
+            {"id": 1, "x": 1, "y": 0},
+            {"id": 2, "x": 2, "y": 1},
+            {"id": 3, "x": 0, "y": 1}
+        ],
+        "edges": [
+            {"src": 0, "dst": 3},
+            {"src": 0, "dst": 1},
+            {"src": 0, "dst": 2},
+            {"src": 1, "dst": 0},
+            {"src": 2, "dst": 0},
+            {"src": 3, "dst": 0}
+        ]
+    })"));
+    auto span = grid.get_neighbor_span(0);
+    QL_ASSERT(span.size() == 3);
+    QL_ASSERT(grid.get_neighbors(0) == utils::List<utils::UInt>(span.begin(), span.end()));
+    QL_ASSERT(grid.get_neighbor_span(1).size() == 1);
+    QL_ASSERT(*grid.get_neighbor_span(1).begin() == 0);
+    QL_ASSERT(grid.get_distance(1, 2) == 2);
+
+    // Disabling couplers only affects the copy it's done on, removes the
+    // coupler in both directions, and repairs the distances.
+    auto degraded = grid;
+    degraded.disable({{2, 0}});
+    QL_ASSERT(degraded.get_neighbor_span(0).size() == 2);
+    QL_ASSERT(degraded.get_neighbor_span(2).empty());
+    QL_ASSERT(degraded.get_distance(1, 2) == utils::MAX);
+    QL_ASSERT(degraded.get_distance(1, 3) == 2);
+    QL_ASSERT(degraded.get_edge_index({0, 2}) == -1);
+    QL_ASSERT(degraded.get_json()["edges"].size() == 4);
+    QL_ASSERT(grid.get_distance(1, 2) == 2);
+    QL_ASSERT(grid.get_neighbor_span(0).size() == 3);
+
+    // Disabling a qubit disables all its couplers. In this ring, that makes
+    // the paths around the qubit longer.
+    com::Topology ring(6, utils::parse_json(R"({
+        "edges": [
+            {"src": 0, "dst": 1}, {"src": 1, "dst": 0},
+            {"src": 1, "dst": 2}, {"src": 2, "dst": 1},
+            {"src": 2, "dst": 3}, {"src": 3, "dst": 2},
+            {"src": 3, "dst": 4}, {"src": 4, "dst": 3},
+            {"src": 4, "dst": 5}, {"src": 5, "dst": 4},
+            {"src": 5, "dst": 0}, {"src": 0, "dst": 5}
+        ]
+    })"));
+    QL_ASSERT(ring.get_distance(1, 5) == 2);
+    ring.disable({}, {0});
+    QL_ASSERT(ring.get_distance(1, 5) == 4);
+    QL_ASSERT(ring.get_distance(5, 1) == 4);
+    QL_ASSERT(ring.get_distance(2, 4) == 2);
+    QL_ASSERT(ring.get_distance(0, 3) == utils::MAX);
+    QL_ASSERT(ring.get_neighbor_span(1).size() == 1);
+
+    // Large topologies compute their distance rows on demand, and keep only
+    // distance_cache_rows of them. Looking up more sources than that evicts
+    // rows, which must then be recomputed correctly.
+    utils::UInt num_large = 5000;
+    auto large_json = utils::parse_json(R"({"distance_cache_rows": 3})");
+    large_json["edges"] = utils::Json::array();
+    for (utils::UInt q = 0; q < num_large; q++) {
+        auto n = (q + 1) % num_large;
+        large_json["edges"].push_back({{"src", q}, {"dst", n}});
+        large_json["edges"].push_back({{"src", n}, {"dst", q}});
+    }
+    com::Topology large(num_large, large_json);
+    for (utils::UInt round = 0; round < 3; round++) {
+        for (utils::UInt source = 0; source < 10; source++) {
+            for (utils::UInt target : {source, source + 1, source + 2500, source + 4999}) {
+                auto expected_distance = (target - source) % num_large;
+                expected_distance = utils::min(expected_distance, num_large - expected_distance);
+                QL_ASSERT(large.get_distance(source, target % num_large) == expected_distance);
+            }
+        }
+    }
+    large.disable({{0, 1}});
+    QL_ASSERT(large.get_distance(0, 1) == num_large - 1);
+    QL_ASSERT(large.get_distance(9, 11) == 2);
+
+    // The row budget must be positive.
+    utils::Bool rejected = false;
+    try {
+        com::Topology(num_large, utils::parse_json(R"({"distance_cache_rows": 0, "edges": []})"));
+    } catch (utils::Exception &) {
+        rejected = true;
+    }
+    QL_ASSERT(rejected);
+
+    // Full connectivity with coordinates: the neighbors are stored, sorted
+    // clockwise starting from 12:00, rather than enumerated.
+    auto square_json = utils::parse_json(R"({"form": "xy", "connectivity": "full"})");
+    square_json["qubits"] = utils::Json::array();
+    for (utils::UInt q = 0; q < 9; q++) {
+        square_json["qubits"].push_back({{"id", q}, {"x", q % 3}, {"y", q / 3}});
+    }
+    com::Topology square(9, square_json);
+    QL_ASSERT(square.get_neighbors(4) == utils::List<utils::UInt>({7, 8, 5, 2, 1, 0, 3, 6}));
+    span = square.get_neighbor_span(4);
+    QL_ASSERT(square.get_neighbors(4) == utils::List<utils::UInt>(span.begin(), span.end()));
+
+    // Full connectivity without coordinates: the neighbors are enumerated.
+    com::Topology full(5, utils::parse_json("{}"));
+    utils::UInt expected = 0;
+    for (auto n : full.get_neighbor_span(2)) {
+        if (expected == 2) expected++;
+        QL_ASSERT(n == expected);
+        expected++;
+    }
+    QL_ASSERT(expected == 5);
+    QL_ASSERT(full.get_neighbor_span(2).size() == 4);
+    QL_ASSERT(full.get_neighbors(2).size() == 4);
+
+    // Multi-core full connectivity: inter-core links only exist between
+    // communication qubits.
+    com::Topology cores(8, utils::parse_json(R"({
+        "number_of_cores": 2,
+        "comm_qubits_per_core": 1
+    })"));
+    for (utils::UInt q = 0; q < 8; q++) {
+        auto neighbors = cores.get_neighbors(q);
+        QL_ASSERT(neighbors.size() == cores.get_neighbor_span(q).size());
+        for (auto n : cores.get_neighbor_span(q)) {
+            QL_ASSERT(n != q);
+            QL_ASSERT(
+                !cores.is_inter_core_hop(q, n) ||
+                (cores.is_comm_qubit(q) && cores.is_comm_qubit(n))
+            );
+        }
+    }
+
+    return 0;
+}
@@ -5,6 +5,10 @@
 
 #include "ql/com/topology.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "ql/utils/set.h"
 #include "ql/utils/logger.h"
 
 namespace ql {
@@ -66,7 +70,8 @@ void Topology::dump_docs(std::ostream &os, const utils::Str &line_prefix) {
         "number_of_cores": <optional positive integer, default 1>,
         "comm_qubits_per_core": <optional positive integer, num_qubits / number_of_cores>,
         "connectivity": <optional string, either "specified" or "full">,
-        "edges": <mandatory array of objects for connectivity="specified", unused for "full">
+        "edges": <mandatory array of objects for connectivity="specified", unused for "full">,
+        "distance_cache_rows": <optional positive integer, default 1024>
         ...
     }
     ```
@@ -136,27 +141,385 @@ void Topology::dump_docs(std::ostream &os, const utils::Str &line_prefix) {
     If the `"connectivity"` key is missing, its value is derived from whether
     an "edges" list is given.
 
+    For specified connectivity with more than 4096 qubits, the distances
+    between qubits are not precomputed, but computed one source qubit at a
+    time when first needed. `"distance_cache_rows"` sets how many of these
+    rows are kept, and must be at least 1; each row takes two bytes per
+    qubit. When more are needed, the least recently used rows are discarded
+    and computed again later.
+
     Any additional keys in the topology root object are silently ignored, as
     other parts of OpenQL may use the structure as well.
     )");
 }
 
 /**
- * Generates the neighbor list for the given qubit for full connectivity.
+ * Returns the neighbors of qubit that continue a path to the target
+ * qubit in at most budget hops, i.e. the neighbors that are at most
+ * budget - 1 hops away from the target. The state must be reachable
+ * from the source state the DAG was constructed for.
+ */
+const Topology::Neighbors &Topology::PathDag::get_next_hops(Qubit qubit, utils::UInt budget) const {
+    return next_hops.at({qubit, budget});
+}
+
+/**
+ * Least-recently-used cache for the path DAGs returned by get_path_dag().
  */
-void Topology::generate_neighbors_list(utils::UInt qs, Neighbors &qubits) const {
+struct Topology::PathDagCache {
+
+    /**
+     * Cache key, consisting of source qubit, target qubit, and budget.
+     */
+    using Key = utils::Pair<QubitPair, utils::UInt>;
+
+    /**
+     * Mutex protecting the cache, as the mapper may request paths from
+     * multiple threads.
+     */
+    std::mutex mutex;
+
+    /**
+     * The keys of the cached DAGs, from most to least recently used.
+     */
+    utils::List<Key> usage;
+
+    /**
+     * The cached DAGs, along with their position in the usage list.
+     */
+    utils::Map<Key, utils::Pair<CPathDagRef, utils::List<Key>::iterator>> entries;
+
+};
+
+/**
+ * Cache of distance matrix rows, computed on-demand for topologies that are
+ * too large for a complete distance matrix.
+ *
+ * The cache holds at most a fixed number of rows, stored in buffers that are
+ * allocated when first needed and reused once the cache is full. Lookups
+ * don't take any lock, as the mapper requests distances from multiple threads
+ * and almost all requests hit: each buffer carries a sequence number that is
+ * odd while the buffer is being (re)written, so a reader can detect that the
+ * row it read was replaced underneath it and treat that as a miss. Misses
+ * compute the row without holding any lock, and only take the mutex to
+ * publish it. The row to replace is selected with the CLOCK (second chance)
+ * approximation of least-recently-used eviction, such that hits only need to
+ * set a flag.
+ */
+struct Topology::DistanceRowCache {
+
+    /**
+     * Storage for a single cached row.
+     */
+    struct Buffer {
+
+        /**
+         * Sequence number, odd while the buffer is being written.
+         */
+        std::atomic<utils::UInt> sequence{0};
+
+        /**
+         * The source qubit of the row stored in this buffer.
+         */
+        std::atomic<Qubit> source{0};
+
+        /**
+         * Whether the row was used since the clock hand last passed it.
+         */
+        std::atomic<utils::Bool> referenced{false};
+
+        /**
+         * The distances from the source qubit. These are atomic only such
+         * that reading them while the buffer is being rewritten isn't a data
+         * race; all accesses are relaxed.
+         */
+        std::unique_ptr<std::atomic<std::uint16_t>[]> row;
+
+    };
+
+    /**
+     * The number of qubits, i.e. the size of each row.
+     */
+    const utils::UInt num_qubits;
+
+    /**
+     * For each source qubit, the index of the buffer holding its row plus
+     * one, or zero if the row is not cached.
+     */
+    std::unique_ptr<std::atomic<utils::UInt>[]> slots;
+
+    /**
+     * The row buffers; the size of this vector is the maximum number of
+     * cached rows.
+     */
+    utils::Vec<Buffer> buffers;
+
+    /**
+     * The number of buffers that are in use.
+     */
+    utils::UInt num_used = 0;
+
+    /**
+     * The buffer the clock hand points at.
+     */
+    utils::UInt hand = 0;
+
+    /**
+     * Mutex serializing insertions. Lookups don't use it.
+     */
+    std::mutex mutex;
+
+    /**
+     * Creates an empty cache for the given number of qubits that holds at
+     * most the given number of rows.
+     */
+    DistanceRowCache(utils::UInt num_qubits, utils::UInt max_rows) :
+        num_qubits(num_qubits),
+        slots(new std::atomic<utils::UInt>[num_qubits]),
+        buffers(utils::min(max_rows, num_qubits))
+    {
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            slots[q].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Looks up the distance from source to target, returning whether the row
+     * for source was cached.
+     */
+    utils::Bool lookup(Qubit source, Qubit target, std::uint16_t &distance) {
+        auto index = slots[source].load(std::memory_order_acquire);
+        if (!index) {
+            return false;
+        }
+        auto &buffer = buffers[index - 1];
+        auto sequence = buffer.sequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            return false;
+        }
+        auto owner = buffer.source.load(std::memory_order_relaxed);
+        distance = buffer.row[target].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (owner != source || buffer.sequence.load(std::memory_order_relaxed) != sequence) {
+            return false;
+        }
+        if (!buffer.referenced.load(std::memory_order_relaxed)) {
+            buffer.referenced.store(true, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    /**
+     * Stores the row computed for the given source qubit, evicting another
+     * row if the cache is full. Does nothing if another thread already stored
+     * a row for this source.
+     */
+    void insert(Qubit source, const std::uint16_t *row) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (buffers.empty() || slots[source].load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        // Select a buffer, allocating a new one while the cache isn't full
+        // and evicting an unreferenced row otherwise.
+        utils::UInt index;
+        if (num_used < buffers.size()) {
+            index = num_used++;
+            buffers[index].row.reset(new std::atomic<std::uint16_t>[num_qubits]);
+        } else {
+            while (buffers[hand].referenced.exchange(false, std::memory_order_relaxed)) {
+                hand = (hand + 1) % buffers.size();
+            }
+            index = hand;
+            hand = (hand + 1) % buffers.size();
+            auto evicted = buffers[index].source.load(std::memory_order_relaxed);
+            slots[evicted].store(0, std::memory_order_relaxed);
+        }
+
+        // Rewrite the buffer. Readers that still have its index check the
+        // sequence number and source before trusting what they read.
+        auto &buffer = buffers[index];
+        auto sequence = buffer.sequence.load(std::memory_order_relaxed);
+        buffer.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        buffer.source.store(source, std::memory_order_relaxed);
+        buffer.referenced.store(false, std::memory_order_relaxed);
+        for (utils::UInt q = 0; q < num_qubits; q++) {
+            buffer.row[q].store(row[q], std::memory_order_relaxed);
+        }
+        buffer.sequence.store(sequence + 2, std::memory_order_release);
+        slots[source].store(index + 1, std::memory_order_release);
+    }
+
+};
+
+/**
+ * Parses the topology.distance_cache_rows key, returning the given default if
+ * it is not specified.
+ */
+static utils::UInt parse_distance_cache_rows(const utils::Json &topology, utils::UInt def) {
+    auto it = topology.find("distance_cache_rows");
+    if (it == topology.end()) {
+        return def;
+    } else if (it->type() != utils::Json::value_t::number_unsigned || it->get<utils::UInt>() < 1) {
+        throw utils::Exception("topology.distance_cache_rows key must be a positive integer if specified");
+    }
+    return it->get<utils::UInt>();
+}
+
+/**
+ * Returns the first qubit greater than or equal to qd that is a neighbor of qs
+ * for full connectivity, or num_qubits if there is none.
+ */
+Topology::Qubit Topology::find_implicit_neighbor(Qubit qs, Qubit qd) const {
     QL_ASSERT(connectivity == GridConnectivity::FULL);
 
-    // Generate neighbors for qubit qs for full connectivity per core.
-    for (utils::UInt qd = 0; qd < num_qubits; qd++) {
+    // Full connectivity per core, with inter-core links only between
+    // communication qubits.
+    for (; qd < num_qubits; qd++) {
         if (qs == qd) {
             continue;
         }
         if (is_inter_core_hop(qs, qd) && (!is_comm_qubit(qs) || !is_comm_qubit(qd))) {
             continue;
         }
-        qubits.push_back(qd);
+        break;
     }
+    return qd;
+}
+
+/**
+ * Fills the adjacency arrays from the given neighbor lists, sorting them
+ * clockwise first when the qubits have coordinates.
+ */
+void Topology::build_adjacency(QubitMap<Neighbors> &&neighbors) {
+    neighbor_offsets.clear();
+    neighbor_qubits.clear();
+    neighbor_offsets.reserve(num_qubits + 1);
+    for (Qubit q = 0; q < num_qubits; q++) {
+        neighbor_offsets.push_back(neighbor_qubits.size());
+        auto it = neighbors.find(q);
+        if (it == neighbors.end()) {
+            continue;
+        }
+        if (has_coordinates()) {
+            sort_neighbors_clockwise(q, it->second);
+        }
+        neighbor_qubits.insert(neighbor_qubits.end(), it->second.begin(), it->second.end());
+    }
+    neighbor_offsets.push_back(neighbor_qubits.size());
+}
+
+Topology::NeighborSpan::Iterator::Iterator(
+    const Topology *topology,
+    Qubit qubit,
+    const Qubit *ptr,
+    Qubit current
+) : topology(topology), qubit(qubit), ptr(ptr), current(current) {
+}
+
+Topology::Qubit Topology::NeighborSpan::Iterator::operator*() const {
+    return topology ? current : *ptr;
+}
+
+Topology::NeighborSpan::Iterator &Topology::NeighborSpan::Iterator::operator++() {
+    if (topology) {
+        current = topology->find_implicit_neighbor(qubit, current + 1);
+    } else {
+        ptr++;
+    }
+    return *this;
+}
+
+utils::Bool Topology::NeighborSpan::Iterator::operator==(const Iterator &rhs) const {
+    return ptr == rhs.ptr && current == rhs.current;
+}
+
+utils::Bool Topology::NeighborSpan::Iterator::operator!=(const Iterator &rhs) const {
+    return !(*this == rhs);
+}
+
+Topology::NeighborSpan::Iterator Topology::NeighborSpan::begin() const {
+    if (topology) {
+        return {topology, qubit, nullptr, topology->find_implicit_neighbor(qubit, 0)};
+    } else {
+        return {nullptr, 0, first, 0};
+    }
+}
+
+Topology::NeighborSpan::Iterator Topology::NeighborSpan::end() const {
+    if (topology) {
+        return {topology, qubit, nullptr, topology->num_qubits};
+    } else {
+        return {nullptr, 0, last, 0};
+    }
+}
+
+/**
+ * Returns the number of neighbors. This is linear in the number of qubits for
+ * implicit full connectivity.
+ */
+utils::UInt Topology::NeighborSpan::size() const {
+    if (!topology) {
+        return last - first;
+    }
+    utils::UInt count = 0;
+    for (auto it = begin(); it != end(); ++it) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Returns whether there are no neighbors.
+ */
+utils::Bool Topology::NeighborSpan::empty() const {
+    return begin() == end();
+}
+
+/**
+ * Generates the neighbors of the given qubit that a path to the given target
+ * may continue with, for multi-core topologies. See build_path_dag().
+ */
+void Topology::generate_path_neighbors_list(Qubit qs, Qubit target, Neighbors &qubits) const {
+    QL_ASSERT(connectivity == GridConnectivity::FULL);
+    utils::UInt nqpc = num_qubits / num_cores;
+    utils::UInt source_core = get_core_index(qs);
+    utils::UInt target_core = get_core_index(target);
+
+    // Qubits within the current core.
+    for (utils::UInt qd = source_core * nqpc; qd < (source_core + 1) * nqpc; qd++) {
+        if (qd != qs) {
+            qubits.push_back(qd);
+        }
+    }
+
+    // Communication qubits of the target core, if we're not there yet.
+    if (source_core != target_core && is_comm_qubit(qs)) {
+        for (utils::UInt qd = target_core * nqpc; qd < (target_core + 1) * nqpc; qd++) {
+            if (is_comm_qubit(qd)) {
+                qubits.push_back(qd);
+            }
+        }
+    }
+
+    if (has_coordinates()) {
+        sort_neighbors_clockwise(qs, qubits);
+    }
+}
+
+/**
+ * Sorts the given neighbor list of the given qubit clockwise starting from
+ * 12:00. Qubits must have coordinates.
+ */
+void Topology::sort_neighbors_clockwise(Qubit qubit, Neighbors &nbl) const {
+    const auto &origin = xy_coord.at(qubit);
+    nbl.sort(
+        [this, &origin](const utils::UInt &i, const utils::UInt &j) {
+            return get_angle(origin, xy_coord.at(i)) <
+                   get_angle(origin, xy_coord.at(j));
+        }
+    );
 }
 
 /**
@@ -171,6 +534,7 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
     // Save number of qubits and original JSON.
     this->num_qubits = num_qubits;
     this->json = topology;
+    path_dag_cache.emplace();
 
     // Handle grid form key.
     auto it = topology.find("form");
@@ -326,6 +690,9 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
         throw utils::Exception("topology.comm_qubits_per_core is larger than total number of qubits per core");
     }
 
+    // Handle the distance row cache size.
+    distance_cache_rows = parse_distance_cache_rows(topology, DEFAULT_DISTANCE_CACHE_ROWS);
+
     // Handle connectivity key.
     it = topology.find("connectivity");
     if (it == topology.end()) {
@@ -347,6 +714,7 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
     // Handle edges.
     max_edge = 0;
     if (connectivity == GridConnectivity::SPECIFIED) {
+        QubitMap<Neighbors> neighbors;
 
         // Parse connectivity from JSON.
         it = topology.find("edges");
@@ -424,59 +792,54 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
 
             }
         }
-
-        // Compute distances between all qubits using Floyd-Warshall. When not
-        // connected, distance remains set to utils::MAX.
-        distance.resize(num_qubits);
-        for (utils::UInt i = 0; i < num_qubits; i++) {
-
-            // Initialize all distances to maximum value...
-            distance[i].resize(num_qubits, utils::MAX);
-
-            // ... except the self-edge, which is 0 distance...
-            distance[i][i] = 0;
-
-            // ... and the neighbors, which get distance 1.
-            for (utils::UInt j : neighbors.get(i)) {
-                distance[i][j] = 1;
-            }
-
+        build_adjacency(std::move(neighbors));
+
+        // Distances are stored in 16 bits, with the maximum value reserved
+        // for unconnected qubits. No path can be longer than the number of
+        // qubits minus one, so this is fine as long as the number of qubits
+        // can be stored.
+        if (num_qubits >= NO_PATH) {
+            throw utils::Exception(
+                "topology.connectivity=\"specified\" is not supported for " +
+                utils::to_string(num_qubits) + " qubits"
+            );
         }
 
-        // Find shorter distances by gradually including more qubits (k) in path
-        for (utils::UInt k = 0; k < num_qubits; k++) {
+        // Compute distances between all qubits using a breadth-first search
+        // from each qubit, which is much faster than Floyd-Warshall for the
+        // sparse connectivity graphs of real platforms. For very large
+        // topologies, the quadratic matrix would dominate load time and
+        // memory, so rows are computed when they are first needed instead.
+        if (num_qubits <= MAX_QUBITS_FOR_DISTANCE_MATRIX) {
+            distance.resize(num_qubits * num_qubits);
             for (utils::UInt i = 0; i < num_qubits; i++) {
-                for (utils::UInt j = 0; j < num_qubits; j++) {
-
-                    // Prevent overflow in the sum below by explicitly checking for
-                    // MAX.
-                    if (distance[i][k] == utils::MAX) {
-                        continue;
-                    }
-                    if (distance[k][j] == utils::MAX) {
-                        continue;
-                    }
-
-                    if (distance[i][j] > distance[i][k] + distance[k][j]) {
-                        distance[i][j] = distance[i][k] + distance[k][j];
-                    }
-                }
+                compute_distance_row(i, &distance[i * num_qubits]);
             }
+        } else {
+            distance_rows.emplace(num_qubits, distance_cache_rows);
         }
 
     } else if (connectivity == GridConnectivity::FULL) {
 
-        // If we have full connectivity and the qubits have coordinates, we
-        // want neighbor lists for each qubit sorted based on angle. So, in this
-        // case, we should generate the neighbors list. If not, we can easily
-        // figure out neighbors on-the-fly.
+        // With full connectivity, neighbors are enumerated on-the-fly by
+        // NeighborSpan, as storing them would take memory quadratic in the
+        // number of qubits. The exception is when the qubits have
+        // coordinates, as the neighbors must then be sorted clockwise; the
+        // coordinates are listed explicitly in the configuration, so the
+        // number of qubits is small enough for this in practice.
         if (has_coordinates()) {
-
-            // Pre-generate full connectivity.
-            for (utils::UInt qs = 0; qs < num_qubits; qs++) {
-                generate_neighbors_list(qs, neighbors.set(qs));
+            QubitMap<Neighbors> neighbors;
+            for (Qubit qs = 0; qs < num_qubits; qs++) {
+                auto &list = neighbors.set(qs);
+                for (
+                    auto qd = find_implicit_neighbor(qs, 0);
+                    qd < num_qubits;
+                    qd = find_implicit_neighbor(qs, qd + 1)
+                ) {
+                    list.push_back(qd);
+                }
             }
-
+            build_adjacency(std::move(neighbors));
         }
 
     }
@@ -490,19 +853,6 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
 
     }
 
-    // When qubits have coordinates, sort neighbor lists clockwise starting from
-    // 12:00, to know boundary of search space.
-    if (has_coordinates()) {
-        for (auto &it : neighbors) {
-            it.second.sort(
-                [this, it](const utils::UInt &i, const utils::UInt &j) {
-                    return get_angle(xy_coord.at(it.first), xy_coord.at(i)) <
-                           get_angle(xy_coord.at(it.first), xy_coord.at(j));
-                }
-            );
-        }
-    }
-
     // Dump the grid structure to stdout if the loglevel is sufficiently
     // verbose.
     QL_IF_LOG_DEBUG {
@@ -511,6 +861,100 @@ Topology::Topology(utils::UInt num_qubits, const utils::Json &topology) {
 
 }
 
+/**
+ * Writes a binary representation of this topology, including the
+ * adjacency arrays, edge maps, and distance matrix derived from the JSON
+ * description, such that read_binary() doesn't need to recompute them.
+ * This is used for platform snapshots.
+ */
+void Topology::write_binary(utils::BinaryWriter &writer) const {
+    writer.write_uint(num_qubits);
+    writer.write_json(json);
+    writer.write_uint(num_cores);
+    writer.write_uint(num_comm_qubits);
+    writer.write_uint((utils::UInt)form, 1);
+    writer.write_int(xy_size.x);
+    writer.write_int(xy_size.y);
+    writer.write_uint(xy_coord.size());
+    for (const auto &coord : xy_coord) {
+        writer.write_uint(coord.first);
+        writer.write_int(coord.second.x);
+        writer.write_int(coord.second.y);
+    }
+    writer.write_uint((utils::UInt)connectivity, 1);
+    writer.write_uints(neighbor_offsets);
+    writer.write_uints(neighbor_qubits);
+    writer.write_uint(edge_to_qubits.size());
+    for (const auto &edge : edge_to_qubits) {
+        writer.write_int(edge.first);
+        writer.write_uint(edge.second.first);
+        writer.write_uint(edge.second.second);
+    }
+    writer.write_int(max_edge);
+    writer.write_uints(distance, 2);
+}
+
+/**
+ * Reconstructs a topology from the data written by write_binary().
+ */
+Topology Topology::read_binary(utils::BinaryReader &reader) {
+    Topology topology;
+    topology.path_dag_cache.emplace();
+    topology.num_qubits = reader.read_uint();
+    topology.json = reader.read_json();
+    topology.num_cores = reader.read_uint();
+    topology.num_comm_qubits = reader.read_uint();
+    topology.form = (GridForm)reader.read_uint(1);
+    topology.xy_size.x = reader.read_int();
+    topology.xy_size.y = reader.read_int();
+    for (utils::UInt i = reader.read_length(24); i > 0; i--) {
+        auto qubit = reader.read_uint();
+        auto &coord = topology.xy_coord.set(qubit);
+        coord.x = reader.read_int();
+        coord.y = reader.read_int();
+    }
+    topology.connectivity = (GridConnectivity)reader.read_uint(1);
+    topology.neighbor_offsets = reader.read_uints<utils::UInt>();
+    topology.neighbor_qubits = reader.read_uints<Qubit>();
+    for (utils::UInt i = reader.read_length(24); i > 0; i--) {
+        auto edge = reader.read_int();
+        auto src = reader.read_uint();
+        auto dst = reader.read_uint();
+        topology.edge_to_qubits.set(edge) = {src, dst};
+        topology.qubits_to_edge.set({src, dst}) = edge;
+    }
+    topology.max_edge = reader.read_int();
+    topology.distance = reader.read_uints<std::uint16_t>(2);
+    topology.distance_cache_rows = parse_distance_cache_rows(
+        topology.json, DEFAULT_DISTANCE_CACHE_ROWS
+    );
+
+    // Check consistency of the arrays that are indexed without bounds checks
+    // later on.
+    if (
+        (!topology.neighbor_offsets.empty() && (
+            topology.neighbor_offsets.size() != topology.num_qubits + 1
+            || topology.neighbor_offsets.back() != topology.neighbor_qubits.size()
+        )) || (
+            !topology.distance.empty()
+            && topology.distance.size() != topology.num_qubits * topology.num_qubits
+        )
+    ) {
+        throw utils::Exception("binary topology data is inconsistent");
+    }
+
+    // Large topologies compute their distance rows on demand.
+    if (
+        topology.connectivity == GridConnectivity::SPECIFIED
+        && topology.distance.empty()
+        && topology.num_qubits > 0
+    ) {
+        topology.distance_rows.emplace(topology.num_qubits, topology.distance_cache_rows);
+    }
+
+    return topology;
+}
+
 /**
  * Returns the number of qubits for this topology.
  */
@@ -607,13 +1051,24 @@ utils::UInt Topology::get_num_cores() const {
  * Returns the indices of the neighboring qubits for the given qubit.
  */
 Topology::Neighbors Topology::get_neighbors(Qubit qubit) const {
-    if (connectivity != GridConnectivity::FULL || has_coordinates()) {
-        return neighbors.get(qubit);
-    } else {
-        Neighbors retval;
-        generate_neighbors_list(qubit, retval);
-        return retval;
+    auto span = get_neighbor_span(qubit);
+    return Neighbors(span.begin(), span.end());
+}
+
+/**
+ * Returns a view of the neighboring qubits for the given qubit, in the same
+ * order as get_neighbors(), without allocating memory.
+ */
+Topology::NeighborSpan Topology::get_neighbor_span(Qubit qubit) const {
+    NeighborSpan span;
+    if (neighbor_offsets.empty()) {
+        span.topology = this;
+        span.qubit = qubit;
+    } else if (qubit < num_qubits) {
+        span.first = neighbor_qubits.data() + neighbor_offsets[qubit];
+        span.last = neighbor_qubits.data() + neighbor_offsets[qubit + 1];
     }
+    return span;
 }
 
 /**
@@ -670,7 +1125,49 @@ utils::UInt Topology::get_distance(Qubit source, Qubit target) const {
         return d;
     }
 
-    return distance[source][target];
+    // Look up the distance in the distance matrix or row cache.
+    std::uint16_t d;
+    if (distance_rows) {
+        if (!distance_rows->lookup(source, target, d)) {
+            utils::Vec<std::uint16_t> row(num_qubits);
+            compute_distance_row(source, row.data());
+            distance_rows->insert(source, row.data());
+            d = row[target];
+        }
+    } else {
+        d = distance[source * num_qubits + target];
+    }
+
+    // When not connected, the distance is reported as utils::MAX.
+    if (d == NO_PATH) {
+        return utils::MAX;
+    }
+    return d;
+}
+
+/**
+ * Computes the distances from the given source qubit to all qubits using a
+ * breadth-first search over the specified edges, writing them to the given
+ * row of num_qubits entries.
+ */
+void Topology::compute_distance_row(Qubit source, std::uint16_t *row) const {
+    QL_ASSERT(connectivity == GridConnectivity::SPECIFIED);
+    for (utils::UInt i = 0; i < num_qubits; i++) {
+        row[i] = NO_PATH;
+    }
+    row[source] = 0;
+    utils::Vec<Qubit> queue;
+    queue.reserve(num_qubits);
+    queue.push_back(source);
+    for (utils::UInt head = 0; head < queue.size(); head++) {
+        auto q = queue[head];
+        for (auto n : get_neighbor_span(q)) {
+            if (row[n] == NO_PATH) {
+                row[n] = row[q] + 1;
+                queue.push_back(n);
+            }
+        }
+    }
 }
 
 /**
@@ -708,6 +1205,101 @@ utils::UInt Topology::get_min_hops(Qubit source, Qubit target) const {
     }
 }
 
+/**
+ * Constructs the path DAG for the given source, target, and budget.
+ *
+ * For multi-core topologies, paths are built at two levels. Cores are fully
+ * connected internally, and any two cores are connected through their
+ * communication qubits, so the only useful core-level route is the direct
+ * hop from the core of the source qubit to that of the target qubit. Paths
+ * thus never enter a third core, and never leave the target core once they
+ * reach it; within each of the two cores, any qubit can be used. This way,
+ * the work done per state scales with the size of a core, rather than with
+ * the total number of qubits.
+ */
+Topology::CPathDagRef Topology::build_path_dag(Qubit source, Qubit target, utils::UInt budget) const {
+    utils::Ptr<PathDag> dag;
+    dag.emplace();
+    utils::Bool multi_core = connectivity == GridConnectivity::FULL && num_cores > 1;
+
+    // Walk all (qubit, remaining budget) states reachable from the source
+    // state, recording the neighbors that are still within budget of the
+    // target. Each state is expanded only once, even though it may be part
+    // of many paths.
+    utils::List<utils::Pair<Qubit, utils::UInt>> todo;
+    todo.push_back({source, budget});
+    while (!todo.empty()) {
+        auto state = todo.front();
+        todo.pop_front();
+        if (state.first == target || dag->next_hops.count(state)) {
+            continue;
+        }
+        auto &hops = dag->next_hops.set(state);
+        auto visit = [&](Qubit n) {
+            if (get_distance(n, target) < state.second) {
+                hops.push_back(n);
+                todo.push_back({n, state.second - 1});
+            }
+        };
+        if (multi_core) {
+            Neighbors candidates;
+            generate_path_neighbors_list(state.first, target, candidates);
+            for (auto n : candidates) {
+                visit(n);
+            }
+        } else {
+            for (auto n : get_neighbor_span(state.first)) {
+                visit(n);
+            }
+        }
+    }
+
+    return dag.as_const();
+}
+
+/**
+ * Returns the DAG of all paths from source to target that take at most
+ * budget hops. This is always precisely the set of shortest paths when
+ * budget equals get_distance(source, target), but a larger budget can be
+ * used for multi-core routing (see get_min_hops()). The most recently
+ * used DAGs are cached, so repeated requests for the same qubit pair
+ * (which are very common while mapping a kernel) don't recompute them.
+ * This function is thread-safe.
+ */
+Topology::CPathDagRef Topology::get_path_dag(Qubit source, Qubit target, utils::UInt budget) const {
+    auto &cache = *path_dag_cache;
+    PathDagCache::Key key{{source, target}, budget};
+
+    // Look for the DAG in the cache, and mark it as most recently used if we
+    // find it.
+    {
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        auto it = cache.entries.find(key);
+        if (it != cache.entries.end()) {
+            cache.usage.splice(cache.usage.begin(), cache.usage, it->second.second);
+            return it->second.first;
+        }
+    }
+
+    // Build the DAG without holding the lock. If another thread happened to
+    // build the same DAG in the meantime, the result is simply the same.
+    auto dag = build_path_dag(source, target, budget);
+
+    // Insert it into the cache, evicting the least recently used DAG if the
+    // cache is full.
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.entries.count(key)) {
+        return dag;
+    }
+    if (cache.entries.size() >= PATH_DAG_CACHE_SIZE) {
+        cache.entries.erase(cache.usage.back());
+        cache.usage.pop_back();
+    }
+    cache.usage.push_front(key);
+    cache.entries.set(key) = {dag, cache.usage.begin()};
+    return dag;
+}
+
 /**
  * Returns whether qubits have coordinates associated with them.
  */
@@ -715,6 +1307,172 @@ utils::Bool Topology::has_coordinates() const {
     return form != GridForm::IRREGULAR;
 }
 
+/**
+ * Returns whether all pairs of qubits are nearest neighbors, i.e. the
+ * connectivity is full and there is only a single core. Two-qubit gates then
+ * never need routing.
+ */
+utils::Bool Topology::is_fully_connected() const {
+    return connectivity == GridConnectivity::FULL && num_cores == 1;
+}
+
+/**
+ * Disables the given couplers and all couplers of the given qubits, for
+ * example because they have been taken offline. A coupler is disabled in both
+ * directions, so the edges from its first to its second qubit and vice versa
+ * are removed, along with their edge indices. Disabling a coupler that
+ * doesn't exist in either direction is an error. The JSON returned by
+ * get_json() is updated accordingly. This is only supported for specified
+ * connectivity.
+ *
+ * The distances are repaired incrementally: removing edges can only make
+ * distances larger, so only the distance rows of source qubits for which a
+ * removed edge lies on a shortest path are recomputed. Rows that are computed
+ * on-demand for large topologies are simply dropped when affected. The path
+ * DAG and distance row caches are normally shared between copies, so this
+ * topology gets new ones. This means that copies made before this call are
+ * unaffected, and thus that a degraded variant of a topology can be derived
+ * cheaply by disabling parts of a copy of it.
+ */
+void Topology::disable(const utils::Vec<QubitPair> &couplers, const utils::Vec<Qubit> &qubits) {
+    if (connectivity != GridConnectivity::SPECIFIED) {
+        throw utils::Exception("couplers can only be disabled for topologies with specified connectivity");
+    }
+
+    // Determine which (directed) edges to remove.
+    auto has_edge = [this](Qubit src, Qubit dst) {
+        for (auto n : get_neighbor_span(src)) {
+            if (n == dst) {
+                return true;
+            }
+        }
+        return false;
+    };
+    utils::Set<QubitPair> removed;
+    for (const auto &coupler : couplers) {
+        if (coupler.first >= num_qubits || coupler.second >= num_qubits) {
+            throw utils::Exception("qubit of coupler to disable is out of range");
+        }
+        utils::Bool found = false;
+        if (has_edge(coupler.first, coupler.second)) {
+            removed.insert(coupler);
+            found = true;
+        }
+        if (has_edge(coupler.second, coupler.first)) {
+            removed.insert({coupler.second, coupler.first});
+            found = true;
+        }
+        if (!found) {
+            throw utils::Exception(
+                "cannot disable nonexistent coupler between qubits " +
+                utils::to_string(coupler.first) + " and " +
+                utils::to_string(coupler.second)
+            );
+        }
+    }
+    if (!qubits.empty()) {
+        utils::Vec<utils::Bool> disabled(num_qubits, false);
+        for (auto q : qubits) {
+            if (q >= num_qubits) {
+                throw utils::Exception("qubit to disable is out of range");
+            }
+            disabled[q] = true;
+        }
+        for (Qubit src = 0; src < num_qubits; src++) {
+            for (auto dst : get_neighbor_span(src)) {
+                if (disabled[src] || disabled[dst]) {
+                    removed.insert({src, dst});
+                }
+            }
+        }
+    }
+    if (removed.empty()) {
+        return;
+    }
+
+    // Remove the edges from the adjacency arrays, preserving the order of the
+    // remaining neighbors.
+    utils::Vec<utils::UInt> offsets;
+    utils::Vec<Qubit> remaining;
+    offsets.reserve(num_qubits + 1);
+    remaining.reserve(neighbor_qubits.size() - removed.size());
+    for (Qubit q = 0; q < num_qubits; q++) {
+        offsets.push_back(remaining.size());
+        for (auto i = neighbor_offsets[q]; i < neighbor_offsets[q + 1]; i++) {
+            if (!removed.count({q, neighbor_qubits[i]})) {
+                remaining.push_back(neighbor_qubits[i]);
+            }
+        }
+    }
+    offsets.push_back(remaining.size());
+    neighbor_offsets = std::move(offsets);
+    neighbor_qubits = std::move(remaining);
+
+    // Remove the edge indices. max_edge is left alone, as the indices of the
+    // remaining edges don't change.
+    for (const auto &edge : removed) {
+        auto it = qubits_to_edge.find(edge);
+        if (it != qubits_to_edge.end()) {
+            edge_to_qubits.erase(it->second);
+            qubits_to_edge.erase(it);
+        }
+    }
+
+    // Remove the edges from the JSON description.
+    utils::Json edges = utils::Json::array();
+    for (const auto &edge : json.at("edges")) {
+        QubitPair qubit_pair{edge.at("src").get<Qubit>(), edge.at("dst").get<Qubit>()};
+        if (!removed.count(qubit_pair)) {
+            edges.push_back(edge);
+        }
+    }
+    json["edges"] = std::move(edges);
+
+    // Repair the distances. A row is affected if and only if a removed edge
+    // continues a shortest path from its source qubit, which can be checked
+    // using the old distances in that row alone.
+    auto is_affected = [&removed](const std::uint16_t *row) {
+        for (const auto &edge : removed) {
+            if (row[edge.first] != NO_PATH && row[edge.first] + 1 == row[edge.second]) {
+                return true;
+            }
+        }
+        return false;
+    };
+    if (distance_rows) {
+        auto old_rows = distance_rows;
+        distance_rows.emplace(num_qubits, distance_cache_rows);
+        std::lock_guard<std::mutex> lock(old_rows->mutex);
+        utils::Vec<std::uint16_t> row(num_qubits);
+        for (utils::UInt i = 0; i < old_rows->num_used; i++) {
+            const auto &buffer = old_rows->buffers[i];
+            for (utils::UInt q = 0; q < num_qubits; q++) {
+                row[q] = buffer.row[q].load(std::memory_order_relaxed);
+            }
+            if (!is_affected(row.data())) {
+                distance_rows->insert(buffer.source.load(std::memory_order_relaxed), row.data());
+            }
+        }
+    } else {
+        utils::UInt num_recomputed = 0;
+        for (Qubit q = 0; q < num_qubits; q++) {
+            auto row = &distance[q * num_qubits];
+            if (is_affected(row)) {
+                compute_distance_row(q, row);
+                num_recomputed++;
+            }
+        }
+        QL_DOUT(
+            "disabling " << removed.size() << " edges required recomputing " <<
+            num_recomputed << " of " << num_qubits << " distance rows"
+        );
+    }
+
+    // The cached path DAGs may use the removed edges.
+    path_dag_cache.emplace();
+
+}
+
 /**
  * Rotate neighbors list such that largest angle difference between adjacent
  * elements is behind back. This is needed when a given subset of variations
@@ -778,7 +1536,7 @@ void Topology::dump(std::ostream &os, const utils::Str &line_prefix) const {
     for (utils::UInt i = 0; i < num_qubits; i++) {
         os << line_prefix << "qubit[" << i << "]=" << xy_coord.dbg(i);
         os << " has neighbors";
-        for (auto &n : get_neighbors(i)) {
+        for (auto n : get_neighbor_span(i)) {
             os << " qubit[" << n << "]=" << xy_coord.dbg(i);
         }
         os << "\n";
@@ -0,0 +1,197 @@
+/** \file
+ * Binary serialization of the IR, as a compact and fast alternative to
+ * the cQASM round trip for checkpointing and transferring IR trees.
+ */
+
+#include "ql/ir/binary.h"
+
+#include <algorithm>
+
+#include "ql/utils/exception.h"
+#include "ql/utils/filesystem.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/ir/consistency.h"
+#include "ql/rmgr/manager.h"
+
+namespace ql {
+namespace ir {
+namespace binary {
+
+/**
+ * Version of the binary format. This is incremented whenever the IR tree
+ * structure or the serialization of any of its primitives changes.
+ */
+const utils::UInt FORMAT_VERSION = 1;
+
+/**
+ * Magic number at the start of each record.
+ */
+static const char MAGIC[4] = {'Q', 'L', 'I', 'R'};
+
+/**
+ * Size of the record header: magic number, format version, and payload
+ * length.
+ */
+static const utils::UInt HEADER_SIZE = 4 + 4 + 8;
+
+/**
+ * Appends the given integer to the given buffer in little-endian byte order.
+ */
+static void append_le(utils::Str &buf, utils::UInt value, utils::UInt num_bytes) {
+    for (utils::UInt i = 0; i < num_bytes; i++) {
+        buf.push_back((char)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+/**
+ * Decodes a little-endian integer of the given size from the given buffer.
+ */
+static utils::UInt decode_le(const char *data, utils::UInt num_bytes) {
+    utils::UInt value = 0;
+    for (utils::UInt i = 0; i < num_bytes; i++) {
+        value |= ((utils::UInt)(unsigned char)data[i]) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * Checks the given record header and returns the payload length.
+ */
+static utils::UInt check_header(const char *header) {
+    if (!std::equal(MAGIC, MAGIC + 4, header)) {
+        QL_USER_ERROR("not an OpenQL binary IR record (bad magic number)");
+    }
+    auto version = decode_le(header + 4, 4);
+    if (version != FORMAT_VERSION) {
+        QL_USER_ERROR(
+            "unsupported OpenQL binary IR format version " << version
+            << "; this version of OpenQL reads version " << FORMAT_VERSION
+        );
+    }
+    return decode_le(header + 8, 8);
+}
+
+/**
+ * Rebuilds the parts of the platform that are not serialized, i.e. the
+ * compatibility platform annotation and the resource manager, from the
+ * platform JSON data. Like the new-to-old conversion does when the annotation
+ * is missing, this assumes that building a compat::Platform from the already
+ * preprocessed JSON data yields the same platform.
+ */
+static void restore_platform(const Ref &ir) {
+    auto old = compat::Platform::build(ir->platform->name, ir->platform->data.data);
+    ir->platform->set_annotation<compat::PlatformRef>(old);
+    rmgr::CRef resources;
+    resources.emplace(rmgr::Manager::from_defaults(old, {}, ir));
+    ir->platform->resources.populate(resources);
+}
+
+/**
+ * Writes a binary representation of the given IR to the given stream.
+ *
+ * The record consists of a four-byte magic number (`QLIR`), a 32-bit format
+ * version, a 64-bit payload length, and the payload itself, all integers being
+ * little-endian. The payload is tree-gen's CBOR serialization of the tree,
+ * which stores links as the sequence number of the node they refer to. Since
+ * records are length-prefixed, multiple records can be written to the same
+ * stream back to back.
+ *
+ * The resource manager and the compatibility platform are not stored; they
+ * are rebuilt from the platform JSON data when the record is read. All other
+ * annotations are lost.
+ */
+void write(const Ref &ir, std::ostream &os) {
+    auto payload = utils::tree::base::serialize(ir);
+    utils::Str header(MAGIC, 4);
+    append_le(header, FORMAT_VERSION, 4);
+    append_le(header, payload.size(), 8);
+    os.write(header.data(), header.size());
+    os.write(payload.data(), payload.size());
+    if (!os.good()) {
+        QL_USER_ERROR("failed to write binary IR record");
+    }
+}
+
+/**
+ * Shorthand for getting the binary representation of the given IR as a
+ * string.
+ */
+utils::Str to_string(const Ref &ir) {
+    utils::StrStrm ss;
+    write(ir, ss);
+    return ss.str();
+}
+
+/**
+ * Same as write(), but writes to the given file.
+ */
+void write_file(const Ref &ir, const utils::Str &fname) {
+    utils::OutFile file{fname, true};
+    write(ir, file.unwrap());
+    file.close();
+}
+
+/**
+ * Deserializes the given CBOR payload and restores the platform.
+ */
+static Ref read_payload(const utils::Str &payload) {
+    Ref ir;
+    ir.set(utils::tree::base::deserialize<Root>(payload).get_ptr());
+    restore_platform(ir);
+    check_consistency(ir);
+    return ir;
+}
+
+/**
+ * Reads a binary IR record from the given buffer, which must contain exactly
+ * one record. The buffer is only read from and not retained, so it may for
+ * instance be a memory-mapped file.
+ */
+Ref read(const char *data, utils::UInt size) {
+    if (size < HEADER_SIZE) {
+        QL_USER_ERROR("binary IR record is truncated");
+    }
+    auto payload_size = check_header(data);
+    if (payload_size != size - HEADER_SIZE) {
+        QL_USER_ERROR(
+            "binary IR record size mismatch: header specifies " << payload_size
+            << " bytes of payload, but " << (size - HEADER_SIZE) << " are available"
+        );
+    }
+    return read_payload(utils::Str(data + HEADER_SIZE, payload_size));
+}
+
+/**
+ * Same as read(const char*, utils::UInt), but reads from a string.
+ */
+Ref read(const utils::Str &data) {
+    return read(data.data(), data.size());
+}
+
+/**
+ * Reads the next binary IR record from the given stream. The stream is left
+ * positioned at the end of the record.
+ */
+Ref read(std::istream &is) {
+    char header[HEADER_SIZE];
+    if (!is.read(header, HEADER_SIZE)) {
+        QL_USER_ERROR("binary IR record is truncated");
+    }
+    auto payload_size = check_header(header);
+    utils::Str payload(payload_size, '\0');
+    if (!is.read(&payload[0], payload_size)) {
+        QL_USER_ERROR("binary IR record is truncated");
+    }
+    return read_payload(payload);
+}
+
+/**
+ * Same as read(), but reads the record from the given file.
+ */
+Ref read_file(const utils::Str &fname) {
+    return read(utils::InFile(fname, true).read());
+}
+
+} // namespace binary
+} // namespace ir
+} // namespace ql
@@ -12,6 +12,47 @@ namespace compat {
 
 using namespace utils;
 
+/**
+ * Returns the number of bundles.
+ */
+UInt Bundles::size() const {
+    return start_cycles.size();
+}
+
+/**
+ * Returns whether there are no bundles.
+ */
+Bool Bundles::empty() const {
+    return start_cycles.empty();
+}
+
+/**
+ * Returns a view of the bundle with the given index.
+ */
+Bundle Bundles::at(UInt idx) const {
+    QL_ASSERT(idx < size());
+    const UInt *indices = gate_indices.empty() ? nullptr : &gate_indices[0];
+    return {
+        start_cycles[idx],
+        durations[idx],
+        BundleGates(kernel->gates, indices + offsets[idx], indices + offsets[idx + 1])
+    };
+}
+
+/**
+ * Returns a view of the first bundle, which must exist.
+ */
+Bundle Bundles::front() const {
+    return at(0);
+}
+
+/**
+ * Returns a view of the last bundle, which must exist.
+ */
+Bundle Bundles::back() const {
+    return at(size() - 1);
+}
+
 /**
  * Create a circuit with valid cycle values from the bundled internal
  * representation. The bundles are assumed to be ordered by cycle number.
@@ -42,6 +83,7 @@ GateRefs circuiter(const Bundles &bundles) {
  */
 Str qasm(const Bundles &bundles) {
     StrStrm ssqasm;
+    Str instr;                            // reused for all gates, to avoid a temporary string per gate
     UInt curr_cycle = FIRST_CYCLE;        // FIXME HvS prefer to start at 0; also see depgraph creation
     Str skipgate = "wait";
     if (com::options::get("issue_skip_319") == "yes") {
@@ -64,7 +106,9 @@ Str qasm(const Bundles &bundles) {
             if (isfirst == 0) {
                 ssqasm << " | ";
             }
-            ssqasm << gate->qasm();
+            instr.clear();
+            gate->append_qasm(instr);
+            ssqasm << instr;
             isfirst = 0;
         }
         if (ngates > 1) ssqasm << " }";
@@ -73,7 +117,7 @@ Str qasm(const Bundles &bundles) {
     }
 
     if (!bundles.empty()) {
-        auto &last_bundle = bundles.back();
+        auto last_bundle = bundles.back();
         UInt lsduration = last_bundle.duration_in_cycles;
         if (lsduration > 1) {
             ssqasm << "    " << skipgate << " " << lsduration - 1 << std::endl;
@@ -93,23 +137,22 @@ Bundles bundler(const KernelRef &kernel) {
     auto cycle_time = kernel->platform->cycle_time;
 
     Bundles bundles;        // result bundles
+    bundles.kernel = kernel;
+    bundles.gate_indices.reserve(kernel->gates.size());
 
-    Bundle  currBundle;     // current bundle at currCycle that is being filled
     UInt    currCycle = 0;  // cycle at which bundle is to be scheduled
 
-    currBundle.start_cycle = currCycle; // starts off as empty bundle starting at currCycle
-    currBundle.duration_in_cycles = 0;
-
     QL_DOUT("bundler ...");
 
-    // Create bundles in a single scan over the circuit, using currBundle and
-    // currCycle as state:
-    //  - currBundle: bundle that is being put together; currBundle copied into
-    //    output bundles when the bundle has been done
-    //  - currCycle: cycle at which currBundle will be put; equals cycle value
-    //    of all contained gates
-
-    for (auto &gp : kernel->gates) {
+    // Create bundles in a single scan over the circuit. Gates are appended to
+    // gate_indices as they are encountered; a new bundle is started (that is,
+    // its start cycle, duration, and the offset of its first gate are
+    // appended) when the cycle number of a gate differs from that of the
+    // current bundle, which is the last one in the columns:
+    //  - currCycle: cycle at which the current bundle is put; equals cycle
+    //    value of all contained gates
+    for (UInt idx = 0; idx < kernel->gates.size(); idx++) {
+        const auto &gp = kernel->gates[idx];
         QL_DOUT(". adding gate(@" << gp->cycle << ")  " << gp->qasm());
         if (gp->type() == GateType::WAIT ||    // FIXME HvS: wait must be written as well
             gp->type() == GateType::DUMMY
@@ -121,45 +164,27 @@ Bundles bundler(const KernelRef &kernel) {
         if (newCycle < currCycle) {
             QL_FATAL("Error: circuit not ordered by cycle value");
         }
-        if (newCycle > currCycle) {
-            if (!currBundle.gates.empty()) {
-                // finish currBundle at currCycle
-                // DOUT(".. bundle at cycle " << currCycle << " duration in cycles: " << currBundle.duration_in_cycles);
-                // for (auto &s : currBundle.parallel_sections)
-                // {
-                //     for (auto &sgp: s)
-                //     {
-                //         DOUT("... with gate(@" << sgp->cycle << ")  " << sgp->qasm());
-                //     }
-                // }
-                bundles.push_back(currBundle);
+        if (bundles.start_cycles.empty() || newCycle > currCycle) {
+            if (!bundles.start_cycles.empty()) {
+                // finish current bundle at currCycle
+                bundles.offsets.push_back(bundles.gate_indices.size());
                 QL_DOUT(".. ready with bundle at cycle " << currCycle);
-                currBundle.gates.clear();
             }
 
-            // new empty currBundle at newCycle
+            // new empty bundle at newCycle
             currCycle = newCycle;
-            // DOUT(".. bundling at cycle: " << currCycle);
-            currBundle.start_cycle = currCycle;
-            currBundle.duration_in_cycles = 0;
+            bundles.start_cycles.push_back(currCycle);
+            bundles.durations.push_back(0);
         }
 
-        // add gp to currBundle
-        currBundle.gates.push_back(gp);
-        // DOUT("... gate: " << gp->qasm() << " in private parallel section");
-        currBundle.duration_in_cycles = max(currBundle.duration_in_cycles, (gp->duration+cycle_time-1)/cycle_time);
+        // add gp to the current bundle
+        bundles.gate_indices.push_back(idx);
+        auto &duration = bundles.durations.back();
+        duration = max(duration, (gp->duration+cycle_time-1)/cycle_time);
     }
-    if (!currBundle.gates.empty()) {
-        // finish currBundle (which is last bundle) at currCycle
-        // DOUT("... bundle at cycle " << currCycle << " duration in cycles: " << currBundle.duration_in_cycles);
-        // for (auto &s : currBundle.parallel_sections)
-        // {
-        //     for (auto &sgp: s)
-        //     {
-        //         DOUT("... with gate(@" << sgp->cycle << ")  " << sgp->qasm());
-        //     }
-        // }
-        bundles.push_back(currBundle);
+    if (!bundles.start_cycles.empty()) {
+        // finish the last bundle at currCycle
+        bundles.offsets.push_back(bundles.gate_indices.size());
         QL_DOUT(".. ready with bundle at cycle " << currCycle);
     }
 
@@ -169,7 +194,7 @@ Bundles bundler(const KernelRef &kernel) {
     if (bundles.empty()) {
         QL_DOUT("Depth: " << 0);
     } else {
-        QL_DOUT("Depth: " << currCycle + currBundle.duration_in_cycles - bundles.front().start_cycle);
+        QL_DOUT("Depth: " << currCycle + bundles.durations.back() - bundles.start_cycles.front());
     }
     QL_DOUT("bundler [DONE]");
     return bundles;
@@ -187,21 +187,16 @@ Classical::Classical(const Str &operation) {
     }
 }
 
-Instruction Classical::qasm() const {
-    Str iopers;
-    Int sz = creg_operands.size();
-    for (Int i = 0; i < sz; ++i) {
-        if (i == sz - 1) {
-            iopers += " r" + to_string(creg_operands[i]);
-        } else {
-            iopers += " r" + to_string(creg_operands[i]) + ",";
-        }
+void Classical::append_qasm(Str &buf) const {
+    buf += name;
+    for (UInt i = 0; i < creg_operands.size(); ++i) {
+        buf += i ? ", r" : " r";
+        append_uint(buf, creg_operands[i]);
     }
 
     if (name == "ldi") {
-        return "ldi" + iopers + ", " + to_string(int_operand);
-    } else {
-        return name + iopers;
+        buf += ", ";
+        append_int(buf, int_operand);
     }
 }
 
@@ -5,6 +5,9 @@
 #include "ql/ir/compat/gate.h"
 
 #include <cctype>
+#include <sstream>
+#include <iterator>
+#include <algorithm>
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 
@@ -74,31 +77,72 @@ Bool Gate::is_conditional() const {
     return condition != ConditionType::ALWAYS;
 }
 
-Instruction Gate::cond_qasm() const {
+// re-interns name if it changed since the last call
+void Gate::update_name_cache() const {
+    if (name_cache.str() != name) {
+        name_cache = InternedStr(name);
+        base_name_cache = InternedStr(name.substr(0, name.find(' ')));
+    }
+}
+
+// interned name, for O(1) comparison against other interned names; cached, so after the first call this
+// only costs a (short) string compare to check that name didn't change
+const InternedStr &Gate::get_interned_name() const {
+    update_name_cache();
+    return name_cache;
+}
+
+// same, but only up to the first space, i.e. without the operands that legacy custom gate names may include
+const InternedStr &Gate::get_base_name() const {
+    update_name_cache();
+    return base_name_cache;
+}
+
+// convenience wrapper around append_qasm(); prefer the latter when generating qasm for many gates, as that
+// allows a single buffer to be reused
+Instruction Gate::qasm() const {
+    Str buf;
+    append_qasm(buf);
+    return buf;
+}
+
+void Gate::append_cond_qasm(Str &buf) const {
     QL_ASSERT(Gate::is_valid_cond(condition, cond_operands));
+    const char *op = nullptr;
+    Bool inverted = false;
     switch (condition) {
         case ConditionType::ALWAYS:
-            return "";
+            return;
         case ConditionType::NEVER:
-            return Instruction("cond(0) ");
+            buf += "cond(0) ";
+            return;
         case ConditionType::UNARY:
-            return Instruction("cond(b[" + to_string(cond_operands[0]) + "]) ");
         case ConditionType::NOT:
-            return Instruction("cond(!b[" + to_string(cond_operands[0]) + "]) ");
-        case ConditionType::AND:
-            return Instruction("cond(b[" + to_string(cond_operands[0]) + "]&&b[" + to_string(cond_operands[1]) + ") ");
-        case ConditionType::NAND:
-            return Instruction("cond(!(b[" + to_string(cond_operands[0]) + "]&&b[" + to_string(cond_operands[1]) + ")) ");
-        case ConditionType::OR:
-            return Instruction("cond(b[" + to_string(cond_operands[0]) + "]||b[" + to_string(cond_operands[1]) + ") ");
-        case ConditionType::NOR:
-            return Instruction("cond(!(b[" + to_string(cond_operands[0]) + "]||b[" + to_string(cond_operands[1]) + ")) ");
-        case ConditionType::XOR:
-            return Instruction("cond(b[" + to_string(cond_operands[0]) + "]^^b[" + to_string(cond_operands[1]) + ") ");
-        case ConditionType::NXOR:
-            return Instruction("cond(!(b[" + to_string(cond_operands[0]) + "]^^b[" + to_string(cond_operands[1]) + ")) ");
+            buf += condition == ConditionType::NOT ? "cond(!b[" : "cond(b[";
+            append_uint(buf, cond_operands[0]);
+            buf += "]) ";
+            return;
+        case ConditionType::AND: op = "&&"; break;
+        case ConditionType::NAND: op = "&&"; inverted = true; break;
+        case ConditionType::OR: op = "||"; break;
+        case ConditionType::NOR: op = "||"; inverted = true; break;
+        case ConditionType::XOR: op = "^^"; break;
+        case ConditionType::NXOR: op = "^^"; inverted = true; break;
     }
-    return "";
+    if (!op) return;
+    buf += inverted ? "cond(!(b[" : "cond(b[";
+    append_uint(buf, cond_operands[0]);
+    buf += "]";
+    buf += op;
+    buf += "b[";
+    append_uint(buf, cond_operands[1]);
+    buf += inverted ? "])) " : "]) ";
+}
+
+Instruction Gate::cond_qasm() const {
+    Str buf;
+    append_cond_qasm(buf);
+    return buf;
 }
 
 Bool Gate::is_valid_cond(ConditionType condition, const Vec<UInt> &cond_operands) {
@@ -120,6 +164,20 @@ Bool Gate::is_valid_cond(ConditionType condition, const Vec<UInt> &cond_operands
     return false;
 }
 
+/**
+ * Appends the condition, the given mnemonic, and the first num_qubits qubit
+ * operands of the given gate to buf, in legacy qasm layout.
+ */
+static void append_simple_qasm(Str &buf, const Gate &gate, const char *mnemonic, UInt num_qubits) {
+    gate.append_cond_qasm(buf);
+    buf += mnemonic;
+    for (UInt i = 0; i < num_qubits; i++) {
+        buf += i ? ",q[" : " q[";
+        append_uint(buf, gate.operands[i]);
+        buf += ']';
+    }
+}
+
 namespace gate_types {
 
 Identity::Identity(UInt q) {
@@ -128,8 +186,8 @@ Identity::Identity(UInt q) {
     operands.push_back(q);
 }
 
-Instruction Identity::qasm() const {
-    return Instruction(cond_qasm() + "i q[" + to_string(operands[0]) + "]");
+void Identity::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "i", 1);
 }
 
 GateType Identity::type() const {
@@ -142,8 +200,8 @@ Hadamard::Hadamard(UInt q) {
     operands.push_back(q);
 }
 
-Instruction Hadamard::qasm() const {
-    return Instruction(cond_qasm() + "h q[" + to_string(operands[0]) + "]");
+void Hadamard::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "h", 1);
 }
 
 GateType Hadamard::type() const {
@@ -156,8 +214,8 @@ Phase::Phase(UInt q) {
     operands.push_back(q);
 }
 
-Instruction Phase::qasm() const {
-    return Instruction(cond_qasm() + "s q[" + to_string(operands[0]) + "]");
+void Phase::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "s", 1);
 }
 
 GateType Phase::type() const {
@@ -170,8 +228,8 @@ PhaseDag::PhaseDag(UInt q) {
     operands.push_back(q);
 }
 
-Instruction PhaseDag::qasm() const {
-    return Instruction(cond_qasm() + "sdag q[" + to_string(operands[0]) + "]");
+void PhaseDag::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "sdag", 1);
 }
 
 GateType PhaseDag::type() const {
@@ -185,8 +243,10 @@ RX::RX(UInt q, double theta) {
     operands.push_back(q);
 }
 
-Instruction RX::qasm() const {
-    return Instruction(cond_qasm() + "rx q[" + to_string(operands[0]) + "], " + to_string(angle));
+void RX::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "rx", 1);
+    buf += ", ";
+    append_real(buf, angle);
 }
 
 GateType RX::type() const {
@@ -200,8 +260,10 @@ RY::RY(UInt q, double theta) {
     operands.push_back(q);
 }
 
-Instruction RY::qasm() const {
-    return Instruction(cond_qasm() + "ry q[" + to_string(operands[0]) + "], " + to_string(angle));
+void RY::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "ry", 1);
+    buf += ", ";
+    append_real(buf, angle);
 }
 
 GateType RY::type() const {
@@ -215,8 +277,10 @@ RZ::RZ(UInt q, double theta) {
     operands.push_back(q);
 }
 
-Instruction RZ::qasm() const {
-    return Instruction(cond_qasm() + "rz q[" + to_string(operands[0]) + "], " + to_string(angle));
+void RZ::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "rz", 1);
+    buf += ", ";
+    append_real(buf, angle);
 }
 
 GateType RZ::type() const {
@@ -229,8 +293,8 @@ T::T(UInt q) {
     operands.push_back(q);
 }
 
-Instruction T::qasm() const {
-    return Instruction(cond_qasm() + "t q[" + to_string(operands[0]) + "]");
+void T::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "t", 1);
 }
 
 GateType T::type() const {
@@ -243,8 +307,8 @@ TDag::TDag(UInt q) {
     operands.push_back(q);
 }
 
-Instruction TDag::qasm() const {
-    return Instruction(cond_qasm() + "tdag q[" + to_string(operands[0]) + "]");
+void TDag::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "tdag", 1);
 }
 
 GateType TDag::type() const {
@@ -257,8 +321,8 @@ PauliX::PauliX(UInt q) {
     operands.push_back(q);
 }
 
-Instruction PauliX::qasm() const {
-    return Instruction(cond_qasm() + "x q[" + to_string(operands[0]) + "]");
+void PauliX::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "x", 1);
 }
 
 GateType PauliX::type() const {
@@ -271,8 +335,8 @@ PauliY::PauliY(UInt q) {
     operands.push_back(q);
 }
 
-Instruction PauliY::qasm() const {
-    return Instruction(cond_qasm() + "y q[" + to_string(operands[0]) + "]");
+void PauliY::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "y", 1);
 }
 
 GateType PauliY::type() const {
@@ -285,8 +349,8 @@ PauliZ::PauliZ(UInt q) {
     operands.push_back(q);
 }
 
-Instruction PauliZ::qasm() const {
-    return Instruction(cond_qasm() + "z q[" + to_string(operands[0]) + "]");
+void PauliZ::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "z", 1);
 }
 
 GateType PauliZ::type() const {
@@ -299,8 +363,8 @@ RX90::RX90(UInt q) {
     operands.push_back(q);
 }
 
-Instruction RX90::qasm() const {
-    return Instruction(cond_qasm() + "x90 q[" + to_string(operands[0]) + "]");
+void RX90::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "x90", 1);
 }
 
 GateType RX90::type() const {
@@ -313,8 +377,8 @@ MRX90::MRX90(UInt q) {
     operands.push_back(q);
 }
 
-Instruction MRX90::qasm() const {
-    return Instruction(cond_qasm() + "mx90 q[" + to_string(operands[0]) + "]");
+void MRX90::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "mx90", 1);
 }
 
 GateType MRX90::type() const {
@@ -327,8 +391,8 @@ RX180::RX180(UInt q) {
     operands.push_back(q);
 }
 
-Instruction RX180::qasm() const {
-    return Instruction(cond_qasm() + "x180 q[" + to_string(operands[0]) + "]");
+void RX180::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "x180", 1);
 }
 
 GateType RX180::type() const {
@@ -341,8 +405,8 @@ RY90::RY90(UInt q) {
     operands.push_back(q);
 }
 
-Instruction RY90::qasm() const {
-    return Instruction(cond_qasm() + "y90 q[" + to_string(operands[0]) + "]");
+void RY90::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "y90", 1);
 }
 
 GateType RY90::type() const {
@@ -355,8 +419,8 @@ MRY90::MRY90(UInt q) {
     operands.push_back(q);
 }
 
-Instruction MRY90::qasm() const {
-    return Instruction(cond_qasm() + "my90 q[" + to_string(operands[0]) + "]");
+void MRY90::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "my90", 1);
 }
 
 GateType MRY90::type() const {
@@ -369,8 +433,8 @@ RY180::RY180(UInt q) {
     operands.push_back(q);
 }
 
-Instruction RY180::qasm() const {
-    return Instruction(cond_qasm() + "y180 q[" + to_string(operands[0]) + "]");
+void RY180::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "y180", 1);
 }
 
 GateType RY180::type() const {
@@ -390,15 +454,15 @@ Measure::Measure(UInt q, UInt c) {
     creg_operands.push_back(c);
 }
 
-Instruction Measure::qasm() const {
-    StrStrm ss;
-    ss << "measure ";
-    ss << "q[" << operands[0] << "]";
+void Measure::append_qasm(Str &buf) const {
+    buf += "measure q[";
+    append_uint(buf, operands[0]);
+    buf += ']';
     if (!creg_operands.empty()) {
-        ss << ", r[" << creg_operands[0] << "]";
+        buf += ", r[";
+        append_uint(buf, creg_operands[0]);
+        buf += ']';
     }
-
-    return Instruction(ss.str());
 }
 
 GateType Measure::type() const {
@@ -411,8 +475,8 @@ PrepZ::PrepZ(UInt q) {
     operands.push_back(q);
 }
 
-Instruction PrepZ::qasm() const {
-    return Instruction(cond_qasm() + "prep_z q[" + to_string(operands[0]) + "]");
+void PrepZ::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "prep_z", 1);
 }
 
 GateType PrepZ::type() const {
@@ -426,9 +490,8 @@ CNot::CNot(UInt q1, UInt q2) {
     operands.push_back(q2);
 }
 
-Instruction CNot::qasm() const {
-    return Instruction(cond_qasm() + "cnot q[" + to_string(operands[0]) + "]"
-                       + ",q[" + to_string(operands[1]) + "]");
+void CNot::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "cnot", 2);
 }
 
 GateType CNot::type() const {
@@ -442,9 +505,8 @@ CPhase::CPhase(UInt q1, UInt q2) {
     operands.push_back(q2);
 }
 
-Instruction CPhase::qasm() const {
-    return Instruction(cond_qasm() + "cz q[" + to_string(operands[0]) + "]"
-                       + ",q[" + to_string(operands[1]) + "]");
+void CPhase::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "cz", 2);
 }
 
 GateType CPhase::type() const {
@@ -459,10 +521,8 @@ Toffoli::Toffoli(UInt q1, UInt q2, UInt q3) {
     operands.push_back(q3);
 }
 
-Instruction Toffoli::qasm() const {
-    return Instruction(cond_qasm() + "toffoli q[" + to_string(operands[0]) + "]"
-                       + ",q[" + to_string(operands[1]) + "]"
-                       + ",q[" + to_string(operands[2]) + "]");
+void Toffoli::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "toffoli", 3);
 }
 
 GateType Toffoli::type() const {
@@ -474,8 +534,8 @@ Nop::Nop() {
     duration = 20;
 }
 
-Instruction Nop::qasm() const {
-    return Instruction("nop");
+void Nop::append_qasm(Str &buf) const {
+    buf += "nop";
 }
 
 GateType Nop::type() const {
@@ -489,9 +549,8 @@ Swap::Swap(UInt q1, UInt q2) {
     operands.push_back(q2);
 }
 
-Instruction Swap::qasm() const {
-    return Instruction(cond_qasm() + "swap q[" + to_string(operands[0]) + "]"
-                       + ",q[" + to_string(operands[1]) + "]");
+void Swap::append_qasm(Str &buf) const {
+    append_simple_qasm(buf, *this, "swap", 2);
 }
 
 GateType Swap::type() const {
@@ -511,8 +570,9 @@ Wait::Wait(Vec<UInt> qubits, UInt d, UInt dc) {
     }
 }
 
-Instruction Wait::qasm() const {
-    return Instruction("wait " + to_string(duration_in_cycles));
+void Wait::append_qasm(Str &buf) const {
+    buf += "wait ";
+    append_uint(buf, duration_in_cycles);
 }
 
 GateType Wait::type() const {
@@ -524,8 +584,8 @@ Source::Source() {
     duration = 1;
 }
 
-Instruction Source::qasm() const {
-    return Instruction("SOURCE");
+void Source::append_qasm(Str &buf) const {
+    buf += "SOURCE";
 }
 
 GateType Source::type() const {
@@ -537,8 +597,8 @@ Sink::Sink() {
     duration = 1;
 }
 
-Instruction Sink::qasm() const {
-    return Instruction("SINK");
+void Sink::append_qasm(Str &buf) const {
+    buf += "SINK";
 }
 
 GateType Sink::type() const {
@@ -550,8 +610,8 @@ Display::Display() {
     duration = 0;
 }
 
-Instruction Display::qasm() const {
-    return Instruction("display");
+void Display::append_qasm(Str &buf) const {
+    buf += "display";
 }
 
 GateType Display::type() const {
@@ -647,46 +707,33 @@ void Custom::print_info() const {
     QL_PRINTLN("    |- duration : " << duration);
 }
 
-Instruction Custom::qasm() const {
-    StrStrm ss;
+void Custom::append_qasm(Str &buf) const {
     UInt p = name.find(' ');
-    Str gate_name = name.substr(0, p);
-    ss << cond_qasm();
-    if (operands.empty()) {
-        ss << gate_name;
-    } else if (operands.size() == 1) {
-        ss << gate_name << " q[" << operands[0] << "]";
-    } else {
-        ss << gate_name << " q[" << operands[0] << "]";
-        for (UInt i = 1; i < operands.size(); i++) {
-            ss << ",q[" << operands[i] << "]";
-        }
+    append_cond_qasm(buf);
+    buf.append(name, 0, p);
+    for (UInt i = 0; i < operands.size(); i++) {
+        buf += i ? ",q[" : " q[";
+        append_uint(buf, operands[i]);
+        buf += ']';
     }
 
     // deal with custom gates with argument, such as angle
-    if (gate_name == "rx" || gate_name == "ry" || gate_name == "rz") {	// FIXME: implicitly defining semantics here
-        ss << ", " << angle;
+    if (!name.compare(0, p, "rx") || !name.compare(0, p, "ry") || !name.compare(0, p, "rz")) {	// FIXME: implicitly defining semantics here
+        buf += ", ";
+        append_real(buf, angle);
     }
 
-    if (creg_operands.size() == 1) {
-        ss << ", r[" << creg_operands[0] << "]";
-    } else if (creg_operands.size() > 1) {
-        ss << ", r[" << creg_operands[0] << "]";
-        for (size_t i = 1; i < creg_operands.size(); i++) {
-            ss << ", r[" << creg_operands[i] << "]";
-        }
+    for (auto r : creg_operands) {
+        buf += ", r[";
+        append_uint(buf, r);
+        buf += ']';
     }
 
-    if (breg_operands.size() == 1) {
-        ss << ", b[" << breg_operands[0] << "]";
-    } else if (breg_operands.size() > 1) {
-        ss << ", b[" << breg_operands[0] << "]";
-        for (size_t i = 1; i < breg_operands.size(); i++) {
-            ss << ", b[" << breg_operands[i] << "]";
-        }
+    for (auto b : breg_operands) {
+        buf += ", b[";
+        append_uint(buf, b);
+        buf += ']';
     }
-
-    return Instruction(ss.str());
 }
 
 GateType Custom::type() const {
@@ -703,15 +750,38 @@ Composite::Composite(const Str &name, const GateRefs &seq) : Custom(name) {
         gs.add(g);
         duration += g->duration;    // FIXME: not true if gates operate in parallel
         operands.insert(operands.end(), g->operands.begin(), g->operands.end());
+
+        // parse the name of the sub-gate into its template, e.g. "cz %0,%1" or "x q3", so the decomposition does
+        // not need any string processing when the composite gate is used
+        Str sub_ins = g->name;
+        std::replace(sub_ins.begin(), sub_ins.end(), ',', ' ');
+        std::istringstream iss(sub_ins);
+        Vec<Str> tokens{
+            std::istream_iterator<Str>{iss},
+            std::istream_iterator<Str>{}
+        };
+        if (tokens.empty()) {
+            template_error = "empty sub-instruction";
+            continue;
+        }
+        SubGate sub_gate;
+        sub_gate.name = tokens[0];
+        for (UInt i = 1; i < tokens.size(); i++) {
+            try {
+                sub_gate.operands.push_back(std::stoi(tokens[i].substr(1)));
+            } catch (std::exception &) {
+                template_error = "cannot parse operand '" + tokens[i] + "' of sub-instruction '" + g->name + "'";
+            }
+        }
+        sub_gates.push_back(std::move(sub_gate));
     }
 }
 
-Instruction Composite::qasm() const {
-    StrStrm instr;
+void Composite::append_qasm(Str &buf) const {
     for (const auto &g : gs) {
-        instr << g->qasm() << std::endl;
+        g->append_qasm(buf);
+        buf += '\n';
     }
-    return Instruction(instr.str());
 }
 
 GateType Composite::type() const {
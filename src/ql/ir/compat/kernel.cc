@@ -29,11 +29,12 @@ using namespace utils;
  * Generates cQASM for a given circuit.
  */
 Str qasm(const GateRefs &c) {
-    StrStrm ss;
-    for (auto gate : c) {
-        ss << gate->qasm() << "\n";
+    Str buf;
+    for (const auto &gate : c) {
+        gate->append_qasm(buf);
+        buf += '\n';
     }
-    return ss.str();
+    return buf;
 }
 
 Kernel::Kernel(
@@ -82,6 +83,9 @@ Kernel::Kernel(
             );
         }
     }
+    if (com::options::global["ir_arena"].as_bool()) {
+        gate_arena.emplace();
+    }
 }
 
 void Kernel::set_condition(const ClassicalOperation &oper) {
@@ -103,6 +107,123 @@ void Kernel::set_kernel_type(KernelType typ) {
     type = typ;
 }
 
+KernelRef Kernel::clone_with_angles(
+    const Str &clone_name,
+    const Vec<UInt> &gate_indices,
+    const Vec<Real> &angles
+) const {
+    if (gate_indices.size() != angles.size()) {
+        QL_USER_ERROR(
+            "cannot clone kernel (" << name << "): " <<
+            gate_indices.size() << " gate indices given for " <<
+            angles.size() << " angles"
+        );
+    }
+    auto clone = KernelRef::make(*this);
+    clone->name = clone_name;
+    clone->gates.reset();
+    for (const auto &gate : gates) {
+        clone->gates.add(copy_gate(*gate));
+    }
+    for (UInt i = 0; i < gate_indices.size(); i++) {
+        auto index = gate_indices[i];
+        if (index >= gates.size()) {
+            QL_USER_ERROR(
+                "cannot clone kernel (" << name << "): " <<
+                "gate index " << index << " out of range"
+            );
+        }
+        const auto &copy = clone->gates[index];
+        switch (copy->type()) {
+            case GateType::RX:
+            case GateType::RY:
+            case GateType::RZ:
+            case GateType::CUSTOM:
+            case GateType::COMPOSITE:
+                break;
+            default:
+                QL_USER_ERROR(
+                    "cannot clone kernel (" << name << "): " <<
+                    "gate " << index << " (" << copy->name << ") has no angle parameter"
+                );
+        }
+        copy->angle = angles[i];
+    }
+    return clone;
+}
+
+GateRef Kernel::copy_gate(const Gate &gate) const {
+    switch (gate.type()) {
+        case GateType::IDENTITY:
+            return make_gate<gate_types::Identity>(static_cast<const gate_types::Identity&>(gate));
+        case GateType::HADAMARD:
+            return make_gate<gate_types::Hadamard>(static_cast<const gate_types::Hadamard&>(gate));
+        case GateType::PAULI_X:
+            return make_gate<gate_types::PauliX>(static_cast<const gate_types::PauliX&>(gate));
+        case GateType::PAULI_Y:
+            return make_gate<gate_types::PauliY>(static_cast<const gate_types::PauliY&>(gate));
+        case GateType::PAULI_Z:
+            return make_gate<gate_types::PauliZ>(static_cast<const gate_types::PauliZ&>(gate));
+        case GateType::PHASE:
+            return make_gate<gate_types::Phase>(static_cast<const gate_types::Phase&>(gate));
+        case GateType::PHASE_DAG:
+            return make_gate<gate_types::PhaseDag>(static_cast<const gate_types::PhaseDag&>(gate));
+        case GateType::T:
+            return make_gate<gate_types::T>(static_cast<const gate_types::T&>(gate));
+        case GateType::T_DAG:
+            return make_gate<gate_types::TDag>(static_cast<const gate_types::TDag&>(gate));
+        case GateType::RX90:
+            return make_gate<gate_types::RX90>(static_cast<const gate_types::RX90&>(gate));
+        case GateType::MRX90:
+            return make_gate<gate_types::MRX90>(static_cast<const gate_types::MRX90&>(gate));
+        case GateType::RX180:
+            return make_gate<gate_types::RX180>(static_cast<const gate_types::RX180&>(gate));
+        case GateType::RY90:
+            return make_gate<gate_types::RY90>(static_cast<const gate_types::RY90&>(gate));
+        case GateType::MRY90:
+            return make_gate<gate_types::MRY90>(static_cast<const gate_types::MRY90&>(gate));
+        case GateType::RY180:
+            return make_gate<gate_types::RY180>(static_cast<const gate_types::RY180&>(gate));
+        case GateType::RX:
+            return make_gate<gate_types::RX>(static_cast<const gate_types::RX&>(gate));
+        case GateType::RY:
+            return make_gate<gate_types::RY>(static_cast<const gate_types::RY&>(gate));
+        case GateType::RZ:
+            return make_gate<gate_types::RZ>(static_cast<const gate_types::RZ&>(gate));
+        case GateType::PREP_Z:
+            return make_gate<gate_types::PrepZ>(static_cast<const gate_types::PrepZ&>(gate));
+        case GateType::CNOT:
+            return make_gate<gate_types::CNot>(static_cast<const gate_types::CNot&>(gate));
+        case GateType::CPHASE:
+            return make_gate<gate_types::CPhase>(static_cast<const gate_types::CPhase&>(gate));
+        case GateType::TOFFOLI:
+            return make_gate<gate_types::Toffoli>(static_cast<const gate_types::Toffoli&>(gate));
+        case GateType::CUSTOM:
+            return make_gate<gate_types::Custom>(static_cast<const gate_types::Custom&>(gate));
+        case GateType::COMPOSITE:
+            return make_gate<gate_types::Composite>(static_cast<const gate_types::Composite&>(gate));
+        case GateType::MEASURE:
+            return make_gate<gate_types::Measure>(static_cast<const gate_types::Measure&>(gate));
+        case GateType::DISPLAY:
+            return make_gate<gate_types::Display>(static_cast<const gate_types::Display&>(gate));
+        case GateType::NOP:
+            return make_gate<gate_types::Nop>(static_cast<const gate_types::Nop&>(gate));
+        case GateType::DUMMY:
+            if (dynamic_cast<const gate_types::Source*>(&gate)) {
+                return make_gate<gate_types::Source>(static_cast<const gate_types::Source&>(gate));
+            }
+            return make_gate<gate_types::Sink>(static_cast<const gate_types::Sink&>(gate));
+        case GateType::SWAP:
+            return make_gate<gate_types::Swap>(static_cast<const gate_types::Swap&>(gate));
+        case GateType::WAIT:
+            return make_gate<gate_types::Wait>(static_cast<const gate_types::Wait&>(gate));
+        case GateType::CLASSICAL:
+            return make_gate<gate_types::Classical>(static_cast<const gate_types::Classical&>(gate));
+        default:
+            QL_ICE("cannot copy gate " << gate.name << " of type " << gate.type());
+    }
+}
+
 Str Kernel::get_gates_definition() const {
     StrStrm ss;
 
@@ -133,21 +254,21 @@ void Kernel::h(UInt qubit) {
 }
 
 void Kernel::rx(UInt qubit, Real angle) {
-    gates.emplace<gate_types::RX>(qubit, angle);
+    add_gate<gate_types::RX>(qubit, angle);
     gates.back()->condition = condition;
     gates.back()->cond_operands = cond_operands;;
     cycles_valid = false;
 }
 
 void Kernel::ry(UInt qubit, Real angle) {
-    gates.emplace<gate_types::RY>(qubit, angle);
+    add_gate<gate_types::RY>(qubit, angle);
     gates.back()->condition = condition;
     gates.back()->cond_operands = cond_operands;;
     cycles_valid = false;
 }
 
 void Kernel::rz(UInt qubit, Real angle) {
-    gates.emplace<gate_types::RZ>(qubit, angle);
+    add_gate<gate_types::RZ>(qubit, angle);
     gates.back()->condition = condition;
     gates.back()->cond_operands = cond_operands;;
     cycles_valid = false;
@@ -231,7 +352,7 @@ void Kernel::cphase(UInt qubit1, UInt qubit2) {
 
 void Kernel::toffoli(UInt qubit1, UInt qubit2, UInt qubit3) {
     // TODO add custom gate check if needed
-    gates.emplace<gate_types::Toffoli>(qubit1, qubit2, qubit3);
+    add_gate<gate_types::Toffoli>(qubit1, qubit2, qubit3);
     gates.back()->condition = condition;
     gates.back()->cond_operands = cond_operands;;
     cycles_valid = false;
@@ -246,7 +367,7 @@ void Kernel::wait(const Vec<UInt> &qubits, UInt duration) {
 }
 
 void Kernel::display() {
-    gates.emplace<gate_types::Display>();
+    add_gate<gate_types::Display>();
     cycles_valid = false;
 }
 
@@ -396,80 +517,80 @@ Bool Kernel::add_default_gate_if_available(
     }
 
     if (gname == "identity" || gname == "i") {
-        gates.emplace<gate_types::Identity>(qubits[0]);
+        add_gate<gate_types::Identity>(qubits[0]);
         result = true;
     } else if (gname == "hadamard" || gname == "h") {
-        gates.emplace<gate_types::Hadamard>(qubits[0]);
+        add_gate<gate_types::Hadamard>(qubits[0]);
         result = true;
     } else if (gname == "pauli_x" || gname == "x") {
-        gates.emplace<gate_types::PauliX>(qubits[0]);
+        add_gate<gate_types::PauliX>(qubits[0]);
         result = true;
     } else if( gname == "pauli_y" || gname == "y") {
-        gates.emplace<gate_types::PauliY>(qubits[0]);
+        add_gate<gate_types::PauliY>(qubits[0]);
         result = true;
     } else if (gname == "pauli_z" || gname == "z") {
-        gates.emplace<gate_types::PauliZ>(qubits[0]);
+        add_gate<gate_types::PauliZ>(qubits[0]);
         result = true;
     } else if (gname == "s" || gname == "phase") {
-        gates.emplace<gate_types::Phase>(qubits[0]);
+        add_gate<gate_types::Phase>(qubits[0]);
         result = true;
     } else if (gname == "sdag" || gname == "phasedag") {
-        gates.emplace<gate_types::PhaseDag>(qubits[0]);
+        add_gate<gate_types::PhaseDag>(qubits[0]);
         result = true;
     } else if (gname == "t") {
-        gates.emplace<gate_types::T>(qubits[0]);
+        add_gate<gate_types::T>(qubits[0]);
         result = true;
     } else if (gname == "tdag") {
-        gates.emplace<gate_types::TDag>(qubits[0]);
+        add_gate<gate_types::TDag>(qubits[0]);
         result = true;
     } else if (gname == "rx") {
-        gates.emplace<gate_types::RX>(qubits[0], angle);
+        add_gate<gate_types::RX>(qubits[0], angle);
         result = true;
     } else if (gname == "ry") {
-        gates.emplace<gate_types::RY>(qubits[0], angle);
+        add_gate<gate_types::RY>(qubits[0], angle);
         result = true;
     } else if( gname == "rz") {
-        gates.emplace<gate_types::RZ>(qubits[0], angle);
+        add_gate<gate_types::RZ>(qubits[0], angle);
         result = true;
     } else if (gname == "rx90") {
-        gates.emplace<gate_types::RX90>(qubits[0]);
+        add_gate<gate_types::RX90>(qubits[0]);
         result = true;
     } else if (gname == "mrx90") {
-        gates.emplace<gate_types::MRX90>(qubits[0]);
+        add_gate<gate_types::MRX90>(qubits[0]);
         result = true;
     } else if (gname == "rx180") {
-        gates.emplace<gate_types::RX180>(qubits[0]);
+        add_gate<gate_types::RX180>(qubits[0]);
         result = true;
     } else if (gname == "ry90") {
-        gates.emplace<gate_types::RY90>(qubits[0]);
+        add_gate<gate_types::RY90>(qubits[0]);
         result = true;
     } else if (gname == "mry90") {
-        gates.emplace<gate_types::MRY90>(qubits[0]);
+        add_gate<gate_types::MRY90>(qubits[0]);
         result = true;
     } else if (gname == "ry180") {
-        gates.emplace<gate_types::RY180>(qubits[0]);
+        add_gate<gate_types::RY180>(qubits[0]);
         result = true;
     } else if (gname == "measure") {
         if (cregs.empty()) {
-            gates.emplace<gate_types::Measure>(qubits[0]);
+            add_gate<gate_types::Measure>(qubits[0]);
         } else {
-            gates.emplace<gate_types::Measure>(qubits[0], cregs[0]);
+            add_gate<gate_types::Measure>(qubits[0], cregs[0]);
         }
         result = true;
     } else if (gname == "prepz") {
-        gates.emplace<gate_types::PrepZ>(qubits[0]);
+        add_gate<gate_types::PrepZ>(qubits[0]);
         result = true;
     } else if (gname == "cnot") {
-        gates.emplace<gate_types::CNot>(qubits[0], qubits[1]);
+        add_gate<gate_types::CNot>(qubits[0], qubits[1]);
         result = true;
     } else if (gname == "cz" || gname == "cphase") {
-        gates.emplace<gate_types::CPhase>(qubits[0], qubits[1]);
+        add_gate<gate_types::CPhase>(qubits[0], qubits[1]);
         result = true;
     } else if (gname == "toffoli") {
-        gates.emplace<gate_types::Toffoli>(qubits[0], qubits[1], qubits[2]);
+        add_gate<gate_types::Toffoli>(qubits[0], qubits[1], qubits[2]);
         result = true;
     } else if (gname == "swap") {
-        gates.emplace<gate_types::Swap>(qubits[0], qubits[1]);
+        add_gate<gate_types::Swap>(qubits[0], qubits[1]);
         result = true;
     } else if (gname == "barrier") {
         /*
@@ -481,9 +602,9 @@ Bool Kernel::add_default_gate_if_available(
             for (UInt q = 0; q < qubit_count; q++) {
                 all_qubits.push_back(q);
             }
-            gates.emplace<gate_types::Wait>(all_qubits, 0, 0);
+            add_gate<gate_types::Wait>(all_qubits, 0, 0);
         } else {
-            gates.emplace<gate_types::Wait>(qubits, 0, 0);
+            add_gate<gate_types::Wait>(qubits, 0, 0);
         }
         result = true;
     } else if (gname == "wait") {
@@ -497,9 +618,9 @@ Bool Kernel::add_default_gate_if_available(
             for (UInt q = 0; q < qubit_count; q++) {
                 all_qubits.push_back(q);
             }
-            gates.emplace<gate_types::Wait>(all_qubits, duration, duration_in_cycles);
+            add_gate<gate_types::Wait>(all_qubits, duration, duration_in_cycles);
         } else {
-            gates.emplace<gate_types::Wait>(qubits, duration, duration_in_cycles);
+            add_gate<gate_types::Wait>(qubits, duration, duration_in_cycles);
         }
         result = true;
     } else {
@@ -541,28 +662,30 @@ Bool Kernel::add_custom_gate_if_available(
         return false;   // return, so a default gate will be attempted
     }
 #endif
-    // construct canonical name
-    Str instr = "";
-    for (auto qubit : qubits) {
-        if (!instr.empty()) {
-            instr += ",";
-        }
-        instr += "q" + to_string(qubit);
-    }
-    instr = gname + " " + instr;
-
-    // first check if a specialized custom gate is available
-    // a specialized custom gate is of the form: "cz q0 q3"
-    auto it = platform->instruction_map.find(instr);
-    if (it == platform->instruction_map.end()) {
-        it = platform->instruction_map.find(gname);
-    }
-    if (it == platform->instruction_map.end()) {
+    // first check if a specialized custom gate is available, of the form
+    // "cz q0,q3", and otherwise fall back to the generic gate
+    auto custom = platform->find_custom_gate(gname, qubits);
+    if (!custom) {
         QL_DOUT("custom gate not added for " << gname);
         return false;
     }
 
-    auto g = GateRef::make<gate_types::Custom>(*(it->second));
+    add_custom_gate(*custom, qubits, cregs, duration, angle, bregs, gcond, gcondregs);
+    QL_DOUT("custom gate added for " << gname);
+    return true;
+}
+
+void Kernel::add_custom_gate(
+    const gate_types::Custom &custom,
+    const Vec<UInt> &qubits,
+    const Vec<UInt> &cregs,
+    UInt duration,
+    Real angle,
+    const Vec<UInt> &bregs,
+    ConditionType gcond,
+    const Vec<UInt> &gcondregs
+) {
+    GateRef g = make_gate<gate_types::Custom>(custom);
     g->operands.clear();
     for (auto qubit : qubits) {
         g->operands.push_back(qubit);
@@ -582,29 +705,64 @@ Bool Kernel::add_custom_gate_if_available(
     g->condition = gcond;
     g->cond_operands = gcondregs;
     gates.add(g);
-
-    QL_DOUT("custom gate added for " << gname);
     cycles_valid = false;
-    return true;
 }
 
-// FIXME: move to class composite_gate?
-// return the subinstructions of a composite gate
-// while doing, test whether the subinstructions have a definition (so they cannot be specialized or default ones!)
-void Kernel::get_decomposed_ins(
+// add the sub-gates of the given composite gate to the circuit, using its pre-parsed decomposition template;
+// if parameterized is set, the operand numbers of the template index into all_qubits, otherwise they are the
+// qubits themselves
+void Kernel::add_decomposed_gate(
     const gate_types::Composite &gate,
-    Vec<Str> &sub_instructions
-) const {
-    auto &sub_gates = gate.gs;
+    Bool parameterized,
+    const Vec<UInt> &all_qubits,
+    const Vec<UInt> &cregs,
+    const Vec<UInt> &bregs,
+    ConditionType gcond,
+    const Vec<UInt> &gcondregs
+) {
     QL_DOUT("composite ins: " << gate.name);
-    for (auto &agate : sub_gates) {
-        const Str &sub_ins = agate->name;
-        QL_DOUT("  sub ins: " << sub_ins);
-        auto it = platform->instruction_map.find(sub_ins);
-        if (it != platform->instruction_map.end()) {
-            sub_instructions.push_back(sub_ins);
+    if (!gate.template_error.empty()) {
+        QL_USER_ERROR("gate decomposition for '" << gate.name << "' is malformed: " << gate.template_error);
+    }
+    Vec<UInt> this_gate_qubits;
+    for (const auto &sub_gate : gate.sub_gates) {
+        const Str &sub_ins_name = sub_gate.name;
+        this_gate_qubits.clear();
+        if (parameterized) {
+            for (auto qubit_idx : sub_gate.operands) {
+                if (qubit_idx >= all_qubits.size()) {
+                    QL_FATAL("Illegal qubit parameter index " << qubit_idx
+                                                              << " exceeds actual number of parameters given (" << all_qubits.size()
+                                                              << ") while adding sub ins '" << sub_ins_name
+                                                              << "' in parameterized instruction '" << gate.name << "'");
+                }
+                this_gate_qubits.push_back(all_qubits[qubit_idx]);
+            }
         } else {
-            QL_ICE("gate decomposition not available for '" << sub_ins << "' in the target platform");
+            this_gate_qubits = sub_gate.operands;
+        }
+        QL_DOUT("actual qubits of this gate: " << this_gate_qubits);
+
+        // custom gate check
+        // when found, custom_added is true, and the expanded subinstruction was added to the circuit
+        Bool custom_added = add_custom_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
+        if (!custom_added) {
+            if (com::options::get_cached().use_default_gates) {
+                // default gate check
+                QL_DOUT("adding default gate for " << sub_ins_name);
+                Bool default_available = add_default_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
+                if (default_available) {
+                    if (parameterized) {
+                        QL_WOUT("added default gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
+                    } else {
+                        QL_DOUT("added default gate '" << sub_ins_name << "' with qubits " << this_gate_qubits); // // NB: changed WOUT to DOUT, since this is common for 'barrier', spamming log
+                    }
+                } else {
+                    QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
+                }
+            } else {
+                QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
+            }
         }
     }
 }
@@ -655,50 +813,7 @@ Bool Kernel::add_spec_decomposed_gate_if_available(
         }
 
         // perform decomposition
-        Vec<Str> sub_instructions;
-        get_decomposed_ins(*gptr, sub_instructions);
-        for (auto &sub_ins : sub_instructions) {
-            // extract name and qubits
-            QL_DOUT("Adding sub ins: " << sub_ins);
-            std::replace(sub_ins.begin(), sub_ins.end(), ',', ' ');    // FIXME: perform all conversions in sanitize_instruction_name()
-            QL_DOUT(" after comma removal, sub ins: " << sub_ins);
-            std::istringstream iss(sub_ins);
-
-            Vec<Str> tokens{
-                std::istream_iterator<Str>{iss},
-                std::istream_iterator<Str>{}
-            };
-
-            Vec<UInt> this_gate_qubits;
-            Str &sub_ins_name = tokens[0];
-
-            for (UInt i = 1; i < tokens.size(); i++) {
-                QL_DOUT("tokens[i] : " << tokens[i]);
-                auto sub_str_token = tokens[i].substr(1);
-                QL_DOUT("sub_str_token[i] : " << sub_str_token);
-                this_gate_qubits.push_back(stoi(tokens[i].substr(1)));
-            }
-
-            QL_DOUT("actual qubits of this gate:" << this_gate_qubits);
-
-            // custom gate check
-            // when found, custom_added is true, and the expanded subinstruction was added to the circuit
-            Bool custom_added = add_custom_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
-            if (!custom_added) {
-                if (com::options::get("use_default_gates") == "yes") {
-                    // default gate check
-                    QL_DOUT("adding default gate for " << sub_ins_name);
-                    Bool default_available = add_default_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
-                    if (default_available) {
-                        QL_DOUT("added default gate '" << sub_ins_name << "' with qubits " << this_gate_qubits); // // NB: changed WOUT to DOUT, since this is common for 'barrier', spamming log
-                    } else {
-                        QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
-                    }
-                } else {
-                    QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
-                }
-            }
-        }
+        add_decomposed_gate(*gptr, false, all_qubits, cregs, bregs, gcond, gcondregs);
         added = true;
     } else {
         QL_DOUT("composite gate not found for " << instr_parameterized);
@@ -751,54 +866,7 @@ Bool Kernel::add_param_decomposed_gate_if_available(
             return false;
         }
 
-        Vec<Str> sub_instructions;
-        get_decomposed_ins(*gptr, sub_instructions);
-        for (auto &sub_ins : sub_instructions) {
-            QL_DOUT("Adding sub ins: " << sub_ins);
-            std::replace( sub_ins.begin(), sub_ins.end(), ',', ' ');
-            QL_DOUT(" after comma removal, sub ins: " << sub_ins);
-
-            // tokenize sub_ins into sub_ins_name and this_gate_qubits
-            // FIXME: similar code in add_spec_decomposed_gate_if_available()
-            std::istringstream iss(sub_ins);
-            Vec<Str> tokens{ std::istream_iterator<Str>{iss},
-                                             std::istream_iterator<Str>{} };
-
-            Vec<UInt> this_gate_qubits;
-            Str & sub_ins_name = tokens[0];
-
-            for (UInt i = 1; i < tokens.size(); i++) {
-                auto sub_str_token = tokens[i].substr(1);   // example: tokens[i] equals "%1" -> sub_str_token equals "1"
-                UInt qubit_idx = stoi(sub_str_token);
-                if (qubit_idx >= all_qubits.size()) {
-                    QL_FATAL("Illegal qubit parameter index " << sub_str_token
-                                                              << " exceeds actual number of parameters given (" << all_qubits.size()
-                                                              << ") while adding sub ins '" << sub_ins
-                                                              << "' in parameterized instruction '" << instr_parameterized << "'");
-                }
-                this_gate_qubits.push_back(all_qubits[qubit_idx]);
-            }
-            QL_DOUT("actual qubits of this gate: " << this_gate_qubits);
-
-            // FIXME: following code block exists several times in this file
-            // custom gate check
-            // when found, custom_added is true, and the expanded subinstruction was added to the circuit
-            Bool custom_added = add_custom_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
-            if (!custom_added) {
-                if (com::options::get("use_default_gates") == "yes") {
-                    // default gate check
-                    QL_DOUT("adding default gate for " << sub_ins_name);
-                    Bool default_available = add_default_gate_if_available(sub_ins_name, this_gate_qubits, cregs, 0, 0.0, bregs, gcond, gcondregs);
-                    if (default_available) {
-                        QL_WOUT("added default gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
-                    } else {
-                        QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
-                    }
-                } else {
-                    QL_USER_ERROR("unknown gate '" << sub_ins_name << "' with qubits " << this_gate_qubits);
-                }
-            }
-        }
+        add_decomposed_gate(*gptr, true, all_qubits, cregs, bregs, gcond, gcondregs);
         added = true;
     } else {
         QL_DOUT("composite gate not found for " << instr_parameterized);
@@ -834,21 +902,7 @@ void Kernel::gate(
 ) {
     QL_DOUT("gate:" <<" gname=" << gname <<" qubits=" << qubits <<" cregs=" << cregs <<" duration=" << duration <<" angle=" << angle <<" bregs=" << bregs <<" gcond=" << gcond <<" gcondregs=" << gcondregs);
 
-    for (auto &qno : qubits) {
-        if (qno >= qubit_count) {
-            QL_FATAL("Number of qubits in platform: " << to_string(qubit_count) << ", specified qubit numbers out of range for gate: '" << gname << "' with qubits " << qubits);
-        }
-    }
-    for (auto &cno : cregs) {
-        if (cno >= creg_count) {
-            QL_FATAL("Out of range operand(s) for '" << gname << "' with cregs " << cregs);
-        }
-    }
-    for (auto &bno : bregs) {
-        if (bno >= breg_count) {
-            QL_FATAL("Out of range operand(s) for '" << gname << "' with bregs " << bregs);
-        }
-    }
+    gate_check_operands(gname, qubits, cregs, bregs);
     if (!Gate::is_valid_cond(gcond, gcondregs)) {
         QL_FATAL("Condition " << gcond << " of '" << gname << "' incompatible with gcondregs " << gcondregs);
     }
@@ -866,6 +920,32 @@ void Kernel::gate(
     }
 }
 
+/**
+ * check register indices against platform parameters; fail fatally if an index is out of range
+ */
+void Kernel::gate_check_operands(
+    const Str &gname,
+    const Vec<UInt> &qubits,
+    const Vec<UInt> &cregs,
+    const Vec<UInt> &bregs
+) const {
+    for (auto &qno : qubits) {
+        if (qno >= qubit_count) {
+            QL_FATAL("Number of qubits in platform: " << to_string(qubit_count) << ", specified qubit numbers out of range for gate: '" << gname << "' with qubits " << qubits);
+        }
+    }
+    for (auto &cno : cregs) {
+        if (cno >= creg_count) {
+            QL_FATAL("Out of range operand(s) for '" << gname << "' with cregs " << cregs);
+        }
+    }
+    for (auto &bno : bregs) {
+        if (bno >= breg_count) {
+            QL_FATAL("Out of range operand(s) for '" << gname << "' with bregs " << bregs);
+        }
+    }
+}
+
 /**
  * preset condition to make all future created gates conditional gates with this condition
  * preset ends when cleared: back to {cond_always, {}};
@@ -1010,7 +1090,7 @@ Bool Kernel::gate_nonfatal(
                 added = true;
                 QL_DOUT("custom gate added for " << gname_lower);
             } else {
-                if (com::options::get("use_default_gates") == "yes") {
+                if (com::options::get_cached().use_default_gates) {
                     // default gate check (which is always parameterized)
                     QL_DOUT("adding default gate for " << gname_lower);
 
@@ -1029,6 +1109,70 @@ Bool Kernel::gate_nonfatal(
     return added;
 }
 
+/**
+ * Returns the custom gate that gate() would add as-is for the given lowercase
+ * gate name and qubit operands, or nullptr if gate() would decompose it or
+ * fall back to a default gate. This mirrors the lookup order of
+ * gate_nonfatal().
+ */
+const gate_types::Custom *Kernel::find_direct_custom_gate(
+    const Str &gname,
+    const Vec<UInt> &qubits
+) const {
+#ifdef OPT_DECOMPOSE_WAIT_BARRIER  // hack to skip wait/barrier
+    if (gname=="wait" || gname=="barrier") {
+        return nullptr;
+    }
+#endif
+
+    // specialized and parameterized composite gates take precedence
+    Str spec_name = "";
+    Str param_name = "";
+    for (UInt i = 0; i < qubits.size(); i++) {
+        if (i) {
+            spec_name += ",";
+            param_name += ",";
+        }
+        spec_name += "q" + to_string(qubits[i]);
+        param_name += "%" + to_string(i);
+    }
+    for (const auto &composite_name : {gname + " " + spec_name, gname + " " + param_name}) {
+        auto it = platform->instruction_map.find(composite_name);
+        if (it != platform->instruction_map.end() && !it->second.as<gate_types::Composite>().empty()) {
+            return nullptr;
+        }
+    }
+
+    return platform->find_custom_gate(gname, qubits);
+}
+
+/**
+ * Equivalent to gate() for a custom gate resolved by find_direct_custom_gate().
+ */
+void Kernel::custom_gate(
+    const Str &gname,
+    const gate_types::Custom &custom,
+    const Vec<UInt> &qubits,
+    const Vec<UInt> &cregs,
+    UInt duration,
+    Real angle,
+    const Vec<UInt> &bregs
+) {
+    gate_check_operands(gname, qubits, cregs, bregs);
+    auto lqubits = qubits;
+    auto lcregs = cregs;
+    auto lbregs = bregs;
+    auto gcond = ConditionType::ALWAYS;
+    gate_add_implicits(gname, lqubits, lcregs, duration, angle, lbregs, gcond, {});
+
+    // impose kernel's preset condition if any, like gate_nonfatal() does
+    if (condition != ConditionType::ALWAYS) {
+        add_custom_gate(custom, lqubits, lcregs, duration, angle, lbregs, condition, cond_operands);
+    } else {
+        add_custom_gate(custom, lqubits, lcregs, duration, angle, lbregs, gcond, {});
+    }
+}
+
 // to add unitary to kernel
 void Kernel::gate(
     com::dec::Unitary &u,
@@ -1093,18 +1237,33 @@ Str Kernel::get_epilogue() const {
     return ss.str();
 }
 
-Str Kernel::qasm() const {
-    StrStrm ss;
+void Kernel::qasm(std::ostream &os) const {
+    static const UInt FLUSH_SIZE = 1 << 16;
 
-    ss << get_prologue();
+    os << get_prologue();
 
-    for (UInt i = 0; i < gates.size(); ++i) {
-        ss << "    " << gates[i]->qasm() << "\n";
+    // gates are appended into a single buffer that is written out in chunks,
+    // so no temporary strings are constructed per gate
+    Str buf;
+    buf.reserve(FLUSH_SIZE + 256);
+    for (const auto &gate : gates) {
+        buf += "    ";
+        gate->append_qasm(buf);
+        buf += '\n';
+        if (buf.size() >= FLUSH_SIZE) {
+            os.write(buf.data(), buf.size());
+            buf.clear();
+        }
     }
+    os.write(buf.data(), buf.size());
 
-    ss << get_epilogue();
+    os << get_epilogue();
+}
 
-    return  ss.str();
+Str Kernel::qasm() const {
+    StrStrm ss;
+    qasm(ss);
+    return ss.str();
 }
 
 /**
@@ -1125,12 +1284,12 @@ void Kernel::classical(const ClassicalRegister &destination, const ClassicalOper
         }
     }
 
-    gates.emplace<gate_types::Classical>(destination, oper);
+    add_gate<gate_types::Classical>(destination, oper);
     cycles_valid = false;
 }
 
 void Kernel::classical(const Str &operation) {
-    gates.emplace<gate_types::Classical>(operation);
+    add_gate<gate_types::Classical>(operation);
     cycles_valid = false;
 }
 
@@ -1421,10 +1580,10 @@ void Kernel::controlled_single(
             UInt cq2 = control_qubit;
             UInt tq = goperands[1];
 
-            auto opt = com::options::get("decompose_toffoli");
-            if (opt == "AM") {
+            auto opt = com::options::get_cached().decompose_toffoli;
+            if (opt == com::options::ToffoliDecomposition::AM) {
                 controlled_cnot_AM(tq, cq1, cq2);
-            } else if (opt == "NC") {
+            } else if (opt == com::options::ToffoliDecomposition::NC) {
                 controlled_cnot_NC(tq, cq1, cq2);
             } else {
                 toffoli(cq1, cq2, tq);
@@ -1578,6 +1737,25 @@ void Kernel::conjugate(const Kernel &k) {
     QL_COUT("Generating conjugate kernel [Done]");
 }
 
+/**
+ * Makes the given kernel reference the only owner of its kernel, by replacing
+ * it with a copy if the kernel is also referenced from elsewhere. Kernels are
+ * thus shared until they are modified. The copy gets copies of the gates as
+ * well, because passes modify gates in place, for example to set their cycle
+ * numbers or to map their operands. Returns the reference.
+ */
+KernelRef &make_mutable(KernelRef &kernel) {
+    if (!kernel.empty() && kernel.get_ptr().use_count() > 1) {
+        auto copy = KernelRef::make(*kernel);
+        copy->gates.reset();
+        for (const auto &gate : kernel->gates) {
+            copy->gates.add(kernel->copy_gate(*gate));
+        }
+        kernel = copy;
+    }
+    return kernel;
+}
+
 } // namespace compat
 } // namespace ir
 } // namespace ql
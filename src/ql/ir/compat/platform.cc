@@ -4,9 +4,16 @@
 
 #include "ql/ir/compat/platform.h"
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
 #include <regex>
+#include <unordered_map>
 #include "ql/config.h"
+#include "ql/version.h"
 #include "ql/utils/filesystem.h"
+#include "ql/utils/binary_io.h"
+#include "ql/com/options.h"
 #include "ql/rmgr/manager.h"
 #include "ql/arch/factory.h"
 
@@ -428,7 +435,7 @@ static utils::Str sanitize_instruction_name(utils::Str name) {
 
 static GateRef load_instruction(
     const utils::Str &name,
-    utils::Json &instr,
+    const utils::Json &instr,
     utils::UInt num_qubits,
     utils::UInt cycle_time
 ) {
@@ -453,14 +460,18 @@ static GateRef load_instruction(
 
 /**
  * Loads the platform members from the given JSON data and optional
- * auxiliary compiler configuration file.
+ * auxiliary compiler configuration file. The JSON data is moved into the
+ * platform, leaving platform_cfg in a valid but unspecified state.
  */
 void Platform::load(
     utils::Json &platform_cfg,
     const utils::Str &platform_config_fname,
     const utils::Str &compiler_config
 ) {
-    platform_config = platform_cfg;
+    // Take ownership of the configuration data. Once preprocessed, it is
+    // frozen and shared by all copies of this platform.
+    auto config = std::make_shared<utils::Json>(std::move(platform_cfg));
+    utils::Json &cfg = *config;
     arch::Factory arch_factory = {};
 
     // Load compiler configuration.
@@ -470,22 +481,22 @@ void Platform::load(
         // using "eqasm_compiler".
         compiler_settings = utils::load_json(compiler_config);
 
-    } else if (platform_config.count("eqasm_compiler") <= 0) {
+    } else if (cfg.count("eqasm_compiler") <= 0) {
 
         // Let's be lenient. We have sane defaults regardless of what's
         // specified here.
         architecture = arch_factory.build_from_namespace("none");
         compiler_settings = "\"\""_json;
 
-    } else if (platform_config["eqasm_compiler"].type() == utils::Json::value_t::object) {
+    } else if (cfg["eqasm_compiler"].type() == utils::Json::value_t::object) {
 
         // Inline configuration object.
-        compiler_settings = platform_config["eqasm_compiler"];
+        compiler_settings = cfg["eqasm_compiler"];
 
-    } else if (platform_config["eqasm_compiler"].type() == utils::Json::value_t::string) {
+    } else if (cfg["eqasm_compiler"].type() == utils::Json::value_t::string) {
 
         // Figure out what kind of string this is.
-        utils::Str s = platform_config["eqasm_compiler"].get<utils::Str>();
+        utils::Str s = cfg["eqasm_compiler"].get<utils::Str>();
         architecture = arch_factory.build_from_eqasm_compiler(s);
         if (!architecture.has_value()) {
 
@@ -538,70 +549,86 @@ void Platform::load(
     QL_ASSERT(architecture.has_value());
 
     // Do architecture-specific preprocessing before anything else.
-    architecture->preprocess_platform(platform_config);
+    architecture->preprocess_platform(cfg);
+    platform_config = config;
+
+    load_preprocessed();
+}
+
+/**
+ * Loads the platform members that follow from the preprocessed platform
+ * configuration in platform_config: the hardware settings, the resources,
+ * the topology (unless it has already been set), and the instructions.
+ */
+void Platform::load_preprocessed() {
+    const utils::Json &cfg = *platform_config;
 
     // load hardware_settings
-    if (platform_config.count("hardware_settings") <= 0) {
+    if (cfg.count("hardware_settings") <= 0) {
         QL_FATAL("'hardware_settings' section is not specified in the hardware config file");
     } else {
-        hardware_settings = platform_config["hardware_settings"];
-        if (hardware_settings.count("qubit_number") <= 0) {
+        hardware_settings = &cfg.at("hardware_settings");
+        if (hardware_settings->count("qubit_number") <= 0) {
             QL_FATAL("qubit number of the platform is not specified in the configuration file !");
         } else {
-            qubit_count = hardware_settings["qubit_number"];
+            qubit_count = (*hardware_settings)["qubit_number"];
         }
-        if (hardware_settings.count("creg_number") <= 0) {
+        if (hardware_settings->count("creg_number") <= 0) {
             creg_count = 0;
             compat_implicit_creg_count = true;
         } else {
-            creg_count = hardware_settings["creg_number"];
+            creg_count = (*hardware_settings)["creg_number"];
             compat_implicit_creg_count = false;
         }
-        if (hardware_settings.count("breg_number") <= 0) {
+        if (hardware_settings->count("breg_number") <= 0) {
             breg_count = 0;
             compat_implicit_breg_count = true;
         } else {
-            breg_count = hardware_settings["breg_number"];
+            breg_count = (*hardware_settings)["breg_number"];
             compat_implicit_breg_count = false;
         }
-        if (hardware_settings.count("cycle_time") <= 0) {
+        if (hardware_settings->count("cycle_time") <= 0) {
             QL_WOUT("hardware_settings.cycle_time is not specified in the configuration file; assuming 1 \"ns\" for ease of calculation");
             cycle_time = 1;
         } else {
-            cycle_time = hardware_settings["cycle_time"];
+            cycle_time = (*hardware_settings)["cycle_time"];
         }
     }
 
     // load instruction_settings
-    if (platform_config.count("instructions") <= 0) {
+    if (cfg.count("instructions") <= 0) {
         QL_FATAL("'instructions' section is not specified in the hardware config file");
     } else {
-        instruction_settings = platform_config["instructions"];
+        instruction_settings = &cfg.at("instructions");
     }
 
     // load platform resources
-    if (platform_config.count("resources") <= 0) {
+    if (cfg.count("resources") <= 0) {
         QL_WOUT("'resources' section is not specified in the hardware config file; assuming that there are none");
         resources = "{}"_json;
     } else {
-        resources = platform_config["resources"];
+        resources = cfg.at("resources");
     }
 
     // load platform topology
-    if (platform_config.count("topology") <= 0) {
+    if (topology.has_value()) {
+        if (topology->get_num_qubits() != qubit_count) {
+            QL_FATAL("topology does not match the number of qubits of the platform");
+        }
+    } else if (cfg.count("topology") <= 0) {
         QL_WOUT("'topology' section is not specified in the hardware config file; a fully-connected topology will be generated");
         topology.emplace(qubit_count, "{}"_json);
     } else {
-        topology.emplace(qubit_count, platform_config["topology"]);
+        topology.emplace(qubit_count, cfg.at("topology"));
     }
 
     // load instructions
-    const utils::Json &instructions = platform_config["instructions"];
+    const utils::Json &instructions = *instruction_settings;
     static const std::regex comma_space_pattern("\\s*,\\s*");
 
     for (auto it = instructions.begin(); it != instructions.end(); ++it) {
         utils::Str instr_name = it.key();
-        utils::Json attr = *it; //.value();
+        const utils::Json &attr = *it;
 
         instr_name = sanitize_instruction_name(instr_name);
         instr_name = std::regex_replace(instr_name, comma_space_pattern, ",");
@@ -629,8 +656,8 @@ void Platform::load(
     // Examples:
     // - Parametrized gate-decomposition: "cl_2 %0": ["rxm90 %0", "rym90 %0"]
     // - Specialized gate-decomposition:  "rx180 q0" : ["x q0"]
-    if (platform_config.count("gate_decomposition") > 0) {
-        const utils::Json &gate_decomposition = platform_config["gate_decomposition"];
+    if (cfg.count("gate_decomposition") > 0) {
+        const utils::Json &gate_decomposition = cfg.at("gate_decomposition");
         for (auto it = gate_decomposition.begin();
              it != gate_decomposition.end(); ++it) {
             // standardize instruction name
@@ -704,6 +731,14 @@ void Platform::load(
         }
     }
 
+    build_instruction_index();
+
+}
+
+/**
+ * Constructs an empty platform, to be filled by read_snapshot().
+ */
+Platform::Platform(const utils::Str &name) : name(name) {
 }
 
 /**
@@ -754,6 +789,88 @@ Platform::Platform(
     load(platform_config_mut, compiler_config);
 }
 
+/**
+ * Process-wide cache of fully loaded and post-processed platforms, used by
+ * build() to avoid loading the same configuration over and over again.
+ */
+struct PlatformBuildCache {
+
+    /**
+     * Mutex protecting the entries.
+     */
+    std::mutex mutex;
+
+    /**
+     * Map from cache key to the cached platform. The cached platforms are
+     * never handed out directly, as platforms are not entirely immutable, so
+     * build() returns copies of them.
+     */
+    std::unordered_map<utils::Str, PlatformRef> entries;
+
+};
+
+/**
+ * Returns the platform build cache. It is intentionally leaked, to avoid
+ * depending on the destruction order of static objects.
+ */
+static PlatformBuildCache &get_build_cache() {
+    static PlatformBuildCache *cache = new PlatformBuildCache();
+    return *cache;
+}
+
+/**
+ * Returns the contents of the given compiler configuration file for use in a
+ * platform build cache key, or an empty string if there is none.
+ */
+static utils::Str get_compiler_config_key(const utils::Str &compiler_config) {
+    if (compiler_config.empty()) {
+        return "";
+    }
+    return utils::InFile(compiler_config).read();
+}
+
+/**
+ * Returns a platform with the given name, constructed by copying the cached
+ * platform for the given key if there is one, or constructing and caching one
+ * using the given function otherwise. The copy shares the gate prototypes in
+ * instruction_map, the platform configuration JSON, and the architecture with
+ * the cached platform, but everything that may be modified after construction
+ * is copied. An empty key
+ * disables the cache.
+ */
+static PlatformRef build_cached(
+    const utils::Str &key,
+    const utils::Str &name,
+    const std::function<PlatformRef()> &construct
+) {
+    if (key.empty() || !com::options::global["platform_cache"].as_bool()) {
+        return construct();
+    }
+    auto &cache = get_build_cache();
+
+    // Look for a cached platform. Construction happens without holding the
+    // lock; if another thread constructed the same platform in the meantime,
+    // we just use theirs.
+    PlatformRef cached;
+    {
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        auto it = cache.entries.find(key);
+        if (it != cache.entries.end()) {
+            cached = it->second;
+        }
+    }
+    if (cached.empty()) {
+        cached = construct();
+        std::lock_guard<std::mutex> lock{cache.mutex};
+        cached = cache.entries.emplace(key, cached).first->second;
+    }
+
+    PlatformRef ref;
+    ref.set(std::make_shared<Platform>(*cached));
+    ref->name = name;
+    return ref;
+}
+
 /**
  * Constructs a platform from the given configuration filename.
  */
@@ -762,10 +879,45 @@ PlatformRef Platform::build(
     const utils::Str &platform_config,
     const utils::Str &compiler_config
 ) {
-    PlatformRef ref;
-    ref.set(std::shared_ptr<Platform>(new Platform(name, platform_config, compiler_config)));
-    ref->architecture->post_process_platform(ref);
-    return ref;
+
+    // Architecture names map to embedded configurations that can't change,
+    // so the name suffices as key. For files, the key includes the contents
+    // and the resolved filename, as eqasm_compiler filenames are resolved
+    // relative to it. If the file doesn't exist, don't cache, so the
+    // constructor reports the error.
+    utils::Str key;
+    if (arch::Factory().build_from_namespace(platform_config).has_value()) {
+        key = "arch\n" + platform_config;
+    } else if (utils::is_file(platform_config)) {
+        auto contents = utils::InFile(platform_config, true).read();
+
+        // Platform snapshots are self-contained, so the contents suffice as
+        // key.
+        if (is_snapshot(contents.data(), contents.size())) {
+            if (!compiler_config.empty()) {
+                QL_USER_ERROR(
+                    "a compiler configuration file cannot be specified "
+                    "when loading platform snapshot " << platform_config
+                );
+            }
+            return build_cached("snapshot\n" + contents, name, [&]() {
+                return read_snapshot(name, contents.data(), contents.size());
+            });
+        }
+
+        key = "file\n" + utils::path_relative_to(utils::get_working_directory(), platform_config);
+        key += "\n" + contents;
+    }
+    if (!key.empty()) {
+        key += "\n" + get_compiler_config_key(compiler_config);
+    }
+
+    return build_cached(key, name, [&]() {
+        PlatformRef ref;
+        ref.set(std::shared_ptr<Platform>(new Platform(name, platform_config, compiler_config)));
+        ref->architecture->post_process_platform(ref);
+        return ref;
+    });
 }
 
 /**
@@ -776,9 +928,160 @@ PlatformRef Platform::build(
     const utils::Json &platform_config,
     const utils::Str &compiler_config
 ) {
+    auto key = "json\n" + platform_config.dump() + "\n" + get_compiler_config_key(compiler_config);
+    return build_cached(key, name, [&]() {
+        PlatformRef ref;
+        ref.set(std::shared_ptr<Platform>(new Platform(name, platform_config, compiler_config)));
+        ref->architecture->post_process_platform(ref);
+        return ref;
+    });
+}
+
+/**
+ * Clears the cache used by build().
+ */
+void Platform::clear_build_cache() {
+    auto &cache = get_build_cache();
+    std::lock_guard<std::mutex> lock{cache.mutex};
+    cache.entries.clear();
+}
+
+/**
+ * Magic number at the start of each platform snapshot.
+ */
+static const char SNAPSHOT_MAGIC[4] = {'Q', 'L', 'P', 'S'};
+
+/**
+ * Version of the platform snapshot format. This is incremented whenever the
+ * layout of the snapshot or of the topology data changes.
+ */
+static const utils::UInt SNAPSHOT_FORMAT_VERSION = 1;
+
+/**
+ * Writes a snapshot of this platform to the given stream, in a versioned
+ * binary format. The snapshot contains the platform configuration as
+ * preprocessed and post-processed by the architecture, the compiler
+ * configuration, and the topology including the data derived from it
+ * (adjacency, edge maps, and distance matrix). Loading it thus avoids
+ * reading and preprocessing the configuration files and building the
+ * topology. The instructions are loaded from the stored configuration
+ * as usual. Snapshots are only readable by the OpenQL version that wrote
+ * them.
+ *
+ * The snapshot consists of the four-byte magic number `QLPS`, a 32-bit
+ * format version, and length-prefixed fields for the OpenQL version, the
+ * architecture variant, and the compiler configuration, platform
+ * configuration, and resource JSON data (as CBOR), followed by the topology.
+ * All integers are little-endian.
+ */
+void Platform::write_snapshot(std::ostream &os) const {
+    utils::Str buf(SNAPSHOT_MAGIC, 4);
+    utils::BinaryWriter writer{buf};
+    writer.write_uint(SNAPSHOT_FORMAT_VERSION, 4);
+    writer.write_str(OPENQL_VERSION_STRING);
+    writer.write_str(architecture->family->get_namespace_name() + "." + architecture->variant);
+    writer.write_json(compiler_settings);
+    writer.write_json(*platform_config);
+    writer.write_json(resources);
+    topology->write_binary(writer);
+    os.write(buf.data(), buf.size());
+    if (!os.good()) {
+        QL_USER_ERROR("failed to write platform snapshot");
+    }
+}
+
+/**
+ * Same as write_snapshot(), but writes to the given file. The file can
+ * be passed to build() in place of a platform configuration file.
+ */
+void Platform::write_snapshot_file(const utils::Str &fname) const {
+    utils::OutFile file{fname, true};
+    write_snapshot(file.unwrap());
+    file.close();
+}
+
+/**
+ * Returns whether the given buffer starts like a platform snapshot.
+ */
+utils::Bool Platform::is_snapshot(const char *data, utils::UInt size) {
+    return size >= 4 && std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4, data);
+}
+
+/**
+ * Constructs a platform with the given name from the given snapshot
+ * buffer, which must contain exactly one snapshot. The buffer is only
+ * read from and not retained, so it may for instance be a memory-mapped
+ * file. This does not use the cache of build().
+ */
+PlatformRef Platform::read_snapshot(
+    const utils::Str &name,
+    const char *data,
+    utils::UInt size
+) {
+    if (!is_snapshot(data, size)) {
+        QL_USER_ERROR("not an OpenQL platform snapshot (bad magic number)");
+    }
+    utils::BinaryReader reader{data + 4, size - 4, "platform snapshot"};
+    auto version = reader.read_uint(4);
+    if (version != SNAPSHOT_FORMAT_VERSION) {
+        QL_USER_ERROR(
+            "unsupported platform snapshot format version " << version
+            << "; this version of OpenQL reads version " << SNAPSHOT_FORMAT_VERSION
+        );
+    }
+    auto openql_version = reader.read_str();
+    if (openql_version != OPENQL_VERSION_STRING) {
+        QL_USER_ERROR(
+            "platform snapshot was written by OpenQL " << openql_version
+            << " and must be recreated for OpenQL " << OPENQL_VERSION_STRING
+        );
+    }
+
+    PlatformRef ref;
+    ref.set(std::shared_ptr<Platform>(new Platform(name)));
+    auto architecture_name = reader.read_str();
+    ref->architecture = arch::Factory().build_from_namespace(architecture_name);
+    if (!ref->architecture.has_value()) {
+        QL_USER_ERROR("platform snapshot uses unknown architecture " << architecture_name);
+    }
+    ref->compiler_settings = reader.read_json();
+    ref->platform_config = std::make_shared<const utils::Json>(reader.read_json());
+    auto resources = reader.read_json();
+    ref->topology.emplace(com::Topology::read_binary(reader));
+    if (reader.remaining()) {
+        QL_USER_ERROR("platform snapshot has trailing data");
+    }
+
+    // The configuration was already preprocessed, and the only thing that
+    // post-processing by the architecture changes is the resource
+    // configuration, which we restore after loading the rest.
+    ref->load_preprocessed();
+    ref->resources = std::move(resources);
+    return ref;
+}
+
+/**
+ * Returns a copy of this platform with the given couplers and all couplers of
+ * the given qubits disabled in its topology (see com::Topology::disable()),
+ * for compiling against a degraded device. Everything but the topology is
+ * shared with this platform, and the topology only repairs the distances that
+ * are affected, so this is much cheaper than building a platform from an
+ * edited configuration. This platform is not modified. Snapshots written for
+ * the returned platform contain the degraded topology.
+ */
+PlatformRef Platform::derive_degraded(
+    const utils::Vec<com::Topology::QubitPair> &couplers,
+    const utils::Vec<com::Topology::Qubit> &qubits
+) const {
+    com::Topology degraded = *topology;
+    try {
+        degraded.disable(couplers, qubits);
+    } catch (utils::Exception &e) {
+        QL_USER_ERROR("failed to derive degraded platform from " << name << ": " << e.what());
+    }
     PlatformRef ref;
-    ref.set(std::shared_ptr<Platform>(new Platform(name, platform_config, compiler_config)));
-    ref->architecture->post_process_platform(ref);
+    ref.set(std::make_shared<Platform>(*this));
+    ref->topology.emplace(std::move(degraded));
     return ref;
 }
 
@@ -803,10 +1106,11 @@ void Platform::dump_info(std::ostream &os, utils::Str line_prefix) const {
  */
 const utils::Json &Platform::find_instruction(const utils::Str &iname) const {
     // search the JSON defined instructions, to prevent JSON exception if key does not exist
-    if (!QL_JSON_EXISTS(instruction_settings, iname)) {
+    auto it = instruction_settings->find(iname);
+    if (it == instruction_settings->end()) {
         QL_FATAL("JSON file: instruction not found: '" << iname << "'");
     }
-    return instruction_settings[iname];
+    return *it;
 }
 
 /**
@@ -816,7 +1120,23 @@ const utils::Json &Platform::find_instruction(const utils::Str &iname) const {
  *  have been parsed rather than be in JSON form.
  */
 const utils::Json &Platform::get_instructions() const {
-    return instruction_settings;
+    return *instruction_settings;
+}
+
+/**
+ * Returns the additional hardware settings (to use by the eqasm backend),
+ * corresponding to the `"hardware_settings"` key in the root JSON object.
+ */
+const utils::Json &Platform::get_hardware_settings() const {
+    return *hardware_settings;
+}
+
+/**
+ * Returns the *complete* platform configuration JSON, after preprocessing by
+ * the architecture.
+ */
+const utils::Json &Platform::get_platform_config() const {
+    return *platform_config;
 }
 
 /**
@@ -826,6 +1146,105 @@ utils::UInt Platform::time_to_cycles(utils::Real time_ns) const {
     return ceil(time_ns / cycle_time);
 }
 
+/**
+ * Parses the qubit operand list of a specialized instruction name, such as
+ * `q0,q3`, into the given vector. Returns false if the list is not in the
+ * canonical form that Kernel uses to look up specialized instructions.
+ */
+static utils::Bool parse_qubit_list(const utils::Str &list, utils::Vec<utils::UInt> &qubits) {
+    utils::Str canonical;
+    utils::UInt start = 0;
+    while (true) {
+        auto end = list.find(',', start);
+        auto operand = list.substr(start, end == utils::Str::npos ? utils::Str::npos : end - start);
+        if (operand.size() < 2 || operand[0] != 'q') {
+            return false;
+        }
+        for (utils::UInt i = 1; i < operand.size(); i++) {
+            if (operand[i] < '0' || operand[i] > '9') {
+                return false;
+            }
+        }
+        auto qubit = utils::parse_uint(operand.substr(1));
+        if (!canonical.empty()) {
+            canonical += ",";
+        }
+        canonical += "q" + utils::to_string(qubit);
+        qubits.push_back(qubit);
+        if (end == utils::Str::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    return canonical == list;
+}
+
+/**
+ * (Re)builds instruction_index from instruction_map.
+ */
+void Platform::build_instruction_index() {
+    instruction_index.clear();
+    for (const auto &it : instruction_map) {
+
+        // Every instruction can be found by its full name.
+        instruction_index[it.first].generic = it.second;
+
+        // Make sure there is an entry for the name without operands, so
+        // has_instruction() also finds parameterized decompositions.
+        instruction_index[it.first.substr(0, it.first.find(' '))];
+
+        // If the name has the form "<name> <qubit list>", the instruction is
+        // also a specialization of <name> for those qubits.
+        auto space = it.first.rfind(' ');
+        if (space == utils::Str::npos) {
+            continue;
+        }
+        utils::Vec<utils::UInt> qubits;
+        if (parse_qubit_list(it.first.substr(space + 1), qubits)) {
+            instruction_index[it.first.substr(0, space)].specialized[qubits] = it.second;
+        }
+
+    }
+}
+
+/**
+ * Returns the custom instruction to use for a gate with the given name and
+ * qubit operands: the specialized instruction for exactly these operands
+ * (e.g. `"cz q0,q3"`) if there is one, otherwise the generic instruction
+ * with the given name, otherwise null. This is equivalent to looking up
+ * the canonical specialized and generic names in instruction_map, but does
+ * not need to build any strings.
+ */
+const gate_types::Custom *Platform::find_custom_gate(
+    const utils::Str &name,
+    const utils::Vec<utils::UInt> &qubits
+) const {
+    auto it = instruction_index.find(name);
+    if (it == instruction_index.end()) {
+        return nullptr;
+    }
+    if (!qubits.empty()) {
+        auto spec = it->second.specialized.find(qubits);
+        if (spec != it->second.specialized.end()) {
+            return &*spec->second;
+        }
+    }
+    if (it->second.generic.empty()) {
+        return nullptr;
+    }
+    return &*it->second.generic;
+}
+
+/**
+ * Returns whether instruction_map defines an instruction or decomposition
+ * by the given name (case-insensitive) for any operands. If not, no gate
+ * by this name can be made, except possibly a default gate. Used to avoid
+ * probing for optional variants like `<name>_prim` gate by gate.
+ */
+utils::Bool Platform::has_instruction(const utils::Str &name) const {
+    return instruction_index.find(utils::to_lower(name)) != instruction_index.end();
+}
+
 } // namespace compat
 } // namespace ir
 } // namespace ql
@@ -104,19 +104,23 @@ Program::Program(
 }
 
 /**
- * Adds the given kernel to the end of the program, after checking that it's
- * safe to add.
+ * Brings kernel_names up to date with the kernels list.
  */
-void Program::add(const KernelRef &kernel) {
-
-    // Check name uniqueness.
-    // FIXME: use a set or a map!
-    for (const auto &kernel2 : kernels) {
-        if (kernel2->name == kernel->name) {
-            throw Exception("duplicate kernel name: " + kernel->name);
-        }
+void Program::index_kernel_names() {
+    if (num_indexed_kernels > kernels.size()) {
+        kernel_names.clear();
+        num_indexed_kernels = 0;
     }
+    for (; num_indexed_kernels < kernels.size(); num_indexed_kernels++) {
+        kernel_names.insert(kernels[num_indexed_kernels]->name);
+    }
+}
 
+/**
+ * Throws an exception if the given kernel cannot be added to this program.
+ * The name is not checked by this function.
+ */
+void Program::check_kernel(const KernelRef &kernel) const {
     // Check platform.
     if (kernel->platform.get_ptr() != platform.get_ptr()) {
         throw Exception(
@@ -147,9 +151,53 @@ void Program::add(const KernelRef &kernel) {
             "than the program declares ( "+ to_string(breg_count) + ")"
         );
     }
+}
+
+/**
+ * Adds the given kernel to the end of the program, after checking that it's
+ * safe to add.
+ */
+void Program::add(const KernelRef &kernel) {
+    check_kernel(kernel);
+
+    // Check name uniqueness.
+    index_kernel_names();
+    if (!kernel_names.insert(kernel->name).second) {
+        throw Exception("duplicate kernel name: " + kernel->name);
+    }
 
     // If sane, add kernel to list of kernels.
     kernels.add(kernel);
+    num_indexed_kernels++;
+
+}
+
+/**
+ * Adds the given kernels to the end of the program, after checking that they
+ * are all safe to add. If any of them is not, none of them are added.
+ */
+void Program::add_kernels(const KernelRefs &ks) {
+    for (const auto &kernel : ks) {
+        check_kernel(kernel);
+    }
+
+    // Check name uniqueness, rolling back the names we inserted if there is
+    // a duplicate.
+    index_kernel_names();
+    for (UInt i = 0; i < ks.size(); i++) {
+        if (!kernel_names.insert(ks[i]->name).second) {
+            for (UInt j = 0; j < i; j++) {
+                kernel_names.erase(ks[j]->name);
+            }
+            throw Exception("duplicate kernel name: " + ks[i]->name);
+        }
+    }
+
+    // If sane, add the kernels to list of kernels.
+    for (const auto &kernel : ks) {
+        kernels.add(kernel);
+    }
+    num_indexed_kernels += ks.size();
 
 }
 
@@ -326,7 +374,7 @@ void Program::add_for(const KernelRef &k, UInt iterations) {
     kernels.add(kphi1);
 
     add(k);
-    kernels.back()->iteration_count = iterations;
+    make_mutable(kernels.back())->iteration_count = iterations;
 
     // phi node
     auto kphi2 = KernelRef::make(k->name+"_for" + to_string(phi_node_count) +"_end", platform, qubit_count, creg_count, breg_count);
@@ -0,0 +1,50 @@
+#include <iostream>
+
+#include "ql/utils/str.h"
+#include "ql/ir/compat/gate.h"
+#include "ql/ir/compat/classical.h"
+
+using namespace ql;
+using namespace ql::utils;
+using namespace ql::ir::compat;
+
+int main() {
+
+    // Simple gates, with and without conditions.
+    QL_ASSERT_EQ(gate_types::Hadamard(3).qasm(), "h q[3]");
+    QL_ASSERT_EQ(gate_types::CNot(1, 23).qasm(), "cnot q[1],q[23]");
+    QL_ASSERT_EQ(gate_types::Toffoli(0, 1, 2).qasm(), "toffoli q[0],q[1],q[2]");
+    QL_ASSERT_EQ(gate_types::RX(4, 0.5).qasm(), "rx q[4], 0.5");
+    QL_ASSERT_EQ(gate_types::Measure(5, 6).qasm(), "measure q[5], r[6]");
+    QL_ASSERT_EQ(gate_types::Nop().qasm(), "nop");
+
+    gate_types::PauliX x(2);
+    x.condition = ConditionType::NOT;
+    x.cond_operands = {7};
+    QL_ASSERT_EQ(x.qasm(), "cond(!b[7]) x q[2]");
+    x.condition = ConditionType::NOR;
+    x.cond_operands = {7, 8};
+    QL_ASSERT_EQ(x.qasm(), "cond(!(b[7]||b[8])) x q[2]");
+
+    // Custom gates with all kinds of operands.
+    gate_types::Custom c("rz q0");
+    c.operands = {0, 1};
+    c.angle = 0.25;
+    c.creg_operands = {2};
+    c.breg_operands = {3, 4};
+    QL_ASSERT_EQ(c.qasm(), "rz q[0],q[1], 0.25, r[2], b[3], b[4]");
+
+    // Classical gates.
+    QL_ASSERT_EQ(
+        gate_types::Classical(ClassicalRegister(1), ClassicalOperation(ClassicalRegister(2), "+", ClassicalRegister(3))).qasm(),
+        "add r1, r2, r3"
+    );
+    QL_ASSERT_EQ(gate_types::Classical(ClassicalRegister(1), ClassicalOperation(-5)).qasm(), "ldi r1, -5");
+
+    // Gates append to the given buffer.
+    Str buf = "    ";
+    gate_types::Swap(8, 9).append_qasm(buf);
+    QL_ASSERT_EQ(buf, "    swap q[8],q[9]");
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "ql/utils/str.h"
+#include "ql/ir/compat/platform.h"
+#include "ql/ir/compat/kernel.h"
+#include "ql/pass/sch/schedule/detail/scheduler.h"
+
+using namespace ql;
+using namespace ql::utils;
+using namespace ql::ir::compat;
+
+/**
+ * Returns the cycle number of the gate in the given kernel with the given
+ * qasm representation.
+ */
+static UInt get_cycle(const KernelRef &kernel, const Str &qasm) {
+    for (const auto &gate : kernel->gates) {
+        if (gate->qasm() == qasm) {
+            return gate->cycle;
+        }
+    }
+    QL_ICE("gate " << qasm << " not found");
+}
+
+int main() {
+    auto plat = Platform::build("test_plat", Str("cc_light"));
+
+    // Make a kernel that is shared with another reference, for example a
+    // program it was added to, and then make it mutable.
+    auto kernel = KernelRef::make("kernel", plat, 3);
+    kernel->x(0);
+    kernel->cnot(0, 1);
+    kernel->cnot(0, 1);
+    kernel->x(2);
+    auto shared = kernel;
+    make_mutable(kernel);
+    QL_ASSERT(kernel.get_ptr() != shared.get_ptr());
+    QL_ASSERT_EQ(kernel->gates.size(), shared->gates.size());
+    for (UInt i = 0; i < kernel->gates.size(); i++) {
+        QL_ASSERT(kernel->gates[i].get_ptr() != shared->gates[i].get_ptr());
+        QL_ASSERT_EQ(kernel->gates[i]->qasm(), shared->gates[i]->qasm());
+    }
+
+    // Scheduling the two kernels differently must not affect one another,
+    // as the scheduler sets the cycle numbers of the gates in place.
+    pass::sch::schedule::detail::Scheduler asap;
+    asap.init(shared, "test_output/compat_kernel_asap_", false, false, false);
+    asap.schedule_asap();
+    auto asap_cycle = get_cycle(shared, "x q[2]");
+    pass::sch::schedule::detail::Scheduler alap;
+    alap.init(kernel, "test_output/compat_kernel_alap_", false, false, false);
+    alap.schedule_alap();
+    QL_ASSERT_EQ(get_cycle(shared, "x q[2]"), asap_cycle);
+    QL_ASSERT(get_cycle(kernel, "x q[2]") > asap_cycle);
+
+    // Clones with substituted angles don't share gates with the original
+    // either.
+    kernel->rx(1, 0.5);
+    auto clone = kernel->clone_with_angles("clone", {4}, {0.25});
+    QL_ASSERT_EQ(clone->gates[4]->angle, 0.25);
+    QL_ASSERT_EQ(kernel->gates[4]->angle, 0.5);
+    QL_ASSERT(kernel->gates[0].get_ptr() != clone->gates[0].get_ptr());
+
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <iostream>
+
+#include "ql/utils/str.h"
+#include "ql/ir/compat/platform.h"
+
+using namespace ql;
+
+int main() {
+    ir::compat::Platform::clear_build_cache();
+
+    // Building the same platform twice must yield independent copies that
+    // share the gate prototypes.
+    auto a = ir::compat::Platform::build("a", utils::Str("cc_light"));
+    auto b = ir::compat::Platform::build("b", utils::Str("cc_light"));
+    QL_ASSERT(a.get_ptr() != b.get_ptr());
+    QL_ASSERT(a->name == "a");
+    QL_ASSERT(b->name == "b");
+    QL_ASSERT(a->qubit_count == b->qubit_count);
+    QL_ASSERT(a->instruction_map.size() == b->instruction_map.size());
+    QL_ASSERT(!a->instruction_map.empty());
+    QL_ASSERT(
+        a->instruction_map.begin()->second.get_ptr() ==
+        b->instruction_map.begin()->second.get_ptr()
+    );
+    QL_ASSERT(a->find_custom_gate("x", {0}) == b->find_custom_gate("x", {0}));
+    QL_ASSERT(a->has_instruction("x"));
+    QL_ASSERT(a->has_instruction("X"));
+    QL_ASSERT(!a->has_instruction("x_prim"));
+
+    // Modifying one copy must not affect the other.
+    a->creg_count += 10;
+    QL_ASSERT(a->creg_count != b->creg_count);
+
+    // Platforms built from JSON data are cached by content.
+    auto c = ir::compat::Platform::build("c", a->get_platform_config());
+    auto d = ir::compat::Platform::build("d", a->get_platform_config());
+    QL_ASSERT(
+        c->instruction_map.begin()->second.get_ptr() ==
+        d->instruction_map.begin()->second.get_ptr()
+    );
+
+    // A platform loaded from a snapshot matches the original, including the
+    // data derived from the topology.
+    auto snapshot = utils::StrStrm();
+    a->write_snapshot(snapshot);
+    auto data = snapshot.str();
+    QL_ASSERT(ir::compat::Platform::is_snapshot(data.data(), data.size()));
+    auto f = ir::compat::Platform::read_snapshot("f", data.data(), data.size());
+    QL_ASSERT(f->name == "f");
+    QL_ASSERT(f->qubit_count == a->qubit_count);
+    QL_ASSERT(f->cycle_time == a->cycle_time);
+    QL_ASSERT(f->instruction_map.size() == a->instruction_map.size());
+    QL_ASSERT(f->has_instruction("x"));
+    QL_ASSERT(f->resources == a->resources);
+    QL_ASSERT(f->get_platform_config() == a->get_platform_config());
+    QL_ASSERT(f->architecture->get_friendly_name() == a->architecture->get_friendly_name());
+    for (utils::UInt i = 0; i < a->qubit_count; i++) {
+        QL_ASSERT(f->topology->get_neighbors(i) == a->topology->get_neighbors(i));
+        for (utils::UInt j = 0; j < a->qubit_count; j++) {
+            QL_ASSERT(f->topology->get_distance(i, j) == a->topology->get_distance(i, j));
+            QL_ASSERT(f->topology->get_edge_index({i, j}) == a->topology->get_edge_index({i, j}));
+        }
+    }
+    QL_ASSERT_RAISES(ir::compat::Platform::read_snapshot("g", data.data(), data.size() - 1));
+    QL_ASSERT_RAISES(ir::compat::Platform::read_snapshot("g", data.data() + 1, data.size() - 1));
+
+    // After clearing the cache, platforms are loaded from scratch.
+    ir::compat::Platform::clear_build_cache();
+    auto e = ir::compat::Platform::build("e", utils::Str("cc_light"));
+    QL_ASSERT(
+        a->instruction_map.begin()->second.get_ptr() !=
+        e->instruction_map.begin()->second.get_ptr()
+    );
+
+    return 0;
+}
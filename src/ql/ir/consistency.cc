@@ -8,6 +8,7 @@
 #include "ql/utils/exception.h"
 #include "ql/utils/set.h"
 #include "ql/ir/ops.h"
+#include "ql/com/options.h"
 
 namespace ql {
 namespace ir {
@@ -33,6 +34,12 @@ private:
      */
     utils::OptLink<DataType> implicit_bit_type;
 
+    /**
+     * Only every sample_period'th statement of each block is checked, along
+     * with the last statement. 1 means that all statements are checked.
+     */
+    utils::UInt sample_period;
+
     /**
      * Checks that the given string is a valid identifier.
      */
@@ -134,6 +141,19 @@ private:
 
 public:
 
+    /**
+     * Constructs a consistency checker. implicit_bit_type must be specified
+     * when checking a program without its platform; otherwise it is taken from
+     * the platform when it is visited.
+     */
+    explicit ConsistencyChecker(
+        const utils::OptLink<DataType> &implicit_bit_type = {},
+        utils::UInt sample_period = 1
+    ) :
+        implicit_bit_type(implicit_bit_type),
+        sample_period(sample_period)
+    {}
+
     /**
      * Behavior for unknown node types. Assume that means that no check is
      * needed.
@@ -141,6 +161,23 @@ public:
     void visit_node(Node &node) override {
     }
 
+    /**
+     * Visits the statements of a block, or only a sample of them if
+     * sample_period is greater than one.
+     */
+    void visit_block_base(BlockBase &node) override {
+        if (sample_period <= 1) {
+            RecursiveVisitor::visit_block_base(node);
+            return;
+        }
+        auto num_statements = node.statements.size();
+        for (utils::UInt i = 0; i < num_statements; i++) {
+            if (i % sample_period == 0 || i + 1 == num_statements) {
+                node.statements[i]->visit(*this);
+            }
+        }
+    }
+
     /**
      * Checks a platform node.
      */
@@ -930,6 +967,32 @@ public:
 
 };
 
+/**
+ * The statement sample period used for the SAMPLED check level.
+ */
+static const utils::UInt SAMPLE_PERIOD = 64;
+
+/**
+ * Returns the consistency check level configured via the
+ * `ir_consistency_check` global option. When debug logging is enabled, FULL is
+ * always returned.
+ */
+ConsistencyCheckLevel get_consistency_check_level() {
+    if (QL_IS_LOG_DEBUG) {
+        return ConsistencyCheckLevel::FULL;
+    }
+    auto level = com::options::global["ir_consistency_check"].as_str();
+    if (level == "off") {
+        return ConsistencyCheckLevel::OFF;
+    } else if (level == "sampled") {
+        return ConsistencyCheckLevel::SAMPLED;
+    } else if (level == "changed") {
+        return ConsistencyCheckLevel::CHANGED;
+    } else {
+        return ConsistencyCheckLevel::FULL;
+    }
+}
+
 /**
  * Performs a consistency check of the IR. An exception is thrown if a problem
  * is found. The constraints checked by this must be met on any interface that
@@ -937,17 +1000,66 @@ public:
  * might be detrimental for performance.
  */
 void check_consistency(const Ref &ir) {
+    check_consistency(ir, ConsistencyCheckLevel::FULL);
+}
+
+/**
+ * Same as check_consistency(ir), but only performs the amount of checking
+ * indicated by level. changed specifies which parts of the tree may have
+ * changed since they were last checked.
+ */
+void check_consistency(
+    const Ref &ir,
+    ConsistencyCheckLevel level,
+    ChangedParts changed
+) {
+    if (level == ConsistencyCheckLevel::OFF) {
+        return;
+    }
     try {
+        switch (level) {
+            case ConsistencyCheckLevel::SAMPLED: {
 
-        // First, check whether the tree itself is well-formed according to
-        // tree-gen.
-        ir.check_well_formed();
+                // Skip the well-formedness check, and check only a sample of
+                // the statements of each block.
+                ConsistencyChecker consistency_checker{{}, SAMPLE_PERIOD};
+                ir->visit(consistency_checker);
+                break;
 
-        // The well-formedness check doesn't check any of the additional constraints
-        // that the IR imposes. The visitor pattern is great for doing checks like
-        // this, because it recursively walks through the entire tree by default.
-        ConsistencyChecker consistency_checker;
-        ir->visit(consistency_checker);
+            }
+            case ConsistencyCheckLevel::CHANGED: {
+
+                // The well-formedness of the platform can be checked in
+                // isolation, but that of the program can't, because the
+                // program links to the platform.
+                if (changed != ChangedParts::PROGRAM) {
+                    ir->platform.check_well_formed();
+                    ConsistencyChecker consistency_checker;
+                    ir->platform->visit(consistency_checker);
+                }
+                if (changed != ChangedParts::PLATFORM && !ir->program.empty()) {
+                    ConsistencyChecker consistency_checker{ir->platform->implicit_bit_type};
+                    ir->program->visit(consistency_checker);
+                }
+                break;
+
+            }
+            default: {
+
+                // First, check whether the tree itself is well-formed
+                // according to tree-gen.
+                ir.check_well_formed();
+
+                // The well-formedness check doesn't check any of the
+                // additional constraints that the IR imposes. The visitor
+                // pattern is great for doing checks like this, because it
+                // recursively walks through the entire tree by default.
+                ConsistencyChecker consistency_checker;
+                ir->visit(consistency_checker);
+                break;
+
+            }
+        }
 
     } catch (utils::Exception &e) {
 
@@ -0,0 +1,138 @@
+/** \file
+ * Copy-on-write operations on the IR, for cheaply forking (parts of) a
+ * program and modifying the fork without affecting the original.
+ */
+
+#include "ql/ir/cow.h"
+
+#include "ql/utils/map.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * Mapping from the blocks of a program to the blocks of its fork.
+ */
+using BlockMap = utils::Map<BlockRef, BlockRef>;
+
+/**
+ * Returns the block that the given block maps to, the given block itself if
+ * it is not in the map, or empty if the given block is empty.
+ */
+static BlockRef relink(const BlockMap &remap, const BlockRef &block) {
+    if (block.empty()) {
+        return {};
+    }
+    auto it = remap.find(block);
+    if (it != remap.end()) {
+        return it->second;
+    } else {
+        return block;
+    }
+}
+
+/**
+ * Returns whether the given statement is or contains a goto instruction.
+ */
+static utils::Bool contains_goto(const StatementRef &statement);
+
+/**
+ * Returns whether any statement in the given block is or contains a goto
+ * instruction.
+ */
+static utils::Bool contains_goto(const BlockBaseRef &block) {
+    for (const auto &statement : block->statements) {
+        if (contains_goto(statement)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns whether the given statement is or contains a goto instruction.
+ */
+static utils::Bool contains_goto(const StatementRef &statement) {
+    if (statement->as_goto_instruction()) {
+        return true;
+    } else if (auto if_else = statement->as_if_else()) {
+        for (const auto &branch : if_else->branches) {
+            if (contains_goto(branch->body)) {
+                return true;
+            }
+        }
+        return !if_else->otherwise.empty() && contains_goto(if_else->otherwise);
+    } else if (auto loop = statement->as_loop()) {
+        return contains_goto(loop->body);
+    }
+    return false;
+}
+
+static void relink_gotos(const BlockMap &remap, utils::Any<Statement> &statements);
+
+/**
+ * Makes the given sub-block mutable and relinks the goto instructions in it,
+ * if it contains any.
+ */
+static void relink_gotos(const BlockMap &remap, utils::Maybe<SubBlock> &block) {
+    if (!block.empty() && contains_goto(block)) {
+        make_mutable(block);
+        relink_gotos(remap, block->statements);
+    }
+}
+
+/**
+ * Relinks the goto instructions in the given statement list to the forked
+ * blocks, making them and the structured statements containing them mutable
+ * first.
+ */
+static void relink_gotos(const BlockMap &remap, utils::Any<Statement> &statements) {
+    for (auto &statement : statements) {
+        if (!contains_goto(statement)) {
+            continue;
+        }
+        make_mutable(statement);
+        if (auto goto_insn = statement->as_goto_instruction()) {
+            goto_insn->target = relink(remap, goto_insn->target.as_mut());
+        } else if (auto if_else = statement->as_if_else()) {
+            for (auto &branch : if_else->branches) {
+                make_mutable(branch);
+                relink_gotos(remap, branch->body);
+            }
+            relink_gotos(remap, if_else->otherwise);
+        } else if (auto loop = statement->as_loop()) {
+            relink_gotos(remap, loop->body);
+        }
+    }
+}
+
+/**
+ * Returns a fork of the given program that shares all statements with it.
+ * Only the program node and its blocks are copied, along with the goto
+ * instructions (and the structured statements containing them) that need to
+ * be relinked to the copied blocks, so this is linear in the number of
+ * blocks rather than in the size of the program. The statements of the fork
+ * must be made mutable with make_mutable() before being modified; adding,
+ * removing and reordering statements of a forked block is always safe.
+ */
+ProgramRef fork_program(const ProgramRef &program) {
+    auto fork = program.copy();
+    fork->copy_annotations(*program);
+    fork->blocks.reset();
+    BlockMap remap;
+    for (const auto &block : program->blocks) {
+        auto block_fork = block.copy();
+        block_fork->copy_annotations(*block);
+        remap.set(block) = block_fork;
+        fork->blocks.add(block_fork);
+    }
+    fork->entry_point = relink(remap, program->entry_point.as_mut());
+    for (const auto &block : fork->blocks) {
+        block->next = relink(remap, block->next.as_mut());
+        relink_gotos(remap, block->statements);
+    }
+    return std::move(fork);
+}
+
+} // namespace ir
+} // namespace ql
@@ -5,6 +5,9 @@
 #include "ql/ir/cqasm/read.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/hash_map.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/trace.h"
 #include "ql/ir/compat/program.h"
 #include "ql/ir/ops.h"
 #include "ql/ir/consistency.h"
@@ -610,6 +613,91 @@ static utils::One<SetInstruction> convert_set_instruction(
     return utils::make<SetInstruction>(ql_lhs, ql_rhs, ir::make_bit_lit(ir, true));
 }
 
+/**
+ * The signature of a custom instruction for the purpose of finding its
+ * instruction type: its name, and the type and writability of each operand.
+ */
+struct InstructionSignature {
+    utils::Str name;
+    utils::Vec<const DataType*> types;
+    utils::Vec<utils::Bool> writable;
+
+    utils::Bool operator==(const InstructionSignature &rhs) const {
+        return name == rhs.name && types == rhs.types && writable == rhs.writable;
+    }
+};
+
+/**
+ * Hash function for InstructionSignature.
+ */
+struct InstructionSignatureHash {
+    std::size_t operator()(const InstructionSignature &sig) const {
+        auto hash = std::hash<utils::Str>()(sig.name);
+        for (utils::UInt i = 0; i < sig.types.size(); i++) {
+            hash = hash * 31 + std::hash<const DataType*>()(sig.types[i]);
+            hash = hash * 2 + sig.writable[i];
+        }
+        return hash;
+    }
+};
+
+/**
+ * Map from signatures to the instruction types that find_instruction_type()
+ * returned for them, kept for the duration of a single read. Files tend to use
+ * the same few signatures over and over, so this avoids most platform lookups.
+ * Instruction types are not removed while reading, so the links remain valid.
+ */
+using InstructionTypeCache = utils::HashMap<
+    InstructionSignature, InstructionTypeLink, InstructionSignatureHash
+>;
+
+/**
+ * Equivalent to make_instruction(), except that the instruction type of
+ * custom instructions is taken from the given cache if an instruction with the
+ * same signature was converted before.
+ */
+static InstructionRef make_cached_instruction(
+    const Ref &ir,
+    InstructionTypeCache &types,
+    const utils::Str &name,
+    const utils::Any<Expression> &operands,
+    const ExpressionRef &condition
+) {
+    if (name == "set" || name == "wait" || name == "barrier") {
+        return make_instruction(ir, name, operands, condition);
+    }
+
+    InstructionSignature sig{name, {}, {}};
+    utils::Vec<DataTypeLink> operand_types;
+    for (const auto &operand : operands) {
+        operand_types.push_back(get_type_of(operand));
+        sig.types.push_back(operand_types.back().get_ptr().get());
+        sig.writable.push_back(operand->as_reference() != nullptr);
+    }
+    auto it = types.find(sig);
+    if (it == types.end()) {
+        auto ityp = find_instruction_type(ir, name, operand_types, sig.writable);
+        if (ityp.empty()) {
+
+            // Let make_instruction() report the error.
+            return make_instruction(ir, name, operands, condition);
+
+        }
+        it = types.insert({std::move(sig), ityp}).first;
+    }
+
+    auto custom_insn = utils::make<CustomInstruction>();
+    custom_insn->instruction_type = it->second;
+    custom_insn->operands = operands;
+    specialize_instruction(custom_insn);
+    if (condition.empty()) {
+        custom_insn->condition = make_bit_lit(ir, true);
+    } else {
+        custom_insn->condition = condition;
+    }
+    return custom_insn;
+}
+
 /**
  * Converts the contents of a cQASM block to an OpenQL block.
  */
@@ -617,7 +705,8 @@ static void convert_block(
     const Ref &ir,
     const cqt::One<cqs::Block> &cq_block,
     const utils::One<BlockBase> &ql_block,
-    const ReadOptions &options
+    const ReadOptions &options,
+    InstructionTypeCache &types
 ) {
 
     // We need to convert bundle + skip instruction representation of the
@@ -734,7 +823,7 @@ static void convert_block(
                                 ql_operands.add(convert_expression(ir, cq_operand, sgmq_size, sgmq_index));
                             }
                         }
-                        ql_insns.push_back(make_instruction(ir, cq_insn->name, ql_operands, ql_condition));
+                        ql_insns.push_back(make_cached_instruction(ir, types, cq_insn->name, ql_operands, ql_condition));
 
                     } else if (
                         !options.measure_all_target.empty() &&
@@ -745,8 +834,9 @@ static void convert_block(
                         // Handle expansion of measure_all.
                         QL_ASSERT(ir->platform->qubits->shape.size() == 1);
                         for (utils::UInt q = 0; q < ir->platform->qubits->shape[0]; q++) {
-                            ql_insns.push_back(make_instruction(
+                            ql_insns.push_back(make_cached_instruction(
                                 ir,
+                                types,
                                 options.measure_all_target,
                                 {make_qubit_ref(ir, q)},
                                 ql_condition.clone()
@@ -789,7 +879,7 @@ static void convert_block(
                                 ql_operands[1] = x;
                             }
 
-                            ql_insns.push_back(make_instruction(ir, cq_insn->name, ql_operands, ql_condition));
+                            ql_insns.push_back(make_cached_instruction(ir, types, cq_insn->name, ql_operands, ql_condition));
                         }
 
                     }
@@ -916,7 +1006,7 @@ static void convert_block(
 
                 // Convert body.
                 ql_branch->body.emplace();
-                convert_block(ir, cq_branch->body, ql_branch->body, options);
+                convert_block(ir, cq_branch->body, ql_branch->body, options, types);
 
                 ql_if_else->branches.add(ql_branch);
             }
@@ -924,7 +1014,7 @@ static void convert_block(
             // Convert final else block.
             if (!cq_if_else->otherwise.empty()) {
                 ql_if_else->otherwise.emplace();
-                convert_block(ir, cq_if_else->otherwise, ql_if_else->otherwise, options);
+                convert_block(ir, cq_if_else->otherwise, ql_if_else->otherwise, options, types);
             }
 
             // Add to block.
@@ -957,7 +1047,7 @@ static void convert_block(
 
             // Convert body.
             ql_for_loop->body.emplace();
-            convert_block(ir, cq_for_loop->body, ql_for_loop->body, options);
+            convert_block(ir, cq_for_loop->body, ql_for_loop->body, options, types);
 
             // Add to block.
             ql_block->statements.add(ql_for_loop);
@@ -983,7 +1073,7 @@ static void convert_block(
 
             // Convert body.
             ql_static_loop->body.emplace();
-            convert_block(ir, cq_foreach_loop->body, ql_static_loop->body, options);
+            convert_block(ir, cq_foreach_loop->body, ql_static_loop->body, options, types);
 
             // Add to block.
             ql_block->statements.add(ql_static_loop);
@@ -1005,7 +1095,7 @@ static void convert_block(
 
             // Convert body.
             ql_for_loop->body.emplace();
-            convert_block(ir, cq_while_loop->body, ql_for_loop->body, options);
+            convert_block(ir, cq_while_loop->body, ql_for_loop->body, options, types);
 
             // Add to block.
             ql_block->statements.add(ql_for_loop);
@@ -1018,7 +1108,7 @@ static void convert_block(
 
             // Convert body.
             ql_for_loop->body.emplace();
-            convert_block(ir, cq_repeat_until->body, ql_for_loop->body, options);
+            convert_block(ir, cq_repeat_until->body, ql_for_loop->body, options, types);
 
             // Convert loop condition.
             ql_for_loop->condition = convert_expression(ir, cq_repeat_until->condition);
@@ -1114,20 +1204,12 @@ static ir::compat::PlatformRef load_platform(const cq::parser::ParseResult &pres
 }
 
 /**
- * Reads a cQASM 1.2 file into the IR. If reading is successful, ir->program is
- * completely replaced. data represents the cQASM file contents, fname specifies
- * the filename if one exists for the purpose of generating better error
- * messages.
+ * Throws a user error with the parse errors of the given parse result, if any.
  */
-void read(
-    const Ref &ir,
-    const utils::Str &data,
-    const utils::Str &fname,
-    const ReadOptions &options
+static void check_parse_result(
+    const cq::parser::ParseResult &pres,
+    const utils::Str &fname
 ) {
-
-    // Start by parsing the file without analysis.
-    auto pres = cq::parser::parse_string(data, fname);
     if (!pres.errors.empty()) {
         utils::StrStrm errors;
         errors << "failed to parse " << fname << " for the following reasons:";
@@ -1137,17 +1219,19 @@ void read(
         }
         QL_USER_ERROR(errors.str());
     }
+}
 
-    // If the load_platform option was passed to us, look for the
-    // `pragma @ql.platform(...)` annotation in the AST and build the platform
-    // from it, before even building the analyzer, because we need said platform
-    // to correctly build the analyzer.
-    if (options.load_platform) {
-        ir->platform = ir::convert_old_to_new(load_platform(pres))->platform;
-    }
-
-    // Create an analyzer for files with a version up to cQASM 1.2.
-    cq::analyzer::Analyzer a{"1.2"};
+/**
+ * Registers the functions and mappings for the platform of the given IR and
+ * the given options with the given analyzer. The analyzer only refers to the
+ * platform, so it can be reused for any number of reads into IRs with the same
+ * platform and options.
+ */
+static void register_platform(
+    cq::analyzer::Analyzer &a,
+    const Ref &ir,
+    const ReadOptions &options
+) {
 
     // Add the default constant-propagation functions and mappings such as true
     // and false.
@@ -1268,6 +1352,23 @@ void read(
         });
     }
 
+}
+
+/**
+ * Analyzes the given parse result using the given analyzer, previously set up
+ * with register_platform() for the platform of ir, and converts the result
+ * into the IR. If make_unique is cleared and the program is given a new name,
+ * its unique name is left equal to its name, for the caller to assign.
+ */
+static void analyze_parse_result(
+    const Ref &ir,
+    cq::analyzer::Analyzer &a,
+    cq::parser::ParseResult &pres,
+    const utils::Str &fname,
+    const ReadOptions &options,
+    utils::Bool make_unique = true
+) {
+
     // Analyze the file. Note that we didn't add any instruction or error model
     // types, which disables libqasm's resolver. This lets us completely ignore
     // error models, and handle instruction resolution ourselves using our own
@@ -1284,6 +1385,9 @@ void read(
     }
     auto cq_program = res.root;
 
+    // The parse tree is no longer needed, so release it now.
+    pres.root.reset();
+
     // Make a corresponding OpenQL program node.
     auto ql_program = utils::make<Program>();
 
@@ -1316,7 +1420,11 @@ void read(
         }
 
         // Figure out a unique name for this name if needed.
-        ql_program->unique_name = compat::make_unique_name(ql_program->name);
+        if (make_unique) {
+            ql_program->unique_name = compat::make_unique_name(ql_program->name);
+        } else {
+            ql_program->unique_name = ql_program->name;
+        }
 
     }
 
@@ -1468,7 +1576,9 @@ void read(
             // wherever the goto instruction in the @ql.entry block is pointed.
             ql_program->entry_point = cq_entry->get_annotation<utils::One<Block>>();
 
-            // Now handle the contents of the subcircuits.
+            // Now handle the contents of the subcircuits, sharing the
+            // instruction type cache between them.
+            InstructionTypeCache types;
             for (const auto &cq_subc : cq_program->subcircuits) {
                 auto ql_block = cq_subc->get_annotation<utils::One<Block>>();
 
@@ -1487,11 +1597,17 @@ void read(
                 }
 
                 // Convert the rest of the block.
-                convert_block(ir, cq_subc->body, ql_block, options);
+                convert_block(ir, cq_subc->body, ql_block, options, types);
 
                 // Make sure no unused @ql.* annotations remain.
                 check_all_annotations_used(cq_program->subcircuits.back());
 
+                // We're done with the statements of this subcircuit, so
+                // release them before converting the next one. The subcircuit
+                // node itself must remain, as goto instructions in subsequent
+                // subcircuits may still refer to it.
+                cq_subc->body->statements.reset();
+
             }
 
         }
@@ -1505,22 +1621,152 @@ void read(
     // was not used, otherwise links will be missing. So we just skip the check
     // if operands were specified.
     if (options.operands.empty()) {
-        check_consistency(ir);
+        check_consistency(ir, get_consistency_check_level(), ChangedParts::PROGRAM);
+    }
+
+}
+
+/**
+ * Converts the given cQASM 1.2 parse result into the IR. This is the common
+ * part of read() and read_file(). The parse result is consumed: its AST is
+ * released as soon as semantic analysis is done, and the body of every
+ * subcircuit of the semantic tree is released as soon as it has been converted,
+ * such that the peak memory usage for large files is not much more than the
+ * size of the semantic tree plus the resulting IR.
+ */
+static void read_parse_result(
+    const Ref &ir,
+    cq::parser::ParseResult &pres,
+    const utils::Str &fname,
+    const ReadOptions &options
+) {
+
+    // If the load_platform option was passed to us, look for the
+    // `pragma @ql.platform(...)` annotation in the AST and build the platform
+    // from it, before even building the analyzer, because we need said platform
+    // to correctly build the analyzer.
+    if (options.load_platform) {
+        ir->platform = ir::convert_old_to_new(load_platform(pres))->platform;
     }
 
+    // Create an analyzer for files with a version up to cQASM 1.2.
+    cq::analyzer::Analyzer a{"1.2"};
+    register_platform(a, ir, options);
+
+    // Analyze and convert the file.
+    analyze_parse_result(ir, a, pres, fname, options);
+
+}
+
+/**
+ * Reads a cQASM 1.2 file into the IR. If reading is successful, ir->program is
+ * completely replaced. data represents the cQASM file contents, fname specifies
+ * the filename if one exists for the purpose of generating better error
+ * messages.
+ */
+void read(
+    const Ref &ir,
+    const utils::Str &data,
+    const utils::Str &fname,
+    const ReadOptions &options
+) {
+    QL_TRACE_SCOPE("cqasm.read");
+
+    // Start by parsing the file without analysis.
+    auto pres = cq::parser::parse_string(data, fname);
+    check_parse_result(pres, fname);
+
+    // Convert the parse result to the IR.
+    read_parse_result(ir, pres, fname, options);
+
+}
+
+/**
+ * Resolves the given filename relative to OpenQL's working directory and
+ * checks that it exists, such that it can be passed to libqasm directly.
+ */
+static utils::Str resolve_input_file(const utils::Str &fname) {
+    auto path = utils::path_relative_to(utils::get_working_directory(), fname);
+    if (!utils::is_file(path)) {
+        QL_USER_ERROR("failed to open file " << fname << " for reading");
+    }
+    return path;
 }
 
 /**
  * Same as read(), but given a file to load, rather than loading from a string.
+ * The file is parsed by libqasm directly, rather than reading it into a string
+ * first, to avoid keeping a copy of the whole file in memory while parsing.
  */
 void read_file(
     const Ref &ir,
     const utils::Str &fname,
     const ReadOptions &options
 ) {
-    auto data = utils::InFile(fname).read();
+    QL_TRACE_SCOPE("cqasm.read");
+    auto path = resolve_input_file(fname);
     auto wd = utils::WithWorkingDirectory(utils::dir_name(fname));
-    read(ir, data, fname, options);
+    auto pres = cq::parser::parse_file(path);
+    check_parse_result(pres, fname);
+    read_parse_result(ir, pres, fname, options);
+}
+
+/**
+ * Reads multiple cQASM 1.2 files concurrently, each into a new IR root that
+ * shares the platform of ir, using at most num_threads threads (0 means all
+ * hardware threads, subject to the num_threads global option). The analyzer
+ * is set up once per thread rather than once per file, and the platform is not
+ * modified. The load_platform option is not supported, as all files must use
+ * the same platform. If reading a file fails, an exception is rethrown once
+ * all threads are done.
+ */
+utils::Vec<Ref> read_files(
+    const Ref &ir,
+    const utils::Vec<utils::Str> &fnames,
+    const ReadOptions &options,
+    utils::UInt num_threads
+) {
+    QL_TRACE_SCOPE("cqasm.read_files");
+    if (options.load_platform) {
+        QL_USER_ERROR(
+            "the load_platform option is not supported when reading multiple "
+            "files at once"
+        );
+    }
+
+    // Bring the lookup indices of the platform up to date, such that reading
+    // concurrently doesn't modify it.
+    index_instruction_types(ir);
+
+    utils::Vec<Ref> irs;
+    irs.reserve(fnames.size());
+    for (utils::UInt i = 0; i < fnames.size(); i++) {
+        irs.push_back(utils::make<Root>(ir->platform));
+    }
+
+    // Each worker sets up its own analyzer, because analysis may annotate the
+    // values registered with it, and reads every num_workers'th file with it.
+    auto num_workers = utils::min<utils::UInt>(utils::resolve_num_threads(num_threads), fnames.size());
+    utils::parallel_for(num_workers, num_workers, [&](utils::UInt worker) {
+        cq::analyzer::Analyzer a{"1.2"};
+        register_platform(a, ir, options);
+        for (auto i = worker; i < fnames.size(); i += num_workers) {
+            auto path = resolve_input_file(fnames[i]);
+            auto wd = utils::WithWorkingDirectory(utils::dir_name(fnames[i]));
+            auto pres = cq::parser::parse_file(path);
+            check_parse_result(pres, fnames[i]);
+            analyze_parse_result(irs[i], a, pres, fnames[i], options, false);
+        }
+    });
+
+    // compat::make_unique_name() keeps its state in the output directory, so
+    // assign the unique names here rather than in the workers. This also makes
+    // them follow the order of fnames.
+    for (const auto &file_ir : irs) {
+        file_ir->program->unique_name = compat::make_unique_name(file_ir->program->name);
+    }
+
+    return irs;
 }
 
 /**
@@ -1534,15 +1780,7 @@ ir::compat::PlatformRef read_platform(
 
     // Read the file without analyzing it.
     auto pres = cq::parser::parse_string(data, fname);
-    if (!pres.errors.empty()) {
-        utils::StrStrm errors;
-        errors << "failed to parse " << fname << " for the following reasons:";
-        for (const auto &error : pres.errors) {
-            QL_EOUT(error);
-            errors << "\n  " << error;
-        }
-        QL_USER_ERROR(errors.str());
-    }
+    check_parse_result(pres, fname);
 
     return load_platform(pres);
 }
@@ -1552,9 +1790,11 @@ ir::compat::PlatformRef read_platform(
  * string.
  */
 ir::compat::PlatformRef read_platform_from_file(const utils::Str &fname) {
-    auto data = utils::InFile(fname).read();
+    auto path = resolve_input_file(fname);
     auto wd = utils::WithWorkingDirectory(utils::dir_name(fname));
-    return read_platform(data, fname);
+    auto pres = cq::parser::parse_file(path);
+    check_parse_result(pres, fname);
+    return load_platform(pres);
 }
 
 } // namespace cqasm
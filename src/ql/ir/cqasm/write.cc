@@ -4,7 +4,14 @@
 
 #include "ql/ir/cqasm/write.h"
 
+#include <cmath>
+#include <deque>
+#include <streambuf>
+#include <type_traits>
 #include "ql/version.h"
+#include "ql/utils/json.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/trace.h"
 #include "ql/ir/ops.h"
 #include "ql/ir/describe.h"
 #include "ql/ir/operator_info.h"
@@ -14,6 +21,184 @@ namespace ql {
 namespace ir {
 namespace cqasm {
 
+/**
+ * Output buffer for the cQASM writer. Text is appended to a large string that
+ * is only flushed to the target stream once it grows beyond a threshold, and
+ * is then reused. Strings and integers are appended directly, avoiding the
+ * formatting overhead of std::ostream for every token; anything else is
+ * formatted via a std::ostream that writes into the same buffer. Without a
+ * target stream, the buffer simply accumulates everything written to it.
+ */
+class OutputBuffer : public std::streambuf {
+private:
+
+    /**
+     * The number of buffered bytes after which the buffer is flushed to the
+     * target stream.
+     */
+    static constexpr utils::UInt FLUSH_THRESHOLD = 256 * 1024;
+
+    /**
+     * The stream that the buffer is flushed to, or nullptr to accumulate
+     * everything.
+     */
+    std::ostream *target;
+
+    /**
+     * The buffered data.
+     */
+    utils::Str data;
+
+    /**
+     * Stream that writes into this buffer, used for formatting anything but
+     * strings and integers.
+     */
+    std::ostream stream_wrapper;
+
+    /**
+     * Flushes the buffer if it has grown beyond the threshold.
+     */
+    void maybe_flush() {
+        if (target && data.size() >= FLUSH_THRESHOLD) {
+            flush();
+        }
+    }
+
+protected:
+
+    /**
+     * streambuf override for writing a single character.
+     */
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            data.push_back(traits_type::to_char_type(c));
+            maybe_flush();
+        }
+        return traits_type::not_eof(c);
+    }
+
+    /**
+     * streambuf override for writing a sequence of characters.
+     */
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        data.append(s, n);
+        maybe_flush();
+        return n;
+    }
+
+public:
+
+    /**
+     * Constructs an output buffer for the given target stream, or one that
+     * accumulates everything if target is nullptr.
+     */
+    explicit OutputBuffer(std::ostream *target = nullptr) :
+        target(target), data(), stream_wrapper(this)
+    {
+        if (target) {
+            data.reserve(FLUSH_THRESHOLD * 2);
+        }
+    }
+
+    /**
+     * Writes all buffered data to the target stream, if any.
+     */
+    void flush() {
+        if (target && !data.empty()) {
+            target->write(data.data(), data.size());
+            data.clear();
+        }
+    }
+
+    /**
+     * Returns the buffered data.
+     */
+    utils::Str &get_data() {
+        return data;
+    }
+
+    /**
+     * Returns a stream that writes into this buffer.
+     */
+    std::ostream &stream() {
+        return stream_wrapper;
+    }
+
+    /**
+     * Appends the given number of characters.
+     */
+    void append(const char *str, utils::UInt size) {
+        data.append(str, size);
+        maybe_flush();
+    }
+
+    /**
+     * Appends a string.
+     */
+    OutputBuffer &operator<<(const utils::Str &str) {
+        data.append(str);
+        maybe_flush();
+        return *this;
+    }
+
+    /**
+     * Appends a null-terminated string.
+     */
+    OutputBuffer &operator<<(const char *str) {
+        data.append(str);
+        maybe_flush();
+        return *this;
+    }
+
+    /**
+     * Appends a single character.
+     */
+    OutputBuffer &operator<<(char c) {
+        data.push_back(c);
+        maybe_flush();
+        return *this;
+    }
+
+    /**
+     * Appends an integer in decimal notation.
+     */
+    template <typename T>
+    typename std::enable_if<
+        std::is_integral<T>::value && !std::is_same<T, bool>::value,
+        OutputBuffer&
+    >::type operator<<(T value) {
+        using U = typename std::make_unsigned<T>::type;
+        char buf[24];
+        char *end = buf + sizeof(buf);
+        char *start = end;
+        auto negative = std::is_signed<T>::value && value < 0;
+        U magnitude = negative ? U(0) - U(value) : U(value);
+        do {
+            *--start = (char)('0' + magnitude % 10);
+            magnitude /= 10;
+        } while (magnitude);
+        if (negative) {
+            *--start = '-';
+        }
+        data.append(start, end - start);
+        maybe_flush();
+        return *this;
+    }
+
+    /**
+     * Appends anything else using its stream << overload.
+     */
+    template <typename T>
+    typename std::enable_if<
+        !std::is_integral<T>::value || std::is_same<T, bool>::value,
+        OutputBuffer&
+    >::type operator<<(const T &value) {
+        stream_wrapper << value;
+        return *this;
+    }
+
+};
+
 /**
  * cQASM 1.2 writer implemented (more or less) using the visitor pattern.
  */
@@ -26,9 +211,9 @@ protected:
     const Ref &ir;
 
     /**
-     * The stream that we're writing to.
+     * The buffer that we're writing to.
      */
-    std::ostream &os;
+    OutputBuffer &os;
 
     /**
      * Line prefix.
@@ -57,6 +242,19 @@ protected:
      */
     utils::UInt precedence = 0;
 
+    /**
+     * Cache of the line start strings returned by sl(), indexed by indentation
+     * level. A deque is used because references to its elements remain valid
+     * when it grows.
+     */
+    std::deque<utils::Str> line_starts;
+
+    /**
+     * Cache of the line end strings returned by el(), indexed by the number of
+     * blank lines.
+     */
+    std::deque<utils::Str> line_ends;
+
     /**
      * Starts a Line, after updating the indentation level by adding
      * `indent_delta` to it.
@@ -65,15 +263,17 @@ protected:
      * line of <<. The order in which indent is updated is basically undefined
      * behavior!
      */
-    std::string sl(utils::Int indent_delta = 0) {
-        utils::StrStrm ss;
+    const utils::Str &sl(utils::Int indent_delta = 0) {
         indent += indent_delta;
         if (indent < 0) indent = 0;
-        auto indent_remain = indent;
-        while (indent_remain-- > 0) {
-            ss << "    ";
+        while (line_starts.size() <= (utils::UInt)indent) {
+            if (line_starts.empty()) {
+                line_starts.emplace_back();
+            } else {
+                line_starts.push_back(line_starts.back() + "    ");
+            }
         }
-        return ss.str();
+        return line_starts[indent];
     }
 
     /**
@@ -84,16 +284,25 @@ protected:
      * line of <<. The order in which indent is updated is basically undefined
      * behavior!
      */
-    std::string el(utils::UInt blank = 0, utils::Int indent_delta = 0) {
-        utils::StrStrm ss;
+    const utils::Str &el(utils::UInt blank = 0, utils::Int indent_delta = 0) {
         indent += indent_delta;
         if (indent < 0) indent = 0;
-        do {
-            ss << "\n" << line_prefix;
-        } while (blank--);
-        return ss.str();
+        while (line_ends.size() <= blank) {
+            if (line_ends.empty()) {
+                line_ends.push_back("\n" + line_prefix);
+            } else {
+                line_ends.push_back(line_ends.back() + line_ends.front());
+            }
+        }
+        return line_ends[blank];
     }
 
+    /**
+     * When this writer is used to print a single block on behalf of another
+     * writer, this points to said writer, from which all names are taken.
+     */
+    const Writer *parent = nullptr;
+
     /**
      * The set of all names currently in use or reserved.
      */
@@ -115,8 +324,19 @@ protected:
         const utils::Str &desired_name
     ) {
 
-        // See if we've uniquified the name for this node before.
+        // See if we've uniquified the name for this node before. When we're
+        // printing a block on behalf of another writer, all names must have
+        // been resolved by it already, so we only look them up.
         const void *key = node.get_ptr().get();
+        if (parent) {
+            if (key != nullptr) {
+                auto it = parent->unique_names.find(key);
+                if (it != parent->unique_names.end()) {
+                    return it->second;
+                }
+            }
+            QL_ICE("name for " << desired_name << " was not resolved before printing blocks");
+        }
         if (key != nullptr) {
             auto it = unique_names.find(key);
             if (it != unique_names.end()) {
@@ -161,15 +381,150 @@ protected:
         return true;
     }
 
+    /**
+     * Recursive visitor that resolves the names used within the statements of
+     * a block in the same order in which printing them would.
+     */
+    class NameResolver : public RecursiveVisitor {
+    private:
+
+        /**
+         * The writer that we're resolving names for.
+         */
+        Writer &writer;
+
+    public:
+
+        /**
+         * Constructs a name resolver for the given writer.
+         */
+        explicit NameResolver(Writer &writer) : writer(writer) {}
+
+        /**
+         * Visitor function for `CustomInstruction` nodes. The template operands
+         * are printed as well, so they must be resolved as well.
+         */
+        void visit_custom_instruction(CustomInstruction &node) override {
+            node.condition.visit(*this);
+            for (const auto &op : node.instruction_type->template_operands) {
+                op->visit(*this);
+            }
+            for (const auto &op : node.operands) {
+                op->visit(*this);
+            }
+        }
+
+        /**
+         * Visitor function for `GotoInstruction` nodes.
+         */
+        void visit_goto_instruction(GotoInstruction &node) override {
+            RecursiveVisitor::visit_goto_instruction(node);
+            writer.uniquify(node.target.as_mut(), node.target->name);
+        }
+
+        /**
+         * Visitor function for `Reference` nodes.
+         */
+        void visit_reference(Reference &node) override {
+            if (node.target != writer.ir->platform->qubits && !node.target->as_physical_object()) {
+                writer.uniquify(node.target.as_mut(), node.target->name);
+            }
+            RecursiveVisitor::visit_reference(node);
+        }
+
+    };
+
+    /**
+     * Resolves the names of all blocks and of everything referred to from
+     * within them, in the same order in which printing the blocks sequentially
+     * would. After this, the blocks can be printed in any order (or
+     * concurrently) without affecting the output. Returns the name of the exit
+     * label, or an empty string if none is needed.
+     */
+    utils::Str resolve_block_names(Program &node) {
+        NameResolver resolver{*this};
+        utils::Str exit_name;
+        for (utils::UInt idx = 0; idx < node.blocks.size(); idx++) {
+            const auto &block = node.blocks[idx];
+            uniquify(block, block->name);
+            block->visit(resolver);
+            if (block->next.empty() && idx != node.blocks.size() - 1) {
+                if (exit_name.empty()) {
+                    exit_name = uniquify("exit");
+                }
+            } else {
+                utils::Link<Block> seq_next;
+                if (idx < node.blocks.size() - 1) {
+                    seq_next = node.blocks[idx + 1];
+                }
+                if (block->next != seq_next) {
+                    uniquify(block->next.as_mut(), block->next->name);
+                }
+            }
+        }
+        return exit_name;
+    }
+
+    /**
+     * Prints the block with the given index of the given program, including
+     * its header and the goto instruction to its successor. If a goto to the
+     * exit label is needed and exit_name is empty, it is set to a new unique
+     * name.
+     */
+    void print_block(Program &node, utils::UInt idx, utils::Str &exit_name) {
+        const auto &block = node.blocks[idx];
+
+        // Write the block header.
+        auto name = uniquify(block, block->name);
+        os << el();
+        os << sl(-1) << "." << name;
+        if (options.include_metadata && name != block->name) {
+            os << " @ql.name(\"" << block->name << "\")";
+        }
+        os << el(0, 1);
+
+        // Write the statements.
+        block->visit(*this);
+
+        // Write the goto statement for the next block if needed.
+        if (block->next.empty() && idx != node.blocks.size() - 1) {
+            if (!version_at_least({1, 2})) {
+                QL_USER_ERROR("control-flow is not supported until cQASM 1.2");
+            }
+            if (exit_name.empty()) {
+                exit_name = uniquify("exit");
+            }
+            os << sl() << "goto " << exit_name << el();
+        } else {
+            utils::Link<Block> seq_next;
+            if (idx < node.blocks.size() - 1) {
+                seq_next = node.blocks[idx + 1];
+            }
+            if (block->next != seq_next) {
+                if (!version_at_least({1, 2})) {
+                    QL_USER_ERROR("control-flow is not supported until cQASM 1.2");
+                }
+                os << sl() << "goto " << uniquify(block->next.as_mut(), block->next->name) << el();
+            }
+        }
+
+        // Print block-wide statistics as comments at the end if requested.
+        if (options.include_statistics) {
+            os << el();
+            pass::ana::statistics::report::dump(ir, block, os.stream(), line_prefix + "    # ");
+        }
+
+    }
+
 public:
 
     /**
-     * Constructs a writer for the given stream.
+     * Constructs a writer for the given buffer.
      */
     Writer(
         const Ref &ir,
         const WriteOptions &options,
-        std::ostream &os = std::cout,
+        OutputBuffer &os,
         const utils::Str &line_prefix = ""
     ) :
         ir(ir),
@@ -192,6 +547,21 @@ public:
         })
     {}
 
+    /**
+     * Constructs a writer that prints blocks into the given buffer on behalf
+     * of the given writer, taking all names from it. This is used to print
+     * blocks concurrently, so the parent writer must have resolved all names
+     * in advance using resolve_block_names().
+     */
+    Writer(const Writer &parent, OutputBuffer &os) :
+        ir(parent.ir),
+        os(os),
+        line_prefix(parent.line_prefix),
+        options(parent.options),
+        indent(parent.indent),
+        parent(&parent)
+    {}
+
     /**
      * Fallback function.
      */
@@ -221,7 +591,7 @@ public:
         // Print program-wide statistics as comments at the end if requested.
         if (options.include_statistics) {
             os << el();
-            pass::ana::statistics::report::dump(ir, node.program, os, line_prefix + "# ");
+            pass::ana::statistics::report::dump(ir, node.program, os.stream(), line_prefix + "# ");
         }
 
     }
@@ -420,51 +790,29 @@ public:
             os << sl() << "goto " << uniquify(node.entry_point.as_mut(), node.entry_point->name) << el();
         }
 
-        // Print the blocks.
+        // Print the blocks. When multiple threads are requested, the blocks
+        // are printed into separate buffers concurrently, after resolving all
+        // names up front such that the result is the same.
         utils::Str exit_name;
-        for (utils::UInt idx = 0; idx < node.blocks.size(); idx++) {
-            const auto &block = node.blocks[idx];
-
-            // Write the block header.
-            auto name = uniquify(block, block->name);
-            os << el();
-            os << sl(-1) << "." << name;
-            if (options.include_metadata && name != block->name) {
-                os << " @ql.name(\"" << block->name << "\")";
+        auto num_threads = utils::resolve_num_threads(options.num_threads);
+        if (num_threads > 1 && node.blocks.size() > 1) {
+            exit_name = resolve_block_names(node);
+            utils::Vec<utils::Str> texts(node.blocks.size());
+            utils::parallel_for(node.blocks.size(), num_threads, [&](utils::UInt idx) {
+                OutputBuffer buffer;
+                Writer writer{*this, buffer};
+                auto block_exit_name = exit_name;
+                writer.print_block(node, idx, block_exit_name);
+                texts[idx] = std::move(buffer.get_data());
+            });
+            for (auto &text : texts) {
+                os << text;
+                utils::Str().swap(text);
             }
-            os << el(0, 1);
-
-            // Write the statements.
-            block->visit(*this);
-
-            // Write the goto statement for the next block if needed.
-            if (block->next.empty() && idx != node.blocks.size() - 1) {
-                if (!version_at_least({1, 2})) {
-                    QL_USER_ERROR("control-flow is not supported until cQASM 1.2");
-                }
-                if (exit_name.empty()) {
-                    exit_name = uniquify("exit");
-                }
-                os << sl() << "goto " << exit_name << el();
-            } else {
-                utils::Link<Block> seq_next;
-                if (idx < node.blocks.size() - 1) {
-                    seq_next = node.blocks[idx + 1];
-                }
-                if (block->next != seq_next) {
-                    if (!version_at_least({1, 2})) {
-                        QL_USER_ERROR("control-flow is not supported until cQASM 1.2");
-                    }
-                    os << sl() << "goto " << uniquify(block->next.as_mut(), block->next->name) << el();
-                }
-            }
-
-            // Print block-wide statistics as comments at the end if requested.
-            if (options.include_statistics) {
-                os << el();
-                pass::ana::statistics::report::dump(ir, block, os, line_prefix + "    # ");
+        } else {
+            for (utils::UInt idx = 0; idx < node.blocks.size(); idx++) {
+                print_block(node, idx, exit_name);
             }
-
         }
 
         // Print the exit label if needed.
@@ -847,9 +1195,17 @@ public:
 
         // Accurately printing floating-point values is hard. Half the JSON
         // library is dedicated to it. So why not abuse it for printing
-        // literals?
-        utils::Json j{r};
-        os << j[0];
+        // literals? For finite numbers we can call its shortest round-trip
+        // formatting function directly, rather than constructing a JSON
+        // value first.
+        if (std::isfinite(r)) {
+            char buf[64];
+            auto end = ::nlohmann::detail::to_chars(buf, buf + sizeof(buf), r);
+            os.append(buf, end - buf);
+        } else {
+            utils::Json j{r};
+            os << j[0];
+        }
 
     }
 
@@ -1121,6 +1477,7 @@ void write(
     std::ostream &os,
     const utils::Str &line_prefix
 ) {
+    QL_TRACE_SCOPE("cqasm.write");
     write(ir, ir, options, os, line_prefix);
 }
 
@@ -1135,8 +1492,10 @@ void write(
     std::ostream &os,
     const utils::Str &line_prefix
 ) {
-    Writer w{ir, options, os, line_prefix};
+    OutputBuffer buffer{&os};
+    Writer w{ir, options, buffer, line_prefix};
     node->visit(w);
+    buffer.flush();
 }
 
 /**
@@ -1147,9 +1506,10 @@ utils::Str to_string(
     const utils::One<ir::Node> &node,
     const WriteOptions &options
 ) {
-    utils::StrStrm ss;
-    write(ir, node, options, ss);
-    return ss.str();
+    OutputBuffer buffer;
+    Writer w{ir, options, buffer};
+    node->visit(w);
+    return std::move(buffer.get_data());
 }
 
 } // namespace cqasm
@@ -0,0 +1,240 @@
+/** \file
+ * Defines a mark-and-sweep garbage collector that removes unused temporary
+ * objects and generated instruction types from the IR.
+ */
+
+#include "ql/ir/gc.h"
+
+#include "ql/utils/set.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/trace.h"
+#include "ql/ir/ops.h"
+
+namespace ql {
+namespace ir {
+
+/**
+ * Annotation placed on the platform node by collect_garbage_if_needed(),
+ * recording how many garbage candidates survived the previous collection.
+ */
+struct GarbageCollectorState {
+
+    /**
+     * The number of candidates that survived the previous collection.
+     */
+    utils::UInt survivors;
+
+};
+
+/**
+ * Visitor that marks all objects and instruction types used anywhere in a
+ * tree.
+ */
+class UseMarker : public RecursiveVisitor {
+public:
+
+    /**
+     * The objects that are referred to.
+     */
+    utils::Set<const Object*> objects;
+
+    /**
+     * The instruction types that are used by instructions or function
+     * decompositions.
+     */
+    utils::Set<const InstructionType*> instruction_types;
+
+    /**
+     * Does nothing for other nodes.
+     */
+    void visit_node(Node &node) override {
+    }
+
+    /**
+     * Marks the instruction type of a custom instruction.
+     */
+    void visit_custom_instruction(CustomInstruction &node) override {
+        RecursiveVisitor::visit_custom_instruction(node);
+        instruction_types.insert(node.instruction_type.get_ptr().get());
+    }
+
+    /**
+     * Marks the instruction type that a function decomposes to.
+     */
+    void visit_function_decomposition(FunctionDecomposition &node) override {
+        RecursiveVisitor::visit_function_decomposition(node);
+        instruction_types.insert(node.instruction_type.get_ptr().get());
+    }
+
+    /**
+     * Marks the target of a reference.
+     */
+    void visit_reference(Reference &node) override {
+        RecursiveVisitor::visit_reference(node);
+        objects.insert(node.target.get_ptr().get());
+    }
+
+};
+
+/**
+ * Returns whether the given instruction type or any of its specializations is
+ * used.
+ */
+static utils::Bool is_used(
+    const InstructionType &ityp,
+    const utils::Set<const InstructionType*> &used
+) {
+    if (used.count(&ityp)) {
+        return true;
+    }
+    for (const auto &spec : ityp.specializations) {
+        if (is_used(*spec, used)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Returns the number of instruction types in the specialization tree rooted
+ * at the given instruction type.
+ */
+static utils::UInt count_tree(const InstructionType &ityp) {
+    utils::UInt count = 1;
+    for (const auto &spec : ityp.specializations) {
+        count += count_tree(*spec);
+    }
+    return count;
+}
+
+/**
+ * Removes the unused generated instruction types from the given list and from
+ * the specialization lists of the instruction types that remain, recursively.
+ * Returns the number of instruction types removed.
+ */
+static utils::UInt sweep_instruction_types(
+    utils::Any<InstructionType> &types,
+    const utils::Set<const InstructionType*> &used
+) {
+    utils::UInt removed = 0;
+    auto &vec = types.get_vec();
+    utils::UInt kept = 0;
+    for (utils::UInt i = 0; i < vec.size(); i++) {
+        const auto &ityp = vec[i];
+        if (ityp->has_annotation<GeneratedInstructionType>() && !is_used(*ityp, used)) {
+            removed += count_tree(*ityp);
+            continue;
+        }
+        removed += sweep_instruction_types(ityp->specializations, used);
+        if (kept != i) {
+            vec[kept] = vec[i];
+        }
+        kept++;
+    }
+    vec.resize(kept);
+    return removed;
+}
+
+/**
+ * Returns the number of entries in the IR that the garbage collector could
+ * remove if they are unused: the temporary objects of the program and the
+ * generated instruction types of the platform (see GeneratedInstructionType).
+ * This does not traverse the program, so it is cheap enough to call after
+ * every pass.
+ */
+utils::UInt count_garbage_candidates(const Ref &ir) {
+    utils::UInt count = 0;
+    if (!ir->program.empty()) {
+        for (const auto &obj : ir->program->objects) {
+            if (obj->as_temporary_object()) {
+                count++;
+            }
+        }
+    }
+    for (const auto &ityp : ir->platform->instructions) {
+        if (ityp->has_annotation<GeneratedInstructionType>()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * Removes all temporary objects of the program that are not referenced, and
+ * all generated instruction types of the platform that are not used by any
+ * instruction and none of whose specializations are used, from the IR. Uses
+ * are found by traversing the entire IR, including the decomposition rules of
+ * the platform; links held by annotations are not considered, so annotations
+ * that refer to objects or instruction types must not outlive the pass that
+ * made them. Objects and instruction types defined by the platform or the
+ * user are never removed. The instruction type indices are rebuilt if
+ * anything was removed.
+ */
+GarbageStats collect_garbage(const Ref &ir) {
+    QL_TRACE_SCOPE("ir.collect_garbage");
+    GarbageStats stats;
+
+    // Mark everything that is used.
+    UseMarker marker;
+    ir->visit(marker);
+
+    // Sweep the temporary objects.
+    if (!ir->program.empty()) {
+        auto &vec = ir->program->objects.get_vec();
+        utils::UInt kept = 0;
+        for (utils::UInt i = 0; i < vec.size(); i++) {
+            const auto &obj = vec[i];
+            if (obj->as_temporary_object() && !marker.objects.count(obj.get_ptr().get())) {
+                stats.temporaries++;
+                continue;
+            }
+            if (kept != i) {
+                vec[kept] = vec[i];
+            }
+            kept++;
+        }
+        vec.resize(kept);
+    }
+
+    // Sweep the instruction types.
+    stats.instruction_types = sweep_instruction_types(
+        ir->platform->instructions, marker.instruction_types
+    );
+    if (stats.instruction_types) {
+        reindex_instruction_types(ir);
+    }
+
+    QL_DOUT(
+        "garbage collector removed " << stats.temporaries << " temporaries "
+        "and " << stats.instruction_types << " instruction types"
+    );
+    return stats;
+}
+
+/**
+ * Runs collect_garbage() only when the number of garbage candidates exceeds
+ * the number that survived the previous collection by at least threshold, such
+ * that the cost of traversing the IR is amortized over the garbage it can
+ * remove. The number of survivors is recorded in an annotation on the platform
+ * node, and is zero before the first collection. A threshold of zero disables
+ * the collector. Returns whether a collection was performed.
+ */
+utils::Bool collect_garbage_if_needed(const Ref &ir, utils::UInt threshold) {
+    if (!threshold) {
+        return false;
+    }
+    utils::UInt survivors = 0;
+    if (auto state = ir->platform->get_annotation_ptr<GarbageCollectorState>()) {
+        survivors = state->survivors;
+    }
+    if (count_garbage_candidates(ir) < survivors + threshold) {
+        return false;
+    }
+    collect_garbage(ir);
+    ir->platform->set_annotation<GarbageCollectorState>({count_garbage_candidates(ir)});
+    return true;
+}
+
+} // namespace ir
+} // namespace ql
@@ -5,6 +5,8 @@
 
 #include "ql/ir/new_to_old.h"
 
+#include "ql/utils/pair.h"
+#include "ql/utils/hash_map.h"
 #include "ql/ir/old_to_new.h"
 #include "ql/ir/ops.h"
 #include "ql/ir/describe.h"
@@ -58,6 +60,34 @@ private:
      */
     ObjectLink creg_ob;
 
+    /**
+     * Key type for custom_gates: the (specialized) instruction type of a
+     * custom instruction and its qubit operands.
+     */
+    using CustomGateKey = utils::Pair<const InstructionType*, utils::Vec<utils::UInt>>;
+
+    /**
+     * Hash function for CustomGateKey.
+     */
+    struct CustomGateKeyHash {
+        std::size_t operator()(const CustomGateKey &key) const {
+            auto hash = std::hash<const void*>()(key.first);
+            for (auto qubit : key.second) {
+                hash = hash * 31 + std::hash<utils::UInt>()(qubit);
+            }
+            return hash;
+        }
+    };
+
+    /**
+     * Table mapping custom instructions to the compat custom gate that
+     * Kernel::gate() would add for them, or to nullptr if Kernel::gate()
+     * would decompose them or use a default gate instead. This is filled as
+     * instructions are converted, such that the string-based lookups of
+     * Kernel::gate() are only done once for every distinct gate.
+     */
+    utils::HashMap<CustomGateKey, const compat::gate_types::Custom*, CustomGateKeyHash> custom_gates;
+
     /**
      * Makes a unique kernel/program name based on the name of the given block,
      * if any.
@@ -488,10 +518,24 @@ void NewToOldConverter::convert_block(
                     for (utils::UInt i = 0; i < custom->operands.size() - diamond_op_count; i++) {
                         ops.append(*this, custom->operands[i]);
                     }
-                    kernel->gate(
-                        custom->instruction_type->name, ops.qubits, ops.cregs,
-                        0, ops.angle, ops.bregs
-                    );
+                    const auto &name = custom->instruction_type->name;
+                    CustomGateKey key{custom->instruction_type.get_ptr().get(), ops.qubits};
+                    auto it = custom_gates.find(key);
+                    if (it == custom_gates.end()) {
+                        auto gate = kernel->find_direct_custom_gate(utils::to_lower(name), ops.qubits);
+                        it = custom_gates.insert({std::move(key), gate}).first;
+                    }
+                    if (it->second) {
+                        kernel->custom_gate(
+                            name, *it->second, ops.qubits, ops.cregs,
+                            0, ops.angle, ops.bregs
+                        );
+                    } else {
+                        kernel->gate(
+                            name, ops.qubits, ops.cregs,
+                            0, ops.angle, ops.bregs
+                        );
+                    }
                     if (ops.has_integer) {
                         CHECK_COMPAT(
                             kernel->gates.size() == first_gate_index + 1,
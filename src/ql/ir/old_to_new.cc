@@ -5,9 +5,13 @@
 
 #include "ql/ir/old_to_new.h"
 
+#include <cctype>
+#include "ql/utils/hash_map.h"
+#include "ql/utils/parallel.h"
 #include "ql/ir/ops.h"
 #include "ql/ir/consistency.h"
 #include "ql/ir/cqasm/read.h"
+#include "ql/com/options.h"
 #include "ql/rmgr/manager.h"
 #include "ql/arch/diamond/annotations.h"
 
@@ -323,6 +327,11 @@ Ref convert_old_to_new(const compat::PlatformRef &old) {
     // functions will then get executed after all instructions are added.
     utils::List<std::function<void()>> todo;
 
+    // Platforms with per-qubit and per-edge specializations can have a great
+    // many instruction types, so we add them in bulk, sorting them only once
+    // when we're done.
+    begin_bulk_instruction_types(ir);
+
     // Now load the sorted instruction list.
     for (const UnparsedGateType &unparsed_gate_type : unparsed_gate_types) {
         try {
@@ -697,8 +706,8 @@ Ref convert_old_to_new(const compat::PlatformRef &old) {
 
     // Add legacy decompositions to the new system, for gates added by passes
     // (notably swap and relatives for the mapper).
-    auto it = old->platform_config.find("gate_decomposition");
-    if (it != old->platform_config.end()) {
+    auto it = old->get_platform_config().find("gate_decomposition");
+    if (it != old->get_platform_config().end()) {
         for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
             try {
 
@@ -868,6 +877,7 @@ Ref convert_old_to_new(const compat::PlatformRef &old) {
     for (const auto &fn : todo) {
         fn();
     }
+    end_bulk_instruction_types(ir);
 
     // Populate the default function types.
     auto fn = add_function_type(ir, utils::make<FunctionType>("operator!"));
@@ -913,7 +923,7 @@ Ref convert_old_to_new(const compat::PlatformRef &old) {
     ir->platform->resources.populate(resources);
 
     // Populate platform JSON data.
-    ir->platform->data = old->platform_config;
+    ir->platform->data = old->get_platform_config();
 
     // Attach the old platform structure as an annotation. This is used when
     // converting back to the old IR structure.
@@ -922,7 +932,7 @@ Ref convert_old_to_new(const compat::PlatformRef &old) {
     // Check the result.
     QL_DOUT("Result of old->new IR platform conversion:");
     QL_IF_LOG_DEBUG(ir->dump_seq());
-    check_consistency(ir);
+    check_consistency(ir, get_consistency_check_level(), ChangedParts::PLATFORM);
 
     return ir;
 }
@@ -1051,13 +1061,242 @@ static ExpressionRef convert_operation(
 }
 
 /**
- * Converts an old-IR gate to a new-IR instruction.
+ * Converts the gates of the static kernels of an old-IR program to new-IR
+ * instructions. The names, registers, and types needed for this are resolved
+ * once when the converter is constructed, and the instruction type of every
+ * distinct gate shape (name and operand types) is only resolved via the
+ * platform once. The gates can be converted on multiple threads ahead of
+ * time, in which case only the gates that need to modify the platform (for
+ * instance to infer an instruction type for a default gate) are left to be
+ * converted serially, in program order.
  */
-static InstructionRef convert_gate(
+class GateConverter {
+private:
+
+    /**
+     * The new IR being built.
+     */
+    Ref ir;
+
+    /**
+     * The old-IR program being converted.
+     */
+    compat::ProgramRef old;
+
+    /**
+     * The creg register object, if any.
+     */
+    ObjectLink creg_object;
+
+    /**
+     * The breg register object, if any.
+     */
+    ObjectLink breg_object;
+
+    /**
+     * The number of qubits, and thus implicit measurement bits.
+     */
+    utils::UInt num_qubits;
+
+    /**
+     * The real number type, if any.
+     */
+    DataTypeLink real_type;
+
+    /**
+     * The sanitized instruction names for the old-IR gate names used in the
+     * program. This is filled by the constructor, so it is not modified while
+     * converting gates.
+     */
+    utils::HashMap<utils::Str, utils::Str> names;
+
+    /**
+     * Key type for TypeCache: an instruction name, its operand types
+     * (identified by their node address), and whether the operands are
+     * writable references.
+     */
+    struct Signature {
+        utils::Str name;
+        utils::Vec<const DataType*> types;
+        utils::Vec<utils::Bool> writable;
+
+        utils::Bool operator==(const Signature &rhs) const {
+            return name == rhs.name && types == rhs.types && writable == rhs.writable;
+        }
+    };
+
+    /**
+     * Hash function for Signature.
+     */
+    struct SignatureHash {
+        std::size_t operator()(const Signature &sig) const {
+            auto hash = std::hash<utils::Str>()(sig.name);
+            for (utils::UInt i = 0; i < sig.types.size(); i++) {
+                hash = hash * 31 + std::hash<const DataType*>()(sig.types[i]);
+                hash = hash * 2 + sig.writable[i];
+            }
+            return hash;
+        }
+    };
+
+    /**
+     * Map from signatures to the generalized instruction types that
+     * find_instruction_type() returned for them. Since instruction types are
+     * only ever added after existing instruction types with the same name,
+     * these remain valid throughout the conversion.
+     */
+    using TypeCache = utils::HashMap<Signature, InstructionTypeLink, SignatureHash>;
+
+    /**
+     * Type cache used for serial conversion.
+     */
+    TypeCache types;
+
+    /**
+     * The instructions converted ahead of time by convert_in_parallel(),
+     * indexed by kernel and gate index. Gates that could not be converted
+     * ahead of time have an empty entry.
+     */
+    utils::Vec<utils::Vec<InstructionRef>> converted;
+
+    /**
+     * Returns the sanitized instruction name for the given old-IR gate name.
+     */
+    utils::Str get_name(const utils::Str &gate_name) const;
+
+    /**
+     * Converts an old-IR gate to a new-IR instruction, using and updating the
+     * given type cache. If may_modify is false, the platform is not modified,
+     * and an empty reference is returned if that would be needed.
+     */
+    InstructionRef convert_gate(
+        const compat::GateRef &gate,
+        TypeCache &cache,
+        utils::Bool may_modify
+    ) const;
+
+public:
+
+    /**
+     * Constructs a converter for the given program, converting to the given
+     * IR, of which the platform must already have been converted.
+     */
+    GateConverter(const Ref &ir, const compat::ProgramRef &old);
+
+    /**
+     * Converts the gates of all static kernels ahead of time, using up to the
+     * given number of threads, as far as this is possible without modifying
+     * the platform. This includes copying the gate annotations.
+     */
+    void convert_in_parallel(utils::UInt num_threads);
+
+    /**
+     * Returns the new-IR instruction for the given gate of the given kernel,
+     * converting it now if it was not converted ahead of time. The
+     * annotations of the gate are copied to the instruction.
+     */
+    InstructionRef convert(utils::UInt kernel_idx, utils::UInt gate_idx);
+
+};
+
+/**
+ * Constructs a converter for the given program.
+ */
+GateConverter::GateConverter(
     const Ref &ir,
-    const compat::ProgramRef &old,
-    const compat::GateRef &gate
-) {
+    const compat::ProgramRef &old
+) :
+    ir(ir),
+    old(old),
+    creg_object(find_physical_object(ir, "creg")),
+    breg_object(find_physical_object(ir, "breg")),
+    num_qubits(get_num_qubits(ir)),
+    real_type(find_type(ir, "real"))
+{
+    for (const auto &kernel : old->kernels) {
+        for (const auto &gate : kernel->gates) {
+            if (names.find(gate->name) == names.end()) {
+                names.insert({gate->name, parse_instruction_name(gate->name).front()});
+            }
+        }
+    }
+}
+
+/**
+ * Returns the sanitized instruction name for the given old-IR gate name.
+ */
+utils::Str GateConverter::get_name(const utils::Str &gate_name) const {
+    auto it = names.find(gate_name);
+    if (it != names.end()) {
+        return it->second;
+    }
+    return parse_instruction_name(gate_name).front();
+}
+
+/**
+ * Converts the gates of all static kernels ahead of time.
+ */
+void GateConverter::convert_in_parallel(utils::UInt num_threads) {
+    num_threads = utils::resolve_num_threads(num_threads);
+    if (num_threads <= 1 || old->kernels.size() <= 1) {
+        return;
+    }
+
+    // Make sure that the instruction type indices of the platform are up to
+    // date, such that looking up and specializing instruction types without
+    // generating overloads does not modify the IR.
+    index_instruction_types(ir);
+
+    // Convert the kernels concurrently, each with its own type cache. When a
+    // gate fails to convert, the rest of the kernel is left to the serial
+    // conversion, which adds the proper context to the exception, if any.
+    converted.resize(old->kernels.size());
+    utils::parallel_for(old->kernels.size(), num_threads, [this](utils::UInt idx) {
+        const auto &kernel = old->kernels[idx];
+        if (kernel->type != compat::KernelType::STATIC) {
+            return;
+        }
+        auto &instructions = converted[idx];
+        instructions.resize(kernel->gates.size());
+        TypeCache cache;
+        try {
+            for (utils::UInt i = 0; i < kernel->gates.size(); i++) {
+                auto &instruction = instructions[i];
+                instruction = convert_gate(kernel->gates[i], cache, false);
+                if (!instruction.empty()) {
+                    instruction->copy_annotations(*kernel->gates[i]);
+                }
+            }
+        } catch (utils::Exception &) {
+        }
+    });
+}
+
+/**
+ * Returns the new-IR instruction for the given gate of the given kernel,
+ * including the annotations copied from the gate.
+ */
+InstructionRef GateConverter::convert(utils::UInt kernel_idx, utils::UInt gate_idx) {
+    if (kernel_idx < converted.size() && gate_idx < converted[kernel_idx].size()) {
+        auto &instruction = converted[kernel_idx][gate_idx];
+        if (!instruction.empty()) {
+            return std::move(instruction);
+        }
+    }
+    const auto &gate = old->kernels[kernel_idx]->gates[gate_idx];
+    auto instruction = convert_gate(gate, types, true);
+    instruction->copy_annotations(*gate);
+    return instruction;
+}
+
+/**
+ * Converts an old-IR gate to a new-IR instruction.
+ */
+InstructionRef GateConverter::convert_gate(
+    const compat::GateRef &gate,
+    TypeCache &cache,
+    utils::Bool may_modify
+) const {
 
     // Gate names are a lie for RX90, MRX90, RX180, and Y variants of those
     // default gates, in that the name reported by the class differs from the
@@ -1072,7 +1311,7 @@ static InstructionRef convert_gate(
     // we'll use the name of the gate that the user would have to add (ry90) for
     // the real name, and use gate->name (y90) for the cQASM name, assuming
     // we'll need to add a new gate definition.
-    auto name = parse_instruction_name(gate->name).front();
+    auto name = get_name(gate->name);
     auto cqasm_name = name;
     switch (gate->type()) {
         case compat::GateType::RX90:  name = "rx90";  break;
@@ -1095,7 +1334,6 @@ static InstructionRef convert_gate(
         // Convert the gate's creg operands.
         utils::Any<Expression> creg_operands;
         if (!gate->creg_operands.empty()) {
-            auto creg_object = find_physical_object(ir, "creg");
             QL_ASSERT(!creg_object.empty());
             for (auto idx : gate->creg_operands) {
                 creg_operands.add(make_reference(ir, creg_object, {idx}));
@@ -1107,8 +1345,6 @@ static InstructionRef convert_gate(
         // beyond that is the b register used.
         utils::Any<Expression> breg_operands;
         ExpressionRef condition;
-        auto breg_object = find_physical_object(ir, "breg");
-        auto num_qubits = get_num_qubits(ir);
 
         // Convert breg operands.
         for (auto idx : gate->breg_operands) {
@@ -1239,7 +1475,6 @@ static InstructionRef convert_gate(
         operands.extend(qubit_operands);
         operands.extend(creg_operands);
         operands.extend(breg_operands);
-        auto real_type = find_type(ir, "real");
         if (
             name == "rx" || name == "ry" || name == "rz" ||
             name == "crz" || name == "cr"
@@ -1279,13 +1514,42 @@ static InstructionRef convert_gate(
         }
 
         // Try to make an instruction for the name and operand list we found.
-        auto insn = make_instruction(ir, name, operands, condition, true, true);
-        if (!insn.empty()) {
-            return insn;
+        // This is equivalent to make_instruction(), except that the
+        // instruction type is taken from the cache if a gate with the same
+        // signature was converted before.
+        Signature sig{name, {}, {}};
+        utils::Vec<DataTypeLink> operand_types;
+        for (const auto &operand : operands) {
+            operand_types.push_back(get_type_of(operand));
+            sig.types.push_back(operand_types.back().get_ptr().get());
+            sig.writable.push_back(operand->as_reference() != nullptr);
+        }
+        auto it = cache.find(sig);
+        if (it == cache.end()) {
+            auto ityp = find_instruction_type(ir, name, operand_types, sig.writable, may_modify);
+            if (!ityp.empty()) {
+                it = cache.insert({std::move(sig), ityp}).first;
+            }
+        }
+        if (it != cache.end()) {
+            auto custom_insn = utils::make<CustomInstruction>();
+            custom_insn->instruction_type = it->second;
+            custom_insn->operands = operands;
+            specialize_instruction(custom_insn);
+            if (condition.empty()) {
+                custom_insn->condition = make_bit_lit(ir, true);
+            } else {
+                custom_insn->condition = condition;
+            }
+            return custom_insn;
         }
 
         // No instruction type exists yet... probably a default gate. So try to
-        // infer an instruction type for it.
+        // infer an instruction type for it, which requires modifying the
+        // platform.
+        if (!may_modify) {
+            return {};
+        }
         operands.reset();
         auto ityp = utils::make<InstructionType>(name, cqasm_name);
         ityp->duration = utils::div_ceil(gate->duration, old->platform->cycle_time);
@@ -1425,6 +1689,7 @@ static InstructionRef convert_gate(
 static utils::Str convert_kernels(
     const Ref &ir,
     const compat::ProgramRef &old,
+    GateConverter &gates,
     utils::UInt &idx,
     const utils::One<BlockBase> block
 ) {
@@ -1441,13 +1706,11 @@ static utils::Str convert_kernels(
             case compat::KernelType::STATIC: {
 
                 // Convert gates to instructions.
-                for (const auto &gate : old->kernels[idx]->gates) {
-
-                    // Convert the gate.
-                    auto instruction = convert_gate(ir, old, gate);
+                for (utils::UInt gate_idx = 0; gate_idx < old->kernels[idx]->gates.size(); gate_idx++) {
+                    const auto &gate = old->kernels[idx]->gates[gate_idx];
 
-                    // Copy gate-level annotations.
-                    instruction->copy_annotations(*gate);
+                    // Convert the gate, including its annotations.
+                    auto instruction = gates.convert(idx, gate_idx);
 
                     // Figure out its cycle number.
                     if (old->kernels[idx]->cycles_valid) {
@@ -1507,7 +1770,7 @@ static utils::Str convert_kernels(
                 // Handle the body by calling ourselves until we reach a FOR_END.
                 auto sub_block = utils::make<SubBlock>();
                 do {
-                    auto new_name = convert_kernels(ir, old, idx, sub_block);
+                    auto new_name = convert_kernels(ir, old, gates, idx, sub_block);
                     if (name.empty()) name = new_name;
                 } while (old->kernels[idx]->type != compat::KernelType::FOR_END);
 
@@ -1536,7 +1799,7 @@ static utils::Str convert_kernels(
                 // Handle the body by calling ourselves until we reach a DO_WHILE_END.
                 auto sub_block = utils::make<SubBlock>();
                 do {
-                    auto new_name = convert_kernels(ir, old, idx, sub_block);
+                    auto new_name = convert_kernels(ir, old, gates, idx, sub_block);
                     if (name.empty()) name = new_name;
                 } while (old->kernels[idx]->type != compat::KernelType::DO_WHILE_END);
 
@@ -1565,7 +1828,7 @@ static utils::Str convert_kernels(
                 // Handle the body by calling ourselves until we reach an IF_END.
                 auto if_block = utils::make<SubBlock>();
                 do {
-                    auto new_name = convert_kernels(ir, old, idx, if_block);
+                    auto new_name = convert_kernels(ir, old, gates, idx, if_block);
                     if (name.empty()) name = new_name;
                 } while (old->kernels[idx]->type != compat::KernelType::IF_END);
 
@@ -1583,7 +1846,7 @@ static utils::Str convert_kernels(
                     // ELSE_END.
                     else_block.emplace();
                     do {
-                        auto new_name = convert_kernels(ir, old, idx, else_block);
+                        auto new_name = convert_kernels(ir, old, gates, idx, else_block);
                         if (name.empty()) name = new_name;
                     } while (old->kernels[idx]->type != compat::KernelType::ELSE_END);
 
@@ -1654,23 +1917,28 @@ Ref convert_old_to_new(const compat::ProgramRef &old) {
         old->breg_count
     });
 
-    // Convert the kernels.
+    // Convert the gates of the static kernels, on multiple threads if
+    // requested, and then the kernels.
+    GateConverter gates{ir, old};
+    gates.convert_in_parallel(com::options::global["ir_conversion_threads"].as_uint());
     utils::Set<utils::Str> names;
     for (utils::UInt idx = 0; idx < old->kernels.size(); ) {
 
         // Convert the next block of kernels.
         auto block = utils::make<Block>();
-        auto name = convert_kernels(ir, old, idx, block);
+        auto name = convert_kernels(ir, old, gates, idx, block);
 
-        // Sanitize and uniquify the kernel name.
-        name = std::regex_replace(name, std::regex("[^a-zA-Z0-9_]"), "_");
-        if (!std::regex_match(name, IDENTIFIER_RE)) name = "_" + name;
+        // Sanitize and uniquify the kernel name. This is done for every
+        // kernel, so avoid constructing and matching regular expressions.
+        for (auto &c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') c = '_';
+        }
+        if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) name = "_" + name;
         auto unique_name = name;
         utils::UInt unique_idx = 1;
         while (!names.insert(unique_name).second) {
             unique_name = name + "_" + utils::to_string(unique_idx++);
         }
-        QL_ASSERT(std::regex_match(unique_name, IDENTIFIER_RE));
         block->name = unique_name;
 
         // Link the previous block to this one.
@@ -1688,7 +1956,7 @@ Ref convert_old_to_new(const compat::ProgramRef &old) {
     // Check the result.
     QL_DOUT("Result of old->new IR program conversion:");
     QL_IF_LOG_DEBUG(ir->dump_seq());
-    check_consistency(ir);
+    check_consistency(ir, get_consistency_check_level(), ChangedParts::PROGRAM);
 
     return ir;
 }
@@ -4,6 +4,9 @@
 
 #include "ql/ir/ops.h"
 
+#include <functional>
+#include <unordered_map>
+
 #include "ql/ir/describe.h"
 #include "ql/ir/old_to_new.h"
 
@@ -109,6 +112,392 @@ ObjectLink find_physical_object(const Ref &ir, const utils::Str &name) {
     }
 }
 
+/**
+ * Key for looking up generalized instruction types by name and operand data
+ * types.
+ */
+struct InstructionSignature {
+
+    /**
+     * Name of the instruction type.
+     */
+    utils::Str name;
+
+    /**
+     * The data types of the operands, identified by their node address.
+     */
+    utils::Vec<const DataType*> types;
+
+    /**
+     * Equality operator for use in hash maps.
+     */
+    utils::Bool operator==(const InstructionSignature &rhs) const {
+        return name == rhs.name && types == rhs.types;
+    }
+
+};
+
+/**
+ * Hash function for InstructionSignature.
+ */
+struct InstructionSignatureHash {
+    std::size_t operator()(const InstructionSignature &sig) const {
+        auto hash = std::hash<utils::Str>()(sig.name);
+        for (auto type : sig.types) {
+            hash = hash * 31 + std::hash<const DataType*>()(type);
+        }
+        return hash;
+    }
+};
+
+/**
+ * Returns the signature of the given instruction type.
+ */
+static InstructionSignature get_signature(const InstructionType &ityp) {
+    InstructionSignature sig{ityp.name, {}};
+    for (const auto &operand_type : ityp.operand_types) {
+        sig.types.push_back(operand_type->data_type.get_ptr().get());
+    }
+    return sig;
+}
+
+/**
+ * Annotation placed on the platform node to index its generalized instruction
+ * types by name and by signature, such that lookups don't have to search the
+ * instruction list. The index is maintained by the functions in this file as
+ * instruction types are added. If the platform node is cloned or its
+ * instruction list is otherwise modified, the index is rebuilt on first use.
+ */
+struct InstructionTypeIndex {
+
+    /**
+     * The platform node that the index was built for.
+     */
+    const Platform *platform;
+
+    /**
+     * The number of instruction types in the platform when the index was last
+     * updated.
+     */
+    utils::UInt num_instructions;
+
+    /**
+     * The instruction types for each signature, in platform order. There may
+     * be more than one due to generated overloads that only differ in operand
+     * access modes.
+     */
+    std::unordered_map<
+        InstructionSignature,
+        utils::Vec<InstructionTypeLink>,
+        InstructionSignatureHash
+    > by_signature;
+
+    /**
+     * The first instruction type in platform order for each name.
+     */
+    std::unordered_map<utils::Str, InstructionTypeLink> first_by_name;
+
+    /**
+     * Adds an instruction type that was just inserted into the platform after
+     * all other instruction types with the same name.
+     */
+    void add(const utils::One<InstructionType> &ityp) {
+        by_signature[get_signature(*ityp)].push_back(ityp);
+        first_by_name.insert({ityp->name, ityp});
+        num_instructions++;
+    }
+
+};
+
+/**
+ * Returns the instruction type index for the platform, (re)building it if
+ * it does not exist yet or is out of date.
+ */
+static InstructionTypeIndex &get_instruction_type_index(const Ref &ir) {
+    const auto &platform = ir->platform;
+    auto index = platform->get_annotation_ptr<InstructionTypeIndex>();
+    if (
+        index && index->platform == platform.get_ptr().get() &&
+        index->num_instructions == platform->instructions.size()
+    ) {
+        return *index;
+    }
+    InstructionTypeIndex new_index{platform.get_ptr().get(), 0, {}, {}};
+    for (const auto &ityp : platform->instructions) {
+        new_index.add(ityp);
+    }
+    platform->set_annotation<InstructionTypeIndex>(std::move(new_index));
+    return platform->get_annotation<InstructionTypeIndex>();
+}
+
+/**
+ * Annotation placed on the platform node between begin_bulk_instruction_types()
+ * and end_bulk_instruction_types(), indicating that new generalized instruction
+ * types should be appended to the instruction list rather than inserted in
+ * sort order.
+ */
+struct BulkInstructionTypes {
+
+    /**
+     * The platform node that bulk mode was started for.
+     */
+    const Platform *platform;
+
+};
+
+/**
+ * Returns whether bulk mode is active for the platform.
+ */
+static utils::Bool is_bulk_mode(const Ref &ir) {
+    auto bulk = ir->platform->get_annotation_ptr<BulkInstructionTypes>();
+    return bulk && bulk->platform == ir->platform.get_ptr().get();
+}
+
+/**
+ * Inserts a generalized instruction type into the platform after all other
+ * instruction types with the same name, to maintain sort order, and adds it to
+ * the index. In bulk mode, the instruction type is appended instead, and the
+ * list is sorted by end_bulk_instruction_types().
+ */
+static void insert_instruction_type(
+    const Ref &ir,
+    InstructionTypeIndex &index,
+    const utils::One<InstructionType> &ityp
+) {
+    auto &vec = ir->platform->instructions.get_vec();
+    if (is_bulk_mode(ir)) {
+        vec.push_back(ityp);
+    } else {
+        auto pos = std::upper_bound(vec.begin(), vec.end(), ityp, compare_by_name<InstructionType>);
+        vec.insert(pos, ityp);
+    }
+    index.add(ityp);
+}
+
+/**
+ * Starts adding instruction types to the platform in bulk. See
+ * end_bulk_instruction_types().
+ */
+void begin_bulk_instruction_types(const Ref &ir) {
+    ir->platform->set_annotation<BulkInstructionTypes>({ir->platform.get_ptr().get()});
+}
+
+/**
+ * Ends adding instruction types to the platform in bulk, sorting the
+ * instruction types that were added since begin_bulk_instruction_types() into
+ * place and indexing them. The sort is stable, so instruction types with the
+ * same name retain the order in which they were added, exactly as if they had
+ * been inserted one by one.
+ */
+void end_bulk_instruction_types(const Ref &ir) {
+    if (!is_bulk_mode(ir)) {
+        return;
+    }
+    ir->platform->erase_annotation<BulkInstructionTypes>();
+    auto &vec = ir->platform->instructions.get_vec();
+    std::stable_sort(vec.begin(), vec.end(), compare_by_name<InstructionType>);
+    index_instruction_types(ir);
+}
+
+/**
+ * Returns a hash for the given template operand that is consistent with
+ * equals(). Only the kinds of operands that instruction types are specialized
+ * on in practice (integer and bit literals, and references indexed by them)
+ * are hashed meaningfully; everything else hashes to zero, and is thus
+ * distinguished by linear search.
+ */
+static std::size_t hash_template_operand(const Expression &expr) {
+    if (auto ilit = expr.as_int_literal()) {
+        return std::hash<utils::Int>()(ilit->value) * 3 + 1;
+    } else if (auto blit = expr.as_bit_literal()) {
+        return blit->value ? 2 : 5;
+    } else if (auto ref = expr.as_reference()) {
+        auto hash = std::hash<const Object*>()(ref->target.get_ptr().get());
+        for (const auto &index : ref->indices) {
+            hash = hash * 31 + hash_template_operand(*index);
+        }
+        return hash;
+    }
+    return 0;
+}
+
+/**
+ * Returns the hash of the tuple formed by the first n of the given template
+ * operands, consistent with the hashes stored in SpecializationIndex.
+ */
+static std::size_t hash_template_operands(
+    const utils::Vec<ExpressionRef> &operands,
+    utils::UInt n
+) {
+    std::size_t hash = n;
+    for (utils::UInt i = 0; i < n; i++) {
+        hash = hash * 31 + hash_template_operand(*operands[i]);
+    }
+    return hash;
+}
+
+/**
+ * Annotation placed on generalized instruction types with specializations to
+ * index their entire specialization tree by the tuple of template operands,
+ * such that finding the (most) specialized instruction type for a list of
+ * operands doesn't have to walk the tree and compare operands level by level.
+ * Like InstructionTypeIndex, it is rebuilt on first use if the node was
+ * cloned or its specialization list was otherwise modified. Specializations
+ * added deeper in the tree are only picked up when they are added through
+ * add_specialization(), which is the case for everything in this file.
+ */
+struct SpecializationIndex {
+
+    /**
+     * The generalized instruction type node that the index was built for.
+     */
+    const InstructionType *instruction_type;
+
+    /**
+     * The number of direct specializations of the generalized instruction
+     * type when the index was last updated.
+     */
+    utils::UInt num_specializations;
+
+    /**
+     * The maximum number of template operands of any of the specializations.
+     */
+    utils::UInt max_depth;
+
+    /**
+     * The specializations by hash of their template operands.
+     */
+    std::unordered_map<std::size_t, utils::Vec<InstructionTypeLink>> by_template_operands;
+
+    /**
+     * Adds a specialization that was just added somewhere in the tree.
+     */
+    void add(const utils::One<InstructionType> &spec) {
+        utils::Vec<ExpressionRef> operands{
+            spec->template_operands.begin(),
+            spec->template_operands.end()
+        };
+        by_template_operands[hash_template_operands(operands, operands.size())].push_back(spec);
+        max_depth = utils::max(max_depth, operands.size());
+    }
+
+    /**
+     * Adds the given specialization and its specializations, recursively.
+     */
+    void add_tree(const utils::One<InstructionType> &spec) {
+        add(spec);
+        for (const auto &sub : spec->specializations) {
+            add_tree(sub);
+        }
+    }
+
+    /**
+     * Returns the specialization whose template operands are exactly the first
+     * n of the given operands, or an empty link if there is none.
+     */
+    InstructionTypeLink find(
+        const utils::Vec<ExpressionRef> &operands,
+        utils::UInt n
+    ) const {
+        if (n > max_depth) {
+            return {};
+        }
+        auto it = by_template_operands.find(hash_template_operands(operands, n));
+        if (it == by_template_operands.end()) {
+            return {};
+        }
+        for (const auto &spec : it->second) {
+            if (spec->template_operands.size() != n) {
+                continue;
+            }
+            auto match = true;
+            for (utils::UInt i = 0; i < n; i++) {
+                if (!spec->template_operands[i].equals(operands[i])) {
+                    match = false;
+                    break;
+                }
+            }
+            if (match) {
+                return spec;
+            }
+        }
+        return {};
+    }
+
+};
+
+/**
+ * Returns the specialization index for the given generalized instruction
+ * type, (re)building it if it does not exist yet or is out of date.
+ */
+static SpecializationIndex &get_specialization_index(InstructionType &ityp) {
+    auto index = ityp.get_annotation_ptr<SpecializationIndex>();
+    if (
+        index && index->instruction_type == &ityp &&
+        index->num_specializations == ityp.specializations.size()
+    ) {
+        return *index;
+    }
+    SpecializationIndex new_index{&ityp, ityp.specializations.size(), 0, {}};
+    for (const auto &spec : ityp.specializations) {
+        new_index.add_tree(spec);
+    }
+    ityp.set_annotation<SpecializationIndex>(std::move(new_index));
+    return ityp.get_annotation<SpecializationIndex>();
+}
+
+/**
+ * Adds a specialization to the given instruction type, which must be (a
+ * specialization of) the given generalized instruction type, keeping the
+ * specialization index of the latter up to date if it has one.
+ */
+static void add_specialization(
+    InstructionType &generalized,
+    InstructionType &ityp,
+    const utils::One<InstructionType> &spec
+) {
+    auto index = generalized.get_annotation_ptr<SpecializationIndex>();
+    auto index_valid = (
+        index && index->instruction_type == &generalized &&
+        index->num_specializations == generalized.specializations.size()
+    );
+    ityp.specializations.add(spec);
+    if (index_valid) {
+        index->add(spec);
+        if (&ityp == &generalized) {
+            index->num_specializations++;
+        }
+    }
+}
+
+/**
+ * Brings all lookup indices for the instruction types of the platform up to
+ * date, such that subsequent lookups that don't add anything also don't modify
+ * the IR. This must be called before looking up instruction types or
+ * specializing instructions from multiple threads concurrently.
+ */
+void index_instruction_types(const Ref &ir) {
+    get_instruction_type_index(ir);
+    for (const auto &ityp : ir->platform->instructions) {
+        if (!ityp->specializations.empty()) {
+            get_specialization_index(*ityp);
+        }
+    }
+}
+
+/**
+ * Discards and rebuilds all lookup indices for the instruction types of the
+ * platform. The indices only pick up instruction types that are added, so this
+ * must be called after removing instruction types or specializations.
+ */
+void reindex_instruction_types(const Ref &ir) {
+    ir->platform->erase_annotation<InstructionTypeIndex>();
+    for (const auto &ityp : ir->platform->instructions) {
+        ityp->erase_annotation<SpecializationIndex>();
+    }
+    index_instruction_types(ir);
+}
+
 /**
  * Adds an instruction type to the platform, or return the matching instruction
  * type specialization without changing anything in the IR if one already
@@ -127,39 +516,27 @@ static utils::Pair<InstructionTypeLink, utils::Bool> add_or_find_instruction_typ
     QL_ASSERT(instruction_type->template_operands.empty());
     QL_ASSERT(instruction_type->generalization.empty());
 
-    // Check its name.
-    if (!std::regex_match(instruction_type->name, IDENTIFIER_RE)) {
-        QL_USER_ERROR(
-            "invalid name for new instruction type: \"" <<
-            instruction_type->name << "\" is not a valid identifier"
-        );
-    }
-
     // Search for an existing matching instruction.
-    auto begin = ir->platform->instructions.get_vec().begin();
-    auto end = ir->platform->instructions.get_vec().end();
-    auto pos = std::lower_bound(begin, end, instruction_type, compare_by_name<InstructionType>);
-    auto already_exists = false;
-    for (; pos != end && (*pos)->name == instruction_type->name; ++pos) {
-        if ((*pos)->operand_types.size() != instruction_type->operand_types.size()) {
-            continue;
-        }
-        auto match = true;
-        for (utils::UInt i = 0; i < (*pos)->operand_types.size(); i++) {
-            if ((*pos)->operand_types[i]->data_type != instruction_type->operand_types[i]->data_type) {
-                match = false;
-                break;
-            }
-        }
-        if (match) {
-            already_exists = true;
-            break;
-        }
+    auto &index = get_instruction_type_index(ir);
+    utils::One<InstructionType> ityp;
+    auto it = index.by_signature.find(get_signature(*instruction_type));
+    if (it != index.by_signature.end()) {
+        ityp = utils::One<InstructionType>(it->second.front().get_ptr());
     }
 
     // If the generalized instruction doesn't already exist, add it.
     auto added_anything = false;
-    if (!already_exists) {
+    if (ityp.empty()) {
+
+        // Check its name. Existing instruction types have already been
+        // checked when they were added.
+        if (!std::regex_match(instruction_type->name, IDENTIFIER_RE)) {
+            QL_USER_ERROR(
+                "invalid name for new instruction type: \"" <<
+                instruction_type->name << "\" is not a valid identifier"
+            );
+        }
+
         auto clone = instruction_type.clone();
         clone->copy_annotations(*instruction_type);
 
@@ -170,7 +547,8 @@ static utils::Pair<InstructionTypeLink, utils::Bool> add_or_find_instruction_typ
         // the original from instruction_type at the end.
         clone->decompositions.reset();
 
-        pos = ir->platform->instructions.get_vec().insert(pos, clone);
+        insert_instruction_type(ir, index, clone);
+        ityp = clone;
         added_anything = true;
     } else {
 
@@ -180,28 +558,25 @@ static utils::Pair<InstructionTypeLink, utils::Bool> add_or_find_instruction_typ
         // descriptiveness, so we need to copy anything that must be the same
         // across specializations to the incoming instruction type in case it's
         // added.
-        for (utils::UInt i = 0; i < (*pos)->operand_types.size(); i++) {
-            instruction_type->operand_types[i]->mode = (*pos)->operand_types[i]->mode;
+        for (utils::UInt i = 0; i < ityp->operand_types.size(); i++) {
+            instruction_type->operand_types[i]->mode = ityp->operand_types[i]->mode;
         }
 
     }
 
     // Now create/add/look for specializations as appropriate.
-    auto ityp = *pos;
+    // The specializations are looked up through the specialization index of
+    // the generalized instruction type.
+    auto generalized = ityp;
+    utils::Vec<ExpressionRef> operands{template_operands.begin(), template_operands.end()};
     for (utils::UInt i = 0; i < template_operands.size(); i++) {
-        auto op = template_operands[i];
+        auto &spec_index = get_specialization_index(*generalized);
 
         // See if the specialization already exists, and if so, recurse into
         // it.
-        auto already_exists = false;
-        for (const auto &spec : ityp->specializations) {
-            if (spec->template_operands.back().equals(op)) {
-                already_exists = true;
-                ityp = spec;
-                break;
-            }
-        }
-        if (already_exists) {
+        auto existing = spec_index.find(operands, i + 1);
+        if (!existing.empty()) {
+            ityp = utils::One<InstructionType>(existing.get_ptr());
             continue;
         }
 
@@ -214,6 +589,7 @@ static utils::Pair<InstructionTypeLink, utils::Bool> add_or_find_instruction_typ
         } else {
             spec = ityp.clone();
             spec->copy_annotations(*ityp);
+            spec->erase_annotation<SpecializationIndex>();
             spec->specializations.reset();
             spec->generalization.reset();
         }
@@ -229,7 +605,7 @@ static utils::Pair<InstructionTypeLink, utils::Bool> add_or_find_instruction_typ
         }
 
         // Link the specialization up.
-        ityp->specializations.add(spec);
+        add_specialization(*generalized, *ityp, spec);
         spec->generalization = ityp;
         added_anything = true;
 
@@ -280,7 +656,8 @@ InstructionTypeLink add_instruction_type(
  * with the given name and operand type set exists, then an overload is
  * generated for the first instruction type for which only the name matches iff
  * that instruction type has the PrototypeInferred annotation, and that overload
- * is returned. If no matching instruction type is found or was created, an
+ * is returned. Generated overloads carry the GeneratedInstructionType
+ * annotation. If no matching instruction type is found or was created, an
  * empty link is returned.
  */
 InstructionTypeLink find_instruction_type(
@@ -293,56 +670,51 @@ InstructionTypeLink find_instruction_type(
     QL_ASSERT(types.size() == writable.size());
 
     // Search for a matching instruction.
-    auto begin = ir->platform->instructions.get_vec().begin();
-    auto end = ir->platform->instructions.get_vec().end();
-    auto first = std::lower_bound(
-        begin, end,
-        utils::make<InstructionType>(name),
-        compare_by_name<InstructionType>
-    );
-    auto pos = first;
-    for (; pos != end && (*pos)->name == name; ++pos) {
-        if ((*pos)->operand_types.size() != types.size()) {
-            continue;
-        }
-        auto match = true;
-        for (utils::UInt i = 0; i < (*pos)->operand_types.size(); i++) {
-            if ((*pos)->operand_types[i]->data_type != types[i]) {
-                match = false;
-                break;
-            }
-            if (!writable[i]) {
-                switch ((*pos)->operand_types[i]->mode) {
-                    case prim::OperandMode::BARRIER:
-                    case prim::OperandMode::WRITE:
-                    case prim::OperandMode::UPDATE:
-                    case prim::OperandMode::COMMUTE_X:
-                    case prim::OperandMode::COMMUTE_Y:
-                    case prim::OperandMode::COMMUTE_Z:
-                    case prim::OperandMode::MEASURE:
-                        match = false;
-                        break;
-                    case prim::OperandMode::READ:
-                    case prim::OperandMode::LITERAL:
-                    case prim::OperandMode::IGNORE:
-                        break;
+    auto &index = get_instruction_type_index(ir);
+    InstructionSignature sig{name, {}};
+    for (const auto &type : types) {
+        sig.types.push_back(type.get_ptr().get());
+    }
+    auto it = index.by_signature.find(sig);
+    if (it != index.by_signature.end()) {
+        for (const auto &candidate : it->second) {
+            auto match = true;
+            for (utils::UInt i = 0; i < candidate->operand_types.size(); i++) {
+                if (!writable[i]) {
+                    switch (candidate->operand_types[i]->mode) {
+                        case prim::OperandMode::BARRIER:
+                        case prim::OperandMode::WRITE:
+                        case prim::OperandMode::UPDATE:
+                        case prim::OperandMode::COMMUTE_X:
+                        case prim::OperandMode::COMMUTE_Y:
+                        case prim::OperandMode::COMMUTE_Z:
+                        case prim::OperandMode::MEASURE:
+                            match = false;
+                            break;
+                        case prim::OperandMode::READ:
+                        case prim::OperandMode::LITERAL:
+                        case prim::OperandMode::IGNORE:
+                            break;
+                    }
+                    if (!match) break;
                 }
-                if (!match) break;
             }
-        }
-        if (match) {
-            return *pos;
+            if (match) {
+                return candidate;
+            }
         }
     }
 
-    // pos equalling first implies that (*pos)->name != name, i.e. there is no
-    // instruction by this name.
-    if (pos == first) {
+    // Look for the first instruction by this name. If there is none, there is
+    // nothing to generate an overload from.
+    auto first_it = index.first_by_name.find(name);
+    if (first_it == index.first_by_name.end()) {
         return {};
     }
+    const auto &first = first_it->second;
 
     // If we shouldn't generate an overload if only the name matches, stop now.
-    if (!generate_overload_if_needed || !(*first)->has_annotation<PrototypeInferred>()) {
+    if (!generate_overload_if_needed || !first->has_annotation<PrototypeInferred>()) {
         return {};
     }
 
@@ -350,8 +722,9 @@ InstructionTypeLink find_instruction_type(
     // parameters, conservatively assuming write access mode for references and
     // read for everything else. This is based on the first instruction we
     // encounter with this name.
-    auto ityp = first->clone();
-    ityp->copy_annotations(**first);
+    auto ityp = utils::One<InstructionType>(first.get_ptr()).clone();
+    ityp->copy_annotations(*first);
+    ityp->set_annotation<GeneratedInstructionType>({});
     ityp->operand_types.reset();
     for (utils::UInt i = 0; i < types.size(); i++) {
         ityp->operand_types.emplace(
@@ -361,8 +734,8 @@ InstructionTypeLink find_instruction_type(
     }
 
     // Insert the instruction just after all the other instructions with this
-    // name, i.e. at pos, to maintain sort order.
-    ir->platform->instructions.get_vec().insert(pos, ityp);
+    // name, to maintain sort order.
+    insert_instruction_type(ir, index, ityp);
 
     return ityp;
 }
@@ -563,23 +936,48 @@ InstructionRef make_set_instruction(
  * Updates the given instruction node to use the most specialized instruction
  * type available. If the instruction is not a custom instruction or the
  * instruction is already fully specialized, this is no-op.
+ *
+ * The specialization is looked up in the specialization index of the
+ * generalized instruction type, trying the longest possible tuple of template
+ * operands first, so this takes a constant number of hash lookups regardless
+ * of the number of specializations.
  */
 void specialize_instruction(
     const InstructionRef &instruction
 ) {
-    if (auto custom_insn = instruction->as_custom_instruction()) {
-        utils::Bool specialization_found;
-        do {
-            specialization_found = false;
-            for (const auto &spec : custom_insn->instruction_type->specializations) {
-                if (spec->template_operands.back().equals(custom_insn->operands.front())) {
-                    custom_insn->operands.remove(0);
-                    custom_insn->instruction_type = spec;
-                    specialization_found = true;
-                    break;
-                }
+    auto custom_insn = instruction->as_custom_instruction();
+    if (!custom_insn || custom_insn->operands.empty()) {
+        return;
+    }
+    auto generalized = get_generalization(custom_insn->instruction_type);
+    if (generalized->specializations.empty()) {
+        return;
+    }
+    const auto &index = get_specialization_index(*generalized);
+
+    // Gather the template operands that the instruction type already has and
+    // the operands that may become template operands.
+    const auto &current = custom_insn->instruction_type->template_operands;
+    auto depth = current.size();
+    auto max_depth = utils::min(index.max_depth, depth + custom_insn->operands.size());
+    if (max_depth <= depth) {
+        return;
+    }
+    utils::Vec<ExpressionRef> operands{current.begin(), current.end()};
+    for (utils::UInt i = 0; operands.size() < max_depth; i++) {
+        operands.push_back(custom_insn->operands[i]);
+    }
+
+    // Find the most specialized match.
+    for (auto n = max_depth; n > depth; n--) {
+        auto spec = index.find(operands, n);
+        if (!spec.empty()) {
+            for (auto i = depth; i < n; i++) {
+                custom_insn->operands.remove(0);
             }
-        } while (specialization_found);
+            custom_insn->instruction_type = spec;
+            return;
+        }
     }
 }
 
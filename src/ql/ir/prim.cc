@@ -372,6 +372,30 @@ std::ostream &operator<<(std::ostream &os, const ResourceManager &rm) {
     return os;
 }
 
+
+//==============================================================================
+// AnnotationSlots
+//==============================================================================
+
+template <>
+void serialize(const AnnotationSlots &obj, utils::tree::cbor::MapWriter &map) {
+}
+
+template <>
+AnnotationSlots deserialize(const utils::tree::cbor::MapReader &map) {
+    return AnnotationSlots();
+}
+
+std::ostream &operator<<(std::ostream &os, const AnnotationSlots &slots) {
+    utils::UInt count = 0;
+    for (utils::UInt index = 0; index < AnnotationSlots::SIZE; index++) {
+        if (slots.get(index)) {
+            count++;
+        }
+    }
+    return os << count << " of " << AnnotationSlots::SIZE << " used";
+}
+
 } // namespace prim
 } // namespace ir
 } // namespace ql
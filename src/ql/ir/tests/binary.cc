@@ -0,0 +1,57 @@
+#include <iostream>
+
+#include "ql/utils/str.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/binary.h"
+#include "ql/ir/cqasm/write.h"
+
+using namespace ql;
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+    auto program = utils::make<ir::compat::Program>("test_prog", plat, 7, 32, 10);
+
+    auto kernel = utils::make<ir::compat::Kernel>("kernel", plat, 7, 32, 10);
+    kernel->x(0);
+    kernel->cnot(0, 2);
+    kernel->classical(ir::compat::ClassicalRegister(1), 10);
+    program->add(kernel);
+
+    auto ir = ir::convert_old_to_new(program);
+
+    ir::cqasm::WriteOptions wo;
+    wo.include_platform = true;
+    wo.include_metadata = true;
+    utils::StrStrm before;
+    ir::cqasm::write(ir, wo, before);
+
+    // Round trip through a string and a stream with two consecutive records.
+    auto data = ir::binary::to_string(ir);
+    auto restored = ir::binary::read(data);
+    utils::StrStrm records;
+    ir::binary::write(restored, records);
+    ir::binary::write(ir, records);
+    auto first = ir::binary::read(records);
+    auto second = ir::binary::read(records);
+
+    for (const auto &result : {restored, first, second}) {
+        QL_ASSERT(result->platform->has_annotation<ir::compat::PlatformRef>());
+        QL_ASSERT(result->platform->resources.is_populated());
+        utils::StrStrm after;
+        ir::cqasm::write(result, wo, after);
+        QL_ASSERT(after.str() == before.str());
+    }
+
+    // Corrupt records must be rejected.
+    auto truncated = data.substr(0, data.size() - 1);
+    utils::Bool rejected = false;
+    try {
+        ir::binary::read(truncated);
+    } catch (utils::Exception &) {
+        rejected = true;
+    }
+    QL_ASSERT(rejected);
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "ql/utils/str.h"
+#include "ql/utils/filesystem.h"
+#include "ql/com/options.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/cqasm/read.h"
+#include "ql/ir/cqasm/write.h"
+
+using namespace ql;
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+
+    // Write a number of different programs to cQASM files.
+    utils::make_dirs("test_output");
+    ir::Ref ir;
+    utils::Vec<utils::Str> fnames;
+    for (utils::UInt i = 0; i < 12; i++) {
+        auto program = utils::make<ir::compat::Program>("prog", plat, 7, 32, 10);
+        auto kernel = utils::make<ir::compat::Kernel>("kernel", plat, 7, 32, 10);
+        for (utils::UInt j = 0; j < 10 + i; j++) {
+            kernel->x(j % 7);
+            kernel->cnot(j % 7, (j + i % 6 + 1) % 7);
+            kernel->rx(i % 7, 0.1 * j);
+            kernel->measure(j % 7);
+        }
+        program->add(kernel);
+        ir = ir::convert_old_to_new(program);
+        fnames.push_back("test_output/cqasm_read_files_" + utils::to_string(i) + ".cq");
+        utils::OutFile(fnames.back()).write(ir::cqasm::to_string(ir, ir));
+    }
+
+    // Reading the files in a batch must yield the same programs as reading
+    // them one by one, and the platform must be shared.
+    utils::Vec<utils::Str> sequential;
+    for (const auto &fname : fnames) {
+        auto file_ir = utils::make<ir::Root>(ir->platform);
+        ir::cqasm::read_file(file_ir, fname);
+        sequential.push_back(ir::cqasm::to_string(file_ir, file_ir));
+    }
+    for (utils::UInt num_threads : {1, 4, 0}) {
+        auto irs = ir::cqasm::read_files(ir, fnames, {}, num_threads);
+        QL_ASSERT(irs.size() == fnames.size());
+        for (utils::UInt i = 0; i < irs.size(); i++) {
+            QL_ASSERT(irs[i]->platform.get_ptr() == ir->platform.get_ptr());
+            QL_ASSERT(ir::cqasm::to_string(irs[i], irs[i]) == sequential[i]);
+        }
+    }
+
+    // With unique_output set, the files get consecutive unique names in the
+    // order in which they were specified, regardless of the thread count.
+    com::options::set("output_dir", "test_output");
+    com::options::set("unique_output", "yes");
+    for (utils::UInt num_threads : {1, 4}) {
+        auto irs = ir::cqasm::read_files(ir, fnames, {}, num_threads);
+        auto name = irs[0]->program->name;
+        utils::OutFile("test_output/" + name + ".unique") << 1;
+        irs = ir::cqasm::read_files(ir, fnames, {}, num_threads);
+        for (utils::UInt i = 0; i < irs.size(); i++) {
+            QL_ASSERT(irs[i]->program->unique_name == name + utils::to_string(i + 2));
+        }
+    }
+    com::options::set("unique_output", "no");
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <iostream>
+
+#include "ql/utils/str.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/cqasm/write.h"
+
+using namespace ql;
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+    auto program = utils::make<ir::compat::Program>("test_prog", plat, 7, 32, 10);
+
+    // Make a program with a bunch of blocks, some of which have the same name
+    // to exercise name uniquification.
+    for (utils::UInt i = 0; i < 16; i++) {
+        auto kernel = utils::make<ir::compat::Kernel>(i % 3 ? "kernel" : "exit", plat, 7, 32, 10);
+        kernel->x(i % 7);
+        kernel->cnot(i % 7, (i + 2) % 7);
+        kernel->rx(i % 7, 0.1 * i);
+        kernel->classical(ir::compat::ClassicalRegister(i % 32), i);
+        program->add(kernel);
+    }
+
+    auto ir = ir::convert_old_to_new(program);
+
+    // Printing the blocks concurrently must not affect the output.
+    ir::cqasm::WriteOptions wo;
+    wo.include_statistics = true;
+    utils::StrStrm sequential;
+    ir::cqasm::write(ir, wo, sequential);
+    for (utils::UInt num_threads : {2, 4, 0}) {
+        wo.num_threads = num_threads;
+        utils::StrStrm concurrent;
+        ir::cqasm::write(ir, wo, concurrent);
+        QL_ASSERT(concurrent.str() == sequential.str());
+        QL_ASSERT(ir::cqasm::to_string(ir, ir, wo) == sequential.str());
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "ql/ir/compat/compat.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/gc.h"
+
+using namespace ql;
+
+/**
+ * Returns whether the given object is still part of the program.
+ */
+static utils::Bool has_object(const ir::Ref &ir, const ir::ObjectLink &obj) {
+    for (const auto &candidate : ir->program->objects) {
+        if (candidate.get_ptr() == obj.get_ptr()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+    auto program = utils::make<ir::compat::Program>("prog", plat, 7, 32, 10);
+    auto kernel = utils::make<ir::compat::Kernel>("kernel", plat, 7, 32, 10);
+    kernel->x(0);
+    program->add(kernel);
+    auto ir = ir::convert_old_to_new(program);
+    auto block = ir->program->blocks[0];
+    auto int_type = ir->platform->default_int_type;
+    auto bit_type = ir->platform->default_bit_type;
+
+    // Generate two overloads of x, and only use the second one.
+    auto unused_overload = ir::find_instruction_type(ir, "x", {int_type}, {false}, true);
+    QL_ASSERT(!unused_overload.empty());
+    QL_ASSERT(unused_overload->has_annotation<ir::GeneratedInstructionType>());
+    block->statements.add(ir::make_instruction(ir, "x", {ir::make_bit_lit(ir, true)}, {}, false, true));
+
+    // Make two temporaries, and only use the second one.
+    auto unused_temp = ir::make_temporary(ir, int_type);
+    auto used_temp = ir::make_temporary(ir, int_type);
+    block->statements.add(ir::make_instruction(ir, "set", {
+        ir::make_reference(ir, used_temp), ir::make_int_lit(ir, 1)
+    }));
+
+    // Collecting garbage must remove exactly the unused entries, and keep
+    // the lookup indices consistent.
+    auto stats = ir::collect_garbage(ir);
+    QL_ASSERT(stats.temporaries >= 1);
+    QL_ASSERT(stats.instruction_types >= 1);
+    QL_ASSERT(!has_object(ir, unused_temp));
+    QL_ASSERT(has_object(ir, used_temp));
+    QL_ASSERT(ir::find_instruction_type(ir, "x", {int_type}, {false}).empty());
+    QL_ASSERT(!ir::find_instruction_type(ir, "x", {bit_type}, {false}).empty());
+    QL_ASSERT(!ir::find_instruction_type(ir, "x", {ir->platform->qubits->data_type}, {true}).empty());
+
+    // Before the first collection, all candidates count towards the
+    // threshold. After it, only new candidates do, so a threshold of one
+    // must not trigger another collection until a new candidate appears.
+    QL_ASSERT(ir::collect_garbage_if_needed(ir, 1));
+    QL_ASSERT(!ir::collect_garbage_if_needed(ir, 1));
+    ir::make_temporary(ir, int_type);
+    QL_ASSERT(ir::collect_garbage_if_needed(ir, 1));
+    QL_ASSERT(!ir::collect_garbage_if_needed(ir, 1));
+    QL_ASSERT(!ir::collect_garbage_if_needed(ir, 0));
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+
+#include "ql/utils/json.h"
+#include "ql/ir/ir.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/old_to_new.h"
+
+using namespace ql;
+
+int main() {
+
+    // Build a platform with a specialization of x for every qubit and of cz
+    // for every edge of a chain, enough to trigger the specialization index.
+    const utils::UInt num_qubits = 64;
+    auto instructions = utils::Json::object();
+    instructions["x"] = {{"duration", 20}};
+    instructions["cz"] = {{"duration", 40}};
+    for (utils::UInt q = 0; q < num_qubits; q++) {
+        instructions["x q" + utils::to_string(q)] = {{"duration", 20 + q}};
+        if (q + 1 < num_qubits) {
+            instructions[
+                "cz q" + utils::to_string(q) + ",q" + utils::to_string(q + 1)
+            ] = {{"duration", 40 + q}};
+        }
+    }
+    utils::Json config = {
+        {"eqasm_compiler", "none"},
+        {"hardware_settings", {{"qubit_number", num_qubits}, {"cycle_time", 1}}},
+        {"instructions", instructions},
+        {"gate_decomposition", utils::Json::object()},
+        {"resources", utils::Json::object()},
+        {"topology", utils::Json::object()}
+    };
+    auto ir = ir::convert_old_to_new(ir::compat::Platform::build("test_plat", config));
+
+    // The instruction list must be sorted by name once bulk mode ends.
+    const auto &types = ir->platform->instructions;
+    for (utils::UInt i = 1; i < types.size(); i++) {
+        QL_ASSERT(!(types[i]->name < types[i - 1]->name));
+    }
+
+    // Each qubit must resolve to its own specialization.
+    auto x = ir::find_instruction_type(ir, "x", {ir->platform->qubits->data_type}, {true});
+    QL_ASSERT(!x.empty());
+    QL_ASSERT(x->specializations.size() == num_qubits);
+    for (utils::UInt q = 0; q < num_qubits; q++) {
+        auto insn = ir::make_instruction(ir, "x", {ir::make_qubit_ref(ir, q)});
+        auto custom = insn->as_custom_instruction();
+        QL_ASSERT(custom);
+        QL_ASSERT(custom->operands.empty());
+        QL_ASSERT(custom->instruction_type->duration == 20 + q);
+    }
+
+    // Each edge must resolve to its own two-level specialization, and the
+    // reverse direction must not.
+    for (utils::UInt q = 0; q + 1 < num_qubits; q++) {
+        auto insn = ir::make_instruction(ir, "cz", {
+            ir::make_qubit_ref(ir, q), ir::make_qubit_ref(ir, q + 1)
+        });
+        auto custom = insn->as_custom_instruction();
+        QL_ASSERT(custom);
+        QL_ASSERT(custom->operands.empty());
+        QL_ASSERT(custom->instruction_type->duration == 40 + q);
+
+        insn = ir::make_instruction(ir, "cz", {
+            ir::make_qubit_ref(ir, q + 1), ir::make_qubit_ref(ir, q)
+        });
+        custom = insn->as_custom_instruction();
+        QL_ASSERT(custom);
+        QL_ASSERT(!custom->operands.empty());
+    }
+
+    // Generalizing and specializing again must round-trip.
+    auto insn = ir::make_instruction(ir, "x", {ir::make_qubit_ref(ir, 42)});
+    ir::generalize_instruction(insn);
+    QL_ASSERT(insn->as_custom_instruction()->instruction_type->generalization.empty());
+    ir::specialize_instruction(insn);
+    QL_ASSERT(insn->as_custom_instruction()->instruction_type->duration == 62);
+    insn = ir::make_instruction(ir, "cz", {
+        ir::make_qubit_ref(ir, 10), ir::make_qubit_ref(ir, 11)
+    });
+    ir::generalize_instruction(insn);
+    QL_ASSERT(insn->as_custom_instruction()->operands.size() == 2);
+    ir::specialize_instruction(insn);
+    QL_ASSERT(insn->as_custom_instruction()->operands.empty());
+    QL_ASSERT(insn->as_custom_instruction()->instruction_type->duration == 50);
+
+    // Specializing an instruction that is already partially specialized must
+    // only consider the remaining operands.
+    auto cz10 = insn->as_custom_instruction()->instruction_type->generalization;
+    insn = ir::make_instruction(ir, "cz", {
+        ir::make_qubit_ref(ir, 10), ir::make_qubit_ref(ir, 12)
+    });
+    QL_ASSERT(insn->as_custom_instruction()->instruction_type.get_ptr() == cz10.get_ptr());
+    QL_ASSERT(insn->as_custom_instruction()->operands.size() == 1);
+    insn->as_custom_instruction()->operands[0] = ir::make_qubit_ref(ir, 11);
+    ir::specialize_instruction(insn);
+    QL_ASSERT(insn->as_custom_instruction()->operands.empty());
+    QL_ASSERT(insn->as_custom_instruction()->instruction_type->duration == 50);
+
+    return 0;
+}
@@ -9,6 +9,130 @@ namespace pass {
 namespace ana {
 namespace statistics {
 
+/**
+ * Renders the statistic as a line for the report.
+ */
+utils::Str AdditionalStats::Entry::to_string() const {
+    switch (kind) {
+        case Kind::LINE:
+            return line;
+        case Kind::COUNTER:
+            return name.str() + ": " + utils::to_string(count);
+        default:
+            return name.str() + ": " + utils::to_string(value);
+    }
+}
+
+/**
+ * Returns the typed statistic with the given name and kind, creating it with
+ * value zero if it doesn't exist yet. Names are interned, so the lookup only
+ * compares pointers.
+ */
+static AdditionalStats::Entry &get_entry(
+    utils::List<AdditionalStats::Entry> &entries,
+    const utils::InternedStr &name,
+    AdditionalStats::Kind kind
+) {
+    for (auto &entry : entries) {
+        if (entry.kind == kind && entry.name == name) {
+            return entry;
+        }
+    }
+    entries.push_back({kind, name, "", 0, 0.0});
+    return entries.back();
+}
+
+/**
+ * Returns a reference to the value of the counter with the given name,
+ * creating it with value zero if it doesn't exist yet.
+ */
+utils::Int &AdditionalStats::counter(const utils::InternedStr &name) {
+    return get_entry(entries, name, Kind::COUNTER).count;
+}
+
+/**
+ * Returns a reference to the value of the gauge with the given name, creating
+ * it with value zero if it doesn't exist yet.
+ */
+utils::Real &AdditionalStats::gauge(const utils::InternedStr &name) {
+    return get_entry(entries, name, Kind::GAUGE).value;
+}
+
+/**
+ * Returns a reference to the number of seconds accumulated by the timer with
+ * the given name, creating it with value zero if it doesn't exist yet.
+ */
+utils::Real &AdditionalStats::timer(const utils::InternedStr &name) {
+    return get_entry(entries, name, Kind::TIMER).value;
+}
+
+/**
+ * Converts the typed statistics to a JSON object mapping their names to their
+ * values. Free-form lines are listed in the "lines" array.
+ */
+utils::Json AdditionalStats::to_json() const {
+    utils::Json json = utils::Json::object();
+    utils::Json lines = utils::Json::array();
+    for (const auto &entry : entries) {
+        switch (entry.kind) {
+            case Kind::LINE:
+                lines.push_back(entry.line);
+                break;
+            case Kind::COUNTER:
+                json[entry.name.str()] = entry.count;
+                break;
+            default:
+                json[entry.name.str()] = entry.value;
+                break;
+        }
+    }
+    json["lines"] = lines;
+    return json;
+}
+
+/**
+ * Returns the statistics attached to the given node, attaching an empty set of
+ * statistics first if there are none yet.
+ */
+static AdditionalStats &get_node(utils::tree::annotatable::Annotatable &node) {
+    if (!node.has_annotation<AdditionalStats>()) {
+        node.set_annotation<AdditionalStats>({});
+    }
+    return node.get_annotation<AdditionalStats>();
+}
+
+/**
+ * Returns the statistics attached to the given block node, attaching an empty
+ * set of statistics first if there are none yet.
+ */
+AdditionalStats &AdditionalStats::get(const ir::BlockRef &block) {
+    return get_node(*block);
+}
+
+/**
+ * Returns the statistics attached to the given program node, attaching an
+ * empty set of statistics first if there are none yet.
+ */
+AdditionalStats &AdditionalStats::get(const ir::ProgramRef &program) {
+    return get_node(*program);
+}
+
+/**
+ * Returns the statistics attached to the given kernel node, attaching an empty
+ * set of statistics first if there are none yet.
+ */
+AdditionalStats &AdditionalStats::get(const ir::compat::KernelRef &kernel) {
+    return get_node(*kernel);
+}
+
+/**
+ * Returns the statistics attached to the given program node, attaching an
+ * empty set of statistics first if there are none yet.
+ */
+AdditionalStats &AdditionalStats::get(const ir::compat::ProgramRef &program) {
+    return get_node(*program);
+}
+
 /**
  * Attaches a statistic to the given node.
  */
@@ -16,10 +140,9 @@ static void push_node(
     utils::tree::annotatable::Annotatable &node,
     const utils::Str &line
 ) {
-    if (!node.has_annotation<AdditionalStats>()) {
-        node.set_annotation<AdditionalStats>({});
-    }
-    node.get_annotation<AdditionalStats>().stats.push_back(line);
+    get_node(node).entries.push_back({
+        AdditionalStats::Kind::LINE, {}, line, 0, 0.0
+    });
 }
 
 /**
@@ -51,32 +174,63 @@ void AdditionalStats::push(const ir::compat::ProgramRef &program, const utils::S
 }
 
 /**
- * Pops all statistics annotations from the given node.
+ * Pops all statistics annotations from the given node, rendering the typed
+ * statistics to lines of text.
  */
 static utils::List<utils::Str> pop_node(utils::tree::annotatable::Annotatable &node) {
+    utils::List<utils::Str> stats;
     if (auto s = node.get_annotation_ptr<AdditionalStats>()) {
-        auto stats = std::move(s->stats);
+        for (const auto &entry : s->entries) {
+            stats.push_back(entry.to_string());
+        }
         node.erase_annotation<AdditionalStats>();
-        return stats;
-    } else {
-        return {};
     }
+    return stats;
+}
+
+/**
+ * Returns the statistics attached to the given node as JSON, without removing
+ * them.
+ */
+static utils::Json peek_json_node(utils::tree::annotatable::Annotatable &node) {
+    if (auto s = node.get_annotation_ptr<AdditionalStats>()) {
+        return s->to_json();
+    }
+    return AdditionalStats().to_json();
 }
 
 /**
- * Pops all statistics annotations from the given kernel.
+ * Pops all statistics annotations from the given kernel, rendering the typed
+ * statistics to lines of text.
  */
 utils::List<utils::Str> AdditionalStats::pop(const ir::BlockRef &kernel) {
     return pop_node(*kernel);
 }
 
 /**
- * Pops all statistics annotations from the given program.
+ * Pops all statistics annotations from the given program, rendering the typed
+ * statistics to lines of text.
  */
 utils::List<utils::Str> AdditionalStats::pop(const ir::ProgramRef &program) {
     return pop_node(*program);
 }
 
+/**
+ * Returns the statistics attached to the given kernel as JSON, without
+ * removing them.
+ */
+utils::Json AdditionalStats::peek_json(const ir::BlockRef &block) {
+    return peek_json_node(*block);
+}
+
+/**
+ * Returns the statistics attached to the given program as JSON, without
+ * removing them.
+ */
+utils::Json AdditionalStats::peek_json(const ir::ProgramRef &program) {
+    return peek_json_node(*program);
+}
+
 } // namespace statistics
 } // namespace ana
 } // namespace pass
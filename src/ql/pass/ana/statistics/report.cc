@@ -5,6 +5,8 @@
 #include "ql/pass/ana/statistics/report.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
+#include "ql/utils/parallel.h"
 #include "ql/com/ana/metrics.h"
 
 namespace ql {
@@ -14,22 +16,36 @@ namespace statistics {
 namespace report {
 
 /**
- * Dumps basic statistics for the given kernel to the given output stream.
+ * The basic statistics reported for blocks and programs, computed in a single
+ * traversal.
  */
-void dump(
-    const ir::Ref &ir,
+using Statistics = com::ana::MetricSet<
+    com::ana::Latency,
+    com::ana::QuantumGateCount,
+    com::ana::MultiQubitGateCount,
+    com::ana::ClassicalOperationCount,
+    com::ana::QubitUsageCount,
+    com::ana::QubitUsedCycleCount
+>;
+
+/**
+ * Dumps the given precomputed statistics for a block to the given output
+ * stream.
+ */
+static void dump(
+    Statistics &stats,
     const ir::BlockRef &block,
     std::ostream &os,
     const utils::Str &line_prefix
 ) {
     using namespace com::ana;
 
-    os << line_prefix << "Duration (assuming no control-flow): " << compute_block<Latency>(ir, block) << "\n";
-    os << line_prefix << "Number of quantum gates: " << compute_block<QuantumGateCount>(ir, block) << "\n";
-    os << line_prefix << "Number of multi-qubit gates: " << compute_block<MultiQubitGateCount>(ir, block) << "\n";
-    os << line_prefix << "Number of classical operations: " << compute_block<ClassicalOperationCount>(ir, block) << "\n";
-    os << line_prefix << "Number of qubits used: " << compute_block<QubitUsageCount>(ir, block).sparse_size() << "\n";
-    os << line_prefix << "Qubit cycles use (assuming no control-flow): " << compute_block<QubitUsedCycleCount>(ir, block) << "\n";
+    os << line_prefix << "Duration (assuming no control-flow): " << stats.get_result<Latency>() << "\n";
+    os << line_prefix << "Number of quantum gates: " << stats.get_result<QuantumGateCount>() << "\n";
+    os << line_prefix << "Number of multi-qubit gates: " << stats.get_result<MultiQubitGateCount>() << "\n";
+    os << line_prefix << "Number of classical operations: " << stats.get_result<ClassicalOperationCount>() << "\n";
+    os << line_prefix << "Number of qubits used: " << stats.get_result<QubitUsageCount>().sparse_size() << "\n";
+    os << line_prefix << "Qubit cycles use (assuming no control-flow): " << stats.get_result<QubitUsedCycleCount>() << "\n";
     for (const auto &line : AdditionalStats::pop(block)) {
         os << line_prefix << "----- " << line << "\n";
     }
@@ -37,49 +53,88 @@ void dump(
 }
 
 /**
- * Dumps basic statistics for the given program to the given output stream. This
- * only dumps the global statistics, not the statistics for each individual
- * kernel.
+ * Dumps the given precomputed statistics for a program to the given output
+ * stream.
  */
-void dump(
-    const ir::Ref &ir,
+static void dump(
+    Statistics &stats,
     const ir::ProgramRef &program,
     std::ostream &os,
     const utils::Str &line_prefix
 ) {
     using namespace com::ana;
 
-    os << line_prefix << "Total duration (assuming no control-flow): " << compute_program<Latency>(ir) << "\n";
-    os << line_prefix << "Total number of quantum gates: " << compute_program<QuantumGateCount>(ir) << "\n";
-    os << line_prefix << "Total number of multi-qubit gates: " << compute_program<MultiQubitGateCount>(ir) << "\n";
-    os << line_prefix << "Total number of classical operations: " << compute_program<ClassicalOperationCount>(ir) << "\n";
-    os << line_prefix << "Number of qubits used: " << compute_program<QubitUsageCount>(ir).sparse_size() << "\n";
-    os << line_prefix << "Qubit cycles use (assuming no control-flow): " << compute_program<QubitUsedCycleCount>(ir) << "\n";
+    os << line_prefix << "Total duration (assuming no control-flow): " << stats.get_result<Latency>() << "\n";
+    os << line_prefix << "Total number of quantum gates: " << stats.get_result<QuantumGateCount>() << "\n";
+    os << line_prefix << "Total number of multi-qubit gates: " << stats.get_result<MultiQubitGateCount>() << "\n";
+    os << line_prefix << "Total number of classical operations: " << stats.get_result<ClassicalOperationCount>() << "\n";
+    os << line_prefix << "Number of qubits used: " << stats.get_result<QubitUsageCount>().sparse_size() << "\n";
+    os << line_prefix << "Qubit cycles use (assuming no control-flow): " << stats.get_result<QubitUsedCycleCount>() << "\n";
     for (const auto &line : AdditionalStats::pop(program)) {
         os << line_prefix << line << "\n";
     }
     os.flush();
 }
 
+/**
+ * Dumps basic statistics for the given kernel to the given output stream.
+ */
+void dump(
+    const ir::Ref &ir,
+    const ir::BlockRef &block,
+    std::ostream &os,
+    const utils::Str &line_prefix
+) {
+    Statistics stats;
+    stats.process_block(ir, block);
+    dump(stats, block, os, line_prefix);
+}
+
+/**
+ * Dumps basic statistics for the given program to the given output stream. This
+ * only dumps the global statistics, not the statistics for each individual
+ * kernel.
+ */
+void dump(
+    const ir::Ref &ir,
+    const ir::ProgramRef &program,
+    std::ostream &os,
+    const utils::Str &line_prefix
+) {
+    Statistics stats;
+    stats.process_program(ir, program);
+    dump(stats, program, os, line_prefix);
+}
+
 /**
  * Dumps statistics for the given program and its kernels to the given output
- * stream.
+ * stream. The statistics of the blocks are computed using up to num_threads
+ * threads (0 means use all hardware threads), and are accumulated into the
+ * global statistics rather than traversing the program again.
  */
 void dump_all(
     const ir::Ref &ir,
     std::ostream &os,
-    const utils::Str &line_prefix
+    const utils::Str &line_prefix,
+    utils::UInt num_threads
 ) {
     if (ir->program.empty()) {
         os << line_prefix << "no program node to dump statistics for" << std::endl;
     } else {
-        for (const auto &block : ir->program->blocks) {
-            os << line_prefix << "For block with name \"" << block->name << "\":\n";
-            dump(ir, block, os, line_prefix + "    ");
+        const auto &blocks = ir->program->blocks;
+        utils::Vec<Statistics> block_stats(blocks.size());
+        utils::parallel_for(blocks.size(), num_threads, [&](utils::UInt i) {
+            block_stats[i].process_block(ir, blocks[i]);
+        });
+        Statistics global_stats;
+        for (utils::UInt i = 0; i < blocks.size(); i++) {
+            os << line_prefix << "For block with name \"" << blocks[i]->name << "\":\n";
+            dump(block_stats[i], blocks[i], os, line_prefix + "    ");
             os << "\n";
+            global_stats.accumulate(block_stats[i]);
         }
         os << line_prefix << "Global statistics:\n";
-        dump(ir, ir->program, os, line_prefix);
+        dump(global_stats, ir->program, os, line_prefix);
     }
 }
 
@@ -95,6 +150,10 @@ void ReportStatisticsPass::dump_docs(
     report file. Some passes may also attach additional pass-specific statistics
     to the program and kernels, in which case these are printed and subsequently
     discarded as well.
+
+    The numeric statistics attached by other passes (counters, gauges, and
+    timers) can also be written to a JSON file by setting the json_suffix
+    option, for example to `.json`.
     )");
 }
 
@@ -105,6 +164,14 @@ utils::Str ReportStatisticsPass::get_friendly_type() const {
     return "Statistics reporter";
 }
 
+/**
+ * Returns the products of the statistics reporter: the report files, and the
+ * statistics reported in them.
+ */
+pmgr::Products ReportStatisticsPass::get_products() const {
+    return pmgr::product::FILES | pmgr::product::STATISTICS;
+}
+
 /**
  * Constructs a statistics reporter.
  */
@@ -118,12 +185,27 @@ ReportStatisticsPass::ReportStatisticsPass(
         "Suffix to use for the output filename.",
         ".txt"
     );
+    options.add_str(
+        "json_suffix",
+        "When nonempty, the numeric statistics attached to the program and "
+        "its blocks by previous passes are additionally written to a JSON "
+        "file with this filename suffix.",
+        ""
+    );
     options.add_str(
         "line_prefix",
         "Historically, report files contain a \"# \" prefix before each line. You can "
         "use this option to emulate that behavior.",
         ""
     );
+    options.add_int(
+        "block_threads",
+        "The number of threads to use for computing the statistics of the "
+        "blocks of the program concurrently. 0 means use all hardware "
+        "threads.",
+        "1",
+        0
+    );
 }
 
 /**
@@ -135,7 +217,28 @@ utils::Int ReportStatisticsPass::run(
 ) const {
     auto line_prefix = options["line_prefix"].as_str();
     auto filename = context.output_prefix + options["output_suffix"].as_str();
-    dump_all(ir, utils::OutFile(filename).unwrap(), line_prefix);
+
+    // The JSON report must be written first, as the text report discards the
+    // statistics.
+    auto json_suffix = options["json_suffix"].as_str();
+    if (!json_suffix.empty() && !ir->program.empty()) {
+        utils::Json blocks = utils::Json::object();
+        for (const auto &block : ir->program->blocks) {
+            blocks[block->name] = AdditionalStats::peek_json(block);
+        }
+        utils::Json json = {
+            {"program", AdditionalStats::peek_json(ir->program)},
+            {"blocks", blocks}
+        };
+        utils::AsyncOutFile(context.output_prefix + json_suffix) << json.dump(4) << "\n";
+    }
+
+    dump_all(
+        ir,
+        utils::AsyncOutFile(filename).unwrap(),
+        line_prefix,
+        options["block_threads"].as_uint()
+    );
     return 0;
 }
 
@@ -57,7 +57,12 @@ void VisualizeCircuitPass::dump_docs(
       NOTE: when the to-be-visualized circuit is very large, the interactive
       window may have trouble rendering the circuit even when zoomed in.
       Therefore, it is recommended to use non-interactive mode and view the
-      generated bitmap with a more capable external viewer.
+      generated bitmap with a more capable external viewer. For circuits that
+      are too large to fit in a single image, the `tile_width` option can be
+      used to save the circuit as a series of fixed-width images instead.
+      Alternatively, `image_format` can be set to `svg` to save the circuit as
+      vector graphics, of which the size scales with the number of gates
+      rather than with the number of pixels.
 
       The `"circuit"` section has several child sections.
 
@@ -337,6 +342,17 @@ utils::Str VisualizeCircuitPass::get_friendly_type() const {
     return "Circuit visualizer";
 }
 
+/**
+ * Returns the products of the circuit visualizer: a window in interactive mode,
+ * or an image file otherwise.
+ */
+pmgr::Products VisualizeCircuitPass::get_products() const {
+    if (options["interactive"].as_bool()) {
+        return pmgr::product::INTERACTIVE;
+    }
+    return pmgr::product::FILES;
+}
+
 /**
  * Constructs a circuit visualizer pass.
  */
@@ -358,7 +374,35 @@ VisualizeCircuitPass::VisualizeCircuitPass(
     options.add_bool(
         "interactive",
         "When yes, the visualizer will open a window when the pass is run. "
-        "When no, an image will be saved as <output_prefix>.bmp instead."
+        "When no, an image will be saved as <output_prefix>.bmp (or .svg) "
+        "instead."
+    );
+    options.add_int(
+        "tile_width",
+        "When nonzero, the circuit is drawn in tiles of this width in pixels, "
+        "which are saved as <output_prefix>_<index>.bmp from left to right. "
+        "Only a single tile is kept in memory at any time, so this allows "
+        "circuits to be visualized that are too large for a single image. "
+        "Interactive mode is not supported when tiling.",
+        "0",
+        0
+    );
+    options.add_int(
+        "tile_threads",
+        "The number of threads to use for drawing. The image is divided into "
+        "vertical strips (or into tiles, when tile_width is set) that are "
+        "drawn concurrently. 0 means use all hardware threads.",
+        "1",
+        0
+    );
+    options.add_enum(
+        "image_format",
+        "The format of the saved images. bmp renders the circuit to a bitmap. "
+        "svg writes the circuit as vector graphics instead, which is much "
+        "smaller for large circuits and can be zoomed without loss of "
+        "detail. Interactive mode only supports bmp.",
+        "bmp",
+        {"bmp", "svg"}
     );
 }
 
@@ -377,7 +421,12 @@ utils::Int VisualizeCircuitPass::run(
             options["waveform_mapping"].as_str(),
             options["interactive"].as_bool(),
             context.output_prefix,
-            context.full_pass_name
+            context.full_pass_name,
+            options["tile_width"].as_int(),
+            options["tile_threads"].as_uint(),
+            options["image_format"].as_str() == "svg"
+                ? detail::ImageFormat::SVG
+                : detail::ImageFormat::BITMAP
         }
     );
     return 0;
@@ -8,6 +8,7 @@
 
 #include <regex>
 #include "ql/utils/exception.h"
+#include "ql/utils/parallel.h"
 #include "common.h"
 
 namespace ql {
@@ -541,6 +542,15 @@ void Structure::printProperties() const {
 }
 
 void visualizeCircuit(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration) {
+    // Huge circuits are drawn in tiles to bound memory usage.
+    if (configuration.tileWidth > 0) {
+        if (configuration.interactive) {
+            QL_WOUT("Interactive mode is not supported for tiled circuit visualization, saving tiles instead...");
+        }
+        generateTiles(program, configuration);
+        return;
+    }
+
     const Vec<GateProperties> gates = parseGates(program);
     const Int cycleDuration = utoi(program->platform->cycle_time);
     const Int amountOfCycles = calculateAmountOfCycles(gates, cycleDuration);
@@ -551,7 +561,7 @@ void visualizeCircuit(const ir::compat::ProgramRef &program, const VisualizerCon
 
     // Save the image if enabled.
     if (imageOutput.circuitLayout.saveImage || !configuration.interactive) {
-        imageOutput.image.save(configuration.output_prefix + ".bmp");
+        imageOutput.image.save(configuration.output_prefix + getFileExtension(configuration.imageFormat));
     }
 
     // Display the image if enabled.
@@ -561,6 +571,61 @@ void visualizeCircuit(const ir::compat::ProgramRef &program, const VisualizerCon
     }
 }
 
+void generateTiles(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration) {
+    // Get the gate list from the program.
+    QL_DOUT("Getting gate list...");
+    Vec<GateProperties> gates = parseGates(program);
+    if (gates.size() == 0) {
+        QL_FATAL("Quantum program contains no gates!");
+    }
+
+    // Parse and validate the layout and instruction configuration file.
+    CircuitLayout layout = parseCircuitConfiguration(gates, configuration.visualizerConfigPath, program->platform->get_instructions());
+    validateCircuitLayout(layout, configuration.visualizationType);
+
+    // Calculate circuit properties.
+    QL_DOUT("Calculating circuit properties...");
+    const Int cycleDuration = utoi(program->platform->cycle_time);
+    fixMeasurementOperands(gates);
+    CircuitData circuitData(gates, layout, cycleDuration);
+    circuitData.printProperties();
+
+    // Initialize the structure of the visualization. Only the structure spans
+    // the whole circuit; the image itself is only ever allocated for a single
+    // tile.
+    QL_DOUT("Initializing visualization structure...");
+    const Vec<Int> minCycleWidths(circuitData.getAmountOfCycles(), 0);
+    Structure structure(layout, circuitData, minCycleWidths, 0);
+    structure.printProperties();
+
+    Vec<QubitLines> linesPerQubit;
+    if (layout.pulses.areEnabled()) {
+        PulseVisualization pulseVisualization = parseWaveformMapping(configuration.waveformMappingPath);
+        linesPerQubit = generateQubitLines(gates, pulseVisualization, circuitData);
+    }
+
+    // Draw and save the tiles one at a time. The tiles are numbered from left
+    // to right, zero-padded such that they sort in order.
+    const Int imageWidth = structure.getImageWidth();
+    const Int amountOfTiles = (imageWidth + configuration.tileWidth - 1) / configuration.tileWidth;
+    const UInt digits = to_string(max(amountOfTiles - 1, (Int) 0)).size();
+    // Each thread works on one tile at a time, so at most numThreads tiles
+    // are in memory at once.
+    QL_IOUT("Drawing circuit of width " << imageWidth << " in " << amountOfTiles << " tiles...");
+    parallel_for(amountOfTiles, configuration.numThreads, [&](UInt tileIndex) {
+        const Int x0 = utoi(tileIndex) * configuration.tileWidth;
+        const Int width = min(configuration.tileWidth, imageWidth - x0);
+
+        Image tile(width, structure.getImageHeight(), x0, configuration.imageFormat);
+        tile.fill(layout.backgroundColor);
+        drawCircuit(tile, layout, circuitData, structure, linesPerQubit);
+
+        Str index = to_string(tileIndex);
+        index.insert(0, digits - index.size(), '0');
+        tile.save(configuration.output_prefix + "_" + index + getFileExtension(configuration.imageFormat));
+    });
+}
+
 ImageOutput generateImage(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration, const Vec<Int> &minCycleWidths, const utils::Int extendedImageHeight) {
     // Get the gate list from the program.
     QL_DOUT("Getting gate list...");
@@ -591,9 +656,56 @@ ImageOutput generateImage(const ir::compat::ProgramRef &program, const Visualize
 
     // Initialize image.
     QL_DOUT("Initializing image...");
-    Image image(structure.getImageWidth(), structure.getImageHeight());
+    Image image(structure.getImageWidth(), structure.getImageHeight(), 0, configuration.imageFormat);
     image.fill(layout.backgroundColor);
 
+    // Draw the circuit.
+    Vec<QubitLines> linesPerQubit;
+    if (layout.pulses.areEnabled()) {
+        PulseVisualization pulseVisualization = parseWaveformMapping(configuration.waveformMappingPath);
+        linesPerQubit = generateQubitLines(gates, pulseVisualization, circuitData);
+    }
+    drawCircuitParallel(image, layout, circuitData, structure, linesPerQubit, configuration.numThreads);
+
+    return {image, layout, circuitData, structure};
+}
+
+void drawCircuitParallel(Image &image,
+                         const CircuitLayout &layout,
+                         const CircuitData &circuitData,
+                         const Structure &structure,
+                         const Vec<QubitLines> &linesPerQubit,
+                         const UInt numThreads) {
+    // SVG images cannot be composed from strips, but they are cheap to draw
+    // anyway, as the primitives are not rasterized.
+    const Int amountOfStrips = min(utoi(resolve_num_threads(numThreads)), image.getWidth());
+    if (amountOfStrips <= 1 || image.getFormat() != ImageFormat::BITMAP) {
+        drawCircuit(image, layout, circuitData, structure, linesPerQubit);
+        return;
+    }
+
+    // Draw vertical strips of the image concurrently, each into its own
+    // image, and copy them into the image afterwards. The strips are disjoint,
+    // so the copies can also be done concurrently.
+    QL_DOUT("Drawing circuit in " << amountOfStrips << " strips...");
+    const Int stripWidth = (image.getWidth() + amountOfStrips - 1) / amountOfStrips;
+    parallel_for(amountOfStrips, numThreads, [&](UInt stripIndex) {
+        const Int x0 = image.getOriginX() + utoi(stripIndex) * stripWidth;
+        const Int width = min(stripWidth, image.getOriginX() + image.getWidth() - x0);
+        if (width <= 0) return;
+
+        Image strip(width, structure.getImageHeight(), x0);
+        strip.fill(layout.backgroundColor);
+        drawCircuit(strip, layout, circuitData, structure, linesPerQubit);
+        image.drawImage(strip);
+    });
+}
+
+void drawCircuit(Image &image,
+                 const CircuitLayout &layout,
+                 const CircuitData &circuitData,
+                 const Structure &structure,
+                 const Vec<QubitLines> &linesPerQubit) {
     // Draw the cycle labels if the option has been set.
     if (layout.cycles.labels.areEnabled()) {
         drawCycleLabels(image, layout, circuitData, structure);
@@ -609,32 +721,29 @@ ImageOutput generateImage(const ir::compat::ProgramRef &program, const Visualize
         drawBitLineEdges(image, layout, circuitData, structure);
     }
     
-    // Draw the bit line labels if enabled.
-    if (layout.bitLines.labels.areEnabled()) {
+    // Draw the bit line labels if enabled (and visible, when drawing a tile).
+    if (layout.bitLines.labels.areEnabled() && image.isVisible(0, structure.getBitLabelsX() + layout.bitLines.labels.getColumnWidth())) {
         drawBitLineLabels(image, layout, circuitData, structure);
     }
 
     // Draw the circuit as pulses if enabled.
     if (layout.pulses.areEnabled()) {
-        PulseVisualization pulseVisualization = parseWaveformMapping(configuration.waveformMappingPath);
-        const Vec<QubitLines> linesPerQubit = generateQubitLines(gates, pulseVisualization, circuitData);
-
         // Draw the lines of each qubit.
         QL_DOUT("Drawing qubit lines for pulse visualization...");
         for (Int qubitIndex = 0; qubitIndex < circuitData.amountOfQubits; qubitIndex++) {
             const Int yBase = structure.getCellPosition(0, qubitIndex, QUANTUM).y0;
 
-            drawLine(image, structure, cycleDuration, linesPerQubit[qubitIndex].microwave, qubitIndex,
+            drawLine(image, structure, circuitData.cycleDuration, linesPerQubit[qubitIndex].microwave, qubitIndex,
                 yBase,
                 layout.pulses.getPulseRowHeightMicrowave(),
                 layout.pulses.getPulseColorMicrowave());
 
-            drawLine(image, structure, cycleDuration, linesPerQubit[qubitIndex].flux, qubitIndex,
+            drawLine(image, structure, circuitData.cycleDuration, linesPerQubit[qubitIndex].flux, qubitIndex,
                 yBase + layout.pulses.getPulseRowHeightMicrowave(),
                 layout.pulses.getPulseRowHeightFlux(),
                 layout.pulses.getPulseColorFlux());
 
-            drawLine(image, structure, cycleDuration, linesPerQubit[qubitIndex].readout, qubitIndex,
+            drawLine(image, structure, circuitData.cycleDuration, linesPerQubit[qubitIndex].readout, qubitIndex,
                 yBase + layout.pulses.getPulseRowHeightMicrowave() + layout.pulses.getPulseRowHeightFlux(),
                 layout.pulses.getPulseRowHeightReadout(),
                 layout.pulses.getPulseColorReadout());
@@ -706,6 +815,12 @@ ImageOutput generateImage(const ir::compat::ProgramRef &program, const Visualize
         // Draw the cycles.
         QL_DOUT("Drawing cycles...");
         for (Int i = 0; i < circuitData.getAmountOfCycles(); i++) {
+            // Cycles are laid out from left to right, so once a cycle starts
+            // beyond the image (tile), so do all subsequent cycles.
+            if (structure.getCellPosition(i, 0, QUANTUM).x0 >= image.getOriginX() + image.getWidth()) {
+                break;
+            }
+
             // Only draw a cut cycle if its the first in its cut range.
             if (circuitData.isCycleCut(i)) {
                 if (i > 0 && !circuitData.isCycleCut(i - 1)) {
@@ -718,7 +833,6 @@ ImageOutput generateImage(const ir::compat::ProgramRef &program, const Visualize
         }
     }
 
-    return {image, layout, circuitData, structure};
 }
 
 CircuitLayout parseCircuitConfiguration(Vec<GateProperties> &gates,
@@ -1386,6 +1500,12 @@ void drawCycleLabels(Image &image,
             }
         }
 
+        // Skip labels outside of the image (tile).
+        const Int xCell = structure.getCellPosition(i, 0, QUANTUM).x0;
+        if (!image.isVisible(xCell, xCell + cellWidth)) {
+            continue;
+        }
+
         Dimensions textDimensions = calculateTextDimensions(cycleLabel, layout.cycles.labels.getFontHeight());
 
         const Int xGap = (cellWidth - textDimensions.width) / 2;
@@ -1408,6 +1528,7 @@ void drawCycleEdges(Image &image,
         if (circuitData.isCycleCut(i) && circuitData.isCycleCut(i - 1)) continue;
 
         const Int xCycle = structure.getCellPosition(i, 0, QUANTUM).x0;
+        if (!image.isVisible(xCycle, xCycle)) continue;
         const Int y0 = structure.getCircuitTopY();
         const Int y1 = structure.getCircuitBotY();
 
@@ -1688,6 +1809,15 @@ void drawCycle(Image &image,
         // Draw each of the gates in the current chunk.
         for (const GateProperties &gate : cycle.gates[chunkIndex])
         {
+            // Skip gates that lie entirely outside of the image, which happens
+            // when the circuit is drawn in tiles.
+            const Int gateDurationInCycles = (!layout.cycles.areCompressed() && layout.gateDurationOutlines.areEnabled())
+                ? max(gate.duration / circuitData.cycleDuration, (Int) 1) : 1;
+            const Int columnEnd = min(gate.cycle + gateDurationInCycles, circuitData.getAmountOfCycles()) - 1;
+            if (!image.isVisible(structure.getCellPosition(gate.cycle, 0, QUANTUM).x0, structure.getCellPosition(columnEnd, 0, QUANTUM).x1)) {
+                continue;
+            }
+
             drawGate(image, layout, circuitData, gate, structure, chunkOffset);
         }
     }
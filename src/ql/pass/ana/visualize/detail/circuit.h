@@ -158,6 +158,9 @@ struct ImageOutput {
 
 void visualizeCircuit(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration);
 ImageOutput generateImage(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration, const utils::Vec<utils::Int> &minCycleWidths, utils::Int extendedImageHeight);
+void generateTiles(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration);
+void drawCircuit(Image &image, const CircuitLayout &layout, const CircuitData &circuitData, const Structure &structure, const utils::Vec<QubitLines> &linesPerQubit);
+void drawCircuitParallel(Image &image, const CircuitLayout &layout, const CircuitData &circuitData, const Structure &structure, const utils::Vec<QubitLines> &linesPerQubit, utils::UInt numThreads);
 
 CircuitLayout parseCircuitConfiguration(utils::Vec<GateProperties> &gates, const utils::Str &configPath, const utils::Json &platformInstructions);
 void validateCircuitLayout(CircuitLayout &layout, const utils::Str &visualizationType);
@@ -6,10 +6,17 @@
 
 #include "image.h"
 
+#include <mutex>
 #include "CImg.h"
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/map.h"
+#include "ql/utils/exception.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/logger.h"
 #include "types.h"
+#include "svg.h"
 
 namespace ql {
 namespace pass {
@@ -19,68 +26,165 @@ namespace detail {
 
 using namespace utils;
 
-Image::Image(const Int imageWidth, const Int imageHeight) : cimg((int) imageWidth, (int) imageHeight, 1, 3) {
-    // empty
+Image::Image(const Int imageWidth, const Int imageHeight, const Int originX, const ImageFormat format) :
+    format(format),
+    width(imageWidth),
+    height(imageHeight),
+    originX(originX)
+{
+    if (format == ImageFormat::SVG) {
+        svg.emplace(imageWidth, imageHeight);
+    } else {
+        cimg.emplace((int) imageWidth, (int) imageHeight, 1, 3);
+    }
+}
+
+ImageFormat Image::getFormat() const {
+    return format;
+}
+
+Int Image::getWidth() const {
+    return width;
+}
+
+Int Image::getOriginX() const {
+    return originX;
+}
+
+Bool Image::isVisible(const Int x0, const Int x1) const {
+    return x1 >= originX && x0 < originX + width;
 }
 
 void Image::fill(const Color color) {
+    if (format == ImageFormat::SVG) {
+        svg->drawRectangle(0, 0, width - 1, height - 1, color, 1.0, true, false);
+        return;
+    }
     cimg->fill(255);
-    drawFilledRectangle(0, 0, cimg->width(), cimg->height(), color, 1.0f);
+    cimg->draw_rectangle(0, 0, cimg->width(), cimg->height(), color.data(), 1.0f);
 }
 
 void Image::drawLine(const Int x0, const Int y0, const Int x1, const Int y1, const Color color, const Real alpha, const LinePattern pattern) {
-    cimg->draw_line((int) x0, (int) y0, (int) x1, (int) y1, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
+    if (format == ImageFormat::SVG) {
+        svg->drawLine(x0 - originX, y0, x1 - originX, y1, color, alpha, pattern == LinePattern::DASHED);
+        return;
+    }
+    cimg->draw_line((int) (x0 - originX), (int) y0, (int) (x1 - originX), (int) y1, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
 }
 
 void Image::drawText(const Int x, const Int y, const Str &text, const Int height, const Color color) {
-    cimg->draw_text((int) x, (int) y, text.c_str(), color.data(), 0, 1, (int) height);
+    if (format == ImageFormat::SVG) {
+        svg->drawText(x - originX, y, text, height, color);
+        return;
+    }
+    cimg->draw_text((int) (x - originX), (int) y, text.c_str(), color.data(), 0, 1, (int) height);
 }
 
 void Image::drawFilledCircle(const Int centerX, const Int centerY, const Int radius,
                              const Color color, const Real alpha) {
-    cimg->draw_circle((int) centerX, (int) centerY, (int) radius, color.data(), (float) alpha);
+    if (format == ImageFormat::SVG) {
+        svg->drawCircle(centerX - originX, centerY, radius, color, alpha, true, false);
+        return;
+    }
+    cimg->draw_circle((int) (centerX - originX), (int) centerY, (int) radius, color.data(), (float) alpha);
 }
 
 void Image::drawOutlinedCircle(const Int centerX, const Int centerY, const Int radius,
                                const Color color, const Real alpha, const LinePattern pattern) {
-    cimg->draw_circle((int) centerX, (int) centerY, (int) radius, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
+    if (format == ImageFormat::SVG) {
+        svg->drawCircle(centerX - originX, centerY, radius, color, alpha, false, pattern == LinePattern::DASHED);
+        return;
+    }
+    cimg->draw_circle((int) (centerX - originX), (int) centerY, (int) radius, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
 }
 
 void Image::drawFilledTriangle(const Int x0, const Int y0, const Int x1, const Int y1, const Int x2, const Int y2,
                                const Color color, const Real alpha) {
-    cimg->draw_triangle((int) x0, (int) y0, (int) x1, (int) y1, (int) x2, (int) y2, color.data(), (float) alpha);
+    if (format == ImageFormat::SVG) {
+        svg->drawTriangle(x0 - originX, y0, x1 - originX, y1, x2 - originX, y2, color, alpha, true, false);
+        return;
+    }
+    cimg->draw_triangle((int) (x0 - originX), (int) y0, (int) (x1 - originX), (int) y1, (int) (x2 - originX), (int) y2, color.data(), (float) alpha);
 }
 
 void Image::drawOutlinedTriangle(const Int x0, const Int y0, const Int x1, const Int y1, const Int x2, const Int y2,
                                  const Color color, const Real alpha, const LinePattern pattern) {
-    cimg->draw_triangle((int) x0, (int) y0, (int) x1, (int) y1, (int) x2, (int) y2, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
+    if (format == ImageFormat::SVG) {
+        svg->drawTriangle(x0 - originX, y0, x1 - originX, y1, x2 - originX, y2, color, alpha, false, pattern == LinePattern::DASHED);
+        return;
+    }
+    cimg->draw_triangle((int) (x0 - originX), (int) y0, (int) (x1 - originX), (int) y1, (int) (x2 - originX), (int) y2, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
 }
 
 void Image::drawFilledRectangle(const Int x0, const Int y0, const Int x1, const Int y1,
                                 const Color color, const Real alpha) {
-    cimg->draw_rectangle((int) x0, (int) y0, (int) x1, (int) y1, color.data(), (float) alpha);
+    if (format == ImageFormat::SVG) {
+        svg->drawRectangle(x0 - originX, y0, x1 - originX, y1, color, alpha, true, false);
+        return;
+    }
+    cimg->draw_rectangle((int) (x0 - originX), (int) y0, (int) (x1 - originX), (int) y1, color.data(), (float) alpha);
 }
 
 void Image::drawOutlinedRectangle(const Int x0, const Int y0, const Int x1, const Int y1,
                                   const Color color, const Real alpha, const LinePattern pattern) {
-    cimg->draw_rectangle((int) x0, (int) y0, (int) x1, (int) y1, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
+    if (format == ImageFormat::SVG) {
+        svg->drawRectangle(x0 - originX, y0, x1 - originX, y1, color, alpha, false, pattern == LinePattern::DASHED);
+        return;
+    }
+    cimg->draw_rectangle((int) (x0 - originX), (int) y0, (int) (x1 - originX), (int) y1, color.data(), (float) alpha, static_cast<unsigned int>(pattern));
+}
+
+void Image::drawImage(const Image &image) {
+    if (format != ImageFormat::BITMAP || image.format != ImageFormat::BITMAP) {
+        QL_ICE("drawing images into other images is only supported for bitmaps");
+    }
+    cimg->draw_image((int) (image.originX - originX), 0, *image.cimg);
 }
 
 void Image::save(const Str &filename) {
+    if (format == ImageFormat::SVG) {
+        OutFile(filename).write(svg->str());
+        return;
+    }
     cimg->save(static_cast<std::string>(filename).c_str());
 }
 
 void Image::display(const Str &caption) {
+    if (format == ImageFormat::SVG) {
+        QL_WOUT("Cannot display SVG images interactively, skipping display of '" << caption << "'");
+        return;
+    }
     cimg->display(static_cast<std::string>(caption).c_str());
 }
 
+Str getFileExtension(const ImageFormat format) {
+    switch (format) {
+        case ImageFormat::SVG:  return ".svg";
+        default:                return ".bmp";
+    }
+}
+
 Dimensions calculateTextDimensions(const Str &text, const Int fontHeight) {
+    static std::mutex mutex;
+    static Map<Pair<Str, Int>, Dimensions> cache;
+    const Pair<Str, Int> key{text, fontHeight};
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
+    }
+
     const char* chars = text.c_str();
     cimg_library::CImg<unsigned char> imageTextDimensions;
     const char color = 1;
     imageTextDimensions.draw_text(0, 0, chars, &color, 0, 1, (int) fontHeight);
+    const Dimensions dimensions { imageTextDimensions.width(), imageTextDimensions.height() };
 
-    return Dimensions { imageTextDimensions.width(), imageTextDimensions.height() };
+    std::lock_guard<std::mutex> lock{mutex};
+    cache.emplace(key, dimensions);
+    return dimensions;
 }
 
 } // namespace detail
@@ -37,12 +37,32 @@ enum class LinePattern : unsigned int {
     DASHED = 0xF0F0F0F0
 };
 
+class SvgCanvas;
+
 class Image {
 private:
+    ImageFormat format;
+    utils::Int width;
+    utils::Int height;
+
+    // Only one of these is used, depending on the format.
     utils::Ptr<cimg_library::CImg<unsigned char>> cimg;
+    utils::Ptr<SvgCanvas> svg;
+
+    // X coordinate of the leftmost column of this image. All drawing
+    // coordinates are relative to the full circuit, so a tile of a larger
+    // image can be drawn by setting this to the left edge of the tile; drawing
+    // outside of the tile is clipped.
+    utils::Int originX = 0;
 
 public:
-    Image(const utils::Int imageWidth, const utils::Int imageHeight);
+    Image(const utils::Int imageWidth, const utils::Int imageHeight, const utils::Int originX = 0,
+          const ImageFormat format = ImageFormat::BITMAP);
+
+    ImageFormat getFormat() const;
+    utils::Int getWidth() const;
+    utils::Int getOriginX() const;
+    utils::Bool isVisible(const utils::Int x0, const utils::Int x1) const;
 
     void fill(const Color color);
 
@@ -67,10 +87,21 @@ public:
     void drawOutlinedRectangle(const utils::Int x0, const utils::Int y0, const utils::Int x1, const utils::Int y1,
                                const Color color = black, const utils::Real alpha = 1, const LinePattern pattern = LinePattern::UNBROKEN);
     
+    // Copies the given image into this one, at the position given by the
+    // origin of the given image relative to the origin of this image. Only
+    // supported for bitmaps.
+    void drawImage(const Image &image);
+
     void save(const utils::Str &filename);
     void display(const utils::Str &caption);
 };
 
+// Returns the file extension (including the period) for the given format.
+utils::Str getFileExtension(const ImageFormat format);
+
+// Returns the dimensions of the given text when drawn with the given font
+// height. The results are cached per unique text and font height, as the same
+// labels are measured over and over again. This function is thread-safe.
 Dimensions calculateTextDimensions(const utils::Str &text, const utils::Int fontHeight);
 
 } // namespace detail
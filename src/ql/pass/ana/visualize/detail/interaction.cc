@@ -6,10 +6,12 @@
 
 #include "interaction.h"
 
-#include <fstream>
 #include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/com/ana/interaction_matrix.h"
 #include "common.h"
 #include "image.h"
+#include "mapping.h"
 
 namespace ql {
 namespace pass {
@@ -42,41 +44,63 @@ void visualizeInteractionGraph(const ir::compat::ProgramRef &program, const Visu
 
     if (qubits.size() > 1) {
 
-        // Calculate the interaction circle properties.
-        const Real thetaSpacing = 2 * M_PI / amountOfQubits;
-        const Int interactionCircleRadius = max(layout.getMinInteractionCircleRadius(),
-            (Int) (layout.getInteractionCircleRadiusModifier() * calculateQubitCircleRadius(layout.getQubitRadius(), thetaSpacing)));
-        const Position2 center{layout.getBorderWidth() + interactionCircleRadius, layout.getBorderWidth() + interactionCircleRadius};
+        // Calculate the qubit positions. These are taken from the topology
+        // section of the platform if enabled and available, which scales
+        // better to large qubit counts; otherwise the qubits are placed on a
+        // circle.
+        Vec<Position2> qubitPositions(amountOfQubits, { 0, 0 });
+        Int imageWidth = 0;
+        Int imageHeight = 0;
+        Topology topology;
+        const Bool parsedTopology = layout.getUseTopology()
+            && parseTopology(program->platform, topology)
+            && (Int) topology.vertices.size() >= amountOfQubits;
+        if (parsedTopology) {
+            const Int pitch = 4 * layout.getQubitRadius();
+            const Int offset = layout.getBorderWidth() + layout.getQubitRadius();
+            for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
+                const Position2 &vertex = topology.vertices[qubitIndex];
+                // Flip the y-axis, like the mapping graph does.
+                qubitPositions[qubitIndex] = {offset + vertex.x * pitch, offset + (topology.ySize - 1 - vertex.y) * pitch};
+            }
+            imageWidth = 2 * offset + (topology.xSize - 1) * pitch;
+            imageHeight = 2 * offset + (topology.ySize - 1) * pitch;
+        } else {
+            if (layout.getUseTopology()) {
+                QL_WOUT("Could not parse qubit topology. Placing qubits on a circle instead.");
+            }
 
-        // Calculate the qubit coordinates on the interaction circle.
-        Vec<Pair<Qubit, Position2>> qubitPositions;
-        for (const Qubit &qubit : qubits) {
-            const Real theta = qubit.qubitIndex * thetaSpacing;
-            const Position2 position = calculatePositionOnCircle(interactionCircleRadius, theta, center);
-            qubitPositions.push_back( {qubit, position} );
+            // Calculate the interaction circle properties.
+            const Real thetaSpacing = 2 * M_PI / amountOfQubits;
+            const Int interactionCircleRadius = max(layout.getMinInteractionCircleRadius(),
+                (Int) (layout.getInteractionCircleRadiusModifier() * calculateQubitCircleRadius(layout.getQubitRadius(), thetaSpacing)));
+            const Position2 center{layout.getBorderWidth() + interactionCircleRadius, layout.getBorderWidth() + interactionCircleRadius};
+
+            // Calculate the qubit coordinates on the interaction circle.
+            for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
+                const Real theta = qubitIndex * thetaSpacing;
+                qubitPositions[qubitIndex] = calculatePositionOnCircle(interactionCircleRadius, theta, center);
+            }
+            imageWidth = 2 * (layout.getBorderWidth() + interactionCircleRadius);
+            imageHeight = 2 * (layout.getBorderWidth() + interactionCircleRadius);
         }
 
         // Initialize the image.
         QL_DOUT("Initializing image...");
-        const Int imageWidth = 2 * (layout.getBorderWidth() + interactionCircleRadius);
-        const Int imageHeight = 2 * (layout.getBorderWidth() + interactionCircleRadius);
         Image image(imageWidth, imageHeight);
         image.fill(white);
 
-        // Draw the edges between interacting qubits.
-        Vec<Pair<Int, Int>> drawnEdges;
-        // std::vector<std::pair<int, int>> drawnEdges;
-        for (const Pair<Qubit, Position2> &qubit : qubitPositions) {
-            const Position2 qubitPosition = qubit.second;
-            for (const InteractionsWithQubit &interactionsWithQubit : qubit.first.interactions) {
-                if (isEdgeAlreadyDrawn(drawnEdges, qubit.first.qubitIndex, interactionsWithQubit.qubitIndex))
+        // Draw the edges between interacting qubits. The interactions are
+        // symmetric, so each edge is drawn from the qubit with the lowest
+        // index only.
+        for (const Qubit &qubit : qubits) {
+            const Position2 qubitPosition = qubitPositions[qubit.qubitIndex];
+            for (const InteractionsWithQubit &interactionsWithQubit : qubit.interactions) {
+                if (interactionsWithQubit.qubitIndex <= qubit.qubitIndex)
                     continue;
-                
-                drawnEdges.push_back( {qubit.first.qubitIndex, interactionsWithQubit.qubitIndex } );
 
                 // Draw the edge.
-                const Real theta = interactionsWithQubit.qubitIndex * thetaSpacing;
-                const Position2 interactionPosition = calculatePositionOnCircle(interactionCircleRadius, theta, center);
+                const Position2 interactionPosition = qubitPositions[interactionsWithQubit.qubitIndex];
                 image.drawLine(qubitPosition.x, qubitPosition.y, interactionPosition.x, interactionPosition.y, layout.getEdgeColor());
 
                 // Calculate label dimensions.
@@ -97,16 +121,17 @@ void visualizeInteractionGraph(const ir::compat::ProgramRef &program, const Visu
             }
         }
         // Draw the qubits.
-        for (const Pair<Qubit, Position2> &qubit : qubitPositions) {
+        for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
+            const Position2 &position = qubitPositions[qubitIndex];
             // Draw the circle outline.
-            image.drawFilledCircle(qubit.second.x, qubit.second.y, layout.getQubitRadius(), layout.getCircleFillColor(), 1);
-            image.drawOutlinedCircle(qubit.second.x, qubit.second.y, layout.getQubitRadius(), layout.getCircleOutlineColor(), 1, LinePattern::UNBROKEN);
+            image.drawFilledCircle(position.x, position.y, layout.getQubitRadius(), layout.getCircleFillColor(), 1);
+            image.drawOutlinedCircle(position.x, position.y, layout.getQubitRadius(), layout.getCircleOutlineColor(), 1, LinePattern::UNBROKEN);
             // Draw the qubit label.
-            const Str label = to_string(qubit.first.qubitIndex);
+            const Str label = to_string(qubitIndex);
             const Dimensions labelDimensions = calculateTextDimensions(label, layout.getLabelFontHeight());
             const Int xGap = (2 * layout.getQubitRadius() - labelDimensions.width) / 2;
             const Int yGap = (2 * layout.getQubitRadius() - labelDimensions.height) / 2;
-            image.drawText(qubit.second.x - layout.getQubitRadius() + xGap, qubit.second.y - layout.getQubitRadius() + yGap, label, layout.getLabelFontHeight(), layout.getLabelColor());
+            image.drawText(position.x - layout.getQubitRadius() + xGap, position.y - layout.getQubitRadius() + yGap, label, layout.getLabelFontHeight(), layout.getLabelColor());
         }
 
         // Save the image if enabled.
@@ -132,17 +157,16 @@ void generateAndSaveDOTFile(const Str &output_prefix, const Vec<Qubit> &qubits)
     {
         QL_IOUT("Generating DOT file for qubit interaction graph...");
 
-        std::ofstream output(output_prefix + ".dot");
+        OutFile output(output_prefix + ".dot");
         output << "graph qubit_interaction_graph {\n";
         output << "    node [shape=circle];\n";
 
-        Vec<Pair<Int, Int>> drawnEdges;
-        // std::vector<std::pair<int, int>> drawnEdges;
+        // The interactions are symmetric, so each edge is only written for
+        // the qubit with the lowest index.
         for (const Qubit &qubit : qubits) {
             for (const InteractionsWithQubit &target : qubit.interactions) {
-                if (isEdgeAlreadyDrawn(drawnEdges, qubit.qubitIndex, target.qubitIndex))
+                if (target.qubitIndex <= qubit.qubitIndex)
                     continue;
-                drawnEdges.push_back( {qubit.qubitIndex, target.qubitIndex } );
 
                 output << "    " << qubit.qubitIndex << " -- " << target.qubitIndex << " [label=" << target.amountOfInteractions << "];\n";
             }
@@ -186,6 +210,7 @@ InteractionGraphLayout parseInteractionGraphLayout(const Str &configPath) {
 
     // Load the parameters.
     if (config.count("outputDotFile") == 1)     layout.enableDotFileOutput(config["outputDotFile"]);
+    if (config.count("useTopology") == 1)       layout.setUseTopology(config["useTopology"]);
 
     if (config.count("borderWidth") == 1)                       layout.setBorderWidth(config["borderWidth"]);
     if (config.count("minInteractionCircleRadius") == 1)        layout.setMinInteractionCircleRadius(config["minInteractionCircleRadius"]);
@@ -229,15 +254,9 @@ Position2 calculatePositionOnCircle(const Int radius, const Real theta, const Po
 }
 
 Vec<Qubit> findQubitInteractions(const Vec<GateProperties> &gates, const Int amountOfQubits) {
-    // Initialize the qubit vector.
-    Vec<Qubit> qubits(amountOfQubits);
-    for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
-        Qubit qubit;
-        qubit.qubitIndex = qubitIndex;
-        // qubits[qubitIndex] = {qubitIndex, {}};
-        qubits[qubitIndex] = qubit;
-    }
-
+    // Gather the interacting qubit pairs of all multi-qubit gates, such that
+    // they can be counted using a sparse interaction matrix.
+    Vec<Pair<UInt, UInt>> interactions;
     for (const GateProperties &gate : gates) {
         const Vec<GateOperand> operands = getGateOperands(gate);
         if (operands.size() > 1) {
@@ -254,37 +273,25 @@ Vec<Qubit> findQubitInteractions(const Vec<GateProperties> &gates, const Int amo
                 for (UInt j = 0; j < qubitIndices.size(); j++) {
                     // Do not add an interaction between a qubit and itself.
                     if (i != j) {
-                        Vec<InteractionsWithQubit> &interactions = qubits[qubitIndices[i]].interactions;
-                        // Find the existing interaction count with the current qubit if it exists.
-                        Bool found = false;
-                        for (InteractionsWithQubit &interactionsWithQubit : interactions) {
-                            if (interactionsWithQubit.qubitIndex == qubitIndices[j]) {
-                                found = true;
-                                interactionsWithQubit.amountOfInteractions++;
-                            }
-                        }
-                        // If the interaction count does not yet exist, add a new one.
-                        if (!found) {
-                            interactions.push_back( {qubitIndices[j], 1} );
-                        }
+                        interactions.emplace_back(qubitIndices[i], qubitIndices[j]);
                     }
                 }
             }
         }
     }
+    const com::ana::InteractionMatrix matrix(amountOfQubits, interactions);
 
-    return qubits;
-}
-
-Bool isEdgeAlreadyDrawn(const Vec<Pair<Int, Int>> &drawnEdges, const Int first, const Int second) {
-    // Check if the edge already exists.
-    for (const Pair<Int, Int> &drawnEdge : drawnEdges) {
-        if ((drawnEdge.first == first && drawnEdge.second == second) || (drawnEdge.first == second && drawnEdge.second == first)) {
-            return true;
+    // Initialize the qubit vector from the rows of the matrix.
+    Vec<Qubit> qubits(amountOfQubits);
+    for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
+        Qubit &qubit = qubits[qubitIndex];
+        qubit.qubitIndex = qubitIndex;
+        for (const auto &entry : matrix.get_row(qubitIndex)) {
+            qubit.interactions.push_back( {(Int) entry.qubit, (Int) entry.count} );
         }
     }
 
-    return false;
+    return qubits;
 }
 
 void printInteractionList(const Vec<Qubit> &qubits) {
@@ -40,9 +40,6 @@ utils::Real calculateQubitCircleRadius(utils::Int qubitRadius, const utils::Real
 Position2 calculatePositionOnCircle(utils::Int radius, utils::Real theta, const Position2 &center);
 utils::Vec<Qubit> findQubitInteractions(const utils::Vec<GateProperties> &gates, utils::Int amountOfQubits);
 
-// bool isEdgeAlreadyDrawn(const std::vector<std::pair<int, int>> &drawnEdges, const int first, const int second);
-utils::Bool isEdgeAlreadyDrawn(const utils::Vec<utils::Pair<utils::Int, utils::Int>> &drawnEdges, utils::Int first, utils::Int second);
-
 void printInteractionList(const utils::Vec<Qubit> &qubits);
 
 } // namespace detail
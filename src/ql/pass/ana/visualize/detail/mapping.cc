@@ -6,6 +6,8 @@
 
 #include "mapping.h"
 
+#include <algorithm>
+
 #include "common.h"
 #include "image.h"
 #include "circuit.h"
@@ -72,14 +74,17 @@ void visualizeMappingGraph(const ir::compat::ProgramRef &program, const Visualiz
         }
     }
 
-    // This vector stores the qubit mapping per cycle.
-    Vec<Vec<Int>> virtualQubits(amountOfCycles);
+    // The qubit mapping is stored as the mapping for the first cycle and a log of the changes made to it in later
+    // cycles, ordered by cycle, rather than as a full mapping per cycle, to keep memory usage proportional to the
+    // number of changes. The mapping for a cycle is reconstructed by replaying the changes up to and including it.
+    Vec<Int> virtualQubits;
+    Vec<MappingChange> mappingChanges;
 
     // This vector stores whether the mapping has changed for each cycle compared to the previous cycle.
     Vec<Bool> mappingChangedPerCycle(amountOfCycles, false);
 
     // Compute the mappings for each cycle.
-    computeMappingPerCycle(layout, virtualQubits, mappingChangedPerCycle, gates, amountOfCycles, amountOfQubits);
+    computeMappingPerCycle(layout, virtualQubits, mappingChanges, mappingChangedPerCycle, gates, amountOfCycles, amountOfQubits);
     
     // Compute the minimum cycle widths for each cycle.
     Vec<Int> minCycleWidths(amountOfCycles, 0);
@@ -111,7 +116,15 @@ void visualizeMappingGraph(const ir::compat::ProgramRef &program, const Visualiz
     //const Int yEnd = imageOutput.structure.getImageHeight();
 
     // Draw the mapping for each cycle.
+    UInt nextMappingChange = 0;
     for (Int cycleIndex = 0; cycleIndex < amountOfCycles; cycleIndex++) {
+        // Bring the mapping up to date for this cycle.
+        while (nextMappingChange < mappingChanges.size() && mappingChanges[nextMappingChange].cycle <= cycleIndex) {
+            const MappingChange &change = mappingChanges[nextMappingChange];
+            virtualQubits[change.realQubit] = change.virtualQubit;
+            nextMappingChange++;
+        }
+
         // Skip cycles for which the mapping has not changed.
         if (!mappingChangedPerCycle[cycleIndex]) {
             continue;
@@ -146,7 +159,7 @@ void visualizeMappingGraph(const ir::compat::ProgramRef &program, const Visualiz
         // Draw each of the qubit mappings in this cycle.
         for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
             const Position2 position = qubitPositions[qubitIndex];
-            const Int virtualOperand = virtualQubits[cycleIndex][qubitIndex];
+            const Int virtualOperand = virtualQubits[qubitIndex];
 
             // Draw qubit circle.
             const Color virtualColor = virtualOperand != -1 ? virtualColors[virtualOperand] : layout.getQubitFillColor();
@@ -178,7 +191,7 @@ void visualizeMappingGraph(const ir::compat::ProgramRef &program, const Visualiz
 
     // Save the image if enabled.
     if (imageOutput.circuitLayout.saveImage || !configuration.interactive) {
-        imageOutput.image.save(configuration.output_prefix + ".bmp");
+        imageOutput.image.save(configuration.output_prefix + getFileExtension(configuration.imageFormat));
     }
 
     // Display the image if enabled.
@@ -188,15 +201,18 @@ void visualizeMappingGraph(const ir::compat::ProgramRef &program, const Visualiz
 }
 
 void computeMappingPerCycle(const MappingGraphLayout &layout,
-                            Vec<Vec<Int>> &virtualQubits,
+                            Vec<Int> &virtualQubits,
+                            Vec<MappingChange> &mappingChanges,
                             Vec<Bool> &mappingChangedPerCycle,
                             const Vec<GateProperties> &gates,
                             Int amountOfCycles,
                             Int amountOfQubits) {
     // Initialize the first cycle with a virtual index = real index mapping.
+    virtualQubits.clear();
+    mappingChanges.clear();
     for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
         const Int virtualIndex = layout.getInitDefaultVirtuals() ? qubitIndex : -1;
-        virtualQubits[0].push_back(virtualIndex);
+        virtualQubits.push_back(virtualIndex);
         mappingChangedPerCycle[0] = true; // the mapping has changed for the first cycle always!
     }
 
@@ -244,21 +260,32 @@ void computeMappingPerCycle(const MappingGraphLayout &layout,
         }
     }
 
-    // Fill the cycles with qubit mappings.
+    // Order the gates by cycle, such that each cycle only needs to look at its own gates.
+    Vec<UInt> gatesByCycle(gates.size());
+    for (UInt gateIndex = 0; gateIndex < gates.size(); gateIndex++) {
+        gatesByCycle[gateIndex] = gateIndex;
+    }
+    std::stable_sort(gatesByCycle.begin(), gatesByCycle.end(), [&gates](UInt a, UInt b) {
+        return gates[a].cycle < gates[b].cycle;
+    });
+
+    // Log the changes to the mapping for each cycle, keeping track of the current mapping as we go. Gates in the
+    // first cycle do not affect the mapping.
+    Vec<Int> currentVirtualQubits = virtualQubits;
+    UInt nextGate = 0;
+    while (nextGate < gatesByCycle.size() && gates[gatesByCycle[nextGate]].cycle < 1) {
+        nextGate++;
+    }
     for (Int cycleIndex = 1; cycleIndex < amountOfCycles; cycleIndex++) {
-        // Copy virtual qubit operand from the previous cycle of the same qubit.
-        for (Int qubitIndex = 0; qubitIndex < amountOfQubits; qubitIndex++) {
-            virtualQubits[cycleIndex].push_back(virtualQubits[cycleIndex - 1][qubitIndex]);
-        }
-        for (const GateProperties &gate : gates) {
-            if (gate.cycle == cycleIndex) {
-                for (UInt qubitIndex = 0; qubitIndex < gate.operands.size(); qubitIndex++) {
-                    const Int mappingIndex = gate.operands[qubitIndex];
-                    const Int mappingIndexFromPreviousCycle = virtualQubits[cycleIndex - 1][mappingIndex];
-                    if (mappingIndexFromPreviousCycle == -1) {
-                        virtualQubits[cycleIndex][mappingIndex] = mappingIndex;
-                        mappingChangedPerCycle[cycleIndex] = true;
-                    }
+        // Qubits that are used for the first time in this cycle map to the virtual qubit with the same index.
+        for (; nextGate < gatesByCycle.size() && gates[gatesByCycle[nextGate]].cycle == cycleIndex; nextGate++) {
+            const GateProperties &gate = gates[gatesByCycle[nextGate]];
+            for (UInt qubitIndex = 0; qubitIndex < gate.operands.size(); qubitIndex++) {
+                const Int mappingIndex = gate.operands[qubitIndex];
+                if (currentVirtualQubits[mappingIndex] == -1) {
+                    currentVirtualQubits[mappingIndex] = mappingIndex;
+                    mappingChanges.push_back({cycleIndex, mappingIndex, mappingIndex});
+                    mappingChangedPerCycle[cycleIndex] = true;
                 }
             }
         }
@@ -269,8 +296,10 @@ void computeMappingPerCycle(const MappingGraphLayout &layout,
         if (swapInCycle) {
             const Int r0 = swaps[cycleIndex].r0;
             const Int r1 = swaps[cycleIndex].r1;
-            virtualQubits[cycleIndex][r0] = v0;
-            virtualQubits[cycleIndex][r1] = v1;
+            currentVirtualQubits[r0] = v0;
+            currentVirtualQubits[r1] = v1;
+            mappingChanges.push_back({cycleIndex, r0, v0});
+            mappingChanges.push_back({cycleIndex, r1, v1});
         }
     }
 }
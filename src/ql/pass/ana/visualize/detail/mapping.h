@@ -31,10 +31,20 @@ struct Topology {
     utils::Vec<Edge> edges;
 };
 
+/**
+ * A change to the virtual qubit mapped to a real qubit, taking effect in the given cycle.
+ */
+struct MappingChange {
+    utils::Int cycle;
+    utils::Int realQubit;
+    utils::Int virtualQubit;
+};
+
 void visualizeMappingGraph(const ir::compat::ProgramRef &program, const VisualizerConfiguration &configuration);
 
 void computeMappingPerCycle(const MappingGraphLayout &layout,
-                            utils::Vec<utils::Vec<utils::Int>> &virtualQubits,
+                            utils::Vec<utils::Int> &virtualQubits,
+                            utils::Vec<MappingChange> &mappingChanges,
                             utils::Vec<utils::Bool> &mappingChangedPerCycle,
                             const utils::Vec<GateProperties> &gates,
                             utils::Int amountOfCycles,
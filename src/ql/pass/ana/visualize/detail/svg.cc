@@ -0,0 +1,130 @@
+/** \file
+ * Minimal SVG writer used as a vector backend for the visualizer images.
+ */
+
+#ifdef WITH_VISUALIZER
+
+#include "svg.h"
+
+namespace ql {
+namespace pass {
+namespace ana {
+namespace visualize {
+namespace detail {
+
+using namespace utils;
+
+// Formats a color as an SVG color value.
+static Str svgColor(const Color &color) {
+    return "rgb(" + to_string((Int) color[0]) + "," + to_string((Int) color[1]) + "," + to_string((Int) color[2]) + ")";
+}
+
+// Escapes the XML special characters in the given text.
+static Str svgEscape(const Str &text) {
+    Str escaped;
+    for (const char c : text) {
+        switch (c) {
+            case '&': escaped += "&amp;"; break;
+            case '<': escaped += "&lt;"; break;
+            case '>': escaped += "&gt;"; break;
+            case '"': escaped += "&quot;"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+// Returns the stroke/fill attributes for a shape.
+static Str svgPaint(const Color &color, const Real alpha, const Bool filled, const Bool dashed) {
+    StrStrm ss;
+    if (filled) {
+        ss << " fill=\"" << svgColor(color) << "\"";
+        if (alpha < 1.0) ss << " fill-opacity=\"" << alpha << "\"";
+    } else {
+        ss << " fill=\"none\" stroke=\"" << svgColor(color) << "\"";
+        if (alpha < 1.0) ss << " stroke-opacity=\"" << alpha << "\"";
+        // LinePattern::DASHED is four pixels on, four pixels off.
+        if (dashed) ss << " stroke-dasharray=\"4,4\"";
+    }
+    return ss.str();
+}
+
+SvgCanvas::SvgCanvas(const Int width, const Int height) : width(width), height(height) {
+    // empty
+}
+
+UInt SvgCanvas::getTextId(const Str &text, const Int fontHeight) {
+    const Pair<Str, Int> key{text, fontHeight};
+    auto it = textIds.find(key);
+    if (it != textIds.end()) {
+        return it->second;
+    }
+    const UInt id = textIds.size();
+    textIds.emplace(key, id);
+    defs << "<text id=\"t" << id << "\" font-size=\"" << fontHeight
+         << "\" dominant-baseline=\"hanging\">" << svgEscape(text) << "</text>\n";
+    return id;
+}
+
+UInt SvgCanvas::getCircleId(const Int radius) {
+    auto it = circleIds.find(radius);
+    if (it != circleIds.end()) {
+        return it->second;
+    }
+    const UInt id = circleIds.size();
+    circleIds.emplace(radius, id);
+    defs << "<circle id=\"c" << id << "\" r=\"" << radius << "\"/>\n";
+    return id;
+}
+
+void SvgCanvas::drawLine(const Int x0, const Int y0, const Int x1, const Int y1,
+                         const Color &color, const Real alpha, const Bool dashed) {
+    body << "<line x1=\"" << x0 << "\" y1=\"" << y0 << "\" x2=\"" << x1 << "\" y2=\"" << y1 << "\""
+         << svgPaint(color, alpha, false, dashed) << "/>\n";
+}
+
+void SvgCanvas::drawText(const Int x, const Int y, const Str &text, const Int fontHeight, const Color &color) {
+    body << "<use xlink:href=\"#t" << getTextId(text, fontHeight) << "\" x=\"" << x << "\" y=\"" << y << "\""
+         << svgPaint(color, 1.0, true, false) << "/>\n";
+}
+
+void SvgCanvas::drawCircle(const Int centerX, const Int centerY, const Int radius,
+                           const Color &color, const Real alpha, const Bool filled, const Bool dashed) {
+    body << "<use xlink:href=\"#c" << getCircleId(radius) << "\" x=\"" << centerX << "\" y=\"" << centerY << "\""
+         << svgPaint(color, alpha, filled, dashed) << "/>\n";
+}
+
+void SvgCanvas::drawTriangle(const Int x0, const Int y0, const Int x1, const Int y1, const Int x2, const Int y2,
+                             const Color &color, const Real alpha, const Bool filled, const Bool dashed) {
+    body << "<polygon points=\"" << x0 << "," << y0 << " " << x1 << "," << y1 << " " << x2 << "," << y2 << "\""
+         << svgPaint(color, alpha, filled, dashed) << "/>\n";
+}
+
+void SvgCanvas::drawRectangle(const Int x0, const Int y0, const Int x1, const Int y1,
+                              const Color &color, const Real alpha, const Bool filled, const Bool dashed) {
+    // CImg rectangles include both corners.
+    body << "<rect x=\"" << min(x0, x1) << "\" y=\"" << min(y0, y1)
+         << "\" width=\"" << (max(x0, x1) - min(x0, x1) + 1) << "\" height=\"" << (max(y0, y1) - min(y0, y1) + 1) << "\""
+         << svgPaint(color, alpha, filled, dashed) << "/>\n";
+}
+
+Str SvgCanvas::str() const {
+    StrStrm ss;
+    ss << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+    ss << "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\""
+       << " width=\"" << width << "\" height=\"" << height << "\""
+       << " viewBox=\"0 0 " << width << " " << height << "\""
+       << " font-family=\"monospace\" shape-rendering=\"crispEdges\">\n";
+    ss << "<defs>\n" << defs.str() << "</defs>\n";
+    ss << body.str();
+    ss << "</svg>\n";
+    return ss.str();
+}
+
+} // namespace detail
+} // namespace visualize
+} // namespace ana
+} // namespace pass
+} // namespace ql
+
+#endif // WITH_VISUALIZER
@@ -0,0 +1,62 @@
+/** \file
+ * Minimal SVG writer used as a vector backend for the visualizer images.
+ */
+
+#pragma once
+
+#ifdef WITH_VISUALIZER
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/map.h"
+#include "types.h"
+
+namespace ql {
+namespace pass {
+namespace ana {
+namespace visualize {
+namespace detail {
+
+// Accumulates SVG primitives for an image of the given size. Coordinates are
+// in pixels, with the same conventions as the CImg drawing functions. Text
+// labels and circles are emitted once per unique text/font height or radius
+// in the <defs> section and instantiated with <use>, as circuits consist of
+// the same glyphs over and over again.
+class SvgCanvas {
+private:
+    const utils::Int width;
+    const utils::Int height;
+
+    utils::StrStrm defs;
+    utils::StrStrm body;
+
+    utils::Map<utils::Pair<utils::Str, utils::Int>, utils::UInt> textIds;
+    utils::Map<utils::Int, utils::UInt> circleIds;
+
+    utils::UInt getTextId(const utils::Str &text, utils::Int fontHeight);
+    utils::UInt getCircleId(utils::Int radius);
+
+public:
+    SvgCanvas(utils::Int width, utils::Int height);
+
+    void drawLine(utils::Int x0, utils::Int y0, utils::Int x1, utils::Int y1,
+                  const Color &color, utils::Real alpha, utils::Bool dashed);
+    void drawText(utils::Int x, utils::Int y, const utils::Str &text, utils::Int fontHeight, const Color &color);
+    void drawCircle(utils::Int centerX, utils::Int centerY, utils::Int radius,
+                    const Color &color, utils::Real alpha, utils::Bool filled, utils::Bool dashed);
+    void drawTriangle(utils::Int x0, utils::Int y0, utils::Int x1, utils::Int y1, utils::Int x2, utils::Int y2,
+                      const Color &color, utils::Real alpha, utils::Bool filled, utils::Bool dashed);
+    void drawRectangle(utils::Int x0, utils::Int y0, utils::Int x1, utils::Int y1,
+                       const Color &color, utils::Real alpha, utils::Bool filled, utils::Bool dashed);
+
+    utils::Str str() const;
+};
+
+} // namespace detail
+} // namespace visualize
+} // namespace ana
+} // namespace pass
+} // namespace ql
+
+#endif // WITH_VISUALIZER
@@ -21,6 +21,11 @@ namespace detail {
 void assertPositive(utils::Int parameterValue, const utils::Str &parameterName);
 void assertPositive(utils::Real parameterValue, const utils::Str &parameterName);
 
+// The output format of the images. Bitmaps are rendered through CImg; SVG
+// images are written as vector primitives, such that their size scales with
+// the number of gates rather than with the pixel area.
+enum class ImageFormat {BITMAP, SVG};
+
 struct VisualizerConfiguration {
     utils::Str visualizationType;
     utils::Str visualizerConfigPath;
@@ -28,6 +33,13 @@ struct VisualizerConfiguration {
     utils::Bool interactive;
     utils::Str output_prefix;
     utils::Str pass_name;
+    // Width in pixels of the tiles the circuit visualizer draws the circuit
+    // in, or 0 to draw a single image.
+    utils::Int tileWidth;
+    // Number of threads to draw the circuit with, or 0 to use all hardware
+    // threads.
+    utils::UInt numThreads;
+    ImageFormat imageFormat;
 };
 
 typedef std::array<utils::Byte, 3> Color;
@@ -180,6 +192,7 @@ public:
 class InteractionGraphLayout {
 private:
     utils::Bool outputDotFile = false;
+    utils::Bool useTopology = false;
     utils::Int borderWidth = 32;
     utils::Int minInteractionCircleRadius = 100;
     utils::Real interactionCircleRadiusModifier = 3.0;
@@ -194,6 +207,7 @@ public:
     utils::Bool saveImage = false;
 
     utils::Bool isDotFileOutputEnabled() const { return outputDotFile; }
+    utils::Bool getUseTopology() const { return useTopology; }
     utils::Int getBorderWidth() const { return borderWidth; }
     utils::Int getMinInteractionCircleRadius() const { return minInteractionCircleRadius; }
     utils::Real getInteractionCircleRadiusModifier() const { return interactionCircleRadiusModifier; }
@@ -205,6 +219,7 @@ public:
     Color getEdgeColor() const { return edgeColor; }
     
     void enableDotFileOutput(const utils::Bool argument) { outputDotFile = argument; }
+    void setUseTopology(const utils::Bool argument) { useTopology = argument; }
     void setBorderWidth(const utils::Int argument) { assertPositive(argument, "borderWidth"); borderWidth = argument; }
     void setMinInteractionCircleRadius(const utils::Int argument) { assertPositive(argument, "minInteractionCircleRadius"); minInteractionCircleRadius = argument; }
     void setInteractionCircleRadiusModifier(const utils::Real argument) { assertPositive(argument, "interactionCircleRadiusModifier"); interactionCircleRadiusModifier = argument; }
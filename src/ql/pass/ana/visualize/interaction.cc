@@ -64,6 +64,11 @@ void VisualizeInteractionPass::dump_docs(
           // whether a DOT file should be generated for use with graphing
           // software
           "outputDotFile": true,
+          // whether the qubits should be placed according to the qubit
+          // coordinates in the topology section of the platform rather than
+          // on a circle, which works better for large qubit counts; falls
+          // back to a circle if the topology has no coordinates
+          "useTopology": false,
           "borderWidth": 32,
           // the minimum radius of the circle on which the qubits are placed
           "minInteractionCircleRadius": 100,
@@ -86,6 +91,17 @@ utils::Str VisualizeInteractionPass::get_friendly_type() const {
     return "Qubit interaction graph visualizer";
 }
 
+/**
+ * Returns the products of the interaction graph visualizer: a window in
+ * interactive mode, or an image file otherwise.
+ */
+pmgr::Products VisualizeInteractionPass::get_products() const {
+    if (options["interactive"].as_bool()) {
+        return pmgr::product::INTERACTIVE;
+    }
+    return pmgr::product::FILES;
+}
+
 /**
  * Constructs a interaction graph visualizer pass.
  */
@@ -121,7 +137,9 @@ utils::Int VisualizeInteractionPass::run(
             "", // unused
             options["interactive"].as_bool(),
             context.output_prefix,
-            context.full_pass_name
+            context.full_pass_name,
+            0, // unused
+            1
         }
     );
     return 0;
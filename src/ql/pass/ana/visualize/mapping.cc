@@ -97,6 +97,17 @@ utils::Str VisualizeMappingPass::get_friendly_type() const {
     return "Qubit mapping graph visualizer";
 }
 
+/**
+ * Returns the products of the mapping graph visualizer: a window in interactive
+ * mode, or an image file otherwise.
+ */
+pmgr::Products VisualizeMappingPass::get_products() const {
+    if (options["interactive"].as_bool()) {
+        return pmgr::product::INTERACTIVE;
+    }
+    return pmgr::product::FILES;
+}
+
 /**
  * Constructs a mapping graph visualizer pass.
  */
@@ -132,7 +143,9 @@ utils::Int VisualizeMappingPass::run(
             "", // unused
             options["interactive"].as_bool(),
             context.output_prefix,
-            context.full_pass_name
+            context.full_pass_name,
+            0, // unused
+            1
         }
     );
     return 0;
@@ -187,12 +187,12 @@ utils::UInt DecomposeInstructionsPass::run_on_block(
     const ir::Ref &ir,
     const ir::BlockBaseRef &block,
     utils::Bool ignore_schedule,
-    const com::dec::RulePredicate &predicate
+    com::dec::DecompositionRuleTable &rules
 ) {
 
     // Apply the decomposition rules.
     auto number_of_applications = com::dec::apply_decomposition_rules(
-        ir, block, ignore_schedule, predicate
+        ir, block, ignore_schedule, rules
     );
 
     // Remove the KernelCyclesValid annotation if we broke the schedule for
@@ -205,13 +205,13 @@ utils::UInt DecomposeInstructionsPass::run_on_block(
     for (const auto &statement : block->statements) {
         if (auto if_else = statement->as_if_else()) {
             for (const auto &branch : if_else->branches) {
-                number_of_applications += run_on_block(ir, branch->body, ignore_schedule, predicate);
+                number_of_applications += run_on_block(ir, branch->body, ignore_schedule, rules);
             }
             if (!if_else->otherwise.empty()) {
-                number_of_applications += run_on_block(ir, if_else->otherwise, ignore_schedule, predicate);
+                number_of_applications += run_on_block(ir, if_else->otherwise, ignore_schedule, rules);
             }
         } else if (auto loop = statement->as_loop()) {
-            number_of_applications += run_on_block(ir, loop->body, ignore_schedule, predicate);
+            number_of_applications += run_on_block(ir, loop->body, ignore_schedule, rules);
         }
     }
 
@@ -245,12 +245,16 @@ utils::Int DecomposeInstructionsPass::run(
         return utils::pattern_match(predicate_value, value);
     };
 
+    // Look up the applicable rule for each instruction type only once for the
+    // whole program.
+    com::dec::DecompositionRuleTable rules{predicate};
+
     // Process the decomposition rules for the whole program.
     utils::UInt number_of_applications = 0;
     if (!ir->program.empty()) {
         for (const auto &block : ir->program->blocks) {
             try {
-                number_of_applications += run_on_block(ir, block, ignore_schedule, predicate);
+                number_of_applications += run_on_block(ir, block, ignore_schedule, rules);
             } catch (utils::Exception &e) {
                 e.add_context("in block " + block->name);
                 throw;
@@ -5,6 +5,7 @@
 #include "ql/pass/dec/structure/structure.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 #include "ql/com/dec/structure.h"
 #include "ql/com/cfg/build.h"
 #include "ql/com/cfg/consistency.h"
@@ -95,7 +96,7 @@ utils::Int DecomposeStructurePass::run(
     if (options["write_dot_graph"].as_bool()) {
         com::cfg::build(ir->program);
         com::cfg::check_consistency(ir->program);
-        com::cfg::dump_dot(ir, utils::OutFile(context.output_prefix + ".dot").unwrap());
+        com::cfg::dump_dot(ir, utils::AsyncOutFile(context.output_prefix + ".dot").unwrap());
         com::cfg::clear(ir->program);
     }
 
@@ -177,7 +177,13 @@ ReadCQasmPass::ReadCQasmPass(
 ) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
     options.add_str(
         "cqasm_file",
-        "cQASM file to read. Mandatory."
+        "cQASM file to read. Mandatory, unless cqasm_string is specified."
+    );
+    options.add_str(
+        "cqasm_string",
+        "cQASM code to read. When specified, this is used instead of "
+        "cqasm_file, such that no file is needed.",
+        ""
     );
     options.add_enum(
         "schedule",
@@ -230,11 +236,16 @@ utils::Int ReadCQasmPass::run(
     read_options.measure_all_target = options["measure_all_target"].as_str();
     read_options.load_platform = options["load_platform"].as_bool();
 
-    ir::cqasm::read_file(
-        ir,
-        options["cqasm_file"].as_str(),
-        read_options
-    );
+    const auto &cqasm_string = options["cqasm_string"].as_str();
+    if (!cqasm_string.empty()) {
+        ir::cqasm::read(ir, cqasm_string, "<string>", read_options);
+    } else {
+        ir::cqasm::read_file(
+            ir,
+            options["cqasm_file"].as_str(),
+            read_options
+        );
+    }
 
     return 0;
 }
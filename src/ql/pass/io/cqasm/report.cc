@@ -5,6 +5,7 @@
 #include "ql/pass/io/cqasm/report.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 #include "ql/ir/cqasm/write.h"
 #include "ql/pass/ana/statistics/report.h"
 
@@ -119,6 +120,17 @@ utils::Str ReportCQasmPass::get_friendly_type() const {
     return "cQASM writer";
 }
 
+/**
+ * Returns the products of the cQASM writer: the output file, and the statistics
+ * reported in it if enabled.
+ */
+pmgr::Products ReportCQasmPass::get_products() const {
+    if (options["with_statistics"].as_bool()) {
+        return pmgr::product::FILES | pmgr::product::STATISTICS;
+    }
+    return pmgr::product::FILES;
+}
+
 /**
  * Constructs a cQASM writer.
  */
@@ -182,6 +194,15 @@ ReportCQasmPass::ReportCQasmPass(
         "notation.",
         true
     );
+    options.add_int(
+        "block_threads",
+        "The number of threads to use for printing the blocks of the program. "
+        "The blocks are printed into separate buffers and concatenated in "
+        "order, so the output does not depend on this. 0 means use all "
+        "hardware threads.",
+        "1",
+        0
+    );
 }
 
 /**
@@ -191,7 +212,7 @@ utils::Int ReportCQasmPass::run(
     const ir::Ref &ir,
     const pmgr::pass_types::Context &context
 ) const {
-    utils::OutFile file{context.output_prefix + options["output_suffix"].as_str()};
+    utils::AsyncOutFile file{context.output_prefix + options["output_suffix"].as_str()};
 
     ir::cqasm::WriteOptions write_options;
 
@@ -223,6 +244,7 @@ utils::Int ReportCQasmPass::run(
     }
 
     write_options.include_timing = options["with_timing"].as_bool();
+    write_options.num_threads = options["block_threads"].as_uint();
 
     ir::cqasm::write(ir, write_options, file.unwrap());
 
@@ -15,7 +15,11 @@ namespace detail {
  * This should only be called after a virgin construction and not after
  * cloning a path.
  */
-void Alter::initialize(const ir::compat::KernelRef &k, const OptionsRef &opt) {
+void Alter::initialize(
+    const ir::compat::KernelRef &k,
+    const OptionsRef &opt,
+    const rmgr::Manager &rm
+) {
     QL_DOUT("Alter::initialize(number of qubits=" << k->platform->qubit_count);
     platform = k->platform;
     kernel = k;
@@ -24,7 +28,7 @@ void Alter::initialize(const ir::compat::KernelRef &k, const OptionsRef &opt) {
     nq = platform->qubit_count;
     ct = platform->cycle_time;
     // total, fromSource and fromTarget start as empty vectors
-    past.initialize(kernel, options); // initializes past to empty
+    past.initialize(kernel, options, rm); // initializes past to empty
     score_valid = false; // will not print score for now
 }
 
@@ -63,8 +67,8 @@ void Alter::print(const utils::Str &s) const {
  * Prints the state of this Alter, prefixed by s, only when the logging
  * verbosity is at least debug.
  */
-void Alter::debug_print(const utils::Str &s) const {
-    if (utils::logger::log_level >= utils::logger::LogLevel::LOG_DEBUG) {
+void Alter::debug_print(const char *s) const {
+    if (QL_IS_LOG_DEBUG) {
         print(s);
     }
 }
@@ -72,7 +76,7 @@ void Alter::debug_print(const utils::Str &s) const {
 /**
  * Prints a state of a whole list of Alters, prefixed by s.
  */
-void Alter::print(const utils::Str &s, const utils::List<Alter> &la) {
+void Alter::print(const utils::Str &s, const Alters &la) {
     utils::Int started = 0;
     for (auto &a : la) {
         if (started == 0) {
@@ -90,8 +94,8 @@ void Alter::print(const utils::Str &s, const utils::List<Alter> &la) {
  * Prints a state of a whole list of Alters, prefixed by s, only when the
  * logging verbosity is at least debug.
  */
-void Alter::debug_print(const utils::Str &s, const utils::List<Alter> &la) {
-    if (utils::logger::log_level >= utils::logger::LogLevel::LOG_DEBUG) {
+void Alter::debug_print(const char *s, const Alters &la) {
+    if (QL_IS_LOG_DEBUG) {
         print(s, la);
     }
 }
@@ -153,6 +157,31 @@ void Alter::add_swaps(Past &past, SwapSelectionMode mode) const {
     past.schedule();
 }
 
+/**
+ * Computes where the states of the real qubits along the path of this
+ * alternative end up when all its swaps are applied (as for
+ * SwapSelectionMode::ALL). For each real qubit whose state moves, moved
+ * maps the original real qubit to the real qubit that holds the state
+ * afterwards; qubits that are not in the map are not affected.
+ */
+void Alter::get_permutation(utils::Map<utils::UInt, utils::UInt> &moved) const {
+    moved.clear();
+
+    // The swaps along from_source, in order, shift the state of the source
+    // qubit to the end of the partial path, and the state of each other
+    // qubit on the path one step back toward the source. The same goes for
+    // from_target.
+    for (const auto *partial : {&from_source, &from_target}) {
+        if (partial->size() < 2) {
+            continue;
+        }
+        moved.set(partial->front()) = partial->back();
+        for (utils::UInt i = 1; i < partial->size(); i++) {
+            moved.set((*partial)[i]) = (*partial)[i - 1];
+        }
+    }
+}
+
 /**
  * Compute cycle extension of the current alternative in curr_past relative
  * to the given base past.
@@ -164,14 +193,14 @@ void Alter::add_swaps(Past &past, SwapSelectionMode mode) const {
  * relative to which the total extension is to be computed.
  *
  * Do this by adding the swaps described by this alternative to an
- * alternative-local copy of the current past. Keep this resulting past in
- * the current alternative (for later use). Compute the total extension of
- * all pasts relative to the base past, and store this extension in the
- * alternative's score for later use.
+ * alternative-local speculative extension of the current past. Keep this
+ * resulting past in the current alternative (for later use). Compute the
+ * total extension of all pasts relative to the base past, and store this
+ * extension in the alternative's score for later use.
  */
 void Alter::extend(const Past &curr_past, const Past &base_past) {
     // QL_DOUT("... clone past, add swaps, compute overall score and keep it all in current alternative");
-    past = curr_past;   // explicitly clone currPast to an alternative-local copy of it, Alter.past
+    past.initialize_speculative(curr_past);   // only the mapping and FreeCycle state are copied
     // QL_DOUT("... adding swaps to alternative-local past ...");
     add_swaps(past, SwapSelectionMode::ALL);
     // QL_DOUT("... done adding/scheduling swaps to alternative-local past");
@@ -200,7 +229,7 @@ void Alter::extend(const Past &curr_past, const Past &base_past) {
  * index in total:      0           1           2           length-3        length-2        length-1
  * qubit:               2   ->      5   ->      7   ->      3       ->      1       CZ      4
  */
-void Alter::split(utils::List<Alter> &result) const {
+void Alter::split(Alters &result) const {
     // QL_DOUT("Split ...");
 
     utils::UInt length = total.size();
@@ -8,6 +8,8 @@
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/list.h"
+#include "ql/utils/arena.h"
+#include "ql/utils/map.h"
 #include "ql/ir/compat/compat.h"
 #include "ql/rmgr/manager.h"
 #include "options.h"
@@ -21,6 +23,21 @@ namespace qubits {
 namespace map {
 namespace detail {
 
+class Alter;
+
+/**
+ * Allocator for the nodes of Alters lists, allocating from the scratch arena
+ * of the mapper (see Mapper::scratch).
+ */
+using AlterAllocator = utils::ArenaAllocator<Alter>;
+
+/**
+ * List of alternatives. Such lists only live while a single gate is being
+ * routed, so their nodes are allocated from a scratch arena that is reset as a
+ * whole after each routed gate.
+ */
+using Alters = utils::List<Alter, AlterAllocator>;
+
 /**
  * Alter: one alternative way to make two real qbits (operands of a 2-qubit
  * gate) nearest neighbor (NN).
@@ -115,7 +132,8 @@ public:
     utils::Vec<utils::UInt> from_target;
 
     /**
-     * Cloned main past, extended with swaps from this path.
+     * Speculative extension of the main past with the swaps from this path.
+     * See Past::initialize_speculative().
      */
     Past past;
 
@@ -131,9 +149,13 @@ public:
 
     /**
      * This should only be called after a virgin construction and not after
-     * cloning a path.
+     * cloning a path. The resource manager is used to initialize the past.
      */
-    void initialize(const ir::compat::KernelRef &k, const OptionsRef &opt);
+    void initialize(
+        const ir::compat::KernelRef &k,
+        const OptionsRef &opt,
+        const rmgr::Manager &rm
+    );
 
     /**
      * Prints the state of this Alter, prefixed by s.
@@ -144,18 +166,18 @@ public:
      * Prints the state of this Alter, prefixed by s, only when the logging
      * verbosity is at least debug.
      */
-    void debug_print(const utils::Str &s) const;
+    void debug_print(const char *s) const;
 
     /**
      * Prints a state of a whole list of Alters, prefixed by s.
      */
-    static void print(const utils::Str &s, const utils::List<Alter> &la);
+    static void print(const utils::Str &s, const Alters &la);
 
     /**
      * Prints a state of a whole list of Alters, prefixed by s, only when the
      * logging verbosity is at least debug.
      */
-    static void debug_print(const utils::Str &s, const utils::List<Alter> &la);
+    static void debug_print(const char *s, const Alters &la);
 
     /**
      * Adds a node to the path in front, extending its length with one.
@@ -170,6 +192,15 @@ public:
      */
     void add_swaps(Past &past, SwapSelectionMode mode) const;
 
+    /**
+     * Computes where the states of the real qubits along the path of this
+     * alternative end up when all its swaps are applied (as for
+     * SwapSelectionMode::ALL). For each real qubit whose state moves, moved
+     * maps the original real qubit to the real qubit that holds the state
+     * afterwards; qubits that are not in the map are not affected.
+     */
+    void get_permutation(utils::Map<utils::UInt, utils::UInt> &moved) const;
+
     /**
      * Compute cycle extension of the current alternative in curr_past relative
      * to the given base past.
@@ -181,10 +212,10 @@ public:
      * relative to which the total extension is to be computed.
      *
      * Do this by adding the swaps described by this alternative to an
-     * alternative-local copy of the current past. Keep this resulting past in
-     * the current alternative (for later use). Compute the total extension of
-     * all pasts relative to the base past, and store this extension in the
-     * alternative's score for later use.
+     * alternative-local speculative extension of the current past. Keep this
+     * resulting past in the current alternative (for later use). Compute the
+     * total extension of all pasts relative to the base past, and store this
+     * extension in the alternative's score for later use.
      */
     void extend(const Past &curr_past, const Past &base_past);
 
@@ -203,7 +234,7 @@ public:
      * index in total:      0           1           2           length-3        length-2        length-1
      * qubit:               2   ->      5   ->      7   ->      3       ->      1       CZ      4
      */
-    void split(utils::List<Alter> &result) const;
+    void split(Alters &result) const;
 
 };
 
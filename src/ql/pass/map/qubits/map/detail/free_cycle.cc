@@ -12,13 +12,15 @@ namespace map {
 namespace detail {
 
 /**
- * Initializes this FreeCycle object.
+ * Initializes this FreeCycle object, using the given resource manager
+ * for the resource constraints.
  */
-void FreeCycle::initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt) {
+void FreeCycle::initialize(
+    const ir::compat::PlatformRef &p,
+    const OptionsRef &opt,
+    const rmgr::Manager &rm
+) {
     QL_DOUT("FreeCycle::initialize()");
-    auto rm = rmgr::Manager::from_defaults(p);   // allocated here and copied below to rm because of platform parameter
-                                                           // JvS: I have no idea what ^ means
-    QL_DOUT("... created FreeCycle initialize local resource_manager");
     options = opt;
     platform = p;
     nq = platform->qubit_count;
@@ -27,9 +29,66 @@ void FreeCycle::initialize(const ir::compat::PlatformRef &p, const OptionsRef &o
     QL_DOUT("... FreeCycle: nq=" << nq << ", nb=" << nb << ", ct=" << ct << "), initializing to all 0 cycles");
     fcv.clear();
     fcv.resize(nq+nb, 1);   // this 1 implies that cycle of first gate will be 1 and not 0; OpenQL convention!?!?
-    QL_DOUT("... about to copy FreeCycle initialize local resource_manager to FreeCycle member rm");
-    rs = rm.build(rmgr::Direction::FORWARD);
-    QL_DOUT("... done copy FreeCycle initialize local resource_manager to FreeCycle member rm");
+    update_bounds();
+    rs.emplace(rm.build(rmgr::Direction::FORWARD));
+}
+
+/**
+ * Returns mutable access to the resource state, cloning it first if it is
+ * still shared with other FreeCycle copies.
+ */
+rmgr::State &FreeCycle::get_mutable_resource_state() {
+    if (rs.unwrap().use_count() > 1) {
+        rs.emplace(*rs);
+    }
+    return *rs;
+}
+
+/**
+ * Recomputes min_free_cycle, max_free_cycle, and num_at_min by scanning
+ * fcv.
+ */
+void FreeCycle::update_bounds() {
+    min_free_cycle = ir::compat::MAX_CYCLE;
+    max_free_cycle = 0;
+    num_at_min = 0;
+    for (auto v : fcv) {
+        if (v < min_free_cycle) {
+            min_free_cycle = v;
+            num_at_min = 0;
+        }
+        if (v == min_free_cycle) {
+            num_at_min++;
+        }
+        max_free_cycle = utils::max(max_free_cycle, v);
+    }
+}
+
+/**
+ * Sets the free cycle of the given fcv index, updating the cached minimum
+ * and maximum.
+ */
+void FreeCycle::set_free_cycle(utils::UInt index, utils::UInt free_cycle) {
+    utils::UInt old = fcv[index];
+    if (free_cycle == old) {
+        return;
+    }
+    fcv[index] = free_cycle;
+
+    // Gates start no earlier than the free cycles of their operands, so
+    // entries should only ever increase. Fall back to a rescan if one is
+    // lowered anyway.
+    if (free_cycle < old) {
+        update_bounds();
+        return;
+    }
+    max_free_cycle = utils::max(max_free_cycle, free_cycle);
+    if (old == min_free_cycle) {
+        num_at_min--;
+        if (num_at_min == 0) {
+            update_bounds();
+        }
+    }
 }
 
 /**
@@ -46,12 +105,6 @@ utils::UInt FreeCycle::get_depth() const {
  * entries.
  */
 utils::UInt FreeCycle::get_min() const {
-    utils::UInt min_free_cycle = ir::compat::MAX_CYCLE;
-    for (const auto &v : fcv) {
-        if (v < min_free_cycle) {
-            min_free_cycle = v;
-        }
-    }
     return min_free_cycle;
 }
 
@@ -60,15 +113,16 @@ utils::UInt FreeCycle::get_min() const {
  * entries.
  */
 utils::UInt FreeCycle::get_max() const {
-    utils::UInt max_free_cycle = 0;
-    for (const auto &v : fcv) {
-        if (max_free_cycle < v) {
-            max_free_cycle = v;
-        }
-    }
     return max_free_cycle;
 }
 
+/**
+ * Returns the free cycle of the given fcv index.
+ */
+utils::UInt FreeCycle::get_free_cycle(utils::UInt index) const {
+    return fcv[index];
+}
+
 /**
  * Prints the state of this object along with the given string.
  */
@@ -94,8 +148,8 @@ void FreeCycle::print(const utils::Str &s) const {
 /**
  * Calls print only if the loglevel is debug or more verbose.
  */
-void FreeCycle::debug_print(const utils::Str &s) const {
-    if (utils::logger::log_level >= utils::logger::LogLevel::LOG_DEBUG) {
+void FreeCycle::debug_print(const char *s) const {
+    if (QL_IS_LOG_DEBUG) {
         print(s);
     }
 }
@@ -168,21 +222,13 @@ utils::UInt FreeCycle::get_start_cycle(const ir::compat::GateRef &g) const {
     utils::UInt start_cycle = get_start_cycle_no_rc(g);
 
     if (options->heuristic == Heuristic::BASE_RC || options->heuristic == Heuristic::MIN_EXTEND_RC) {
-        utils::UInt base_start_cycle = start_cycle;
-
-        while (start_cycle < ir::compat::MAX_CYCLE) {
-            // QL_DOUT("Startcycle for " << g->qasm() << ": available? at startCycle=" << startCycle);
-            if (rs->available(start_cycle, g)) {
-                // QL_DOUT(" ... [" << startCycle << "] resources available for " << g->qasm());
-                break;
-            } else {
-                // QL_DOUT(" ... [" << startCycle << "] Busy resource for " << g->qasm());
-                start_cycle++;
-            }
-        }
-        if (base_start_cycle != start_cycle) {
-            // QL_DOUT(" ... from [" << baseStartCycle << "] to [" << startCycle-1 << "] busy resource(s) for " << g->qasm());
-        }
+        // Let the resources skip directly to the first cycle at which they
+        // are all available, rather than probing cycle by cycle.
+        ir::compat::GateRefs gates;
+        gates.add(g);
+        start_cycle += rs->get_earliest(
+            start_cycle, gates, ir::compat::MAX_CYCLE - start_cycle - 1
+        )[0];
     }
     QL_ASSERT (start_cycle < ir::compat::MAX_CYCLE);
 
@@ -199,10 +245,10 @@ void FreeCycle::add_no_rc(const ir::compat::GateRef &g, utils::UInt startCycle)
     utils::UInt duration = (g->duration+ct-1)/ct;   // rounded-up unsigned integer division
     utils::UInt freeCycle = startCycle + duration;
     for (auto qreg : g->operands) {
-        fcv[qreg] = freeCycle;
+        set_free_cycle(qreg, freeCycle);
     }
     for (auto breg : g->breg_operands) {
-        fcv[nq+breg] = freeCycle;
+        set_free_cycle(nq+breg, freeCycle);
     }
 }
 
@@ -216,7 +262,38 @@ void FreeCycle::add(const ir::compat::GateRef &g, utils::UInt start_cycle) {
     add_no_rc(g, start_cycle);
 
     if (options->heuristic == Heuristic::BASE_RC || options->heuristic == Heuristic::MIN_EXTEND_RC) {
-        rs->reserve(start_cycle, g);
+        get_mutable_resource_state().reserve(start_cycle, g);
+    }
+}
+
+/**
+ * Makes a checkpoint of the current state, such that gates added after
+ * this can be undone using rollback(). This avoids cloning the resource
+ * state for "try this gate" speculation.
+ */
+FreeCycle::Checkpoint FreeCycle::checkpoint() {
+    Checkpoint cp;
+    cp.fcv = fcv;
+    cp.min_free_cycle = min_free_cycle;
+    cp.max_free_cycle = max_free_cycle;
+    cp.num_at_min = num_at_min;
+    cp.rs_token = 0;
+    if (options->heuristic == Heuristic::BASE_RC || options->heuristic == Heuristic::MIN_EXTEND_RC) {
+        cp.rs_token = get_mutable_resource_state().checkpoint();
+    }
+    return cp;
+}
+
+/**
+ * Restores the state to what it was when the given checkpoint was made.
+ */
+void FreeCycle::rollback(const Checkpoint &cp) {
+    fcv = cp.fcv;
+    min_free_cycle = cp.min_free_cycle;
+    max_free_cycle = cp.max_free_cycle;
+    num_at_min = cp.num_at_min;
+    if (options->heuristic == Heuristic::BASE_RC || options->heuristic == Heuristic::MIN_EXTEND_RC) {
+        get_mutable_resource_state().rollback(cp.rs_token);
     }
 }
 
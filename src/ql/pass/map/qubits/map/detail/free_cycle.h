@@ -7,7 +7,7 @@
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
-#include "ql/utils/opt.h"
+#include "ql/utils/ptr.h"
 #include "ql/ir/compat/compat.h"
 #include "ql/rmgr/manager.h"
 #include "ql/com/map/qubit_mapping.h"
@@ -78,16 +78,59 @@ private:
     utils::Vec<utils::UInt> fcv;
 
     /**
-     * Actual resources occupied by scheduled gates, if resource-aware.
+     * Cached minimum of all entries of fcv.
      */
-    utils::Opt<rmgr::State> rs;
+    utils::UInt min_free_cycle;
+
+    /**
+     * Cached maximum of all entries of fcv.
+     */
+    utils::UInt max_free_cycle;
+
+    /**
+     * Number of entries of fcv that equal min_free_cycle. When the last of
+     * these is raised, the minimum is recomputed by scanning fcv.
+     */
+    utils::UInt num_at_min;
+
+    /**
+     * Actual resources occupied by scheduled gates, if resource-aware. Cloning
+     * the resource state is expensive, and FreeCycle objects are copied a lot
+     * during speculation, usually without ever reserving anything in the copy.
+     * Therefore, the state is shared between copies, and only cloned (by
+     * get_mutable_resource_state()) when a copy is about to modify it.
+     */
+    utils::Ptr<rmgr::State> rs;
+
+    /**
+     * Returns mutable access to the resource state, cloning it first if it is
+     * still shared with other FreeCycle copies.
+     */
+    rmgr::State &get_mutable_resource_state();
+
+    /**
+     * Recomputes min_free_cycle, max_free_cycle, and num_at_min by scanning
+     * fcv.
+     */
+    void update_bounds();
+
+    /**
+     * Sets the free cycle of the given fcv index, updating the cached minimum
+     * and maximum.
+     */
+    void set_free_cycle(utils::UInt index, utils::UInt free_cycle);
 
 public:
 
     /**
-     * Initializes this FreeCycle object.
+     * Initializes this FreeCycle object, using the given resource manager
+     * for the resource constraints.
      */
-    void initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt);
+    void initialize(
+        const ir::compat::PlatformRef &p,
+        const OptionsRef &opt,
+        const rmgr::Manager &rm
+    );
 
     /**
      * Returns the depth of the FreeCycle map. Equals the max of all entries
@@ -98,16 +141,21 @@ public:
 
     /**
      * Returns the minimum cycle of the FreeCycle map; equals the min of all
-     * entries.
+     * entries. This is maintained incrementally, so it is O(1).
      */
     utils::UInt get_min() const;
 
     /**
      * Returns the maximum cycle of the FreeCycle map; equals the max of all
-     * entries.
+     * entries. This is maintained incrementally, so it is O(1).
      */
     utils::UInt get_max() const;
 
+    /**
+     * Returns the free cycle of the given fcv index.
+     */
+    utils::UInt get_free_cycle(utils::UInt index) const;
+
     /**
      * Prints the state of this object along with the given string.
      */
@@ -116,7 +164,7 @@ public:
     /**
      * Calls print only if the loglevel is debug or more verbose.
      */
-    void debug_print(const utils::Str &s) const;
+    void debug_print(const char *s) const;
 
     /**
      * Return whether gate with first operand qubit r0 can be scheduled earlier
@@ -166,6 +214,42 @@ public:
      */
     void add(const ir::compat::GateRef &g, utils::UInt start_cycle);
 
+    /**
+     * Saved state returned by checkpoint() and consumed by rollback().
+     */
+    struct Checkpoint {
+
+        /**
+         * Copy of the free cycle vector.
+         */
+        utils::Vec<utils::UInt> fcv;
+
+        /**
+         * Copies of the cached bounds of the free cycle vector.
+         */
+        utils::UInt min_free_cycle;
+        utils::UInt max_free_cycle;
+        utils::UInt num_at_min;
+
+        /**
+         * Token for the resource state checkpoint, if resource-aware.
+         */
+        utils::UInt rs_token;
+
+    };
+
+    /**
+     * Makes a checkpoint of the current state, such that gates added after
+     * this can be undone using rollback(). This avoids cloning the resource
+     * state for "try this gate" speculation.
+     */
+    Checkpoint checkpoint();
+
+    /**
+     * Restores the state to what it was when the given checkpoint was made.
+     */
+    void rollback(const Checkpoint &cp);
+
 };
 
 } // namespace detail
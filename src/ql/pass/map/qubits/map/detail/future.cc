@@ -5,6 +5,7 @@
 #include "future.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 
 namespace ql {
 namespace pass {
@@ -13,6 +14,27 @@ namespace qubits {
 namespace map {
 namespace detail {
 
+/**
+ * Ordering for the availability list: from most to least critical as
+ * defined by Scheduler::criticality_lessthan(), and for equal criticality
+ * in the order in which the nodes became available.
+ */
+utils::Bool Future::CriticalityOrder::operator()(
+    const AvailableNode &lhs,
+    const AvailableNode &rhs
+) const {
+    if (lhs.node == rhs.node) {
+        return false;
+    }
+    if (scheduler->criticality_lessthan(rhs.node, lhs.node, rmgr::Direction::FORWARD)) {
+        return true;
+    }
+    if (scheduler->criticality_lessthan(lhs.node, rhs.node, rmgr::Direction::FORWARD)) {
+        return false;
+    }
+    return lhs.order < rhs.order;
+}
+
 /**
  * Program-wide initialization function.
  */
@@ -26,7 +48,11 @@ void Future::initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt)
 /**
  * Set/switch input to the provided kernel.
  */
-void Future::set_kernel(const ir::compat::KernelRef &kernel, const utils::Ptr<Scheduler> &sched) {
+void Future::set_kernel(
+    const ir::compat::KernelRef &kernel,
+    const utils::Ptr<Scheduler> &sched,
+    utils::UInt num_released
+) {
     QL_DOUT("Future::set_kernel ...");
     approx_gates_total = kernel->gates.size();
     approx_gates_remaining = approx_gates_total;
@@ -43,15 +69,33 @@ void Future::set_kernel(const ir::compat::KernelRef &kernel, const utils::Ptr<Sc
             options->enable_criticality
         );
 
-        // and so also the original circuit can be output to after this
-        for (auto &gp : kernel->gates) {
-            scheduled.set(gp) = false;   // none were scheduled
+        // Count the incoming dependencies of each node. Multiple arcs
+        // between the same pair of nodes are all counted, and are all
+        // resolved at once when their source node completes.
+        pending_deps.emplace(scheduler->get_node_count(), (utils::UInt)0);
+        pending_deps_overlay.clear();
+        for (auto target : scheduler->arc_target) {
+            (*pending_deps)[target]++;
         }
-        scheduled.set(scheduler->instruction[scheduler->s]) = false;      // also the dummy nodes not
-        scheduled.set(scheduler->instruction[scheduler->t]) = false;
-        avlist.clear();
-        avlist.push_back(scheduler->s);
+
+        // Hold back the gates beyond the released ones. Since the gates are
+        // in input order, none of the released gates depend on them; the sink
+        // node does, so it's implicitly held back as well.
+        held.reset();
+        if (num_released < kernel->gates.size()) {
+            utils::Ptr<utils::Vec<utils::Bool>> held_nodes;
+            held_nodes.emplace(scheduler->get_node_count(), false);
+            for (utils::UInt i = num_released; i < kernel->gates.size(); i++) {
+                (*held_nodes)[scheduler->node.at(kernel->gates[i])] = true;
+            }
+            held = held_nodes.as_const();
+        }
+
         scheduler->set_remaining(rmgr::Direction::FORWARD);          // to know criticality
+        avlist = utils::Set<AvailableNode, CriticalityOrder>{CriticalityOrder{&*scheduler}};
+        avlist_order.clear();
+        next_available_order = 0;
+        make_available(scheduler->s);
 
         if (options->write_dot_graphs) {
             utils::Str map_dot;
@@ -61,12 +105,49 @@ void Future::set_kernel(const ir::compat::KernelRef &kernel, const utils::Ptr<Sc
 
             fname << options->output_prefix << kernel->name << "_" << "mapper" << ".dot";
             QL_IOUT("writing " << "mapper" << " dependence graph dot file to '" << fname.str() << "' ...");
-            utils::OutFile(fname.str()).write(map_dot);
+            utils::AsyncOutFile(fname.str()).write(map_dot);
         }
     }
     QL_DOUT("Future::set_kernel [DONE]");
 }
 
+/**
+ * Decrements the number of pending incoming dependencies of the given
+ * node, returning the new count.
+ */
+utils::UInt Future::decrement_pending_deps(Scheduler::Node n) {
+    // If we're the only future using the base counts, update them in place.
+    if (pending_deps.use_count() == 1 && pending_deps_overlay.empty()) {
+        auto &count = (*pending_deps)[n];
+        QL_ASSERT(count > 0);
+        return --count;
+    }
+
+    // Otherwise record the new count in our overlay.
+    auto it = pending_deps_overlay.find(n);
+    if (it == pending_deps_overlay.end()) {
+        it = pending_deps_overlay.insert({n, (*pending_deps)[n]}).first;
+    }
+    QL_ASSERT(it->second > 0);
+    return --it->second;
+}
+
+/**
+ * Adds the given node to the availability list.
+ */
+void Future::make_available(Scheduler::Node n) {
+    if (held.has_value() && (*held)[n]) {
+        return;
+    }
+    // NOTE: unlike Scheduler::make_available(), this doesn't update the cycle
+    // number of the input gate; the mapper doesn't use it (Past keeps its own
+    // cycle map), and the input gates may be shared by multiple mappers
+    // running concurrently (see Mapper::map_kernel_multi_start()).
+    avlist_order.set(n) = next_available_order;
+    avlist.insert({n, next_available_order});
+    next_available_order++;
+}
+
 /**
  * Get from avlist all gates that are non-quantum into nonqlg. Non-quantum
  * gates include classical and dummy (SOURCE/SINK). Return whether some
@@ -85,8 +166,8 @@ utils::Bool Future::get_non_quantum_gates(utils::List<ir::compat::GateRef> &nonq
             }
         }
     } else {
-        for (auto n : avlist) {
-            ir::compat::GateRef gate = scheduler->instruction[n];
+        for (const auto &entry : avlist) {
+            ir::compat::GateRef gate = scheduler->instruction[entry.node];
             if (
                 gate->type() == ir::compat::GateType::CLASSICAL
                 || gate->type() == ir::compat::GateType::DUMMY
@@ -112,8 +193,8 @@ utils::Bool Future::get_gates(utils::List<ir::compat::GateRef> &qlg) const {
             qlg.push_back(gp);
         }
     } else {
-        for (auto n : avlist) {
-            ir::compat::GateRef gp = scheduler->instruction[n];
+        for (const auto &entry : avlist) {
+            ir::compat::GateRef gp = scheduler->instruction[entry.node];
             if (gp->operands.size() > 2) {
                 QL_FATAL(" gate: " << gp->qasm() << " has more than 2 operand qubits; please decompose such gates first before mapping.");
             }
@@ -134,7 +215,20 @@ void Future::completed_gate(const ir::compat::GateRef &gate) {
     if (options->lookahead_mode == LookaheadMode::DISABLED) {
         input_gatepp = std::next(input_gatepp);
     } else {
-        scheduler->take_available(scheduler->node.at(gate), avlist, scheduled, rmgr::Direction::FORWARD);
+        auto n = scheduler->node.at(gate);
+        auto order_it = avlist_order.find(n);
+        QL_ASSERT(order_it != avlist_order.end());
+        avlist.erase({n, order_it->second});
+        avlist_order.erase(order_it);
+
+        // Make the successors available for which this was the last pending
+        // dependency.
+        for (auto arc : scheduler->get_out_arcs(n)) {
+            auto succ = scheduler->arc_target[arc];
+            if (!decrement_pending_deps(succ)) {
+                make_available(succ);
+            }
+        }
     }
 }
 
@@ -151,6 +245,76 @@ ir::compat::GateRef Future::get_most_critical(const utils::List<ir::compat::Gate
     }
 }
 
+/**
+ * Returns (in window) up to max_gates two-qubit gates that will become
+ * available after the gates currently in avlist, roughly in the order in
+ * which they will become available. This is the extended window used by
+ * the SABRE heuristic.
+ */
+void Future::get_lookahead_gates(utils::UInt max_gates, utils::List<ir::compat::GateRef> &window) const {
+    window.clear();
+    if (!max_gates) {
+        return;
+    }
+    if (options->lookahead_mode == LookaheadMode::DISABLED) {
+
+        // Without a dependency graph, the upcoming gates are simply the gates
+        // following the current one in the input circuit.
+        if (input_gatepp == input_gatepv.end()) {
+            return;
+        }
+        for (auto it = std::next(input_gatepp); it != input_gatepv.end(); ++it) {
+            if ((*it)->operands.size() == 2) {
+                window.push_back(*it);
+                if (window.size() >= max_gates) {
+                    return;
+                }
+            }
+        }
+
+    } else {
+
+        // Walk the dependency graph breadth-first, starting from the successors
+        // of the available gates. If the upcoming gates are mostly
+        // single-qubit or classical gates, this could walk the entire
+        // remainder of the graph for each routing step, so we give up after
+        // visiting a number of nodes proportional to max_gates.
+        utils::UInt max_visited = avlist.size() + 16 * max_gates;
+        utils::Set<utils::Int> visited;
+        utils::List<Scheduler::Node> todo;
+        for (const auto &entry : avlist) {
+            visited.insert(entry.node);
+            todo.push_back(entry.node);
+        }
+        while (!todo.empty()) {
+            auto n = todo.front();
+            todo.pop_front();
+            for (auto arc : scheduler->get_out_arcs(n)) {
+                auto succ = scheduler->arc_target[arc];
+                if (!visited.insert(succ).second) {
+                    continue;
+                }
+                const auto &gate = scheduler->instruction[succ];
+                if (
+                    gate->operands.size() == 2
+                    && gate->type() != ir::compat::GateType::CLASSICAL
+                    && gate->type() != ir::compat::GateType::DUMMY
+                ) {
+                    window.push_back(gate);
+                    if (window.size() >= max_gates) {
+                        return;
+                    }
+                }
+                if (visited.size() >= max_visited) {
+                    return;
+                }
+                todo.push_back(succ);
+            }
+        }
+
+    }
+}
+
 } // namespace detail
 } // namespace map
 } // namespace qubits
@@ -8,6 +8,7 @@
 #include "ql/utils/str.h"
 #include "ql/utils/ptr.h"
 #include "ql/utils/map.h"
+#include "ql/utils/set.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/list.h"
 #include "ql/ir/compat/compat.h"
@@ -59,13 +60,44 @@ using Scheduler = pass::sch::schedule::detail::Scheduler;
  * increasing circuit depth than taking a non-critical gate as first one to map.
  * Later implementations may become more sophisticated.
  *
+ * The availability list is kept ordered by criticality in a balanced tree,
+ * and for each node the number of incoming dependencies that haven't been
+ * completed yet is tracked, such that completing a gate costs logarithmic time
+ * in the size of the availability list plus linear time in its number of
+ * successors, rather than requiring scans over the availability list and
+ * over all predecessors of each successor. The dependency counts are shared
+ * between copies of a future (as made by the recursion in
+ * Mapper::select_alter()); copies record their changes in a small overlay
+ * instead, so copying a future doesn't cost time linear in the size of the
+ * kernel.
+ *
  * With the lookahead_mode option disabled, the future window's dependency
- * graphs (scheduled and avlist) are not used. Instead, a copy of the input
+ * graphs (pending_deps and avlist) are not used. Instead, a copy of the input
  * circuit (input_gatepv) is created and iterated over (input_gatepp).
  */
 class Future {
 public:
 
+    /**
+     * An entry in the availability list. order is a sequence number assigned
+     * when the node is made available, to break ties between equally critical
+     * nodes in favor of the node that became available first.
+     */
+    struct AvailableNode {
+        Scheduler::Node node;
+        utils::UInt order;
+    };
+
+    /**
+     * Ordering for the availability list: from most to least critical as
+     * defined by Scheduler::criticality_lessthan(), and for equal criticality
+     * in the order in which the nodes became available.
+     */
+    struct CriticalityOrder {
+        utils::RawPtr<Scheduler> scheduler;
+        utils::Bool operator()(const AvailableNode &lhs, const AvailableNode &rhs) const;
+    };
+
     /**
      * The platform being mapped to.
      */
@@ -87,14 +119,44 @@ public:
     ir::compat::GateRefs input_gatepv;
 
     /**
-     * State: has gate been scheduled, here: done from future?
+     * The number of incoming dependencies of each node of the dependency
+     * graph (indexed by node ID) that hadn't been completed yet when the last
+     * copy of this future was made. Shared between copies; only modified
+     * directly when not shared.
+     */
+    utils::Ptr<utils::Vec<utils::UInt>> pending_deps;
+
+    /**
+     * State: overrides for pending_deps, made while it was shared with other
+     * futures.
+     */
+    utils::Map<utils::Int, utils::UInt> pending_deps_overlay;
+
+    /**
+     * Whether each node is held back, i.e. only part of the dependency graph
+     * for the sake of criticality and lookahead, but never made available.
+     * Empty if no nodes are held back. Shared between copies of the future,
+     * because it is never modified after set_kernel().
+     */
+    utils::Ptr<const utils::Vec<utils::Bool>> held;
+
+    /**
+     * State: the nodes/gates which are available for mapping now, ordered
+     * by decreasing criticality.
      */
-    utils::Map<ir::compat::GateRef, utils::Bool> scheduled;
+    utils::Set<AvailableNode, CriticalityOrder> avlist;
 
     /**
-     * State: the nodes/gates which are available for mapping now.
+     * State: the order field of the avlist entry for each available node,
+     * indexed by node ID, such that the entry can be found again.
      */
-    utils::List<lemon::ListDigraph::Node> avlist;
+    utils::Map<utils::Int, utils::UInt> avlist_order;
+
+    /**
+     * State: the sequence number to assign to the next node that becomes
+     * available.
+     */
+    utils::UInt next_available_order;
 
     /**
      * State: alternative iterator in input_gatepv.
@@ -117,9 +179,30 @@ public:
     void initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt);
 
     /**
-     * Set/switch input to the provided kernel.
+     * Set/switch input to the provided kernel. If num_released is less than
+     * the number of gates in the kernel, only the first num_released gates
+     * are made available for mapping; the others only serve as lookahead.
+     */
+    void set_kernel(
+        const ir::compat::KernelRef &kernel,
+        const utils::Ptr<Scheduler> &sched,
+        utils::UInt num_released = utils::MAX
+    );
+
+private:
+
+    /**
+     * Decrements the number of pending incoming dependencies of the given
+     * node, returning the new count.
      */
-    void set_kernel(const ir::compat::KernelRef &kernel, const utils::Ptr<Scheduler> &sched);
+    utils::UInt decrement_pending_deps(Scheduler::Node n);
+
+    /**
+     * Adds the given node to the availability list.
+     */
+    void make_available(Scheduler::Node n);
+
+public:
 
     /**
      * Get from avlist all gates that are non-quantum into nonqlg. Non-quantum
@@ -146,6 +229,14 @@ public:
      */
     ir::compat::GateRef get_most_critical(const utils::List<ir::compat::GateRef> &lag) const;
 
+    /**
+     * Returns (in window) up to max_gates two-qubit gates that will become
+     * available after the gates currently in avlist, roughly in the order in
+     * which they will become available. This is the extended window used by
+     * the SABRE heuristic.
+     */
+    void get_lookahead_gates(utils::UInt max_gates, utils::List<ir::compat::GateRef> &window) const;
+
 };
 
 } // namespace detail
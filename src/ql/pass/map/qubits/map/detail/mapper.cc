@@ -4,10 +4,20 @@
 
 #include "mapper.h"
 
+#include <algorithm>
 #include <chrono>
+#include <iomanip>
+#include "ql/utils/budget.h"
 #include "ql/utils/filesystem.h"
+#include "ql/utils/hash_map.h"
+#include "ql/utils/intern.h"
+#include "ql/utils/pair.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/set.h"
+#include "ql/utils/trace.h"
 #include "ql/pass/ana/statistics/annotations.h"
-#include "ql/pass/map/qubits/place_mip/detail/algorithm.h"
+#include "ql/pass/map/qubits/partition_cores/detail/algorithm.h"
+#include "ql/pass/map/qubits/place_anneal/detail/algorithm.h"
 
 namespace ql {
 namespace pass {
@@ -34,9 +44,48 @@ std::ostream &operator<<(std::ostream &os, PathStrategy p) {
 using namespace utils;
 using namespace com;
 
+/**
+ * Sets degraded and reports this if the compile-time budget has been
+ * exhausted.
+ */
+void Mapper::check_time_budget() {
+    if (degraded || !TimeBudget::is_exceeded()) {
+        return;
+    }
+    degraded = true;
+    StrStrm ss;
+    ss << "routing the remainder of kernel " << kernel->name;
+    if (
+        options->heuristic == Heuristic::MIN_EXTEND ||
+        options->heuristic == Heuristic::MIN_EXTEND_RC ||
+        options->heuristic == Heuristic::MAX_FIDELITY
+    ) {
+        ss << " using the base heuristic";
+    }
+    ss << " with at most " << DEGRADED_MAX_ALTERS << " alternatives per step";
+    TimeBudget::report_degradation("mapper", ss.str());
+}
+
+/**
+ * Returns the limit on the number of alternative routing solutions to
+ * generate per routing step, or 0 if there is none, taking degradation into
+ * account.
+ */
+UInt Mapper::get_max_alters() const {
+    if (!degraded) {
+        return options->max_alters;
+    }
+    if (options->max_alters) {
+        return utils::min(options->max_alters, DEGRADED_MAX_ALTERS);
+    }
+    return DEGRADED_MAX_ALTERS;
+}
+
 /**
  * Find shortest paths between src and tgt in the grid, bounded by a
- * particular strategy. path is a linked-list node representing the complete
+ * particular strategy. dag is the path DAG for the original src and tgt
+ * qubits and budget, as returned by Topology::get_path_dag(); the next hops
+ * are taken from it. path is a linked-list node representing the complete
  * path from the initial src qubit to src in reverse order, not including src;
  * it will be null for the initial call. budget is the maximum number of hops
  * allowed in the path from src and is at least distance to tgt, but can be
@@ -52,17 +101,18 @@ using namespace com;
  */
 void Mapper::gen_shortest_paths(
     const ir::compat::GateRef &gate,
+    const Topology::PathDag &dag,
     RawPtr<Path> path,
     UInt src,
     UInt tgt,
     UInt budget,
-    List<Alter> &alters,
+    Alters &alters,
     UInt max_alters,
     PathStrategy strategy
 ) {
 
     // List that will get the result of a recursive gen_shortest_paths() call.
-    List<Alter> sub_alters;
+    Alters sub_alters(alters.get_allocator());
 
     QL_DOUT("gen_shortest_paths: src=" << src << " tgt=" << tgt << " budget=" << budget << " which=" << strategy);
     QL_ASSERT(alters.empty());
@@ -74,7 +124,7 @@ void Mapper::gen_shortest_paths(
         // distance 0 path with one qubit, src) and add the Alter to the result
         // list.
         Alter a;
-        a.initialize(kernel, options);
+        a.initialize(kernel, options, *resources);
         a.target_gate = gate;
         a.add_to_front(src);
         while (path) {
@@ -96,18 +146,11 @@ void Mapper::gen_shortest_paths(
     QL_DOUT("gen_shortest_paths: distance(src=" << src << ", tgt=" << tgt << ") = " << d);
     QL_ASSERT(d >= 1);
 
-    // Reduce neighbors nbs to those n continuing a path within budget.
+    // Get the neighbors n continuing a path within budget from the DAG.
     // src=>tgt is distance d, budget>=d is allowed, attempt src->n=>tgt
     // src->n is one hop, budget from n is one less so distance(n,tgt) <= budget-1 (i.e. distance < budget)
     // when budget==d, this defaults to distance(n,tgt) <= d-1
-    auto neighbors = platform->topology->get_neighbors(src);
-    if (logger::log_level >= logger::LogLevel::LOG_DEBUG) {
-        QL_DOUT("gen_shortest_paths: ... neighbors: ");
-        for (auto dn : neighbors) {
-            QL_DOUT("..." << dn << " ");
-        }
-    }
-    neighbors.remove_if([this,budget,tgt](const UInt& n) { return platform->topology->get_distance(n, tgt) >= budget; });
+    auto neighbors = dag.get_next_hops(src, budget);
     if (logger::log_level >= logger::LogLevel::LOG_DEBUG) {
         QL_DOUT("gen_shortest_paths: ... after reducing to steps within budget, nbl: ");
         for (auto dn : neighbors) {
@@ -178,7 +221,7 @@ void Mapper::gen_shortest_paths(
         }
 
         // Get list of possible paths in budget-1 from n to tgt in sub_alters.
-        gen_shortest_paths(gate, sub_path, n, tgt, budget - 1, sub_alters, max_sub_alters, new_strategy);
+        gen_shortest_paths(gate, dag, sub_path, n, tgt, budget - 1, sub_alters, max_sub_alters, new_strategy);
 
         // Move all of sub_alters to alters, and make sub_alters empty.
         alters.splice(alters.end(), sub_alters);
@@ -215,34 +258,95 @@ void Mapper::gen_shortest_paths(
  * The end result is a list of alternatives (in alters) suitable for being
  * evaluated for any routing metric.
  */
-void Mapper::gen_shortest_paths(const ir::compat::GateRef &gate, UInt src, UInt tgt, List<Alter> &alters) {
+void Mapper::gen_shortest_paths(const ir::compat::GateRef &gate, UInt src, UInt tgt, Alters &alters) {
+    ProfileTimer timer{profile, &Profile::path_generation_time};
+    UInt num_alters_before = alters.size();
 
     // Compute budget.
     UInt budget = platform->topology->get_min_hops(src, tgt);
 
+    // Get all paths within budget from the topology. These are cached by the
+    // topology, as the same qubit pairs tend to be routed over and over again.
+    auto dag = platform->topology->get_path_dag(src, tgt, budget);
+
     // Generate paths using the configured path selection strategy.
+    UInt max_alters = get_max_alters();
     if (options->path_selection_mode == PathSelectionMode::ALL) {
-        gen_shortest_paths(gate, nullptr, src, tgt, budget, alters, options->max_alters, PathStrategy::ALL);
+        gen_shortest_paths(gate, *dag, nullptr, src, tgt, budget, alters, max_alters, PathStrategy::ALL);
     } else if (options->path_selection_mode == PathSelectionMode::BORDERS) {
-        gen_shortest_paths(gate, nullptr, src, tgt, budget, alters, options->max_alters, PathStrategy::LEFT_RIGHT);
+        gen_shortest_paths(gate, *dag, nullptr, src, tgt, budget, alters, max_alters, PathStrategy::LEFT_RIGHT);
     } else if (options->path_selection_mode == PathSelectionMode::RANDOM) {
-        gen_shortest_paths(gate, nullptr, src, tgt, budget, alters, options->max_alters, PathStrategy::RANDOM);
+        gen_shortest_paths(gate, *dag, nullptr, src, tgt, budget, alters, max_alters, PathStrategy::RANDOM);
     } else {
         QL_FATAL("Unknown value of path selection mode option " << options->path_selection_mode);
     }
 
+    // Update the performance counters.
+    if (profile) {
+        UInt num_generated = alters.size() - num_alters_before;
+        profile->num_alters_generated += num_generated;
+        if (max_alters && num_generated >= max_alters) {
+            profile->num_alters_limited++;
+        }
+    }
+
     // Note: path split used to be here. Now it's done greedily by
     // gen_shortest_paths().
 
 }
 
+/**
+ * Removes the alternatives in alters from index first onward that result
+ * in the same placement of the virtual qubits (as mapped in past) as an
+ * earlier alternative from that index onward. Swaps that only move
+ * unmapped real qubits around thus don't distinguish alternatives. The
+ * first alternative of each class is kept, so this is deterministic.
+ */
+void Mapper::prune_equivalent_alters(
+    Alters &alters,
+    UInt first,
+    const Past &past
+) {
+    const auto &mapping = past.get_mapping();
+    utils::Set<Vec<utils::Pair<UInt, UInt>>> seen;
+    Map<UInt, UInt> moved;
+    UInt num_pruned = 0;
+    auto it = alters.begin();
+    std::advance(it, first);
+    while (it != alters.end()) {
+
+        // The canonical form of an alternative is the sorted list of
+        // (virtual qubit, new real qubit) pairs for the virtual qubits it
+        // moves. The moves of real qubits without state are irrelevant.
+        it->get_permutation(moved);
+        Vec<utils::Pair<UInt, UInt>> key;
+        for (const auto &move : moved) {
+            UInt virt = mapping.get_virtual(move.first);
+            if (virt != com::map::UNDEFINED_QUBIT) {
+                key.push_back({virt, move.second});
+            }
+        }
+        std::sort(key.begin(), key.end());
+
+        if (seen.insert(key).second) {
+            ++it;
+        } else {
+            it = alters.erase(it);
+            num_pruned++;
+        }
+    }
+    if (profile) {
+        profile->num_alters_pruned += num_pruned;
+    }
+}
+
 /**
  * Generates all possible variations of making the given gate
  * nearest-neighbor, starting from given past (with its mappings), and
  * return the found variations by appending them to the given list of
  * Alters.
  */
-void Mapper::gen_alters_gate(const ir::compat::GateRef &gate, List<Alter> &alters, Past &past) {
+void Mapper::gen_alters_gate(const ir::compat::GateRef &gate, Alters &alters, Past &past) {
 
     // Interpret virtual operands in past's current map.
     auto &q = gate->operands;
@@ -254,8 +358,15 @@ void Mapper::gen_alters_gate(const ir::compat::GateRef &gate, List<Alter> &alter
     past.debug_print_fc();
 
     // Find shortest paths from src to tgt, and split these.
+    UInt num_alters_before = alters.size();
     gen_shortest_paths(gate, src, tgt, alters);
     QL_ASSERT(!alters.empty());
+
+    // Discard alternatives that are equivalent as far as the placement of
+    // the virtual qubits is concerned.
+    if (options->prune_equivalent_alters) {
+        prune_equivalent_alters(alters, num_alters_before, past);
+    }
     // Alter::DPRINT("... after GenShortestPaths", la);
 
 }
@@ -269,7 +380,7 @@ void Mapper::gen_alters_gate(const ir::compat::GateRef &gate, List<Alter> &alter
  */
 void Mapper::gen_alters(
     const utils::List<ir::compat::GateRef> &gates,
-    List<Alter> &alters,
+    Alters &alters,
     Past &past
 ) {
     if (options->lookahead_mode == LookaheadMode::ALL) {
@@ -300,21 +411,34 @@ void Mapper::gen_alters(
 }
 
 /**
- * Seeds the random number generator with the current time in microseconds.
+ * Determines the seed for the random number generator, using the seed
+ * option if set or the current time in microseconds otherwise.
  */
 void Mapper::random_init() {
-    auto ts = std::chrono::duration_cast<std::chrono::microseconds>(
-        std::chrono::system_clock::now().time_since_epoch()
-    ).count();
-    // QL_DOUT("Seeding random generator with " << ts );
-    rng.seed(ts);
+    rng_seed = options->seed;
+    if (!rng_seed) {
+        rng_seed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()
+        ).count();
+    }
+    QL_DOUT("Seeding random generator with " << rng_seed);
+    rng.seed(rng_seed);
+}
+
+/**
+ * Resets the random number generator to the stream for the next routing
+ * decision of the current kernel.
+ */
+void Mapper::random_next_decision() {
+    rng.seed(rng_seed, rng_kernel << 32 ^ rng_decision);
+    rng_decision++;
 }
 
 /**
  * Chooses an Alter from the list based on the configured tie-breaking
  * strategy.
  */
-Alter Mapper::tie_break_alter(List<Alter> &alters, Future &future) {
+Alter Mapper::tie_break_alter(Alters &alters, Future &future) {
     QL_ASSERT(!alters.empty());
 
     if (alters.size() == 1) {
@@ -390,9 +514,10 @@ void Mapper::map_routed_gate(const ir::compat::GateRef &gate, Past &past) {
  * of future when done with it. Depending on configuration, this might not
  * actually place the target gate for the given alternative yet, because
  * only part of the swap chain is generated; in this case, swaps are added
- * to past, but future is not updated.
+ * to past, but future is not updated. Returns whether the target gate was
+ * placed.
  */
-void Mapper::commit_alter(Alter &alter, Future &future, Past &past) {
+Bool Mapper::commit_alter(Alter &alter, Future &future, Past &past) {
 
     // The target two-qubit-gate, now not yet nearest-neighbor.
     ir::compat::GateRef target = alter.target_gate;
@@ -410,9 +535,11 @@ void Mapper::commit_alter(Alter &alter, Future &future, Past &past) {
         // QL_DOUT("... CommitAlter, target 2q is NN, map it and done: " << resgp->qasm());
         map_routed_gate(target, past);
         future.completed_gate(target);
+        return true;
 
     } else {
         // QL_DOUT("... CommitAlter, target 2q is not NN yet, keep it: " << resgp->qasm());
+        return false;
     }
 
 }
@@ -460,12 +587,9 @@ Bool Mapper::map_mappable_gates(
     QL_DOUT("map_mappable_gates entry");
     while (true) {
 
-        // Print progress every once in a while if we're taking long.
-        Real progress = 1.0;
-        if (future.approx_gates_total) {
-            progress -= ((Real)future.approx_gates_remaining / (Real)future.approx_gates_total);
-        }
-        routing_progress.feed(progress);
+        // Record progress; it's printed every once in a while if we're
+        // taking long. This is a single relaxed atomic store.
+        routing_progress.set_done(future.approx_gates_total - future.approx_gates_remaining);
 
         // Handle non-quantum gates that need to be done first.
         if (future.get_non_quantum_gates(av_non_quantum_gates)) {
@@ -582,6 +706,426 @@ Bool Mapper::map_mappable_gates(
     }
 }
 
+/**
+ * Returns the cached profile of the swap that Past::add_swap() inserts for the
+ * given operands, after any reversal. The profile is made using the given
+ * past when it isn't cached yet.
+ */
+const SwapProfile &Mapper::get_swap_profile(const Past &past, UInt r0, UInt r1) {
+    auto key = utils::Pair<UInt, UInt>(r0, r1);
+    auto it = swap_profiles.find(key);
+    if (it == swap_profiles.end()) {
+        it = swap_profiles.emplace(key, past.make_swap_profile(r0, r1)).first;
+    }
+    return it->second;
+}
+
+/**
+ * Scores all the given alternatives relative to base_past as Alter::extend()
+ * on top of past would, but without cloning past for each of them. The swap
+ * chains of all alternatives are flattened into structure-of-arrays form,
+ * recording for each swap the gates it adds (as a swap profile) and the base
+ * free cycle of the qubit it moves the state into. The free cycle of the
+ * qubit carrying the state of each chain is then propagated through these
+ * arrays for all chains in lockstep. This relies on the free cycles only
+ * depending on gate dependencies, so it is only done for the
+ * non-resource-constrained heuristics, and without move gates, which depend
+ * on more of the state. Returns false without touching the alternatives when
+ * this isn't possible or the batch_scoring option is disabled. The
+ * speculative pasts of the alternatives are left empty; they would only be
+ * used to compute the scores anyway.
+ */
+Bool Mapper::score_alters_batched(Alters &alters, const Past &past, const Past &base_past) {
+    if (!options->batch_scoring || options->use_move_gates) {
+        return false;
+    }
+    if (options->heuristic != Heuristic::BASE && options->heuristic != Heuristic::MIN_EXTEND) {
+        return false;
+    }
+    const auto &v2r = past.get_mapping();
+
+    // Flatten the swap chains. Each chain with at least one swap gets a lane,
+    // and each swap an entry in the swap arrays. Past::add_swap() only
+    // updates the free cycles when the swaps are scheduled, so the operand
+    // reversal is decided using the free cycles of past. A swap that moves
+    // no live state adds no gates; since the state of the first qubit of a
+    // chain is carried along it, that only depends on the initial state of
+    // that qubit and the state of the qubit it moves into.
+    Vec<UInt> lane_alter;
+    Vec<UInt> lane_offset;
+    Vec<UInt> lane_carried;
+    Vec<RawPtr<const SwapProfile>> swap_profile;
+    Vec<Bool> swap_reversed;
+    Vec<UInt> swap_other;
+    UInt max_length = 0;
+    UInt alter_index = 0;
+    for (const auto &a : alters) {
+        for (const auto *chain : {&a.from_source, &a.from_target}) {
+            if (chain->size() < 2) {
+                continue;
+            }
+            Bool carries_live = v2r.get_state(chain->front()) == com::map::QubitState::LIVE;
+            lane_alter.push_back(alter_index);
+            lane_offset.push_back(swap_profile.size());
+            lane_carried.push_back(past.get_free_cycle(chain->front()));
+            for (UInt i = 1; i < chain->size(); i++) {
+                UInt r0 = (*chain)[i - 1];
+                UInt r1 = (*chain)[i];
+                swap_other.push_back(past.get_free_cycle(r1));
+                if (!carries_live && v2r.get_state(r1) != com::map::QubitState::LIVE) {
+                    swap_profile.push_back(nullptr);
+                    swap_reversed.push_back(false);
+                    continue;
+                }
+                Bool reversed = options->reverse_swap_if_better && past.get_free_cycle(r0) < past.get_free_cycle(r1);
+                const auto &swap_gates = reversed ? get_swap_profile(past, r1, r0) : get_swap_profile(past, r0, r1);
+                if (!swap_gates.supported) {
+                    return false;
+                }
+                swap_profile.push_back(&swap_gates);
+                swap_reversed.push_back(reversed);
+            }
+            max_length = utils::max<UInt>(max_length, chain->size() - 1);
+        }
+        alter_index++;
+    }
+    lane_offset.push_back(swap_profile.size());
+    QL_DOUT("scoring " << alters.size() << " alternatives with " << swap_profile.size() << " swaps in a batch");
+
+    // Propagate the free cycle of the carried state along all chains in
+    // lockstep, keeping track of the maximum free cycle of each alternative.
+    // The untouched free cycles don't change, and the touched ones only
+    // increase, so that maximum is all we need for the score.
+    Vec<UInt> alter_max(alters.size(), past.get_max_free_cycle());
+    UInt num_lanes = lane_alter.size();
+    for (UInt step = 0; step < max_length; step++) {
+        for (UInt lane = 0; lane < num_lanes; lane++) {
+            UInt s = lane_offset[lane] + step;
+            if (s >= lane_offset[lane + 1]) {
+                continue;
+            }
+            const auto &swap_gates = swap_profile[s];
+            if (!swap_gates.has_value()) {
+                lane_carried[lane] = swap_other[s];
+                continue;
+            }
+            UInt carried_index = swap_reversed[s] ? 1 : 0;
+            UInt free_cycles[2];
+            free_cycles[carried_index] = lane_carried[lane];
+            free_cycles[1 - carried_index] = swap_other[s];
+            for (UInt g = 0; g < swap_gates->operands.size(); g++) {
+                UInt mask = swap_gates->operands[g];
+                UInt start_cycle = 1;
+                for (UInt o = 0; o < 2; o++) {
+                    if (mask & (1ull << o)) {
+                        start_cycle = utils::max(start_cycle, free_cycles[o]);
+                    }
+                }
+                UInt free_cycle = start_cycle + swap_gates->durations[g];
+                for (UInt o = 0; o < 2; o++) {
+                    if (mask & (1ull << o)) {
+                        free_cycles[o] = free_cycle;
+                    }
+                }
+            }
+            lane_carried[lane] = free_cycles[1 - carried_index];
+            auto &m = alter_max[lane_alter[lane]];
+            m = utils::max(m, utils::max(free_cycles[0], free_cycles[1]));
+        }
+    }
+
+    alter_index = 0;
+    for (auto &a : alters) {
+        a.score = alter_max[alter_index++] - base_past.get_max_free_cycle();
+        a.score_valid = true;
+    }
+    return true;
+}
+
+/**
+ * Extends all the given alternatives on top of past (see Alter::extend()),
+ * computing their scores relative to base_past. When the batch_scoring option
+ * allows for it, they are only scored using score_alters_batched().
+ * Otherwise, when the route_threads option allows for it, the alternatives
+ * are evaluated concurrently. This does not affect the result, because each
+ * alternative only modifies its own private copy of the past.
+ */
+void Mapper::extend_alters(Alters &alters, const Past &past, const Past &base_past) {
+    ProfileTimer timer{profile, &Profile::scoring_time};
+    if (score_alters_batched(alters, past, base_past)) {
+        return;
+    }
+    if (options->num_route_threads == 1 || alters.size() < 2) {
+        for (auto &a : alters) {
+            a.debug_print("Considering extension by alternative: ...");
+            a.extend(past, base_past);
+        }
+        return;
+    }
+
+    // List iterators can't be indexed, so gather pointers to the alternatives
+    // first.
+    Vec<RawPtr<Alter>> alter_ptrs;
+    alter_ptrs.reserve(alters.size());
+    for (auto &a : alters) {
+        alter_ptrs.push_back(&a);
+    }
+    QL_DOUT("extending " << alter_ptrs.size() << " alternatives in parallel");
+    parallel_for(alter_ptrs.size(), options->num_route_threads, [&](UInt i) {
+        alter_ptrs[i]->extend(past, base_past);
+    });
+}
+
+/**
+ * Select an Alter using the SABRE heuristic. Each alternative is scored by
+ * the SABRE lookahead cost (see compute_sabre_cost()) of the two-qubit
+ * gates in the available gate list and the extended window returned by
+ * Future::get_lookahead_gates(), after applying all its swaps to the
+ * current mapping of past, multiplied by the largest decay factor of the
+ * qubits it swaps. The tie-breaking strategy is applied to the
+ * alternatives with the lowest score.
+ */
+void Mapper::select_alter_sabre(
+    Alters &alters,
+    Alter &result,
+    Future &future,
+    const Past &past
+) {
+    const auto &v2r = past.get_mapping();
+
+    // Converts the given gates to pairs of real operand qubits. Gates with
+    // operands that haven't been mapped yet are skipped; moving other qubits
+    // around does not affect them anyway.
+    auto to_real_pairs = [&v2r](const List<ir::compat::GateRef> &gates, Vec<QubitPair> &pairs) {
+        pairs.clear();
+        for (const auto &gate : gates) {
+            if (gate->operands.size() != 2) {
+                continue;
+            }
+            UInt r0 = v2r[gate->operands[0]];
+            UInt r1 = v2r[gate->operands[1]];
+            if (r0 != com::map::UNDEFINED_QUBIT && r1 != com::map::UNDEFINED_QUBIT) {
+                pairs.push_back({r0, r1});
+            }
+        }
+    };
+
+    // Build the front layer from the available two-qubit gates, and the
+    // extended window from the gates that follow them.
+    List<ir::compat::GateRef> gates;
+    Vec<QubitPair> front;
+    future.get_gates(gates);
+    to_real_pairs(gates, front);
+    Vec<QubitPair> extended;
+    future.get_lookahead_gates(options->sabre_extended_set_size, gates);
+    to_real_pairs(gates, extended);
+
+    // Score the alternatives.
+    ProfileTimer timer{profile, &Profile::scoring_time};
+    Map<UInt, UInt> moved;
+    for (auto &a : alters) {
+        a.get_permutation(moved);
+        Real decay = 1.0;
+        for (const auto &it : moved) {
+            decay = utils::max(decay, sabre_decay[it.first]);
+        }
+        a.score = decay * compute_sabre_cost(
+            *platform->topology, front, extended,
+            options->sabre_extended_set_weight, moved
+        );
+        a.score_valid = true;
+    }
+    alters.sort([](const Alter &a1, const Alter &a2) { return a1.score < a2.score; });
+    Alter::debug_print("... select_alter_sabre sorted alternatives:", alters);
+
+    // Tie-break between the best alternatives.
+    Alters best_alters = alters;
+    best_alters.remove_if([&alters](const Alter& a) { return a.score != alters.front().score; });
+    result = tie_break_alter(best_alters, future);
+    result.debug_print("... the selected Alter is");
+}
+
+/**
+ * Select an Alter using beam search, for the MIN_EXTEND[_RC] heuristics when
+ * beam_width is nonzero. Rather than recursing into the good alternatives,
+ * this keeps the beam_width best speculative states per routing step. Each
+ * state consists of a future and past with the swaps of one alternative per
+ * step committed, and is ranked by its cycle extension relative to base_past
+ * plus beam_lookahead_weight times the number of swaps that the gates that
+ * still need routing need at least. The search ends after
+ * recursion_depth_limit + 1 steps or when all states reach the end of the
+ * circuit, after which the tie-breaking strategy is applied to the
+ * alternatives (of the current step) that the best-ranked states started
+ * with. The runtime thus grows linearly with the beam width and the number
+ * of steps.
+ */
+void Mapper::select_alter_beam(
+    Alters &alters,
+    Alter &result,
+    Future &future,
+    Past &past,
+    const Past &base_past
+) {
+
+    // A speculative state in the beam.
+    struct BeamState {
+
+        // The index of the alternative of the current step that this state
+        // started with.
+        UInt root;
+
+        // The future and past after committing the alternatives of this
+        // state.
+        Future future;
+        Past past;
+
+        // The gates that need routing next, and whether there are any gates
+        // left at all.
+        List<ir::compat::GateRef> gates;
+        Bool gates_remain;
+
+        // Cycle extension relative to base_past, and the extension plus the
+        // lookahead term.
+        Real score;
+        Real rank;
+
+    };
+
+    // See select_alter().
+    Bool also_nn_two_qubit_gates = options->recurse_on_nn_two_qubit
+                 && (
+                     options->lookahead_mode == LookaheadMode::NO_ROUTING_FIRST
+                     || options->lookahead_mode == LookaheadMode::ALL
+                 );
+
+    // Returns the minimum number of swaps still needed to route the given
+    // gates with the mapping of the given past. Gates with operands that
+    // haven't been mapped yet are skipped.
+    auto get_routing_distance = [this](const List<ir::compat::GateRef> &gates, const Past &p) {
+        const auto &v2r = p.get_mapping();
+        UInt distance = 0;
+        for (const auto &gate : gates) {
+            if (gate->operands.size() != 2) {
+                continue;
+            }
+            UInt r0 = v2r[gate->operands[0]];
+            UInt r1 = v2r[gate->operands[1]];
+            if (r0 != com::map::UNDEFINED_QUBIT && r1 != com::map::UNDEFINED_QUBIT) {
+                distance += platform->topology->get_min_hops(r0, r1) - 1;
+            }
+        }
+        return distance;
+    };
+
+    // Commits the given (extended) alternative on top of the given future and
+    // past, and maps the gates that don't need routing, returning the
+    // resulting state.
+    auto expand = [&](const Future &parent_future, const Past &parent_past, Alter &alter, UInt root) {
+        BeamState state{root, parent_future};
+        state.past.initialize_speculative(parent_past);
+        commit_alter(alter, state.future, state.past);
+        state.gates_remain = map_mappable_gates(state.future, state.past, state.gates, also_nn_two_qubit_gates);
+        state.score = state.past.get_max_free_cycle() - base_past.get_max_free_cycle();
+        state.rank = state.score + options->beam_lookahead_weight * get_routing_distance(state.gates, state.past);
+        return state;
+    };
+
+    // Start the beam with the alternatives of the current step.
+    extend_alters(alters, past, base_past);
+    Vec<Alter> roots(alters.begin(), alters.end());
+    Vec<BeamState> beam;
+    for (UInt step = 0; ; step++) {
+
+        // Expand all states by all their alternatives.
+        Vec<BeamState> candidates;
+        if (step == 0) {
+            for (UInt i = 0; i < roots.size(); i++) {
+                candidates.push_back(expand(future, past, roots[i], i));
+            }
+        } else {
+            for (auto &state : beam) {
+                if (!state.gates_remain) {
+                    candidates.push_back(std::move(state));
+                    continue;
+                }
+                Alters sub_alters{AlterAllocator(scratch)};
+                gen_alters(state.gates, sub_alters, state.past);
+                extend_alters(sub_alters, state.past, base_past);
+                for (auto &a : sub_alters) {
+                    candidates.push_back(expand(state.future, state.past, a, state.root));
+                }
+            }
+        }
+
+        // Keep the best-ranked states. The sort is stable to keep the
+        // alternative generation order for equal ranks.
+        std::stable_sort(
+            candidates.begin(), candidates.end(),
+            [](const BeamState &a, const BeamState &b) { return a.rank < b.rank; }
+        );
+        if (candidates.size() > options->beam_width) {
+            candidates.erase(candidates.begin() + options->beam_width, candidates.end());
+        }
+        beam = std::move(candidates);
+        if (profile) {
+            profile->record_recursion_depth(step);
+        }
+
+        // Stop when the step limit is reached or no state has anything left to
+        // route.
+        Bool gates_remain = false;
+        for (const auto &state : beam) {
+            gates_remain |= state.gates_remain;
+        }
+        if (!gates_remain || step >= options->recursion_depth_limit) {
+            break;
+        }
+
+    }
+
+    // Score the alternatives of the current step by their best state, and
+    // tie-break between the ones with the best score.
+    Vec<Bool> selected(roots.size(), false);
+    Alters best_alters{AlterAllocator(scratch)};
+    for (const auto &state : beam) {
+        if (state.rank != beam.front().rank) {
+            break;
+        }
+        if (selected[state.root]) {
+            continue;
+        }
+        selected[state.root] = true;
+        roots[state.root].score = state.score;
+        best_alters.push_back(roots[state.root]);
+    }
+    Alter::debug_print("... select_alter_beam best alternatives:", best_alters);
+    result = tie_break_alter(best_alters, future);
+    result.debug_print("... the selected Alter is");
+}
+
+/**
+ * Updates the SABRE decay factors after the given alternative has been
+ * committed. If its target gate was placed, all decay factors are reset.
+ * Otherwise, the decay factors of the qubits it swapped are increased.
+ */
+void Mapper::update_sabre_decay(const Alter &alter, Bool target_placed) {
+    if (target_placed) {
+        for (auto q : sabre_decayed_qubits) {
+            sabre_decay[q] = 1.0;
+        }
+        sabre_decayed_qubits.clear();
+        return;
+    }
+    Map<UInt, UInt> moved;
+    alter.get_permutation(moved);
+    for (const auto &it : moved) {
+        if (sabre_decay[it.first] == 1.0) {
+            sabre_decayed_qubits.push_back(it.first);
+        }
+        sabre_decay[it.first] += options->sabre_decay;
+    }
+}
+
 /**
  * Select an Alter based on the selected heuristic.
  *
@@ -591,12 +1135,16 @@ Bool Mapper::map_mappable_gates(
  *    of the given past (or some factor of that amount, ordered by
  *    increasing cycle extension) and recurse. When the recursion depth
  *    limit is reached, apply the tie-breaking strategy.
+ *  - If SABRE, defer to select_alter_sabre().
+ *
+ * For MIN_EXTEND[_RC], the recursion is replaced by beam search (see
+ * select_alter_beam()) when beam_width is nonzero.
  *
  * For recursion, past is the speculative past, and base_past is the past
  * we've already committed to, and should thus measure fitness against.
  */
 void Mapper::select_alter(
-    List<Alter> &alters,
+    Alters &alters,
     Alter &result,
     Future &future,
     Past &past,
@@ -607,10 +1155,18 @@ void Mapper::select_alter(
     QL_ASSERT(!alters.empty());
 
     QL_DOUT("select_alter ENTRY level=" << recursion_depth << " from " << alters.size() << " alternatives");
+    if (profile) {
+        profile->record_recursion_depth(recursion_depth);
+    }
 
     // Handle the basic strategy, where we just tie-break on all alters without
-    // recusing.
-    if (options->heuristic == Heuristic::BASE || options->heuristic == Heuristic::BASE_RC) {
+    // recusing. The speculating heuristics fall back to this once the
+    // compile-time budget is exhausted.
+    if (
+        options->heuristic == Heuristic::BASE ||
+        options->heuristic == Heuristic::BASE_RC ||
+        (degraded && options->heuristic != Heuristic::SABRE)
+    ) {
         Alter::debug_print(
             "... select_alter base (equally good/best) alternatives:", alters);
         result = tie_break_alter(alters, future);
@@ -619,19 +1175,28 @@ void Mapper::select_alter(
         return;
     }
 
+    // The SABRE heuristic doesn't speculate, so it doesn't need the
+    // extension-based logic below either.
+    if (options->heuristic == Heuristic::SABRE) {
+        select_alter_sabre(alters, result, future, past);
+        return;
+    }
+
     QL_ASSERT(
         options->heuristic == Heuristic::MIN_EXTEND ||
         options->heuristic == Heuristic::MIN_EXTEND_RC ||
         options->heuristic == Heuristic::MAX_FIDELITY
     );
 
+    // Beam search replaces the recursion below when enabled.
+    if (options->beam_width > 0 && options->heuristic != Heuristic::MAX_FIDELITY) {
+        select_alter_beam(alters, result, future, past, base_past);
+        return;
+    }
+
     // Compute a score for each alternative relative to base_past, and sort the
     // alternatives based on it, minimum first.
-    for (auto &a : alters) {
-        a.debug_print("Considering extension by alternative: ...");
-        a.extend(past, base_past);           // locally here, past will be cloned and kept in alter
-        // and the extension stored into the a.score
-    }
+    extend_alters(alters, past, base_past);
     alters.sort([this](const Alter &a1, const Alter &a2) { return a1.score < a2.score; });
     Alter::debug_print(
         "... select_alter sorted all entry alternatives after extension:", alters);
@@ -643,7 +1208,7 @@ void Mapper::select_alter(
     // exponentially builds more alternatives. To curb this,
     // recursion_width_exponent can be set to a value less than one, to
     // multiplicatively reduce the width for each recursion level.
-    List<Alter> good_alters = alters;
+    Alters good_alters = alters;
     good_alters.remove_if([this,alters](const Alter& a) { return a.score != alters.front().score; });
     Real factor = options->recursion_width_factor * utils::pow(options->recursion_width_exponent, recursion_depth);
     Real keep_real = utils::max(1.0, utils::ceil(factor * good_alters.size()));
@@ -651,7 +1216,7 @@ void Mapper::select_alter(
     if (keep != good_alters.size()) {
         if (keep < alters.size()) {
             good_alters = alters;
-            List<Alter>::iterator ia;
+            Alters::iterator ia;
             ia = good_alters.begin();
             advance(ia, keep);
             good_alters.erase(ia, good_alters.end());
@@ -669,7 +1234,7 @@ void Mapper::select_alter(
         // Reduce list of good alternatives to list of minextend/maxfidelity
         // best alternatives (bla), and make a choice from that list to return
         // as result.
-        List<Alter> best_alters = good_alters;
+        Alters best_alters = good_alters;
         best_alters.remove_if([this,good_alters](const Alter& a) { return a.score != good_alters.front().score; });
         Alter::debug_print(
             "... select_alter reduced to best alternatives to choose result from:",
@@ -704,8 +1269,9 @@ void Mapper::select_alter(
     // QL_DOUT("... SelectAlter level=" << level << " entering recursion with " << gla.size() << " good alternatives");
     for (auto &a : good_alters) {
         a.debug_print("... ... considering alternative:");
-        Future sub_future = future; // copy!
-        Past sub_past = past;       // copy!
+        Future sub_future = future; // copy; shares the dependency counts with future
+        Past sub_past;
+        sub_past.initialize_speculative(past);
         commit_alter(a, sub_future, sub_past);
         a.debug_print(
             "... ... committed this alternative first before recursion:");
@@ -749,7 +1315,7 @@ void Mapper::select_alter(
             QL_DOUT("... ... select_alter level=" << recursion_depth << ", committed + mapped easy gates, now facing " << gates.size() << " 2q gates to evaluate next");
 
             // Generate the next set of alternative routing actions.
-            List<Alter> sub_alters;
+            Alters sub_alters{AlterAllocator(scratch)};
             gen_alters(gates, sub_alters, sub_past);
             QL_DOUT("... ... select_alter level=" << recursion_depth << ", generated for these 2q gates " << sub_alters.size() << " alternatives; RECURSE ... ");
 
@@ -788,7 +1354,7 @@ void Mapper::select_alter(
     // Reduce list of good alternatives of before recursion to list of equally
     // minimal best alternatives now, and make a choice from that list to return
     // as result.
-    List<Alter> best_alters = good_alters;
+    Alters best_alters = good_alters;
     best_alters.remove_if([this,good_alters](const Alter& a) { return a.score != good_alters.front().score; });
     Alter::debug_print("... select_alter equally best alternatives on return of RECURSION:", best_alters);
     result = tie_break_alter(best_alters, future);
@@ -806,6 +1372,7 @@ void Mapper::select_alter(
  * which the mapping is done.
  */
 void Mapper::map_gates(Future &future, Past &past, Past &base_past) {
+    QL_TRACE_SCOPE("map.map_gates");
 
     // List of non-mappable gates taken from avlist, as returned by
     // map_mappable_gates.
@@ -816,7 +1383,12 @@ void Mapper::map_gates(Future &future, Past &past, Past &base_past) {
         || options->lookahead_mode == LookaheadMode::ALL
     );
 
-    routing_progress = Progress("router", 1000);
+    routing_progress = Progress("router", 1000, future.approx_gates_total);
+
+    // Make a fresh scratch arena for the alternatives. Copies of this mapper
+    // share the arena pointer, so it must not be reused from a previous run.
+    // A few chunks of 64kiB are plenty for all the alternatives of a gate.
+    scratch.emplace(64 * 1024);
 
     // Handle all the gates one by one. map_mappable_gates returns false when no
     // gates remain.
@@ -827,8 +1399,13 @@ void Mapper::map_gates(Future &future, Past &past, Past &base_past) {
         // one of the known strategies. The only requirement on the code below
         // is that at least something is done that decreases the problem.
 
-        // Generate all alternative routes.
-        List<Alter> alters;
+        // Generate all alternative routes, cheaply if we're out of time.
+        // The alternatives of the previous gate are gone by now, so the
+        // scratch arena can be reused.
+        check_time_budget();
+        random_next_decision();
+        scratch->reset();
+        Alters alters{AlterAllocator(scratch)};
         gen_alters(gates, alters, past);
 
         // Select the best one based on the configured strategy.
@@ -837,14 +1414,13 @@ void Mapper::map_gates(Future &future, Past &past, Past &base_past) {
 
         // Commit to selected alternative. This adds all or just one swap
         // (depending on configuration) to THIS past, and schedules them/it in.
-        commit_alter(alter, future, past);
-
-        // Print progress every once in a while if we're taking long.
-        Real progress = 1.0;
-        if (future.approx_gates_total) {
-            progress -= ((Real)future.approx_gates_remaining / (Real)future.approx_gates_total);
+        Bool target_placed = commit_alter(alter, future, past);
+        if (options->heuristic == Heuristic::SABRE) {
+            update_sabre_decay(alter, target_placed);
         }
-        routing_progress.feed(progress);
+
+        // Record progress.
+        routing_progress.set_done(future.approx_gates_total - future.approx_gates_remaining);
 
     }
 
@@ -856,6 +1432,43 @@ void Mapper::map_gates(Future &future, Past &past, Past &base_past) {
  */
 void Mapper::place(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r) {
 
+    if (options->enable_core_partitioner) {
+        QL_DOUT("PartitionCores: kernel=" << k->name << " horizon=" << options->core_partitioner_horizon << " [START]");
+
+        partition_cores::detail::Options pcopt;
+        pcopt.map_all = options->initialize_one_to_one;
+        pcopt.horizon = options->core_partitioner_horizon;
+        pcopt.half_life = options->core_partitioner_half_life;
+
+        partition_cores::detail::Algorithm pc;
+        auto pcok = pc.run(k, pcopt, v2r);
+        QL_DOUT("PartitionCores: kernel=" << k->name << " result=" << pcok << " cut=" << pc.get_cut() << " original cut=" << pc.get_original_cut() << " [DONE]");
+    }
+
+    if (options->enable_anneal_placer) {
+        QL_DOUT("PlaceAnneal: kernel=" << k->name << " horizon=" << options->mip_horizon << " [START]");
+
+        place_anneal::detail::Options paopt;
+        paopt.map_all = options->initialize_one_to_one;
+        paopt.horizon = options->mip_horizon;
+        paopt.moves_per_qubit = options->anneal_moves_per_qubit;
+        paopt.num_chains = options->anneal_chains;
+        paopt.num_threads = options->num_anneal_threads;
+        paopt.timeout = options->anneal_timeout;
+
+        // Don't anneal for longer than the compile-time budget allows. The
+        // timeout must be positive to be enabled at all, so an exhausted
+        // budget is rounded up to a millisecond.
+        Real remaining = TimeBudget::get_remaining();
+        if (remaining < INF && (paopt.timeout <= 0.0 || remaining < paopt.timeout)) {
+            paopt.timeout = utils::max(remaining, 0.001);
+        }
+
+        place_anneal::detail::Algorithm pa;
+        auto paok = pa.run(k, paopt, v2r);
+        QL_DOUT("PlaceAnneal: kernel=" << k->name << " result=" << paok << " cost=" << pa.get_cost() << " original cost=" << pa.get_original_cost() << " time taken=" << pa.get_time_taken() << " seconds [DONE]");
+    }
+
     if (options->enable_mip_placer) {
 #ifdef INITIALPLACE
         QL_DOUT("InitialPlace: kernel=" << k->name << " timeout=" << options->mip_timeout << " horizon=" << options->mip_horizon << " [START]");
@@ -864,6 +1477,8 @@ void Mapper::place(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r)
         ipopt.map_all = options->initialize_one_to_one;
         ipopt.horizon = options->mip_horizon;
         ipopt.timeout = options->mip_timeout;
+        ipopt.warm_start = options->mip_warm_start;
+        ipopt.cache = &mip_cache;
 
         place_mip::detail::Algorithm ip;
         auto ipok = ip.run(k, ipopt, v2r); // compute mapping (in v2r) using ip model, may fail
@@ -880,45 +1495,228 @@ void Mapper::place(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r)
 
 }
 
+/**
+ * Initializes the given future window with the circuit of the given kernel,
+ * using a new scheduler for its dependency graph. Only the first num_released
+ * gates are released for mapping.
+ */
+void Mapper::start_future(
+    Future &future,
+    const ir::compat::KernelRef &k,
+    UInt num_released
+) const {
+
+    // Scheduler instance (from src/scheduler.h) used for its dependency graph.
+    utils::Ptr<Scheduler> sched;
+    sched.emplace();
+
+    future.initialize(platform, options);
+    future.set_kernel(k, sched, num_released);
+
+}
+
+/**
+ * Adds swaps to the given past that route the virtual qubits back to the real
+ * qubits they occupy in the given mapping. Virtual qubits that are not mapped
+ * in the given mapping may end up anywhere.
+ *
+ * This is a token swapping problem. The real qubits are fixed one by one in
+ * reverse breadth-first order of the topology, such that the unfixed qubits
+ * always remain connected; the virtual qubit that belongs in the qubit being
+ * fixed is moved there along a shortest path through the unfixed qubits. If
+ * no virtual qubit belongs there, the nearest unfixed qubit that does not
+ * hold a virtual qubit that must be restored is moved there instead.
+ */
+void Mapper::restore_to(Past &past, const com::map::QubitMapping &target) const {
+    com::map::QubitMapping current{nq, false, com::map::QubitState::NONE};
+    past.export_mapping(current);
+
+    // The virtual qubit currently at each real qubit, and whether each
+    // virtual qubit must be restored.
+    Vec<UInt> virt_at(nq);
+    Vec<Bool> restored(nq, false);
+    for (UInt r = 0; r < nq; r++) {
+        virt_at[r] = current.get_virtual(r);
+        UInt v = target.get_virtual(r);
+        if (v != com::map::UNDEFINED_QUBIT && current[v] != com::map::UNDEFINED_QUBIT) {
+            restored[v] = true;
+        }
+    }
+    auto is_free = [&](UInt r) {
+        return virt_at[r] == com::map::UNDEFINED_QUBIT || !restored[virt_at[r]];
+    };
+
+    // Order the real qubits breadth-first, per connected component.
+    const auto &topology = platform->topology;
+    Vec<UInt> order;
+    Vec<Bool> visited(nq, false);
+    for (UInt root = 0; root < nq; root++) {
+        if (visited[root]) continue;
+        visited[root] = true;
+        order.push_back(root);
+        for (UInt i = order.size() - 1; i < order.size(); i++) {
+            for (auto n : topology->get_neighbor_span(order[i])) {
+                if (!visited[n]) {
+                    visited[n] = true;
+                    order.push_back(n);
+                }
+            }
+        }
+    }
+
+    Vec<Bool> fixed(nq, false);
+    Vec<UInt> parent(nq);
+    for (auto it = order.rbegin(); it != order.rend(); ++it) {
+        UInt t = *it;
+        UInt v = target.get_virtual(t);
+        Bool wanted = v != com::map::UNDEFINED_QUBIT && restored[v];
+
+        // Search the unfixed qubits breadth-first from t for the qubit to
+        // move to t.
+        UInt source = com::map::UNDEFINED_QUBIT;
+        Vec<UInt> queue{t};
+        parent[t] = t;
+        Vec<Bool> seen(nq, false);
+        seen[t] = true;
+        for (UInt i = 0; i < queue.size() && source == com::map::UNDEFINED_QUBIT; i++) {
+            UInt r = queue[i];
+            if (wanted ? virt_at[r] == v : is_free(r)) {
+                source = r;
+                break;
+            }
+            for (auto n : topology->get_neighbor_span(r)) {
+                if (!seen[n] && !fixed[n]) {
+                    seen[n] = true;
+                    parent[n] = r;
+                    queue.push_back(n);
+                }
+            }
+        }
+        QL_ASSERT(source != com::map::UNDEFINED_QUBIT);
+
+        // Move it there.
+        for (UInt r = source; r != t; r = parent[r]) {
+            past.add_swap(r, parent[r]);
+            std::swap(virt_at[r], virt_at[parent[r]]);
+        }
+        fixed[t] = true;
+    }
+}
+
 /**
  * Map the kernel's circuit's gates in the provided context (v2r maps),
  * updating circuit and v2r maps.
  */
 void Mapper::route(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r) {
+    QL_TRACE_SCOPE("map.route");
+
+    // Long kernels may be routed in windows of stream_window gates to bound
+    // memory usage. This is only useful when the dependency graph is used.
+    // With lookahead_window, the windows overlap by half: only the first half
+    // of each window is mapped, while the second half only contributes to
+    // criticality and lookahead, and is mapped as part of the next window.
+    UInt window = options->stream_window;
+    UInt step = window;
+    if (options->lookahead_window > 0) {
+        window = options->lookahead_window;
+        step = (window + 1) / 2;
+    }
+    Bool streaming = (
+        window > 0
+        && options->lookahead_mode != LookaheadMode::DISABLED
+        && k->gates.size() > window
+    );
 
-    // Future window, presents input in available list.
+    // Future window, presents input in available list. When streaming, a
+    // future is made for each window instead, and the incoming circuit is
+    // kept here.
     Future future;
+    ir::compat::GateRefs input;
 
     // Past window, contains output schedule, storing all gates until taken out.
     Past past;
 
-    // Scheduler instance (from src/scheduler.h) used for its dependency graph.
-    utils::Ptr<Scheduler> sched;
-    sched.emplace();
-
     // Initialize the future window with the incoming circuit.
-    future.initialize(platform, options);
-    future.set_kernel(k, sched);
+    if (streaming) {
+        input = k->gates;
+    } else {
+        start_future(future, k);
+    }
 
     // Future has now copied kernel->c to private data, making kernel->c ready
     // for use by Past::new_gate(), for the kludge we need because gates can
     // only be constructed in the context of and at the end of a kernel.
     k->gates.reset();
     kernel = k;
-    past.initialize(kernel, options);
+    past.initialize(kernel, options, *resources);
+    past.set_profile(profile);
     past.import_mapping(v2r);
 
-    // Perform the actual mapping.
-    map_gates(future, past, past);
+    // Reset the SABRE decay factors.
+    sabre_decay.clear();
+    sabre_decay.resize(nq, 1.0);
+    sabre_decayed_qubits.clear();
 
-    // Flush all gates to the output window.
-    past.flush_all();
+    // The mapping the kernel starts with, for restoring it at the end.
+    com::map::QubitMapping v2r_start = v2r;
 
-    // Copy the gates into the kernel's circuit.
-    // mainPast.DPRINT("end mapping");
-    QL_DOUT("... retrieving outCirc from mainPast.outlg; swapping outCirc with kernel.c, kernel.c contains output circuit");
-    k->gates.reset();
-    past.flush_to_circuit(k->gates);
+    if (!streaming) {
+
+        // Perform the actual mapping.
+        map_gates(future, past, past);
+        if (restore_mapping) {
+            restore_to(past, v2r_start);
+        }
+
+        // Flush all gates to the output window.
+        past.flush_all();
+
+        // Copy the gates into the kernel's circuit.
+        // mainPast.DPRINT("end mapping");
+        QL_DOUT("... retrieving outCirc from mainPast.outlg; swapping outCirc with kernel.c, kernel.c contains output circuit");
+        k->gates.reset();
+        past.flush_to_circuit(k->gates);
+
+    } else {
+
+        // Map the circuit window by window. All gates of a window are mapped
+        // before the next window is started, so dependencies between windows
+        // are respected trivially, and the past (and thus the schedule and
+        // the qubit mapping) simply carries over. The dependency graph and
+        // criticality are thus only computed over a window, and the gates
+        // that the past has committed to are moved out after each window, so
+        // the memory used besides the input and output circuits is
+        // proportional to the window size. The input gates are released as
+        // they are handed to a window.
+        QL_DOUT("routing kernel " << k->name << " in windows of " << window << " gates, advancing by " << step);
+        ir::compat::GateRefs output;
+        auto &input_gates = input.get_vec();
+        for (UInt first = 0; first < input_gates.size(); first += step) {
+            auto window_kernel = ir::compat::KernelRef::make(
+                k->name, k->platform, k->qubit_count, k->creg_count, k->breg_count
+            );
+            UInt last = utils::min<UInt>(first + window, input_gates.size());
+            UInt released = utils::min<UInt>(step, last - first);
+            for (UInt i = first; i < last; i++) {
+                window_kernel->gates.add(input_gates[i]);
+            }
+            for (UInt i = first; i < first + released; i++) {
+                input_gates[i].reset();
+            }
+            Future window_future;
+            start_future(window_future, window_kernel, released);
+            map_gates(window_future, past, past);
+            past.flush_to_circuit(output);
+        }
+        if (restore_mapping) {
+            restore_to(past, v2r_start);
+        }
+        past.flush_all();
+        past.flush_to_circuit(output);
+        k->gates.reset();
+        k->gates.get_vec().swap(output.get_vec());
+
+    }
 
     // The mapper also schedules internally, including any decompositions it
     // does to make things primitive. Thus, cycle numbers are now valid.
@@ -947,7 +1745,7 @@ void Mapper::decompose_to_primitives(const ir::compat::KernelRef &k) {
 
     // Output window in which gates are scheduled.
     Past past;
-    past.initialize(k, options);
+    past.initialize(k, options, *resources);
 
     for (const auto &gate : circuit) {
 
@@ -971,6 +1769,87 @@ void Mapper::decompose_to_primitives(const ir::compat::KernelRef &k) {
     QL_DOUT("decompose_to_primitives circuit [DONE]");
 }
 
+/**
+ * Returns whether the given kernel can be mapped without routing, because the
+ * topology is fully connected and the kernel has no gates on more than two
+ * qubits.
+ */
+Bool Mapper::is_trivially_routable(const ir::compat::KernelRef &k) const {
+    if (!platform->topology->is_fully_connected()) {
+        return false;
+    }
+    for (const auto &gate : k->gates) {
+        if (gate->type() != ir::compat::GateType::CLASSICAL && gate->operands.size() > 2) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Replaces route() and decompose_to_primitives() for kernels that don't need
+ * routing: maps the gates of the kernel to their real qubits and decomposes
+ * them to primitives in a single pass, without building the future window and
+ * its dependency graph.
+ *
+ * No swaps are added, so the virtual qubits that were mapped at the start of
+ * the kernel are still in the same place at the end, and restore_mapping
+ * needs no special treatment.
+ */
+void Mapper::route_trivially(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r) {
+    QL_TRACE_SCOPE("map.route_trivially");
+    QL_DOUT("route_trivially circuit ...");
+
+    // Copy to allow kernel.c use by Past.new_gate.
+    ir::compat::GateRefs circuit = k->gates;
+    k->gates.reset();
+    kernel = k;
+
+    // Output window in which gates are scheduled.
+    Past past;
+    past.initialize(k, options, *resources);
+    past.set_profile(profile);
+    past.import_mapping(v2r);
+
+    ir::compat::GateRefs real_gates;
+    ir::compat::GateRefs prim_gates;
+    for (const auto &gate : circuit) {
+
+        // Classical gates have no qubits to map, so they are only made
+        // primitive, like decompose_to_primitives() does.
+        real_gates.reset();
+        if (gate->type() == ir::compat::GateType::CLASSICAL) {
+            real_gates.add(gate);
+        } else {
+            past.make_real(gate, real_gates);
+        }
+
+        // Decompose to primitives as specified in the config file, and
+        // schedule the result.
+        for (const auto &real_gate : real_gates) {
+            prim_gates.reset();
+            past.make_primitive(real_gate, prim_gates);
+            for (const auto &prim_gate : prim_gates) {
+                past.add_and_schedule(prim_gate);
+            }
+        }
+
+    }
+
+    // Update the output circuit based on the scheduling result.
+    past.flush_all();
+    past.flush_to_circuit(k->gates);
+    k->cycles_valid = true;
+
+    // The mapping may still have changed due to allocation of virtual qubits
+    // that weren't mapped yet.
+    past.export_mapping(v2r);
+    num_swaps_added = 0;
+    num_moves_added = 0;
+
+    QL_DOUT("route_trivially circuit [DONE]");
+}
+
 /**
  * Initialize the data structures in this class that don't change from
  * kernel to kernel.
@@ -980,6 +1859,7 @@ void Mapper::initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt)
     // QL_DOUT("... Grid initialization: platform qubits->coordinates, ->neighbors, distance ...");
     platform = p;
     options = opt;
+    resources.emplace(rmgr::Manager::from_defaults(p));
     nq = p->qubit_count;
     nc = p->creg_count;
     nb = p->breg_count;
@@ -1012,6 +1892,15 @@ void Mapper::map_kernel(const ir::compat::KernelRef &k) {
     QL_DOUT("... kernel original virtual number of qubits=" << k->qubit_count);
     kernel.reset();            // no new_gates until kernel.c has been copied
 
+    // Start with fresh performance counters, if requested, and without
+    // degradation.
+    degraded = false;
+    rng_decision = 0;
+    profile.reset();
+    if (options->write_profile) {
+        profile.emplace();
+    }
+
     QL_DOUT("Mapper::Map before v2r.initialize: assume_initialized=" << options->assume_initialized);
 
     // TODO: unify all incoming v2rs into v2r to compute kernel input mapping.
@@ -1033,13 +1922,33 @@ void Mapper::map_kernel(const ir::compat::KernelRef &k) {
     // Perform placement.
     place(k, v2r);
 
+    // When the topology is fully connected, every two-qubit gate is already
+    // nearest-neighbor, so routing and the placement refinement it drives
+    // amount to mapping the gates to their real qubits.
+    Bool trivial = is_trivially_routable(k);
+    if (trivial) {
+        QL_DOUT("kernel " << k->name << " needs no routing");
+    }
+
+    // The SABRE heuristic refines the placement by routing the circuit back
+    // and forth.
+    if (!trivial && options->heuristic == Heuristic::SABRE) {
+        SabrePlacer placer;
+        placer.initialize(platform, options);
+        placer.refine(k, v2r);
+    }
+
     // Save the placed qubit map for reporting. This is the resulting qubit map
     // at the *start* of the kernel.
     v2r_ip = v2r;
 
     // Perform heuristic routing.
     QL_DOUT("Mapper::Map before route: assume_initialized=" << options->assume_initialized);
-    route(k, v2r);        // updates kernel.c with swaps, maps all gates, updates v2r map
+    if (trivial) {
+        route_trivially(k, v2r);
+    } else {
+        route(k, v2r);        // updates kernel.c with swaps, maps all gates, updates v2r map
+    }
     QL_IF_LOG_DEBUG {
         QL_DOUT("After heuristics");
         v2r.dump_state();
@@ -1050,7 +1959,10 @@ void Mapper::map_kernel(const ir::compat::KernelRef &k) {
     v2r_out = v2r;
 
     // Decompose to primitive instructions as specified in the config file.
-    decompose_to_primitives(k);
+    // This was already done for trivially routable kernels.
+    if (!trivial) {
+        decompose_to_primitives(k);
+    }
 
     k->qubit_count = nq;       // bluntly copy nq (==#real qubits), so that all kernels get the same qubit_count
     k->creg_count = nc;        // same for number of cregs and bregs, although we don't really map those
@@ -1059,12 +1971,143 @@ void Mapper::map_kernel(const ir::compat::KernelRef &k) {
     QL_DOUT("Mapping kernel " << k->name << " [DONE]");
 }
 
+/**
+ * Returns the depth in cycles of the given kernel, which must have valid
+ * cycle numbers.
+ */
+static UInt get_kernel_depth(const ir::compat::KernelRef &k, UInt cycle_time) {
+    if (k->gates.empty()) {
+        return 0;
+    }
+    UInt start = ir::compat::MAX_CYCLE;
+    UInt end = 0;
+    for (const auto &gate : k->gates) {
+        start = utils::min(start, gate->cycle);
+        end = utils::max(end, gate->cycle + utils::div_ceil(gate->duration, cycle_time));
+    }
+    return end - start;
+}
+
+/**
+ * Maps the given kernel multiple times as specified by the multi_start
+ * option, each time using a mapper with a differently seeded random
+ * number generator, and keeps the best result according to the
+ * multi_start_metric option. The runs operate on private copies of the
+ * kernel, so they can be performed concurrently; the statistics of the
+ * best run are copied into this mapper.
+ */
+void Mapper::map_kernel_multi_start(const ir::compat::KernelRef &k) {
+    UInt num_runs = options->multi_start_runs;
+    QL_DOUT("multi-start mapping of kernel " << k->name << " using " << num_runs << " runs");
+
+    // Make a mapper and a copy of the kernel for each run. The copies share
+    // the gates with the original kernel, but the mapper only reads those
+    // and builds a new gate list.
+    Vec<Mapper> run_mappers(num_runs, *this);
+    Vec<ir::compat::KernelRef> run_kernels;
+    for (UInt i = 0; i < num_runs; i++) {
+        run_mappers[i].rng_seed = utils::Philox::derive_seed(rng_seed, i);
+        auto run_kernel = ir::compat::KernelRef::make(
+            k->name, k->platform, k->qubit_count, k->creg_count, k->breg_count
+        );
+        run_kernel->gates = k->gates;
+        run_kernels.push_back(run_kernel);
+    }
+
+    // Perform the runs.
+    parallel_for(num_runs, options->num_multi_start_threads, [&](UInt i) {
+        run_mappers[i].map_kernel(run_kernels[i]);
+    });
+
+    // Select the best run.
+    UInt best = 0;
+    UInt best_score = utils::MAX;
+    for (UInt i = 0; i < num_runs; i++) {
+        UInt score;
+        if (options->multi_start_metric == MultiStartMetric::DEPTH) {
+            score = get_kernel_depth(run_kernels[i], cycle_time);
+        } else {
+            score = run_mappers[i].num_swaps_added;
+        }
+        QL_DOUT("multi-start run " << i << " scored " << score);
+        if (score < best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+    QL_DOUT("multi-start mapping selected run " << best);
+
+    // Take the result of the best run.
+    const auto &best_kernel = run_kernels[best];
+    k->gates = best_kernel->gates;
+    k->cycles_valid = best_kernel->cycles_valid;
+    k->qubit_count = best_kernel->qubit_count;
+    k->creg_count = best_kernel->creg_count;
+    k->breg_count = best_kernel->breg_count;
+    const auto &best_mapper = run_mappers[best];
+    num_swaps_added = best_mapper.num_swaps_added;
+    num_moves_added = best_mapper.num_moves_added;
+    v2r_in = best_mapper.v2r_in;
+    v2r_ip = best_mapper.v2r_ip;
+    v2r_out = best_mapper.v2r_out;
+    profile = best_mapper.profile;
+}
+
+/**
+ * Returns a string that uniquely identifies the mapper input of the given
+ * kernel, for detecting kernels that need not be mapped more than once.
+ */
+static Str get_kernel_fingerprint(const ir::compat::KernelRef &k) {
+    StrStrm ss;
+    ss << std::setprecision(17);
+    ss << k->qubit_count << ' ' << k->creg_count << ' ' << k->breg_count << '\n';
+    for (const auto &gate : k->gates) {
+        ss << gate->type() << ' ' << gate->name;
+        ss << " q" << gate->operands;
+        ss << " c" << gate->creg_operands;
+        ss << " b" << gate->breg_operands;
+        ss << ' ' << gate->condition << gate->cond_operands;
+        ss << ' ' << gate->int_operand << ' ' << gate->duration << ' ' << gate->angle;
+        ss << ' ' << gate->swap_params.part_of_swap << '\n';
+    }
+    return ss.str();
+}
+
+/**
+ * Replaces the gates of the given kernel with copies of the mapped gates of
+ * the given original kernel, which must have had the same gates as k before
+ * mapping. Returns false without modifying k if the mapped gates can't be
+ * copied; only gates defined by the platform configuration can.
+ */
+static Bool replay_kernel(const ir::compat::KernelRef &original, const ir::compat::KernelRef &k) {
+    for (const auto &gate : original->gates) {
+        if (gate->type() != ir::compat::GateType::CUSTOM) {
+            return false;
+        }
+    }
+    ir::compat::GateRefs gates;
+    for (const auto &gate : original->gates) {
+        gates.add(ir::compat::GateRef::make<ir::compat::gate_types::Custom>(
+            static_cast<const ir::compat::gate_types::Custom&>(*gate)
+        ));
+    }
+    k->gates = gates;
+    k->cycles_valid = original->cycles_valid;
+    k->qubit_count = original->qubit_count;
+    k->creg_count = original->creg_count;
+    k->breg_count = original->breg_count;
+    return true;
+}
+
 /**
  * Runs mapping for the given program.
  *
  * TODO: inter-kernel mapping is NOT SUPPORTED; each kernel is mapped
  *  individually. That means that the resulting program is garbage if any
  *  quantum state was originally maintained from kernel to kernel!
+ *
+ * Because the kernels are independent, they can be mapped concurrently; the
+ * number of threads used for this is controlled by the kernel_threads option.
  */
 void Mapper::map(const ir::compat::ProgramRef &prog, const OptionsRef &opt) {
 
@@ -1074,47 +2117,185 @@ void Mapper::map(const ir::compat::ProgramRef &prog, const OptionsRef &opt) {
     // Perform program-wide initialization.
     initialize(prog->platform, opt);
 
-    // Map kernel by kernel, adding statistics all the while.
-    UInt total_swaps = 0;
-    UInt total_moves = 0;
-    Real total_time_taken = 0.0;
-    for (const auto &k : prog->kernels) {
+    // Maps a single kernel with the given mapper, returning the time taken.
+    auto map_kernel_timed = [](Mapper &mapper, const ir::compat::KernelRef &k) {
         QL_IOUT("Mapping kernel: " << k->name);
 
         // Start interval timer for measuring time taken for this kernel.
-        Real time_taken = 0.0;
         using namespace std::chrono;
         high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
         // Actually do the mapping.
-        map_kernel(k);
+        if (mapper.options->multi_start_runs > 1) {
+            mapper.map_kernel_multi_start(k);
+        } else {
+            mapper.map_kernel(k);
+        }
 
         // Stop the interval timer.
         high_resolution_clock::time_point t2 = high_resolution_clock::now();
         duration<Real> time_span = t2 - t1;
-        time_taken = time_span.count();
+        return time_span.count();
+    };
+
+    // Pushes the statistics left behind by the given mapper for the given
+    // kernel into the kernel, and updates the totals.
+    UInt total_swaps = 0;
+    UInt total_moves = 0;
+    Real total_time_taken = 0.0;
+    auto push_statistics = [&](const Mapper &mapper, const ir::compat::KernelRef &k, Real time_taken) {
 
         // Push mapping statistics into the kernel.
-        AdditionalStats::push(k, "swaps added: " + to_string(num_swaps_added));
-        AdditionalStats::push(k, "of which moves added: " + to_string(num_moves_added));
-        AdditionalStats::push(k, "virt2real map before mapper:" + to_string(v2r_in.get_virt_to_real()));
-        AdditionalStats::push(k, "virt2real map after initial placement:" + to_string(v2r_ip.get_virt_to_real()));
-        AdditionalStats::push(k, "virt2real map after mapper:" + to_string(v2r_out.get_virt_to_real()));
-        AdditionalStats::push(k, "realqubit states before mapper:" + to_string(v2r_in.get_state()));
-        AdditionalStats::push(k, "realqubit states after mapper:" + to_string(v2r_out.get_state()));
-        AdditionalStats::push(k, "time taken: " + to_string(time_taken));
+        static const utils::InternedStr SWAPS_ADDED{"swaps added"};
+        static const utils::InternedStr MOVES_ADDED{"of which moves added"};
+        static const utils::InternedStr TIME_TAKEN{"time taken"};
+        auto &stats = AdditionalStats::get(k);
+        stats.counter(SWAPS_ADDED) += mapper.num_swaps_added;
+        stats.counter(MOVES_ADDED) += mapper.num_moves_added;
+        AdditionalStats::push(k, "virt2real map before mapper:" + to_string(mapper.v2r_in.get_virt_to_real()));
+        AdditionalStats::push(k, "virt2real map after initial placement:" + to_string(mapper.v2r_ip.get_virt_to_real()));
+        AdditionalStats::push(k, "virt2real map after mapper:" + to_string(mapper.v2r_out.get_virt_to_real()));
+        AdditionalStats::push(k, "realqubit states before mapper:" + to_string(mapper.v2r_in.get_state()));
+        AdditionalStats::push(k, "realqubit states after mapper:" + to_string(mapper.v2r_out.get_state()));
+        stats.timer(TIME_TAKEN) += time_taken;
+
+        // Write the performance counters, if requested.
+        if (mapper.profile) {
+            mapper.profile->write_json(
+                options->output_prefix + "_" + k->name + "_profile.json",
+                k->name, mapper.num_swaps_added, mapper.num_moves_added, time_taken
+            );
+        }
 
         // Update total statistical counters.
-        total_swaps += num_swaps_added;
-        total_moves += num_moves_added;
+        total_swaps += mapper.num_swaps_added;
+        total_moves += mapper.num_moves_added;
         total_time_taken += time_taken;
 
+    };
+
+    // Find kernels that have the same gates as an earlier kernel, such as the
+    // kernels of an unrolled loop. Every kernel starts from the same initial
+    // mapping, so these can reuse the mapping result of the first copy.
+    // first_copy[i] is that first copy for kernel i, or i itself if there is
+    // none.
+    UInt num_kernels = prog->kernels.size();
+
+    // Loops are kept rolled, so the kernels of a loop body are mapped once.
+    // When requested, those kernels restore their starting mapping at the
+    // end, such that each iteration starts with the same mapping.
+    Vec<Bool> restore(num_kernels, false);
+    if (options->loop_invariant_mapping) {
+        UInt loop_depth = 0;
+        for (UInt i = 0; i < num_kernels; i++) {
+            switch (prog->kernels[i]->type) {
+                case ir::compat::KernelType::FOR_START:
+                case ir::compat::KernelType::DO_WHILE_START:
+                    loop_depth++;
+                    break;
+                case ir::compat::KernelType::FOR_END:
+                case ir::compat::KernelType::DO_WHILE_END:
+                    if (loop_depth > 0) loop_depth--;
+                    break;
+                default:
+                    restore[i] = loop_depth > 0;
+                    break;
+            }
+        }
+    }
+
+    Vec<UInt> first_copy(num_kernels);
+    Vec<Bool> is_repeated(num_kernels, false);
+    HashMap<Str, UInt> fingerprints;
+    for (UInt i = 0; i < num_kernels; i++) {
+        first_copy[i] = i;
+        if (options->reuse_routing && !options->write_dot_graphs) {
+            auto fingerprint = get_kernel_fingerprint(prog->kernels[i]);
+            if (restore[i]) {
+                fingerprint += "restore";
+            }
+            first_copy[i] = fingerprints.insert({fingerprint, i}).first->second;
+        }
+        if (first_copy[i] != i) {
+            is_repeated[first_copy[i]] = true;
+        }
+    }
+
+    UInt num_threads = utils::min(resolve_num_threads(options->num_kernel_threads), num_kernels);
+    if (num_threads <= 1) {
+
+        // Map kernel by kernel, adding statistics all the while. The state of
+        // the mapper is saved for kernels that are repeated later, so the
+        // statistics can be reported again for the copies.
+        Map<UInt, Mapper> originals;
+        for (UInt i = 0; i < num_kernels; i++) {
+            const auto &k = prog->kernels[i];
+            auto it = originals.find(first_copy[i]);
+            if (it != originals.end() && replay_kernel(prog->kernels[first_copy[i]], k)) {
+                QL_IOUT("Reusing mapping of kernel " << prog->kernels[first_copy[i]]->name << " for kernel " << k->name);
+                push_statistics(it->second, k, 0.0);
+                continue;
+            }
+            restore_mapping = restore[i];
+            rng_kernel = i;
+            push_statistics(*this, k, map_kernel_timed(*this, k));
+            if (is_repeated[i]) {
+                originals.emplace(i, *this);
+            }
+        }
+
+    } else {
+
+        // Kernels are mapped independently, so we can map them concurrently.
+        // Each kernel gets its own copy of this mapper, because the mapper
+        // keeps per-kernel state (which also includes the Past and Future
+        // objects that live in route()). Their random number streams are
+        // selected by kernel index, so the result doesn't depend on how the
+        // kernels are distributed over the threads.
+        QL_DOUT("mapping " << num_kernels << " kernels using " << num_threads << " threads");
+        Vec<Mapper> kernel_mappers(num_kernels, *this);
+        for (UInt i = 0; i < num_kernels; i++) {
+            kernel_mappers[i].rng_kernel = i;
+            kernel_mappers[i].restore_mapping = restore[i];
+        }
+        Vec<Real> times_taken(num_kernels, 0.0);
+        parallel_for(num_kernels, num_threads, [&](UInt i) {
+            if (first_copy[i] == i) {
+                times_taken[i] = map_kernel_timed(kernel_mappers[i], prog->kernels[i]);
+            }
+        });
+
+        // Copy the results for repeated kernels, mapping the ones that can't
+        // be copied after all.
+        Vec<UInt> result_of(first_copy);
+        for (UInt i = 0; i < num_kernels; i++) {
+            if (first_copy[i] == i) {
+                continue;
+            }
+            const auto &k = prog->kernels[i];
+            if (replay_kernel(prog->kernels[first_copy[i]], k)) {
+                QL_IOUT("Reusing mapping of kernel " << prog->kernels[first_copy[i]]->name << " for kernel " << k->name);
+            } else {
+                times_taken[i] = map_kernel_timed(kernel_mappers[i], k);
+                result_of[i] = i;
+            }
+        }
+
+        // Merge the statistics in program order.
+        for (UInt i = 0; i < num_kernels; i++) {
+            push_statistics(kernel_mappers[result_of[i]], prog->kernels[i], times_taken[i]);
+        }
+
     }
 
     // Push mapping statistics into the program.
-    AdditionalStats::push(prog, "Total no. of swaps: " + to_string(total_swaps));
-    AdditionalStats::push(prog, "Total no. of moves of swaps: " + to_string(total_moves));
-    AdditionalStats::push(prog, "Total time taken: " + to_string(total_time_taken));
+    static const utils::InternedStr TOTAL_SWAPS{"Total no. of swaps"};
+    static const utils::InternedStr TOTAL_MOVES{"Total no. of moves of swaps"};
+    static const utils::InternedStr TOTAL_TIME_TAKEN{"Total time taken"};
+    auto &stats = AdditionalStats::get(prog);
+    stats.counter(TOTAL_SWAPS) += total_swaps;
+    stats.counter(TOTAL_MOVES) += total_moves;
+    stats.timer(TOTAL_TIME_TAKEN) += total_time_taken;
 
     // Kernel qubit/creg/breg counts will have been updated to the platform
     // counts, so we need to do the same for the program.
@@ -9,15 +9,21 @@
 #include "ql/utils/str.h"
 #include "ql/utils/vec.h"
 #include "ql/utils/list.h"
+#include "ql/utils/arena.h"
 #include "ql/utils/map.h"
+#include "ql/utils/pair.h"
 #include "ql/utils/progress.h"
+#include "ql/utils/rng.h"
 #include "ql/ir/compat/compat.h"
 #include "ql/com/map/qubit_mapping.h"
+#include "ql/pass/map/qubits/place_mip/detail/algorithm.h"
 #include "options.h"
 #include "free_cycle.h"
 #include "past.h"
 #include "alter.h"
 #include "future.h"
+#include "sabre.h"
+#include "profile.h"
 
 namespace ql {
 namespace pass {
@@ -211,6 +217,14 @@ std::ostream &operator<<(std::ostream &os, PathStrategy p);
  * Past's context.
  */
 class Mapper {
+public:
+
+    /**
+     * The limit on the number of alternative routing solutions generated per
+     * routing step once the compile-time budget is exhausted.
+     */
+    static constexpr utils::UInt DEGRADED_MAX_ALTERS = 4;
+
 private:
 
     /**
@@ -230,6 +244,13 @@ private:
      */
     OptionsRef options;
 
+    /**
+     * Resource manager for the platform, built once by initialize() and
+     * shared by all pasts, such that the resources are only initialized once
+     * rather than for every past and routing alternative.
+     */
+    rmgr::CRef resources;
+
     /**
      * Number of qubits in the platform, i.e. the number of real qubits.
      */
@@ -252,15 +273,44 @@ private:
     utils::UInt cycle_time;
 
     /**
-     * Random-number generator for the "random" tie-breaking option.
+     * Random-number generator for the "random" tie-breaking and path
+     * selection options. It is reset to a new stream for each routing
+     * decision by map_gates(), identified by rng_kernel and rng_decision, so
+     * the numbers drawn don't depend on how kernels and runs are distributed
+     * over threads.
+     */
+    utils::Philox rng;
+
+    /**
+     * Seed for rng, from the seed option or the current time, and derived
+     * from that for each run when multi_start is used.
      */
-    std::mt19937 rng;
+    utils::UInt rng_seed = 0;
+
+    /**
+     * Index of the kernel currently being mapped, used to select the stream
+     * of rng.
+     */
+    utils::UInt rng_kernel = 0;
+
+    /**
+     * Index of the current routing decision within the current kernel, used
+     * to select the stream of rng.
+     */
+    utils::UInt rng_decision = 0;
 
     /**
      * Routing progress tracker.
      */
     utils::Progress routing_progress;
 
+    /**
+     * Scratch arena for the lists of alternatives generated while routing a
+     * single gate. It is created anew by map_gates() and reset after each
+     * routed gate.
+     */
+    utils::ArenaRef scratch;
+
     /**
      * Number of swaps added (including moves) to the most recently mapped
      * kernel, set by map_kernel().
@@ -273,6 +323,55 @@ private:
      */
     utils::UInt num_moves_added;
 
+    /**
+     * Whether the compile-time budget was found to be exhausted while routing
+     * the current kernel. When set, the MIN_EXTEND[_RC] and MAX_FIDELITY
+     * heuristics behave like BASE, and max_alters is limited to
+     * DEGRADED_MAX_ALTERS. Set by check_time_budget().
+     */
+    utils::Bool degraded = false;
+
+    /**
+     * Whether the mapping at the end of the current kernel must be routed
+     * back to the mapping at its start, such that the kernel can be repeated
+     * by an enclosing loop. Set by map() for the kernels of loop bodies
+     * when the loop_invariant_mapping option is set.
+     */
+    utils::Bool restore_mapping = false;
+
+    /**
+     * Decay factor for each real qubit, used by the SABRE heuristic to
+     * discourage swapping the same qubits over and over again. Reset to 1 for
+     * all qubits whenever a routed gate is mapped.
+     */
+    utils::Vec<utils::Real> sabre_decay;
+
+    /**
+     * The real qubits for which sabre_decay is currently not 1, so they can be
+     * reset without iterating over all qubits.
+     */
+    utils::Vec<utils::UInt> sabre_decayed_qubits;
+
+#ifdef INITIALPLACE
+    /**
+     * Placements found by the MIP-based placer for the kernels mapped by this
+     * mapper thus far, indexed by their model.
+     */
+    place_mip::detail::Cache mip_cache;
+
+    /**
+     * Cache for get_swap_profile(), keyed by the ordered pair of operands.
+     * The profiles only depend on the platform and the options.
+     */
+    utils::Map<utils::Pair<utils::UInt, utils::UInt>, SwapProfile> swap_profiles;
+#endif
+
+    /**
+     * Performance counters for the most recently mapped kernel, set by
+     * map_kernel(). Empty when the write_profile option is disabled.
+     */
+    ProfileRef profile;
+
     /**
      * Qubit mapping before mapping, set by map_kernel().
      */
@@ -293,9 +392,24 @@ private:
         utils::RawPtr<Path> prev;
     };
 
+    /**
+     * Sets degraded and reports this if the compile-time budget has been
+     * exhausted.
+     */
+    void check_time_budget();
+
+    /**
+     * Returns the limit on the number of alternative routing solutions to
+     * generate per routing step, or 0 if there is none, taking degradation
+     * into account.
+     */
+    utils::UInt get_max_alters() const;
+
     /**
      * Find shortest paths between src and tgt in the grid, bounded by a
-     * particular strategy. path is a linked-list node representing the complete
+     * particular strategy. dag is the path DAG for the original src and tgt
+     * qubits and budget, as returned by Topology::get_path_dag(); the next hops
+     * are taken from it. path is a linked-list node representing the complete
      * path from the initial src qubit to src in reverse order, not including src;
      * it will be null for the initial call. budget is the maximum number of hops
      * allowed in the path from src and is at least distance to tgt, but can be
@@ -311,11 +425,12 @@ private:
      */
     void gen_shortest_paths(
         const ir::compat::GateRef &gate,
+        const com::Topology::PathDag &dag,
         utils::RawPtr<Path> path,
         utils::UInt src,
         utils::UInt tgt,
         utils::UInt budget,
-        utils::List<Alter> &alters,
+        Alters &alters,
         utils::UInt max_alters,
         PathStrategy strategy
     );
@@ -346,7 +461,20 @@ private:
         const ir::compat::GateRef &gate,
         utils::UInt src,
         utils::UInt tgt,
-        utils::List<Alter> &alters
+        Alters &alters
+    );
+
+    /**
+     * Removes the alternatives in alters from index first onward that result
+     * in the same placement of the virtual qubits (as mapped in past) as an
+     * earlier alternative from that index onward. Swaps that only move
+     * unmapped real qubits around thus don't distinguish alternatives. The
+     * first alternative of each class is kept, so this is deterministic.
+     */
+    void prune_equivalent_alters(
+        Alters &alters,
+        utils::UInt first,
+        const Past &past
     );
 
     /**
@@ -357,7 +485,7 @@ private:
      */
     void gen_alters_gate(
         const ir::compat::GateRef &gate,
-        utils::List<Alter> &alters,
+        Alters &alters,
         Past &past
     );
 
@@ -370,20 +498,27 @@ private:
      */
     void gen_alters(
         const utils::List<ir::compat::GateRef> &gates,
-        utils::List<Alter> &alters,
+        Alters &alters,
         Past &past
     );
 
     /**
-     * Seeds the random number generator with the current time in microseconds.
+     * Determines the seed for the random number generator, using the seed
+     * option if set or the current time in microseconds otherwise.
      */
     void random_init();
 
+    /**
+     * Resets the random number generator to the stream for the next routing
+     * decision of the current kernel.
+     */
+    void random_next_decision();
+
     /**
      * Chooses an Alter from the list based on the configured tie-breaking
      * strategy.
      */
-    Alter tie_break_alter(utils::List<Alter> &alters, Future &future);
+    Alter tie_break_alter(Alters &alters, Future &future);
 
     /**
      * Map the gate/operands of a gate that has been routed or doesn't require
@@ -396,9 +531,10 @@ private:
      * of future when done with it. Depending on configuration, this might not
      * actually place the target gate for the given alternative yet, because
      * only part of the swap chain is generated; in this case, swaps are added
-     * to past, but future is not updated.
+     * to past, but future is not updated. Returns whether the target gate was
+     * placed.
      */
-    void commit_alter(Alter &alter, Future &future, Past &past);
+    utils::Bool commit_alter(Alter &alter, Future &future, Past &past);
 
     /**
      * Find gates available for scheduling that do not require routing, take
@@ -434,6 +570,94 @@ private:
         utils::Bool also_nn_two_qubit_gates
     );
 
+    /**
+     * Returns the cached profile of the swap that Past::add_swap() inserts for
+     * the given operands, after any reversal. The profile is made using the
+     * given past when it isn't cached yet.
+     */
+    const SwapProfile &get_swap_profile(const Past &past, utils::UInt r0, utils::UInt r1);
+
+    /**
+     * Scores all the given alternatives relative to base_past as
+     * Alter::extend() on top of past would, but without cloning past for
+     * each of them. The swap chains of all alternatives are flattened into
+     * structure-of-arrays form, recording for each swap the gates it adds (as
+     * a swap profile) and the base free cycle of the qubit it moves the state
+     * into. The free cycle of the qubit carrying the state of each chain is
+     * then propagated through these arrays for all chains in lockstep. This
+     * relies on the free cycles only depending on gate dependencies, so it is
+     * only done for the non-resource-constrained heuristics, and without move
+     * gates, which depend on more of the state. Returns false without
+     * touching the alternatives when this isn't possible or the batch_scoring
+     * option is disabled. The speculative pasts of the alternatives are left
+     * empty; they would only be used to compute the scores anyway.
+     */
+    utils::Bool score_alters_batched(
+        Alters &alters,
+        const Past &past,
+        const Past &base_past
+    );
+
+    /**
+     * Extends all the given alternatives on top of past (see Alter::extend()),
+     * computing their scores relative to base_past. When the batch_scoring
+     * option allows for it, they are only scored using
+     * score_alters_batched(). Otherwise, when the route_threads option allows
+     * for it, the alternatives are evaluated concurrently. This does not
+     * affect the result, because each alternative only modifies its own
+     * private copy of the past.
+     */
+    void extend_alters(
+        Alters &alters,
+        const Past &past,
+        const Past &base_past
+    );
+
+    /**
+     * Select an Alter using the SABRE heuristic. Each alternative is scored by
+     * the SABRE lookahead cost (see compute_sabre_cost()) of the two-qubit
+     * gates in the available gate list and the extended window returned by
+     * Future::get_lookahead_gates(), after applying all its swaps to the
+     * current mapping of past, multiplied by the largest decay factor of the
+     * qubits it swaps. The tie-breaking strategy is applied to the
+     * alternatives with the lowest score.
+     */
+    void select_alter_sabre(
+        Alters &alters,
+        Alter &result,
+        Future &future,
+        const Past &past
+    );
+
+    /**
+     * Select an Alter using beam search, for the MIN_EXTEND[_RC] heuristics
+     * when beam_width is nonzero. Rather than recursing into the good
+     * alternatives, this keeps the beam_width best speculative states per
+     * routing step. Each state consists of a future and past with the swaps of
+     * one alternative per step committed, and is ranked by its cycle extension
+     * relative to base_past plus beam_lookahead_weight times the number of
+     * swaps that the gates that still need routing need at least. The search
+     * ends after recursion_depth_limit + 1 steps or when all states reach the
+     * end of the circuit, after which the tie-breaking strategy is applied to
+     * the alternatives (of the current step) that the best-ranked states
+     * started with. The runtime thus grows linearly with the beam width and
+     * the number of steps.
+     */
+    void select_alter_beam(
+        Alters &alters,
+        Alter &result,
+        Future &future,
+        Past &past,
+        const Past &base_past
+    );
+
+    /**
+     * Updates the SABRE decay factors after the given alternative has been
+     * committed. If its target gate was placed, all decay factors are reset.
+     * Otherwise, the decay factors of the qubits it swapped are increased.
+     */
+    void update_sabre_decay(const Alter &alter, utils::Bool target_placed);
+
     /**
      * Select an Alter based on the selected heuristic.
      *
@@ -443,12 +667,16 @@ private:
      *    of the given past (or some factor of that amount, ordered by
      *    increasing cycle extension) and recurse. When the recursion depth
      *    limit is reached, apply the tie-breaking strategy.
+     *  - If SABRE, defer to select_alter_sabre().
+     *
+     * For MIN_EXTEND[_RC], the recursion is replaced by beam search (see
+     * select_alter_beam()) when beam_width is nonzero.
      *
      * For recursion, past is the speculative past, and base_past is the past
      * we've already committed to, and should thus measure fitness against.
      */
     void select_alter(
-        utils::List<Alter> &alters,
+        Alters &alters,
         Alter &result,
         Future &future,
         Past &past,
@@ -470,9 +698,29 @@ private:
      */
     void place(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r);
 
+    /**
+     * Initializes the given future window with the circuit of the given
+     * kernel, using a new scheduler for its dependency graph. Only the first
+     * num_released gates are released for mapping.
+     */
+    void start_future(
+        Future &future,
+        const ir::compat::KernelRef &k,
+        utils::UInt num_released = utils::MAX
+    ) const;
+
+    /**
+     * Adds swaps to the given past that route the virtual qubits back to the
+     * real qubits they occupy in the given mapping. Virtual qubits that are
+     * not mapped in the given mapping may end up anywhere.
+     */
+    void restore_to(Past &past, const com::map::QubitMapping &target) const;
+
     /**
      * Map the kernel's circuit's gates in the provided context (v2r maps),
-     * updating circuit and v2r maps.
+     * updating circuit and v2r maps. When the stream_window or
+     * lookahead_window option is set and the kernel is longer than that, this
+     * is done window by window.
      */
     void route(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r);
 
@@ -482,6 +730,21 @@ private:
      */
     void decompose_to_primitives(const ir::compat::KernelRef &k);
 
+    /**
+     * Returns whether the given kernel can be mapped without routing, because
+     * the topology is fully connected and the kernel has no gates on more
+     * than two qubits.
+     */
+    utils::Bool is_trivially_routable(const ir::compat::KernelRef &k) const;
+
+    /**
+     * Replaces route() and decompose_to_primitives() for kernels that don't
+     * need routing: maps the gates of the kernel to their real qubits and
+     * decomposes them to primitives in a single pass, without building the
+     * future window and its dependency graph.
+     */
+    void route_trivially(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r);
+
     /**
      * Initialize the data structures in this class that don't change from
      * kernel to kernel.
@@ -507,6 +770,16 @@ private:
      */
     void map_kernel(const ir::compat::KernelRef &k);
 
+    /**
+     * Maps the given kernel multiple times as specified by the multi_start
+     * option, each time using a mapper with a differently seeded random
+     * number generator, and keeps the best result according to the
+     * multi_start_metric option. The runs operate on private copies of the
+     * kernel, so they can be performed concurrently; the statistics of the
+     * best run are copied into this mapper.
+     */
+    void map_kernel_multi_start(const ir::compat::KernelRef &k);
+
 public:
 
     /**
@@ -515,6 +788,9 @@ public:
      * TODO: inter-kernel mapping is NOT SUPPORTED; each kernel is mapped
      *  individually. That means that the resulting program is garbage if any
      *  quantum state was originally maintained from kernel to kernel!
+     *
+     * Because the kernels are independent, they can be mapped concurrently; the
+     * number of threads used for this is controlled by the kernel_threads option.
      */
     void map(const ir::compat::ProgramRef &prog, const OptionsRef &opt);
 
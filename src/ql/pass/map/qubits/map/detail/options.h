@@ -52,7 +52,21 @@ enum class Heuristic {
     /**
      * No longer supported?
      */
-    MAX_FIDELITY
+    MAX_FIDELITY,
+
+    /**
+     * SABRE-style lookahead heuristic. Alternatives are scored by the average
+     * distance between the operands of the two-qubit gates in the front layer
+     * (the available gates) after applying the alternative's swaps, plus a
+     * weighted average for an extended window of upcoming two-qubit gates
+     * taken from the dependency graph, multiplied by a decay factor that
+     * discourages repeatedly swapping the same qubits. No speculation or
+     * scheduling is done to score alternatives, so routing time is linear in
+     * the number of gates. Optionally, the initial placement is refined
+     * first by alternating forward and reverse routing passes over the
+     * two-qubit gates of the kernel.
+     */
+    SABRE
 
 };
 
@@ -171,6 +185,29 @@ enum class TieBreakMethod {
  */
 std::ostream &operator<<(std::ostream &os, TieBreakMethod tbm);
 
+/**
+ * Metrics for selecting the best result when the mapper is run multiple
+ * times per kernel (see the multi_start option).
+ */
+enum class MultiStartMetric {
+
+    /**
+     * Keep the result with the fewest swaps and moves added.
+     */
+    SWAPS,
+
+    /**
+     * Keep the result with the lowest circuit depth in cycles.
+     */
+    DEPTH
+
+};
+
+/**
+ * String conversion for MultiStartMetric.
+ */
+std::ostream &operator<<(std::ostream &os, MultiStartMetric msm);
+
 /**
  * Main options structure.
  */
@@ -214,12 +251,67 @@ struct Options {
     utils::Real mip_timeout = 0.0;
 
     /**
-     * The placement algorithm will only consider the connectivity required to
-     * perform the first horizon two-qubit gates of a kernel. 0 means that all
-     * gates should be considered.
+     * The MIP-based and annealing placement algorithms will only consider the
+     * connectivity required to perform the first horizon two-qubit gates of a
+     * kernel. 0 means that all gates should be considered.
      */
     utils::UInt mip_horizon = 0;
 
+    /**
+     * Controls whether the MIP-based placer should be warm-started from the
+     * incoming mapping.
+     */
+    utils::Bool mip_warm_start = true;
+
+    /**
+     * Controls whether simulated-annealing-based placement should be attempted
+     * before resorting to heuristic routing. Uses mip_horizon as well.
+     */
+    utils::Bool enable_anneal_placer = false;
+
+    /**
+     * The number of simulated annealing moves per chain and per interacting
+     * virtual qubit for the annealing placer.
+     */
+    utils::UInt anneal_moves_per_qubit = 1000;
+
+    /**
+     * The number of independent simulated annealing chains for the annealing
+     * placer.
+     */
+    utils::UInt anneal_chains = 4;
+
+    /**
+     * The maximum number of threads used to run the annealing chains, or 0 to
+     * use all hardware threads.
+     */
+    utils::UInt num_anneal_threads = 1;
+
+    /**
+     * Timeout for the annealing placer in seconds, or 0 to disable timeout.
+     */
+    utils::Real anneal_timeout = 0.0;
+
+    /**
+     * Controls whether the virtual qubits should be partitioned over the cores
+     * of a multi-core platform to minimize inter-core communication before
+     * routing.
+     */
+    utils::Bool enable_core_partitioner = false;
+
+    /**
+     * The core partitioner will only consider the first horizon two-qubit
+     * gates of a kernel. 0 means that all gates should be considered.
+     */
+    utils::UInt core_partitioner_horizon = 0;
+
+    /**
+     * The number of two-qubit gate layers after which the weight of an
+     * interaction is halved for the core partitioner, or 0 to weigh all
+     * interactions equally.
+     */
+    utils::Real core_partitioner_half_life = 0.0;
+
     /**
      * Controls which heuristic the heuristic mapper is to use.
      */
@@ -231,21 +323,56 @@ struct Options {
      */
     utils::UInt max_alters = 0;
 
+    /**
+     * Compile-time budget for the mapper in seconds, or 0 to only observe the
+     * budget of the pass manager. Once exhausted, the speculating heuristics
+     * fall back to BASE, and max_alters is limited to DEGRADED_MAX_ALTERS.
+     */
+    utils::Real time_budget = 0.0;
+
     /**
      * Controls how to tie-break equally-scoring alternative mapping solutions.
      */
     TieBreakMethod tie_break_method = TieBreakMethod::RANDOM;
 
+    /**
+     * Seed for the random number generator used for RANDOM tie-breaking and
+     * path selection, or 0 to seed it from the current time.
+     */
+    utils::UInt seed = 0;
+
     /**
      * Controls the strategy for selecting the next gate(s) to map.
      */
     LookaheadMode lookahead_mode = LookaheadMode::NO_ROUTING_FIRST;
 
+    /**
+     * When nonzero, kernels with more gates than this are routed in windows
+     * of this many gates, each with its own dependency graph, to bound the
+     * memory used by the router. Not used when lookahead_mode is DISABLED.
+     */
+    utils::UInt stream_window = 0;
+
+    /**
+     * When nonzero, kernels with more gates than this are routed using a
+     * sliding window of this many gates, of which criticality is computed,
+     * advancing by half the window at a time. Overrides stream_window. Not
+     * used when lookahead_mode is DISABLED.
+     */
+    utils::UInt lookahead_window = 0;
+
     /**
      * Controls which paths are considered when routing.
      */
     PathSelectionMode path_selection_mode = PathSelectionMode::ALL;
 
+    /**
+     * Whether to discard routing alternatives for a gate that leave the
+     * virtual qubits in the same places as an earlier alternative for that
+     * gate, before they are extended and scored.
+     */
+    utils::Bool prune_equivalent_alters = false;
+
     /**
      * Swap selection mode.
      */
@@ -256,6 +383,58 @@ struct Options {
      */
     utils::Bool recurse_on_nn_two_qubit = false;
 
+    /**
+     * Number of threads used to extend and score the alternative routing
+     * solutions of a single routing step concurrently. 1 disables
+     * multithreading, 0 means use all hardware threads.
+     */
+    utils::UInt num_route_threads = 1;
+
+    /**
+     * Whether to score the alternatives of a routing step in a single batch
+     * based on the free cycles of the current past, rather than by extending
+     * a speculative copy of the past for each of them, when the heuristic and
+     * swap options allow for it.
+     */
+    utils::Bool batch_scoring = false;
+
+    /**
+     * Number of threads used to map different kernels concurrently. 1
+     * disables multithreading, 0 means use all hardware threads.
+     */
+    utils::UInt num_kernel_threads = 1;
+
+    /**
+     * Whether kernels with the same gates as an earlier kernel reuse the
+     * mapping result of that kernel.
+     */
+    utils::Bool reuse_routing = true;
+
+    /**
+     * Whether the kernels of loop bodies route their qubits back to their
+     * starting mapping at the end, such that the mapping is the same in every
+     * iteration.
+     */
+    utils::Bool loop_invariant_mapping = false;
+
+    /**
+     * Number of independently seeded mapping runs per kernel, of which the
+     * best result is kept. 1 means a single run.
+     */
+    utils::UInt multi_start_runs = 1;
+
+    /**
+     * Number of threads used to perform the runs for multi-start mapping
+     * concurrently. 1 disables multithreading, 0 means use all hardware
+     * threads.
+     */
+    utils::UInt num_multi_start_threads = 1;
+
+    /**
+     * The metric used to select the best result for multi-start mapping.
+     */
+    MultiStartMetric multi_start_metric = MultiStartMetric::SWAPS;
+
     /**
      * Controls the maximum recursion depth while searching for alternative
      * mapping solutions.
@@ -274,6 +453,45 @@ struct Options {
      */
     utils::Real recursion_width_exponent = 1.0;
 
+    /**
+     * When nonzero, the MIN_EXTEND[_RC] heuristics use beam search with this
+     * many states per routing step instead of recursion; recursion_depth_limit
+     * then limits the number of steps.
+     */
+    utils::UInt beam_width = 0;
+
+    /**
+     * Weight of the minimum number of swaps still needed for the gates that
+     * need routing, relative to the cycle extension, when ranking beam search
+     * states.
+     */
+    utils::Real beam_lookahead_weight = 1.0;
+
+    /**
+     * Maximum number of upcoming two-qubit gates (beyond the front layer) that
+     * the SABRE heuristic takes into account.
+     */
+    utils::UInt sabre_extended_set_size = 20;
+
+    /**
+     * Weight of the extended window relative to the front layer for the SABRE
+     * heuristic.
+     */
+    utils::Real sabre_extended_set_weight = 0.5;
+
+    /**
+     * Amount by which the decay factor of a qubit is increased for the SABRE
+     * heuristic each time it is swapped. The decay factors are reset to 1
+     * whenever a routed gate is mapped.
+     */
+    utils::Real sabre_decay = 0.001;
+
+    /**
+     * Number of forward/reverse routing passes that the SABRE heuristic uses
+     * to refine the initial placement. 0 disables refinement.
+     */
+    utils::UInt sabre_placement_passes = 1;
+
     /**
      * Whether to use move gates if possible, instead of always using swap.
      */
@@ -315,6 +533,11 @@ struct Options {
      */
     utils::Bool write_dot_graphs = false;
 
+    /**
+     * Whether to write a JSON file with performance counters for each kernel.
+     */
+    utils::Bool write_profile = false;
+
 };
 
 /**
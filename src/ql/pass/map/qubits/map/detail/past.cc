@@ -15,12 +15,18 @@ namespace map {
 namespace detail {
 
 /**
- * Past initializer.
+ * Past initializer. The resource manager is used to build the resource
+ * state of the FreeCycle map.
  */
-void Past::initialize(const ir::compat::KernelRef &k, const OptionsRef &opt) {
+void Past::initialize(
+    const ir::compat::KernelRef &k,
+    const OptionsRef &opt,
+    const rmgr::Manager &rm
+) {
     QL_DOUT("Past::initialize");
     platform = k->platform;
     kernel = k;
+    gate_kernel.reset();
     options = opt;
 
     nq = platform->qubit_count;
@@ -33,13 +39,78 @@ void Past::initialize(const ir::compat::KernelRef &k, const OptionsRef &opt) {
         options->initialize_one_to_one,
         options->assume_initialized ? com::map::QubitState::INITIALIZED : com::map::QubitState::NONE
     );
-    fc.initialize(platform, options); // fc starts off with all qubits free, is updated after schedule of each gate
+    fc.initialize(platform, options, rm); // fc starts off with all qubits free, is updated after schedule of each gate
     waiting_gates.clear();            // no gates pending to be scheduled in; Add of gate to past entered here
     gates.clear();                    // no gates scheduled yet in this past; after schedule of gate, it gets here
     output_gates.clear();             // no gates output yet by flushing from or bypassing this past
     num_swaps_added = 0;              // no swaps or moves added yet to this past; AddSwap adds one here
     num_moves_added = 0;              // no moves added yet to this past; AddSwap may add one here
-    cycle.clear();                    // no gates have cycles assigned in this past; scheduling gate updates this
+    cycles.clear();                   // no gates have cycles assigned in this past; scheduling gate updates this
+    free_slots.clear();
+    speculative = false;              // this is the main past or a past for decomposition, not a speculative past
+    profile.reset();                  // not profiled unless set_profile() is called
+
+    // Resolve which swap/move variants exist once, rather than probing for
+    // them for every swap or move.
+    utils::Str suffix = options->heuristic == Heuristic::MAX_FIDELITY ? "_prim" : "_real";
+    has_swap_variant = platform->has_instruction("swap" + suffix);
+    has_tswap_variant = platform->has_instruction("tswap" + suffix);
+    has_move_variant = platform->has_instruction("move" + suffix);
+    has_tmove_variant = platform->has_instruction("tmove" + suffix);
+    has_move_init = platform->has_instruction("move_init");
+}
+
+/**
+ * Initializes this past as a speculative extension of the given base
+ * past. Unlike a plain copy, this does not copy the gates that were
+ * already scheduled in the base past (nor their cycle numbers), because
+ * speculation only needs the qubit mapping and the FreeCycle map to
+ * compute the effect of new gates. Those are small, and the resource state
+ * in the FreeCycle map is only cloned when the speculative past actually
+ * reserves something. Thus, the cost of speculation no longer grows with
+ * the length of the kernel.
+ *
+ * A speculative past is never turned back into a complete past; when an
+ * alternative is selected, commit_alter() instead replays its swaps on the
+ * main past.
+ */
+void Past::initialize_speculative(const Past &base) {
+    platform = base.platform;
+    kernel = base.kernel;
+    gate_kernel.reset();
+    options = base.options;
+
+    nq = base.nq;
+    nb = base.nb;
+    ct = base.ct;
+
+    v2r = base.v2r;
+    fc = base.fc;
+    waiting_gates = base.waiting_gates;
+    gates.clear();
+    output_gates.clear();
+    cycles.clear();
+    free_slots.clear();
+    num_swaps_added = base.num_swaps_added;
+    num_moves_added = base.num_moves_added;
+    has_swap_variant = base.has_swap_variant;
+    has_tswap_variant = base.has_tswap_variant;
+    has_move_variant = base.has_move_variant;
+    has_tmove_variant = base.has_tmove_variant;
+    has_move_init = base.has_move_init;
+    speculative = true;
+    profile = base.profile;
+    if (profile) {
+        profile->num_past_clones++;
+    }
+}
+
+/**
+ * Sets the performance counters that this past (and any speculative past
+ * derived from it) should update.
+ */
+void Past::set_profile(const ProfileRef &p) {
+    profile = p;
 }
 
 /**
@@ -56,6 +127,13 @@ void Past::export_mapping(com::map::QubitMapping &v2r_destination) const {
     v2r_destination = v2r;
 }
 
+/**
+ * Returns our qubit mapping, without copying it.
+ */
+const com::map::QubitMapping &Past::get_mapping() const {
+    return v2r;
+}
+
 /**
  * Prints the state of the embedded FreeCycle object.
  */
@@ -68,7 +146,7 @@ void Past::print_fc() const{
  * is at least debug.
  */
 void Past::debug_print_fc() const {
-    if (utils::logger::log_level >= utils::logger::LogLevel::LOG_DEBUG) {
+    if (QL_IS_LOG_DEBUG) {
         fc.print("");
     }
 }
@@ -82,7 +160,7 @@ void Past::print(const utils::Str &s) const {
     fc.print("");
     // QL_DOUT("... list of gates in past");
     for (auto &gp : gates) {
-        QL_DOUT("[" << cycle.at(gp) << "] " << gp->qasm());
+        QL_DOUT("[" << cycles[gp.slot] << "] " << gp.gate->qasm());
     }
 }
 
@@ -94,6 +172,8 @@ void Past::print(const utils::Str &s) const {
  * gradually, until definitive.
  */
 void Past::schedule() {
+    ProfileTimer timer{profile, &Profile::scheduling_time};
+
     // the copy includes the resource manager.
     // QL_DOUT("Schedule ...");
 
@@ -110,22 +190,34 @@ void Past::schedule() {
         // the earliest start cycle per qubit, and so dependencies are
         // respected, so we can find the gate that can start first...
         //
-        // Note that tryfc includes the free cycle vector AND the resource map,
-        // so using tryfc.StartCycle/tryfc.Add we get a realistic ASAP rc
-        // schedule. We use a copy of fc and not fc itself, since the latter
-        // reflects the really scheduled gates and that shouldn't be changed.
+        // Note that fc includes the free cycle vector AND the resource map,
+        // so using fc.get_start_cycle/fc.add we get a realistic ASAP rc
+        // schedule. The trial additions are made between a checkpoint and a
+        // rollback, since fc reflects the really scheduled gates and that
+        // shouldn't be changed; this is much cheaper than trying on a copy of
+        // fc, which would have to clone the resource state.
         //
         // This search is really a hack to avoid the construction of a
         // dependency graph and a set of schedulable gates.
-        FreeCycle tryfc = fc;
-        for (auto try_gate_it = waiting_gates.begin(); try_gate_it != waiting_gates.end(); ++try_gate_it) {
-            utils::UInt try_start_cycle = tryfc.get_start_cycle(*try_gate_it);
-            tryfc.add(*try_gate_it, try_start_cycle);
-
-            if (try_start_cycle < start_cycle) {
-                start_cycle = try_start_cycle;
-                gate_it = try_gate_it;
+        //
+        // When only one gate is waiting, which is the common case for
+        // add_and_schedule(), there is nothing to choose from, so the
+        // checkpoint and trial additions are skipped.
+        if (waiting_gates.size() == 1) {
+            gate_it = waiting_gates.begin();
+            start_cycle = fc.get_start_cycle(*gate_it);
+        } else {
+            auto try_checkpoint = fc.checkpoint();
+            for (auto try_gate_it = waiting_gates.begin(); try_gate_it != waiting_gates.end(); ++try_gate_it) {
+                utils::UInt try_start_cycle = fc.get_start_cycle(*try_gate_it);
+                fc.add(*try_gate_it, try_start_cycle);
+
+                if (try_start_cycle < start_cycle) {
+                    start_cycle = try_start_cycle;
+                    gate_it = try_gate_it;
+                }
             }
+            fc.rollback(try_checkpoint);
         }
 
         auto gate = *gate_it;
@@ -134,11 +226,11 @@ void Past::schedule() {
         // assignment).
         // QL_DOUT("... add " << gp->qasm() << " startcycle=" << startCycle << " cycles=" << ((gp->duration+ct-1)/ct) );
         fc.add(gate, start_cycle);
-        cycle.set(gate) = start_cycle; // cycle[gp] is private to this past but gp->cycle is private to gp
+        ScheduledGate scheduled{gate, allocate_slot(start_cycle)}; // cycles is private to this past but gp->cycle is private to gp
         gate->cycle = start_cycle; // so gp->cycle gets assigned for each alter' Past and finally definitively for mainPast
         // QL_DOUT("... set " << gp->qasm() << " at cycle " << startCycle);
 
-        // Insert gate into the list of gates, in cycle[gp] order, and inside
+        // Insert gate into the list of gates, in cycle order, and inside
         // this order, as late as possible.
         //
         // Reverse iterate because the insertion is near the end of the list.
@@ -147,13 +239,13 @@ void Past::schedule() {
         auto rigp = gates.rbegin();
         utils::Bool inserted = false;
         for (; rigp != gates.rend(); rigp++) {
-            if (cycle.at(*rigp) <= start_cycle) {
+            if (cycles[rigp->slot] <= start_cycle) {
 
                 // rigp.base() because insert doesn't work with reverse iteration
                 // rigp.base points after the element that rigp is pointing at
                 // which is lucky because insert only inserts before the given
                 // element. The net result is inserting after rigp.
-                gates.insert(rigp.base(), gate);
+                gates.insert(rigp.base(), scheduled);
 
                 inserted = true;
                 break;
@@ -162,16 +254,59 @@ void Past::schedule() {
 
         // When list was empty or no element was found, just put it in front.
         if (!inserted) {
-            gates.push_front(gate);
+            gates.push_front(scheduled);
         }
 
         // Having added it to the main list, remove it from the waiting list.
         waiting_gates.erase(gate_it);
     }
 
+    // Gates that can no longer be reordered need not be revisited by the
+    // insertions of future calls.
+    if (!speculative) {
+        flush_committed();
+    }
+
     // DPRINT("Schedule:");
 }
 
+/**
+ * Moves the gates at the front of the main gate list that start before the
+ * minimum free cycle of the FreeCycle map to the output gate list. Any gate
+ * scheduled later starts at or after that cycle, and is thus inserted behind
+ * these gates, so their order is final.
+ */
+void Past::flush_committed() {
+    utils::UInt horizon = fc.get_min();
+    while (!gates.empty() && cycles[gates.front().slot] < horizon) {
+        output(gates.front());
+        gates.pop_front();
+    }
+}
+
+/**
+ * Returns a free slot in cycles, initialized to the given cycle.
+ */
+utils::UInt Past::allocate_slot(utils::UInt start_cycle) {
+    if (free_slots.empty()) {
+        cycles.push_back(start_cycle);
+        return cycles.size() - 1;
+    }
+    utils::UInt slot = free_slots.back();
+    free_slots.pop_back();
+    cycles[slot] = start_cycle;
+    return slot;
+}
+
+/**
+ * Moves the given gate from the main gate list to the output gate list,
+ * releasing its slot.
+ */
+void Past::output(const ScheduledGate &gate) {
+    output_gates.push_back(gate.gate);
+    free_slots.push_back(gate.slot);
+}
+
 /**
  * Computes the costs in cycle extension of optionally scheduling
  * init_circuit before the inevitable circuit.
@@ -223,12 +358,8 @@ void Past::add(const ir::compat::GateRef &gate) {
  *
  * Since kernel.h only provides a gate interface as method of class
  * Kernel, that adds the gate to kernel.c, and we want the gate (or its
- * decomposed sequence) here to be added to circ, the kludge is implemented
- * to make sure that kernel.c (the current kernel's mapper input/output
- * circuit) is available for this. In class Future, kernel.c is copied into
- * the dependence graph or copied to a local circuit, and in
- * Mapper::route, a temporary local output circuit is used, which is
- * written to kernel.c only at the very end.
+ * decomposed sequence) here to be added to circ, the gate is created in
+ * gate_kernel, and then moved from there to circ.
  */
 utils::Bool Past::new_gate(
     ir::compat::GateRefs &circ,
@@ -243,11 +374,14 @@ utils::Bool Past::new_gate(
 ) const {
     utils::Bool added;
     QL_ASSERT(circ.empty());
-    QL_ASSERT(kernel->gates.empty());
-    // create gate(s) in kernelp->c
-    added = kernel->gate_nonfatal(gname, qubits, cregs, duration, angle, bregs, gcond, gcondregs);
-    circ = kernel->gates;
-    kernel->gates.reset();
+    if (gate_kernel.empty()) {
+        QL_ASSERT(kernel->gates.empty());
+        gate_kernel = ir::compat::KernelRef::make(*kernel);
+    }
+    // create gate(s) in gate_kernel->gates
+    added = gate_kernel->gate_nonfatal(gname, qubits, cregs, duration, angle, bregs, gcond, gcondregs);
+    circ = gate_kernel->gates;
+    gate_kernel->gates.reset();
     for (const auto &gate : circ) {
         QL_DOUT("new_gate added: " << gate->qasm());
     }
@@ -255,6 +389,33 @@ utils::Bool Past::new_gate(
     return added;
 }
 
+/**
+ * Creates the gate(s) for a swap or move named gname (swap, tswap, move, or
+ * tmove) on the given qubits in circ, preferring the _prim or _real variant
+ * depending on the heuristic if has_variant is set, and returning whether
+ * this was successful.
+ */
+utils::Bool Past::new_swap_gate(
+    ir::compat::GateRefs &circ,
+    const utils::Str &gname,
+    utils::Bool has_variant,
+    utils::UInt r0,
+    utils::UInt r1
+) const {
+    if (has_variant) {
+        utils::Str variant = gname;
+        if (options->heuristic == Heuristic::MAX_FIDELITY) {
+            variant.append("_prim");
+        } else {
+            variant.append("_real");
+        }
+        if (new_gate(circ, variant, {r0, r1})) {
+            return true;
+        }
+    }
+    return new_gate(circ, gname, {r0, r1});
+}
+
 /**
  * Returns the number of swaps added to this past.
  */
@@ -313,28 +474,14 @@ void Past::generate_move(ir::compat::GateRefs &circuit, utils::UInt &r0, utils::
     // First (optimistically) create the move circuit and add it to circuit.
     utils::Bool created;
     if (platform->topology->is_inter_core_hop(r0, r1)) {
-        if (options->heuristic == Heuristic::MAX_FIDELITY) {
-            created = new_gate(circuit, "tmove_prim", {r0, r1});    // gates implementing tmove returned in circ
-        } else {
-            created = new_gate(circuit, "tmove_real", {r0, r1});    // gates implementing tmove returned in circ
-        }
+        created = new_swap_gate(circuit, "tmove", has_tmove_variant, r0, r1);    // gates implementing tmove returned in circ
         if (!created) {
-            created = new_gate(circuit, "tmove", {r0, r1});
-            if (!created) {
-                new_gate_exception("tmove or tmove_real");
-            }
+            new_gate_exception("tmove or tmove_real");
         }
     } else {
-        if (options->heuristic == Heuristic::MAX_FIDELITY) {
-            created = new_gate(circuit, "move_prim", {r0, r1});    // gates implementing move returned in circ
-        } else {
-            created = new_gate(circuit, "move_real", {r0, r1});    // gates implementing move returned in circ
-        }
+        created = new_swap_gate(circuit, "move", has_move_variant, r0, r1);    // gates implementing move returned in circ
         if (!created) {
-            created = new_gate(circuit, "move", {r0, r1});
-            if (!created) {
-                new_gate_exception("move or move_real");
-            }
+            new_gate_exception("move or move_real");
         }
     }
 
@@ -343,7 +490,7 @@ void Past::generate_move(ir::compat::GateRefs &circuit, utils::UInt &r0, utils::
         // QL_DOUT("... initializing non-inited " << r1 << " to |0> (inited) state preferably using move_init ...");
         ir::compat::GateRefs init_circuit;
 
-        created = new_gate(init_circuit, "move_init", {r1});
+        created = has_move_init && new_gate(init_circuit, "move_init", {r1});
         if (!created) {
             created = new_gate(init_circuit, "prepz", {r1});
             // if (created)
@@ -454,29 +601,15 @@ void Past::add_swap(utils::UInt r0, utils::UInt r1) {
             }
         }
         if (platform->topology->is_inter_core_hop(r0, r1)) {
-            if (options->heuristic == Heuristic::MAX_FIDELITY) {
-                created = new_gate(circuit, "tswap_prim", {r0, r1});    // gates implementing tswap returned in circ
-            } else {
-                created = new_gate(circuit, "tswap_real", {r0, r1});    // gates implementing tswap returned in circ
-            }
+            created = new_swap_gate(circuit, "tswap", has_tswap_variant, r0, r1);    // gates implementing tswap returned in circ
             if (!created) {
-                created = new_gate(circuit, "tswap", {r0, r1});
-                if (!created) {
-                    new_gate_exception("tswap or tswap_real");
-                }
+                new_gate_exception("tswap or tswap_real");
             }
             QL_DOUT("... tswap(q" << r0 << ",q" << r1 << ") ...");
         } else {
-            if (options->heuristic == Heuristic::MAX_FIDELITY) {
-                created = new_gate(circuit, "swap_prim", {r0, r1});    // gates implementing swap returned in circ
-            } else {
-                created = new_gate(circuit, "swap_real", {r0, r1});    // gates implementing swap returned in circ
-            }
+            created = new_swap_gate(circuit, "swap", has_swap_variant, r0, r1);    // gates implementing swap returned in circ
             if (!created) {
-                created = new_gate(circuit, "swap", {r0, r1});
-                if (!created) {
-                    new_gate_exception("swap or swap_real");
-                }
+                new_gate_exception("swap or swap_real");
             }
             QL_DOUT("... swap(q" << r0 << ",q" << r1 << ") ...");
         }
@@ -560,7 +693,7 @@ void Past::make_real(const ir::compat::GateRef &gate, ir::compat::GateRefs &circ
         real_gname.append("_real");
     }
 
-    utils::Bool created = new_gate(
+    utils::Bool created = platform->has_instruction(real_gname) && new_gate(
         circuit,
         real_gname,
         real_qubits,
@@ -607,7 +740,7 @@ void Past::make_primitive(const ir::compat::GateRef &gate, ir::compat::GateRefs
     strip_name(gname);
     utils::Str prim_gname = gname;
     prim_gname.append("_prim");
-    utils::Bool created = new_gate(
+    utils::Bool created = platform->has_instruction(prim_gname) && new_gate(
         circuit,
         prim_gname,
         gate->operands,
@@ -651,6 +784,52 @@ utils::UInt Past::get_max_free_cycle() const {
     return fc.get_max();
 }
 
+/**
+ * Returns the free cycle of the given real qubit.
+ */
+utils::UInt Past::get_free_cycle(utils::UInt q) const {
+    return fc.get_free_cycle(q);
+}
+
+/**
+ * Returns the profile of the gates that add_swap() inserts for a swap with
+ * the given operands, after any reversal of the operands. This creates the
+ * gates, so it's not cheap; the result only depends on the platform and the
+ * options, so it can be cached.
+ */
+SwapProfile Past::make_swap_profile(utils::UInt r0, utils::UInt r1) const {
+    SwapProfile profile;
+    ir::compat::GateRefs circuit;
+    utils::Bool created;
+    if (platform->topology->is_inter_core_hop(r0, r1)) {
+        created = new_swap_gate(circuit, "tswap", has_tswap_variant, r0, r1);
+    } else {
+        created = new_swap_gate(circuit, "swap", has_swap_variant, r0, r1);
+    }
+    if (!created) {
+        return profile;
+    }
+    for (const auto &gate : circuit) {
+        if (!gate->breg_operands.empty() || gate->is_conditional()) {
+            return profile;
+        }
+        utils::UInt mask = 0;
+        for (auto q : gate->operands) {
+            if (q == r0) {
+                mask |= 1;
+            } else if (q == r1) {
+                mask |= 2;
+            } else {
+                return profile;
+            }
+        }
+        profile.operands.push_back(mask);
+        profile.durations.push_back((gate->duration + ct - 1) / ct);
+    }
+    profile.supported = true;
+    return profile;
+}
+
 /**
  * Non-quantum and quantum gates follow separate flows through Past:
  *
@@ -667,7 +846,7 @@ utils::UInt Past::get_max_free_cycle() const {
  */
 void Past::flush_all() {
     for (const auto &gate : gates) {
-        output_gates.push_back(gate);
+        output(gate);
     }
     gates.clear();         // so effectively, lg's content was moved to outlg
 
@@ -691,6 +870,7 @@ void Past::bypass(const ir::compat::GateRef &gate) {
  * Flushes the output gate list to the given circuit.
  */
 void Past::flush_to_circuit(ir::compat::GateRefs &output_circuit) {
+    QL_ASSERT(!speculative);
     for (const auto &gate : output_gates) {
         output_circuit.add(gate);
     }
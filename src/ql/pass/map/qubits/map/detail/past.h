@@ -13,6 +13,7 @@
 #include "ql/com/map/qubit_mapping.h"
 #include "options.h"
 #include "free_cycle.h"
+#include "profile.h"
 
 namespace ql {
 namespace pass {
@@ -64,6 +65,33 @@ namespace detail {
  *  - flush_to_circuit: output_gates flushed to output circuit
  *    [isempty(waiting_gates) && isempty(gates) && isempty(output_gates)]
  */
+/**
+ * The effect of the gates implementing a swap on the free cycles of its
+ * operands, assuming non-resource-constrained scheduling. This allows a swap
+ * to be scored without creating its gates. See Past::make_swap_profile().
+ */
+struct SwapProfile {
+
+    /**
+     * Whether the gates implementing the swap only act on its two operands,
+     * without breg operands or conditions. If not, the swap can't be scored
+     * using this profile.
+     */
+    utils::Bool supported = false;
+
+    /**
+     * For each gate, in order, the operands of the swap it acts on, as a bit
+     * mask: bit 0 for the first operand and bit 1 for the second.
+     */
+    utils::Vec<utils::UInt> operands;
+
+    /**
+     * For each gate, in order, its duration in cycles.
+     */
+    utils::Vec<utils::UInt> durations;
+
+};
+
 class Past {
 private:
 
@@ -92,6 +120,14 @@ private:
      */
     ir::compat::KernelRef kernel;
 
+    /**
+     * Private copy of kernel that new_gate() creates its gates in, made on
+     * first use and dropped when the past is (re)initialized. Each past thus
+     * has its own, so alternatives can be extended from multiple threads at
+     * once (see the route_threads option) without a lock.
+     */
+    mutable ir::compat::KernelRef gate_kernel;
+
     /**
      * Parsed options record for the whole mapper pass.
      */
@@ -117,12 +153,33 @@ private:
 
 public:
 
+    /**
+     * A gate in the main gate list, along with the index of the entry in
+     * cycles that holds its start cycle in this past.
+     */
+    struct ScheduledGate {
+
+        /**
+         * The scheduled gate.
+         */
+        ir::compat::GateRef gate;
+
+        /**
+         * Index into cycles.
+         */
+        utils::UInt slot;
+
+    };
+
     /**
      * State: list of q gates in this Past, scheduled by their (start) cycle
      * values. So this is the result list of this Past, to compare with other
-     * Alters.
+     * Alters. For speculative pasts, this only contains the gates added since
+     * the past was split off from its base. For other pasts, gates that are
+     * no longer affected by scheduling are moved to output_gates as soon as
+     * possible by flush_committed().
      */
-    utils::List<ir::compat::GateRef> gates;
+    utils::List<ScheduledGate> gates;
 
 private:
 
@@ -133,12 +190,30 @@ private:
     utils::List<ir::compat::GateRef> output_gates;
 
     /**
-     * State: gate to cycle map, startCycle value of each past gatecycle[gp].
-     * cycle[gp] can be different for each gp for each past. gp->cycle is not
-     * used by map_gates, although updated by set_cycle called from
-     * MakeAvailable/TakeAvailable.
+     * State: start cycle of each gate in the main gate list, indexed by the
+     * slot of its ScheduledGate. The cycle can be different for each gate for
+     * each past, because alternatives share gates, so gp->cycle can't be used
+     * for this. Slots are assigned when a gate enters the main gate list, and
+     * are recycled via free_slots when it leaves it, so this stays as small
+     * as the main gate list.
+     */
+    utils::Vec<utils::UInt> cycles;
+
+    /**
+     * Slots in cycles that are not in use.
+     */
+    utils::Vec<utils::UInt> free_slots;
+
+    /**
+     * Returns a free slot in cycles, initialized to the given cycle.
      */
-    utils::Map<ir::compat::GateRef, utils::UInt> cycle;
+    utils::UInt allocate_slot(utils::UInt start_cycle);
+
+    /**
+     * Moves the given gate from the main gate list to the output gate list,
+     * releasing its slot.
+     */
+    void output(const ScheduledGate &gate);
 
     /**
      * Number of swaps (including moves) added to this past.
@@ -150,12 +225,66 @@ private:
      */
     utils::UInt num_moves_added;
 
+    /**
+     * Whether the platform defines the preferred variants (_prim or _real,
+     * depending on the heuristic) of the swap, tswap, move, and tmove gates,
+     * and whether it defines move_init. Resolved once by initialize(), so
+     * inserting swaps and moves doesn't need to probe the platform for gates
+     * that don't exist.
+     */
+    utils::Bool has_swap_variant;
+    utils::Bool has_tswap_variant;
+    utils::Bool has_move_variant;
+    utils::Bool has_tmove_variant;
+    utils::Bool has_move_init;
+
+    /**
+     * Whether this is a speculative past, constructed using
+     * initialize_speculative(). Such a past only tracks the gates that were
+     * added to it since it was split off from its base past, so it can't be
+     * flushed to a circuit.
+     */
+    utils::Bool speculative;
+
+    /**
+     * Performance counters to update, or empty if profiling is disabled.
+     * Inherited by speculative pasts.
+     */
+    ProfileRef profile;
+
 public:
 
     /**
-     * Past initializer.
+     * Past initializer. The resource manager is used to build the resource
+     * state of the FreeCycle map.
      */
-    void initialize(const ir::compat::KernelRef &k, const OptionsRef &opt);
+    void initialize(
+        const ir::compat::KernelRef &k,
+        const OptionsRef &opt,
+        const rmgr::Manager &rm
+    );
+
+    /**
+     * Initializes this past as a speculative extension of the given base
+     * past. Unlike a plain copy, this does not copy the gates that were
+     * already scheduled in the base past (nor their cycle numbers), because
+     * speculation only needs the qubit mapping and the FreeCycle map to
+     * compute the effect of new gates. Those are small, and the resource state
+     * in the FreeCycle map is only cloned when the speculative past actually
+     * reserves something. Thus, the cost of speculation no longer grows with
+     * the length of the kernel.
+     *
+     * A speculative past is never turned back into a complete past; when an
+     * alternative is selected, commit_alter() instead replays its swaps on the
+     * main past.
+     */
+    void initialize_speculative(const Past &base);
+
+    /**
+     * Sets the performance counters that this past (and any speculative past
+     * derived from it) should update.
+     */
+    void set_profile(const ProfileRef &p);
 
     /**
      * Copies the given qubit mapping into our mapping.
@@ -167,6 +296,11 @@ public:
      */
     void export_mapping(com::map::QubitMapping &v2r_destination) const;
 
+    /**
+     * Returns our qubit mapping, without copying it.
+     */
+    const com::map::QubitMapping &get_mapping() const;
+
     /**
      * Prints the state of the embedded FreeCycle object.
      */
@@ -188,10 +322,21 @@ public:
      * gates all are mapped and so have real operand qubit indices. The
      * FreeCycle map reflects for each qubit the first free cycle. All new
      * gates, now in waitinglist, get such a cycle assigned below, increased
-     * gradually, until definitive.
+     * gradually, until definitive. Only the waiting gates are scheduled; the
+     * gates scheduled by earlier calls are represented by the FreeCycle map.
+     * Afterwards, gates of which the position can no longer change are
+     * flushed to the output gate list (see flush_committed()).
      */
     void schedule();
 
+    /**
+     * Moves the gates at the front of the main gate list that start before the
+     * minimum free cycle of the FreeCycle map to the output gate list. Any gate
+     * scheduled later starts at or after that cycle, and is thus inserted behind
+     * these gates, so their order is final.
+     */
+    void flush_committed();
+
     /**
      * Computes the costs in cycle extension of optionally scheduling
      * init_circuit before the inevitable circuit.
@@ -214,12 +359,8 @@ public:
      *
      * Since kernel.h only provides a gate interface as method of class
      * Kernel, that adds the gate to kernel.c, and we want the gate (or its
-     * decomposed sequence) here to be added to circ, the kludge is implemented
-     * to make sure that kernel.c (the current kernel's mapper input/output
-     * circuit) is available for this. In class Future, kernel.c is copied into
-     * the dependence graph or copied to a local circuit, and in
-     * Mapper::route, a temporary local output circuit is used, which is
-     * written to kernel.c only at the very end.
+     * decomposed sequence) here to be added to circ, the gate is created in
+     * gate_kernel, and then moved from there to circ.
      */
     utils::Bool new_gate(
         ir::compat::GateRefs &circ,
@@ -233,6 +374,20 @@ public:
         const utils::Vec<utils::UInt> &gcondregs = {}
     ) const;
 
+    /**
+     * Creates the gate(s) for a swap or move named gname (swap, tswap, move,
+     * or tmove) on the given qubits in circ, preferring the _prim or _real
+     * variant depending on the heuristic if has_variant is set, and returning
+     * whether this was successful.
+     */
+    utils::Bool new_swap_gate(
+        ir::compat::GateRefs &circ,
+        const utils::Str &gname,
+        utils::Bool has_variant,
+        utils::UInt r0,
+        utils::UInt r1
+    ) const;
+
     /**
      * Returns the number of swaps added to this past.
      */
@@ -349,6 +504,19 @@ public:
      */
     utils::UInt get_max_free_cycle() const;
 
+    /**
+     * Returns the free cycle of the given real qubit.
+     */
+    utils::UInt get_free_cycle(utils::UInt q) const;
+
+    /**
+     * Returns the profile of the gates that add_swap() inserts for a swap with
+     * the given operands, after any reversal of the operands. This creates the
+     * gates, so it's not cheap; the result only depends on the platform and
+     * the options, so it can be cached.
+     */
+    SwapProfile make_swap_profile(utils::UInt r0, utils::UInt r1) const;
+
     /**
      * Non-quantum and quantum gates follow separate flows through Past:
      *
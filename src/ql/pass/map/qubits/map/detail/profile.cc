@@ -0,0 +1,81 @@
+/** \file
+ * Performance counters for the mapper.
+ */
+
+#include "profile.h"
+
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/logger.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace map {
+namespace detail {
+
+/**
+ * Records that select_alter() reached the given recursion depth.
+ */
+void Profile::record_recursion_depth(utils::UInt depth) {
+    utils::UInt current = max_recursion_depth.load();
+    while (depth > current && !max_recursion_depth.compare_exchange_weak(current, depth)) {}
+}
+
+/**
+ * Writes the counters to the given file as a JSON object, along with the
+ * given kernel name, swap and move counts, and total time taken in
+ * seconds.
+ */
+void Profile::write_json(
+    const utils::Str &file_name,
+    const utils::Str &kernel_name,
+    utils::UInt num_swaps_added,
+    utils::UInt num_moves_added,
+    utils::Real time_taken
+) const {
+    utils::Json json;
+    json["kernel"] = kernel_name;
+    json["alters_generated"] = num_alters_generated.load();
+    json["alters_limited_by_max_alters"] = num_alters_limited.load();
+    json["alters_pruned"] = num_alters_pruned.load();
+    json["past_clones"] = num_past_clones.load();
+    json["max_recursion_depth"] = max_recursion_depth.load();
+    json["path_generation_time"] = path_generation_time.load() * 1.0e-9;
+    json["scoring_time"] = scoring_time.load() * 1.0e-9;
+    json["scheduling_time"] = scheduling_time.load() * 1.0e-9;
+    json["swaps_added"] = num_swaps_added;
+    json["moves_added"] = num_moves_added;
+    json["time_taken"] = time_taken;
+    QL_IOUT("writing mapper profile to '" << file_name << "' ...");
+    utils::OutFile(file_name) << json.dump(4) << "\n";
+}
+
+/**
+ * Starts timing for the given counter of the given profile.
+ */
+ProfileTimer::ProfileTimer(
+    const ProfileRef &profile,
+    std::atomic<utils::UInt> Profile::*member
+) :
+    counter(profile ? &((*profile).*member) : nullptr),
+    start(counter ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+{}
+
+/**
+ * Adds the elapsed time to the counter.
+ */
+ProfileTimer::~ProfileTimer() {
+    if (counter) {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        *counter += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+}
+
+} // namespace detail
+} // namespace map
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
@@ -0,0 +1,141 @@
+/** \file
+ * Performance counters for the mapper.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/ptr.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace map {
+namespace detail {
+
+/**
+ * Performance counters for mapping a single kernel, used to figure out where
+ * the time goes for a particular combination of circuit and mapper options.
+ * The counters are atomic, because alternatives may be evaluated concurrently
+ * (see the route_threads option). For the same reason, the times are summed
+ * over all threads, so they may add up to more than the wall-clock time taken.
+ */
+class Profile {
+public:
+
+    /**
+     * Number of routing alternatives generated by gen_shortest_paths().
+     */
+    std::atomic<utils::UInt> num_alters_generated{0};
+
+    /**
+     * Number of times path generation was cut short because the max_alters
+     * limit was reached, i.e. the number of routing requests for which
+     * alternatives were pruned.
+     */
+    std::atomic<utils::UInt> num_alters_limited{0};
+
+    /**
+     * Number of routing alternatives discarded because they resulted in the
+     * same placement of the virtual qubits as an earlier alternative.
+     */
+    std::atomic<utils::UInt> num_alters_pruned{0};
+
+    /**
+     * Number of times a Past was cloned for speculative evaluation.
+     */
+    std::atomic<utils::UInt> num_past_clones{0};
+
+    /**
+     * Maximum recursion depth reached by select_alter().
+     */
+    std::atomic<utils::UInt> max_recursion_depth{0};
+
+    /**
+     * Time spent generating routing alternatives, in nanoseconds.
+     */
+    std::atomic<utils::UInt> path_generation_time{0};
+
+    /**
+     * Time spent scoring routing alternatives, in nanoseconds. This includes
+     * the time spent scheduling the swaps of the alternatives in their
+     * speculative pasts.
+     */
+    std::atomic<utils::UInt> scoring_time{0};
+
+    /**
+     * Time spent in Past::schedule(), in nanoseconds.
+     */
+    std::atomic<utils::UInt> scheduling_time{0};
+
+    /**
+     * Records that select_alter() reached the given recursion depth.
+     */
+    void record_recursion_depth(utils::UInt depth);
+
+    /**
+     * Writes the counters to the given file as a JSON object, along with the
+     * given kernel name, swap and move counts, and total time taken in
+     * seconds.
+     */
+    void write_json(
+        const utils::Str &file_name,
+        const utils::Str &kernel_name,
+        utils::UInt num_swaps_added,
+        utils::UInt num_moves_added,
+        utils::Real time_taken
+    ) const;
+
+};
+
+/**
+ * Shared reference to a Profile. Empty when profiling is disabled.
+ */
+using ProfileRef = utils::Ptr<Profile>;
+
+/**
+ * Scope guard that adds the time between its construction and destruction to
+ * one of the time counters of a Profile. Does nothing if the profile reference
+ * is empty.
+ */
+class ProfileTimer {
+private:
+
+    /**
+     * The counter to add the elapsed time to, or nullptr if profiling is
+     * disabled.
+     */
+    std::atomic<utils::UInt> *counter;
+
+    /**
+     * The time at which the timer was constructed.
+     */
+    std::chrono::steady_clock::time_point start;
+
+public:
+
+    /**
+     * Starts timing for the given counter of the given profile.
+     */
+    ProfileTimer(const ProfileRef &profile, std::atomic<utils::UInt> Profile::*member);
+
+    /**
+     * Adds the elapsed time to the counter.
+     */
+    ~ProfileTimer();
+
+    ProfileTimer(const ProfileTimer &) = delete;
+    ProfileTimer &operator=(const ProfileTimer &) = delete;
+
+};
+
+} // namespace detail
+} // namespace map
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
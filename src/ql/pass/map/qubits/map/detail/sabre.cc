@@ -0,0 +1,358 @@
+/** \file
+ * SABRE-style lookahead cost function and initial placement refinement for
+ * the mapper.
+ */
+
+#include "sabre.h"
+
+#include <algorithm>
+#include "ql/utils/logger.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace map {
+namespace detail {
+
+using namespace utils;
+
+/**
+ * Returns the real qubit holding the state of real qubit q after applying the
+ * permutation described by moved.
+ */
+static UInt apply_permutation(const Map<UInt, UInt> &moved, UInt q) {
+    auto it = moved.find(q);
+    if (it == moved.end()) {
+        return q;
+    }
+    return it->second;
+}
+
+/**
+ * Returns the average number of hops between the operands of the given gates
+ * after applying the permutation described by moved, or 0 if there are no
+ * gates.
+ */
+static Real get_average_hops(
+    const com::Topology &topology,
+    const Vec<QubitPair> &gates,
+    const Map<UInt, UInt> &moved
+) {
+    if (gates.empty()) {
+        return 0.0;
+    }
+    Real total = 0.0;
+    for (const auto &gate : gates) {
+        total += topology.get_min_hops(
+            apply_permutation(moved, gate.first),
+            apply_permutation(moved, gate.second)
+        );
+    }
+    return total / gates.size();
+}
+
+/**
+ * Computes the SABRE lookahead cost for the given front layer and extended
+ * window of two-qubit gates, given in real qubit indices, after the states of
+ * the real qubits have been permuted as described by moved (see
+ * Alter::get_permutation()). The cost is the average number of hops between
+ * the operands of the front layer gates, plus extended_weight times the same
+ * average for the extended window. Decay is not included; callers multiply by
+ * the decay factor of the swapped qubits themselves.
+ */
+Real compute_sabre_cost(
+    const com::Topology &topology,
+    const Vec<QubitPair> &front,
+    const Vec<QubitPair> &extended,
+    Real extended_weight,
+    const Map<UInt, UInt> &moved
+) {
+    return get_average_hops(topology, front, moved)
+        + extended_weight * get_average_hops(topology, extended, moved);
+}
+
+/**
+ * Initializes the placer for the given platform and options.
+ */
+void SabrePlacer::initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt) {
+    platform = p;
+    options = opt;
+    nq = p->qubit_count;
+}
+
+/**
+ * Allocates the lowest-indexed free real qubit for the given unmapped
+ * virtual qubit, in the same way that QubitMapping::allocate() would.
+ */
+void SabrePlacer::allocate(UInt virt, Vec<UInt> &v2r, Vec<UInt> &r2v) const {
+    QL_ASSERT(v2r[virt] == com::map::UNDEFINED_QUBIT);
+    for (UInt real = 0; real < nq; real++) {
+        if (r2v[real] == com::map::UNDEFINED_QUBIT) {
+            v2r[virt] = real;
+            r2v[real] = virt;
+            return;
+        }
+    }
+    QL_ASSERT(false);
+}
+
+/**
+ * Simulates routing of the given list of two-qubit gates (in virtual qubit
+ * indices), updating the given virtual-to-real and real-to-virtual maps
+ * along the way. Returns false if routing got stuck, in which case the maps
+ * are left in an undefined state.
+ */
+Bool SabrePlacer::route_pass(
+    const Vec<QubitPair> &gates,
+    Vec<UInt> &v2r,
+    Vec<UInt> &r2v
+) const {
+    const auto &topology = *platform->topology;
+
+    // Build the per-qubit gate lists. A gate is in the front layer when it is
+    // the next gate for both its operands.
+    Vec<Vec<UInt>> qubit_gates(nq);
+    for (UInt i = 0; i < gates.size(); i++) {
+        qubit_gates[gates[i].first].push_back(i);
+        qubit_gates[gates[i].second].push_back(i);
+    }
+    Vec<UInt> head(nq, 0);
+    auto is_ready = [&](UInt i) {
+        for (auto q : {gates[i].first, gates[i].second}) {
+            if (head[q] >= qubit_gates[q].size() || qubit_gates[q][head[q]] != i) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Construct the initial front layer.
+    Vec<Bool> done(gates.size(), false);
+    Vec<Bool> in_front(gates.size(), false);
+    Vec<UInt> front;
+    for (UInt q = 0; q < nq; q++) {
+        if (!qubit_gates[q].empty()) {
+            auto i = qubit_gates[q].front();
+            if (!in_front[i] && is_ready(i)) {
+                in_front[i] = true;
+                front.push_back(i);
+            }
+        }
+    }
+
+    // Decay state.
+    Vec<Real> decay(nq, 1.0);
+    Vec<UInt> decayed;
+
+    // Swaps a pair of real qubits in the maps.
+    auto swap = [&](UInt r0, UInt r1) {
+        std::swap(r2v[r0], r2v[r1]);
+        if (r2v[r0] != com::map::UNDEFINED_QUBIT) v2r[r2v[r0]] = r0;
+        if (r2v[r1] != com::map::UNDEFINED_QUBIT) v2r[r2v[r1]] = r1;
+    };
+
+    UInt num_done = 0;
+    UInt first_pending = 0;
+    UInt swaps_since_progress = 0;
+    while (num_done < gates.size()) {
+        QL_ASSERT(!front.empty());
+
+        // Allocate real qubits for virtual qubits that are used for the first
+        // time.
+        for (auto i : front) {
+            for (auto v : {gates[i].first, gates[i].second}) {
+                if (v2r[v] == com::map::UNDEFINED_QUBIT) {
+                    allocate(v, v2r, r2v);
+                }
+            }
+        }
+
+        // Execute all gates in the front layer that are nearest-neighbor, and
+        // add the gates that become ready to the front layer.
+        Vec<UInt> new_front;
+        Bool progress = false;
+        for (auto i : front) {
+            const auto &gate = gates[i];
+            if (topology.get_min_hops(v2r[gate.first], v2r[gate.second]) != 1) {
+                new_front.push_back(i);
+                continue;
+            }
+            done[i] = true;
+            in_front[i] = false;
+            num_done++;
+            progress = true;
+            for (auto q : {gate.first, gate.second}) {
+                head[q]++;
+                if (head[q] < qubit_gates[q].size()) {
+                    auto j = qubit_gates[q][head[q]];
+                    if (!in_front[j] && is_ready(j)) {
+                        in_front[j] = true;
+                        new_front.push_back(j);
+                    }
+                }
+            }
+        }
+        front = std::move(new_front);
+        if (progress) {
+            for (auto q : decayed) {
+                decay[q] = 1.0;
+            }
+            decayed.clear();
+            swaps_since_progress = 0;
+            continue;
+        }
+
+        // Nothing could be executed, so we need to swap. Build the front layer
+        // and extended window in terms of real qubits.
+        Vec<QubitPair> front_reals;
+        for (auto i : front) {
+            front_reals.push_back({v2r[gates[i].first], v2r[gates[i].second]});
+        }
+        while (first_pending < gates.size() && done[first_pending]) {
+            first_pending++;
+        }
+        Vec<QubitPair> extended_reals;
+        for (
+            UInt i = first_pending;
+            i < gates.size() && extended_reals.size() < options->sabre_extended_set_size;
+            i++
+        ) {
+            if (done[i] || in_front[i]) {
+                continue;
+            }
+            auto r0 = v2r[gates[i].first];
+            auto r1 = v2r[gates[i].second];
+            if (r0 != com::map::UNDEFINED_QUBIT && r1 != com::map::UNDEFINED_QUBIT) {
+                extended_reals.push_back({r0, r1});
+            }
+        }
+
+        // If the heuristic doesn't seem to converge, fall back to greedily
+        // routing the first gate in the front layer along a shortest path, to
+        // guarantee progress.
+        auto stuck_limit = 2 * topology.get_min_hops(front_reals[0].first, front_reals[0].second) + 8;
+        if (swaps_since_progress > stuck_limit) {
+            auto src = front_reals[0].first;
+            auto tgt = front_reals[0].second;
+            while (topology.get_min_hops(src, tgt) != 1) {
+                auto best = src;
+                auto best_hops = topology.get_min_hops(src, tgt);
+                for (auto n : topology.get_neighbor_span(src)) {
+                    auto hops = n == tgt ? utils::MAX : topology.get_min_hops(n, tgt);
+                    if (hops < best_hops) {
+                        best = n;
+                        best_hops = hops;
+                    }
+                }
+                if (best == src) {
+                    QL_DOUT("SABRE placement pass got stuck routing q" << src << " to q" << tgt);
+                    return false;
+                }
+                swap(src, best);
+                src = best;
+            }
+            swaps_since_progress = 0;
+            continue;
+        }
+
+        // Score all swaps involving an operand of a gate in the front layer,
+        // and apply the best one.
+        Real best_cost = utils::INF;
+        QubitPair best_swap = {0, 0};
+        Map<UInt, UInt> moved;
+        for (const auto &gate : front_reals) {
+            for (auto r : {gate.first, gate.second}) {
+                for (auto n : topology.get_neighbor_span(r)) {
+                    moved.clear();
+                    moved.set(r) = n;
+                    moved.set(n) = r;
+                    Real cost = utils::max(decay[r], decay[n]) * compute_sabre_cost(
+                        topology, front_reals, extended_reals,
+                        options->sabre_extended_set_weight, moved
+                    );
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_swap = {r, n};
+                    }
+                }
+            }
+        }
+        if (best_cost == utils::INF) {
+            QL_DOUT("SABRE placement pass found no candidate swaps");
+            return false;
+        }
+        swap(best_swap.first, best_swap.second);
+        for (auto q : {best_swap.first, best_swap.second}) {
+            if (decay[q] == 1.0) {
+                decayed.push_back(q);
+            }
+            decay[q] += options->sabre_decay;
+        }
+        swaps_since_progress++;
+
+    }
+
+    return true;
+}
+
+/**
+ * Refines the given initial mapping for the given kernel using the
+ * configured number of forward/reverse passes. Returns whether the mapping
+ * was modified. When routing gets stuck (which can only happen for
+ * topologies where not all qubits are connected), the mapping is left
+ * as it was.
+ */
+Bool SabrePlacer::refine(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r) const {
+    if (!options->sabre_placement_passes) {
+        return false;
+    }
+
+    // Gather the two-qubit gates of the kernel, and the same in reverse order.
+    Vec<QubitPair> gates;
+    for (const auto &gate : k->gates) {
+        if (
+            gate->operands.size() == 2
+            && gate->type() != ir::compat::GateType::CLASSICAL
+            && gate->type() != ir::compat::GateType::DUMMY
+        ) {
+            gates.push_back({gate->operands[0], gate->operands[1]});
+        }
+    }
+    if (gates.empty()) {
+        return false;
+    }
+    Vec<QubitPair> reversed_gates{gates.rbegin(), gates.rend()};
+
+    // Build the working copies of the mapping.
+    Vec<UInt> v2r_work = v2r.get_virt_to_real();
+    Vec<UInt> r2v_work(nq, com::map::UNDEFINED_QUBIT);
+    for (UInt virt = 0; virt < nq; virt++) {
+        if (v2r_work[virt] != com::map::UNDEFINED_QUBIT) {
+            r2v_work[v2r_work[virt]] = virt;
+        }
+    }
+
+    // Do the forward/reverse passes.
+    for (UInt pass = 0; pass < options->sabre_placement_passes; pass++) {
+        if (!route_pass(gates, v2r_work, r2v_work) || !route_pass(reversed_gates, v2r_work, r2v_work)) {
+            QL_WOUT("SABRE placement refinement failed for kernel " << k->name << "; using unrefined placement");
+            return false;
+        }
+    }
+
+    // Copy the result into the mapping.
+    v2r.set_virt_to_real(v2r_work);
+    QL_IF_LOG_DEBUG {
+        QL_DOUT("After SABRE placement refinement");
+        v2r.dump_state();
+    }
+    return true;
+}
+
+} // namespace detail
+} // namespace map
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
@@ -0,0 +1,123 @@
+/** \file
+ * SABRE-style lookahead cost function and initial placement refinement for
+ * the mapper.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/map.h"
+#include "ql/utils/pair.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/com/topology.h"
+#include "ql/com/map/qubit_mapping.h"
+#include "options.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace map {
+namespace detail {
+
+/**
+ * The pair of operand qubits of a two-qubit gate, as used by the SABRE
+ * heuristic. Depending on context these are real or virtual qubit indices.
+ */
+using QubitPair = utils::Pair<utils::UInt, utils::UInt>;
+
+/**
+ * Computes the SABRE lookahead cost for the given front layer and extended
+ * window of two-qubit gates, given in real qubit indices, after the states of
+ * the real qubits have been permuted as described by moved (see
+ * Alter::get_permutation()). The cost is the average number of hops between
+ * the operands of the front layer gates, plus extended_weight times the same
+ * average for the extended window. Decay is not included; callers multiply by
+ * the decay factor of the swapped qubits themselves.
+ */
+utils::Real compute_sabre_cost(
+    const com::Topology &topology,
+    const utils::Vec<QubitPair> &front,
+    const utils::Vec<QubitPair> &extended,
+    utils::Real extended_weight,
+    const utils::Map<utils::UInt, utils::UInt> &moved
+);
+
+/**
+ * Refines the initial placement for a kernel the way SABRE does it: the
+ * two-qubit gates of the kernel are routed in forward and then in reverse
+ * order, only tracking the qubit mapping, and the mapping at the end of the
+ * reverse pass is used as the initial mapping for the actual routing. The idea
+ * is that the mapping that routing converges to at the end of the reversed
+ * circuit is a good fit for the start of the original circuit.
+ *
+ * Dependencies are derived from the qubit operands of the two-qubit gates
+ * only; single-qubit gates never require routing, and commutation is not taken
+ * into account. Because this only affects the initial placement, these
+ * simplifications never affect correctness.
+ */
+class SabrePlacer {
+private:
+
+    /**
+     * The platform being mapped to.
+     */
+    ir::compat::PlatformRef platform;
+
+    /**
+     * The parsed option structure for the mapping pass.
+     */
+    OptionsRef options;
+
+    /**
+     * Number of real qubits.
+     */
+    utils::UInt nq;
+
+    /**
+     * Allocates the lowest-indexed free real qubit for the given unmapped
+     * virtual qubit, in the same way that QubitMapping::allocate() would.
+     */
+    void allocate(
+        utils::UInt virt,
+        utils::Vec<utils::UInt> &v2r,
+        utils::Vec<utils::UInt> &r2v
+    ) const;
+
+    /**
+     * Simulates routing of the given list of two-qubit gates (in virtual qubit
+     * indices), updating the given virtual-to-real and real-to-virtual maps
+     * along the way. Returns false if routing got stuck, in which case the maps
+     * are left in an undefined state.
+     */
+    utils::Bool route_pass(
+        const utils::Vec<QubitPair> &gates,
+        utils::Vec<utils::UInt> &v2r,
+        utils::Vec<utils::UInt> &r2v
+    ) const;
+
+public:
+
+    /**
+     * Initializes the placer for the given platform and options.
+     */
+    void initialize(const ir::compat::PlatformRef &p, const OptionsRef &opt);
+
+    /**
+     * Refines the given initial mapping for the given kernel using the
+     * configured number of forward/reverse passes. Returns whether the mapping
+     * was modified. When routing gets stuck (which can only happen for
+     * topologies where not all qubits are connected), the mapping is left
+     * as it was.
+     */
+    utils::Bool refine(const ir::compat::KernelRef &k, com::map::QubitMapping &v2r) const;
+
+};
+
+} // namespace detail
+} // namespace map
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
@@ -4,6 +4,8 @@
 
 #include "ql/pass/map/qubits/map/map.h"
 
+#include "ql/utils/budget.h"
+#include "ql/com/options.h"
 #include "detail/mapper.h"
 
 namespace ql {
@@ -114,6 +116,11 @@ void MapQubitsPass::dump_docs(
       usage (the latter especially when a lot of alternative solutions are
       generated before a choice is made). Based on these options, time and space
       complexity can be anywhere from linear to exponential!
+
+      When the topology is fully connected (and not multi-core), no gate ever
+      needs routing. Kernels that only consist of gates on at most two qubits
+      are then mapped to their real qubits and decomposed into primitives in a
+      single linear pass, regardless of the routing options.
 )" R"(
     * Decomposition into primitives *
 
@@ -126,6 +133,26 @@ void MapQubitsPass::dump_docs(
     )");
 }
 
+/**
+ * Returns whether the result of the mapper may be restored from the pass
+ * cache. This is the case when all tie-breaking and path selection is
+ * deterministic or explicitly seeded, the MIP placer (which has a time limit)
+ * is disabled, the annealing placer has no timeout, no compile-time budget is
+ * imposed, and no output files are to be written.
+ */
+utils::Bool MapQubitsPass::is_cacheable() const {
+    utils::Bool seeded = options["seed"].as_uint() != 0;
+    return (seeded || options["tie_break_method"].as_str() != "random")
+        && (seeded || options["path_selection_mode"].as_str() != "random")
+        && options["scheduler_heuristic"].as_str() != "random"
+        && !options["enable_mip_placer"].as_bool()
+        && options["anneal_timeout"].as_real() == 0.0
+        && options["time_budget"].as_real() == 0.0
+        && com::options::global["max_compile_time"].as_real() == 0.0
+        && !options["write_dot_graphs"].as_bool()
+        && !options["write_profile"].as_bool();
+}
+
 /**
  * Returns a user-friendly type name for this pass.
  */
@@ -181,12 +208,112 @@ MapQubitsPass::MapQubitsPass(
 
     options.add_int(
         "mip_horizon",
-        "This controls how many two-qubit gates the MIP-based initial placement "
-        "algorithm considers for each kernel (if enabled). If 0 or unspecified, "
-        "all gates are considered.",
+        "This controls how many two-qubit gates the MIP-based and "
+        "annealing-based initial placement algorithms consider for each kernel "
+        "(if enabled). If 0 or unspecified, all gates are considered.",
+        "0", 0, utils::MAX
+    );
+
+    options.add_bool(
+        "mip_warm_start",
+        "Controls whether the MIP-based initial placement algorithm (if "
+        "enabled) should be warm-started from the incoming mapping, by bounding "
+        "the objective by the cost of that mapping. This is most effective "
+        "in combination with `enable_anneal_placer`, as the MIP-based "
+        "algorithm then starts from the placement found by annealing. "
+        "Regardless of this option, kernels with identical interaction graphs "
+        "are only solved once.",
+        true
+    );
+
+    //========================================================================//
+    // Options for the simulated annealing initial placement engine           //
+    //========================================================================//
+
+    options.add_bool(
+        "enable_anneal_placer",
+        "Controls whether the simulated-annealing-based initial placement "
+        "algorithm should be run before resorting to heuristic mapping. Unlike "
+        "the MIP-based algorithm, this algorithm scales to devices with "
+        "hundreds or thousands of qubits, but it does not guarantee that an "
+        "optimal placement is found. The resulting placement is only used when "
+        "it is better than the incoming mapping. The MIP-based algorithm, if "
+        "enabled, runs afterwards, and overrides the placement if it finds a "
+        "solution.",
+        false
+    );
+
+    options.add_int(
+        "anneal_moves_per_qubit",
+        "The number of simulated annealing moves performed by each annealing "
+        "chain of the annealing-based placer, per virtual qubit taking part in "
+        "a two-qubit gate within `mip_horizon`. The runtime of the placer is "
+        "proportional to this.",
+        "1000", 0, utils::MAX
+    );
+
+    options.add_int(
+        "anneal_chains",
+        "The number of independent simulated annealing chains run by the "
+        "annealing-based placer. The best placement found by any chain is "
+        "used.",
+        "4", 1, utils::MAX
+    );
+
+    options.add_int(
+        "anneal_threads",
+        "The maximum number of threads used to run the annealing chains of the "
+        "annealing-based placer in parallel. 0 means one thread per hardware "
+        "thread. The placement found does not depend on this, unless "
+        "`anneal_timeout` is used.",
+        "1", 0, utils::MAX
+    );
+
+    options.add_real(
+        "anneal_timeout",
+        "Timeout for the annealing-based placer in seconds, or 0 to disable "
+        "the timeout. When the timeout expires, the best placement found thus "
+        "far is used. Note that this makes the result nondeterministic.",
+        "0",
+        0.0, utils::INF
+    );
+
+    //========================================================================//
+    // Options for the multi-core partitioner                                 //
+    //========================================================================//
+
+    options.add_bool(
+        "enable_core_partitioner",
+        "Controls whether the virtual qubits should be partitioned over the "
+        "cores of a multi-core platform before routing, such that as few "
+        "two-qubit gates as possible act on qubits in different cores. The "
+        "partition is computed using multilevel graph partitioning of the "
+        "two-qubit gate interaction graph, and is only used when it is better "
+        "than the incoming mapping. This has no effect for single-core "
+        "platforms. The MIP-based initial placement algorithm, if enabled, "
+        "runs afterwards, and overrides the partition if it finds a solution.",
+        false
+    );
+
+    options.add_int(
+        "core_partitioner_horizon",
+        "This controls how many two-qubit gates the multi-core partitioner "
+        "considers for each kernel (if enabled). If 0 or unspecified, all gates "
+        "are considered.",
         "0", 0, utils::MAX
     );
 
+    options.add_real(
+        "core_partitioner_half_life",
+        "When nonzero, the multi-core partitioner weighs two-qubit gates that "
+        "are executed early in the kernel heavier than those executed later, "
+        "as the mapping will have drifted away from the initial mapping by "
+        "then. The weight of a gate is halved for every this many layers of "
+        "two-qubit gates that precede it.",
+        "0",
+        0.0, utils::INF
+    );
+
     //========================================================================//
     // Options controlling the heuristic routing algorithm                    //
     //========================================================================//
@@ -203,10 +330,15 @@ MapQubitsPass::MapQubitsPass(
         "the best alternatives in terms of circuit duration within some"
         "lookahead window. The existence of the `rc` suffix specifies whether "
         "the internal scheduling for fitness determination should be done with "
-        "or without resource constraints. `maxfidelity` is not supported "
+        "or without resource constraints. `sabre` scores each alternative by "
+        "the resulting distances between the operands of the available "
+        "two-qubit gates and a window of upcoming two-qubit gates (see the "
+        "`sabre_*` options), without any speculation, such that its execution "
+        "time is linear in the number of gates; this is the recommended "
+        "heuristic for large topologies. `maxfidelity` is not supported "
         "in this build of OpenQL.",
         "base",
-        {"base", "baserc", "minextend", "minextendrc", "maxfidelity"}
+        {"base", "baserc", "minextend", "minextendrc", "maxfidelity", "sabre"}
     );
 
     options.add_int(
@@ -218,6 +350,119 @@ MapQubitsPass::MapQubitsPass(
         0, utils::MAX
     );
 
+    options.add_real(
+        "time_budget",
+        "Compile-time budget for this pass in seconds, or 0 to only observe "
+        "the global `max_compile_time` budget. Once the budget is exhausted, "
+        "the `minextend`, `minextendrc`, and `maxfidelity` heuristics fall "
+        "back to `base` for the remaining routing decisions, and the number "
+        "of alternative routing solutions generated is limited as if "
+        "`max_alternative_routes` were set to a small number. Note that this "
+        "makes the result depend on timing.",
+        "0",
+        0.0, utils::INF
+    );
+
+    options.add_int(
+        "route_threads",
+        "Controls how many threads are used to extend and score the "
+        "alternative routing solutions for a routing step. Each alternative is "
+        "evaluated independently, and the result is the same as for "
+        "single-threaded evaluation, so the tie-breaking method is unaffected. "
+        "This is most useful for large topologies and the `minextend` and "
+        "`minextendrc` heuristics, where many alternatives need to be "
+        "scheduled. 0 means that all hardware threads are used.",
+        "1",
+        0, utils::MAX
+    );
+
+    options.add_bool(
+        "batch_scoring",
+        "Controls whether the alternative routing solutions for a routing step "
+        "are scored in a single batch, rather than by extending a speculative "
+        "copy of the past for each of them. The swap chains of all "
+        "alternatives are flattened into arrays of free-cycle deltas on top "
+        "of the current past, which are then evaluated in lockstep, so only "
+        "the qubits along the paths are touched. The scores are the same as "
+        "those of the regular evaluation. This only applies to the `base` and "
+        "`minextend` heuristics when `use_move_gates` is disabled and the "
+        "gates implementing swaps only act on the swapped qubits; otherwise "
+        "this option has no effect.",
+        false
+    );
+
+    options.add_int(
+        "kernel_threads",
+        "Controls how many kernels are mapped concurrently. Kernels are always "
+        "mapped independently of each other (inter-kernel mapping is not "
+        "supported), and the random numbers used for the `random` "
+        "tie-breaking and path selection methods depend only on `seed` and "
+        "the index of the kernel, so this does not affect the result. "
+        "Statistics are still "
+        "reported in program order. 0 means that all hardware threads are "
+        "used. Note that the threads used for `route_threads` are spawned per "
+        "kernel thread.",
+        "1",
+        0, utils::MAX
+    );
+
+    options.add_bool(
+        "reuse_routing",
+        "Controls whether kernels with exactly the same gates as an earlier "
+        "kernel, such as the kernels of an unrolled loop, reuse the result of "
+        "mapping that earlier kernel rather than being mapped again. Since "
+        "each kernel starts from the same initial mapping, this only affects "
+        "the result when `tie_break_method` or `path_selection_mode` is "
+        "`random`, in which case repeated kernels get the same result as the "
+        "first one. Kernels of which the mapped gates include anything other "
+        "than instructions from the platform configuration are always mapped "
+        "again.",
+        true
+    );
+
+    options.add_bool(
+        "loop_invariant_mapping",
+        "Controls whether the kernels that form the body of a loop "
+        "route the qubits back to the mapping they started with at their end, "
+        "by means of additional swaps. Loops are kept rolled, so their body "
+        "is mapped only once, but without this the mapping at the end of an "
+        "iteration generally differs from the mapping that the next "
+        "iteration assumes. Virtual qubits that are first used within the "
+        "body are not restored.",
+        false
+    );
+
+    options.add_int(
+        "multi_start",
+        "Number of times each kernel is mapped, each time with a differently "
+        "seeded random number generator, keeping the best result according to "
+        "`multi_start_metric`. This is only useful when `tie_break_method` "
+        "or `path_selection_mode` is `random`; otherwise all runs give the "
+        "same result. The runs are performed concurrently using up to "
+        "`multi_start_threads` threads.",
+        "1",
+        1, utils::MAX
+    );
+
+    options.add_int(
+        "multi_start_threads",
+        "Controls how many threads are used to perform the runs requested "
+        "using `multi_start` concurrently. 0 means that all hardware threads "
+        "are used.",
+        "1",
+        0, utils::MAX
+    );
+
+    options.add_enum(
+        "multi_start_metric",
+        "The metric used to select the best result when `multi_start` is "
+        "more than 1. `swaps` keeps the result with the fewest swaps and moves, "
+        "`depth` keeps the result with the lowest circuit depth. Ties are "
+        "broken in favor of the earliest run.",
+        "swaps",
+        {"swaps", "depth"}
+    );
+
     options.add_enum(
         "tie_break_method",
         "Controls how to tie-break equally-scoring alternative mapping "
@@ -234,6 +479,19 @@ MapQubitsPass::MapQubitsPass(
         {"first", "last", "random", "critical"}
     );
 
+    options.add_int(
+        "seed",
+        "Seed for the random number generator used by the `random` "
+        "tie-breaking and path selection methods, or 0 to seed it from the "
+        "current time. The random numbers for each routing decision are "
+        "drawn from a separate stream identified by the index of the kernel "
+        "and of the decision within it, so for a given nonzero seed the "
+        "result is reproducible regardless of `kernel_threads`, "
+        "`route_threads`, and `multi_start_threads`.",
+        "0",
+        0, utils::MAX
+    );
+
     options.add_enum(
         "lookahead_mode",
         "Controls the strategy for selecting the next gate(s) to map. When `no`, "
@@ -259,6 +517,35 @@ MapQubitsPass::MapQubitsPass(
         {"no", "1qfirst", "noroutingfirst", "all"}
     );
 
+    options.add_int(
+        "stream_window",
+        "When nonzero, kernels with more gates than this are routed in "
+        "windows of this many gates rather than all at once, to bound the "
+        "memory used by the router for very long kernels. Each window is "
+        "mapped completely before the next one is started, using a dependency "
+        "graph (and thus criticality) computed over that window only, and the "
+        "gates the router has committed to are moved to the output circuit "
+        "after each window. Thus, gates are never reordered across window "
+        "boundaries. When `write_dot_graphs` is set, the dependency graph "
+        "written is that of the last window. Has no effect when "
+        "`lookahead_mode` is `no`, since the dependency graph isn't used then.",
+        "0", 0, utils::MAX
+    );
+
+    options.add_int(
+        "lookahead_window",
+        "When nonzero, the dependency graph and criticality of kernels with "
+        "more gates than this are computed over a sliding window of this "
+        "many gates rather than over the whole kernel up front. Only the "
+        "first half of each window is mapped; the second half serves as "
+        "lookahead for criticality and the `sabre` heuristic, and is mapped "
+        "as part of the next window, which starts where the mapped part "
+        "ended. Like with `stream_window`, gates are never reordered across "
+        "the boundary between the mapped halves. Overrides `stream_window`. "
+        "Has no effect when `lookahead_mode` is `no`.",
+        "0", 0, utils::MAX
+    );
+
     options.add_enum(
         "path_selection_mode",
         "Controls whether to consider all paths from a source to destination "
@@ -272,6 +559,19 @@ MapQubitsPass::MapQubitsPass(
         {"all", "borders", "random"}
     );
 
+    options.add_bool(
+        "prune_equivalent_alters",
+        "Whether to discard routing alternatives that result in the same "
+        "placement of the virtual qubits as an alternative generated earlier "
+        "for the same gate, before they are evaluated. Different paths often "
+        "only differ in which unused qubits are swapped around, so this can "
+        "substantially reduce the number of alternatives to score. The first "
+        "alternative of each equivalence class is kept, so the result remains "
+        "deterministic, but it may differ from the result without pruning "
+        "because the discarded alternatives may schedule differently.",
+        false
+    );
+
     options.add_enum(
         "swap_selection_mode",
         "This controls how routing interacts with speculation. When `all`, all"
@@ -328,6 +628,66 @@ MapQubitsPass::MapQubitsPass(
         0.0, 1.0
     );
 
+    options.add_int(
+        "beam_width",
+        "Only used for the `minextend` and `minextendrc` heuristics. When "
+        "nonzero, the recursive search for the best alternative routing "
+        "solution is replaced by a beam search that keeps this many of the "
+        "best speculative states for each routing step, and "
+        "`recursion_depth_limit` limits the number of additional steps. "
+        "Unlike for recursion, the runtime grows linearly with both.",
+        "0",
+        0, utils::MAX
+    );
+
+    options.add_real(
+        "beam_lookahead_weight",
+        "Only used when `beam_width` is nonzero. Beam search states are ranked "
+        "by their cycle extension plus this weight times the minimum number of "
+        "swaps that the gates that need routing next still need.",
+        "1",
+        0.0, utils::INF
+    );
+
+    options.add_int(
+        "sabre_extended_set_size",
+        "Only used for the `sabre` heuristic. Controls how many upcoming "
+        "two-qubit gates beyond the currently available gates are taken into "
+        "account when scoring routing alternatives.",
+        "20",
+        0, utils::MAX
+    );
+
+    options.add_real(
+        "sabre_extended_set_weight",
+        "Only used for the `sabre` heuristic. The weight of the upcoming "
+        "two-qubit gates relative to the currently available gates when "
+        "scoring routing alternatives.",
+        "0.5",
+        0.0, utils::INF
+    );
+
+    options.add_real(
+        "sabre_decay",
+        "Only used for the `sabre` heuristic. Each time a qubit is swapped, "
+        "the score of alternatives that swap it again is penalized by this "
+        "factor, to favor routing that can be done in parallel. The penalties "
+        "are reset whenever a routed gate is mapped.",
+        "0.001",
+        0.0, utils::INF
+    );
+
+    options.add_int(
+        "sabre_placement_passes",
+        "Only used for the `sabre` heuristic. Controls how many times the "
+        "two-qubit gates of a kernel are routed in forward and then reverse "
+        "order before the actual routing is done, to refine the initial "
+        "placement: the qubit mapping at the end of each reverse pass is used "
+        "as the starting point for the next pass. 0 disables refinement.",
+        "1",
+        0, utils::MAX
+    );
+
     options.add_int(
         "use_moves",
         "Controls if/when the mapper inserts move gates rather than swap gates "
@@ -383,6 +743,21 @@ MapQubitsPass::MapQubitsPass(
         false
     );
 
+    options.add_bool(
+        "write_profile",
+        "Whether to write a JSON file with performance counters for each "
+        "kernel, named `<output_prefix>_<kernel>_profile.json`. It "
+        "contains the number of routing alternatives generated, the number of "
+        "times `max_alters` cut alternative generation short, the number of "
+        "alternatives discarded by `prune_equivalent_alters`, the number of "
+        "speculative pasts created, the maximum recursion depth reached, the "
+        "number of swaps and moves added, and the time spent generating "
+        "paths, scoring alternatives, and scheduling (which overlaps with "
+        "scoring). Times are in seconds, and are summed over all threads when "
+        "`route_threads` is not 1.",
+        false
+    );
+
 }
 
 /**
@@ -405,6 +780,15 @@ pmgr::pass_types::NodeType MapQubitsPass::on_construct(
     parsed_options->assume_prep_only_initializes = options["assume_prep_only_initializes"].as_bool();
     parsed_options->enable_mip_placer = options["enable_mip_placer"].as_bool();
     parsed_options->mip_horizon = options["mip_horizon"].as_uint();
+    parsed_options->mip_warm_start = options["mip_warm_start"].as_bool();
+    parsed_options->enable_anneal_placer = options["enable_anneal_placer"].as_bool();
+    parsed_options->anneal_moves_per_qubit = options["anneal_moves_per_qubit"].as_uint();
+    parsed_options->anneal_chains = options["anneal_chains"].as_uint();
+    parsed_options->num_anneal_threads = options["anneal_threads"].as_uint();
+    parsed_options->anneal_timeout = options["anneal_timeout"].as_real();
+    parsed_options->enable_core_partitioner = options["enable_core_partitioner"].as_bool();
+    parsed_options->core_partitioner_horizon = options["core_partitioner_horizon"].as_uint();
+    parsed_options->core_partitioner_half_life = options["core_partitioner_half_life"].as_real();
 
     auto route_heuristic = options["route_heuristic"].as_str();
     if (route_heuristic == "base") {
@@ -417,11 +801,32 @@ pmgr::pass_types::NodeType MapQubitsPass::on_construct(
         parsed_options->heuristic = detail::Heuristic::MIN_EXTEND_RC;
     } else if (route_heuristic == "maxfidelity") {
         parsed_options->heuristic = detail::Heuristic::MAX_FIDELITY;
+    } else if (route_heuristic == "sabre") {
+        parsed_options->heuristic = detail::Heuristic::SABRE;
     } else {
         QL_ASSERT(false);
     }
 
     parsed_options->max_alters = options["max_alternative_routes"].as_uint();
+    parsed_options->seed = options["seed"].as_uint();
+    parsed_options->time_budget = options["time_budget"].as_real();
+    parsed_options->num_route_threads = options["route_threads"].as_uint();
+    parsed_options->batch_scoring = options["batch_scoring"].as_bool();
+    parsed_options->num_kernel_threads = options["kernel_threads"].as_uint();
+    parsed_options->reuse_routing = options["reuse_routing"].as_bool();
+    parsed_options->loop_invariant_mapping = options["loop_invariant_mapping"].as_bool();
+    parsed_options->prune_equivalent_alters = options["prune_equivalent_alters"].as_bool();
+    parsed_options->multi_start_runs = options["multi_start"].as_uint();
+    parsed_options->num_multi_start_threads = options["multi_start_threads"].as_uint();
+
+    auto multi_start_metric = options["multi_start_metric"].as_str();
+    if (multi_start_metric == "swaps") {
+        parsed_options->multi_start_metric = detail::MultiStartMetric::SWAPS;
+    } else if (multi_start_metric == "depth") {
+        parsed_options->multi_start_metric = detail::MultiStartMetric::DEPTH;
+    } else {
+        QL_ASSERT(false);
+    }
 
     auto tie_break_method = options["tie_break_method"].as_str();
     if (tie_break_method == "first") {
@@ -448,6 +853,8 @@ pmgr::pass_types::NodeType MapQubitsPass::on_construct(
     } else {
         QL_ASSERT(false);
     }
+    parsed_options->stream_window = options["stream_window"].as_uint();
+    parsed_options->lookahead_window = options["lookahead_window"].as_uint();
 
     auto path_selection_mode = options["path_selection_mode"].as_str();
     if (path_selection_mode == "all") {
@@ -481,6 +888,12 @@ pmgr::pass_types::NodeType MapQubitsPass::on_construct(
 
     parsed_options->recursion_width_factor = options["recursion_width_factor"].as_real();
     parsed_options->recursion_width_exponent = options["recursion_width_exponent"].as_real();
+    parsed_options->beam_width = options["beam_width"].as_uint();
+    parsed_options->beam_lookahead_weight = options["beam_lookahead_weight"].as_real();
+    parsed_options->sabre_extended_set_size = options["sabre_extended_set_size"].as_uint();
+    parsed_options->sabre_extended_set_weight = options["sabre_extended_set_weight"].as_real();
+    parsed_options->sabre_decay = options["sabre_decay"].as_real();
+    parsed_options->sabre_placement_passes = options["sabre_placement_passes"].as_uint();
 
     auto use_moves = options["use_moves"].as_str();
     if (use_moves == "no") {
@@ -498,6 +911,7 @@ pmgr::pass_types::NodeType MapQubitsPass::on_construct(
     parsed_options->commute_single_qubit = options["commute_single_qubit"].as_bool();
     parsed_options->enable_criticality = options["scheduler_heuristic"].as_str() == "path_length";
     parsed_options->write_dot_graphs = options["write_dot_graphs"].as_bool();
+    parsed_options->write_profile = options["write_profile"].as_bool();
 
     return pmgr::pass_types::NodeType::NORMAL;
 }
@@ -513,7 +927,8 @@ utils::Int MapQubitsPass::run(
     // Update options from context.
     parsed_options->output_prefix = context.output_prefix;
 
-    // Run mapping.
+    // Run mapping within this pass' compile-time budget.
+    utils::TimeBudget budget{parsed_options->time_budget};
     detail::Mapper().map(program, parsed_options.as_const());
 
     return 0;
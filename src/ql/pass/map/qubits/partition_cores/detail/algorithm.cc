@@ -0,0 +1,637 @@
+/** \file
+ * Multi-core qubit partitioning engine.
+ */
+
+#include "algorithm.h"
+
+#include <cmath>
+#include <algorithm>
+#include "ql/utils/map.h"
+#include "ql/utils/logger.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace partition_cores {
+namespace detail {
+
+using namespace utils;
+
+/**
+ * Graphs with at most this many nodes per core are not coarsened any further.
+ */
+static const UInt COARSEST_NODES_PER_CORE = 4;
+
+/**
+ * Maximum number of refinement passes over all nodes per level.
+ */
+static const UInt MAX_REFINEMENT_PASSES = 8;
+
+/**
+ * Minimum reduction of the cut weight for a move or swap to be considered an
+ * improvement, to prevent cycling due to rounding errors.
+ */
+static const Real EPSILON = 1.0e-9;
+
+/**
+ * String conversion for partitioning results.
+ */
+std::ostream &operator<<(std::ostream &os, Result result) {
+    switch (result) {
+        case Result::ANY:       os << "any";        break;
+        case Result::CURRENT:   os << "current";    break;
+        case Result::NEW_MAP:   os << "newmap";     break;
+    }
+    return os;
+}
+
+/**
+ * Returns the total node weight assigned to each core by the given partition.
+ */
+static Vec<UInt> get_loads(
+    const Vec<UInt> &node_weights,
+    const Vec<UInt> &part,
+    UInt num_cores
+) {
+    Vec<UInt> loads(num_cores, 0);
+    for (UInt node = 0; node < node_weights.size(); node++) {
+        loads[part[node]] += node_weights[node];
+    }
+    return loads;
+}
+
+/**
+ * Coarsens the given graph using heavy-edge matching, such that no node of the
+ * resulting graph is heavier than max_node_weight. The coarse node for each
+ * fine node is returned via fine_to_coarse.
+ */
+Algorithm::Graph Algorithm::coarsen(
+    const Graph &fine,
+    UInt max_node_weight,
+    Vec<UInt> &fine_to_coarse
+) {
+    UInt num_fine = fine.node_weights.size();
+    fine_to_coarse.assign(num_fine, MAX);
+    Graph coarse;
+
+    // Match each node with the unmatched neighbor it shares its heaviest edge
+    // with. Nodes with few neighbors are visited first, as they have the
+    // fewest opportunities to be matched.
+    Vec<UInt> order(num_fine);
+    for (UInt node = 0; node < num_fine; node++) {
+        order[node] = node;
+    }
+    std::stable_sort(order.begin(), order.end(), [&fine](UInt a, UInt b) {
+        return fine.edges[a].size() < fine.edges[b].size();
+    });
+    Vec<Vec<UInt>> members;
+    for (auto node : order) {
+        if (fine_to_coarse[node] != MAX) {
+            continue;
+        }
+        UInt match = MAX;
+        Real match_weight = 0.0;
+        for (const auto &edge : fine.edges[node]) {
+            if (fine_to_coarse[edge.first] != MAX) {
+                continue;
+            }
+            if (fine.node_weights[node] + fine.node_weights[edge.first] > max_node_weight) {
+                continue;
+            }
+            if (match == MAX || edge.second > match_weight) {
+                match = edge.first;
+                match_weight = edge.second;
+            }
+        }
+        fine_to_coarse[node] = members.size();
+        coarse.node_weights.push_back(fine.node_weights[node]);
+        members.push_back({node});
+        if (match != MAX) {
+            fine_to_coarse[match] = fine_to_coarse[node];
+            coarse.node_weights.back() += fine.node_weights[match];
+            members.back().push_back(match);
+        }
+    }
+
+    // Merge the edges of the members of each coarse node, dropping the ones
+    // between its members.
+    UInt num_coarse = members.size();
+    coarse.edges.resize(num_coarse);
+    Vec<UInt> index(num_coarse, MAX);
+    for (UInt node = 0; node < num_coarse; node++) {
+        auto &edges = coarse.edges[node];
+        for (auto member : members[node]) {
+            for (const auto &edge : fine.edges[member]) {
+                UInt neighbor = fine_to_coarse[edge.first];
+                if (neighbor == node) {
+                    continue;
+                }
+                if (index[neighbor] == MAX) {
+                    index[neighbor] = edges.size();
+                    edges.emplace_back(neighbor, 0.0);
+                }
+                edges[index[neighbor]].second += edge.second;
+            }
+        }
+        for (const auto &edge : edges) {
+            index[edge.first] = MAX;
+        }
+    }
+
+    return coarse;
+}
+
+/**
+ * Computes the total weight of the edges between the given node and each core
+ * for the given partition. Neighbors that have not been assigned to a core yet
+ * (i.e. that map to MAX) are ignored.
+ */
+void Algorithm::get_connectivity(
+    const Graph &graph,
+    const Vec<UInt> &part,
+    UInt node,
+    Vec<Real> &connectivity
+) const {
+    connectivity.assign(num_cores, 0.0);
+    for (const auto &edge : graph.edges[node]) {
+        UInt core = part[edge.first];
+        if (core != MAX) {
+            connectivity[core] += edge.second;
+        }
+    }
+}
+
+/**
+ * Computes an initial partition for the given (coarsest) graph using greedy
+ * graph growing. Cores may end up overloaded if the nodes cannot be packed into
+ * them.
+ */
+void Algorithm::initial_partition(
+    const Graph &graph,
+    Vec<UInt> &part
+) const {
+    UInt num_nodes = graph.node_weights.size();
+    part.assign(num_nodes, MAX);
+    Vec<UInt> loads(num_cores, 0);
+    Vec<Real> attached(num_nodes, 0.0);
+    Vec<Real> connectivity;
+    for (UInt step = 0; step < num_nodes; step++) {
+
+        // Select the unassigned node that is most strongly connected to the
+        // nodes assigned thus far. Heavier nodes are preferred on ties, as
+        // they are harder to pack.
+        UInt node = MAX;
+        for (UInt candidate = 0; candidate < num_nodes; candidate++) {
+            if (part[candidate] != MAX) {
+                continue;
+            }
+            if (
+                node == MAX
+                || attached[candidate] > attached[node]
+                || (
+                    attached[candidate] == attached[node]
+                    && graph.node_weights[candidate] > graph.node_weights[node]
+                )
+            ) {
+                node = candidate;
+            }
+        }
+
+        // Assign it to the core with room for it that it is most strongly
+        // connected to, preferring the emptiest core on ties, such that
+        // unconnected parts of the graph are spread out. If it doesn't fit
+        // anywhere, overload the emptiest core; this is fixed by rebalance()
+        // once the graph is fully uncoarsened.
+        UInt weight = graph.node_weights[node];
+        get_connectivity(graph, part, node, connectivity);
+        UInt best = MAX;
+        for (UInt core = 0; core < num_cores; core++) {
+            if (loads[core] + weight > core_size) {
+                continue;
+            }
+            if (
+                best == MAX
+                || connectivity[core] > connectivity[best]
+                || (connectivity[core] == connectivity[best] && loads[core] < loads[best])
+            ) {
+                best = core;
+            }
+        }
+        if (best == MAX) {
+            best = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        }
+        part[node] = best;
+        loads[best] += weight;
+        for (const auto &edge : graph.edges[node]) {
+            attached[edge.first] += edge.second;
+        }
+
+    }
+}
+
+/**
+ * Moves nodes out of overloaded cores into cores with room left, choosing the
+ * nodes that increase the cut the least. Always succeeds when all nodes have
+ * weight one.
+ */
+void Algorithm::rebalance(
+    const Graph &graph,
+    Vec<UInt> &part
+) const {
+    UInt num_nodes = graph.node_weights.size();
+    auto loads = get_loads(graph.node_weights, part, num_cores);
+    Vec<Real> connectivity;
+    while (true) {
+        UInt best_node = MAX;
+        UInt best_core = MAX;
+        Real best_loss = 0.0;
+        for (UInt node = 0; node < num_nodes; node++) {
+            UInt from = part[node];
+            if (loads[from] <= core_size) {
+                continue;
+            }
+            get_connectivity(graph, part, node, connectivity);
+            for (UInt core = 0; core < num_cores; core++) {
+                if (core == from || loads[core] + graph.node_weights[node] > core_size) {
+                    continue;
+                }
+                Real loss = connectivity[from] - connectivity[core];
+                if (best_node == MAX || loss < best_loss) {
+                    best_node = node;
+                    best_core = core;
+                    best_loss = loss;
+                }
+            }
+        }
+        if (best_node == MAX) {
+            break;
+        }
+        loads[part[best_node]] -= graph.node_weights[best_node];
+        loads[best_core] += graph.node_weights[best_node];
+        part[best_node] = best_core;
+    }
+}
+
+/**
+ * Refines the given partition by greedily moving nodes to other cores and
+ * swapping pairs of nodes between cores when this reduces the cut, without
+ * overloading any core.
+ */
+void Algorithm::refine(
+    const Graph &graph,
+    Vec<UInt> &part
+) const {
+    UInt num_nodes = graph.node_weights.size();
+    auto loads = get_loads(graph.node_weights, part, num_cores);
+    Vec<Real> connectivity;
+    Vec<Real> other_connectivity;
+    Vec<Real> edge_to(num_nodes, 0.0);
+    for (UInt pass = 0; pass < MAX_REFINEMENT_PASSES; pass++) {
+        Bool improved = false;
+        for (UInt node = 0; node < num_nodes; node++) {
+            UInt from = part[node];
+            UInt weight = graph.node_weights[node];
+            get_connectivity(graph, part, node, connectivity);
+
+            // Try to move the node to the core with room for it that reduces
+            // the cut the most.
+            UInt best_core = MAX;
+            Real best_gain = EPSILON;
+            Bool wants_out = false;
+            for (UInt core = 0; core < num_cores; core++) {
+                if (core == from) {
+                    continue;
+                }
+                Real gain = connectivity[core] - connectivity[from];
+                if (gain > EPSILON) {
+                    wants_out = true;
+                }
+                if (loads[core] + weight > core_size) {
+                    continue;
+                }
+                if (gain > best_gain) {
+                    best_core = core;
+                    best_gain = gain;
+                }
+            }
+            if (best_core != MAX) {
+                loads[from] -= weight;
+                loads[best_core] += weight;
+                part[node] = best_core;
+                improved = true;
+                continue;
+            }
+
+            // If that isn't possible because the cores it would rather be in
+            // are full, try to swap it with a node from one of those cores.
+            // The edge between the swapped nodes, if any, remains cut.
+            if (!wants_out) {
+                continue;
+            }
+            for (const auto &edge : graph.edges[node]) {
+                edge_to[edge.first] = edge.second;
+            }
+            UInt best_other = MAX;
+            best_gain = EPSILON;
+            for (UInt other = 0; other < num_nodes; other++) {
+                UInt to = part[other];
+                if (to == from || connectivity[to] - connectivity[from] <= EPSILON) {
+                    continue;
+                }
+                UInt other_weight = graph.node_weights[other];
+                if (
+                    loads[from] - weight + other_weight > core_size
+                    || loads[to] - other_weight + weight > core_size
+                ) {
+                    continue;
+                }
+                get_connectivity(graph, part, other, other_connectivity);
+                Real gain = connectivity[to] - connectivity[from]
+                          + other_connectivity[from] - other_connectivity[to]
+                          - 2.0 * edge_to[other];
+                if (gain > best_gain) {
+                    best_other = other;
+                    best_gain = gain;
+                }
+            }
+            for (const auto &edge : graph.edges[node]) {
+                edge_to[edge.first] = 0.0;
+            }
+            if (best_other != MAX) {
+                UInt to = part[best_other];
+                loads[from] += graph.node_weights[best_other] - weight;
+                loads[to] += weight - graph.node_weights[best_other];
+                part[node] = to;
+                part[best_other] = from;
+                improved = true;
+            }
+
+        }
+        if (!improved) {
+            break;
+        }
+    }
+}
+
+/**
+ * Returns the total weight of the edges cut by the given partition.
+ */
+Real Algorithm::compute_cut(
+    const Graph &graph,
+    const Vec<UInt> &part
+) {
+    Real total = 0.0;
+    for (UInt node = 0; node < graph.edges.size(); node++) {
+        for (const auto &edge : graph.edges[node]) {
+            if (edge.first > node && part[edge.first] != part[node]) {
+                total += edge.second;
+            }
+        }
+    }
+    return total;
+}
+
+/**
+ * Computes a partition of the virtual qubits of the given kernel over the
+ * cores of its platform, and, if it cuts fewer interactions than the given
+ * mapping, replaces the mapping with one that implements it.
+ */
+Result Algorithm::run(
+    const ir::compat::KernelRef &kernel,
+    const Options &opt,
+    com::map::QubitMapping &v2r
+) {
+
+    // Initialize ourselves for the given kernel.
+    options = opt;
+    const auto &topology = kernel->platform->topology;
+    UInt nq = kernel->platform->qubit_count;
+    num_cores = topology->get_num_cores();
+    core_size = nq / num_cores;
+    cut = 0.0;
+    original_cut = -1.0;
+    if (num_cores <= 1) {
+        QL_DOUT("PartitionCores: single-core platform, so any mapping is ok");
+        return Result::ANY;
+    }
+
+    // Accumulate the interaction weights per pair of virtual qubits. The
+    // weight of each two-qubit gate depends on the layer it would end up in
+    // when scheduling only the two-qubit gates ASAP.
+    Map<Pair<UInt, UInt>, Real> interactions;
+    Vec<UInt> depth(nq, 0);
+    UInt num_two_qubit_gates = 0;
+    for (const auto &gate : kernel->gates) {
+        const auto &q = gate->operands;
+        if (q.size() != 2 || q[0] == q[1]) {
+            continue;
+        }
+        if (options.horizon != 0 && num_two_qubit_gates >= options.horizon) {
+            break;
+        }
+        num_two_qubit_gates++;
+        UInt layer = std::max(depth[q[0]], depth[q[1]]);
+        depth[q[0]] = depth[q[1]] = layer + 1;
+        Real weight = 1.0;
+        if (options.half_life > 0.0) {
+            weight = std::pow(0.5, layer / options.half_life);
+        }
+        interactions.set({std::min(q[0], q[1]), std::max(q[0], q[1])}) += weight;
+    }
+    if (interactions.empty()) {
+        QL_DOUT("PartitionCores: no two-qubit gates found, so any mapping is ok");
+        return Result::ANY;
+    }
+
+    // Build the finest graph, with a node for each interacting virtual qubit.
+    Vec<UInt> node_of(nq, MAX);
+    for (const auto &interaction : interactions) {
+        node_of[interaction.first.first] = 0;
+        node_of[interaction.first.second] = 0;
+    }
+    Vec<UInt> qubit_of;
+    for (UInt qubit = 0; qubit < nq; qubit++) {
+        if (node_of[qubit] != MAX) {
+            node_of[qubit] = qubit_of.size();
+            qubit_of.push_back(qubit);
+        }
+    }
+    UInt num_nodes = qubit_of.size();
+    Vec<Graph> levels(1);
+    levels[0].node_weights.resize(num_nodes, 1);
+    levels[0].edges.resize(num_nodes);
+    for (const auto &interaction : interactions) {
+        UInt a = node_of[interaction.first.first];
+        UInt b = node_of[interaction.first.second];
+        levels[0].edges[a].emplace_back(b, interaction.second);
+        levels[0].edges[b].emplace_back(a, interaction.second);
+    }
+
+    // Coarsen the graph until it is small enough or stops shrinking
+    // significantly. Coarse nodes are limited to half a core, to leave the
+    // initial partitioning some freedom to pack them.
+    Vec<Vec<UInt>> fine_to_coarse;
+    UInt max_node_weight = std::max<UInt>(1, core_size / 2);
+    while (levels.back().node_weights.size() > num_cores * COARSEST_NODES_PER_CORE) {
+        Vec<UInt> mapping;
+        auto coarse = coarsen(levels.back(), max_node_weight, mapping);
+        if (coarse.node_weights.size() * 20 > levels.back().node_weights.size() * 19) {
+            break;
+        }
+        levels.push_back(std::move(coarse));
+        fine_to_coarse.push_back(std::move(mapping));
+    }
+    QL_DOUT(
+        "PartitionCores: " << num_nodes << " interacting qubits, "
+        << num_two_qubit_gates << " two-qubit gates, "
+        << levels.size() << " levels"
+    );
+
+    // Partition the coarsest graph, and project the partition back to the
+    // finest graph, refining it at each level.
+    Vec<UInt> part;
+    UInt level = levels.size() - 1;
+    initial_partition(levels[level], part);
+    while (true) {
+        if (level == 0) {
+            rebalance(levels[0], part);
+        }
+        refine(levels[level], part);
+        if (level == 0) {
+            break;
+        }
+        level--;
+        Vec<UInt> fine_part(levels[level].node_weights.size());
+        for (UInt node = 0; node < fine_part.size(); node++) {
+            fine_part[node] = part[fine_to_coarse[level][node]];
+        }
+        part = std::move(fine_part);
+    }
+    cut = compute_cut(levels[0], part);
+
+    // Compare with the current mapping, if it is complete.
+    Vec<UInt> original_part(num_nodes);
+    Bool complete = true;
+    for (UInt node = 0; node < num_nodes; node++) {
+        UInt real = v2r[qubit_of[node]];
+        if (real == com::map::UNDEFINED_QUBIT) {
+            complete = false;
+            break;
+        }
+        original_part[node] = topology->get_core_index(real);
+    }
+    if (complete) {
+        original_cut = compute_cut(levels[0], original_part);
+    }
+    QL_DOUT("PartitionCores: cut=" << cut << " original cut=" << original_cut);
+    if (complete && cut >= original_cut - EPSILON) {
+        QL_DOUT("PartitionCores: current mapping cuts no more interactions, so current mapping is ok");
+        return Result::CURRENT;
+    }
+
+    // Keep the interacting qubits that are already in the right core where
+    // they are.
+    Vec<UInt> new_v2r(nq, com::map::UNDEFINED_QUBIT);
+    Vec<Bool> taken(nq, false);
+    Vec<UInt> remaining;
+    for (UInt node = 0; node < num_nodes; node++) {
+        UInt real = v2r[qubit_of[node]];
+        if (real != com::map::UNDEFINED_QUBIT && topology->get_core_index(real) == part[node]) {
+            new_v2r[qubit_of[node]] = real;
+            taken[real] = true;
+        } else {
+            remaining.push_back(node);
+        }
+    }
+
+    // Place the other interacting qubits in the free real qubits of their
+    // core, giving the communication qubits to the qubits that interact most
+    // with other cores.
+    Vec<Real> external(num_nodes, 0.0);
+    for (UInt node = 0; node < num_nodes; node++) {
+        for (const auto &edge : levels[0].edges[node]) {
+            if (part[edge.first] != part[node]) {
+                external[node] += edge.second;
+            }
+        }
+    }
+    std::stable_sort(remaining.begin(), remaining.end(), [&external](UInt a, UInt b) {
+        return external[a] > external[b];
+    });
+    for (auto node : remaining) {
+        UInt real = com::map::UNDEFINED_QUBIT;
+        for (UInt candidate = part[node] * core_size; candidate < (part[node] + 1) * core_size; candidate++) {
+            if (taken[candidate]) {
+                continue;
+            }
+            if (real == com::map::UNDEFINED_QUBIT) {
+                real = candidate;
+            }
+            if (topology->is_comm_qubit(candidate)) {
+                real = candidate;
+                break;
+            }
+        }
+        QL_ASSERT(real != com::map::UNDEFINED_QUBIT);
+        new_v2r[qubit_of[node]] = real;
+        taken[real] = true;
+    }
+
+    // Place the remaining virtual qubits that were mapped before, or all of
+    // them if map_all is set, keeping them where they are if possible.
+    UInt next_free = 0;
+    for (UInt qubit = 0; qubit < nq; qubit++) {
+        if (node_of[qubit] != MAX) {
+            continue;
+        }
+        UInt real = v2r[qubit];
+        if (real != com::map::UNDEFINED_QUBIT && !taken[real]) {
+            new_v2r[qubit] = real;
+            taken[real] = true;
+        }
+    }
+    for (UInt qubit = 0; qubit < nq; qubit++) {
+        if (node_of[qubit] != MAX || new_v2r[qubit] != com::map::UNDEFINED_QUBIT) {
+            continue;
+        }
+        if (v2r[qubit] == com::map::UNDEFINED_QUBIT && !options.map_all) {
+            continue;
+        }
+        while (taken[next_free]) {
+            next_free++;
+        }
+        new_v2r[qubit] = next_free;
+        taken[next_free] = true;
+    }
+
+    v2r.set_virt_to_real(new_v2r);
+    QL_IF_LOG_DEBUG {
+        QL_DOUT("PartitionCores: resulting mapping");
+        v2r.dump_state();
+    }
+    return Result::NEW_MAP;
+}
+
+/**
+ * Returns the weight of the interactions cut by the partition found by the
+ * last call to run().
+ */
+Real Algorithm::get_cut() const {
+    return cut;
+}
+
+/**
+ * Returns the weight of the interactions cut by the mapping passed to the last
+ * call to run(), or -1 if that mapping was incomplete.
+ */
+Real Algorithm::get_original_cut() const {
+    return original_cut;
+}
+
+} // namespace detail
+} // namespace partition_cores
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
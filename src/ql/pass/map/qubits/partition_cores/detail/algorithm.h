@@ -0,0 +1,256 @@
+/** \file
+ * Multi-core qubit partitioning engine.
+ *
+ * For multi-core platforms, two-qubit gates between qubits in different cores
+ * require inter-core communication, which is far more expensive than routing
+ * within a core, and is additionally limited by the inter-core channels. This
+ * engine computes an initial virtual to real qubit mapping that assigns the
+ * virtual qubits to cores such that the (time-weighted) number of two-qubit
+ * gates that cross a core boundary is minimized, leaving the placement within
+ * each core to the router.
+ *
+ * The problem is modelled as balanced graph partitioning. Each virtual qubit
+ * that takes part in a two-qubit gate is a node, and each pair of interacting
+ * qubits is an edge, weighted by the sum over their two-qubit gates of
+ * 0.5^(t/half_life), where t is the two-qubit gate layer in which the gate
+ * would be executed in an ASAP schedule that only considers two-qubit gates.
+ * Thus, interactions that happen early in the kernel, when the mapping is
+ * still close to the initial mapping, weigh heavier than later ones. The
+ * number of nodes in each part is limited by the number of qubits per core.
+ *
+ * The partitioning itself is multilevel, in the style of METIS:
+ *
+ *  - the graph is repeatedly coarsened by merging nodes along heavy edges
+ *    (heavy-edge matching), until it is small enough or no longer shrinks;
+ *  - the coarsest graph is partitioned using greedy graph growing, i.e. by
+ *    repeatedly assigning the node most strongly connected to the nodes
+ *    assigned thus far to the core it is most strongly connected to;
+ *  - the partition is then projected back through the levels, refining it at
+ *    each level with greedy moves and pairwise swaps of nodes between cores
+ *    that reduce the weight of the cut edges.
+ *
+ * Finally, the qubits assigned to each core are mapped to real qubits of that
+ * core, keeping them where they are when they're already there, and otherwise
+ * preferring communication qubits for the qubits that interact most with
+ * other cores.
+ */
+
+#pragma once
+
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/com/map/qubit_mapping.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace partition_cores {
+namespace detail {
+
+/**
+ * Options structure for configuring the partitioning algorithm.
+ */
+struct Options {
+
+    /**
+     * The partitioning algorithm will only consider the first horizon
+     * two-qubit gates of a kernel. 0 means that all gates should be
+     * considered.
+     */
+    utils::UInt horizon = 0;
+
+    /**
+     * The number of two-qubit gate layers after which the weight of an
+     * interaction is halved. 0 means that all interactions weigh the same.
+     */
+    utils::Real half_life = 0.0;
+
+    /**
+     * When set, any virtual qubits not used in the original kernel will also
+     * be mapped to real qubits.
+     */
+    utils::Bool map_all = false;
+
+};
+
+/**
+ * Enumeration of the possible algorithm outcomes.
+ */
+enum class Result {
+
+    /**
+     * Any mapping will do, because the platform has only one core or there
+     * are no two-qubit gates in the circuit.
+     */
+    ANY,
+
+    /**
+     * The current mapping will do, because it does not cut more interactions
+     * than the partition that was found.
+     */
+    CURRENT,
+
+    /**
+     * A new mapping was found that cuts fewer interactions than the current
+     * mapping.
+     */
+    NEW_MAP
+
+};
+
+/**
+ * String conversion for partitioning results.
+ */
+std::ostream &operator<<(std::ostream &os, Result result);
+
+/**
+ * Multi-core qubit partitioning algorithm.
+ */
+class Algorithm {
+private:
+
+    /**
+     * Weighted, undirected graph for a single level of the multilevel
+     * partitioning algorithm.
+     */
+    struct Graph {
+
+        /**
+         * The weight of each node, i.e. the number of virtual qubits it
+         * represents.
+         */
+        utils::Vec<utils::UInt> node_weights;
+
+        /**
+         * The adjacency list of each node, as pairs of neighbor and edge
+         * weight. Each edge is listed for both its nodes.
+         */
+        utils::Vec<utils::Vec<utils::Pair<utils::UInt, utils::Real>>> edges;
+
+    };
+
+    /**
+     * The options that we're being called with.
+     */
+    Options options;
+
+    /**
+     * The number of cores of the platform.
+     */
+    utils::UInt num_cores = 1;
+
+    /**
+     * The number of qubits per core, i.e. the maximum weight of each part.
+     */
+    utils::UInt core_size = 0;
+
+    /**
+     * Weight of the interactions cut by the partition that was found by the
+     * last call to run().
+     */
+    utils::Real cut = 0.0;
+
+    /**
+     * Weight of the interactions cut by the mapping passed to the last call to
+     * run(), or -1 if that mapping did not define a real qubit for all
+     * interacting virtual qubits.
+     */
+    utils::Real original_cut = -1.0;
+
+    /**
+     * Coarsens the given graph using heavy-edge matching, such that no node
+     * of the resulting graph is heavier than max_node_weight. The coarse node
+     * for each fine node is returned via fine_to_coarse.
+     */
+    static Graph coarsen(
+        const Graph &fine,
+        utils::UInt max_node_weight,
+        utils::Vec<utils::UInt> &fine_to_coarse
+    );
+
+    /**
+     * Computes the total weight of the edges between the given node and each
+     * core for the given partition.
+     */
+    void get_connectivity(
+        const Graph &graph,
+        const utils::Vec<utils::UInt> &part,
+        utils::UInt node,
+        utils::Vec<utils::Real> &connectivity
+    ) const;
+
+    /**
+     * Computes an initial partition for the given (coarsest) graph using
+     * greedy graph growing. Cores may end up overloaded if the nodes cannot be
+     * packed into them.
+     */
+    void initial_partition(
+        const Graph &graph,
+        utils::Vec<utils::UInt> &part
+    ) const;
+
+    /**
+     * Moves nodes out of overloaded cores into cores with room left, choosing
+     * the nodes that increase the cut the least. Always succeeds when all
+     * nodes have weight one.
+     */
+    void rebalance(
+        const Graph &graph,
+        utils::Vec<utils::UInt> &part
+    ) const;
+
+    /**
+     * Refines the given partition by greedily moving nodes to other cores and
+     * swapping pairs of nodes between cores when this reduces the cut,
+     * without overloading any core.
+     */
+    void refine(
+        const Graph &graph,
+        utils::Vec<utils::UInt> &part
+    ) const;
+
+    /**
+     * Returns the total weight of the edges cut by the given partition.
+     */
+    static utils::Real compute_cut(
+        const Graph &graph,
+        const utils::Vec<utils::UInt> &part
+    );
+
+public:
+
+    /**
+     * Computes a partition of the virtual qubits of the given kernel over the
+     * cores of its platform, and, if it cuts fewer interactions than the
+     * given mapping, replaces the mapping with one that implements it.
+     */
+    Result run(
+        const ir::compat::KernelRef &kernel,
+        const Options &options,
+        com::map::QubitMapping &v2r
+    );
+
+    /**
+     * Returns the weight of the interactions cut by the partition found by the
+     * last call to run().
+     */
+    utils::Real get_cut() const;
+
+    /**
+     * Returns the weight of the interactions cut by the mapping passed to the
+     * last call to run(), or -1 if that mapping was incomplete.
+     */
+    utils::Real get_original_cut() const;
+
+};
+
+} // namespace detail
+} // namespace partition_cores
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
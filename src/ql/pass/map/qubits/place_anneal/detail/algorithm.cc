@@ -0,0 +1,493 @@
+/** \file
+ * Heuristic initial placement engine.
+ */
+
+#include "algorithm.h"
+
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include "ql/utils/logger.h"
+#include "ql/utils/parallel.h"
+#include "ql/com/ana/interaction_matrix.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace place_anneal {
+namespace detail {
+
+using namespace utils;
+
+/**
+ * The number of random moves used to estimate the initial temperature.
+ */
+static const UInt NUM_TEMPERATURE_SAMPLES = 1000;
+
+/**
+ * The final temperature. As costs are integral, this makes accepting a cost
+ * increase practically impossible toward the end of each chain.
+ */
+static const Real FINAL_TEMPERATURE = 0.1;
+
+/**
+ * The number of moves between checks of the deadline.
+ */
+static const UInt DEADLINE_CHECK_INTERVAL = 1024;
+
+/**
+ * String conversion for heuristic placement results.
+ */
+std::ostream &operator<<(std::ostream &os, Result result) {
+    switch (result) {
+        case Result::ANY:       os << "any";        break;
+        case Result::CURRENT:   os << "current";    break;
+        case Result::NEW_MAP:   os << "newmap";     break;
+    }
+    return os;
+}
+
+/**
+ * Returns the cost of the given placement, mapping facilities to locations.
+ */
+UInt Algorithm::get_cost(const Vec<UInt> &placement) const {
+    const auto &topology = kernel->platform->topology;
+    UInt total = 0;
+    for (UInt i = 0; i < nfac; i++) {
+        for (const auto &interaction : interactions[i]) {
+            if (interaction.first > i) {
+                total += interaction.second * (topology->get_distance(
+                    placement[i], placement[interaction.first]
+                ) - 1);
+            }
+        }
+    }
+    return total;
+}
+
+/**
+ * Constructs the seed placement by greedily embedding the interaction graph
+ * into the topology.
+ */
+Vec<UInt> Algorithm::get_seed() const {
+    const auto &topology = kernel->platform->topology;
+    Vec<UInt> placement(nfac, MAX);
+    Vec<Bool> taken(nlocs, false);
+    Vec<UInt> attached(nfac, 0);
+    Vec<UInt> total(nfac, 0);
+    for (UInt i = 0; i < nfac; i++) {
+        for (const auto &interaction : interactions[i]) {
+            total[i] += interaction.second;
+        }
+    }
+    for (UInt step = 0; step < nfac; step++) {
+
+        // Select the unplaced facility that interacts most with the placed
+        // facilities, preferring facilities with many interactions on ties.
+        UInt fac = MAX;
+        for (UInt i = 0; i < nfac; i++) {
+            if (placement[i] != MAX) {
+                continue;
+            }
+            if (
+                fac == MAX
+                || attached[i] > attached[fac]
+                || (attached[i] == attached[fac] && total[i] > total[fac])
+            ) {
+                fac = i;
+            }
+        }
+
+        UInt loc = MAX;
+        if (attached[fac] == 0) {
+
+            // This is the first facility of a connected component of the
+            // interaction graph, so place it where it has the most room to
+            // grow, i.e. at the free location with the most free neighbors.
+            UInt loc_free = 0;
+            for (UInt k = 0; k < nlocs; k++) {
+                if (taken[k]) {
+                    continue;
+                }
+                UInt num_free = 0;
+                for (auto l : neighbors[k]) {
+                    if (!taken[l]) {
+                        num_free++;
+                    }
+                }
+                if (loc == MAX || num_free > loc_free) {
+                    loc = k;
+                    loc_free = num_free;
+                }
+            }
+
+        } else {
+
+            // Place the facility at the free location that minimizes the cost
+            // of its interactions with the facilities placed thus far.
+            UInt loc_cost = MAX;
+            for (UInt k = 0; k < nlocs; k++) {
+                if (taken[k]) {
+                    continue;
+                }
+                UInt k_cost = 0;
+                for (const auto &interaction : interactions[fac]) {
+                    UInt other = placement[interaction.first];
+                    if (other != MAX) {
+                        k_cost += interaction.second * (topology->get_distance(k, other) - 1);
+                    }
+                }
+                if (k_cost < loc_cost) {
+                    loc = k;
+                    loc_cost = k_cost;
+                }
+            }
+
+        }
+        QL_ASSERT(loc != MAX);
+
+        placement[fac] = loc;
+        taken[loc] = true;
+        for (const auto &interaction : interactions[fac]) {
+            attached[interaction.first] += interaction.second;
+        }
+
+    }
+    return placement;
+}
+
+/**
+ * Runs a single simulated annealing chain starting from (and updating) the
+ * given placement, using the given random seed, until the configured number of
+ * moves has been performed or the given deadline has passed. Returns the cost
+ * of the best placement found, which is returned via placement as well.
+ */
+UInt Algorithm::anneal(
+    Vec<UInt> &placement,
+    UInt seed,
+    std::chrono::steady_clock::time_point deadline
+) const {
+    const auto &topology = kernel->platform->topology;
+
+    // NOTE: the random numbers are drawn from the generator directly rather
+    // than through the standard distributions, because the latter differ
+    // between standard library implementations.
+    std::mt19937 rng(seed);
+    auto uniform = [&rng]() -> Real {
+        return rng() / (static_cast<Real>(std::mt19937::max()) + 1.0);
+    };
+
+    Vec<UInt> occupant(nlocs, MAX);
+    for (UInt i = 0; i < nfac; i++) {
+        occupant[placement[i]] = i;
+    }
+
+    // Proposes a random move, returning the facility to move and the location
+    // to move it to. The facility that occupies that location, if any, is to
+    // be moved to the original location of the moved facility. Returns false
+    // if the proposed move is a no-op.
+    auto propose = [&](UInt &fac, UInt &loc) -> Bool {
+        fac = rng() % nfac;
+        const auto &partners = interactions[fac];
+        UInt partner = partners[rng() % partners.size()].first;
+        const auto &candidates = neighbors[placement[partner]];
+        if (candidates.empty()) {
+            return false;
+        }
+        loc = candidates[rng() % candidates.size()];
+        return loc != placement[fac];
+    };
+
+    // Returns the change in cost resulting from the given move. The distance
+    // between the two facilities involved in a swap does not change.
+    auto get_delta = [&](UInt fac, UInt loc) -> Int {
+        UInt from = placement[fac];
+        UInt other = occupant[loc];
+        Int delta = 0;
+        for (const auto &interaction : interactions[fac]) {
+            if (interaction.first == other) {
+                continue;
+            }
+            UInt at = placement[interaction.first];
+            delta += (Int)interaction.second * (
+                (Int)topology->get_distance(loc, at)
+                - (Int)topology->get_distance(from, at)
+            );
+        }
+        if (other != MAX) {
+            for (const auto &interaction : interactions[other]) {
+                if (interaction.first == fac) {
+                    continue;
+                }
+                UInt at = placement[interaction.first];
+                delta += (Int)interaction.second * (
+                    (Int)topology->get_distance(from, at)
+                    - (Int)topology->get_distance(loc, at)
+                );
+            }
+        }
+        return delta;
+    };
+
+    // Applies the given move.
+    auto apply = [&](UInt fac, UInt loc) {
+        UInt from = placement[fac];
+        UInt other = occupant[loc];
+        placement[fac] = loc;
+        occupant[loc] = fac;
+        occupant[from] = other;
+        if (other != MAX) {
+            placement[other] = from;
+        }
+    };
+
+    // Estimate the initial temperature as the average cost increase of
+    // random moves that increase the cost.
+    UInt fac, loc;
+    Real uphill_total = 0.0;
+    UInt uphill_count = 0;
+    for (UInt i = 0; i < NUM_TEMPERATURE_SAMPLES; i++) {
+        if (propose(fac, loc)) {
+            Int delta = get_delta(fac, loc);
+            if (delta > 0) {
+                uphill_total += delta;
+                uphill_count++;
+            }
+        }
+    }
+    Real temperature = FINAL_TEMPERATURE;
+    if (uphill_count) {
+        temperature = std::max(temperature, uphill_total / uphill_count);
+    }
+
+    // Anneal.
+    UInt num_moves = options.moves_per_qubit * nfac;
+    Real cooling = 1.0;
+    if (num_moves) {
+        cooling = std::pow(FINAL_TEMPERATURE / temperature, 1.0 / num_moves);
+    }
+    Int current_cost = get_cost(placement);
+    Int best_cost = current_cost;
+    Vec<UInt> best = placement;
+    for (UInt move = 0; move < num_moves; move++) {
+        if (
+            move % DEADLINE_CHECK_INTERVAL == 0
+            && std::chrono::steady_clock::now() > deadline
+        ) {
+            QL_DOUT("PlaceAnneal: chain " << seed << " timed out after " << move << " moves");
+            break;
+        }
+        temperature *= cooling;
+        if (!propose(fac, loc)) {
+            continue;
+        }
+        Int delta = get_delta(fac, loc);
+        if (delta > 0 && uniform() >= std::exp(-delta / temperature)) {
+            continue;
+        }
+        apply(fac, loc);
+        current_cost += delta;
+        if (current_cost < best_cost) {
+            best_cost = current_cost;
+            best = placement;
+        }
+    }
+
+    placement = std::move(best);
+    return best_cost;
+}
+
+/**
+ * Runs the algorithm to find an initial placement of the virtual qubits for
+ * the given kernel with the given options. v2r is updated when a placement is
+ * found that is better than v2r itself.
+ */
+Result Algorithm::run(
+    const ir::compat::KernelRef &k,
+    const Options &opt,
+    com::map::QubitMapping &v2r
+) {
+    auto start = std::chrono::steady_clock::now();
+    auto finish = [this, &start](Result result) {
+        time_taken = std::chrono::duration<Real>(std::chrono::steady_clock::now() - start).count();
+        QL_DOUT("PlaceAnneal: result=" << result << " cost=" << cost << " time taken=" << time_taken << " seconds");
+        return result;
+    };
+
+    // Initialize ourselves for the given kernel.
+    options = opt;
+    kernel = k;
+    const auto &topology = kernel->platform->topology;
+    nlocs = kernel->platform->qubit_count;
+    cost = 0;
+    original_cost = MAX;
+    time_taken = 0.0;
+
+    // Find the interacting virtual qubits within the horizon, and number them
+    // contiguously as facilities.
+    Vec<UInt> fac_of(nlocs, MAX);
+    Vec<UInt> qubit_of;
+    Vec<Pair<UInt, UInt>> pairs;
+    UInt num_two_qubit_gates = 0;
+    for (const auto &gate : kernel->gates) {
+        const auto &q = gate->operands;
+        if (q.size() != 2 || q[0] == q[1]) {
+            continue;
+        }
+        if (options.horizon != 0 && num_two_qubit_gates >= options.horizon) {
+            break;
+        }
+        num_two_qubit_gates++;
+        for (auto v : q) {
+            if (fac_of[v] == MAX) {
+                fac_of[v] = qubit_of.size();
+                qubit_of.push_back(v);
+            }
+        }
+        pairs.emplace_back(fac_of[q[0]], fac_of[q[1]]);
+        pairs.emplace_back(fac_of[q[1]], fac_of[q[0]]);
+    }
+    nfac = qubit_of.size();
+    if (!nfac) {
+        QL_DOUT("PlaceAnneal: no two-qubit gates found, so any mapping is ok");
+        return finish(Result::ANY);
+    }
+    const com::ana::InteractionMatrix refcount(nfac, pairs);
+    interactions.assign(nfac, {});
+    for (UInt i = 0; i < nfac; i++) {
+        for (const auto &entry : refcount.get_row(i)) {
+            interactions[i].emplace_back(entry.qubit, entry.count);
+        }
+    }
+    neighbors.assign(nlocs, {});
+    for (UInt q = 0; q < nlocs; q++) {
+        for (auto n : topology->get_neighbor_span(q)) {
+            neighbors[q].push_back(n);
+        }
+    }
+
+    // Determine the cost of the current mapping, if it is complete.
+    Vec<UInt> original(nfac);
+    Bool complete = true;
+    for (UInt i = 0; i < nfac; i++) {
+        original[i] = v2r[qubit_of[i]];
+        if (original[i] == com::map::UNDEFINED_QUBIT) {
+            complete = false;
+            break;
+        }
+    }
+    if (complete) {
+        original_cost = get_cost(original);
+        if (original_cost == 0) {
+            QL_DOUT("PlaceAnneal: in current map, all two-qubit gates are nearest neighbor, so current map is ok");
+            return finish(Result::CURRENT);
+        }
+    }
+
+    // Construct the seed placement.
+    auto seed = get_seed();
+    auto seed_cost = get_cost(seed);
+    if (complete && original_cost < seed_cost) {
+        seed = original;
+        seed_cost = original_cost;
+    }
+    QL_DOUT(
+        "PlaceAnneal: " << nfac << " facilities, " << num_two_qubit_gates
+        << " two-qubit gates, seed cost=" << seed_cost
+        << " original cost=" << original_cost
+    );
+
+    // Run the annealing chains.
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (options.timeout > 0.0) {
+        deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<Real>(options.timeout)
+        );
+    }
+    UInt num_chains = std::max<UInt>(1, options.num_chains);
+    Vec<Vec<UInt>> placements(num_chains, seed);
+    Vec<UInt> costs(num_chains, MAX);
+    parallel_for(num_chains, options.num_threads, [&](UInt i) {
+        costs[i] = anneal(placements[i], i + 1, deadline);
+    });
+    UInt best = 0;
+    for (UInt i = 1; i < num_chains; i++) {
+        if (costs[i] < costs[best]) {
+            best = i;
+        }
+    }
+    cost = costs[best];
+    if (complete && cost >= original_cost) {
+        cost = original_cost;
+        return finish(Result::CURRENT);
+    }
+
+    // Copy the placement to v2r. The virtual qubits that aren't facilities
+    // keep their real qubit if it is still free; otherwise, they are moved to
+    // the lowest free real qubit. Virtual qubits that weren't mapped before
+    // remain unmapped unless map_all is set.
+    Vec<UInt> new_v2r(nlocs, com::map::UNDEFINED_QUBIT);
+    Vec<Bool> taken(nlocs, false);
+    for (UInt i = 0; i < nfac; i++) {
+        new_v2r[qubit_of[i]] = placements[best][i];
+        taken[placements[best][i]] = true;
+    }
+    for (UInt v = 0; v < nlocs; v++) {
+        UInt real = v2r[v];
+        if (fac_of[v] == MAX && real != com::map::UNDEFINED_QUBIT && !taken[real]) {
+            new_v2r[v] = real;
+            taken[real] = true;
+        }
+    }
+    UInt next_free = 0;
+    for (UInt v = 0; v < nlocs; v++) {
+        if (fac_of[v] != MAX || new_v2r[v] != com::map::UNDEFINED_QUBIT) {
+            continue;
+        }
+        if (v2r[v] == com::map::UNDEFINED_QUBIT && !options.map_all) {
+            continue;
+        }
+        while (taken[next_free]) {
+            next_free++;
+        }
+        new_v2r[v] = next_free;
+        taken[next_free] = true;
+    }
+    v2r.set_virt_to_real(new_v2r);
+    QL_IF_LOG_DEBUG {
+        QL_DOUT("PlaceAnneal: resulting mapping");
+        v2r.dump_state();
+    }
+
+    return finish(Result::NEW_MAP);
+}
+
+/**
+ * Returns the cost of the placement found by the last call to run().
+ */
+UInt Algorithm::get_cost() const {
+    return cost;
+}
+
+/**
+ * Returns the cost of the mapping passed to the last call to run(), or MAX if
+ * that mapping was incomplete.
+ */
+UInt Algorithm::get_original_cost() const {
+    return original_cost;
+}
+
+/**
+ * Returns the amount of time taken by the last call to run() in seconds.
+ */
+Real Algorithm::get_time_taken() const {
+    return time_taken;
+}
+
+} // namespace detail
+} // namespace place_anneal
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
@@ -0,0 +1,238 @@
+/** \file
+ * Heuristic initial placement engine.
+ *
+ * Like the MIP-based placer (see place_mip), this engine tries to find an
+ * initial placement of the virtual qubits that minimizes
+ *
+ *     sum i: sum j: refcount[i][j] * (distance(loc[i], loc[j]) - 1)
+ *
+ * over the two-qubit gates within the placement horizon, but it does so
+ * heuristically, such that it remains usable for devices with hundreds or
+ * thousands of qubits. The number of variables of the MIP model is quadratic
+ * in the number of qubits, making that approach intractable beyond roughly 20
+ * qubits.
+ *
+ * The placement is found in two steps:
+ *
+ *  - a seed placement is constructed by greedily embedding the interaction
+ *    graph into the topology: starting with the most strongly interacting
+ *    virtual qubit at the best-connected real qubit, each next virtual qubit is
+ *    the one most strongly interacting with the qubits placed thus far, and is
+ *    placed at the free real qubit that minimizes the above cost for those
+ *    interactions. If the incoming mapping is complete and better, it is used
+ *    as seed instead;
+ *  - a number of independent simulated annealing chains then improve this
+ *    seed, each using its own random number generator seed. Each move
+ *    relocates a virtual qubit to a neighbor of the real qubit of one of the
+ *    qubits it interacts with, swapping it with the virtual qubit that is
+ *    already there (if any). The temperature is cooled geometrically from an
+ *    estimate of the typical cost increase of a move to near zero over the
+ *    configured number of moves. The best placement found by any chain wins.
+ *
+ * The chains can be run in parallel. The result only depends on the number of
+ * chains, not on the number of threads, unless a timeout is configured.
+ */
+
+#pragma once
+
+#include <chrono>
+#include "ql/utils/num.h"
+#include "ql/utils/str.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/com/map/qubit_mapping.h"
+
+namespace ql {
+namespace pass {
+namespace map {
+namespace qubits {
+namespace place_anneal {
+namespace detail {
+
+/**
+ * Options structure for configuring the heuristic placement algorithm.
+ */
+struct Options {
+
+    /**
+     * The placement algorithm will only consider the first horizon two-qubit
+     * gates of a kernel. 0 means that all gates should be considered.
+     */
+    utils::UInt horizon = 0;
+
+    /**
+     * The number of simulated annealing moves per chain, per virtual qubit
+     * that takes part in a two-qubit gate.
+     */
+    utils::UInt moves_per_qubit = 1000;
+
+    /**
+     * The number of independent simulated annealing chains.
+     */
+    utils::UInt num_chains = 4;
+
+    /**
+     * The maximum number of threads to run the chains with, or 0 to use all
+     * hardware threads.
+     */
+    utils::UInt num_threads = 1;
+
+    /**
+     * Timeout for the annealing step in seconds, or 0 to disable timeout.
+     * When the timeout expires, the best placement found thus far is used.
+     */
+    utils::Real timeout = 0.0;
+
+    /**
+     * When set, any virtual qubits not used in the original kernel will also
+     * be mapped to real qubits.
+     */
+    utils::Bool map_all = false;
+
+};
+
+/**
+ * Enumeration of the possible algorithm outcomes.
+ */
+enum class Result {
+
+    /**
+     * Any mapping will do, because there are no two-qubit gates in the circuit.
+     */
+    ANY,
+
+    /**
+     * The current mapping will do, because all two-qubit gates are
+     * nearest-neighbor, or because no better placement was found.
+     */
+    CURRENT,
+
+    /**
+     * A placement was found that is better than the current mapping.
+     */
+    NEW_MAP
+
+};
+
+/**
+ * String conversion for heuristic placement results.
+ */
+std::ostream &operator<<(std::ostream &os, Result result);
+
+/**
+ * Heuristic initial placement algorithm.
+ */
+class Algorithm {
+private:
+
+    /**
+     * The options that we're being called with.
+     */
+    Options options;
+
+    /**
+     * Reference to the kernel we're operating on.
+     */
+    ir::compat::KernelRef kernel;
+
+    /**
+     * Number of locations, i.e. real qubits.
+     */
+    utils::UInt nlocs = 0;
+
+    /**
+     * Number of facilities, i.e. virtual qubits that take part in two-qubit
+     * gates within the horizon.
+     */
+    utils::UInt nfac = 0;
+
+    /**
+     * The interactions of each facility, as pairs of the other facility and
+     * the number of two-qubit gates between them.
+     */
+    utils::Vec<utils::Vec<utils::Pair<utils::UInt, utils::UInt>>> interactions;
+
+    /**
+     * The neighbors of each location.
+     */
+    utils::Vec<utils::Vec<utils::UInt>> neighbors;
+
+    /**
+     * Cost of the placement found by the last call to run().
+     */
+    utils::UInt cost = 0;
+
+    /**
+     * Cost of the mapping passed to the last call to run(), or MAX if that
+     * mapping was incomplete.
+     */
+    utils::UInt original_cost = utils::MAX;
+
+    /**
+     * Total time taken by the last call to run() in seconds.
+     */
+    utils::Real time_taken = 0.0;
+
+    /**
+     * Returns the cost of the given placement, mapping facilities to
+     * locations.
+     */
+    utils::UInt get_cost(const utils::Vec<utils::UInt> &placement) const;
+
+    /**
+     * Constructs the seed placement by greedily embedding the interaction
+     * graph into the topology.
+     */
+    utils::Vec<utils::UInt> get_seed() const;
+
+    /**
+     * Runs a single simulated annealing chain starting from (and updating) the
+     * given placement, using the given random seed, until the configured
+     * number of moves has been performed or the given deadline has passed.
+     * Returns the cost of the best placement found, which is returned via
+     * placement as well.
+     */
+    utils::UInt anneal(
+        utils::Vec<utils::UInt> &placement,
+        utils::UInt seed,
+        std::chrono::steady_clock::time_point deadline
+    ) const;
+
+public:
+
+    /**
+     * Runs the algorithm to find an initial placement of the virtual qubits
+     * for the given kernel with the given options. v2r is updated when a
+     * placement is found that is better than v2r itself.
+     */
+    Result run(
+        const ir::compat::KernelRef &k,
+        const Options &opt,
+        com::map::QubitMapping &v2r
+    );
+
+    /**
+     * Returns the cost of the placement found by the last call to run().
+     */
+    utils::UInt get_cost() const;
+
+    /**
+     * Returns the cost of the mapping passed to the last call to run(), or
+     * MAX if that mapping was incomplete.
+     */
+    utils::UInt get_original_cost() const;
+
+    /**
+     * Returns the amount of time taken by the last call to run() in seconds.
+     */
+    utils::Real get_time_taken() const;
+
+};
+
+} // namespace detail
+} // namespace place_anneal
+} // namespace qubits
+} // namespace map
+} // namespace pass
+} // namespace ql
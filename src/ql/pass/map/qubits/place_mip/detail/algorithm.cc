@@ -7,9 +7,13 @@
 #ifdef INITIALPLACE
 
 #include <thread>
+#include <algorithm>
 #include <mutex>
 #include <condition_variable>
 #include <lemon/lp.h>
+#include "ql/utils/pair.h"
+#include "ql/utils/budget.h"
+#include "ql/com/ana/interaction_matrix.h"
 
 namespace ql {
 namespace pass {
@@ -35,6 +39,43 @@ std::ostream &operator<<(std::ostream &os, Result ipr) {
     return os;
 }
 
+/**
+ * Returns the cache key for the model for the given number of locations and
+ * interaction matrix between facilities.
+ */
+Str Cache::get_key(
+    UInt nlocs,
+    const com::ana::InteractionMatrix &refcount
+) {
+    StrStrm ss;
+    ss << nlocs << "/" << refcount.get_size();
+    for (UInt i = 0; i < refcount.get_size(); i++) {
+        ss << ";";
+        for (const auto &ref : refcount.get_row(i)) {
+            ss << ref.qubit << ":" << ref.count << ",";
+        }
+    }
+    return ss.str();
+}
+
+/**
+ * Returns the placement stored for the given key, or null if there is none.
+ */
+const Vec<UInt> *Cache::find(const Str &key) const {
+    auto it = placements.find(key);
+    if (it == placements.end()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+/**
+ * Stores the placement for the given key.
+ */
+void Cache::store(const Str &key, const Vec<UInt> &placement) {
+    placements.set(key) = placement;
+}
+
 // find an initial placement of the virtual qubits for the given circuit
 // the resulting placement is put in the provided virt2real map
 // result indicates one of the result indicators (InitialPlaceResult, see above)
@@ -88,9 +129,10 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
     // at the same time, set anymap and currmap
     // anymap = there are no two-qubit gates so any map will do
     // currmap = in the current map, all two-qubit gates are NN so current map will do
+    // refcount is a sparse interaction matrix, as most facility pairs do not
+    // interact at all for larger circuits
     QL_DOUT("... compute refcount by scanning circuit");
-    Vec<Vec<UInt>>  refcount;
-    refcount.resize(nfac); for (UInt i=0; i<nfac; i++) refcount[i].resize(nfac,0);
+    Vec<Pair<UInt, UInt>> refpairs;
     Bool anymap = true;    // true when all refcounts are 0
     Bool currmap = true;   // true when in current map all two-qubit gates are NN
 
@@ -100,7 +142,7 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
         if (q.size() == 2) {
             if (options.horizon == 0 || twoqubitcount < options.horizon) {
                 anymap = false;
-                refcount[v2i[q[0]]][v2i[q[1]]] += 1;
+                refpairs.emplace_back(v2i[q[0]], v2i[q[1]]);
 
                 if (
                     v2r[q[0]] == com::map::UNDEFINED_QUBIT
@@ -113,6 +155,7 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
             twoqubitcount++;
         }
     }
+    const com::ana::InteractionMatrix refcount(nfac, refpairs);
     if (options.horizon != 0 && twoqubitcount >= options.horizon) {
         QL_DOUT("InitialPlace: only considered " << options.horizon << " of " << twoqubitcount << " two-qubit gates, so resulting mapping is not exact");
     }
@@ -129,210 +172,291 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
         return Result::CURRENT;
     }
 
-    // compute iptimetaken, start interval timer here
-    using namespace std::chrono;
-    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    // location[i] = location found for facility i
+    Vec<UInt> location;
+
+    // if the same model was solved before, reuse its solution
+    Str cache_key;
+    if (options.cache) {
+        cache_key = Cache::get_key(nlocs, refcount);
+        if (auto cached = options.cache->find(cache_key)) {
+            QL_DOUT("InitialPlace: reusing placement of identical model solved before");
+            location = *cached;
+            time_taken = 0.0;
+        }
+    }
 
-    // precompute costmax by applying formula
-    // costmax[i][k] = sum j: sum l: refcount[i][j] * distance(k,l) for facility i in location k
-    QL_DOUT("... precompute costmax by combining refcount and distances");
-    Vec<Vec<UInt>>  costmax;
-    costmax.resize(nfac); for (UInt i=0; i<nfac; i++) costmax[i].resize(nlocs,0);
-    for (UInt i = 0; i < nfac; i++) {
-        for (UInt k = 0; k < nlocs; k++) {
-            for (UInt j = 0; j < nfac; j++) {
-                for (UInt l = 0; l < nlocs; l++) {
-                    costmax[i][k] += refcount[i][j] * (platform->topology->get_distance(k, l) - 1);
+    // The solver can't be interrupted, so there's no point in building and
+    // solving the model when the compile-time budget is already exhausted.
+    if (location.empty() && utils::TimeBudget::is_exceeded()) {
+        utils::TimeBudget::report_degradation(
+            "MIP placer",
+            "skipping initial placement of kernel " + kernel->name
+        );
+        QL_DOUT("InitialPlace.body [OUT OF TIME, DID NOT FIND MAPPING]");
+        return Result::TIMED_OUT;
+    }
+
+    if (location.empty()) {
+
+        // compute iptimetaken, start interval timer here
+        using namespace std::chrono;
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+        // precompute costmax by applying formula
+        // costmax[i][k] = sum j: sum l: refcount[i][j] * distance(k,l) for facility i in location k
+        QL_DOUT("... precompute costmax by combining refcount and distances");
+        Vec<Vec<UInt>>  costmax;
+        costmax.resize(nfac); for (UInt i=0; i<nfac; i++) costmax[i].resize(nlocs,0);
+        for (UInt i = 0; i < nfac; i++) {
+            auto row = refcount.get_row(i);
+            for (UInt k = 0; k < nlocs; k++) {
+                for (const auto &ref : row) {
+                    for (UInt l = 0; l < nlocs; l++) {
+                        costmax[i][k] += ref.count * (platform->topology->get_distance(k, l) - 1);
+                    }
                 }
             }
         }
-    }
 
-    // the problem
-    // mixed integer programming
-    Mip  mip;
-
-    // variables (columns)
-    //  x[i][k] are integral, values 0 or 1
-    //      x[i][k] represents whether facility i is in location k
-    //  w[i][k] are real, values >= 0
-    //      w[i][k] represents x[i][k] * sum j: sum l: refcount[i][j] * distance(k,l) * x[j][l]
-    //       i.e. if facility i not in location k then 0
-    //       else for all facilities j in its location l sum refcount[i][j] * distance(k,l)
-    // QL_DOUT("... allocate x column variable");
-    Vec<Vec<Mip::Col>> x;
-    x.resize(nfac); for (UInt i=0; i<nfac; i++) x[i].resize(nlocs);
-    // QL_DOUT("... allocate w column variable");
-    Vec<Vec<Mip::Col>> w;
-    w.resize(nfac); for (UInt i=0; i<nfac; i++) w[i].resize(nlocs);
-    // QL_DOUT("... add/initialize x and w column variables with trivial constraints and type");
-    for (UInt i = 0; i < nfac; i++) {
-        for (UInt k = 0; k < nlocs; k++) {
-            x[i][k] = mip.addCol();
-            mip.colLowerBound(x[i][k], 0);          // 0 <= x[i][k]
-            mip.colUpperBound(x[i][k], 1);          //      x[i][k] <= 1
-            mip.colType(x[i][k], Mip::INTEGER);     // Int
-            // QL_DOUT("x[" << i << "][" << k << "] INTEGER >= 0 and <= 1");
-
-            w[i][k] = mip.addCol();
-            mip.colLowerBound(w[i][k], 0);          // 0 <= w[i][k]
-            mip.colType(w[i][k], Mip::REAL);        // real
-            // QL_DOUT("w[" << i << "][" << k << "] REAL >= 0");
+        // the problem
+        // mixed integer programming
+        Mip  mip;
+
+        // variables (columns)
+        //  x[i][k] are integral, values 0 or 1
+        //      x[i][k] represents whether facility i is in location k
+        //  w[i][k] are real, values >= 0
+        //      w[i][k] represents x[i][k] * sum j: sum l: refcount[i][j] * distance(k,l) * x[j][l]
+        //       i.e. if facility i not in location k then 0
+        //       else for all facilities j in its location l sum refcount[i][j] * distance(k,l)
+        // QL_DOUT("... allocate x column variable");
+        Vec<Vec<Mip::Col>> x;
+        x.resize(nfac); for (UInt i=0; i<nfac; i++) x[i].resize(nlocs);
+        // QL_DOUT("... allocate w column variable");
+        Vec<Vec<Mip::Col>> w;
+        w.resize(nfac); for (UInt i=0; i<nfac; i++) w[i].resize(nlocs);
+        // QL_DOUT("... add/initialize x and w column variables with trivial constraints and type");
+        for (UInt i = 0; i < nfac; i++) {
+            for (UInt k = 0; k < nlocs; k++) {
+                x[i][k] = mip.addCol();
+                mip.colLowerBound(x[i][k], 0);          // 0 <= x[i][k]
+                mip.colUpperBound(x[i][k], 1);          //      x[i][k] <= 1
+                mip.colType(x[i][k], Mip::INTEGER);     // Int
+                // QL_DOUT("x[" << i << "][" << k << "] INTEGER >= 0 and <= 1");
+
+                w[i][k] = mip.addCol();
+                mip.colLowerBound(w[i][k], 0);          // 0 <= w[i][k]
+                mip.colType(w[i][k], Mip::REAL);        // real
+                // QL_DOUT("w[" << i << "][" << k << "] REAL >= 0");
+            }
         }
-    }
 
-    // constraints (rows)
-    //  forall i: ( sum k: x[i][k] == 1 )
-    // QL_DOUT("... add/initialize sum to 1 constraint rows");
-    for (UInt i = 0; i < nfac; i++) {
-        Mip::Expr   sum;
-        Str s{};
-        Bool started = false;
+        // constraints (rows)
+        //  forall i: ( sum k: x[i][k] == 1 )
+        // QL_DOUT("... add/initialize sum to 1 constraint rows");
+        for (UInt i = 0; i < nfac; i++) {
+            Mip::Expr   sum;
+            Str s{};
+            Bool started = false;
+            for (UInt k = 0; k < nlocs; k++) {
+                sum += x[i][k];
+                if (started) {
+                    s += "+ ";
+                } else {
+                    started = true;
+                }
+                s += "x[";
+                s += to_string(i);
+                s += "][";
+                s += to_string(k);
+                s += "]";
+            }
+            mip.addRow(sum == 1);
+            s += " == 1";
+            // QL_DOUT(s);
+        }
+
+        // constraints (rows)
+        //  forall k: ( sum i: x[i][k] <= 1 )
+        //  < 1 (i.e. == 0) may apply for a k when location k doesn't contain a qubit in this solution
         for (UInt k = 0; k < nlocs; k++) {
-            sum += x[i][k];
-            if (started) {
-                s += "+ ";
-            } else {
-                started = true;
+            Mip::Expr   sum;
+            Str s{};
+            Bool started = false;
+            for (UInt i = 0; i < nfac; i++) {
+                sum += x[i][k];
+                if (started) s += "+ "; else started = true;
+                s += "x[";
+                s += to_string(i);
+                s += "][";
+                s += to_string(k);
+                s += "]";
             }
-            s += "x[";
-            s += to_string(i);
-            s += "][";
-            s += to_string(k);
-            s += "]";
+            mip.addRow(sum <= 1);
+            s += " <= 1";
+            // QL_DOUT(s);
         }
-        mip.addRow(sum == 1);
-        s += " == 1";
-        // QL_DOUT(s);
-    }
 
-    // constraints (rows)
-    //  forall k: ( sum i: x[i][k] <= 1 )
-    //  < 1 (i.e. == 0) may apply for a k when location k doesn't contain a qubit in this solution
-    for (UInt k = 0; k < nlocs; k++) {
-        Mip::Expr   sum;
-        Str s{};
-        Bool started = false;
+        // constraints (rows)
+        //  forall i, k: costmax[i][k] * x[i][k]
+        //          + sum j sum l refcount[i][j]*distance[k][l]*x[j][l] - w[i][k] <= costmax[i][k]
+        // QL_DOUT("... add/initialize nfac x nlocs constraint rows based on nfac x nlocs column combinations");
         for (UInt i = 0; i < nfac; i++) {
-            sum += x[i][k];
-            if (started) s += "+ "; else started = true;
-            s += "x[";
-            s += to_string(i);
-            s += "][";
-            s += to_string(k);
-            s += "]";
+            auto row = refcount.get_row(i);
+            for (UInt k = 0; k < nlocs; k++) {
+                Mip::Expr   left = costmax[i][k] * x[i][k];
+                Str lefts{};
+                Bool started = false;
+                for (const auto &ref : row) {
+                    UInt j = ref.qubit;
+                    for (UInt l = 0; l < nlocs; l++) {
+                        left += ref.count * platform->topology->get_distance(k, l) * x[j][l];
+                        if (ref.count * platform->topology->get_distance(k, l) != 0) {
+                            if (started) {
+                                lefts += " + ";
+                            } else {
+                                started = true;
+                            }
+                            lefts += to_string(ref.count * platform->topology->get_distance(k, l));
+                            lefts += " * x[";
+                            lefts += to_string(j);
+                            lefts += "][";
+                            lefts += to_string(l);
+                            lefts += "]";
+                        }
+                    }
+                }
+                left -= w[i][k];
+                lefts += "- w[";
+                lefts += to_string(i);
+                lefts += "][";
+                lefts += to_string(k);
+                lefts += "]";
+                Mip::Expr   right = costmax[i][k];
+                mip.addRow(left <= right);
+                // QL_DOUT(lefts << " <= " << costmax[i][k]);
+            }
         }
-        mip.addRow(sum <= 1);
-        s += " <= 1";
-        // QL_DOUT(s);
-    }
 
-    // constraints (rows)
-    //  forall i, k: costmax[i][k] * x[i][k]
-    //          + sum j sum l refcount[i][j]*distance[k][l]*x[j][l] - w[i][k] <= costmax[i][k]
-    // QL_DOUT("... add/initialize nfac x nlocs constraint rows based on nfac x nlocs column combinations");
-    for (UInt i = 0; i < nfac; i++) {
-        for (UInt k = 0; k < nlocs; k++) {
-            Mip::Expr   left = costmax[i][k] * x[i][k];
-            Str lefts{};
-            Bool started = false;
-            for (UInt j = 0; j < nfac; j++) {
-                for (UInt l = 0; l < nlocs; l++) {
-                    left += refcount[i][j] * platform->topology->get_distance(k, l) * x[j][l];
-                    if (refcount[i][j] * platform->topology->get_distance(k, l) != 0) {
-                        if (started) {
-                            lefts += " + ";
-                        } else {
-                            started = true;
+        // objective
+        Mip::Expr   objective;
+        // QL_DOUT("... add/initialize objective");
+        Str objs{};
+        Bool started = false;
+        mip.min();
+        for (UInt i = 0; i < nfac; i++) {
+            for (UInt k = 0; k < nlocs; k++) {
+                objective += w[i][k];
+                if (started) {
+                    objs += "+ ";
+                } else {
+                    started = true;
+                }
+                objs += "w[";
+                objs += to_string(i);
+                objs += "][";
+                objs += to_string(k);
+                objs += "]";
+            }
+        }
+        mip.obj(objective);
+        // QL_DOUT("MINIMIZE " << objs);
+
+        // warm start: if the incoming mapping places all facilities, bound the
+        // objective by its cost in this model, i.e. sum i: sum k: the minimal
+        // w[i][k] that satisfies the constraints for that placement, such that
+        // the solver can prune anything that doesn't improve on it
+        if (options.warm_start) {
+            Vec<UInt> incumbent(nfac, com::map::UNDEFINED_QUBIT);
+            Bool complete = true;
+            for (UInt v = 0; v < nvq; v++) {
+                if (v2i[v] != com::map::UNDEFINED_QUBIT) {
+                    incumbent[v2i[v]] = v2r[v];
+                    if (v2r[v] == com::map::UNDEFINED_QUBIT) {
+                        complete = false;
+                    }
+                }
+            }
+            if (complete) {
+                Real bound = 0.0;
+                for (UInt i = 0; i < nfac; i++) {
+                    auto row = refcount.get_row(i);
+                    for (UInt k = 0; k < nlocs; k++) {
+                        Real left = 0.0;
+                        for (const auto &ref : row) {
+                            left += ref.count * platform->topology->get_distance(k, incumbent[ref.qubit]);
+                        }
+                        if (incumbent[i] != k) {
+                            left -= costmax[i][k];
                         }
-                        lefts += to_string(refcount[i][j] * platform->topology->get_distance(k, l));
-                        lefts += " * x[";
-                        lefts += to_string(j);
-                        lefts += "][";
-                        lefts += to_string(l);
-                        lefts += "]";
+                        bound += std::max(left, 0.0);
                     }
                 }
+                QL_DOUT("InitialPlace: warm start from incoming mapping, objective <= " << bound);
+                mip.addRow(objective <= bound);
             }
-            left -= w[i][k];
-            lefts += "- w[";
-            lefts += to_string(i);
-            lefts += "][";
-            lefts += to_string(k);
-            lefts += "]";
-            Mip::Expr   right = costmax[i][k];
-            mip.addRow(left <= right);
-            // QL_DOUT(lefts << " <= " << costmax[i][k]);
         }
-    }
 
-    // objective
-    Mip::Expr   objective;
-    // QL_DOUT("... add/initialize objective");
-    Str objs{};
-    Bool started = false;
-    mip.min();
-    for (UInt i = 0; i < nfac; i++) {
-        for (UInt k = 0; k < nlocs; k++) {
-            objective += w[i][k];
-            if (started) {
-                objs += "+ ";
-            } else {
-                started = true;
+        QL_DOUT("... v2r before solving, nvq=" << nvq);
+        for (UInt v = 0; v < nvq; v++) {
+            QL_DOUT("... about to print v2r[" << v << "]= ...");
+            QL_DOUT("....." << v2r[v]);
+        }
+        QL_DOUT("..1 nvq=" << nvq);
+
+        // solve the problem
+        QL_WOUT("... computing initial placement using MIP, this may take a while ...");
+        QL_DOUT("InitialPlace: solving the problem, this may take a while ...");
+        QL_DOUT("..2 nvq=" << nvq);
+        Mip::SolveExitStatus s;
+        QL_DOUT("Just before solve: platformp=" << platform.get_ptr() << " nlocs=" << nlocs << " nvq=" << nvq);
+        QL_DOUT("Just before solve: objs=" << objs << " x.size()=" << x.size() << " w.size()=" << w.size() << " refcount.size()=" << refcount.get_size() << " v2i.size()=" << v2i.size() << " ipusecount.size()=" << ipusecount.size());
+        QL_DOUT("..2b nvq=" << nvq);
+        {
+            s = mip.solve();
+        }
+        QL_DOUT("..3 nvq=" << nvq);
+        QL_DOUT("Just after solve: platformp=" << platform.get_ptr() << " nlocs=" << nlocs << " nvq=" << nvq);
+        QL_DOUT("Just after solve: objs=" << objs << " x.size()=" << x.size() << " w.size()=" << w.size() << " refcount.size()=" << refcount.get_size() << " v2i.size()=" << v2i.size() << " ipusecount.size()=" << ipusecount.size());
+        QL_ASSERT(nvq == nlocs);         // consistency check, mainly to let it crash
+
+        // computing iptimetaken, stop interval timer
+        QL_DOUT("..4 nvq=" << nvq);
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        duration<Real> time_span = t2 - t1;
+        time_taken = time_span.count();
+        QL_DOUT("..5 nvq=" << nvq);
+
+        // QL_DOUT("... determine result of solving");
+        Mip::ProblemType pt = mip.type();
+        QL_DOUT("..6 nvq=" << nvq);
+        if (s != Mip::SOLVED || pt != Mip::OPTIMAL) {
+            QL_DOUT("... InitialPlace: no (optimal) solution found; solve returned:" << s << " type returned:" << pt);
+            QL_DOUT("InitialPlace.body [FAILED, DID NOT FIND MAPPING]");
+            return Result::FAILED;
+        }
+        QL_DOUT("..7 nvq=" << nvq);
+
+        // get the results: x[i][k] == 1 iff facility i is in location k (i.e. real qubit index k)
+        location.resize(nfac, com::map::UNDEFINED_QUBIT);
+        for (UInt i = 0; i < nfac; i++) {
+            for (UInt k = 0; k < nlocs; k++) {
+                if (mip.sol(x[i][k]) == 1) {
+                    location[i] = k;
+                    break;
+                }
             }
-            objs += "w[";
-            objs += to_string(i);
-            objs += "][";
-            objs += to_string(k);
-            objs += "]";
+            QL_ASSERT(location[i] != com::map::UNDEFINED_QUBIT);  // each facility i by definition represents a used qubit so must have got a location
+        }
+        if (options.cache) {
+            options.cache->store(cache_key, location);
         }
-    }
-    mip.obj(objective);
-    // QL_DOUT("MINIMIZE " << objs);
 
-    QL_DOUT("... v2r before solving, nvq=" << nvq);
-    for (UInt v = 0; v < nvq; v++) {
-        QL_DOUT("... about to print v2r[" << v << "]= ...");
-        QL_DOUT("....." << v2r[v]);
-    }
-    QL_DOUT("..1 nvq=" << nvq);
-
-    // solve the problem
-    QL_WOUT("... computing initial placement using MIP, this may take a while ...");
-    QL_DOUT("InitialPlace: solving the problem, this may take a while ...");
-    QL_DOUT("..2 nvq=" << nvq);
-    Mip::SolveExitStatus s;
-    QL_DOUT("Just before solve: platformp=" << platform.get_ptr() << " nlocs=" << nlocs << " nvq=" << nvq);
-    QL_DOUT("Just before solve: objs=" << objs << " x.size()=" << x.size() << " w.size()=" << w.size() << " refcount.size()=" << refcount.size() << " v2i.size()=" << v2i.size() << " ipusecount.size()=" << ipusecount.size());
-    QL_DOUT("..2b nvq=" << nvq);
-    {
-        s = mip.solve();
-    }
-    QL_DOUT("..3 nvq=" << nvq);
-    QL_DOUT("Just after solve: platformp=" << platform.get_ptr() << " nlocs=" << nlocs << " nvq=" << nvq);
-    QL_DOUT("Just after solve: objs=" << objs << " x.size()=" << x.size() << " w.size()=" << w.size() << " refcount.size()=" << refcount.size() << " v2i.size()=" << v2i.size() << " ipusecount.size()=" << ipusecount.size());
-    QL_ASSERT(nvq == nlocs);         // consistency check, mainly to let it crash
-
-    // computing iptimetaken, stop interval timer
-    QL_DOUT("..4 nvq=" << nvq);
-    high_resolution_clock::time_point t2 = high_resolution_clock::now();
-    duration<Real> time_span = t2 - t1;
-    time_taken = time_span.count();
-    QL_DOUT("..5 nvq=" << nvq);
-
-    // QL_DOUT("... determine result of solving");
-    Mip::ProblemType pt = mip.type();
-    QL_DOUT("..6 nvq=" << nvq);
-    if (s != Mip::SOLVED || pt != Mip::OPTIMAL) {
-        QL_DOUT("... InitialPlace: no (optimal) solution found; solve returned:" << s << " type returned:" << pt);
-        QL_DOUT("InitialPlace.body [FAILED, DID NOT FIND MAPPING]");
-        return Result::FAILED;
     }
-    QL_DOUT("..7 nvq=" << nvq);
 
     // return new mapping as result in v2r
 
-    // get the results: x[i][k] == 1 iff facility i is in location k (i.e. real qubit index k)
     // use v2i to translate facilities back to original virtual qubit indices
     // and fill v2r with the found locations for the used virtual qubits;
     // the unused mapped virtual qubits are mapped to an arbitrary permutation of the remaining locations;
@@ -341,7 +465,7 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
     QL_DOUT("... interpret result and copy to Virt2Real, nvq=" << nvq);
     for (UInt v = 0; v < nvq; v++) {
         QL_DOUT("... about to set v2r to undefined for v " << v);
-        v2r[v] = com::map::UNDEFINED_QUBIT;      // i.e. undefined, i.e. v is not an index of a used virtual qubit
+        v2r.set_real(v, com::map::UNDEFINED_QUBIT);      // i.e. undefined, i.e. v is not an index of a used virtual qubit
     }
     for (UInt i = 0; i < nfac; i++) {
         UInt v;   // found virtual qubit index v represented by facility i
@@ -353,15 +477,8 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
             }
         }
         QL_ASSERT(v < nvq);  // for each facility there must be a virtual qubit
-        UInt k;   // location to which facility i being virtual qubit index v was allocated
-        for (k = 0; k < nlocs; k++) {
-            if (mip.sol(x[i][k]) == 1) {
-                v2r[v] = k;
-                // v2r.rs[] is not updated because no gates were really mapped yet
-                break;
-            }
-        }
-        QL_ASSERT(k < nlocs);  // each facility i by definition represents a used qubit so must have got a location
+        v2r.set_real(v, location[i]);
+        // v2r.rs[] is not updated because no gates were really mapped yet
         QL_DOUT("... end loop body over nfac");
     }
 
@@ -379,20 +496,13 @@ Result Algorithm::body(com::map::QubitMapping &v2r) {
                 // v is unused by this kernel; find an unused location k
                 UInt k;   // location k that is checked for having been allocated to some virtual qubit w
                 for (k = 0; k < nlocs; k++) {
-                    UInt w;
-                    for (w = 0; w < nvq; w++) {
-                        if (v2r[w] == k) {
-                            break;
-                        }
-                    }
-                    if (w >= nvq) {
-                        // no w found for which v2r[w] == k
+                    if (v2r.get_virtual(k) == com::map::UNDEFINED_QUBIT) {
                         break;     // k is an unused location
                     }
                     // k is a used location, so continue with next k to check whether it is hopefully unused
                 }
                 QL_ASSERT(k < nlocs);  // when a virtual qubit is not used, there must be a location that is not used
-                v2r[v] = k;
+                v2r.set_real(v, k);
             }
             QL_DOUT("... end loop body over nvq when mapinitone2oneopt");
         }
@@ -53,8 +53,10 @@
 #include "ql/utils/str.h"
 #include "ql/utils/ptr.h"
 #include "ql/utils/vec.h"
+#include "ql/utils/map.h"
 #include "ql/ir/compat/compat.h"
 #include "ql/com/map/qubit_mapping.h"
+#include "ql/com/ana/interaction_matrix.h"
 
 namespace ql {
 namespace pass {
@@ -63,6 +65,44 @@ namespace qubits {
 namespace place_mip {
 namespace detail {
 
+/**
+ * Cache for the placements found for previously solved models, such that
+ * kernels with the same interaction graph (in terms of facilities) on the same
+ * platform need to be solved only once. The placement is stored as the
+ * location for each facility. A cache must only be used for a single platform.
+ */
+class Cache {
+private:
+
+    /**
+     * The placements, indexed by the key returned by get_key().
+     */
+    utils::Map<utils::Str, utils::Vec<utils::UInt>> placements;
+
+public:
+
+    /**
+     * Returns the cache key for the model for the given number of locations
+     * and interaction matrix between facilities.
+     */
+    static utils::Str get_key(
+        utils::UInt nlocs,
+        const com::ana::InteractionMatrix &refcount
+    );
+
+    /**
+     * Returns the placement stored for the given key, or null if there is
+     * none.
+     */
+    const utils::Vec<utils::UInt> *find(const utils::Str &key) const;
+
+    /**
+     * Stores the placement for the given key.
+     */
+    void store(const utils::Str &key, const utils::Vec<utils::UInt> &placement);
+
+};
+
 /**
  * Options structure for configuring the initial placement algorithm.
  */
@@ -86,6 +126,22 @@ struct Options {
      */
     utils::Bool map_all = false;
 
+    /**
+     * When set, and the incoming mapping places all virtual qubits considered
+     * by the solver, the cost of that mapping is added to the model as an
+     * upper bound on the objective. This allows the solver to prune all
+     * branches that cannot improve on it right away; this is particularly
+     * effective when the incoming mapping was itself computed by a heuristic
+     * placer.
+     */
+    utils::Bool warm_start = true;
+
+    /**
+     * Cache for the placements of previously solved models, or null to disable
+     * caching.
+     */
+    Cache *cache = nullptr;
+
 };
 
 /**
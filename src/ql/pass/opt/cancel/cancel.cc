@@ -0,0 +1,476 @@
+/** \file
+ * Defines the gate cancellation and rotation merging pass.
+ */
+
+#include "ql/pass/opt/cancel/cancel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/com/ddg/build.h"
+#include "ql/com/ddg/ops.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace cancel {
+
+/**
+ * Dumps docs for the gate cancellation pass.
+ */
+void CancelPass::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass removes pairs of gates that cancel each other out, such as two
+    CNOTs on the same qubits or an S gate followed by an S-dagger gate, and
+    merges rotations around the same axis on the same qubit into a single
+    rotation (removing it if the resulting angle is a multiple of 2 pi).
+
+    Gates don't need to be adjacent for this: the data dependency graph of each
+    block is used to determine whether the two gates can be made adjacent by
+    commuting the gates in between out of the way. Which gates commute is
+    determined by the operand access modes of the instruction types, and can
+    be controlled with the `commute_*` options as for the scheduler.
+
+    Like the Clifford optimizer, the relation between gates is currently
+    inferred from the instruction names; recognized are `x`, `y`, `z`, `h`,
+    `cnot`, `cx`, `cz`, `swap`, `rx180`, `ry180`, and `rz180` (self-inverse),
+    the pairs `s`/`sdag`, `t`/`tdag`, `x90`/`mx90`, `y90`/`my90`,
+    `rx90`/`mrx90`, and `ry90`/`mry90`, and the rotations `rx`, `ry`, and `rz`
+    with a literal angle operand. Only unconditional instructions with
+    statically-indexed qubit operands are optimized.
+
+    The pass returns the number of statements that were removed.
+    )");
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str CancelPass::get_friendly_type() const {
+    return "Gate canceller";
+}
+
+/**
+ * Constructs a gate cancellation pass.
+ */
+CancelPass::CancelPass(
+    const utils::Ptr<const pmgr::Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
+
+    options.add_bool(
+        "commute_multi_qubit",
+        "Whether to consider commutation rules for multi-qubit gates.",
+        true
+    );
+
+    options.add_bool(
+        "commute_single_qubit",
+        "Whether to consider commutation rules for single-qubit gates.",
+        true
+    );
+
+    options.add_bool(
+        "merge_rotations",
+        "Whether to merge rotations around the same axis. When disabled, only "
+        "inverse pairs of gates are cancelled.",
+        true
+    );
+
+}
+
+/**
+ * Inverse of each gate recognized by the pass, by name.
+ *
+ * TODO: like for the Clifford optimizer, these semantics should come from the
+ *  platform configuration somehow.
+ */
+static const std::unordered_map<utils::Str, utils::Str> INVERSES{
+    {"x", "x"},
+    {"y", "y"},
+    {"z", "z"},
+    {"h", "h"},
+    {"cnot", "cnot"},
+    {"cx", "cx"},
+    {"cz", "cz"},
+    {"swap", "swap"},
+    {"rx180", "rx180"},
+    {"ry180", "ry180"},
+    {"rz180", "rz180"},
+    {"s", "sdag"},
+    {"sdag", "s"},
+    {"t", "tdag"},
+    {"tdag", "t"},
+    {"x90", "mx90"},
+    {"mx90", "x90"},
+    {"y90", "my90"},
+    {"my90", "y90"},
+    {"rx90", "mrx90"},
+    {"mrx90", "rx90"},
+    {"ry90", "mry90"},
+    {"mry90", "ry90"}
+};
+
+/**
+ * Gates of which the qubit operands may be specified in any order.
+ */
+static const std::unordered_set<utils::Str> SYMMETRIC{"cz", "swap"};
+
+/**
+ * Rotation gates, taking a qubit and a real-valued angle in radians.
+ */
+static const std::unordered_set<utils::Str> ROTATIONS{"rx", "ry", "rz"};
+
+/**
+ * Rotations with an angle closer than this to a multiple of 2 pi are
+ * considered to be the identity.
+ */
+static const utils::Real ANGLE_TOLERANCE = 1e-9;
+
+/**
+ * The maximum number of candidates checked for each gate. This just bounds the
+ * cost of long sequences of mutually commuting gates that don't combine.
+ */
+static const utils::UInt MAX_CANDIDATES = 32;
+
+/**
+ * Information about a statement that may be cancelled or merged.
+ */
+struct Gate {
+
+    /**
+     * The statement.
+     */
+    ir::StatementRef statement;
+
+    /**
+     * The instruction name.
+     */
+    utils::Str name;
+
+    /**
+     * The qubit operands, in operand order.
+     */
+    utils::Vec<com::ddg::Reference> qubits;
+
+    /**
+     * The angle operand, for rotations.
+     */
+    utils::Real angle = 0.0;
+
+    /**
+     * The object accesses of the statement.
+     */
+    com::ddg::Events events;
+
+};
+
+/**
+ * Returns the raw pointer of a statement, for use as a key.
+ */
+static const ir::Statement *key_of(const ir::StatementRef &statement) {
+    return statement.get_ptr().get();
+}
+
+/**
+ * Fills in gate if the given statement is a gate recognized by the pass, and
+ * returns whether this is the case.
+ */
+static utils::Bool get_gate(
+    const ir::StatementRef &statement,
+    com::ddg::EventGatherer &gatherer,
+    Gate &gate
+) {
+    auto custom = statement->as_custom_instruction();
+    if (!custom || custom->instruction_type->barrier) {
+        return false;
+    }
+    auto condition = custom->condition->as_bit_literal();
+    if (!condition || !condition->value) {
+        return false;
+    }
+    gate.name = custom->instruction_type->name;
+    auto rotation = ROTATIONS.count(gate.name) > 0;
+    if (!rotation && !INVERSES.count(gate.name)) {
+        return false;
+    }
+
+    // Check the operands. We only handle qubits with statically known
+    // indices, and (for rotations) a literal angle.
+    utils::Bool have_angle = false;
+    gate.qubits.clear();
+    for (const auto &operand : ir::get_operands(statement.as<ir::Instruction>())) {
+        if (auto ref = operand->as_reference()) {
+            if (!ref->data_type->as_qubit_type()) {
+                return false;
+            }
+            com::ddg::Reference qubit(operand.as<ir::Reference>());
+            if (qubit.indices.size() != ref->indices.size()) {
+                return false;
+            }
+            gate.qubits.push_back(qubit);
+        } else if (auto lit = operand->as_real_literal()) {
+            if (!rotation || have_angle) {
+                return false;
+            }
+            gate.angle = lit->value;
+            have_angle = true;
+        } else {
+            return false;
+        }
+    }
+    if (gate.qubits.empty() || (rotation && (!have_angle || gate.qubits.size() != 1))) {
+        return false;
+    }
+
+    gate.statement = statement;
+    gatherer.reset();
+    gatherer.add_statement(statement);
+    gate.events = gatherer.get();
+    return true;
+}
+
+/**
+ * Returns whether the given two gates access exactly the same objects in the
+ * same way.
+ */
+static utils::Bool same_events(const Gate &a, const Gate &b) {
+    if (a.events.size() != b.events.size()) {
+        return false;
+    }
+    auto it = b.events.begin();
+    for (const auto &event : a.events) {
+        if (!(event.first == it->first) || !(event.second == it->second)) {
+            return false;
+        }
+        ++it;
+    }
+    return true;
+}
+
+/**
+ * Returns whether the given two gates act on the same qubits, taking symmetry
+ * into account.
+ */
+static utils::Bool same_qubits(const Gate &a, const Gate &b) {
+    if (a.qubits == b.qubits) {
+        return true;
+    }
+    if (!SYMMETRIC.count(a.name) || a.qubits.size() != b.qubits.size()) {
+        return false;
+    }
+    for (const auto &qubit : a.qubits) {
+        if (std::find(b.qubits.begin(), b.qubits.end(), qubit) == b.qubits.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns whether statement b can be moved back to directly after statement a
+ * (which precedes it) by commuting the statements in between out of the way,
+ * given that a and b access the same objects in the same way, and ignoring
+ * the given removed statements.
+ *
+ * This is the case iff no statement between a and b depends on a. Because
+ * the DDG is not transitively closed, removed statements are looked through
+ * rather than ignored.
+ */
+static utils::Bool can_combine(
+    const ir::StatementRef &a,
+    const ir::StatementRef &b,
+    const std::unordered_set<const ir::Statement*> &removed
+) {
+    auto order = com::ddg::get_node(b)->order;
+    utils::Vec<ir::StatementRef> stack{a};
+    std::unordered_set<const ir::Statement*> visited;
+    while (!stack.empty()) {
+        auto statement = stack.back();
+        stack.pop_back();
+        for (const auto &successor : com::ddg::get_node(statement)->successors) {
+            const auto &next = successor.first;
+            if (key_of(next) == key_of(b)) {
+                continue;
+            }
+            if (com::ddg::get_node(next)->order > order) {
+                continue;
+            }
+            if (!removed.count(key_of(next))) {
+                return false;
+            }
+            if (visited.insert(key_of(next)).second) {
+                stack.push_back(next);
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Normalizes the given angle in radians to the range (-pi, pi].
+ */
+static utils::Real normalize_angle(utils::Real angle) {
+    angle = std::fmod(angle, 2 * utils::PI);
+    if (angle > utils::PI) {
+        angle -= 2 * utils::PI;
+    } else if (angle <= -utils::PI) {
+        angle += 2 * utils::PI;
+    }
+    return angle;
+}
+
+/**
+ * Replaces the angle operand of the given rotation gate.
+ */
+static void set_angle(const ir::StatementRef &statement, utils::Real angle) {
+    auto insn = statement.as<ir::Instruction>();
+    ir::generalize_instruction(insn);
+    for (auto &operand : insn->as_custom_instruction()->operands) {
+        if (auto lit = operand->as_real_literal()) {
+            lit->value = angle;
+        }
+    }
+    ir::specialize_instruction(insn);
+}
+
+/**
+ * Cancels and merges gates in the given block and (recursively) its
+ * structured control-flow sub-blocks. Returns the number of statements
+ * that were removed.
+ */
+utils::UInt CancelPass::run_on_block(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    const pmgr::pass_types::Context &context
+) {
+    auto commute_multi_qubit = context.options["commute_multi_qubit"].as_bool();
+    auto commute_single_qubit = context.options["commute_single_qubit"].as_bool();
+    auto merge_rotations = context.options["merge_rotations"].as_bool();
+    com::ddg::build(ir, block, commute_multi_qubit, commute_single_qubit);
+    com::ddg::EventGatherer gatherer(ir);
+    gatherer.disable_multi_qubit_commutation = !commute_multi_qubit;
+    gatherer.disable_single_qubit_commutation = !commute_single_qubit;
+
+    // Walk over the statements in order. For each set of qubits, we keep track
+    // of the gates that a subsequent gate on the same qubits may still
+    // combine with. A gate that fails can_combine() for some later gate also
+    // fails it for anything after that (unless the statement blocking it is
+    // removed later on, which we conservatively ignore), so such gates are
+    // dropped.
+    utils::Map<utils::Vec<com::ddg::Reference>, utils::Vec<Gate>> candidates;
+    std::unordered_set<const ir::Statement*> removed;
+    Gate gate;
+    for (const auto &statement : block->statements) {
+        if (!get_gate(statement, gatherer, gate)) {
+            continue;
+        }
+        auto qubits = gate.qubits;
+        std::sort(qubits.begin(), qubits.end());
+        auto &list = candidates.set(qubits);
+
+        utils::Bool combined = false;
+        utils::UInt checked = 0;
+        for (auto i = list.size(); i-- > 0 && checked < MAX_CANDIDATES; ) {
+            auto &candidate = list[i];
+            if (!can_combine(candidate.statement, statement, removed)) {
+                list.erase(list.begin() + i);
+                continue;
+            }
+            checked++;
+            if (!same_events(candidate, gate)) {
+                continue;
+            }
+            if (INVERSES.count(candidate.name) && INVERSES.at(candidate.name) == gate.name && same_qubits(candidate, gate)) {
+                QL_DOUT(
+                    "cancelling " << ir::describe(candidate.statement) <<
+                    " with " << ir::describe(statement)
+                );
+                removed.insert(key_of(candidate.statement));
+                removed.insert(key_of(statement));
+                list.erase(list.begin() + i);
+                combined = true;
+                break;
+            }
+            if (merge_rotations && ROTATIONS.count(gate.name) && candidate.name == gate.name && candidate.qubits == gate.qubits) {
+                QL_DOUT(
+                    "merging " << ir::describe(statement) <<
+                    " into " << ir::describe(candidate.statement)
+                );
+                auto angle = normalize_angle(candidate.angle + gate.angle);
+                removed.insert(key_of(statement));
+                if (std::abs(angle) < ANGLE_TOLERANCE) {
+                    removed.insert(key_of(candidate.statement));
+                    list.erase(list.begin() + i);
+                } else {
+                    set_angle(candidate.statement, angle);
+                    candidate.angle = angle;
+                }
+                combined = true;
+                break;
+            }
+        }
+        if (!combined) {
+            list.push_back(gate);
+        }
+    }
+    com::ddg::clear(block);
+
+    // Remove the statements that were cancelled or merged.
+    utils::UInt count = removed.size();
+    if (count) {
+        auto statements = block->statements;
+        block->statements.reset();
+        for (const auto &statement : statements) {
+            if (!removed.count(key_of(statement))) {
+                block->statements.add(statement);
+            }
+        }
+    }
+
+    // Recurse into structured control-flow sub-blocks.
+    for (const auto &statement : block->statements) {
+        if (auto if_else = statement->as_if_else()) {
+            for (const auto &branch : if_else->branches) {
+                count += run_on_block(ir, branch->body, context);
+            }
+            if (!if_else->otherwise.empty()) {
+                count += run_on_block(ir, if_else->otherwise, context);
+            }
+        } else if (auto loop = statement->as_loop()) {
+            count += run_on_block(ir, loop->body, context);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Runs the gate cancellation pass.
+ */
+utils::Int CancelPass::run(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) const {
+    utils::UInt count = 0;
+    if (!ir->program.empty()) {
+        for (const auto &block : ir->program->blocks) {
+            count += run_on_block(ir, block, context);
+        }
+    }
+    QL_DOUT("removed " << count << " statements");
+    return count;
+}
+
+} // namespace cancel
+} // namespace opt
+} // namespace pass
+} // namespace ql
@@ -4,8 +4,13 @@
 
 #include "clifford.h"
 
+#include <algorithm>
+#include <unordered_map>
 #include "ql/utils/num.h"
-#include "ql/com/options.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/parallel.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/old_to_new.h"
 
 namespace ql {
 namespace pass {
@@ -16,27 +21,394 @@ namespace detail {
 
 using namespace utils;
 
+/**
+ * The gate sequences used to implement each of the 24 Cliffords, by gate name.
+ * These are the same sequences that the old IR's Kernel::clifford() emits.
+ */
+static const Vec<Str> CLIFFORD_SEQUENCES[24] = {
+    {},
+    {"ry90", "rx90"},
+    {"mrx90", "mry90"},
+    {"rx180"},
+    {"mry90", "mrx90"},
+    {"rx90", "mry90"},
+    {"ry180"},
+    {"mry90", "rx90"},
+    {"rx90", "ry90"},
+    {"rx180", "ry180"},
+    {"ry90", "mrx90"},
+    {"mrx90", "ry90"},
+    {"ry90", "rx180"},
+    {"mrx90"},
+    {"rx90", "mry90", "mrx90"},
+    {"mry90"},
+    {"rx90"},
+    {"rx90", "ry90", "rx90"},
+    {"mry90", "rx180"},
+    {"rx90", "ry180"},
+    {"rx90", "mry90", "rx90"},
+    {"ry90"},
+    {"mrx90", "ry180"},
+    {"rx90", "ry90", "mrx90"}
+};
+
+/**
+ * Duration in nanoseconds of the default gates that the old IR falls back to
+ * for the gates of CLIFFORD_SEQUENCES when the platform doesn't define them.
+ */
+static const UInt DEFAULT_GATE_DURATION = 40;
+
+/**
+ * Constructs a Clifford optimizer for the given IR. If multi_qubit is set,
+ * segments of Cliffords including CNOT and CZ gates are optimized as well.
+ * num_threads bounds the number of threads used in single-qubit mode.
+ */
+Clifford::Clifford(
+    const ir::Ref &ir,
+    Bool multi_qubit,
+    UInt num_threads
+) :
+    ir(ir),
+    nq(ir::get_num_qubits(ir)),
+    multi_qubit(multi_qubit),
+    num_threads(num_threads),
+    total_saved(0)
+{}
+
+/**
+ * Appends the indices of the qubit operands of the given statement to qubits,
+ * in operand order. Returns false if the statement has operands that refer to
+ * qubits dynamically.
+ */
+Bool Clifford::get_qubits(
+    const ir::StatementRef &statement,
+    Vec<UInt> &qubits
+) const {
+    auto add = [&](const ir::Reference *ref) {
+        if (
+            ref->target == ir->platform->qubits &&
+            ref->data_type == ir->platform->qubits->data_type
+        ) {
+            if (ref->indices.size() != 1 || !ref->indices[0]->as_int_literal()) {
+                return false;
+            }
+            qubits.push_back(ref->indices[0]->as_int_literal()->value);
+        }
+        return true;
+    };
+    if (auto wait = statement->as_wait_instruction()) {
+        for (const auto &object : wait->objects) {
+            if (!add(object.get_ptr().get())) {
+                return false;
+            }
+        }
+    } else if (statement->as_instruction()) {
+        for (const auto &operand : ir::get_operands(statement.as<ir::Instruction>())) {
+            if (auto ref = operand->as_reference()) {
+                if (!add(ref)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Determines how each statement in input is to be handled.
+ */
+void Clifford::classify() {
+    infos.clear();
+    operand_qubits.clear();
+    globals.clear();
+    if (!multi_qubit) {
+        streams.assign(nq, {});
+    }
+    for (UInt i = 0; i < input.size(); i++) {
+        const auto &statement = input[i];
+        StatementInfo info{Action::SYNC_ALL, 0, ir::get_duration_of_statement(statement), operand_qubits.size(), 0};
+
+        // Statements that aren't gates, classical instructions without qubit
+        // operands, and instructions that index qubits dynamically may affect
+        // all qubits (really being pessimistic here about these). The same
+        // goes for waits and barriers on everything.
+        auto custom = statement->as_custom_instruction();
+        if (custom || statement->as_wait_instruction()) {
+            if (!get_qubits(statement, operand_qubits)) {
+                operand_qubits.resize(info.begin);
+            } else if (operand_qubits.size() > info.begin) {
+                info.action = Action::SYNC;
+            }
+        }
+        info.end = operand_qubits.size();
+        auto num_operands = info.end - info.begin;
+
+        if (info.action == Action::SYNC && custom) {
+            auto condition = custom->condition->as_bit_literal();
+            auto unconditional = condition && condition->value;
+            const auto &name = custom->instruction_type->name;
+            if (
+                multi_qubit
+                && num_operands == 2
+                && operand_qubits[info.begin] != operand_qubits[info.begin + 1]
+                && unconditional
+            ) {
+                // CNOT/CZ in multi-qubit mode: add to the segment of its
+                // operands
+                auto tq = gate2tq(name);
+                if (tq != 0) {
+                    info.action = Action::TRACK;
+                    info.clifford = tq;
+                }
+            } else if (num_operands == 1 && unconditional) {
+                // unary quantum clifford gates like x/y/z/h/xm90/y90/s/...
+                // are accumulated; non-clifford unary gates (wait, meas,
+                // prepz, ...) and conditional gates end the sequence
+                auto cs = gate2cs(name);
+                if (cs != -1) {
+                    info.action = Action::ACCUMULATE;
+                    info.clifford = cs;
+                }
+            }
+        }
+
+        if (info.action == Action::SYNC_ALL) {
+            globals.push_back(i);
+        } else if (!multi_qubit) {
+            for (auto j = info.begin; j < info.end; j++) {
+                auto &stream = streams[operand_qubits[j]];
+                if (stream.empty() || stream.back() != i) {
+                    stream.push_back(i);
+                }
+            }
+        }
+        infos.push_back(info);
+    }
+    globals.push_back(input.size());
+}
+
+/**
+ * Appends an instruction for the given gate to the output. If the platform
+ * does not define the gate, an instruction type is inferred for it in the same
+ * way the conversion from the old IR would for the old IR's default gate.
+ */
+static void emit_gate(
+    const ir::Ref &ir,
+    const Str &name,
+    const Any<ir::Expression> &operands,
+    Vec<ir::StatementRef> &output
+) {
+    auto insn = ir::make_instruction(ir, name, operands, {}, true);
+    if (insn.empty()) {
+        UInt cycle_time = 1;
+        const auto &data = ir->platform->data.data;
+        auto settings = data.find("hardware_settings");
+        if (settings != data.end()) {
+            auto it = settings->find("cycle_time");
+            if (it != settings->end() && it->is_number_unsigned()) {
+                cycle_time = it->get<UInt>();
+            }
+        }
+        auto ityp = utils::make<ir::InstructionType>(name, name);
+        ityp->duration = utils::div_ceil(DEFAULT_GATE_DURATION, cycle_time);
+        ityp->operand_types.emplace(
+            name.find('x') != Str::npos ? ir::prim::OperandMode::COMMUTE_X : ir::prim::OperandMode::COMMUTE_Y,
+            ir->platform->qubits->data_type
+        );
+        ir::add_instruction_type(ir, ityp);
+        insn = ir::make_instruction(ir, name, operands);
+    }
+    output.push_back(insn.as<ir::Statement>());
+}
+
+/**
+ * Appends the gate sequence for the given Clifford on qubit q to the output.
+ */
+void Clifford::emit_clifford(Int cs, UInt q) {
+    for (const auto &name : CLIFFORD_SEQUENCES[cs]) {
+        emit_gate(ir, name, {ir::make_qubit_ref(ir, q)}, output);
+    }
+}
+
+/**
+ * Appends a CNOT (tq = 1) or CZ (tq = 2) gate to the output.
+ */
+void Clifford::emit_two_qubit(UInt tq, UInt a, UInt b) {
+    output.push_back(ir::make_instruction(
+        ir,
+        tq == 1 ? "cnot" : "cz",
+        {ir::make_qubit_ref(ir, a), ir::make_qubit_ref(ir, b)}
+    ).as<ir::Statement>());
+}
+
+/**
+ * Determines the Clifford sequences of qubit q in single-qubit mode, by
+ * sweeping over its stream of statements. The Cliffords that end them are
+ * appended to emissions, and the number of cycles saved is returned.
+ */
+UInt Clifford::sweep(UInt q, Vec<Emission> &emissions) const {
+    Int csq = 0;
+    UInt acc_cycles = 0;
+    UInt saved = 0;
+    auto sync = [&](UInt index) {
+        if (csq != 0) {
+            emissions.push_back({index, csq});
+            saved += acc_cycles - cs2cycles(csq);
+        }
+        csq = 0;
+        acc_cycles = 0;
+    };
+
+    // globals ends with the number of statements, so g can't run past it
+    // before the stream ends.
+    UInt g = 0;
+    for (auto index : streams[q]) {
+        while (globals[g] < index) {
+            sync(globals[g++]);
+        }
+        const auto &info = infos[index];
+        if (info.action == Action::ACCUMULATE) {
+            acc_cycles += info.cycles;
+            csq = TRANSITION_TABLE[csq][info.clifford];
+        } else {
+            sync(index);
+        }
+    }
+    while (g < globals.size()) {
+        sync(globals[g++]);
+    }
+    return saved;
+}
+
+/**
+ * Optimizes the block in single-qubit mode. The qubits are swept independently
+ * (and concurrently, if allowed), after which the results are recombined in
+ * statement order.
+ */
+void Clifford::optimize_single_qubit() {
+
+    // The sequences of different qubits only meet at the statements that end
+    // them, so each qubit can be swept on its own.
+    Vec<Vec<Emission>> emissions(nq);
+    Vec<UInt> saved(nq, 0);
+    parallel_for(nq, num_threads, [&](UInt q) {
+        saved[q] = sweep(q, emissions[q]);
+    });
+    for (auto s : saved) {
+        total_saved += s;
+    }
+
+    // Recombine the results. The Cliffords that end a sequence are emitted
+    // directly before the statement that ended it, in operand order, or for
+    // all qubits in qubit order for statements that end all of them.
+    Vec<UInt> next(nq, 0);
+    auto emit_pending = [&](UInt q, UInt index) {
+        const auto &list = emissions[q];
+        if (next[q] < list.size() && list[next[q]].statement == index) {
+            emit_clifford(list[next[q]].clifford, q);
+            next[q]++;
+        }
+    };
+    for (UInt i = 0; i < input.size(); i++) {
+        const auto &info = infos[i];
+        if (info.action == Action::ACCUMULATE) {
+            continue;
+        }
+        if (info.action == Action::SYNC_ALL) {
+            for (UInt q = 0; q < nq; q++) {
+                emit_pending(q, i);
+            }
+        } else {
+            for (auto j = info.begin; j < info.end; j++) {
+                emit_pending(operand_qubits[j], i);
+            }
+        }
+        output.push_back(input[i]);
+    }
+    for (UInt q = 0; q < nq; q++) {
+        emit_pending(q, input.size());
+    }
+
+}
+
+/**
+ * Optimizes the block in multi-qubit mode, in which the qubits interact
+ * through the segments, by means of a single sweep over the block.
+ */
+void Clifford::optimize_multi_qubit() {
+    cliffstate.assign(nq, 0);       // 0 is identity; for all qubits accumulated state is set to identity
+    cliffcycles.assign(nq, 0);      // for all qubits, no accumulated cycles
+    segments.clear();
+    free_segments.clear();
+    segment_of.assign(nq, -1);
+    local_index.resize(nq, 0);
+
+    for (UInt i = 0; i < input.size(); i++) {
+        const auto &info = infos[i];
+        switch (info.action) {
+            case Action::SYNC_ALL:
+                // sync all qubits: create gate sequences corresponding to what was accumulated in cliffstate, for all qubits
+                sync_all();
+                output.push_back(input[i]);
+                break;
+
+            case Action::TRACK:
+                track(i);
+                break;
+
+            case Action::SYNC:
+                // sync particular qubits: create gate sequences corresponding to what was accumulated in cliffstate, for those particular operand qubits
+                for (auto j = info.begin; j < info.end; j++) {
+                    sync(operand_qubits[j]);
+                }
+                output.push_back(input[i]);
+                break;
+
+            case Action::ACCUMULATE: {
+                // don't emit gate but accumulate gate in cliffstate
+                // also record accumulated cycles to compute savings
+                auto q = operand_qubits[info.begin];
+                cliffcycles[q] += info.cycles;
+                Int csq = cliffstate[q];
+                QL_DOUT("... from " << cs2string(csq) << " to " << cs2string(TRANSITION_TABLE[csq][info.clifford]));
+                cliffstate[q] = TRANSITION_TABLE[csq][info.clifford];
+                break;
+            }
+        }
+    }
+    sync_all();
+}
+
 /**
  * Create gate sequences for all accumulated cliffords, output them and
- * reset state.
+ * reset state. Only used in multi-qubit mode.
  */
-void Clifford::sync_all(const ir::compat::KernelRef &k) {
+void Clifford::sync_all() {
     QL_DOUT("... sync_all");
+    for (UInt i = 0; i < segments.size(); i++) {
+        if (!segments[i].qubits.empty()) {
+            flush(i);
+        }
+    }
     for (UInt q = 0; q < nq; q++) {
-        sync(k, q);
+        sync(q);
     }
     QL_DOUT("... sync_all DONE");
 }
 
 /**
  * Create gate sequence for accumulated cliffords of qubit q, output it and
- * reset state.
+ * reset state. Only used in multi-qubit mode.
  */
-void Clifford::sync(const ir::compat::KernelRef &k, UInt q) {
+void Clifford::sync(UInt q) {
+    if (segment_of[q] >= 0) {
+        flush(segment_of[q]);
+        return;
+    }
     Int csq = cliffstate[q];
     if (csq != 0) {
         QL_DOUT("... sync q[" << q << "]: generating clifford " << cs2string(csq));
-        k->clifford(csq, q);          // generates clifford(csq) in kernel.c
+        emit_clifford(csq, q);
         UInt  acc_cycles = cliffcycles[q];
         UInt  ins_cycles = cs2cycles(csq);
         QL_DOUT("... qubit q[" << q << "]: accumulated: " << acc_cycles << ", inserted: " << ins_cycles);
@@ -49,42 +421,274 @@ void Clifford::sync(const ir::compat::KernelRef &k, UInt q) {
 }
 
 /**
- * Find the clifford state from identity to given gate, or return -1 if
- * unknown or the gate is not in C1.
+ * Moves the accumulated single-qubit Clifford state of qubit q into the
+ * given segment.
+ */
+void Clifford::absorb(Segment &segment, UInt q) {
+    if (cliffstate[q] != 0) {
+        segment.gates.push_back({cliffstate[q], q});
+    }
+    segment.cycles += cliffcycles[q];
+    cliffstate[q] = 0;
+    cliffcycles[q] = 0;
+}
+
+/**
+ * Adds the CNOT or CZ gate with the given statement index to the multi-qubit
+ * segments, merging the segments of its operands.
+ */
+void Clifford::track(UInt index) {
+    const auto &info = infos[index];
+    UInt a = operand_qubits[info.begin];
+    UInt b = operand_qubits[info.begin + 1];
+
+    // If joining the groups of a and b would make the segment too large, flush
+    // what we have first.
+    if (segment_of[a] < 0 || segment_of[a] != segment_of[b]) {
+        UInt size_a = segment_of[a] < 0 ? 1 : segments[segment_of[a]].qubits.size();
+        UInt size_b = segment_of[b] < 0 ? 1 : segments[segment_of[b]].qubits.size();
+        if (size_a + size_b > MAX_SEGMENT_QUBITS) {
+            if (segment_of[a] >= 0) flush(segment_of[a]);
+            if (segment_of[b] >= 0) flush(segment_of[b]);
+        }
+    }
+
+    // Find or make the segment to add the gate to. When two segments are
+    // joined, the gates of the smaller one are appended to the larger one;
+    // their relative order is irrelevant, as they act on disjoint qubits.
+    Int sa = segment_of[a];
+    Int sb = segment_of[b];
+    Int target;
+    if (sa < 0 && sb < 0) {
+        if (free_segments.empty()) {
+            target = segments.size();
+            segments.emplace_back();
+        } else {
+            target = free_segments.back();
+            free_segments.pop_back();
+        }
+        segments[target].cycles = 0;
+    } else if (sa < 0) {
+        target = sb;
+    } else if (sb < 0 || sa == sb) {
+        target = sa;
+    } else {
+        target = segments[sa].gates.size() >= segments[sb].gates.size() ? sa : sb;
+        auto &from = segments[target == sa ? sb : sa];
+        auto &to = segments[target];
+        for (auto q : from.qubits) {
+            segment_of[q] = target;
+            to.qubits.push_back(q);
+        }
+        to.gates.insert(to.gates.end(), from.gates.begin(), from.gates.end());
+        to.cycles += from.cycles;
+        from.qubits.clear();
+        from.gates.clear();
+        free_segments.push_back(target == sa ? sb : sa);
+    }
+    auto &segment = segments[target];
+    for (auto q : {a, b}) {
+        if (segment_of[q] < 0) {
+            segment_of[q] = target;
+            segment.qubits.push_back(q);
+        }
+        absorb(segment, q);
+    }
+    segment.gates.push_back({-1, index});
+    segment.cycles += info.cycles;
+}
+
+/**
+ * Emits the given multi-qubit segment, either as its original gates (with
+ * single-qubit runs reduced) or as resynthesized from its tableau,
+ * whichever has less depth, and frees it.
+ */
+void Clifford::flush(UInt index) {
+    auto &segment = segments[index];
+    for (auto q : segment.qubits) {
+        absorb(segment, q);
+    }
+    UInt n = segment.qubits.size();
+    QL_DOUT("... flushing Clifford segment on " << n << " qubits with " << segment.gates.size() << " gates");
+
+    // Build the tableau of the segment, using qubit indices local to the
+    // segment.
+    for (UInt i = 0; i < n; i++) {
+        local_index[segment.qubits[i]] = i;
+    }
+    Tableau tableau(n);
+    Bool uses_cnot = false;
+    for (const auto &gate : segment.gates) {
+        if (gate.clifford >= 0) {
+            tableau.clifford(gate.clifford, local_index[gate.index]);
+        } else {
+            const auto &info = infos[gate.index];
+            auto q0 = local_index[operand_qubits[info.begin]];
+            auto q1 = local_index[operand_qubits[info.begin + 1]];
+            if (info.clifford == 1) {
+                tableau.cnot(q0, q1);
+                uses_cnot = true;
+            } else {
+                tableau.cz(q0, q1);
+            }
+        }
+    }
+
+    UInt emitted_cycles = 0;
+    if (tableau.is_identity()) {
+        QL_DOUT("... segment reduces to identity");
+    } else {
+
+        // Emit the original gates, with the single-qubit runs reduced as in
+        // the single-qubit mode.
+        auto begin = output.size();
+        for (const auto &gate : segment.gates) {
+            if (gate.clifford >= 0) {
+                emit_clifford(gate.clifford, gate.index);
+            } else {
+                output.push_back(input[gate.index]);
+            }
+        }
+        UInt original_cycles = 0;
+        auto original_depth = depth(begin, original_cycles);
+
+        // Emit the resynthesized segment after it, again merging single-qubit
+        // runs. We stick to the two-qubit gate type that the segment used;
+        // if it only used CZ gates, CNOTs are emitted as H.CZ.H.
+        auto middle = output.size();
+        Vec<Int> pending(n, 0);
+        auto emit_pending = [&](UInt i) {
+            if (pending[i] != 0) {
+                emit_clifford(pending[i], segment.qubits[i]);
+                pending[i] = 0;
+            }
+        };
+        for (const auto &gate : tableau.synthesize()) {
+            if (gate.clifford >= 0) {
+                pending[gate.qubit] = TRANSITION_TABLE[pending[gate.qubit]][gate.clifford];
+            } else if (uses_cnot) {
+                emit_pending(gate.qubit);
+                emit_pending(gate.target);
+                emit_two_qubit(1, segment.qubits[gate.qubit], segment.qubits[gate.target]);
+            } else {
+                pending[gate.target] = TRANSITION_TABLE[pending[gate.target]][12];
+                emit_pending(gate.qubit);
+                emit_pending(gate.target);
+                emit_two_qubit(2, segment.qubits[gate.qubit], segment.qubits[gate.target]);
+                pending[gate.target] = 12;
+            }
+        }
+        for (UInt i = 0; i < n; i++) {
+            emit_pending(i);
+        }
+        UInt synthesized_cycles = 0;
+        auto synthesized_depth = depth(middle, synthesized_cycles);
+
+        // Keep whichever is better.
+        QL_DOUT("... original depth " << original_depth << ", resynthesized depth " << synthesized_depth);
+        if (
+            synthesized_depth < original_depth
+            || (synthesized_depth == original_depth && synthesized_cycles < original_cycles)
+        ) {
+            output.erase(output.begin() + begin, output.begin() + middle);
+            emitted_cycles = synthesized_cycles;
+        } else {
+            output.erase(output.begin() + middle, output.end());
+            emitted_cycles = original_cycles;
+        }
+
+    }
+    total_saved += segment.cycles - emitted_cycles;
+
+    for (auto q : segment.qubits) {
+        segment_of[q] = -1;
+    }
+    segment.qubits.clear();
+    segment.gates.clear();
+    free_segments.push_back(index);
+}
+
+/**
+ * Returns the depth in cycles of the output statements from index begin
+ * onwards, and adds their total number of cycles to cycles.
+ */
+UInt Clifford::depth(UInt begin, UInt &cycles) const {
+    std::unordered_map<UInt, UInt> free_cycle;
+    Vec<UInt> qubits;
+    UInt result = 0;
+    for (UInt i = begin; i < output.size(); i++) {
+        const auto &statement = output[i];
+        UInt duration = ir::get_duration_of_statement(statement);
+        qubits.clear();
+        get_qubits(statement, qubits);
+        UInt start = 0;
+        for (auto q : qubits) {
+            start = std::max(start, free_cycle[q]);
+        }
+        for (auto q : qubits) {
+            free_cycle[q] = start + duration;
+        }
+        result = std::max(result, start + duration);
+        cycles += duration;
+    }
+    return result;
+}
+
+/**
+ * Find the clifford state from identity to the gate with the given name, or
+ * return -1 if unknown or the gate is not in C1.
  *
  * TODO: this currently infers the Clifford index by gate name; instead
  *  semantics like this should be in the config file somehow.
  */
-Int Clifford::gate2cs(const ir::compat::GateRef &gate) {
-    auto gname = gate->name;
-    if (gname == "identity")         return 0;
-    else if (gname == "i")           return 0;
-    else if (gname == "pauli_x")     return 3;
-    else if (gname == "x")           return 3;
-    else if (gname == "rx180")       return 3;
-    else if (gname == "pauli_y")     return 6;
-    else if (gname == "y")           return 6;
-    else if (gname == "ry180")       return 6;
-    else if (gname == "pauli_z")     return 9;
-    else if (gname == "z")           return 9;
-    else if (gname == "rz180")       return 9;
-    else if (gname == "hadamard")    return 12;
-    else if (gname == "h")           return 12;
-    else if (gname == "xm90")        return 13;
-    else if (gname == "mrx90")       return 13;
-    else if (gname == "s")           return 14;
-    else if (gname == "zm90")        return 14;
-    else if (gname == "mrz90")       return 14;
-    else if (gname == "ym90")        return 15;
-    else if (gname == "mry90")       return 15;
-    else if (gname == "x90")         return 16;
-    else if (gname == "rx90")        return 16;
-    else if (gname == "y90")         return 21;
-    else if (gname == "ry90")        return 21;
-    else if (gname == "sdag")        return 23;
-    else if (gname == "z90")         return 23;
-    else if (gname == "rz90")        return 23;
-    else return -1;
+Int Clifford::gate2cs(const Str &name) {
+    static const std::unordered_map<Str, Int> CLIFFORD_STATES{
+        {"identity", 0},
+        {"i", 0},
+        {"pauli_x", 3},
+        {"x", 3},
+        {"rx180", 3},
+        {"pauli_y", 6},
+        {"y", 6},
+        {"ry180", 6},
+        {"pauli_z", 9},
+        {"z", 9},
+        {"rz180", 9},
+        {"hadamard", 12},
+        {"h", 12},
+        {"xm90", 13},
+        {"mrx90", 13},
+        {"s", 14},
+        {"zm90", 14},
+        {"mrz90", 14},
+        {"ym90", 15},
+        {"mry90", 15},
+        {"x90", 16},
+        {"rx90", 16},
+        {"y90", 21},
+        {"ry90", 21},
+        {"sdag", 23},
+        {"z90", 23},
+        {"rz90", 23}
+    };
+    auto it = CLIFFORD_STATES.find(name);
+    if (it == CLIFFORD_STATES.end()) return -1;
+    return it->second;
+}
+
+/**
+ * Returns 1 if the gate with the given name is a CNOT, 2 if it is a CZ, and 0
+ * otherwise. Like gate2cs(), this is inferred from the gate name.
+ */
+UInt Clifford::gate2tq(const Str &name) {
+    static const std::unordered_map<Str, UInt> TWO_QUBIT_CLIFFORDS{
+        {"cnot", 1},
+        {"cx", 1},
+        {"cz", 2}
+    };
+    auto it = TWO_QUBIT_CLIFFORDS.find(name);
+    if (it == TWO_QUBIT_CLIFFORDS.end()) return 0;
+    return it->second;
 }
 
 /**
@@ -156,22 +760,18 @@ Str Clifford::cs2string(Int cs) {
 }
 
 /**
- * Optimizes the given kernel, returning how many cycles were saved.
+ * Optimizes the given block, returning how many cycles were saved. The
+ * structured control-flow sub-blocks of the block are not touched.
  */
-utils::UInt Clifford::optimize_kernel(const ir::compat::KernelRef &kernel) {
-    QL_DOUT("clifford_optimize_kernel()");
-
-    nq = kernel->qubit_count;
-    ct = kernel->platform->cycle_time;
-    QL_DOUT("Clifford optimizer on kernel " << kernel->name << " ...");
-
-    // copy circuit kernel.c to take input from;
-    // output will fill kernel.c again
-    auto input_gates = kernel->gates;
-    kernel->gates.reset();
+UInt Clifford::optimize_block(const ir::BlockBaseRef &block) {
+    QL_DOUT("Clifford optimizer on block with " << block->statements.size() << " statements ...");
 
-    cliffstate.resize(nq, 0);       // 0 is identity; for all qubits accumulated state is set to identity
-    cliffcycles.resize(nq, 0);      // for all qubits, no accumulated cycles
+    // copy the statements of the block to take input from;
+    // output will fill the block again
+    for (const auto &statement : block->statements) {
+        input.push_back(statement);
+    }
+    output.clear();
     total_saved = 0;                // reset saved, just for reporting
 
     /*
@@ -190,7 +790,7 @@ utils::UInt Clifford::optimize_kernel(const ir::compat::KernelRef &kernel) {
       to which clifford the combination is equivalent to;
       so clifford(sequence1; sequence2) == clifftrans[clifford(sequence1)][clifford(sequence2)].
     - UInt cs2cycles(Int cs): the minimum number of cycles needed to implement a clifford of state cs
-    - void k.clifford(Int csq, UInt q): generates minimal clifford sequence for state csq and qubit q
+    - void emit_clifford(Int csq, UInt q): generates minimal clifford sequence for state csq and qubit q
 
     Therefore, maintain for each qubit q while scanning:
     - cliffstate[q]:    clifford state of sequence until now per qubit; initially identity
@@ -207,51 +807,45 @@ utils::UInt Clifford::optimize_kernel(const ir::compat::KernelRef &kernel) {
     - those affecting a single qubit but not being a clifford: push out state for that qubit, clearing it
     - those affecting a single qubit and being a conditional gate: push out state for that qubit, clearing it
     - remaining case is a single qubit clifford: add it to the state
+
+    In multi-qubit mode, CNOT and CZ gates are not synchronization points.
+    Instead, the qubits they act on are joined into a group, and the gates of
+    the group (with the accumulated single-qubit cliffords folded in as above)
+    are collected in a segment. When a synchronization point affects any of
+    the qubits of a segment, the whole segment is pushed out. At that point,
+    the Clifford operator of the segment is computed using a stabilizer
+    tableau, and the segment is either removed entirely (if it is the
+    identity), resynthesized from the tableau (if that has less depth), or
+    pushed out as it was with only the single-qubit runs reduced.
+
+    In single-qubit mode, the sequences of different qubits only interact
+    through the statements that end them. So rather than scanning the block
+    once while keeping the state of all qubits, the statements are first
+    classified, after which the stream of statements acting on each qubit is
+    swept independently (and in parallel) to determine what to emit where.
+    The results are then merged back into a single statement list in the
+    original statement order.
     */
-    for (const auto &gate : input_gates) {
-        QL_DOUT("... gate: " << gate->qasm());
+    classify();
+    if (multi_qubit) {
+        optimize_multi_qubit();
+    } else {
+        optimize_single_qubit();
+    }
 
-        if (
-            gate->type() == ir::compat::GateType::CLASSICAL       // classical gates (really being pessimistic here about these)
-            || gate->operands.empty()                             // gates without operands which may affect ALL qubits
-        ) {
-            // sync all qubits: create gate sequences corresponding to what was accumulated in cliffstate, for all qubits
-            sync_all(kernel);
-            kernel->gates.add(gate);
-        } else if (gate->operands.size() != 1) {                 // gates like CNOT/CZ/TOFFOLI
-            // sync particular qubits: create gate sequences corresponding to what was accumulated in cliffstate, for those particular operand qubits
-            for (auto q : gate->operands) {
-                sync(kernel, q);
-            }
-            kernel->gates.add(gate);
-        } else {
-            // unary quantum gates like x/y/z/h/xm90/y90/s/wait/meas/prepz
-            UInt q = gate->operands[0];
-            Int cs = gate2cs(gate);
-            if (
-                cs == -1                                        // non-clifford unary gates (wait, meas, prepz, ...)
-                || gate->is_conditional()                         // conditional unary (clifford) gates
-            ) {
-                // sync particular single qubit: create gate sequence corresponding to what was accumulated in cliffstate, for this particular operand qubit
-                QL_DOUT("... unary gate not a clifford gate or conditional: " << gate->qasm());
-                sync(kernel, q);
-                kernel->gates.add(gate);
-            } else {
-                // unary quantum clifford gates like x/y/z/h/xm90/y90/s/...
-                // don't emit gate but accumulate gate in cliffstate
-                // also record accumulated cycles to compute savings
-                cliffcycles[q] += (gate->duration + ct - 1) / ct;
-                Int csq = cliffstate[q];
-                QL_DOUT("... from " << cs2string(csq) << " to " << cs2string(TRANSITION_TABLE[csq][cs]));
-                cliffstate[q] = TRANSITION_TABLE[csq][cs];
-            }
-        }
-        QL_DOUT("... gate: " << gate->qasm() << " DONE");
+    // Like for the old IR, we don't try to keep the schedule valid; the
+    // cycle numbers just reflect the statement order, and the block is marked
+    // as unscheduled for the conversion back to the old IR.
+    block->statements.reset();
+    for (UInt i = 0; i < output.size(); i++) {
+        output[i]->cycle = i;
+        block->statements.add(output[i]);
     }
-    sync_all(kernel);
-    kernel->cycles_valid = false;
+    block->set_annotation<ir::KernelCyclesValid>({false});
+    input.clear();
+    output.clear();
 
-    QL_DOUT("Clifford optimizer on kernel " << kernel->name << " saved " << total_saved << " cycles [DONE]");
+    QL_DOUT("Clifford optimizer saved " << total_saved << " cycles [DONE]");
 
     return total_saved;
 }
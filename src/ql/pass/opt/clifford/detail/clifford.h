@@ -5,8 +5,10 @@
 #pragma once
 
 #include "ql/utils/num.h"
+#include "ql/utils/str.h"
 #include "ql/utils/vec.h"
-#include "ql/ir/compat/compat.h"
+#include "ql/ir/ir.h"
+#include "tableau.h"
 
 namespace ql {
 namespace pass {
@@ -15,6 +17,129 @@ namespace clifford {
 namespace optimize {
 namespace detail {
 
+/**
+ * The way a statement is handled by the optimizer.
+ */
+enum class Action {
+
+    /**
+     * The statement may affect all qubits, so it ends the Clifford sequences
+     * of all of them.
+     */
+    SYNC_ALL,
+
+    /**
+     * The statement ends the Clifford sequences of its qubit operands.
+     */
+    SYNC,
+
+    /**
+     * The statement is an unconditional single-qubit Clifford gate, which is
+     * folded into the sequence of its qubit.
+     */
+    ACCUMULATE,
+
+    /**
+     * The statement is an unconditional CNOT or CZ gate, which is added to a
+     * multi-qubit segment. Only used in multi-qubit mode.
+     */
+    TRACK
+
+};
+
+/**
+ * What the optimizer needs to know about a statement of the block being
+ * optimized.
+ */
+struct StatementInfo {
+
+    /**
+     * How the statement is handled.
+     */
+    Action action;
+
+    /**
+     * For ACCUMULATE, the index of the Clifford in the 24-element group. For
+     * TRACK, 1 for a CNOT and 2 for a CZ.
+     */
+    utils::Int clifford;
+
+    /**
+     * The duration of the statement in cycles.
+     */
+    utils::UInt cycles;
+
+    /**
+     * The range of the qubit operands of the statement in
+     * Clifford::operand_qubits, in operand order.
+     */
+    utils::UInt begin;
+    utils::UInt end;
+
+};
+
+/**
+ * A Clifford that ends a single-qubit sequence, to be emitted directly before
+ * the given statement (or at the end of the block if the statement index
+ * equals the number of statements).
+ */
+struct Emission {
+
+    /**
+     * Index of the statement.
+     */
+    utils::UInt statement;
+
+    /**
+     * Index of the Clifford in the 24-element group.
+     */
+    utils::Int clifford;
+
+};
+
+/**
+ * A gate in a multi-qubit Clifford segment. Runs of single-qubit Cliffords are
+ * stored as their index in the 24-element group; CNOT and CZ gates refer to
+ * the original statement.
+ */
+struct SegmentGate {
+
+    /**
+     * Index of the single-qubit Clifford, or -1 for a two-qubit gate.
+     */
+    utils::Int clifford;
+
+    /**
+     * The qubit of a single-qubit Clifford, or the index of the original
+     * statement of a two-qubit gate.
+     */
+    utils::UInt index;
+
+};
+
+/**
+ * A Clifford segment on a group of qubits that interact through CNOT and CZ
+ * gates, tracked in the multi-qubit mode of the optimizer.
+ */
+struct Segment {
+
+    /**
+     * The qubits in the group. Empty if the segment slot is unused.
+     */
+    utils::Vec<utils::UInt> qubits;
+
+    /**
+     * The gates of the segment in time order.
+     */
+    utils::Vec<SegmentGate> gates;
+
+    /**
+     * The total number of cycles of the original gates of the segment.
+     */
+    utils::UInt cycles;
+
+};
+
 /**
  * Clifford optimizer logic implementation.
  */
@@ -22,41 +147,185 @@ class Clifford {
 private:
 
     /**
-     * Shorthand for the number of qubits in the kernel.
+     * The maximum number of qubits in a multi-qubit segment. Segments that
+     * would grow larger than this are flushed first, to bound the cost of
+     * resynthesis.
+     */
+    static const utils::UInt MAX_SEGMENT_QUBITS = 64;
+
+    /**
+     * The IR root node.
+     */
+    ir::Ref ir;
+
+    /**
+     * Shorthand for the number of qubits in the platform.
      */
     utils::UInt nq;
 
     /**
-     * Shorthand for the platform's cycle time in nanoseconds.
+     * Whether CNOT and CZ gates are tracked as part of Clifford segments.
+     */
+    utils::Bool multi_qubit;
+
+    /**
+     * The number of threads used for the per-qubit sweeps.
      */
-    utils::UInt ct;
+    utils::UInt num_threads;
 
     /**
-     * Current accumulated Clifford state per qubit.
+     * The statements of the block being optimized.
+     */
+    utils::Vec<ir::StatementRef> input;
+
+    /**
+     * Information about each statement in input.
+     */
+    utils::Vec<StatementInfo> infos;
+
+    /**
+     * The qubit operands of all statements, indexed by StatementInfo::begin
+     * and StatementInfo::end.
+     */
+    utils::Vec<utils::UInt> operand_qubits;
+
+    /**
+     * For each qubit, the indices of the SYNC and ACCUMULATE statements that
+     * act on it, in statement order. Only used in single-qubit mode.
+     */
+    utils::Vec<utils::Vec<utils::UInt>> streams;
+
+    /**
+     * The indices of the SYNC_ALL statements, followed by the number of
+     * statements to represent the end of the block.
+     */
+    utils::Vec<utils::UInt> globals;
+
+    /**
+     * The optimized statements.
+     */
+    utils::Vec<ir::StatementRef> output;
+
+    /**
+     * Current accumulated Clifford state per qubit. Only used in multi-qubit
+     * mode.
      */
     utils::Vec<utils::Int> cliffstate;
 
     /**
-     * Current accumulated Clifford cycles per qubit.
+     * Current accumulated Clifford cycles per qubit. Only used in multi-qubit
+     * mode.
      */
     utils::Vec<utils::UInt> cliffcycles;
 
     /**
-     * Total number of cycles saved per kernel.
+     * Total number of cycles saved in the current block.
      */
     utils::UInt total_saved;
 
+    /**
+     * The multi-qubit Clifford segments. Unused slots have no qubits.
+     */
+    utils::Vec<Segment> segments;
+
+    /**
+     * Indices of unused slots in segments.
+     */
+    utils::Vec<utils::UInt> free_segments;
+
+    /**
+     * Index of the segment each qubit belongs to, or -1 if none.
+     */
+    utils::Vec<utils::Int> segment_of;
+
+    /**
+     * Scratch space mapping each qubit to its index within the segment being
+     * flushed.
+     */
+    utils::Vec<utils::UInt> local_index;
+
+    /**
+     * Appends the indices of the qubit operands of the given statement to
+     * qubits, in operand order. Returns false if the statement has operands
+     * that refer to qubits dynamically.
+     */
+    utils::Bool get_qubits(
+        const ir::StatementRef &statement,
+        utils::Vec<utils::UInt> &qubits
+    ) const;
+
+    /**
+     * Determines how each statement in input is to be handled.
+     */
+    void classify();
+
+    /**
+     * Appends the gate sequence for the given Clifford on qubit q to the
+     * output.
+     */
+    void emit_clifford(utils::Int cs, utils::UInt q);
+
+    /**
+     * Appends a CNOT (tq = 1) or CZ (tq = 2) gate to the output.
+     */
+    void emit_two_qubit(utils::UInt tq, utils::UInt a, utils::UInt b);
+
+    /**
+     * Determines the Clifford sequences of qubit q in single-qubit mode, by
+     * sweeping over its stream of statements. The Cliffords that end them are
+     * appended to emissions, and the number of cycles saved is returned.
+     */
+    utils::UInt sweep(utils::UInt q, utils::Vec<Emission> &emissions) const;
+
+    /**
+     * Optimizes the block in single-qubit mode. The qubits are swept
+     * independently (and concurrently, if allowed), after which the results
+     * are recombined in statement order.
+     */
+    void optimize_single_qubit();
+
+    /**
+     * Optimizes the block in multi-qubit mode, in which the qubits interact
+     * through the segments, by means of a single sweep over the block.
+     */
+    void optimize_multi_qubit();
+
+    /**
+     * Moves the accumulated single-qubit Clifford state of qubit q into the
+     * given segment.
+     */
+    void absorb(Segment &segment, utils::UInt q);
+
+    /**
+     * Adds the CNOT or CZ gate with the given statement index to the
+     * multi-qubit segments, merging the segments of its operands.
+     */
+    void track(utils::UInt index);
+
+    /**
+     * Emits the given multi-qubit segment, either as its original gates (with
+     * single-qubit runs reduced) or as resynthesized from its tableau,
+     * whichever has less depth, and frees it.
+     */
+    void flush(utils::UInt index);
+
+    /**
+     * Returns the depth in cycles of the output statements from index begin
+     * onwards, and adds their total number of cycles to cycles.
+     */
+    utils::UInt depth(utils::UInt begin, utils::UInt &cycles) const;
+
     /**
      * Create gate sequences for all accumulated cliffords, output them and
-     * reset state.
+     * reset state. Only used in multi-qubit mode.
      */
-    void sync_all(const ir::compat::KernelRef &k);
+    void sync_all();
 
     /**
      * Create gate sequence for accumulated cliffords of qubit q, output it and
-     * reset state.
+     * reset state. Only used in multi-qubit mode.
      */
-    void sync(const ir::compat::KernelRef &k, utils::UInt q);
+    void sync(utils::UInt q);
 
     /**
      * Clifford state transition table.
@@ -91,13 +360,19 @@ private:
     };
 
     /**
-     * Find the clifford state from identity to given gate, or return -1 if
-     * unknown or the gate is not in C1.
+     * Find the clifford state from identity to the gate with the given name,
+     * or return -1 if unknown or the gate is not in C1.
      *
      * TODO: this currently infers the Clifford index by gate name; instead
      *  semantics like this should be in the config file somehow.
      */
-    static utils::Int gate2cs(const ir::compat::GateRef &gate);
+    static utils::Int gate2cs(const utils::Str &name);
+
+    /**
+     * Returns 1 if the gate with the given name is a CNOT, 2 if it is a CZ,
+     * and 0 otherwise. Like gate2cs(), this is inferred from the gate name.
+     */
+    static utils::UInt gate2tq(const utils::Str &name);
 
     /**
      * Find the duration of the gate sequence corresponding to given clifford
@@ -117,9 +392,17 @@ private:
 public:
 
     /**
-     * Optimizes the given kernel, returning how many cycles were saved.
+     * Constructs a Clifford optimizer for the given IR. If multi_qubit is set,
+     * segments of Cliffords including CNOT and CZ gates are optimized as well.
+     * num_threads bounds the number of threads used in single-qubit mode.
+     */
+    Clifford(const ir::Ref &ir, utils::Bool multi_qubit, utils::UInt num_threads);
+
+    /**
+     * Optimizes the given block, returning how many cycles were saved. The
+     * structured control-flow sub-blocks of the block are not touched.
      */
-    utils::UInt optimize_kernel(const ir::compat::KernelRef &kernel);
+    utils::UInt optimize_block(const ir::BlockBaseRef &block);
 
 };
 
@@ -0,0 +1,332 @@
+/** \file
+ * Bit-packed stabilizer tableau for multi-qubit Clifford segments.
+ */
+
+#include "tableau.h"
+
+#include <utility>
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace clifford {
+namespace optimize {
+namespace detail {
+
+using namespace utils;
+
+/**
+ * Indices of the single-qubit Cliffords that synthesize() produces, in the
+ * 24-element group used by the Clifford optimizer.
+ */
+static const Int CLIFFORD_X = 3;
+static const Int CLIFFORD_Z = 9;
+static const Int CLIFFORD_H = 12;
+static const Int CLIFFORD_S = 14;
+static const Int CLIFFORD_SDAG = 23;
+
+/**
+ * The 24 single-qubit Cliffords of the Clifford optimizer as the shortest
+ * sequence of H and S gates (in time order) that implements them.
+ */
+static const char *const CLIFFORD_WORDS[24] = {
+    "", "HSHS", "HS", "HSSH", "SHSS", "HSSS", "HSSHSS", "HSHSSS",
+    "HSHSSH", "SS", "SH", "SSHS", "H", "SHS", "S", "HSS",
+    "HSH", "HSSHS", "SSHSS", "SHSSS", "SHSSH", "SSH", "HSHSS", "SSS"
+};
+
+/**
+ * Constructs the identity tableau for the given number of qubits.
+ */
+Tableau::Tableau(UInt num_qubits) :
+    num_qubits(num_qubits),
+    num_words((2 * num_qubits + 63) / 64),
+    xs(num_qubits * num_words, 0),
+    zs(num_qubits * num_words, 0),
+    rs(num_words, 0)
+{
+    for (UInt q = 0; q < num_qubits; q++) {
+        xs[q * num_words + q / 64] |= 1ull << (q % 64);
+        auto row = num_qubits + q;
+        zs[q * num_words + row / 64] |= 1ull << (row % 64);
+    }
+}
+
+/**
+ * Returns the number of qubits.
+ */
+UInt Tableau::size() const {
+    return num_qubits;
+}
+
+/**
+ * Returns the X bit of the given row for the given qubit.
+ */
+Bool Tableau::get_x(UInt row, UInt qubit) const {
+    return (xs[qubit * num_words + row / 64] >> (row % 64)) & 1;
+}
+
+/**
+ * Returns the Z bit of the given row for the given qubit.
+ */
+Bool Tableau::get_z(UInt row, UInt qubit) const {
+    return (zs[qubit * num_words + row / 64] >> (row % 64)) & 1;
+}
+
+/**
+ * Returns the sign bit of the given row.
+ */
+Bool Tableau::get_r(UInt row) const {
+    return (rs[row / 64] >> (row % 64)) & 1;
+}
+
+/**
+ * Returns whether this tableau represents the identity operator (up to
+ * global phase).
+ */
+Bool Tableau::is_identity() const {
+    for (auto r : rs) {
+        if (r) return false;
+    }
+    for (UInt q = 0; q < num_qubits; q++) {
+        auto z_row = num_qubits + q;
+        for (UInt w = 0; w < num_words; w++) {
+            std::uint64_t x_expected = (w == q / 64) ? 1ull << (q % 64) : 0;
+            std::uint64_t z_expected = (w == z_row / 64) ? 1ull << (z_row % 64) : 0;
+            if (xs[q * num_words + w] != x_expected) return false;
+            if (zs[q * num_words + w] != z_expected) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Appends a Hadamard gate.
+ */
+void Tableau::h(UInt qubit) {
+    auto x = &xs[qubit * num_words];
+    auto z = &zs[qubit * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= x[w] & z[w];
+        std::swap(x[w], z[w]);
+    }
+}
+
+/**
+ * Appends an S gate, i.e. diag(1, i).
+ */
+void Tableau::s(UInt qubit) {
+    auto x = &xs[qubit * num_words];
+    auto z = &zs[qubit * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= x[w] & z[w];
+        z[w] ^= x[w];
+    }
+}
+
+/**
+ * Appends an S-dagger gate, i.e. diag(1, -i).
+ */
+void Tableau::sdag(UInt qubit) {
+    auto x = &xs[qubit * num_words];
+    auto z = &zs[qubit * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= x[w] & ~z[w];
+        z[w] ^= x[w];
+    }
+}
+
+/**
+ * Appends a Pauli X gate.
+ */
+void Tableau::pauli_x(UInt qubit) {
+    auto z = &zs[qubit * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= z[w];
+    }
+}
+
+/**
+ * Appends a Pauli Z gate.
+ */
+void Tableau::pauli_z(UInt qubit) {
+    auto x = &xs[qubit * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= x[w];
+    }
+}
+
+/**
+ * Appends a CNOT gate.
+ */
+void Tableau::cnot(UInt control, UInt target) {
+    auto xc = &xs[control * num_words];
+    auto zc = &zs[control * num_words];
+    auto xt = &xs[target * num_words];
+    auto zt = &zs[target * num_words];
+    for (UInt w = 0; w < num_words; w++) {
+        rs[w] ^= xc[w] & zt[w] & ~(xt[w] ^ zc[w]);
+        xt[w] ^= xc[w];
+        zc[w] ^= zt[w];
+    }
+}
+
+/**
+ * Appends a CZ gate.
+ */
+void Tableau::cz(UInt qubit1, UInt qubit2) {
+    h(qubit2);
+    cnot(qubit1, qubit2);
+    h(qubit2);
+}
+
+/**
+ * Appends the single-qubit Clifford with the given index in the 24-element
+ * group used by the Clifford optimizer.
+ */
+void Tableau::clifford(Int index, UInt qubit) {
+    if (index < 0 || index >= 24) {
+        QL_ICE("invalid single-qubit Clifford index " << index);
+    }
+    for (auto c = CLIFFORD_WORDS[index]; *c; c++) {
+        if (*c == 'H') {
+            h(qubit);
+        } else {
+            s(qubit);
+        }
+    }
+}
+
+/**
+ * Appends the given gate.
+ */
+void Tableau::apply(const TableauGate &gate) {
+    if (gate.clifford < 0) {
+        cnot(gate.qubit, gate.target);
+    } else {
+        clifford(gate.clifford, gate.qubit);
+    }
+}
+
+/**
+ * Synthesizes a gate sequence implementing this tableau, in time order,
+ * using only CNOTs and the single-qubit Cliffords H, S, S-dagger, X, and
+ * Z. The sequence is found by reducing the tableau to the identity one
+ * qubit at a time, and thus uses O(n^2) gates, but it is not necessarily
+ * minimal.
+ */
+Vec<TableauGate> Tableau::synthesize() const {
+    Tableau t = *this;
+    UInt n = num_qubits;
+
+    // The gates that reduce the tableau to the identity, i.e. the inverse of
+    // the circuit we're looking for.
+    Vec<TableauGate> reduction;
+    auto single = [&](Int index, UInt q) {
+        t.clifford(index, q);
+        reduction.push_back({index, q, 0});
+    };
+    auto cnot = [&](UInt c, UInt tgt) {
+        t.cnot(c, tgt);
+        reduction.push_back({-1, c, tgt});
+    };
+
+    // Reduce qubit by qubit. Once qubit i is done, destabilizer row i is +-X_i
+    // and stabilizer row i is +-Z_i, and because of the commutation relations
+    // all other rows are then the identity on qubit i. The rows that are done
+    // are therefore the identity on the qubits that remain, so the gates below
+    // never disturb them.
+    for (UInt i = 0; i < n; i++) {
+        UInt d = i;
+        UInt s = n + i;
+
+        // Make the X bit of the destabilizer on qubit i true. The row cannot be
+        // the identity on all remaining qubits, as it anticommutes with
+        // stabilizer row i.
+        if (!t.get_x(d, i)) {
+            Bool found = false;
+            for (UInt j = i + 1; j < n && !found; j++) {
+                if (t.get_x(d, j)) {
+                    cnot(j, i);
+                    found = true;
+                }
+            }
+            for (UInt j = i; j < n && !found; j++) {
+                if (t.get_z(d, j)) {
+                    single(CLIFFORD_H, j);
+                    if (j != i) cnot(j, i);
+                    found = true;
+                }
+            }
+            if (!found) {
+                QL_ICE("tableau is not symplectic");
+            }
+        }
+
+        // Clear the remaining X bits of the destabilizer, and then its Z bits.
+        for (UInt j = i + 1; j < n; j++) {
+            if (t.get_x(d, j)) cnot(i, j);
+        }
+        Bool any_z = false;
+        for (UInt j = i; j < n; j++) {
+            any_z |= t.get_z(d, j);
+        }
+        if (any_z) {
+            if (!t.get_z(d, i)) single(CLIFFORD_S, i);
+            for (UInt j = i + 1; j < n; j++) {
+                if (t.get_z(d, j)) cnot(j, i);
+            }
+            single(CLIFFORD_S, i);
+        }
+
+        // Now clear the stabilizer, which has its Z bit on qubit i set because
+        // it anticommutes with destabilizer row i (now +-X_i).
+        for (UInt j = i + 1; j < n; j++) {
+            if (t.get_z(s, j)) cnot(j, i);
+        }
+        Bool any_x = false;
+        for (UInt j = i; j < n; j++) {
+            any_x |= t.get_x(s, j);
+        }
+        if (any_x) {
+            single(CLIFFORD_H, i);
+            for (UInt j = i + 1; j < n; j++) {
+                if (t.get_x(s, j)) cnot(i, j);
+            }
+            if (t.get_z(s, i)) single(CLIFFORD_S, i);
+            single(CLIFFORD_H, i);
+        }
+
+    }
+
+    // Fix the signs.
+    for (UInt i = 0; i < n; i++) {
+        if (t.get_r(i)) single(CLIFFORD_Z, i);
+        if (t.get_r(n + i)) single(CLIFFORD_X, i);
+    }
+    if (!t.is_identity()) {
+        QL_ICE("failed to reduce Clifford tableau to the identity");
+    }
+
+    // Invert the reduction to get the circuit for the original tableau.
+    Vec<TableauGate> result;
+    result.reserve(reduction.size());
+    for (auto it = reduction.rbegin(); it != reduction.rend(); ++it) {
+        auto gate = *it;
+        if (gate.clifford == CLIFFORD_S) {
+            gate.clifford = CLIFFORD_SDAG;
+        } else if (gate.clifford == CLIFFORD_SDAG) {
+            gate.clifford = CLIFFORD_S;
+        }
+        result.push_back(gate);
+    }
+    return result;
+}
+
+} // namespace detail
+} // namespace optimize
+} // namespace clifford
+} // namespace opt
+} // namespace pass
+} // namespace ql
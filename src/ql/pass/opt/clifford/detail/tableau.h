@@ -0,0 +1,174 @@
+/** \file
+ * Bit-packed stabilizer tableau for multi-qubit Clifford segments.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "ql/utils/num.h"
+#include "ql/utils/vec.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace clifford {
+namespace optimize {
+namespace detail {
+
+/**
+ * A gate produced by Tableau::synthesize().
+ */
+struct TableauGate {
+
+    /**
+     * Index of the single-qubit Clifford in the 24-element group used by the
+     * Clifford optimizer, or -1 for a CNOT.
+     */
+    utils::Int clifford;
+
+    /**
+     * The qubit for single-qubit gates, or the control qubit for a CNOT.
+     */
+    utils::UInt qubit;
+
+    /**
+     * The target qubit of a CNOT, unused for single-qubit gates.
+     */
+    utils::UInt target;
+
+};
+
+/**
+ * Stabilizer tableau in the style of Aaronson and Gottesman, representing a
+ * Clifford operator U on n qubits by the images U X_i U^dagger (destabilizer
+ * rows 0..n-1) and U Z_i U^dagger (stabilizer rows n..2n-1) of the Pauli
+ * generators, each a Pauli string with a sign bit.
+ *
+ * The bits are stored column-major: for every qubit, the X and Z bits of all
+ * 2n rows are packed into 64-bit words, as are the sign bits. Appending a
+ * gate is a column operation, so it updates 64 rows per word operation.
+ */
+class Tableau {
+private:
+
+    /**
+     * The number of qubits.
+     */
+    utils::UInt num_qubits;
+
+    /**
+     * The number of words needed for one column of 2n row bits.
+     */
+    utils::UInt num_words;
+
+    /**
+     * X bits, indexed by qubit * num_words + word.
+     */
+    utils::Vec<std::uint64_t> xs;
+
+    /**
+     * Z bits, indexed by qubit * num_words + word.
+     */
+    utils::Vec<std::uint64_t> zs;
+
+    /**
+     * Sign bits, indexed by word.
+     */
+    utils::Vec<std::uint64_t> rs;
+
+public:
+
+    /**
+     * Constructs the identity tableau for the given number of qubits.
+     */
+    explicit Tableau(utils::UInt num_qubits);
+
+    /**
+     * Returns the number of qubits.
+     */
+    utils::UInt size() const;
+
+    /**
+     * Returns the X bit of the given row for the given qubit.
+     */
+    utils::Bool get_x(utils::UInt row, utils::UInt qubit) const;
+
+    /**
+     * Returns the Z bit of the given row for the given qubit.
+     */
+    utils::Bool get_z(utils::UInt row, utils::UInt qubit) const;
+
+    /**
+     * Returns the sign bit of the given row.
+     */
+    utils::Bool get_r(utils::UInt row) const;
+
+    /**
+     * Returns whether this tableau represents the identity operator (up to
+     * global phase).
+     */
+    utils::Bool is_identity() const;
+
+    /**
+     * Appends a Hadamard gate.
+     */
+    void h(utils::UInt qubit);
+
+    /**
+     * Appends an S gate, i.e. diag(1, i).
+     */
+    void s(utils::UInt qubit);
+
+    /**
+     * Appends an S-dagger gate, i.e. diag(1, -i).
+     */
+    void sdag(utils::UInt qubit);
+
+    /**
+     * Appends a Pauli X gate.
+     */
+    void pauli_x(utils::UInt qubit);
+
+    /**
+     * Appends a Pauli Z gate.
+     */
+    void pauli_z(utils::UInt qubit);
+
+    /**
+     * Appends a CNOT gate.
+     */
+    void cnot(utils::UInt control, utils::UInt target);
+
+    /**
+     * Appends a CZ gate.
+     */
+    void cz(utils::UInt qubit1, utils::UInt qubit2);
+
+    /**
+     * Appends the single-qubit Clifford with the given index in the 24-element
+     * group used by the Clifford optimizer.
+     */
+    void clifford(utils::Int index, utils::UInt qubit);
+
+    /**
+     * Appends the given gate.
+     */
+    void apply(const TableauGate &gate);
+
+    /**
+     * Synthesizes a gate sequence implementing this tableau, in time order,
+     * using only CNOTs and the single-qubit Cliffords H, S, S-dagger, X, and
+     * Z. The sequence is found by reducing the tableau to the identity one
+     * qubit at a time, and thus uses O(n^2) gates, but it is not necessarily
+     * minimal.
+     */
+    utils::Vec<TableauGate> synthesize() const;
+
+};
+
+} // namespace detail
+} // namespace optimize
+} // namespace clifford
+} // namespace opt
+} // namespace pass
+} // namespace ql
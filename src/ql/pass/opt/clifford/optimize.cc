@@ -29,6 +29,24 @@ void CliffordOptimizePass::dump_docs(
     Note that the relation between the Clifford state transition corresponding
     to a particular gate is currently hardcoded based on gate name, and the
     equivalent cycle counts are also hardcoded.
+
+    When the `multi_qubit` option is set, CNOT and CZ gates (again recognized by
+    name: `cnot`, `cx`, or `cz`) no longer end a sequence. Instead, the qubits
+    they act on are grouped together, and the Clifford segment on each group is
+    tracked until a non-Clifford gate touches one of its qubits. The segment is
+    then simulated using a stabilizer tableau. If it turns out to be the
+    identity it is removed; otherwise, it is replaced by a sequence synthesized
+    from the tableau if that reduces the depth of the segment, or kept with
+    only its single-qubit sequences minimized if not.
+
+    The pass operates on each block of the program and on their structured
+    control-flow sub-blocks separately; any statement that isn't a gate on
+    statically-indexed qubits ends the sequences of all qubits. In single-qubit
+    mode, the statements acting on each qubit are processed independently, and
+    optionally in parallel (see `qubit_threads`); the result does not depend on
+    the number of threads. The cycle numbers of the optimized blocks just
+    reflect the statement order afterwards, so the program must be
+    (re)scheduled.
     )");
 }
 
@@ -46,22 +64,74 @@ CliffordOptimizePass::CliffordOptimizePass(
     const utils::Ptr<const pmgr::Factory> &pass_factory,
     const utils::Str &instance_name,
     const utils::Str &type_name
-) : pmgr::pass_types::KernelTransformation(pass_factory, instance_name, type_name) {
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
+
+    options.add_bool(
+        "multi_qubit",
+        "Whether to also optimize Clifford segments containing CNOT and CZ "
+        "gates, using a stabilizer tableau to simulate and resynthesize them.",
+        false
+    );
+
+    options.add_int(
+        "qubit_threads",
+        "The number of threads to use for processing the qubits of a block "
+        "concurrently in single-qubit mode. The result does not depend on "
+        "it. 0 means use all hardware threads.",
+        "1",
+        0
+    );
+
+}
+
+/**
+ * Optimizes the given block and (recursively) its structured control-flow
+ * sub-blocks, returning how many cycles were saved.
+ */
+static utils::UInt run_on_block(
+    detail::Clifford &clifford,
+    const ir::BlockBaseRef &block
+) {
+    auto cycles_saved = clifford.optimize_block(block);
+    for (const auto &statement : block->statements) {
+        if (auto if_else = statement->as_if_else()) {
+            for (const auto &branch : if_else->branches) {
+                cycles_saved += run_on_block(clifford, branch->body);
+            }
+            if (!if_else->otherwise.empty()) {
+                cycles_saved += run_on_block(clifford, if_else->otherwise);
+            }
+        } else if (auto loop = statement->as_loop()) {
+            cycles_saved += run_on_block(clifford, loop->body);
+        }
+    }
+    return cycles_saved;
 }
 
 /**
  * Runs the Clifford optimizer.
  */
 utils::Int CliffordOptimizePass::run(
-    const ir::compat::ProgramRef &program,
-    const ir::compat::KernelRef &kernel,
+    const ir::Ref &ir,
     const pmgr::pass_types::Context &context
 ) const {
-    auto cycles_saved = detail::Clifford().optimize_kernel(kernel);
-    ana::statistics::AdditionalStats::push(
-        kernel,
-        utils::to_string(cycles_saved) + " cycles saved by " + context.full_pass_name
+    if (ir->program.empty()) {
+        return 0;
+    }
+    detail::Clifford clifford(
+        ir,
+        context.options["multi_qubit"].as_bool(),
+        context.options["qubit_threads"].as_uint()
     );
+    utils::UInt cycles_saved = 0;
+    for (const auto &block : ir->program->blocks) {
+        auto block_cycles_saved = run_on_block(clifford, block);
+        ana::statistics::AdditionalStats::push(
+            block,
+            utils::to_string(block_cycles_saved) + " cycles saved by " + context.full_pass_name
+        );
+        cycles_saved += block_cycles_saved;
+    }
     return cycles_saved;
 }
 
@@ -0,0 +1,740 @@
+/** \file
+ * Defines the classical constant folding pass.
+ */
+
+#include "ql/pass/opt/const_fold/const_fold.h"
+
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/com/ddg/build.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace const_fold {
+
+/**
+ * Dumps docs for the constant folding pass.
+ */
+void ConstFoldPass::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass simplifies the classical part of the program, to reduce the
+    number of classical instructions that the backend has to emit. The
+    following transformations are performed:
+
+     - function calls of which all operands are integer or bit literals are
+       evaluated at compile-time, for the builtin operators (`+`, `-`, `*`,
+       `/`, `%`, `&`, `|`, `^`, `~`, `<<`, `>>`, the comparison operators,
+       `!`, `&&`, `||`, and `^^`) and the `int()` conversion function;
+     - when `strength_reduction` is enabled, identities such as `x + 0`,
+       `x * 1`, `x & 0`, or `b && true` are simplified, multiplications by a
+       power of two are turned into shifts if the platform has a matching
+       shift function, and nested additions and subtractions of literals, such
+       as `(x + 1) + 1`, are merged into one;
+     - when `propagate` is enabled, the literal values assigned to objects by
+       unconditional set instructions are substituted into the expressions that
+       read them, until the object is written again. Values that are not
+       written inside a loop are propagated into the loop, including into its
+       condition and update assignment, so loop-invariant values are only
+       computed once. Set instructions that assign an object to itself or to
+       the value it is already known to have are removed;
+     - when `prune_branches` is enabled, instructions with a literal false
+       condition are removed, and if-else branches with a literal condition
+       are resolved.
+
+    Only objects that are referenced with literal indices are tracked. Values
+    are not propagated across the boundaries of the program blocks, as the
+    control flow between them isn't considered.
+
+    The pass returns the number of simplifications that were made.
+    )");
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str ConstFoldPass::get_friendly_type() const {
+    return "Constant folder";
+}
+
+/**
+ * Constructs a constant folding pass.
+ */
+ConstFoldPass::ConstFoldPass(
+    const utils::Ptr<const pmgr::Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
+
+    options.add_bool(
+        "propagate",
+        "Whether to propagate the literal values assigned to objects into "
+        "the expressions that read them.",
+        true
+    );
+
+    options.add_bool(
+        "strength_reduction",
+        "Whether to simplify expressions with a literal operand using "
+        "algebraic identities, even when not all operands are literals.",
+        true
+    );
+
+    options.add_bool(
+        "prune_branches",
+        "Whether to remove instructions and if-else branches of which the "
+        "condition is known to be false.",
+        true
+    );
+
+}
+
+/**
+ * Returns whether the given two data types are the same.
+ */
+static utils::Bool same_type(const ir::DataTypeLink &a, const ir::DataTypeLink &b) {
+    return a.get_ptr().get() == b.get_ptr().get();
+}
+
+/**
+ * If the given expression is an integer or bit literal, stores its value in
+ * value and returns true. Otherwise returns false.
+ */
+static utils::Bool get_literal_value(const ir::ExpressionRef &expr, utils::Int &value) {
+    if (auto lit = expr->as_int_literal()) {
+        value = lit->value;
+        return true;
+    } else if (auto lit = expr->as_bit_literal()) {
+        value = lit->value ? 1 : 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Returns whether the given two expressions are the same integer or bit
+ * literal.
+ */
+static utils::Bool same_literal(const ir::ExpressionRef &a, const ir::ExpressionRef &b) {
+    utils::Int a_value, b_value;
+    if (!get_literal_value(a, a_value) || !get_literal_value(b, b_value)) {
+        return false;
+    }
+    return a_value == b_value && same_type(ir::get_type_of(a), ir::get_type_of(b));
+}
+
+/**
+ * Adds b to a if this doesn't overflow, and returns whether this is the case.
+ */
+static utils::Bool checked_add(utils::Int &a, utils::Int b) {
+    if ((b > 0 && a > utils::MAX - b) || (b < 0 && a < utils::MIN - b)) {
+        return false;
+    }
+    a += b;
+    return true;
+}
+
+/**
+ * Returns whether the given reference refers to a single object element with
+ * statically known indices, such that its value can be tracked.
+ */
+static utils::Bool is_trackable(const utils::One<ir::Reference> &ref) {
+    com::ddg::Reference key(ref);
+    return (
+        !key.is_global_state() &&
+        key.indices.size() == ref->indices.size() &&
+        ref->indices.size() == ref->target->shape.size()
+    );
+}
+
+/**
+ * Constant folder class. Simplifies the statements of a block, tracking the
+ * literal values of objects as it goes.
+ */
+class ConstantFolder {
+public:
+
+    /**
+     * The literal values known for objects at some point in the program.
+     */
+    using Values = utils::Map<com::ddg::Reference, ir::ExpressionRef>;
+
+private:
+
+    /**
+     * IR root node.
+     */
+    const ir::Ref &ir;
+
+    /**
+     * Whether to propagate values into expressions.
+     */
+    utils::Bool propagate;
+
+    /**
+     * Whether to apply algebraic identities.
+     */
+    utils::Bool reduce;
+
+    /**
+     * Whether to remove code with a literal false condition.
+     */
+    utils::Bool prune;
+
+    /**
+     * Event gatherer used to determine which objects a statement writes.
+     */
+    com::ddg::EventGatherer gatherer;
+
+    /**
+     * The number of simplifications made thus far.
+     */
+    utils::UInt count = 0;
+
+    /**
+     * Makes a literal of the given type with the given value, or returns an
+     * empty expression if the type is not integer- or bit-like or the value
+     * is out of range.
+     */
+    ir::ExpressionRef make_literal(utils::Int value, const ir::DataTypeLink &type) const {
+        if (auto int_type = type->as_int_type()) {
+            if (value > ir::get_max_int_for(*int_type) || value < ir::get_min_int_for(*int_type)) {
+                return {};
+            }
+            return ir::make_int_lit(ir, value, type);
+        } else if (type->as_bit_type()) {
+            return ir::make_bit_lit(ir, value != 0, type);
+        }
+        return {};
+    }
+
+    /**
+     * Makes a call to the given binary function, provided that the platform
+     * has a function with that name for the given operands and that it
+     * returns the given type. Otherwise returns an empty expression.
+     */
+    ir::ExpressionRef make_binary(
+        const utils::Str &name,
+        const ir::ExpressionRef &lhs,
+        const ir::ExpressionRef &rhs,
+        const ir::DataTypeLink &return_type
+    ) const {
+        auto function_type = ir::find_function_type(
+            ir, name, {ir::get_type_of(lhs), ir::get_type_of(rhs)}
+        );
+        if (function_type.empty() || !same_type(function_type->return_type, return_type)) {
+            return {};
+        }
+        auto call = utils::make<ir::FunctionCall>();
+        call->function_type = function_type;
+        call->operands.add(lhs);
+        call->operands.add(rhs);
+        return call;
+    }
+
+    /**
+     * Evaluates the given function call, of which all operands must be
+     * literals for this to succeed. Returns an empty expression if the
+     * function call can't be evaluated.
+     */
+    ir::ExpressionRef evaluate(const ir::FunctionCall &fn) const {
+        const auto &name = fn.function_type->name;
+        utils::Vec<utils::Int> args;
+        for (const auto &operand : fn.operands) {
+            utils::Int value;
+            if (!get_literal_value(operand, value)) {
+                return {};
+            }
+            args.push_back(value);
+        }
+
+        // Arithmetic is done on unsigned values to get two's complement
+        // wraparound; make_literal() rejects values that don't fit the return
+        // type.
+        utils::Int result;
+        if (args.size() == 1) {
+            auto a = args[0];
+            if (name == "operator!") {
+                result = !a;
+            } else if (name == "operator~") {
+                result = fn.function_type->return_type->as_bit_type() ? !a : ~a;
+            } else if (name == "operator-") {
+                result = (utils::Int)(0 - (utils::UInt)a);
+            } else if (name == "int") {
+                result = a;
+            } else {
+                return {};
+            }
+        } else if (args.size() == 2) {
+            auto a = args[0];
+            auto b = args[1];
+            if (name == "operator+") {
+                result = (utils::Int)((utils::UInt)a + (utils::UInt)b);
+            } else if (name == "operator-") {
+                result = (utils::Int)((utils::UInt)a - (utils::UInt)b);
+            } else if (name == "operator*") {
+                result = (utils::Int)((utils::UInt)a * (utils::UInt)b);
+            } else if (name == "operator/" || name == "operator%") {
+                if (b == 0 || (a == utils::MIN && b == -1)) {
+                    return {};
+                }
+                result = name == "operator/" ? a / b : a % b;
+            } else if (name == "operator<<" || name == "operator>>") {
+                if (b < 0 || b >= 64) {
+                    return {};
+                }
+                result = name == "operator<<" ? (utils::Int)((utils::UInt)a << b) : a >> b;
+            } else if (name == "operator&") {
+                result = a & b;
+            } else if (name == "operator|") {
+                result = a | b;
+            } else if (name == "operator^") {
+                result = a ^ b;
+            } else if (name == "operator&&") {
+                result = a && b;
+            } else if (name == "operator||") {
+                result = a || b;
+            } else if (name == "operator^^") {
+                result = (a != 0) != (b != 0);
+            } else if (name == "operator==") {
+                result = a == b;
+            } else if (name == "operator!=") {
+                result = a != b;
+            } else if (name == "operator<") {
+                result = a < b;
+            } else if (name == "operator>") {
+                result = a > b;
+            } else if (name == "operator<=") {
+                result = a <= b;
+            } else if (name == "operator>=") {
+                result = a >= b;
+            } else {
+                return {};
+            }
+        } else {
+            return {};
+        }
+        return make_literal(result, fn.function_type->return_type);
+    }
+
+    /**
+     * Merges additions and subtractions of literals into the given offset,
+     * starting from expr, and returns the expression that remains. Sets merged
+     * if anything was merged.
+     */
+    ir::ExpressionRef strip_offset(
+        const ir::ExpressionRef &expr,
+        utils::Int &offset,
+        utils::Bool &merged
+    ) const {
+        auto fn = expr->as_function_call();
+        if (!fn || fn->operands.size() != 2) {
+            return expr;
+        }
+        const auto &name = fn->function_type->name;
+        if (name != "operator+" && name != "operator-") {
+            return expr;
+        }
+        utils::Int value;
+        if (get_literal_value(fn->operands[1], value)) {
+            if (name == "operator-") {
+                if (value == utils::MIN) return expr;
+                value = -value;
+            }
+            if (!checked_add(offset, value)) return expr;
+            merged = true;
+            return fn->operands[0];
+        } else if (name == "operator+" && get_literal_value(fn->operands[0], value)) {
+            if (!checked_add(offset, value)) return expr;
+            merged = true;
+            return fn->operands[1];
+        }
+        return expr;
+    }
+
+    /**
+     * Simplifies the given function call using algebraic identities, given
+     * that not all of its operands are literals. Returns an empty expression
+     * if nothing can be simplified.
+     */
+    ir::ExpressionRef simplify(const ir::FunctionCall &fn) const {
+        const auto &name = fn.function_type->name;
+        const auto &return_type = fn.function_type->return_type;
+
+        // Double negation.
+        if (fn.operands.size() == 1) {
+            if (name != "operator!" && name != "operator~") {
+                return {};
+            }
+            auto inner = fn.operands[0]->as_function_call();
+            if (
+                inner && inner->operands.size() == 1 &&
+                inner->function_type->name == name &&
+                same_type(ir::get_type_of(inner->operands[0]), return_type)
+            ) {
+                return inner->operands[0];
+            }
+            return {};
+        }
+        if (fn.operands.size() != 2) {
+            return {};
+        }
+
+        // Figure out which operand is a literal. For non-commutative
+        // operators, this must be the right-hand side.
+        const auto &lhs = fn.operands[0];
+        const auto &rhs = fn.operands[1];
+        utils::Int value;
+        auto literal_rhs = get_literal_value(rhs, value);
+        if (!literal_rhs && !get_literal_value(lhs, value)) {
+            return {};
+        }
+        if (!literal_rhs && (
+            name == "operator-" || name == "operator/" || name == "operator%" ||
+            name == "operator<<" || name == "operator>>"
+        )) {
+            return {};
+        }
+        const auto &other = literal_rhs ? lhs : rhs;
+        auto literal_type = ir::get_type_of(literal_rhs ? rhs : lhs);
+        auto keeps_type = same_type(ir::get_type_of(other), return_type);
+
+        if (name == "operator+" || name == "operator-") {
+
+            // Merge nested additions and subtractions of literals, and drop
+            // additions of zero.
+            utils::Int offset = value;
+            if (name == "operator-") {
+                if (value == utils::MIN) return {};
+                offset = -value;
+            }
+            utils::Bool merged = false;
+            auto base = strip_offset(other, offset, merged);
+            if (offset == 0) {
+                if (same_type(ir::get_type_of(base), return_type)) {
+                    return base;
+                }
+                return {};
+            }
+            if (!merged || offset == utils::MIN) {
+                return {};
+            }
+            auto literal = make_literal(offset > 0 ? offset : -offset, literal_type);
+            if (literal.empty()) {
+                return {};
+            }
+            return make_binary(offset > 0 ? "operator+" : "operator-", base, literal, return_type);
+
+        } else if (name == "operator|" || name == "operator^") {
+            if (value == 0 && keeps_type) {
+                return other;
+            }
+        } else if (name == "operator&") {
+            if (value == 0) {
+                return make_literal(0, return_type);
+            }
+        } else if (name == "operator*") {
+            if (value == 0) {
+                return make_literal(0, return_type);
+            } else if (value == 1 && keeps_type) {
+                return other;
+            } else if (value > 1 && (value & (value - 1)) == 0) {
+                utils::Int shift = 0;
+                while ((utils::Int)1 << shift != value) shift++;
+                auto literal = make_literal(shift, literal_type);
+                if (!literal.empty()) {
+                    return make_binary("operator<<", other, literal, return_type);
+                }
+            }
+        } else if (name == "operator/") {
+            if (value == 1 && keeps_type) {
+                return other;
+            }
+        } else if (name == "operator<<" || name == "operator>>") {
+            if (value == 0 && keeps_type) {
+                return other;
+            }
+        } else if (name == "operator&&") {
+            if (!value) {
+                return make_literal(0, return_type);
+            } else if (keeps_type) {
+                return other;
+            }
+        } else if (name == "operator||") {
+            if (value) {
+                return make_literal(1, return_type);
+            } else if (keeps_type) {
+                return other;
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Folds the given expression in place, substituting the given known
+     * values.
+     */
+    void fold(ir::ExpressionRef &expr, const Values &values) {
+        if (expr->as_reference()) {
+            auto ref = expr.as<ir::Reference>();
+            for (auto &index : ref->indices) {
+                fold(index, values);
+            }
+            if (values.empty() || !is_trackable(ref)) {
+                return;
+            }
+            auto it = values.find(com::ddg::Reference(ref));
+            if (it != values.end()) {
+                QL_DOUT("propagating " << ir::describe(it->second) << " into " << ir::describe(expr));
+                expr = it->second.clone();
+                count++;
+            }
+        } else if (auto fn = expr->as_function_call()) {
+            for (auto &operand : fn->operands) {
+                fold(operand, values);
+            }
+            auto result = evaluate(*fn);
+            if (result.empty() && reduce) {
+                result = simplify(*fn);
+            }
+            if (!result.empty()) {
+                QL_DOUT("folding " << ir::describe(expr) << " to " << ir::describe(result));
+                expr = result;
+                count++;
+            }
+        }
+    }
+
+    /**
+     * Forgets the values of all objects that may be written by the given
+     * statement.
+     */
+    void kill(const ir::StatementRef &statement, Values &values) {
+        if (values.empty()) {
+            return;
+        }
+        gatherer.reset();
+        gatherer.add_statement(statement);
+        utils::Vec<com::ddg::Reference> killed;
+        for (const auto &value : values) {
+            for (const auto &event : gatherer.get()) {
+                if (event.second == com::ddg::AccessMode::read() || event.first.is_global_state()) {
+                    continue;
+                }
+                if (!value.first.is_provably_distinct_from(event.first)) {
+                    killed.push_back(value.first);
+                    break;
+                }
+            }
+        }
+        for (const auto &reference : killed) {
+            values.erase(reference);
+        }
+    }
+
+    /**
+     * Simplifies an if-else chain. Returns false if the statement can be
+     * removed entirely.
+     */
+    utils::Bool process_if_else(const ir::StatementRef &statement, Values &values) {
+        auto if_else = statement->as_if_else();
+
+        // Fold the conditions, dropping branches that can never be taken and
+        // everything after a branch that is always taken. Conditions are
+        // evaluated in order, so nothing is written in between.
+        utils::Many<ir::IfElseBranch> branches;
+        for (const auto &branch : if_else->branches) {
+            fold(branch->condition, values);
+            auto literal = branch->condition->as_bit_literal();
+            if (!prune || !literal) {
+                branches.add(branch);
+                continue;
+            }
+            if (!literal->value) {
+                count++;
+                continue;
+            }
+            if (branches.empty()) {
+                branches.add(branch);
+                if (!if_else->otherwise.empty()) {
+                    if_else->otherwise.reset();
+                    count++;
+                }
+            } else {
+                if_else->otherwise = branch->body;
+                count++;
+            }
+            break;
+        }
+        if (branches.empty()) {
+            if (if_else->otherwise.empty()) {
+                return false;
+            }
+            branches.add(utils::make<ir::IfElseBranch>(
+                ir::make_bit_lit(ir, true),
+                if_else->otherwise
+            ));
+            if_else->otherwise.reset();
+        }
+        if_else->branches = branches;
+
+        // Simplify the bodies, each starting from the values before the
+        // if-else chain.
+        for (const auto &branch : if_else->branches) {
+            auto branch_values = values;
+            process_block(branch->body, branch_values);
+        }
+        if (!if_else->otherwise.empty()) {
+            auto otherwise_values = values;
+            process_block(if_else->otherwise, otherwise_values);
+        }
+        kill(statement, values);
+        return true;
+    }
+
+    /**
+     * Simplifies a loop.
+     */
+    void process_loop(const ir::StatementRef &statement, Values &values) {
+        auto for_loop = statement->as_for_loop();
+        if (for_loop && !for_loop->initialize.empty()) {
+            fold(for_loop->initialize->rhs, values);
+        }
+
+        // Only the values of objects that are not written anywhere in the
+        // loop are valid at the start of each iteration. Those are then
+        // propagated into the condition, update, and body.
+        kill(statement, values);
+        if (auto dynamic_loop = statement->as_dynamic_loop()) {
+            fold(dynamic_loop->condition, values);
+        }
+        if (for_loop && !for_loop->update.empty()) {
+            fold(for_loop->update->rhs, values);
+        }
+        auto body_values = values;
+        process_block(statement->as_loop()->body, body_values);
+    }
+
+    /**
+     * Simplifies the given statement, and updates the given values according
+     * to what it writes. Returns false if the statement can be removed.
+     */
+    utils::Bool process_statement(const ir::StatementRef &statement, Values &values) {
+        if (auto insn = statement->as_conditional_instruction()) {
+            fold(insn->condition, values);
+            auto condition = insn->condition->as_bit_literal();
+            if (prune && condition && !condition->value) {
+                QL_DOUT("removing never-executed " << ir::describe(statement));
+                return false;
+            }
+            auto unconditional = condition && condition->value;
+            if (auto set = statement->as_set_instruction()) {
+                fold(set->rhs, values);
+                auto trackable = is_trackable(set->lhs);
+                if (unconditional && trackable) {
+                    com::ddg::Reference lhs(set->lhs);
+                    if (set->rhs->as_reference()) {
+                        auto rhs = set->rhs.as<ir::Reference>();
+                        if (is_trackable(rhs) && com::ddg::Reference(rhs) == lhs) {
+                            QL_DOUT("removing self-assignment " << ir::describe(statement));
+                            return false;
+                        }
+                    }
+                    auto it = values.find(lhs);
+                    if (it != values.end() && same_literal(it->second, set->rhs)) {
+                        QL_DOUT("removing redundant " << ir::describe(statement));
+                        return false;
+                    }
+                }
+                kill(statement, values);
+                utils::Int value;
+                if (propagate && unconditional && trackable && get_literal_value(set->rhs, value)) {
+                    values.set(com::ddg::Reference(set->lhs)) = set->rhs;
+                }
+                return true;
+            }
+        } else if (statement->as_if_else()) {
+            return process_if_else(statement, values);
+        } else if (statement->as_loop()) {
+            process_loop(statement, values);
+            return true;
+        }
+        kill(statement, values);
+        return true;
+    }
+
+public:
+
+    /**
+     * Creates a new constant folder.
+     */
+    ConstantFolder(
+        const ir::Ref &ir,
+        utils::Bool propagate,
+        utils::Bool reduce,
+        utils::Bool prune
+    ) :
+        ir(ir),
+        propagate(propagate),
+        reduce(reduce),
+        prune(prune),
+        gatherer(ir)
+    {}
+
+    /**
+     * Simplifies the statements of the given block and (recursively) its
+     * structured control-flow sub-blocks, starting from the given known
+     * values, which are updated to the values known at the end of the block.
+     */
+    void process_block(const ir::BlockBaseRef &block, Values &values) {
+        auto statements = block->statements;
+        block->statements.reset();
+        for (const auto &statement : statements) {
+            if (process_statement(statement, values)) {
+                block->statements.add(statement);
+            } else {
+                count++;
+            }
+        }
+    }
+
+    /**
+     * Returns the number of simplifications made thus far.
+     */
+    utils::UInt get_count() const {
+        return count;
+    }
+
+};
+
+/**
+ * Runs the constant folding pass.
+ */
+utils::Int ConstFoldPass::run(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) const {
+    ConstantFolder folder(
+        ir,
+        context.options["propagate"].as_bool(),
+        context.options["strength_reduction"].as_bool(),
+        context.options["prune_branches"].as_bool()
+    );
+    if (!ir->program.empty()) {
+        for (const auto &block : ir->program->blocks) {
+            ConstantFolder::Values values;
+            folder.process_block(block, values);
+        }
+    }
+    QL_DOUT("made " << folder.get_count() << " simplifications");
+    return folder.get_count();
+}
+
+} // namespace const_fold
+} // namespace opt
+} // namespace pass
+} // namespace ql
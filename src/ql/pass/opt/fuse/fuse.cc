@@ -0,0 +1,565 @@
+/** \file
+ * Defines the single-qubit gate fusion pass.
+ */
+
+#include "ql/pass/opt/fuse/fuse.h"
+
+#include <array>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+#include "ql/ir/ops.h"
+#include "ql/ir/describe.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/com/ddg/build.h"
+#include "ql/com/ddg/ops.h"
+#include "ql/pmgr/pass_types/base.h"
+
+namespace ql {
+namespace pass {
+namespace opt {
+namespace fuse {
+
+/**
+ * Dumps docs for the gate fusion pass.
+ */
+void FusePass::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass fuses runs of single-qubit gates on the same qubit into a single
+    2x2 unitary matrix, and then resynthesizes that unitary as a sequence of
+    at most three rotations around two axes (an Euler decomposition). The run
+    is only replaced when the resulting sequence is cheaper than the original
+    run, in terms of the total duration of the gates and then their number.
+    Runs that amount to the identity are removed entirely. Global phase is
+    ignored.
+
+    As for the gate canceller, gates don't need to be adjacent to be part of
+    the same run: the data dependency graph of each block is used to determine
+    whether the gates in between can be commuted out of the way, such that
+    the fused sequence can take the place of the last gate of the run. Which
+    gates commute is controlled with the `commute_*` options.
+
+    The gates that can be fused are currently recognized by name: `i`, `x`,
+    `y`, `z`, `h`, `s`, `sdag`, `t`, `tdag`, `x90`, `mx90`, `y90`, `my90`,
+    `rx90`, `mrx90`, `ry90`, `mry90`, `x180`, `y180`, `rx180`, `ry180`, and
+    `rz180`, as well as the rotations `rx`, `ry`, and `rz` with a literal angle
+    operand. Only unconditional instructions with a single statically-indexed
+    qubit operand are fused. The resynthesized sequences consist of `rx`, `ry`
+    and/or `rz` gates, so at least two of these must be defined by the
+    platform for anything but the removal of identities.
+
+    The pass returns by how many statements the program shrunk.
+    )");
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str FusePass::get_friendly_type() const {
+    return "Gate fuser";
+}
+
+/**
+ * Constructs a gate fusion pass.
+ */
+FusePass::FusePass(
+    const utils::Ptr<const pmgr::Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pmgr::pass_types::Transformation(pass_factory, instance_name, type_name) {
+
+    options.add_bool(
+        "commute_multi_qubit",
+        "Whether to consider commutation rules for multi-qubit gates.",
+        true
+    );
+
+    options.add_bool(
+        "commute_single_qubit",
+        "Whether to consider commutation rules for single-qubit gates.",
+        true
+    );
+
+    options.add_enum(
+        "basis",
+        "The rotation axes used to resynthesize fused runs. `zyz`, for "
+        "instance, resynthesizes runs as a Z rotation, followed by a Y "
+        "rotation, followed by a Z rotation. When set to `auto`, all bases "
+        "of which the rotation gates exist are tried, and the cheapest "
+        "result is used.",
+        "auto",
+        {"auto", "zyz", "zxz", "xyx", "xzx"}
+    );
+
+}
+
+/**
+ * A 2x2 complex matrix, stored row-major.
+ */
+using Matrix = std::array<utils::Complex, 4>;
+
+/**
+ * Returns the product a * b of two 2x2 matrices.
+ */
+static inline Matrix multiply(const Matrix &a, const Matrix &b) {
+    return {
+        a[0] * b[0] + a[1] * b[2], a[0] * b[1] + a[1] * b[3],
+        a[2] * b[0] + a[3] * b[2], a[2] * b[1] + a[3] * b[3]
+    };
+}
+
+/**
+ * Returns the matrix for a rotation by the given angle around the given axis
+ * (0 for X, 1 for Y, 2 for Z).
+ */
+static Matrix rotation(utils::UInt axis, utils::Real angle) {
+    utils::Real c = std::cos(angle / 2);
+    utils::Real s = std::sin(angle / 2);
+    switch (axis) {
+        case 0: return {c, -utils::IM * s, -utils::IM * s, c};
+        case 1: return {c, -s, s, c};
+        default: return {utils::expi(-angle / 2), 0.0, 0.0, utils::expi(angle / 2)};
+    }
+}
+
+/**
+ * Rotation axis and angle of each rotation-like gate recognized by the pass,
+ * by name.
+ *
+ * TODO: like for the Clifford optimizer, these semantics should come from the
+ *  platform configuration somehow.
+ */
+static const std::unordered_map<utils::Str, std::pair<utils::UInt, utils::Real>> FIXED_ROTATIONS{
+    {"i", {2, 0.0}},
+    {"x", {0, utils::PI}},
+    {"y", {1, utils::PI}},
+    {"z", {2, utils::PI}},
+    {"s", {2, utils::PI / 2}},
+    {"sdag", {2, -utils::PI / 2}},
+    {"t", {2, utils::PI / 4}},
+    {"tdag", {2, -utils::PI / 4}},
+    {"x90", {0, utils::PI / 2}},
+    {"mx90", {0, -utils::PI / 2}},
+    {"y90", {1, utils::PI / 2}},
+    {"my90", {1, -utils::PI / 2}},
+    {"rx90", {0, utils::PI / 2}},
+    {"mrx90", {0, -utils::PI / 2}},
+    {"ry90", {1, utils::PI / 2}},
+    {"mry90", {1, -utils::PI / 2}},
+    {"x180", {0, utils::PI}},
+    {"y180", {1, utils::PI}},
+    {"rx180", {0, utils::PI}},
+    {"ry180", {1, utils::PI}},
+    {"rz180", {2, utils::PI}}
+};
+
+/**
+ * Rotation gates taking a qubit and a real-valued angle in radians, by axis.
+ */
+static const std::array<const char*, 3> ROTATIONS{"rx", "ry", "rz"};
+
+/**
+ * Rotations with an angle closer than this to a multiple of 2 pi are
+ * considered to be the identity.
+ */
+static const utils::Real ANGLE_TOLERANCE = 1e-9;
+
+/**
+ * The maximum number of gates in a run. This just bounds the cost of the
+ * commutation checks for very long runs; longer runs are split.
+ */
+static const utils::UInt MAX_RUN_LENGTH = 256;
+
+/**
+ * Returns the raw pointer of a statement, for use as a key.
+ */
+static const ir::Statement *key_of(const ir::StatementRef &statement) {
+    return statement.get_ptr().get();
+}
+
+/**
+ * If the given statement is a single-qubit gate recognized by the pass, sets
+ * qubit and matrix accordingly and returns true.
+ */
+static utils::Bool get_gate(
+    const ir::StatementRef &statement,
+    utils::One<ir::Expression> &qubit,
+    Matrix &matrix
+) {
+    auto custom = statement->as_custom_instruction();
+    if (!custom || custom->instruction_type->barrier) {
+        return false;
+    }
+    auto condition = custom->condition->as_bit_literal();
+    if (!condition || !condition->value) {
+        return false;
+    }
+    const auto &name = custom->instruction_type->name;
+    utils::Bool hadamard = name == "h";
+    utils::UInt axis = 3;
+    auto fixed = FIXED_ROTATIONS.find(name);
+    if (!hadamard && fixed == FIXED_ROTATIONS.end()) {
+        for (utils::UInt i = 0; i < 3; i++) {
+            if (name == ROTATIONS[i]) {
+                axis = i;
+            }
+        }
+        if (axis == 3) {
+            return false;
+        }
+    }
+
+    // Check the operands. We only handle a qubit with a statically known
+    // index, and (for rotations) a literal angle.
+    utils::Bool have_angle = false;
+    utils::Real angle = 0.0;
+    qubit.reset();
+    for (const auto &operand : ir::get_operands(statement.as<ir::Instruction>())) {
+        if (auto ref = operand->as_reference()) {
+            if (!qubit.empty() || !ref->data_type->as_qubit_type()) {
+                return false;
+            }
+            com::ddg::Reference reference(operand.as<ir::Reference>());
+            if (reference.indices.size() != ref->indices.size()) {
+                return false;
+            }
+            qubit = operand;
+        } else if (auto lit = operand->as_real_literal()) {
+            if (axis == 3 || have_angle) {
+                return false;
+            }
+            angle = lit->value;
+            have_angle = true;
+        } else {
+            return false;
+        }
+    }
+    if (qubit.empty()) {
+        return false;
+    }
+    if (hadamard) {
+        utils::Real r = 1.0 / std::sqrt(2.0);
+        matrix = {r, r, r, -r};
+    } else if (fixed != FIXED_ROTATIONS.end()) {
+        matrix = rotation(fixed->second.first, fixed->second.second);
+    } else if (have_angle) {
+        matrix = rotation(axis, angle);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Returns whether the given statement can join the given run, i.e. whether
+ * the statements of the run can be moved forward to directly before it by
+ * commuting the statements in between out of the way.
+ *
+ * This is the case iff no statement between the run and the given statement
+ * depends on any statement of the run.
+ */
+static utils::Bool can_join(
+    const utils::Vec<ir::StatementRef> &run,
+    const std::unordered_set<const ir::Statement*> &members,
+    const ir::StatementRef &statement
+) {
+    auto order = com::ddg::get_node(statement)->order;
+    for (const auto &member : run) {
+        for (const auto &successor : com::ddg::get_node(member)->successors) {
+            const auto &next = successor.first;
+            if (key_of(next) == key_of(statement)) {
+                continue;
+            }
+            if (com::ddg::get_node(next)->order > order) {
+                continue;
+            }
+            if (!members.count(key_of(next))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * Normalizes the given angle in radians to the range (-pi, pi].
+ */
+static utils::Real normalize_angle(utils::Real angle) {
+    angle = std::fmod(angle, 2 * utils::PI);
+    if (angle > utils::PI) {
+        angle -= 2 * utils::PI;
+    } else if (angle <= -utils::PI) {
+        angle += 2 * utils::PI;
+    }
+    return angle;
+}
+
+/**
+ * A sequence of rotations in circuit order, as axis and angle pairs.
+ */
+using Rotations = utils::Vec<std::pair<utils::UInt, utils::Real>>;
+
+/**
+ * Returns the angles a, b, and c such that the given unitary equals
+ * Rz(a) * Ry(b) * Rz(c) up to global phase.
+ */
+static std::array<utils::Real, 3> decompose_zyz(const Matrix &u) {
+
+    // Scale to a determinant of 1. With b in [0, pi], the top-left element is
+    // then exp(-i(a+c)/2) cos(b/2) and the bottom-left element is
+    // exp(i(a-c)/2) sin(b/2). The sign ambiguity of the square root only
+    // changes a by 2 pi, which is a global phase.
+    auto scale = std::sqrt(u[0] * u[3] - u[1] * u[2]);
+    auto top = u[0] / scale;
+    auto bottom = u[2] / scale;
+    utils::Real b = 2 * std::atan2(std::abs(bottom), std::abs(top));
+    utils::Real half_sum = 0.0;
+    utils::Real half_diff = 0.0;
+    if (std::abs(top) > ANGLE_TOLERANCE) {
+        half_sum = -std::arg(top);
+    }
+    if (std::abs(bottom) > ANGLE_TOLERANCE) {
+        half_diff = std::arg(bottom);
+    }
+    return {half_sum + half_diff, b, half_sum - half_diff};
+}
+
+/**
+ * Resynthesizes the given unitary in the given basis, returning the rotations
+ * in circuit order. Identity rotations are dropped, and adjacent rotations
+ * around the same axis are merged.
+ */
+static Rotations resynthesize(const Matrix &u, const utils::Str &basis) {
+    std::array<utils::UInt, 3> axes;
+    std::array<utils::Real, 3> angles;
+    if (basis == "zyz" || basis == "zxz") {
+        angles = decompose_zyz(u);
+        if (basis == "zyz") {
+            axes = {2, 1, 2};
+        } else {
+
+            // Ry(b) = Rz(pi/2) * Rx(b) * Rz(-pi/2).
+            axes = {2, 0, 2};
+            angles[0] += utils::PI / 2;
+            angles[2] -= utils::PI / 2;
+
+        }
+    } else {
+
+        // Conjugating with a Hadamard swaps the X and Z axes and negates Y.
+        utils::Real r = 1.0 / std::sqrt(2.0);
+        Matrix h{r, r, r, -r};
+        angles = decompose_zyz(multiply(h, multiply(u, h)));
+        angles[1] = -angles[1];
+        if (basis == "xyx") {
+            axes = {0, 1, 0};
+        } else {
+
+            // Ry(b) = Rx(-pi/2) * Rz(b) * Rx(pi/2).
+            axes = {0, 2, 0};
+            angles[0] -= utils::PI / 2;
+            angles[2] += utils::PI / 2;
+
+        }
+    }
+
+    // The angles are in matrix order, so the last one comes first in the
+    // circuit.
+    Rotations result;
+    for (utils::UInt i = 3; i-- > 0; ) {
+        auto angle = normalize_angle(angles[i]);
+        if (!result.empty() && result.back().first == axes[i]) {
+            angle = normalize_angle(result.back().second + angle);
+            result.pop_back();
+        }
+        if (std::abs(angle) > ANGLE_TOLERANCE) {
+            result.emplace_back(axes[i], angle);
+        }
+    }
+    return result;
+}
+
+/**
+ * Fuses single-qubit gates in the given block and (recursively) its
+ * structured control-flow sub-blocks. Returns by how many statements the
+ * blocks shrunk.
+ */
+utils::UInt FusePass::run_on_block(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    const pmgr::pass_types::Context &context
+) {
+    auto commute_multi_qubit = context.options["commute_multi_qubit"].as_bool();
+    auto commute_single_qubit = context.options["commute_single_qubit"].as_bool();
+    auto basis_option = context.options["basis"].as_str();
+    utils::Vec<utils::Str> bases;
+    if (basis_option == "auto") {
+        bases = {"zyz", "zxz", "xyx", "xzx"};
+    } else {
+        bases = {basis_option};
+    }
+    auto real_type = ir::find_type(ir, "real");
+    com::ddg::build(ir, block, commute_multi_qubit, commute_single_qubit);
+
+    // The run of fusable gates currently open for each qubit.
+    struct Run {
+        utils::Vec<ir::StatementRef> statements;
+        std::unordered_set<const ir::Statement*> members;
+        utils::One<ir::Expression> qubit;
+        Matrix unitary{1.0, 0.0, 0.0, 1.0};
+    };
+    utils::Map<com::ddg::Reference, Run> runs;
+
+    // Statements to be removed, and the statements replacing the last
+    // statement of each fused run.
+    std::unordered_set<const ir::Statement*> removed;
+    std::unordered_map<const ir::Statement*, utils::Vec<ir::StatementRef>> replacements;
+    utils::UInt count = 0;
+
+    // Resynthesizes the given run, and records its replacement if that's
+    // cheaper than the run itself.
+    auto finish = [&](Run &run) {
+        if (run.statements.empty()) {
+            return;
+        }
+        utils::UInt old_duration = 0;
+        for (const auto &statement : run.statements) {
+            old_duration += ir::get_duration_of_statement(statement);
+        }
+        auto best_duration = old_duration;
+        auto best_size = run.statements.size();
+        utils::Vec<ir::StatementRef> best;
+        utils::Bool found = false;
+        for (const auto &basis : bases) {
+            auto rotations = resynthesize(run.unitary, basis);
+            if (!rotations.empty() && real_type.empty()) {
+                continue;
+            }
+            utils::Vec<ir::StatementRef> sequence;
+            utils::UInt duration = 0;
+            for (const auto &rot : rotations) {
+                utils::Any<ir::Expression> operands;
+                operands.add(run.qubit.clone());
+                operands.emplace<ir::RealLiteral>(rot.second, real_type);
+                auto insn = ir::make_instruction(ir, ROTATIONS[rot.first], operands, {}, true);
+                if (insn.empty()) {
+                    break;
+                }
+                insn->cycle = run.statements.back()->cycle;
+                duration += ir::get_duration_of_instruction(insn);
+                sequence.push_back(insn.as<ir::Statement>());
+            }
+            if (sequence.size() != rotations.size()) {
+                continue;
+            }
+            if (
+                duration < best_duration ||
+                (duration == best_duration && sequence.size() < best_size)
+            ) {
+                best_duration = duration;
+                best_size = sequence.size();
+                best = std::move(sequence);
+                found = true;
+            }
+        }
+        if (found) {
+            QL_DOUT(
+                "fusing " << run.statements.size() << " gates ending with " <<
+                ir::describe(run.statements.back()) << " into " << best.size()
+            );
+            for (const auto &statement : run.statements) {
+                removed.insert(key_of(statement));
+            }
+            count += run.statements.size() - best.size();
+            replacements[key_of(run.statements.back())] = std::move(best);
+        }
+        run.statements.clear();
+        run.members.clear();
+        run.unitary = {1.0, 0.0, 0.0, 1.0};
+    };
+
+    // Walk over the statements in order, growing the runs for each qubit.
+    utils::One<ir::Expression> qubit;
+    Matrix matrix;
+    for (const auto &statement : block->statements) {
+        if (!get_gate(statement, qubit, matrix)) {
+            continue;
+        }
+        auto &run = runs.set(com::ddg::Reference(qubit.as<ir::Reference>()));
+        if (
+            !run.statements.empty() && (
+                run.statements.size() >= MAX_RUN_LENGTH ||
+                !can_join(run.statements, run.members, statement)
+            )
+        ) {
+            finish(run);
+        }
+        run.statements.push_back(statement);
+        run.members.insert(key_of(statement));
+        run.qubit = qubit;
+        run.unitary = multiply(matrix, run.unitary);
+    }
+    for (auto &it : runs) {
+        finish(it.second);
+    }
+    com::ddg::clear(block);
+
+    // Replace the statements of the fused runs. The replacements reuse the
+    // cycle of the last statement of the run, so the schedule is broken.
+    if (!removed.empty()) {
+        block->erase_annotation<ir::KernelCyclesValid>();
+        auto statements = block->statements;
+        block->statements.reset();
+        for (const auto &statement : statements) {
+            auto it = replacements.find(key_of(statement));
+            if (it != replacements.end()) {
+                for (const auto &replacement : it->second) {
+                    block->statements.add(replacement);
+                }
+            } else if (!removed.count(key_of(statement))) {
+                block->statements.add(statement);
+            }
+        }
+    }
+
+    // Recurse into structured control-flow sub-blocks.
+    for (const auto &statement : block->statements) {
+        if (auto if_else = statement->as_if_else()) {
+            for (const auto &branch : if_else->branches) {
+                count += run_on_block(ir, branch->body, context);
+            }
+            if (!if_else->otherwise.empty()) {
+                count += run_on_block(ir, if_else->otherwise, context);
+            }
+        } else if (auto loop = statement->as_loop()) {
+            count += run_on_block(ir, loop->body, context);
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Runs the gate fusion pass.
+ */
+utils::Int FusePass::run(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) const {
+    utils::UInt count = 0;
+    if (!ir->program.empty()) {
+        for (const auto &block : ir->program->blocks) {
+            count += run_on_block(ir, block, context);
+        }
+    }
+    QL_DOUT("removed " << count << " statements");
+    return count;
+}
+
+} // namespace fuse
+} // namespace opt
+} // namespace pass
+} // namespace ql
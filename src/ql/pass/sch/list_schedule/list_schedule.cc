@@ -5,11 +5,23 @@
 #include "ql/pass/sch/list_schedule/list_schedule.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
+#include "ql/utils/parallel.h"
 #include "ql/ir/old_to_new.h"
+#include "ql/ir/ops.h"
 #include "ql/com/ddg/build.h"
 #include "ql/com/ddg/ops.h"
 #include "ql/com/ddg/dot.h"
+#include "ql/com/ddg/incremental.h"
+#include "ql/com/cfg/build.h"
+#include "ql/com/cfg/ops.h"
+#include "ql/com/dec/structure.h"
 #include "ql/com/sch/scheduler.h"
+#include "ql/com/sch/frontier.h"
+#include "ql/rmgr/static_state.h"
+#include "ql/resource/qubit.h"
+#include "ql/resource/instrument.h"
+#include "ql/resource/inter_core_channel.h"
 #include "ql/pmgr/pass_types/base.h"
 
 namespace ql {
@@ -27,13 +39,29 @@ void ListSchedulePass::dump_docs(
     utils::dump_str(os, line_prefix, R"(
     This pass analyzes the data dependencies between statements and applies
     quantum cycle numbers to them using optionally resource-constrained ASAP or
-    ALAP list scheduling. All blocks in the program are scheduled independently.
+    ALAP list scheduling. All blocks in the program are scheduled independently,
+    unless cross_block is enabled; in that case, the tail of a block may
+    subsequently be overlapped with the head of the block that follows it.
+
+    When resource constraints are disabled, the schedule only depends on the
+    data dependencies, and is computed in a single pass over each block without
+    building the data dependency graph, unless it is needed for the dot graph
+    output or debug logging.
     )");
 }
 
 /**
  * Returns a user-friendly type name for this pass.
  */
+/**
+ * Returns whether the result of the scheduler may be restored from the pass
+ * cache, which is the case unless it is configured to write output files.
+ */
+utils::Bool ListSchedulePass::is_cacheable() const {
+    return !options["write_dot_graphs"].as_bool()
+        && !options["write_resource_statistics"].as_bool();
+}
+
 utils::Str ListSchedulePass::get_friendly_type() const {
     return "List scheduler";
 }
@@ -79,6 +107,21 @@ ListSchedulePass::ListSchedulePass(
         {"none", "critical_path", "deep_criticality"}
     );
 
+    options.add_int(
+        "feedback_latency",
+        "The latency in cycles between a measurement and a gate conditioned "
+        "on its result, for example due to the classical feedback path of the "
+        "control electronics. This is added to the critical path lengths "
+        "computed for the `critical_path` and `deep_criticality` heuristics "
+        "wherever a conditional gate depends on the bit it is conditioned "
+        "on, such that measurements that feed back into the program are "
+        "scheduled as early as possible and independent statements fill the "
+        "feedback gap. It does not affect the cycle constraints of the "
+        "schedule itself.",
+        "0",
+        0
+    );
+
     options.add_bool(
         "commute_multi_qubit",
         "Whether to consider commutation rules for multi-qubit gates.",
@@ -91,6 +134,15 @@ ListSchedulePass::ListSchedulePass(
         false
     );
 
+    options.add_bool(
+        "transitive_reduction",
+        "Whether to prune data dependency graph edges that are implied by "
+        "a path of two other edges while the graph is built. This yields the "
+        "same schedule with fewer edges to process, but the pruned edges and "
+        "their causes are missing from the emitted dot graphs.",
+        false
+    );
+
     options.add_int(
         "max_resource_block_cycles",
         "The maximum number of cycles to wait for the resource constraints to "
@@ -102,6 +154,66 @@ ListSchedulePass::ListSchedulePass(
         0
     );
 
+    options.add_int(
+        "block_threads",
+        "The number of threads to use for scheduling the blocks of the "
+        "program concurrently. Each block of the program is scheduled as a "
+        "single piece of work, along with its structured control-flow "
+        "sub-blocks. When core_partitioned is enabled, this also limits the "
+        "number of threads used to schedule the cores of a block "
+        "concurrently. 0 means use all hardware threads.",
+        "1",
+        0
+    );
+
+    options.add_int(
+        "window_size",
+        "When nonzero, blocks with more statements than this are scheduled "
+        "in consecutive windows of this many statements, to bound the memory "
+        "needed for the data dependency graph of very long blocks. Each window "
+        "is scheduled after the previous one has been committed, with the "
+        "dependencies on earlier windows summarized as the cycle in which "
+        "each accessed object becomes free. This costs some schedule quality, "
+        "because statements can't move past window boundaries. Only supported "
+        "for ASAP scheduling; the option is ignored for ALAP, and when "
+        "resource_constraints is disabled, as the schedule is then computed "
+        "in linear time without a data dependency graph.",
+        "0",
+        0
+    );
+
+    options.add_bool(
+        "core_partitioned",
+        "Whether to schedule blocks on multi-core platforms by core. The "
+        "statements that only involve the qubits of a single core are then "
+        "scheduled concurrently for each core, with inter-core gates and all "
+        "other statements acting as synchronization points between the cores. "
+        "When the cores turn out to share a resource, the statements between "
+        "two synchronization points are rescheduled together. This costs some "
+        "schedule quality, because statements can't move past the "
+        "synchronization points. Only supported for ASAP scheduling on "
+        "platforms with more than one core; the option is ignored otherwise, "
+        "and when resource_constraints is disabled, as the schedule is then "
+        "computed in linear time without a data dependency graph. Takes "
+        "precedence over window_size.",
+        false
+    );
+
+    options.add_bool(
+        "cross_block",
+        "Whether to overlap the tail of each block with the head of the "
+        "block that follows it, when the program is in basic block form and "
+        "control flow permits: the block must unconditionally continue with "
+        "the next block, and that block must not be reachable in any other "
+        "way. The statements of both blocks are then scheduled together, and "
+        "the statements of the second block that can start before the first "
+        "block completes are moved into the first block. This is only done "
+        "when it reduces the combined duration of the two blocks. Blocks are "
+        "otherwise still scheduled to start only when all statements of the "
+        "preceding block have completed.",
+        false
+    );
+
     options.add_bool(
         "write_dot_graphs",
         "Whether to emit a graphviz dot graph representation of the data "
@@ -111,17 +223,30 @@ ListSchedulePass::ListSchedulePass(
         false
     );
 
+    options.add_bool(
+        "write_resource_statistics",
+        "Whether to write a JSON file with performance counters for each "
+        "scheduling resource for each block, using suffix "
+        "`_<block-name>_resources.json`. For each resource, it contains the "
+        "number of availability probes, commits, and rejections (i.e. how "
+        "often the resource prevented a statement from being scheduled), the "
+        "number of earliest-cycle queries, and the time spent in the resource "
+        "in seconds. Only meaningful when resource_constraints is enabled.",
+        false
+    );
+
 }
 
 /**
- * Runs the scheduler on the given block.
+ * Appends the given block and (recursively) its structured control-flow
+ * sub-blocks to the given task list, after giving them a unique name. The
+ * sub-blocks are appended after their parent block.
  */
-void ListSchedulePass::run_on_block(
-    const ir::Ref &ir,
+void ListSchedulePass::gather_blocks(
     const ir::BlockBaseRef &block,
     const utils::Str &name_path,
     utils::Set<utils::Str> &used_names,
-    const pmgr::pass_types::Context &context
+    utils::List<BlockTask> &tasks
 ) {
 
     // Figure out a unique name for this block.
@@ -132,20 +257,692 @@ void ListSchedulePass::run_on_block(
             name = name_path + "_" + utils::to_string(i++);
         } while (!used_names.insert(name).second);
     }
+    tasks.push_back({block, name});
+
+    // Recurse into structured control-flow sub-blocks.
+    for (const auto &statement : block->statements) {
+        if (auto if_else = statement->as_if_else()) {
+            for (const auto &branch : if_else->branches) {
+                gather_blocks(branch->body, name + "_if", used_names, tasks);
+            }
+            if (!if_else->otherwise.empty()) {
+                gather_blocks(if_else->otherwise, name + "_else", used_names, tasks);
+            }
+        } else if (auto loop = statement->as_loop()) {
+            gather_blocks(loop->body, name + "_loop", used_names, tasks);
+        }
+    }
+
+}
+
+/**
+ * Writes the performance counters of the given resource state for the block
+ * with the given name to a JSON file, if requested via the
+ * write_resource_statistics option.
+ */
+template <class ResourceState>
+static void write_resource_statistics(
+    const ResourceState &resource_state,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context
+) {
+    if (!context.options["write_resource_statistics"].as_bool()) {
+        return;
+    }
+    auto filename = context.output_prefix + "_" + name + "_resources.json";
+    QL_DOUT("writing resource statistics to " << filename);
+    utils::Json json;
+    json["block"] = name;
+    json["resources"] = resource_state.get_statistics();
+    utils::AsyncOutFile(filename) << json.dump(4) << "\n";
+}
+
+/**
+ * Runs the given scheduler on a whole block and converts the resulting cycle
+ * numbers, collecting resource statistics along the way if requested and
+ * write_outputs is set.
+ */
+template <class Heuristic, class ResourceState>
+static void run_scheduler(
+    com::sch::Scheduler<Heuristic, ResourceState> &scheduler,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    if (write_outputs && context.options["write_resource_statistics"].as_bool()) {
+        scheduler.enable_resource_statistics();
+    }
+    scheduler.run(context.options["max_resource_block_cycles"].as_int());
+    scheduler.convert_cycles();
+    if (write_outputs) {
+        write_resource_statistics(scheduler.get_resource_state(), name, context);
+    }
+}
+
+/**
+ * Resource state for platforms that only use qubit resources.
+ */
+using QubitState = rmgr::StaticState<
+    resource::qubit::Resource
+>;
+
+/**
+ * Resource state for platforms that use qubit and instrument resources, such
+ * as cc_light and cc.
+ */
+using QubitInstrumentState = rmgr::StaticState<
+    resource::qubit::Resource,
+    resource::instrument::Resource
+>;
+
+/**
+ * Resource state for multi-core platforms that additionally use inter-core
+ * channel resources.
+ */
+using QubitInstrumentChannelState = rmgr::StaticState<
+    resource::qubit::Resource,
+    resource::instrument::Resource,
+    resource::inter_core_channel::Resource
+>;
+
+/**
+ * Runs the scheduler on a whole block using the given heuristic and the given
+ * initial resource state.
+ */
+template <class Heuristic, class ResourceState>
+static void schedule_with_state(
+    const ir::BlockBaseRef &block,
+    const com::ddg::CompactGraphCRef &graph,
+    const ResourceState &resource_state,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    com::sch::Scheduler<Heuristic, ResourceState> scheduler(block, graph, resource_state, 0);
+    run_scheduler(scheduler, name, context, write_outputs);
+}
+
+/**
+ * Runs the scheduler on a whole block using the given heuristic. When
+ * resource constraints are enabled and all resources are of a type that ships
+ * with OpenQL, the resource state is converted to the smallest matching
+ * rmgr::StaticState, such that the resources are not called through their
+ * vtable for every probe. Otherwise, the dynamic rmgr::State is used.
+ */
+template <class Heuristic>
+static void schedule_block(
+    const ir::BlockBaseRef &block,
+    const com::ddg::CompactGraphCRef &graph,
+    const rmgr::CRef &manager,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    if (!manager.has_value()) {
+        com::sch::Scheduler<Heuristic> scheduler(block, graph);
+        run_scheduler(scheduler, name, context, write_outputs);
+        return;
+    }
+    auto state = manager->build(
+        graph->direction > 0 ? rmgr::Direction::FORWARD : rmgr::Direction::BACKWARD
+    );
+    if (QubitState::matches(state)) {
+        schedule_with_state<Heuristic>(block, graph, QubitState(state), name, context, write_outputs);
+    } else if (QubitInstrumentState::matches(state)) {
+        schedule_with_state<Heuristic>(block, graph, QubitInstrumentState(state), name, context, write_outputs);
+    } else if (QubitInstrumentChannelState::matches(state)) {
+        schedule_with_state<Heuristic>(block, graph, QubitInstrumentChannelState(state), name, context, write_outputs);
+    } else {
+        schedule_with_state<Heuristic>(block, graph, state, name, context, write_outputs);
+    }
+}
+
+/**
+ * Schedules a single part of a block for run_windowed_on_block() or
+ * run_core_partitioned_on_block() using the given heuristic, continuing from
+ * the given resource state, and with the source of the part's DDG in the
+ * given cycle. The DDG must already have been built, and must be in forward
+ * direction.
+ */
+template <class Heuristic>
+static void schedule_window(
+    const ir::BlockBaseRef &window,
+    utils::Opt<rmgr::State> &resource_state,
+    utils::Int start_cycle,
+    utils::UInt max_resource_block_cycles
+) {
+    utils::Ptr<com::ddg::CompactGraph> graph;
+    graph.emplace(window);
+    com::sch::Scheduler<Heuristic> scheduler(window, graph.as_const(), *resource_state, start_cycle);
+    scheduler.run(max_resource_block_cycles);
+    resource_state = scheduler.get_resource_state();
+}
+
+/**
+ * The cycle in which each object accessed by the statements scheduled thus far
+ * becomes free, i.e. the maximum over the statements accessing it of their
+ * cycle plus their duration. This summarizes the dependencies on statements
+ * outside the part of a block that is being scheduled.
+ */
+using Frontier = utils::Map<com::ddg::Reference, utils::Int>;
+
+/**
+ * Returns an event gatherer configured with the commutation options of the
+ * pass.
+ */
+static com::ddg::EventGatherer make_gatherer(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) {
+    com::ddg::EventGatherer gatherer(ir);
+    gatherer.disable_multi_qubit_commutation = !context.options["commute_multi_qubit"].as_bool();
+    gatherer.disable_single_qubit_commutation = !context.options["commute_single_qubit"].as_bool();
+    return gatherer;
+}
+
+/**
+ * Resets the given event gatherer and gathers the events of the given
+ * statement. Statements without any events are upgraded to barriers, like the
+ * DDG builder does.
+ */
+static void gather_events(
+    com::ddg::EventGatherer &gatherer,
+    const ir::StatementRef &statement
+) {
+    gatherer.reset();
+    gatherer.add_statement(statement);
+    if (gatherer.get().empty()) {
+        gatherer.add_reference(ir::prim::OperandMode::BARRIER, {});
+    }
+}
+
+/**
+ * Schedules the statements of the given temporary block, which must not have
+ * been scheduled yet, continuing from the given resource state. The
+ * dependencies on the statements that were scheduled before are taken from
+ * the given frontier, which is not updated. This builds the DDG for the
+ * block, and clears it again when done.
+ */
+static void schedule_part(
+    const ir::Ref &ir,
+    const ir::SubBlockRef &part,
+    const Frontier &frontier,
+    utils::Opt<rmgr::State> &resource_state,
+    const pmgr::pass_types::Context &context
+) {
+    auto heuristic = context.options["scheduler_heuristic"].as_str();
+    auto max_resource_block_cycles = context.options["max_resource_block_cycles"].as_uint();
+    com::ddg::build(
+        ir,
+        part,
+        context.options["commute_multi_qubit"].as_bool(),
+        context.options["commute_single_qubit"].as_bool(),
+        context.options["transitive_reduction"].as_bool()
+    );
+
+    // Determine the earliest cycle for each statement in the part based on
+    // the frontier, and start the part at the minimum thereof.
+    auto gatherer = make_gatherer(ir, context);
+    utils::Vec<utils::Int> earliest;
+    earliest.reserve(part->statements.size());
+    utils::Int start_cycle = utils::MAX;
+    for (const auto &statement : part->statements) {
+        gather_events(gatherer, statement);
+        utils::Int cycle = 0;
+        for (const auto &event : gatherer.get()) {
+            for (const auto &free : frontier) {
+                if (!event.first.is_provably_distinct_from(free.first)) {
+                    cycle = utils::max(cycle, free.second);
+                }
+            }
+        }
+        earliest.push_back(cycle);
+        start_cycle = utils::min(start_cycle, cycle);
+    }
+    for (utils::UInt i = 0; i < earliest.size(); i++) {
+        if (earliest[i] > start_cycle) {
+            com::ddg::constrain_start(part, part->statements[i], earliest[i] - start_cycle);
+        }
+    }
+
+    // Pre-schedule in the reverse direction for critical-path-length-based
+    // heuristics, and then schedule the part.
+    if (
+        heuristic == "critical_path" ||
+        heuristic == "deep_criticality"
+    ) {
+        utils::Ptr<com::ddg::CompactGraph> reversed;
+        reversed.emplace(part, -1);
+        com::sch::add_feedback_latency(ir, *reversed, context.options["feedback_latency"].as_uint());
+        com::sch::Scheduler<>(part, reversed.as_const()).run();
+    }
+    if (heuristic == "none") {
+        schedule_window<com::sch::TrivialHeuristic>(part, resource_state, start_cycle, max_resource_block_cycles);
+    } else if (heuristic == "critical_path") {
+        schedule_window<com::sch::CriticalPathHeuristic>(part, resource_state, start_cycle, max_resource_block_cycles);
+    } else if (heuristic == "deep_criticality") {
+        com::sch::DeepCriticality::compute(part);
+        schedule_window<com::sch::DeepCriticality::Heuristic>(part, resource_state, start_cycle, max_resource_block_cycles);
+        com::sch::DeepCriticality::clear(part);
+    } else {
+        QL_ICE("unknown heuristic " << heuristic);
+    }
+    com::ddg::clear(part);
+
+}
+
+/**
+ * Commits the given scheduled statements by updating the frontier.
+ */
+static void update_frontier(
+    com::ddg::EventGatherer &gatherer,
+    const ir::StatementRef &statement,
+    Frontier &frontier
+) {
+    gather_events(gatherer, statement);
+    auto free = statement->cycle + (utils::Int)ir::get_duration_of_statement(statement);
+    for (const auto &event : gatherer.get()) {
+        auto it = frontier.find(event.first);
+        if (it == frontier.end()) {
+            frontier.set(event.first) = free;
+        } else {
+            it->second = utils::max(it->second, free);
+        }
+    }
+}
+
+/**
+ * Builds the initial resource state for scheduling a block in parts. This is
+ * carried over from part to part.
+ */
+static utils::Opt<rmgr::State> build_part_resource_state(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    utils::Opt<rmgr::State> resource_state;
+    if (context.options["resource_constraints"].as_bool()) {
+        resource_state = ir->platform->resources->build(rmgr::Direction::FORWARD);
+    } else {
+        resource_state = rmgr::Manager({}).build(rmgr::Direction::UNDEFINED);
+    }
+    if (write_outputs && context.options["write_resource_statistics"].as_bool()) {
+        resource_state->enable_statistics();
+    }
+    return resource_state;
+}
+
+/**
+ * Puts the given statements back into the given block after scheduling it in
+ * parts, sorted by cycle.
+ */
+static void put_back_statements(
+    const ir::BlockBaseRef &block,
+    utils::Vec<ir::StatementRef> &statements
+) {
+    std::stable_sort(
+        statements.begin(),
+        statements.end(),
+        [](const ir::StatementRef &lhs, const ir::StatementRef &rhs) {
+            return lhs->cycle < rhs->cycle;
+        }
+    );
+    block->statements.reset();
+    for (const auto &statement : statements) {
+        block->statements.add(statement);
+    }
+}
+
+/**
+ * Runs the scheduler on the given block in consecutive windows of the given
+ * number of statements, for ASAP scheduling of very long blocks. This does
+ * not recurse into sub-blocks.
+ */
+void ListSchedulePass::run_windowed_on_block(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    const utils::Str &name,
+    utils::UInt window_size,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    QL_DOUT("scheduling " << name << " in windows of " << window_size << " statements...");
+    auto resource_state = build_part_resource_state(ir, context, write_outputs);
+    Frontier frontier;
+
+    // Take the statements out of the block; they are put back once all
+    // windows have been scheduled.
+    utils::Vec<ir::StatementRef> statements;
+    statements.reserve(block->statements.size());
+    for (const auto &statement : block->statements) {
+        statements.push_back(statement);
+    }
+    auto gatherer = make_gatherer(ir, context);
+
+    for (utils::UInt window_start = 0; window_start < statements.size(); window_start += window_size) {
+        auto window_end = utils::min(window_start + window_size, statements.size());
+
+        // Make a temporary block for the window and schedule it.
+        auto window = utils::make<ir::SubBlock>();
+        for (auto i = window_start; i < window_end; i++) {
+            window->statements.add(statements[i]);
+        }
+        schedule_part(ir, window, frontier, resource_state, context);
+
+        // Commit the window by updating the frontier.
+        for (const auto &statement : window->statements) {
+            update_frontier(gatherer, statement, frontier);
+        }
+        QL_DOUT("scheduled statements " << window_start << " to " << window_end << " of " << name);
+
+    }
+
+    put_back_statements(block, statements);
+    QL_DOUT("scheduling complete for " << name);
+    if (write_outputs) {
+        write_resource_statistics(*resource_state, name, context);
+    }
+
+    // Attach the KernelCyclesValid annotation to set the cycles_valid flag of
+    // the corresponding kernel when new-to-old conversion is applied.
+    block->set_annotation<ir::KernelCyclesValid>({true});
+
+}
+
+/**
+ * Returns the core that all objects accessed by the statement whose events
+ * are in the given gatherer belong to, or utils::MAX if it accesses the
+ * qubits of multiple cores, or anything other than qubits and their implicit
+ * bits.
+ */
+static utils::UInt get_core(
+    const ir::Ref &ir,
+    const com::ddg::EventGatherer &gatherer
+) {
+    const auto &topology = *ir->platform->topology;
+    auto num_qubits = ir::get_num_qubits(ir);
+    auto qubits = ir->platform->qubits.get_ptr().get();
+    auto qubit_type = qubits->data_type.get_ptr().get();
+    const ir::DataType *implicit_bit_type = nullptr;
+    if (!ir->platform->implicit_bit_type.empty()) {
+        implicit_bit_type = ir->platform->implicit_bit_type.get_ptr().get();
+    }
+    utils::UInt core = utils::MAX;
+    for (const auto &event : gatherer.get()) {
+        const auto &reference = event.first;
+        if (
+            reference.is_global_state() ||
+            reference.target.get_ptr().get() != qubits ||
+            reference.indices.size() != 1 ||
+            reference.indices[0] >= num_qubits
+        ) {
+            return utils::MAX;
+        }
+        auto data_type = reference.data_type.get_ptr().get();
+        if (data_type != qubit_type && data_type != implicit_bit_type) {
+            return utils::MAX;
+        }
+        auto qubit_core = topology.get_core_index(reference.indices[0]);
+        if (core == utils::MAX) {
+            core = qubit_core;
+        } else if (core != qubit_core) {
+            return utils::MAX;
+        }
+    }
+    return core;
+}
+
+/**
+ * Runs the scheduler on the given block for ASAP scheduling on a multi-core
+ * platform, scheduling the statements local to each core concurrently. This
+ * does not recurse into sub-blocks.
+ *
+ * Statements that only access the qubits of a single core (and their implicit
+ * bits) are local to that core; all other statements, such as inter-core
+ * gates and classical logic, are synchronization points. The statements are
+ * divided into rounds, such that the local statements of a round only depend
+ * on local statements of the same core in the same or earlier rounds and on
+ * synchronization points of earlier rounds, and the synchronization points of
+ * a round only depend on statements of the same or earlier rounds. Local
+ * statements of different cores never depend on each other directly.
+ *
+ * Each round, the local statements of each core are scheduled concurrently,
+ * each core starting from the resource state at the end of the previous
+ * round. The resulting schedules are then merged by replaying them in cycle
+ * order onto that resource state. If that fails, because a resource is shared
+ * between cores, the local statements of the round are rescheduled together.
+ * Finally, the synchronization points of the round are scheduled, after which
+ * the next round starts. Like windowed scheduling, this costs some schedule
+ * quality, because statements can't move past the rounds they are in.
+ */
+void ListSchedulePass::run_core_partitioned_on_block(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+    auto num_cores = ir->platform->topology->get_num_cores();
+    QL_DOUT("scheduling " << name << " partitioned over " << num_cores << " cores...");
+    auto resource_state = build_part_resource_state(ir, context, write_outputs);
+    Frontier frontier;
+
+    // Take the statements out of the block; they are put back once all
+    // rounds have been scheduled.
+    utils::Vec<ir::StatementRef> statements;
+    statements.reserve(block->statements.size());
+    for (const auto &statement : block->statements) {
+        statements.push_back(statement);
+    }
+    auto gatherer = make_gatherer(ir, context);
+
+    // Divide the statements into rounds and cores, using index num_cores for
+    // the synchronization points. To determine the rounds, we track for each
+    // object the lowest round that a statement accessing it after the
+    // statements seen thus far may be in. Commuting accesses are treated as
+    // dependencies here, which is conservative.
+    auto num_parts_per_round = num_cores + 1;
+    utils::Vec<utils::Vec<utils::UInt>> parts;
+    utils::Map<com::ddg::Reference, utils::UInt> next_round;
+    for (utils::UInt index = 0; index < statements.size(); index++) {
+        gather_events(gatherer, statements[index]);
+        auto core = get_core(ir, gatherer);
+        utils::UInt round = 0;
+        for (const auto &event : gatherer.get()) {
+            for (const auto &access : next_round) {
+                if (!event.first.is_provably_distinct_from(access.first)) {
+                    round = utils::max(round, access.second);
+                }
+            }
+        }
+        auto after = core == utils::MAX ? round + 1 : round;
+        for (const auto &event : gatherer.get()) {
+            auto it = next_round.find(event.first);
+            if (it == next_round.end()) {
+                next_round.set(event.first) = after;
+            } else {
+                it->second = utils::max(it->second, after);
+            }
+        }
+        if (parts.size() <= round * num_parts_per_round) {
+            parts.resize((round + 1) * num_parts_per_round);
+        }
+        parts[round * num_parts_per_round + utils::min(core, num_cores)].push_back(index);
+    }
+    auto num_rounds = parts.size() / num_parts_per_round;
+
+    // Makes a temporary block for the statements with the given indices.
+    auto make_part = [&statements](const utils::Vec<utils::UInt> &indices) {
+        auto part = utils::make<ir::SubBlock>();
+        for (auto index : indices) {
+            part->statements.add(statements[index]);
+        }
+        return part;
+    };
+
+    for (utils::UInt round = 0; round < num_rounds; round++) {
+        auto *round_parts = &parts[round * num_parts_per_round];
+
+        // Schedule the local statements of each core concurrently. The
+        // statements of different cores access different objects, so the
+        // frontier can be shared.
+        utils::Vec<utils::Opt<rmgr::State>> core_states(num_cores);
+        utils::parallel_for(
+            num_cores,
+            context.options["block_threads"].as_uint(),
+            [&](utils::UInt core) {
+                if (round_parts[core].empty()) {
+                    return;
+                }
+                core_states[core] = resource_state;
+                schedule_part(ir, make_part(round_parts[core]), frontier, core_states[core], context);
+            }
+        );
+
+        // Merge the schedules of the cores.
+        utils::Vec<utils::UInt> local;
+        utils::UInt num_active_cores = 0;
+        utils::UInt active_core = 0;
+        for (utils::UInt core = 0; core < num_cores; core++) {
+            if (!round_parts[core].empty()) {
+                local.insert(local.end(), round_parts[core].begin(), round_parts[core].end());
+                num_active_cores++;
+                active_core = core;
+            }
+        }
+        if (num_active_cores == 1) {
+            resource_state = core_states[active_core];
+        } else if (num_active_cores > 1) {
+            std::sort(local.begin(), local.end());
+            utils::Vec<utils::UInt> by_cycle = local;
+            std::stable_sort(
+                by_cycle.begin(),
+                by_cycle.end(),
+                [&statements](utils::UInt lhs, utils::UInt rhs) {
+                    return statements[lhs]->cycle < statements[rhs]->cycle;
+                }
+            );
+            auto merged = resource_state;
+            utils::Bool conflict = false;
+            for (auto index : by_cycle) {
+                const auto &statement = statements[index];
+                if (!merged->available(statement->cycle, statement)) {
+                    conflict = true;
+                    break;
+                }
+                merged->reserve(statement->cycle, statement);
+            }
+            if (!conflict) {
+                resource_state = merged;
+            } else {
+                QL_DOUT("resource conflict between cores in round " << round << " of " << name << "; rescheduling the round as a whole");
+                schedule_part(ir, make_part(local), frontier, resource_state, context);
+            }
+        }
+        for (auto index : local) {
+            update_frontier(gatherer, statements[index], frontier);
+        }
+
+        // Schedule the synchronization points.
+        const auto &sync = round_parts[num_cores];
+        if (!sync.empty()) {
+            schedule_part(ir, make_part(sync), frontier, resource_state, context);
+            for (auto index : sync) {
+                update_frontier(gatherer, statements[index], frontier);
+            }
+        }
+
+    }
+    QL_DOUT("scheduled " << name << " in " << num_rounds << " round(s)");
+
+    put_back_statements(block, statements);
+    QL_DOUT("scheduling complete for " << name);
+    if (write_outputs) {
+        write_resource_statistics(*resource_state, name, context);
+    }
+
+    // Attach the KernelCyclesValid annotation to set the cycles_valid flag of
+    // the corresponding kernel when new-to-old conversion is applied.
+    block->set_annotation<ir::KernelCyclesValid>({true});
+
+}
+
+/**
+ * Runs the scheduler on the given block. This does not recurse into
+ * sub-blocks.
+ */
+void ListSchedulePass::run_on_block(
+    const ir::Ref &ir,
+    const ir::BlockBaseRef &block,
+    const utils::Str &name,
+    const pmgr::pass_types::Context &context,
+    utils::Bool write_outputs
+) {
+
+    // Without resource constraints, the schedule only depends on the data
+    // dependencies, so unless we need the DDG for the outputs, we can skip
+    // building it entirely.
+    if (
+        !context.options["resource_constraints"].as_bool() &&
+        !QL_IS_LOG_DEBUG && !(write_outputs && (
+            context.options["write_dot_graphs"].as_bool() ||
+            context.options["write_resource_statistics"].as_bool()
+        ))
+    ) {
+        QL_DOUT("scheduling " << name << " without DDG...");
+        if (com::sch::schedule_without_resources(
+            ir,
+            block,
+            context.options["scheduler_target"].as_str() == "alap" ? -1 : 1,
+            context.options["commute_multi_qubit"].as_bool(),
+            context.options["commute_single_qubit"].as_bool()
+        )) {
+            QL_DOUT("scheduling complete for " << name);
+            block->set_annotation<ir::KernelCyclesValid>({true});
+            return;
+        }
+        QL_DOUT("falling back to DDG-based scheduling for " << name);
+    }
+
+    // Schedule by core for multi-core platforms if requested.
+    if (
+        context.options["core_partitioned"].as_bool() &&
+        ir->platform->topology.is_populated() &&
+        ir->platform->topology->get_num_cores() > 1
+    ) {
+        if (context.options["scheduler_target"].as_str() == "asap") {
+            run_core_partitioned_on_block(ir, block, name, context, write_outputs);
+            return;
+        }
+        QL_WOUT("core_partitioned is only supported for ASAP scheduling; scheduling " << name << " as a whole");
+    }
+
+    // Use windowed scheduling for long blocks if requested.
+    auto window_size = context.options["window_size"].as_uint();
+    if (window_size && block->statements.size() > window_size) {
+        if (context.options["scheduler_target"].as_str() == "asap") {
+            run_windowed_on_block(ir, block, name, window_size, context, write_outputs);
+            return;
+        }
+        QL_WOUT("window_size is only supported for ASAP scheduling; scheduling " << name << " as a whole");
+    }
 
     // Build a data dependency graph for the block.
     com::ddg::build(
         ir,
         block,
         context.options["commute_multi_qubit"].as_bool(),
-        context.options["commute_single_qubit"].as_bool()
+        context.options["commute_single_qubit"].as_bool(),
+        context.options["transitive_reduction"].as_bool()
     );
 
-    // Reverse the DDG if backward/ALAP scheduling is desired.
-    auto reversed = context.options["scheduler_target"].as_str() == "alap";
-    if (reversed) {
-        com::ddg::reverse(block);
-    }
+    // Build the compact form of the DDG once, to be shared by the heuristic
+    // and the scheduler. For backward/ALAP scheduling, the compact graph is
+    // built in reverse direction; the DDG annotations themselves always stay
+    // in forward direction.
+    utils::Int direction = context.options["scheduler_target"].as_str() == "alap" ? -1 : 1;
+    utils::Ptr<com::ddg::CompactGraph> graph;
+    graph.emplace(block, direction);
 
     // Pre-schedule in the reverse direction for critical-path-length-based
     // heuristics.
@@ -156,18 +953,15 @@ void ListSchedulePass::run_on_block(
     ) {
 
         // Criticality for ASAP list scheduling is computed via ALAP
-        // pre-scheduling and vice-versa. So we need to reverse the direction of
-        // the DDG to reverse the scheduling direction prior to prescheduling.
-        com::ddg::reverse(block);
-
-        // Perform prescheduling.
+        // pre-scheduling and vice-versa, so this uses a compact graph in the
+        // opposite direction.
         QL_DOUT("prescheduling to determine criticality for " << name << "...");
-        com::sch::Scheduler<>(block).run();
+        utils::Ptr<com::ddg::CompactGraph> prescheduling_graph;
+        prescheduling_graph.emplace(graph->reversed());
+        com::sch::add_feedback_latency(ir, *prescheduling_graph, context.options["feedback_latency"].as_uint());
+        com::sch::Scheduler<>(block, prescheduling_graph.as_const()).run();
         QL_DOUT("prescheduling complete for " << name);
 
-        // Reverse the DDG again so we don't clobber its direction.
-        com::ddg::reverse(block);
-
     }
 
     // Perform the actual scheduling operation.
@@ -177,38 +971,25 @@ void ListSchedulePass::run_on_block(
         manager = *ir->platform->resources;
     }
     if (heuristic == "none") {
-        com::sch::Scheduler<com::sch::TrivialHeuristic> scheduler(block, manager);
-        scheduler.run(context.options["max_resource_block_cycles"].as_int());
-        scheduler.convert_cycles();
+        schedule_block<com::sch::TrivialHeuristic>(block, graph.as_const(), manager, name, context, write_outputs);
     } else if (heuristic == "critical_path") {
-        com::sch::Scheduler<com::sch::CriticalPathHeuristic> scheduler(block, manager);
-        scheduler.run(context.options["max_resource_block_cycles"].as_int());
-        scheduler.convert_cycles();
+        schedule_block<com::sch::CriticalPathHeuristic>(block, graph.as_const(), manager, name, context, write_outputs);
     } else if (heuristic == "deep_criticality") {
         QL_DOUT("computing deep criticality:");
-        com::sch::DeepCriticality::compute(block);
+        com::sch::DeepCriticality::compute(block, *graph);
         for (const auto &statement : block->statements) {
             QL_DOUT(
                 "  n" << utils::abs(com::ddg::get_node(statement)->order) <<
                 " -> " << com::sch::DeepCriticality::get(statement)
             );
         }
-        com::sch::Scheduler<com::sch::DeepCriticality::Heuristic> scheduler(block, manager);
-        scheduler.run(context.options["max_resource_block_cycles"].as_int());
-        scheduler.convert_cycles();
+        schedule_block<com::sch::DeepCriticality::Heuristic>(block, graph.as_const(), manager, name, context, write_outputs);
         com::sch::DeepCriticality::clear(block);
     } else {
         QL_ICE("unknown heuristic " << heuristic);
     }
     QL_DOUT("scheduling complete for " << name);
 
-    // Reverse the DDG back to forward direction if needed, since that makes
-    // it much more readable.
-    if (reversed && (QL_IS_LOG_DEBUG || context.options["write_dot_graphs"].as_bool())) {
-        com::ddg::reverse(block);
-        reversed = false;
-    }
-
     // Always dump dot for the schedule if we're debugging.
     if (QL_IS_LOG_DEBUG) {
         QL_COUT("dumping dot file...");
@@ -216,10 +997,10 @@ void ListSchedulePass::run_on_block(
     }
 
     // Write the schedule as a dot file if requested.
-    if (context.options["write_dot_graphs"].as_bool()) {
+    if (write_outputs && context.options["write_dot_graphs"].as_bool()) {
         auto filename = context.output_prefix + "_" + name + ".dot";
         QL_DOUT("writing dot output to " << filename);
-        com::ddg::dump_dot(block, utils::OutFile(filename).unwrap());
+        com::ddg::dump_dot(block, utils::AsyncOutFile(filename).unwrap());
     }
 
     // Clean up the DDG.
@@ -229,18 +1010,149 @@ void ListSchedulePass::run_on_block(
     // the corresponding kernel when new-to-old conversion is applied.
     block->set_annotation<ir::KernelCyclesValid>({true});
 
-    // Recurse into structured control-flow sub-blocks.
-    for (const auto &statement : block->statements) {
-        if (auto if_else = statement->as_if_else()) {
-            for (const auto &branch : if_else->branches) {
-                run_on_block(ir, branch->body, name + "_if", used_names, context);
-            }
-            if (!if_else->otherwise.empty()) {
-                run_on_block(ir, if_else->otherwise, name + "_else", used_names, context);
+}
+
+/**
+ * Tries to overlap the tail of the given block with the head of its successor,
+ * both of which must already have been scheduled, by scheduling their
+ * statements together and moving the statements of the successor that end up
+ * starting before the block is done into the block. The blocks are left
+ * unchanged if this does not reduce their combined duration.
+ */
+void ListSchedulePass::overlap_blocks(
+    const ir::Ref &ir,
+    const ir::BlockRef &block,
+    const ir::BlockRef &successor,
+    const pmgr::pass_types::Context &context
+) {
+    auto independent_duration = (utils::Int)(
+        ir::get_duration_of_block(block) + ir::get_duration_of_block(successor)
+    );
+
+    // Schedule the statements of both blocks together in a temporary block,
+    // remembering the independent schedule in case we need to revert.
+    utils::Vec<ir::StatementRef> statements;
+    utils::Vec<utils::Int> cycles;
+    auto joint = utils::make<ir::SubBlock>();
+    for (const auto &b : {block, successor}) {
+        for (const auto &statement : b->statements) {
+            statements.push_back(statement);
+            cycles.push_back(statement->cycle);
+            joint->statements.add(statement);
+        }
+    }
+    auto num_in_block = block->statements.size();
+    run_on_block(ir, joint, block->name + "_" + successor->name, context, false);
+
+    // The statements of the successor that start before all statements of the
+    // first block have completed move to the first block, which then lasts
+    // until those have completed as well. The remaining statements are moved
+    // earlier uniformly, by at most the duration of the first block, such that
+    // their relative timing and the timing with respect to the moved
+    // statements is preserved.
+    utils::Int split = 0;
+    for (utils::UInt i = 0; i < num_in_block; i++) {
+        split = utils::max(split, statements[i]->cycle + (utils::Int)ir::get_duration_of_statement(statements[i]));
+    }
+    utils::Vec<ir::StatementRef> moved;
+    utils::Vec<ir::StatementRef> remaining;
+    utils::Int block_duration = split;
+    utils::Int shift = utils::MAX;
+    utils::Bool valid = true;
+    for (utils::UInt i = num_in_block; i < statements.size(); i++) {
+        const auto &statement = statements[i];
+        if (statement->cycle < split) {
+            if (statement->as_goto_instruction()) {
+                valid = false;
             }
-        } else if (auto loop = statement->as_loop()) {
-            run_on_block(ir, loop->body, name + "_loop", used_names, context);
+            moved.push_back(statement);
+            block_duration = utils::max(block_duration, statement->cycle + (utils::Int)ir::get_duration_of_statement(statement));
+        } else {
+            remaining.push_back(statement);
+            shift = utils::min(shift, statement->cycle);
+        }
+    }
+    shift = utils::min(shift, block_duration);
+    utils::Int successor_duration = 0;
+    for (const auto &statement : remaining) {
+        successor_duration = utils::max(successor_duration, statement->cycle + (utils::Int)ir::get_duration_of_statement(statement) - shift);
+    }
+
+    // Revert if this doesn't help.
+    if (!valid || moved.empty() || block_duration + successor_duration >= independent_duration) {
+        for (utils::UInt i = 0; i < statements.size(); i++) {
+            statements[i]->cycle = cycles[i];
+        }
+        return;
+    }
+    QL_DOUT(
+        "moved " << moved.size() << " statement(s) of " << successor->name <<
+        " into " << block->name << ", saving " <<
+        independent_duration - block_duration - successor_duration << " cycle(s)"
+    );
+
+    // Rebuild the blocks, sorted by cycle.
+    auto by_cycle = [](const ir::StatementRef &lhs, const ir::StatementRef &rhs) {
+        return lhs->cycle < rhs->cycle;
+    };
+    utils::Vec<ir::StatementRef> block_statements;
+    for (utils::UInt i = 0; i < num_in_block; i++) {
+        block_statements.push_back(statements[i]);
+    }
+    block_statements.insert(block_statements.end(), moved.begin(), moved.end());
+    std::stable_sort(block_statements.begin(), block_statements.end(), by_cycle);
+    std::stable_sort(remaining.begin(), remaining.end(), by_cycle);
+    block->statements.reset();
+    for (const auto &statement : block_statements) {
+        block->statements.add(statement);
+    }
+    successor->statements.reset();
+    for (const auto &statement : remaining) {
+        statement->cycle -= shift;
+        successor->statements.add(statement);
+    }
+
+}
+
+/**
+ * Overlaps every program block with its successor for cross-block scheduling,
+ * where the control flow permits this: the block must unconditionally continue
+ * with the successor, and the successor must not be reachable in any other
+ * way.
+ */
+void ListSchedulePass::run_cross_block(
+    const ir::Ref &ir,
+    const pmgr::pass_types::Context &context
+) {
+    const auto &program = ir->program;
+    if (!com::dec::is_in_basic_block_form(program)) {
+        QL_WOUT("cross_block requires the program to be in basic block form; scheduling blocks independently");
+        return;
+    }
+
+    // Find the pairs of blocks that can be overlapped using the control-flow
+    // graph, and then overlap them in program order. Overlapping only moves
+    // statements between the blocks of a pair, so it doesn't change the
+    // graph.
+    com::cfg::build(program);
+    utils::List<std::pair<ir::BlockRef, ir::BlockRef>> pairs;
+    for (const auto &block : program->blocks) {
+        if (
+            block->next.empty() ||
+            block->next.links_to(block) ||
+            (!block->statements.empty() && block->statements.back()->as_goto_instruction())
+        ) {
+            continue;
         }
+        auto successor = block->next.as_mut();
+        if (com::cfg::get_node(successor)->predecessors.size() != 1) {
+            continue;
+        }
+        pairs.emplace_back(block, successor);
+    }
+    com::cfg::clear(program);
+    for (const auto &pair : pairs) {
+        overlap_blocks(ir, pair.first, pair.second, context);
     }
 
 }
@@ -252,12 +1164,41 @@ utils::Int ListSchedulePass::run(
     const ir::Ref &ir,
     const pmgr::pass_types::Context &context
 ) const {
+    if (ir->program.empty()) {
+        return 0;
+    }
+
+    // Gather the blocks to schedule and give them unique names. The blocks of
+    // the program are independent as far as DDG construction and scheduling
+    // are concerned, so each program block is scheduled as a single task,
+    // along with its sub-blocks; the sub-blocks are processed sequentially
+    // after their parent, because DDG construction for the parent looks into
+    // them.
     utils::Set<utils::Str> used_names;
-    if (!ir->program.empty()) {
-        for (const auto &block : ir->program->blocks) {
-            run_on_block(ir, block, block->name, used_names, context);
+    utils::Vec<utils::List<BlockTask>> tasks(ir->program->blocks.size());
+    for (utils::UInt i = 0; i < ir->program->blocks.size(); i++) {
+        const auto &block = ir->program->blocks[i];
+        gather_blocks(block, block->name, used_names, tasks[i]);
+    }
+
+    // Schedule the program blocks, using multiple threads if requested. The
+    // resource states are built independently for each block from the
+    // platform's resource manager, which is only read.
+    utils::parallel_for(
+        tasks.size(),
+        context.options["block_threads"].as_uint(),
+        [&](utils::UInt i) {
+            for (const auto &task : tasks[i]) {
+                run_on_block(ir, task.block, task.name, context);
+            }
         }
+    );
+
+    // Overlap consecutive blocks if requested.
+    if (context.options["cross_block"].as_bool()) {
+        run_cross_block(ir, context);
     }
+
     return 0;
 }
 
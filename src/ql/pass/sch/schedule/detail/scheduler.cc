@@ -10,7 +10,7 @@
  * bundles, a list of bundles in which gates starting in the same cycle are
  * grouped.
  *
- * The dependency graph (represented by the graph field below) is created in the
+ * The dependency graph (represented by the node and arc arrays) is created in the
  * Init method, and the graph is constructed from and referring to the gates in
  * the sequence of gates in the kernel's circuit. In this graph, the nodes refer
  * to the gates in the circuit, and the edges represent the dependencies between
@@ -86,8 +86,13 @@
 
 #include "scheduler.h"
 
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
 #include "ql/utils/vec.h"
+#include "ql/utils/intern.h"
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 
 namespace ql {
 namespace pass {
@@ -96,8 +101,8 @@ namespace schedule {
 namespace detail {
 
 using namespace utils;
-using ListDigraph = lemon::ListDigraph;
-using ListDigraphPath = lemon::Path<ListDigraph>;
+
+const Scheduler::Node Scheduler::NO_NODE;
 
 std::ostream &operator<<(std::ostream &os, DepType dt) {
     switch (dt) {
@@ -140,14 +145,27 @@ std::ostream &operator<<(std::ostream &os, OperandType ot) {
     return os;
 }
 
+// interned names of the gates that get a special event signature in the dependency graph
+static const InternedStr MEASURE_NAME{"measure"};
+static const InternedStr DISPLAY_NAME{"display"};
+static const InternedStr CNOT_NAME{"cnot"};
+static const InternedStr CZ_NAME{"cz"};
+static const InternedStr CPHASE_NAME{"cphase"};
+static const std::unordered_set<InternedStr> Z_ROTATION_NAMES{
+    InternedStr("rz"), InternedStr("z"), InternedStr("pauli_z"), InternedStr("rz180"),
+    InternedStr("z90"), InternedStr("rz90"), InternedStr("zm90"), InternedStr("mrz90"),
+    InternedStr("s"), InternedStr("sdag"), InternedStr("t"), InternedStr("tdag")
+};
+static const std::unordered_set<InternedStr> X_ROTATION_NAMES{
+    InternedStr("rx"), InternedStr("x"), InternedStr("pauli_x"), InternedStr("rx180"),
+    InternedStr("x90"), InternedStr("rx90"), InternedStr("xm90"), InternedStr("mrx90"),
+    InternedStr("x45")
+};
+
 Scheduler::Scheduler() :
-    instruction(graph),
-    name(graph),
-    order(graph),
-    weight(graph),
-    op_type(graph),
-    cause(graph),
-    dep_type(graph)
+    s(0),
+    t(0),
+    criticality_dir(rmgr::Direction::FORWARD)
 {
 }
 
@@ -159,6 +177,11 @@ void Scheduler::strip_name(Str &name) {
     }
 }
 
+// the qasm string of node n, including any condition; only used for debugging output, so built on demand
+Str Scheduler::get_node_name(Node n) const {
+    return instruction[n]->qasm();
+}
+
 // Add a dependency between two nodes: from node fromID to node toID
 // the dependence is annotated with the deptype, operandtype and operand for possible transformations and for tracing
 void Scheduler::add_dep(
@@ -169,14 +192,16 @@ void Scheduler::add_dep(
     UInt operand
 ) {
     QL_DOUT(".. adddep ... from fromID " << from_id << " to toID " << to_id << "   opnd=" << ot << "[" << operand << "], dep=" << dt);
-    auto from_node = graph.nodeFromId(from_id);
-    auto to_node = graph.nodeFromId(to_id);
-    auto arc = graph.addArc(from_node, to_node);
-    weight[arc] = Int(ceil(static_cast<Real>(instruction[from_node]->duration) / cycle_time));
-    op_type[arc] = ot;
-    cause[arc] = operand;
-    dep_type[arc] = dt;
-    QL_DOUT("... dep " << name[from_node] << " -> " << name[to_node] << " opnd=" << op_type[arc] << "[" << cause[arc] << "], dep=" << dep_type[arc] << ", wght=" << weight[arc] << ")");
+    Node from_node = from_id;
+    Node to_node = to_id;
+    Arc arc = arc_source.size();
+    arc_source.push_back(from_node);
+    arc_target.push_back(to_node);
+    weight.push_back(Int(ceil(static_cast<Real>(instruction[from_node]->duration) / cycle_time)));
+    op_type.push_back(ot);
+    cause.push_back(operand);
+    dep_type.push_back(dt);
+    QL_DOUT("... dep " << get_node_name(from_node) << " -> " << get_node_name(to_node) << " opnd=" << op_type[arc] << "[" << cause[arc] << "], dep=" << dep_type[arc] << ", wght=" << weight[arc] << ")");
 }
 
 // Signal a new event to the depgraph constructor:
@@ -350,16 +375,31 @@ void Scheduler::init(
     // operands can be a qubit, a classical register or a bit register
     // the indices in the state vectors are operand indices within the operandType space
 
+    // start from an empty dependency graph
+    instruction.clear();
+    node.clear();
+    order.clear();
+    arc_source.clear();
+    arc_target.clear();
+    weight.clear();
+    op_type.clear();
+    cause.clear();
+    dep_type.clear();
+    UInt gate_count = kernel->gates.size();
+    instruction.reserve(gate_count + 2);
+    order.reserve(gate_count + 2);
+
     // start filling the dependency graph by creating the s node, the top of the graph
     {
         // add dummy source node
-        auto srcNode = graph.addNode();
+        Node srcNode = instruction.size();
+        instruction.emplace_back();
         instruction[srcNode].emplace<ir::compat::gate_types::Source>();    // so SOURCE is defined as instruction[s], not unique in itself
         node.set(instruction[srcNode]) = srcNode;
-        name[srcNode] = instruction[srcNode]->qasm();
+        order.push_back(0);
         s = srcNode;
     }
-    Int src_id = graph.id(s);
+    Int src_id = s;
 
     // start the state machines, one for each possible operand
     last_q_event.resize(qubit_count, EventType::DEFAULT);   // start as if SOURCE gate did Default on all qubit operands
@@ -393,16 +433,15 @@ void Scheduler::init(
             QL_DOUT(".. Condition: `" << ins->cond_qasm() << "'");
         }
 
-        auto iname = ins->name; // copy!!!!
-        strip_name(iname);
+        // ins->name may contain parameters, so use the interned name stripped of those
+        auto iname = ins->get_base_name();
 
         // Add node
-        ListDigraph::Node currNode = graph.addNode();
-        int curr_id = graph.id(currNode);
-        instruction[currNode] = ins;
+        Node currNode = instruction.size();
+        int curr_id = currNode;
+        instruction.push_back(ins);
         node.set(ins) = currNode;
-        name[currNode] = ins->qasm();   // and this includes any condition!
-        order[currNode] = index++;
+        order.push_back(index++);
 
         // Add edges (arcs)
         // In quantum computing there are no real Reads and Writes on qubits because they cannot be cloned.
@@ -453,8 +492,8 @@ void Scheduler::init(
         }
 
         // each type of gate has a different 'signature' of events; switch out to each one
-        if (iname == "measure") {
-            QL_DOUT(". considering " << name[currNode] << " as measure");
+        if (iname == MEASURE_NAME) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as measure");
             // Default each qubit operand + Cwrite each classical operand + Bwrite each bit operand
             for (auto operand : ins->operands) {
                 new_event(curr_id, OperandType::QUBIT, operand, EventType::DEFAULT, false);
@@ -466,8 +505,8 @@ void Scheduler::init(
                 new_event(curr_id, OperandType::BREG, boperand, EventType::BWRITE, false);
             }
             QL_DOUT(". measure done");
-        } else if (iname == "display") {
-            QL_DOUT(". considering " << name[currNode] << " as display");
+        } else if (iname == DISPLAY_NAME) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as display");
             // no operands, display all qubits, cregs and bregs
             // FIXME: operands should have been added when creating this gate; then this special case would not be needed
             // Default on each qubit operand
@@ -489,58 +528,35 @@ void Scheduler::init(
                 new_event(curr_id, OperandType::BREG, boperand, EventType::BWRITE, false);
             }
         } else if (ins->type() == ir::compat::GateType::CLASSICAL) {
-            QL_DOUT(". considering " << name[currNode] << " as classical gate");
+            QL_DOUT(". considering " << get_node_name(currNode) << " as classical gate");
             // Cwrite each classical operand
             for (auto coperand : ins->creg_operands) {
                 new_event(curr_id, OperandType::CREG, coperand, EventType::CWRITE, false);
             }
-        } else if (iname == "cnot") {
-            QL_DOUT(". considering " << name[currNode] << " as cnot");
+        } else if (iname == CNOT_NAME) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as cnot");
             // CNOTs first operand is control and a Zrotate, second operand is target and an Xrotate
             QL_ASSERT(ins->operands.size() == 2);
             new_event(curr_id, OperandType::QUBIT, ins->operands[0], EventType::ZROTATE, commute_multi_qubit);
             new_event(curr_id, OperandType::QUBIT, ins->operands[1], EventType::XROTATE, commute_multi_qubit);
-        } else if (iname == "cz" || iname == "cphase") {
-            QL_DOUT(". considering " << name[currNode] << " as cz");
+        } else if (iname == CZ_NAME || iname == CPHASE_NAME) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as cz");
             // CZs operands are both Zrotates
             QL_ASSERT(ins->operands.size() == 2);
             new_event(curr_id, OperandType::QUBIT, ins->operands[0], EventType::ZROTATE, commute_multi_qubit);
             new_event(curr_id, OperandType::QUBIT, ins->operands[1], EventType::ZROTATE, commute_multi_qubit);
-        } else if (
-                iname == "rz"
-                || iname == "z"
-                || iname == "pauli_z"
-                || iname == "rz180"
-                || iname == "z90"
-                || iname == "rz90"
-                || iname == "zm90"
-                || iname == "mrz90"
-                || iname == "s"
-                || iname == "sdag"
-                || iname == "t"
-                || iname == "tdag"
-            ) {
-            QL_DOUT(". considering " << name[currNode] << " as Z rotation");
+        } else if (Z_ROTATION_NAMES.count(iname)) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as Z rotation");
             // Z rotations on single operand
             QL_ASSERT(ins->operands.size() == 1);
             new_event(curr_id, OperandType::QUBIT, ins->operands[0], EventType::ZROTATE, commute_single_qubit);
-        } else if (
-                iname == "rx"
-                || iname == "x"
-                || iname == "pauli_x"
-                || iname == "rx180"
-                || iname == "x90"
-                || iname == "rx90"
-                || iname == "xm90"
-                || iname == "mrx90"
-                || iname == "x45"
-            ) {
-            QL_DOUT(". considering " << name[currNode] << " as X rotation");
+        } else if (X_ROTATION_NAMES.count(iname)) {
+            QL_DOUT(". considering " << get_node_name(currNode) << " as X rotation");
             // X rotations on single operand
             QL_ASSERT(ins->operands.size() == 1);
             new_event(curr_id, OperandType::QUBIT, ins->operands[0], EventType::XROTATE, commute_single_qubit);
         } else {
-            QL_DOUT(". considering " << name[currNode] << " as no special gate (catch-all, generic rules)");
+            QL_DOUT(". considering " << get_node_name(currNode) << " as no special gate (catch-all, generic rules)");
             // Default on each qubit operand
             // Cwrite on each classical operand
             // Bwrite on each bit operand
@@ -561,11 +577,12 @@ void Scheduler::init(
     // finish filling the dependency graph by creating the t node, the bottom of the graph
     {
         // add dummy target node
-        ListDigraph::Node curr_node = graph.addNode();
-        int curr_id = graph.id(curr_node);
+        Node curr_node = instruction.size();
+        int curr_id = curr_node;
+        instruction.emplace_back();
         instruction[curr_node].emplace<ir::compat::gate_types::Sink>();    // so SINK is defined as instruction[t], not unique in itself
         node.set(instruction[curr_node]) = curr_node;
-        name[curr_node] = instruction[curr_node]->qasm();
+        order.push_back(0);
         t = curr_node;
 
         // add deps to the dummy target node to close the dependency chains
@@ -596,6 +613,9 @@ void Scheduler::init(
         }
     }
 
+    // all arcs have been added, so the adjacency arrays can be built
+    build_adjacency();
+
     // when in doubt about dependence graph, enable next line to get a dump of it in debugging output
     dprint_depgraph("init");
 
@@ -603,27 +623,76 @@ void Scheduler::init(
     // but when afterwards dependencies are added, cycles may be created,
     // and after doing so (a copy of) this test should certainly be done because
     // a cyclic dependency graph cannot be scheduled;
-    // this test here is a kind of debugging aid whether dependency creation was done well
-    if (!dag(graph)) {
-        QL_FATAL("The dependency graph is not a DAG.");
+    // this test here is a kind of debugging aid whether dependency creation was done well;
+    // since nodes are numbered in circuit order, it suffices to check that all arcs point forward
+    for (Arc arc = 0; arc < arc_source.size(); arc++) {
+        if (arc_source[arc] >= arc_target[arc]) {
+            QL_FATAL("The dependency graph is not a DAG.");
+        }
     }
     QL_DOUT("dependency graph creation Done.");
 }
 
+// build the compressed adjacency arrays from arc_source and arc_target, once all arcs have been added;
+// within the arcs of a node, the most recently added arc comes first
+void Scheduler::build_adjacency() {
+    UInt node_count = instruction.size();
+    UInt arc_count = arc_source.size();
+
+    // count the arcs of each node, and turn the counts into start indices
+    out_index.assign(node_count + 1, 0);
+    in_index.assign(node_count + 1, 0);
+    for (Arc arc = 0; arc < arc_count; arc++) {
+        out_index[arc_source[arc] + 1]++;
+        in_index[arc_target[arc] + 1]++;
+    }
+    for (Node n = 0; n < node_count; n++) {
+        out_index[n + 1] += out_index[n];
+        in_index[n + 1] += in_index[n];
+    }
+
+    // fill the ranges back to front while scanning the arcs in the order in which they were added
+    Vec<UInt> out_fill(out_index.begin() + 1, out_index.end());
+    Vec<UInt> in_fill(in_index.begin() + 1, in_index.end());
+    out_arcs.resize(arc_count);
+    in_arcs.resize(arc_count);
+    for (Arc arc = 0; arc < arc_count; arc++) {
+        out_arcs[--out_fill[arc_source[arc]]] = arc;
+        in_arcs[--in_fill[arc_target[arc]]] = arc;
+    }
+
+    node_mark.assign(node_count, false);
+}
+
+// number of nodes of the dependence graph, including SOURCE and SINK
+UInt Scheduler::get_node_count() const {
+    return instruction.size();
+}
+
+// the outgoing arcs of a node
+Scheduler::ArcRange Scheduler::get_out_arcs(Node n) const {
+    return {out_arcs.data() + out_index[n], out_arcs.data() + out_index[n + 1]};
+}
+
+// the incoming arcs of a node
+Scheduler::ArcRange Scheduler::get_in_arcs(Node n) const {
+    return {in_arcs.data() + in_index[n], in_arcs.data() + in_index[n + 1]};
+}
+
 // print depgraph for debugging with string parameter identifying where
 void Scheduler::dprint_depgraph(const Str &s) const {
     if (logger::log_level >= logger::LogLevel::LOG_DEBUG) {
         std::cout << "Depgraph " << s << std::endl;
-        for (ListDigraph::NodeIt n(graph); n != lemon::INVALID; ++n) {
-            std::cout << "Node " << graph.id(n) << " \"" << name[n] << "\" :" << std::endl;
+        for (Node n = get_node_count(); n-- > 0;) {
+            std::cout << "Node " << n << " \"" << get_node_name(n) << "\" :" << std::endl;
             std::cout << "    out:";
-            for (ListDigraph::OutArcIt arc(graph,n); arc != lemon::INVALID; ++arc) {
-                std::cout << " Arc(" << graph.id(arc) << "," << dep_type[arc] << "," << op_type[arc] << "[" << cause[arc] << "])->node(" << graph.id(graph.target(arc)) << ")";
+            for (Arc arc : get_out_arcs(n)) {
+                std::cout << " Arc(" << arc << "," << dep_type[arc] << "," << op_type[arc] << "[" << cause[arc] << "])->node(" << arc_target[arc] << ")";
             }
             std::cout << std::endl;
             std::cout << "    in:";
-            for (ListDigraph::InArcIt arc(graph,n); arc != lemon::INVALID; ++arc) {
-                std::cout << " Arc(" << graph.id(arc) << "," << dep_type[arc] << "," << op_type[arc] << "[" << cause[arc] << "])<-node(" << graph.id(graph.source(arc)) << ")";
+            for (Arc arc : get_in_arcs(n)) {
+                std::cout << " Arc(" << arc << "," << dep_type[arc] << "," << op_type[arc] << "[" << cause[arc] << "])<-node(" << arc_source[arc] << ")";
             }
             std::cout << std::endl;
         }
@@ -631,34 +700,38 @@ void Scheduler::dprint_depgraph(const Str &s) const {
     }
 }
 
+// print the dependency graph in lemon's graph format
 void Scheduler::print() const {
     QL_COUT("Printing dependency Graph ");
-    digraphWriter(graph).
-        nodeMap("name", name).
-        arcMap("optype", op_type).
-        arcMap("cause", cause).
-        arcMap("weight", weight).
-        // arcMap("depType", depType).
-        node("source", s).
-        node("target", t).
-        run();
+    std::cout << "@nodes" << std::endl;
+    std::cout << "label\tname\t" << std::endl;
+    for (Node n = get_node_count(); n-- > 0;) {
+        std::cout << n << "\t\"" << get_node_name(n) << "\"\t" << std::endl;
+    }
+    std::cout << "@arcs" << std::endl;
+    std::cout << "\t\tlabel\toptype\tcause\tweight\t" << std::endl;
+    for (Node n = get_node_count(); n-- > 0;) {
+        for (Arc arc : get_out_arcs(n)) {
+            std::cout << n << "\t" << arc_target[arc] << "\t" << arc << "\t"
+                      << op_type[arc] << "\t" << cause[arc] << "\t" << weight[arc] << "\t" << std::endl;
+        }
+    }
+    std::cout << "@attributes" << std::endl;
+    std::cout << "source " << s << std::endl;
+    std::cout << "target " << t << std::endl;
 }
 
 void Scheduler::write_dependence_matrix() const {
     QL_COUT("Printing dependency Matrix ...");
     Str datfname(output_prefix + "dependenceMatrix.dat");
-    OutFile fout(datfname);
+    AsyncOutFile fout(datfname);
 
-    UInt total_instructions = countNodes(graph);
+    UInt total_instructions = get_node_count();
     Vec<Vec<Bool> > matrix(total_instructions, Vec<Bool>(total_instructions));
 
     // now print the edges
-    for (ListDigraph::ArcIt arc(graph); arc != lemon::INVALID; ++arc) {
-        auto srcNode = graph.source(arc);
-        auto dstNode = graph.target(arc);
-        UInt srcID = graph.id( srcNode );
-        UInt dstID = graph.id( dstNode );
-        matrix[srcID][dstID] = true;
+    for (Arc arc = 0; arc < arc_source.size(); arc++) {
+        matrix[arc_source[arc]][arc_target[arc]] = true;
     }
 
     for (UInt i = 1; i < total_instructions - 1; i++) {
@@ -680,12 +753,12 @@ void Scheduler::write_dependence_matrix() const {
 // but when in between the depgraph was updated (as done in commute_variation),
 // dependences may have been inserted in the opposite circuit direction and then the recursion kicks in
 void Scheduler::set_cycle_gate(const ir::compat::GateRef &gp, rmgr::Direction dir) {
-    ListDigraph::Node curr_node = node.at(gp);
+    Node curr_node = node.at(gp);
     UInt  curr_cycle;
     if (dir == rmgr::Direction::FORWARD) {
         curr_cycle = 0;
-        for (ListDigraph::InArcIt arc(graph, curr_node); arc != lemon::INVALID; ++arc) {
-            auto nextgp = instruction[graph.source(arc)];
+        for (Arc arc : get_in_arcs(curr_node)) {
+            const auto &nextgp = instruction[arc_source[arc]];
             if (nextgp->cycle == ir::compat::MAX_CYCLE) {
                 set_cycle_gate(nextgp, dir);
             }
@@ -693,8 +766,8 @@ void Scheduler::set_cycle_gate(const ir::compat::GateRef &gp, rmgr::Direction di
         }
     } else {
         curr_cycle = ALAP_SINK_CYCLE;
-        for (ListDigraph::OutArcIt arc(graph, curr_node); arc != lemon::INVALID; ++arc) {
-            auto nextgp = instruction[graph.target(arc)];
+        for (Arc arc : get_out_arcs(curr_node)) {
+            const auto &nextgp = instruction[arc_target[arc]];
             if (nextgp->cycle == ir::compat::MAX_CYCLE) {
                 set_cycle_gate(nextgp, dir);
             }
@@ -707,8 +780,8 @@ void Scheduler::set_cycle_gate(const ir::compat::GateRef &gp, rmgr::Direction di
 
 void Scheduler::set_cycle(rmgr::Direction dir) {
     // note when iterating that graph contains SOURCE and SINK whereas the circuit doesn't
-    for (ListDigraph::NodeIt n(graph); n != lemon::INVALID; ++n) {
-        instruction[n]->cycle = ir::compat::MAX_CYCLE;       // not yet visited successfully by set_cycle_gate
+    for (const auto &gp : instruction) {
+        gp->cycle = ir::compat::MAX_CYCLE;                   // not yet visited successfully by set_cycle_gate
     }
     if (dir == rmgr::Direction::FORWARD) {
         set_cycle_gate(instruction[s], dir);
@@ -786,44 +859,42 @@ void Scheduler::schedule_alap() {
 // remaining[node] is complementary to node's cycle value,
 // so the implementation below is also a systematically modified copy of that of set_cycle_gate and set_cycle
 void Scheduler::set_remaining_gate(const ir::compat::GateRef &gp, rmgr::Direction dir) {
-    ListDigraph::Node curr_node = node.at(gp);
+    Node curr_node = node.at(gp);
     UInt curr_remain = 0;
-    QL_DOUT("... set_remaining of node " << graph.id(curr_node) << ": " << gp->qasm() << " ...");
+    QL_DOUT("... set_remaining of node " << curr_node << ": " << gp->qasm() << " ...");
     if (dir == rmgr::Direction::FORWARD) {
-        for (ListDigraph::OutArcIt arc(graph, curr_node); arc != lemon::INVALID; ++arc) {
-            auto nextNode = graph.target(arc);
-            QL_DOUT("...... target of arc " << graph.id(arc) << " to node " << graph.id(nextNode));
-            if (remaining.at(nextNode) == ir::compat::MAX_CYCLE) {
+        for (Arc arc : get_out_arcs(curr_node)) {
+            Node nextNode = arc_target[arc];
+            QL_DOUT("...... target of arc " << arc << " to node " << nextNode);
+            if (remaining[nextNode] == ir::compat::MAX_CYCLE) {
                 set_remaining_gate(instruction[nextNode], dir);
             }
-            curr_remain = max<UInt>(curr_remain, remaining.at(nextNode) + weight[arc]);
+            curr_remain = max<UInt>(curr_remain, remaining[nextNode] + weight[arc]);
         }
     } else {
-        for (ListDigraph::InArcIt arc(graph, curr_node); arc != lemon::INVALID; ++arc) {
-            auto nextNode = graph.source(arc);
-            QL_DOUT("...... source of arc " << graph.id(arc) << " from node " << graph.id(nextNode));
-            if (remaining.at(nextNode) == ir::compat::MAX_CYCLE) {
+        for (Arc arc : get_in_arcs(curr_node)) {
+            Node nextNode = arc_source[arc];
+            QL_DOUT("...... source of arc " << arc << " from node " << nextNode);
+            if (remaining[nextNode] == ir::compat::MAX_CYCLE) {
                 set_remaining_gate(instruction[nextNode], dir);
             }
-            curr_remain = max<UInt>(curr_remain, remaining.at(nextNode) + weight[arc]);
+            curr_remain = max<UInt>(curr_remain, remaining[nextNode] + weight[arc]);
         }
     }
-    remaining.set(curr_node) = curr_remain;
-    QL_DOUT("... set_remaining of node " << graph.id(curr_node) << ": " << gp->qasm() << " remaining " << curr_remain);
+    remaining[curr_node] = curr_remain;
+    QL_DOUT("... set_remaining of node " << curr_node << ": " << gp->qasm() << " remaining " << curr_remain);
 }
 
 void Scheduler::set_remaining(rmgr::Direction dir) {
     // note when iterating that graph contains SOURCE and SINK whereas the circuit doesn't;
-    // regretfully, the order of visiting the nodes while iterating over the graph, is undefined
-    // and in set_remaining (and set_cycle) the order matters (i.e. in circuit order or reversed circuit order)
-    for (ListDigraph::NodeIt n(graph); n != lemon::INVALID; ++n) {
-        remaining.set(n) = ir::compat::MAX_CYCLE;               // not yet visited successfully by set_remaining_gate
-    }
+    // in set_remaining (and set_cycle) the order of visiting the nodes matters
+    // (i.e. in circuit order or reversed circuit order)
+    remaining.assign(get_node_count(), ir::compat::MAX_CYCLE);  // not yet visited successfully by set_remaining_gate
     if (dir == rmgr::Direction::FORWARD) {
         // remaining until SINK (i.e. the SINK.cycle-ALAP value)
         set_remaining_gate(instruction[t], dir);
         for (auto gpit = kernel->gates.rbegin(); gpit != kernel->gates.rend(); gpit++) {
-            if (remaining.at(node.at(*gpit)) == ir::compat::MAX_CYCLE) {
+            if (remaining[node.at(*gpit)] == ir::compat::MAX_CYCLE) {
                 set_remaining_gate(*gpit, dir);
             }
         }
@@ -832,19 +903,22 @@ void Scheduler::set_remaining(rmgr::Direction dir) {
         // remaining until SOURCE (i.e. the ASAP value)
         set_remaining_gate(instruction[s], dir);
         for (auto gpit = kernel->gates.begin(); gpit != kernel->gates.end(); gpit++) {
-            if (remaining.at(node.at(*gpit)) == ir::compat::MAX_CYCLE) {
+            if (remaining[node.at(*gpit)] == ir::compat::MAX_CYCLE) {
                 set_remaining_gate(*gpit, dir);
             }
         }
         set_remaining_gate(instruction[t], dir);
     }
+
+    // deep-criticality follows from remaining
+    compute_criticality(dir);
 }
 
 ir::compat::GateRef Scheduler::find_mostcritical(const List<ir::compat::GateRef> &lg) {
     UInt max_remain = 0;
     ir::compat::GateRef most_critical_gate = {};
     for (const auto &gp : lg) {
-        UInt gr = remaining.at(node.at(gp));
+        UInt gr = remaining[node.at(gp)];
         if (gr > max_remain) {
             most_critical_gate = gp;
             max_remain = gr;
@@ -857,7 +931,7 @@ ir::compat::GateRef Scheduler::find_mostcritical(const List<ir::compat::GateRef>
 // Set the curr_cycle of the scheduling algorithm to start at the appropriate end as well;
 // note that the cycle attributes will be shifted down to start at 1 after backward scheduling.
 void Scheduler::init_available(
-    List<ListDigraph::Node> &avlist,
+    List<Node> &avlist,
     rmgr::Direction dir,
     UInt &curr_cycle
 ) {
@@ -876,45 +950,26 @@ void Scheduler::init_available(
 // collect the list of directly depending nodes
 // (i.e. those necessarily scheduled after the given node) without duplicates;
 // dependencies that are duplicates from the perspective of the scheduler
-// may be present in the dependency graph because the scheduler ignores dependency type and cause
+// may be present in the dependency graph because the scheduler ignores dependency type and cause;
+// duplicates are filtered out by marking the nodes that were collected in node_mark
 void Scheduler::get_depending_nodes(
-    ListDigraph::Node n,
+    Node n,
     rmgr::Direction dir,
-    List<ListDigraph::Node> &ln
+    List<Node> &ln
 ) {
-    if (dir == rmgr::Direction::FORWARD) {
-        for (ListDigraph::OutArcIt succ_arc(graph, n); succ_arc != lemon::INVALID; ++succ_arc) {
-            auto succ_node = graph.target(succ_arc);
-            // DOUT("...... succ of " << instruction[n]->qasm() << " : " << instruction[succNode]->qasm());
-            Bool found = false;             // filter out duplicates
-            for (auto anySuccNode : ln) {
-                if (succ_node == anySuccNode) {
-                    // DOUT("...... duplicate: " << instruction[succNode]->qasm());
-                    found = true;           // duplicate found
-                }
-            }
-            if (!found) {                   // found new one
-                ln.push_back(succ_node);     // new node to ln
-            }
+    ArcRange arcs = dir == rmgr::Direction::FORWARD ? get_out_arcs(n) : get_in_arcs(n);
+    const Vec<Node> &endpoints = dir == rmgr::Direction::FORWARD ? arc_target : arc_source;
+    for (Arc arc : arcs) {
+        Node dep_node = endpoints[arc];
+        if (!node_mark[dep_node]) {         // filter out duplicates
+            node_mark[dep_node] = true;
+            ln.push_back(dep_node);         // new node to ln
         }
-        // ln contains depending nodes of n without duplicates
-    } else {
-        for (ListDigraph::InArcIt pred_arc(graph, n); pred_arc != lemon::INVALID; ++pred_arc) {
-            ListDigraph::Node pred_node = graph.source(pred_arc);
-            // DOUT("...... pred of " << instruction[n]->qasm() << " : " << instruction[predNode]->qasm());
-            Bool found = false;             // filter out duplicates
-            for (auto any_pred_node : ln) {
-                if (pred_node == any_pred_node) {
-                    // DOUT("...... duplicate: " << instruction[predNode]->qasm());
-                    found = true;           // duplicate found
-                }
-            }
-            if (!found) {                   // found new one
-                ln.push_back(pred_node);     // new node to ln
-            }
-        }
-        // ln contains depending nodes of n without duplicates
     }
+    for (Node dep_node : ln) {
+        node_mark[dep_node] = false;
+    }
+    // ln contains depending nodes of n without duplicates
 }
 
 // Compute of two nodes whether the first one is less deep-critical than the second, for the given scheduling direction;
@@ -922,52 +977,110 @@ void Scheduler::get_depending_nodes(
 // deep-criticality takes into account the criticality of depending nodes (in the right direction!);
 // this function is used to order the avlist in an order from highest deep-criticality to lowest deep-criticality;
 // it is the core of the heuristics of the critical path list scheduler.
+//
+// Deep-criticality is defined recursively: when the remaining values are equal, and both nodes have depending nodes,
+// the node whose most deep-critical depending node is less deep-critical is less deep-critical,
+// and when those are equally deep-critical, the node that comes later in the original gate order is;
+// compute_criticality precomputes a rank for this order, so this is just a comparison of ranks.
 Bool Scheduler::criticality_lessthan(
-    ListDigraph::Node n1,
-    ListDigraph::Node n2,
+    Node n1,
+    Node n2,
     rmgr::Direction dir
 ) {
     if (n1 == n2) return false;             // because not <
+    if (dir != criticality_dir) {
+        compute_criticality(dir);
+    }
+    return criticality_rank[n1] < criticality_rank[n2];
+}
+
+// Compare the deep-criticality of two nodes by following the chains of most deep-critical depending nodes,
+// which is equivalent to the recursion over the sorted lists of depending nodes that defines deep-criticality:
+// the first pair of nodes along the chains that differ in remaining or in having depending nodes decides,
+// and when the chains turn out to be equally deep-critical, the original gate order of the deepest pair
+// of nodes that differs in it decides; ranked nodes are compared by their rank right away
+Int Scheduler::compare_criticality(Node n1, Node n2) const {
+    if (remaining[n1] != remaining[n2]) return remaining[n1] < remaining[n2] ? -1 : 1;
+    if (!enable_criticality) return 0;
+
+    Int result = 0;     // outcome when the remainders of the chains are equally deep-critical
+    while (n1 != n2) {
+        if (criticality_rank[n1] != UMAX && criticality_rank[n2] != UMAX) {
+            if (criticality_rank[n1] == criticality_rank[n2]) return result;
+            return criticality_rank[n1] < criticality_rank[n2] ? -1 : 1;
+        }
+        if (remaining[n1] != remaining[n2]) return remaining[n1] < remaining[n2] ? -1 : 1;
+        Node d1 = critical_dep[n1];
+        Node d2 = critical_dep[n2];
+        if (d2 == NO_NODE) return d1 == NO_NODE ? result : 1;
+        if (d1 == NO_NODE) return -1;
+        if (order[n1] != order[n2]) {
+            // fall back to original gate order for stability
+            result = order[n1] > order[n2] ? -1 : 1;
+        }
+        n1 = d1;
+        n2 = d2;
+    }
+    return result;
+}
+
+// Compute critical_dep and criticality_rank for the given scheduling direction from remaining;
+// since a node's depending nodes never have a larger remaining value than the node itself,
+// the nodes can be ranked in groups of equal remaining, in order of increasing remaining:
+// the depending nodes of a group then have been ranked already, apart from those connected through
+// dependences of zero cycles, and these are handled by processing each group in dependence order
+void Scheduler::compute_criticality(rmgr::Direction dir) {
+    UInt node_count = get_node_count();
+    criticality_dir = dir;
+    critical_dep.assign(node_count, NO_NODE);
+    criticality_rank.assign(node_count, UMAX);
+
+    // nodes ordered by remaining, and within equal remaining such that depending nodes come first
+    Vec<Node> nodes(node_count);
+    std::iota(nodes.begin(), nodes.end(), 0);
+    if (dir == rmgr::Direction::FORWARD) {
+        std::reverse(nodes.begin(), nodes.end());
+    }
+    std::stable_sort(nodes.begin(), nodes.end(), [this](Node n1, Node n2) {
+        return remaining[n1] < remaining[n2];
+    });
+
+    UInt rank = 0;
+    List<Node> ln;
+    for (UInt group_begin = 0; group_begin < node_count;) {
+        UInt group_end = group_begin + 1;
+        while (group_end < node_count && remaining[nodes[group_end]] == remaining[nodes[group_begin]]) {
+            group_end++;
+        }
+
+        // find the most deep-critical depending node of each node in the group;
+        // of equally deep-critical ones the last one is taken, as the original sort of the list did
+        for (UInt i = group_begin; i < group_end; i++) {
+            Node n = nodes[i];
+            ln.clear();
+            get_depending_nodes(n, dir, ln);
+            Node best = NO_NODE;
+            for (Node dep_node : ln) {
+                if (best == NO_NODE || compare_criticality(dep_node, best) >= 0) {
+                    best = dep_node;
+                }
+            }
+            critical_dep[n] = best;
+        }
 
-    if (remaining.at(n1) < remaining.at(n2)) return true;
-    if (!enable_criticality) return false;
-    if (remaining.at(n1) > remaining.at(n2)) return false;
-    // so: remaining[n1] == remaining[n2]
-
-    List<ListDigraph::Node> ln1;
-    List<ListDigraph::Node> ln2;
-
-    get_depending_nodes(n1, dir, ln1);
-    get_depending_nodes(n2, dir, ln2);
-    if (ln2.empty()) return false;          // strictly < only when ln1.empty and ln2.not_empty
-    if (ln1.empty()) return true;           // so when both empty, it is equal, so not strictly <, so false
-    // so: ln1.non_empty && ln2.non_empty
-/*
-    ln1.sort([this](const ListDigraph::Node &d1, const ListDigraph::Node &d2) { return remaining.at(d1) < remaining.at(d2); });
-    ln2.sort([this](const ListDigraph::Node &d1, const ListDigraph::Node &d2) { return remaining.at(d1) < remaining.at(d2); });
-
-    UInt crit_dep_n1 = remaining.at(ln1.back());    // the last of the list is the one with the largest remaining value
-    UInt crit_dep_n2 = remaining.at(ln2.back());
-
-    if (crit_dep_n1 < crit_dep_n2) return true;
-    if (crit_dep_n1 > crit_dep_n2) return false;
-    // so: crit_dep_n1 == crit_dep_n2, call this crit_dep
-
-    ln1.remove_if([this,crit_dep_n1](ListDigraph::Node n) { return remaining.at(n) < crit_dep_n1; });
-    ln2.remove_if([this,crit_dep_n2](ListDigraph::Node n) { return remaining.at(n) < crit_dep_n2; });
-    // because both contain element with remaining == crit_dep: ln1.non_empty && ln2.non_empty
-
-    if (ln1.size() < ln2.size()) return true;
-    if (ln1.size() > ln2.size()) return false;
-    // so: ln1.size() == ln2.size() >= 1
-*/
-    ln1.sort([this,dir](const ListDigraph::Node &d1, const ListDigraph::Node &d2) { return criticality_lessthan(d1, d2, dir); });
-    ln2.sort([this,dir](const ListDigraph::Node &d1, const ListDigraph::Node &d2) { return criticality_lessthan(d1, d2, dir); });
-    if (criticality_lessthan(ln1.back(), ln2.back(), dir)) return true;
-    if (criticality_lessthan(ln2.back(), ln1.back(), dir)) return false;
-
-    // fall back to original gate order for stability
-    return order[n1] > order[n2];
+        // rank the group; equally deep-critical nodes get the same rank
+        std::sort(nodes.begin() + group_begin, nodes.begin() + group_end, [this](Node n1, Node n2) {
+            return compare_criticality(n1, n2) < 0;
+        });
+        for (UInt i = group_begin; i < group_end; i++) {
+            if (i > group_begin && compare_criticality(nodes[i - 1], nodes[i]) != 0) {
+                rank++;
+            }
+            criticality_rank[nodes[i]] = rank;
+        }
+        rank++;
+        group_begin = group_end;
+    }
 }
 
 // Make node n available
@@ -978,20 +1091,20 @@ Bool Scheduler::criticality_lessthan(
 // avlist is initialized with s or t as first element by init_available
 // avlist is kept ordered on deep-criticality, non-increasing (i.e. highest deep-criticality first)
 void Scheduler::make_available(
-    ListDigraph::Node n,
-    utils::List<lemon::ListDigraph::Node> &avlist,
+    Node n,
+    utils::List<Node> &avlist,
     rmgr::Direction dir
 ) {
     Bool already_in_avlist = false;  // check whether n is already in avlist
     // originates from having multiple arcs between pair of nodes
-    List<ListDigraph::Node>::iterator first_lower_criticality_inp; // for keeping avlist ordered
+    List<Node>::iterator first_lower_criticality_inp; // for keeping avlist ordered
     Bool first_lower_criticality_found = false;                          // for keeping avlist ordered
 
-    QL_DOUT(".... making available node " << name[n] << " remaining: " << remaining.dbg(n));
+    QL_DOUT(".... making available node " << get_node_name(n) << " remaining: " << remaining[n]);
     for (auto inp = avlist.begin(); inp != avlist.end(); inp++) {
         if (*inp == n) {
             already_in_avlist = true;
-            QL_DOUT("...... duplicate when making available: " << name[n]);
+            QL_DOUT("...... duplicate when making available: " << get_node_name(n));
         } else {
             // scanning avlist from front to back (avlist is ordered from high to low criticality)
             // when encountering first node *inp with less criticality,
@@ -1017,12 +1130,12 @@ void Scheduler::make_available(
             // add n to end of avlist, if none found with less criticality
             avlist.push_back(n);
         }
-        QL_DOUT("...... made available node(@" << instruction[n]->cycle << "): " << name[n] << " remaining: " << remaining.dbg(n));
+        QL_DOUT("...... made available node(@" << instruction[n]->cycle << "): " << get_node_name(n) << " remaining: " << remaining[n]);
     }
 }
 
 // take node n out of avlist because it has been scheduled;
-// reflect that the node has been scheduled in the scheduled vector;
+// reflect that the node has been scheduled in the pending vector;
 // having scheduled it means that its depending nodes might become available:
 // such a depending node becomes available when all its dependent nodes have been scheduled now
 //
@@ -1035,47 +1148,28 @@ void Scheduler::make_available(
 //   a predecessor node which has a successor which hasn't been scheduled,
 //   will be checked here at least when that successor is scheduled
 //
+// instead of checking all dependent nodes of each depending node, pending counts the arcs
+// from unscheduled nodes for each node; depending nodes are made available in arc order
+//
 // update (through MakeAvailable) the cycle attribute of the nodes made available
 // because from then on that value is compared to the curr_cycle to check
 // whether a node has completed execution and thus is available for scheduling in curr_cycle
 void Scheduler::take_available(
-    ListDigraph::Node n,
-    utils::List<lemon::ListDigraph::Node> &avlist,
-    utils::Map<ir::compat::GateRef, utils::Bool> &scheduled,
+    Node n,
+    utils::List<Node> &avlist,
+    utils::Vec<utils::UInt> &pending,
     rmgr::Direction dir
 ) {
-    scheduled.set(instruction[n]) = true;
     avlist.remove(n);
 
-    if (dir == rmgr::Direction::FORWARD) {
-        for (ListDigraph::OutArcIt succ_arc(graph, n); succ_arc != lemon::INVALID; ++succ_arc) {
-            auto succ_node = graph.target(succ_arc);
-            Bool schedulable = true;
-            for (ListDigraph::InArcIt pred_arc(graph, succ_node); pred_arc != lemon::INVALID; ++pred_arc) {
-                ListDigraph::Node predNode = graph.source(pred_arc);
-                if (!scheduled.at(instruction[predNode])) {
-                    schedulable = false;
-                    break;
-                }
-            }
-            if (schedulable) {
-                make_available(succ_node, avlist, dir);
-            }
-        }
-    } else {
-        for (ListDigraph::InArcIt pred_arc(graph, n); pred_arc != lemon::INVALID; ++pred_arc) {
-            auto pred_node = graph.source(pred_arc);
-            Bool schedulable = true;
-            for (ListDigraph::OutArcIt succ_arc(graph, pred_node); succ_arc != lemon::INVALID; ++succ_arc) {
-                auto succ_node = graph.target(succ_arc);
-                if (!scheduled.at(instruction[succ_node])) {
-                    schedulable = false;
-                    break;
-                }
-            }
-            if (schedulable) {
-                make_available(pred_node, avlist, dir);
-            }
+    ArcRange arcs = dir == rmgr::Direction::FORWARD ? get_out_arcs(n) : get_in_arcs(n);
+    const Vec<Node> &endpoints = dir == rmgr::Direction::FORWARD ? arc_target : arc_source;
+    for (Arc arc : arcs) {
+        pending[endpoints[arc]]--;
+    }
+    for (Arc arc : arcs) {
+        if (pending[endpoints[arc]] == 0) {
+            make_available(endpoints[arc], avlist, dir);
         }
     }
 }
@@ -1098,7 +1192,7 @@ void Scheduler::advance_curr_cycle(rmgr::Direction dir, UInt &curr_cycle) {
 // return true when immediately schedulable
 // when returning false, isres indicates whether resource occupation was the reason or operand completion (for debugging)
 Bool Scheduler::immediately_schedulable(
-    ListDigraph::Node n,
+    Node n,
     rmgr::Direction dir,
     const UInt curr_cycle,
     rmgr::State &rs,
@@ -1133,8 +1227,8 @@ Bool Scheduler::immediately_schedulable(
 
 // select a node from the avlist
 // the avlist is deep-ordered from high to low criticality (see criticality_lessthan above)
-ListDigraph::Node Scheduler::select_available(
-    utils::List<lemon::ListDigraph::Node> &avlist,
+Scheduler::Node Scheduler::select_available(
+    utils::List<Node> &avlist,
     rmgr::Direction dir,
     const UInt curr_cycle,
     rmgr::State &rs,
@@ -1144,14 +1238,14 @@ ListDigraph::Node Scheduler::select_available(
 
     QL_DOUT("avlist(@" << curr_cycle << "):");
     for (auto n : avlist) {
-        QL_DOUT("...... node(@" << instruction[n]->cycle << "): " << name[n] << " remaining: " << remaining.dbg(n));
+        QL_DOUT("...... node(@" << instruction[n]->cycle << "): " << get_node_name(n) << " remaining: " << remaining[n]);
     }
 
     // select the first (most critical) immediately schedulable gate that has duration 0
     for (auto n : avlist) {
         Bool isres;
         if (instruction[n]->duration == 0 && immediately_schedulable(n, dir, curr_cycle, rs, isres)) {
-            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << name[n] << " duration 0 and immediately schedulable, remaining=" << remaining.dbg(n) << ", selected");
+            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << get_node_name(n) << " duration 0 and immediately schedulable, remaining=" << remaining[n] << ", selected");
             success = true;
             return n;
         }
@@ -1161,11 +1255,11 @@ ListDigraph::Node Scheduler::select_available(
     for (auto n : avlist) {
         Bool isres;
         if (immediately_schedulable(n, dir, curr_cycle, rs, isres)) {
-            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << name[n] << " immediately schedulable, remaining=" << remaining.dbg(n) << ", selected");
+            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << get_node_name(n) << " immediately schedulable, remaining=" << remaining[n] << ", selected");
             success = true;
             return n;
         } else {
-            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << name[n] << " remaining=" << remaining.dbg(n) << ", waiting for " << (isres ? "resource" : "dependent completion"));
+            QL_DOUT("... node (@" << instruction[n]->cycle << "): " << get_node_name(n) << " remaining=" << remaining[n] << ", waiting for " << (isres ? "resource" : "dependent completion"));
         }
     }
 
@@ -1205,16 +1299,17 @@ void Scheduler::schedule(
     // build a new resource state
     auto rs = rm.build(dir);
 
-    // scheduled[gp] :=: whether gate *gp has been scheduled, init all false
-    Map<ir::compat::GateRef, Bool> scheduled;
+    // pending[n] :=: number of arcs to n (forward) or from n (backward) of which the other node
+    // hasn't been scheduled yet; none were scheduled, including SOURCE/SINK
+    Vec<UInt> pending(get_node_count());
     // avlist :=: list of schedulable nodes, initially (see below) just s or t
-    List<ListDigraph::Node> avlist;
+    List<Node> avlist;
 
     // initializations for this scheduler
     // note that dependency graph is not modified by a scheduler, so it can be reused
     QL_DOUT("... initialization");
-    for (ListDigraph::NodeIt n(graph); n != lemon::INVALID; ++n) {
-        scheduled.set(instruction[n]) = false;   // none were scheduled, including SOURCE/SINK
+    for (Node n = 0; n < get_node_count(); n++) {
+        pending[n] = dir == rmgr::Direction::FORWARD ? in_index[n + 1] - in_index[n] : out_index[n + 1] - out_index[n];
     }
     UInt  curr_cycle;         // current cycle for which instructions are sought
     init_available(avlist, dir, curr_cycle);     // first node (SOURCE/SINK) is made available and curr_cycle set
@@ -1223,7 +1318,7 @@ void Scheduler::schedule(
     QL_DOUT("... loop over avlist until it is empty");
     while (!avlist.empty()) {
         Bool success;
-        ListDigraph::Node selected_node;
+        Node selected_node;
 
         selected_node = select_available(avlist, dir, curr_cycle, rs, success);
         if (!success) {
@@ -1246,7 +1341,7 @@ void Scheduler::schedule(
             ) {
             rs.reserve(curr_cycle, gp);
         }
-        take_available(selected_node, avlist, scheduled, dir);   // update avlist/scheduled/cycle
+        take_available(selected_node, avlist, pending, dir);     // update avlist/pending/cycle
         // more nodes that could be scheduled in this cycle, will be found in an other round of the loop
     }
 
@@ -1296,7 +1391,9 @@ void Scheduler::schedule_alap_uniform() {
     //   this has been left out, using our own linear dependency analysis creating a digraph
     //   and using the alap values as measure instead of the dep set size computed in article's D[n]
     // - balanced scheduling algorithm dominates with its O(n^2) when it cannot find a node to forward
-    //   no test has been devised yet to break the loop (figure 3, line 14-35)
+    //   (figure 3, line 14-35); instead, the gates are kept in per-cycle buckets, the latest cycle that
+    //   each gate can be moved to is maintained incrementally, and a max-tree over the buckets is used
+    //   to skip the buckets without a gate that can be moved, making the scan O(n log n) in practice
     // - targeted bundle size is adjusted each cycle and is number_of_gates_to_go/number_of_non_empty_bundles_to_go
     //   this is more greedy, preventing oscillation around a target size based on all bundles,
     //   because local variations caused by local dep chains create small bundles and thus leave more gates still to go
@@ -1328,10 +1425,72 @@ void Scheduler::schedule_alap_uniform() {
 
     // DOUT("Creating gates_per_cycle");
     // create gates_per_cycle[cycle] = for each cycle the list of gates at cycle cycle
-    // this is the basic map to be operated upon by the uniforming scheduler below;
-    Map<UInt, List<ir::compat::GateRef>> gates_per_cycle;
+    // this is the vector of occupancy buckets to be operated upon by the uniforming scheduler below;
+    // bucket 0 (SOURCE) and bucket cycle_count+1 (SINK) remain empty
+    Vec<List<ir::compat::GateRef>> gates_per_cycle(cycle_count + 2);
+    for (const auto &gp : kernel->gates) {
+        gates_per_cycle.at(gp->cycle).push_back(gp);
+    }
+
+    // compute latest[node] = the latest cycle that node can be moved to given the current cycles of its successors,
+    // i.e. such that its result is ready before end-of-circuit and before it is used;
+    // because gates are only ever moved to higher cycles, latest can only increase during the scan below,
+    // and it only needs to be updated for the predecessors of a gate that is moved
+    Vec<Int> latest(get_node_count());
+    auto update_latest = [&](Node n) {
+        Int latest_completion = cycle_count + 1;    // at SINK is ok, later not
+        for (Arc arc : get_out_arcs(n)) {
+            latest_completion = min<Int>(latest_completion, instruction[arc_target[arc]]->cycle);
+        }
+        latest[n] = latest_completion - Int(ceil(static_cast<Real>(instruction[n]->duration)/cycle_time));
+    };
     for (const auto &gp : kernel->gates) {
-        gates_per_cycle.set(gp->cycle).push_back(gp);
+        update_latest(node.at(gp));
+    }
+
+    // priority structure over the buckets below the current cycle: a max-tree over the cycles,
+    // holding for each bucket the highest latest value of the gates in it, i.e. the highest cycle
+    // that any of its gates can be moved to; this allows finding the highest bucket at or below
+    // pred_cycle with a gate that can be moved to curr_cycle in logarithmic time, instead of
+    // scanning all gates of all buckets below curr_cycle for each cycle
+    UInt tree_size = 1;
+    while (tree_size < cycle_count + 2) tree_size <<= 1;
+    Vec<Int> max_latest(2 * tree_size, -1);
+    auto update_bucket = [&](UInt cycle) {
+        Int value = -1;
+        for (const auto &gp : gates_per_cycle.at(cycle)) {
+            value = max<Int>(value, latest[node.at(gp)]);
+        }
+        UInt i = tree_size + cycle;
+        max_latest[i] = value;
+        for (i >>= 1; i >= 1; i >>= 1) {
+            max_latest[i] = max<Int>(max_latest[2 * i], max_latest[2 * i + 1]);
+        }
+    };
+    auto raise_bucket = [&](UInt cycle, Int value) {
+        for (UInt i = tree_size + cycle; i >= 1 && max_latest[i] < value; i >>= 1) {
+            max_latest[i] = value;
+        }
+    };
+    // returns the highest bucket at or below cycle with a gate that can be moved to target_cycle, or 0 if none
+    auto find_bucket = [&](UInt cycle, UInt target_cycle) -> UInt {
+        // walk up from the leaf until a left sibling subtree contains a candidate, then walk down into it
+        UInt i = tree_size + cycle;
+        if (max_latest[i] >= Int(target_cycle)) return cycle;
+        while (i > 1) {
+            if ((i & 1) && max_latest[i - 1] >= Int(target_cycle)) {
+                i--;
+                while (i < tree_size) {
+                    i = max_latest[2 * i + 1] >= Int(target_cycle) ? 2 * i + 1 : 2 * i;
+                }
+                return i - tree_size;
+            }
+            i >>= 1;
+        }
+        return 0;
+    };
+    for (UInt cycle = 1; cycle <= cycle_count; cycle++) {
+        update_bucket(cycle);
     }
 
     // DOUT("Displaying circuit and bundle statistics");
@@ -1343,11 +1502,11 @@ void Scheduler::schedule_alap_uniform() {
     UInt non_empty_bundle_count = 0;
     UInt gate_count = 0;
     for (UInt curr_cycle = 1; curr_cycle <= cycle_count; curr_cycle++) {
-        max_gates_per_cycle = max<UInt>(max_gates_per_cycle, gates_per_cycle.get(curr_cycle).size());
-        if (!gates_per_cycle.get(curr_cycle).empty()) {
+        max_gates_per_cycle = max<UInt>(max_gates_per_cycle, gates_per_cycle.at(curr_cycle).size());
+        if (!gates_per_cycle.at(curr_cycle).empty()) {
             non_empty_bundle_count++;
         }
-        gate_count += gates_per_cycle.get(curr_cycle).size();
+        gate_count += gates_per_cycle.at(curr_cycle).size();
     }
     Real avg_gates_per_cycle = Real(gate_count)/cycle_count;
     Real avg_gates_per_non_empty_cycle = Real(gate_count)/non_empty_bundle_count;
@@ -1370,16 +1529,9 @@ void Scheduler::schedule_alap_uniform() {
         // After an iteration at cycle curr_cycle, all bundles from curr_cycle to cycle_count have been filled up,
         // and all bundles from 1 to curr_cycle-1 still have to be done.
         // This assumes that current bundle is never too long, excess having been moved away earlier, as ASAP does.
-        // When such a node cannot be found, this loop scans the whole circuit for each original node to fill up
-        // and this creates a O(n^2) time complexity.
-        //
-        // A test to break this prematurely based on the current data structure, wasn't devised yet.
-        // A solution is to use the dep graph instead to find a node to fill up the current node,
-        // i.e. maintain a so-called "available list" of nodes free to schedule, as in the non-uniform scheduling algorithm,
-        // which is not hard at all but which is not according to the published algorithm.
-        // When the complexity becomes a problem, it is proposed to rewrite the algorithm accordingly.
-
-        Int pred_cycle = curr_cycle - 1;    // signed because can become negative
+        // Buckets without a gate that can be moved to curr_cycle are skipped using the max-tree,
+        // so only buckets that actually provide a node are scanned.
+        UInt pred_cycle = curr_cycle - 1;
 
         // target size of each bundle is number of gates still to go divided by number of non-empty cycles to go
         // it averages over non-empty bundles instead of all bundles because the latter would be very strict
@@ -1387,89 +1539,81 @@ void Scheduler::schedule_alap_uniform() {
         if (non_empty_bundle_count == 0) break;     // nothing to do
         avg_gates_per_cycle = Real(gate_count)/curr_cycle;
         avg_gates_per_non_empty_cycle = Real(gate_count)/non_empty_bundle_count;
-        QL_DOUT("Cycle=" << curr_cycle << " number of gates=" << gates_per_cycle.get(curr_cycle).size()
+        QL_DOUT("Cycle=" << curr_cycle << " number of gates=" << gates_per_cycle.at(curr_cycle).size()
                          << "; avg_gates_per_cycle=" << avg_gates_per_cycle
                          << "; avg_gates_per_non_empty_cycle=" << avg_gates_per_non_empty_cycle);
 
-        while (Real(gates_per_cycle.get(curr_cycle).size()) < avg_gates_per_non_empty_cycle && pred_cycle >= 1) {
+        while (Real(gates_per_cycle.at(curr_cycle).size()) < avg_gates_per_non_empty_cycle && pred_cycle >= 1) {
+            // skip to the highest bucket with a candidate to move forward to curr_cycle
+            pred_cycle = find_bucket(pred_cycle, curr_cycle);
+            if (pred_cycle == 0) break;
             QL_DOUT("pred_cycle=" << pred_cycle);
-            QL_DOUT("gates_per_cycle[curr_cycle].size()=" << gates_per_cycle.get(curr_cycle).size());
+            QL_DOUT("gates_per_cycle[curr_cycle].size()=" << gates_per_cycle.at(curr_cycle).size());
             UInt min_remaining_cycle = ir::compat::MAX_CYCLE;
-            List<ir::compat::GateRef>::const_iterator best_predgp_it;
+            List<ir::compat::GateRef>::iterator best_predgp_it;
             ir::compat::GateRef best_predgp = {};
             Bool best_predgp_found = false;
 
-            // scan bundle at pred_cycle to find suitable candidate to move forward to curr_cycle
-            for (auto predgp_it = gates_per_cycle.get(pred_cycle).begin(); predgp_it != gates_per_cycle.get(pred_cycle).end(); ++predgp_it) {
-                auto predgp = *predgp_it;
-                Bool forward_predgp = true;
-                UInt predgp_completion_cycle;
-                ListDigraph::Node pred_node = node.at(predgp);
-                QL_DOUT("... considering: " << predgp->qasm() << " @cycle=" << predgp->cycle << " remaining=" << remaining.dbg(pred_node));
-
-                // candidate's result, when moved, must be ready before end-of-circuit and before used
-                predgp_completion_cycle = curr_cycle + UInt(ceil(static_cast<Real>(predgp->duration)/cycle_time));
-                // predgp_completion_cycle = curr_cycle + (predgp->duration+cycle_time-1)/cycle_time;
-                if (predgp_completion_cycle > cycle_count + 1) { // at SINK is ok, later not
-                    forward_predgp = false;
-                    QL_DOUT("... ... rejected (after circuit): " << predgp->qasm() << " would complete @" << predgp_completion_cycle << " SINK @" << cycle_count + 1);
-                } else {
-                    for (ListDigraph::OutArcIt arc(graph,pred_node); arc != lemon::INVALID; ++arc) {
-                        ir::compat::GateRef target_gp = instruction[graph.target(arc)];
-                        UInt target_cycle = target_gp->cycle;
-                        if (predgp_completion_cycle > target_cycle) {
-                            forward_predgp = false;
-                            QL_DOUT("... ... rejected (after succ): " << predgp->qasm() << " would complete @" << predgp_completion_cycle << " target=" << target_gp->qasm() << " target_cycle=" << target_cycle);
-                        }
-                    }
-                }
-
-                // when multiple nodes in bundle qualify, take the one with lowest remaining
-                // because that is the most critical one and thus deserves a cycle as high as possible (ALAP)
-                if (forward_predgp && remaining.at(pred_node) < min_remaining_cycle) {
-                    min_remaining_cycle = remaining.at(pred_node);
+            // scan bundle at pred_cycle to find suitable candidate to move forward to curr_cycle;
+            // when multiple nodes in bundle qualify, take the one with lowest remaining
+            // because that is the most critical one and thus deserves a cycle as high as possible (ALAP)
+            auto &pred_bundle = gates_per_cycle.at(pred_cycle);
+            for (auto predgp_it = pred_bundle.begin(); predgp_it != pred_bundle.end(); ++predgp_it) {
+                Node pred_node = node.at(*predgp_it);
+                if (latest[pred_node] >= Int(curr_cycle) && remaining[pred_node] < min_remaining_cycle) {
+                    min_remaining_cycle = remaining[pred_node];
                     best_predgp_found = true;
-                    best_predgp = predgp;
+                    best_predgp = *predgp_it;
                     best_predgp_it = predgp_it;
                 }
             }
 
-            // when candidate was found in this bundle, move it, and search for more in this bundle, if needed
-            // otherwise, continue scanning backward
-            if (best_predgp_found) {
-                // move predgp from pred_cycle to curr_cycle;
-                // adjust all bookkeeping that is affected by this
-                gates_per_cycle.at(pred_cycle).erase(best_predgp_it);
-                if (gates_per_cycle.at(pred_cycle).empty()) {
-                    // source bundle was non-empty, now it is empty
-                    non_empty_bundle_count--;
-                }
-                if (gates_per_cycle.get(curr_cycle).empty()) {
-                    // target bundle was empty, now it will be non_empty
-                    non_empty_bundle_count++;
-                }
-                best_predgp->cycle = curr_cycle;        // what it is all about
-                gates_per_cycle.set(curr_cycle).push_back(best_predgp);
-
-                // recompute targets
-                if (non_empty_bundle_count == 0) break;     // nothing to do
-                avg_gates_per_cycle = Real(gate_count)/curr_cycle;
-                avg_gates_per_non_empty_cycle = Real(gate_count)/non_empty_bundle_count;
-                QL_DOUT("... moved " << best_predgp->qasm() << " with remaining=" << remaining.dbg(node.at(best_predgp))
-                                     << " from cycle=" << pred_cycle << " to cycle=" << curr_cycle
-                                     << "; new avg_gates_per_cycle=" << avg_gates_per_cycle
-                                     << "; avg_gates_per_non_empty_cycle=" << avg_gates_per_non_empty_cycle
-                );
-            } else {
-                pred_cycle --;
+            // cannot happen as long as the max-tree is up to date, but be robust against it
+            if (!best_predgp_found) {
+                update_bucket(pred_cycle);
+                pred_cycle--;
+                continue;
+            }
+
+            // move predgp from pred_cycle to curr_cycle;
+            // adjust all bookkeeping that is affected by this
+            pred_bundle.erase(best_predgp_it);
+            if (pred_bundle.empty()) {
+                // source bundle was non-empty, now it is empty
+                non_empty_bundle_count--;
             }
+            if (gates_per_cycle.at(curr_cycle).empty()) {
+                // target bundle was empty, now it will be non_empty
+                non_empty_bundle_count++;
+            }
+            best_predgp->cycle = curr_cycle;        // what it is all about
+            gates_per_cycle.at(curr_cycle).push_back(best_predgp);
+            update_bucket(pred_cycle);
+
+            // the predecessors of the moved gate may now be movable further
+            for (Arc arc : get_in_arcs(node.at(best_predgp))) {
+                Node src_node = arc_source[arc];
+                if (src_node == s) continue;
+                update_latest(src_node);
+                raise_bucket(instruction[src_node]->cycle, latest[src_node]);
+            }
+
+            // recompute targets
+            if (non_empty_bundle_count == 0) break;     // nothing to do
+            avg_gates_per_cycle = Real(gate_count)/curr_cycle;
+            avg_gates_per_non_empty_cycle = Real(gate_count)/non_empty_bundle_count;
+            QL_DOUT("... moved " << best_predgp->qasm() << " with remaining=" << remaining[node.at(best_predgp)]
+                                 << " from cycle=" << pred_cycle << " to cycle=" << curr_cycle
+                                 << "; new avg_gates_per_cycle=" << avg_gates_per_cycle
+                                 << "; avg_gates_per_non_empty_cycle=" << avg_gates_per_non_empty_cycle
+            );
         }   // end for finding a bundle to forward a node from to the current cycle
 
         // curr_cycle ready, recompute counts for remaining cycles
         // mask current cycle and its gates from the target counts:
         // - gate_count, non_empty_bundle_count, curr_cycle (as cycles still to go)
-        gate_count -= gates_per_cycle.get(curr_cycle).size();
-        if (!gates_per_cycle.get(curr_cycle).empty()) {
+        gate_count -= gates_per_cycle.at(curr_cycle).size();
+        if (!gates_per_cycle.at(curr_cycle).empty()) {
             // bundle is non-empty
             non_empty_bundle_count--;
         }
@@ -1485,11 +1629,11 @@ void Scheduler::schedule_alap_uniform() {
     gate_count = 0;
     // cycle_count was not changed
     for (UInt curr_cycle = 1; curr_cycle <= cycle_count; curr_cycle++) {
-        max_gates_per_cycle = max<UInt>(max_gates_per_cycle, gates_per_cycle.get(curr_cycle).size());
-        if (!gates_per_cycle.get(curr_cycle).empty()) {
+        max_gates_per_cycle = max<UInt>(max_gates_per_cycle, gates_per_cycle.at(curr_cycle).size());
+        if (!gates_per_cycle.at(curr_cycle).empty()) {
             non_empty_bundle_count++;
         }
-        gate_count += gates_per_cycle.get(curr_cycle).size();
+        gate_count += gates_per_cycle.at(curr_cycle).size();
     }
     avg_gates_per_cycle = Real(gate_count)/cycle_count;
     avg_gates_per_non_empty_cycle = Real(gate_count)/non_empty_bundle_count;
@@ -1513,19 +1657,8 @@ void Scheduler::get_dot(
     std::ostream &dotout
 ) {
     QL_DOUT("Get_dot");
-    ListDigraphPath p;
-    ListDigraph::ArcMap<Bool> is_in_critical{graph};
-    if (with_critical) {
-        for (ListDigraph::ArcIt a(graph); a != lemon::INVALID; ++a) {
-            is_in_critical[a] = false;
-            for (ListDigraphPath::ArcIt ap(p); ap != lemon::INVALID; ++ap) {
-                if (a == ap) {
-                    is_in_critical[a] = true;
-                    break;
-                }
-            }
-        }
-    }
+    // no critical path is computed, so with_critical doesn't mark any arcs
+    Vec<Bool> is_in_critical(arc_source.size(), false);
 
     Str node_style(" fontcolor=black, style=filled, fontsize=16");
     Str edge_style_1(" color=black");
@@ -1536,10 +1669,10 @@ void Scheduler::get_dot(
            << "\nedge [fontsize=16, arrowhead=vee, arrowsize=0.5];"
            << std::endl;
 
-    // first print the nodes
-    for (ListDigraph::NodeIt n(graph); n != lemon::INVALID; ++n) {
-        dotout << "\"" << graph.id(n) << "\""
-               << " [label=\" " << name[n] << " \""
+    // first print the nodes, last one first
+    for (Node n = get_node_count(); n-- > 0;) {
+        dotout << "\"" << n << "\""
+               << " [label=\" " << get_node_name(n) << " \""
                << node_style
                 << "];" << std::endl;
     }
@@ -1563,36 +1696,35 @@ void Scheduler::get_dot(
         dotout << ";\n}\n";
 
         // Now print ranks, as shown below
-        dotout << "{ rank=same; Cycle" << instruction[s]->cycle <<"; " << graph.id(s) << "; }\n";
+        dotout << "{ rank=same; Cycle" << instruction[s]->cycle <<"; " << s << "; }\n";
         for (const auto &gp : kernel->gates) {
-            dotout << "{ rank=same; Cycle" << gp->cycle <<"; " << graph.id(node.at(gp)) << "; }\n";
+            dotout << "{ rank=same; Cycle" << gp->cycle <<"; " << node.at(gp) << "; }\n";
         }
-        dotout << "{ rank=same; Cycle" << instruction[t]->cycle <<"; " << graph.id(t) << "; }\n";
+        dotout << "{ rank=same; Cycle" << instruction[t]->cycle <<"; " << t << "; }\n";
     }
 
-    // now print the edges
-    for (ListDigraph::ArcIt arc(graph); arc != lemon::INVALID; ++arc) {
-        auto src_node = graph.source(arc);
-        auto dst_node = graph.target(arc);
-        Int src_id = graph.id(src_node );
-        Int dst_id = graph.id(dst_node );
-
-        if (with_critical) {
-            edge_style = (is_in_critical[arc] == true) ? edge_style_2 : edge_style_1;
-        }
+    // now print the edges, grouped by source node in the same order as the nodes
+    for (Node src_id = get_node_count(); src_id-- > 0;) {
+        for (Arc arc : get_out_arcs(src_id)) {
+            Node dst_id = arc_target[arc];
 
-        dotout << std::dec
-               << "\"" << src_id << "\""
-               << "->"
-               << "\"" << dst_id << "\""
-               << "[ label=\""
-               << op_type[arc] << "[" << cause[arc] << "]"
-               << " , " << weight[arc]
-               << " , " << dep_type[arc]
-               << "\""
-               << " " << edge_style << " "
-               << "]"
-               << std::endl;
+            if (with_critical) {
+                edge_style = (is_in_critical[arc] == true) ? edge_style_2 : edge_style_1;
+            }
+
+            dotout << std::dec
+                   << "\"" << src_id << "\""
+                   << "->"
+                   << "\"" << dst_id << "\""
+                   << "[ label=\""
+                   << op_type[arc] << "[" << cause[arc] << "]"
+                   << " , " << weight[arc]
+                   << " , " << dep_type[arc]
+                   << "\""
+                   << " " << edge_style << " "
+                   << "]"
+                   << std::endl;
+        }
     }
 
     dotout << "}" << std::endl;
@@ -7,14 +7,9 @@
 
 #pragma once
 
-#include <lemon/list_graph.h>
-#include <lemon/lgf_reader.h>
-#include <lemon/lgf_writer.h>
-#include <lemon/dijkstra.h>
-#include <lemon/connectivity.h>
-
 #include "ql/utils/num.h"
 #include "ql/utils/str.h"
+#include "ql/utils/vec.h"
 #include "ql/utils/list.h"
 #include "ql/utils/map.h"
 #include "ql/utils/ptr.h"
@@ -53,29 +48,52 @@ enum class OperandType {QUBIT, CREG, BREG};
 std::ostream &operator<<(std::ostream &os, OperandType ot);
 
 class Scheduler {
+public:
+    // nodes and arcs of the dependence graph are identified by their index in the node and arc arrays below;
+    // nodes are numbered in circuit order, i.e. SOURCE is node 0, the gates follow, and SINK is the last node
+    typedef utils::UInt Node;
+    typedef utils::UInt Arc;
+    static const Node NO_NODE = utils::UMAX;
+
+    // the incoming or outgoing arcs of a node, as a contiguous range of arc indices
+    struct ArcRange {
+        const Arc *first;
+        const Arc *last;
+        const Arc *begin() const { return first; }
+        const Arc *end() const { return last; }
+    };
+
 private:
     // NOTE JvS: I don't like that this needs to be here, but making all this
     // stuff public feels way worse.
     friend class map::qubits::map::detail::Future;
 
     // dependence graph is constructed (see Init) once from the sequence of gates in a kernel's circuit
-    // it can be reused as often as needed as long as no gates are added/deleted; it doesn't modify those gates
-    lemon::ListDigraph graph;
+    // it can be reused as often as needed as long as no gates are added/deleted; it doesn't modify those gates;
+    // it is stored as arrays indexed by node resp. arc, with the adjacency in compressed form (see build_adjacency)
 
     // conversion between gate* (pointer to the gate in the circuit) and node (of the dependence graph)
-    lemon::ListDigraph::NodeMap<ir::compat::GateRef> instruction;// instruction[n] == gate*
-    utils::Map<ir::compat::GateRef, lemon::ListDigraph::Node>  node;// node[gate*] == n
+    utils::Vec<ir::compat::GateRef> instruction;      // instruction[n] == gate*
+    utils::Map<ir::compat::GateRef, Node>  node;      // node[gate*] == n
 
     // attributes
-    lemon::ListDigraph::NodeMap<utils::Str> name;     // name[n] == qasm string
-    lemon::ListDigraph::NodeMap<utils::Int> order;    // order[n] == original index of gates in kernel
-    lemon::ListDigraph::ArcMap<utils::Int> weight;    // number of cycles of dependence
-    lemon::ListDigraph::ArcMap<OperandType> op_type;  // qubit, creg or breg
-    lemon::ListDigraph::ArcMap<utils::Int> cause;     // operand index
-    lemon::ListDigraph::ArcMap<DepType> dep_type;     // RAW, WAW, ...
+    utils::Vec<utils::Int> order;                     // order[n] == original index of gates in kernel
+    utils::Vec<Node> arc_source;                      // arc_source[a] == node the arc departs from
+    utils::Vec<Node> arc_target;                      // arc_target[a] == node that depends on arc_source[a]
+    utils::Vec<utils::Int> weight;                    // number of cycles of dependence
+    utils::Vec<OperandType> op_type;                  // qubit, creg or breg
+    utils::Vec<utils::Int> cause;                     // operand index
+    utils::Vec<DepType> dep_type;                     // RAW, WAW, ...
+
+    // adjacency: the outgoing arcs of node n are out_arcs[out_index[n]] up to out_arcs[out_index[n+1]],
+    // and likewise for the incoming arcs; in both, the most recently added arc comes first
+    utils::Vec<utils::UInt> out_index;
+    utils::Vec<Arc> out_arcs;
+    utils::Vec<utils::UInt> in_index;
+    utils::Vec<Arc> in_arcs;
 
     // s and t nodes are the top and bottom of the dependence graph
-    lemon::ListDigraph::Node s, t;                     // instruction[s]==SOURCE, instruction[t]==SINK
+    Node s, t;                                        // instruction[s]==SOURCE, instruction[t]==SINK
 
     // parameters of dependence graph construction
     utils::UInt cycle_time;             // to convert durations to cycles as weight of dependence
@@ -91,7 +109,16 @@ private:
     utils::Bool enable_criticality;     // whether to enable criticality selection logic
 
     // scheduler support
-    utils::Map<lemon::ListDigraph::Node, utils::UInt>  remaining;  // remaining[node] == cycles until end; critical path representation
+    utils::Vec<utils::UInt> remaining;              // remaining[node] == cycles until end; critical path representation
+
+    // deep-criticality cache, see compute_criticality;
+    // it is valid for the direction in which remaining was last computed
+    rmgr::Direction criticality_dir;
+    utils::Vec<Node> critical_dep;                  // most deep-critical depending node, or NO_NODE when there is none
+    utils::Vec<utils::UInt> criticality_rank;       // a higher rank indicates a higher deep-criticality
+
+    // marks nodes while collecting depending nodes, to filter out duplicates
+    utils::Vec<utils::Bool> node_mark;
 
     // state of the state machine that is used to construct the dependence graph
     // for each OperandType there is a separate type of state machine
@@ -116,6 +143,9 @@ public:
     // name may contain parameters, so must be stripped first before checking it for gate's name
     static void strip_name(utils::Str &name);
 
+    // the qasm string of node n, including any condition; only used for debugging output, so built on demand
+    utils::Str get_node_name(Node n) const;
+
     // signal the state machine of dependence graph construction to do a step as specified by the parameters;
     // currID is the new node in the graph for the new gate/instruction;
     // the event concerns a particular operand of this gate, with the specified type and index,
@@ -151,6 +181,16 @@ public:
         utils::Bool enable_criticality
     );
 
+    // number of nodes of the dependence graph, including SOURCE and SINK
+    utils::UInt get_node_count() const;
+
+    // the outgoing resp. incoming arcs of a node
+    ArcRange get_out_arcs(Node n) const;
+    ArcRange get_in_arcs(Node n) const;
+
+    // build the compressed adjacency arrays from arc_source and arc_target, once all arcs have been added
+    void build_adjacency();
+
     void dprint_depgraph(const utils::Str &s) const;
     void print() const;
     void write_dependence_matrix() const;
@@ -258,7 +298,7 @@ public:
     // Set the curr_cycle of the scheduling algorithm to start at the appropriate end as well;
     // note that the cycle attributes will be shifted down to start at 1 after backward scheduling.
     void init_available(
-        utils::List<lemon::ListDigraph::Node> &avlist,
+        utils::List<Node> &avlist,
         rmgr::Direction dir,
         utils::UInt &curr_cycle
     );
@@ -268,9 +308,9 @@ public:
     // dependences that are duplicates from the perspective of the scheduler
     // may be present in the dependence graph because the scheduler ignores dependence type and cause
     void get_depending_nodes(
-        lemon::ListDigraph::Node n,
+        Node n,
         rmgr::Direction dir,
-        utils::List<lemon::ListDigraph::Node> &ln
+        utils::List<Node> &ln
     );
 
     // Compute of two nodes whether the first one is less deep-critical than the second, for the given scheduling direction;
@@ -279,11 +319,23 @@ public:
     // this function is used to order the avlist in an order from highest deep-criticality to lowest deep-criticality;
     // it is the core of the heuristics of the critical path list scheduler.
     utils::Bool criticality_lessthan(
-        lemon::ListDigraph::Node n1,
-        lemon::ListDigraph::Node n2,
+        Node n1,
+        Node n2,
         rmgr::Direction dir
     );
 
+    // Compare the deep-criticality of two nodes, returning -1 when n1 is less deep-critical than n2,
+    // 1 when it is more deep-critical, and 0 when they are equally deep-critical;
+    // instead of comparing the sorted lists of depending nodes recursively,
+    // it follows the chains of most deep-critical depending nodes (critical_dep) of both nodes
+    // until they are decided, which is as soon as both have been ranked by compute_criticality
+    utils::Int compare_criticality(Node n1, Node n2) const;
+
+    // Compute critical_dep and criticality_rank for the given scheduling direction from remaining;
+    // nodes are ranked in order of increasing remaining, and nodes with equal remaining are ranked by
+    // sorting them using compare_criticality, so that criticality_lessthan is a comparison of ranks
+    void compute_criticality(rmgr::Direction dir);
+
     // Make node n available
     // add it to the avlist because the condition for that is fulfilled:
     //  all its predecessors were scheduled (forward scheduling) or
@@ -292,13 +344,14 @@ public:
     // avlist is initialized with s or t as first element by init_available
     // avlist is kept ordered on deep-criticality, non-increasing (i.e. highest deep-criticality first)
     void make_available(
-        lemon::ListDigraph::Node n,
-        utils::List<lemon::ListDigraph::Node> &avlist,
+        Node n,
+        utils::List<Node> &avlist,
         rmgr::Direction dir
     );
 
     // take node n out of avlist because it has been scheduled;
-    // reflect that the node has been scheduled in the scheduled vector;
+    // reflect that the node has been scheduled in the pending vector, which counts for each node
+    // the number of arcs from (forward) or to (backward) nodes that haven't been scheduled yet;
     // having scheduled it means that its depending nodes might become available:
     // such a depending node becomes available when all its dependent nodes have been scheduled now
     //
@@ -315,9 +368,9 @@ public:
     // because from then on that value is compared to the curr_cycle to check
     // whether a node has completed execution and thus is available for scheduling in curr_cycle
     void take_available(
-        lemon::ListDigraph::Node n,
-        utils::List<lemon::ListDigraph::Node> &avlist,
-        utils::Map<ir::compat::GateRef, utils::Bool> &scheduled,
+        Node n,
+        utils::List<Node> &avlist,
+        utils::Vec<utils::UInt> &pending,
         rmgr::Direction dir
     );
 
@@ -333,7 +386,7 @@ public:
     // return true when immediately schedulable
     // when returning false, isres indicates whether resource occupation was the reason or operand completion (for debugging)
     utils::Bool immediately_schedulable(
-        lemon::ListDigraph::Node n,
+        Node n,
         rmgr::Direction dir,
         const utils::UInt curr_cycle,
         rmgr::State &rs,
@@ -342,8 +395,8 @@ public:
 
     // select a node from the avlist
     // the avlist is deep-ordered from high to low criticality (see criticality_lessthan above)
-    lemon::ListDigraph::Node select_available(
-        utils::List<lemon::ListDigraph::Node> &avlist,
+    Node select_available(
+        utils::List<Node> &avlist,
         rmgr::Direction dir,
         const utils::UInt curr_cycle,
         rmgr::State &rs,
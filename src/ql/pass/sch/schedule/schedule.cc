@@ -5,6 +5,7 @@
 #include "ql/pass/sch/schedule/schedule.h"
 
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
 #include "ql/pmgr/pass_types/base.h"
 #include "detail/scheduler.h"
 
@@ -45,7 +46,7 @@ SchedulePass::SchedulePass(
     const utils::Ptr<const pmgr::Factory> &pass_factory,
     const utils::Str &instance_name,
     const utils::Str &type_name
-) : pmgr::pass_types::KernelTransformation(pass_factory, instance_name, type_name) {
+) : pmgr::pass_types::KernelTransformation(pass_factory, instance_name, type_name, true) {
 
     options.add_bool(
         "resource_constraints",
@@ -149,7 +150,7 @@ utils::Int SchedulePass::run(
     // Write dot file if requested.
     // TODO: maybe make this a separate pass, actually?
     if (options["write_dot_graphs"].as_bool()) {
-        utils::OutFile outf{context.output_prefix + "_" + kernel->name + ".dot"};
+        utils::AsyncOutFile outf{context.output_prefix + "_" + kernel->name + ".dot"};
         sched.get_dot(false, true, outf.unwrap());
     }
 
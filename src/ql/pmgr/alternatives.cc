@@ -0,0 +1,172 @@
+/** \file
+ * Pass group that runs alternative strategies and keeps the best result.
+ */
+
+#include "ql/pmgr/alternatives.h"
+
+#include "ql/com/ana/metrics.h"
+#include "ql/pmgr/factory.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Writes the documentation for this pass group to the given stream.
+ */
+void Alternatives::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass group runs a number of alternative strategies for the same part
+    of the compilation process, and keeps the result that scores best
+    according to the configured metric. For example, it can be used to try
+    different mapper heuristics or scheduler modes, and keep whichever yields
+    the shortest program.
+
+    Every alternative is run on its own copy of the IR, so the alternatives
+    can be run concurrently (see num_threads). When multiple alternatives
+    score equally well, the first one is kept. The copies are made via the
+    binary IR format, so annotations other than the compatibility platform
+    and resource manager are not carried into them.
+
+    The alternatives consist of a pass of type pass_type each, with the option
+    sets given by the alternatives option. For instance, pass_type
+    `map.qubits.Map` and alternatives
+    `route_heuristic=base|route_heuristic=minextend,lookahead_mode=all`
+    tries the base heuristic and minextend with full lookahead. The passes are
+    named `alt0`, `alt1`, etc. If pass_type is empty, the alternatives are
+    empty generic groups instead, to be populated using the pass management
+    API.
+    )");
+}
+
+/**
+ * Builds the alternatives from the pass_type and alternatives options.
+ */
+pass_types::NodeType Alternatives::on_construct(
+    const utils::Ptr<const Factory> &factory,
+    utils::List<PassRef> &passes,
+    condition::Ref &condition
+) {
+    const auto &pass_type = options["pass_type"].as_str();
+    const auto &spec = options["alternatives"].as_str();
+    if (spec.empty()) {
+        return pass_types::NodeType::GROUP_SELECT;
+    }
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = spec.find('|', start);
+        auto option_set = spec.substr(start, end == utils::Str::npos ? end : end - start);
+        start = end + 1;
+
+        auto pass = Factory::build_pass(factory, pass_type, "alt" + utils::to_string(passes.size()));
+        utils::UInt option_start = 0;
+        utils::UInt option_end;
+        do {
+            option_end = option_set.find(',', option_start);
+            auto option = option_set.substr(
+                option_start,
+                option_end == utils::Str::npos ? option_end : option_end - option_start
+            );
+            option_start = option_end + 1;
+            if (option.empty()) {
+                continue;
+            }
+            auto equals = option.find('=');
+            if (equals == utils::Str::npos) {
+                throw utils::Exception(
+                    "invalid option \"" + option + "\" in alternatives for " +
+                    describe() + "; expected name=value"
+                );
+            }
+            pass->set_option(option.substr(0, equals), option.substr(equals + 1));
+        } while (option_end != utils::Str::npos);
+        passes.push_back(pass);
+
+    } while (end != utils::Str::npos);
+    return pass_types::NodeType::GROUP_SELECT;
+}
+
+/**
+ * Scores a copy of the IR after one of the alternatives has been run on it.
+ * Lower is better.
+ */
+utils::Int Alternatives::run_internal(
+    const ir::Ref &ir,
+    const pass_types::Context &context
+) const {
+    const auto &metric = context.options["metric"].as_str();
+    if (metric == "latency") {
+        return com::ana::compute_program_fused<com::ana::Latency>(ir)
+            .get_result<com::ana::Latency>();
+    } else if (metric == "gate_count") {
+        return com::ana::compute_program_fused<com::ana::QuantumGateCount>(ir)
+            .get_result<com::ana::QuantumGateCount>();
+    } else {
+        return com::ana::compute_program_fused<com::ana::MultiQubitGateCount>(ir)
+            .get_result<com::ana::MultiQubitGateCount>();
+    }
+}
+
+/**
+ * Returns the value of the alternative_threads option.
+ */
+utils::UInt Alternatives::get_num_alternative_threads() const {
+    return options["alternative_threads"].as_uint();
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str Alternatives::get_friendly_type() const {
+    return "Alternatives";
+}
+
+/**
+ * Constructs the pass group.
+ */
+Alternatives::Alternatives(
+    const utils::Ptr<const Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pass_types::Base(pass_factory, instance_name, type_name) {
+    options.add_str(
+        "pass_type",
+        "The type of the pass that each alternative consists of. If empty, "
+        "the alternatives are empty generic groups.",
+        ""
+    );
+    options.add_str(
+        "alternatives",
+        "The option sets for the alternatives, separated by `|`. Each option "
+        "set is a comma-separated list of `name=value` pairs that is applied "
+        "to the pass of that alternative.",
+        ""
+    );
+    options.add_enum(
+        "metric",
+        "The metric used to select the best alternative; the alternative "
+        "yielding the lowest value wins. `latency` is the total duration of "
+        "the blocks of the program in cycles, which requires the program to "
+        "be scheduled. `gate_count` counts all quantum gates, and "
+        "`multi_qubit_gate_count` counts only the gates that act on multiple "
+        "qubits, which serves as a measure of the number of swaps added by "
+        "the mapper.",
+        "latency",
+        {"latency", "gate_count", "multi_qubit_gate_count"}
+    );
+    options.add_int(
+        "alternative_threads",
+        "The number of threads to use for running the alternatives "
+        "concurrently. 0 means use all hardware threads. Note that the pass "
+        "profiler only records the alternatives when they are run "
+        "sequentially.",
+        "1",
+        0
+    );
+}
+
+} // namespace pmgr
+} // namespace ql
@@ -0,0 +1,98 @@
+/** \file
+ * Defines the analyses that the pass manager tracks as annotations on the IR,
+ * and how to free them.
+ */
+
+#include "ql/pmgr/analyses.h"
+
+#include "ql/ir/slots.h"
+#include "ql/com/ddg/types.h"
+#include "ql/com/cfg/types.h"
+#include "ql/com/sch/heuristics.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Visitor that frees the annotations of a set of analyses from all nodes in a
+ * tree.
+ */
+class AnalysisFreer : public ir::RecursiveVisitor {
+public:
+
+    /**
+     * The analyses to free.
+     */
+    Analyses analyses;
+
+    /**
+     * Constructs the visitor.
+     */
+    explicit AnalysisFreer(Analyses analyses) : analyses(analyses) {
+    }
+
+    /**
+     * Does nothing for other nodes.
+     */
+    void visit_node(ir::Node &node) override {
+    }
+
+    /**
+     * Frees the control-flow graph of the program.
+     */
+    void visit_program(ir::Program &node) override {
+        if (analyses & analysis::CFG) {
+            ir::erase_annotation<com::cfg::Graph>(node);
+        }
+        ir::RecursiveVisitor::visit_program(node);
+    }
+
+    /**
+     * Frees the data dependency graph and control-flow graph node of a block.
+     * The sentinels of the data dependency graph are not part of the tree, so
+     * their deep criticality is freed here too when the graph is preserved.
+     */
+    void visit_block_base(ir::BlockBase &node) override {
+        if (analyses & analysis::DDG) {
+            ir::erase_annotation<com::ddg::Graph>(node);
+        } else if (analyses & analysis::DEEP_CRITICALITY) {
+            if (auto graph = ir::get_annotation_ptr<com::ddg::Graph>(node)) {
+                ir::erase_annotation<com::sch::DeepCriticality>(*graph->source);
+                ir::erase_annotation<com::sch::DeepCriticality>(*graph->sink);
+            }
+        }
+        if (analyses & analysis::CFG) {
+            ir::erase_annotation<com::cfg::NodeRef>(node);
+        }
+        ir::RecursiveVisitor::visit_block_base(node);
+    }
+
+    /**
+     * Frees the data dependency graph node and deep criticality of a
+     * statement.
+     */
+    void visit_statement(ir::Statement &node) override {
+        if (analyses & analysis::DDG) {
+            ir::erase_annotation<com::ddg::NodeRef>(node);
+        }
+        if (analyses & analysis::DEEP_CRITICALITY) {
+            ir::erase_annotation<com::sch::DeepCriticality>(node);
+        }
+        ir::RecursiveVisitor::visit_statement(node);
+    }
+
+};
+
+/**
+ * Frees the annotations for the given analyses everywhere in the given IR.
+ */
+void free_analyses(const ir::Ref &ir, Analyses analyses) {
+    if (ir.empty() || ir->program.empty() || !(analyses & analysis::ALL)) {
+        return;
+    }
+    AnalysisFreer freer{analyses};
+    ir->program->visit(freer);
+}
+
+} // namespace pmgr
+} // namespace ql
@@ -0,0 +1,570 @@
+/** \file
+ * Pass group that compiles each kernel of the program separately, possibly on
+ * other machines, and merges the results.
+ */
+
+#include "ql/pmgr/distribute.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "ql/utils/set.h"
+#include "ql/utils/binary_io.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/parallel.h"
+#include "ql/com/options.h"
+#include "ql/ir/binary.h"
+#include "ql/ir/cow.h"
+#include "ql/ir/new_to_old.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/pmgr/factory.h"
+#include "ql/pmgr/manager.h"
+#include "ql/pmgr/pass_types/specializations.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Version of the shard request and response format. This is incremented
+ * whenever the format changes, and workers reject requests of any other
+ * version. The embedded IR records have their own version as well.
+ */
+const utils::UInt Distribute::FORMAT_VERSION = 1;
+
+/**
+ * Magic number at the start of each shard request.
+ */
+static const char REQUEST_MAGIC[4] = {'Q', 'L', 'S', 'Q'};
+
+/**
+ * Magic number at the start of each shard response.
+ */
+static const char RESPONSE_MAGIC[4] = {'Q', 'L', 'S', 'A'};
+
+/**
+ * Transport that serves the requests in the compiling process itself. This is
+ * mostly useful for testing transports and workers, as it goes through the
+ * same serialization steps as a remote worker would.
+ */
+class LocalTransport : public Transport {
+public:
+
+    /**
+     * Serves the given request locally.
+     */
+    utils::Str submit(
+        const utils::Str &worker,
+        const utils::Str &request
+    ) const override {
+        (void)worker;
+        return Distribute::serve(request);
+    }
+
+};
+
+/**
+ * Mutex protecting the transport registry.
+ */
+static std::mutex transports_mutex;
+
+/**
+ * The transports registered using Distribute::register_transport().
+ */
+static utils::Map<utils::Str, CTransportRef> transports;
+
+/**
+ * Registers a transport with the given name, to be selected using the
+ * transport option. Replaces any previously registered transport with the
+ * same name. The built-in `local` transport can not be replaced.
+ */
+void Distribute::register_transport(
+    const utils::Str &name,
+    const CTransportRef &transport
+) {
+    if (name == "local") {
+        throw utils::Exception("the local transport can not be replaced");
+    }
+    std::lock_guard<std::mutex> lock{transports_mutex};
+    transports.set(name) = transport;
+}
+
+/**
+ * Writes the magic number and format version of a shard request or response.
+ */
+static void write_header(utils::BinaryWriter &writer, const char *magic) {
+    writer.write_bytes(magic, 4);
+    writer.write_uint(Distribute::FORMAT_VERSION, 4);
+}
+
+/**
+ * Checks the magic number and format version of a shard request or response.
+ */
+static void check_header(
+    utils::BinaryReader &reader,
+    const char *magic,
+    const utils::Str &what
+) {
+    if (!std::equal(magic, magic + 4, reader.read_bytes(4))) {
+        QL_USER_ERROR("not an OpenQL " << what << " (bad magic number)");
+    }
+    auto version = reader.read_uint(4);
+    if (version != Distribute::FORMAT_VERSION) {
+        QL_USER_ERROR(
+            "unsupported OpenQL " << what << " format version " << version
+            << "; this version of OpenQL handles version "
+            << Distribute::FORMAT_VERSION
+        );
+    }
+}
+
+/**
+ * Returns the given pass type name without its `dnu` namespace elements, if
+ * any.
+ */
+static utils::Str strip_dnu(const utils::Str &type_name) {
+    utils::Str stripped;
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = type_name.find('.', start);
+        auto element = type_name.substr(start, end == utils::Str::npos ? end : end - start);
+        start = end + 1;
+        if (element != "dnu") {
+            if (!stripped.empty()) {
+                stripped += '.';
+            }
+            stripped += element;
+        }
+    } while (end != utils::Str::npos);
+    return stripped;
+}
+
+/**
+ * Describes the given passes for a worker, as a list of objects with the
+ * type, name, and explicitly set options of each pass, and the sub-passes for
+ * generic groups. The full type names of do-not-use passes are added to dnu,
+ * for the worker to enable them.
+ */
+static utils::Json describe_passes(
+    const utils::List<PassRef> &passes,
+    utils::Json &dnu
+) {
+    auto descriptions = utils::Json::array();
+    for (const auto &pass : passes) {
+        auto type_name = strip_dnu(pass->get_type());
+        if (type_name != pass->get_type()) {
+            dnu.push_back(pass->get_type());
+        }
+        utils::Json description;
+        description["type"] = type_name;
+        description["name"] = pass->get_name();
+        description["options"] = utils::Json::object();
+        for (const auto &option : pass->get_options().get_set_options()) {
+            description["options"][option.first] = option.second;
+        }
+        if (type_name.empty()) {
+            description["group"] = describe_passes(pass->get_sub_passes(), dnu);
+        }
+        descriptions.push_back(description);
+    }
+    return descriptions;
+}
+
+/**
+ * Adds the passes described by describe_passes() to the given group.
+ */
+static void add_described_passes(
+    const PassRef &group,
+    const utils::Json &descriptions
+) {
+    for (const auto &description : descriptions) {
+        utils::Map<utils::Str, utils::Str> options;
+        const auto &option_values = description.at("options");
+        for (auto it = option_values.begin(); it != option_values.end(); ++it) {
+            options.set(it.key()) = it.value().get<utils::Str>();
+        }
+        auto pass = group->append_sub_pass(
+            description.at("type").get<utils::Str>(),
+            description.at("name").get<utils::Str>(),
+            options
+        );
+        if (description.count("group")) {
+            add_described_passes(pass, description.at("group"));
+        }
+    }
+}
+
+/**
+ * Handles a shard request as produced by a Distribute pass group, and returns
+ * the response to send back. Errors are reported through the response rather
+ * than thrown, such that the pass group can rethrow them on the machine that
+ * started the compilation.
+ *
+ * The request consists of a four-byte magic number (`QLSQ`), a 32-bit format
+ * version, the description of the pass group as length-prefixed CBOR, and a
+ * length-prefixed binary IR record of the shard, which contains a single
+ * kernel and the platform. The response consists of a four-byte magic number
+ * (`QLSA`), a 32-bit format version, and a status byte. If the status is
+ * nonzero, it is followed by the error message. Otherwise, it is followed by
+ * the binary IR record of the compiled shard and the output files written by
+ * the passes; paths within the output directory of the worker are stored
+ * relative to it, so they can be written to the output directory of the
+ * compiling process.
+ */
+utils::Str Distribute::serve(const utils::Str &request) {
+    utils::Str response;
+    utils::BinaryWriter writer{response};
+    write_header(writer, RESPONSE_MAGIC);
+    try {
+
+        // Decode the request.
+        utils::BinaryReader reader{request.data(), request.size(), "shard request"};
+        check_header(reader, REQUEST_MAGIC, "shard request");
+        auto group = reader.read_json();
+        auto shard = ir::binary::read(reader.read_str());
+
+        // Rebuild the sub-passes. They are nested in generic groups named
+        // after the elements of the full name of the pass group, such that
+        // the sub-passes get the same full names, and thus the same output
+        // filenames, as on the compiling process.
+        utils::Set<utils::Str> dnu;
+        for (const auto &type_name : group.at("dnu")) {
+            dnu.insert(type_name.get<utils::Str>());
+        }
+        Manager manager{"", dnu};
+        auto parent = manager.get_root();
+        const auto prefix = group.at("prefix").get<utils::Str>();
+        if (!prefix.empty()) {
+            utils::UInt start = 0;
+            utils::UInt end;
+            do {
+                end = prefix.find('.', start);
+                auto element = prefix.substr(start, end == utils::Str::npos ? end : end - start);
+                start = end + 1;
+                parent = parent->append_sub_pass("", element);
+            } while (end != utils::Str::npos);
+        }
+        add_described_passes(parent, group.at("passes"));
+
+        // Compile the shard.
+        auto files = manager.compile_in_memory(shard);
+
+        // Encode the result.
+        writer.write_uint(0, 1);
+        writer.write_str(ir::binary::to_string(shard));
+        auto output_dir = com::options::global["output_dir"].as_str() + "/";
+        writer.write_uint(files.size());
+        for (const auto &file : files) {
+            if (utils::starts_with(file.first, output_dir)) {
+                writer.write_uint(1, 1);
+                writer.write_str(file.first.substr(output_dir.size()));
+            } else {
+                writer.write_uint(0, 1);
+                writer.write_str(file.first);
+            }
+            writer.write_str(file.second);
+        }
+
+    } catch (std::exception &e) {
+        response.clear();
+        write_header(writer, RESPONSE_MAGIC);
+        writer.write_uint(1, 1);
+        writer.write_str(e.what());
+    }
+    return response;
+}
+
+/**
+ * Returns the transport selected by the transport option.
+ */
+CTransportRef Distribute::get_transport() const {
+    const auto &name = options["transport"].as_str();
+    if (name == "local") {
+        CTransportRef transport;
+        transport.emplace<LocalTransport>();
+        return transport;
+    }
+    std::lock_guard<std::mutex> lock{transports_mutex};
+    auto it = transports.find(name);
+    if (it == transports.end()) {
+        throw utils::Exception(
+            "unknown transport \"" + name + "\" for " + describe()
+        );
+    }
+    return it->second;
+}
+
+/**
+ * Returns the parsed workers option.
+ */
+utils::Vec<utils::Str> Distribute::get_workers() const {
+    utils::Vec<utils::Str> workers;
+    const auto &spec = options["workers"].as_str();
+    if (spec.empty()) {
+        return workers;
+    }
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = spec.find(',', start);
+        workers.push_back(spec.substr(start, end == utils::Str::npos ? end : end - start));
+        start = end + 1;
+    } while (end != utils::Str::npos);
+    return workers;
+}
+
+/**
+ * Writes the documentation for this pass group to the given stream.
+ */
+void Distribute::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass group runs its sub-passes separately for each kernel of the
+    program, possibly on other machines, in order to distribute the
+    compilation of very large programs. It is meant for the per-kernel part
+    of the compilation process, such as decomposition, mapping, and
+    scheduling; passes that need to see the whole program, such as the code
+    generation passes of the backends, should be placed after the group, such
+    that they operate on the merged program.
+
+    For each kernel, the group serializes a copy of the program that consists
+    of only that kernel, along with the platform and the type, name, and
+    explicitly-set options of the sub-passes, into a shard request. The
+    request is sent to a worker through the selected transport, which
+    compiles the shard with the same sub-passes, and returns the resulting
+    kernel and the files written by the sub-passes. The files are written to
+    the output directory, and the compiled kernels are merged back into the
+    program in their original order. Since each shard is compiled
+    separately, passes that consider multiple kernels at once do not see the
+    other kernels. The output products of each shard get their own filenames,
+    as the unique name of the program is suffixed with `_<index>` for the
+    shard of the kernel with that index. Because the kernels are merged
+    through the old IR, the program must not contain goto-based control flow.
+
+    The transport determines how requests reach the workers. The built-in
+    `local` transport serves them in the compiling process itself; other
+    transports can be registered from C++ using
+    `ql::pmgr::Distribute::register_transport()`, and must deliver each
+    request to a worker that passes it to `ql::pmgr::Distribute::serve()`.
+    Requests are assigned to the addresses listed in workers in a
+    round-robin fashion. Note that workers compile with their own global
+    options, and must run the same OpenQL version with the same passes
+    available.
+
+    The sub-passes consist of one pass for each type in pass_types, named
+    `pass0`, `pass1`, etc. If pass_types is empty, the group is empty, to be
+    populated using the pass management API.
+    )");
+}
+
+/**
+ * Builds the sub-passes from the pass_types option.
+ */
+pass_types::NodeType Distribute::on_construct(
+    const utils::Ptr<const Factory> &factory,
+    utils::List<PassRef> &passes,
+    condition::Ref &condition
+) {
+    const auto &spec = options["pass_types"].as_str();
+    if (spec.empty()) {
+        return pass_types::NodeType::GROUP_SHARDS;
+    }
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = spec.find(',', start);
+        auto pass_type = spec.substr(start, end == utils::Str::npos ? end : end - start);
+        start = end + 1;
+        passes.push_back(Factory::build_pass(
+            factory, pass_type, "pass" + utils::to_string(passes.size())
+        ));
+    } while (end != utils::Str::npos);
+    return pass_types::NodeType::GROUP_SHARDS;
+}
+
+/**
+ * Dummy implementation for compilation. Should never be called, as this pass
+ * group runs its sub-passes through run_shards().
+ */
+utils::Int Distribute::run_internal(
+    const ir::Ref &ir,
+    const pass_types::Context &context
+) const {
+    (void)ir;
+    (void)context;
+    QL_ASSERT(false);
+}
+
+/**
+ * Decodes the given shard response, writes the output files it contains, and
+ * returns the compiled shard converted to the old IR.
+ */
+static ir::compat::ProgramRef read_response(const utils::Str &response) {
+    utils::BinaryReader reader{response.data(), response.size(), "shard response"};
+    check_header(reader, RESPONSE_MAGIC, "shard response");
+    if (reader.read_uint(1)) {
+        throw utils::Exception(reader.read_str());
+    }
+    auto shard = ir::binary::read(reader.read_str());
+    auto output_dir = com::options::global["output_dir"].as_str() + "/";
+    auto num_files = reader.read_uint();
+    for (utils::UInt i = 0; i < num_files; i++) {
+        auto relative = reader.read_uint(1);
+        auto path = reader.read_str();
+        if (relative) {
+            path = output_dir + path;
+        }
+        utils::OutFile(path).write(reader.read_str());
+    }
+    return ir::convert_new_to_old(shard);
+}
+
+/**
+ * Sends each kernel of the program to a worker, and merges the compiled
+ * kernels back into the program.
+ */
+void Distribute::run_shards(
+    const ir::Ref &ir,
+    const pass_types::Context &context
+) const {
+    if (ir->program.empty() || ir->program->blocks.empty()) {
+        QL_IOUT("no kernels to distribute");
+        return;
+    }
+
+    // The shards are made from the new IR.
+    pass_types::flush_legacy_program(ir);
+
+    // Describe the sub-passes for the workers.
+    utils::Json group;
+    group["prefix"] = context.full_pass_name;
+    group["dnu"] = utils::Json::array();
+    group["passes"] = describe_passes(get_sub_passes(), group["dnu"]);
+
+    // Build the requests. Each shard consists of a fork of the program with
+    // only one of its blocks, so the statements are not copied.
+    auto fork = ir::fork_program(ir->program);
+    utils::Vec<ir::BlockRef> blocks{fork->blocks.begin(), fork->blocks.end()};
+    auto num_shards = blocks.size();
+    auto shard = ir.copy();
+    shard->program = fork;
+    utils::Vec<utils::Str> requests(num_shards);
+    for (utils::UInt i = 0; i < num_shards; i++) {
+        fork->blocks.reset();
+        fork->blocks.add(blocks[i]);
+        fork->entry_point = blocks[i];
+        blocks[i]->next.reset();
+        fork->unique_name = ir->program->unique_name + "_" + utils::to_string(i);
+        utils::BinaryWriter writer{requests[i]};
+        write_header(writer, REQUEST_MAGIC);
+        writer.write_json(group);
+        writer.write_str(ir::binary::to_string(shard));
+    }
+
+    // Send the requests to the workers. The responses are decoded as soon as
+    // they arrive.
+    auto transport = get_transport();
+    auto workers = get_workers();
+    utils::Vec<ir::compat::ProgramRef> programs(num_shards);
+    QL_IOUT(
+        "distributing " << num_shards << " kernel(s) using the "
+        << options["transport"].as_str() << " transport..."
+    );
+    utils::parallel_for(num_shards, options["shard_threads"].as_uint(), [&](utils::UInt i) {
+        auto worker = workers.empty() ? utils::Str() : workers[i % workers.size()];
+        try {
+            auto response = transport->submit(worker, requests[i]);
+            utils::Str().swap(requests[i]);
+            programs[i] = read_response(response);
+        } catch (utils::Exception &e) {
+            e.add_context("in shard for kernel \"" + blocks[i]->name + "\"");
+            throw;
+        }
+    });
+
+    // Merge the compiled kernels into the program of the first shard, in
+    // order. Kernel names are made unique again, as the names of the
+    // kernels generated for structured control flow are only unique within
+    // their shard.
+    auto merged = programs[0];
+    merged->name = ir->program->name;
+    merged->unique_name = ir->program->unique_name;
+    for (const auto &program : programs) {
+        merged->qubit_count = utils::max(merged->qubit_count, program->qubit_count);
+        merged->creg_count = utils::max(merged->creg_count, program->creg_count);
+        merged->breg_count = utils::max(merged->breg_count, program->breg_count);
+    }
+    utils::Set<utils::Str> kernel_names;
+    for (const auto &kernel : merged->kernels) {
+        kernel_names.insert(kernel->name);
+    }
+    for (utils::UInt i = 1; i < num_shards; i++) {
+        for (const auto &kernel : programs[i]->kernels) {
+            if (!kernel_names.insert(kernel->name).second) {
+                for (utils::UInt j = 1; true; j++) {
+                    auto unique_name = kernel->name + "_" + utils::to_string(j);
+                    if (kernel_names.insert(unique_name).second) {
+                        kernel->name = unique_name;
+                        break;
+                    }
+                }
+            }
+            kernel->platform = merged->platform;
+            merged->add(kernel);
+        }
+    }
+
+    // Convert the merged program back to the new IR.
+    auto merged_ir = ir::convert_old_to_new(merged);
+    ir->program = merged_ir->program;
+    ir->platform = merged_ir->platform;
+    ir->copy_annotations(*merged_ir);
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str Distribute::get_friendly_type() const {
+    return "Distribute";
+}
+
+/**
+ * Constructs the pass group.
+ */
+Distribute::Distribute(
+    const utils::Ptr<const Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pass_types::Base(pass_factory, instance_name, type_name) {
+    options.add_str(
+        "pass_types",
+        "Comma-separated list of the types of the passes that are run for "
+        "each kernel. If empty, the group is empty.",
+        ""
+    );
+    options.add_str(
+        "transport",
+        "The name of the transport used to send the kernels to the workers. "
+        "`local` compiles them in this process; other transports must be "
+        "registered from C++.",
+        "local"
+    );
+    options.add_str(
+        "workers",
+        "Comma-separated list of worker addresses, interpreted by the "
+        "transport. The kernels are assigned to them round-robin.",
+        ""
+    );
+    options.add_int(
+        "shard_threads",
+        "The maximum number of kernels that are sent to the workers "
+        "concurrently. 0 means use all hardware threads.",
+        "0",
+        0
+    );
+}
+
+} // namespace pmgr
+} // namespace ql
@@ -6,6 +6,9 @@
 
 #include "ql/utils/pair.h"
 #include "ql/pmgr/group.h"
+#include "ql/pmgr/alternatives.h"
+#include "ql/pmgr/sweep.h"
+#include "ql/pmgr/distribute.h"
 
 // Pass definition headers. This list should be generated at some point.
 #include "ql/pass/ana/visualize/circuit.h"
@@ -20,6 +23,9 @@
 #include "ql/pass/dec/generalize/generalize.h"
 #include "ql/pass/dec/specialize/specialize.h"
 #include "ql/pass/dec/structure/structure.h"
+#include "ql/pass/opt/cancel/cancel.h"
+#include "ql/pass/opt/fuse/fuse.h"
+#include "ql/pass/opt/const_fold/const_fold.h"
 #include "ql/pass/opt/clifford/optimize.h"
 #include "ql/pass/sch/schedule/schedule.h"
 #include "ql/pass/sch/list_schedule/list_schedule.h"
@@ -32,31 +38,49 @@ namespace ql {
 namespace pmgr {
 
 /**
- * Constructs a default pass factory for OpenQL.
+ * Returns the registrations for the default OpenQL passes. These are built
+ * on first use only, and then shared by all default factories.
  */
-Factory::Factory() {
-
-    // Default pass registration. This list should be generated at some point.
-    register_pass<::ql::pass::ana::visualize::circuit::Pass>("ana.visualize.Circuit");
-    register_pass<::ql::pass::ana::visualize::interaction::Pass>("ana.visualize.Interaction");
-    register_pass<::ql::pass::ana::visualize::mapping::Pass>("ana.visualize.Mapping");
-    register_pass<::ql::pass::ana::statistics::clean::Pass>("ana.statistics.Clean");
-    register_pass<::ql::pass::ana::statistics::report::Pass>("ana.statistics.Report");
-    register_pass<::ql::pass::io::cqasm::read::Pass>("io.cqasm.Read");
-    register_pass<::ql::pass::io::cqasm::report::Pass>("io.cqasm.Report");
-    register_pass<::ql::pass::io::sweep_points::write::Pass>("io.sweep_points.Write");
-    register_pass<::ql::pass::dec::instructions::Pass>("dec.Instructions");
-    register_pass<::ql::pass::dec::generalize::Pass>("dec.Generalize");
-    register_pass<::ql::pass::dec::specialize::Pass>("dec.Specialize");
-    register_pass<::ql::pass::dec::structure::Pass>("dec.Structure");
-    register_pass<::ql::pass::opt::clifford::optimize::Pass>("opt.clifford.Optimize");
-    register_pass<::ql::pass::sch::schedule::Pass>("sch.Schedule");
-    register_pass<::ql::pass::sch::list_schedule::Pass>("sch.ListSchedule");
-    //register_pass<::ql::pass::map::qubits::place_mip::Pass>("map.qubits.PlaceMIP"); // Broken: need half-decent IR for gates and virtual vs real qubit operands first.
-    register_pass<::ql::pass::map::qubits::map::Pass>("map.qubits.Map");
-    register_pass<::ql::arch::cc::pass::gen::vq1asm::Pass>("arch.cc.gen.VQ1Asm");
-    register_pass<::ql::arch::diamond::pass::gen::microcode::Pass>("arch.diamond.gen.Microcode");
+const Factory::Registrations &Factory::get_default_pass_types() {
+    static const Registrations DEFAULT_PASS_TYPES = [] {
+        Registrations registrations;
+
+        // Default pass registration. This list should be generated at some point.
+        add_pass_type<Alternatives>(registrations, "Alternatives");
+        add_pass_type<Sweep>(registrations, "Sweep");
+        add_pass_type<Distribute>(registrations, "Distribute");
+        add_pass_type<::ql::pass::ana::visualize::circuit::Pass>(registrations, "ana.visualize.Circuit");
+        add_pass_type<::ql::pass::ana::visualize::interaction::Pass>(registrations, "ana.visualize.Interaction");
+        add_pass_type<::ql::pass::ana::visualize::mapping::Pass>(registrations, "ana.visualize.Mapping");
+        add_pass_type<::ql::pass::ana::statistics::clean::Pass>(registrations, "ana.statistics.Clean");
+        add_pass_type<::ql::pass::ana::statistics::report::Pass>(registrations, "ana.statistics.Report");
+        add_pass_type<::ql::pass::io::cqasm::read::Pass>(registrations, "io.cqasm.Read");
+        add_pass_type<::ql::pass::io::cqasm::report::Pass>(registrations, "io.cqasm.Report");
+        add_pass_type<::ql::pass::io::sweep_points::write::Pass>(registrations, "io.sweep_points.Write");
+        add_pass_type<::ql::pass::dec::instructions::Pass>(registrations, "dec.Instructions");
+        add_pass_type<::ql::pass::dec::generalize::Pass>(registrations, "dec.Generalize");
+        add_pass_type<::ql::pass::dec::specialize::Pass>(registrations, "dec.Specialize");
+        add_pass_type<::ql::pass::dec::structure::Pass>(registrations, "dec.Structure");
+        add_pass_type<::ql::pass::opt::cancel::Pass>(registrations, "opt.Cancel");
+        add_pass_type<::ql::pass::opt::fuse::Pass>(registrations, "opt.Fuse");
+        add_pass_type<::ql::pass::opt::const_fold::Pass>(registrations, "opt.ConstFold");
+        add_pass_type<::ql::pass::opt::clifford::optimize::Pass>(registrations, "opt.clifford.Optimize");
+        add_pass_type<::ql::pass::sch::schedule::Pass>(registrations, "sch.Schedule");
+        add_pass_type<::ql::pass::sch::list_schedule::Pass>(registrations, "sch.ListSchedule");
+        //add_pass_type<::ql::pass::map::qubits::place_mip::Pass>(registrations, "map.qubits.PlaceMIP"); // Broken: need half-decent IR for gates and virtual vs real qubit operands first.
+        add_pass_type<::ql::pass::map::qubits::map::Pass>(registrations, "map.qubits.Map");
+        add_pass_type<::ql::arch::cc::pass::gen::vq1asm::Pass>(registrations, "arch.cc.gen.VQ1Asm");
+        add_pass_type<::ql::arch::diamond::pass::gen::microcode::Pass>(registrations, "arch.diamond.gen.Microcode");
+
+        return registrations;
+    }();
+    return DEFAULT_PASS_TYPES;
+}
 
+/**
+ * Constructs a default pass factory for OpenQL.
+ */
+Factory::Factory() : pass_types(get_default_pass_types()) {
 }
 
 /**
@@ -85,7 +109,7 @@ CFactoryRef Factory::configure(
     // NOTE: iterating over original pass_types to avoid iterator invalidation!
     for (const auto &pair : pass_types) {
         const auto &type_name = pair.first;
-        const auto &constructor_fn = pair.second;
+        const auto &registration = pair.second;
 
         // Iterate over the period-separated namespace elements of the type
         // name.
@@ -124,7 +148,7 @@ CFactoryRef Factory::configure(
 
         // Make a new entry if the original type name is in the dnu set.
         if (dnu.find(type_name) != dnu.end()) {
-            ref->pass_types.set(stripped_type_name) = constructor_fn;
+            ref->pass_types.set(stripped_type_name) = registration;
         }
 
     }
@@ -132,18 +156,18 @@ CFactoryRef Factory::configure(
     // Make shorthands for the selected architecture, if one is specified.
     if (!architecture.empty()) {
         auto prefix = "arch." + architecture;
-        utils::List<utils::Pair<utils::Str, ConstructorFn>> to_be_added;
+        utils::List<utils::Pair<utils::Str, Registration>> to_be_added;
         for (const auto &pair : ref->pass_types) {
             const auto &type_name = pair.first;
-            const auto &constructor_fn = pair.second;
+            const auto &registration = pair.second;
             if (type_name.rfind(prefix, 0) == 0) {
-                to_be_added.emplace_back(type_name.substr(prefix.size() + 1), constructor_fn);
+                to_be_added.emplace_back(type_name.substr(prefix.size() + 1), registration);
             }
         }
         for (const auto &pair : to_be_added) {
             const auto &type_name = pair.first;
-            const auto &constructor_fn = pair.second;
-            ref->pass_types.set(type_name) = constructor_fn;
+            const auto &registration = pair.second;
+            ref->pass_types.set(type_name) = registration;
         }
     }
 
@@ -167,7 +191,8 @@ PassRef Factory::build_pass(
     if (it == pass_factory->pass_types.end()) {
         throw utils::Exception("unknown pass type \"" + type_name + "\"");
     }
-    return (*it->second)(pass_factory, instance_name);
+    const auto &registration = it->second;
+    return registration.constructor(pass_factory, registration.type_name, instance_name);
 }
 
 /**
@@ -180,20 +205,23 @@ void Factory::dump_pass_types(
     const utils::Str &line_prefix
 ) {
 
-    // Gather all aliases for each particular pass type.
-    utils::Map<const ConstructorFn::Data*, utils::List<utils::Str>> aliases;
+    // Gather all aliases for each particular pass type, identified by the
+    // type name it was originally registered with.
+    utils::Map<utils::Str, utils::Pair<Registration, utils::List<utils::Str>>> aliases;
     for (const auto &pair : pass_factory->pass_types) {
         const auto &type_name = pair.first;
-        const auto &constructor_fn = pair.second;
-        aliases.set(constructor_fn.unwrap().get()).push_back(type_name);
+        const auto &registration = pair.second;
+        auto &entry = aliases.set(registration.type_name);
+        entry.first = registration;
+        entry.second.push_back(type_name);
     }
 
     // Sort pass types by full pass type name.
     utils::Map<utils::Str, utils::Pair<PassRef, utils::List<utils::Str>>> pass_types;
     for (const auto &pair : aliases) {
-        const auto *constructor_fn_ptr = pair.first;
-        const auto &type_aliases = pair.second;
-        auto pass = (*constructor_fn_ptr)(pass_factory, "");
+        const auto &registration = pair.second.first;
+        const auto &type_aliases = pair.second.second;
+        auto pass = registration.constructor(pass_factory, registration.type_name, "");
         const auto &full_type_name = pass->get_type();
         QL_ASSERT(pass_types.find(full_type_name) == pass_types.end());
         pass_types.set(full_type_name) = {pass, type_aliases};
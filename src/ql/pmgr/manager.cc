@@ -4,10 +4,18 @@
 
 #include "ql/pmgr/manager.h"
 
+#include <mutex>
 #include "ql/utils/filesystem.h"
+#include "ql/utils/arena.h"
+#include "ql/utils/accounting.h"
+#include "ql/utils/async_output.h"
+#include "ql/utils/budget.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/trace.h"
 #include "ql/com/options.h"
 #include "ql/arch/architecture.h"
 #include "ql/ir/cqasm/write.h"
+#include "ql/pmgr/pass_types/specializations.h"
 
 namespace ql {
 namespace pmgr {
@@ -884,24 +892,162 @@ void Manager::clear_passes() {
     return root->clear_sub_passes();
 }
 
+/**
+ * Mutex used to serialize pass construction, such that multiple threads may
+ * compile using the same pass manager.
+ */
+static std::mutex construct_mutex;
+
 /**
  * Constructs all passes recursively. This freezes the pass options, but
  * allows subtrees to be modified.
  */
 void Manager::construct() {
+    std::lock_guard<std::mutex> lock{construct_mutex};
     root->construct_recursive();
 }
 
 /**
- * Executes this pass or pass group on the given platform and program.
+ * Runs the passes on the given program, assuming that they have already been
+ * constructed.
+ */
+void Manager::run_passes(const ir::Ref &ir) const {
+    QL_TRACE_SCOPE("pmgr.compile");
+
+    // Allocate the nodes created by the passes from an arena if requested.
+    // The arena is kept alive by the nodes allocated from it, so it is
+    // released when the IR is.
+    utils::ArenaRef arena;
+    if (com::options::global["ir_arena"].as_bool()) {
+        arena.emplace();
+    }
+    utils::UseArena use_arena{arena};
+
+    // Hand side outputs (reports, DOT graphs, etc.) off to a background
+    // thread if requested. They are flushed before returning, so they are
+    // complete when compilation finishes.
+    utils::Opt<utils::AsyncOutput> async_output;
+    if (com::options::global["async_output"].as_bool()) {
+        async_output.emplace(
+            com::options::global["async_output_queue_limit"].as_uint() * 1024 * 1024
+        );
+    }
+
+    // Impose the compile-time budget, if any. Expensive algorithms observe it
+    // by degrading to cheaper strategies; nothing is interrupted.
+    auto max_compile_time = com::options::global["max_compile_time"].as_real();
+    utils::TimeBudget budget{max_compile_time};
+
+    // Compile the program, profiling the passes (and counting allocations)
+    // and using the pass cache if requested.
+    utils::Opt<utils::AccountAllocations> account_allocations;
+    ProfilerRef profiler;
+    if (com::options::global["profile_passes"].as_bool()) {
+        if (com::options::global["profile_allocations"].as_bool()) {
+            account_allocations.emplace();
+        }
+        profiler.emplace();
+    }
+    PassCacheRef cache;
+    const auto &cache_dir = com::options::global["pass_cache_dir"].as_str();
+    if (!cache_dir.empty()) {
+        cache.emplace(cache_dir);
+    }
+    utils::Opt<pass_types::DeferredPasses> deferred;
+    if (com::options::global["defer_reports"].as_bool()) {
+        deferred.emplace();
+    }
+    root->compile(ir, "", profiler, cache);
+
+    // Wait for the passes that were deferred to complete.
+    if (deferred.has_value()) {
+        deferred->wait();
+    }
+
+    // If the last passes were legacy passes, the new IR may still need to be
+    // regenerated from the old IR they operated on.
+    pass_types::flush_legacy_program(ir);
+
+    // Write the profiling reports, and the compile report if a compile-time
+    // budget was imposed or any pass degraded due to its own budget.
+    utils::Str prefix = com::options::global["output_dir"].as_str() + "/";
+    if (!ir->program.empty()) {
+        prefix += ir->program->unique_name + "_";
+    }
+    if (profiler.has_value()) {
+        utils::AsyncOutFile(prefix + "pass_profile.json") << profiler->to_json().dump(4) << "\n";
+        utils::AsyncOutFile(prefix + "pass_trace.json") << profiler->to_trace_json().dump() << "\n";
+    }
+    if (max_compile_time > 0.0 || !budget.get_degradations().empty()) {
+        utils::AsyncOutFile(prefix + "compile_report.json") << budget.to_json().dump(4) << "\n";
+    }
+
+    // Wait for the side outputs to be written, reporting any I/O errors.
+    if (async_output.has_value()) {
+        async_output->flush();
+    }
+
+}
+
+/**
+ * Ensures that all passes have been constructed, and then runs the passes
+ * on the given program. The global options are frozen while this runs.
+ * Multiple threads may compile different programs using the same pass
+ * manager concurrently, as long as the pass tree is not modified.
  */
 void Manager::compile(const ir::Ref &ir) {
 
     // Ensure that all passes are constructed.
     construct();
 
-    // Compile the program.
-    root->compile(ir, "");
+    // Compile the program. The global options are frozen while doing so,
+    // because the Python bindings release the GIL during compilation, so
+    // another Python thread could otherwise change them under our feet.
+    com::options::Freeze freeze;
+    run_passes(ir);
+
+    // Make sure the log output of the compilation is complete when we return.
+    utils::logger::flush();
+
+}
+
+/**
+ * Like compile(), but collects the files that the passes would write in
+ * memory instead of writing them to disk, and returns them, keyed by the path
+ * they would have been written to (usually starting with the output_dir
+ * option). Files that passes read back during compilation are read from
+ * memory as well, while cache entries are still written to disk. Bitmap
+ * images written by the visualizer are not captured.
+ */
+utils::Map<utils::Str, utils::Str> Manager::compile_in_memory(const ir::Ref &ir) {
+    utils::OutputCapture capture;
+    compile(ir);
+    return capture.get_files();
+}
+
+/**
+ * Ensures that all passes have been constructed, and then runs the passes
+ * on each of the given programs, compiling up to num_threads programs
+ * concurrently. 0 means use all hardware threads. The pass tree is shared
+ * between the programs and must not be modified while this runs, and the
+ * global options are frozen until all programs have been compiled. If
+ * compilation of one or more programs fails, the exception for the first
+ * failing program is rethrown once all threads are done.
+ */
+void Manager::compile_batch(const utils::Vec<ir::Ref> &irs, utils::UInt num_threads) {
+
+    // Ensure that all passes are constructed. This must happen before we
+    // start any threads, because construction modifies the pass tree.
+    construct();
+
+    // Compile the programs.
+    com::options::Freeze freeze;
+    utils::parallel_for(irs.size(), num_threads, [this, &irs](utils::UInt i) {
+        run_passes(irs[i]);
+    });
+
+    // Make sure the log output of the compilation is complete when we return.
+    utils::logger::flush();
 
 }
 
@@ -0,0 +1,152 @@
+/** \file
+ * Defines the on-disk pass result cache, used by the pass manager to skip
+ * passes that were already run on identical input before.
+ */
+
+#include "ql/pmgr/pass_cache.h"
+
+#include <cstdio>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include "ql/version.h"
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/ir/cqasm/read.h"
+#include "ql/ir/cqasm/write.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Returns the cQASM representation of the given IR that is used both for
+ * hashing and for storing cache entries.
+ */
+static utils::Str to_cqasm(const ir::Ref &ir) {
+    ir::cqasm::WriteOptions options;
+    options.include_platform = true;
+    options.include_metadata = true;
+    options.include_timing = true;
+    utils::StrStrm ss;
+    ir::cqasm::write(ir, options, ss);
+    return ss.str();
+}
+
+/**
+ * Updates a 64-bit FNV-1a hash with the given data, including a terminator
+ * such that the boundaries between consecutive strings affect the hash.
+ */
+static void fnv1a(utils::UInt &hash, const utils::Str &data) {
+    for (auto c : data) {
+        hash ^= (unsigned char)c;
+        hash *= 0x100000001B3ull;
+    }
+    hash ^= 0xFF;
+    hash *= 0x100000001B3ull;
+}
+
+/**
+ * Returns the filename for the entry with the given key.
+ */
+utils::Str PassCache::get_entry_path(const utils::Str &key) const {
+    return directory + "/" + key + ".json";
+}
+
+/**
+ * Constructs a cache that stores its entries in the given directory. The
+ * directory is created when the first entry is written, if it does not
+ * already exist.
+ */
+PassCache::PassCache(const utils::Str &directory) : directory(directory) {
+}
+
+/**
+ * Computes the cache key for running a pass of the given type and with
+ * the given options on the given IR.
+ */
+utils::Str PassCache::make_key(
+    const ir::Ref &ir,
+    const utils::Str &type_name,
+    const utils::Options &options
+) {
+    utils::StrStrm options_ss;
+    options.dump_options(false, options_ss);
+    auto cqasm = to_cqasm(ir);
+
+    // Hash everything twice with different offset bases, to get a 128-bit key;
+    // a collision would silently yield the wrong program.
+    utils::UInt hashes[2] = {0xCBF29CE484222325ull, 0x84222325CBF29CE4ull};
+    for (auto &hash : hashes) {
+        fnv1a(hash, OPENQL_VERSION_STRING);
+        fnv1a(hash, type_name);
+        fnv1a(hash, options_ss.str());
+        fnv1a(hash, cqasm);
+    }
+    utils::StrStrm key;
+    key << std::hex << std::setfill('0');
+    key << std::setw(16) << hashes[0] << std::setw(16) << hashes[1];
+    return key.str();
+}
+
+/**
+ * Looks up the entry for the given key. If it exists, ir->program is
+ * replaced with the cached result, retval is set to the cached return
+ * value, and true is returned. Otherwise, the IR is not modified and
+ * false is returned.
+ */
+utils::Bool PassCache::restore(
+    const utils::Str &key,
+    const ir::Ref &ir,
+    utils::Int &retval
+) const {
+    auto path = get_entry_path(key);
+    if (!utils::is_file(path)) {
+        return false;
+    }
+    auto entry = utils::parse_json(utils::InFile(path).read());
+    ir::cqasm::ReadOptions read_options;
+    read_options.schedule_mode = ir::cqasm::ScheduleMode::KEEP;
+    ir::cqasm::read(ir, entry["cqasm"].get<utils::Str>(), path, read_options);
+    retval = entry["retval"].get<utils::Int>();
+    return true;
+}
+
+/**
+ * Stores the given IR and return value as the entry for the given key.
+ */
+void PassCache::store(
+    const utils::Str &key,
+    const ir::Ref &ir,
+    utils::Int retval
+) const {
+    utils::Json entry = {
+        {"retval", retval},
+        {"cqasm", to_cqasm(ir)}
+    };
+
+    // Write to a temporary file that is unique to this thread and process
+    // first, and then move it into place, such that readers never see partial
+    // entries.
+    auto path = get_entry_path(key);
+    utils::StrStrm tmp_path;
+    tmp_path << path << ".tmp" << std::this_thread::get_id() << "_" << std::random_device()();
+    utils::WithoutOutputCapture without_capture;
+    {
+        utils::OutFile file{tmp_path.str()};
+        file << entry.dump() << "\n";
+        file.close();
+    }
+    auto wd = utils::get_working_directory();
+    auto from = utils::path_relative_to(wd, tmp_path.str());
+    auto to = utils::path_relative_to(wd, path);
+    if (std::rename(from.c_str(), to.c_str())) {
+        std::remove(to.c_str());
+        if (std::rename(from.c_str(), to.c_str())) {
+            std::remove(from.c_str());
+            QL_WOUT("failed to store pass cache entry " << path);
+        }
+    }
+}
+
+} // namespace pmgr
+} // namespace ql
@@ -5,16 +5,136 @@
 #include "ql/pmgr/pass_types/base.h"
 
 #include <cctype>
+#include <exception>
+#include <functional>
+#include <mutex>
 #include <regex>
 #include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
+#include "ql/utils/trace.h"
+#include "ql/utils/parallel.h"
+#include "ql/ir/binary.h"
+#include "ql/ir/gc.h"
+#include "ql/ir/ops.h"
+#include "ql/ir/old_to_new.h"
 #include "ql/ir/cqasm/write.h"
+#include "ql/com/options.h"
 #include "ql/pmgr/manager.h"
+#include "ql/pmgr/pass_types/specializations.h"
 #include "ql/pass/ana/statistics/report.h"
+#include "ql/pass/ana/statistics/annotations.h"
+#include "ql/arch/diamond/annotations.h"
 
 namespace ql {
 namespace pmgr {
 namespace pass_types {
 
+/**
+ * The number of pending passes and the first error, shared with the tasks.
+ */
+struct DeferredPasses::State {
+
+    /**
+     * Mutex protecting everything below.
+     */
+    std::mutex mutex;
+
+    /**
+     * The number of passes that were submitted but haven't completed yet.
+     */
+    utils::UInt pending = 0;
+
+    /**
+     * The first exception thrown by a deferred pass that hasn't been reported
+     * yet, if any.
+     */
+    std::exception_ptr error;
+
+};
+
+/**
+ * The innermost scope that is open on this thread.
+ */
+static thread_local DeferredPasses *active_deferred_passes = nullptr;
+
+/**
+ * Opens a scope on the calling thread.
+ */
+DeferredPasses::DeferredPasses() : previous(active_deferred_passes) {
+    state.emplace();
+    active_deferred_passes = this;
+}
+
+/**
+ * Closes the scope, waiting for any passes that are still pending. Errors that
+ * were not yet reported by wait() are logged.
+ */
+DeferredPasses::~DeferredPasses() {
+    active_deferred_passes = previous;
+    try {
+        wait();
+    } catch (std::exception &e) {
+        QL_EOUT("deferred pass failed: " << e.what());
+    } catch (...) {
+        QL_EOUT("deferred pass failed with an unknown exception");
+    }
+}
+
+/**
+ * Returns the innermost scope that is open on the calling thread, or nullptr
+ * if there is none.
+ */
+DeferredPasses *DeferredPasses::get_active() {
+    return active_deferred_passes;
+}
+
+/**
+ * Submits a deferred pass to the thread pool.
+ */
+void DeferredPasses::submit(std::function<void()> &&task) {
+    auto shared = state;
+    {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        shared->pending++;
+    }
+    utils::ThreadPool::get().submit([shared, task]() {
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock{shared->mutex};
+            if (error && !shared->error) {
+                shared->error = error;
+            }
+            shared->pending--;
+        }
+        utils::ThreadPool::get().notify();
+    });
+}
+
+/**
+ * Waits for all deferred passes to complete, running pending tasks in the
+ * meantime. If any of them threw an exception, the first one is rethrown.
+ */
+void DeferredPasses::wait() {
+    auto shared = state;
+    utils::ThreadPool::get().wait_until([shared]() {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        return shared->pending == 0;
+    });
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock{shared->mutex};
+        std::swap(error, shared->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
 /**
  * Returns whether the given user-specified name is a valid pass name.
  */
@@ -162,7 +282,9 @@ Base::Base(
         "`%D` is substituted with the fully-qualified name of the pass, using "
         "slashes as hierarchy separators. "
         "Any directories that don't exist will be created as soon as an output "
-        "file is written.",
+        "file is written. An empty prefix disables the output: passes whose "
+        "only products are output files, such as reports and non-interactive "
+        "visualizers, are then skipped altogether.",
         "%N.%P"
     );
     options.add_enum(
@@ -192,6 +314,78 @@ utils::Bool Base::is_legacy() const {
     return false;
 }
 
+/**
+ * Returns whether the pass manager may restore the result of this pass from
+ * the pass cache rather than running it. This requires that, with the
+ * configured options, the pass is deterministic, its result depends only on
+ * the input IR (including the platform) and its options, and it has no
+ * effects other than modifying the IR and returning its return value.
+ * Returns false unless overridden.
+ */
+utils::Bool Base::is_cacheable() const {
+    return false;
+}
+
+/**
+ * Returns the analyses (see ql/pmgr/analyses.h) whose annotations remain valid
+ * after this pass runs, such that later passes may use them. The pass manager
+ * frees the annotations of all other analyses after running the pass. Only
+ * used for passes that operate on the new IR. Returns analysis::NONE unless
+ * overridden.
+ */
+Analyses Base::get_preserved_analyses() const {
+    return analysis::NONE;
+}
+
+/**
+ * Returns the products (see ql/pmgr/products.h) of this pass with its current
+ * options. A pass whose only products are output files (and the statistics
+ * reported in them) is skipped when its output_prefix option is empty, and may
+ * be deferred when the defer_reports global option is set. Returns
+ * product::ALL unless overridden.
+ */
+Products Base::get_products() const {
+    return product::ALL;
+}
+
+/**
+ * Returns the maximum number of threads that GROUP_SELECT and GROUP_INSTANCES
+ * nodes may use to run their alternatives or instances concurrently, with 0
+ * meaning all hardware threads. Returns 1 unless overridden.
+ */
+utils::UInt Base::get_num_alternative_threads() const {
+    return 1;
+}
+
+/**
+ * Returns the number of instances of a GROUP_INSTANCES node. Returns 0 unless
+ * overridden.
+ */
+utils::UInt Base::get_num_instances() const {
+    return 0;
+}
+
+/**
+ * Prepares the given copy of the IR for the given instance of a
+ * GROUP_INSTANCES node, before the sub-passes are run on it. Does nothing
+ * unless overridden.
+ */
+void Base::instantiate(const ir::Ref &ir, utils::UInt index) const {
+    (void)ir;
+    (void)index;
+}
+
+/**
+ * Runs the sub-passes of a GROUP_SHARDS node on each kernel of the given
+ * program, and merges the results back into the IR. Must be overridden by
+ * passes that construct into a GROUP_SHARDS node.
+ */
+void Base::run_shards(const ir::Ref &ir, const Context &context) const {
+    (void)ir;
+    (void)context;
+    QL_ASSERT(false);
+}
+
 /**
  * Returns `pass "<name>"` for normal passes and `root` for the root pass.
  * Used for error messages.
@@ -288,6 +482,15 @@ void Base::dump_strategy(
             case NodeType::GROUP_REPEAT_UNTIL_NOT:
                 os << first_indent << "repeat:\n";
                 break;
+            case NodeType::GROUP_SELECT:
+                os << first_indent << "best of:\n";
+                break;
+            case NodeType::GROUP_INSTANCES:
+                os << first_indent << "for " << get_num_instances() << " instance(s):\n";
+                break;
+            case NodeType::GROUP_SHARDS:
+                os << first_indent << "for each kernel:\n";
+                break;
             default:
                 if (!is_root()) {
                     os << first_indent << "passes:\n";
@@ -524,6 +727,9 @@ void Base::construct() {
             QL_ASSERT(!constructed_condition.has_value());
             break;
         case NodeType::GROUP:
+        case NodeType::GROUP_SELECT:
+        case NodeType::GROUP_INSTANCES:
+        case NodeType::GROUP_SHARDS:
             QL_ASSERT(!constructed_condition.has_value());
             break;
         case NodeType::GROUP_IF:
@@ -587,7 +793,10 @@ utils::Bool Base::is_group() const {
     return node_type == NodeType::GROUP
         || node_type == NodeType::GROUP_IF
         || node_type == NodeType::GROUP_WHILE
-        || node_type == NodeType::GROUP_REPEAT_UNTIL_NOT;
+        || node_type == NodeType::GROUP_REPEAT_UNTIL_NOT
+        || node_type == NodeType::GROUP_SELECT
+        || node_type == NodeType::GROUP_INSTANCES
+        || node_type == NodeType::GROUP_SHARDS;
 }
 
 /**
@@ -999,41 +1208,259 @@ void Base::handle_debugging(
 ) {
     utils::Str in_or_out = after_pass ? "out" : "in";
     auto debug_opt = options["debug"].as_str();
+    if (debug_opt != "no") {
+        sync_legacy_program(ir);
+    }
     if (debug_opt == "yes") {
         ir->dump_seq(
-            utils::OutFile(context.output_prefix + "_debug_" + in_or_out + ".ir").unwrap()
+            utils::AsyncOutFile(context.output_prefix + "_debug_" + in_or_out + ".ir").unwrap()
         );
         ir::cqasm::WriteOptions write_options;
         write_options.include_statistics = true;
         ir::cqasm::write(
             ir, write_options,
-            utils::OutFile(context.output_prefix + "_debug_" + in_or_out + ".cq").unwrap()
+            utils::AsyncOutFile(context.output_prefix + "_debug_" + in_or_out + ".cq").unwrap()
         );
     }
     if (debug_opt == "stats" || debug_opt == "both") {
         pass::ana::statistics::report::dump_all(
             ir,
-            utils::OutFile(context.output_prefix + "_" + in_or_out + ".report").unwrap()
+            utils::AsyncOutFile(context.output_prefix + "_" + in_or_out + ".report").unwrap()
         );
     }
     if (debug_opt == "qasm" || debug_opt == "both") {
         ir::cqasm::write(
             ir, {},
-            utils::OutFile(context.output_prefix + "_" + in_or_out + ".qasm").unwrap()
+            utils::AsyncOutFile(context.output_prefix + "_" + in_or_out + ".qasm").unwrap()
         );
     }
 }
 
+/**
+ * Returns whether this pass is dead, i.e. whether the only products of the
+ * pass are output files (and the statistics reported in them), while its
+ * output_prefix option routes them nowhere by being empty.
+ */
+utils::Bool Base::is_dead() const {
+    auto products = get_products();
+    return (
+        (products & product::FILES) &&
+        !(products & (product::PROGRAM | product::INTERACTIVE)) &&
+        options["output_prefix"].as_str().empty()
+    );
+}
+
+/**
+ * Called instead of the main pass implementation when the pass is dead.
+ * Discards the statistics that the pass would have reported, if any.
+ */
+void Base::skip_dead_pass(const ir::Ref &ir, const Context &context) const {
+    QL_IOUT("skipping pass \"" << context.full_pass_name << "\" of type \"" << type_name << "\", because its output is disabled");
+    if (get_products() & product::STATISTICS) {
+        using pass::ana::statistics::AdditionalStats;
+        flush_legacy_program(ir);
+        if (!ir->program.empty()) {
+            for (const auto &block : ir->program->blocks) {
+                AdditionalStats::pop(block);
+            }
+            AdditionalStats::pop(ir->program);
+        }
+    }
+}
+
+/**
+ * Visitor that lists all the nodes in a tree, in the order of the recursive
+ * visitor.
+ */
+class NodeLister : public ir::RecursiveVisitor {
+public:
+
+    /**
+     * The nodes encountered thus far.
+     */
+    utils::Vec<utils::RawPtr<ir::Node>> nodes;
+
+    /**
+     * Called once for every node in the tree.
+     */
+    void visit_node(ir::Node &node) override {
+        nodes.push_back(&node);
+    }
+
+};
+
+/**
+ * Snapshot of the annotations of an IR tree that a binary round trip (see
+ * ir/binary.h) would lose, to be applied to the copies obtained that way.
+ * Only annotations that are plain data are carried over. The analyses and the
+ * indices of the platform refer to nodes of the original tree, and are
+ * rebuilt when needed, as is the old-IR program cache, which is flushed
+ * before the IR is serialized. The snapshot stores its own copies of the
+ * annotation objects, so the original tree may be modified afterwards, and it
+ * may be applied to any number of copies concurrently.
+ */
+class AnnotationSnapshot {
+private:
+
+    /**
+     * A captured annotation: the index of the node it belongs to in the order
+     * of NodeLister, and a function that attaches a copy of it to a node.
+     */
+    struct Entry {
+        utils::UInt node;
+        std::function<void(ir::Node&)> apply;
+    };
+
+    /**
+     * The number of nodes in the original tree.
+     */
+    utils::UInt num_nodes;
+
+    /**
+     * The captured annotations.
+     */
+    utils::Vec<Entry> entries;
+
+    /**
+     * Captures the annotation of type T of the given node, if it has one.
+     */
+    template <class T>
+    void capture(utils::UInt index, ir::Node &node) {
+        auto annotation = node.get_annotation_ptr<T>();
+        if (annotation) {
+            auto value = std::make_shared<const T>(*annotation);
+            entries.push_back({index, [value](ir::Node &target) {
+                target.set_annotation<T>(*value);
+            }});
+        }
+    }
+
+public:
+
+    /**
+     * Takes a snapshot of the annotations of the given tree.
+     */
+    explicit AnnotationSnapshot(const ir::Ref &ir) {
+        NodeLister lister;
+        ir->visit(lister);
+        num_nodes = lister.nodes.size();
+        for (utils::UInt i = 0; i < num_nodes; i++) {
+            auto &node = *lister.nodes[i];
+            capture<ir::ObjectUsage>(i, node);
+            capture<ir::KernelName>(i, node);
+            capture<ir::KernelCyclesValid>(i, node);
+            capture<ir::PrototypeInferred>(i, node);
+            capture<ir::GeneratedInstructionType>(i, node);
+            capture<pass::ana::statistics::AdditionalStats>(i, node);
+            capture<arch::diamond::annotations::ExciteMicrowaveParameters>(i, node);
+            capture<arch::diamond::annotations::MemSwapParameters>(i, node);
+            capture<arch::diamond::annotations::QEntangleParameters>(i, node);
+            capture<arch::diamond::annotations::SweepBiasParameters>(i, node);
+            capture<arch::diamond::annotations::CRCParameters>(i, node);
+            capture<arch::diamond::annotations::RabiParameters>(i, node);
+        }
+    }
+
+    /**
+     * Applies the snapshot to the given copy of the original tree.
+     */
+    void apply(const ir::Ref &copy) const {
+        NodeLister lister;
+        copy->visit(lister);
+        QL_ASSERT(lister.nodes.size() == num_nodes);
+        for (const auto &entry : entries) {
+            entry.apply(*lister.nodes[entry.node]);
+        }
+    }
+
+};
+
+/**
+ * Copies the given IR via a binary round trip, restoring the annotations
+ * given by the snapshot of the original.
+ */
+static ir::Ref copy_ir(const utils::Str &serialized, const AnnotationSnapshot &annotations) {
+    auto copy = ir::binary::read(serialized);
+    annotations.apply(copy);
+    return copy;
+}
+
+/**
+ * Defers the main pass implementation to the active DeferredPasses scope if
+ * there is one and the only products of the pass are output files. Returns
+ * whether the pass was deferred.
+ */
+utils::Bool Base::defer_main_pass(const ir::Ref &ir, const Context &context) const {
+    auto deferred = DeferredPasses::get_active();
+    if (!deferred || is_legacy() || get_products() != product::FILES) {
+        return false;
+    }
+
+    // The pass runs on a copy of the IR, as the IR may be modified by the
+    // passes that follow while the deferred pass is still running. A binary
+    // round trip yields a fully independent tree; only serializing it and
+    // taking a snapshot of its annotations is done inline.
+    flush_legacy_program(ir);
+    auto serialized = ir::binary::to_string(ir);
+    auto annotations = std::make_shared<const AnnotationSnapshot>(ir);
+    QL_IOUT("deferring pass \"" << context.full_pass_name << "\" of type \"" << type_name << "\"");
+    deferred->submit([this, serialized, annotations, context]() {
+        run_main_pass(copy_ir(serialized, *annotations), context, {});
+    });
+    return true;
+}
+
 /**
  * Wrapper around running the main pass implementation for this pass, taking
  * care of logging, profiling, etc.
  */
 utils::Int Base::run_main_pass(
     const ir::Ref &ir,
-    const Context &context
+    const Context &context,
+    const PassCacheRef &cache
 ) const {
     QL_IOUT("starting pass \"" << context.full_pass_name << "\" of type \"" << type_name << "\"...");
+    QL_TRACE_SCOPE(context.full_pass_name);
+
+    // Passes that operate on the new IR need it to be up to date, and
+    // invalidate the old-IR program cached for legacy passes because they may
+    // modify it. The pass cache hashes and stores the new IR, so that also
+    // needs to be up to date when the pass cache is used.
+    utils::Bool use_cache = cache.has_value() && is_cacheable();
+    if (!is_legacy() || use_cache) {
+        flush_legacy_program(ir);
+    }
+
+    // Try to restore the result of the pass from the cache.
+    utils::Str cache_key;
+    if (use_cache) {
+        cache_key = PassCache::make_key(ir, type_name, options);
+        utils::Int retval;
+        if (cache->restore(cache_key, ir, retval)) {
+            QL_IOUT("restored result of pass \"" << context.full_pass_name << "\" from cache; return value is " << retval);
+            return retval;
+        }
+    }
+
     auto retval = run_internal(ir, context);
+
+    // Free the analyses that the pass doesn't preserve, so they don't
+    // accumulate in the IR. Legacy passes don't touch the annotations of the
+    // new IR, and the new IR is regenerated after them anyway. The same goes
+    // for the temporaries and instruction types that the pass left unused.
+    if (!is_legacy()) {
+        free_analyses(ir, analysis::ALL & ~get_preserved_analyses());
+        ir::collect_garbage_if_needed(
+            ir, com::options::global["gc_threshold"].as_uint()
+        );
+    }
+
+    // Store the result of the pass in the cache.
+    if (use_cache) {
+        sync_legacy_program(ir);
+        cache->store(cache_key, ir, retval);
+    }
+
     QL_IOUT("completed pass \"" << context.full_pass_name << "\"; return value is " << retval);
     return retval;
 }
@@ -1044,20 +1471,120 @@ utils::Int Base::run_main_pass(
  */
 void Base::run_sub_passes(
     const ir::Ref &ir,
-    const Context &context
+    const Context &context,
+    const ProfilerRef &profiler,
+    const PassCacheRef &cache
 ) const {
     utils::Str sub_prefix = context.full_pass_name.empty() ? "" : (context.full_pass_name + ".");
     for (const auto &pass : sub_pass_order) {
-        pass->compile(ir, sub_prefix);
+        pass->compile(ir, sub_prefix, profiler, cache);
     }
 }
 
 /**
- * Executes this pass or pass group on the given platform and program.
+ * Runs each sub-pass on its own copy of the IR, scores the copies using the
+ * main pass, and replaces the IR with the best copy. Used for GROUP_SELECT
+ * nodes.
+ */
+void Base::run_alternatives(
+    const ir::Ref &ir,
+    const Context &context,
+    const ProfilerRef &profiler,
+    const PassCacheRef &cache
+) const {
+    if (sub_pass_order.empty()) {
+        QL_IOUT("no alternatives to select from");
+        return;
+    }
+
+    // The copies are made from the new IR, so none of them shares a cached
+    // old-IR program. A binary round trip yields a fully independent tree,
+    // including the links between its nodes; the annotations it doesn't store
+    // are restored from a snapshot.
+    flush_legacy_program(ir);
+    auto serialized = ir::binary::to_string(ir);
+    AnnotationSnapshot annotations{ir};
+
+    // Run the alternatives. The profiler is not thread-safe, so it only
+    // records the alternatives when they are run sequentially.
+    utils::Vec<Ref> alternatives{sub_pass_order.begin(), sub_pass_order.end()};
+    auto num_alternatives = alternatives.size();
+    auto num_threads = get_num_alternative_threads();
+    auto sequential = utils::resolve_num_threads(num_threads) <= 1 || num_alternatives <= 1;
+    utils::Str sub_prefix = context.full_pass_name.empty() ? "" : (context.full_pass_name + ".");
+    utils::Vec<ir::Ref> copies(num_alternatives);
+    utils::Vec<utils::Int> scores(num_alternatives);
+    QL_IOUT("running " << num_alternatives << " alternative(s)...");
+    utils::parallel_for(num_alternatives, num_threads, [&](utils::UInt i) {
+        copies[i] = copy_ir(serialized, annotations);
+        alternatives[i]->compile(copies[i], sub_prefix, sequential ? profiler : ProfilerRef(), cache);
+        scores[i] = run_main_pass(copies[i], context, cache);
+    });
+
+    // Select the alternative with the lowest score, preferring the first in
+    // case of a tie.
+    utils::UInt best = 0;
+    for (utils::UInt i = 0; i < num_alternatives; i++) {
+        QL_IOUT("alternative \"" << alternatives[i]->get_name() << "\" scored " << scores[i]);
+        if (scores[i] < scores[best]) {
+            best = i;
+        }
+    }
+    QL_IOUT("selected alternative \"" << alternatives[best]->get_name() << "\"");
+
+    // Commit the selected copy.
+    const auto &selected = copies[best];
+    ir->program = selected->program;
+    ir->platform = selected->platform;
+    ir->copy_annotations(*selected);
+}
+
+/**
+ * Runs the main pass, and then runs the sub-passes on a copy of the IR for
+ * each instance. Used for GROUP_INSTANCES nodes.
+ */
+void Base::run_instances(
+    const ir::Ref &ir,
+    const Context &context,
+    const ProfilerRef &profiler,
+    const PassCacheRef &cache
+) const {
+    run_main_pass(ir, context, cache);
+    auto num_instances = get_num_instances();
+    if (num_instances == 0 || sub_pass_order.empty()) {
+        QL_IOUT("no instances to run");
+        return;
+    }
+
+    // Like for alternatives, the copies are made via a binary round trip of
+    // the new IR.
+    flush_legacy_program(ir);
+    auto serialized = ir::binary::to_string(ir);
+    AnnotationSnapshot annotations{ir};
+
+    // Run the instances. The profiler is not thread-safe, so it only records
+    // the instances when they are run sequentially.
+    auto num_threads = get_num_alternative_threads();
+    auto sequential = utils::resolve_num_threads(num_threads) <= 1 || num_instances <= 1;
+    QL_IOUT("running " << num_instances << " instance(s)...");
+    utils::parallel_for(num_instances, num_threads, [&](utils::UInt i) {
+        auto copy = copy_ir(serialized, annotations);
+        instantiate(copy, i);
+        run_sub_passes(copy, context, sequential ? profiler : ProfilerRef(), cache);
+    });
+}
+
+/**
+ * Executes this pass or pass group on the given program. If a profiler is
+ * specified, the execution of this pass and all its sub-passes is recorded
+ * with it. If a pass cache is specified, the results of cacheable passes are
+ * restored from it when possible, and stored in it otherwise.
  */
 void Base::compile(
     const ir::Ref &ir,
-    const utils::Str &pass_name_prefix
+    const utils::Str &pass_name_prefix,
+    const ProfilerRef &profiler,
+    const PassCacheRef &cache
 ) {
 
     // The passes should already have been constructed by the pass manager.
@@ -1123,23 +1650,32 @@ void Base::compile(
     // Handle configured debugging actions before running the pass.
     handle_debugging(ir, context, false);
 
+    // Start profiling the pass, if requested.
+    if (profiler.has_value()) {
+        profiler->begin(context.full_pass_name, type_name, ir);
+    }
+
     // Traverse our level of the pass tree based on our node type.
     switch (node_type) {
         case NodeType::NORMAL: {
-            run_main_pass(ir, context);
+            if (is_dead()) {
+                skip_dead_pass(ir, context);
+            } else if (!defer_main_pass(ir, context)) {
+                run_main_pass(ir, context, cache);
+            }
             break;
         }
 
         case NodeType::GROUP: {
-            run_sub_passes(ir, context);
+            run_sub_passes(ir, context, profiler, cache);
             break;
         }
 
         case NodeType::GROUP_IF: {
-            auto retval = run_main_pass(ir, context);
+            auto retval = run_main_pass(ir, context, cache);
             if (condition->evaluate(retval)) {
                 QL_IOUT("pass condition returned true, running sub-passes...");
-                run_sub_passes(ir, context);
+                run_sub_passes(ir, context, profiler, cache);
             } else {
                 QL_IOUT("pass condition returned false, skipping " << sub_pass_order.size() << " sub-pass(es)");
             }
@@ -1149,14 +1685,14 @@ void Base::compile(
         case NodeType::GROUP_WHILE: {
             QL_IOUT("entering loop pass loop...");
             while (true) {
-                auto retval = run_main_pass(ir, context);
+                auto retval = run_main_pass(ir, context, cache);
                 if (!condition->evaluate(retval)) {
                     QL_IOUT("pass condition returned false, exiting loop");
                     break;
                 } else {
                     QL_IOUT("pass condition returned true, continuing loop...");
                 }
-                run_sub_passes(ir, context);
+                run_sub_passes(ir, context, profiler, cache);
             }
             break;
         }
@@ -1164,8 +1700,8 @@ void Base::compile(
         case NodeType::GROUP_REPEAT_UNTIL_NOT: {
             QL_IOUT("entering loop pass loop...");
             while (true) {
-                run_sub_passes(ir, context);
-                auto retval = run_main_pass(ir, context);
+                run_sub_passes(ir, context, profiler, cache);
+                auto retval = run_main_pass(ir, context, cache);
                 if (!condition->evaluate(retval)) {
                     QL_IOUT("pass condition returned false, exiting loop");
                     break;
@@ -1176,9 +1712,29 @@ void Base::compile(
             break;
         }
 
+        case NodeType::GROUP_SELECT: {
+            run_alternatives(ir, context, profiler, cache);
+            break;
+        }
+
+        case NodeType::GROUP_INSTANCES: {
+            run_instances(ir, context, profiler, cache);
+            break;
+        }
+
+        case NodeType::GROUP_SHARDS: {
+            run_shards(ir, context);
+            break;
+        }
+
         default: QL_ASSERT(false);
     }
 
+    // Stop profiling the pass.
+    if (profiler.has_value()) {
+        profiler->end(ir);
+    }
+
     // Handle configured debugging actions after running the pass.
     handle_debugging(ir, context, true);
 
@@ -5,6 +5,7 @@
 
 #include "ql/pmgr/pass_types/specializations.h"
 
+#include "ql/utils/parallel.h"
 #include "ql/ir/new_to_old.h"
 #include "ql/ir/old_to_new.h"
 
@@ -12,6 +13,86 @@ namespace ql {
 namespace pmgr {
 namespace pass_types {
 
+/**
+ * Annotation placed on the IR root while a converted old-IR program is cached
+ * for use by consecutive legacy passes.
+ */
+struct LegacyProgramCache {
+
+    /**
+     * The cached old-IR program.
+     */
+    ir::compat::ProgramRef program;
+
+    /**
+     * Whether a legacy transformation modified the program since the new IR
+     * was last converted from or to it.
+     */
+    utils::Bool new_ir_stale;
+
+};
+
+/**
+ * Returns the old-IR equivalent of the given new IR for use by a legacy pass.
+ * Consecutive legacy passes share the same old-IR program: it is only
+ * converted from the new IR when no valid cached conversion exists.
+ */
+ir::compat::ProgramRef get_legacy_program(const ir::Ref &ir) {
+    if (auto cache = ir->get_annotation_ptr<LegacyProgramCache>()) {
+        QL_DOUT("reusing cached old-IR program");
+        return cache->program;
+    }
+    auto program = ir::convert_new_to_old(ir);
+    ir->set_annotation<LegacyProgramCache>({program, false});
+    return program;
+}
+
+/**
+ * Records that a legacy transformation pass modified the program returned by
+ * get_legacy_program(), such that the new IR must be regenerated from it
+ * before anything reads the new IR again. The conversion back is deferred
+ * until sync_legacy_program() is called.
+ */
+void mark_legacy_program_modified(const ir::Ref &ir) {
+    auto cache = ir->get_annotation_ptr<LegacyProgramCache>();
+    QL_ASSERT(cache);
+    cache->new_ir_stale = true;
+}
+
+/**
+ * Regenerates the new IR from the cached old-IR program if a legacy
+ * transformation modified it since the last conversion. The cache stays
+ * valid, so this is suitable for passes and debug dumps that only read the
+ * new IR.
+ */
+void sync_legacy_program(const ir::Ref &ir) {
+    auto cache = ir->get_annotation_ptr<LegacyProgramCache>();
+    if (!cache || !cache->new_ir_stale) {
+        return;
+    }
+    auto program = cache->program;
+    QL_DOUT("converting cached old-IR program back to the new IR");
+    auto new_ir = ir::convert_old_to_new(program);
+    ir->program = new_ir->program;
+    ir->platform = new_ir->platform;
+    ir->copy_annotations(*new_ir);
+    ir->set_annotation<LegacyProgramCache>({program, false});
+}
+
+/**
+ * Syncs the new IR with the cached old-IR program (if needed) and then
+ * discards the cache. This must be called before anything modifies the new
+ * IR, i.e. before running any pass that isn't a legacy pass, and once all
+ * passes have been run.
+ */
+void flush_legacy_program(const ir::Ref &ir) {
+    if (!ir->has_annotation<LegacyProgramCache>()) {
+        return;
+    }
+    sync_legacy_program(ir);
+    ir->erase_annotation<LegacyProgramCache>();
+}
+
 /**
  * Constructs the abstract pass group. No error checking here; this is up to
  * the parent pass group.
@@ -111,12 +192,9 @@ utils::Int ProgramTransformation::run_internal(
     const ir::Ref &ir,
     const Context &context
 ) const {
-    auto program = ir::convert_new_to_old(ir);
+    auto program = get_legacy_program(ir);
     auto retval = run(program, context);
-    auto new_ir = ir::convert_old_to_new(program);
-    ir->program = new_ir->program;
-    ir->platform = new_ir->platform;
-    ir->copy_annotations(*new_ir);
+    mark_legacy_program_modified(ir);
     return retval;
 }
 
@@ -127,6 +205,69 @@ utils::Bool ProgramTransformation::is_legacy() const {
     return true;
 }
 
+/**
+ * Adds the kernel_threads option to the given options record. This is done by
+ * the KernelTransformation and KernelAnalysis constructors when their
+ * kernel_parallel argument is set, which pass types that don't touch any state
+ * outside the kernel passed to run() (and thus can process kernels
+ * concurrently) should do.
+ */
+static void add_kernel_threads_option(utils::Options &options) {
+    options.add_int(
+        "kernel_threads",
+        "The number of kernels to process concurrently. The return values of "
+        "the pass for the individual kernels are still combined in program "
+        "order, and the log messages produced while processing each kernel "
+        "are buffered and written out in program order once all kernels are "
+        "done, so the thread count affects neither. 0 means use all hardware "
+        "threads.",
+        "1",
+        0
+    );
+}
+
+/**
+ * Calls fn for each kernel of the given program and returns the results in
+ * program order. If num_threads resolves to more than one thread, the kernels
+ * are processed concurrently. In that case, the log messages written while
+ * processing each kernel are captured and written out in program order once
+ * all kernels are done, so the log output doesn't depend on how the kernels
+ * ended up being distributed over the threads.
+ */
+static utils::Vec<utils::Int> run_per_kernel(
+    const ir::compat::ProgramRef &program,
+    utils::UInt num_threads,
+    const std::function<utils::Int(const ir::compat::KernelRef&)> &fn
+) {
+    utils::UInt num_kernels = program->kernels.size();
+    utils::Vec<utils::Int> retvals(num_kernels, 0);
+    num_threads = utils::min(utils::resolve_num_threads(num_threads), num_kernels);
+    if (num_threads <= 1) {
+        for (utils::UInt i = 0; i < num_kernels; i++) {
+            retvals[i] = fn(program->kernels[i]);
+        }
+        return retvals;
+    }
+
+    QL_DOUT("processing " << num_kernels << " kernels using " << num_threads << " threads");
+    utils::Vec<utils::logger::Capture> logs(num_kernels);
+    try {
+        utils::parallel_for(num_kernels, num_threads, [&](utils::UInt i) {
+            utils::logger::Redirect redirect(logs[i]);
+            retvals[i] = fn(program->kernels[i]);
+        });
+    } catch (...) {
+        for (auto &log : logs) {
+            log.replay();
+        }
+        throw;
+    }
+    for (auto &log : logs) {
+        log.replay();
+    }
+    return retvals;
+}
+
 /**
  * Constructs the pass. No error checking here; this is up to the parent
  * pass group.
@@ -134,8 +275,12 @@ utils::Bool ProgramTransformation::is_legacy() const {
 KernelTransformation::KernelTransformation(
     const utils::Ptr<const Factory> &pass_factory,
     const utils::Str &instance_name,
-    const utils::Str &type_name
-) : Normal(pass_factory, instance_name, type_name) {
+    const utils::Str &type_name,
+    utils::Bool kernel_parallel
+) : Normal(pass_factory, instance_name, type_name), kernel_parallel(kernel_parallel) {
+    if (kernel_parallel) {
+        add_kernel_threads_option(options);
+    }
 }
 
 /**
@@ -162,15 +307,19 @@ utils::Int KernelTransformation::run_internal(
     const ir::Ref &ir,
     const Context &context
 ) const {
-    auto program = ir::convert_new_to_old(ir);
+    auto program = get_legacy_program(ir);
+    auto retvals = run_per_kernel(
+        program,
+        kernel_parallel ? context.options["kernel_threads"].as_uint() : 1,
+        [&](const ir::compat::KernelRef &kernel) {
+            return run(program, kernel, context);
+        }
+    );
     utils::Int accumulator = retval_initialize();
-    for (const auto &kernel : program->kernels) {
-        accumulator = retval_accumulate(accumulator, run(program, kernel, context));
+    for (auto retval : retvals) {
+        accumulator = retval_accumulate(accumulator, retval);
     }
-    auto new_ir = ir::convert_old_to_new(program);
-    ir->program = new_ir->program;
-    ir->platform = new_ir->platform;
-    ir->copy_annotations(*new_ir);
+    mark_legacy_program_modified(ir);
     return accumulator;
 }
 
@@ -181,6 +330,13 @@ utils::Bool KernelTransformation::is_legacy() const {
     return true;
 }
 
+/**
+ * Returns whether this pass type can process kernels concurrently.
+ */
+utils::Bool KernelTransformation::is_kernel_parallel() const {
+    return kernel_parallel;
+}
+
 /**
  * Constructs the pass. No error checking here; this is up to the parent
  * pass group.
@@ -202,6 +358,13 @@ utils::Int Analysis::run_internal(
     return run(ir, context);
 }
 
+/**
+ * Analysis passes don't modify the IR, so they preserve all analyses.
+ */
+Analyses Analysis::get_preserved_analyses() const {
+    return analysis::ALL;
+}
+
 /**
  * Constructs the pass. No error checking here; this is up to the parent
  * pass group.
@@ -220,13 +383,7 @@ utils::Int ProgramAnalysis::run_internal(
     const ir::Ref &ir,
     const Context &context
 ) const {
-    auto program = ir::convert_new_to_old(ir);
-    auto retval = run(program, context);
-    auto new_ir = ir::convert_old_to_new(program);
-    ir->program = new_ir->program;
-    ir->platform = new_ir->platform;
-    ir->copy_annotations(*new_ir);
-    return retval;
+    return run(get_legacy_program(ir), context);
 }
 
 /**
@@ -243,8 +400,12 @@ utils::Bool ProgramAnalysis::is_legacy() const {
 KernelAnalysis::KernelAnalysis(
     const utils::Ptr<const Factory> &pass_factory,
     const utils::Str &instance_name,
-    const utils::Str &type_name
-) : Normal(pass_factory, instance_name, type_name) {
+    const utils::Str &type_name,
+    utils::Bool kernel_parallel
+) : Normal(pass_factory, instance_name, type_name), kernel_parallel(kernel_parallel) {
+    if (kernel_parallel) {
+        add_kernel_threads_option(options);
+    }
 }
 
 /**
@@ -271,15 +432,18 @@ utils::Int KernelAnalysis::run_internal(
     const ir::Ref &ir,
     const Context &context
 ) const {
-    auto program = ir::convert_new_to_old(ir);
+    auto program = get_legacy_program(ir);
+    auto retvals = run_per_kernel(
+        program,
+        kernel_parallel ? context.options["kernel_threads"].as_uint() : 1,
+        [&](const ir::compat::KernelRef &kernel) {
+            return run(program, kernel, context);
+        }
+    );
     utils::Int accumulator = retval_initialize();
-    for (const auto &kernel : program->kernels) {
-        accumulator = retval_accumulate(accumulator, run(program, kernel, context));
+    for (auto retval : retvals) {
+        accumulator = retval_accumulate(accumulator, retval);
     }
-    auto new_ir = ir::convert_old_to_new(program);
-    ir->program = new_ir->program;
-    ir->platform = new_ir->platform;
-    ir->copy_annotations(*new_ir);
     return accumulator;
 }
 
@@ -290,6 +454,13 @@ utils::Bool KernelAnalysis::is_legacy() const {
     return true;
 }
 
+/**
+ * Returns whether this pass type can process kernels concurrently.
+ */
+utils::Bool KernelAnalysis::is_kernel_parallel() const {
+    return kernel_parallel;
+}
+
 } // namespace pass_types
 } // namespace pmgr
 } // namespace ql
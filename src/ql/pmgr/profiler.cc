@@ -0,0 +1,230 @@
+/** \file
+ * Defines the pass profiler, used by the pass manager to record how much time
+ * and memory each pass in the pass tree takes.
+ */
+
+#include "ql/pmgr/profiler.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Visitor that simply counts the number of nodes in a tree.
+ */
+class NodeCounter : public ir::RecursiveVisitor {
+public:
+
+    /**
+     * The number of nodes encountered thus far.
+     */
+    utils::UInt count = 0;
+
+    /**
+     * Called once for every node in the tree.
+     */
+    void visit_node(ir::Node &node) override {
+        count++;
+    }
+
+};
+
+/**
+ * Takes a snapshot of the current resource metrics.
+ */
+Profiler::Snapshot Profiler::take_snapshot() {
+    Snapshot snapshot;
+    snapshot.wall = Clock::now();
+    snapshot.cpu = std::clock();
+    snapshot.heap = 0;
+    snapshot.peak_rss = 0;
+    snapshot.allocations = utils::AllocationAccounting::get_counters();
+#ifdef __GLIBC__
+#if __GLIBC_PREREQ(2, 33)
+    auto mi = mallinfo2();
+#else
+    auto mi = mallinfo();
+#endif
+    snapshot.heap = (utils::Int)mi.uordblks + (utils::Int)mi.hblkhd;
+#endif
+#ifndef _WIN32
+    struct rusage usage;
+    if (!getrusage(RUSAGE_SELF, &usage)) {
+#ifdef __APPLE__
+        snapshot.peak_rss = (utils::Int)usage.ru_maxrss;
+#else
+        snapshot.peak_rss = (utils::Int)usage.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return snapshot;
+}
+
+/**
+ * Counts the number of nodes in the given IR tree.
+ */
+utils::UInt Profiler::count_nodes(const ir::Ref &ir) {
+    if (ir.empty()) return 0;
+    NodeCounter counter;
+    ir->visit(counter);
+    return counter.count;
+}
+
+/**
+ * Constructs a new profiler, starting its clock.
+ */
+Profiler::Profiler() :
+    count_allocations(utils::AllocationAccounting::is_enabled()),
+    epoch(Clock::now())
+{
+}
+
+/**
+ * Records the start of a pass.
+ */
+void Profiler::begin(
+    const utils::Str &pass_name,
+    const utils::Str &type_name,
+    const ir::Ref &ir
+) {
+    Record record;
+    record.pass_name = pass_name;
+    record.type_name = type_name;
+    record.depth = stack.size();
+    record.wall_us = 0;
+    record.cpu_us = 0;
+    record.nodes_before = count_nodes(ir);
+    record.nodes_after = 0;
+    record.heap_delta = 0;
+    record.peak_rss_delta = 0;
+    record.allocated_bytes = 0;
+    record.live_bytes = 0;
+    record.peak_live_bytes = 0;
+
+    // Take the snapshot after counting nodes, so the counting itself is not
+    // attributed to the pass. Start measuring the peak for this pass, saving
+    // that of the parent.
+    if (count_allocations) {
+        parent_peaks.push_back(utils::AllocationAccounting::exchange_peak(0));
+    }
+    auto snapshot = take_snapshot();
+    record.start_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        snapshot.wall - epoch
+    ).count();
+
+    stack.push_back({records.size(), snapshot});
+    records.push_back(record);
+}
+
+/**
+ * Records the completion of the pass most recently started with begin().
+ */
+void Profiler::end(const ir::Ref &ir) {
+    if (stack.empty()) {
+        QL_ICE("Profiler::end() called without matching begin()");
+    }
+    auto snapshot = take_snapshot();
+    const auto &start = stack.back().second;
+    auto &record = records[stack.back().first];
+    record.wall_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        snapshot.wall - start.wall
+    ).count();
+    record.cpu_us = (utils::UInt)(
+        (snapshot.cpu - start.cpu) * 1000000.0 / CLOCKS_PER_SEC
+    );
+    record.heap_delta = snapshot.heap - start.heap;
+    record.peak_rss_delta = snapshot.peak_rss - start.peak_rss;
+    if (count_allocations) {
+        record.allocated_bytes = snapshot.allocations.allocated - start.allocations.allocated;
+        record.live_bytes = snapshot.allocations.get_live();
+        record.peak_live_bytes = snapshot.allocations.peak;
+
+        // The peak of the parent includes the peak of this pass.
+        auto parent_peak = parent_peaks.back();
+        parent_peaks.pop_back();
+        utils::AllocationAccounting::exchange_peak(utils::max(parent_peak, snapshot.allocations.peak));
+    }
+    record.nodes_after = count_nodes(ir);
+    stack.pop_back();
+}
+
+/**
+ * Returns the records for all passes that were run thus far.
+ */
+const utils::Vec<Profiler::Record> &Profiler::get_records() const {
+    return records;
+}
+
+/**
+ * Returns the profiling report as a JSON array with one object per pass
+ * invocation.
+ */
+utils::Json Profiler::to_json() const {
+    utils::Json json = utils::Json::array();
+    for (const auto &record : records) {
+        json.push_back({
+            {"pass", record.pass_name},
+            {"type", record.type_name},
+            {"depth", record.depth},
+            {"start_us", record.start_us},
+            {"wall_us", record.wall_us},
+            {"cpu_us", record.cpu_us},
+            {"nodes_before", record.nodes_before},
+            {"nodes_after", record.nodes_after},
+            {"heap_delta", record.heap_delta},
+            {"peak_rss_delta", record.peak_rss_delta}
+        });
+        if (count_allocations) {
+            json.back()["allocated_bytes"] = record.allocated_bytes;
+            json.back()["live_bytes"] = record.live_bytes;
+            json.back()["peak_live_bytes"] = record.peak_live_bytes;
+        }
+    }
+    return json;
+}
+
+/**
+ * Returns the profiling report in the Chrome trace event format, as
+ * understood by chrome://tracing and Perfetto.
+ */
+utils::Json Profiler::to_trace_json() const {
+    utils::Json events = utils::Json::array();
+    for (const auto &record : records) {
+        events.push_back({
+            {"name", record.pass_name.empty() ? "compile" : record.pass_name},
+            {"cat", record.type_name.empty() ? "group" : record.type_name},
+            {"ph", "X"},
+            {"ts", record.start_us},
+            {"dur", record.wall_us},
+            {"pid", 0},
+            {"tid", 0},
+            {"args", {
+                {"cpu_us", record.cpu_us},
+                {"nodes_before", record.nodes_before},
+                {"nodes_after", record.nodes_after},
+                {"heap_delta", record.heap_delta},
+                {"peak_rss_delta", record.peak_rss_delta}
+            }}
+        });
+        if (count_allocations) {
+            auto &args = events.back()["args"];
+            args["allocated_bytes"] = record.allocated_bytes;
+            args["live_bytes"] = record.live_bytes;
+            args["peak_live_bytes"] = record.peak_live_bytes;
+        }
+    }
+    return {
+        {"traceEvents", events},
+        {"displayTimeUnit", "ms"}
+    };
+}
+
+} // namespace pmgr
+} // namespace ql
@@ -0,0 +1,265 @@
+/** \file
+ * Pass group that instantiates the remainder of the compilation process for
+ * each point of a parameter sweep.
+ */
+
+#include "ql/pmgr/sweep.h"
+
+#include "ql/utils/filesystem.h"
+#include "ql/com/map/expression_mapper.h"
+#include "ql/pmgr/factory.h"
+
+namespace ql {
+namespace pmgr {
+
+/**
+ * Expression mapper that replaces the value of all real literals that equal
+ * the placeholder.
+ */
+class PlaceholderSubstituter final
+    : public com::map::StaticExpressionMapper<PlaceholderSubstituter>
+{
+public:
+
+    /**
+     * The placeholder value.
+     */
+    const utils::Real placeholder;
+
+    /**
+     * The value to substitute.
+     */
+    const utils::Real value;
+
+    /**
+     * The number of literals that were substituted.
+     */
+    utils::UInt num_substituted = 0;
+
+    /**
+     * Constructs the substituter.
+     */
+    PlaceholderSubstituter(
+        utils::Real placeholder,
+        utils::Real value
+    ) : placeholder(placeholder), value(value) {}
+
+protected:
+
+    friend class com::map::StaticExpressionMapper<PlaceholderSubstituter>;
+
+    /**
+     * Substitutes the value if the expression is a real literal with the
+     * placeholder value.
+     */
+    utils::Bool on_expression(utils::Maybe<ir::Expression> &expr) {
+        auto lit = expr->as_real_literal();
+        if (lit && lit->value == placeholder) {
+            lit->value = value;
+            num_substituted++;
+        }
+        return false;
+    }
+
+};
+
+/**
+ * Returns the parsed values option.
+ */
+utils::Vec<utils::Real> Sweep::get_values() const {
+    utils::Vec<utils::Real> values;
+    const auto &spec = options["values"].as_str();
+    if (spec.empty()) {
+        return values;
+    }
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = spec.find(',', start);
+        auto value = spec.substr(start, end == utils::Str::npos ? end : end - start);
+        start = end + 1;
+        values.push_back(utils::parse_real(value));
+    } while (end != utils::Str::npos);
+    return values;
+}
+
+/**
+ * Writes the documentation for this pass group to the given stream.
+ */
+void Sweep::dump_docs(
+    std::ostream &os,
+    const utils::Str &line_prefix
+) const {
+    utils::dump_str(os, line_prefix, R"(
+    This pass group runs the remainder of the compilation process once for
+    each point of a parameter sweep, such that the passes before it (mapping,
+    scheduling, etc.) are only run once for the whole sweep. This is useful
+    for calibration experiments, where the same circuit is compiled for many
+    rotation angles.
+
+    The swept angle is represented in the program by a placeholder value,
+    i.e. the program is to be built with the placeholder as the angle of the
+    gates that are to be swept, and placeholder must be set to that value.
+    It should be chosen such that it does not occur anywhere else in the
+    program. For each sweep point, the group makes a copy of the IR, replaces
+    all real literals that equal the placeholder with the value for that
+    point, and suffixes the name of the program with `_<index>`, such that
+    the output products of each point get their own filenames. The sub-passes
+    are then run on the copy, which is discarded afterwards; the IR itself is
+    not modified.
+
+    The sub-passes consist of one pass for each type in pass_types, named
+    `pass0`, `pass1`, etc. If pass_types is empty, the group is empty, to be
+    populated using the pass management API.
+
+    If write_sweep_points is set, the group also writes the sweep points to
+    `<output_prefix>.json`, in the same format as the io.sweep_points pass.
+    )");
+}
+
+/**
+ * Builds the sub-passes from the pass_types option.
+ */
+pass_types::NodeType Sweep::on_construct(
+    const utils::Ptr<const Factory> &factory,
+    utils::List<PassRef> &passes,
+    condition::Ref &condition
+) {
+    const auto &spec = options["pass_types"].as_str();
+    if (spec.empty()) {
+        return pass_types::NodeType::GROUP_INSTANCES;
+    }
+    utils::UInt start = 0;
+    utils::UInt end;
+    do {
+        end = spec.find(',', start);
+        auto pass_type = spec.substr(start, end == utils::Str::npos ? end : end - start);
+        start = end + 1;
+        passes.push_back(Factory::build_pass(
+            factory, pass_type, "pass" + utils::to_string(passes.size())
+        ));
+    } while (end != utils::Str::npos);
+    return pass_types::NodeType::GROUP_INSTANCES;
+}
+
+/**
+ * Writes the sweep points file, if enabled.
+ */
+utils::Int Sweep::run_internal(
+    const ir::Ref &ir,
+    const pass_types::Context &context
+) const {
+    (void)ir;
+    if (!context.options["write_sweep_points"].as_bool()) {
+        return 0;
+    }
+    auto values = get_values();
+    utils::StrStrm ss;
+    ss << "{ \"measurement_points\" : [";
+    for (utils::UInt i = 0; i < values.size(); i++) {
+        if (i) ss << ", ";
+        ss << values[i];
+    }
+    ss << "] }";
+    auto file_name = context.output_prefix + ".json";
+    QL_IOUT("writing sweep points to '" << file_name << "'...");
+    utils::OutFile(file_name).write(ss.str());
+    return 0;
+}
+
+/**
+ * Returns the value of the point_threads option.
+ */
+utils::UInt Sweep::get_num_alternative_threads() const {
+    return options["point_threads"].as_uint();
+}
+
+/**
+ * Returns the number of sweep points.
+ */
+utils::UInt Sweep::get_num_instances() const {
+    return get_values().size();
+}
+
+/**
+ * Substitutes the value of the given sweep point for the placeholder, and
+ * suffixes the program name with the index of the point.
+ */
+void Sweep::instantiate(const ir::Ref &ir, utils::UInt index) const {
+    if (ir->program.empty()) {
+        return;
+    }
+    if (options["placeholder"].as_str().empty()) {
+        throw utils::Exception("no placeholder specified for " + describe());
+    }
+    PlaceholderSubstituter substituter{
+        options["placeholder"].as_real(),
+        get_values().at(index)
+    };
+    for (const auto &block : ir->program->blocks) {
+        substituter.process_block(block);
+    }
+    if (!substituter.num_substituted) {
+        QL_WOUT(
+            "placeholder " << options["placeholder"].as_real() << " of " <<
+            describe() << " does not occur in the program"
+        );
+    }
+    auto suffix = "_" + utils::to_string(index);
+    ir->program->name += suffix;
+    ir->program->unique_name += suffix;
+}
+
+/**
+ * Returns a user-friendly type name for this pass.
+ */
+utils::Str Sweep::get_friendly_type() const {
+    return "Sweep";
+}
+
+/**
+ * Constructs the pass group.
+ */
+Sweep::Sweep(
+    const utils::Ptr<const Factory> &pass_factory,
+    const utils::Str &instance_name,
+    const utils::Str &type_name
+) : pass_types::Base(pass_factory, instance_name, type_name) {
+    options.add_str(
+        "pass_types",
+        "Comma-separated list of the types of the passes that are run for "
+        "each sweep point. If empty, the group is empty.",
+        ""
+    );
+    options.add_real(
+        "placeholder",
+        "The angle used in the program in place of the swept parameter. All "
+        "real literals with exactly this value are substituted. Must be "
+        "specified if there are any sweep points.",
+        ""
+    );
+    options.add_str(
+        "values",
+        "Comma-separated list of the values of the swept parameter, one for "
+        "each sweep point.",
+        ""
+    );
+    options.add_bool(
+        "write_sweep_points",
+        "Whether to write the values to `<output_prefix>.json` as sweep "
+        "points.",
+        true
+    );
+    options.add_int(
+        "point_threads",
+        "The number of threads to use for running the sweep points "
+        "concurrently. 0 means use all hardware threads. Note that the pass "
+        "profiler only records the sweep points when they are run "
+        "sequentially.",
+        "1",
+        0
+    );
+}
+
+} // namespace pmgr
+} // namespace ql
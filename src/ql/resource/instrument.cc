@@ -5,6 +5,13 @@
 
 #include "ql/resource/instrument.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include "ql/utils/small_vec.h"
+#include "ql/ir/ir.h"
+
 /*#undef QL_DOUT
 #define QL_DOUT(x) ::std::cout << x << ::std::endl
 #undef QL_IF_LOG_DEBUG
@@ -34,6 +41,17 @@ using Instrument = utils::UInt;
  */
 using Instruments = utils::Vec<Instrument>;
 
+/**
+ * Represents a word of an instrument bitmask, in which bit i of word j is set
+ * if instrument j * 64 + i is included.
+ */
+using MaskWord = std::uint64_t;
+
+/**
+ * Scratch space for an instrument bitmask. Up to 256 instruments fit inline.
+ */
+using Mask = utils::SmallVec<MaskWord, 4>;
+
 /**
  * Represents an instrument function index.
  */
@@ -49,6 +67,26 @@ using Predicate = utils::Pair<utils::Str, utils::Set<utils::Str>>;
  */
 using Predicates = utils::Vec<Predicate>;
 
+/**
+ * Precompiled information about a gate type, i.e. about the JSON data of an
+ * instruction, as far as this resource is concerned.
+ */
+struct GateType {
+
+    /**
+     * Whether the gate type matches the predicates, indexed by the number of
+     * qubit operands minus one, clamped to 2 maximum (like Config::predicates).
+     */
+    utils::Bool matches[3];
+
+    /**
+     * The function index for the gate type. Always zero if usage is mutually
+     * exclusive.
+     */
+    Function function;
+
+};
+
 /**
  * Configuration structure. This does not need to be copied every time the
  * resource state is cloned; we keep a shared_ptr to it instead.
@@ -74,11 +112,33 @@ struct Config {
     utils::Vec<utils::Str> function_keys;
 
     /**
-     * Map from gate type combinations we've seen thus far to a number, to
-     * keep the state tracker memory footprint down.
+     * Map from gate type combinations to a number, to keep the state tracker
+     * memory footprint down. This is filled for all instruction types known
+     * at initialization. It is only consulted (and extended) at runtime for
+     * gates with JSON data not in gate_types, in which case function_mutex must
+     * be held, because config is shared between clones of the resource.
      */
     utils::Map<utils::Vec<utils::Str>, Function> function_map;
 
+    /**
+     * Mutex protecting function_map after initialization.
+     */
+    std::mutex function_mutex;
+
+    /**
+     * Precompiled gate type information for the JSON data of every
+     * instruction type known at initialization, keyed by the address of the
+     * JSON object (see GateData::data). This avoids evaluating the predicates
+     * and constructing function keys from strings for every gate.
+     */
+    std::unordered_map<const utils::Json*, GateType> gate_types;
+
+    /**
+     * Precompiled gate type information for gates without JSON data, such as
+     * wait instructions.
+     */
+    GateType empty_gate_type;
+
     /**
      * When set, function_keys is ignored, function_map is unused, and all
      * instrument usage is considered to be mutually exclusive.
@@ -92,26 +152,58 @@ struct Config {
     utils::Bool allow_overlap;
 
     /**
-     * Map from the qubit for single-qubit gates to instrument index.
+     * The instruments used by single-qubit gates, indexed by qubit. The lists
+     * contain no duplicates.
      */
-    utils::Map<Qubit, Instruments> single_qubit_instruments;
+    utils::Vec<Instruments> single_qubit_instruments;
 
     /**
-     * Map from the nth qubit of a two-qubit gate to instrument index.
+     * The instruments used by the nth qubit of a two-qubit gate, indexed by
+     * qubit.
      */
-    utils::Map<Qubit, Instruments> two_qubit_instrument[2];
+    utils::Vec<Instruments> two_qubit_instrument[2];
 
     /**
-     * Map from the edge corresponding to a two-qubit gate to instrument
-     * index.
+     * The instruments used by two-qubit gates along a particular edge,
+     * indexed by the first qubit of the edge, and then listed by the second
+     * qubit.
      */
-    utils::Map<Edge, Instruments> two_qubit_edge_instrument;
+    utils::Vec<utils::Vec<utils::Pair<Qubit, Instruments>>> two_qubit_edge_instrument;
 
     /**
-     * Map from the nth qubit of a three-or-more-qubit gate to instrument
-     * index, with all qubit operands after the first two bunched together.
+     * The instruments used by the nth qubit of a three-or-more-qubit gate,
+     * indexed by qubit, with all qubit operands after the first two bunched
+     * together.
      */
-    utils::Map<Qubit, Instruments> multi_qubit_instrument[3];
+    utils::Vec<Instruments> multi_qubit_instrument[3];
+
+    /**
+     * The number of words in an instrument bitmask, i.e. the number of
+     * instruments divided by 64, rounded up.
+     */
+    utils::UInt mask_words;
+
+    /**
+     * Bitmasks of two_qubit_instrument, flattened into a single table of
+     * mask_words words per qubit.
+     */
+    utils::Vec<MaskWord> two_qubit_mask[2];
+
+    /**
+     * Flattened version of two_qubit_edge_instrument. The edges that have
+     * qubit q as their first qubit are stored at indices edge_offsets[q] up
+     * to edge_offsets[q + 1] of edge_partners, which holds the second qubit
+     * of each edge, and of edge_mask, which holds mask_words words per edge.
+     */
+    utils::Vec<utils::UInt> edge_offsets;
+    utils::Vec<Qubit> edge_partners;
+    utils::Vec<MaskWord> edge_mask;
+
+    /**
+     * Bitmasks of multi_qubit_instrument, flattened into a single table of
+     * mask_words words per qubit.
+     */
+    utils::Vec<MaskWord> multi_qubit_mask[3];
 
     /**
      * Defines the scheduling direction, if there is one. This controls whether
@@ -131,6 +223,151 @@ struct Config {
 
 };
 
+/**
+ * Returns whether the given gate JSON data matches all the given predicates.
+ */
+static utils::Bool matches_predicates(
+    const Predicates &predicates,
+    const utils::Json &gate_json
+) {
+    for (const auto &predicate : predicates) {
+        auto it = gate_json.find(predicate.first);
+        if (it == gate_json.end()) {
+            return false;
+        } else if (!it->is_string()) {
+            return false;
+        } else if (predicate.second.count(it->get<utils::Str>()) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Computes the gate type information for the given gate JSON data, mapping
+ * its function key to a function index. Function keys we haven't seen
+ * before are given a new index. Note that this is fine even when resources
+ * are cloned (remember: config is NOT cloned!) because we only ever add
+ * indices here. Doing so doesn't affect the state. At worst, it may change
+ * *future* indices added by other clones of this resource. After
+ * initialization, function_mutex must be held while calling this.
+ */
+static GateType make_gate_type(Config &cfg, const utils::Json &gate_json) {
+    GateType type;
+    for (utils::UInt i = 0; i < 3; i++) {
+        type.matches[i] = matches_predicates(cfg.predicates[i], gate_json);
+    }
+    type.function = 0;
+    if (!cfg.mutually_exclusive) {
+        utils::Vec<utils::Str> function_key;
+        function_key.resize(cfg.function_keys.size());
+        for (utils::UInt i = 0; i < function_key.size(); i++) {
+            auto it = gate_json.find(cfg.function_keys[i]);
+            if (it != gate_json.end() && it->is_string()) {
+                function_key[i] = it->get<utils::Str>();
+            }
+        }
+        auto it = cfg.function_map.find(function_key);
+        if (it == cfg.function_map.end()) {
+            type.function = cfg.function_map.size();
+            cfg.function_map.set(function_key) = type.function;
+        } else {
+            type.function = it->second;
+        }
+    }
+    return type;
+}
+
+/**
+ * Precompiles the gate type information for the given new-IR instruction
+ * type and its specializations.
+ */
+static void add_instruction_type(
+    Config &cfg,
+    const utils::One<ir::InstructionType> &instruction_type
+) {
+    cfg.gate_types.emplace(
+        &instruction_type->data.data,
+        make_gate_type(cfg, instruction_type->data.data)
+    );
+    for (const auto &specialization : instruction_type->specializations) {
+        add_instruction_type(cfg, specialization);
+    }
+}
+
+/**
+ * Returns the gate type information for the given gate JSON data. This is
+ * normally just a lookup in the precompiled gate_types map; only gates with
+ * JSON data that didn't exist yet when the resource was initialized (for
+ * example for instruction specializations generated later on) are handled
+ * the slow way.
+ */
+static GateType get_gate_type(Config &cfg, const utils::Json &gate_json) {
+    auto it = cfg.gate_types.find(&gate_json);
+    if (it != cfg.gate_types.end()) {
+        return it->second;
+    }
+    if (gate_json.empty()) {
+        return cfg.empty_gate_type;
+    }
+    std::lock_guard<std::mutex> lock(cfg.function_mutex);
+    return make_gate_type(cfg, gate_json);
+}
+
+/**
+ * Appends the instruments in src that are not yet in dest to dest.
+ */
+static void merge_instruments(Instruments &dest, const Instruments &src) {
+    for (auto instrument : src) {
+        if (std::find(dest.begin(), dest.end(), instrument) == dest.end()) {
+            dest.push_back(instrument);
+        }
+    }
+}
+
+/**
+ * Sets the bits for the given instruments in the mask of mask_words words
+ * starting at the given offset of the given table.
+ */
+static void add_to_mask(
+    utils::Vec<MaskWord> &table,
+    utils::UInt offset,
+    const Instruments &instruments
+) {
+    for (auto instrument : instruments) {
+        table[offset + instrument / 64] |= MaskWord(1) << (instrument % 64);
+    }
+}
+
+/**
+ * Builds a flattened table of bitmasks with the given number of words per
+ * mask from per-qubit lists of instruments.
+ */
+static utils::Vec<MaskWord> make_masks(
+    const utils::Vec<Instruments> &instruments_per_qubit,
+    utils::UInt mask_words
+) {
+    utils::Vec<MaskWord> table(instruments_per_qubit.size() * mask_words, 0);
+    for (utils::UInt qubit = 0; qubit < instruments_per_qubit.size(); qubit++) {
+        add_to_mask(table, qubit * mask_words, instruments_per_qubit[qubit]);
+    }
+    return table;
+}
+
+/**
+ * Merges the mask of mask_words words starting at the given offset of the
+ * given table into the given mask.
+ */
+static void merge_mask(
+    Mask &mask,
+    const utils::Vec<MaskWord> &table,
+    utils::UInt offset
+) {
+    for (utils::UInt word = 0; word < mask.size(); word++) {
+        mask[word] |= table[offset + word];
+    }
+}
+
 /**
  * Initializes this resource.
  */
@@ -258,7 +495,7 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
         } else if (!it->is_object()) {
             ERROR("edge connection_map key must be an object");
         }
-        utils::Map<utils::UInt, utils::Set<utils::UInt>> qubit_to_detuning_edges;
+        utils::Vec<utils::Vec<utils::UInt>> qubit_to_detuning_edges(context->platform->qubit_count);
         for (auto it2 = it->begin(); it2 != it->end(); ++it2) {
             if (!it2->is_array()) {
                 ERROR("edge connection_map values must be arrays of qubits");
@@ -279,12 +516,24 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
                     ERROR("edge connection_map values must be arrays of qubits");
                 }
                 auto qubit = it3->get<utils::UInt>();
-                qubit_to_detuning_edges.set(qubit).insert(edge_id);
+                if (qubit >= qubit_to_detuning_edges.size()) {
+                    ERROR(
+                        "qubit index out of range in connection_map: " +
+                        utils::to_string(qubit)
+                    );
+                }
+                auto &edges = qubit_to_detuning_edges[qubit];
+                if (std::find(edges.begin(), edges.end(), edge_id) == edges.end()) {
+                    edges.push_back(edge_id);
+                }
             }
         }
-        for (auto it2 : qubit_to_detuning_edges) {
-            auto qubit = it2.first;
-            const auto &edges = it2.second;
+        for (utils::UInt qubit = 0; qubit < qubit_to_detuning_edges.size(); qubit++) {
+            auto &edges = qubit_to_detuning_edges[qubit];
+            if (edges.empty()) {
+                continue;
+            }
+            std::sort(edges.begin(), edges.end());
             cfg->json["instruments"].push_back(
                 {
                     {"name", "qubit-" + utils::to_string(qubit)},
@@ -369,7 +618,16 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
         ERROR("missing instruments key in configuration structure");
     }
 
-    // Parse instruments substructure.
+    // Parse instruments substructure into flat tables indexed by qubit.
+    auto num_qubits = context->platform->qubit_count;
+    cfg->single_qubit_instruments.resize(num_qubits);
+    for (auto &instruments_per_qubit : cfg->two_qubit_instrument) {
+        instruments_per_qubit.resize(num_qubits);
+    }
+    cfg->two_qubit_edge_instrument.resize(num_qubits);
+    for (auto &instruments_per_qubit : cfg->multi_qubit_instrument) {
+        instruments_per_qubit.resize(num_qubits);
+    }
     for (const auto &instrument : *instruments) {
         if (!instrument.is_object()) {
             ERROR("instrument elements must be objects");
@@ -396,59 +654,69 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
                     ERROR("all instrument keys except name must be arrays of integers");
                 }
             }
-            utils::Bool recognized_as_qubits = false;
+            utils::Bool recognized_as_qubits =
+                it.key() == "1q_qubit" || it.key() == "qubit"
+                || it.key() == "2q_qubit0" || it.key() == "2q_qubit1"
+                || it.key() == "nq_qubit0" || it.key() == "nq_qubit1"
+                || it.key() == "nq_qubitn";
+            if (recognized_as_qubits) {
+                for (const auto &qubit : elements) {
+                    if (qubit >= num_qubits) {
+                        ERROR(
+                            "qubit index out of range in " + it.key() +
+                            " list: " + utils::to_string(qubit)
+                        );
+                    }
+                }
+            }
             if (it.key() == "1q_qubit" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->single_qubit_instruments.set(qubit).push_back(index);
+                    merge_instruments(cfg->single_qubit_instruments[qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
             if (it.key() == "2q_qubit0" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->two_qubit_instrument[0].set(qubit).push_back(index);
+                    merge_instruments(cfg->two_qubit_instrument[0][qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
             if (it.key() == "2q_qubit1" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->two_qubit_instrument[1].set(qubit).push_back(index);
+                    merge_instruments(cfg->two_qubit_instrument[1][qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
             if (it.key() == "nq_qubit0" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->multi_qubit_instrument[0].set(qubit).push_back(index);
+                    merge_instruments(cfg->multi_qubit_instrument[0][qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
             if (it.key() == "nq_qubit1" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->multi_qubit_instrument[1].set(qubit).push_back(index);
+                    merge_instruments(cfg->multi_qubit_instrument[1][qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
             if (it.key() == "nq_qubitn" || it.key() == "qubit") {
                 for (const auto &qubit : elements) {
-                    cfg->multi_qubit_instrument[2].set(qubit).push_back(index);
+                    merge_instruments(cfg->multi_qubit_instrument[2][qubit], {index});
                 }
-                recognized_as_qubits = true;
             }
-            if (recognized_as_qubits) {
-                for (const auto &qubit : elements) {
-                    if (qubit >= context->platform->qubit_count) {
-                        ERROR(
-                            "qubit index out of range in " + it.key() +
-                            " list: " + utils::to_string(qubit)
-                        );
-                    }
-                }
-            } else if (it.key() == "edge") {
+            if (!recognized_as_qubits && it.key() == "edge") {
                 for (const auto &edge_id : elements) {
                     auto edge = context->platform->topology->get_edge_qubits(edge_id);
                     if (edge == Edge(0, 0)) {
                         ERROR("invalid edge ID in edge list: " + utils::to_string(edge_id));
                     }
-                    cfg->two_qubit_edge_instrument.set(edge).push_back(index);
+                    auto &edges = cfg->two_qubit_edge_instrument[edge.first];
+                    auto edge_it = std::find_if(
+                        edges.begin(), edges.end(),
+                        [&edge](const utils::Pair<Qubit, Instruments> &e) {
+                            return e.first == edge.second;
+                        }
+                    );
+                    if (edge_it == edges.end()) {
+                        edges.emplace_back(edge.second, Instruments{index});
+                    } else {
+                        merge_instruments(edge_it->second, {index});
+                    }
                 }
             }
 
@@ -456,6 +724,48 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
         cfg->instrument_names.push_back(name);
     }
 
+    // Compile the instrument lists for multi-qubit gates into bitmasks, such
+    // that the instruments affected by a gate can be computed by OR-ing a
+    // few words together rather than merging lists.
+    auto mask_words = (cfg->instrument_names.size() + 63) / 64;
+    cfg->mask_words = mask_words;
+    for (utils::UInt i = 0; i < 2; i++) {
+        cfg->two_qubit_mask[i] = make_masks(cfg->two_qubit_instrument[i], mask_words);
+    }
+    for (utils::UInt i = 0; i < 3; i++) {
+        cfg->multi_qubit_mask[i] = make_masks(cfg->multi_qubit_instrument[i], mask_words);
+    }
+    cfg->edge_offsets.resize(num_qubits + 1);
+    cfg->edge_offsets[0] = 0;
+    for (utils::UInt qubit = 0; qubit < num_qubits; qubit++) {
+        const auto &edges = cfg->two_qubit_edge_instrument[qubit];
+        cfg->edge_offsets[qubit + 1] = cfg->edge_offsets[qubit] + edges.size();
+        for (const auto &edge : edges) {
+            cfg->edge_partners.push_back(edge.first);
+        }
+    }
+    cfg->edge_mask.resize(cfg->edge_partners.size() * mask_words, 0);
+    for (utils::UInt qubit = 0; qubit < num_qubits; qubit++) {
+        const auto &edges = cfg->two_qubit_edge_instrument[qubit];
+        for (utils::UInt i = 0; i < edges.size(); i++) {
+            auto offset = (cfg->edge_offsets[qubit] + i) * mask_words;
+            add_to_mask(cfg->edge_mask, offset, edges[i].second);
+        }
+    }
+
+    // Precompile the predicates and function index for all instruction types
+    // we know about, such that on_gate() only needs a single lookup.
+    cfg->empty_gate_type = make_gate_type(*cfg, utils::Json::object());
+    const auto &old_instructions = context->platform->get_instructions();
+    for (auto it = old_instructions.begin(); it != old_instructions.end(); ++it) {
+        cfg->gate_types.emplace(&*it, make_gate_type(*cfg, *it));
+    }
+    if (!context->ir.empty()) {
+        for (const auto &instruction_type : context->ir->platform->instructions) {
+            add_instruction_type(*cfg, instruction_type);
+        }
+    }
+
     // Whew, what a mouthful. But now we're done.
     config = cfg;
 
@@ -495,6 +805,59 @@ void InstrumentResource::on_initialize(rmgr::Direction direction) {
 
 }
 
+/**
+ * Returns the instruments affected by the given gate, which must have at least
+ * one qubit operand. For single-qubit gates we can refer to the table
+ * directly; otherwise the bitmasks for the operands are OR-ed together in the
+ * given scratch mask, and the instruments in the result are written to the
+ * given scratch list in ascending order, which is then returned.
+ */
+static const Instruments &get_affected_instruments(
+    const Config &cfg,
+    const rmgr::resource_types::GateData &gate,
+    Instruments &merged,
+    Mask &mask
+) {
+    if (gate.qubits.size() == 1) {
+        return cfg.single_qubit_instruments[gate.qubits[0]];
+    }
+    auto mask_words = cfg.mask_words;
+    mask.assign(mask_words, 0);
+    if (gate.qubits.size() == 2) {
+
+        // Two-qubit gate.
+        for (utils::UInt i = 0; i < 2; i++) {
+            merge_mask(mask, cfg.two_qubit_mask[i], gate.qubits[i] * mask_words);
+        }
+        auto q0 = gate.qubits[0];
+        for (auto edge = cfg.edge_offsets[q0]; edge < cfg.edge_offsets[q0 + 1]; edge++) {
+            if (cfg.edge_partners[edge] == gate.qubits[1]) {
+                merge_mask(mask, cfg.edge_mask, edge * mask_words);
+                break;
+            }
+        }
+
+    } else {
+
+        // Three-or-more-qubit gate.
+        for (utils::UInt i = 0; i < gate.qubits.size(); i++) {
+            auto j = utils::min<utils::UInt>(i, 2);
+            merge_mask(mask, cfg.multi_qubit_mask[j], gate.qubits[i] * mask_words);
+        }
+
+    }
+    merged.clear();
+    for (utils::UInt word = 0; word < mask_words; word++) {
+        auto bits = mask[word];
+        for (Instrument instrument = word * 64; bits; instrument++, bits >>= 1) {
+            if (bits & 1) {
+                merged.push_back(instrument);
+            }
+        }
+    }
+    return merged;
+}
+
 /**
  * Checks availability of and/or reserves a gate.
  */
@@ -505,7 +868,7 @@ utils::Bool InstrumentResource::on_gate(
 ) {
     QL_DOUT(
         "instrument resource " << context->instance_name
-        << " got gate with name " << gate.name
+        << " got gate with name " << *gate.name
         << " and qubit operands " << gate.qubits
         << " for cycle " << cycle
         << " with commit set to " << commit
@@ -517,75 +880,21 @@ utils::Bool InstrumentResource::on_gate(
         return true;
     }
 
-    // Fetch the JSON data for this gate.
-    const auto &gate_json = *gate.data;
+    // Look up the precompiled information for this gate type.
+    auto type = get_gate_type(*config, *gate.data);
 
     // Check predicates. If the gate doesn't match, we don't care about it, so
     // we can return true, such that it can be started in any cycle.
     auto op_count_pos = utils::min<utils::UInt>(gate.qubits.size() - 1, 2);
-    for (const auto &predicate : config->predicates[op_count_pos]) {
-        auto it = gate_json.find(predicate.first);
-        if (it == gate_json.end()) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": key does not exist"
-            );
-            return true;
-        } else if (!it->is_string()) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": key is not a string"
-            );
-            return true;
-        } else if (predicate.second.count(it->get<utils::Str>()) == 0) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": value " << it->get<utils::Str>()
-                << " not in " << predicate.second
-            );
-            return true;
-        }
+    if (!type.matches[op_count_pos]) {
+        QL_DOUT(" -> available: gate does not match predicates");
+        return true;
     }
 
     // Check operands to see which instruments are affected.
-    utils::Set<Instrument> affected;
-    switch (gate.qubits.size()) {
-        case 1: {
-            // Single-qubit gate.
-            auto it = config->single_qubit_instruments.find(gate.qubits[0]);
-            if (it != config->single_qubit_instruments.end()) {
-                affected.insert(it->second.begin(), it->second.end());
-            }
-            break;
-        }
-        case 2: {
-            // Two-qubit gate.
-            for (auto i = 0; i < 2; i++) {
-                auto it = config->two_qubit_instrument[i].find(gate.qubits[i]);
-                if (it != config->two_qubit_instrument[i].end()) {
-                    affected.insert(it->second.begin(), it->second.end());
-                }
-            }
-            auto it = config->two_qubit_edge_instrument.find(
-                Edge(gate.qubits[0], gate.qubits[1])
-            );
-            if (it != config->two_qubit_edge_instrument.end()) {
-                affected.insert(it->second.begin(), it->second.end());
-            }
-            break;
-        }
-        default: {
-            // Three-or-more-qubit gate.
-            for (utils::UInt i = 0; i < gate.qubits.size(); i++) {
-                auto j = utils::min<utils::UInt>(i, 2);
-                auto it = config->two_qubit_instrument[j].find(gate.qubits[i]);
-                if (it != config->two_qubit_instrument[j].end()) {
-                    affected.insert(it->second.begin(), it->second.end());
-                }
-            }
-            break;
-        }
-    }
+    Instruments merged;
+    Mask mask;
+    const auto &affected = get_affected_instruments(*config, gate, merged, mask);
 
     // If no instruments are affected, short-circuit here.
     if (affected.empty()) {
@@ -605,39 +914,16 @@ utils::Bool InstrumentResource::on_gate(
     Function function = 0;
     if (config->mutually_exclusive) {
         for (auto index : affected) {
-            if (state[index].find(range).type != utils::RangeMatchType::NONE) {
+            if (state[index].find_any_overlap(range)) {
                 QL_DOUT(" -> not available because of instrument " << config->instrument_names[index]);
                 return false;
             }
         }
     } else {
 
-        // If not mutually exclusive, determine the function based on keys in
-        // the gate's JSON.
-        utils::Vec<utils::Str> function_key;
-        function_key.resize(config->function_keys.size());
-        for (utils::UInt i = 0; i < function_key.size(); i++) {
-            auto it = gate_json.find(config->function_keys[i]);
-            if (it != gate_json.end() && it->is_string()) {
-                function_key[i] = it->get<utils::Str>();
-            }
-        }
-        QL_DOUT("    function key = " << function_key);
-
-        // Because storing vectors of strings in the resource state is a bit
-        // ridiculous, we map these string tuples to unique integers. We just
-        // generate a new integer whenever we see a function that we haven't
-        // seen before. Note that this is fine even when resources are cloned
-        // (remember: config is NOT cloned!) because we only ever add indices
-        // here. Doing so doesn't affect the state. At worst, it may change
-        // *future* indices added by other clones of this resource.
-        auto it = config->function_map.find(function_key);
-        if (it == config->function_map.end()) {
-            function = config->function_map.size();
-            config->function_map.set(function_key) = function;
-        } else {
-            function = it->second;
-        }
+        // If not mutually exclusive, the function is determined by keys in
+        // the gate's JSON, which we've already mapped to an index.
+        function = type.function;
         QL_DOUT("    function index = " << function);
 
         // Check the resources based on function index.
@@ -712,6 +998,7 @@ utils::Bool InstrumentResource::on_gate(
             << affected.size() << " instruments"
         );
         for (auto index : affected) {
+            undo_log.record(state, index);
             if (config->direction == rmgr::Direction::FORWARD) {
                 state[index].erase({utils::MIN, range.first});
             } else if (config->direction == rmgr::Direction::BACKWARD) {
@@ -729,6 +1016,119 @@ utils::Bool InstrumentResource::on_gate(
     return true;
 }
 
+/**
+ * Computes the earliest cycles at which the given gates would be accepted,
+ * skipping directly past conflicting reservations.
+ */
+void InstrumentResource::on_get_earliest(
+    utils::Int cycle,
+    const utils::Vec<rmgr::resource_types::GateData> &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    utils::Bool backward = get_direction() == rmgr::Direction::BACKWARD;
+    Instruments merged;
+    Mask mask;
+    for (utils::UInt i = 0; i < gates.size(); i++) {
+        const auto &gate = gates[i];
+
+        // Gates that on_gate() accepts in any cycle don't need to move.
+        if (gate.qubits.empty()) {
+            continue;
+        }
+        auto type = get_gate_type(*config, *gate.data);
+        auto op_count_pos = utils::min<utils::UInt>(gate.qubits.size() - 1, 2);
+        if (!type.matches[op_count_pos]) {
+            continue;
+        }
+        const auto &affected = get_affected_instruments(*config, gate, merged, mask);
+        if (affected.empty()) {
+            continue;
+        }
+        Function function = config->mutually_exclusive ? 0 : type.function;
+        utils::Int duration = gate.duration_cycles;
+
+        // Move the candidate start cycle past the reservations that it
+        // conflicts with, i.e. all overlapping reservations if instruments are
+        // mutually exclusive and those for a different function otherwise,
+        // until no instrument conflicts anymore. Any start cycle in between
+        // would still overlap one of those reservations. The exception is a
+        // partial overlap with only reservations for the same function when
+        // allow_overlap is not set, which might be resolved by starting
+        // exactly in sync with one of them; in that case, we just try the next
+        // cycle.
+        utils::Bool changed = true;
+        while (changed && delays[i] <= max_delay) {
+            changed = false;
+            utils::Int start = backward
+                ? cycle - (utils::Int)delays[i]
+                : cycle + (utils::Int)delays[i];
+            State::Range range = {start, start + duration};
+            for (auto index : affected) {
+                auto result = state[index].find(range);
+                if (result.type == utils::RangeMatchType::NONE) {
+                    continue;
+                }
+                utils::Bool blocked = false;
+                utils::Int next = backward ? utils::MAX : utils::MIN;
+                for (auto it = result.begin; it != result.end; ++it) {
+                    if (config->mutually_exclusive || it->second != function) {
+                        blocked = true;
+                        if (backward) {
+                            next = utils::min(next, it->first.first - duration);
+                        } else {
+                            next = utils::max(next, it->first.second);
+                        }
+                    }
+                }
+                if (blocked) {
+                    if (backward) {
+                        delays[i] += utils::max<utils::Int>(start - next, 1);
+                    } else {
+                        delays[i] += utils::max<utils::Int>(next - start, 1);
+                    }
+                } else if (result.type != utils::RangeMatchType::EXACT && !config->allow_overlap) {
+                    delays[i]++;
+                } else {
+                    continue;
+                }
+                changed = true;
+                break;
+            }
+        }
+        delays[i] = utils::min(delays[i], max_delay + 1);
+
+    }
+}
+
+/**
+ * Returns whether this resource supports checkpoints, which it does.
+ */
+utils::Bool InstrumentResource::on_supports_checkpoints() const {
+    return true;
+}
+
+/**
+ * Pushes a checkpoint onto the undo log.
+ */
+void InstrumentResource::on_checkpoint() {
+    undo_log.on_checkpoint();
+}
+
+/**
+ * Undoes all reservations made since the innermost checkpoint.
+ */
+void InstrumentResource::on_rollback() {
+    undo_log.on_rollback(state);
+}
+
+/**
+ * Pops the innermost checkpoint from the undo log.
+ */
+void InstrumentResource::on_release() {
+    undo_log.on_release();
+}
+
 /**
  * Dumps documentation for this resource.
  */
@@ -1289,6 +1689,7 @@ void InstrumentResource::on_dump_state(
                 if (this->config->mutually_exclusive) {
                     os << "reserved";
                 } else {
+                    std::lock_guard<std::mutex> lock(this->config->function_mutex);
                     for (const auto &it : this->config->function_map) {
                         if (val == it.second) {
                             os << it.first;
@@ -5,6 +5,11 @@
 
 #include "ql/resource/inter_core_channel.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include "ql/utils/set.h"
+#include "ql/ir/ir.h"
+
 namespace ql {
 namespace resource {
 namespace inter_core_channel {
@@ -19,6 +24,20 @@ using Predicate = utils::Pair<utils::Str, utils::Set<utils::Str>>;
  */
 using Predicates = utils::Vec<Predicate>;
 
+/**
+ * Precompiled information about a gate type, i.e. about the JSON data of an
+ * instruction, as far as this resource is concerned.
+ */
+struct GateType {
+
+    /**
+     * Whether the gate type matches the predicates, indexed by the number of
+     * qubit operands minus one, clamped to 2 maximum (like Config::predicates).
+     */
+    utils::Bool matches[3];
+
+};
+
 /**
  * Configuration structure. This does not need to be copied every time the
  * resource state is cloned; instead we keep a shared_ptr to it instead.
@@ -60,6 +79,21 @@ struct Config {
      */
     utils::Bool optimize;
 
+    /**
+     * Precompiled gate type information for the JSON data of every
+     * instruction type known at initialization, keyed by the address of the
+     * JSON object (see GateData::data). This avoids evaluating the predicates
+     * for every gate.
+     */
+    std::unordered_map<const utils::Json*, GateType> gate_types;
+
+    /**
+     * For each qubit, the index of the core it belongs to if it requires
+     * channel resources (i.e. always if communication_qubit_only is not set,
+     * otherwise only for communication qubits), or utils::UMAX if not.
+     */
+    utils::Vec<utils::UInt> qubit_core;
+
     /**
      * The (desugared) JSON configuration of this resource. Only retained for
      * dumping the configuration.
@@ -68,6 +102,69 @@ struct Config {
 
 };
 
+/**
+ * Returns whether the given gate JSON data matches all the given predicates.
+ */
+static utils::Bool matches_predicates(
+    const Predicates &predicates,
+    const utils::Json &gate_json
+) {
+    for (const auto &predicate : predicates) {
+        auto it = gate_json.find(predicate.first);
+        if (it == gate_json.end()) {
+            return false;
+        } else if (!it->is_string()) {
+            return false;
+        } else if (predicate.second.count(it->get<utils::Str>()) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Computes the gate type information for the given gate JSON data.
+ */
+static GateType make_gate_type(const Config &cfg, const utils::Json &gate_json) {
+    GateType type;
+    for (utils::UInt i = 0; i < 3; i++) {
+        type.matches[i] = matches_predicates(cfg.predicates[i], gate_json);
+    }
+    return type;
+}
+
+/**
+ * Precompiles the gate type information for the given new-IR instruction
+ * type and its specializations.
+ */
+static void add_instruction_type(
+    Config &cfg,
+    const utils::One<ir::InstructionType> &instruction_type
+) {
+    cfg.gate_types.emplace(
+        &instruction_type->data.data,
+        make_gate_type(cfg, instruction_type->data.data)
+    );
+    for (const auto &specialization : instruction_type->specializations) {
+        add_instruction_type(cfg, specialization);
+    }
+}
+
+/**
+ * Returns the gate type information for the given gate JSON data. This is
+ * normally just a lookup in the precompiled gate_types map; only gates with
+ * JSON data that didn't exist yet when the resource was initialized are
+ * evaluated the slow way. The config structure is shared between clones of
+ * the resource, so those are not added to the map.
+ */
+static GateType get_gate_type(const Config &cfg, const utils::Json &gate_json) {
+    auto it = cfg.gate_types.find(&gate_json);
+    if (it != cfg.gate_types.end()) {
+        return it->second;
+    }
+    return make_gate_type(cfg, gate_json);
+}
+
 /**
  * Initializes this resource.
  */
@@ -174,15 +271,34 @@ void InterCoreChannelResource::on_initialize(rmgr::Direction direction) {
         ERROR("illegal number of communication channels; need at least one");
     }
 
+    // Precompile the predicates for all instruction types we know about, and
+    // the core of each qubit, such that on_gate() doesn't need to evaluate
+    // either.
+    const auto &old_instructions = context->platform->get_instructions();
+    for (auto it = old_instructions.begin(); it != old_instructions.end(); ++it) {
+        cfg->gate_types.emplace(&*it, make_gate_type(*cfg, *it));
+    }
+    if (!context->ir.empty()) {
+        for (const auto &instruction_type : context->ir->platform->instructions) {
+            add_instruction_type(*cfg, instruction_type);
+        }
+    }
+    const auto &grid = *context->platform->topology;
+    cfg->qubit_core.resize(context->platform->qubit_count);
+    for (utils::UInt qubit = 0; qubit < cfg->qubit_core.size(); qubit++) {
+        if (!cfg->communication_qubit_only || grid.is_comm_qubit(qubit)) {
+            cfg->qubit_core[qubit] = grid.get_core_index(qubit);
+        } else {
+            cfg->qubit_core[qubit] = utils::UMAX;
+        }
+    }
+
     // Configuration load successful; save the constructed configuration.
     config = cfg;
 
     // Initialize state.
     state.clear();
-    state.resize(cfg->num_cores);
-    for (auto &s : state) {
-        s.resize(cfg->num_channels);
-    }
+    state.resize(cfg->num_cores * cfg->num_channels);
 
     // Print result if debug is enabled.
     QL_IF_LOG_DEBUG {
@@ -210,64 +326,34 @@ void InterCoreChannelResource::on_initialize(rmgr::Direction direction) {
 }
 
 /**
- * Checks availability of and/or reserves a gate.
+ * Determines the cores whose channels the given gate needs. Returns false if
+ * the gate is not constrained by this resource at all.
  */
-utils::Bool InterCoreChannelResource::on_gate(
-    utils::Int cycle,
+utils::Bool InterCoreChannelResource::get_affected_cores(
     const rmgr::resource_types::GateData &gate,
-    utils::Bool commit
-) {
-    QL_DOUT(
-        "channel resource " << context->instance_name
-        << " got gate with name " << gate.name
-        << " and qubit operands " << gate.qubits
-        << " for cycle " << cycle
-        << " with commit set to " << commit
-    );
-
-    const auto &grid = *context->platform->topology;
+    utils::Vec<utils::UInt> &affected
+) const {
 
     // We don't do anything with gates that don't have qubit operands.
     if (gate.qubits.empty()) {
         QL_DOUT(" -> available: gate has no qubit operands");
-        return true;
+        return false;
     }
 
-    // Fetch the JSON data for this gate.
-    const auto &gate_json = *gate.data;
-
     // Check predicates. If the gate doesn't match, we don't care about it, so
-    // we can return true, such that it can be started in any cycle.
+    // we can return false, such that it can be started in any cycle.
     auto op_count_pos = utils::min<utils::UInt>(gate.qubits.size() - 1, 2);
-    for (const auto &predicate : config->predicates[op_count_pos]) {
-        auto it = gate_json.find(predicate.first);
-        if (it == gate_json.end()) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": key does not exist"
-            );
-            return true;
-        } else if (!it->is_string()) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": key is not a string"
-            );
-            return true;
-        } else if (predicate.second.count(it->get<utils::Str>()) == 0) {
-            QL_DOUT(
-                " -> available: gate does not match predicate "
-                << predicate.first << ": value " << it->get<utils::Str>()
-                << " not in " << predicate.second
-            );
-            return true;
-        }
+    if (!get_gate_type(*config, *gate.data).matches[op_count_pos]) {
+        QL_DOUT(" -> available: gate does not match predicates");
+        return false;
     }
 
     // Figure out which cores are affected.
-    utils::Set<utils::UInt> affected;
+    affected.clear();
     for (auto qubit : gate.qubits) {
-        if (!config->communication_qubit_only || grid.is_comm_qubit(qubit)) {
-            affected.insert(grid.get_core_index(qubit));
+        auto core = config->qubit_core[qubit];
+        if (core != utils::UMAX && std::find(affected.begin(), affected.end(), core) == affected.end()) {
+            affected.push_back(core);
         }
     }
 
@@ -275,6 +361,32 @@ utils::Bool InterCoreChannelResource::on_gate(
     // one core.
     if (config->inter_core_required && affected.size() < 2) {
         QL_DOUT(" -> available: gate does not match inter-core predicate");
+        return false;
+    }
+
+    return !affected.empty();
+}
+
+/**
+ * Checks availability of and/or reserves a gate.
+ */
+utils::Bool InterCoreChannelResource::on_gate(
+    utils::Int cycle,
+    const rmgr::resource_types::GateData &gate,
+    utils::Bool commit
+) {
+    QL_DOUT(
+        "channel resource " << context->instance_name
+        << " got gate with name " << *gate.name
+        << " and qubit operands " << gate.qubits
+        << " for cycle " << cycle
+        << " with commit set to " << commit
+    );
+
+    // Figure out which cores are affected. If none, the gate can be started
+    // in any cycle.
+    utils::Vec<utils::UInt> affected;
+    if (!get_affected_cores(gate, affected)) {
         return true;
     }
 
@@ -284,11 +396,12 @@ utils::Bool InterCoreChannelResource::on_gate(
         cycle + gate.duration_cycles
     };
 
-    // Check availability.
+    // Check availability. The channels of each core are adjacent in state.
+    auto num_channels = config->num_channels;
     for (auto core : affected) {
         utils::Bool core_available = false;
-        for (auto &s : state[core]) {
-            if (s.find(range).type == utils::RangeMatchType::NONE) {
+        for (utils::UInt channel = 0; channel < num_channels; channel++) {
+            if (!state[core * num_channels + channel].find_any_overlap(range)) {
                 core_available = true;
                 break;
             }
@@ -308,8 +421,11 @@ utils::Bool InterCoreChannelResource::on_gate(
         );
         for (auto core : affected) {
             utils::Bool core_found = false;
-            for (auto &s : state[core]) {
-                if (s.find(range).type == utils::RangeMatchType::NONE) {
+            for (utils::UInt channel = 0; channel < num_channels; channel++) {
+                auto index = core * num_channels + channel;
+                auto &s = state[index];
+                if (!s.find_any_overlap(range)) {
+                    undo_log.record(state, index);
                     if (config->optimize) {
                         s.clear();
                     }
@@ -329,6 +445,95 @@ utils::Bool InterCoreChannelResource::on_gate(
     return true;
 }
 
+/**
+ * Computes the earliest cycles at which the given gates would be accepted,
+ * skipping directly past conflicting reservations.
+ */
+void InterCoreChannelResource::on_get_earliest(
+    utils::Int cycle,
+    const utils::Vec<rmgr::resource_types::GateData> &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    utils::Bool backward = get_direction() == rmgr::Direction::BACKWARD;
+    auto num_channels = config->num_channels;
+    utils::Vec<utils::UInt> affected;
+    for (utils::UInt i = 0; i < gates.size(); i++) {
+        const auto &gate = gates[i];
+        if (!get_affected_cores(gate, affected)) {
+            continue;
+        }
+        utils::Int duration = gate.duration_cycles;
+
+        // A core accepts the gate at the earliest start cycle for which any
+        // of its channels is free. For each channel, that is found by moving
+        // the candidate start cycle past the reservations it overlaps (any
+        // start cycle in between would still overlap them). The gate is
+        // accepted when all cores agree on the same start cycle, so iterate
+        // until none of them needs to move it anymore.
+        utils::Bool changed = true;
+        while (changed && delays[i] <= max_delay) {
+            changed = false;
+            for (auto core : affected) {
+                utils::UInt core_delay = utils::UMAX;
+                for (utils::UInt channel = 0; channel < num_channels; channel++) {
+                    const auto &s = state[core * num_channels + channel];
+                    utils::UInt delay = delays[i];
+                    while (delay < core_delay && delay <= max_delay) {
+                        utils::Int start = backward
+                            ? cycle - (utils::Int)delay
+                            : cycle + (utils::Int)delay;
+                        auto result = s.find({start, start + duration});
+                        if (result.type == utils::RangeMatchType::NONE) {
+                            break;
+                        }
+                        if (backward) {
+                            delay += utils::max<utils::Int>(start - (result.begin->first.first - duration), 1);
+                        } else {
+                            delay += utils::max<utils::Int>(std::prev(result.end)->first.second - start, 1);
+                        }
+                    }
+                    core_delay = utils::min(core_delay, delay);
+                }
+                if (core_delay > delays[i]) {
+                    delays[i] = core_delay;
+                    changed = true;
+                }
+            }
+        }
+        delays[i] = utils::min(delays[i], max_delay + 1);
+
+    }
+}
+
+/**
+ * Returns whether this resource supports checkpoints, which it does.
+ */
+utils::Bool InterCoreChannelResource::on_supports_checkpoints() const {
+    return true;
+}
+
+/**
+ * Pushes a checkpoint onto the undo log.
+ */
+void InterCoreChannelResource::on_checkpoint() {
+    undo_log.on_checkpoint();
+}
+
+/**
+ * Undoes all reservations made since the innermost checkpoint.
+ */
+void InterCoreChannelResource::on_rollback() {
+    undo_log.on_rollback(state);
+}
+
+/**
+ * Pops the innermost checkpoint from the undo log.
+ */
+void InterCoreChannelResource::on_release() {
+    undo_log.on_release();
+}
+
 /**
  * Dumps documentation for this resource.
  */
@@ -454,12 +659,11 @@ void InterCoreChannelResource::on_dump_state(
         os << line_prefix << "Not yet initialized" << std::endl;
         return;
     }
-    for (utils::UInt core = 0; core < state.size(); core++) {
+    for (utils::UInt core = 0; core < config->num_cores; core++) {
         os << line_prefix << "Core " << core << ":\n";
-        const auto &core_state = state[core];
-        for (utils::UInt channel = 0; channel < core_state.size(); channel++) {
+        for (utils::UInt channel = 0; channel < config->num_channels; channel++) {
             os << line_prefix << "  Channel " << channel << ":\n";
-            core_state[channel].dump_state(os, line_prefix + "    ");
+            state[core * config->num_channels + channel].dump_state(os, line_prefix + "    ");
         }
     }
     os.flush();
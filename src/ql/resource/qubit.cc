@@ -13,45 +13,102 @@ namespace qubit {
  * Initializes this resource.
  */
 void QubitResource::on_initialize(rmgr::Direction direction) {
-    state = utils::Vec<State>(context->platform->qubit_count);
     optimize = direction != rmgr::Direction::UNDEFINED;
+    if (optimize) {
+        horizon = utils::Vec<Horizon>(context->platform->qubit_count);
+    } else {
+        state = utils::Vec<State>(context->platform->qubit_count);
+    }
 }
 
 /**
- * Checks availability of and/or reserves a gate.
+ * Computes the earliest cycles at which the given gates would be accepted,
+ * skipping directly past conflicting reservations.
  */
-utils::Bool QubitResource::on_gate(
+void QubitResource::on_get_earliest(
     utils::Int cycle,
-    const rmgr::resource_types::GateData &gate,
-    utils::Bool commit
+    const utils::Vec<rmgr::resource_types::GateData> &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
 ) {
-
-    // Compute cycle range for this gate.
-    State::Range range = {
-        cycle,
-        cycle + gate.duration_cycles
-    };
-
-    // Check qubit availability for all operands.
-    for (auto qubit : gate.qubits) {
-        if (state[qubit].find(range).type != utils::RangeMatchType::NONE) {
-            return false;
-        }
-    }
-
-    // If we're committing, reserve for all operands.
-    if (commit) {
-        for (auto qubit : gate.qubits) {
-            if (optimize) {
-                state[qubit].clear();
+    utils::Bool backward = get_direction() == rmgr::Direction::BACKWARD;
+    for (utils::UInt i = 0; i < gates.size(); i++) {
+        const auto &gate = gates[i];
+        utils::Int duration = gate.duration_cycles;
+
+        // Move the candidate start cycle past whatever reservation it
+        // conflicts with, until none of the operand qubits conflict anymore.
+        // Any start cycle in between would conflict with the same
+        // reservation.
+        utils::Bool changed = true;
+        while (changed && delays[i] <= max_delay) {
+            changed = false;
+            utils::Int start = backward
+                ? cycle - (utils::Int)delays[i]
+                : cycle + (utils::Int)delays[i];
+            State::Range range = {start, start + duration};
+            for (auto qubit : gate.qubits) {
+                State::Range conflict;
+                if (optimize) {
+                    if (!horizon[qubit].overlaps(range)) {
+                        continue;
+                    }
+                    conflict = {horizon[qubit].first, horizon[qubit].second};
+                } else {
+                    auto result = state[qubit].find(range);
+                    if (result.type == utils::RangeMatchType::NONE) {
+                        continue;
+                    }
+                    conflict = {result.begin->first.first, std::prev(result.end)->first.second};
+                }
+                utils::Int next;
+                if (backward) {
+                    next = conflict.first - duration;
+                    delays[i] += utils::max<utils::Int>(start - next, 1);
+                } else {
+                    next = conflict.second;
+                    delays[i] += utils::max<utils::Int>(next - start, 1);
+                }
+                changed = true;
+                break;
             }
-            state[qubit].set(range);
         }
+        delays[i] = utils::min(delays[i], max_delay + 1);
+
     }
+}
 
+/**
+ * Returns whether this resource supports checkpoints, which it does.
+ */
+utils::Bool QubitResource::on_supports_checkpoints() const {
     return true;
 }
 
+/**
+ * Pushes a checkpoint onto the undo log.
+ */
+void QubitResource::on_checkpoint() {
+    undo_log.on_checkpoint();
+    horizon_undo_log.on_checkpoint();
+}
+
+/**
+ * Undoes all reservations made since the innermost checkpoint.
+ */
+void QubitResource::on_rollback() {
+    undo_log.on_rollback(state);
+    horizon_undo_log.on_rollback(horizon);
+}
+
+/**
+ * Pops the innermost checkpoint from the undo log.
+ */
+void QubitResource::on_release() {
+    undo_log.on_release();
+    horizon_undo_log.on_release();
+}
+
 /**
  * Dumps documentation for this resource.
  */
@@ -92,6 +149,17 @@ void QubitResource::on_dump_state(
     std::ostream &os,
     const utils::Str &line_prefix
 ) const {
+    if (optimize) {
+        for (utils::UInt q = 0; q < horizon.size(); q++) {
+            os << line_prefix << "Qubit " << q << ":\n";
+            if (horizon[q].first > horizon[q].second) {
+                os << line_prefix << "  empty" << std::endl;
+            } else {
+                os << line_prefix << "  [" << horizon[q].first << ".." << horizon[q].second << ")" << std::endl;
+            }
+        }
+        return;
+    }
     for (utils::UInt q = 0; q < state.size(); q++) {
         os << line_prefix << "Qubit " << q << ":\n";
         state[q].dump_state(os, line_prefix + "  ");
@@ -141,6 +141,7 @@ Manager::Manager(
     ir(ir),
     resources()
 {
+    templates.emplace();
 }
 
 /**
@@ -331,6 +332,10 @@ void Manager::add_resource(
     // pointer behind in the resources map.
     resources.set(name) = resource;
 
+    // Previously built states no longer match the list of resources. Note
+    // that the cache may still be in use by copies of this manager.
+    templates.emplace();
+
 }
 
 /**
@@ -355,19 +360,35 @@ void Manager::remove_resource(
         );
     }
     resources.erase(target);
+    templates.emplace();
 }
 
 /**
- * Builds a state tracker from the configured list of resources.
+ * Builds a state tracker from the configured list of resources. The
+ * resources are only initialized the first time this is called for a
+ * particular direction; after that, the result is a clone of the state
+ * built then.
  */
 State Manager::build(Direction direction) const {
-    State state;
-    state.resources.reserve(resources.size());
-    for (const auto &it : resources) {
-        state.resources.emplace_back(it.second.clone());
-        state.resources.back()->initialize(direction);
+    const State *pristine;
+    {
+        std::lock_guard<std::mutex> lock{templates->mutex};
+        auto it = templates->states.find(direction);
+        if (it == templates->states.end()) {
+            State state;
+            state.resources.reserve(resources.size());
+            for (const auto &it2 : resources) {
+                state.resources.emplace_back(it2.second.clone());
+                state.resources.back()->initialize(direction);
+            }
+            it = templates->states.emplace(direction, std::move(state)).first;
+        }
+        pristine = &it->second;
     }
-    return state;
+
+    // The pristine states are never modified once built, so they can be
+    // cloned without holding the lock.
+    return *pristine;
 }
 
 } // namespace rmgr
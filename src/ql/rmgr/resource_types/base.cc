@@ -4,12 +4,37 @@
 
 #include "ql/rmgr/resource_types/base.h"
 
+#include <chrono>
 #include "ql/ir/ops.h"
 
 namespace ql {
 namespace rmgr {
 namespace resource_types {
 
+/**
+ * Returns the counters as a JSON object. The time is in seconds.
+ */
+utils::Json Statistics::to_json() const {
+    utils::Json json;
+    json["probes"] = num_probes.load();
+    json["commits"] = num_commits.load();
+    json["rejections"] = num_rejections.load();
+    json["earliest_queries"] = num_earliest_queries.load();
+    json["time"] = time.load() * 1.0e-9;
+    return json;
+}
+
+/**
+ * Dumps the counters in human-readable form.
+ */
+void Statistics::dump(std::ostream &os, const utils::Str &line_prefix) const {
+    os << line_prefix << "probes: " << num_probes.load() << "\n";
+    os << line_prefix << "commits: " << num_commits.load() << "\n";
+    os << line_prefix << "rejections: " << num_rejections.load() << "\n";
+    os << line_prefix << "earliest-cycle queries: " << num_earliest_queries.load() << "\n";
+    os << line_prefix << "time: " << (time.load() * 1.0e-9) << "s\n";
+}
+
 /**
  * Constructs the abstract resource. No error checking here; this is up to
  * the resource manager.
@@ -32,6 +57,148 @@ void Base::on_initialize(Direction direction) {
     (void)direction;
 }
 
+/**
+ * Returns the scheduling direction that the resource was initialized
+ * with.
+ */
+Direction Base::get_direction() const {
+    return direction;
+}
+
+/**
+ * Converts an old-IR gate to the GateData wrapper passed to on_gate().
+ */
+GateData Base::make_gate_data(const ir::compat::GateRef &gate) const {
+    GateData data;
+    data.gate = gate;
+    data.name = &gate->name;
+    data.duration_cycles = utils::div_ceil(gate->duration, context->platform->cycle_time);
+    data.qubits = gate->operands;
+    data.data = &context->platform->find_instruction(gate->name);
+    return data;
+}
+
+/**
+ * Converts a new-IR statement to the GateData wrapper passed to on_gate().
+ */
+GateData Base::make_gate_data(const ir::StatementRef &statement) const {
+    static const utils::Json EMPTY = {};
+    static const utils::Str NO_NAME = "";
+    static const utils::Str SET_NAME = "set";
+    static const utils::Str GOTO_NAME = "goto";
+    static const utils::Str WAIT_NAME = "wait";
+    static const utils::Str BREAK_NAME = "break";
+    static const utils::Str CONTINUE_NAME = "continue";
+    GateData data;
+    data.statement = statement;
+    data.duration_cycles = ir::get_duration_of_statement(statement);
+
+    // Figure out a name and JSON data record in all cases.
+    if (auto custom = statement->as_custom_instruction()) {
+        data.name = &custom->instruction_type->name;
+        data.data = &custom->instruction_type->data.data;
+    } else if (statement->as_set_instruction()) {
+        data.name = &SET_NAME;
+        data.data = &EMPTY;
+    } else if (statement->as_goto_instruction()) {
+        data.name = &GOTO_NAME;
+        data.data = &EMPTY;
+    } else if (statement->as_wait_instruction()) {
+        data.name = &WAIT_NAME;
+        data.data = &EMPTY;
+    } else if (statement->as_break_statement()) {
+        data.name = &BREAK_NAME;
+        data.data = &EMPTY;
+    } else if (statement->as_continue_statement()) {
+        data.name = &CONTINUE_NAME;
+        data.data = &EMPTY;
+    } else {
+        data.name = &NO_NAME;
+        data.data = &EMPTY;
+    }
+
+    // Figure out main qubit register operands.
+    auto insn = statement.as<ir::Instruction>();
+    if (!insn.empty()) {
+        for (const auto &oper : ir::get_operands(statement.as<ir::Instruction>())) {
+            if (auto ref = oper->as_reference()) {
+                if (
+                    ref->target == context->ir->platform->qubits &&
+                    ref->data_type == context->ir->platform->qubits->data_type &&
+                    ref->indices.size() == 1 &&
+                    ref->indices[0]->as_int_literal()
+                ) {
+                    data.qubits.push_back(ref->indices[0]->as_int_literal()->value);
+                }
+            }
+        }
+    }
+
+    return data;
+}
+
+/**
+ * Abstract implementation for get_earliest(). Each entry of delays is a
+ * lower bound for the number of cycles after cycle (in the scheduling
+ * direction, or forward if there is none) at which the respective gate can
+ * be scheduled; the implementation must increase it to the smallest delay at
+ * which this resource alone accepts the gate, or to max_delay + 1 if that
+ * delay would exceed max_delay. The default implementation probes
+ * on_gate() for each successive cycle; resources that can compute the
+ * earliest cycle directly from their state should override it.
+ */
+void Base::on_get_earliest(
+    utils::Int cycle,
+    const utils::Vec<GateData> &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    auto step = direction == Direction::BACKWARD ? -1 : 1;
+    for (utils::UInt i = 0; i < gates.size(); i++) {
+        while (
+            delays[i] <= max_delay &&
+            !on_gate(cycle + step * (utils::Int)delays[i], gates[i], false)
+        ) {
+            delays[i]++;
+        }
+    }
+}
+
+/**
+ * Abstract implementation for supports_checkpoints(). The default
+ * implementation returns false. Resources that override this to return
+ * true must also override on_checkpoint(), on_rollback(), and on_release(),
+ * and must record how to undo any state change they commit in on_gate()
+ * while a checkpoint is active.
+ */
+utils::Bool Base::on_supports_checkpoints() const {
+    return false;
+}
+
+/**
+ * Abstract implementation for checkpoint(). The default implementation
+ * throws an exception.
+ */
+void Base::on_checkpoint() {
+    throw utils::Exception("resource type " + get_type() + " does not support checkpoints");
+}
+
+/**
+ * Abstract implementation for rollback(). The default implementation
+ * throws an exception.
+ */
+void Base::on_rollback() {
+    throw utils::Exception("resource type " + get_type() + " does not support checkpoints");
+}
+
+/**
+ * Abstract implementation for release(). The default implementation
+ * throws an exception.
+ */
+void Base::on_release() {
+    throw utils::Exception("resource type " + get_type() + " does not support checkpoints");
+}
+
 /**
  * Returns the type name for this resource.
  */
@@ -109,18 +276,28 @@ utils::Bool Base::gate(
     // simply return false. The behavior of the old resources was basically
     // undefined, which we're not going to emulate...
     QL_DOUT("commit = " << commit << ", cycle = " << cycle << ", prev = " << prev_cycle);
-    utils::Bool out_of_order = false;
-    switch (direction) {
-        case Direction::FORWARD: out_of_order = cycle < prev_cycle; break;
-        case Direction::BACKWARD: out_of_order = cycle > prev_cycle; break;
-        default: void();
-    }
-    if (out_of_order) {
+    if (is_out_of_order(cycle)) {
         return false;
     }
 
-    // Run the resource implementation.
-    utils::Bool retval = on_gate(cycle, data, commit);
+    // Run the resource implementation, timing it if statistics are enabled.
+    utils::Bool retval;
+    if (!statistics.has_value()) {
+        retval = on_gate(cycle, data, commit);
+    } else {
+        auto start = std::chrono::steady_clock::now();
+        retval = on_gate(cycle, data, commit);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        statistics->time += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (!commit) {
+            statistics->num_probes++;
+        } else if (retval) {
+            statistics->num_commits++;
+        }
+        if (!retval) {
+            statistics->num_rejections++;
+        }
+    }
 
     // If the above committed a gate, update prev_cycle.
     if (retval && commit) {
@@ -144,15 +321,7 @@ utils::Bool Base::gate(
         throw utils::Exception("resource gate() called before initialization");
     }
 
-    // Convert to GateData wrapper.
-    GateData data;
-    data.gate = gate;
-    data.name = gate->name;
-    data.duration_cycles = utils::div_ceil(gate->duration, context->platform->cycle_time);
-    data.qubits = gate->operands;
-    data.data = &context->platform->find_instruction(gate->name);
-
-    return this->gate((utils::Int)cycle, data, commit);
+    return this->gate((utils::Int)cycle, make_gate_data(gate), commit);
 }
 
 /**
@@ -170,54 +339,157 @@ utils::Bool Base::gate(
         throw utils::Exception("resource gate() called before initialization");
     }
 
-    // Convert to GateData wrapper.
-    static const utils::Json EMPTY = {};
-    GateData data;
-    data.statement = statement;
-    data.duration_cycles = ir::get_duration_of_statement(statement);
+    return this->gate(cycle, make_gate_data(statement), commit);
+}
 
-    // Figure out a name and JSON data record in all cases.
-    if (auto custom = statement->as_custom_instruction()) {
-        data.name = custom->instruction_type->name;
-        data.data = &custom->instruction_type->data.data;
-    } else if (statement->as_set_instruction()) {
-        data.name = "set";
-        data.data = &EMPTY;
-    } else if (statement->as_goto_instruction()) {
-        data.name = "goto";
-        data.data = &EMPTY;
-    } else if (statement->as_wait_instruction()) {
-        data.name = "wait";
-        data.data = &EMPTY;
-    } else if (statement->as_break_statement()) {
-        data.name = "break";
-        data.data = &EMPTY;
-    } else if (statement->as_continue_statement()) {
-        data.name = "continue";
-        data.data = &EMPTY;
+/**
+ * Computes, for each of the given gates, the smallest number of cycles
+ * after cycle (in the scheduling direction, or forward if there is none) at
+ * which this resource would accept the gate, assuming no further gates are
+ * committed in the meantime. The entries of delays should be initialized by
+ * the caller, and are treated as lower bounds; they are only ever
+ * increased. Delays that would exceed max_delay are set to max_delay + 1.
+ * Returns whether any delay was increased. Unlike probing gate() cycle by
+ * cycle, this does all gates in a single call, and lets resources skip
+ * directly past their reservations.
+ */
+utils::Bool Base::get_earliest(
+    utils::Int cycle,
+    const utils::Vec<GateData> &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    if (!initialized) {
+        throw utils::Exception("resource get_earliest() called before initialization");
+    }
+    QL_ASSERT(delays.size() == gates.size());
+    auto before = delays;
+
+    // Gates can't be placed before prev_cycle in the scheduling direction
+    // anymore (see gate()), so start at prev_cycle at the earliest.
+    utils::UInt min_delay = 0;
+    if (direction == Direction::FORWARD && cycle < prev_cycle) {
+        min_delay = prev_cycle - cycle;
+    } else if (direction == Direction::BACKWARD && cycle > prev_cycle) {
+        min_delay = cycle - prev_cycle;
+    }
+    for (auto &delay : delays) {
+        delay = utils::min(utils::max(delay, min_delay), max_delay + 1);
+    }
+
+    // Run the resource implementation, timing it if statistics are enabled.
+    if (!statistics.has_value()) {
+        on_get_earliest(cycle, gates, delays, max_delay);
     } else {
-        data.name = "";
-        data.data = &EMPTY;
+        auto start = std::chrono::steady_clock::now();
+        on_get_earliest(cycle, gates, delays, max_delay);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        statistics->time += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        statistics->num_earliest_queries += gates.size();
     }
 
-    // Figure out main qubit register operands.
-    auto insn = statement.as<ir::Instruction>();
-    if (!insn.empty()) {
-        for (const auto &oper : ir::get_operands(statement.as<ir::Instruction>())) {
-            if (auto ref = oper->as_reference()) {
-                if (
-                    ref->target == context->ir->platform->qubits &&
-                    ref->data_type == context->ir->platform->qubits->data_type &&
-                    ref->indices.size() == 1 &&
-                    ref->indices[0]->as_int_literal()
-                ) {
-                    data.qubits.push_back(ref->indices[0]->as_int_literal()->value);
-                }
-            }
-        }
+    return delays != before;
+}
+
+/**
+ * Same as get_earliest() for GateData wrappers, but for old-IR gates.
+ */
+utils::Bool Base::get_earliest(
+    utils::UInt cycle,
+    const ir::compat::GateRefs &gates,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    utils::Vec<GateData> data;
+    data.reserve(gates.size());
+    for (const auto &gate : gates) {
+        data.push_back(make_gate_data(gate));
+    }
+    return get_earliest((utils::Int)cycle, data, delays, max_delay);
+}
+
+/**
+ * Same as get_earliest() for GateData wrappers, but for new-IR statements.
+ */
+utils::Bool Base::get_earliest(
+    utils::Int cycle,
+    const utils::Vec<ir::StatementRef> &statements,
+    utils::Vec<utils::UInt> &delays,
+    utils::UInt max_delay
+) {
+    utils::Vec<GateData> data;
+    data.reserve(statements.size());
+    for (const auto &statement : statements) {
+        data.push_back(make_gate_data(statement));
+    }
+    return get_earliest(cycle, data, delays, max_delay);
+}
+
+/**
+ * Returns whether this resource supports checkpoint(), rollback(), and
+ * release(). If not, the only way to undo reservations is to restore a
+ * clone of the resource.
+ */
+utils::Bool Base::supports_checkpoints() const {
+    return on_supports_checkpoints();
+}
+
+/**
+ * Pushes a checkpoint. Any gates committed after this can be undone
+ * using rollback(), until the checkpoint is released using release().
+ * Checkpoints can be nested; rollback() and release() always operate on
+ * the innermost active checkpoint.
+ */
+void Base::checkpoint() {
+    if (!initialized) {
+        throw utils::Exception("resource checkpoint() called before initialization");
     }
+    on_checkpoint();
+    checkpoints.push_back(prev_cycle);
+}
 
-    return this->gate(cycle, data, commit);
+/**
+ * Undoes all gates committed since the innermost active checkpoint, and
+ * removes that checkpoint.
+ */
+void Base::rollback() {
+    if (checkpoints.empty()) {
+        throw utils::Exception("resource rollback() called without active checkpoint");
+    }
+    on_rollback();
+    prev_cycle = checkpoints.back();
+    checkpoints.pop_back();
+}
+
+/**
+ * Removes the innermost active checkpoint without undoing anything. The
+ * gates committed since then can still be undone by rolling back an outer
+ * checkpoint, if any.
+ */
+void Base::release() {
+    if (checkpoints.empty()) {
+        throw utils::Exception("resource release() called without active checkpoint");
+    }
+    on_release();
+    checkpoints.pop_back();
+}
+
+/**
+ * Enables the performance counters for this resource. The counters are
+ * shared with all clones of the resource made after this call.
+ */
+void Base::enable_statistics() {
+    if (!statistics.has_value()) {
+        statistics.emplace();
+    }
+}
+
+/**
+ * Returns the performance counters for this resource, or an empty
+ * reference if statistics are disabled.
+ */
+utils::Ptr<const Statistics> Base::get_statistics() const {
+    return statistics.as_const();
 }
 
 /**
@@ -231,6 +503,10 @@ void Base::dump_state(
         throw utils::Exception("resource dump_state() called before initialization");
     }
     on_dump_state(os, line_prefix);
+    if (statistics.has_value()) {
+        os << line_prefix << "Statistics:\n";
+        statistics->dump(os, line_prefix + "  ");
+    }
 }
 
 } // namespace resource_types
@@ -14,7 +14,24 @@ namespace rmgr {
 /**
  * Constructor for the initial state, called from Manager::build().
  */
-State::State() : resources(), is_broken(false) {
+State::State() : resources(), is_broken(false), checkpoints() {
+}
+
+/**
+ * Copies the checkpoint stack of src into this, cloning the resource clones
+ * contained in it.
+ */
+void State::copy_checkpoints(const State &src) {
+    auto &dest = checkpoints;
+    dest.resize(src.checkpoints.size());
+    for (utils::UInt i = 0; i < dest.size(); i++) {
+        const auto &cp = src.checkpoints[i];
+        dest[i].clones.resize(cp.clones.size());
+        for (utils::UInt j = 0; j < cp.clones.size(); j++) {
+            dest[i].clones[j] = cp.clones[j].clone();
+        }
+        dest[i].is_broken = cp.is_broken;
+    }
 }
 
 /**
@@ -26,6 +43,7 @@ State::State(const State &src) {
         resources[i] = src.resources[i].clone();
     }
     is_broken = src.is_broken;
+    copy_checkpoints(src);
 }
 
 /**
@@ -37,6 +55,7 @@ State &State::operator=(const State &src) {
         resources[i] = src.resources[i].clone();
     }
     is_broken = src.is_broken;
+    copy_checkpoints(src);
     return *this;
 }
 
@@ -51,8 +70,12 @@ utils::Bool State::available(
     if (is_broken) {
         throw utils::Exception("usage of resource state that was left in an undefined state");
     }
+    if (resources.empty()) {
+        return true;
+    }
+    auto data = resources.front()->make_gate_data(gate);
     for (auto &resource : resources) {
-        if (!resource->gate(cycle, gate, false)) {
+        if (!resource->gate((utils::Int)cycle, data, false)) {
             return false;
         }
     }
@@ -70,8 +93,12 @@ utils::Bool State::available(
     if (is_broken) {
         throw utils::Exception("usage of resource state that was left in an undefined state");
     }
+    if (resources.empty()) {
+        return true;
+    }
+    auto data = resources.front()->make_gate_data(statement);
     for (auto &resource : resources) {
-        if (!resource->gate(cycle, statement, false)) {
+        if (!resource->gate(cycle, data, false)) {
             return false;
         }
     }
@@ -90,8 +117,12 @@ void State::reserve(
     if (is_broken) {
         throw utils::Exception("usage of resource state that was left in an undefined state");
     }
+    if (resources.empty()) {
+        return;
+    }
+    auto data = resources.front()->make_gate_data(gate);
     for (auto &resource : resources) {
-        if (!resource->gate(cycle, gate, true)) {
+        if (!resource->gate((utils::Int)cycle, data, true)) {
             is_broken = true;
             utils::StrStrm ss;
             ss << "failed to reserve " << gate->qasm();
@@ -116,8 +147,12 @@ void State::reserve(
     if (is_broken) {
         throw utils::Exception("usage of resource state that was left in an undefined state");
     }
+    if (resources.empty()) {
+        return;
+    }
+    auto data = resources.front()->make_gate_data(statement);
     for (auto &resource : resources) {
-        if (!resource->gate(cycle, statement, true)) {
+        if (!resource->gate(cycle, data, true)) {
             is_broken = true;
             utils::StrStrm ss;
             ss << "failed to reserve " << ir::describe(statement);
@@ -129,6 +164,170 @@ void State::reserve(
     }
 }
 
+/**
+ * Runs get_earliest() on all resources until they all agree, i.e. until
+ * none of them increases any delay anymore.
+ */
+template <typename C, typename G>
+static utils::Vec<utils::UInt> get_earliest_of_all(
+    const utils::Vec<ResourceRef> &resources,
+    C cycle,
+    const G &gates,
+    utils::UInt max_delay
+) {
+    utils::Vec<utils::UInt> delays(gates.size(), 0);
+    utils::UInt num_agreeing = 0;
+    utils::UInt index = 0;
+    while (num_agreeing < resources.size()) {
+        if (resources[index]->get_earliest(cycle, gates, delays, max_delay)) {
+            num_agreeing = 1;
+        } else {
+            num_agreeing++;
+        }
+        index = (index + 1) % resources.size();
+    }
+    return delays;
+}
+
+/**
+ * Computes, for each of the given old-IR gates, the earliest (start) cycle
+ * at or after the given cycle at which it could be scheduled, assuming
+ * nothing else is reserved in the meantime. This is done in a single pass
+ * per resource rather than by probing available() cycle by cycle. The
+ * result is returned as the number of cycles after the given cycle; when
+ * this number would exceed max_delay, max_delay + 1 is returned instead.
+ */
+utils::Vec<utils::UInt> State::get_earliest(
+    utils::UInt cycle,
+    const ir::compat::GateRefs &gates,
+    utils::UInt max_delay
+) const {
+    if (is_broken) {
+        throw utils::Exception("usage of resource state that was left in an undefined state");
+    }
+    return get_earliest_of_all(resources, cycle, gates, max_delay);
+}
+
+/**
+ * Computes, for each of the given new-IR statements, the earliest (start)
+ * cycle at or after the given cycle in the scheduling direction at which
+ * it could be scheduled, assuming nothing else is reserved in the
+ * meantime. This is done in a single pass per resource rather than by
+ * probing available() cycle by cycle. The result is returned as the
+ * number of cycles after (or before, when scheduling backward) the given
+ * cycle; when this number would exceed max_delay, max_delay + 1 is
+ * returned instead.
+ */
+utils::Vec<utils::UInt> State::get_earliest(
+    utils::Int cycle,
+    const utils::Vec<ir::StatementRef> &statements,
+    utils::UInt max_delay
+) const {
+    if (is_broken) {
+        throw utils::Exception("usage of resource state that was left in an undefined state");
+    }
+    return get_earliest_of_all(resources, cycle, statements, max_delay);
+}
+
+/**
+ * Makes a checkpoint of the current state, such that all reservations
+ * made after this can be undone using rollback(). This is much cheaper
+ * than copying the state for resources that support checkpoints, because
+ * they only keep an undo log of the reservations made after the
+ * checkpoint; other resources are cloned. Checkpoints can be nested. The
+ * returned token identifies the checkpoint for rollback() and release().
+ */
+utils::UInt State::checkpoint() {
+    Checkpoint cp;
+    cp.clones.resize(resources.size());
+    for (utils::UInt i = 0; i < resources.size(); i++) {
+        if (resources[i]->supports_checkpoints()) {
+            resources[i]->checkpoint();
+        } else {
+            cp.clones[i] = resources[i].clone();
+        }
+    }
+    cp.is_broken = is_broken;
+    checkpoints.push_back(std::move(cp));
+    return checkpoints.size() - 1;
+}
+
+/**
+ * Restores the state to what it was when the checkpoint identified by the
+ * given token was made. The checkpoint and all checkpoints made after it
+ * are no longer active after this.
+ */
+void State::rollback(utils::UInt token) {
+    if (token >= checkpoints.size()) {
+        throw utils::Exception("rollback to inactive resource state checkpoint");
+    }
+    while (checkpoints.size() > token) {
+        auto &cp = checkpoints.back();
+        for (utils::UInt i = 0; i < resources.size(); i++) {
+            if (!cp.clones[i].has_value()) {
+                resources[i]->rollback();
+            } else {
+                resources[i] = std::move(cp.clones[i]);
+            }
+        }
+        is_broken = cp.is_broken;
+        checkpoints.pop_back();
+    }
+}
+
+/**
+ * Deactivates the checkpoint identified by the given token and all
+ * checkpoints made after it, without undoing any reservations. This
+ * should be done as soon as a checkpoint is no longer needed, because
+ * resources keep their undo log for as long as any checkpoint is active.
+ */
+void State::release(utils::UInt token) {
+    if (token >= checkpoints.size()) {
+        throw utils::Exception("release of inactive resource state checkpoint");
+    }
+    while (checkpoints.size() > token) {
+        const auto &cp = checkpoints.back();
+        for (utils::UInt i = 0; i < resources.size(); i++) {
+            if (!cp.clones[i].has_value()) {
+                resources[i]->release();
+            }
+        }
+        checkpoints.pop_back();
+    }
+}
+
+/**
+ * Enables the performance counters of all resources (see
+ * resource_types::Statistics). The counters are shared with all copies of
+ * this state made after this call. They are included in dump() from then
+ * on.
+ */
+void State::enable_statistics() {
+    for (auto &resource : resources) {
+        resource->enable_statistics();
+    }
+}
+
+/**
+ * Returns the performance counters of all resources as a JSON array of
+ * objects, each also containing the name and type of the resource.
+ * Resources for which statistics are disabled are omitted.
+ */
+utils::Json State::get_statistics() const {
+    auto json = utils::Json::array();
+    for (const auto &resource : resources) {
+        auto statistics = resource->get_statistics();
+        if (!statistics.has_value()) {
+            continue;
+        }
+        auto entry = statistics->to_json();
+        entry["name"] = resource->get_name();
+        entry["type"] = resource->get_type();
+        json.push_back(entry);
+    }
+    return json;
+}
+
 /**
  * Dumps a debug representation of the current resource state.
  */
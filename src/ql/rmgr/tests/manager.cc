@@ -0,0 +1,37 @@
+#include "ql/ir/compat/compat.h"
+#include "ql/rmgr/manager.h"
+
+using namespace ql;
+
+int main() {
+    auto plat = ir::compat::Platform::build("test_plat", utils::Str("cc_light"));
+    auto kernel = utils::make<ir::compat::Kernel>("kernel", plat, 7, 32, 10);
+    kernel->x(0);
+    auto gate = kernel->gates[0];
+
+    rmgr::Manager rm(plat);
+    rm.add_resource("Qubit", "qubits");
+
+    // States built for the same direction are clones of the same pristine
+    // state, but must not share their reservations.
+    auto a = rm.build(rmgr::Direction::FORWARD);
+    auto b = rm.build(rmgr::Direction::FORWARD);
+    QL_ASSERT(a.available(0, gate));
+    a.reserve(0, gate);
+    QL_ASSERT(!a.available(0, gate));
+    QL_ASSERT(b.available(0, gate));
+    QL_ASSERT(rm.build(rmgr::Direction::FORWARD).available(0, gate));
+
+    // Copies of the manager share the cache until resources are added or
+    // removed, after which the copy must no longer build the old state.
+    auto copy = rm;
+    copy.remove_resource("qubits");
+    auto c = copy.build(rmgr::Direction::FORWARD);
+    c.reserve(0, gate);
+    QL_ASSERT(c.available(0, gate));
+    auto d = rm.build(rmgr::Direction::FORWARD);
+    d.reserve(0, gate);
+    QL_ASSERT(!d.available(0, gate));
+
+    return 0;
+}
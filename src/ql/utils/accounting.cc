@@ -0,0 +1,121 @@
+/** \file
+ * Optional accounting of the memory allocated for objects constructed with
+ * utils::make(), used by the pass profiler to attribute memory usage to
+ * passes.
+ */
+
+#include "ql/utils/accounting.h"
+
+#include <atomic>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+namespace ql {
+namespace utils {
+
+/**
+ * The number of AccountAllocations objects that currently exist.
+ */
+static std::atomic<UInt> num_enablers{0};
+
+/**
+ * Total number of bytes allocated while accounting was enabled.
+ */
+static std::atomic<UInt> allocated_bytes{0};
+
+/**
+ * Total number of bytes freed of the counted allocations.
+ */
+static std::atomic<UInt> freed_bytes{0};
+
+/**
+ * The largest number of live bytes since the last call to exchange_peak().
+ */
+static std::atomic<UInt> peak_bytes{0};
+
+/**
+ * Returns the number of bytes to count for the given allocation.
+ */
+static UInt get_counted_size(void *ptr, UInt size, Bool from_heap) {
+#ifdef __GLIBC__
+    if (from_heap) {
+        return malloc_usable_size(ptr);
+    }
+#else
+    (void)ptr;
+    (void)from_heap;
+#endif
+    return size;
+}
+
+/**
+ * Raises the peak counter to the given value if it is lower.
+ */
+static void raise_peak(UInt live) {
+    auto peak = peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+/**
+ * Returns whether allocations made by utils::make() are currently being
+ * counted.
+ */
+Bool AllocationAccounting::is_enabled() {
+    return num_enablers.load(std::memory_order_relaxed) > 0;
+}
+
+/**
+ * Records an allocation of the given number of bytes at the given address.
+ */
+void AllocationAccounting::record_allocation(void *ptr, UInt size, Bool from_heap) {
+    size = get_counted_size(ptr, size, from_heap);
+    auto allocated = allocated_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    raise_peak(allocated - freed_bytes.load(std::memory_order_relaxed));
+}
+
+/**
+ * Records a deallocation of an allocation previously recorded with
+ * record_allocation() using the same arguments.
+ */
+void AllocationAccounting::record_deallocation(void *ptr, UInt size, Bool from_heap) noexcept {
+    freed_bytes.fetch_add(get_counted_size(ptr, size, from_heap), std::memory_order_relaxed);
+}
+
+/**
+ * Returns the current values of the counters.
+ */
+AllocationCounters AllocationAccounting::get_counters() {
+    AllocationCounters counters;
+    counters.freed = freed_bytes.load(std::memory_order_relaxed);
+    counters.allocated = allocated_bytes.load(std::memory_order_relaxed);
+    counters.peak = peak_bytes.load(std::memory_order_relaxed);
+    return counters;
+}
+
+/**
+ * Sets the peak counter to the given value or the current number of live
+ * bytes, whichever is larger, and returns its previous value.
+ */
+UInt AllocationAccounting::exchange_peak(UInt peak) {
+    auto live = get_counters().get_live();
+    return peak_bytes.exchange(peak > live ? peak : live, std::memory_order_relaxed);
+}
+
+/**
+ * Enables allocation accounting.
+ */
+AccountAllocations::AccountAllocations() {
+    num_enablers++;
+}
+
+/**
+ * Disables allocation accounting, unless other instances still exist.
+ */
+AccountAllocations::~AccountAllocations() {
+    num_enablers--;
+}
+
+} // namespace utils
+} // namespace ql
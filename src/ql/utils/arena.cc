@@ -0,0 +1,121 @@
+/** \file
+ * Defines a bump allocator for tree nodes, used to avoid the cost of
+ * allocating and freeing many small nodes individually.
+ */
+
+#include "ql/utils/arena.h"
+
+#include <cstddef>
+#include <cstdint>
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Constructs an arena that allocates memory in chunks of at least the
+ * given size.
+ */
+Arena::Arena(UInt chunk_size) :
+    chunk_size(chunk_size), mutex(), chunks(), next(nullptr), remaining(0), allocated(0),
+    reserved(0)
+{
+}
+
+/**
+ * Allocates size bytes of memory with the given alignment, which must be
+ * a power of two no larger than alignof(std::max_align_t).
+ */
+void *Arena::allocate(UInt size, UInt alignment) {
+    if (alignment > alignof(std::max_align_t)) {
+        QL_ICE("arena allocation with unsupported alignment " << alignment);
+    }
+    std::lock_guard<std::mutex> lock{mutex};
+
+    // Skip to the next suitably aligned address in the current chunk, and
+    // start a new chunk if the remainder doesn't fit the allocation. Chunks
+    // are allocated with new[], and are thus suitably aligned for anything.
+    auto padding = (alignment - ((std::uintptr_t)next & (alignment - 1))) & (alignment - 1);
+    if (!next || padding + size > remaining) {
+        auto new_chunk_size = size > chunk_size ? size : chunk_size;
+        chunks.emplace_back(new char[new_chunk_size]);
+        next = chunks.back().get();
+        remaining = new_chunk_size;
+        reserved += new_chunk_size;
+        padding = 0;
+    }
+
+    auto result = next + padding;
+    next = result + size;
+    remaining -= padding + size;
+    allocated += size;
+    return result;
+}
+
+/**
+ * Releases everything allocated from the arena at once, such that the
+ * reserved memory can be reused. This must only be called when none of
+ * the objects allocated from the arena are alive anymore. If the arena
+ * spans multiple chunks, they are merged into a single chunk, such that
+ * the next round of allocations of the same size fits in one chunk.
+ */
+void Arena::reset() {
+    std::lock_guard<std::mutex> lock{mutex};
+    if (chunks.empty()) {
+        return;
+    }
+    if (chunks.size() > 1) {
+        chunks.clear();
+        chunks.emplace_back(new char[reserved]);
+    }
+    next = chunks.front().get();
+    remaining = reserved;
+    allocated = 0;
+}
+
+/**
+ * Returns the total number of bytes handed out by allocate() since
+ * construction or the last reset().
+ */
+UInt Arena::get_allocated() {
+    std::lock_guard<std::mutex> lock{mutex};
+    return allocated;
+}
+
+/**
+ * Returns the total number of bytes reserved by the arena so far.
+ */
+UInt Arena::get_reserved() {
+    std::lock_guard<std::mutex> lock{mutex};
+    return reserved;
+}
+
+/**
+ * The arena that utils::make() allocates from in the current thread, if any.
+ */
+static thread_local ArenaRef active_arena;
+
+/**
+ * Returns the arena that utils::make() allocates from in the current
+ * thread, or an empty pointer if the heap is used.
+ */
+const Ptr<Arena> &Arena::get_active() {
+    return active_arena;
+}
+
+/**
+ * Makes utils::make() allocate from the given arena in the current thread.
+ */
+UseArena::UseArena(const ArenaRef &arena) : previous(active_arena) {
+    active_arena = arena;
+}
+
+/**
+ * Restores the previously active arena of the current thread.
+ */
+UseArena::~UseArena() {
+    active_arena = previous;
+}
+
+} // namespace utils
+} // namespace ql
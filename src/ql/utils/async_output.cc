@@ -0,0 +1,324 @@
+/** \file
+ * Asynchronous writing of side outputs (reports, DOT graphs, cQASM dumps,
+ * etc.), to keep disk I/O off the critical path of compilation.
+ */
+
+#include "ql/utils/async_output.h"
+
+#include "ql/config.h"
+#ifndef QL_SINGLE_THREADED
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+#include "ql/utils/list.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * The instance of AsyncOutput that is active for the calling thread.
+ */
+static thread_local AsyncOutput *current = nullptr;
+
+/**
+ * A file queued for writing.
+ */
+struct AsyncFile {
+    Str path;
+    Bool binary;
+    Str contents;
+};
+
+/**
+ * Writes the given file synchronously. Returns an error message if this
+ * fails, or an empty string if it succeeds.
+ */
+static Str write_file(const AsyncFile &file) {
+    try {
+        OutFile out{file.path, file.binary};
+        out.write(file.contents);
+        out.close();
+    } catch (std::exception &e) {
+        return e.what();
+    }
+    return "";
+}
+
+/**
+ * The queue and background thread of an AsyncOutput object.
+ */
+class AsyncOutput::Writer {
+public:
+
+    /**
+     * Errors encountered since the last flush.
+     */
+    Vec<Str> errors;
+
+#ifndef QL_SINGLE_THREADED
+
+    /**
+     * The maximum number of queued bytes.
+     */
+    UInt max_queued_bytes;
+
+    /**
+     * Protects everything below and errors.
+     */
+    std::mutex mutex;
+
+    /**
+     * Notified when a file is queued, a file has been written, or the writer
+     * is stopping.
+     */
+    std::condition_variable changed;
+
+    /**
+     * The files that still need to be written, in submission order.
+     */
+    List<AsyncFile> queue;
+
+    /**
+     * The total size of the contents of the files in the queue.
+     */
+    UInt queued_bytes = 0;
+
+    /**
+     * Whether the I/O thread is currently writing a file that has already
+     * been removed from the queue.
+     */
+    Bool busy = false;
+
+    /**
+     * Set when the writer is being destroyed.
+     */
+    Bool stopping = false;
+
+    /**
+     * The I/O thread.
+     */
+    std::thread thread;
+
+    /**
+     * Starts the I/O thread.
+     */
+    explicit Writer(UInt max_queued_bytes) : max_queued_bytes(max_queued_bytes) {
+        thread = std::thread([this]() { run(); });
+    }
+
+    /**
+     * Writes the remaining files and stops the I/O thread.
+     */
+    ~Writer() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        changed.notify_all();
+        thread.join();
+    }
+
+    /**
+     * Main loop of the I/O thread. Files are written in submission order, so
+     * when the same file is written more than once, the last write wins.
+     */
+    void run() {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (true) {
+            changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                break;
+            }
+            auto file = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+            lock.unlock();
+            auto error = write_file(file);
+            lock.lock();
+            busy = false;
+            queued_bytes -= file.contents.size();
+            if (!error.empty()) {
+                errors.push_back(error);
+            }
+            changed.notify_all();
+        }
+    }
+
+    /**
+     * Queues the given file, blocking while the queue is full. A file that
+     * exceeds the limit by itself is accepted as soon as the queue is empty.
+     */
+    void submit(AsyncFile &&file) {
+        std::unique_lock<std::mutex> lock{mutex};
+        changed.wait(lock, [this, &file]() {
+            return queued_bytes == 0 || queued_bytes + file.contents.size() <= max_queued_bytes;
+        });
+        queued_bytes += file.contents.size();
+        queue.push_back(std::move(file));
+        lock.unlock();
+        changed.notify_all();
+    }
+
+    /**
+     * Waits until all queued files have been written, and returns the errors
+     * encountered since the previous call.
+     */
+    Vec<Str> wait() {
+        std::unique_lock<std::mutex> lock{mutex};
+        changed.wait(lock, [this]() { return queue.empty() && !busy; });
+        Vec<Str> result;
+        std::swap(result, errors);
+        return result;
+    }
+
+#else
+
+    /**
+     * Without threading support, files are written synchronously.
+     */
+    explicit Writer(UInt max_queued_bytes) {
+        (void)max_queued_bytes;
+    }
+
+    /**
+     * Writes the given file immediately.
+     */
+    void submit(AsyncFile &&file) {
+        auto error = write_file(file);
+        if (!error.empty()) {
+            errors.push_back(error);
+        }
+    }
+
+    /**
+     * Returns the errors encountered since the previous call.
+     */
+    Vec<Str> wait() {
+        Vec<Str> result;
+        std::swap(result, errors);
+        return result;
+    }
+
+#endif
+
+};
+
+/**
+ * Starts asynchronous writing of output files for the calling thread,
+ * queueing at most the given number of bytes.
+ */
+AsyncOutput::AsyncOutput(UInt max_queued_bytes) :
+    writer(new Writer(max_queued_bytes)),
+    previous(current)
+{
+    current = this;
+}
+
+/**
+ * Waits until all queued files have been written, logging any errors, and
+ * reverts to the previously active instance, if any.
+ */
+AsyncOutput::~AsyncOutput() {
+    current = previous;
+    for (const auto &error : writer->wait()) {
+        QL_EOUT("asynchronous output: " << error);
+    }
+}
+
+/**
+ * Waits until all files queued thus far have been written. Throws an
+ * Exception if any of them could not be written.
+ */
+void AsyncOutput::flush() {
+    auto errors = writer->wait();
+    if (!errors.empty()) {
+        StrStrm ss;
+        ss << "failed to write " << errors.size() << " output file(s):";
+        for (const auto &error : errors) {
+            ss << "\n" << error;
+        }
+        QL_SYSTEM_ERROR(ss.str());
+    }
+}
+
+/**
+ * Returns the instance that is active for the calling thread, or nullptr if
+ * files are to be written synchronously.
+ */
+AsyncOutput *AsyncOutput::get_current() {
+    return current;
+}
+
+/**
+ * Queues the given contents to be written to the given file. The path must
+ * already have been made relative to the OpenQL working directory of the
+ * calling thread. Blocks while the queue is full.
+ */
+void AsyncOutput::submit(const Str &path, Bool binary, Str &&contents) {
+    writer->submit({path, binary, std::move(contents)});
+}
+
+/**
+ * Opens the given file, or prepares to write it asynchronously.
+ */
+AsyncOutFile::AsyncOutFile(const Str &path, Bool binary) :
+    path(path_relative_to(get_working_directory(), path)),
+    binary(binary),
+    output(OutputCapture::get_current() ? nullptr : AsyncOutput::get_current())
+{
+    if (!output) {
+        file.emplace(path, binary);
+    }
+}
+
+/**
+ * Closes the file if this has not been done yet.
+ */
+AsyncOutFile::~AsyncOutFile() noexcept(false) {
+    if (output && !std::uncaught_exception()) {
+        close();
+    }
+}
+
+/**
+ * Writes to the file.
+ */
+void AsyncOutFile::write(const Str &content) {
+    if (file.has_value()) {
+        file->write(content);
+    } else {
+        buffer << content;
+    }
+}
+
+/**
+ * Closes the file, or submits its contents to the I/O thread.
+ */
+void AsyncOutFile::close() {
+    if (file.has_value()) {
+        file->close();
+    } else if (output) {
+        auto target = output;
+        output = nullptr;
+        target->submit(path, binary, buffer.str());
+        buffer.str("");
+    }
+}
+
+/**
+ * Provides access to the underlying stream.
+ */
+std::ostream &AsyncOutFile::unwrap() {
+    if (file.has_value()) {
+        return file->unwrap();
+    } else {
+        return buffer;
+    }
+}
+
+} // namespace utils
+} // namespace ql
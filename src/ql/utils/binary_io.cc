@@ -0,0 +1,140 @@
+/** \file
+ * Helpers for reading and writing the little-endian records of OpenQL's
+ * binary file formats.
+ */
+
+#include "ql/utils/binary_io.h"
+
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Constructs a writer that appends to the given buffer.
+ */
+BinaryWriter::BinaryWriter(Str &buf) : buf(buf) {
+}
+
+/**
+ * Writes an unsigned integer using the given number of bytes.
+ */
+void BinaryWriter::write_uint(UInt value, UInt num_bytes) {
+    for (UInt i = 0; i < num_bytes; i++) {
+        buf.push_back((char)((value >> (8 * i)) & 0xFF));
+    }
+}
+
+/**
+ * Writes a signed integer as a 64-bit two's complement number.
+ */
+void BinaryWriter::write_int(Int value) {
+    write_uint((UInt)value);
+}
+
+/**
+ * Writes raw bytes.
+ */
+void BinaryWriter::write_bytes(const char *data, UInt size) {
+    buf.append(data, size);
+}
+
+/**
+ * Writes a length-prefixed string.
+ */
+void BinaryWriter::write_str(const Str &value) {
+    write_uint(value.size());
+    write_bytes(value.data(), value.size());
+}
+
+/**
+ * Writes a JSON value as a length-prefixed CBOR record.
+ */
+void BinaryWriter::write_json(const Json &value) {
+    auto cbor = Json::to_cbor(value);
+    write_uint(cbor.size());
+    write_bytes(reinterpret_cast<const char*>(cbor.data()), cbor.size());
+}
+
+/**
+ * Constructs a reader for the given buffer. what describes the contents
+ * of the buffer for error messages, for example "platform snapshot".
+ */
+BinaryReader::BinaryReader(const char *data, UInt size, const Str &what) :
+    data(data), end(data + size), what(what)
+{
+}
+
+/**
+ * Returns the number of bytes that remain to be read.
+ */
+UInt BinaryReader::remaining() const {
+    return end - data;
+}
+
+/**
+ * Returns a pointer to the next size bytes, and skips past them.
+ */
+const char *BinaryReader::read_bytes(UInt size) {
+    if (size > remaining()) {
+        QL_USER_ERROR(what << " is truncated or corrupt");
+    }
+    auto result = data;
+    data += size;
+    return result;
+}
+
+/**
+ * Reads an unsigned integer stored using the given number of bytes.
+ */
+UInt BinaryReader::read_uint(UInt num_bytes) {
+    auto bytes = read_bytes(num_bytes);
+    UInt value = 0;
+    for (UInt i = 0; i < num_bytes; i++) {
+        value |= ((UInt)(unsigned char)bytes[i]) << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * Reads a signed integer stored as a 64-bit two's complement number.
+ */
+Int BinaryReader::read_int() {
+    return (Int)read_uint();
+}
+
+/**
+ * Reads the length prefix of an array of elements of the given size, and
+ * checks that the array fits in the remaining data.
+ */
+UInt BinaryReader::read_length(UInt element_size) {
+    auto length = read_uint();
+    if (element_size && length > remaining() / element_size) {
+        QL_USER_ERROR(what << " is truncated or corrupt");
+    }
+    return length;
+}
+
+/**
+ * Reads a length-prefixed string.
+ */
+Str BinaryReader::read_str() {
+    auto size = read_length(1);
+    return Str(read_bytes(size), size);
+}
+
+/**
+ * Reads a JSON value stored as a length-prefixed CBOR record.
+ */
+Json BinaryReader::read_json() {
+    auto size = read_length(1);
+    auto bytes = reinterpret_cast<const std::uint8_t*>(read_bytes(size));
+    try {
+        return Json::from_cbor(bytes, bytes + size);
+    } catch (Json::exception &e) {
+        QL_USER_ERROR(what << " contains malformed JSON data: " << e.what());
+    }
+}
+
+} // namespace utils
+} // namespace ql
@@ -0,0 +1,179 @@
+/** \file
+ * Compile-time budgets, allowing expensive algorithms to degrade gracefully
+ * when compilation takes longer than allowed.
+ */
+
+#include "ql/utils/budget.h"
+
+#include <limits>
+#include <mutex>
+#include "ql/utils/logger.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * The budget that is active for the calling thread.
+ */
+static thread_local TimeBudget *current = nullptr;
+
+/**
+ * The degradations reported within an outermost budget.
+ */
+class TimeBudget::Record {
+public:
+
+    /**
+     * When the outermost budget was started.
+     */
+    Clock::time_point start;
+
+    /**
+     * The limit of the outermost budget in seconds, or 0 if it has none.
+     */
+    Real limit;
+
+    /**
+     * Protects degradations.
+     */
+    std::mutex mutex;
+
+    /**
+     * The degradations reported thus far.
+     */
+    Vec<Degradation> degradations;
+
+    Record(Clock::time_point start, Real limit) : start(start), limit(limit) {
+    }
+
+};
+
+/**
+ * Starts a budget of the given number of seconds for the calling thread,
+ * nested in the currently active budget, if any. Zero or less means that
+ * this budget imposes no limit of its own.
+ */
+TimeBudget::TimeBudget(Real seconds) :
+    deadline(Clock::time_point::max()),
+    previous(current)
+{
+    auto now = Clock::now();
+    if (seconds > 0.0) {
+        deadline = now + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<Real>(seconds)
+        );
+    }
+    if (previous) {
+        record = previous->record;
+        if (previous->deadline < deadline) {
+            deadline = previous->deadline;
+        }
+    } else {
+        record = std::make_shared<Record>(now, utils::max(seconds, 0.0));
+    }
+    current = this;
+}
+
+/**
+ * Reverts to the previously active budget, if any.
+ */
+TimeBudget::~TimeBudget() {
+    current = previous;
+}
+
+/**
+ * Returns the budget that is active for the calling thread, or nullptr if
+ * there is none.
+ */
+TimeBudget *TimeBudget::get_current() {
+    return current;
+}
+
+/**
+ * Makes the given budget the active one for the calling thread, returning
+ * the previously active budget. Used to propagate budgets to thread pool
+ * tasks; the given budget must outlive its use.
+ */
+TimeBudget *TimeBudget::exchange_current(TimeBudget *budget) {
+    auto result = current;
+    current = budget;
+    return result;
+}
+
+/**
+ * Returns whether the budget of the calling thread is exhausted. Always
+ * false when no budget with a limit is active.
+ */
+Bool TimeBudget::is_exceeded() {
+    return current && Clock::now() >= current->deadline;
+}
+
+/**
+ * Returns the number of seconds left in the budget of the calling thread,
+ * zero if it is exhausted, or infinity if there is no limit.
+ */
+Real TimeBudget::get_remaining() {
+    if (!current || current->deadline == Clock::time_point::max()) {
+        return std::numeric_limits<Real>::infinity();
+    }
+    auto now = Clock::now();
+    if (now >= current->deadline) {
+        return 0.0;
+    }
+    return std::chrono::duration<Real>(current->deadline - now).count();
+}
+
+/**
+ * Logs a warning stating that the given algorithm or pass degrades as
+ * described by the message due to the compile-time budget, and records it
+ * with the budget of the calling thread, if any. Thread-safe.
+ */
+void TimeBudget::report_degradation(const Str &source, const Str &message) {
+    QL_WOUT(source << ": compile-time budget exceeded; " << message);
+    if (!current) {
+        return;
+    }
+    auto &record = *current->record;
+    Real time = std::chrono::duration<Real>(Clock::now() - record.start).count();
+    std::lock_guard<std::mutex> lock{record.mutex};
+    record.degradations.push_back({source, message, time});
+}
+
+/**
+ * Returns the degradations reported thus far by the code running within
+ * this budget, including nested budgets, in the order they were reported.
+ */
+Vec<TimeBudget::Degradation> TimeBudget::get_degradations() const {
+    std::lock_guard<std::mutex> lock{record->mutex};
+    return record->degradations;
+}
+
+/**
+ * Returns the number of seconds since the outermost budget was started.
+ */
+Real TimeBudget::get_elapsed() const {
+    return std::chrono::duration<Real>(Clock::now() - record->start).count();
+}
+
+/**
+ * Returns a JSON report of the limit, the time elapsed thus far, and the
+ * degradations reported thus far.
+ */
+Json TimeBudget::to_json() const {
+    Json json = Json::object();
+    json["max_compile_time"] = record->limit;
+    json["elapsed"] = get_elapsed();
+    Json degradations = Json::array();
+    for (const auto &degradation : get_degradations()) {
+        Json entry = Json::object();
+        entry["source"] = degradation.source;
+        entry["message"] = degradation.message;
+        entry["time"] = degradation.time;
+        degradations.push_back(entry);
+    }
+    json["degradations"] = degradations;
+    return json;
+}
+
+} // namespace utils
+} // namespace ql
@@ -9,6 +9,8 @@
 #include <cerrno>
 #include <algorithm>
 #include <cctype>
+#include <exception>
+#include <mutex>
 
 #ifdef _WIN32
 #include <direct.h>
@@ -29,9 +31,16 @@ namespace {
 
 /**
  * Stack of working directories. Private; use push_working_directory(),
- * pop_working_directory(), and get_working_directory() to access.
+ * pop_working_directory(), and get_working_directory() to access. This is
+ * thread-local, such that programs being compiled concurrently don't
+ * interfere with each other.
  */
-List<Str> working_directory_stack;
+thread_local List<Str> working_directory_stack;
+
+/**
+ * The output capture that is active for the calling thread.
+ */
+thread_local OutputCapture *current_capture = nullptr;
 
 } // anonymous namespace
 
@@ -59,6 +68,17 @@ void pop_working_directory() {
     working_directory_stack.pop_back();
 }
 
+/**
+ * Replaces the working directory stack of the calling thread with the given
+ * one, and returns the previous stack. This is used to run work on behalf of
+ * another thread (see ThreadPool): a stack with only the result of
+ * get_working_directory() on that thread reproduces its working directory.
+ */
+List<Str> exchange_working_directory_stack(List<Str> &&stack) {
+    std::swap(stack, working_directory_stack);
+    return std::move(stack);
+}
+
 /**
  * Returns OpenQL's current working directory. If no working directory has been
  * set yet, `.` is returned, so the OS working directory is effectively used
@@ -204,12 +224,115 @@ void make_dirs(const Str &path) {
     make_dirs_raw(process_path(path));
 }
 
+/**
+ * The files collected by an OutputCapture.
+ */
+class OutputCapture::Files {
+public:
+
+    /**
+     * Protects files.
+     */
+    mutable std::mutex mutex;
+
+    /**
+     * The files collected thus far.
+     */
+    Map<Str, Str> files;
+
+};
+
+/**
+ * Starts capturing the output files of the calling thread.
+ */
+OutputCapture::OutputCapture() : files(new Files()), previous(current_capture) {
+    current_capture = this;
+}
+
+/**
+ * Reverts to the previously active capture, if any.
+ */
+OutputCapture::~OutputCapture() {
+    current_capture = previous;
+}
+
+/**
+ * Returns the capture that is active for the calling thread, or nullptr if
+ * files are written to disk.
+ */
+OutputCapture *OutputCapture::get_current() {
+    return current_capture;
+}
+
+/**
+ * Makes the given capture the active one for the calling thread, returning
+ * the previously active capture. Used to propagate captures to thread pool
+ * tasks; the given capture must outlive its use.
+ */
+OutputCapture *OutputCapture::exchange_current(OutputCapture *capture) {
+    auto result = current_capture;
+    current_capture = capture;
+    return result;
+}
+
+/**
+ * Returns the key for the given path, as used by store() and load().
+ */
+Str OutputCapture::get_key(const Str &path) {
+    if (working_directory_stack.empty()) {
+        return path;
+    }
+    return process_path(path);
+}
+
+/**
+ * Stores the given contents for the file with the given key, replacing any
+ * previous contents. Thread-safe.
+ */
+void OutputCapture::store(const Str &key, Str &&contents) {
+    std::lock_guard<std::mutex> lock{files->mutex};
+    files->files.set(key) = std::move(contents);
+}
+
+/**
+ * Copies the contents of the file with the given key into contents and
+ * returns true if it has been stored, or returns false if not. Thread-safe.
+ */
+Bool OutputCapture::load(const Str &key, Str &contents) const {
+    std::lock_guard<std::mutex> lock{files->mutex};
+    auto it = files->files.find(key);
+    if (it == files->files.end()) {
+        return false;
+    }
+    contents = it->second;
+    return true;
+}
+
+/**
+ * Returns a copy of all files collected thus far, mapping their keys to their
+ * contents.
+ */
+Map<Str, Str> OutputCapture::get_files() const {
+    std::lock_guard<std::mutex> lock{files->mutex};
+    return files->files;
+}
+
 /**
  * Tries to create a file (if it doesn't already exist) and opens it for
  * writing. If the directory that path is contained by does not exists, it is
- * first created.
+ * first created. The file is opened in text mode unless binary is set. When
+ * an OutputCapture is active, nothing is done on disk; the contents are
+ * buffered instead.
  */
-OutFile::OutFile(const Str &path) : ofs(), path(path) {
+OutFile::OutFile(const Str &path, Bool binary) :
+    ofs(),
+    buffer(),
+    capture(OutputCapture::get_current()),
+    path(path)
+{
+    if (capture) {
+        return;
+    }
     auto processed_path = process_path(path);
 
     // If the parent path does not exist yet, recursively try to create a
@@ -220,16 +343,40 @@ OutFile::OutFile(const Str &path) : ofs(), path(path) {
     }
 
     // Open the file.
-    ofs.open(processed_path);
+    if (binary) {
+        ofs.open(processed_path, std::ios::out | std::ios::binary);
+    } else {
+        ofs.open(processed_path);
+    }
     check();
 
 }
 
+/**
+ * Stores the buffered contents with the output capture if this has not been
+ * done yet. Otherwise, the file is closed by the destructor of the stream.
+ */
+OutFile::~OutFile() {
+    if (capture && !std::uncaught_exception()) {
+        capture->store(OutputCapture::get_key(path), buffer.str());
+    }
+}
+
+/**
+ * Returns the stream that is being written to.
+ */
+std::ostream &OutFile::stream() {
+    if (capture) {
+        return buffer;
+    }
+    return ofs;
+}
+
 /**
  * Writes to the file.
  */
 void OutFile::write(const Str &content) {
-    ofs << content;
+    stream() << content;
     check();
 }
 
@@ -239,6 +386,13 @@ void OutFile::write(const Str &content) {
  * any exceptions from the close() syscall to be caught.
  */
 void OutFile::close() {
+    if (capture) {
+        auto target = capture;
+        capture = nullptr;
+        target->store(OutputCapture::get_key(path), buffer.str());
+        buffer.str("");
+        return;
+    }
     ofs.close();
     check();
 }
@@ -247,31 +401,58 @@ void OutFile::close() {
  * Throws an exception if badbit or failbit are set.
  */
 void OutFile::check() {
-    if (ofs.fail()) {
+    if (stream().fail()) {
         QL_SYSTEM_ERROR("failed to write file \"" << path << "\"");
     }
 }
 
 /**
- * Provides unchecked access to the underlying std::ofstream object.
+ * Provides unchecked access to the underlying stream.
  */
-std::ofstream &OutFile::unwrap() {
-    return ofs;
+std::ostream &OutFile::unwrap() {
+    return stream();
 }
 
 /**
- * Tries to open a file for reading.
+ * Tries to open a file for reading. The file is opened in text mode unless
+ * binary is set.
  */
-InFile::InFile(const Str &path) : ifs(), path(path) {
-    ifs.open(process_path(path));
+InFile::InFile(const Str &path, Bool binary) :
+    ifs(),
+    captured(),
+    is_captured(false),
+    path(path)
+{
+    auto capture = OutputCapture::get_current();
+    Str contents;
+    if (capture && capture->load(OutputCapture::get_key(path), contents)) {
+        captured.str(contents);
+        is_captured = true;
+        return;
+    }
+    if (binary) {
+        ifs.open(process_path(path), std::ios::in | std::ios::binary);
+    } else {
+        ifs.open(process_path(path));
+    }
     check();
 }
 
+/**
+ * Returns the stream that is being read from.
+ */
+std::istream &InFile::stream() {
+    if (is_captured) {
+        return captured;
+    }
+    return ifs;
+}
+
 /**
  * Reads the entire (remainder of the) file to a string.
  */
 Str InFile::read() {
-    Str s{(std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>()};
+    Str s{(std::istreambuf_iterator<char>(stream())), std::istreambuf_iterator<char>()};
     check();
     return s;
 }
@@ -282,7 +463,9 @@ Str InFile::read() {
  * any exceptions from the close() syscall to be caught.
  */
 void InFile::close() {
-    ifs.close();
+    if (!is_captured) {
+        ifs.close();
+    }
     check();
 }
 
@@ -290,7 +473,7 @@ void InFile::close() {
  * Throws an exception if badbit or failbit are set.
  */
 void InFile::check() {
-    if (ifs.fail()) {
+    if (stream().fail()) {
         QL_SYSTEM_ERROR("failed to read file \"" << path << "\"");
     }
 }
@@ -0,0 +1,50 @@
+/** \file
+ * Provides interned strings, i.e. strings that are stored only once for the
+ * whole process such that they can be compared in constant time.
+ */
+
+#include "ql/utils/intern.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace ql {
+namespace utils {
+
+/**
+ * Returns the canonical copy of the given string in the process-wide intern
+ * table, adding it if it does not exist yet. The elements of unordered sets
+ * are never moved, so the returned pointer remains valid for the lifetime of
+ * the process. The table itself is intentionally leaked, such that interned
+ * strings can still be used by static destructors.
+ */
+static const Str *intern(const Str &str) {
+    static std::mutex *mutex = new std::mutex();
+    static std::unordered_set<Str> *table = new std::unordered_set<Str>();
+    std::lock_guard<std::mutex> lock{*mutex};
+    return &*table->insert(str).first;
+}
+
+/**
+ * Constructs the interned empty string.
+ */
+InternedStr::InternedStr() {
+    static const Str *empty = intern("");
+    ptr = empty;
+}
+
+/**
+ * Interns the given string.
+ */
+InternedStr::InternedStr(const Str &str) : ptr(intern(str)) {
+}
+
+/**
+ * Stream << overload for interned strings.
+ */
+std::ostream &operator<<(std::ostream &os, const InternedStr &str) {
+    return os << str.str();
+}
+
+} // namespace utils
+} // namespace ql
@@ -6,29 +6,89 @@
 #include "ql/utils/json.h"
 
 #include <fstream>
+#include <streambuf>
+#include <algorithm>
+#include <cstring>
 #include "ql/utils/str.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace ql {
 namespace utils {
 
+namespace {
+
 /**
- * Parses JSON data that may include // comments.
+ * Read-only stream buffer over a range of memory, such that data that is
+ * already in memory can be parsed via operator>> without copying it.
  */
-Json parse_json(std::istream &is) {
-    Json j;
-    std::stringstream stripped; // file contents with comments stripped
-    Str line;
-
-    // strip comments
-    while (getline(is, line)) {
-        Str::size_type n = line.find("//");
-        if (n != Str::npos) line.erase(n);
-        std::istringstream iss(line);
-        stripped << line;
+class MemoryBuffer : public std::streambuf {
+public:
+    MemoryBuffer(const char *data, UInt size) {
+        auto begin = const_cast<char*>(data);
+        setg(begin, begin, begin + size);
+    }
+};
+
+} // anonymous namespace
+
+/**
+ * Calls fn for each line of the given data, with // comments stripped.
+ * Lines are separated by '\n', like std::getline() does.
+ */
+template <class F>
+static void for_each_stripped_line(const char *data, UInt size, F fn) {
+    const char *end = data + size;
+    const char *line = data;
+    while (line < end) {
+        auto eol = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!eol) eol = end;
+        const char *cut = line;
+        while (cut < eol && !(cut[0] == '/' && cut + 1 < eol && cut[1] == '/')) cut++;
+        fn(line, cut);
+        line = eol + (eol < end ? 1 : 0);
+        if (eol == end) break;
+    }
+}
+
+/**
+ * Parses JSON data that may include // comments from memory.
+ *
+ * Comments are stripped by removing everything from // up to the end of each
+ * line, and the lines are then concatenated without line separators before
+ * parsing, so the error positions reported by the parser are relative to
+ * that. When the data does not contain // at all, the data is first parsed
+ * in place (strictly, i.e. it may not contain anything after the toplevel
+ * value), without making a stripped copy; if that fails, the data is parsed
+ * again the normal way, such that the result and any error messages are the
+ * same.
+ */
+static Json parse_json_data(const char *data, UInt size) {
+    static const Str COMMENT = "//";
+    if (std::search(data, data + size, COMMENT.begin(), COMMENT.end()) == data + size) {
+        try {
+            return Json::parse(data, data + size);
+        } catch (Json::exception &) {
+        }
     }
 
+    // Strip comments.
+    Str stripped;
+    stripped.reserve(size);
+    for_each_stripped_line(data, size, [&stripped](const char *begin, const char *end) {
+        stripped.append(begin, end);
+    });
+
+    Json j;
     try {
-        stripped >> j;  // pass stripped line to json. NB: the whole file must be passed in 1 go
+        MemoryBuffer buffer{stripped.data(), stripped.size()};
+        std::istream is{&buffer};
+        is >> j;  // NB: the whole file must be passed in 1 go
     } catch (Json::parse_error &e) {
         // treat parse errors separately to give the user a clue about what's wrong
         QL_EOUT("error parsing JSON file : \n\t" << e.what());
@@ -36,11 +96,8 @@ Json parse_json(std::istream &is) {
             // go through file once again to find error position
             unsigned int lineNr = 1;
             size_t absPos = 0;
-            is.clear();
-            is.seekg(0, std::ios::beg);
-            while (getline(is, line)) {
-                Str::size_type n = line.find("//");
-                if (n != Str::npos) line.erase(n);
+            for_each_stripped_line(data, size, [&](const char *begin, const char *end) {
+                Str line{begin, end};
                 if (e.byte >= absPos && e.byte < absPos + line.size()) {
                     unsigned int relPos = e.byte - absPos;
                     line = utils::replace_all(line, "\t", " "); // make a TAB take one position
@@ -53,7 +110,7 @@ Json parse_json(std::istream &is) {
                 }
                 lineNr++;
                 absPos += line.size();
-            }
+            });
             QL_FATAL("error position " << e.byte << " points beyond last file position " << absPos);
         } else {
             QL_FATAL("no information on error position");
@@ -65,18 +122,48 @@ Json parse_json(std::istream &is) {
     return j;
 }
 
+/**
+ * Parses JSON data that may include // comments.
+ */
+Json parse_json(std::istream &is) {
+    Str data{(std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>()};
+    return parse_json_data(data.data(), data.size());
+}
+
 /**
  * Parses JSON data that may include // comments.
  */
 Json parse_json(const Str &data) {
-    auto is = std::istringstream(data);
-    return parse_json(is);
+    return parse_json_data(data.data(), data.size());
 }
 
 /**
- * Loads a JSON file that may include // comments.
+ * Loads a JSON file that may include // comments. Where supported, the file
+ * is memory-mapped rather than read into a buffer.
  */
 Json load_json(const Str &path) {
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        QL_FATAL("failed to open file '" << path << "'");
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    UInt size = 0;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        size = st.st_size;
+        data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (data != MAP_FAILED) {
+        struct Unmap {
+            void *data;
+            UInt size;
+            ~Unmap() { munmap(data, size); }
+        } unmap{data, size};
+        return parse_json_data(static_cast<const char*>(data), size);
+    }
+#endif
     std::ifstream fs(path);
     if (fs.is_open()) {
         return parse_json(fs);
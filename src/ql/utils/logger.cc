@@ -3,6 +3,13 @@
  */
 
 #include "ql/utils/logger.h"
+
+#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "ql/utils/exception.h"
 
 namespace ql {
@@ -43,6 +50,353 @@ void set_log_level(const Str &level) {
     log_level = log_level_from_string(level);
 }
 
+/**
+ * The capture that the current thread is redirected to, if any.
+ */
+static thread_local Capture *active_capture = nullptr;
+
+namespace {
+
+/**
+ * Single-producer, single-consumer ring buffer of log messages. The producer
+ * is the thread that owns the buffer, the consumer is the background writer.
+ */
+class Ring {
+public:
+
+    /**
+     * The number of messages that can be queued before the producer has to
+     * wait for the writer.
+     */
+    static constexpr UInt CAPACITY = 1024;
+
+    /**
+     * The message slots.
+     */
+    Vec<Str> slots = Vec<Str>(CAPACITY);
+
+    /**
+     * Index of the next slot to be written by the producer (modulo CAPACITY).
+     */
+    std::atomic<UInt> head{0};
+
+    /**
+     * Index of the next slot to be read by the consumer (modulo CAPACITY).
+     */
+    std::atomic<UInt> tail{0};
+
+    /**
+     * Set when the producing thread has terminated, such that another thread
+     * can take over the buffer.
+     */
+    std::atomic<Bool> released{false};
+
+};
+
+/**
+ * The background writer that drains the ring buffers of all threads to
+ * stdout.
+ */
+class Writer {
+private:
+
+    /**
+     * Protects rings and thread. Only taken when a thread logs for the first
+     * time, and by the writer thread once per drain cycle.
+     */
+    std::mutex mutex;
+
+    /**
+     * The ring buffers of all threads that have logged something.
+     */
+    Vec<std::unique_ptr<Ring>> rings;
+
+    /**
+     * The background thread, started when the first ring is acquired.
+     */
+    std::thread thread;
+
+    /**
+     * Set when the writer is shutting down. Messages are then written
+     * synchronously.
+     */
+    std::atomic<Bool> stopping{false};
+
+    /**
+     * Serializes stop() with starting the background thread.
+     */
+    std::mutex stop_mutex;
+
+    /**
+     * The number of messages queued and written so far, used by flush().
+     */
+    std::atomic<UInt> queued{0};
+    std::atomic<UInt> written{0};
+
+    /**
+     * Moves all pending messages from the rings to stdout, without flushing.
+     * Returns the number of messages written.
+     */
+    UInt drain() {
+        Str batch;
+        UInt count = 0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const auto &ring : rings) {
+                UInt tail = ring->tail.load(std::memory_order_relaxed);
+                UInt head = ring->head.load(std::memory_order_acquire);
+                for (UInt i = tail; i != head; i++) {
+                    auto &slot = ring->slots[i % Ring::CAPACITY];
+                    batch += slot;
+                    batch += '\n';
+                    Str().swap(slot);
+                }
+                ring->tail.store(head, std::memory_order_release);
+                count += head - tail;
+            }
+        }
+        if (count) {
+            std::cout.write(batch.data(), batch.size());
+            written.fetch_add(count, std::memory_order_release);
+        }
+        return count;
+    }
+
+    /**
+     * Main loop of the background thread.
+     */
+    void run() {
+        while (true) {
+            if (drain()) continue;
+            if (stopping.load(std::memory_order_acquire)) {
+                if (!drain()) break;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        finished.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Set by the background thread when it is done.
+     */
+    std::atomic<Bool> finished{false};
+
+public:
+
+    /**
+     * Returns a ring buffer for the calling thread, either by taking over
+     * the buffer of a thread that has terminated or by creating a new one.
+     */
+    Ring *acquire() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!thread.joinable() && !stopping.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> stop_lock(stop_mutex);
+            thread = std::thread([this]() { run(); });
+        }
+        for (const auto &ring : rings) {
+            Bool expected = true;
+            if (ring->released.compare_exchange_strong(expected, false, std::memory_order_acq_rel)) {
+                return ring.get();
+            }
+        }
+        rings.emplace_back(new Ring());
+        return rings.back().get();
+    }
+
+    /**
+     * Queues the given message in the given ring buffer, owned by the calling
+     * thread.
+     */
+    void push(Ring &ring, const Str &message) {
+        if (stopping.load(std::memory_order_acquire)) {
+            std::cout << (message + "\n");
+            return;
+        }
+        UInt head = ring.head.load(std::memory_order_relaxed);
+        while (head - ring.tail.load(std::memory_order_acquire) >= Ring::CAPACITY) {
+            if (stopping.load(std::memory_order_acquire)) {
+                std::cout << (message + "\n");
+                return;
+            }
+            std::this_thread::yield();
+        }
+        ring.slots[head % Ring::CAPACITY] = message;
+        queued.fetch_add(1, std::memory_order_relaxed);
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * Waits until all messages queued so far have been written, and flushes
+     * stdout.
+     */
+    void flush() {
+        UInt target = queued.load(std::memory_order_acquire);
+        while (written.load(std::memory_order_acquire) < target && !stopping.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        std::cout.flush();
+    }
+
+    /**
+     * Writes out all pending messages and stops the background thread.
+     * Messages written after this are written synchronously. Note that the
+     * background thread may already have been terminated when this is called
+     * during process exit on some platforms, in which case we drain the
+     * buffers ourselves.
+     */
+    void stop() {
+        stopping.store(true, std::memory_order_release);
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex);
+            if (thread.joinable()) {
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                while (!finished.load(std::memory_order_acquire) && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+                if (finished.load(std::memory_order_acquire)) {
+                    thread.join();
+                } else {
+                    thread.detach();
+                }
+            }
+        }
+        drain();
+        std::cout.flush();
+    }
+
+};
+
+/**
+ * Returns the writer for this process. It is intentionally never destroyed,
+ * such that messages logged by static destructors remain safe.
+ */
+Writer &get_writer() {
+    static Writer *writer = new Writer();
+    return *writer;
+}
+
+/**
+ * Stops the writer when the library is unloaded or the process exits.
+ */
+struct Shutdown {
+    ~Shutdown() {
+        get_writer().stop();
+    }
+} shutdown;
+
+/**
+ * Handle to the ring buffer of a thread, releasing it for reuse when the
+ * thread terminates.
+ */
+class RingHandle {
+public:
+
+    /**
+     * The ring buffer, acquired when the thread first logs something.
+     */
+    Ring *ring = nullptr;
+
+    /**
+     * Releases the ring buffer.
+     */
+    ~RingHandle() {
+        if (ring) {
+            ring->released.store(true, std::memory_order_release);
+        }
+    }
+
+};
+
+/**
+ * The ring buffer handle for the current thread.
+ */
+thread_local RingHandle ring_handle;
+
+} // anonymous namespace
+
+constexpr UInt Ring::CAPACITY;
+
+/**
+ * Writes a single formatted log message followed by a newline to stderr (if
+ * to_stderr is set) or stdout, or to the Capture that the calling thread is
+ * currently redirected to, if any. Messages from different threads do not
+ * interleave within a line.
+ *
+ * Messages for stdout are queued in a lock-free ring buffer for the calling
+ * thread, which a background thread drains to stdout without flushing after
+ * every line. Messages for stderr first flush() all queued messages, and are
+ * then written and flushed immediately, so errors and warnings still appear
+ * in order with respect to the preceding messages of the same thread.
+ */
+void write_message(Bool to_stderr, const Str &message) {
+    if (active_capture) {
+        std::lock_guard<std::mutex> lock{active_capture->mutex};
+        active_capture->messages.emplace_back(to_stderr, message);
+    } else if (to_stderr) {
+        get_writer().flush();
+        std::cerr << (message + "\n") << std::flush;
+    } else {
+        if (!ring_handle.ring) {
+            ring_handle.ring = get_writer().acquire();
+        }
+        get_writer().push(*ring_handle.ring, message);
+    }
+}
+
+/**
+ * Waits until all messages queued by write_message() so far have been
+ * written, and then flushes stdout.
+ */
+void flush() {
+    get_writer().flush();
+}
+
+/**
+ * Writes all captured messages out using write_message(), in the order in
+ * which they were captured, and clears the capture.
+ */
+void Capture::replay() {
+    Vec<Pair<Bool, Str>> to_replay;
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        std::swap(to_replay, messages);
+    }
+    for (const auto &message : to_replay) {
+        write_message(message.first, message.second);
+    }
+}
+
+/**
+ * Returns the capture that the current thread is redirected to, or nullptr
+ * if it is not redirected.
+ */
+Capture *get_active_capture() {
+    return active_capture;
+}
+
+/**
+ * Redirects the log messages of the current thread to the given capture.
+ */
+Redirect::Redirect(Capture &capture) : previous(active_capture) {
+    active_capture = &capture;
+}
+
+/**
+ * Same as above, but nullptr can be passed to undo any redirection for as
+ * long as this object exists.
+ */
+Redirect::Redirect(Capture *capture) : previous(active_capture) {
+    active_capture = capture;
+}
+
+/**
+ * Restores the previous redirection of the current thread.
+ */
+Redirect::~Redirect() {
+    active_capture = previous;
+}
+
 } // namespace logger
 } // namespace utils
 } // namespace ql
@@ -317,11 +317,11 @@ Str IntegerOption::syntax() const {
         if (maximum == MAX) {
             s << "any integer";
         } else {
-            s << "an integer greater than or equal to " << maximum;
+            s << "an integer less than or equal to " << maximum;
         }
     } else {
         if (maximum == MAX) {
-            s << "an integer less than or equal to " << minimum;
+            s << "an integer greater than or equal to " << minimum;
         } else {
             s << "an integer between " << minimum << " and " << maximum << " inclusive";
         }
@@ -584,6 +584,19 @@ void Options::update_from(const Options &src) {
     }
 }
 
+/**
+ * Returns the names and values of all options that were explicitly set.
+ */
+utils::Map<utils::Str, utils::Str> Options::get_set_options() const {
+    utils::Map<utils::Str, utils::Str> result;
+    for (const auto &it : options) {
+        if (it.second->is_set()) {
+            result.set(it.first) = it.second->as_str();
+        }
+    }
+    return result;
+}
+
 /**
  * Resets all options to their default values.
  */
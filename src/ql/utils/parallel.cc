@@ -0,0 +1,523 @@
+/** \file
+ * Provides simple utilities for running independent pieces of work on multiple
+ * threads.
+ */
+
+#include "ql/utils/parallel.h"
+
+#include <atomic>
+#include <exception>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "ql/config.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/list.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/budget.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Returns the number of hardware threads available to us, or 1 if the
+ * standard library can't tell us.
+ */
+UInt get_hardware_concurrency() {
+    UInt n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/**
+ * Resolves a user-specified thread count to the actual number of threads to
+ * use. 0 is interpreted as "use all hardware threads." Always returns 1 when
+ * OpenQL is built with QL_SINGLE_THREADED.
+ */
+UInt resolve_num_threads(UInt num_threads) {
+#ifdef QL_SINGLE_THREADED
+    (void)num_threads;
+    return 1;
+#else
+    if (!num_threads) {
+        return get_hardware_concurrency();
+    }
+    return num_threads;
+#endif
+}
+
+/**
+ * The deques, workers, and synchronization primitives of a ThreadPool.
+ */
+class ThreadPool::State {
+public:
+
+    /**
+     * A deque of tasks, with the mutex protecting it.
+     */
+    struct Deque {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /**
+     * The deques. Index 0 is the injection deque for tasks submitted by
+     * threads that aren't workers of this pool; index i > 0 belongs to
+     * worker i.
+     */
+    Vec<std::unique_ptr<Deque>> deques;
+
+    /**
+     * The total number of tasks in the deques.
+     */
+    std::atomic<UInt> num_queued{0};
+
+    /**
+     * The number of tasks submitted to this state that haven't finished yet,
+     * including tasks that are about to be pushed. The state is only
+     * replaced when this is zero.
+     */
+    std::atomic<UInt> num_pending{0};
+
+    /**
+     * The number of worker threads this state was created with.
+     */
+    const UInt num_workers;
+
+    /**
+     * Protects stopping, and used along with changed to wait for tasks or
+     * completion.
+     */
+    std::mutex mutex;
+
+    /**
+     * Notified when a task is queued, when the pool is stopping, and by
+     * notify().
+     */
+    std::condition_variable changed;
+
+    /**
+     * Set when the state is being destroyed or replaced.
+     */
+    Bool stopping = false;
+
+    /**
+     * The worker threads.
+     */
+    Vec<std::thread> workers;
+
+    /**
+     * The pool state that the calling thread is a worker of, if any.
+     */
+    static thread_local State *worker_state;
+
+    /**
+     * The deque index of the calling thread within worker_state.
+     */
+    static thread_local UInt worker_index;
+
+    /**
+     * Starts the given number of worker threads.
+     */
+    explicit State(UInt num_workers);
+
+    /**
+     * Stops the worker threads once they have run the remaining tasks. The
+     * state can still be used afterwards, but tasks pushed to it from then on
+     * are only run by threads calling run_pending_task().
+     */
+    void stop();
+
+    /**
+     * Runs the remaining tasks and stops the worker threads.
+     */
+    ~State();
+
+    /**
+     * Returns the index of the deque belonging to the calling thread.
+     */
+    UInt get_own_deque() const;
+
+    /**
+     * Pushes the given task to the back of the given deque.
+     */
+    void push(UInt index, std::function<void()> &&task);
+
+    /**
+     * Runs a single pending task, taken from the back of the given deque, or
+     * stolen from the front of another. Returns whether a task was run.
+     */
+    Bool run_pending_task(UInt own);
+
+    /**
+     * Wakes up all threads waiting on changed.
+     */
+    void notify();
+
+    /**
+     * Main loop of worker thread index.
+     */
+    void run_worker(UInt index);
+
+};
+
+/**
+ * The pool state that the calling thread is a worker of, if any.
+ */
+thread_local ThreadPool::State *ThreadPool::State::worker_state = nullptr;
+
+/**
+ * The deque index of the calling thread within worker_state.
+ */
+thread_local UInt ThreadPool::State::worker_index = 0;
+
+/**
+ * Starts the given number of worker threads.
+ */
+ThreadPool::State::State(UInt num_workers) : num_workers(num_workers) {
+    deques.reserve(num_workers + 1);
+    for (UInt i = 0; i <= num_workers; i++) {
+        deques.emplace_back(new Deque());
+    }
+#ifndef QL_SINGLE_THREADED
+    workers.reserve(num_workers);
+    for (UInt i = 1; i <= num_workers; i++) {
+        workers.emplace_back([this, i]() { run_worker(i); });
+    }
+#endif
+}
+
+/**
+ * Stops the worker threads once they have run the remaining tasks. The state
+ * can still be used afterwards, but tasks pushed to it from then on are only
+ * run by threads calling run_pending_task().
+ */
+void ThreadPool::State::stop() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+/**
+ * Runs the remaining tasks and stops the worker threads.
+ */
+ThreadPool::State::~State() {
+    stop();
+    while (run_pending_task(0));
+}
+
+/**
+ * Returns the index of the deque belonging to the calling thread.
+ */
+UInt ThreadPool::State::get_own_deque() const {
+    return worker_state == this ? worker_index : 0;
+}
+
+/**
+ * Pushes the given task to the back of the given deque.
+ */
+void ThreadPool::State::push(UInt index, std::function<void()> &&task) {
+    {
+        std::lock_guard<std::mutex> lock{deques[index]->mutex};
+        deques[index]->tasks.push_back(std::move(task));
+    }
+    num_queued.fetch_add(1);
+    notify();
+}
+
+/**
+ * Runs a single pending task, taken from the back of the given deque, or
+ * stolen from the front of another. Returns whether a task was run.
+ */
+Bool ThreadPool::State::run_pending_task(UInt own) {
+    std::function<void()> task;
+    for (UInt i = 0; i < deques.size() && !task; i++) {
+        auto &deque = *deques[(own + i) % deques.size()];
+        std::lock_guard<std::mutex> lock{deque.mutex};
+        if (deque.tasks.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(deque.tasks.back());
+            deque.tasks.pop_back();
+        } else {
+            task = std::move(deque.tasks.front());
+            deque.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    num_queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+/**
+ * Wakes up all threads waiting on changed.
+ */
+void ThreadPool::State::notify() {
+    {
+        std::lock_guard<std::mutex> lock{mutex};
+    }
+    changed.notify_all();
+}
+
+/**
+ * Main loop of worker thread index.
+ */
+void ThreadPool::State::run_worker(UInt index) {
+    worker_state = this;
+    worker_index = index;
+    while (true) {
+        if (run_pending_task(index)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock{mutex};
+        changed.wait(lock, [this]() { return stopping || num_queued.load() > 0; });
+        if (stopping && !num_queued.load()) {
+            break;
+        }
+    }
+    worker_state = nullptr;
+}
+
+/**
+ * Constructs the pool, using all hardware threads.
+ */
+ThreadPool::ThreadPool() : num_threads(resolve_num_threads(0)) {
+}
+
+/**
+ * Runs the remaining tasks and stops the worker threads.
+ */
+ThreadPool::~ThreadPool() = default;
+
+/**
+ * Returns the process-wide pool. This is intentionally never destroyed, as
+ * joining threads from static destructors can deadlock when OpenQL is loaded
+ * as a shared library.
+ */
+ThreadPool &ThreadPool::get() {
+    static ThreadPool *pool = new ThreadPool();
+    return *pool;
+}
+
+/**
+ * Sets the maximum total number of threads working on tasks, including the
+ * thread waiting for them, after resolving it with resolve_num_threads(); the
+ * pool thus uses one worker thread less than this. This is controlled by the
+ * num_threads global option. The workers are (re)started lazily, when the
+ * next task is submitted; if tasks are still pending at that time, the resize
+ * is deferred to the first submission after they are done. This may be called
+ * from any thread.
+ */
+void ThreadPool::set_num_threads(UInt new_num_threads) {
+    num_threads.store(resolve_num_threads(new_num_threads));
+}
+
+/**
+ * Returns the maximum total number of threads working on tasks, as set by
+ * set_num_threads().
+ */
+UInt ThreadPool::get_num_threads() const {
+    return num_threads.load();
+}
+
+/**
+ * Returns the state to submit a task to, creating it if there is none, and
+ * replacing it if the number of threads changed and no tasks are pending. The
+ * task is counted as pending for the returned state, such that it can't be
+ * replaced before the task is pushed.
+ */
+ThreadPool::State *ThreadPool::acquire_state() {
+    std::lock_guard<std::mutex> lock{state_mutex};
+    auto current = state.load();
+    auto num_workers = num_threads.load() - 1;
+    if (!current || (current->num_workers != num_workers && !current->num_pending.load())) {
+
+        // The previous state is stopped, but not destroyed: threads that
+        // loaded it before it was replaced may still be waiting on it.
+        if (current) {
+            current->stop();
+        }
+        states.emplace_back(new State(num_workers));
+        current = states.back().get();
+        state.store(current);
+
+    }
+    current->num_pending.fetch_add(1);
+    return current;
+}
+
+/**
+ * Queues the given task.
+ */
+void ThreadPool::submit(std::function<void()> &&task) {
+
+    // Wrap the task such that it runs with the log redirection, working
+    // directory, output capture, and compile-time budget of the calling
+    // thread.
+    auto capture = logger::get_active_capture();
+    auto directory = get_working_directory();
+    auto output_capture = OutputCapture::get_current();
+    auto budget = TimeBudget::get_current();
+    auto wrapped = [capture, directory, output_capture, budget, task]() {
+        logger::Redirect redirect{capture};
+        auto previous = exchange_working_directory_stack({directory});
+        auto previous_output_capture = OutputCapture::exchange_current(output_capture);
+        auto previous_budget = TimeBudget::exchange_current(budget);
+        try {
+            task();
+        } catch (std::exception &e) {
+            QL_EOUT("uncaught exception in thread pool task: " << e.what());
+        } catch (...) {
+            QL_EOUT("uncaught exception in thread pool task");
+        }
+        TimeBudget::exchange_current(previous_budget);
+        OutputCapture::exchange_current(previous_output_capture);
+        exchange_working_directory_stack(std::move(previous));
+    };
+
+    // Without workers, just run the task.
+    if (num_threads.load() <= 1) {
+        wrapped();
+        return;
+    }
+
+    auto target = acquire_state();
+    target->push(target->get_own_deque(), [target, wrapped]() {
+        wrapped();
+        target->num_pending.fetch_sub(1);
+    });
+}
+
+/**
+ * Runs a single pending task on the calling thread, if there is one. Returns
+ * whether a task was run.
+ */
+Bool ThreadPool::run_pending_task() {
+    auto current = state.load();
+    if (!current) {
+        return false;
+    }
+    return current->run_pending_task(current->get_own_deque());
+}
+
+/**
+ * Blocks until done() returns true, running pending tasks in the meantime.
+ * The tasks signalling completion must call notify() after updating whatever
+ * state done() checks.
+ */
+void ThreadPool::wait_until(const std::function<Bool()> &done) {
+    while (!done()) {
+        auto current = state.load();
+        if (!current) {
+            QL_ICE("waiting for thread pool tasks that were never submitted");
+        }
+        if (current->run_pending_task(current->get_own_deque())) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock{current->mutex};
+        current->changed.wait(lock, [current, &done]() {
+            return done() || current->num_queued.load() > 0;
+        });
+    }
+}
+
+/**
+ * Wakes up the threads blocked in wait_until(), such that they re-evaluate
+ * their condition.
+ */
+void ThreadPool::notify() {
+    if (auto current = state.load()) {
+        current->notify();
+    }
+}
+
+/**
+ * Calls fn(i) for all i in [0, count), using at most num_threads threads
+ * (after resolving it with resolve_num_threads()), and no more than the
+ * num_threads global option allows; the additional threads are taken from
+ * ThreadPool. The calling thread participates in the work, so nothing is
+ * submitted to the pool at all when the effective thread count or count is
+ * one (or less). Calls to parallel_for() may be nested. The order in which the
+ * indices are processed is undefined, so fn must only touch state that
+ * belongs to index i, or otherwise synchronize itself.
+ *
+ * If one or more calls to fn throw an exception, the remaining indices that
+ * haven't been started yet are skipped, and once all threads are done, the
+ * exception thrown for the lowest index is rethrown in the calling thread.
+ */
+void parallel_for(
+    UInt count,
+    UInt num_threads,
+    const std::function<void(UInt)> &fn
+) {
+    auto &pool = ThreadPool::get();
+    num_threads = min(min(resolve_num_threads(num_threads), pool.get_num_threads()), count);
+
+    // Don't bother with threads at all if we would only use one.
+    if (num_threads <= 1) {
+        for (UInt i = 0; i < count; i++) {
+            fn(i);
+        }
+        return;
+    }
+
+    // Shared state for the workers. Indices are handed out dynamically, so
+    // unevenly-sized work items are balanced automatically.
+    std::atomic<UInt> next_index{0};
+    std::atomic<Bool> failed{false};
+    std::mutex error_mutex;
+    UInt error_index = count;
+    std::exception_ptr error;
+
+    auto worker = [&]() {
+        while (!failed.load()) {
+            UInt i = next_index.fetch_add(1);
+            if (i >= count) {
+                return;
+            }
+            try {
+                fn(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (i < error_index) {
+                    error_index = i;
+                    error = std::current_exception();
+                }
+                failed.store(true);
+            }
+        }
+    };
+
+    // Submit num_threads - 1 helper tasks to the pool; the calling thread
+    // does its share of the work as well, and then helps running pending
+    // tasks until all helpers are done. Helpers that weren't started by the
+    // time all indices were handed out just return immediately.
+    std::atomic<UInt> num_helpers{num_threads - 1};
+    for (UInt t = 1; t < num_threads; t++) {
+        pool.submit([&worker, &num_helpers]() {
+            worker();
+            num_helpers.fetch_sub(1);
+            ThreadPool::get().notify();
+        });
+    }
+    worker();
+    pool.wait_until([&num_helpers]() { return num_helpers.load() == 0; });
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace utils
+} // namespace ql
@@ -1,75 +1,398 @@
 /** \file
- * Provides utilities for working with strings that the STL fails to
- * satisfactorily provide.
+ * Thread-safe progress monitoring for long-running algorithms.
  */
 
 #include "ql/utils/progress.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "ql/utils/list.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/pair.h"
 #include "ql/utils/logger.h"
 
 namespace ql {
 namespace utils {
 
 /**
- * Constructor that doesn't print anything.
- */
-Progress::Progress() :
-    prefix(),
-    interval(0)
-{
-    start = Clock::now();
-    prev = start;
+ * The clock source to use.
+ */
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Time points for the clock source.
+ */
+using TimePoint = Clock::time_point;
+
+/**
+ * The rate in milliseconds at which the reporter thread samples the active
+ * monitors.
+ */
+const UInt Progress::REPORT_INTERVAL = 100;
+
+/**
+ * The total amount of work used by feed().
+ */
+static const UInt FEED_RESOLUTION = 1000000;
+
+/**
+ * The progress state shared with the reporter thread.
+ */
+struct Progress::State {
+
+    /**
+     * Prefix for printing.
+     */
+    const Str prefix;
+
+    /**
+     * Minimum printing interval.
+     */
+    const UInt interval;
+
+    /**
+     * Start time (when the monitor was constructed).
+     */
+    const TimePoint start;
+
+    /**
+     * The amount of work done thus far.
+     */
+    std::atomic<UInt> done;
+
+    /**
+     * The total amount of work, or 0 if not known yet.
+     */
+    std::atomic<UInt> total;
+
+    /**
+     * Whether complete() was called.
+     */
+    std::atomic<Bool> completed;
+
+    /**
+     * The previous time the progress was printed. Only used by the reporter
+     * thread.
+     */
+    TimePoint prev;
+
+    /**
+     * Constructs the state.
+     */
+    State(const Str &prefix, UInt interval, UInt total) :
+        prefix(prefix),
+        interval(interval),
+        start(Clock::now()),
+        done(0),
+        total(total),
+        completed(false),
+        prev(start)
+    {}
+
+    /**
+     * Returns the progress as a fraction between 0 and 1.
+     */
+    Real get_progress() const {
+        auto t = total.load(std::memory_order_relaxed);
+        if (!t) {
+            return 0.0;
+        }
+        return min((Real)done.load(std::memory_order_relaxed) / (Real)t, 1.0);
+    }
+
+};
+
+/**
+ * The reporter thread, along with the list of active monitors.
+ */
+class Reporter {
+private:
+
+    /**
+     * Mutex protecting everything below.
+     */
+    std::mutex mutex;
+
+    /**
+     * Used to wake up the reporter thread when the process exits.
+     */
+    std::condition_variable cv;
+
+    /**
+     * The active monitors. Monitors that completed or of which all copies
+     * were destroyed are removed by the reporter thread.
+     */
+    List<std::weak_ptr<Progress::State>> states;
+
+    /**
+     * The progress callback, if any.
+     */
+    Progress::Callback callback;
+
+    /**
+     * The reporter thread. It exits when there are no more active monitors,
+     * and is restarted when a monitor is added.
+     */
+    std::thread thread;
+
+    /**
+     * Whether the reporter thread is running.
+     */
+    Bool running = false;
+
+    /**
+     * Set when the process exits, to stop the reporter thread.
+     */
+    Bool stopping = false;
+
+    /**
+     * Builds the snapshot for the given monitors, averaging the progress of
+     * monitors with the same prefix.
+     */
+    static Map<Str, Real> make_snapshot(
+        const Vec<std::shared_ptr<Progress::State>> &live
+    ) {
+        Map<Str, Pair<Real, UInt>> sums;
+        for (const auto &state : live) {
+            auto &sum = sums.set(state->prefix);
+            sum.first += state->get_progress();
+            sum.second++;
+        }
+        Map<Str, Real> snapshot;
+        for (const auto &sum : sums) {
+            snapshot.set(sum.first) = sum.second.first / (Real)sum.second.second;
+        }
+        return snapshot;
+    }
+
+    /**
+     * Prints the progress of the given monitors for which the printing
+     * interval has passed, and passes the progress of all of them to the
+     * given callback.
+     */
+    static void report(
+        const Vec<std::shared_ptr<Progress::State>> &live,
+        const Progress::Callback &callback
+    ) {
+        auto now = Clock::now();
+        for (const auto &state : live) {
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(now - state->prev).count() <= (Int)state->interval) {
+                continue;
+            }
+            auto progress = state->get_progress();
+            UInt millis_thus_far = std::chrono::duration_cast<std::chrono::milliseconds>(now - state->start).count();
+            UInt millis_eta = 0;
+            if (progress > 0.01 && progress < 1) {
+                millis_eta = millis_thus_far / progress - millis_thus_far;
+            }
+            StrStrm ss;
+            ss << std::fixed << std::setprecision(2) << (progress * 100) << "%";
+            ss << " after " << (millis_thus_far / 1000) << "s";
+            if (millis_eta) {
+                ss << ", ETA " << (millis_eta / 1000) << "s";
+            }
+            QL_IOUT(state->prefix << ": " << ss.str());
+            state->prev = now;
+        }
+        if (callback) {
+            try {
+                callback(make_snapshot(live));
+            } catch (std::exception &e) {
+                QL_WOUT("progress callback failed: " << e.what());
+            }
+        }
+    }
+
+    /**
+     * Returns the active monitors, removing the ones that are no longer
+     * active from the list. The mutex must be held.
+     */
+    Vec<std::shared_ptr<Progress::State>> get_live() {
+        Vec<std::shared_ptr<Progress::State>> live;
+        for (auto it = states.begin(); it != states.end();) {
+            auto state = it->lock();
+            if (!state || state->completed.load(std::memory_order_relaxed)) {
+                it = states.erase(it);
+            } else {
+                live.push_back(state);
+                ++it;
+            }
+        }
+        return live;
+    }
+
+    /**
+     * The body of the reporter thread.
+     */
+    void run() {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (!stopping) {
+            cv.wait_for(lock, std::chrono::milliseconds(Progress::REPORT_INTERVAL));
+            if (stopping) {
+                break;
+            }
+            auto live = get_live();
+            if (live.empty()) {
+                break;
+            }
+            auto current_callback = callback;
+            lock.unlock();
+            report(live, current_callback);
+            lock.lock();
+        }
+        running = false;
+    }
+
+    Reporter() = default;
+
+public:
+
+    /**
+     * Stops the reporter thread.
+     */
+    ~Reporter() {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopping = true;
+        }
+        cv.notify_all();
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+
+    /**
+     * Returns the reporter singleton.
+     */
+    static Reporter &get() {
+        static Reporter reporter;
+        return reporter;
+    }
+
+    /**
+     * Adds a monitor, starting the reporter thread if it isn't running.
+     */
+    void add(const std::shared_ptr<Progress::State> &state) {
+        std::lock_guard<std::mutex> lock{mutex};
+        states.push_back(state);
+        if (!running && !stopping) {
+
+            // A previous reporter thread no longer needs the mutex once it
+            // has cleared running, so it can be joined while holding it.
+            if (thread.joinable()) {
+                thread.join();
+            }
+            running = true;
+            thread = std::thread(&Reporter::run, this);
+
+        }
+    }
+
+    /**
+     * Sets the progress callback.
+     */
+    void set_callback(const Progress::Callback &new_callback) {
+        std::lock_guard<std::mutex> lock{mutex};
+        callback = new_callback;
+    }
+
+    /**
+     * Returns the current progress of all active monitors.
+     */
+    Map<Str, Real> get_snapshot() {
+        std::lock_guard<std::mutex> lock{mutex};
+        return make_snapshot(get_live());
+    }
+
+};
+
+/**
+ * Sets the progress callback, or clears it when an empty function is passed.
+ */
+void Progress::set_callback(const Callback &callback) {
+    Reporter::get().set_callback(callback);
+}
+
+/**
+ * Returns the current progress of all active monitors, keyed by prefix, as
+ * it would be passed to the progress callback.
+ */
+Map<Str, Real> Progress::get_snapshot() {
+    return Reporter::get().get_snapshot();
 }
 
 /**
- * Progress monitor constructor. Also starts the timer.
+ * Constructor that doesn't report anything.
+ */
+Progress::Progress() = default;
+
+/**
+ * Progress monitor constructor. Also starts the timer. The progress is
+ * printed every interval milliseconds; if the total amount of work is not
+ * known yet, it can be set later using set_total().
  */
 Progress::Progress(
     const Str &prefix,
-    UInt interval
-) :
-    prefix(prefix),
-    interval(interval)
-{
+    UInt interval,
+    UInt total
+) {
     QL_IOUT(prefix << ": starting...");
-    start = Clock::now();
-    prev = start;
+    state.emplace(prefix, interval, total);
+    Reporter::get().add(state.unwrap());
+}
+
+/**
+ * Sets the total amount of work.
+ */
+void Progress::set_total(UInt total) {
+    if (!state.has_value()) return;
+    state->total.store(total, std::memory_order_relaxed);
 }
 
 /**
- * Prints the current progress and ETA, if enough time has passed since
- * the previous print.
+ * Records that the given amount of work was done. This is a single relaxed
+ * atomic increment.
+ */
+void Progress::advance(UInt amount) {
+    if (!state.has_value()) return;
+    state->done.fetch_add(amount, std::memory_order_relaxed);
+}
+
+/**
+ * Records the total amount of work done thus far. This is a single relaxed
+ * atomic store.
+ */
+void Progress::set_done(UInt done) {
+    if (!state.has_value()) return;
+    state->done.store(done, std::memory_order_relaxed);
+}
+
+/**
+ * Records the progress as a fraction between 0 and 1, for algorithms that
+ * can't express their progress as an amount of work. This overrides the total
+ * amount of work set previously.
  */
 void Progress::feed(Real progress) {
-    if (prefix.empty()) return;
-    auto now = Clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - prev).count() > (Int)interval) {
-        UInt millis_thus_far = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-        UInt millis_eta = 0;
-        if (progress > 0.01 && progress < 1) {
-            millis_eta = millis_thus_far / progress - millis_thus_far;
-        }
-        utils::StrStrm ss;
-        ss << std::fixed << std::setprecision(2) << (progress * 100) << "%";
-        ss << " after " << (millis_thus_far / 1000) << "s";
-        if (millis_eta) {
-            ss << ", ETA " << (millis_eta / 1000) << "s";
-        }
-        QL_IOUT(prefix << ": " << ss.str());
-        prev = now;
-    }
+    if (!state.has_value()) return;
+    state->total.store(FEED_RESOLUTION, std::memory_order_relaxed);
+    state->done.store((UInt)(progress * FEED_RESOLUTION), std::memory_order_relaxed);
 }
 
 /**
- * Prints a completion message that includes total time taken.
+ * Stops reporting the progress, and prints a completion message that
+ * includes total time taken.
  */
 void Progress::complete() {
-    if (prefix.empty()) return;
-    auto now = Clock::now();
-    UInt millis_thus_far = std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
-    QL_IOUT(prefix << ": completed within " << millis_thus_far << "ms");
-    prefix.clear();
+    if (!state.has_value()) return;
+    state->completed.store(true, std::memory_order_relaxed);
+    UInt millis_thus_far = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - state->start).count();
+    QL_IOUT(state->prefix << ": completed within " << millis_thus_far << "ms");
+    state.reset();
 }
 
 } // namespace utils
@@ -0,0 +1,113 @@
+/** \file
+ * Counter-based random number generation, for reproducible random streams
+ * that don't depend on the order in which threads consume them.
+ */
+
+#include "ql/utils/rng.h"
+
+namespace ql {
+namespace utils {
+
+/**
+ * Multipliers and key schedule constants (the golden ratio and sqrt(3)-1)
+ * of Philox4x32.
+ */
+static const std::uint32_t PHILOX_M0 = 0xD2511F53u;
+static const std::uint32_t PHILOX_M1 = 0xCD9E8D57u;
+static const std::uint32_t PHILOX_W0 = 0x9E3779B9u;
+static const std::uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+/**
+ * Constructs a generator for the given seed and stream.
+ */
+Philox::Philox(UInt seed, UInt stream) {
+    this->seed(seed, stream);
+}
+
+/**
+ * Resets the generator to the start of the given stream for the given
+ * seed.
+ */
+void Philox::seed(UInt seed, UInt stream) {
+    key = {(result_type)seed, (result_type)(seed >> 32)};
+    counter = {0, 0, (result_type)stream, (result_type)(stream >> 32)};
+    index = 4;
+}
+
+/**
+ * Returns the next random number of the stream.
+ */
+Philox::result_type Philox::operator()() {
+    if (index >= 4) {
+        block = generate(counter, key);
+        index = 0;
+        if (++counter[0] == 0) {
+            counter[1]++;
+        }
+    }
+    return block[index++];
+}
+
+/**
+ * Skips the next n numbers of the stream in constant time.
+ */
+void Philox::discard(UInt n) {
+
+    // Use up what's left of the current block first.
+    while (n && index < 4) {
+        index++;
+        n--;
+    }
+
+    // Skip over whole blocks by advancing the counter.
+    UInt position = ((UInt)counter[1] << 32 | counter[0]) + n / 4;
+    counter[0] = (result_type)position;
+    counter[1] = (result_type)(position >> 32);
+
+    // Skip into the next block.
+    for (n %= 4; n; n--) {
+        (*this)();
+    }
+}
+
+/**
+ * Applies the Philox4x32-10 bijection to the given counter using the
+ * given key, returning the resulting block of four random numbers.
+ */
+std::array<Philox::result_type, 4> Philox::generate(
+    const std::array<result_type, 4> &counter,
+    const std::array<result_type, 2> &key
+) {
+    auto c = counter;
+    auto k = key;
+    for (UInt round = 0; round < 10; round++) {
+        if (round) {
+            k[0] += PHILOX_W0;
+            k[1] += PHILOX_W1;
+        }
+        std::uint64_t p0 = (std::uint64_t)PHILOX_M0 * c[0];
+        std::uint64_t p1 = (std::uint64_t)PHILOX_M1 * c[2];
+        c = {
+            (result_type)(p1 >> 32) ^ c[1] ^ k[0],
+            (result_type)p1,
+            (result_type)(p0 >> 32) ^ c[3] ^ k[1],
+            (result_type)p0
+        };
+    }
+    return c;
+}
+
+/**
+ * Derives a new seed from the given seed and index, for example to give
+ * each of a number of independent runs its own set of streams.
+ */
+UInt Philox::derive_seed(UInt seed, UInt index) {
+    auto block = generate(
+        {(result_type)index, (result_type)(index >> 32), 0xFFFFFFFFu, 0xFFFFFFFFu},
+        {(result_type)seed, (result_type)(seed >> 32)}
+    );
+    return (UInt)block[1] << 32 | block[0];
+}
+
+} // namespace utils
+} // namespace ql
@@ -7,6 +7,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstdio>
 #include <iomanip>
 #include <regex>
 #include "ql/utils/exception.h"
@@ -15,6 +16,48 @@
 namespace ql {
 namespace utils {
 
+/**
+ * Appends the decimal representation of the given unsigned integer to buf.
+ * This is equivalent to buf += to_string(value), but doesn't go through a
+ * stream or allocate a temporary string.
+ */
+void append_uint(Str &buf, UInt value) {
+    char digits[20];
+    char *end = digits + sizeof(digits);
+    char *begin = end;
+    do {
+        *--begin = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    buf.append(begin, end);
+}
+
+/**
+ * Appends the decimal representation of the given signed integer to buf.
+ * This is equivalent to buf += to_string(value), but doesn't go through a
+ * stream or allocate a temporary string.
+ */
+void append_int(Str &buf, Int value) {
+    if (value < 0) {
+        buf += '-';
+        append_uint(buf, (UInt)0 - (UInt)value);
+    } else {
+        append_uint(buf, (UInt)value);
+    }
+}
+
+/**
+ * Appends the given real number to buf, formatted the same way as
+ * to_string(value), i.e. with six significant digits.
+ */
+void append_real(Str &buf, Real value) {
+    char digits[32];
+    auto len = std::snprintf(digits, sizeof(digits), "%g", value);
+    if (len > 0) {
+        buf.append(digits, (UInt)len);
+    }
+}
+
 /**
  * Parses the given string as an unsigned integer. Throws an exception if the
  * conversion fails.
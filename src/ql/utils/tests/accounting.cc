@@ -0,0 +1,63 @@
+#include <memory>
+#include <vector>
+
+#include "ql/utils/accounting.h"
+#include "ql/utils/str.h"
+
+using namespace ql::utils;
+
+struct Node {
+    Str name;
+    Real value;
+    explicit Node(const Str &name) : name(name), value(0.0) {}
+};
+
+int main() {
+    QL_ASSERT(!AllocationAccounting::is_enabled());
+    {
+        AccountAllocations outer;
+        AccountAllocations inner;
+        QL_ASSERT(AllocationAccounting::is_enabled());
+    }
+    QL_ASSERT(!AllocationAccounting::is_enabled());
+
+    // Heap allocations are counted when they are made and when they are
+    // freed.
+    auto start = AllocationAccounting::get_counters();
+    auto node = std::allocate_shared<Node>(CountingAllocator<Node>({}), "heap");
+    auto after_alloc = AllocationAccounting::get_counters();
+    QL_ASSERT(after_alloc.allocated - start.allocated >= sizeof(Node));
+    QL_ASSERT_EQ(after_alloc.freed, start.freed);
+    QL_ASSERT(after_alloc.peak >= after_alloc.get_live());
+    node.reset();
+    auto after_free = AllocationAccounting::get_counters();
+    QL_ASSERT_EQ(after_free.allocated, after_alloc.allocated);
+    QL_ASSERT_EQ(after_free.get_live(), start.get_live());
+
+    // The peak can be measured for a region and restored afterwards.
+    auto outer_peak = AllocationAccounting::exchange_peak(0);
+    QL_ASSERT(outer_peak >= after_alloc.get_live());
+    QL_ASSERT_EQ(AllocationAccounting::get_counters().peak, after_free.get_live());
+    {
+        std::vector<std::shared_ptr<Node>> nodes;
+        for (UInt i = 0; i < 10; i++) {
+            nodes.push_back(std::allocate_shared<Node>(CountingAllocator<Node>({}), "peak"));
+        }
+    }
+    auto region = AllocationAccounting::get_counters();
+    QL_ASSERT(region.peak >= region.get_live() + 10 * sizeof(Node));
+    AllocationAccounting::exchange_peak(outer_peak > region.peak ? outer_peak : region.peak);
+    QL_ASSERT(AllocationAccounting::get_counters().peak >= outer_peak);
+
+    // Arena allocations are counted with their requested size.
+    ArenaRef arena;
+    arena.emplace();
+    auto before_arena = AllocationAccounting::get_counters();
+    auto arena_node = std::allocate_shared<Node>(CountingAllocator<Node>(arena), "arena");
+    auto after_arena = AllocationAccounting::get_counters();
+    QL_ASSERT_EQ(after_arena.allocated - before_arena.allocated, arena->get_allocated());
+    arena_node.reset();
+    QL_ASSERT_EQ(AllocationAccounting::get_counters().get_live(), before_arena.get_live());
+
+    return 0;
+}
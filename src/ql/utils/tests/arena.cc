@@ -0,0 +1,69 @@
+#include <iostream>
+#include <cstdint>
+
+#include "ql/utils/arena.h"
+#include "ql/utils/str.h"
+
+using namespace ql::utils;
+
+struct Node {
+    Str name;
+    Real value;
+    explicit Node(const Str &name) : name(name), value(0.0) {}
+};
+
+int main() {
+    std::shared_ptr<Node> survivor;
+    {
+        ArenaRef arena;
+        arena.emplace(256);
+        UseArena use_arena{arena};
+        QL_ASSERT(Arena::get_active().unwrap() == arena.unwrap());
+
+        for (UInt i = 0; i < 100; i++) {
+            survivor = std::allocate_shared<Node>(
+                ArenaAllocator<Node>(Arena::get_active()),
+                "node number " + std::to_string(i)
+            );
+            QL_ASSERT((std::uintptr_t)survivor.get() % alignof(Node) == 0);
+        }
+        QL_ASSERT(arena->get_allocated() > 0);
+        QL_ASSERT(arena->get_reserved() >= arena->get_allocated());
+
+        // Allocations larger than the chunk size get their own chunk.
+        auto big = arena->allocate(1000, 8);
+        QL_ASSERT(big != nullptr);
+
+        // Scopes nest.
+        {
+            UseArena use_heap{{}};
+            QL_ASSERT(!Arena::get_active().has_value());
+        }
+        QL_ASSERT(Arena::get_active().unwrap() == arena.unwrap());
+    }
+    QL_ASSERT(!Arena::get_active().has_value());
+
+    // The surviving node keeps the arena alive.
+    QL_ASSERT(survivor->name == "node number 99");
+
+    // Resetting an arena merges its chunks and reuses the memory.
+    {
+        Arena scratch{64};
+        for (UInt i = 0; i < 10; i++) {
+            QL_ASSERT(scratch.allocate(48, 8) != nullptr);
+        }
+        auto reserved = scratch.get_reserved();
+        scratch.reset();
+        QL_ASSERT(scratch.get_allocated() == 0);
+        QL_ASSERT(scratch.get_reserved() == reserved);
+        auto first = scratch.allocate(48, 8);
+        for (UInt i = 1; i < 10; i++) {
+            QL_ASSERT(scratch.allocate(48, 8) != nullptr);
+        }
+        QL_ASSERT(scratch.get_reserved() == reserved);
+        scratch.reset();
+        QL_ASSERT(scratch.allocate(48, 8) == first);
+    }
+
+    return 0;
+}
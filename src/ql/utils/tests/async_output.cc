@@ -0,0 +1,59 @@
+#include "ql/utils/async_output.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+static Str read(const Str &path) {
+    return InFile(path).read();
+}
+
+int main() {
+    make_dirs("test_output");
+
+    // Without an active AsyncOutput, files are written synchronously.
+    QL_ASSERT(AsyncOutput::get_current() == nullptr);
+    {
+        AsyncOutFile file{"test_output/utils_async_sync.txt"};
+        file << "sync " << 1;
+    }
+    QL_ASSERT_EQ(read("test_output/utils_async_sync.txt"), "sync 1");
+
+    {
+        // With a tiny queue limit, submitting blocks until the I/O thread
+        // catches up, but all files are still written, in order.
+        AsyncOutput output{16};
+        QL_ASSERT(AsyncOutput::get_current() == &output);
+        for (UInt i = 0; i < 50; i++) {
+            AsyncOutFile file{"test_output/utils_async_" + to_string(i % 5) + ".txt"};
+            file << "file " << i;
+            file.unwrap() << " of 50";
+        }
+        output.flush();
+        for (UInt i = 0; i < 5; i++) {
+            QL_ASSERT_EQ(read("test_output/utils_async_" + to_string(i) + ".txt"), "file " + to_string(45 + i) + " of 50");
+        }
+
+        // Errors are reported by flush(), not by the writer.
+        {
+            AsyncOutFile file{"test_output/utils_async_0.txt/nested.txt"};
+            file << "cannot be written";
+        }
+        QL_ASSERT_RAISES(output.flush());
+        output.flush();
+
+        // Nested instances take precedence while they exist.
+        {
+            AsyncOutput nested;
+            QL_ASSERT(AsyncOutput::get_current() == &nested);
+            AsyncOutFile file{"test_output/utils_async_nested.txt"};
+            file.write("nested");
+        }
+        QL_ASSERT(AsyncOutput::get_current() == &output);
+        QL_ASSERT_EQ(read("test_output/utils_async_nested.txt"), "nested");
+
+    }
+    QL_ASSERT(AsyncOutput::get_current() == nullptr);
+
+    return 0;
+}
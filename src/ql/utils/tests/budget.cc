@@ -0,0 +1,73 @@
+#include <limits>
+#include <thread>
+
+#include "ql/utils/budget.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/logger.h"
+
+using namespace ql::utils;
+
+int main() {
+    logger::set_log_level("LOG_ERROR");
+
+    // Without a budget, nothing is ever exceeded, and degradations are only
+    // logged.
+    QL_ASSERT(TimeBudget::get_current() == nullptr);
+    QL_ASSERT(!TimeBudget::is_exceeded());
+    QL_ASSERT_EQ(TimeBudget::get_remaining(), std::numeric_limits<Real>::infinity());
+    TimeBudget::report_degradation("test", "not recorded");
+
+    {
+        // A budget without limit records degradations, but is never
+        // exceeded.
+        TimeBudget outer;
+        QL_ASSERT(TimeBudget::get_current() == &outer);
+        QL_ASSERT(!TimeBudget::is_exceeded());
+        QL_ASSERT_EQ(TimeBudget::get_remaining(), std::numeric_limits<Real>::infinity());
+
+        {
+            // A nested budget imposes its own limit.
+            TimeBudget inner{3600.0};
+            QL_ASSERT(TimeBudget::get_current() == &inner);
+            QL_ASSERT(!TimeBudget::is_exceeded());
+            QL_ASSERT(TimeBudget::get_remaining() <= 3600.0);
+            QL_ASSERT(TimeBudget::get_remaining() > 3000.0);
+
+            {
+                // A budget nested in that can only be tighter.
+                TimeBudget looser{7200.0};
+                QL_ASSERT(TimeBudget::get_remaining() <= 3600.0);
+                TimeBudget tighter{0.001};
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                QL_ASSERT(TimeBudget::is_exceeded());
+                QL_ASSERT_EQ(TimeBudget::get_remaining(), 0.0);
+
+                // The budget is propagated to thread pool tasks, and
+                // degradations reported by them end up with the outermost
+                // budget.
+                ThreadPool::get().set_num_threads(4);
+                parallel_for(8, 0, [](UInt i) {
+                    QL_ASSERT(TimeBudget::is_exceeded());
+                    TimeBudget::report_degradation("task", to_string(i));
+                });
+            }
+            QL_ASSERT(TimeBudget::get_current() == &inner);
+            QL_ASSERT(!TimeBudget::is_exceeded());
+        }
+        QL_ASSERT(TimeBudget::get_current() == &outer);
+
+        auto degradations = outer.get_degradations();
+        QL_ASSERT_EQ(degradations.size(), 8);
+        for (const auto &degradation : degradations) {
+            QL_ASSERT_EQ(degradation.source, "task");
+            QL_ASSERT(degradation.time >= 0.0);
+            QL_ASSERT(degradation.time <= outer.get_elapsed());
+        }
+        auto json = outer.to_json();
+        QL_ASSERT_EQ(json["max_compile_time"].get<Real>(), 0.0);
+        QL_ASSERT_EQ(json["degradations"].size(), 8);
+    }
+    QL_ASSERT(TimeBudget::get_current() == nullptr);
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include "ql/utils/filesystem.h"
+#include "ql/utils/async_output.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+
+    // Without a capture, files are written to disk.
+    QL_ASSERT(OutputCapture::get_current() == nullptr);
+    OutFile("test_output/utils_capture_disk.txt") << "disk";
+    QL_ASSERT(is_file("test_output/utils_capture_disk.txt"));
+
+    {
+        OutputCapture capture;
+        QL_ASSERT(OutputCapture::get_current() == &capture);
+
+        // While capturing, neither the files nor their directories are
+        // created, but they can still be read back.
+        OutFile("test_output/utils_capture/a.txt") << "a" << 1;
+        {
+            AsyncOutput output;
+            AsyncOutFile file{"test_output/utils_capture/b.txt"};
+            file << "b";
+        }
+        QL_ASSERT(!path_exists("test_output/utils_capture"));
+        QL_ASSERT_EQ(InFile("test_output/utils_capture/a.txt").read(), "a1");
+        QL_ASSERT_EQ(InFile("test_output/utils_capture_disk.txt").read(), "disk");
+        QL_ASSERT_RAISES(InFile("test_output/utils_capture/c.txt"));
+
+        // Thread pool tasks capture into the same object, and the last write
+        // of a file wins.
+        parallel_for(4, 4, [](UInt i) {
+            OutFile("test_output/utils_capture/" + to_string(i) + ".txt") << i;
+        });
+        OutFile("test_output/utils_capture/a.txt").write("a2");
+
+        // Files that must end up on disk can bypass the capture.
+        {
+            WithoutOutputCapture without_capture;
+            QL_ASSERT(OutputCapture::get_current() == nullptr);
+            OutFile("test_output/utils_capture_bypass.txt") << "bypass";
+        }
+        QL_ASSERT(OutputCapture::get_current() == &capture);
+        QL_ASSERT(is_file("test_output/utils_capture_bypass.txt"));
+
+        auto files = capture.get_files();
+        QL_ASSERT_EQ(files.size(), 6);
+        QL_ASSERT_EQ(files.at("test_output/utils_capture/a.txt"), "a2");
+        QL_ASSERT_EQ(files.at("test_output/utils_capture/b.txt"), "b");
+        for (UInt i = 0; i < 4; i++) {
+            QL_ASSERT_EQ(files.at("test_output/utils_capture/" + to_string(i) + ".txt"), to_string(i));
+        }
+    }
+    QL_ASSERT(OutputCapture::get_current() == nullptr);
+
+    return 0;
+}
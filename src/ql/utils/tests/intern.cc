@@ -0,0 +1,29 @@
+#include <iostream>
+#include <unordered_set>
+
+#include "ql/utils/intern.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+    InternedStr empty;
+    InternedStr x{"x"};
+    InternedStr also_x{Str("x")};
+    InternedStr y{"y"};
+
+    QL_ASSERT(empty.str().empty());
+    QL_ASSERT(empty == InternedStr(""));
+    QL_ASSERT(x == also_x);
+    QL_ASSERT(x.id() == also_x.id());
+    QL_ASSERT(x != y);
+    QL_ASSERT(x.str() == "x");
+    QL_ASSERT(y.str() == "y");
+
+    std::unordered_set<InternedStr> set{x, y};
+    QL_ASSERT(set.size() == 2);
+    QL_ASSERT(set.count(InternedStr("x")) == 1);
+    QL_ASSERT(set.count(InternedStr("z")) == 0);
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "ql/utils/flat_map.h"
+#include "ql/utils/hash_map.h"
+#include "ql/utils/index_map.h"
+#include "ql/utils/ptr.h"
+
+using namespace ql::utils;
+
+/**
+ * Checks the accessors shared by all map types.
+ */
+template <class M>
+void check_common() {
+    M map;
+    QL_ASSERT(map.empty());
+    map.set(3) = 30;
+    map.set(1) = 10;
+    map.set(2) = 20;
+    QL_ASSERT_EQ(map.size(), 3);
+    QL_ASSERT_EQ(map.at(2), 20);
+    QL_ASSERT_EQ(map.get(5), 0);
+    QL_ASSERT_EQ(map.get(5, 7), 7);
+    QL_ASSERT_EQ(map.dbg(5), "<EMPTY>");
+    QL_ASSERT_EQ(map.count(1), 1);
+    QL_ASSERT_EQ(map.count(4), 0);
+
+    Bool thrown = false;
+    try {
+        map.at(4);
+    } catch (Exception &) {
+        thrown = true;
+    }
+    QL_ASSERT(thrown);
+
+    QL_ASSERT(!map.insert({1, 11}).second);
+    QL_ASSERT_EQ(map.at(1), 10);
+    QL_ASSERT(map.insert({4, 40}).second);
+    QL_ASSERT(map.emplace(0, 0).second);
+    QL_ASSERT_EQ(map.erase(4), 1);
+    QL_ASSERT_EQ(map.erase(4), 0);
+
+    Int sum = 0;
+    for (const auto &kv : map) {
+        sum += kv.second;
+    }
+    QL_ASSERT_EQ(sum, 60);
+
+    auto it = map.find(2);
+    QL_ASSERT(it != map.end());
+    QL_ASSERT_EQ(it->second, 20);
+    map.erase(it);
+    QL_ASSERT_EQ(map.size(), 3);
+
+    M copy = map;
+    QL_ASSERT(copy == map);
+    copy.set(9);
+    QL_ASSERT(copy != map);
+}
+
+int main() {
+    check_common<FlatMap<UInt, Int>>();
+    check_common<HashMap<UInt, Int>>();
+    check_common<IndexMap<UInt, Int>>();
+    check_common<IndexMap<Int, Int>>();
+
+    // Ordered maps iterate in key order.
+    FlatMap<Str, Int> flat{{"b", 2}, {"a", 1}};
+    QL_ASSERT_EQ(flat.to_string(), "{a: 1, b: 2}");
+    QL_ASSERT_EQ(flat.lower_bound("aa")->first, "b");
+    IndexMap<UInt, Str> index;
+    index.set(5) = "x";
+    index.set(2) = "y";
+    QL_ASSERT_EQ(index.to_string(), "{2: y, 5: x}");
+
+    // Index maps don't accept negative keys.
+    Bool thrown = false;
+    try {
+        IndexMap<Int, Int> map;
+        map.set(-1);
+    } catch (Exception &) {
+        thrown = true;
+    }
+    QL_ASSERT(thrown);
+
+    // Ptr can be used as a hash map key.
+    HashMap<Ptr<Int>, UInt> hash;
+    Ptr<Int> ptr;
+    ptr.emplace(3);
+    hash.set(ptr) = 1;
+    QL_ASSERT_EQ(hash.at(ptr), 1);
+
+#ifdef QL_CHECKED_MAP
+    // Insertion invalidates iterators, modification of existing values does
+    // not.
+    FlatMap<UInt, UInt> checked{{1, 1}};
+    auto it = checked.begin();
+    checked.set(2);
+    thrown = false;
+    try {
+        *it;
+    } catch (Exception &) {
+        thrown = true;
+    }
+    QL_ASSERT(thrown);
+    it = checked.find(1);
+    checked.set(1) = 3;
+    QL_ASSERT_EQ(it->second, 3);
+#endif
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "ql/utils/options.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+
+    // The help text of integer options describes their bounds, and the same
+    // wording is used when a value out of range is given.
+    Options options;
+    options.add_int("min_only", "Min only.", "1", 0);
+    options.add_int("max_only", "Max only.", "3", MIN, 10);
+    options.add_int("both", "Both.", "2", 1, 4);
+    options.add_int("neither", "Neither.", "4");
+    StrStrm ss;
+    options.dump_help(ss, "  ");
+    QL_ASSERT_EQ(ss.str(),
+        "  * `min_only` *\n"
+        "    Must be an integer greater than or equal to 0, default `1`. Min only.\n"
+        "\n"
+        "  * `max_only` *\n"
+        "    Must be an integer less than or equal to 10, default `3`. Max only.\n"
+        "\n"
+        "  * `both` *\n"
+        "    Must be an integer between 1 and 4 inclusive, default `2`. Both.\n"
+        "\n"
+        "  * `neither` *\n"
+        "    Must be any integer, default `4`. Neither.\n"
+        "\n"
+    );
+
+    options["both"] = "4";
+    QL_ASSERT_EQ(options["both"].as_int(), 4);
+    Str message;
+    try {
+        options["min_only"] = "-1";
+    } catch (Exception &e) {
+        message = e.what();
+    }
+    QL_ASSERT(message.find("must be an integer greater than or equal to 0, but -1 was given") != Str::npos);
+    QL_ASSERT_EQ(options["min_only"].as_int(), 1);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+
+#include "ql/utils/parallel.h"
+#include "ql/utils/logger.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/vec.h"
+
+using namespace ql::utils;
+
+int main() {
+    auto &pool = ThreadPool::get();
+    pool.set_num_threads(4);
+    QL_ASSERT_EQ(pool.get_num_threads(), resolve_num_threads(4));
+
+    // The pool may be used for the first time from multiple threads at once.
+    {
+        std::atomic<UInt> total{0};
+        Vec<std::thread> threads;
+        for (UInt t = 0; t < 2; t++) {
+            threads.emplace_back([&total]() {
+                parallel_for(100, 0, [&total](UInt j) {
+                    total.fetch_add(j);
+                });
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        QL_ASSERT_EQ(total.load(), 2 * 4950);
+    }
+
+    // Resizing the pool while other threads are using it takes effect once
+    // their work is done, and doesn't lose any tasks.
+    {
+        std::atomic<UInt> total{0};
+        std::thread user([&total]() {
+            for (UInt k = 0; k < 20; k++) {
+                parallel_for(50, 0, [&total](UInt j) {
+                    total.fetch_add(j);
+                });
+            }
+        });
+        for (UInt k = 0; k < 20; k++) {
+            pool.set_num_threads(k % 2 ? 3 : 4);
+        }
+        user.join();
+        pool.set_num_threads(4);
+        QL_ASSERT_EQ(total.load(), 20 * 1225);
+    }
+
+    // Nested parallel regions share the pool without deadlocking, even when
+    // there are more outer indices than threads.
+    Vec<UInt> sums(16, 0);
+    parallel_for(16, 0, [&](UInt i) {
+        std::atomic<UInt> sum{0};
+        parallel_for(100, 0, [&](UInt j) {
+            sum.fetch_add(j);
+        });
+        sums[i] = sum.load() + i;
+    });
+    for (UInt i = 0; i < 16; i++) {
+        QL_ASSERT_EQ(sums[i], 4950 + i);
+    }
+
+    // The exception thrown for the lowest index is rethrown.
+    Bool caught = false;
+    try {
+        parallel_for(64, 0, [](UInt i) {
+            if (i == 10 || i == 50) {
+                throw std::runtime_error(i == 10 ? "ten" : "fifty");
+            }
+        });
+    } catch (std::runtime_error &e) {
+        caught = true;
+        QL_ASSERT_EQ(Str(e.what()), "ten");
+    }
+    QL_ASSERT(caught);
+
+    // Tasks inherit the log redirection and working directory of the thread
+    // that submitted them.
+    logger::set_log_level("LOG_INFO");
+    logger::Capture capture;
+    {
+        logger::Redirect redirect{capture};
+        WithWorkingDirectory wd{"pool_test"};
+        auto dir = get_working_directory();
+        std::atomic<UInt> wrong_dir{0};
+        parallel_for(32, 0, [&](UInt i) {
+            if (get_working_directory() != dir) {
+                wrong_dir.fetch_add(1);
+            }
+            QL_IOUT("index " << i);
+        });
+        QL_ASSERT_EQ(wrong_dir.load(), 0);
+    }
+    capture.replay();
+    logger::set_log_level("LOG_NOTHING");
+
+    // With a single thread, everything runs on the calling thread.
+    pool.set_num_threads(1);
+    auto self = std::this_thread::get_id();
+    parallel_for(8, 0, [&](UInt) {
+        QL_ASSERT(std::this_thread::get_id() == self);
+    });
+
+    return 0;
+}
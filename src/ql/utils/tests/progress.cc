@@ -0,0 +1,75 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include "ql/utils/progress.h"
+#include "ql/utils/parallel.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+
+    // The reporter thread passes the progress of all active monitors to the
+    // callback.
+    std::mutex mutex;
+    Map<Str, Real> reported;
+    Progress::set_callback([&](const Map<Str, Real> &progress) {
+        std::lock_guard<std::mutex> lock{mutex};
+        reported = progress;
+    });
+    auto wait_for_report = [&](const Str &prefix, Real value) {
+        for (UInt i = 0; i < 100; i++) {
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                if (reported.count(prefix) && reported.at(prefix) == value) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(Progress::REPORT_INTERVAL / 4));
+        }
+        return false;
+    };
+
+    {
+        // Progress may be recorded from any thread.
+        Progress progress{"test", 0, 1000};
+        QL_ASSERT_EQ(Progress::get_snapshot().at("test"), 0.0);
+        parallel_for(1000, 4, [&progress](UInt) {
+            progress.advance();
+        });
+        QL_ASSERT_EQ(Progress::get_snapshot().at("test"), 1.0);
+        QL_ASSERT(wait_for_report("test", 1.0));
+
+        // Copies refer to the same progress, and feed() overrides the total.
+        auto copy = progress;
+        copy.feed(0.25);
+        QL_ASSERT_EQ(Progress::get_snapshot().at("test"), 0.25);
+        QL_ASSERT(wait_for_report("test", 0.25));
+
+        // Monitors with the same prefix are averaged.
+        Progress other{"test", 0, 4};
+        other.set_done(3);
+        QL_ASSERT_EQ(Progress::get_snapshot().at("test"), 0.5);
+
+        // Completed monitors are no longer reported, even if copies remain.
+        progress.complete();
+        QL_ASSERT_EQ(Progress::get_snapshot().at("test"), 0.75);
+        other.complete();
+        QL_ASSERT(!Progress::get_snapshot().count("test"));
+    }
+
+    // Monitors are also no longer reported once all copies are destroyed,
+    // while monitors without a prefix are never reported.
+    {
+        Progress progress{"destroyed"};
+        Progress silent;
+        silent.advance();
+        QL_ASSERT(Progress::get_snapshot().count("destroyed"));
+        QL_ASSERT_EQ(Progress::get_snapshot().size(), 1);
+    }
+    QL_ASSERT(Progress::get_snapshot().empty());
+
+    Progress::set_callback({});
+    return 0;
+}
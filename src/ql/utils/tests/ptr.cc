@@ -0,0 +1,69 @@
+#include "ql/utils/ptr.h"
+#include "ql/utils/set.h"
+
+using namespace ql::utils;
+
+static Int alive = 0;
+
+struct Base : RefCounted {
+    Int x = 1;
+    Base() { alive++; }
+    Base(const Base &other) : RefCounted(other), x(other.x) { alive++; }
+    ~Base() override { alive--; }
+};
+
+struct Derived : Base {
+    Int y = 2;
+};
+
+using BaseRef = IntrusivePtr<Base>;
+using BaseCRef = IntrusivePtr<const Base>;
+
+int main() {
+    static_assert(sizeof(BaseRef) == sizeof(void*), "intrusive pointers should be a single pointer");
+    {
+        // Copies refer to the same object.
+        BaseRef a;
+        QL_ASSERT(!a);
+        a.emplace();
+        BaseRef b = a;
+        BaseRef c;
+        c = b;
+        c = c;
+        QL_ASSERT(a == c);
+        QL_ASSERT_EQ(alive, 1);
+
+        // Const references compare equal to the non-const ones.
+        Set<BaseCRef> set;
+        set.insert(a.as_const());
+        set.insert(c.as_const());
+        QL_ASSERT_EQ(set.size(), 1);
+
+        // Casts.
+        BaseRef d;
+        d.emplace<Derived>();
+        QL_ASSERT(d.is<Derived>());
+        QL_ASSERT(!a.is<Derived>());
+        QL_ASSERT_EQ(d.as<Derived>()->y, 2);
+        QL_ASSERT(!a.try_as<Derived>());
+
+        // Moves leave the source empty.
+        BaseRef e = std::move(d);
+        QL_ASSERT(!d);
+        QL_ASSERT(e);
+
+        // Copying the object does not copy its reference count.
+        BaseRef f = BaseRef::make(*a);
+        QL_ASSERT(f != a);
+        QL_ASSERT_EQ(alive, 3);
+        a.reset();
+        b.reset();
+        QL_ASSERT_EQ(alive, 3);
+        set.clear();
+        c.reset();
+        QL_ASSERT_EQ(alive, 2);
+    }
+    QL_ASSERT_EQ(alive, 0);
+
+    return 0;
+}
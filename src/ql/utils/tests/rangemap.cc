@@ -4,6 +4,88 @@
 
 using namespace ql::utils;
 
+/**
+ * Checks the insertion, lookup, and removal operations, which must behave the
+ * same regardless of the underlying map type.
+ */
+template <class M>
+void check_ops() {
+    M map([](const UInt &a, const UInt &b) { return a == b; });
+
+    QL_ASSERT_EQ(map.to_string(), "empty");
+    map.set({10, 20}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
+    map.set({12, 18}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
+    map.set({12, 18}, 6);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..18): 6, [18..20): 10}");
+    map.set({14, 16}, 2);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..14): 6, [14..16): 2, [16..18): 6, [18..20): 10}");
+
+    QL_ASSERT_RAISES(map.at({10, 11}));
+    QL_ASSERT_EQ(map.at({10, 12}), 10);
+
+    QL_ASSERT_EQ(map.find(9), map.end());
+    QL_ASSERT_EQ(map.find(10), map.begin());
+    QL_ASSERT_EQ(map.find(11), map.begin());
+    QL_ASSERT_EQ(map.find(12), std::next(map.begin()));
+
+    QL_ASSERT_EQ(map.find({0, 5}).type, RangeMatchType::NONE);
+    QL_ASSERT_EQ(map.find({9, 11}).type, RangeMatchType::PARTIAL);
+    QL_ASSERT_EQ(map.find({9, 13}).type, RangeMatchType::MULTIPLE);
+    QL_ASSERT_EQ(map.find({10, 12}).type, RangeMatchType::EXACT);
+    QL_ASSERT_EQ(map.find({9, 12}).type, RangeMatchType::SUPER);
+    QL_ASSERT_EQ(map.find({11, 12}).type, RangeMatchType::SUB);
+
+    QL_ASSERT(!map.find_any_overlap({0, 5}));
+    QL_ASSERT(!map.find_any_overlap({5, 10}));
+    QL_ASSERT(map.find_any_overlap({9, 11}));
+    QL_ASSERT(map.find_any_overlap({10, 12}));
+    QL_ASSERT(map.find_any_overlap({11, 11}));
+    QL_ASSERT(map.find_any_overlap({19, 25}));
+    QL_ASSERT(!map.find_any_overlap({20, 25}));
+    QL_ASSERT(!map.find_any_overlap({20, 20}));
+
+    map.set({16, 19}, 2);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..14): 6, [14..19): 2, [19..20): 10}");
+    map.set({11, 19}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
+    map.set({20, 21}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..21): 10}");
+    map.set({9, 10}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[9..21): 10}");
+    map.set({8, 10}, 10);
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..21): 10}");
+    map.set({10, 15}, 10, [](const UInt &a, const UInt &b) { return false; });
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..15): 10, [15..21): 10}");
+    QL_ASSERT_RAISES(map.set({20, 10}, 3));
+    map.erase({14, 16});
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..14): 10, [16..21): 10}");
+    map.erase({13, 14});
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [16..21): 10}");
+    map.erase({16, 17});
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [17..21): 10}");
+    map.erase({14, 16});
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [17..21): 10}");
+    map.erase({8, 10});
+    map.check_consistency();
+    QL_ASSERT_EQ(map.to_string(), "{[10..13): 10, [17..21): 10}");
+}
+
 int main() {
     RangeMap<UInt, UInt> map([](const UInt &a, const UInt &b) { return a == b; });
 
@@ -109,69 +191,8 @@ int main() {
     QL_ASSERT(!map.range_entirely_before({20, 22}, {10, 20}));
     QL_ASSERT(!map.range_entirely_before({22, 24}, {10, 20}));
 
-    QL_ASSERT_EQ(map.to_string(), "empty");
-    map.set({10, 20}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
-    map.set({12, 18}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
-    map.set({12, 18}, 6);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..18): 6, [18..20): 10}");
-    map.set({14, 16}, 2);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..14): 6, [14..16): 2, [16..18): 6, [18..20): 10}");
-
-    QL_ASSERT_RAISES(map.at({10, 11}));
-    QL_ASSERT_EQ(map.at({10, 12}), 10);
-
-    QL_ASSERT_EQ(map.find(9), map.end());
-    QL_ASSERT_EQ(map.find(10), map.begin());
-    QL_ASSERT_EQ(map.find(11), map.begin());
-    QL_ASSERT_EQ(map.find(12), std::next(map.begin()));
-
-    QL_ASSERT_EQ(map.find({0, 5}).type, RangeMatchType::NONE);
-    QL_ASSERT_EQ(map.find({9, 11}).type, RangeMatchType::PARTIAL);
-    QL_ASSERT_EQ(map.find({9, 13}).type, RangeMatchType::MULTIPLE);
-    QL_ASSERT_EQ(map.find({10, 12}).type, RangeMatchType::EXACT);
-    QL_ASSERT_EQ(map.find({9, 12}).type, RangeMatchType::SUPER);
-    QL_ASSERT_EQ(map.find({11, 12}).type, RangeMatchType::SUB);
-
-    map.set({16, 19}, 2);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..12): 10, [12..14): 6, [14..19): 2, [19..20): 10}");
-    map.set({11, 19}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..20): 10}");
-    map.set({20, 21}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..21): 10}");
-    map.set({9, 10}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[9..21): 10}");
-    map.set({8, 10}, 10);
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..21): 10}");
-    map.set({10, 15}, 10, [](const UInt &a, const UInt &b) { return false; });
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..15): 10, [15..21): 10}");
-    QL_ASSERT_RAISES(map.set({20, 10}, 3));
-    map.erase({14, 16});
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..14): 10, [16..21): 10}");
-    map.erase({13, 14});
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [16..21): 10}");
-    map.erase({16, 17});
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [17..21): 10}");
-    map.erase({14, 16});
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[8..10): 10, [10..13): 10, [17..21): 10}");
-    map.erase({8, 10});
-    map.check_consistency();
-    QL_ASSERT_EQ(map.to_string(), "{[10..13): 10, [17..21): 10}");
+    check_ops<RangeMap<UInt, UInt>>();
+    check_ops<FlatRangeMap<UInt, UInt>>();
 
     return 0;
 }
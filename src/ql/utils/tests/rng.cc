@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "ql/utils/rng.h"
+#include "ql/utils/vec.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+
+    // Known-answer tests from the Random123 reference implementation.
+    auto zero = Philox::generate({0, 0, 0, 0}, {0, 0});
+    QL_ASSERT_EQ(zero[0], 0x6627e8d5u);
+    QL_ASSERT_EQ(zero[1], 0xe169c58du);
+    QL_ASSERT_EQ(zero[2], 0xbc57ac4cu);
+    QL_ASSERT_EQ(zero[3], 0x9b00dbd8u);
+    auto ones = Philox::generate(
+        {0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu},
+        {0xffffffffu, 0xffffffffu}
+    );
+    QL_ASSERT_EQ(ones[0], 0x408f276du);
+    QL_ASSERT_EQ(ones[1], 0x41c83b0eu);
+    QL_ASSERT_EQ(ones[2], 0xa20bc7c6u);
+    QL_ASSERT_EQ(ones[3], 0x6d5451fdu);
+
+    // The same seed and stream always give the same numbers, while different
+    // streams give different numbers.
+    Philox a(42, 7);
+    Philox b(42, 7);
+    Philox c(42, 8);
+    Vec<Philox::result_type> seq;
+    Bool differs = false;
+    for (UInt i = 0; i < 100; i++) {
+        auto x = a();
+        QL_ASSERT_EQ(x, b());
+        differs |= x != c();
+        seq.push_back(x);
+    }
+    QL_ASSERT(differs);
+
+    // Reseeding restarts the stream, and discarding skips ahead exactly.
+    a.seed(42, 7);
+    QL_ASSERT_EQ(a(), seq[0]);
+    for (UInt n : {0, 1, 3, 4, 9, 50}) {
+        Philox d(42, 7);
+        d();
+        d.discard(n);
+        QL_ASSERT_EQ(d(), seq[n + 1]);
+    }
+
+    // Derived seeds differ per index, and the generator works with the
+    // standard library algorithms.
+    QL_ASSERT(Philox::derive_seed(42, 0) != Philox::derive_seed(42, 1));
+    QL_ASSERT(Philox::derive_seed(42, 0) == Philox::derive_seed(42, 0));
+    Vec<UInt> x{0, 1, 2, 3, 4, 5, 6, 7};
+    Vec<UInt> y = x;
+    Philox e(1, 2);
+    Philox f(1, 2);
+    std::shuffle(x.begin(), x.end(), e);
+    std::shuffle(y.begin(), y.end(), f);
+    QL_ASSERT(x == y);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include <iostream>
+#include <limits>
+
+#include "ql/utils/str.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+
+    // The append functions must format exactly like to_string() does.
+    for (UInt value : {
+        (UInt)0, (UInt)1, (UInt)9, (UInt)10, (UInt)1234567890,
+        std::numeric_limits<UInt>::max()
+    }) {
+        Str buf = "x";
+        append_uint(buf, value);
+        QL_ASSERT_EQ(buf, "x" + to_string(value));
+    }
+    for (Int value : {
+        (Int)0, (Int)-1, (Int)42, (Int)-1234567890,
+        std::numeric_limits<Int>::max(), std::numeric_limits<Int>::min()
+    }) {
+        Str buf = "x";
+        append_int(buf, value);
+        QL_ASSERT_EQ(buf, "x" + to_string(value));
+    }
+    for (Real value : {
+        0.0, -0.5, 1.0, 3.14159265358979, 1e-7, -2.5e12, 123456789.0,
+        std::numeric_limits<Real>::infinity()
+    }) {
+        Str buf = "x";
+        append_real(buf, value);
+        QL_ASSERT_EQ(buf, "x" + to_string(value));
+    }
+
+    // Appending must not disturb what's already in the buffer.
+    Str buf;
+    append_uint(buf, 3);
+    buf += ",";
+    append_int(buf, -4);
+    buf += ",";
+    append_real(buf, 0.25);
+    QL_ASSERT_EQ(buf, "3,-4,0.25");
+
+    return 0;
+}
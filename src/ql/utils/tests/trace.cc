@@ -0,0 +1,59 @@
+#include "ql/utils/trace.h"
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+static void traced(const Str &name) {
+    QL_TRACE_SCOPE(name);
+    QL_TRACE_SCOPE("inner");
+}
+
+int main() {
+    make_dirs("test_output");
+    Str filename = "test_output/utils_trace.json";
+
+#ifdef QL_TRACE
+
+    // Spans are only recorded while tracing is enabled.
+    traced("before");
+    trace::enable(filename);
+    QL_ASSERT(trace::is_enabled());
+    {
+        QL_TRACE_SCOPE("outer");
+        traced("dynamic");
+    }
+    trace::disable();
+    QL_ASSERT(!trace::is_enabled());
+    traced("after");
+
+    // Spans are written in the order in which they end.
+    auto events = load_json(filename)["traceEvents"];
+    QL_ASSERT_EQ(events.size(), 3);
+    QL_ASSERT_EQ(events[0]["name"].get<Str>(), "inner");
+    QL_ASSERT_EQ(events[1]["name"].get<Str>(), "dynamic");
+    QL_ASSERT_EQ(events[2]["name"].get<Str>(), "outer");
+    for (const auto &event : events) {
+        QL_ASSERT_EQ(event["ph"].get<Str>(), "X");
+        QL_ASSERT(event["dur"].get<Real>() >= 0.0);
+    }
+    QL_ASSERT(events[2]["ts"].get<Real>() <= events[1]["ts"].get<Real>());
+    QL_ASSERT(
+        events[1]["ts"].get<Real>() + events[1]["dur"].get<Real>() <=
+        events[2]["ts"].get<Real>() + events[2]["dur"].get<Real>()
+    );
+
+#else
+
+    // Without tracing support, the spans compile to nothing and tracing
+    // cannot be enabled.
+    traced("disabled");
+    QL_ASSERT_RAISES(trace::enable(filename));
+    trace::enable("");
+    QL_ASSERT(!trace::is_enabled());
+
+#endif
+
+    return 0;
+}
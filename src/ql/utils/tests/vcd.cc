@@ -0,0 +1,46 @@
+#include <iostream>
+#include <sstream>
+
+#include "ql/utils/vcd.h"
+#include "ql/utils/exception.h"
+
+using namespace ql::utils;
+
+int main() {
+    std::ostringstream os;
+    Vcd vcd;
+    vcd.start(os);
+    vcd.scope(Vcd::Scope::MODULE, "top");
+    Int a = vcd.registerVar("a", Vcd::VarType::STRING);
+    Int b = vcd.registerVar("b", Vcd::VarType::STRING);
+    vcd.upscope();
+
+    // Changes may arrive out of order within the window; the last change of a
+    // variable at a timestamp wins.
+    vcd.change(a, 20, "");
+    vcd.change(b, 10, "y");
+    vcd.change(a, 10, "x");
+    vcd.change(a, 20, "x");
+    vcd.flush(20);
+    Str header =
+        "$date today $end\n"
+        "$timescale 1 ns $end\n"
+        "$scope module top $end\n"
+        "$var string 20 0 a $end\n"
+        "$var string 20 1 b $end\n"
+        "$upscope $end\n"
+        "$enddefinitions $end\n";
+    QL_ASSERT_EQ(os.str(), header + "#10\nsx 0\nsy 1\n");
+
+    // Changes before the flushed timestamp are no longer accepted.
+    QL_ASSERT_RAISES(vcd.change(b, 19, "z"));
+
+    auto id = vcd.intern("y");
+    QL_ASSERT_EQ(vcd.intern("y"), id);
+    vcd.changeInterned(b, 20, id);
+    vcd.change(b, 30, "");
+    vcd.finish();
+    QL_ASSERT_EQ(os.str(), header + "#10\nsx 0\nsy 1\n#20\nsx 0\nsy 1\n#30\ns 1\n");
+
+    return 0;
+}
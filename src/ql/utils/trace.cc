@@ -0,0 +1,347 @@
+/** \file
+ * Lightweight tracing of compiler phases for external profilers.
+ */
+
+#include "ql/utils/trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#ifdef QL_TRACE_ITT
+#include <ittnotify.h>
+#endif
+#include "ql/utils/vec.h"
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/exception.h"
+
+namespace ql {
+namespace utils {
+namespace trace {
+
+#ifdef QL_TRACE
+
+/**
+ * A completed span, as collected for the Chrome trace backend.
+ */
+struct Event {
+    Str name;
+    UInt tid;
+    Real start_us;
+    Real duration_us;
+};
+
+/**
+ * Global tracing state.
+ */
+class Tracer {
+public:
+
+    /**
+     * The clock source to use.
+     */
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * The active backend. Read without locking the mutex for every span, so
+     * that spans cost only this load when tracing is disabled.
+     */
+    std::atomic<Backend> backend{Backend::NONE};
+
+    /**
+     * Protects everything below.
+     */
+    std::mutex mutex;
+
+    /**
+     * Time at which tracing was enabled.
+     */
+    Clock::time_point epoch;
+
+    /**
+     * The file to write the Chrome trace to.
+     */
+    Str filename;
+
+    /**
+     * The spans completed thus far, for the Chrome trace backend.
+     */
+    Vec<Event> events;
+
+    /**
+     * The ftrace marker file, for the marker backend.
+     */
+    std::FILE *marker = nullptr;
+
+    /**
+     * Enables tracing based on the OPENQL_TRACE environment variable.
+     */
+    Tracer() {
+        const char *spec = std::getenv("OPENQL_TRACE");
+        if (spec && *spec) {
+            try {
+                start(spec);
+            } catch (std::exception &e) {
+                std::fprintf(stderr, "failed to enable OPENQL_TRACE: %s\n", e.what());
+            }
+        }
+    }
+
+    /**
+     * Writes out any collected spans.
+     */
+    ~Tracer() {
+        try {
+            stop();
+        } catch (std::exception &e) {
+            std::fprintf(stderr, "failed to write OPENQL_TRACE output: %s\n", e.what());
+        }
+    }
+
+    /**
+     * Enables tracing using the given backend specification, after stopping
+     * the currently active backend.
+     */
+    void start(const Str &spec) {
+        stop();
+        if (spec.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock{mutex};
+        epoch = Clock::now();
+        if (spec == "marker") {
+            for (const char *path : {
+                "/sys/kernel/tracing/trace_marker",
+                "/sys/kernel/debug/tracing/trace_marker"
+            }) {
+                marker = std::fopen(path, "w");
+                if (marker) {
+                    break;
+                }
+            }
+            if (!marker) {
+                throw Exception("failed to open the ftrace marker file");
+            }
+            std::setvbuf(marker, nullptr, _IONBF, 0);
+            backend = Backend::MARKER;
+        } else if (spec == "itt") {
+#ifdef QL_TRACE_ITT
+            backend = Backend::ITT;
+#else
+            throw Exception("OpenQL was built without ITT support (OPENQL_TRACE_ITT)");
+#endif
+        } else {
+            filename = spec;
+            backend = Backend::CHROME;
+        }
+    }
+
+    /**
+     * Disables tracing, writing the Chrome trace if that backend was active.
+     */
+    void stop() {
+        std::lock_guard<std::mutex> lock{mutex};
+        auto previous = backend.exchange(Backend::NONE);
+        if (previous == Backend::CHROME) {
+            Json trace_events = Json::array();
+            for (const auto &event : events) {
+                trace_events.push_back({
+                    {"name", event.name},
+                    {"cat", "openql"},
+                    {"ph", "X"},
+                    {"ts", event.start_us},
+                    {"dur", event.duration_us},
+                    {"pid", 0},
+                    {"tid", event.tid}
+                });
+            }
+            events.clear();
+            OutFile(filename) << Json({
+                {"traceEvents", trace_events},
+                {"displayTimeUnit", "ms"}
+            }).dump() << "\n";
+        }
+        if (marker) {
+            std::fclose(marker);
+            marker = nullptr;
+        }
+    }
+
+    /**
+     * Returns the time since tracing was enabled in microseconds.
+     */
+    Real now_us() const {
+        return std::chrono::duration<Real, std::micro>(Clock::now() - epoch).count();
+    }
+
+    /**
+     * Writes a line to the ftrace marker file in a single write, so lines
+     * from different threads do not interleave.
+     */
+    void write_marker(const Str &line) {
+        std::lock_guard<std::mutex> lock{mutex};
+        if (marker) {
+            std::fwrite(line.data(), 1, line.size(), marker);
+        }
+    }
+
+};
+
+/**
+ * Returns the global tracer, constructing it on first use.
+ */
+static Tracer &get_tracer() {
+    static Tracer tracer;
+    return tracer;
+}
+
+/**
+ * Returns a small integer identifying the calling thread.
+ */
+static UInt get_thread_id() {
+    static std::atomic<UInt> next_id{0};
+    thread_local UInt id = next_id++;
+    return id;
+}
+
+#ifdef QL_TRACE_ITT
+/**
+ * Returns the ITT domain for OpenQL's spans.
+ */
+static __itt_domain *get_itt_domain() {
+    static __itt_domain *domain = __itt_domain_create("OpenQL");
+    return domain;
+}
+#endif
+
+/**
+ * Starts the span.
+ */
+void Scope::begin() {
+    auto &tracer = get_tracer();
+    backend = tracer.backend.load(std::memory_order_relaxed);
+    switch (backend) {
+        case Backend::NONE:
+            return;
+        case Backend::CHROME:
+            start_us = tracer.now_us();
+            break;
+        case Backend::MARKER:
+            tracer.write_marker("B|0|" + Str(literal ? literal : name.c_str()) + "\n");
+            break;
+        case Backend::ITT:
+#ifdef QL_TRACE_ITT
+            __itt_task_begin(
+                get_itt_domain(), __itt_null, __itt_null,
+                __itt_string_handle_create(literal ? literal : name.c_str())
+            );
+#endif
+            break;
+    }
+}
+
+/**
+ * Starts a span with the given name, which must outlive the span.
+ */
+Scope::Scope(const char *literal) : literal(literal), backend(Backend::NONE), start_us(0.0) {
+    begin();
+}
+
+/**
+ * Starts a span with the given name.
+ */
+Scope::Scope(const Str &name) : literal(nullptr), backend(Backend::NONE), start_us(0.0) {
+    if (get_tracer().backend.load(std::memory_order_relaxed) != Backend::NONE) {
+        this->name = name;
+        begin();
+    }
+}
+
+/**
+ * Ends the span.
+ */
+Scope::~Scope() {
+    if (backend == Backend::NONE) {
+        return;
+    }
+    auto &tracer = get_tracer();
+    switch (backend) {
+        case Backend::NONE:
+            break;
+        case Backend::CHROME: {
+            auto end_us = tracer.now_us();
+            std::lock_guard<std::mutex> lock{tracer.mutex};
+            if (tracer.backend == Backend::CHROME) {
+                tracer.events.push_back({
+                    literal ? Str(literal) : name,
+                    get_thread_id(),
+                    start_us,
+                    end_us - start_us
+                });
+            }
+            break;
+        }
+        case Backend::MARKER:
+            tracer.write_marker("E|0\n");
+            break;
+        case Backend::ITT:
+#ifdef QL_TRACE_ITT
+            __itt_task_end(get_itt_domain());
+#endif
+            break;
+    }
+}
+
+/**
+ * Enables tracing using the given backend specification.
+ */
+void enable(const Str &spec) {
+    get_tracer().start(spec);
+}
+
+/**
+ * Disables tracing, writing out the collected spans if the backend requires
+ * this.
+ */
+void disable() {
+    get_tracer().stop();
+}
+
+/**
+ * Returns whether spans are currently being recorded.
+ */
+Bool is_enabled() {
+    return get_tracer().backend != Backend::NONE;
+}
+
+#else
+
+/**
+ * Tracing is not compiled in, so only disabling it is supported.
+ */
+void enable(const Str &spec) {
+    if (!spec.empty()) {
+        throw Exception("OpenQL was built without tracing support (OPENQL_TRACE)");
+    }
+}
+
+/**
+ * Tracing is not compiled in, so this is no-op.
+ */
+void disable() {
+}
+
+/**
+ * Tracing is not compiled in, so this always returns false.
+ */
+Bool is_enabled() {
+    return false;
+}
+
+#endif
+
+} // namespace trace
+} // namespace utils
+} // namespace ql
@@ -12,19 +12,21 @@
 #include "ql/utils/vcd.h"
 
 #include <iostream>
+#include "ql/utils/exception.h"
 
 namespace ql {
 namespace utils {
 
-void Vcd::start() {
-    vcd << "$date today $end" << std::endl;
-    vcd << "$timescale 1 ns $end" << std::endl;
+void Vcd::start(std::ostream &os) {
+    vcd = &os;
+    *vcd << "$date today $end" << std::endl;
+    *vcd << "$timescale 1 ns $end" << std::endl;
 }
 
 
 void Vcd::scope(Scope type, const Str &name) {
     // FIXME: handle type
-    vcd << "$scope " << "module" << " " << name << " $end" << std::endl;
+    *vcd << "$scope " << "module" << " " << name << " $end" << std::endl;
 }
 
 
@@ -32,19 +34,43 @@ int Vcd::registerVar(const Str &name, VarType type, Scope scope) {
     // FIXME: incomplete
     const Int width = 20;
 
-    vcd << "$var string " << width << " " << lastId << " " << name << " $end" << std::endl;
+    *vcd << "$var string " << width << " " << lastId << " " << name << " $end" << std::endl;
 
     return lastId++;
 }
 
 
 void Vcd::upscope() {
-    vcd << "$upscope $end" << std::endl;
+    *vcd << "$upscope $end" << std::endl;
 }
 
 
-void Vcd::change(Int var, Int timestamp, const Str &value)
-{
+Vcd::ValueId Vcd::intern(const Str &value) {
+    auto it = valueIds.find(value);
+    if (it != valueIds.end()) {
+        return it->second;
+    }
+    ValueId id = values.size();
+    values.push_back(value);
+    valueIds.insert({value, id});
+    return id;
+}
+
+
+void Vcd::change(Int var, Int timestamp, const Str &value) {
+    changeInterned(var, timestamp, intern(value));
+}
+
+
+void Vcd::changeInterned(Int var, Int timestamp, ValueId value) {
+    if (timestamp < flushedUntil) {
+        QL_ICE(
+            "VCD change of var " << var << " at timestamp " << timestamp
+            << " arrives after changes up to timestamp " << flushedUntil
+            << " have been written"
+        );
+    }
+
     auto tsIt = timestampMap.find(timestamp);
     if (tsIt != timestampMap.end()) {    // timestamp found
         VarChangeMap &vcm = tsIt->second;
@@ -54,30 +80,24 @@ void Vcd::change(Int var, Int timestamp, const Str &value)
 #if OPT_DEBUG_VCD
             std::cout << "ts=" << tsIt->first
                 << ", var " << vcmIt->first
-                << " overwritten with '" << value << "'" << std::endl;
+                << " overwritten with '" << values[value] << "'" << std::endl;
 #endif
-            Value &val = vcmIt->second;
-            val.strVal = value;         // overwrite previous value. FIXME: only if it was empty?
+            vcmIt->second = value;      // overwrite previous value. FIXME: only if it was empty?
         } else {                        // var not found
 #if OPT_DEBUG_VCD
             std::cout << "ts=" << tsIt->first
                 << ", var " << var
-                << " not found, wrote value '" << value << "'" << std::endl;
+                << " not found, wrote value '" << values[value] << "'" << std::endl;
 #endif
-            Value val;
-            val.strVal = value;
-            vcm.insert({var, val});
+            vcm.insert({var, value});
         }
     } else {                            // timestamp not found
 #if OPT_DEBUG_VCD
         std::cout << "ts=" << timestamp
             << " not found, wrote var " << var
-            << " with value '" << value << "'" << std::endl;
+            << " with value '" << values[value] << "'" << std::endl;
 #endif
-        Value val;
-        val.strVal = value;
-
-        VarChangeMap varChange{{var, val}};
+        VarChangeMap varChange{{var, value}};
         timestampMap.insert({timestamp, varChange});
     }
 }
@@ -89,20 +109,37 @@ void Vcd::change(Int var, Int timestamp, Int value) {
 }
 
 
-void Vcd::finish() {
-    vcd << "$enddefinitions $end" << std::endl;
+void Vcd::endDefinitions() {
+    if (!definitionsEnded) {
+        *vcd << "$enddefinitions $end" << std::endl;
+        definitionsEnded = true;
+    }
+}
 
-    for (auto &t: timestampMap) {
-        vcd << "#" << t.first << std::endl;      // timestamp
-        for (auto &v: t.second) {
-            vcd << "s" << v.second.strVal << " " << v.first << std::endl;
+
+// write out and forget all pending changes before timestamp. The caller
+// promises that no changes before timestamp will follow
+void Vcd::flush(Int timestamp) {
+    if (timestamp <= flushedUntil) {
+        return;
+    }
+    endDefinitions();
+
+    auto end = timestampMap.lower_bound(timestamp);
+    for (auto it = timestampMap.begin(); it != end; ++it) {
+        *vcd << "#" << it->first << "\n";      // timestamp
+        for (auto &v: it->second) {
+            *vcd << "s" << values[v.second] << " " << v.first << "\n";
         }
     }
+    timestampMap.erase(timestampMap.begin(), end);
+    flushedUntil = timestamp;
 }
 
 
-std::string Vcd::getVcd() {
-    return vcd.str();
+void Vcd::finish() {
+    flush(MAX);
+    vcd->flush();
 }
 
 
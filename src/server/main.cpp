@@ -0,0 +1,235 @@
+/** \file
+ * Long-running compile server, which keeps platforms and constructed pass
+ * managers loaded between compilations.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <tuple>
+#include "ql/utils/str.h"
+#include "ql/utils/list.h"
+#include "ql/utils/map.h"
+#include "ql/utils/json.h"
+#include "ql/utils/filesystem.h"
+#include "ql/utils/exception.h"
+#include "ql/com/options.h"
+#include "ql/ir/compat/compat.h"
+#include "ql/ir/old_to_new.h"
+#include "ql/ir/cqasm/read.h"
+#include "ql/pmgr/manager.h"
+
+using namespace ql;
+
+/**
+ * Temporarily applies a set of global option overrides, restoring the
+ * previous values when destroyed.
+ */
+class OptionOverrides {
+private:
+
+    /**
+     * Previous state of each overridden option: its name, whether it was set
+     * explicitly, and its value.
+     */
+    utils::List<std::tuple<utils::Str, utils::Bool, utils::Str>> previous;
+
+public:
+
+    /**
+     * Applies the given option overrides. If one of them fails to apply, the
+     * ones that were already applied are restored.
+     */
+    explicit OptionOverrides(const utils::Json &overrides) {
+        try {
+            for (auto it = overrides.begin(); it != overrides.end(); ++it) {
+                auto &option = com::options::global[it.key()];
+                previous.emplace_front(it.key(), option.is_set(), option.as_str());
+                if (it.value().is_string()) {
+                    option = it.value().get<utils::Str>();
+                } else {
+                    option = it.value().dump();
+                }
+            }
+        } catch (...) {
+            restore();
+            throw;
+        }
+    }
+
+    /**
+     * Restores the options to their previous values.
+     */
+    ~OptionOverrides() {
+        restore();
+    }
+
+    OptionOverrides(const OptionOverrides &) = delete;
+    OptionOverrides &operator=(const OptionOverrides &) = delete;
+
+private:
+
+    /**
+     * Restores the options to their previous values, in reverse order of
+     * application.
+     */
+    void restore() {
+        for (const auto &prev : previous) {
+            auto &option = com::options::global[std::get<0>(prev)];
+            if (std::get<1>(prev)) {
+                option = std::get<2>(prev);
+            } else {
+                option.reset();
+            }
+        }
+        previous.clear();
+    }
+
+};
+
+/**
+ * The compile server state, i.e. the pass managers built thus far.
+ */
+class Server {
+private:
+
+    /**
+     * Pass managers that have already been constructed, keyed by the platform,
+     * compiler configuration, and option overrides they were built for. The
+     * platforms themselves are cached by Platform::build().
+     */
+    utils::Map<utils::Str, pmgr::Ref> managers;
+
+    /**
+     * Returns the pass manager for the given platform and compiler
+     * configuration file, constructing it if it doesn't exist yet. The global
+     * options must already have been overridden as requested by the job,
+     * because some of them affect the pass list generated by
+     * Manager::from_defaults().
+     */
+    const pmgr::Ref &get_manager(
+        const ir::compat::PlatformRef &platform,
+        const utils::Str &key,
+        const utils::Str &compiler
+    ) {
+        auto it = managers.find(key);
+        if (it != managers.end()) {
+            return it->second;
+        }
+        pmgr::Ref manager;
+        if (compiler.empty()) {
+            manager.emplace(pmgr::Manager::from_defaults(platform));
+        } else {
+            manager.emplace(pmgr::Manager::from_json(utils::load_json(compiler)));
+        }
+        manager->construct();
+        return managers.set(key) = manager;
+    }
+
+public:
+
+    /**
+     * Handles a single compilation request, returning the response object.
+     */
+    utils::Json handle(const utils::Json &request) {
+        auto start = std::chrono::steady_clock::now();
+
+        // Parse the request.
+        utils::Str platform_config = request.at("platform").get<utils::Str>();
+        utils::Str compiler = request.value("compiler", "");
+        utils::Str cqasm = request.at("cqasm").get<utils::Str>();
+        utils::Json overrides = request.value("options", utils::Json::object());
+        if (!overrides.is_object()) {
+            throw utils::Exception("options must be an object mapping option names to values");
+        }
+        if (request.count("output_dir")) {
+            overrides["output_dir"] = request.at("output_dir");
+        }
+
+        // Apply the option overrides for the duration of this job.
+        OptionOverrides options{overrides};
+        utils::make_dirs(com::options::global["output_dir"].as_str());
+
+        // Load the platform and the pass manager. Both are kept around for
+        // subsequent jobs with the same configuration.
+        auto platform = ir::compat::Platform::build("platform", platform_config);
+        auto key = platform_config + "\n" + compiler + "\n" + overrides.dump();
+        const auto &manager = get_manager(platform, key, compiler);
+
+        // Read the cQASM program and compile it.
+        auto ir = ir::convert_old_to_new(platform);
+        ir::cqasm::read(ir, cqasm, "<request>");
+        manager->compile(ir);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        utils::Json response = utils::Json::object();
+        response["status"] = "ok";
+        response["output_dir"] = com::options::global["output_dir"].as_str();
+        response["time"] = elapsed.count();
+        return response;
+    }
+
+};
+
+/**
+ * Entry point.
+ *
+ * Reads compilation requests from stdin, one JSON object per line, and writes
+ * one JSON response object per line to stdout for each of them, in order.
+ * Log output is redirected to stderr, such that it can't corrupt the
+ * responses. The server exits when stdin is closed.
+ *
+ * Requests support the following keys:
+ *
+ *  - "platform": the platform configuration, as passed to the Platform
+ *    constructor (an architecture name or a JSON filename). Mandatory.
+ *  - "cqasm": the cQASM 1.x program to compile. Mandatory.
+ *  - "compiler": filename of a compiler configuration JSON file. Optional; if
+ *    not specified, the default pass list for the platform is used.
+ *  - "options": object mapping global option names to values, applied for the
+ *    duration of this job only. Optional.
+ *  - "output_dir": shorthand for the output_dir option. Optional.
+ *  - "id": arbitrary value, copied into the response as-is. Optional.
+ *
+ * Responses have a "status" key, which is either "ok" or "error". For "ok",
+ * "output_dir" specifies the directory that the outputs were written to, and
+ * "time" specifies the time taken in seconds. For "error", "message" contains
+ * the error message.
+ *
+ * Platforms and pass managers are cached for the lifetime of the server,
+ * keyed by the platform, compiler configuration, and set of option
+ * overrides, so only the first job for each configuration pays for loading
+ * them.
+ */
+int main() {
+
+    // Keep the real stdout for the responses, and send log output to stderr.
+    std::ostream responses{std::cout.rdbuf()};
+    std::cout.rdbuf(std::cerr.rdbuf());
+
+    Server server;
+    utils::Str line;
+    while (std::getline(std::cin, line)) {
+        if (line.find_first_not_of(" \t\r") == utils::Str::npos) {
+            continue;
+        }
+        utils::Json response;
+        utils::Json id;
+        try {
+            auto request = utils::parse_json(line);
+            if (request.count("id")) {
+                id = request.at("id");
+            }
+            response = server.handle(request);
+        } catch (std::exception &e) {
+            response = utils::Json::object();
+            response["status"] = "error";
+            response["message"] = e.what();
+        }
+        if (!id.is_null()) {
+            response["id"] = id;
+        }
+        responses << response.dump() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,353 @@
+"""Benchmarks for the overhead of the Python API.
+
+Measures the per-call overhead and throughput of the public Python API for
+representative circuit-building patterns: adding gates one call at a time,
+through the named gate methods, and in bulk; building programs out of kernels;
+constructing platforms; and setting options. Most time in these patterns is
+spent in the SWIG binding layer rather than in the compiler itself, so this
+quantifies binding-level improvements and catches regressions in them.
+
+Like ql_bench, each result is written to stdout as one JSON object per line,
+containing the benchmark name, its parameters, and the minimum, median, mean
+and maximum time of the timed iterations in seconds. Each benchmark also
+reports the median time per call (``per_call``) and the throughput in calls or
+gates per second. Results can be stored with ``--save-baseline <file>`` and
+compared against with ``--baseline <file>``, in which case a summary table is
+printed to stderr, and the exit code is 2 if the median time of any benchmark
+grew by more than ``--threshold`` (default 20%).
+
+This file is deliberately not named ``test_*.py``, so pytest doesn't pick it
+up. Run it from anywhere using ``python3 tests/bench_api.py --help``.
+"""
+
+import argparse
+import json
+import os
+import sys
+import time
+
+import openql as ql
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+# Number of qubits of the none platform.
+NUM_QUBITS = 10
+
+# The metrics that are compared with the baseline. Larger is worse for all of
+# them.
+COMPARED_METRICS = ['median']
+
+
+class Runner:
+    """Runs benchmarks and reports their results."""
+
+    def __init__(self, args):
+        self.args = args
+        self.results = []
+
+    def scaled(self, count):
+        """Returns the number of calls to make for the given base count."""
+        return max(1, int(count * self.args.scale))
+
+    def run(self, name, params, setup, body, calls, unit='calls'):
+        """Runs the given benchmark, unless it is filtered out. setup is
+        called before every iteration and is not timed, and its result is
+        passed to body, which is timed and is expected to make the given
+        number of calls, adding the given unit to the throughput metric name.
+        One untimed warm-up iteration precedes the timed iterations."""
+        if self.args.filter not in name:
+            return
+        params = dict(params, calls=calls)
+        if self.args.list:
+            print(name, json.dumps(params, sort_keys=True))
+            return
+
+        times = []
+        for i in range(self.args.repeat + 1):
+            state = setup()
+            start = time.perf_counter()
+            body(state)
+            elapsed = time.perf_counter() - start
+            if i:
+                times.append(elapsed)
+        times.sort()
+        median = times[len(times) // 2]
+
+        result = {
+            'benchmark': name,
+            'params': params,
+            'repeat': len(times),
+            'median': median,
+            'min': times[0],
+            'mean': sum(times) / len(times),
+            'max': times[-1],
+            'per_call': median / calls,
+        }
+        if median > 0.0:
+            result[unit + '_per_second'] = calls / median
+        print(json.dumps(result, sort_keys=True))
+        sys.stdout.flush()
+        self.results.append(result)
+
+
+def make_platform():
+    return ql.Platform('bench', 'none')
+
+
+def make_kernel(platform, name='kernel'):
+    return ql.Kernel(name, platform, NUM_QUBITS, 0, NUM_QUBITS)
+
+
+def bench_platform(runner):
+    """Benchmarks platform construction."""
+    calls = runner.scaled(20)
+    runner.run(
+        'platform.construct', {'platform': 'none'},
+        lambda: None,
+        lambda _: [make_platform() for _ in range(calls)],
+        calls
+    )
+
+
+def bench_options(runner):
+    """Benchmarks setting and getting global options."""
+    calls = runner.scaled(10000)
+
+    def set_options(_):
+        for i in range(calls):
+            ql.set_option('log_level', 'LOG_NOTHING' if i & 1 else 'LOG_ERROR')
+        ql.set_option('log_level', 'LOG_NOTHING')
+
+    runner.run('option.set', {}, lambda: None, set_options, calls)
+    runner.run(
+        'option.get', {},
+        lambda: None,
+        lambda _: [ql.get_option('log_level') for _ in range(calls)],
+        calls
+    )
+
+
+def bench_kernel_gates(runner):
+    """Benchmarks adding gates to a kernel, one call per gate."""
+    platform = make_platform()
+    num_gates = runner.scaled(10000)
+    setup = lambda: make_kernel(platform)
+
+    def generic_single(k):
+        for i in range(num_gates):
+            k.gate('x', [i % NUM_QUBITS])
+
+    def generic_two(k):
+        for i in range(num_gates):
+            k.gate('cnot', [i % NUM_QUBITS, (i + 1) % NUM_QUBITS])
+
+    def generic_rotation(k):
+        for i in range(num_gates):
+            k.gate('rx', [i % NUM_QUBITS], 0, 0.001 * i)
+
+    def named_single(k):
+        for i in range(num_gates):
+            k.x(i % NUM_QUBITS)
+
+    def named_two(k):
+        for i in range(num_gates):
+            k.cnot(i % NUM_QUBITS, (i + 1) % NUM_QUBITS)
+
+    def named_rotation(k):
+        for i in range(num_gates):
+            k.rx(i % NUM_QUBITS, 0.001 * i)
+
+    def mixed(k):
+        for i in range(num_gates // 4):
+            q = i % NUM_QUBITS
+            k.hadamard(q)
+            k.cnot(q, (q + 1) % NUM_QUBITS)
+            k.rz(q, 0.001 * i)
+            k.measure(q)
+
+    params = {'platform': 'none'}
+    runner.run('kernel.gate.single', params, setup, generic_single, num_gates, 'gates')
+    runner.run('kernel.gate.two', params, setup, generic_two, num_gates, 'gates')
+    runner.run('kernel.gate.rotation', params, setup, generic_rotation, num_gates, 'gates')
+    runner.run('kernel.named.single', params, setup, named_single, num_gates, 'gates')
+    runner.run('kernel.named.two', params, setup, named_two, num_gates, 'gates')
+    runner.run('kernel.named.rotation', params, setup, named_rotation, num_gates, 'gates')
+    runner.run('kernel.named.mixed', params, setup, mixed, num_gates // 4 * 4, 'gates')
+
+
+def bench_kernel_bulk(runner):
+    """Benchmarks adding gates to a kernel in bulk, from Python lists and,
+    if available, NumPy arrays."""
+    platform = make_platform()
+    num_gates = runner.scaled(10000)
+    names = ['x', 'cnot', 'rx']
+    types = [i % 3 for i in range(num_gates)]
+    qubits = []
+    angles = []
+    for i in range(num_gates):
+        q = i % NUM_QUBITS
+        qubits.append(q)
+        qubits.append((q + 1) % NUM_QUBITS if types[i] == 1 else -1)
+        angles.append(0.001 * i if types[i] == 2 else 0.0)
+    setup = lambda: make_kernel(platform)
+    params = {'platform': 'none'}
+
+    runner.run(
+        'kernel.gates.list', params, setup,
+        lambda k: k.gates(names, types, qubits, angles),
+        num_gates, 'gates'
+    )
+    if np is not None:
+        np_types = np.array(types, dtype=np.int64)
+        np_qubits = np.array(qubits, dtype=np.int64)
+        np_angles = np.array(angles, dtype=np.float64)
+        runner.run(
+            'kernel.gates.numpy', params, setup,
+            lambda k: k.gates(names, np_types, np_qubits, np_angles),
+            num_gates, 'gates'
+        )
+
+
+def bench_program(runner):
+    """Benchmarks kernel construction and building programs out of
+    kernels."""
+    platform = make_platform()
+    num_kernels = runner.scaled(1000)
+    params = {'platform': 'none', 'gates_per_kernel': 4}
+
+    def make_small_kernel(name):
+        k = make_kernel(platform, name)
+        k.x(0)
+        k.cnot(0, 1)
+        k.rx(1, 0.5)
+        k.measure(1)
+        return k
+
+    def make_kernels():
+        return [make_small_kernel('kernel_%d' % i) for i in range(num_kernels)]
+
+    runner.run(
+        'kernel.construct', {'platform': 'none'},
+        lambda: None,
+        lambda _: [make_kernel(platform, 'kernel_%d' % i) for i in range(num_kernels)],
+        num_kernels, 'kernels'
+    )
+
+    def add_kernel(state):
+        program, kernels = state
+        for k in kernels:
+            program.add_kernel(k)
+
+    def add_kernels(state):
+        program, kernels = state
+        program.add_kernels(kernels)
+
+    setup = lambda: (ql.Program('program', platform, NUM_QUBITS, 0, NUM_QUBITS), make_kernels())
+    runner.run('program.add_kernel', params, setup, add_kernel, num_kernels, 'kernels')
+    runner.run('program.add_kernels', params, setup, add_kernels, num_kernels, 'kernels')
+
+    kernel = make_small_kernel('kernel')
+    angles = [0.001 * i for i in range(num_kernels)]
+    runner.run(
+        'program.add_kernel_clones', params,
+        lambda: ql.Program('program', platform, NUM_QUBITS, 0, NUM_QUBITS),
+        lambda program: program.add_kernel_clones(kernel, [2], angles),
+        num_kernels, 'kernels'
+    )
+
+
+BENCHMARKS = [
+    bench_platform,
+    bench_options,
+    bench_kernel_gates,
+    bench_kernel_bulk,
+    bench_program,
+]
+
+
+def get_result_key(result):
+    """Returns the key used to match results with their baseline."""
+    return result['benchmark'] + ' ' + json.dumps(result['params'], sort_keys=True)
+
+
+def compare_with_baseline(args, results, f):
+    """Compares the given results with the baseline results. A summary table
+    is written to the given file, and the number of regressions is returned.
+    A metric regresses when its value exceeds the baseline value by more than
+    the threshold. Results without a baseline are listed, but are never
+    regressions."""
+    with open(args.baseline) as bf:
+        baseline_json = json.load(bf)
+    if not isinstance(baseline_json, list):
+        raise ValueError('baseline file %s must contain a JSON array' % args.baseline)
+    baseline = {get_result_key(result): result for result in baseline_json}
+
+    print('%-60s %-14s %12s %12s %8s  status' % ('benchmark', 'metric', 'baseline', 'current', 'change'), file=f)
+    regressions = 0
+    for result in results:
+        key = get_result_key(result)
+        previous_result = baseline.get(key, {})
+        for metric in COMPARED_METRICS:
+            if metric not in result:
+                continue
+            current = result[metric]
+            if metric not in previous_result:
+                print('%-60s %-14s %12s %12.6g %8s  new' % (key, metric, '-', current, '-'), file=f)
+                continue
+            previous = previous_result[metric]
+            if previous <= 0.0:
+                print('%-60s %-14s %12.6g %12.6g %8s  ok' % (key, metric, previous, current, '-'), file=f)
+                continue
+            change = current / previous - 1.0
+            if change > args.threshold:
+                status = 'REGRESSION'
+                regressions += 1
+            elif change < -args.threshold:
+                status = 'improved'
+            else:
+                status = 'ok'
+            print('%-60s %-14s %12.6g %12.6g %+7.1f%%  %s' % (key, metric, previous, current, change * 100.0, status), file=f)
+    print('%d regression(s) beyond %g%%' % (regressions, args.threshold * 100.0), file=f)
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmarks the overhead of the OpenQL Python API.')
+    parser.add_argument('--filter', default='', help='only run benchmarks whose name contains this string')
+    parser.add_argument('--repeat', type=int, default=5, help='number of timed iterations per benchmark (default 5)')
+    parser.add_argument('--scale', type=float, default=1.0, help='factor for the number of calls per benchmark (default 1)')
+    parser.add_argument('--list', action='store_true', help='list the benchmarks instead of running them')
+    parser.add_argument('--save-baseline', metavar='FILE', help='write the results to FILE as a JSON array')
+    parser.add_argument('--baseline', metavar='FILE', help='compare the results with the baseline in FILE, print a summary table to stderr, and exit with code 2 on regressions')
+    parser.add_argument('--threshold', type=float, default=0.2, help='relative increase considered a regression (default 0.2)')
+    args = parser.parse_args()
+    if args.repeat < 1:
+        parser.error('--repeat must be at least 1')
+
+    ql.initialize()
+    ql.set_option('output_dir', output_dir)
+    ql.set_option('log_level', 'LOG_NOTHING')
+
+    runner = Runner(args)
+    for bench in BENCHMARKS:
+        bench(runner)
+    if args.list:
+        return 0
+
+    if args.save_baseline:
+        with open(args.save_baseline, 'w') as f:
+            json.dump(runner.results, f, indent=4, sort_keys=True)
+            f.write('\n')
+    if args.baseline and compare_with_baseline(args, runner.results, sys.stderr):
+        return 2
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -79,6 +79,47 @@ class Test_kernel(unittest.TestCase):
         # At this point it should be tested if these things have been added
         # to the qubits. However, it is not clear how to view this
 
+    def test_bulk_gates(self):
+        import numpy as np
+        nqubits = 3
+
+        def compile_kernel(build):
+            k = ql.Kernel("kernel1", platf, nqubits)
+            build(k)
+            p = ql.Program("test_bulk_gates", platf, nqubits)
+            p.add_kernel(k)
+            p.compile()
+            with open(os.path.join(output_dir, p.name + '_last.qasm')) as f:
+                return f.read()
+
+        def build_single(k):
+            k.gate('x', [0])
+            k.gate('rx', [1], 0, 0.5)
+            k.gate('cnot', [0, 2])
+            k.gate('measure', [2])
+
+        def build_bulk(k):
+            k.gates(
+                ['x', 'rx', 'cnot', 'measure'],
+                np.array([0, 1, 2, 3], dtype=np.int64),
+                np.array([[0, -1], [1, -1], [0, 2], [2, -1]], dtype=np.int64),
+                np.array([0.0, 0.5, 0.0, 0.0])
+            )
+
+        def build_lists(k):
+            k.gates(['x', 'rx', 'cnot', 'measure'], [0, 1, 2, 3], [0, -1, 1, -1, 0, 2, 2, -1], [0.0, 0.5, 0.0, 0.0])
+
+        expected = compile_kernel(build_single)
+        self.assertEqual(compile_kernel(build_bulk), expected)
+        self.assertEqual(compile_kernel(build_lists), expected)
+
+        k = ql.Kernel("kernel1", platf, nqubits)
+        k.gates(['x'], [], [], None)
+        with self.assertRaises(Exception):
+            k.gates(['x'], [1], [0], None)
+        with self.assertRaises(Exception):
+            k.gates(['x', 'y'], [0, 1], [0, 1, 2], None)
+
     def test_multi_kernel(self):
         sweep_points = [2]
         nqubits = 3
@@ -138,6 +179,36 @@ class Test_kernel(unittest.TestCase):
         # compile the program
         p.compile()
 
+    def test_kernel_copy_on_write(self):
+        platform = ql.Platform('platform', 'none')
+
+        def compile(p):
+            c = ql.Compiler()
+            c.append_pass('io.cqasm.Report', 'writer', {
+                'output_prefix': output_dir + '/%N',
+                'output_suffix': '.cq'
+            })
+            c.compile(p)
+            with open(os.path.join(output_dir, p.name + '.cq')) as f:
+                return f.read()
+
+        # a kernel is shared with the programs it is added to until it is
+        # modified, so gates added later must not show up in earlier programs
+        k = ql.Kernel('aKernel', platform, 3)
+        k.gate('x', [0])
+        p1 = ql.Program('test_kernel_copy_on_write_1', platform, 3)
+        p1.add_kernel(k)
+        k.gate('y', [1])
+        p2 = ql.Program('test_kernel_copy_on_write_2', platform, 3)
+        p2.add_kernel(k)
+
+        result1 = compile(p1)
+        result2 = compile(p2)
+        self.assertIn('x q[0]', result1)
+        self.assertNotIn('y q[1]', result1)
+        self.assertIn('x q[0]', result2)
+        self.assertIn('y q[1]', result2)
+
 
 if __name__ == '__main__':
     unittest.main()
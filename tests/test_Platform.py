@@ -57,5 +57,25 @@ class Test_platform(unittest.TestCase):
             os.path.join(curdir, 'golden', name + '_last.qasm')
         ))
 
+    def test_platform_snapshot(self):
+        # a platform loaded from a snapshot must compile the same as the
+        # original platform
+        results = []
+        snapshot_fn = os.path.join(output_dir, 'test_platform_snapshot.qlps')
+        ql.Platform('x', 'cc_light.s7').write_snapshot(snapshot_fn)
+        for config in ['cc_light.s7', snapshot_fn]:
+            name = 'test_platform_snapshot'
+            platf = ql.Platform(name, config)
+            k = ql.Kernel('test', platf, 7)
+            k.gate('x', [0])
+            k.gate('cnot', [0, 6])
+            k.gate('measure', [6])
+            p = ql.Program(name, platf, 7)
+            p.add_kernel(k)
+            p.compile()
+            with open(os.path.join(output_dir, name + '_last.qasm')) as f:
+                results.append(f.read())
+        self.assertEqual(results[0], results[1])
+
 if __name__ == '__main__':
     unittest.main()
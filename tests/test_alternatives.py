@@ -0,0 +1,81 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_alternatives(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, alternatives, num_threads=1):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.gate('y', [1])
+        kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('Alternatives', 'select', {
+            'pass_type': 'sch.ListSchedule',
+            'alternatives': alternatives,
+            'metric': 'latency',
+            'alternative_threads': str(num_threads),
+        })
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.writer.cq')) as f:
+            return f.read()
+
+    def test_select(self):
+        # Both scheduler targets yield the same latency for this program, so
+        # the first alternative must be kept.
+        selected = self.compile('test_alternatives_select', 'scheduler_target=asap|scheduler_target=alap')
+        asap = self.compile('test_alternatives_asap', 'scheduler_target=asap')
+        self.assertEqual(selected.replace('_select', ''), asap.replace('_asap', ''))
+
+    def test_threads(self):
+        sequential = self.compile('test_alternatives_seq', 'scheduler_target=alap|scheduler_target=asap')
+        threaded = self.compile('test_alternatives_par', 'scheduler_target=alap|scheduler_target=asap', 2)
+        self.assertEqual(sequential.replace('_seq', ''), threaded.replace('_par', ''))
+
+    def test_annotations(self):
+        # The statistics that the Clifford optimizer attaches to the blocks
+        # must survive the copies made for the alternatives, and still be
+        # reported afterwards.
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_alternatives_annotations', platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.clifford.Optimize', 'clifford')
+        compiler.append_pass('Alternatives', 'select', {
+            'pass_type': 'sch.ListSchedule',
+            'alternatives': 'scheduler_target=alap|scheduler_target=asap',
+            'metric': 'latency',
+            'alternative_threads': '2',
+        })
+        compiler.append_pass('ana.statistics.Report', 'stats')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, 'test_alternatives_annotations.stats.txt')) as f:
+            self.assertIn('cycles saved by clifford', f.read())
+
+    def test_invalid(self):
+        with self.assertRaises(RuntimeError):
+            self.compile('test_alternatives_invalid', 'scheduler_target')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,56 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_async_output(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def tearDown(self):
+        ql.set_option('async_output', 'no')
+
+    def compile(self, name):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        for i in range(20):
+            kernel.gate('x', [i % 3])
+            kernel.gate('cnot', [i % 3, (i + 1) % 3])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler', {'write_dot_graphs': 'yes'})
+        compiler.append_pass('ana.statistics.Report', 'stats')
+        compiler.append_pass('io.cqasm.Report', 'writer', {'debug': 'yes'})
+        compiler.compile(program)
+
+        outputs = {}
+        for fname in os.listdir(output_dir):
+            if fname.startswith(name + '.'):
+                with open(os.path.join(output_dir, fname)) as f:
+                    outputs[fname[len(name):]] = f.read().replace(name, '<name>')
+        return outputs
+
+    def test_async_output(self):
+        sync = self.compile('test_async_output_sync')
+        ql.set_option('async_output', 'yes')
+        ql.set_option('async_output_queue_limit', '1')
+        asynchronous = self.compile('test_async_output_async')
+
+        # The files must be complete when compile() returns, and must not
+        # depend on how they were written.
+        self.assertIn('.writer.cq', asynchronous)
+        self.assertIn('.stats.txt', asynchronous)
+        self.assertIn('.writer_debug_out.cq', asynchronous)
+        self.assertEqual(sync, asynchronous)
+
+
+if __name__ == '__main__':
+    unittest.main()
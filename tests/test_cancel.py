@@ -0,0 +1,77 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_cancel(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, build):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        build(kernel)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.Cancel', 'cancel')
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '.cq'
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.cq')) as f:
+            return f.read()
+
+    def test_nested_pairs(self):
+        def build(k):
+            k.gate('h', [0])
+            k.gate('cnot', [0, 1])
+            k.gate('x', [2])
+            k.gate('cnot', [0, 1])
+            k.gate('h', [0])
+        result = self.compile('test_cancel_nested_pairs', build)
+        self.assertNotIn('h q', result)
+        self.assertNotIn('cnot', result)
+        self.assertIn('x q[2]', result)
+
+    def test_inverse_pair(self):
+        def build(k):
+            k.gate('s', [1])
+            k.gate('sdag', [1])
+            k.gate('t', [1])
+        result = self.compile('test_cancel_inverse_pair', build)
+        self.assertNotIn('s q', result)
+        self.assertNotIn('sdag', result)
+        self.assertIn('t q[1]', result)
+
+    def test_blocked(self):
+        def build(k):
+            k.gate('cnot', [0, 1])
+            k.gate('h', [1])
+            k.gate('cnot', [0, 1])
+        result = self.compile('test_cancel_blocked', build)
+        self.assertEqual(result.count('cnot'), 2)
+
+    def test_rotations(self):
+        def build(k):
+            k.gate('rz', [0], 0, 0.25)
+            k.gate('rz', [0], 0, 0.5)
+            k.gate('rx', [1], 0, 1.5)
+            k.gate('rx', [1], 0, -1.5)
+        result = self.compile('test_cancel_rotations', build)
+        self.assertEqual(result.count('rz'), 1)
+        self.assertIn('0.75', result)
+        self.assertNotIn('rx', result)
+
+
+if __name__ == '__main__':
+    unittest.main()
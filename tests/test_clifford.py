@@ -0,0 +1,84 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_clifford(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, gates, multi_qubit, num_threads=1):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        for gate, qubits in gates:
+            kernel.gate(gate, qubits)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.clifford.Optimize', 'clifford', {
+            'multi_qubit': 'yes' if multi_qubit else 'no',
+            'qubit_threads': str(num_threads)
+        })
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '.cq'
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.cq')) as f:
+            return f.read()
+
+    def test_cnot_pair(self):
+        gates = [('cnot', [0, 1]), ('cnot', [0, 1])]
+        self.assertIn('cnot', self.compile('test_clifford_cnot_pair_1q', gates, False))
+        self.assertNotIn('cnot', self.compile('test_clifford_cnot_pair_mq', gates, True))
+
+    def test_cz_conjugation(self):
+        gates = [('h', [1]), ('cz', [0, 1]), ('h', [1]), ('cnot', [0, 1]), ('x', [2])]
+        result = self.compile('test_clifford_cz_conjugation', gates, True)
+        self.assertNotIn('cz', result)
+        self.assertNotIn('cnot', result)
+        self.assertIn('q[2]', result)
+
+    def test_non_clifford_barrier(self):
+        gates = [('cnot', [0, 1]), ('t', [1]), ('cnot', [0, 1])]
+        result = self.compile('test_clifford_non_clifford_barrier', gates, True)
+        self.assertEqual(result.count('cnot'), 2)
+        self.assertIn('t q[1]', result)
+
+    def test_single_qubit_sequences(self):
+        gates = [
+            ('h', [0]), ('x', [1]), ('h', [0]), ('cnot', [1, 2]), ('y', [1]),
+            ('s', [2]), ('measure', [0]), ('x', [1]), ('s', [2]), ('s', [2])
+        ]
+        result = self.compile('test_clifford_single_qubit_sequences', gates, False)
+        self.assertNotIn('h q[0]', result)
+        self.assertEqual(result.count('cnot'), 1)
+        self.assertIn('measure q[0]', result)
+
+    def test_num_threads(self):
+        gates = []
+        for i in range(30):
+            gates.append(('h', [i % 3]))
+            gates.append(('s', [(i + 1) % 3]))
+            if i % 4 == 0:
+                gates.append(('cnot', [i % 3, (i + 2) % 3]))
+            if i % 7 == 0:
+                gates.append(('t', [(i + 1) % 3]))
+        serial = self.compile('test_clifford_serial', gates, False, 1)
+        parallel = self.compile('test_clifford_parallel', gates, False, 4)
+        self.assertEqual(
+            serial.replace('test_clifford_serial', ''),
+            parallel.replace('test_clifford_parallel', '')
+        )
+
+
+if __name__ == '__main__':
+    unittest.main()
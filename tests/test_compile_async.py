@@ -0,0 +1,80 @@
+import openql as ql
+import asyncio
+import os
+import threading
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_compile_async(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def make_program(self, platform, name, suffix):
+        program = ql.Program(name, platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        for _ in range(100):
+            kernel.gate('x', [0])
+            kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': suffix
+        })
+        program.set_compiler(compiler)
+        return program
+
+    def read(self, name, suffix):
+        with open(os.path.join(output_dir, name + suffix)) as f:
+            return f.read()
+
+    def test_compile_async(self):
+        platform = ql.Platform('platform', 'none')
+        name = 'test_compile_async'
+        self.make_program(platform, name, '_sync.cq').compile()
+
+        job = self.make_program(platform, name, '_async.cq').compile_async()
+        job.wait()
+        self.assertTrue(job.done())
+        self.assertEqual(self.read(name, '_sync.cq'), self.read(name, '_async.cq'))
+
+        # The global options must be unfrozen once the job completes.
+        ql.set_option('log_level', 'LOG_NOTHING')
+
+    def test_compile_await(self):
+        platform = ql.Platform('platform', 'none')
+        name = 'test_compile_await'
+        self.make_program(platform, name, '_sync.cq').compile()
+
+        async def compile():
+            await self.make_program(platform, name, '_async.cq').compile_async()
+        asyncio.run(compile())
+        self.assertEqual(self.read(name, '_sync.cq'), self.read(name, '_async.cq'))
+
+    def test_compile_threads(self):
+        platform = ql.Platform('platform', 'none')
+        names = ['test_compile_threads_%d' % i for i in range(4)]
+        threads = [
+            threading.Thread(target=self.make_program(platform, name, '.cq').compile)
+            for name in names
+        ]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for name in names[1:]:
+            self.assertEqual(
+                self.read(names[0], '.cq').replace(names[0], ''),
+                self.read(name, '.cq').replace(name, '')
+            )
+
+
+if __name__ == '__main__':
+    unittest.main()
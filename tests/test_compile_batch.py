@@ -0,0 +1,74 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_compile_batch(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def make_program(self, platform, name, num_gates):
+        program = ql.Program(name, platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        for _ in range(num_gates):
+            kernel.gate('x', [0])
+            kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+        return program
+
+    def make_compiler(self, suffix):
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': suffix
+        })
+        return compiler
+
+    def test_compile_batch(self):
+        platform = ql.Platform('platform', 'none')
+        names = ['test_compile_batch_%d' % i for i in range(8)]
+
+        # Compile serially for reference.
+        compiler = self.make_compiler('_serial.cq')
+        for i, name in enumerate(names):
+            compiler.compile(self.make_program(platform, name, i + 1))
+
+        # Compile the same programs as a batch.
+        compiler = self.make_compiler('_batch.cq')
+        compiler.compile_batch(
+            [self.make_program(platform, name, i + 1) for i, name in enumerate(names)],
+            4
+        )
+
+        for name in names:
+            with open(os.path.join(output_dir, name + '_serial.cq')) as f:
+                serial = f.read()
+            with open(os.path.join(output_dir, name + '_batch.cq')) as f:
+                batch = f.read()
+            self.assertEqual(serial, batch)
+
+    def test_compile_batch_error(self):
+        platform = ql.Platform('platform', 'none')
+        compiler = ql.Compiler()
+        compiler.append_pass('io.cqasm.Read', 'reader', {
+            'cqasm_file': os.path.join(output_dir, 'does_not_exist.cq')
+        })
+        with self.assertRaises(RuntimeError):
+            compiler.compile_batch([
+                self.make_program(platform, 'test_compile_batch_error_%d' % i, 1)
+                for i in range(2)
+            ])
+
+        # The global options must not remain frozen after a failure.
+        ql.set_option('log_level', 'LOG_NOTHING')
+
+
+if __name__ == '__main__':
+    unittest.main()
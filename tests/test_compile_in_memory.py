@@ -0,0 +1,71 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_compile_in_memory(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def build(self, name):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        for i in range(20):
+            kernel.gate('x', [i % 3])
+            kernel.gate('cnot', [i % 3, (i + 1) % 3])
+        program.add_kernel(kernel)
+
+        compiler = program.get_compiler()
+        compiler.clear_passes()
+        compiler.append_pass('sch.ListSchedule', 'scheduler', {'write_dot_graphs': 'yes'})
+        compiler.append_pass('ana.statistics.Report', 'stats')
+        compiler.append_pass('io.cqasm.Report', 'writer', {'debug': 'yes'})
+        return program
+
+    def test_compile_in_memory(self):
+        name = 'test_compile_in_memory_disk'
+        self.build(name).compile()
+        on_disk = {}
+        for fname in os.listdir(output_dir):
+            if fname.startswith(name + '.'):
+                with open(os.path.join(output_dir, fname)) as f:
+                    on_disk[fname[len(name):]] = f.read().replace(name, '<name>')
+
+        # The same files must be returned, but nothing may be written.
+        name = 'test_compile_in_memory_mem'
+        files = dict(self.build(name).compile_in_memory())
+        in_memory = {}
+        for path, contents in files.items():
+            self.assertTrue(path.startswith(output_dir + '/' + name + '.'))
+            self.assertFalse(os.path.exists(path))
+            in_memory[path[len(output_dir) + 1 + len(name):]] = contents.replace(name, '<name>')
+        self.assertIn('.writer.cq', in_memory)
+        self.assertIn('.stats.txt', in_memory)
+        self.assertEqual(on_disk, in_memory)
+
+    def test_compile_cqasm_in_memory(self):
+        cqasm = '\n'.join([
+            'version 1.2',
+            'pragma @ql.name("test_compile_cqasm_in_memory")',
+            'qubits 3',
+            'x q[0]',
+            'cnot q[0], q[1]',
+            ''
+        ])
+        platform_json = ql.Platform.get_platform_json_string('none')
+        files = dict(ql.compile_in_memory(cqasm, platform_json))
+        self.assertTrue(len(files) > 0)
+        for path in files:
+            self.assertIn('test_compile_cqasm_in_memory', path)
+            self.assertFalse(os.path.exists(path))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -173,6 +173,12 @@ Indices start from 0 in both cases.
   * `with_timing` *
     Must be `yes` or `no`, default `yes`. Whether to include scheduling/timing
     information via bundle-and-skip notation.
+
+  * `block_threads` *
+    Must be an integer greater than or equal to 0, default `1`. The number of
+    threads to use for printing the blocks of the program. The blocks are printed
+    into separate buffers and concatenated in order, so the output does not depend
+    on this. 0 means use all hardware threads.
 """.strip())
         self.assertEqual(p.dump_options(False).strip(), """
 output_prefix: %N.%P
@@ -185,6 +191,7 @@ with_statistics: no
 with_metadata: yes
 with_barriers: extended
 with_timing: yes
+block_threads: 1
 """.strip())
         self.assertEqual(p.dump_options(True).strip(), 'no options to dump')
         with self.assertRaisesRegex(RuntimeError, 'unknown option: does not exist'):
@@ -0,0 +1,63 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_const_fold(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, build, options={}):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3, 3)
+        kernel = ql.Kernel('kernel', platform, 3, 3)
+        build(kernel)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.ConstFold', 'const_fold', options)
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '.cq'
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.cq')) as f:
+            return f.read()
+
+    def build_sum(self, k):
+        k.classical(ql.CReg(1), ql.Operation(3))
+        k.classical(ql.CReg(2), ql.Operation(4))
+        k.classical(ql.CReg(0), ql.Operation(ql.CReg(1), '+', ql.CReg(2)))
+
+    def test_propagate(self):
+        result = self.compile('test_const_fold_propagate', self.build_sum)
+        self.assertIn('= 7', result)
+        self.assertNotIn('+', result)
+
+    def test_no_propagate(self):
+        result = self.compile('test_const_fold_no_propagate', self.build_sum, {
+            'propagate': 'no'
+        })
+        self.assertNotIn('= 7', result)
+        self.assertIn('+', result)
+
+    def test_redundant_set(self):
+        def build(k):
+            k.classical(ql.CReg(1), ql.Operation(3))
+            k.gate('x', [0])
+            k.classical(ql.CReg(1), ql.Operation(3))
+            k.classical(ql.CReg(2), ql.Operation(ql.CReg(1)))
+        result = self.compile('test_const_fold_redundant_set', build)
+        self.assertEqual(result.count('= 3'), 2)
+        self.assertIn('x q[0]', result)
+
+
+if __name__ == '__main__':
+    unittest.main()
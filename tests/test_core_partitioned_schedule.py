@@ -0,0 +1,49 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_core_partitioned_schedule(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, core_partitioned):
+        platform = ql.Platform('mc4x4full', os.path.join(curdir, 'test_multi_core_4x4_full.json'))
+        program = ql.Program('test_core_partitioned', platform, 16)
+        kernel = ql.Kernel('kernel', platform, 16)
+        for i in range(4):
+            kernel.gate('x', [4*i])
+            kernel.gate('cnot', [4*i, 4*i+1])
+        kernel.barrier()
+        for i in range(4):
+            kernel.gate('x', [4*i+1])
+            kernel.gate('x', [4*i+2])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler', {
+            'scheduler_target': 'asap',
+            'core_partitioned': 'yes' if core_partitioned else 'no',
+            'block_threads': '4',
+        })
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, 'test_core_partitioned.writer.cq')) as f:
+            return f.read()
+
+    def test_same_schedule(self):
+        # The cores don't interact other than through the barrier, so
+        # scheduling them independently on either side of it yields the same
+        # schedule as scheduling the block as a whole.
+        self.assertEqual(self.compile(True), self.compile(False))
+
+
+if __name__ == '__main__':
+    unittest.main()
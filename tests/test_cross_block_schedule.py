@@ -0,0 +1,56 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_cross_block_schedule(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, cross_block):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 2)
+        first = ql.Kernel('first', platform, 2)
+        first.gate('x', [0])
+        first.gate('y', [0])
+        program.add_kernel(first)
+        second = ql.Kernel('second', platform, 2)
+        second.gate('x', [1])
+        second.gate('y', [0])
+        program.add_kernel(second)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler', {
+            'scheduler_target': 'asap',
+            'cross_block': 'yes' if cross_block else 'no',
+        })
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.writer.cq')) as f:
+            cq = f.read()
+        return cq[:cq.index('.second')], cq[cq.index('.second'):]
+
+    def test_independent(self):
+        first, second = self.compile('test_cross_block_independent', False)
+        self.assertNotIn('x q[1]', first)
+        self.assertIn('x q[1]', second)
+
+    def test_cross_block(self):
+        # The x gate on q[1] in the second block does not depend on anything
+        # in the first block, so it moves into the first block. The y gate on
+        # q[0] does, and stays where it is.
+        first, second = self.compile('test_cross_block_overlap', True)
+        self.assertIn('x q[1]', first)
+        self.assertNotIn('x q[1]', second)
+        self.assertIn('y q[0]', second)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,68 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_dead_passes(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def tearDown(self):
+        ql.set_option('defer_reports', 'no')
+
+    def compile(self, tag):
+        name = 'test_dead_passes'
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        for i in range(4):
+            kernel.gate('x', [i % 3])
+            kernel.gate('cnot', [i % 3, (i + 1) % 3])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('io.cqasm.Report', 'disabled', {
+            'output_prefix': '',
+            'output_suffix': os.path.join(output_dir, name + '_' + tag + '_disabled.cq')
+        })
+        compiler.append_pass('io.cqasm.Report', 'initial', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '_' + tag + '_initial.cq'
+        })
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'scheduled', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '_' + tag + '_scheduled.cq'
+        })
+        compiler.compile(program)
+
+        # A report with an empty output prefix is dead, so it must not have
+        # written anything.
+        self.assertFalse(os.path.exists(os.path.join(output_dir, name + '_' + tag + '_disabled.cq')))
+
+        outputs = []
+        for suffix in ('_initial.cq', '_scheduled.cq'):
+            suffix = '_' + tag + suffix
+            with open(os.path.join(output_dir, name + suffix)) as f:
+                outputs.append(f.read())
+        return outputs
+
+    def test_deferred_reports(self):
+
+        # Deferred reports must see the IR as it was when they were
+        # scheduled, not as it is at the end of the pipeline.
+        inline = self.compile('inline')
+        ql.set_option('defer_reports', 'yes')
+        deferred = self.compile('deferred')
+        self.assertEqual(inline, deferred)
+        self.assertNotEqual(deferred[0], deferred[1])
+
+
+if __name__ == '__main__':
+    unittest.main()
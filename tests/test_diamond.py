@@ -116,6 +116,45 @@ class Test_diamond(unittest.TestCase):
         qasm_fn = os.path.join(output_dir, 'diamond_cqasm_diamond_codegen.dqasm')
         self.assertTrue(file_compare(qasm_fn, gold_fn))
 
+    def test_diamond_calibration(self):
+        # the generator inserts calibration gates into the program, so passes
+        # that run after it see them
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('prescheduler', 'no')
+
+        platform = ql.Platform('diamond_test', 'diamond')
+
+        nqubits = 2
+        p = ql.Program('diamond_calibration', platform, nqubits)
+        k = ql.Kernel('kernel', platform, nqubits)
+        for _ in range(11):
+            k.gate('x', [0])
+        p.add_kernel(k)
+
+        compiler = platform.get_compiler()
+        compiler.append_pass('io.cqasm.Report', 'writer', {'with_timing': 'no'})
+        compiler.compile(p)
+
+        with open(os.path.join(output_dir, p.name + '.writer.cq')) as f:
+            lines = [line.strip() for line in f.read().split('\n')]
+        expected = []
+        for q in range(nqubits):
+            expected.append('sweep_bias q[%d], 10, %d, 0, 10, 100, 0' % (q, q))
+            expected.append('calculate_current q[%d]' % q)
+        for q in range(nqubits):
+            expected.append('rabi_check q[%d], 100, 2, 3' % q)
+        for q in range(nqubits):
+            expected.append('crc q[%d], 5, %d' % (q, q))
+        for q in range(nqubits):
+            expected.append('initialize q[%d]' % q)
+        expected.extend(['x q[0]'] * 10)
+        for q in range(nqubits):
+            expected.append('crc q[%d], 5, %d' % (q, q))
+        expected.append('x q[0]')
+        gates = [line for line in lines if line in expected]
+        self.assertEqual(gates, expected)
+
 
 if __name__ == '__main__':
     unittest.main()
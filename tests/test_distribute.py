@@ -0,0 +1,70 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_distribute(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, options):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        for i in range(3):
+            kernel = ql.Kernel('kernel%d' % i, platform, 3)
+            kernel.gate('x', [i])
+            kernel.gate('cnot', [i, (i + 1) % 3])
+            kernel.gate('y', [(i + 2) % 3])
+            program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('Distribute', 'distribute', options)
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+        with open(os.path.join(output_dir, name + '.writer.cq')) as f:
+            return f.read().replace(name, '<name>')
+
+    def test_shards(self):
+        cq = self.compile('test_distribute', {
+            'pass_types': 'sch.ListSchedule,io.cqasm.Report',
+            'shard_threads': '1',
+        })
+
+        # the kernels must be merged back in order
+        positions = [cq.index('.kernel%d' % i) for i in range(3)]
+        self.assertEqual(positions, sorted(positions))
+
+        # each shard only contains its own kernel, and gets its own output
+        # files
+        for i in range(3):
+            with open(os.path.join(output_dir, 'test_distribute_%d.distribute.pass1.cq' % i)) as f:
+                shard = f.read()
+            for j in range(3):
+                if i == j:
+                    self.assertIn('.kernel%d' % j, shard)
+                else:
+                    self.assertNotIn('.kernel%d' % j, shard)
+
+    def test_threads(self):
+        options = {'pass_types': 'sch.ListSchedule', 'shard_threads': '1'}
+        sequential = self.compile('test_distribute_seq', options)
+        options['shard_threads'] = '3'
+        concurrent = self.compile('test_distribute_par', options)
+        self.assertEqual(sequential, concurrent)
+
+    def test_unknown_transport(self):
+        with self.assertRaisesRegex(RuntimeError, 'unknown transport'):
+            self.compile('test_distribute_transport', {
+                'pass_types': 'sch.ListSchedule',
+                'transport': 'does_not_exist',
+            })
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,72 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_fuse(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, build, options={}):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        build(kernel)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.Fuse', 'fuse', options)
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '.cq'
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.cq')) as f:
+            return f.read()
+
+    def test_long_run(self):
+        def build(k):
+            k.gate('h', [0])
+            k.gate('s', [0])
+            k.gate('x', [0])
+            k.gate('t', [0])
+            k.gate('y90', [0])
+            k.gate('rz', [0], 0, 0.3)
+        result = self.compile('test_fuse_long_run', build, {'basis': 'zyz'})
+        self.assertNotIn('h q', result)
+        self.assertNotIn('rx', result)
+        self.assertLessEqual(result.count('rz q[0]') + result.count('ry q[0]'), 3)
+
+    def test_identity(self):
+        def build(k):
+            k.gate('x', [1])
+            k.gate('x', [1])
+            k.gate('h', [2])
+            k.gate('h', [2])
+            k.gate('z', [2])
+        result = self.compile('test_fuse_identity', build)
+        self.assertNotIn('q[1]', result)
+        self.assertNotIn('h q', result)
+        self.assertIn('q[2]', result)
+
+    def test_blocked(self):
+        def build(k):
+            k.gate('h', [1])
+            k.gate('s', [1])
+            k.gate('cnot', [0, 1])
+            k.gate('h', [1])
+            k.gate('s', [1])
+        result = self.compile('test_fuse_blocked', build)
+        self.assertEqual(result.count('h q[1]'), 2)
+        self.assertEqual(result.count('s q[1]'), 2)
+
+
+if __name__ == '__main__':
+    unittest.main()
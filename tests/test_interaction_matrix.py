@@ -0,0 +1,50 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_interaction_matrix(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def build(self, name):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 4)
+        kernel = ql.Kernel(name + '_kernel', platform, 4)
+        kernel.gate('cnot', [0, 1])
+        kernel.gate('cnot', [1, 0])
+        kernel.gate('cnot', [2, 3])
+        kernel.gate('x', [2])
+        program.add_kernel(kernel)
+        return program
+
+    def read(self, name):
+        with open(os.path.join(output_dir, name + '_kernelInteractionMatrix.dat')) as f:
+            return f.read()
+
+    def test_dense(self):
+        program = self.build('test_interaction_matrix_dense')
+        program.write_interaction_matrix()
+        rows = [line.split() for line in self.read('test_interaction_matrix_dense').splitlines()]
+        self.assertEqual(rows[0], ['q0', 'q1', 'q2', 'q3'])
+        self.assertEqual(rows[1], ['q0', '0', '2', '0', '0'])
+        self.assertEqual(rows[3], ['q2', '0', '0', '0', '1'])
+
+    def test_sparse(self):
+        program = self.build('test_interaction_matrix_sparse')
+        program.write_interaction_matrix(True)
+        lines = [
+            line for line in self.read('test_interaction_matrix_sparse').splitlines()
+            if not line.startswith('#')
+        ]
+        self.assertEqual(lines, ['0 1 2', '1 0 2', '2 3 1', '3 2 1'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,75 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_kernel_clones(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, program):
+        compiler = ql.Compiler()
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+        with open(os.path.join(output_dir, name + '.writer.cq')) as f:
+            return f.read()
+
+    def test_add_kernels(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_add_kernels', platform, 2)
+        kernels = []
+        for i in range(3):
+            k = ql.Kernel('k%d' % i, platform, 2)
+            k.gate('x', [i % 2])
+            kernels.append(k)
+        program.add_kernels(kernels)
+        cq = self.compile('test_add_kernels', program)
+        self.assertLess(cq.index('.k0'), cq.index('.k1'))
+        self.assertLess(cq.index('.k1'), cq.index('.k2'))
+
+    def test_add_kernels_duplicate(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_add_kernels_duplicate', platform, 2)
+        a = ql.Kernel('a', platform, 2)
+        b = ql.Kernel('b', platform, 2)
+        with self.assertRaises(Exception):
+            program.add_kernels([a, b, ql.Kernel('a', platform, 2)])
+
+        # None of the kernels should have been added.
+        program.add_kernels([a, b])
+
+    def test_add_kernel_clones(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_add_kernel_clones', platform, 2)
+        k = ql.Kernel('sweep', platform, 2)
+        k.gate('x', [0])
+        k.rx(0, 1.0)
+        k.ry(1, 1.0)
+        program.add_kernel_clones(k, [1, 2], [0.25, 0.5, 0.75, 1.25])
+        cq = self.compile('test_add_kernel_clones', program)
+        first = cq[cq.index('.sweep_0'):cq.index('.sweep_1')]
+        second = cq[cq.index('.sweep_1'):]
+        self.assertIn('0.25', first)
+        self.assertIn('0.5', first)
+        self.assertIn('0.75', second)
+        self.assertIn('1.25', second)
+        self.assertNotIn('.sweep\n', cq)
+
+    def test_add_kernel_clones_mismatch(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_add_kernel_clones_mismatch', platform, 2)
+        k = ql.Kernel('sweep', platform, 2)
+        k.rx(0, 1.0)
+        with self.assertRaises(Exception):
+            program.add_kernel_clones(k, [0, 1], [0.25, 0.5, 0.75])
+        with self.assertRaises(Exception):
+            program.add_kernel_clones(k, [1], [0.25])
+
+if __name__ == '__main__':
+    unittest.main()
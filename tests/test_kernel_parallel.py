@@ -0,0 +1,66 @@
+import openql as ql
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_kernel_parallel(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, kernel_threads):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 3)
+        for k in range(6):
+            kernel = ql.Kernel('kernel_%d' % k, platform, 3)
+            for i in range(k + 1):
+                kernel.gate('h', [i % 3])
+                kernel.gate('h', [i % 3])
+                kernel.gate('cnot', [i % 3, (i + 1) % 3])
+                kernel.gate('x', [(i + 2) % 3])
+            program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.clifford.Optimize', 'clifford', {
+            'qubit_threads': str(kernel_threads)
+        })
+        compiler.append_pass('sch.Schedule', 'scheduler', {
+            'kernel_threads': str(kernel_threads)
+        })
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': '.cq'
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, name + '.cq')) as f:
+            return f.read()
+
+    def test_kernel_parallel(self):
+        serial = self.compile('test_kernel_parallel_serial', 1)
+        parallel = self.compile('test_kernel_parallel_parallel', 4)
+        self.assertEqual(
+            serial.replace('test_kernel_parallel_serial', ''),
+            parallel.replace('test_kernel_parallel_parallel', '')
+        )
+
+    def test_ir_conversion_parallel(self):
+        serial = self.compile('test_ir_conversion_serial', 1)
+        try:
+            ql.set_option('ir_conversion_threads', '4')
+            parallel = self.compile('test_ir_conversion_parallel', 1)
+        finally:
+            ql.set_option('ir_conversion_threads', '1')
+        self.assertEqual(
+            serial.replace('test_ir_conversion_serial', ''),
+            parallel.replace('test_ir_conversion_parallel', '')
+        )
+
+
+if __name__ == '__main__':
+    unittest.main()
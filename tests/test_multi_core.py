@@ -157,6 +157,38 @@ class Test_multi_core(unittest.TestCase):
         qasm_fn = os.path.join(output_dir, prog.name+'_last.qasm')
         self.assertTrue( file_compare(qasm_fn, gold_fn) )
 
+    def compile_partitioned(self, prog_name, enable):
+        config = os.path.join(curdir, "test_multi_core_4x4_full.json")
+        num_qubits = 16
+
+        # create and set platform
+        starmon = ql.Platform("mc4x4full", config)
+        starmon.get_compiler().set_option('mapper.enable_core_partitioner', enable)
+        prog = ql.Program(prog_name, starmon, num_qubits, 0)
+        k = ql.Kernel("kernel_partition", starmon, num_qubits, 0)
+
+        # qubits 4*i+j interact only with qubits 4*j+i, so the one-to-one
+        # mapping requires inter-core communication for nearly all gates
+        for r in range(3):
+            for i in range(4):
+                for j in range(4):
+                    if i < j:
+                        k.gate("cnot", [4*i+j,4*j+i])
+
+        prog.add_kernel(k)
+        prog.compile()
+
+        qasm_fn = os.path.join(output_dir, prog.name+'_last.qasm')
+        with open(qasm_fn) as f:
+            return len(f.readlines())
+
+    def test_mc_partition(self):
+        # after partitioning, all interacting qubits share a core, so no
+        # routing operations should be needed anymore
+        partitioned = self.compile_partitioned('test_mc_partition_yes', 'yes')
+        unpartitioned = self.compile_partitioned('test_mc_partition_no', 'no')
+        self.assertLess(partitioned, unpartitioned)
+
 if __name__ == '__main__':
     # ql.set_option('log_level', 'LOG_DEBUG')
     unittest.main()
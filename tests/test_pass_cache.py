@@ -0,0 +1,61 @@
+import openql as ql
+import os
+import unittest
+import tempfile
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_pass_cache(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def tearDown(self):
+        ql.set_option('pass_cache_dir', '')
+
+    def compile(self, suffix):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_pass_cache', platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        for i in range(4):
+            kernel.gate('x', [i % 3])
+            kernel.gate('cnot', [i % 3, (i + 1) % 3])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'writer', {
+            'output_prefix': output_dir + '/%N',
+            'output_suffix': suffix
+        })
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, 'test_pass_cache' + suffix)) as f:
+            return f.read()
+
+    def test_pass_cache(self):
+        uncached = self.compile('_uncached.cq')
+        with tempfile.TemporaryDirectory() as d:
+            ql.set_option('pass_cache_dir', d)
+
+            # The first run populates the cache. The cQASM writer is an
+            # analysis pass, so only the scheduler gets an entry.
+            first = self.compile('_first.cq')
+            entries = os.listdir(d)
+            self.assertEqual(len(entries), 1)
+            self.assertTrue(entries[0].endswith('.json'))
+
+            # The second run restores the scheduler result from the cache.
+            second = self.compile('_second.cq')
+            self.assertEqual(os.listdir(d), entries)
+
+        self.assertEqual(uncached, first)
+        self.assertEqual(uncached, second)
+
+
+if __name__ == '__main__':
+    unittest.main()
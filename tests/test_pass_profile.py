@@ -0,0 +1,86 @@
+import openql as ql
+import os
+import json
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_pass_profile(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def tearDown(self):
+        ql.set_option('profile_passes', 'no')
+        ql.set_option('profile_allocations', 'no')
+
+    def test_pass_profile(self):
+        ql.set_option('profile_passes', 'yes')
+
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_pass_profile', platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, 'test_pass_profile_pass_profile.json')) as f:
+            profile = json.load(f)
+        names = [record['pass'] for record in profile]
+        self.assertEqual(names, ['', 'scheduler', 'writer'])
+        self.assertEqual([record['depth'] for record in profile], [0, 1, 1])
+        self.assertEqual(profile[1]['type'], 'sch.ListSchedule')
+        for record in profile:
+            self.assertGreater(record['nodes_before'], 0)
+            self.assertGreater(record['nodes_after'], 0)
+
+        with open(os.path.join(output_dir, 'test_pass_profile_pass_trace.json')) as f:
+            trace = json.load(f)
+        self.assertEqual(len(trace['traceEvents']), 3)
+        self.assertEqual(trace['traceEvents'][1]['name'], 'scheduler')
+        self.assertEqual(trace['traceEvents'][1]['ph'], 'X')
+        self.assertNotIn('allocated_bytes', profile[0])
+
+    def test_allocation_profile(self):
+        ql.set_option('profile_passes', 'yes')
+        ql.set_option('profile_allocations', 'yes')
+
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_allocation_profile', platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        for _ in range(10):
+            kernel.gate('x', [0])
+            kernel.gate('cnot', [0, 1])
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('io.cqasm.Report', 'writer')
+        compiler.compile(program)
+
+        with open(os.path.join(output_dir, 'test_allocation_profile_pass_profile.json')) as f:
+            profile = json.load(f)
+        root, scheduler, writer = profile
+        for record in profile:
+            self.assertGreaterEqual(record['peak_live_bytes'], record['live_bytes'])
+
+        # The root group includes the allocations and peak of its sub-passes.
+        self.assertGreaterEqual(
+            root['allocated_bytes'],
+            scheduler['allocated_bytes'] + writer['allocated_bytes']
+        )
+        self.assertGreaterEqual(root['peak_live_bytes'], scheduler['peak_live_bytes'])
+        self.assertGreaterEqual(root['peak_live_bytes'], writer['peak_live_bytes'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,53 @@
+import openql as ql
+import os
+import threading
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_progress(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def test_idle(self):
+        self.assertEqual(dict(ql.get_progress()), {})
+
+    def test_poll_while_compiling(self):
+        platform = ql.Platform('platform', 'cc_light.s7')
+        program = ql.Program('test_progress', platform, 7)
+        kernel = ql.Kernel('kernel', platform, 7)
+        for i in range(500):
+            kernel.gate('cnot', [i % 7, (i * 3 + 1) % 7])
+        program.add_kernel(kernel)
+
+        # poll from another thread while the program is being compiled
+        done = threading.Event()
+        polled = []
+        def poll():
+            while not done.is_set():
+                polled.append(dict(ql.get_progress()))
+                done.wait(0.01)
+        poller = threading.Thread(target=poll)
+        poller.start()
+        try:
+            ql.set_option('mapper', 'minextend')
+            program.compile()
+        finally:
+            ql.set_option('mapper', 'no')
+            done.set()
+            poller.join()
+
+        for progress in polled:
+            for name, fraction in progress.items():
+                self.assertGreaterEqual(fraction, 0.0)
+                self.assertLessEqual(fraction, 1.0)
+        self.assertEqual(dict(ql.get_progress()), {})
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,63 @@
+import openql as ql
+import numpy as np
+import os
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_schedule(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+
+    def test_compile_to_schedule(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_compile_to_schedule', platform, 3)
+        kernel = ql.Kernel('kernel', platform, 3)
+        kernel.gate('x', [0])
+        kernel.gate('x', [1])
+        kernel.gate('cnot', [0, 1])
+        kernel.gate('y', [2])
+        program.add_kernel(kernel)
+
+        compiler = program.get_compiler()
+        compiler.clear_passes()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        schedule = program.compile_to_schedule()
+
+        self.assertEqual(schedule.get_num_instructions(), 4)
+        self.assertEqual(schedule.get_num_blocks(), 1)
+        columns = schedule.get_columns()
+        self.assertEqual(set(columns), set(schedule.get_column_names()))
+        for column in columns.values():
+            self.assertEqual(column.dtype, np.int64)
+            self.assertFalse(column.flags.writeable)
+
+        # The arrays must remain usable after the schedule is gone.
+        del schedule
+        self.assertEqual(list(columns['block_offset']), [0, 4])
+        self.assertEqual(list(columns['operand_offset']), [0, 1, 2, 4, 5])
+        self.assertEqual(sorted(columns['operand'][2:4]), [0, 1])
+        self.assertTrue(np.all(columns['duration'] > 0))
+        self.assertTrue(np.all(np.diff(columns['cycle']) >= 0))
+
+    def test_compile_to_schedule_names(self):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_compile_to_schedule_names', platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.gate('x', [1])
+        kernel.gate('h', [0])
+        program.add_kernel(kernel)
+        schedule = program.compile_to_schedule()
+        names = list(schedule.get_instruction_types())
+        types = schedule.get_column('type')
+        self.assertEqual([names[t] for t in types], ['x', 'x', 'h'])
+        self.assertEqual(list(schedule.get_block_names()), ['kernel'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -42,5 +42,13 @@ class Test_structure_decomposition(unittest.TestCase):
     def test_structure_decomposition_repeat_until(self):
         self.run_test_case('structure_decomposition_repeat_until')
 
+    def test_structure_decomposition_check_levels(self):
+        try:
+            for level in ['off', 'sampled', 'changed', 'full']:
+                ql.set_option('ir_consistency_check', level)
+                self.run_test_case('structure_decomposition_while')
+        finally:
+            ql.set_option('ir_consistency_check', 'full')
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,83 @@
+import openql as ql
+import os
+import json
+import unittest
+
+curdir = os.path.dirname(os.path.realpath(__file__))
+output_dir = os.path.join(curdir, 'test_output')
+
+class test_sweep(unittest.TestCase):
+
+    def setUp(self):
+        ql.initialize()
+        ql.set_option('output_dir', output_dir)
+        ql.set_option('log_level', 'LOG_NOTHING')
+        ql.set_option('unique_output', 'no')
+
+    def compile(self, name, values, num_threads=1):
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program(name, platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.rx(1, 12.5)
+        kernel.rx(0, 0.5)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('sch.ListSchedule', 'scheduler')
+        compiler.append_pass('Sweep', 'sweep', {
+            'pass_types': 'io.cqasm.Report',
+            'placeholder': '12.5',
+            'values': values,
+            'point_threads': str(num_threads),
+        })
+        compiler.compile(program)
+
+    def test_instances(self):
+        self.compile('test_sweep', '0.25,0.75')
+        for index, value in enumerate(['0.25', '0.75']):
+            with open(os.path.join(output_dir, 'test_sweep_%d.sweep.pass0.cq' % index)) as f:
+                cq = f.read()
+            self.assertNotIn('12.5', cq)
+            self.assertIn(value, cq)
+            self.assertIn('0.5', cq)
+        with open(os.path.join(output_dir, 'test_sweep.sweep.json')) as f:
+            self.assertEqual(json.load(f)['measurement_points'], [0.25, 0.75])
+
+    def test_threads(self):
+        self.compile('test_sweep_seq', '1,2,3')
+        self.compile('test_sweep_par', '1,2,3', 2)
+        for index in range(3):
+            with open(os.path.join(output_dir, 'test_sweep_seq_%d.sweep.pass0.cq' % index)) as f:
+                sequential = f.read()
+            with open(os.path.join(output_dir, 'test_sweep_par_%d.sweep.pass0.cq' % index)) as f:
+                threaded = f.read()
+            self.assertEqual(sequential.replace('_seq', ''), threaded.replace('_par', ''))
+
+    def test_annotations(self):
+        # The statistics that the Clifford optimizer attaches to the blocks
+        # must survive the copies made for the sweep points.
+        platform = ql.Platform('platform', 'none')
+        program = ql.Program('test_sweep_annotations', platform, 2)
+        kernel = ql.Kernel('kernel', platform, 2)
+        kernel.gate('x', [0])
+        kernel.rx(1, 12.5)
+        program.add_kernel(kernel)
+
+        compiler = ql.Compiler()
+        compiler.append_pass('opt.clifford.Optimize', 'clifford')
+        compiler.append_pass('Sweep', 'sweep', {
+            'pass_types': 'ana.statistics.Report',
+            'placeholder': '12.5',
+            'values': '0.25,0.75',
+            'point_threads': '2',
+        })
+        compiler.compile(program)
+
+        for index in range(2):
+            with open(os.path.join(output_dir, 'test_sweep_annotations_%d.sweep.pass0.txt' % index)) as f:
+                self.assertIn('cycles saved by clifford', f.read())
+
+
+if __name__ == '__main__':
+    unittest.main()